@@ -16,6 +16,8 @@ folly::StringPiece congestionControlTypeToString(CongestionControlType type) {
       return "cubic";
     case CongestionControlType::BBR:
       return "bbr";
+    case CongestionControlType::BBR2:
+      return "bbr2";
     case CongestionControlType::Copa:
       return "copa";
     case CongestionControlType::NewReno:
@@ -35,6 +37,10 @@ QuicBatchingMode getQuicBatchingMode(uint32_t val) {
       return QuicBatchingMode::BATCHING_MODE_GSO;
     case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_SENDMMSG):
       return QuicBatchingMode::BATCHING_MODE_SENDMMSG;
+    case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY):
+      return QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY;
+    case static_cast<uint32_t>(QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO):
+      return QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO;
       // no default
   }
 
@@ -79,6 +85,8 @@ std::string writeDataReasonString(WriteDataReason reason) {
       return "Reset";
     case WriteDataReason::PATHCHALLENGE:
       return "PathChallenge";
+    case WriteDataReason::DATAGRAM:
+      return "Datagram";
     case WriteDataReason::NO_WRITE:
       return "NoWrite";
   }
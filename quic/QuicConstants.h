@@ -42,11 +42,45 @@ constexpr uint16_t kMinMaxUDPPayload = 1200;
 // EMSGSIZE.
 constexpr uint16_t kDefaultMsgSizeBackOffSize = 50;
 
+// Largest packet probed by path MTU discovery by default, what is left of a
+// 9000 byte jumbo frame after the IPv6 and UDP headers.
+constexpr uint64_t kDefaultMaxPmtuProbeSize = 8952;
+// The search for the path MTU stops once the largest size known to work is
+// this close to the smallest size known not to.
+constexpr uint64_t kPmtuSearchGranularity = 32;
+// Number of lost probes of a size before it is known not to work (MAX_PROBES
+// of RFC 8899).
+constexpr uint8_t kMaxPmtuProbes = 3;
+// A probe that isn't acked within this many PTOs is lost.
+constexpr uint8_t kPmtuProbeTimeoutPtos = 3;
+// Once the search is over, time before it starts again in case the path MTU
+// grew (PMTU_RAISE_TIMER of RFC 8899).
+constexpr std::chrono::seconds kPmtuRaiseTimer = 600s;
+// Number of packets larger than the size the search started from that can be
+// lost in a row, without one of them acked, before the path is assumed to no
+// longer carry them.
+constexpr uint64_t kPmtuBlackHoleThreshold = 6;
+
+// A packet isn't coalesced into a datagram with less room left than this, the
+// datagram is sent and the packet starts a new one.
+constexpr uint64_t kMinCoalescedPacketRoom = 64;
+
 // Size of read buffer we provide to AsyncUDPSocket. The packet size cannot be
 // larger than this, unless configured otherwise.
 constexpr uint16_t kDefaultUDPReadBufferSize = 1500;
 
 constexpr uint16_t kMaxNumCoalescedPackets = 5;
+
+// Max number of emptied frame vectors the read codec keeps for reuse, and the
+// max capacity of the ones it keeps, so that one packet with a lot of frames
+// doesn't pin its memory for the lifetime of the connection.
+constexpr size_t kMaxSpareFrameVectors = 8;
+constexpr size_t kMaxRecycledFrames = 32;
+
+// Largest datagram that TakeoverProtocolVersion::V1 packs forwarded packets
+// into, unless a single packet needs more. The packets are forwarded over
+// loopback, whose MTU is much larger.
+constexpr uint16_t kMaxTakeoverBatchSize = 16 * 1024;
 // As per version 20 of the spec, transport parameters for private use must
 // have ids with first byte being 0xff.
 constexpr uint16_t kCustomTransportParameterThreshold = 0xff00;
@@ -57,6 +91,10 @@ constexpr uint16_t kCustomTransportParameterThreshold = 0xff00;
 constexpr uint64_t kDefaultBufferSpaceAvailable =
     std::numeric_limits<uint64_t>::max();
 
+// Size of the buffers that small stream writes are coalesced into when
+// TransportSettings::writeCoalescingThreshold is set.
+constexpr size_t kWriteCoalescingBufferSize = 2048;
+
 // The default min rtt to use for a new connection
 constexpr std::chrono::microseconds kDefaultMinRtt =
     std::chrono::microseconds::max();
@@ -95,6 +133,11 @@ enum class FrameType : uint8_t {
   PATH_RESPONSE = 0x1B,
   CONNECTION_CLOSE = 0x1C,
   APPLICATION_CLOSE = 0x1D,
+  // DATAGRAM frames run to the end of the packet, DATAGRAM_LEN ones carry
+  // their length (draft-ietf-quic-datagram).
+  DATAGRAM = 0x30,
+  DATAGRAM_LEN = 0x31,
+  ACK_FREQUENCY = 0xAF, // draft-iyengar-quic-delayed-ack
   MIN_STREAM_DATA = 0xFE, // subject to change (https://fburl.com/qpr)
   EXPIRED_STREAM_DATA = 0xFF, // subject to change (https://fburl.com/qpr)
 };
@@ -194,6 +237,16 @@ using TransportPartialReliabilitySetting = bool;
 
 constexpr uint16_t kPartialReliabilityParameterId = 0xFF00; // subject to change
 
+// Advertises the smallest ack delay the endpoint can be asked for with an
+// ACK_FREQUENCY frame, in microseconds.
+constexpr uint16_t kMinAckDelayParameterId = 0xFF01; // subject to change
+
+// Advertises the largest DATAGRAM frame the endpoint accepts, the extension
+// is not supported without it. The draft's 0x20 is below
+// kCustomTransportParameterThreshold, so it goes in the private range for
+// now, like the other extensions.
+constexpr uint16_t kMaxDatagramFrameSizeParameterId = 0xFF02;
+
 constexpr uint32_t kDrainFactor = 3;
 
 // batching mode
@@ -201,6 +254,12 @@ enum class QuicBatchingMode : uint32_t {
   BATCHING_MODE_NONE = 0,
   BATCHING_MODE_GSO = 1,
   BATCHING_MODE_SENDMMSG = 2,
+  // GSO with MSG_ZEROCOPY, falls back to BATCHING_MODE_GSO if the socket
+  // does not support zero copy
+  BATCHING_MODE_GSO_ZEROCOPY = 3,
+  // sendmmsg of GSO messages, falls back to BATCHING_MODE_SENDMMSG if the
+  // socket does not support GSO
+  BATCHING_MODE_SENDMMSG_GSO = 4,
 };
 
 QuicBatchingMode getQuicBatchingMode(uint32_t val);
@@ -209,6 +268,49 @@ QuicBatchingMode getQuicBatchingMode(uint32_t val);
 // by BATCHING_MODE_GSO
 constexpr uint32_t kDefaultQuicMaxBatchSize = 16;
 
+// Headroom of the packet arena buffers, which the packet header is copied
+// into once the packet is encrypted. Packets with a larger header end up as
+// a chain.
+constexpr size_t kPacketArenaHeadroom = 64;
+
+// How many acked packets ahead of the one being processed have their frames
+// prefetched, see processAckFrame().
+constexpr size_t kAckPrefetchDistance = 8;
+
+// Size of the huge pages the buffer pool regions are made of, and rounded up
+// to.
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+// Maximum number of segments the kernel accepts in a single GSO send.
+constexpr size_t kMaxGSOSegments = 64;
+
+// default number of datagrams to read per read event. 1 disables batched
+// reads.
+constexpr uint32_t kDefaultQuicMaxRecvBatchSize = 1;
+
+// number of packets that can wait to be handed from one server worker to
+// another before the worker falls back to scheduling one closure per packet.
+constexpr size_t kWorkerHandoffQueueSize = 1024;
+
+// Version of the encoding of the connection snapshots that a server hands to
+// the process taking it over, and the largest encoded snapshot accepted.
+constexpr uint8_t kServerConnectionSnapshotVersion = 1;
+constexpr size_t kMaxServerConnectionSnapshotSize = 64 * 1024;
+
+// Number of shards of the ShardedQuicPskCache, and the version of the encoding
+// of the file it can be saved to.
+constexpr size_t kDefaultPskCacheShards = 16;
+constexpr uint8_t kPskCacheFileVersion = 2;
+
+// Most connections a QuicConnectionPool keeps to one peer, and the number of
+// streams the pool's connections to a peer must still be able to open before
+// it starts another connection ahead of demand.
+constexpr size_t kDefaultMaxPooledConnectionsPerPeer = 4;
+constexpr uint64_t kDefaultPoolPrewarmStreamThreshold = 10;
+
+// Size of the buffer needed to receive a GRO coalesced datagram.
+constexpr uint32_t kMaxGROBufferSize = 65535;
+
 // rfc6298:
 constexpr int kRttAlpha = 8;
 constexpr int kRttBeta = 4;
@@ -222,8 +324,20 @@ constexpr std::chrono::microseconds kGranularity = 10000us;
 
 constexpr uint32_t kReorderingThreshold = 3;
 
+// RACK reordering window, in multiples of a quarter of the min rtt, raised at
+// most once per srtt by spurious losses, and reset after
+// kRackReorderingWindowPersistence loss events without one.
+constexpr uint32_t kRackReorderingWindowDivisor = 4;
+constexpr uint32_t kRackReorderingWindowPersistence = 16;
+// Number of lost packets remembered to detect spurious losses.
+constexpr size_t kMaxRecentLostPackets = 128;
+
 constexpr auto kPacketToSendForPTO = 2;
 
+// Number of recently sent packets the CloningScheduler looks at first for a
+// packet to clone.
+constexpr size_t kMaxCloneCandidates = 16;
+
 // Maximum number of packets to write per writeConnectionDataToSocket call.
 constexpr uint64_t kDefaultWriteConnectionDataPacketLimit = 5;
 // Minimum number of packets to write per burst in pacing
@@ -234,11 +348,55 @@ constexpr uint64_t kDefaultMinBurstPackets = 5;
 // this is subject to testing but I would suggest a value >= 200usec
 constexpr std::chrono::microseconds kDefaultPacingTimerTickInterval{1000};
 
+// Number of ticks of the pacing timer covered by one lap of a worker's pacing
+// scheduler. Writes paced further out take more than one lap.
+constexpr size_t kDefaultPacingSchedulerSlots = 1024;
+
+// The send rate limit of a stream lets it burst the bytes of this long at its
+// rate, and at least a packet.
+constexpr std::chrono::microseconds kStreamSendRateBurstInterval{10000};
+
+// A stream buffer reclaimed under memory pressure is copied when the memory
+// it holds on to is more than this many times its data.
+constexpr uint64_t kStreamBufferCompactionFactor = 2;
+
+// How often a worker under memory pressure reclaims the stream buffers of its
+// connections.
+constexpr std::chrono::milliseconds kBufferMemoryReclaimInterval{1000};
+
+// Time a worker's write scheduler can spend on write loops in one iteration
+// of the event loop before leaving the rest to the next one.
+constexpr std::chrono::microseconds kDefaultWriteSchedulerTimeBudget{2000};
+
 // Congestion control:
 constexpr std::chrono::microseconds::rep kPersistentCongestionThreshold = 3;
-enum class CongestionControlType : uint8_t { Cubic, NewReno, Copa, BBR, None };
+enum class CongestionControlType : uint8_t {
+  Cubic,
+  NewReno,
+  Copa,
+  BBR,
+  BBR2,
+  None
+};
 folly::StringPiece congestionControlTypeToString(CongestionControlType type);
 
+// How the writes of a connection are spread over its paths when
+// TransportSettings::multipathEnabled is set.
+enum class PathSchedulerType : uint8_t {
+  // The path with the lowest smoothed rtt that has cwnd left goes first.
+  MinRtt,
+  // Every path gets a share of the packets in proportion to its weight.
+  Weighted,
+};
+
+// The ECN codepoint in the low two bits of the IP TOS or traffic class byte.
+enum class ECNCodepoint : uint8_t {
+  NotECT = 0x00,
+  ECT1 = 0x01,
+  ECT0 = 0x02,
+  CE = 0x03,
+};
+
 // This is an approximation of a small enough number for cwnd to be blocked.
 constexpr size_t kBlockedSizeBytes = 20;
 
@@ -269,6 +427,20 @@ constexpr std::chrono::microseconds kDelayIncreaseUpperBound(8);
 // Hystart's lower bound for DelayIncrease
 constexpr std::chrono::microseconds kDelayIncreaseLowerBound(2);
 
+/* HyStart++: */
+// Number of RTT samples taken at the start of every RTT round
+constexpr uint8_t kHystartPlusPlusRttSamples = 8;
+// Bounds of the RTT increase over the previous round that ends slow start
+constexpr std::chrono::microseconds kHystartPlusPlusMinRttThresh(4000);
+constexpr std::chrono::microseconds kHystartPlusPlusMaxRttThresh(16000);
+// The RTT increase threshold is the previous round's RTT divided by this, then
+// bounded by the two values above
+constexpr uint8_t kHystartPlusPlusRttThreshDivisor = 8;
+// Conservative slow start grows cwnd by acked bytes divided by this
+constexpr uint8_t kHystartPlusPlusCssGrowthDivisor = 4;
+// Number of RTT rounds in conservative slow start before exiting slow start
+constexpr uint8_t kHystartPlusPlusCssRounds = 5;
+
 /* Cubic */
 // Default cwnd reduction factor:
 constexpr double kDefaultCubicReductionFactor = 0.8;
@@ -280,16 +452,31 @@ constexpr uint8_t kDefaultEmulatedConnection = 2;
 // previous W_max:
 constexpr float kDefaultLastMaxReductionFactor = 0.85f;
 
+/* Congestion window validation (RFC 7661) */
+// The acked flight is the largest one of this many last round trips.
+constexpr size_t kPipeAckSampleRounds = 3;
+// How long cwnd can stay unvalidated before it is halved.
+constexpr std::chrono::seconds kCwndNonValidatedPeriod(300);
+
 /* Flow Control */
 // Default flow control window for HTTP/2 + 1K for headers
 constexpr uint64_t kDefaultStreamWindowSize = (64 + 1) * 1024;
 constexpr uint64_t kDefaultConnectionWindowSize = 1024 * 1024;
+// With window auto tuning, the connection window is kept at least this many
+// times the largest stream window.
+constexpr double kConnectionToStreamWindowRatio = 1.5;
 
 /* Stream Limits */
 constexpr uint64_t kDefaultMaxStreamsBidirectional = 2048;
 constexpr uint64_t kDefaultMaxStreamsUnidirectional = 2048;
 constexpr uint64_t kMaxStreamId = 1ull << 62;
 constexpr uint64_t kMaxMaxStreams = 1ull << 60;
+// With stream limit auto scaling, the most streams, open or not yet opened,
+// the peer is allowed to have at once.
+constexpr uint64_t kDefaultMaxAutoScaledStreamLimit = 16 * 1024;
+// With stream limit auto scaling, the peer is granted this many RTTs worth
+// of streams on top of the ones it has open.
+constexpr uint64_t kStreamLimitAutoScaleRtts = 2;
 
 /* Idle timeout parameters */
 // Default idle timeout to advertise.
@@ -317,9 +504,45 @@ constexpr uint8_t kRxPacketsPendingBeforeAckThresh = 10;
 constexpr double kAckTimerFactor = 0.25;
 // max ack timeout: 25ms
 constexpr std::chrono::microseconds kMaxAckTimeout = 25000us;
+// The max_ack_delay advertised with adaptiveAcks, kMaxAckTimeout by default.
+constexpr std::chrono::milliseconds kDefaultMaxAckDelay{25};
+// A max_ack_delay transport parameter of this many milliseconds or more is
+// invalid.
+constexpr uint64_t kMaxMaxAckDelay = 1 << 14;
+// With adaptiveAcks, the retransmittable packets received before an ack grow
+// by one every this many packets received in order, up to the max.
+constexpr uint64_t kRxPacketsPerAckThreshIncrease = 10;
+constexpr uint8_t kMaxRxPacketsPendingBeforeAckThresh = 40;
 
 constexpr uint64_t kAckPurgingThresh = 10;
 
+// Number of packet numbers under the largest received one that the duplicate
+// detection remembers, a multiple of 64.
+constexpr size_t kReceivedPacketWindowSize = 1024;
+
+// Default max number of ack blocks in an ack frame, the largest one included.
+constexpr uint64_t kDefaultMaxAckBlocks = 64;
+
+/* Ack frequency */
+
+// Default min_ack_delay advertised when ack frequency is enabled.
+constexpr std::chrono::microseconds kDefaultMinAckDelay = 1000us;
+// The peer is asked for this many acks per congestion window, and per rtt.
+constexpr uint64_t kAckFrequencyAcksPerCwnd = 4;
+constexpr uint64_t kAckFrequencyAcksPerRtt = 4;
+// Bounds of the packet tolerance of an ACK_FREQUENCY frame. The lower bound
+// is the ack every other packet of the spec.
+constexpr uint64_t kMinAckFrequencyPacketTolerance = 2;
+constexpr uint64_t kMaxAckFrequencyPacketTolerance = 255;
+
+/* Datagrams */
+
+// Default number of datagrams kept for the app to read, and waiting to be
+// written. The oldest one is dropped when a new one doesn't fit.
+constexpr size_t kDefaultMaxDatagramsBuffered = 16;
+// The frame type and a 2 bytes length, enough for any datagram in a packet.
+constexpr uint16_t kMaxDatagramFrameHeaderSize = 3;
+
 // Default number of packets to buffer if keys are not present.
 constexpr uint32_t kDefaultMaxBufferedPackets = 20;
 
@@ -355,6 +578,50 @@ constexpr std::chrono::milliseconds kHappyEyeballsV4Delay = 100ms;
 constexpr std::chrono::milliseconds kHappyEyeballsConnAttemptDelayWithCache =
     15s;
 
+// Bounds of the connection attempt delay that a HappyEyeballsCache derives
+// from the handshake rtts of an address family, from RFC 8305.
+constexpr std::chrono::milliseconds kHappyEyeballsMinConnAttemptDelay = 10ms;
+constexpr std::chrono::milliseconds kHappyEyeballsMaxConnAttemptDelay = 2s;
+
+// Number of races in a row that an address family must lose for a
+// HappyEyeballsCache to stop trying it, and for how long after its last loss.
+constexpr uint32_t kHappyEyeballsBrokenFamilyLosses = 3;
+constexpr std::chrono::minutes kHappyEyeballsBrokenFamilyExpiry = 10min;
+
+// Number of client subnets a PathEstimateCache remembers, and for how long.
+constexpr size_t kDefaultPathEstimateCacheSize = 10000;
+constexpr std::chrono::minutes kDefaultPathEstimateLifetime = 10min;
+// Prefix lengths of the client subnets that share a PathEstimateCache entry.
+constexpr uint8_t kPathEstimateV4PrefixLength = 24;
+constexpr uint8_t kPathEstimateV6PrefixLength = 48;
+// Fraction of the cached bandwidth delay product that a new connection starts
+// with, and the largest initial cwnd the cache can give.
+constexpr double kPathEstimateCwndGain = 0.5;
+constexpr uint64_t kPathEstimateMaxInitCwndInMss = 100;
+
+// Number of client connection ids whose Initial keys an InitialCipherCache
+// remembers.
+constexpr size_t kDefaultInitialCipherCacheSize = 1024;
+
+// The zlib level the certificate compressors of makeCertificateCompressors()
+// use. A certificate is compressed once per handshake it is sent in.
+constexpr int kDefaultCertificateCompressionLevel = 6;
+
+// Number of distinct Certificate messages a CertificateMessageCache keeps.
+constexpr size_t kDefaultCertificateMessageCacheSize = 8;
+
+// Fraction of the new ClientHellos a BloomFilterReplayCache takes for
+// replays, which only costs them their early data.
+constexpr double kDefaultReplayCacheFalsePositiveRate = 0.001;
+
+// How long the tickets of a TicketKeyManager are good for. The key that
+// encrypted a ticket is kept for that long after the next one replaces it.
+constexpr std::chrono::seconds kDefaultTicketLifetime = std::chrono::hours(1);
+
+// Most connection ids a ConnectionIdPool encodes in one loop iteration while
+// refilling.
+constexpr size_t kConnectionIdPoolRefillBatch = 8;
+
 constexpr size_t kMaxNumTokenSourceAddresses = 3;
 
 // Amount of time to retain initial keys until they are dropped after handshake
@@ -369,10 +636,59 @@ constexpr std::chrono::seconds kTimeToRetainLastCongestionAndRttState = 60s;
 
 constexpr uint32_t kMaxNumMigrationsAllowed = 6;
 
+// Alternate peer addresses a server keeps state for, see
+// TransportSettings::enableStandbyPaths.
+constexpr size_t kMaxNumStandbyPaths = 4;
+
 constexpr auto kExpectedNumOfParamsInTheTicket = 8;
 
+// When TransportSettings::congestionStateInTicket is set, the server writes
+// another session ticket this long after the first one, with congestion
+// estimates that have had time to converge.
+constexpr std::chrono::seconds kCongestionStateTicketDelay = 2s;
+// Congestion state in a session ticket older than this is ignored.
+constexpr std::chrono::minutes kTicketCongestionStateLifetime = 30min;
+
 constexpr auto kStatelessResetTokenSecretLength = 32;
 
+constexpr auto kRetryTokenSecretLength = 32;
+
+// Length of the authentication tag at the end of a Retry token.
+constexpr auto kRetryTokenTagLength = 16;
+
+// How long a client has to come back with the token of a Retry. Long enough
+// for a slow client's round trip, short enough that a token can't be replayed
+// for long.
+constexpr std::chrono::seconds kDefaultRetryTokenLifetime = 10s;
+
+// How long a client can come back with the token of a NEW_TOKEN frame and
+// skip the address validation.
+constexpr std::chrono::seconds kDefaultNewTokenLifetime = 24h;
+
+// The buckets of the new connection rate limit of a worker, the client
+// address prefixes share them by hash so that its memory stays fixed.
+constexpr size_t kSourceRateLimiterNumBuckets = 4096;
+
+// The source address map of a worker only holds the connections still in
+// their handshake. After a burst of them, it is rebuilt to its size once its
+// capacity is this many times more than it needs, and above the minimum.
+constexpr size_t kSourceAddressMapShrinkFactor = 8;
+constexpr size_t kSourceAddressMapMinCapacity = 64;
+
+// How often a worker that sheds load samples the lag of its event loop.
+constexpr std::chrono::milliseconds kDefaultLoadSheddingSampleInterval = 10ms;
+
+// Connections a worker summarizes per loop of its EventBase when it is
+// introspected, and how many of the summaries it keeps.
+constexpr size_t kDefaultIntrospectionBatchSize = 64;
+constexpr size_t kDefaultIntrospectionMaxSampledConnections = 32;
+
+// How long the packets of a client that still uses its own connection id
+// follow the worker NewConnectionBalancer moved its connection to, about a
+// handshake, and how many of those decisions a worker keeps.
+constexpr std::chrono::seconds kNewConnectionRedirectLifetime = 10s;
+constexpr size_t kMaxNewConnectionRedirects = 4096;
+
 constexpr uint64_t kMinNumAvailableConnIds = 8;
 
 // default capability of QUIC partial reliability
@@ -423,6 +739,7 @@ enum class WriteDataReason {
   SIMPLE,
   RESET,
   PATHCHALLENGE,
+  DATAGRAM,
 };
 
 enum class NoWriteReason {
@@ -452,4 +769,38 @@ enum class EncryptionLevel : uint8_t {
   AppData,
 };
 
+using PriorityLevel = uint8_t;
+
+// Stream priority, in the terms of the HTTP/3 priority scheme. Streams with a
+// lower urgency level are served first. Within a level, non-incremental
+// streams are served one after the other in stream id order, while
+// incremental streams share the bandwidth in a round robin fashion.
+struct Priority {
+  PriorityLevel level;
+  bool incremental;
+
+  constexpr Priority(PriorityLevel levelIn, bool incrementalIn)
+      : level(levelIn), incremental(incrementalIn) {}
+
+  bool operator==(const Priority& other) const {
+    return level == other.level && incremental == other.incremental;
+  }
+
+  bool operator!=(const Priority& other) const {
+    return !(*this == other);
+  }
+
+  // Orders the priorities in the order the streams are scheduled in.
+  bool operator<(const Priority& other) const {
+    return level < other.level ||
+        (level == other.level && incremental < other.incremental);
+  }
+};
+
+constexpr PriorityLevel kDefaultMaxPriority = 7;
+
+// Streams round robin by default, which is how all the streams were scheduled
+// before priorities existed.
+constexpr Priority kDefaultPriority{3, true};
+
 } // namespace quic
@@ -9,6 +9,7 @@
 #include <quic/api/IoBufQuicBatch.h>
 
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
+#include <quic/state/QuicCpuCostSampler.h>
 
 namespace quic {
 IOBufQuicBatch::IOBufQuicBatch(
@@ -28,6 +29,12 @@ bool IOBufQuicBatch::write(
     size_t encodedSize) {
   pktSent_++;
 
+  // Nothing goes ahead of the packets waiting for the socket.
+  if (conn_.sendBlocked) {
+    conn_.sendBlocked->datagrams.push_back(std::move(buf));
+    return false;
+  }
+
   // see if we need to flush the prev buffer(s)
   if (batchWriter_->needsFlush(encodedSize)) {
     // continue even if we get an error here
@@ -35,6 +42,7 @@ bool IOBufQuicBatch::write(
   }
 
   // try to append the new buffers
+  ++pktsInBatch_;
   if (batchWriter_->append(std::move(buf), encodedSize)) {
     // return if we get an error here
     return flush();
@@ -56,7 +64,11 @@ void IOBufQuicBatch::setContinueOnNetworkUnreachable(
 }
 
 void IOBufQuicBatch::reset() {
-  batchWriter_->reset();
+  // Gone with the blocked batch.
+  if (batchWriter_) {
+    batchWriter_->reset();
+  }
+  pktsInBatch_ = 0;
 }
 
 bool IOBufQuicBatch::isNetworkUnreachable(int err) {
@@ -68,6 +80,11 @@ bool IOBufQuicBatch::isRetriableError(int err) {
       err == EMSGSIZE) {
     return true;
   }
+  // A connected socket reports the ICMP errors of earlier datagrams on the
+  // next send, where an unconnected one drops them. Treat them as losses.
+  if (err == ECONNREFUSED) {
+    return true;
+  }
   auto now = Clock::now();
   if (continueOnNetworkUnreachable_ && isNetworkUnreachable(err)) {
     if (!conn_.continueOnNetworkUnreachableDeadline) {
@@ -79,14 +96,37 @@ bool IOBufQuicBatch::isRetriableError(int err) {
   return false;
 }
 
+bool IOBufQuicBatch::isSendBlocked(int err) const {
+  // With two sockets the other one may still have room.
+  return conn_.transportSettings.sendBlockedBackpressure &&
+      (err == EAGAIN || err == EWOULDBLOCK) &&
+      !happyEyeballsState_.shouldWriteToSecondSocket &&
+      !(happyEyeballsState_.connAttemptDelayTimeout &&
+        happyEyeballsState_.connAttemptDelayTimeout->isScheduled());
+}
+
 bool IOBufQuicBatch::flushInternal() {
-  if (batchWriter_->empty()) {
+  if (!batchWriter_ || batchWriter_->empty()) {
     return true;
   }
+  QuicCpuCostSampler cpuCostSampler(
+      conn_, QuicTransportStatsCallback::CpuCostType::SOCKET_WRITE);
 
   bool written = false;
   if (happyEyeballsState_.shouldWriteToFirstSocket) {
     auto consumed = batchWriter_->write(sock_, peerAddress_);
+    if (consumed < 0 && isSendBlocked(errno)) {
+      VLOG(4) << "Socket send buffer full, waiting for it to be writable "
+              << peerAddress_;
+      conn_.sendBlocked.emplace();
+      conn_.sendBlocked->retryBatch =
+          [writer = std::move(batchWriter_)](
+              folly::AsyncUDPSocket& sock,
+              const folly::SocketAddress& address) mutable {
+            return writer->write(sock, address);
+          };
+      return false;
+    }
     written = (consumed >= 0);
     happyEyeballsState_.shouldWriteToFirstSocket =
         (consumed >= 0 || isRetriableError(errno));
@@ -120,7 +160,7 @@ bool IOBufQuicBatch::flushInternal() {
     }
   }
 
-  // TODO: handle ENOBUFS and backpressure the socket.
+  // TODO: backpressure the socket on ENOBUFS too.
   if (!happyEyeballsState_.shouldWriteToFirstSocket &&
       !happyEyeballsState_.shouldWriteToSecondSocket) {
     // Both sockets becomes fatal, close connection
@@ -138,15 +178,21 @@ bool IOBufQuicBatch::flushInternal() {
   }
 
   if (!written) {
-    // This can happen normally, so ignore for now. Now we treat EAGAIN same
-    // as a loss to avoid looping.
-    // TODO: Remove once we use write event from libevent.
+    // This can happen normally, so ignore for now. Without
+    // sendBlockedBackpressure we treat EAGAIN same as a loss to avoid
+    // looping.
     return false; // done
   }
 
   // Reset the deadline after successful write
   conn_.continueOnNetworkUnreachableDeadline = folly::none;
 
+  if (conn_.currentWriteLoop) {
+    ++conn_.currentWriteLoop->socketWrites;
+    conn_.currentWriteLoop->socketWritePackets += pktsInBatch_;
+    conn_.currentWriteLoop->bytesWritten += batchWriter_->size();
+  }
+
   return true; // success, not done yet
 }
 } // namespace quic
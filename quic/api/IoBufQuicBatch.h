@@ -47,12 +47,20 @@ class IOBufQuicBatch {
    */
   bool isRetriableError(int err);
 
+  /**
+   * Whether the write failed because the send buffer of the socket is full
+   * and the batch should wait for the socket to be writable.
+   */
+  bool isSendBlocked(int err) const;
+
   std::unique_ptr<BatchWriter> batchWriter_;
   folly::AsyncUDPSocket& sock_;
   folly::SocketAddress& peerAddress_;
   QuicConnectionStateBase& conn_;
   QuicConnectionStateBase::HappyEyeballsState& happyEyeballsState_;
   uint64_t pktSent_{0};
+  // The packets appended to the batch since it was last flushed.
+  uint64_t pktsInBatch_{0};
   bool continueOnNetworkUnreachable_{false};
 };
 
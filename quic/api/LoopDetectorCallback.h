@@ -12,6 +12,8 @@
 
 namespace quic {
 
+struct WriteLoopMetrics;
+
 class LoopDetectorCallback {
  public:
   virtual ~LoopDetectorCallback() = default;
@@ -20,6 +22,22 @@ class LoopDetectorCallback {
       WriteDataReason writeReason,
       NoWriteReason noWriteReason,
       const std::string& scheduler) = 0;
+
+  /**
+   * The write loop of the connection used up what was left of the budget of
+   * the worker's write scheduler in a loop iteration, so numDeferred other
+   * connections wait for the next one.
+   */
+  virtual void onWriteBudgetExhausted(
+      std::chrono::microseconds /* timeSpent */,
+      uint64_t /* packetsWritten */,
+      size_t /* numDeferred */) {}
+
+  /**
+   * Every write loop of the connection, with
+   * TransportSettings::writeLoopStats.
+   */
+  virtual void onWriteLoop(const WriteLoopMetrics& /* metrics */) {}
 };
 
 } // namespace quic
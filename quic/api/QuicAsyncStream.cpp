@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicAsyncStream.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+QuicAsyncStream::QuicAsyncStream(QuicSocket& sock, StreamId id)
+    : sock_(sock), id_(id) {
+  sock_.setReadCallback(id_, this);
+  sock_.pauseRead(id_);
+}
+
+QuicAsyncStream::~QuicAsyncStream() {
+  // The transport can't unregister a write callback, the pending writeReady
+  // has to complete first.
+  DCHECK(!writeReadyCont_);
+  readCont_ = nullptr;
+  sock_.setReadCallback(id_, nullptr);
+  if (deliveryCont_) {
+    deliveryCont_ = nullptr;
+    sock_.cancelDeliveryCallbacksForStream(id_);
+  }
+}
+
+void QuicAsyncStream::read(
+    size_t maxLen,
+    folly::Function<void(ReadResult)> cont) {
+  if (readCont_) {
+    cont(folly::makeUnexpected(
+        QuicErrorCode(LocalErrorCode::CALLBACK_ALREADY_INSTALLED)));
+    return;
+  }
+  readMaxLen_ = maxLen;
+  readCont_ = std::move(cont);
+  if (!tryRead()) {
+    sock_.resumeRead(id_);
+  }
+}
+
+bool QuicAsyncStream::tryRead() {
+  auto result = sock_.read(id_, readMaxLen_);
+  if (result.hasValue() && !result->first && !result->second) {
+    return false;
+  }
+  // Moved out first so that the continuation can start the next read.
+  auto cont = std::move(readCont_);
+  readCont_ = nullptr;
+  sock_.pauseRead(id_);
+  if (result.hasError()) {
+    cont(folly::makeUnexpected(QuicErrorCode(result.error())));
+  } else {
+    cont(std::move(result.value()));
+  }
+  return true;
+}
+
+void QuicAsyncStream::readAvailable(StreamId /* id */) noexcept {
+  if (readCont_) {
+    tryRead();
+  }
+}
+
+void QuicAsyncStream::readError(
+    StreamId /* id */,
+    std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+        error) noexcept {
+  if (!readCont_) {
+    return;
+  }
+  auto cont = std::move(readCont_);
+  readCont_ = nullptr;
+  cont(folly::makeUnexpected(std::move(error.first)));
+}
+
+void QuicAsyncStream::writeReady(
+    folly::Function<void(WriteReadyResult)> cont) {
+  if (writeReadyCont_) {
+    cont(folly::makeUnexpected(
+        QuicErrorCode(LocalErrorCode::CALLBACK_ALREADY_INSTALLED)));
+    return;
+  }
+  auto result = sock_.notifyPendingWriteOnStream(id_, this);
+  if (result.hasError()) {
+    cont(folly::makeUnexpected(QuicErrorCode(result.error())));
+    return;
+  }
+  writeReadyCont_ = std::move(cont);
+}
+
+void QuicAsyncStream::onStreamWriteReady(
+    StreamId /* id */,
+    uint64_t maxToSend) noexcept {
+  auto cont = std::move(writeReadyCont_);
+  writeReadyCont_ = nullptr;
+  if (cont) {
+    cont(maxToSend);
+  }
+}
+
+void QuicAsyncStream::onStreamWriteError(
+    StreamId /* id */,
+    std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+        error) noexcept {
+  auto cont = std::move(writeReadyCont_);
+  writeReadyCont_ = nullptr;
+  if (cont) {
+    cont(folly::makeUnexpected(std::move(error.first)));
+  }
+}
+
+void QuicAsyncStream::delivery(
+    uint64_t offset,
+    folly::Function<void(DeliveryResult)> cont) {
+  if (deliveryCont_) {
+    cont(folly::makeUnexpected(
+        QuicErrorCode(LocalErrorCode::CALLBACK_ALREADY_INSTALLED)));
+    return;
+  }
+  auto result = sock_.registerDeliveryCallback(id_, offset, this);
+  if (result.hasError()) {
+    cont(folly::makeUnexpected(QuicErrorCode(result.error())));
+    return;
+  }
+  deliveryCont_ = std::move(cont);
+}
+
+void QuicAsyncStream::onDeliveryAck(
+    StreamId /* id */,
+    uint64_t /* offset */,
+    std::chrono::microseconds rtt) {
+  auto cont = std::move(deliveryCont_);
+  deliveryCont_ = nullptr;
+  if (cont) {
+    cont(rtt);
+  }
+}
+
+void QuicAsyncStream::onCanceled(StreamId /* id */, uint64_t /* offset */) {
+  auto cont = std::move(deliveryCont_);
+  deliveryCont_ = nullptr;
+  if (cont) {
+    cont(folly::makeUnexpected(QuicErrorCode(LocalErrorCode::STREAM_CLOSED)));
+  }
+}
+} // namespace quic
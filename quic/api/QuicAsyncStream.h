@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Expected.h>
+#include <folly/Function.h>
+#include <quic/api/QuicSocket.h>
+
+#include <chrono>
+
+namespace quic {
+
+/**
+ * The reads, write readiness and delivery acks of one stream as operations
+ * that complete with a continuation, instead of the callbacks of QuicSocket
+ * the application would otherwise implement and dispatch per stream:
+ *
+ *   stream.read(kMaxRead, [&](QuicAsyncStream::ReadResult result) {
+ *     ...
+ *   });
+ *
+ * The object is the stream's read, write and delivery callback for its whole
+ * life, and each kind of operation has a single slot holding the pending
+ * continuation, so no operation allocates apart from folly::Function, which
+ * stores small captures inline. A continuation can start the next operation
+ * of its kind. An operation that can complete right away runs its
+ * continuation before returning, like the ready check of an awaiter, and one
+ * started while another of its kind is pending fails with
+ * CALLBACK_ALREADY_INSTALLED.
+ *
+ * The stream's reads are paused while no read is pending, so that data is
+ * left in the receive buffer and flow controlled until the application asks
+ * for it. All the methods must be called from the socket's EventBase, and
+ * the object must be destroyed before the socket.
+ */
+class QuicAsyncStream : private QuicSocket::ReadCallback,
+                        private QuicSocket::WriteCallback,
+                        private QuicSocket::DeliveryCallback {
+ public:
+  using ReadResult = folly::Expected<std::pair<Buf, bool>, QuicErrorCode>;
+  // The bytes the stream can be written without being buffered past the
+  // flow control, see WriteCallback::onStreamWriteReady.
+  using WriteReadyResult = folly::Expected<uint64_t, QuicErrorCode>;
+  // The rtt of the connection when the offset was acked.
+  using DeliveryResult =
+      folly::Expected<std::chrono::microseconds, QuicErrorCode>;
+
+  QuicAsyncStream(QuicSocket& sock, StreamId id);
+
+  ~QuicAsyncStream() override;
+
+  StreamId getStreamId() const {
+    return id_;
+  }
+
+  /**
+   * Reads up to maxLen bytes once there is data or eof on the stream, see
+   * QuicSocket::read().
+   */
+  void read(size_t maxLen, folly::Function<void(ReadResult)> cont);
+
+  /**
+   * Waits until the stream can be written, see notifyPendingWriteOnStream.
+   */
+  void writeReady(folly::Function<void(WriteReadyResult)> cont);
+
+  /**
+   * Waits until the peer has acked the stream up to the offset, see
+   * registerDeliveryCallback. Fails with STREAM_CLOSED if the offset is
+   * never delivered.
+   */
+  void delivery(uint64_t offset, folly::Function<void(DeliveryResult)> cont);
+
+  bool readPending() const {
+    return bool(readCont_);
+  }
+
+  bool writeReadyPending() const {
+    return bool(writeReadyCont_);
+  }
+
+  bool deliveryPending() const {
+    return bool(deliveryCont_);
+  }
+
+ private:
+  // Reads into the pending read and completes it, if there is data, eof or
+  // an error on the stream.
+  bool tryRead();
+
+  void readAvailable(StreamId id) noexcept override;
+
+  void readError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override;
+
+  void onStreamWriteReady(StreamId id, uint64_t maxToSend) noexcept override;
+
+  void onStreamWriteError(
+      StreamId id,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override;
+
+  void onDeliveryAck(
+      StreamId id,
+      uint64_t offset,
+      std::chrono::microseconds rtt) override;
+
+  void onCanceled(StreamId id, uint64_t offset) override;
+
+  QuicSocket& sock_;
+  StreamId id_;
+  size_t readMaxLen_{0};
+  folly::Function<void(ReadResult)> readCont_;
+  folly::Function<void(WriteReadyResult)> writeReadyCont_;
+  folly::Function<void(DeliveryResult)> deliveryCont_;
+};
+} // namespace quic
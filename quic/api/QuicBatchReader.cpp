@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicBatchReader.h>
+
+#include <folly/net/NetOps.h>
+
+#if defined(__linux__) && !defined(UDP_GRO)
+#define UDP_GRO 104
+#endif
+
+namespace quic {
+
+namespace {
+constexpr size_t kGROControlSize = CMSG_SPACE(sizeof(int));
+// IP_TOS (1 byte) or IPV6_TCLASS (an int).
+constexpr size_t kTOSControlSize = CMSG_SPACE(sizeof(int));
+constexpr size_t kTimestampControlSize = CMSG_SPACE(sizeof(struct timespec));
+
+// Returns the GRO segment size of the datagram, 0 if it wasn't coalesced, its
+// ECN codepoint in ecn and its SO_TIMESTAMPNS time, since the epoch of the
+// realtime clock, in timestamp.
+int parseControlMessages(
+    const struct msghdr& msg,
+    ECNCodepoint& ecn,
+    folly::Optional<std::chrono::nanoseconds>& timestamp) {
+  int segmentSize = 0;
+  ecn = ECNCodepoint::NotECT;
+  timestamp = folly::none;
+  if (msg.msg_controllen == 0) {
+    return segmentSize;
+  }
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg)) {
+#ifdef UDP_GRO
+    if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+      memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+      continue;
+    }
+#endif
+#ifdef SCM_TIMESTAMPNS
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      struct timespec ts;
+      memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      timestamp = std::chrono::seconds(ts.tv_sec) +
+          std::chrono::nanoseconds(ts.tv_nsec);
+      continue;
+    }
+#endif
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS) {
+      uint8_t tos;
+      memcpy(&tos, CMSG_DATA(cmsg), sizeof(tos));
+      ecn = static_cast<ECNCodepoint>(tos & 0x03);
+    } else if (
+        cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS) {
+      int tclass;
+      memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+      ecn = static_cast<ECNCodepoint>(tclass & 0x03);
+    }
+  }
+  return segmentSize;
+}
+
+// Converts the realtime clock timestamps of the kernel to the steady clock,
+// against two readings of the clocks taken right after the read. A timestamp
+// past the readings is taken as the time of the read.
+class TimestampConverter {
+ public:
+  explicit TimestampConverter(bool enabled) {
+    if (enabled) {
+      steadyNow_ = Clock::now();
+      realtimeNow_ = std::chrono::system_clock::now().time_since_epoch();
+    }
+  }
+
+  folly::Optional<TimePoint> toReceiveTime(
+      const folly::Optional<std::chrono::nanoseconds>& timestamp) const {
+    if (!timestamp) {
+      return folly::none;
+    }
+    return steadyNow_ -
+        std::max(realtimeNow_ - *timestamp, std::chrono::nanoseconds::zero());
+  }
+
+ private:
+  TimePoint steadyNow_;
+  std::chrono::nanoseconds realtimeNow_{0};
+};
+} // namespace
+
+RecvmmsgBatchReader::RecvmmsgBatchReader(
+    size_t maxPackets,
+    size_t packetSize,
+    bool groEnabled,
+    bool ecnEnabled,
+    bool timestampsEnabled)
+    : maxPackets_(std::max<size_t>(maxPackets, 1)),
+      // Every buffer has to be able to hold a whole coalesced datagram when
+      // GRO is on.
+      packetSize_(groEnabled ? kMaxGROBufferSize : packetSize),
+      groEnabled_(groEnabled),
+      ecnEnabled_(ecnEnabled),
+      timestampsEnabled_(timestampsEnabled),
+      iovecs_(maxPackets_),
+      addrs_(maxPackets_)
+#ifdef FOLLY_HAVE_RECVMMSG
+      ,
+      msgs_(maxPackets_)
+#endif
+{
+  packets_.reserve(maxPackets_);
+  controlSize_ = (groEnabled_ ? kGROControlSize : 0) +
+      (ecnEnabled_ ? kTOSControlSize : 0) +
+      (timestampsEnabled_ ? kTimestampControlSize : 0);
+  control_.resize(maxPackets_ * controlSize_);
+}
+
+bool RecvmmsgBatchReader::enableGRO(folly::NetworkSocket sock) {
+#ifdef UDP_GRO
+  int val = 1;
+  return folly::netops::setsockopt(
+             sock, IPPROTO_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+#else
+  (void)sock;
+  return false;
+#endif
+}
+
+bool RecvmmsgBatchReader::enableECN(
+    folly::NetworkSocket sock,
+    sa_family_t family) {
+#if defined(IP_RECVTOS) && defined(IPV6_RECVTCLASS)
+  int tos = static_cast<int>(ECNCodepoint::ECT0);
+  int on = 1;
+  if (family == AF_INET6) {
+    return folly::netops::setsockopt(
+               sock, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos)) == 0 &&
+        folly::netops::setsockopt(
+            sock, IPPROTO_IPV6, IPV6_RECVTCLASS, &on, sizeof(on)) == 0;
+  }
+  return folly::netops::setsockopt(
+             sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) == 0 &&
+      folly::netops::setsockopt(
+          sock, IPPROTO_IP, IP_RECVTOS, &on, sizeof(on)) == 0;
+#else
+  (void)sock;
+  (void)family;
+  return false;
+#endif
+}
+
+bool RecvmmsgBatchReader::enableTimestamps(folly::NetworkSocket sock) {
+#ifdef SO_TIMESTAMPNS
+  int on = 1;
+  return folly::netops::setsockopt(
+             sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0;
+#else
+  (void)sock;
+  return false;
+#endif
+}
+
+void RecvmmsgBatchReader::maybeAllocateSlab() {
+  // If every packet from the previous batch has been released we can reuse
+  // the same memory, otherwise someone is still holding on to part of it.
+  if (slab_ && !slab_->isSharedOne()) {
+    return;
+  }
+  slab_ = folly::IOBuf::create(maxPackets_ * packetSize_);
+  slab_->append(maxPackets_ * packetSize_);
+  for (size_t i = 0; i < maxPackets_; ++i) {
+    iovecs_[i].iov_base = slab_->writableData() + i * packetSize_;
+    iovecs_[i].iov_len = packetSize_;
+  }
+}
+
+void RecvmmsgBatchReader::onDatagram(
+    size_t index,
+    size_t len,
+    int flags,
+    socklen_t addrLen,
+    int segmentSize,
+    ECNCodepoint ecn,
+    folly::Optional<TimePoint> receiveTime) {
+  folly::SocketAddress peer;
+  peer.setFromSockaddr(
+      reinterpret_cast<struct sockaddr*>(&addrs_[index]), addrLen);
+  bool truncated = (flags & MSG_TRUNC) || len > packetSize_;
+  len = std::min<size_t>(len, packetSize_);
+  size_t offset = index * packetSize_;
+  size_t end = offset + len;
+  size_t step = segmentSize > 0 ? static_cast<size_t>(segmentSize) : len;
+  do {
+    ReceivedPacket packet;
+    packet.peer = peer;
+    packet.truncated = truncated;
+    packet.ecn = ecn;
+    packet.receiveTime = receiveTime;
+    packet.data = slab_->cloneOne();
+    packet.data->trimStart(offset);
+    packet.data->trimEnd(
+        packet.data->length() - std::min<size_t>(step, end - offset));
+    offset += packet.data->length();
+    packets_.push_back(std::move(packet));
+  } while (offset < end && step > 0);
+}
+
+ssize_t RecvmmsgBatchReader::readBatch(folly::NetworkSocket sock) {
+  packets_.clear();
+  maybeAllocateSlab();
+  auto initMsg = [&](struct msghdr& msg, size_t i) {
+    msg = {};
+    msg.msg_name = &addrs_[i];
+    msg.msg_namelen = sizeof(addrs_[i]);
+    msg.msg_iov = &iovecs_[i];
+    msg.msg_iovlen = 1;
+    if (controlSize_ > 0) {
+      msg.msg_control = control_.data() + i * controlSize_;
+      msg.msg_controllen = controlSize_;
+    }
+  };
+
+#ifdef FOLLY_HAVE_RECVMMSG
+  for (size_t i = 0; i < maxPackets_; ++i) {
+    initMsg(msgs_[i].msg_hdr, i);
+    msgs_[i].msg_len = 0;
+  }
+  int ret = ::recvmmsg(
+      sock.toFd(), msgs_.data(), maxPackets_, MSG_DONTWAIT, nullptr);
+  if (ret < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+  }
+  TimestampConverter converter(timestampsEnabled_);
+  for (size_t i = 0; i < static_cast<size_t>(ret); ++i) {
+    ECNCodepoint ecn;
+    folly::Optional<std::chrono::nanoseconds> timestamp;
+    auto segmentSize =
+        parseControlMessages(msgs_[i].msg_hdr, ecn, timestamp);
+    onDatagram(
+        i,
+        msgs_[i].msg_len,
+        msgs_[i].msg_hdr.msg_flags,
+        msgs_[i].msg_hdr.msg_namelen,
+        segmentSize,
+        ecn,
+        converter.toReceiveTime(timestamp));
+  }
+#else
+  for (size_t i = 0; i < maxPackets_; ++i) {
+    struct msghdr msg;
+    initMsg(msg, i);
+    ssize_t ret = folly::netops::recvmsg(sock, &msg, 0);
+    if (ret < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (i == 0) {
+        return -1;
+      }
+      break;
+    }
+    ECNCodepoint ecn;
+    folly::Optional<std::chrono::nanoseconds> timestamp;
+    auto segmentSize = parseControlMessages(msg, ecn, timestamp);
+    onDatagram(
+        i,
+        ret,
+        msg.msg_flags,
+        msg.msg_namelen,
+        segmentSize,
+        ecn,
+        TimestampConverter(timestampsEnabled_).toReceiveTime(timestamp));
+  }
+#endif
+  return packets_.size();
+}
+
+BatchReadHandler::BatchReadHandler(
+    folly::EventBase* evb,
+    folly::NetworkSocket sock,
+    std::unique_ptr<RecvmmsgBatchReader> reader,
+    Callback* callback)
+    : folly::EventHandler(evb, sock),
+      sock_(sock),
+      reader_(std::move(reader)),
+      callback_(callback) {
+  CHECK(reader_);
+  CHECK(callback_);
+}
+
+BatchReadHandler::~BatchReadHandler() {
+  pause();
+}
+
+void BatchReadHandler::start() {
+  registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+}
+
+void BatchReadHandler::pause() {
+  if (isHandlerRegistered()) {
+    unregisterHandler();
+  }
+}
+
+void BatchReadHandler::handlerReady(uint16_t events) noexcept {
+  if (!(events & folly::EventHandler::READ)) {
+    return;
+  }
+  auto ret = reader_->readBatch(sock_);
+  if (ret < 0) {
+    callback_->onBatchReadError(errno);
+    return;
+  }
+  if (ret == 0) {
+    return;
+  }
+  auto receiveTime = Clock::now();
+  // Move the packets out so that they stay alive even if the callback
+  // destroys this handler.
+  auto packets = std::move(reader_->packets());
+  reader_->packets().clear();
+  callback_->onBatchRead(packets, receiveTime);
+}
+
+} // namespace quic
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventHandler.h>
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+#include <quic/QuicConstants.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Reads a batch of datagrams from a non-blocking UDP socket in a single
+ * syscall (recvmmsg where the platform supports it).
+ *
+ * The reader owns a slab that holds maxPackets buffers of packetSize bytes
+ * each. Every datagram read into the slab is handed out as an IOBuf that
+ * shares the slab, so a batch costs a single allocation. The slab is reused
+ * for the next batch once all the previously handed out packets have been
+ * released, otherwise a new one is allocated.
+ *
+ * When GRO is enabled each buffer is large enough to hold a coalesced
+ * super-datagram, which is split into one IOBuf per segment. The segments
+ * share the slab as well, so no data is copied.
+ *
+ * When ECN is enabled every packet carries the ECN codepoint of the datagram
+ * it was read from.
+ *
+ * When timestamps are enabled every packet carries the time the kernel
+ * received its datagram, so the time a datagram waited for the event loop
+ * doesn't count in the RTT samples.
+ */
+class RecvmmsgBatchReader {
+ public:
+  struct ReceivedPacket {
+    folly::SocketAddress peer;
+    std::unique_ptr<folly::IOBuf> data;
+    bool truncated{false};
+    ECNCodepoint ecn{ECNCodepoint::NotECT};
+    // The kernel receive time, on the steady clock. Not set if timestamps
+    // aren't enabled or the kernel didn't report it.
+    folly::Optional<TimePoint> receiveTime;
+  };
+
+  RecvmmsgBatchReader(
+      size_t maxPackets,
+      size_t packetSize,
+      bool groEnabled = false,
+      bool ecnEnabled = false,
+      bool timestampsEnabled = false);
+
+  /**
+   * Reads up to maxPackets datagrams from the socket without blocking.
+   * Returns the number of packets read, which can then be retrieved through
+   * packets(). With GRO a single datagram can result in several packets.
+   * Returns -1 on error with errno set. EAGAIN / EWOULDBLOCK are not treated
+   * as errors and simply result in 0 packets.
+   */
+  ssize_t readBatch(folly::NetworkSocket sock);
+
+  /**
+   * The packets read by the last call to readBatch(). Callers are expected
+   * to move the data out of these.
+   */
+  std::vector<ReceivedPacket>& packets() {
+    return packets_;
+  }
+
+  size_t maxPackets() const {
+    return maxPackets_;
+  }
+
+  size_t packetSize() const {
+    return packetSize_;
+  }
+
+  bool groEnabled() const {
+    return groEnabled_;
+  }
+
+  bool ecnEnabled() const {
+    return ecnEnabled_;
+  }
+
+  bool timestampsEnabled() const {
+    return timestampsEnabled_;
+  }
+
+  /**
+   * Turns on UDP_GRO on the socket. Returns false if the platform or the
+   * kernel does not support it.
+   */
+  static bool enableGRO(folly::NetworkSocket sock);
+
+  /**
+   * Marks the packets sent on the socket as ECT(0) and asks the kernel to
+   * report the ECN codepoint of received datagrams. family is the family of
+   * the socket's address. Returns false if either is not supported.
+   */
+  static bool enableECN(folly::NetworkSocket sock, sa_family_t family);
+
+  /**
+   * Asks the kernel to report the receive time of the datagrams, through
+   * SO_TIMESTAMPNS. Returns false if it is not supported.
+   */
+  static bool enableTimestamps(folly::NetworkSocket sock);
+
+ private:
+  void maybeAllocateSlab();
+  void onDatagram(
+      size_t index,
+      size_t len,
+      int flags,
+      socklen_t addrLen,
+      int segmentSize,
+      ECNCodepoint ecn,
+      folly::Optional<TimePoint> receiveTime);
+
+  size_t maxPackets_;
+  size_t packetSize_;
+  bool groEnabled_;
+  bool ecnEnabled_;
+  bool timestampsEnabled_;
+  std::unique_ptr<folly::IOBuf> slab_;
+  std::vector<ReceivedPacket> packets_;
+  std::vector<struct iovec> iovecs_;
+  std::vector<struct sockaddr_storage> addrs_;
+  // Control message space for the GRO segment size, the TOS byte and the
+  // receive timestamp, one per datagram.
+  size_t controlSize_{0};
+  std::vector<char> control_;
+#ifdef FOLLY_HAVE_RECVMMSG
+  std::vector<struct mmsghdr> msgs_;
+#endif
+};
+
+/**
+ * Drives reads of a UDP socket through a RecvmmsgBatchReader rather than the
+ * socket's own read callback, which hands out a single datagram per event and
+ * cannot surface per-datagram control messages such as the GRO segment size
+ * or the ECN codepoint.
+ *
+ * The owner of the socket must not also install a read callback or an error
+ * message callback on it.
+ */
+class BatchReadHandler : public folly::EventHandler {
+ public:
+  class Callback {
+   public:
+    virtual ~Callback() = default;
+
+    /**
+     * Called with the packets of every batch. The callback is free to move
+     * the packets out of the vector. The handler may be unregistered or
+     * destroyed from within this callback.
+     */
+    virtual void onBatchRead(
+        std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+        TimePoint receiveTime) noexcept = 0;
+
+    virtual void onBatchReadError(int err) noexcept = 0;
+  };
+
+  BatchReadHandler(
+      folly::EventBase* evb,
+      folly::NetworkSocket sock,
+      std::unique_ptr<RecvmmsgBatchReader> reader,
+      Callback* callback);
+
+  ~BatchReadHandler() override;
+
+  void start();
+
+  void pause();
+
+  void handlerReady(uint16_t events) noexcept override;
+
+  RecvmmsgBatchReader& getReader() {
+    return *reader_;
+  }
+
+ private:
+  folly::NetworkSocket sock_;
+  std::unique_ptr<RecvmmsgBatchReader> reader_;
+  Callback* callback_;
+};
+} // namespace quic
@@ -8,6 +8,24 @@
 
 #include <quic/api/QuicBatchWriter.h>
 
+#include <quic/api/QuicPacketIO.h>
+#include <quic/api/QuicWriteCoalescer.h>
+
+#include <folly/net/NetOps.h>
+
+#if defined(__linux__)
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+#endif
+
 namespace quic {
 // BatchWriter
 bool BatchWriter::needsFlush(size_t /*unused*/) {
@@ -91,6 +109,52 @@ ssize_t GSOPacketBatchWriter::write(
       : sock.write(address, buf_);
 }
 
+// GSOZeroCopyPacketBatchWriter
+GSOZeroCopyPacketBatchWriter::GSOZeroCopyPacketBatchWriter(
+    size_t maxBufs,
+    std::shared_ptr<ZeroCopyTracker> tracker)
+    : GSOPacketBatchWriter(maxBufs), tracker_(std::move(tracker)) {
+  CHECK(tracker_);
+}
+
+ssize_t GSOZeroCopyPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+#if defined(MSG_ZEROCOPY) && defined(UDP_SEGMENT)
+  auto iov = buf_->getIov();
+  sockaddr_storage addrStorage;
+  address.getAddress(&addrStorage);
+
+  struct msghdr msg = {};
+  msg.msg_name = reinterpret_cast<void*>(&addrStorage);
+  msg.msg_namelen = address.getActualSize();
+  msg.msg_iov = iov.data();
+  msg.msg_iovlen = iov.size();
+
+  char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+  if (currBufs_ > 1) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = IPPROTO_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gsoSize = static_cast<uint16_t>(prevSize_);
+    memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+  }
+
+  auto ret =
+      folly::netops::sendmsg(sock.getNetworkSocket(), &msg, MSG_ZEROCOPY);
+  if (ret >= 0) {
+    // The kernel now references the memory of the chain.
+    tracker_->onSent(std::move(buf_));
+  }
+  return ret;
+#else
+  return GSOPacketBatchWriter::write(sock, address);
+#endif
+}
+
 // SendmmsgPacketBatchWriter
 SendmmsgPacketBatchWriter::SendmmsgPacketBatchWriter(size_t maxBufs)
     : maxBufs_(maxBufs) {
@@ -149,11 +213,238 @@ ssize_t SendmmsgPacketBatchWriter::write(
   return 0;
 }
 
+// SendmmsgGSOPacketBatchWriter
+SendmmsgGSOPacketBatchWriter::SendmmsgGSOPacketBatchWriter(size_t maxBufs)
+    : maxBufs_(maxBufs) {
+  messages_.reserve(maxBufs);
+}
+
+bool SendmmsgGSOPacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t SendmmsgGSOPacketBatchWriter::size() const {
+  return currSize_;
+}
+
+void SendmmsgGSOPacketBatchWriter::reset() {
+  messages_.clear();
+  openMessages_.clear();
+  defaultMessage_.clear();
+  currBufs_ = 0;
+  currSize_ = 0;
+}
+
+bool SendmmsgGSOPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  return append(std::move(buf), size, folly::SocketAddress());
+}
+
+bool SendmmsgGSOPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size,
+    const folly::SocketAddress& address) {
+  CHECK_LT(currBufs_, maxBufs_);
+  currBufs_++;
+  currSize_ += size;
+
+  // Packets without a destination are tracked separately since an
+  // uninitialized address cannot be hashed.
+  folly::Optional<size_t> openIndex;
+  if (address.isInitialized()) {
+    auto it = openMessages_.find(address);
+    if (it != openMessages_.end()) {
+      openIndex = it->second;
+    }
+  } else {
+    openIndex = defaultMessage_;
+  }
+  if (openIndex) {
+    auto& message = messages_[*openIndex];
+    if (!message.closed && size <= message.segmentSize &&
+        message.numSegments < kMaxGSOSegments) {
+      message.buf->prependChain(std::move(buf));
+      message.numSegments++;
+      // Only the last segment of a GSO message can be smaller.
+      message.closed = size < message.segmentSize;
+      return currBufs_ == maxBufs_;
+    }
+  }
+
+  GSOMessage message;
+  message.address = address;
+  message.buf = std::move(buf);
+  message.segmentSize = size;
+  message.numSegments = 1;
+  if (address.isInitialized()) {
+    openMessages_[address] = messages_.size();
+  } else {
+    defaultMessage_ = messages_.size();
+  }
+  messages_.push_back(std::move(message));
+
+  // reached max buffers
+  if (FOLLY_UNLIKELY(currBufs_ == maxBufs_)) {
+    return true;
+  }
+
+  // does not need to be flushed yet
+  return false;
+}
+
+ssize_t SendmmsgGSOPacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  CHECK_GT(messages_.size(), 0);
+  auto destination = [&](const GSOMessage& message)
+      -> const folly::SocketAddress& {
+    return message.address.isInitialized() ? message.address : address;
+  };
+  if (messages_.size() == 1) {
+    auto& message = messages_[0];
+    return message.numSegments > 1
+        ? sock.writeGSO(
+              destination(message),
+              message.buf,
+              static_cast<int>(message.segmentSize))
+        : sock.write(destination(message), message.buf);
+  }
+
+  std::vector<OutgoingDatagram> datagrams(messages_.size());
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    auto& message = messages_[i];
+    datagrams[i].address = &destination(message);
+    datagrams[i].buf = &message.buf;
+    if (message.numSegments > 1) {
+      datagrams[i].gsoSegmentSize = message.segmentSize;
+    }
+  }
+
+  int ret = SocketPacketIO(sock).sendDatagrams(
+      datagrams.data(), datagrams.size());
+  if (ret <= 0) {
+    return ret;
+  }
+
+  if (static_cast<size_t>(ret) == datagrams.size()) {
+    return currSize_;
+  }
+
+  // this is a partial write - we just need to
+  // return a different number than currSize_
+  return 0;
+}
+
+// TxTimePacketBatchWriter
+TxTimePacketBatchWriter::TxTimePacketBatchWriter(
+    size_t maxBufs,
+    bool gsoEnabled,
+    DepartureTimeFunc getDepartureTime)
+    : maxBufs_(maxBufs),
+      gsoEnabled_(gsoEnabled),
+      getDepartureTime_(std::move(getDepartureTime)) {
+  messages_.reserve(maxBufs);
+}
+
+bool TxTimePacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t TxTimePacketBatchWriter::size() const {
+  return currSize_;
+}
+
+void TxTimePacketBatchWriter::reset() {
+  messages_.clear();
+  currBufs_ = 0;
+  currSize_ = 0;
+}
+
+bool TxTimePacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  auto departureTime = getDepartureTime_();
+  currSize_ += size;
+  ++currBufs_;
+  if (gsoEnabled_ && !messages_.empty()) {
+    auto& message = messages_.back();
+    if (!message.closed && message.departureTime == departureTime &&
+        size <= message.segmentSize) {
+      message.buf->prependChain(std::move(buf));
+      ++message.numSegments;
+      message.closed = size < message.segmentSize;
+      return currBufs_ == maxBufs_;
+    }
+  }
+  TxTimeMessage message;
+  message.buf = std::move(buf);
+  message.departureTime = departureTime;
+  message.segmentSize = size;
+  message.numSegments = 1;
+  messages_.push_back(std::move(message));
+  return currBufs_ == maxBufs_;
+}
+
+ssize_t TxTimePacketBatchWriter::write(
+    folly::AsyncUDPSocket& sock,
+    const folly::SocketAddress& address) {
+  CHECK_GT(messages_.size(), 0);
+  std::vector<OutgoingDatagram> datagrams(messages_.size());
+  for (size_t i = 0; i < messages_.size(); ++i) {
+    auto& message = messages_[i];
+    datagrams[i].address = &address;
+    datagrams[i].buf = &message.buf;
+    datagrams[i].txTime = message.departureTime;
+    if (message.numSegments > 1) {
+      datagrams[i].gsoSegmentSize = message.segmentSize;
+    }
+  }
+
+  int ret = SocketPacketIO(sock).sendDatagrams(
+      datagrams.data(), datagrams.size());
+  if (ret <= 0) {
+    return ret;
+  }
+
+  if (static_cast<size_t>(ret) == datagrams.size()) {
+    return currSize_;
+  }
+
+  // this is a partial write - we just need to
+  // return a different number than currSize_
+  return 0;
+}
+
+bool TxTimePacketBatchWriter::enableTxTime(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock) {
+#if defined(SO_TXTIME)
+  // Same layout as struct sock_txtime. The departure times are steady clock
+  // time points, which is CLOCK_MONOTONIC.
+  struct {
+    clockid_t clockid;
+    uint32_t flags;
+  } config{CLOCK_MONOTONIC, 0};
+  return folly::netops::setsockopt(
+             sock, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) == 0;
+#else
+  return false;
+#endif
+}
+
 // BatchWriterFactory
 std::unique_ptr<BatchWriter> BatchWriterFactory::makeBatchWriter(
     folly::AsyncUDPSocket& sock,
     const quic::QuicBatchingMode& batchingMode,
     uint32_t batchSize) {
+  // The writes of all the transports sharing the socket are flushed together
+  // by its coalescer, if it has one.
+  auto coalescer = QuicWriteCoalescer::getForSocket(sock.getNetworkSocket());
+  if (coalescer) {
+    return std::make_unique<CoalescedPacketBatchWriter>(
+        std::max<uint32_t>(batchSize, 1), std::move(coalescer));
+  }
+
   switch (batchingMode) {
     case quic::QuicBatchingMode::BATCHING_MODE_NONE:
       return std::make_unique<SinglePacketBatchWriter>();
@@ -166,6 +457,26 @@ std::unique_ptr<BatchWriter> BatchWriterFactory::makeBatchWriter(
     }
     case quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG:
       return std::make_unique<SendmmsgPacketBatchWriter>(batchSize);
+    case quic::QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY: {
+      if (sock.getGSO() < 0) {
+        return std::make_unique<SinglePacketBatchWriter>();
+      }
+      // Completions are only delivered if someone registered to drain the
+      // socket's error queue.
+      auto tracker = ZeroCopyTracker::getForSocket(sock.getNetworkSocket());
+      if (tracker) {
+        return std::make_unique<GSOZeroCopyPacketBatchWriter>(
+            batchSize, std::move(tracker));
+      }
+      return std::make_unique<GSOPacketBatchWriter>(batchSize);
+    }
+    case quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO: {
+      if (sock.getGSO() >= 0) {
+        return std::make_unique<SendmmsgGSOPacketBatchWriter>(batchSize);
+      }
+
+      return std::make_unique<SendmmsgPacketBatchWriter>(batchSize);
+    }
       // no default so we can catch missing case at compile time
   }
 
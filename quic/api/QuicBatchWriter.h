@@ -8,9 +8,14 @@
 
 #pragma once
 
+#include <folly/Function.h>
+#include <folly/Optional.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <quic/QuicConstants.h>
+#include <quic/api/ZeroCopyTracker.h>
+
+#include <unordered_map>
 
 namespace quic {
 class BatchWriter {
@@ -80,7 +85,7 @@ class GSOPacketBatchWriter : public IOBufBatchWriter {
       folly::AsyncUDPSocket& sock,
       const folly::SocketAddress& address) override;
 
- private:
+ protected:
   // max number of buffer chains we can accumulate before we need to flush
   size_t maxBufs_{1};
   // current number of buffer chains  appended the buf_
@@ -89,6 +94,26 @@ class GSOPacketBatchWriter : public IOBufBatchWriter {
   size_t prevSize_{0};
 };
 
+/**
+ * GSO batch writer that sends with MSG_ZEROCOPY. The written buffers are
+ * handed to the socket's ZeroCopyTracker, which keeps them alive until the
+ * kernel reports the send has completed.
+ */
+class GSOZeroCopyPacketBatchWriter : public GSOPacketBatchWriter {
+ public:
+  GSOZeroCopyPacketBatchWriter(
+      size_t maxBufs,
+      std::shared_ptr<ZeroCopyTracker> tracker);
+  ~GSOZeroCopyPacketBatchWriter() override = default;
+
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  std::shared_ptr<ZeroCopyTracker> tracker_;
+};
+
 class SendmmsgPacketBatchWriter : public BatchWriter {
  public:
   explicit SendmmsgPacketBatchWriter(size_t maxBufs);
@@ -113,6 +138,122 @@ class SendmmsgPacketBatchWriter : public BatchWriter {
   std::vector<std::unique_ptr<folly::IOBuf>> bufs_;
 };
 
+/**
+ * Batch writer that combines GSO and sendmmsg: consecutive equal sized
+ * packets to the same destination are coalesced into a single GSO message,
+ * and all the GSO messages, which can be for different destinations, are
+ * sent with one sendmmsg call.
+ */
+class SendmmsgGSOPacketBatchWriter : public BatchWriter {
+ public:
+  explicit SendmmsgGSOPacketBatchWriter(size_t maxBufs);
+  ~SendmmsgGSOPacketBatchWriter() override = default;
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  void reset() override;
+
+  // Appends a packet for the address passed to write().
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+
+  // Appends a packet for the given destination.
+  bool append(
+      std::unique_ptr<folly::IOBuf>&& buf,
+      size_t size,
+      const folly::SocketAddress& address);
+
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+  size_t numMessages() const {
+    return messages_.size();
+  }
+
+ private:
+  struct GSOMessage {
+    // Not initialized for packets added without a destination.
+    folly::SocketAddress address;
+    std::unique_ptr<folly::IOBuf> buf;
+    size_t segmentSize{0};
+    size_t numSegments{0};
+    // A smaller packet ends a GSO message.
+    bool closed{false};
+  };
+
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  // number of buffer chains across all the messages
+  size_t currBufs_{0};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<GSOMessage> messages_;
+  // index into messages_ of the message still open for each destination
+  std::unordered_map<folly::SocketAddress, size_t> openMessages_;
+  // index of the open message for packets added without a destination
+  folly::Optional<size_t> defaultMessage_;
+};
+
+/**
+ * Batch writer for kernel pacing. Every packet is tagged with the SCM_TXTIME
+ * departure time returned by getDepartureTime, consecutive equal sized
+ * packets that leave together are coalesced into a single GSO message, and
+ * all the messages are sent with one sendmmsg call. The fq qdisc then holds
+ * each message until its departure time. The socket needs SO_TXTIME.
+ */
+class TxTimePacketBatchWriter : public BatchWriter {
+ public:
+  using DepartureTimeFunc = folly::Function<TimePoint()>;
+
+  TxTimePacketBatchWriter(
+      size_t maxBufs,
+      bool gsoEnabled,
+      DepartureTimeFunc getDepartureTime);
+  ~TxTimePacketBatchWriter() override = default;
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  void reset() override;
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+  size_t numMessages() const {
+    return messages_.size();
+  }
+
+  /**
+   * Turns on SO_TXTIME on the socket, against the steady clock. Returns false
+   * if the socket does not support it.
+   */
+  static bool enableTxTime(folly::NetworkSocket sock);
+
+ private:
+  struct TxTimeMessage {
+    std::unique_ptr<folly::IOBuf> buf;
+    TimePoint departureTime;
+    size_t segmentSize{0};
+    size_t numSegments{0};
+    // A smaller packet ends a GSO message.
+    bool closed{false};
+  };
+
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  bool gsoEnabled_{false};
+  DepartureTimeFunc getDepartureTime_;
+  // number of buffer chains across all the messages
+  size_t currBufs_{0};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<TxTimeMessage> messages_;
+};
+
 class BatchWriterFactory {
  public:
   static std::unique_ptr<BatchWriter> makeBatchWriter(
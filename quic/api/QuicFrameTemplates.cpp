@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicFrameTemplates.h>
+
+#include <glog/logging.h>
+
+#include <limits>
+
+namespace quic {
+
+QuicFrameTemplates::Handle QuicFrameTemplates::add(Buf frame) {
+  CHECK(frame);
+  CHECK_LT(frames_.size(), std::numeric_limits<Handle>::max());
+  frame->coalesce();
+  frames_.push_back(std::move(frame));
+  return frames_.size() - 1;
+}
+
+Buf QuicFrameTemplates::get(Handle handle) const {
+  if (handle >= frames_.size()) {
+    return nullptr;
+  }
+  return frames_[handle]->clone();
+}
+} // namespace quic
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/Types.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Pre-encoded application frames, e.g. the static HTTP/3 frames written at
+ * the start of many streams, that are added once and then written to the
+ * streams by handle, see QuicSocket::writeFrameTemplate(). Every write
+ * references the same immutable buffer, so a frame is neither encoded nor
+ * copied again per stream.
+ *
+ * The templates can belong to one connection or be shared by the connections
+ * of a worker, or of all the workers: once all the frames are added, get() can
+ * be called from any thread.
+ */
+class QuicFrameTemplates {
+ public:
+  using Handle = uint32_t;
+
+  /**
+   * Adds the frame, coalesced into one buffer, and returns its handle.
+   */
+  Handle add(Buf frame);
+
+  /**
+   * A clone of the frame that shares its memory, null if the handle is
+   * unknown.
+   */
+  Buf get(Handle handle) const;
+
+  size_t size() const {
+    return frames_.size();
+  }
+
+ private:
+  std::vector<Buf> frames_;
+};
+} // namespace quic
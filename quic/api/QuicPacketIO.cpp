@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicPacketIO.h>
+
+#include <folly/FBVector.h>
+#include <folly/net/NetOps.h>
+
+#include <vector>
+
+#if defined(__linux__)
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+#endif
+
+namespace quic {
+
+int SocketPacketIO::sendDatagrams(
+    const OutgoingDatagram* datagrams,
+    size_t count) {
+  CHECK_GT(count, 0);
+  if (count == 1 && !datagrams[0].txTime) {
+    return sendDatagramsOneByOne(datagrams, count);
+  }
+
+#if defined(UDP_SEGMENT) && defined(SO_TXTIME)
+  std::vector<struct mmsghdr> msgs(count);
+  std::vector<sockaddr_storage> addrs(count);
+  std::vector<folly::fbvector<struct iovec>> iovs(count);
+  constexpr size_t kControlSize =
+      CMSG_SPACE(sizeof(uint64_t)) + CMSG_SPACE(sizeof(uint16_t));
+  std::vector<char> control(count * kControlSize);
+  for (size_t i = 0; i < count; ++i) {
+    const auto& datagram = datagrams[i];
+    auto& msg = msgs[i].msg_hdr;
+    datagram.address->getAddress(&addrs[i]);
+    iovs[i] = (*datagram.buf)->getIov();
+    msg = {};
+    msg.msg_name = reinterpret_cast<void*>(&addrs[i]);
+    msg.msg_namelen = datagram.address->getActualSize();
+    msg.msg_iov = iovs[i].data();
+    msg.msg_iovlen = iovs[i].size();
+    if (!datagram.txTime && !datagram.gsoSegmentSize) {
+      continue;
+    }
+    msg.msg_control = control.data() + i * kControlSize;
+    msg.msg_controllen = kControlSize;
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    size_t controlLen = 0;
+    if (datagram.txTime) {
+      cm->cmsg_level = SOL_SOCKET;
+      cm->cmsg_type = SCM_TXTIME;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+      uint64_t txTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            datagram.txTime->time_since_epoch())
+                            .count();
+      memcpy(CMSG_DATA(cm), &txTime, sizeof(txTime));
+      controlLen += CMSG_SPACE(sizeof(uint64_t));
+      cm = CMSG_NXTHDR(&msg, cm);
+    }
+    if (datagram.gsoSegmentSize) {
+      cm->cmsg_level = IPPROTO_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t gsoSize = static_cast<uint16_t>(datagram.gsoSegmentSize);
+      memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+      controlLen += CMSG_SPACE(sizeof(uint16_t));
+    }
+    msg.msg_controllen = controlLen;
+  }
+  return folly::netops::sendmmsg(
+      sock_.getNetworkSocket(), msgs.data(), count, 0);
+#else
+  // No sendmmsg, the departure times are ignored and the datagrams are sent
+  // right away.
+  return sendDatagramsOneByOne(datagrams, count);
+#endif
+}
+
+int SocketPacketIO::sendDatagramsOneByOne(
+    const OutgoingDatagram* datagrams,
+    size_t count) {
+  size_t sent = 0;
+  for (; sent < count; ++sent) {
+    const auto& datagram = datagrams[sent];
+    auto ret = datagram.gsoSegmentSize
+        ? sock_.writeGSO(
+              *datagram.address,
+              *datagram.buf,
+              static_cast<int>(datagram.gsoSegmentSize))
+        : sock_.write(*datagram.address, *datagram.buf);
+    if (ret < 0) {
+      return sent > 0 ? static_cast<int>(sent) : -1;
+    }
+  }
+  return static_cast<int>(sent);
+}
+} // namespace quic
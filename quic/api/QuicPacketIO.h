@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <quic/QuicConstants.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * A datagram to send, with the metadata that goes in its ancillary data.
+ */
+struct OutgoingDatagram {
+  const folly::SocketAddress* address{nullptr};
+  const std::unique_ptr<folly::IOBuf>* buf{nullptr};
+  // When not 0, the buffer is sent as GSO segments of this size.
+  size_t gsoSegmentSize{0};
+  // The SCM_TXTIME departure time, the socket needs SO_TXTIME.
+  folly::Optional<TimePoint> txTime;
+};
+
+/**
+ * Sends batches of datagrams. The batch writers go through it instead of
+ * building the sendmmsg messages themselves, so the calls to the kernel, and
+ * the fallbacks where a feature is missing, are in a single place.
+ */
+class QuicPacketIO {
+ public:
+  virtual ~QuicPacketIO() = default;
+
+  /**
+   * Returns the number of datagrams sent, which can be less than count, or -1
+   * if none could be sent, with errno set.
+   */
+  virtual int sendDatagrams(
+      const OutgoingDatagram* datagrams,
+      size_t count) = 0;
+};
+
+/**
+ * QuicPacketIO over an AsyncUDPSocket. A single datagram is written through
+ * the socket's own write methods, so sockets that override them, like the
+ * connection sockets of QuicSharedClientSocket, see it. Several datagrams
+ * are sent with one sendmmsg on the socket's fd where it is available.
+ */
+class SocketPacketIO : public QuicPacketIO {
+ public:
+  explicit SocketPacketIO(folly::AsyncUDPSocket& sock) : sock_(sock) {}
+
+  ~SocketPacketIO() override = default;
+
+  int sendDatagrams(const OutgoingDatagram* datagrams, size_t count)
+      override;
+
+ private:
+  int sendDatagramsOneByOne(const OutgoingDatagram* datagrams, size_t count);
+
+  folly::AsyncUDPSocket& sock_;
+};
+} // namespace quic
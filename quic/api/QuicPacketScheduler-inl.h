@@ -13,9 +13,9 @@
 
 namespace quic {
 
-template <typename ClockType>
+template <typename ClockType, typename BuilderType>
 inline folly::Optional<PacketNum> AckScheduler::writeNextAcks(
-    PacketBuilderInterface& builder,
+    BuilderType& builder,
     AckMode mode) {
   switch (mode) {
     case AckMode::Immediate: {
@@ -28,18 +28,17 @@ inline folly::Optional<PacketNum> AckScheduler::writeNextAcks(
   folly::assume_unreachable();
 }
 
-template <typename ClockType>
+template <typename ClockType, typename BuilderType>
 inline folly::Optional<PacketNum> AckScheduler::writeAcksIfPending(
-    PacketBuilderInterface& builder) {
+    BuilderType& builder) {
   if (ackState_.needsToSendAckImmediately) {
     return writeAcksImpl<ClockType>(builder);
   }
   return folly::none;
 }
 
-template <typename ClockType>
-folly::Optional<PacketNum> AckScheduler::writeAcksImpl(
-    PacketBuilderInterface& builder) {
+template <typename ClockType, typename BuilderType>
+folly::Optional<PacketNum> AckScheduler::writeAcksImpl(BuilderType& builder) {
   // Use default ack delay for long headers. Usually long headers are sent
   // before crypto negotiation, so the peer might not know about the ack delay
   // exponent yet, so we use the default.
@@ -59,6 +58,12 @@ folly::Optional<PacketNum> AckScheduler::writeAcksImpl(
                  ackingTime - receivedTime)
            : 0us);
   AckFrameMetaData meta(ackState_.acks, ackDelay, ackDelayExponentToUse);
+  meta.maxAckBlocks = conn_.transportSettings.maxAckBlocks;
+  meta.encoding = &ackState_.acksEncoding;
+  // Only echo ECN once the peer has sent ECN capable packets.
+  if (!ackState_.ecnCountsReceived.empty()) {
+    meta.ecnCounts = ackState_.ecnCountsReceived;
+  }
   auto ackWriteResult = writeAckFrame(meta, builder);
   if (!ackWriteResult) {
     return folly::none;
@@ -81,6 +81,11 @@ FrameScheduler::Builder& FrameScheduler::Builder::simpleFrames() {
   return *this;
 }
 
+FrameScheduler::Builder& FrameScheduler::Builder::datagramFrames() {
+  datagramFrameScheduler_ = true;
+  return *this;
+}
+
 FrameScheduler FrameScheduler::Builder::build() && {
   FrameScheduler scheduler(std::move(name_));
   if (retransmissionScheduler_) {
@@ -109,6 +114,9 @@ FrameScheduler FrameScheduler::Builder::build() && {
   if (simpleFrameScheduler_) {
     scheduler.simpleFrameScheduler_.emplace(SimpleFrameScheduler(conn_));
   }
+  if (datagramFrameScheduler_) {
+    scheduler.datagramFrameScheduler_.emplace(DatagramFrameScheduler(conn_));
+  }
   return scheduler;
 }
 
@@ -126,7 +134,7 @@ FrameScheduler::scheduleFramesForPacket(
       : 0;
   // We cannot return early if the writablyBytes dropps to 0 here, since pure
   // acks can skip writableBytes entirely.
-  PacketBuilderWrapper wrapper(builder, writableBytes);
+  RegularPacketBuilderWrapper wrapper(builder, writableBytes);
   auto ackMode = hasImmediateData() ? AckMode::Immediate : AckMode::Pending;
   bool cryptoDataWritten = false;
   bool rstWritten = false;
@@ -147,7 +155,8 @@ FrameScheduler::scheduleFramesForPacket(
       // bytes, this will be a pure ack packet and it will skip congestion
       // controller. Otherwise, we will give other schedulers an opportunity to
       // write up to writable bytes.
-      ackScheduler_->writeNextAcks(builder, ackMode);
+      RegularPacketBuilderWrapper fullPacket(builder);
+      ackScheduler_->writeNextAcks(fullPacket, ackMode);
     }
   }
   if (windowUpdateScheduler_ &&
@@ -157,6 +166,12 @@ FrameScheduler::scheduleFramesForPacket(
   if (blockedScheduler_ && blockedScheduler_->hasPendingBlockedFrames()) {
     blockedScheduler_->writeBlockedFrames(wrapper);
   }
+  // Datagrams are sent right away or dropped, so they go before the stream
+  // data, which is queued anyway.
+  if (datagramFrameScheduler_ &&
+      datagramFrameScheduler_->hasPendingDatagrams()) {
+    datagramFrameScheduler_->writeDatagramFrames(wrapper);
+  }
   if (retransmissionScheduler_ && retransmissionScheduler_->hasPendingData()) {
     retransmissionScheduler_->writeRetransmissionStreams(wrapper);
   }
@@ -185,7 +200,9 @@ bool FrameScheduler::hasImmediateData() const {
        windowUpdateScheduler_->hasPendingWindowUpdates()) ||
       (blockedScheduler_ && blockedScheduler_->hasPendingBlockedFrames()) ||
       (simpleFrameScheduler_ &&
-       simpleFrameScheduler_->hasPendingSimpleFrames());
+       simpleFrameScheduler_->hasPendingSimpleFrames()) ||
+      (datagramFrameScheduler_ &&
+       datagramFrameScheduler_->hasPendingDatagrams());
 }
 
 std::string FrameScheduler::name() const {
@@ -198,6 +215,17 @@ RetransmissionScheduler::RetransmissionScheduler(
 
 void RetransmissionScheduler::writeRetransmissionStreams(
     PacketBuilderInterface& builder) {
+  writeRetransmissionStreamsImpl(builder);
+}
+
+void RetransmissionScheduler::writeRetransmissionStreams(
+    RegularPacketBuilderWrapper& builder) {
+  writeRetransmissionStreamsImpl(builder);
+}
+
+template <typename BuilderType>
+void RetransmissionScheduler::writeRetransmissionStreamsImpl(
+    BuilderType& builder) {
   for (auto streamId : conn_.streamManager->lossStreams()) {
     auto stream = conn_.streamManager->findStream(streamId);
     CHECK(stream);
@@ -233,33 +261,149 @@ StreamFrameScheduler::StreamFrameScheduler(QuicConnectionStateBase& conn)
     : conn_(conn) {}
 
 void StreamFrameScheduler::writeStreams(PacketBuilderInterface& builder) {
+  writeStreamsImpl(builder);
+}
+
+void StreamFrameScheduler::writeStreams(RegularPacketBuilderWrapper& builder) {
+  writeStreamsImpl(builder);
+}
+
+template <typename BuilderType>
+void StreamFrameScheduler::writeStreamsImpl(BuilderType& builder) {
   uint64_t connWritableBytes = getSendConnFlowControlBytesWire(conn_);
+  // Data with a delivery deadline goes first, since it is worthless once the
+  // deadline passes.
+  std::set<StreamId> written;
+  bool wroteAll = writeStreamsByDeadline(builder, connWritableBytes, written);
+  // Streams of a more urgent priority group are always written first. A less
+  // urgent group only gets the space left once every stream of the groups
+  // before it has written what it could.
+  for (const auto& group : conn_.streamManager->writableStreamsByPriority()) {
+    if (!wroteAll || connWritableBytes == 0) {
+      break;
+    }
+    wroteAll = group.first.incremental
+        ? writeStreamsRoundRobin(
+              builder, group.second, written, connWritableBytes)
+        : writeStreamsSequentially(
+              builder, group.second, written, connWritableBytes);
+  }
+  if (!wroteAll && connWritableBytes > 0 &&
+      conn_.transportSettings.fillPacketsWithStreams) {
+    fillPacketWithStreams(builder, written, connWritableBytes);
+  }
+}
+
+template <typename BuilderType>
+bool StreamFrameScheduler::writeStreamsByDeadline(
+    BuilderType& builder,
+    uint64_t& connWritableBytes,
+    std::set<StreamId>& written) {
+  std::vector<std::pair<TimePoint, StreamId>> deadlines;
+  for (auto streamId : conn_.streamManager->deadlineStreams()) {
+    if (!conn_.streamManager->writableContains(streamId)) {
+      continue;
+    }
+    auto stream = conn_.streamManager->findStream(streamId);
+    CHECK(stream);
+    auto deadline = getNextWriteDeadline(*stream);
+    if (deadline) {
+      deadlines.emplace_back(*deadline, streamId);
+    }
+  }
+  std::sort(deadlines.begin(), deadlines.end());
+  for (const auto& deadline : deadlines) {
+    if (connWritableBytes == 0 ||
+        !writeNextStreamFrame(builder, deadline.second, connWritableBytes)) {
+      return false;
+    }
+    written.insert(deadline.second);
+  }
+  return true;
+}
+
+template <typename BuilderType>
+bool StreamFrameScheduler::writeStreamsRoundRobin(
+    BuilderType& builder,
+    const std::set<StreamId>& streams,
+    std::set<StreamId>& written,
+    uint64_t& connWritableBytes) {
+  bool fill = conn_.transportSettings.fillPacketsWithStreams;
   MiddleStartingIterationWrapper wrapper(
-      conn_.streamManager->writableStreams(),
-      conn_.schedulingState.nextScheduledStream);
+      streams, conn_.schedulingState.nextScheduledStream);
   auto writableStreamItr = wrapper.cbegin();
   // This will write the stream frames in a round robin fashion ordered by
   // stream id. The iterator will wrap around the collection at the end, and we
   // keep track of the value at the next iteration. This allows us to start
   // writing at the next stream when building the next packet.
-  // TODO experiment with writing streams with an actual prioritization scheme.
   while (writableStreamItr != wrapper.cend() && connWritableBytes > 0) {
-    if (writeNextStreamFrame(builder, *writableStreamItr, connWritableBytes)) {
+    if (written.count(*writableStreamItr)) {
+      writableStreamItr++;
+    } else if (writeNextStreamFrame(
+                   builder, *writableStreamItr, connWritableBytes)) {
+      if (fill) {
+        written.insert(*writableStreamItr);
+      }
       writableStreamItr++;
     } else {
       break;
     }
   }
+  bool wroteAll = writableStreamItr == wrapper.cend();
   conn_.schedulingState.nextScheduledStream = *writableStreamItr;
-} // namespace quic
+  return wroteAll;
+}
+
+template <typename BuilderType>
+bool StreamFrameScheduler::writeStreamsSequentially(
+    BuilderType& builder,
+    const std::set<StreamId>& streams,
+    std::set<StreamId>& written,
+    uint64_t& connWritableBytes) {
+  bool fill = conn_.transportSettings.fillPacketsWithStreams;
+  for (auto streamId : streams) {
+    if (written.count(streamId)) {
+      continue;
+    }
+    if (connWritableBytes == 0 ||
+        !writeNextStreamFrame(builder, streamId, connWritableBytes)) {
+      return false;
+    }
+    if (fill) {
+      written.insert(streamId);
+    }
+  }
+  return true;
+}
+
+template <typename BuilderType>
+void StreamFrameScheduler::fillPacketWithStreams(
+    BuilderType& builder,
+    std::set<StreamId>& written,
+    uint64_t& connWritableBytes) {
+  // The round robin position stays on the stream that didn't fit, so it goes
+  // first in the next packet.
+  for (const auto& group : conn_.streamManager->writableStreamsByPriority()) {
+    for (auto streamId : group.second) {
+      if (builder.remainingSpaceInPkt() == 0 || connWritableBytes == 0) {
+        return;
+      }
+      if (!written.count(streamId) &&
+          writeNextStreamFrame(builder, streamId, connWritableBytes)) {
+        written.insert(streamId);
+      }
+    }
+  }
+}
 
 bool StreamFrameScheduler::hasPendingData() const {
   return conn_.streamManager->hasWritable() &&
       getSendConnFlowControlBytesWire(conn_) > 0;
 }
 
+template <typename BuilderType>
 bool StreamFrameScheduler::writeNextStreamFrame(
-    PacketBuilderInterface& builder,
+    BuilderType& builder,
     StreamId streamId,
     uint64_t& connWritableBytes) {
   if (builder.remainingSpaceInPkt() == 0) {
@@ -275,6 +419,15 @@ bool StreamFrameScheduler::writeNextStreamFrame(
   uint64_t flowControlLen =
       std::min(getSendStreamFlowControlBytesWire(*stream), connWritableBytes);
   uint64_t bufferLen = stream->writeBuffer.chainLength();
+  if (stream->sendRateLimit && bufferLen > 0) {
+    auto tokens = refillStreamSendRateTokens(*stream, Clock::now());
+    if (tokens == 0) {
+      // The stream is over its rate, the other streams go on. It is tried
+      // again at the next paced write.
+      return true;
+    }
+    flowControlLen = std::min(flowControlLen, tokens);
+  }
   bool canWriteFin =
       stream->finalWriteOffset.hasValue() && bufferLen <= flowControlLen;
   auto dataLen = writeStreamFrameHeader(
@@ -288,6 +441,10 @@ bool StreamFrameScheduler::writeNextStreamFrame(
     return false;
   }
   writeStreamFrameData(builder, stream->writeBuffer, *dataLen);
+  if (stream->sendRateLimit) {
+    stream->sendRateLimit->tokens -=
+        std::min(stream->sendRateLimit->tokens, *dataLen);
+  }
   VLOG(4) << "Wrote stream frame stream=" << stream->id
           << " offset=" << stream->currentWriteOffset
           << " bytesWritten=" << *dataLen
@@ -352,6 +509,28 @@ bool SimpleFrameScheduler::writeSimpleFrames(PacketBuilderInterface& builder) {
   return framesWritten;
 }
 
+DatagramFrameScheduler::DatagramFrameScheduler(
+    const QuicConnectionStateBase& conn)
+    : conn_(conn) {}
+
+bool DatagramFrameScheduler::hasPendingDatagrams() const {
+  return !conn_.datagramState.writeBuffer.empty();
+}
+
+bool DatagramFrameScheduler::writeDatagramFrames(
+    PacketBuilderInterface& builder) {
+  bool framesWritten = false;
+  // In order, since the datagrams written are popped off the front of the
+  // queue when the packet is sent.
+  for (const auto& datagram : conn_.datagramState.writeBuffer) {
+    if (!writeDatagramFrame(*datagram, builder)) {
+      break;
+    }
+    framesWritten = true;
+  }
+  return framesWritten;
+}
+
 WindowUpdateScheduler::WindowUpdateScheduler(
     const QuicConnectionStateBase& conn)
     : conn_(conn) {}
@@ -444,7 +623,9 @@ bool CryptoStreamScheduler::writeCryptoData(PacketBuilderInterface& builder) {
     const LongHeader* longHeader = builder.getPacketHeader().asLong();
     bool initialPacket =
         longHeader && longHeader->getHeaderType() == LongHeader::Types::Initial;
-    if (initialPacket) {
+    // When the packets are coalesced the datagram is padded instead, see
+    // writeCoalescedDatagram().
+    if (initialPacket && !conn_.coalescedDatagram.enabled) {
       // This is the initial packet, we need to fill er up.
       while (builder.remainingSpaceInPkt() > 0) {
         writeFrame(PaddingFrame(), builder);
@@ -511,56 +692,119 @@ CloningScheduler::scheduleFramesForPacket(
     return frameScheduler_.scheduleFramesForPacket(
         std::move(builder), writableBytes);
   }
+  // The most recent packets are tried first, and found with a binary search
+  // rather than a walk of the outstanding packets. They are also the newest
+  // of the packets that can be cloned, so the full walk only looks at the
+  // older ones.
+  folly::Optional<PacketNum> oldestCandidate;
+  auto& candidates = conn_.cloneCandidates;
+  if (!candidates.empty()) {
+    oldestCandidate = candidates.front();
+  }
+  for (size_t i = candidates.size(); i-- > 0;) {
+    auto packet = findOutstandingPacket(candidates[i]);
+    if (!packet || !canClone(*packet)) {
+      // It won't become clonable again.
+      candidates.erase(candidates.begin() + i);
+      continue;
+    }
+    if (packet->encodedSize > writableBytes + cipherOverhead_) {
+      continue;
+    }
+    auto result = cloneFromPacket(*packet, builder);
+    if (result.first) {
+      return result;
+    }
+  }
   // Look for an outstanding packet that's no larger than the writableBytes
   for (auto iter = conn_.outstandingPackets.rbegin();
        iter != conn_.outstandingPackets.rend();
        ++iter) {
-    auto opPnSpace = iter->packet.header.getPacketNumberSpace();
-    if (opPnSpace != PacketNumberSpace::AppData) {
-      continue;
-    }
-    // Reusing the RegularQuicPacketBuilder throughout loop bodies will lead to
-    // frames belong to different original packets being written into the same
-    // clone packet. So re-create a RegularQuicPacketBuilder every time.
-    // TODO: We can avoid the copy & rebuild of the header by creating an
-    // independent header builder.
-    auto builderPnSpace = builder.getPacketHeader().getPacketNumberSpace();
-    CHECK_EQ(builderPnSpace, PacketNumberSpace::AppData);
-    RegularQuicPacketBuilder regularBuilder(
-        conn_.udpSendPacketLen,
-        builder.getPacketHeader(),
-        getAckState(conn_, builderPnSpace).largestAckedByPeer,
-        conn_.version.value_or(*conn_.originalVersion));
-    PacketRebuilder rebuilder(regularBuilder, conn_);
-    // We shouldn't clone Handshake packet. For PureAcks, cloning them bring
-    // perf down as shown by load test.
-    if (iter->isHandshake || iter->pureAck) {
+    if (oldestCandidate && iter->packetNum >= *oldestCandidate) {
       continue;
     }
-    // If the packet is already a clone that has been processed, we don't clone
-    // it again.
-    if (iter->associatedEvent &&
-        conn_.outstandingPacketEvents.count(*iter->associatedEvent) == 0) {
+    if (!canClone(*iter)) {
       continue;
     }
-
     // The writableBytes here is an optimization. If the writableBytes is too
     // small for this packet. rebuildFromPacket should fail anyway.
     // TODO: This isn't the ideal way to solve the wrong writableBytes problem.
     if (iter->encodedSize > writableBytes + cipherOverhead_) {
       continue;
     }
-
-    // Rebuilder will write the rest of frames
-    auto rebuildResult = rebuilder.rebuildFromPacket(*iter);
-    if (rebuildResult) {
-      return std::make_pair(
-          std::move(rebuildResult), std::move(regularBuilder).buildPacket());
+    auto result = cloneFromPacket(*iter, builder);
+    if (result.first) {
+      return result;
     }
   }
   return std::make_pair(folly::none, folly::none);
 }
 
+bool CloningScheduler::canClone(const OutstandingPacket& packet) const {
+  if (packet.packetNumberSpace != PacketNumberSpace::AppData) {
+    return false;
+  }
+  // We shouldn't clone Handshake packet. For PureAcks, cloning them bring
+  // perf down as shown by load test.
+  if (packet.isHandshake || packet.pureAck) {
+    return false;
+  }
+  // If the packet is already a clone that has been processed, we don't clone
+  // it again.
+  return !packet.associatedEvent ||
+      conn_.outstandingPacketEvents.count(*packet.associatedEvent);
+}
+
+OutstandingPacket* CloningScheduler::findOutstandingPacket(
+    PacketNum packetNum) {
+  auto& outstandingPackets = conn_.outstandingPackets;
+  auto rawIt = std::lower_bound(
+      outstandingPackets.rawBegin(),
+      outstandingPackets.rawEnd(),
+      packetNum,
+      [](const auto& slot, const auto& val) {
+        return slot.value.packetNum < val;
+      });
+  // The other packet number spaces can have packets with the same number.
+  for (; rawIt != outstandingPackets.rawEnd() &&
+       rawIt->value.packetNum == packetNum;
+       ++rawIt) {
+    if (!rawIt->tombstone &&
+        rawIt->value.packetNumberSpace == PacketNumberSpace::AppData) {
+      return &rawIt->value;
+    }
+  }
+  return nullptr;
+}
+
+std::pair<
+    folly::Optional<PacketEvent>,
+    folly::Optional<RegularQuicPacketBuilder::Packet>>
+CloningScheduler::cloneFromPacket(
+    OutstandingPacket& packet,
+    const RegularQuicPacketBuilder& builder) {
+  // Reusing the RegularQuicPacketBuilder across packets will lead to frames
+  // belong to different original packets being written into the same clone
+  // packet. So re-create a RegularQuicPacketBuilder every time.
+  // TODO: We can avoid the copy & rebuild of the header by creating an
+  // independent header builder.
+  auto builderPnSpace = builder.getPacketHeader().getPacketNumberSpace();
+  CHECK_EQ(builderPnSpace, PacketNumberSpace::AppData);
+  RegularQuicPacketBuilder regularBuilder(
+      conn_.udpSendPacketLen,
+      builder.getPacketHeader(),
+      getAckState(conn_, builderPnSpace).largestAckedByPeer,
+      conn_.version.value_or(*conn_.originalVersion));
+  PacketRebuilder rebuilder(regularBuilder, conn_);
+  // Rebuilder will write the rest of frames
+  auto rebuildResult = rebuilder.rebuildFromPacket(packet);
+  if (!rebuildResult) {
+    return std::make_pair(folly::none, folly::none);
+  }
+  return std::make_pair(
+      std::move(rebuildResult), std::move(regularBuilder).buildPacket());
+}
+
 std::string CloningScheduler::name() const {
   return name_;
 }
@@ -16,6 +16,7 @@
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/state/QPRFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 
 namespace quic {
@@ -61,10 +62,14 @@ class RetransmissionScheduler {
   explicit RetransmissionScheduler(const QuicConnectionStateBase& conn);
 
   void writeRetransmissionStreams(PacketBuilderInterface& builder);
+  void writeRetransmissionStreams(RegularPacketBuilderWrapper& builder);
 
   bool hasPendingData() const;
 
  private:
+  template <typename BuilderType>
+  void writeRetransmissionStreamsImpl(BuilderType& builder);
+
   const QuicConnectionStateBase& conn_;
 };
 
@@ -77,6 +82,7 @@ class StreamFrameScheduler {
    * is written into the packet by writeStreams function.
    */
   void writeStreams(PacketBuilderInterface& builder);
+  void writeStreams(RegularPacketBuilderWrapper& builder);
 
   bool hasPendingData() const;
 
@@ -162,16 +168,79 @@ class StreamFrameScheduler {
   using WritableStreamItr =
       MiddleStartingIterationWrapper::MiddleStartingIterator;
 
+  // The helpers below are templated on the builder so that the
+  // RegularPacketBuilderWrapper overload doesn't go through
+  // PacketBuilderInterface. They are only instantiated in the .cpp.
+  template <typename BuilderType>
+  void writeStreamsImpl(BuilderType& builder);
+
+  /**
+   * Writes the streams that have data with a delivery deadline, earliest
+   * deadline first, and adds them to written.
+   *
+   * Return: whether every such stream got to write, so that the priority
+   *   groups can be scheduled.
+   */
+  template <typename BuilderType>
+  bool writeStreamsByDeadline(
+      BuilderType& builder,
+      uint64_t& connWritableBytes,
+      std::set<StreamId>& written);
+
+  /**
+   * Writes the streams of an incremental priority group that are not in
+   * written in a round robin fashion, starting from
+   * conn.schedulingState.nextScheduledStream. With fillPacketsWithStreams,
+   * adds the streams it writes to written.
+   *
+   * Return: whether every stream of the group got to write, so that the next
+   *   group can be scheduled.
+   */
+  template <typename BuilderType>
+  bool writeStreamsRoundRobin(
+      BuilderType& builder,
+      const std::set<StreamId>& streams,
+      std::set<StreamId>& written,
+      uint64_t& connWritableBytes);
+
+  /**
+   * Writes the streams of a non-incremental priority group that are not in
+   * written one after the other in stream id order. With
+   * fillPacketsWithStreams, adds the streams it writes to written.
+   *
+   * Return: whether every stream of the group got to write, so that the next
+   *   group can be scheduled.
+   */
+  template <typename BuilderType>
+  bool writeStreamsSequentially(
+      BuilderType& builder,
+      const std::set<StreamId>& streams,
+      std::set<StreamId>& written,
+      uint64_t& connWritableBytes);
+
+  /**
+   * Writes a frame for each of the writable streams not in written that fit
+   * in the rest of the packet, in priority order. Used once a stream didn't
+   * fit, so that the smaller frames of the others fill the tail.
+   */
+  template <typename BuilderType>
+  void fillPacketWithStreams(
+      BuilderType& builder,
+      std::set<StreamId>& written,
+      uint64_t& connWritableBytes);
+
   /**
    * Helper function to write either stream data if stream is not flow
    * controlled or a blocked frame otherwise.
    *
    * Return: boolean indicates if anything (either data, or Blocked frame) is
-   *   written into the packet.
+   *   written into the packet, or if the stream is skipped because it is over
+   *   its send rate limit.
    *
    */
+  template <typename BuilderType>
   bool writeNextStreamFrame(
-      PacketBuilderInterface& builder,
+      BuilderType& builder,
       StreamId streamId,
       uint64_t& connWritableBytes);
 
@@ -182,10 +251,10 @@ class AckScheduler {
  public:
   AckScheduler(const QuicConnectionStateBase& conn, const AckState& ackState);
 
-  template <typename ClockType = Clock>
-  folly::Optional<PacketNum> writeNextAcks(
-      PacketBuilderInterface& builder,
-      AckMode mode);
+  template <
+      typename ClockType = Clock,
+      typename BuilderType = PacketBuilderInterface>
+  folly::Optional<PacketNum> writeNextAcks(BuilderType& builder, AckMode mode);
 
   bool hasPendingAcks() const;
 
@@ -193,13 +262,12 @@ class AckScheduler {
   /* Write out pending acks if needsToSendAckImmeidately in the connection's
    * pendingEvent is true.
    */
-  template <typename ClockType>
-  folly::Optional<PacketNum> writeAcksIfPending(
-      PacketBuilderInterface& builder);
+  template <typename ClockType, typename BuilderType>
+  folly::Optional<PacketNum> writeAcksIfPending(BuilderType& builder);
 
   // Write out pending acks
-  template <typename ClockType>
-  folly::Optional<PacketNum> writeAcksImpl(PacketBuilderInterface& builder);
+  template <typename ClockType, typename BuilderType>
+  folly::Optional<PacketNum> writeAcksImpl(BuilderType& builder);
 
   const QuicConnectionStateBase& conn_;
   const AckState& ackState_;
@@ -244,6 +312,22 @@ class SimpleFrameScheduler {
   const QuicConnectionStateBase& conn_;
 };
 
+/*
+ * Writes the queued datagrams of the app, oldest first. They are taken off
+ * the queue when the packet is sent, and not retransmitted.
+ */
+class DatagramFrameScheduler {
+ public:
+  explicit DatagramFrameScheduler(const QuicConnectionStateBase& conn);
+
+  bool hasPendingDatagrams() const;
+
+  bool writeDatagramFrames(PacketBuilderInterface& builder);
+
+ private:
+  const QuicConnectionStateBase& conn_;
+};
+
 class WindowUpdateScheduler {
  public:
   explicit WindowUpdateScheduler(const QuicConnectionStateBase& conn);
@@ -322,6 +406,7 @@ class FrameScheduler : public QuicPacketScheduler {
     Builder& blockedFrames();
     Builder& cryptoFrames();
     Builder& simpleFrames();
+    Builder& datagramFrames();
 
     FrameScheduler build() &&;
 
@@ -340,6 +425,7 @@ class FrameScheduler : public QuicPacketScheduler {
     bool blockedScheduler_{false};
     bool cryptoStreamScheduler_{false};
     bool simpleFrameScheduler_{false};
+    bool datagramFrameScheduler_{false};
   };
 
   explicit FrameScheduler(std::string name);
@@ -368,6 +454,7 @@ class FrameScheduler : public QuicPacketScheduler {
   folly::Optional<BlockedScheduler> blockedScheduler_;
   folly::Optional<CryptoStreamScheduler> cryptoStreamScheduler_;
   folly::Optional<SimpleFrameScheduler> simpleFrameScheduler_;
+  folly::Optional<DatagramFrameScheduler> datagramFrameScheduler_;
   std::string name_;
 };
 
@@ -408,6 +495,15 @@ class CloningScheduler : public QuicPacketScheduler {
   std::string name() const override;
 
  private:
+  bool canClone(const OutstandingPacket& packet) const;
+  OutstandingPacket* findOutstandingPacket(PacketNum packetNum);
+  std::pair<
+      folly::Optional<PacketEvent>,
+      folly::Optional<RegularQuicPacketBuilder::Packet>>
+  cloneFromPacket(
+      OutstandingPacket& packet,
+      const RegularQuicPacketBuilder& builder);
+
   FrameScheduler& frameScheduler_;
   QuicConnectionStateBase& conn_;
   std::string name_;
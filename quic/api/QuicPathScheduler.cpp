@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicPathScheduler.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace quic {
+
+namespace {
+struct PathCandidate {
+  PathId pathId;
+  std::chrono::microseconds srtt;
+  uint64_t weight;
+  // Packets the cwnd of the path has room for
+  uint64_t cwndPackets;
+};
+
+uint64_t cwndPackets(
+    const CongestionController* congestionController,
+    uint64_t packetLen) {
+  if (!congestionController) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  auto writableBytes = congestionController->getWritableBytes();
+  return writableBytes / packetLen + (writableBytes % packetLen ? 1 : 0);
+}
+} // namespace
+
+std::vector<PathWrite> schedulePathWrites(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit) {
+  std::vector<PathWrite> writes;
+  auto packetLen = std::max<uint64_t>(conn.udpSendPacketLen, 1);
+  std::vector<PathCandidate> candidates;
+  candidates.reserve(conn.secondaryPaths.size() + 1);
+  candidates.push_back(PathCandidate{
+      kPrimaryPathId,
+      conn.lossState.srtt,
+      conn.transportSettings.primaryPathWeight,
+      std::max<uint64_t>(
+          cwndPackets(conn.congestionController.get(), packetLen), 1)});
+  for (const auto& path : conn.secondaryPaths) {
+    if (!path.congestionController) {
+      continue;
+    }
+    auto packets = cwndPackets(path.congestionController.get(), packetLen);
+    if (packets > 0) {
+      candidates.push_back(
+          PathCandidate{path.id, path.srtt, path.weight, packets});
+    }
+  }
+  if (candidates.size() == 1 || packetLimit == 0) {
+    writes.push_back(PathWrite{kPrimaryPathId, packetLimit});
+    return writes;
+  }
+
+  switch (conn.transportSettings.pathScheduler) {
+    case PathSchedulerType::MinRtt: {
+      std::stable_sort(
+          candidates.begin(),
+          candidates.end(),
+          [](const PathCandidate& lhs, const PathCandidate& rhs) {
+            return lhs.srtt < rhs.srtt;
+          });
+      // One packet stays set aside for the primary path.
+      uint64_t remaining = packetLimit - 1;
+      for (const auto& candidate : candidates) {
+        bool primary = candidate.pathId == kPrimaryPathId;
+        auto packets = std::min(remaining, candidate.cwndPackets);
+        remaining -= packets;
+        if (primary) {
+          ++packets;
+        }
+        if (packets > 0) {
+          writes.push_back(PathWrite{candidate.pathId, packets});
+        }
+      }
+      break;
+    }
+    case PathSchedulerType::Weighted: {
+      uint64_t totalWeight = 0;
+      for (const auto& candidate : candidates) {
+        totalWeight += candidate.weight;
+      }
+      // What the secondary paths don't take, because of their cwnd or of the
+      // rounding, goes to the primary path, which is written first.
+      uint64_t remaining = packetLimit;
+      std::vector<PathWrite> secondaryWrites;
+      for (const auto& candidate : candidates) {
+        if (candidate.pathId == kPrimaryPathId || totalWeight == 0) {
+          continue;
+        }
+        auto share = std::min(
+            packetLimit * candidate.weight / totalWeight,
+            candidate.cwndPackets);
+        share = std::min(share, remaining - 1);
+        if (share > 0) {
+          remaining -= share;
+          secondaryWrites.push_back(PathWrite{candidate.pathId, share});
+        }
+      }
+      writes.push_back(PathWrite{kPrimaryPathId, remaining});
+      writes.insert(
+          writes.end(), secondaryWrites.begin(), secondaryWrites.end());
+      break;
+    }
+  }
+  return writes;
+}
+
+ScopedPathWrite::ScopedPathWrite(
+    QuicConnectionStateBase& conn,
+    SecondaryPath& path)
+    : conn_(conn), path_(path) {
+  DCHECK_EQ(conn_.writePathId, kPrimaryPathId);
+  conn_.writePathId = path_.id;
+  std::swap(conn_.peerAddress, path_.peerAddress);
+  std::swap(conn_.congestionController, path_.congestionController);
+  pacer_ = std::move(conn_.pacer);
+}
+
+ScopedPathWrite::~ScopedPathWrite() {
+  conn_.pacer = std::move(pacer_);
+  std::swap(conn_.congestionController, path_.congestionController);
+  std::swap(conn_.peerAddress, path_.peerAddress);
+  conn_.writePathId = kPrimaryPathId;
+}
+} // namespace quic
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+struct PathWrite {
+  PathId pathId;
+  uint64_t packetLimit;
+};
+
+/**
+ * Spreads the packetLimit packets of a write over the primary path and the
+ * secondary paths of conn, in the order they should be written, following
+ * TransportSettings::pathScheduler. The FrameScheduler of every write then
+ * picks the frames, so the paths share the stream data. A secondary path is
+ * only scheduled when its cwnd has room for a packet. The primary path always
+ * is, with at least one packet, since the acks and the handshake data go out
+ * on it.
+ */
+std::vector<PathWrite> schedulePathWrites(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit);
+
+/**
+ * Points the connection at a secondary path for the duration of a write: the
+ * packets written in the meantime go to the peer address of the path, are
+ * gated by its congestion controller and are accounted to it once acked or
+ * lost. The writes on a secondary path aren't paced.
+ */
+class ScopedPathWrite {
+ public:
+  ScopedPathWrite(QuicConnectionStateBase& conn, SecondaryPath& path);
+  ~ScopedPathWrite();
+
+  ScopedPathWrite(const ScopedPathWrite&) = delete;
+  ScopedPathWrite& operator=(const ScopedPathWrite&) = delete;
+
+ private:
+  QuicConnectionStateBase& conn_;
+  SecondaryPath& path_;
+  std::unique_ptr<Pacer> pacer_;
+};
+} // namespace quic
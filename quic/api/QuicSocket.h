@@ -10,9 +10,13 @@
 
 #include <folly/Expected.h>
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
+#include <folly/portability/IOVec.h>
 #include <quic/QuicConstants.h>
+#include <quic/api/QuicFrameTemplates.h>
 #include <quic/codec/Types.h>
+#include <quic/state/QuicStreamUtilities.h>
 #include <quic/state/StateData.h>
 
 #include <chrono>
@@ -52,6 +56,21 @@ class QuicSocket {
      */
     virtual void onNewUnidirectionalStream(StreamId id) noexcept = 0;
 
+    /**
+     * Invoked with batchNewPeerStreamCallbacks instead of the two above, with
+     * all the streams the peer created since the last call, in order. By
+     * default it invokes the ones above for each stream.
+     */
+    virtual void onNewStreams(folly::Range<const StreamId*> ids) noexcept {
+      for (auto id : ids) {
+        if (quic::isBidirectionalStream(id)) {
+          onNewBidirectionalStream(id);
+        } else {
+          onNewUnidirectionalStream(id);
+        }
+      }
+    }
+
     /**
      * Invokved when a stream receives a StopSending frame from a peer.
      */
@@ -106,6 +125,27 @@ class QuicSocket {
     uint64_t totalBytesRetransmitted{0};
     uint32_t ptoCount{0};
     uint32_t totalPTOCount{0};
+    // Packets declared lost and then acked, and loss reactions the congestion
+    // controller undid for them, with rackLossDetection
+    uint32_t spuriousLossCount{0};
+    uint32_t congestionUndoCount{0};
+    // Estimated CPU cycles spent on the connection, indexed by
+    // QuicTransportStatsCallback::CpuCostType, with cpuCostSamplingRate
+    std::array<uint64_t, CpuCostState::kNumTypes> cpuCycles{};
+    // The time spent with data to send or in flight, and the parts of it the
+    // writes were held back by nothing left to send, the congestion window,
+    // the flow control of the peer or the pacer, see WriteLimit
+    std::chrono::microseconds busyTime{0us};
+    std::chrono::microseconds appLimitedTime{0us};
+    std::chrono::microseconds cwndLimitedTime{0us};
+    std::chrono::microseconds flowControlLimitedTime{0us};
+    std::chrono::microseconds pacingLimitedTime{0us};
+    // The sums over the write loops, with writeLoopStats
+    WriteLoopStats writeLoopStats;
+    // In bytes per second, the rate of the latest delivery sample and the
+    // bandwidth estimate of the congestion controller, if it keeps one
+    uint64_t deliveryRate{0};
+    uint64_t bandwidthEstimate{0};
     PacketNum largestPacketAckedByPeer{0};
     PacketNum largestPacketSent{0};
   };
@@ -412,6 +452,44 @@ class QuicSocket {
    */
   virtual void unsetAllReadCallbacks() = 0;
 
+  /**
+   * The data read off one stream for the BatchReadCallback.
+   */
+  struct StreamReadResult {
+    StreamId id;
+    Buf data;
+    bool eof{false};
+    // Set instead of the data when there is an error on the stream, the
+    // stream isn't handed over again.
+    folly::Optional<QuicErrorCode> error;
+
+    explicit StreamReadResult(StreamId idIn) : id(idIn) {}
+  };
+
+  /**
+   * Callback class for receiving the data of many streams at once
+   */
+  class BatchReadCallback {
+   public:
+    virtual ~BatchReadCallback() = default;
+
+    /**
+     * Called from the transport layer with all the data, EOFs and errors
+     * read off the readable streams in one pass. The results are only valid
+     * during the call, the data can be moved out of them.
+     */
+    virtual void readAvailable(
+        folly::Range<StreamReadResult*> results) noexcept = 0;
+  };
+
+  /**
+   * Set the callback that streams without their own ReadCallback are read
+   * into, instead of the data waiting for read(). Streams with a
+   * ReadCallback keep using it. Useful with many small streams, it saves a
+   * callback and a read() per stream. nullptr turns it off.
+   */
+  virtual void setBatchReadCallback(BatchReadCallback* cb) = 0;
+
   /**
    * Convenience function that sets the read callbacks of all streams to be
    * nullptr.
@@ -466,11 +544,28 @@ class QuicSocket {
    *
    * Calling read() when there is no data/eof to deliver will return an
    * EAGAIN-like error code.
+   *
+   * The data is the chain of the received buffers as they are, it is never
+   * coalesced or copied, so it can be spliced into another write as is. The
+   * buffers may share the memory of the packets they were received in.
    */
   virtual folly::Expected<std::pair<Buf, bool>, LocalErrorCode> read(
       StreamId id,
       size_t maxLen) = 0;
 
+  /**
+   * Same as read(), but copies the data into the caller's buffers, up to
+   * their total length, instead of handing over the received chain. The
+   * buffers can be reused across the reads, so a caller that needs the data
+   * contiguous doesn't need to coalesce or allocate.
+   *
+   * value() returns a pair of the number of bytes copied and the EOF marker.
+   */
+  virtual folly::Expected<std::pair<size_t, bool>, LocalErrorCode> readInto(
+      StreamId id,
+      const struct iovec* vec,
+      size_t count) = 0;
+
   /**
    * ===== Peek/Consume API =====
    */
@@ -494,7 +589,8 @@ class QuicSocket {
    * };
    */
 
-  using PeekIterator = std::deque<StreamBuffer>::const_iterator;
+  // The buffers are sorted by offset. The iterators are bidirectional.
+  using PeekIterator = StreamReadBuffer::const_iterator;
   class PeekCallback {
    public:
     virtual ~PeekCallback() = default;
@@ -628,6 +724,18 @@ class QuicSocket {
   virtual folly::Expected<folly::Optional<uint64_t>, LocalErrorCode>
   sendDataRejected(StreamId id, uint64_t offset) = 0;
 
+  /**
+   * Set the delivery deadline of the data written to the stream from now on.
+   * The data that is not delivered within the deadline is expired instead of
+   * being retransmitted, and data with a deadline is scheduled ahead of the
+   * data without one, earliest deadline first. A zero deadline clears it.
+   * Requires partial reliability.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode>
+  setStreamDeliveryDeadline(
+      StreamId id,
+      std::chrono::microseconds deadline) = 0;
+
   /**
    * ===== Write API =====
    */
@@ -696,6 +804,8 @@ class QuicSocket {
      * maxToSend represents the amount of data that the transport layer expects
      * to write to the network during this event loop, eg:
      *   min(remaining flow control, remaining send buffer space)
+     * It is at least the low watermark of the stream, see
+     * setStreamWriteLowWatermark.
      */
     virtual void onStreamWriteReady(
         StreamId /* id */,
@@ -708,6 +818,8 @@ class QuicSocket {
      * maxToSend represents the amount of data that the transport layer expects
      * to write to the network during this event loop, eg:
      *   min(remaining flow control, remaining send buffer space)
+     * It is at least the low watermark of the connection, see
+     * setConnectionWriteLowWatermark.
      */
     virtual void onConnectionWriteReady(uint64_t /* maxToSend */) noexcept {}
 
@@ -745,6 +857,24 @@ class QuicSocket {
   virtual folly::Expected<folly::Unit, LocalErrorCode>
   notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) = 0;
 
+  /**
+   * Only invoke onStreamWriteReady for the stream once it can take at least
+   * lowWatermark bytes, so that the app writes in large chunks instead of
+   * being woken up for every bit of space that frees up. The callback still
+   * fires with less when nothing of the stream is waiting to be sent, when
+   * only more flow control from the peer can give it more room.
+   * It applies to the callbacks registered before and after the call, 0,
+   * the default, invokes them as soon as any byte can be written.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode>
+  setStreamWriteLowWatermark(StreamId id, uint64_t lowWatermark) = 0;
+
+  /**
+   * The same as setStreamWriteLowWatermark, for onConnectionWriteReady.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode>
+  setConnectionWriteLowWatermark(uint64_t lowWatermark) = 0;
+
   /**
    * Callback class for receiving ack notifications
    */
@@ -772,9 +902,11 @@ class QuicSocket {
    * Write data/eof to the given stream.
    *
    * cork indicates to the transport that the application expects to write
-   * more data soon.  Passing a delivery callback registers a callback from the
-   * transport when the peer has acknowledged the receipt of all the data/eof
-   * passed to write.
+   * more data soon.  Unless a full packet of data is waiting to be sent, the
+   * transport then builds the packets in the next event loop iteration
+   * instead of this one, so that the writes that follow share them.  Passing
+   * a delivery callback registers a callback from the transport when the peer
+   * has acknowledged the receipt of all the data/eof passed to write.
    *
    * A returned IOBuf indicates that the passed data exceeded the transport
    * flow control window or send buffer space.  The application must call write
@@ -792,6 +924,66 @@ class QuicSocket {
       bool cork,
       DeliveryCallback* cb = nullptr) = 0;
 
+  /**
+   * A buffer owned by the application, see writeBuffers().
+   */
+  struct ExternalBuffer {
+    void* data{nullptr};
+    size_t length{0};
+    // Called with data and userData once the transport doesn't reference the
+    // buffer anymore, which is at the latest when all of it has been acked or
+    // the stream has been reset or closed. Not called when null.
+    folly::IOBuf::FreeFunction releaseFn{nullptr};
+    void* userData{nullptr};
+  };
+
+  /**
+   * Write the buffers, in order, and eof to the given stream, like writeChain
+   * but without taking a copy of the buffers. The stream data is referenced
+   * from the send buffer, the retransmission buffer and the packets being
+   * built, and is only read again when the packets are encrypted, unless
+   * usePacketArena is set. The buffers must not change until released.
+   *
+   * The buffers are always accepted, even past the flow control window, and
+   * released even when the write fails.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeBuffers(
+      StreamId id,
+      std::vector<ExternalBuffer> buffers,
+      bool eof,
+      DeliveryCallback* cb = nullptr) = 0;
+
+  /**
+   * Set the pre-encoded frames writeFrameTemplate() writes, either the
+   * connection's own or ones shared with other connections.
+   */
+  virtual void setFrameTemplates(
+      std::shared_ptr<const QuicFrameTemplates> frameTemplates) = 0;
+
+  /**
+   * Write the pre-encoded frame with the given handle, and eof, to the given
+   * stream, like writeChain. The stream references the buffer of the
+   * template instead of a copy of it, even when the frame is small enough to
+   * be coalesced with the previous writes, see
+   * TransportSettings::writeCoalescingThreshold.
+   *
+   * Returns INVALID_OPERATION if no templates are set or the handle is
+   * unknown.
+   */
+  virtual WriteResult writeFrameTemplate(
+      StreamId id,
+      QuicFrameTemplates::Handle handle,
+      bool eof,
+      bool cork,
+      DeliveryCallback* cb = nullptr) = 0;
+
+  /**
+   * Cork all the writes on the connection, as if they were all passed cork,
+   * until the cork is removed. Removing it sends what the cork held back in
+   * this event loop iteration.
+   */
+  virtual void setWriteCork(bool cork) = 0;
+
   /**
    * Register a callback to be invoked when the peer has acknowledged the
    * given offset on the given stream
@@ -850,6 +1042,47 @@ class QuicSocket {
       PingCallback* callback,
       std::chrono::milliseconds pingTimeout) = 0;
 
+  /**
+   * Callback class for received datagrams
+   */
+  class DatagramCallback {
+   public:
+    virtual ~DatagramCallback() = default;
+
+    /**
+     * Invoked after receiving data when there are datagrams to read with
+     * readDatagrams().
+     */
+    virtual void onDatagramsAvailable() noexcept = 0;
+  };
+
+  /**
+   * Set the callback to notify about received datagrams. The callback may be
+   * nullptr, the datagrams are still buffered up to
+   * TransportSettings::datagramReadBufferSize.
+   */
+  virtual void setDatagramCallback(DatagramCallback* cb) = 0;
+
+  /**
+   * The largest datagram that can be written, 0 if the peer doesn't support
+   * datagrams.
+   */
+  virtual uint16_t getDatagramSizeLimit() const = 0;
+
+  /**
+   * Write an unreliable datagram. It is sent in a DATAGRAM frame that is
+   * never retransmitted, the oldest unsent datagram is dropped when more
+   * than TransportSettings::datagramWriteBufferSize are buffered.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf) = 0;
+
+  /**
+   * Read at most atMost of the received datagrams, all of them if 0.
+   */
+  virtual folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) = 0;
+
   /**
    * Get information on the state of the quic connection. Should only be used
    * for logging.
@@ -890,5 +1123,35 @@ class QuicSocket {
    * createStream() or receiving onNewBidirectionalStream()
    */
   virtual folly::Optional<LocalErrorCode> setControlStream(StreamId id) = 0;
+
+  /**
+   * Set the priority the transport schedules the writes of the stream with.
+   * Streams with a lower level are served first, up to kDefaultMaxPriority.
+   * Streams of the same level are served one after the other if they are not
+   * incremental, and share the bandwidth if they are. See the HTTP/3 priority
+   * scheme for the meaning of the two parameters.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode>
+  setStreamPriority(StreamId id, PriorityLevel level, bool incremental) = 0;
+
+  /**
+   * Cap the pacing rate of the connection at maxRateBytesPerSec, whatever
+   * the congestion controller allows, e.g. for background traffic that
+   * should not compete with the interactive connections. 0 removes the cap.
+   * The connection needs pacingEnabled in its TransportSettings.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setMaxPacingRate(
+      uint64_t maxRateBytesPerSec) = 0;
+
+  /**
+   * Cap the rate the new data of a stream is sent at, with a token bucket
+   * of kStreamSendRateBurstInterval at that rate, while the other streams
+   * use the rest of the cwnd. Retransmissions are not limited. 0 removes the
+   * limit. The stream is sent at the pacing intervals when it runs out of
+   * tokens, so the connection needs pacingEnabled.
+   */
+  virtual folly::Expected<folly::Unit, LocalErrorCode> setStreamMaxSendRate(
+      StreamId id,
+      uint64_t maxRateBytesPerSec) = 0;
 };
 } // namespace quic
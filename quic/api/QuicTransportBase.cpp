@@ -15,6 +15,7 @@
 #include <quic/congestion_control/Pacer.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
@@ -35,6 +36,7 @@ QuicTransportBase::QuicTransportBase(
       idleTimeout_(this),
       drainTimeout_(this),
       pingTimeout_(this),
+      socketWritableHandler_(this),
       readLooper_(new FunctionLooper(
           evb,
           [this](bool /* ignored */) { invokeReadDataAndCallbacks(); },
@@ -50,7 +52,13 @@ QuicTransportBase::QuicTransportBase(
   writeLooper_->setPacingFunction([this]() -> auto {
     if (isConnectionPaced(*conn_)) {
       conn_->pacer->onPacedWriteScheduled(Clock::now());
-      return conn_->pacer->getTimeUntilNextWrite();
+      auto interval = conn_->pacer->getTimeUntilNextWrite();
+      QUIC_SDT(
+          pacing_scheduled,
+          *conn_,
+          interval.count(),
+          conn_->pacer->getCachedWriteBatchSize());
+      return interval;
     }
     return 0us;
   });
@@ -63,6 +71,40 @@ void QuicTransportBase::setPacingTimer(
   }
 }
 
+void QuicTransportBase::setPacingScheduler(
+    PacingScheduler::SharedPtr pacingScheduler) noexcept {
+  if (pacingScheduler) {
+    writeLooper_->setPacingScheduler(std::move(pacingScheduler));
+  }
+}
+
+void QuicTransportBase::setWriteScheduler(
+    WriteScheduler::SharedPtr writeScheduler) noexcept {
+  if (writeScheduler) {
+    writeLooper_->setWriteScheduler(std::move(writeScheduler));
+    writeLooper_->setWriteBudgetExhaustedCallback(
+        [this](
+            std::chrono::microseconds timeSpent,
+            uint64_t packetsWritten,
+            size_t numDeferred) {
+          if (conn_->loopDetectorCallback) {
+            conn_->loopDetectorCallback->onWriteBudgetExhausted(
+                timeSpent, packetsWritten, numDeferred);
+          }
+        });
+  }
+}
+
+void QuicTransportBase::setBufferMemoryBudget(
+    BufferMemoryBudget::SharedPtr budget) noexcept {
+  if (conn_->bufferMemoryBudget) {
+    conn_->bufferMemoryBudget->update(bufferMemoryCharged_, 0);
+    bufferMemoryCharged_ = 0;
+  }
+  conn_->bufferMemoryBudget = std::move(budget);
+  updateBufferMemoryBudget();
+}
+
 void QuicTransportBase::setCongestionControllerFactory(
     std::shared_ptr<CongestionControllerFactory> ccFactory) {
   CHECK(ccFactory);
@@ -156,8 +198,8 @@ void QuicTransportBase::closeNow(
   // case, our close would not take effect. This cancels the drain timeout in
   // this case and expires the timeout.
   // TODO: fix this in a better way.
-  if (drainTimeout_.isScheduled()) {
-    drainTimeout_.cancelTimeout();
+  if (isTimeoutScheduled(&drainTimeout_)) {
+    cancelTimeout(&drainTimeout_);
     drainTimeoutExpired();
   }
 
@@ -253,6 +295,7 @@ void QuicTransportBase::closeImpl(
 
   // TODO: truncate the error code string to be 1MSS only.
   closeState_ = CloseState::CLOSED;
+  updateBufferMemoryBudget();
   updatePacingOnClose(*conn_);
   auto cancelCode = std::make_pair(
       QuicErrorCode(LocalErrorCode::NO_ERROR),
@@ -308,23 +351,19 @@ void QuicTransportBase::closeImpl(
         "no_error");
   }
   cancelLossTimeout();
-  if (ackTimeout_.isScheduled()) {
-    ackTimeout_.cancelTimeout();
-  }
-  if (pathValidationTimeout_.isScheduled()) {
-    pathValidationTimeout_.cancelTimeout();
-  }
-  if (idleTimeout_.isScheduled()) {
-    idleTimeout_.cancelTimeout();
-  }
-  if (pingTimeout_.isScheduled()) {
-    pingTimeout_.cancelTimeout();
-  }
+  cancelTimeout(&ackTimeout_);
+  cancelTimeout(&pathValidationTimeout_);
+  cancelTimeout(&idleTimeout_);
+  cancelTimeout(&pingTimeout_);
 
   VLOG(10) << "Stopping read looper due to immediate close " << *this;
   readLooper_->stop();
   peekLooper_->stop();
   writeLooper_->stop();
+  // The packets waiting for the socket are dropped, the close goes out
+  // without them.
+  socketWritableHandler_.unregisterHandler();
+  conn_->sendBlocked.clear();
 
   // TODO: invoke connection close callbacks.
   cancelAllAppCallbacks(cancelCode);
@@ -348,6 +387,9 @@ void QuicTransportBase::closeImpl(
   conn_->ackStates.initialAckState.acks.clear();
   conn_->ackStates.handshakeAckState.acks.clear();
   conn_->ackStates.appDataAckState.acks.clear();
+  conn_->ackStates.initialAckState.acksEncoding.invalidate();
+  conn_->ackStates.handshakeAckState.acksEncoding.invalidate();
+  conn_->ackStates.appDataAckState.acksEncoding.invalidate();
 
   // connCallback_ could be null if start() was never invoked and the
   // transport was destroyed or if the app initiated close.
@@ -381,6 +423,7 @@ void QuicTransportBase::closeImpl(
 
   // Don't need outstanding packets.
   conn_->outstandingPackets.clear();
+  conn_->outstandingPacketEvents.clear();
   conn_->outstandingHandshakePacketsCount = 0;
   conn_->outstandingPureAckPacketsCount = 0;
 
@@ -401,11 +444,14 @@ void QuicTransportBase::closeImpl(
   drainConnection = drainConnection && !isReset && !isAbandon;
   if (drainConnection) {
     // We ever drain once, and the object ever gets created once.
-    DCHECK(!drainTimeout_.isScheduled());
-    getEventBase()->timer().scheduleTimeout(
-        &drainTimeout_,
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            kDrainFactor * calculatePTO(*conn_)));
+    DCHECK(!isTimeoutScheduled(&drainTimeout_));
+    auto drainPeriod = std::chrono::duration_cast<std::chrono::milliseconds>(
+        kDrainFactor * calculatePTO(*conn_));
+    if (handOffDraining(drainPeriod)) {
+      drainTimeoutExpired();
+    } else {
+      scheduleTimeout(&drainTimeout_, drainPeriod);
+    }
   } else {
     drainTimeoutExpired();
   }
@@ -520,6 +566,30 @@ QuicSocket::TransportInfo QuicTransportBase::getTransportInfo() const {
   transportInfo.bytesRecvd = conn_->lossState.totalBytesRecvd;
   transportInfo.ptoCount = conn_->lossState.ptoCount;
   transportInfo.totalPTOCount = conn_->lossState.totalPTOCount;
+  transportInfo.spuriousLossCount = conn_->lossState.spuriousLossCount;
+  transportInfo.congestionUndoCount = conn_->lossState.congestionUndoCount;
+  transportInfo.cpuCycles = conn_->cpuCosts.cycles;
+  transportInfo.writeLoopStats = conn_->writeLoopStats;
+  auto now = Clock::now();
+  for (size_t i = 0; i < WriteLimitState::kNumLimits; ++i) {
+    auto limit = static_cast<WriteLimit>(i);
+    if (limit != WriteLimit::Idle) {
+      transportInfo.busyTime += getWriteLimitTime(*conn_, limit, now);
+    }
+  }
+  transportInfo.appLimitedTime =
+      getWriteLimitTime(*conn_, WriteLimit::AppLimited, now);
+  transportInfo.cwndLimitedTime =
+      getWriteLimitTime(*conn_, WriteLimit::CwndLimited, now);
+  transportInfo.flowControlLimitedTime =
+      getWriteLimitTime(*conn_, WriteLimit::FlowControlLimited, now);
+  transportInfo.pacingLimitedTime =
+      getWriteLimitTime(*conn_, WriteLimit::PacingLimited, now);
+  transportInfo.deliveryRate = conn_->lossState.deliveryRate;
+  if (conn_->congestionController) {
+    transportInfo.bandwidthEstimate =
+        conn_->congestionController->getBandwidthEstimate();
+  }
   transportInfo.largestPacketAckedByPeer =
       conn_->ackStates.appDataAckState.largestAckedByPeer;
   transportInfo.largestPacketSent = conn_->lossState.largestSent;
@@ -547,9 +617,13 @@ uint64_t QuicTransportBase::bufferSpaceAvailable() const {
   auto bytesBuffered = conn_->flowControlState.sumCurStreamBufferLen;
   auto totalBufferSpaceAvailable =
       conn_->transportSettings.totalBufferSpaceAvailable;
-  return bytesBuffered > totalBufferSpaceAvailable
+  auto available = bytesBuffered > totalBufferSpaceAvailable
       ? 0
       : totalBufferSpaceAvailable - bytesBuffered;
+  if (conn_->bufferMemoryBudget) {
+    available = std::min(available, conn_->bufferMemoryBudget->available());
+  }
+  return available;
 }
 
 folly::Expected<QuicSocket::FlowControlState, LocalErrorCode>
@@ -733,6 +807,12 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
   for (const auto& streamId : readableListCopy) {
     auto callback = self->readCallbacks_.find(streamId);
     if (callback == self->readCallbacks_.end()) {
+      if (self->batchReadCallback_) {
+        self->readIntoBatch(streamId);
+        if (self->closeState_ != CloseState::OPEN) {
+          break;
+        }
+      }
       self->conn_->streamManager->readableStreams().erase(streamId);
       continue;
     }
@@ -760,6 +840,62 @@ void QuicTransportBase::invokeReadDataAndCallbacks() {
       readCb->readAvailable(streamId);
     }
   }
+  self->invokeBatchReadCallback();
+}
+
+void QuicTransportBase::readIntoBatch(StreamId id) {
+  auto stream = conn_->streamManager->getStream(id);
+  if (!stream) {
+    return;
+  }
+  if (stream->streamReadError) {
+    VLOG(10) << "Batching read error on stream=" << id << " " << *this;
+    batchReadResults_.emplace_back(id);
+    batchReadResults_.back().error = *stream->streamReadError;
+    return;
+  }
+  if (!stream->hasReadableData()) {
+    return;
+  }
+  try {
+    auto result = readDataFromQuicStream(*stream);
+    batchReadResults_.emplace_back(id);
+    batchReadResults_.back().data = std::move(result.first);
+    batchReadResults_.back().eof = result.second;
+  } catch (const QuicTransportException& ex) {
+    VLOG(4) << "batch read error " << ex.what() << " " << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+  } catch (const QuicInternalException& ex) {
+    VLOG(4) << "batch read error " << ex.what() << " " << *this;
+    closeImpl(
+        std::make_pair(QuicErrorCode(ex.errorCode()), std::string(ex.what())));
+  } catch (const std::exception& ex) {
+    VLOG(4) << "batch read error " << ex.what() << " " << *this;
+    closeImpl(std::make_pair(
+        QuicErrorCode(TransportErrorCode::INTERNAL_ERROR),
+        std::string(ex.what())));
+  }
+}
+
+void QuicTransportBase::invokeBatchReadCallback() {
+  if (batchReadResults_.empty()) {
+    return;
+  }
+  SCOPE_EXIT {
+    batchReadResults_.clear();
+  };
+  if (closeState_ != CloseState::OPEN || !batchReadCallback_) {
+    return;
+  }
+  VLOG(10) << "invoking batch read callback for "
+           << batchReadResults_.size() << " streams " << *this;
+  batchReadCallback_->readAvailable(folly::range(batchReadResults_));
+}
+
+void QuicTransportBase::setBatchReadCallback(BatchReadCallback* cb) {
+  batchReadCallback_ = cb;
+  updateReadLooper();
 }
 
 void QuicTransportBase::updateReadLooper() {
@@ -771,10 +907,12 @@ void QuicTransportBase::updateReadLooper() {
   auto iter = std::find_if(
       conn_->streamManager->readableStreams().begin(),
       conn_->streamManager->readableStreams().end(),
-      [& readCallbacks = readCallbacks_](StreamId s) {
+      [& readCallbacks = readCallbacks_,
+       batchRead = batchReadCallback_ != nullptr](StreamId s) {
         auto readCb = readCallbacks.find(s);
         if (readCb == readCallbacks.end()) {
-          return false;
+          // Read into the batch, or only dropped from the readable streams.
+          return batchRead;
         }
         // TODO: if the stream has an error and it is also paused we should
         // still return an error
@@ -1084,6 +1222,49 @@ QuicTransportBase::sendDataRejected(StreamId id, uint64_t offset) {
   return folly::makeExpected<LocalErrorCode>(newOffset);
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamDeliveryDeadline(
+    StreamId id,
+    std::chrono::microseconds deadline) {
+  if (!conn_->partialReliabilityEnabled) {
+    return folly::makeUnexpected(LocalErrorCode::APP_ERROR);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  auto stream = conn_->streamManager->getStream(id);
+  if (!stream) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  VLOG(4) << "Setting delivery deadline for stream=" << id
+          << " deadline=" << deadline.count() << "us " << *this;
+  if (deadline == 0us) {
+    stream->deliveryDeadline = folly::none;
+  } else {
+    stream->deliveryDeadline = deadline;
+  }
+  return folly::unit;
+}
+
+void QuicTransportBase::expireDataPastDeadlines() {
+  // Copy the ids since expiring may remove streams from the set.
+  std::vector<StreamId> deadlineStreams(
+      conn_->streamManager->deadlineStreams().begin(),
+      conn_->streamManager->deadlineStreams().end());
+  auto now = Clock::now();
+  for (auto streamId : deadlineStreams) {
+    auto stream = conn_->streamManager->findStream(streamId);
+    if (!stream) {
+      conn_->streamManager->removeDeadline(streamId);
+      continue;
+    }
+    auto newOffset = expireDataPastDeadline(stream, now);
+    if (newOffset) {
+      cancelDeliveryCallbacksForStream(streamId, *newOffset);
+    }
+  }
+}
+
 void QuicTransportBase::updatePeekLooper() {
   if (closeState_ != CloseState::OPEN) {
     VLOG(10) << "Stopping peek looper " << *this;
@@ -1121,13 +1302,50 @@ void QuicTransportBase::updatePeekLooper() {
   }
 }
 
+void QuicTransportBase::reclaimBufferMemory() noexcept {
+  if (closeState_ == CloseState::CLOSED) {
+    return;
+  }
+  conn_->streamManager->streamStateForEach([](QuicStreamState& stream) {
+    reclaimStreamBufferMemory(stream, true);
+  });
+}
+
+void QuicTransportBase::updateBufferMemoryBudget() {
+  if (!conn_->bufferMemoryBudget) {
+    return;
+  }
+  uint64_t bytesBuffered = 0;
+  if (closeState_ != CloseState::CLOSED) {
+    // The retransmission buffers are bounded by the congestion window, only
+    // the data waiting on the peer or on the application is charged.
+    const auto& flowControlState = conn_->flowControlState;
+    bytesBuffered = flowControlState.sumCurStreamBufferLen;
+    if (flowControlState.sumMaxObservedOffset >
+        flowControlState.sumCurReadOffset) {
+      bytesBuffered += flowControlState.sumMaxObservedOffset -
+          flowControlState.sumCurReadOffset;
+    }
+  }
+  conn_->bufferMemoryBudget->update(bufferMemoryCharged_, bytesBuffered);
+  bufferMemoryCharged_ = bytesBuffered;
+}
+
 void QuicTransportBase::updateWriteLooper(bool thisIteration) {
+  updateBufferMemoryBudget();
   if (closeState_ == CloseState::CLOSED) {
     VLOG(10) << nodeToString(conn_->nodeType)
              << " stopping write looper because conn closed " << *this;
     writeLooper_->stop();
     return;
   }
+  if (conn_->sendBlocked) {
+    VLOG(10) << nodeToString(conn_->nodeType)
+             << " stopping write looper until the socket is writable "
+             << *this;
+    writeLooper_->stop();
+    return;
+  }
   // TODO: Also listens to write event from libevent. Only schedule write when
   // the socket itself is writable.
   auto writeDataReason = shouldWriteData(*conn_);
@@ -1217,9 +1435,10 @@ void QuicTransportBase::cancelDeliveryCallbacksForStream(
   }
 }
 
-folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
+template <typename T, typename ReadFn>
+folly::Expected<std::pair<T, bool>, LocalErrorCode> QuicTransportBase::readImpl(
     StreamId id,
-    size_t maxLen) {
+    ReadFn&& readFn) {
   if (isSendingStream(conn_->nodeType, id)) {
     return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
   }
@@ -1246,7 +1465,7 @@ folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
       // by the stream existence check, but might as well check this.
       return folly::makeUnexpected(LocalErrorCode::STREAM_CLOSED);
     }
-    auto result = readDataFromQuicStream(*stream, maxLen);
+    auto result = readFn(*stream);
     if (result.second) {
       VLOG(10) << "Delivered eof to app for stream=" << stream->id << " "
                << *this;
@@ -1278,6 +1497,25 @@ folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
   }
 }
 
+folly::Expected<std::pair<Buf, bool>, LocalErrorCode> QuicTransportBase::read(
+    StreamId id,
+    size_t maxLen) {
+  return readImpl<Buf>(id, [maxLen](QuicStreamState& stream) {
+    return readDataFromQuicStream(stream, maxLen);
+  });
+}
+
+folly::Expected<std::pair<size_t, bool>, LocalErrorCode>
+QuicTransportBase::readInto(
+    StreamId id,
+    const struct iovec* vec,
+    size_t count) {
+  return readImpl<size_t>(id, [vec, count](QuicStreamState& stream) {
+    auto result = readDataFromQuicStream(stream, vec, count);
+    return std::make_pair(static_cast<size_t>(result.first), result.second);
+  });
+}
+
 folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::peek(
     StreamId id,
     const folly::Function<void(StreamId id, const folly::Range<PeekIterator>&)
@@ -1410,12 +1648,12 @@ void QuicTransportBase::handlePingCallback() {
   if (!conn_->pendingEvents.cancelPingTimeout) {
     return; // nothing to cancel
   }
-  if (!pingTimeout_.isScheduled()) {
+  if (!isTimeoutScheduled(&pingTimeout_)) {
     // set cancelpingTimeOut to false, delayed acks
     conn_->pendingEvents.cancelPingTimeout = false;
     return; // nothing to do, as timeout has already fired
   }
-  pingTimeout_.cancelTimeout();
+  cancelTimeout(&pingTimeout_);
   if (pingCallback_ != nullptr) {
     runOnEvbAsync([](auto self) { self->pingCallback_->pingAcknowledged(); });
   }
@@ -1427,15 +1665,25 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
     return;
   }
   // TODO move all of this callback processing to individual functions.
-  for (const auto& stream : conn_->streamManager->newPeerStreams()) {
-    CHECK_NOTNULL(connCallback_);
-    if (isBidirectionalStream(stream)) {
-      connCallback_->onNewBidirectionalStream(stream);
-    } else {
-      connCallback_->onNewUnidirectionalStream(stream);
+  const auto& newPeerStreams = conn_->streamManager->newPeerStreams();
+  if (conn_->transportSettings.batchNewPeerStreamCallbacks) {
+    if (!newPeerStreams.empty()) {
+      CHECK_NOTNULL(connCallback_);
+      connCallback_->onNewStreams(folly::range(
+          newPeerStreams.data(),
+          newPeerStreams.data() + newPeerStreams.size()));
     }
-    if (closeState_ != CloseState::OPEN) {
-      break;
+  } else {
+    for (const auto& stream : newPeerStreams) {
+      CHECK_NOTNULL(connCallback_);
+      if (isBidirectionalStream(stream)) {
+        connCallback_->onNewBidirectionalStream(stream);
+      } else {
+        connCallback_->onNewUnidirectionalStream(stream);
+      }
+      if (closeState_ != CloseState::OPEN) {
+        break;
+      }
     }
   }
   conn_->streamManager->clearNewPeerStreams();
@@ -1443,6 +1691,13 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
   // Handle pingCallbacks
   handlePingCallback();
 
+  if (datagramCallback_ && !conn_->datagramState.readBuffer.empty()) {
+    datagramCallback_->onDatagramsAvailable();
+    if (closeState_ != CloseState::OPEN) {
+      return;
+    }
+  }
+
   // TODO: we're currently assuming that canceling write callbacks will not
   // cause reset of random streams. Maybe get rid of that assumption later.
   for (auto pendingResetIt = conn_->pendingEvents.resets.begin();
@@ -1458,13 +1713,18 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
     // stream shouldn't be cleaned as long as it's still on deliveryList
     DCHECK(stream);
 
+    // The delivered offset only moves forward while the callbacks run, so it
+    // is computed once per stream. Callbacks are sorted by offset, so this
+    // only visits the callbacks that are delivered, plus one.
+    auto minOffsetToDeliver = getStreamNextOffsetToDeliver(*stream);
     while (closeState_ == CloseState::OPEN) {
+      // Looked up again on every iteration since a callback may cancel the
+      // callbacks of the stream.
       auto deliveryCallbacksForAckedStream = deliveryCallbacks_.find(streamId);
       if (deliveryCallbacksForAckedStream == deliveryCallbacks_.end() ||
           deliveryCallbacksForAckedStream->second.empty()) {
         break;
       }
-      auto minOffsetToDeliver = getStreamNextOffsetToDeliver(*stream);
       if (deliveryCallbacksForAckedStream->second.front().first >
           minOffsetToDeliver) {
         break;
@@ -1502,7 +1762,8 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
     }
     CHECK_NOTNULL(connCallback_)->onFlowControlUpdate(streamId);
     auto maxStreamWritable = maxWritableOnStream(*stream);
-    if (maxStreamWritable != 0 && !pendingWriteCallbacks_.empty()) {
+    if (isStreamWriteReady(*stream, maxStreamWritable) &&
+        !pendingWriteCallbacks_.empty()) {
       auto pendingWriteIt = pendingWriteCallbacks_.find(stream->id);
       if (pendingWriteIt != pendingWriteCallbacks_.end()) {
         auto wcb = pendingWriteIt->second;
@@ -1535,7 +1796,7 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
   if (closeState_ == CloseState::OPEN && maxConnWrite != 0) {
     // If the connection now has flow control, we may either have been blocked
     // before on a pending write to the conn, or a stream's write.
-    if (connWriteCallback_) {
+    if (connWriteCallback_ && isConnectionWriteReady(maxConnWrite)) {
       auto connWriteCallback = connWriteCallback_;
       connWriteCallback_ = nullptr;
       connWriteCallback->onConnectionWriteReady(maxConnWrite);
@@ -1560,7 +1821,7 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
         continue;
       }
       auto maxStreamWritable = maxWritableOnStream(*stream);
-      if (maxStreamWritable != 0) {
+      if (isStreamWriteReady(*stream, maxStreamWritable)) {
         pendingWriteCallbacks_.erase(streamId);
         wcb->onStreamWriteReady(streamId, maxStreamWritable);
       }
@@ -1571,6 +1832,55 @@ void QuicTransportBase::processCallbacksAfterNetworkData() {
 void QuicTransportBase::onNetworkData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) noexcept {
+  processNetworkData(peer, folly::range(&networkData, &networkData + 1));
+}
+
+void QuicTransportBase::onNetworkDataBatch(
+    const folly::SocketAddress& peer,
+    std::vector<NetworkData>&& batch) noexcept {
+  processNetworkData(peer, folly::range(batch));
+}
+
+void QuicTransportBase::parseNetworkDataAhead(
+    folly::Range<NetworkData*> batch) {
+  if (!conn_->readCodec || !conn_->readCodec->getOneRttReadCipher()) {
+    return;
+  }
+  std::vector<Buf> datagrams;
+  datagrams.reserve(batch.size());
+  for (auto& networkData : batch) {
+    datagrams.push_back(std::move(networkData.data));
+  }
+  // The peer sends to the connection ids picked by this endpoint.
+  auto dstConnIdSize = conn_->nodeType == QuicNodeType::Client
+      ? conn_->clientConnectionId->size()
+      : kDefaultConnectionIdSize;
+  std::vector<size_t> sizes(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    sizes[i] = datagrams[i] ? datagrams[i]->computeChainDataLength() : 0;
+  }
+  auto results = [&] {
+    QuicLatencySampler sampler(
+        conn_->infoCallback,
+        QuicTransportStatsCallback::LatencyType::PACKET_DECODE);
+    QuicCpuCostSampler cpuCostSampler(
+        *conn_, QuicTransportStatsCallback::CpuCostType::PACKET_DECODE);
+    return conn_->readCodec->parseShortHeaderPackets(
+        datagrams, conn_->ackStates, dstConnIdSize);
+  }();
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (results[i]) {
+      batch[i].parsedPacket = std::move(results[i]);
+      batch[i].parsedPacketSize = sizes[i];
+    } else {
+      batch[i].data = std::move(datagrams[i]);
+    }
+  }
+}
+
+void QuicTransportBase::processNetworkData(
+    const folly::SocketAddress& peer,
+    folly::Range<NetworkData*> batch) noexcept {
   FOLLY_MAYBE_UNUSED auto self = sharedGuard();
   SCOPE_EXIT {
     checkForClosedStream();
@@ -1579,14 +1889,39 @@ void QuicTransportBase::onNetworkData(
     updateWriteLooper(true);
   };
   try {
-    if (networkData.data) {
-      conn_->lossState.totalBytesRecvd +=
-          networkData.data->computeChainDataLength();
+    QuicCpuCostSampler cpuCostSampler(
+        *conn_, QuicTransportStatsCallback::CpuCostType::NETWORK_DATA);
+    for (auto& networkData : batch) {
+      if (networkData.data) {
+        conn_->lossState.totalBytesRecvd +=
+            networkData.data->computeChainDataLength();
+      }
+    }
+    if (batch.size() > 1 && closeState_ == CloseState::OPEN) {
+      parseNetworkDataAhead(batch);
     }
     auto originalAckVersion = currentAckStateVersion(*conn_);
-    onReadData(peer, std::move(networkData));
+    {
+      // The pacer could be gone once the batch is read, if the connection
+      // closed.
+      Pacer* deferredPacer = nullptr;
+      if (batch.size() > 1 && conn_->pacer &&
+          conn_->transportSettings.batchPacingRefresh) {
+        deferredPacer = conn_->pacer.get();
+        deferredPacer->setRefreshDeferred(true);
+      }
+      SCOPE_EXIT {
+        if (deferredPacer && conn_->pacer.get() == deferredPacer) {
+          deferredPacer->setRefreshDeferred(false);
+        }
+      };
+      for (auto& networkData : batch) {
+        onReadData(peer, std::move(networkData));
+      }
+    }
     processCallbacksAfterNetworkData();
     if (closeState_ != CloseState::CLOSED) {
+      updateOneRttKeys(*conn_);
       if (currentAckStateVersion(*conn_) != originalAckVersion) {
         setIdleTimer();
         conn_->receivedNewPacketBeforeWrite = true;
@@ -1629,13 +1964,13 @@ void QuicTransportBase::setIdleTimer() {
   if (closeState_ == CloseState::CLOSED) {
     return;
   }
-  if (idleTimeout_.isScheduled()) {
-    idleTimeout_.cancelTimeout();
-  }
+  // Rescheduling moves the timeout, with coalesced timers it doesn't touch
+  // the wheel, which matters as this runs for nearly every packet.
   if (conn_->transportSettings.idleTimeout >
       std::chrono::milliseconds::zero()) {
-    getEventBase()->timer().scheduleTimeout(
-        &idleTimeout_, conn_->transportSettings.idleTimeout);
+    scheduleTimeout(&idleTimeout_, conn_->transportSettings.idleTimeout);
+  } else {
+    cancelTimeout(&idleTimeout_);
   }
 }
 
@@ -1709,7 +2044,7 @@ QuicTransportBase::notifyPendingWriteOnConnection(WriteCallback* wcb) {
       return;
     }
     auto connWritableBytes = self->maxWritableOnConn();
-    if (connWritableBytes != 0) {
+    if (self->isConnectionWriteReady(connWritableBytes)) {
       auto connWriteCallback = self->connWriteCallback_;
       self->connWriteCallback_ = nullptr;
       connWriteCallback->onConnectionWriteReady(connWritableBytes);
@@ -1768,7 +2103,7 @@ QuicTransportBase::notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) {
       return;
     }
     auto maxCanWrite = self->maxWritableOnStream(*stream);
-    if (maxCanWrite != 0) {
+    if (self->isStreamWriteReady(*stream, maxCanWrite)) {
       self->pendingWriteCallbacks_.erase(wcbIt);
       writeCallback->onStreamWriteReady(id, maxCanWrite);
     }
@@ -1776,6 +2111,53 @@ QuicTransportBase::notifyPendingWriteOnStream(StreamId id, WriteCallback* wcb) {
   return folly::unit;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamWriteLowWatermark(
+    StreamId id,
+    uint64_t lowWatermark) {
+  if (isReceivingStream(conn_->nodeType, id)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  stream->writeLowWatermark = lowWatermark;
+  return folly::unit;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setConnectionWriteLowWatermark(uint64_t lowWatermark) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  connWriteLowWatermark_ = lowWatermark;
+  return folly::unit;
+}
+
+bool QuicTransportBase::isStreamWriteReady(
+    const QuicStreamState& stream,
+    uint64_t maxStreamWritable) const {
+  if (maxStreamWritable == 0) {
+    return false;
+  }
+  // With nothing left to send, sending can't free more space, so waiting for
+  // the watermark could block the stream until the peer gives more credit.
+  return maxStreamWritable >= stream.writeLowWatermark ||
+      stream.writeBuffer.empty();
+}
+
+bool QuicTransportBase::isConnectionWriteReady(uint64_t maxConnWrite) const {
+  if (maxConnWrite == 0) {
+    return false;
+  }
+  return maxConnWrite >= connWriteLowWatermark_ ||
+      conn_->flowControlState.sumCurStreamBufferLen == 0;
+}
+
 uint64_t QuicTransportBase::maxWritableOnStream(const QuicStreamState& stream) {
   auto connWritableBytes = maxWritableOnConn();
   auto streamFlowControlBytes = getSendStreamFlowControlBytesAPI(stream);
@@ -1794,8 +2176,38 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
     StreamId id,
     Buf data,
     bool eof,
-    bool /*cork*/,
+    bool cork,
+    DeliveryCallback* cb) {
+  return writeChainInternal(
+      id, std::move(data), eof, cork, cb, true /* coalesce */);
+}
+
+void QuicTransportBase::setFrameTemplates(
+    std::shared_ptr<const QuicFrameTemplates> frameTemplates) {
+  frameTemplates_ = std::move(frameTemplates);
+}
+
+QuicSocket::WriteResult QuicTransportBase::writeFrameTemplate(
+    StreamId id,
+    QuicFrameTemplates::Handle handle,
+    bool eof,
+    bool cork,
     DeliveryCallback* cb) {
+  auto frame = frameTemplates_ ? frameTemplates_->get(handle) : nullptr;
+  if (!frame) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  return writeChainInternal(
+      id, std::move(frame), eof, cork, cb, false /* coalesce */);
+}
+
+QuicSocket::WriteResult QuicTransportBase::writeChainInternal(
+    StreamId id,
+    Buf data,
+    bool eof,
+    bool cork,
+    DeliveryCallback* cb,
+    bool coalesce) {
   if (isReceivingStream(conn_->nodeType, id)) {
     return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
   }
@@ -1823,8 +2235,17 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
             id, currentLargestWriteOffset + dataLength - 1, cb);
       }
     }
-    writeDataToQuicStream(*stream, std::move(data), eof);
-    updateWriteLooper(true);
+    writeDataToQuicStream(*stream, std::move(data), eof, coalesce);
+    // A corked write leaves the packets to the next iteration, which the
+    // writes still to come can fill, unless a full one can go now.
+    if ((cork || writeCork_) &&
+        conn_->flowControlState.sumCurStreamBufferLen <
+            conn_->udpSendPacketLen) {
+      corkedWriteScheduled_ = true;
+      updateWriteLooper(false);
+    } else {
+      uncorkWriteLooper();
+    }
   } catch (const QuicTransportException& ex) {
     VLOG(4) << __func__ << " streamId=" << id << " " << ex.what() << " "
             << *this;
@@ -1848,6 +2269,31 @@ QuicSocket::WriteResult QuicTransportBase::writeChain(
   return nullptr;
 }
 
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::writeBuffers(
+    StreamId id,
+    std::vector<ExternalBuffer> buffers,
+    bool eof,
+    DeliveryCallback* cb) {
+  Buf data;
+  for (const auto& buffer : buffers) {
+    // The release function runs when the last clone of the IOBuf is gone.
+    auto buf = buffer.releaseFn
+        ? folly::IOBuf::takeOwnership(
+              buffer.data, buffer.length, buffer.releaseFn, buffer.userData)
+        : folly::IOBuf::wrapBuffer(buffer.data, buffer.length);
+    if (data) {
+      data->prependChain(std::move(buf));
+    } else {
+      data = std::move(buf);
+    }
+  }
+  auto result = writeChain(id, std::move(data), eof, false /* cork */, cb);
+  if (result.hasError()) {
+    return folly::makeUnexpected(result.error());
+  }
+  return folly::unit;
+}
+
 folly::Expected<folly::Unit, LocalErrorCode>
 QuicTransportBase::registerDeliveryCallback(
     StreamId id,
@@ -1864,18 +2310,21 @@ QuicTransportBase::registerDeliveryCallback(
     return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
   }
   if (cb) {
-    if (deliveryCallbacks_.find(id) == deliveryCallbacks_.end()) {
-      deliveryCallbacks_[id].emplace_back(offset, cb);
+    auto& streamDeliveryCbs = deliveryCallbacks_[id];
+    if (streamDeliveryCbs.empty() ||
+        streamDeliveryCbs.back().first <= offset) {
+      // Callbacks are usually registered in offset order, as data is written.
+      streamDeliveryCbs.emplace_back(offset, cb);
     } else {
       // Keep DeliveryCallbacks for the same stream sorted by offsets:
       auto pos = std::upper_bound(
-          deliveryCallbacks_[id].begin(),
-          deliveryCallbacks_[id].end(),
+          streamDeliveryCbs.begin(),
+          streamDeliveryCbs.end(),
           offset,
           [&](uint64_t o, const std::pair<uint64_t, DeliveryCallback*>& p) {
             return o < p.first;
           });
-      deliveryCallbacks_[id].emplace(pos, offset, cb);
+      streamDeliveryCbs.emplace(pos, offset, cb);
     }
     auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
     auto minOffsetToDelivery = getStreamNextOffsetToDeliver(*stream);
@@ -2050,6 +2499,71 @@ void QuicTransportBase::sendPing(
   schedulePingTimeout(callback, pingTimeout);
 }
 
+void QuicTransportBase::setDatagramCallback(DatagramCallback* cb) {
+  datagramCallback_ = cb;
+}
+
+uint16_t QuicTransportBase::getDatagramSizeLimit() const {
+  auto maxFrameSize = conn_->datagramState.maxWriteFrameSize;
+  if (maxFrameSize == 0) {
+    return 0;
+  }
+  // Leave room for the largest short header and the AEAD tag.
+  uint64_t packetOverhead = sizeof(uint8_t) + kMaxConnectionIdSize +
+      kMaxPacketNumEncodingSize +
+      (conn_->oneRttWriteCipher ? conn_->oneRttWriteCipher->getCipherOverhead()
+                                : kCipherOverheadHeuristic);
+  if (conn_->udpSendPacketLen <= packetOverhead) {
+    return 0;
+  }
+  auto frameSize = std::min<uint64_t>(
+      maxFrameSize, conn_->udpSendPacketLen - packetOverhead);
+  if (frameSize <= kMaxDatagramFrameHeaderSize) {
+    return 0;
+  }
+  return frameSize - kMaxDatagramFrameHeaderSize;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode> QuicTransportBase::writeDatagram(
+    Buf buf) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  auto sizeLimit = getDatagramSizeLimit();
+  if (sizeLimit == 0) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!buf || buf->computeChainDataLength() > sizeLimit) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_WRITE_DATA);
+  }
+  auto& writeBuffer = conn_->datagramState.writeBuffer;
+  writeBuffer.push_back(std::move(buf));
+  if (writeBuffer.size() > conn_->transportSettings.datagramWriteBufferSize) {
+    writeBuffer.pop_front();
+    conn_->datagramState.numWriteDropped++;
+  }
+  updateWriteLooper(true);
+  return folly::unit;
+}
+
+folly::Expected<std::vector<Buf>, LocalErrorCode>
+QuicTransportBase::readDatagrams(size_t atMost) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  auto& readBuffer = conn_->datagramState.readBuffer;
+  if (atMost == 0 || atMost > readBuffer.size()) {
+    atMost = readBuffer.size();
+  }
+  std::vector<Buf> datagrams;
+  datagrams.reserve(atMost);
+  for (size_t i = 0; i < atMost; ++i) {
+    datagrams.push_back(std::move(readBuffer.front()));
+    readBuffer.pop_front();
+  }
+  return datagrams;
+}
+
 void QuicTransportBase::lossTimeoutExpired() noexcept {
   CHECK_NE(closeState_, CloseState::CLOSED);
   // onLossDetectionAlarm will set packetToSend in pending events
@@ -2094,6 +2608,28 @@ void QuicTransportBase::pingTimeoutExpired() noexcept {
   runOnEvbAsync([](auto self) { self->pingCallback_->pingTimeout(); });
 }
 
+void QuicTransportBase::onSocketWritable() noexcept {
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  if (closeState_ == CloseState::CLOSED || !socket_) {
+    return;
+  }
+  if (!writeSendBlockedPackets(*socket_, *conn_)) {
+    VLOG(10) << "Socket send buffer still full " << *this;
+    waitForSocketWritable();
+    return;
+  }
+  updateWriteLooper(true);
+}
+
+void QuicTransportBase::waitForSocketWritable() {
+  if (!conn_->sendBlocked || !socket_ || !evb_ ||
+      socketWritableHandler_.isHandlerRegistered()) {
+    return;
+  }
+  socketWritableHandler_.initHandler(evb_, socket_->getNetworkSocket());
+  socketWritableHandler_.registerHandler(folly::EventHandler::WRITE);
+}
+
 void QuicTransportBase::pathValidationTimeoutExpired() noexcept {
   CHECK(conn_->outstandingPathValidation);
 
@@ -2128,7 +2664,7 @@ void QuicTransportBase::scheduleLossTimeout(std::chrono::milliseconds timeout) {
   }
   auto& wheelTimer = getEventBase()->timer();
   timeout = timeMax(timeout, wheelTimer.getTickInterval());
-  wheelTimer.scheduleTimeout(&lossTimeout_, timeout);
+  scheduleTimeout(&lossTimeout_, timeout);
 }
 
 void QuicTransportBase::scheduleAckTimeout() {
@@ -2136,25 +2672,35 @@ void QuicTransportBase::scheduleAckTimeout() {
     return;
   }
   if (conn_->pendingEvents.scheduleAckTimeout) {
-    if (!ackTimeout_.isScheduled()) {
+    if (!isTimeoutScheduled(&ackTimeout_)) {
       auto factoredRtt = std::chrono::duration_cast<std::chrono::microseconds>(
           kAckTimerFactor * conn_->lossState.srtt);
+      auto maxAckDelay = timeMin(
+          conn_->transportSettings.adaptiveAcks
+              ? std::chrono::duration_cast<std::chrono::microseconds>(
+                    conn_->transportSettings.maxAckDelay)
+              : kMaxAckTimeout,
+          factoredRtt);
+      // The peer asked for its own ack delay with an ACK_FREQUENCY frame.
+      if (conn_->ackFrequencyState.received) {
+        maxAckDelay = conn_->ackFrequencyState.received->updateMaxAckDelay;
+      }
       auto& wheelTimer = getEventBase()->timer();
       auto timeout = timeMax(
           std::chrono::duration_cast<std::chrono::microseconds>(
               wheelTimer.getTickInterval()),
-          timeMin(kMaxAckTimeout, factoredRtt));
+          maxAckDelay);
       auto timeoutMs =
           std::chrono::duration_cast<std::chrono::milliseconds>(timeout);
       VLOG(10) << __func__ << " timeout=" << timeoutMs.count() << "ms"
                << " factoredRtt=" << factoredRtt.count() << "us"
                << " " << *this;
-      wheelTimer.scheduleTimeout(&ackTimeout_, timeoutMs);
+      scheduleTimeout(&ackTimeout_, timeoutMs);
     }
   } else {
-    if (ackTimeout_.isScheduled()) {
+    if (isTimeoutScheduled(&ackTimeout_)) {
       VLOG(10) << __func__ << " cancel timeout " << *this;
-      ackTimeout_.cancelTimeout();
+      cancelTimeout(&ackTimeout_);
     }
   }
 }
@@ -2163,13 +2709,12 @@ void QuicTransportBase::schedulePingTimeout(
     PingCallback* pingCb,
     std::chrono::milliseconds timeout) {
   // if a ping timeout is already scheduled, nothing to do, return
-  if (pingTimeout_.isScheduled()) {
+  if (isTimeoutScheduled(&pingTimeout_)) {
     return;
   }
 
   pingCallback_ = pingCb;
-  auto& wheelTimer = getEventBase()->timer();
-  wheelTimer.scheduleTimeout(&pingTimeout_, timeout);
+  scheduleTimeout(&pingTimeout_, timeout);
 }
 
 void QuicTransportBase::schedulePathValidationTimeout() {
@@ -2177,13 +2722,13 @@ void QuicTransportBase::schedulePathValidationTimeout() {
     return;
   }
   if (!conn_->pendingEvents.schedulePathValidationTimeout) {
-    if (pathValidationTimeout_.isScheduled()) {
+    if (isTimeoutScheduled(&pathValidationTimeout_)) {
       VLOG(10) << __func__ << " cancel timeout " << *this;
       // This means path validation succeeded, and we should have updated to
       // correct state
-      pathValidationTimeout_.cancelTimeout();
+      cancelTimeout(&pathValidationTimeout_);
     }
-  } else if (!pathValidationTimeout_.isScheduled()) {
+  } else if (!isTimeoutScheduled(&pathValidationTimeout_)) {
     auto pto = conn_->lossState.srtt +
         std::max(4 * conn_->lossState.rttvar, kGranularity) +
         conn_->lossState.maxAckDelay;
@@ -2192,18 +2737,40 @@ void QuicTransportBase::schedulePathValidationTimeout() {
     auto timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(
         validationTimeout);
     VLOG(10) << __func__ << " timeout=" << timeoutMs.count() << "ms " << *this;
-    getEventBase()->timer().scheduleTimeout(&pathValidationTimeout_, timeoutMs);
+    scheduleTimeout(&pathValidationTimeout_, timeoutMs);
   }
 }
 
 void QuicTransportBase::cancelLossTimeout() {
-  if (lossTimeout_.isScheduled()) {
-    lossTimeout_.cancelTimeout();
-  }
+  cancelTimeout(&lossTimeout_);
 }
 
 bool QuicTransportBase::isLossTimeoutScheduled() const {
-  return lossTimeout_.isScheduled();
+  return isTimeoutScheduled(&lossTimeout_);
+}
+
+void QuicTransportBase::scheduleTimeout(
+    folly::HHWheelTimer::Callback* callback,
+    std::chrono::milliseconds timeout) {
+  auto& wheelTimer = getEventBase()->timer();
+  if (conn_->transportSettings.coalesceTimers) {
+    // In case the setting changed while the callback was on the wheel.
+    callback->cancelTimeout();
+    timers_.scheduleTimeout(wheelTimer, callback, timeout);
+  } else {
+    timers_.cancelTimeout(callback);
+    wheelTimer.scheduleTimeout(callback, timeout);
+  }
+}
+
+bool QuicTransportBase::isTimeoutScheduled(
+    const folly::HHWheelTimer::Callback* callback) const {
+  return callback->isScheduled() || timers_.isScheduled(callback);
+}
+
+void QuicTransportBase::cancelTimeout(folly::HHWheelTimer::Callback* callback) {
+  callback->cancelTimeout();
+  timers_.cancelTimeout(callback);
 }
 
 void QuicTransportBase::setSupportedVersions(
@@ -2237,20 +2804,21 @@ void QuicTransportBase::cancelAllAppCallbacks(
   auto deliveryCallbacks = std::move(deliveryCallbacks_);
   // Invoke onCanceled on the copy
   cancelDeliveryCallbacks(deliveryCallbacks);
-  // TODO: this will become simpler when we change the underlying data
-  // structure of read callbacks.
-  // TODO: this approach will make the app unable to setReadCallback to
-  // nullptr during the loop. Need to fix that.
-  // TODO: setReadCallback to nullptr closes the stream, so the app
-  // may just do that...
-  auto readCallbacksCopy = readCallbacks_;
-  for (auto& cb : readCallbacksCopy) {
-    readCallbacks_.erase(cb.first);
+  // The transport is no longer open, so the app can't set callbacks again
+  // from the ones invoked here: the callbacks are taken out of their maps
+  // at once and invoked in a single pass over a vector.
+  std::vector<std::pair<StreamId, ReadCallback*>> readCallbacks;
+  readCallbacks.reserve(readCallbacks_.size());
+  for (const auto& cb : readCallbacks_) {
     if (cb.second.readCb) {
-      cb.second.readCb->readError(
-          cb.first, std::make_pair(err.first, folly::StringPiece(err.second)));
+      readCallbacks.emplace_back(cb.first, cb.second.readCb);
     }
   }
+  readCallbacks_.clear();
+  for (const auto& cb : readCallbacks) {
+    cb.second->readError(
+        cb.first, std::make_pair(err.first, folly::StringPiece(err.second)));
+  }
   VLOG(4) << "Clearing " << peekCallbacks_.size() << " peek callbacks";
   peekCallbacks_.clear();
   dataExpiredCallbacks_.clear();
@@ -2262,19 +2830,75 @@ void QuicTransportBase::cancelAllAppCallbacks(
     connWriteCallback->onConnectionWriteError(
         std::make_pair(err.first, folly::StringPiece(err.second)));
   }
-  auto it = pendingWriteCallbacks_.begin();
-  while (it != pendingWriteCallbacks_.end()) {
-    auto wcb = it->second;
-    wcb->onStreamWriteError(
-        it->first, std::make_pair(err.first, folly::StringPiece(err.second)));
-    it = pendingWriteCallbacks_.erase(it);
+  std::vector<std::pair<StreamId, WriteCallback*>> writeCallbacks(
+      pendingWriteCallbacks_.begin(), pendingWriteCallbacks_.end());
+  pendingWriteCallbacks_.clear();
+  for (const auto& wcb : writeCallbacks) {
+    wcb.second->onStreamWriteError(
+        wcb.first, std::make_pair(err.first, folly::StringPiece(err.second)));
   }
 }
 
+uint64_t QuicTransportBase::totalPacketNums() const {
+  // Every packet written takes a packet number of its space.
+  return conn_->ackStates.initialAckState.nextPacketNum +
+      conn_->ackStates.handshakeAckState.nextPacketNum +
+      conn_->ackStates.appDataAckState.nextPacketNum;
+}
+
+void QuicTransportBase::finishWriteLoop(
+    uint64_t packetsWritten,
+    TimePoint loopStart) {
+  if (!conn_->currentWriteLoop) {
+    return;
+  }
+  auto& loop = *conn_->currentWriteLoop;
+  loop.packetsWritten = packetsWritten;
+  loop.stopReason = getWriteLimit(*conn_);
+  loop.timeSpent = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - loopStart);
+  auto& stats = conn_->writeLoopStats;
+  ++stats.numLoops;
+  stats.packetsWritten += loop.packetsWritten;
+  stats.socketWrites += loop.socketWrites;
+  stats.socketWritePackets += loop.socketWritePackets;
+  stats.bytesWritten += loop.bytesWritten;
+  ++stats.stops[static_cast<size_t>(loop.stopReason)];
+  stats.timeSpent += loop.timeSpent;
+  if (conn_->loopDetectorCallback) {
+    conn_->loopDetectorCallback->onWriteLoop(loop);
+  }
+  QUIC_STATS(conn_->infoCallback, onWriteLoop, loop);
+  conn_->currentWriteLoop = folly::none;
+}
+
 void QuicTransportBase::writeSocketData() {
+  if (conn_->sendBlocked) {
+    // Written once the socket is writable, ahead of any new packet.
+    waitForSocketWritable();
+    return;
+  }
   if (socket_) {
+    if (conn_->partialReliabilityEnabled) {
+      expireDataPastDeadlines();
+    }
     auto packetsBefore = conn_->outstandingPackets.size();
+    auto packetNumsBefore = totalPacketNums();
+    folly::Optional<TimePoint> loopStart;
+    if (conn_->transportSettings.writeLoopStats) {
+      conn_->currentWriteLoop.emplace();
+      loopStart = Clock::now();
+    }
+    conn_->writePacketAllowance = writeLooper_->writePacketAllowance();
     writeData();
+    conn_->writePacketAllowance = folly::none;
+    writeLooper_->onPacketsWritten(totalPacketNums() - packetNumsBefore);
+    if (loopStart) {
+      finishWriteLoop(totalPacketNums() - packetNumsBefore, *loopStart);
+    }
+    if (conn_->sendBlocked) {
+      waitForSocketWritable();
+    }
     if (closeState_ != CloseState::CLOSED) {
       setLossDetectionAlarm(*conn_, *this);
       auto packetsAfter = conn_->outstandingPackets.size();
@@ -2313,6 +2937,7 @@ void QuicTransportBase::writeSocketData() {
           conn_->congestionController->getWritableBytes()) {
         conn_->congestionController->setAppLimited();
       }
+      updateWriteLimit(*conn_, getWriteLimit(*conn_), Clock::now());
     }
   }
   // Writing data could write out an ack which could cause us to cancel
@@ -2380,8 +3005,10 @@ void QuicTransportBase::setTransportSettings(
   if (conn_->transportSettings.pacingEnabled) {
     conn_->pacer = std::make_unique<DefaultPacer>(
         *conn_,
-        transportSettings.defaultCongestionController ==
-                CongestionControlType::BBR
+        (transportSettings.defaultCongestionController ==
+             CongestionControlType::BBR ||
+         transportSettings.defaultCongestionController ==
+             CongestionControlType::BBR2)
             ? kMinCwndInMssForBbr
             : conn_->transportSettings.minCwndInMss);
   }
@@ -2402,7 +3029,8 @@ void QuicTransportBase::setCongestionControl(CongestionControlType type) {
     CHECK(ccFactory_);
 
     // We need to enable pacing if we're switching to BBR.
-    if (type == CongestionControlType::BBR) {
+    if (type == CongestionControlType::BBR ||
+        type == CongestionControlType::BBR2) {
       conn_->transportSettings.pacingEnabled = true;
       conn_->pacer =
           std::make_unique<DefaultPacer>(*conn_, kMinCwndInMssForBbr);
@@ -2437,6 +3065,7 @@ void QuicTransportBase::attachEventBase(folly::EventBase* evb) {
   updateReadLooper();
   updatePeekLooper();
   updateWriteLooper(false);
+  waitForSocketWritable();
 }
 
 void QuicTransportBase::detachEventBase() {
@@ -2452,6 +3081,8 @@ void QuicTransportBase::detachEventBase() {
   pathValidationTimeout_.cancelTimeout();
   idleTimeout_.cancelTimeout();
   drainTimeout_.cancelTimeout();
+  socketWritableHandler_.unregisterHandler();
+  timers_.cancelAll();
   readLooper_->detachEventBase();
   peekLooper_->detachEventBase();
   writeLooper_->detachEventBase();
@@ -2468,6 +3099,96 @@ folly::Optional<LocalErrorCode> QuicTransportBase::setControlStream(
   return folly::none;
 }
 
+void QuicTransportBase::setWriteCork(bool cork) {
+  if (writeCork_ == cork) {
+    return;
+  }
+  writeCork_ = cork;
+  if (!cork && closeState_ == CloseState::OPEN) {
+    uncorkWriteLooper();
+  }
+}
+
+void QuicTransportBase::uncorkWriteLooper() {
+  if (corkedWriteScheduled_) {
+    corkedWriteScheduled_ = false;
+    if (writeLooper_->isLoopCallbackScheduled()) {
+      writeLooper_->cancelLoopCallback();
+    }
+  }
+  updateWriteLooper(true);
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamPriority(
+    StreamId id,
+    PriorityLevel level,
+    bool incremental) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (level > kDefaultMaxPriority) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  VLOG(4) << "Setting priority for stream=" << id << " level=" << (int)level
+          << " incremental=" << incremental << " " << *this;
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  conn_->streamManager->setStreamPriority(
+      *stream, Priority(level, incremental));
+  return folly::unit;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setMaxPacingRate(uint64_t maxRateBytesPerSec) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (!conn_->transportSettings.pacingEnabled || !conn_->pacer) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  VLOG(4) << "Setting max pacing rate=" << maxRateBytesPerSec << " "
+          << *this;
+  if (maxRateBytesPerSec == 0) {
+    conn_->maxPacingRate.clear();
+  } else {
+    conn_->maxPacingRate = maxRateBytesPerSec;
+  }
+  conn_->pacer->setMaxPacingRate(maxRateBytesPerSec);
+  return folly::unit;
+}
+
+folly::Expected<folly::Unit, LocalErrorCode>
+QuicTransportBase::setStreamMaxSendRate(
+    StreamId id,
+    uint64_t maxRateBytesPerSec) {
+  if (closeState_ != CloseState::OPEN) {
+    return folly::makeUnexpected(LocalErrorCode::CONNECTION_CLOSED);
+  }
+  if (isReceivingStream(conn_->nodeType, id) ||
+      (maxRateBytesPerSec && !conn_->transportSettings.pacingEnabled)) {
+    return folly::makeUnexpected(LocalErrorCode::INVALID_OPERATION);
+  }
+  if (!conn_->streamManager->streamExists(id)) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_NOT_EXISTS);
+  }
+  VLOG(4) << "Setting max send rate for stream=" << id
+          << " rate=" << maxRateBytesPerSec << " " << *this;
+  auto stream = CHECK_NOTNULL(conn_->streamManager->getStream(id));
+  if (maxRateBytesPerSec == 0) {
+    stream->sendRateLimit.clear();
+    return folly::unit;
+  }
+  uint64_t burstBytes = std::max<uint64_t>(
+      maxRateBytesPerSec * kStreamSendRateBurstInterval.count() /
+          std::micro::den,
+      conn_->udpSendPacketLen);
+  stream->sendRateLimit.emplace(maxRateBytesPerSec, burstBytes, Clock::now());
+  return folly::unit;
+}
+
 void QuicTransportBase::runOnEvbAsync(
     folly::Function<void(std::shared_ptr<QuicTransportBase>)> func) {
   auto evb = getEventBase();
@@ -10,10 +10,12 @@
 
 #include <folly/ExceptionWrapper.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventHandler.h>
 #include <folly/io/async/HHWheelTimer.h>
 #include <quic/QuicException.h>
 #include <quic/api/QuicSocket.h>
 #include <quic/common/FunctionLooper.h>
+#include <quic/common/TimerMultiplexer.h>
 #include <quic/common/Timers.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/congestion_control/Copa.h>
@@ -43,6 +45,22 @@ class QuicTransportBase : public QuicSocket {
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  void setPacingScheduler(PacingScheduler::SharedPtr pacingScheduler) noexcept;
+
+  void setWriteScheduler(WriteScheduler::SharedPtr writeScheduler) noexcept;
+
+  /**
+   * Charges the stream data buffered by this transport to budget, which is
+   * shared with the other transports of the worker.
+   */
+  void setBufferMemoryBudget(BufferMemoryBudget::SharedPtr budget) noexcept;
+
+  /**
+   * Gives back the memory the buffers of the streams don't use, and copies
+   * the buffers holding on to much more memory than their data.
+   */
+  void reclaimBufferMemory() noexcept;
+
   folly::EventBase* getEventBase() const override;
 
   folly::Optional<ConnectionId> getClientConnectionId() const override;
@@ -123,6 +141,11 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       size_t maxLen) override;
 
+  folly::Expected<std::pair<size_t, bool>, LocalErrorCode> readInto(
+      StreamId id,
+      const struct iovec* vec,
+      size_t count) override;
+
   folly::Expected<folly::Unit, LocalErrorCode> setPeekCallback(
       StreamId id,
       PeekCallback* cb) override;
@@ -160,6 +183,10 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       uint64_t offset) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamDeliveryDeadline(
+      StreamId id,
+      std::chrono::microseconds deadline) override;
+
   folly::Expected<StreamId, LocalErrorCode> createBidirectionalStream(
       bool replaySafe = true) override;
   folly::Expected<StreamId, LocalErrorCode> createUnidirectionalStream(
@@ -178,6 +205,13 @@ class QuicTransportBase : public QuicSocket {
   folly::Expected<folly::Unit, LocalErrorCode> notifyPendingWriteOnConnection(
       WriteCallback* wcb) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamWriteLowWatermark(
+      StreamId id,
+      uint64_t lowWatermark) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> setConnectionWriteLowWatermark(
+      uint64_t lowWatermark) override;
+
   WriteResult writeChain(
       StreamId id,
       Buf data,
@@ -185,6 +219,22 @@ class QuicTransportBase : public QuicSocket {
       bool cork,
       DeliveryCallback* cb = nullptr) override;
 
+  folly::Expected<folly::Unit, LocalErrorCode> writeBuffers(
+      StreamId id,
+      std::vector<ExternalBuffer> buffers,
+      bool eof,
+      DeliveryCallback* cb = nullptr) override;
+
+  void setFrameTemplates(
+      std::shared_ptr<const QuicFrameTemplates> frameTemplates) override;
+
+  WriteResult writeFrameTemplate(
+      StreamId id,
+      QuicFrameTemplates::Handle handle,
+      bool eof,
+      bool cork,
+      DeliveryCallback* cb = nullptr) override;
+
   folly::Expected<folly::Unit, LocalErrorCode> registerDeliveryCallback(
       StreamId id,
       uint64_t offset,
@@ -200,9 +250,21 @@ class QuicTransportBase : public QuicSocket {
       StreamId id,
       QuicErrorCode error) override;
 
+  void setBatchReadCallback(BatchReadCallback* cb) override;
+
   void sendPing(PingCallback* callback, std::chrono::milliseconds pingTimeout)
       override;
 
+  void setDatagramCallback(DatagramCallback* cb) override;
+
+  uint16_t getDatagramSizeLimit() const override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf buf) override;
+
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost = 0) override;
+
   const QuicConnectionStateBase* getState() const override {
     return conn_.get();
   }
@@ -213,6 +275,16 @@ class QuicTransportBase : public QuicSocket {
       const folly::SocketAddress& peer,
       NetworkData&& data) noexcept;
 
+  /**
+   * Same as calling onNetworkData() for every datagram of the batch, which
+   * all come from peer, except that the ack, loss and write processing that
+   * follows the reads runs once for the whole batch. The 1-rtt packets of the
+   * batch are decrypted together, see QuicReadCodec::parseShortHeaderPackets().
+   */
+  virtual void onNetworkDataBatch(
+      const folly::SocketAddress& peer,
+      std::vector<NetworkData>&& batch) noexcept;
+
   virtual void setSupportedVersions(const std::vector<QuicVersion>& versions);
 
   void setConnectionCallback(ConnectionCallback* callback) final;
@@ -230,6 +302,20 @@ class QuicTransportBase : public QuicSocket {
 
   folly::Optional<LocalErrorCode> setControlStream(StreamId id) override;
 
+  void setWriteCork(bool cork) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamPriority(
+      StreamId id,
+      PriorityLevel level,
+      bool incremental) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> setMaxPacingRate(
+      uint64_t maxRateBytesPerSec) override;
+
+  folly::Expected<folly::Unit, LocalErrorCode> setStreamMaxSendRate(
+      StreamId id,
+      uint64_t maxRateBytesPerSec) override;
+
   /**
    * Invoke onCanceled for all the delivery callbacks in the deliveryCallbacks
    * passed in. This is supposed to be a copy of the real deque of the delivery
@@ -301,6 +387,16 @@ class QuicTransportBase : public QuicSocket {
    */
   virtual void unbindConnection() = 0;
 
+  /**
+   * Invoked when the connection starts draining for drainPeriod. The
+   * sub-class may hand the draining to something that outlives the
+   * transport, in which case it returns true and the connection is unbound
+   * right away instead of after the drain timeout.
+   */
+  virtual bool handOffDraining(std::chrono::milliseconds /* drainPeriod */) {
+    return false;
+  }
+
   /**
    * Returns whether or not the connection has a write cipher. This will be used
    * to decide to return the onTransportReady() callbacks.
@@ -449,10 +545,39 @@ class QuicTransportBase : public QuicSocket {
     QuicTransportBase* transport_;
   };
 
+  // Waits for the socket to be writable again after its send buffer was
+  // full, with TransportSettings::sendBlockedBackpressure.
+  class SocketWritableHandler : public folly::EventHandler {
+   public:
+    ~SocketWritableHandler() override = default;
+
+    explicit SocketWritableHandler(QuicTransportBase* transport)
+        : transport_(transport) {}
+
+    void handlerReady(uint16_t /* events */) noexcept override {
+      transport_->onSocketWritable();
+    }
+
+   private:
+    QuicTransportBase* transport_;
+  };
+
   void scheduleLossTimeout(std::chrono::milliseconds timeout);
   void cancelLossTimeout();
   bool isLossTimeoutScheduled() const;
 
+  /**
+   * The timeouts of the transport go through these, so that they are
+   * multiplexed on a single wheel registration with
+   * TransportSettings::coalesceTimers and scheduled on the wheel directly
+   * otherwise.
+   */
+  void scheduleTimeout(
+      folly::HHWheelTimer::Callback* callback,
+      std::chrono::milliseconds timeout);
+  bool isTimeoutScheduled(const folly::HHWheelTimer::Callback* callback) const;
+  void cancelTimeout(folly::HHWheelTimer::Callback* callback);
+
   // If you don't set it, the default is Cubic
   void setCongestionControl(CongestionControlType type);
 
@@ -474,14 +599,29 @@ class QuicTransportBase : public QuicSocket {
       std::pair<QuicErrorCode, std::string> error) noexcept;
 
  protected:
+  void processNetworkData(
+      const folly::SocketAddress& peer,
+      folly::Range<NetworkData*> batch) noexcept;
+  // Parses the 1-rtt packets of the batch into their NetworkData.
+  void parseNetworkDataAhead(folly::Range<NetworkData*> batch);
   void processCallbacksAfterNetworkData();
   void invokeReadDataAndCallbacks();
+  void readIntoBatch(StreamId id);
+  // Common checks and error handling of read() and readInto(), readFn reads
+  // off the stream and returns the read data and the EOF marker.
+  template <typename T, typename ReadFn>
+  folly::Expected<std::pair<T, bool>, LocalErrorCode> readImpl(
+      StreamId id,
+      ReadFn&& readFn);
+  void invokeBatchReadCallback();
   void invokePeekDataAndCallbacks();
   void invokeDataExpiredCallbacks();
+  void expireDataPastDeadlines();
   void invokeDataRejectedCallbacks();
   void updateReadLooper();
   void updatePeekLooper();
   void updateWriteLooper(bool thisIteration);
+  void updateBufferMemoryBudget();
   void handlePingCallback();
 
   void runOnEvbAsync(
@@ -506,6 +646,19 @@ class QuicTransportBase : public QuicSocket {
       PeekCallback* cb) noexcept;
   folly::Expected<StreamId, LocalErrorCode> createStreamInternal(
       bool bidirectional);
+  WriteResult writeChainInternal(
+      StreamId id,
+      Buf data,
+      bool eof,
+      bool cork,
+      DeliveryCallback* cb,
+      bool coalesce);
+
+  /**
+   * Runs the write looper in this loop iteration, even when corked writes
+   * left it to the next one.
+   */
+  void uncorkWriteLooper();
 
   /**
    * write data to socket
@@ -517,6 +670,12 @@ class QuicTransportBase : public QuicSocket {
    */
   void writeSocketData();
 
+  // The packet numbers taken in all the packet number spaces.
+  uint64_t totalPacketNums() const;
+
+  // Ends the current write loop of TransportSettings::writeLoopStats.
+  void finishWriteLoop(uint64_t packetsWritten, TimePoint loopStart);
+
   /**
    * A wrapper around writeSocketData
    *
@@ -538,6 +697,10 @@ class QuicTransportBase : public QuicSocket {
 
   uint64_t maxWritableOnStream(const QuicStreamState&);
   uint64_t maxWritableOnConn();
+  bool isStreamWriteReady(
+      const QuicStreamState& stream,
+      uint64_t maxStreamWritable) const;
+  bool isConnectionWriteReady(uint64_t maxConnWrite) const;
 
   void lossTimeoutExpired() noexcept;
   void ackTimeoutExpired() noexcept;
@@ -545,7 +708,9 @@ class QuicTransportBase : public QuicSocket {
   void idleTimeoutExpired(bool drain) noexcept;
   void drainTimeoutExpired() noexcept;
   void pingTimeoutExpired() noexcept;
+  void onSocketWritable() noexcept;
 
+  void waitForSocketWritable();
   void setIdleTimer();
   void scheduleAckTimeout();
   void schedulePathValidationTimeout();
@@ -598,11 +763,21 @@ class QuicTransportBase : public QuicSocket {
   std::unordered_map<StreamId, DataExpiredCallbackData> dataExpiredCallbacks_;
   std::unordered_map<StreamId, DataRejectedCallbackData> dataRejectedCallbacks_;
   PingCallback* pingCallback_;
+  DatagramCallback* datagramCallback_{nullptr};
+  BatchReadCallback* batchReadCallback_{nullptr};
+  // Reused across the batch reads to keep its capacity.
+  std::vector<StreamReadResult> batchReadResults_;
 
   WriteCallback* connWriteCallback_{nullptr};
+  uint64_t connWriteLowWatermark_{0};
+  bool writeCork_{false};
+  // A corked write may have left the write looper to the next iteration.
+  bool corkedWriteScheduled_{false};
   std::map<StreamId, WriteCallback*> pendingWriteCallbacks_;
   CloseState closeState_{CloseState::OPEN};
   bool transportReadyNotified_{false};
+  // Bytes last charged to conn_->bufferMemoryBudget.
+  uint64_t bufferMemoryCharged_{0};
 
   LossTimeout lossTimeout_;
   AckTimeout ackTimeout_;
@@ -610,6 +785,9 @@ class QuicTransportBase : public QuicSocket {
   IdleTimeout idleTimeout_;
   DrainTimeout drainTimeout_;
   PingTimeout pingTimeout_;
+  SocketWritableHandler socketWritableHandler_;
+  // After the timeouts, so that it goes away before them.
+  TimerMultiplexer timers_;
   FunctionLooper::Ptr readLooper_;
   FunctionLooper::Ptr peekLooper_;
   FunctionLooper::Ptr writeLooper_;
@@ -619,6 +797,7 @@ class QuicTransportBase : public QuicSocket {
   folly::SocketAddress localFallbackAddress;
   // CongestionController factory
   std::shared_ptr<CongestionControllerFactory> ccFactory_{nullptr};
+  std::shared_ptr<const QuicFrameTemplates> frameTemplates_;
 
   folly::Function<bool(const folly::Optional<std::string>&, const Buf&) const>
       earlyDataAppParamsValidator_;
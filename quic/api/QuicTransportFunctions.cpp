@@ -9,9 +9,12 @@
 #include <quic/api/QuicTransportFunctions.h>
 
 #include <folly/Overload.h>
+#include <folly/ScopeGuard.h>
+#include <folly/lang/UncaughtExceptions.h>
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
 #include <quic/api/IoBufQuicBatch.h>
+#include <quic/api/QuicWriteCoalescer.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/QuicWriteCodec.h>
@@ -19,6 +22,7 @@
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
 #include <quic/logging/QuicLogger.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/SimpleFrameFunctions.h>
@@ -78,6 +82,19 @@ bool toWriteAppDataAcks(const quic::QuicConnectionStateBase& conn) {
       conn.ackStates.appDataAckState.needsToSendAckImmediately);
 }
 
+std::unique_ptr<folly::IOBuf> getPacketArenaBuffer(
+    quic::QuicConnectionStateBase& conn) {
+  size_t bufferSize = quic::kPacketArenaHeadroom + conn.udpSendPacketLen;
+  // The packet size can change once we know the peer's max_packet_size.
+  if (!conn.packetArena || conn.packetArena->bufferSize() != bufferSize) {
+    conn.packetArena = std::make_unique<quic::BufferPool>(
+        bufferSize, conn.transportSettings.maxBatchSize);
+  }
+  auto buf = conn.packetArena->getBuffer();
+  buf->advance(quic::kPacketArenaHeadroom);
+  return buf;
+}
+
 } // namespace
 
 namespace quic {
@@ -112,7 +129,7 @@ void handleRetransmissionWritten(
     uint64_t frameLen,
     bool frameFin,
     PacketNum packetNum,
-    std::deque<StreamBuffer>::iterator lossBufferIter) {
+    StreamBufferQueue::iterator lossBufferIter) {
   conn.lossState.totalBytesRetransmitted += frameLen;
   VLOG(10) << nodeToString(conn.nodeType) << " sent retransmission"
            << " packetNum=" << packetNum << " " << conn;
@@ -127,9 +144,7 @@ void handleRetransmissionWritten(
     bufWritten = lossBufferIter->data.split(frameLen);
   }
   stream.retransmissionBuffer.emplace(
-      std::upper_bound(
-          stream.retransmissionBuffer.begin(),
-          stream.retransmissionBuffer.end(),
+      stream.retransmissionBuffer.upperBound(
           frameOffset,
           [](const auto& offsetIn, const auto& buffer) {
             return offsetIn < buffer.offset;
@@ -160,9 +175,7 @@ bool handleStreamWritten(
   }
 
   // If the data is in the loss buffer, it is a retransmission.
-  auto lossBufferIter = std::lower_bound(
-      stream.lossBuffer.begin(),
-      stream.lossBuffer.end(),
+  auto lossBufferIter = stream.lossBuffer.lowerBound(
       frameOffset,
       [](const auto& buf, auto off) { return buf.offset < off; });
   if (lossBufferIter != stream.lossBuffer.end() &&
@@ -217,6 +230,12 @@ void updateConnection(
             writeStreamFrame.fin,
             packetNum,
             packetNumberSpace);
+        onStreamBytesSent(
+            *stream,
+            writeStreamFrame.offset,
+            writeStreamFrame.len,
+            newStreamDataWritten,
+            sentTime);
         if (newStreamDataWritten) {
           updateFlowControlOnWriteToSocket(*stream, writeStreamFrame.len);
           maybeWriteBlockAfterSocketWrite(*stream);
@@ -325,6 +344,19 @@ void updateConnection(
         }
         break;
       }
+      case QuicWriteFrame::Type::WriteDatagramFrame_E: {
+        // Ack-eliciting and congestion controlled, but never retransmitted:
+        // the packet only keeps the length of the datagram.
+        retransmittable = true;
+        if (!packetEvent.hasValue()) {
+          auto& writeBuffer = conn.datagramState.writeBuffer;
+          DCHECK(!writeBuffer.empty());
+          if (!writeBuffer.empty()) {
+            writeBuffer.pop_front();
+          }
+        }
+        break;
+      }
       case QuicWriteFrame::Type::PaddingFrame_E: {
         // do not mark padding as retransmittable. There are several reasons
         // for this:
@@ -350,6 +382,7 @@ void updateConnection(
       isHandshake,
       pureAck,
       conn.lossState.totalBytesSent + encodedSize);
+  pkt.pathId = conn.writePathId;
   pkt.isAppLimited = conn.congestionController
       ? conn.congestionController->isAppLimited()
       : false;
@@ -367,11 +400,20 @@ void updateConnection(
     // clone result cannot be pureAck either.
     DCHECK(!isHandshake);
     DCHECK(!pureAck);
+    conn.outstandingPacketEvents.addPacket(*packetEvent, packetNum);
     pkt.associatedEvent = std::move(packetEvent);
     conn.lossState.totalBytesCloned += encodedSize;
   }
 
   increaseNextPacketNum(conn, packetNumberSpace);
+  QUIC_SDT(
+      packet_sent,
+      conn,
+      static_cast<uint8_t>(packetNumberSpace),
+      packetNum,
+      encodedSize,
+      retransmittable,
+      pureAck);
   QUIC_TRACE(
       packet_sent,
       conn,
@@ -419,11 +461,17 @@ void updateConnection(
           conn.outstandingPackets.rbegin(),
           conn.outstandingPackets.rend(),
           [packetNum](const auto& packetWithTime) {
-            return packetWithTime.packet.header.getPacketSequenceNum() <
-                packetNum;
+            return packetWithTime.packetNum < packetNum;
           })
           .base();
   conn.outstandingPackets.insert(packetIt, std::move(pkt));
+  if (packetNumberSpace == PacketNumberSpace::AppData && !pureAck &&
+      !isHandshake) {
+    if (conn.cloneCandidates.size() == kMaxCloneCandidates) {
+      conn.cloneCandidates.pop_front();
+    }
+    conn.cloneCandidates.push_back(packetNum);
+  }
 
   auto opCount = conn.outstandingPackets.size();
   DCHECK_GE(opCount, conn.outstandingPureAckPacketsCount);
@@ -472,13 +520,14 @@ HeaderBuilder LongHeaderBuilder(LongHeader::Types packetType) {
   };
 }
 
-HeaderBuilder ShortHeaderBuilder() {
-  return [](const ConnectionId& /* srcConnId */,
-            const ConnectionId& dstConnId,
-            PacketNum packetNum,
-            QuicVersion,
-            const std::string&) {
-    return ShortHeader(ProtectionType::KeyPhaseZero, dstConnId, packetNum);
+HeaderBuilder ShortHeaderBuilder(ProtectionType keyPhase) {
+  return [keyPhase](
+             const ConnectionId& /* srcConnId */,
+             const ConnectionId& dstConnId,
+             PacketNum packetNum,
+             QuicVersion,
+             const std::string&) {
+    return ShortHeader(keyPhase, dstConnId, packetNum);
   };
 }
 
@@ -491,7 +540,12 @@ uint64_t writeQuicDataToSocket(
     const PacketNumberCipher& headerCipher,
     QuicVersion version,
     uint64_t packetLimit) {
-  auto builder = ShortHeaderBuilder();
+  QuicLatencySampler sampler(
+      connection.infoCallback,
+      QuicTransportStatsCallback::LatencyType::WRITE_LOOP);
+  QuicCpuCostSampler cpuCostSampler(
+      connection, QuicTransportStatsCallback::CpuCostType::WRITE_LOOP);
+  auto builder = ShortHeaderBuilder(connection.oneRttKeyUpdate.writePhase);
   // TODO: In FrameScheduler, Retx is prioritized over new data. We should
   // add a flag to the Scheduler to control the priority between them and see
   // which way is better.
@@ -533,7 +587,8 @@ uint64_t writeQuicDataToSocket(
                                            .windowUpdateFrames()
                                            .blockedFrames()
                                            .cryptoFrames()
-                                           .simpleFrames())
+                                           .simpleFrames()
+                                           .datagramFrames())
                                  .build();
   written += writeConnectionDataToSocket(
       sock,
@@ -610,7 +665,7 @@ uint64_t writeQuicDataExceptCryptoStreamToSocket(
     const PacketNumberCipher& headerCipher,
     QuicVersion version,
     uint64_t packetLimit) {
-  auto builder = ShortHeaderBuilder();
+  auto builder = ShortHeaderBuilder(connection.oneRttKeyUpdate.writePhase);
   uint64_t written = 0;
   if (connection.pendingEvents.numProbePackets) {
     auto probeScheduler = std::move(FrameScheduler::Builder(
@@ -647,7 +702,8 @@ uint64_t writeQuicDataExceptCryptoStreamToSocket(
                                            .resetFrames()
                                            .windowUpdateFrames()
                                            .blockedFrames()
-                                           .simpleFrames())
+                                           .simpleFrames()
+                                           .datagramFrames())
                                  .build();
   written += writeConnectionDataToSocket(
       socket,
@@ -794,6 +850,21 @@ void writeCloseCommon(
   // Increment the sequence number.
   // TODO: Do not increase pn if write fails
   increaseNextPacketNum(connection, pnSpace);
+  if (connection.transportSettings.compactDrainingConnections) {
+    connection.lastClosePacket = packetBuf->clone();
+  }
+  auto coalescer = connection.transportSettings.maxCoalescedWriteBatchSize
+      ? QuicWriteCoalescer::getForSocket(sock.getNetworkSocket())
+      : nullptr;
+  if (coalescer) {
+    // Written with the packets of the other transports sharing the socket,
+    // the close packets of a server shutting down go out in a few batches.
+    coalescer->enqueue(
+        connection.peerAddress, std::move(packetBuf), packetSize);
+    connection.lossState.totalBytesSent += packetSize;
+    QUIC_STATS(connection.infoCallback, onWrite, packetSize);
+    return;
+  }
   // best effort writing to the socket, ignore any errors.
   auto ret = sock.write(connection.peerAddress, packetBuf);
   connection.lossState.totalBytesSent += packetSize;
@@ -844,7 +915,7 @@ void writeShortClose(
     const Aead& aead,
     const PacketNumberCipher& headerCipher) {
   auto header = ShortHeader(
-      ProtectionType::KeyPhaseZero,
+      connection.oneRttKeyUpdate.writePhase,
       connId,
       getNextPacketNum(connection, PacketNumberSpace::AppData));
   writeCloseCommon(
@@ -856,22 +927,144 @@ void writeShortClose(
       headerCipher);
 }
 
-void encryptPacketHeader(
-    HeaderForm headerForm,
-    folly::IOBuf& header,
-    folly::IOBuf& encryptedBody,
+bool writePathProbe(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress,
+    const ConnectionId& connId,
+    std::vector<QuicSimpleFrame> frames,
+    const Aead& aead,
     const PacketNumberCipher& headerCipher) {
-  // Header encryption.
+  auto packetNum = getNextPacketNum(connection, PacketNumberSpace::AppData);
+  auto header = ShortHeader(
+      connection.oneRttKeyUpdate.writePhase, connId, packetNum);
+  RegularQuicPacketBuilder packetBuilder(
+      connection.udpSendPacketLen,
+      std::move(header),
+      getAckState(connection, PacketNumberSpace::AppData).largestAckedByPeer,
+      connection.version.value_or(*connection.originalVersion));
+  packetBuilder.setCipherOverhead(aead.getCipherOverhead());
+  for (auto& frame : frames) {
+    if (writeSimpleFrame(std::move(frame), packetBuilder) == 0) {
+      LOG(ERROR) << "Path probe frames too large " << connection;
+      return false;
+    }
+  }
+  while (packetBuilder.remainingSpaceInPkt() > 0) {
+    writeFrame(PaddingFrame(), packetBuilder);
+  }
+  auto packet = std::move(packetBuilder).buildPacket();
+  auto body =
+      aead.encrypt(std::move(packet.body), packet.header.get(), packetNum);
+  encryptPacketHeader(
+      HeaderForm::Short, *packet.header, *body, headerCipher);
+  auto packetBuf = std::move(packet.header);
+  packetBuf->prependChain(std::move(body));
+  auto packetSize = packetBuf->computeChainDataLength();
+  if (connection.qLogger) {
+    connection.qLogger->addPacket(packet.packet, packetSize);
+  }
+  VLOG(10) << nodeToString(connection.nodeType)
+           << " sent path probe packetNum=" << packetNum << " to "
+           << peerAddress << " " << connection;
+  increaseNextPacketNum(connection, PacketNumberSpace::AppData);
+  auto ret = sock.write(peerAddress, packetBuf);
+  connection.lossState.totalBytesSent += packetSize;
+  if (ret < 0) {
+    VLOG(4) << "Error writing path probe " << folly::errnoStr(errno) << " "
+            << connection;
+  } else {
+    QUIC_STATS(connection.infoCallback, onWrite, ret);
+  }
+  return true;
+}
+
+uint64_t writePmtuProbe(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& connId,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher) {
+  auto now = Clock::now();
+  auto probeSize = getPmtuProbeSize(connection, now);
+  if (!probeSize) {
+    return 0;
+  }
+  auto packetNum = getNextPacketNum(connection, PacketNumberSpace::AppData);
+  auto header = ShortHeader(
+      connection.oneRttKeyUpdate.writePhase, connId, packetNum);
+  // The builder doesn't count the tag the aead adds.
+  RegularQuicPacketBuilder packetBuilder(
+      *probeSize - aead.getCipherOverhead(),
+      std::move(header),
+      getAckState(connection, PacketNumberSpace::AppData).largestAckedByPeer,
+      connection.version.value_or(*connection.originalVersion));
+  packetBuilder.setCipherOverhead(aead.getCipherOverhead());
+  writeSimpleFrame(PingFrame(), packetBuilder);
+  while (packetBuilder.remainingSpaceInPkt() > 0) {
+    writeFrame(PaddingFrame(), packetBuilder);
+  }
+  auto packet = std::move(packetBuilder).buildPacket();
+  auto body =
+      aead.encrypt(std::move(packet.body), packet.header.get(), packetNum);
+  encryptPacketHeader(
+      HeaderForm::Short, *packet.header, *body, headerCipher);
+  auto packetBuf = std::move(packet.header);
+  packetBuf->prependChain(std::move(body));
+  auto packetSize = packetBuf->computeChainDataLength();
+  if (connection.qLogger) {
+    connection.qLogger->addPacket(packet.packet, packetSize);
+  }
+  VLOG(10) << nodeToString(connection.nodeType)
+           << " sent pmtu probe packetNum=" << packetNum
+           << " size=" << packetSize << " " << connection;
+  increaseNextPacketNum(connection, PacketNumberSpace::AppData);
+  auto ret = sock.write(connection.peerAddress, packetBuf);
+  if (ret < 0) {
+    int err = errno;
+    VLOG(4) << "Error writing pmtu probe " << folly::errnoStr(err) << " "
+            << connection;
+    // The socket doesn't fragment, too large a packet is refused right away.
+    onPmtuProbeLost(connection, now, err == EMSGSIZE);
+    return 0;
+  }
+  connection.lossState.totalBytesSent += packetSize;
+  QUIC_STATS(connection.infoCallback, onWrite, ret);
+  onPmtuProbeWritten(connection, packetNum, *probeSize, now);
+  return 1;
+}
+
+namespace {
+
+Sample getPacketHeaderSample(
+    const folly::IOBuf& header,
+    const folly::IOBuf& encryptedBody) {
   auto packetNumberLength = parsePacketNumberLength(header.data()[0]);
   Sample sample;
   size_t sampleBytesToUse = kMaxPacketNumEncodingSize - packetNumberLength;
+  // The aead usually writes the whole body into a single buffer, which the
+  // sample can be copied out of directly.
+  if (!encryptedBody.isChained() &&
+      encryptedBody.length() >= sampleBytesToUse + sample.size()) {
+    memcpy(
+        sample.data(), encryptedBody.data() + sampleBytesToUse, sample.size());
+    return sample;
+  }
   folly::io::Cursor sampleCursor(&encryptedBody);
   // If there were less than 4 bytes in the packet number, some of the payload
   // bytes will also be skipped during sampling.
   sampleCursor.skip(sampleBytesToUse);
   CHECK(sampleCursor.canAdvance(sample.size())) << "Not enough sample bytes";
   sampleCursor.pull(sample.data(), sample.size());
+  return sample;
+}
 
+void encryptPacketHeaderWithMask(
+    HeaderForm headerForm,
+    folly::IOBuf& header,
+    const HeaderProtectionMask& headerMask,
+    const PacketNumberCipher& headerCipher) {
+  auto packetNumberLength = parsePacketNumberLength(header.data()[0]);
   // This should already be a single buffer.
   header.coalesce();
   folly::MutableByteRange initialByteRange(header.writableData(), 1);
@@ -879,15 +1072,356 @@ void encryptPacketHeader(
       header.writableData() + header.length() - packetNumberLength,
       packetNumberLength);
   if (headerForm == HeaderForm::Short) {
-    headerCipher.encryptShortHeader(
-        sample, initialByteRange, packetNumByteRange);
+    headerCipher.encryptShortHeaderWithMask(
+        headerMask, initialByteRange, packetNumByteRange);
   } else {
-    headerCipher.encryptLongHeader(
-        sample, initialByteRange, packetNumByteRange);
+    headerCipher.encryptLongHeaderWithMask(
+        headerMask, initialByteRange, packetNumByteRange);
   }
 }
 
-uint64_t writeConnectionDataToSocket(
+/**
+ * Defers the header protection of the packets of a write loop, so that the
+ * masks of up to maxPackets packets are computed with a single batchMask
+ * call, and then hands the packets over to the IOBufQuicBatch.
+ */
+class HeaderProtectionBatch {
+ public:
+  HeaderProtectionBatch(
+      IOBufQuicBatch& ioBufBatch,
+      QuicConnectionStateBase& conn,
+      const PacketNumberCipher& headerCipher,
+      size_t maxPackets)
+      : ioBufBatch_(ioBufBatch),
+        conn_(conn),
+        headerCipher_(headerCipher),
+        maxPackets_(std::max<size_t>(maxPackets, 1)) {
+    pending_.reserve(maxPackets_);
+  }
+
+  // returns false if writing a packet failed
+  bool add(HeaderForm headerForm, Buf header, Buf body, size_t encodedSize) {
+    pending_.push_back(
+        {headerForm, std::move(header), std::move(body), encodedSize});
+    if (pending_.size() == maxPackets_) {
+      return flush();
+    }
+    return true;
+  }
+
+  bool flush() {
+    if (pending_.empty()) {
+      return true;
+    }
+    samples_.resize(pending_.size());
+    masks_.resize(pending_.size());
+    {
+      QuicCpuCostSampler cpuCostSampler(
+          conn_, QuicTransportStatsCallback::CpuCostType::PACKET_ENCRYPT);
+      for (size_t i = 0; i < pending_.size(); ++i) {
+        samples_[i] =
+            getPacketHeaderSample(*pending_[i].header, *pending_[i].body);
+      }
+      headerCipher_.batchMask(folly::range(samples_), masks_.data());
+    }
+
+    bool ret = true;
+    for (size_t i = 0; i < pending_.size(); ++i) {
+      auto& packet = pending_[i];
+      encryptPacketHeaderWithMask(
+          packet.headerForm, *packet.header, masks_[i], headerCipher_);
+      auto packetBuf = prependHeaderInPlace(
+          std::move(packet.header), std::move(packet.body));
+      if (ioBufBatch_.write(std::move(packetBuf), packet.encodedSize)) {
+        // update stats
+        QUIC_STATS(conn_.infoCallback, onWrite, packet.encodedSize);
+        QUIC_STATS(conn_.infoCallback, onPacketSent);
+      } else {
+        ret = false;
+      }
+    }
+    pending_.clear();
+    return ret;
+  }
+
+  size_t size() const {
+    return pending_.size();
+  }
+
+ private:
+  struct PendingPacket {
+    HeaderForm headerForm;
+    Buf header;
+    Buf body;
+    size_t encodedSize;
+  };
+
+  IOBufQuicBatch& ioBufBatch_;
+  QuicConnectionStateBase& conn_;
+  const PacketNumberCipher& headerCipher_;
+  size_t maxPackets_;
+  std::vector<PendingPacket> pending_;
+  std::vector<Sample> samples_;
+  std::vector<HeaderProtectionMask> masks_;
+};
+
+// The Initials of the client that carry crypto data are the ones that have to
+// be padded.
+bool isCryptoInitial(const RegularQuicWritePacket& packet) {
+  const LongHeader* longHeader = packet.header.asLong();
+  if (!longHeader ||
+      longHeader->getHeaderType() != LongHeader::Types::Initial) {
+    return false;
+  }
+  return std::any_of(
+      packet.frames.begin(),
+      packet.frames.end(),
+      [](const QuicWriteFrame& frame) {
+        return frame.asWriteCryptoFrame() != nullptr;
+      });
+}
+
+// The room left for the next packet of the datagram being coalesced.
+uint64_t getCoalescedPacketRoom(const QuicConnectionStateBase& conn) {
+  const auto& coalesced = conn.coalescedDatagram;
+  uint64_t used =
+      coalesced.packets ? coalesced.packets->computeChainDataLength() : 0;
+  if (coalesced.needsPadding) {
+    used += coalesced.paddingReserve;
+  }
+  return conn.udpSendPacketLen > used ? conn.udpSendPacketLen - used : 0;
+}
+
+// Protects the header of the packet and adds it to the datagram being
+// coalesced. A short header packet has to be the last one, so it sends the
+// datagram. Returns false if that write failed.
+bool coalescePacket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& conn,
+    const PacketNumberCipher& headerCipher,
+    HeaderForm headerForm,
+    Buf header,
+    Buf body) {
+  {
+    QuicCpuCostSampler cpuCostSampler(
+        conn, QuicTransportStatsCallback::CpuCostType::PACKET_ENCRYPT);
+    encryptPacketHeader(headerForm, *header, *body, headerCipher);
+  }
+  auto packetBuf = prependHeaderInPlace(std::move(header), std::move(body));
+  auto& coalesced = conn.coalescedDatagram;
+  if (coalesced.packets) {
+    coalesced.packets->prependChain(std::move(packetBuf));
+  } else {
+    coalesced.packets = std::move(packetBuf);
+  }
+  ++coalesced.numPackets;
+  if (coalesced.needsPadding &&
+      coalesced.packets->computeChainDataLength() >= kMinInitialPacketSize) {
+    coalesced.needsPadding = false;
+  }
+  if (headerForm == HeaderForm::Short) {
+    return writeCoalescedDatagram(sock, conn);
+  }
+  return true;
+}
+
+// Adds an Initial of PADDING frames to the datagram being coalesced, so that
+// the datagram of the client Initial reaches kMinInitialPacketSize. Like a
+// path probe it isn't tracked, there is nothing in it to be acked.
+void padCoalescedDatagram(QuicConnectionStateBase& connection) {
+  auto& coalesced = connection.coalescedDatagram;
+  auto datagramLen = coalesced.packets->computeChainDataLength();
+  if (datagramLen >= kMinInitialPacketSize ||
+      datagramLen >= connection.udpSendPacketLen) {
+    return;
+  }
+  CHECK(connection.initialWriteCipher);
+  CHECK(connection.initialHeaderCipher);
+  const Aead& aead = *connection.initialWriteCipher;
+  auto packetNum = getNextPacketNum(connection, PacketNumberSpace::Initial);
+  auto version = connection.version.value_or(*connection.originalVersion);
+  LongHeader header(
+      LongHeader::Types::Initial,
+      *coalesced.initialSrcConnId,
+      *coalesced.initialDstConnId,
+      packetNum,
+      version,
+      coalesced.initialToken);
+  // The builder doesn't count the tag the aead adds.
+  uint64_t packetLen = connection.udpSendPacketLen - datagramLen;
+  RegularQuicPacketBuilder packetBuilder(
+      packetLen > aead.getCipherOverhead()
+          ? packetLen - aead.getCipherOverhead()
+          : 0,
+      std::move(header),
+      getAckState(connection, PacketNumberSpace::Initial).largestAckedByPeer,
+      version);
+  packetBuilder.setCipherOverhead(aead.getCipherOverhead());
+  if (!packetBuilder.canBuildPacket()) {
+    VLOG(4) << "No room to pad the coalesced datagram len=" << datagramLen
+            << " " << connection;
+    return;
+  }
+  while (packetBuilder.remainingSpaceInPkt() > 0) {
+    writeFrame(PaddingFrame(), packetBuilder);
+  }
+  auto packet = std::move(packetBuilder).buildPacket();
+  auto body =
+      aead.encrypt(std::move(packet.body), packet.header.get(), packetNum);
+  encryptPacketHeader(
+      HeaderForm::Long,
+      *packet.header,
+      *body,
+      *connection.initialHeaderCipher);
+  auto packetBuf =
+      prependHeaderInPlace(std::move(packet.header), std::move(body));
+  auto packetSize = packetBuf->computeChainDataLength();
+  if (connection.qLogger) {
+    connection.qLogger->addPacket(packet.packet, packetSize);
+  }
+  increaseNextPacketNum(connection, PacketNumberSpace::Initial);
+  connection.lossState.totalBytesSent += packetSize;
+  coalesced.packets->prependChain(std::move(packetBuf));
+  ++coalesced.numPackets;
+}
+
+} // namespace
+
+ScopedCoalescedWrite::ScopedCoalescedWrite(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& conn,
+    bool coalesce)
+    : sock_(sock),
+      conn_(conn),
+      uncaughtExceptions_(folly::uncaught_exceptions()) {
+  conn_.coalescedDatagram.enabled =
+      coalesce && conn_.transportSettings.coalescePackets;
+}
+
+ScopedCoalescedWrite::~ScopedCoalescedWrite() noexcept(false) {
+  SCOPE_EXIT {
+    conn_.coalescedDatagram = QuicConnectionStateBase::CoalescedDatagram();
+  };
+  // Nothing more is sent once the write loop failed.
+  if (folly::uncaught_exceptions() == uncaughtExceptions_) {
+    writeCoalescedDatagram(sock_, conn_);
+  }
+}
+
+bool writeSendBlockedPackets(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection) {
+  if (!connection.sendBlocked) {
+    return true;
+  }
+  auto& blocked = *connection.sendBlocked;
+  auto stillBlocked = [](int err) {
+    return err == EAGAIN || err == EWOULDBLOCK;
+  };
+  if (blocked.retryBatch) {
+    auto consumed = blocked.retryBatch(sock, connection.peerAddress);
+    if (consumed < 0 && stillBlocked(errno)) {
+      return false;
+    }
+    // Any other error loses the batch, as it would have without waiting.
+    if (consumed > 0) {
+      QUIC_STATS(connection.infoCallback, onWrite, consumed);
+    }
+    blocked.retryBatch = nullptr;
+  }
+  while (!blocked.datagrams.empty()) {
+    auto& datagram = blocked.datagrams.front();
+    auto consumed = sock.write(connection.peerAddress, datagram);
+    if (consumed < 0 && stillBlocked(errno)) {
+      return false;
+    }
+    if (consumed > 0) {
+      QUIC_STATS(connection.infoCallback, onWrite, consumed);
+      QUIC_STATS(connection.infoCallback, onPacketSent);
+    }
+    blocked.datagrams.pop_front();
+  }
+  VLOG(10) << nodeToString(connection.nodeType)
+           << " wrote the packets kept while the socket was blocked "
+           << connection;
+  connection.sendBlocked.clear();
+  return true;
+}
+
+bool writeCoalescedDatagram(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection) {
+  auto& coalesced = connection.coalescedDatagram;
+  if (!coalesced.packets) {
+    return true;
+  }
+  if (coalesced.needsPadding) {
+    padCoalescedDatagram(connection);
+  }
+  auto datagram = std::move(coalesced.packets);
+  auto numPackets = coalesced.numPackets;
+  coalesced.numPackets = 0;
+  coalesced.needsPadding = false;
+  auto encodedSize = datagram->computeChainDataLength();
+  VLOG(10) << nodeToString(connection.nodeType)
+           << " writing coalesced datagram packets=" << numPackets
+           << " size=" << encodedSize << " " << connection;
+  IOBufQuicBatch ioBufBatch(
+      BatchWriterFactory::makeBatchWriter(
+          sock, QuicBatchingMode::BATCHING_MODE_NONE, 1),
+      sock,
+      connection.peerAddress,
+      connection,
+      connection.happyEyeballsState);
+  ioBufBatch.setContinueOnNetworkUnreachable(
+      connection.transportSettings.continueOnNetworkUnreachable);
+  if (!ioBufBatch.write(std::move(datagram), encodedSize)) {
+    return false;
+  }
+  QUIC_STATS(connection.infoCallback, onWrite, encodedSize);
+  for (uint64_t i = 0; i < numPackets; ++i) {
+    QUIC_STATS(connection.infoCallback, onPacketSent);
+  }
+  return true;
+}
+
+void encryptPacketHeader(
+    HeaderForm headerForm,
+    folly::IOBuf& header,
+    folly::IOBuf& encryptedBody,
+    const PacketNumberCipher& headerCipher) {
+  // Header encryption.
+  auto sample = getPacketHeaderSample(header, encryptedBody);
+  encryptPacketHeaderWithMask(
+      headerForm,
+      header,
+      headerCipher.mask(folly::range(sample)),
+      headerCipher);
+}
+
+uint32_t getWriteBatchSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit,
+    uint64_t writableBytes) {
+  if (!conn.transportSettings.adaptiveBatchSize ||
+      conn.udpSendPacketLen == 0) {
+    return conn.transportSettings.maxBatchSize;
+  }
+  // A packet is written as long as there is any cwnd left.
+  uint64_t cwndPackets =
+      (writableBytes + conn.udpSendPacketLen - 1) / conn.udpSendPacketLen;
+  uint64_t batchSize = std::min<uint64_t>(
+      {packetLimit, cwndPackets, static_cast<uint64_t>(kMaxGSOSegments)});
+  return folly::to<uint32_t>(std::max<uint64_t>(batchSize, 1));
+}
+
+namespace {
+/**
+ * The loop of writeConnectionDataToSocket(), specialized on the settings it
+ * checks for every packet, which don't change during a write.
+ */
+template <bool kCoalesced, bool kPacketArena>
+uint64_t writeConnectionDataToSocketImpl(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
     const ConnectionId& srcConnId,
@@ -905,10 +1439,29 @@ uint64_t writeConnectionDataToSocket(
            << " writing data using scheduler=" << scheduler.name() << " "
            << connection;
 
-  auto batchWriter = BatchWriterFactory::makeBatchWriter(
-      sock,
-      connection.transportSettings.batchingMode,
-      connection.transportSettings.maxBatchSize);
+  auto batchSize = getWriteBatchSize(
+      connection, packetLimit, writableBytesFunc(connection));
+  folly::Optional<TimePoint> loopTime;
+  if (connection.transportSettings.cachedWriteLoopTime) {
+    loopTime = Clock::now();
+  }
+  auto packetTime = [&loopTime]() {
+    return loopTime ? *loopTime : Clock::now();
+  };
+  std::unique_ptr<BatchWriter> batchWriter;
+  if (isConnectionTxTimePaced(connection)) {
+    // The kernel spaces out the packets by their departure times.
+    auto pacer = connection.pacer.get();
+    batchWriter = std::make_unique<TxTimePacketBatchWriter>(
+        connection.transportSettings.maxBatchSize,
+        sock.getGSO() >= 0,
+        [pacer, packetTime]() {
+          return pacer->getNextDepartureTime(packetTime());
+        });
+  } else {
+    batchWriter = BatchWriterFactory::makeBatchWriter(
+        sock, connection.transportSettings.batchingMode, batchSize);
+  }
 
   IOBufQuicBatch ioBufBatch(
       std::move(batchWriter),
@@ -918,6 +1471,15 @@ uint64_t writeConnectionDataToSocket(
       connection.happyEyeballsState);
   ioBufBatch.setContinueOnNetworkUnreachable(
       connection.transportSettings.continueOnNetworkUnreachable);
+  // Without batching every packet is written as soon as it is built.
+  HeaderProtectionBatch headerProtectionBatch(
+      ioBufBatch,
+      connection,
+      headerCipher,
+      connection.transportSettings.batchingMode ==
+              QuicBatchingMode::BATCHING_MODE_NONE
+          ? 1
+          : batchSize);
 
   if (connection.loopDetectorCallback) {
     connection.debugState.schedulerName = scheduler.name();
@@ -926,78 +1488,171 @@ uint64_t writeConnectionDataToSocket(
       connection.debugState.noWriteReason = NoWriteReason::EMPTY_SCHEDULER;
     }
   }
-  while (scheduler.hasData() && ioBufBatch.getPktSent() < packetLimit) {
+  auto& coalesced = connection.coalescedDatagram;
+  // The packets added to the datagram being coalesced count as written.
+  uint64_t numCoalesced = 0;
+  while (scheduler.hasData() &&
+         ioBufBatch.getPktSent() + headerProtectionBatch.size() +
+                 numCoalesced <
+             packetLimit) {
+    uint64_t packetLen = connection.udpSendPacketLen;
+    uint64_t cipherOverhead = aead.getCipherOverhead();
+    if (kCoalesced) {
+      packetLen = getCoalescedPacketRoom(connection);
+      if (packetLen < kMinCoalescedPacketRoom) {
+        if (!writeCoalescedDatagram(sock, connection)) {
+          if (connection.loopDetectorCallback) {
+            connection.debugState.noWriteReason =
+                NoWriteReason::SOCKET_FAILURE;
+          }
+          return ioBufBatch.getPktSent() + numCoalesced;
+        }
+        packetLen = getCoalescedPacketRoom(connection);
+      }
+    }
     auto packetNum = getNextPacketNum(connection, pnSpace);
     auto header = builder(srcConnId, dstConnId, packetNum, version, token);
-    uint32_t writableBytes = folly::to<uint32_t>(std::min<uint64_t>(
-        connection.udpSendPacketLen, writableBytesFunc(connection)));
-    uint64_t cipherOverhead = aead.getCipherOverhead();
+    uint32_t writableBytes = folly::to<uint32_t>(
+        std::min<uint64_t>(packetLen, writableBytesFunc(connection)));
     if (writableBytes < cipherOverhead) {
       writableBytes = 0;
     } else {
       writableBytes -= cipherOverhead;
     }
     RegularQuicPacketBuilder pktBuilder(
-        connection.udpSendPacketLen,
+        // Pure acks can use the whole builder, which doesn't count the tag, so
+        // it has to be left out of the room in the datagram.
+        kCoalesced ? packetLen - cipherOverhead : packetLen,
         std::move(header),
         getAckState(connection, pnSpace).largestAckedByPeer,
         connection.version.value_or(*connection.originalVersion));
     pktBuilder.setCipherOverhead(cipherOverhead);
+    if (kPacketArena) {
+      pktBuilder.setContiguousBodyBuffer(getPacketArenaBuffer(connection));
+    }
     auto result =
         scheduler.scheduleFramesForPacket(std::move(pktBuilder), writableBytes);
     auto& packet = result.second;
     if (!packet || packet->packet.frames.empty()) {
+      headerProtectionBatch.flush();
       ioBufBatch.flush();
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::NO_FRAME;
       }
-      return ioBufBatch.getPktSent();
+      return ioBufBatch.getPktSent() + numCoalesced;
     }
     if (!packet->body) {
       // No more space remaining.
+      headerProtectionBatch.flush();
       ioBufBatch.flush();
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::NO_BODY;
       }
-      return ioBufBatch.getPktSent();
+      return ioBufBatch.getPktSent() + numCoalesced;
     }
-    auto body =
-        aead.encrypt(std::move(packet->body), packet->header.get(), packetNum);
+    // Packets built into an arena buffer have room for the tag reserved, so
+    // they can be encrypted without any allocation.
+    auto body = [&] {
+      QuicCpuCostSampler cpuCostSampler(
+          connection, QuicTransportStatsCallback::CpuCostType::PACKET_ENCRYPT);
+      auto& plaintext = packet->body;
+      return !plaintext->isChained() && !plaintext->isSharedOne() &&
+              plaintext->tailroom() >= cipherOverhead
+          ? aead.inplaceEncrypt(
+                std::move(plaintext), packet->header.get(), packetNum)
+          : aead.encrypt(
+                std::move(plaintext), packet->header.get(), packetNum);
+    }();
 
     HeaderForm headerForm = packet->packet.header.getHeaderForm();
-    encryptPacketHeader(headerForm, *packet->header, *body, headerCipher);
-
-    auto packetBuf = std::move(packet->header);
-    packetBuf->prependChain(std::move(body));
-    auto encodedSize = packetBuf->computeChainDataLength();
+    auto encodedSize = packet->header->computeChainDataLength() +
+        body->computeChainDataLength();
 
-    bool ret = ioBufBatch.write(std::move(packetBuf), encodedSize);
-
-    if (ret) {
-      // update stats and connection
-      QUIC_STATS(connection.infoCallback, onWrite, encodedSize);
-      QUIC_STATS(connection.infoCallback, onPacketSent);
+    bool ret;
+    if (kCoalesced) {
+      if (connection.nodeType == QuicNodeType::Client &&
+          isCryptoInitial(packet->packet)) {
+        // The Initial isn't padded, its datagram is. Keep the room for a
+        // padding Initial, which has about the same header.
+        coalesced.needsPadding = true;
+        coalesced.paddingReserve = packet->header->computeChainDataLength() +
+            kMaxPacketNumEncodingSize + sizeof(Sample) + cipherOverhead;
+        coalesced.initialSrcConnId = srcConnId;
+        coalesced.initialDstConnId = dstConnId;
+        coalesced.initialToken = token;
+      }
+      ret = coalescePacket(
+          sock,
+          connection,
+          headerCipher,
+          headerForm,
+          std::move(packet->header),
+          std::move(body));
+      ++numCoalesced;
+    } else {
+      ret = headerProtectionBatch.add(
+          headerForm, std::move(packet->header), std::move(body), encodedSize);
     }
 
+    // update connection
     updateConnection(
         connection,
         std::move(result.first),
         std::move(result.second->packet),
-        Clock::now(),
+        packetTime(),
         folly::to<uint32_t>(encodedSize));
 
-    // if ioBufBatch.write returns false
+    // if headerProtectionBatch.add or coalescePacket returns false
     // it is because a flush() call failed
     if (!ret) {
       if (connection.loopDetectorCallback) {
         connection.debugState.noWriteReason = NoWriteReason::SOCKET_FAILURE;
       }
-      return ioBufBatch.getPktSent();
+      return ioBufBatch.getPktSent() + numCoalesced;
     }
   }
 
+  headerProtectionBatch.flush();
   ioBufBatch.flush();
-  return ioBufBatch.getPktSent();
+  return ioBufBatch.getPktSent() + numCoalesced;
+}
+} // namespace
+
+uint64_t writeConnectionDataToSocket(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& srcConnId,
+    const ConnectionId& dstConnId,
+    HeaderBuilder builder,
+    PacketNumberSpace pnSpace,
+    QuicPacketScheduler& scheduler,
+    const WritableBytesFunc& writableBytesFunc,
+    uint64_t packetLimit,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher,
+    QuicVersion version,
+    const std::string& token) {
+  auto write = connection.coalescedDatagram.enabled
+      ? (connection.transportSettings.usePacketArena
+             ? &writeConnectionDataToSocketImpl<true, true>
+             : &writeConnectionDataToSocketImpl<true, false>)
+      : (connection.transportSettings.usePacketArena
+             ? &writeConnectionDataToSocketImpl<false, true>
+             : &writeConnectionDataToSocketImpl<false, false>);
+  return write(
+      sock,
+      connection,
+      srcConnId,
+      dstConnId,
+      std::move(builder),
+      pnSpace,
+      scheduler,
+      writableBytesFunc,
+      packetLimit,
+      aead,
+      headerCipher,
+      version,
+      token);
 }
 
 uint64_t writeProbingDataToSocket(
@@ -1117,9 +1772,37 @@ WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn) {
   if ((conn.pendingEvents.pathChallenge != folly::none)) {
     return WriteDataReason::PATHCHALLENGE;
   }
+  // Datagrams are only written in 1-rtt packets.
+  if (conn.oneRttWriteCipher && !conn.datagramState.writeBuffer.empty()) {
+    return WriteDataReason::DATAGRAM;
+  }
   return WriteDataReason::NO_WRITE;
 }
 
+WriteLimit getWriteLimit(const QuicConnectionStateBase& conn) {
+  bool hasStreamData = conn.flowControlState.sumCurStreamBufferLen > 0 ||
+      conn.streamManager->hasLoss();
+  if (!hasStreamData && !cryptoHasWritableData(conn) &&
+      conn.datagramState.writeBuffer.empty()) {
+    return conn.outstandingPackets.size() > conn.outstandingPureAckPacketsCount
+        ? WriteLimit::AppLimited
+        : WriteLimit::Idle;
+  }
+  if (conn.congestionController &&
+      conn.congestionController->getWritableBytes() == 0) {
+    return WriteLimit::CwndLimited;
+  }
+  if (hasStreamData && !conn.streamManager->hasLoss() &&
+      (getSendConnFlowControlBytesWire(conn) == 0 ||
+       !conn.streamManager->hasWritable())) {
+    return WriteLimit::FlowControlLimited;
+  }
+  if (isConnectionPaced(conn)) {
+    return WriteLimit::PacingLimited;
+  }
+  return WriteLimit::Busy;
+}
+
 void maybeSendStreamLimitUpdates(QuicConnectionStateBase& conn) {
   auto update = conn.streamManager->remoteBidirectionalStreamLimitUpdate();
   if (update) {
@@ -99,6 +99,11 @@ WriteDataReason shouldWriteData(const QuicConnectionStateBase& conn);
 bool hasAckDataToWrite(const QuicConnectionStateBase& conn);
 WriteDataReason hasNonAckDataToWrite(const QuicConnectionStateBase& conn);
 
+/**
+ * What holds the writes of the connection back once a write loop is done.
+ */
+WriteLimit getWriteLimit(const QuicConnectionStateBase& conn);
+
 /**
  * Invoked when the written stream data was new stream data.
  */
@@ -120,7 +125,7 @@ void handleRetransmissionWritten(
     uint64_t frameLen,
     bool frameFin,
     PacketNum packetNum,
-    std::deque<StreamBuffer>::iterator lossBufferIter);
+    StreamBufferQueue::iterator lossBufferIter);
 
 /**
  * Update the connection and stream state after stream data is written and deal
@@ -185,6 +190,79 @@ void writeShortClose(
     const Aead& aead,
     const PacketNumberCipher& headerCipher);
 
+/**
+ * Writes a short header packet carrying frames to peerAddress, which doesn't
+ * have to be the peer address of the connection, padded to the full packet
+ * size as path validation requires. Like the close, the probe bypasses the
+ * packet sent logic: it isn't tracked, the frames are sent again by the next
+ * probe if it is lost. Returns false if the frames didn't fit.
+ */
+bool writePathProbe(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress,
+    const ConnectionId& connId,
+    std::vector<QuicSimpleFrame> frames,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher);
+
+/**
+ * Writes a PING padded to the size getPmtuProbeSize() returns to the peer, if
+ * the path MTU search is due for a probe. Like a path probe, it bypasses the
+ * packet sent logic: only the search keeps track of it. Returns the number of
+ * packets written.
+ */
+uint64_t writePmtuProbe(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection,
+    const ConnectionId& connId,
+    const Aead& aead,
+    const PacketNumberCipher& headerCipher);
+
+/**
+ * While it's alive, if coalesce and TransportSettings::coalescePackets are
+ * set, the packets the write functions build share datagrams: a long header
+ * packet is held back and the next packets, of any encryption level, are
+ * built into the room left in its datagram, until a short header packet ends
+ * it. The datagram left when the scope ends is sent, unless the
+ * scope is left by an exception.
+ */
+class ScopedCoalescedWrite {
+ public:
+  ScopedCoalescedWrite(
+      folly::AsyncUDPSocket& sock,
+      QuicConnectionStateBase& conn,
+      bool coalesce);
+  // Writing the last datagram can throw like any other socket write.
+  ~ScopedCoalescedWrite() noexcept(false);
+
+  ScopedCoalescedWrite(const ScopedCoalescedWrite&) = delete;
+  ScopedCoalescedWrite& operator=(const ScopedCoalescedWrite&) = delete;
+
+ private:
+  folly::AsyncUDPSocket& sock_;
+  QuicConnectionStateBase& conn_;
+  int uncaughtExceptions_;
+};
+
+/**
+ * Writes what was kept while the send buffer of the socket was full, see
+ * QuicConnectionStateBase::sendBlocked. Returns false if the buffer is full
+ * again, with what is left kept for the next time the socket is writable.
+ */
+bool writeSendBlockedPackets(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection);
+
+/**
+ * Sends the datagram being coalesced, if there is one. If it carries a client
+ * Initial and is still too short, a padding only Initial is added to it first.
+ * Returns false if the write failed and the write loop should end.
+ */
+bool writeCoalescedDatagram(
+    folly::AsyncUDPSocket& sock,
+    QuicConnectionStateBase& connection);
+
 /**
  * Encrypts the packet header for the header type.
  * This will overwrite the header with the encrypted header form. It will verify
@@ -219,6 +297,16 @@ uint64_t writeConnectionDataToSocket(
     QuicVersion version,
     const std::string& token = std::string());
 
+/**
+ * The number of packets writeConnectionDataToSocket batches into a single
+ * write, given the packetLimit of the write loop and the writableBytes of the
+ * connection. See TransportSettings::adaptiveBatchSize.
+ */
+uint32_t getWriteBatchSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t packetLimit,
+    uint64_t writableBytes);
+
 uint64_t writeProbingDataToSocket(
     folly::AsyncUDPSocket& sock,
     QuicConnectionStateBase& connection,
@@ -233,7 +321,8 @@ uint64_t writeProbingDataToSocket(
     QuicVersion version);
 
 HeaderBuilder LongHeaderBuilder(LongHeader::Types packetType);
-HeaderBuilder ShortHeaderBuilder();
+HeaderBuilder ShortHeaderBuilder(
+    ProtectionType keyPhase = ProtectionType::KeyPhaseZero);
 
 void maybeSendStreamLimitUpdates(QuicConnectionStateBase& conn);
 
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicWriteCoalescer.h>
+
+#include <folly/String.h>
+#include <folly/Synchronized.h>
+
+#include <unordered_map>
+
+namespace quic {
+
+namespace {
+using CoalescerMap =
+    std::unordered_map<int, std::shared_ptr<QuicWriteCoalescer>>;
+
+folly::Synchronized<CoalescerMap>& coalescers() {
+  static auto* map = new folly::Synchronized<CoalescerMap>();
+  return *map;
+}
+} // namespace
+
+QuicWriteCoalescer::QuicWriteCoalescer(
+    folly::EventBase* evb,
+    folly::AsyncUDPSocket& sock,
+    size_t maxBufs)
+    : evb_(evb), sock_(sock), writer_(std::max<size_t>(maxBufs, 1)) {}
+
+QuicWriteCoalescer::~QuicWriteCoalescer() {
+  cancelLoopCallback();
+}
+
+void QuicWriteCoalescer::enqueue(
+    const folly::SocketAddress& address,
+    std::unique_ptr<folly::IOBuf> buf,
+    size_t size) {
+  if (writer_.append(std::move(buf), size, address)) {
+    flush();
+    return;
+  }
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+void QuicWriteCoalescer::flush() {
+  if (writer_.empty()) {
+    return;
+  }
+  auto size = writer_.size();
+  auto ret = writer_.write(sock_, folly::SocketAddress());
+  if (ret != static_cast<ssize_t>(size)) {
+    // The transports already consider these packets as sent, loss recovery
+    // takes care of retransmitting them.
+    VLOG(4) << "Coalesced write of " << size << " bytes failed ret=" << ret
+            << " err=" << folly::errnoStr(errno);
+  }
+  writer_.reset();
+}
+
+void QuicWriteCoalescer::runLoopCallback() noexcept {
+  flush();
+}
+
+std::shared_ptr<QuicWriteCoalescer> QuicWriteCoalescer::registerSocket(
+    folly::EventBase* evb,
+    folly::AsyncUDPSocket& sock,
+    size_t maxBufs) {
+  auto coalescer = std::make_shared<QuicWriteCoalescer>(evb, sock, maxBufs);
+  (*coalescers().wlock())[sock.getNetworkSocket().toFd()] = coalescer;
+  return coalescer;
+}
+
+void QuicWriteCoalescer::unregisterSocket(folly::NetworkSocket sock) {
+  coalescers().wlock()->erase(sock.toFd());
+}
+
+std::shared_ptr<QuicWriteCoalescer> QuicWriteCoalescer::getForSocket(
+    folly::NetworkSocket sock) {
+  auto locked = coalescers().rlock();
+  auto it = locked->find(sock.toFd());
+  return it == locked->end() ? nullptr : it->second;
+}
+
+// CoalescedPacketBatchWriter
+CoalescedPacketBatchWriter::CoalescedPacketBatchWriter(
+    size_t maxBufs,
+    std::shared_ptr<QuicWriteCoalescer> coalescer)
+    : maxBufs_(maxBufs), coalescer_(std::move(coalescer)) {
+  bufs_.reserve(maxBufs);
+}
+
+bool CoalescedPacketBatchWriter::empty() const {
+  return !currSize_;
+}
+
+size_t CoalescedPacketBatchWriter::size() const {
+  return currSize_;
+}
+
+void CoalescedPacketBatchWriter::reset() {
+  bufs_.clear();
+  currSize_ = 0;
+}
+
+bool CoalescedPacketBatchWriter::append(
+    std::unique_ptr<folly::IOBuf>&& buf,
+    size_t size) {
+  CHECK_LT(bufs_.size(), maxBufs_);
+  bufs_.emplace_back(std::move(buf), size);
+  currSize_ += size;
+
+  // reached max buffers
+  return bufs_.size() == maxBufs_;
+}
+
+ssize_t CoalescedPacketBatchWriter::write(
+    folly::AsyncUDPSocket& /*unused*/,
+    const folly::SocketAddress& address) {
+  for (auto& buf : bufs_) {
+    coalescer_->enqueue(address, std::move(buf.first), buf.second);
+  }
+  return currSize_;
+}
+} // namespace quic
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/api/QuicBatchWriter.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * Coalesces the writes of all the transports sharing a socket during one
+ * EventBase loop iteration, and flushes them with a single sendmmsg (of GSO
+ * messages where supported) at the end of the loop.
+ *
+ * Transports find the coalescer through the socket it was registered for, see
+ * BatchWriterFactory. Since the packets of several connections are flushed
+ * together, a failed write cannot be attributed to a connection and the
+ * packets are simply treated as lost.
+ */
+class QuicWriteCoalescer : public folly::EventBase::LoopCallback {
+ public:
+  QuicWriteCoalescer(
+      folly::EventBase* evb,
+      folly::AsyncUDPSocket& sock,
+      size_t maxBufs);
+
+  ~QuicWriteCoalescer() override;
+
+  /**
+   * Queues a packet for the destination. The packet is written at the end of
+   * the current loop iteration at the latest.
+   */
+  void enqueue(
+      const folly::SocketAddress& address,
+      std::unique_ptr<folly::IOBuf> buf,
+      size_t size);
+
+  /**
+   * Writes all the queued packets.
+   */
+  void flush();
+
+  size_t pendingBytes() const {
+    return writer_.size();
+  }
+
+  void runLoopCallback() noexcept override;
+
+  /**
+   * Creates a coalescer for the socket and registers it, so that the
+   * transports writing to the socket use it.
+   */
+  static std::shared_ptr<QuicWriteCoalescer> registerSocket(
+      folly::EventBase* evb,
+      folly::AsyncUDPSocket& sock,
+      size_t maxBufs);
+
+  static void unregisterSocket(folly::NetworkSocket sock);
+
+  /**
+   * Returns the coalescer registered for the socket, if any.
+   */
+  static std::shared_ptr<QuicWriteCoalescer> getForSocket(
+      folly::NetworkSocket sock);
+
+ private:
+  folly::EventBase* evb_;
+  folly::AsyncUDPSocket& sock_;
+  SendmmsgGSOPacketBatchWriter writer_;
+};
+
+/**
+ * Batch writer used by the transports of a socket which has a coalescer. It
+ * accumulates the packets of one write loop and hands them over to the
+ * coalescer instead of writing to the socket.
+ */
+class CoalescedPacketBatchWriter : public BatchWriter {
+ public:
+  CoalescedPacketBatchWriter(
+      size_t maxBufs,
+      std::shared_ptr<QuicWriteCoalescer> coalescer);
+  ~CoalescedPacketBatchWriter() override = default;
+
+  bool empty() const override;
+
+  size_t size() const override;
+
+  void reset() override;
+
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t size) override;
+
+  ssize_t write(
+      folly::AsyncUDPSocket& sock,
+      const folly::SocketAddress& address) override;
+
+ private:
+  // max number of buffer chains we can accumulate before we need to flush
+  size_t maxBufs_{1};
+  // size of data in all the buffers
+  size_t currSize_{0};
+  std::vector<std::pair<std::unique_ptr<folly::IOBuf>, size_t>> bufs_;
+  std::shared_ptr<QuicWriteCoalescer> coalescer_;
+};
+} // namespace quic
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/ZeroCopyTracker.h>
+
+#include <folly/Synchronized.h>
+#include <folly/net/NetOps.h>
+
+#include <unordered_map>
+
+#if defined(__linux__)
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#endif
+
+namespace quic {
+
+namespace {
+using TrackerMap =
+    std::unordered_map<int, std::shared_ptr<ZeroCopyTracker>>;
+
+folly::Synchronized<TrackerMap>& trackers() {
+  static auto* map = new folly::Synchronized<TrackerMap>();
+  return *map;
+}
+} // namespace
+
+void ZeroCopyTracker::onSent(std::unique_ptr<folly::IOBuf> buf) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  pinned_.push_back(std::move(buf));
+  numPinned_++;
+}
+
+void ZeroCopyTracker::onCompletion(uint32_t lo, uint32_t hi) {
+  std::vector<std::unique_ptr<folly::IOBuf>> released;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    // The ids wrap around, so everything is relative to firstId_.
+    uint32_t begin = lo - firstId_;
+    uint32_t end = hi - firstId_;
+    for (uint32_t i = begin; i <= end && i < pinned_.size(); ++i) {
+      if (pinned_[i]) {
+        released.push_back(std::move(pinned_[i]));
+        numPinned_--;
+      }
+    }
+    while (!pinned_.empty() && !pinned_.front()) {
+      pinned_.pop_front();
+      firstId_++;
+    }
+  }
+  // Free the buffers outside of the lock.
+}
+
+bool ZeroCopyTracker::maybeHandleErrMessage(
+    FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) {
+#ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  if ((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
+      (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR)) {
+    const struct sock_extended_err* serr =
+        reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(&cmsg));
+    if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+      onCompletion(serr->ee_info, serr->ee_data);
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+size_t ZeroCopyTracker::numPinnedBuffers() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return numPinned_;
+}
+
+std::shared_ptr<ZeroCopyTracker> ZeroCopyTracker::registerSocket(
+    FOLLY_MAYBE_UNUSED folly::NetworkSocket sock) {
+#if defined(FOLLY_HAVE_MSG_ERRQUEUE) && defined(SO_ZEROCOPY)
+  int val = 1;
+  if (folly::netops::setsockopt(
+          sock, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) != 0) {
+    return nullptr;
+  }
+  auto tracker = std::make_shared<ZeroCopyTracker>();
+  (*trackers().wlock())[sock.toFd()] = tracker;
+  return tracker;
+#else
+  return nullptr;
+#endif
+}
+
+void ZeroCopyTracker::unregisterSocket(folly::NetworkSocket sock) {
+  trackers().wlock()->erase(sock.toFd());
+}
+
+std::shared_ptr<ZeroCopyTracker> ZeroCopyTracker::getForSocket(
+    folly::NetworkSocket sock) {
+  auto locked = trackers().rlock();
+  auto it = locked->find(sock.toFd());
+  return it == locked->end() ? nullptr : it->second;
+}
+} // namespace quic
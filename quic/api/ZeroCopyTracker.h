@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/net/NetworkSocket.h>
+#include <folly/portability/Sockets.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace quic {
+
+/**
+ * Keeps the buffers written with MSG_ZEROCOPY alive until the kernel reports
+ * through the socket's error queue that it is done with them.
+ *
+ * The kernel numbers every successful MSG_ZEROCOPY send on a socket
+ * sequentially, and completions refer to ranges of these numbers. Since all
+ * the transports sharing a socket share this numbering, a tracker is kept per
+ * socket rather than per connection. A tracker has to be registered by
+ * whoever drains the socket's error queue, so that completions are actually
+ * delivered; writers fall back to regular sends otherwise.
+ */
+class ZeroCopyTracker {
+ public:
+  ZeroCopyTracker() = default;
+
+  /**
+   * Records a successful MSG_ZEROCOPY send of buf.
+   */
+  void onSent(std::unique_ptr<folly::IOBuf> buf);
+
+  /**
+   * Releases the buffers of the sends numbered in [lo, hi].
+   */
+  void onCompletion(uint32_t lo, uint32_t hi);
+
+  /**
+   * Parses an error queue message and releases the completed buffers.
+   * Returns true if the message was a zero copy completion.
+   */
+  bool maybeHandleErrMessage(const cmsghdr& cmsg);
+
+  size_t numPinnedBuffers() const;
+
+  /**
+   * Turns on SO_ZEROCOPY on the socket and registers a tracker for it.
+   * Returns nullptr if the socket does not support zero copy sends.
+   */
+  static std::shared_ptr<ZeroCopyTracker> registerSocket(
+      folly::NetworkSocket sock);
+
+  static void unregisterSocket(folly::NetworkSocket sock);
+
+  /**
+   * Returns the tracker registered for the socket, if any.
+   */
+  static std::shared_ptr<ZeroCopyTracker> getForSocket(
+      folly::NetworkSocket sock);
+
+ private:
+  mutable std::mutex mutex_;
+  // Sequence number of the first entry of pinned_.
+  uint32_t firstId_{0};
+  // Buffers of all the sends past firstId_, in order. Completed entries are
+  // reset and popped once they reach the front.
+  std::deque<std::unique_ptr<folly::IOBuf>> pinned_;
+  size_t numPinned_{0};
+};
+} // namespace quic
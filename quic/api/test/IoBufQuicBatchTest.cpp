@@ -7,7 +7,10 @@
  */
 
 #include <quic/api/IoBufQuicBatch.h>
+#include <folly/io/async/test/MockAsyncUDPSocket.h>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <quic/api/QuicTransportFunctions.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/state/StateData.h>
 
@@ -82,5 +85,143 @@ TEST(QuicBatch, TestBatchingNoFlush) {
 TEST(QuicBatch, TestBatching) {
   RunTest(kMaxBufs);
 }
+
+TEST(QuicBatch, SocketWriteCpuCost) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  folly::SocketAddress peerAddress{"127.0.0.1", 1234};
+  QuicClientConnectionState conn;
+  conn.transportSettings.cpuCostSamplingRate = 1;
+  QuicConnectionStateBase::HappyEyeballsState happyEyeballsState;
+
+  IOBufQuicBatch ioBufBatch(
+      std::make_unique<TestPacketBatchWriter>(kMaxBufs),
+      sock,
+      peerAddress,
+      conn,
+      happyEyeballsState);
+  for (size_t i = 0; i < kNumLoops; i++) {
+    CHECK(ioBufBatch.write(folly::IOBuf::copyBuffer("Test"), 4));
+  }
+  CHECK(ioBufBatch.flush());
+  // An empty batch isn't written, and isn't counted.
+  CHECK(ioBufBatch.flush());
+  auto index = static_cast<size_t>(
+      QuicTransportStatsCallback::CpuCostType::SOCKET_WRITE);
+  uint64_t numWrites = (kNumLoops + kMaxBufs - 1) / kMaxBufs;
+  EXPECT_EQ(numWrites, conn.cpuCosts.calls[index]);
+  EXPECT_EQ(numWrites, conn.cpuCosts.samples[index]);
+}
+
+class FailingPacketBatchWriter : public IOBufBatchWriter {
+ public:
+  explicit FailingPacketBatchWriter(int err) : err_(err) {}
+
+  void reset() override {
+    buf_.reset();
+  }
+
+  bool append(std::unique_ptr<folly::IOBuf>&& buf, size_t /*unused*/)
+      override {
+    buf_ = std::move(buf);
+    return true;
+  }
+
+  ssize_t write(
+      folly::AsyncUDPSocket& /*unused*/,
+      const folly::SocketAddress& /*unused*/) override {
+    errno = err_;
+    return -1;
+  }
+
+ private:
+  int err_;
+};
+
+TEST(QuicBatch, ConnectionRefusedIsNotFatal) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  folly::SocketAddress peerAddress{"127.0.0.1", 1234};
+  QuicClientConnectionState conn;
+  QuicConnectionStateBase::HappyEyeballsState happyEyeballsState;
+
+  IOBufQuicBatch ioBufBatch(
+      std::make_unique<FailingPacketBatchWriter>(ECONNREFUSED),
+      sock,
+      peerAddress,
+      conn,
+      happyEyeballsState);
+  auto buf = folly::IOBuf::copyBuffer("Test");
+  EXPECT_FALSE(ioBufBatch.write(std::move(buf), 4));
+  EXPECT_TRUE(happyEyeballsState.shouldWriteToFirstSocket);
+
+  IOBufQuicBatch fatalBatch(
+      std::make_unique<FailingPacketBatchWriter>(EBADF),
+      sock,
+      peerAddress,
+      conn,
+      happyEyeballsState);
+  buf = folly::IOBuf::copyBuffer("Test");
+  EXPECT_THROW(fatalBatch.write(std::move(buf), 4), QuicTransportException);
+}
+
+TEST(QuicBatch, SendBlocked) {
+  folly::EventBase evb;
+  folly::test::MockAsyncUDPSocket sock(&evb);
+  folly::SocketAddress peerAddress{"127.0.0.1", 1234};
+  QuicClientConnectionState conn;
+  conn.peerAddress = peerAddress;
+  conn.transportSettings.sendBlockedBackpressure = true;
+  QuicConnectionStateBase::HappyEyeballsState happyEyeballsState;
+
+  IOBufQuicBatch ioBufBatch(
+      std::make_unique<FailingPacketBatchWriter>(EAGAIN),
+      sock,
+      peerAddress,
+      conn,
+      happyEyeballsState);
+  EXPECT_FALSE(ioBufBatch.write(folly::IOBuf::copyBuffer("Test"), 4));
+  ASSERT_TRUE(conn.sendBlocked.hasValue());
+  EXPECT_TRUE(conn.sendBlocked->retryBatch);
+  // The packets after it are kept behind it.
+  EXPECT_FALSE(ioBufBatch.write(folly::IOBuf::copyBuffer("Next"), 4));
+  EXPECT_EQ(1, conn.sendBlocked->datagrams.size());
+  EXPECT_TRUE(ioBufBatch.flush());
+
+  // The batch is still blocked.
+  EXPECT_FALSE(writeSendBlockedPackets(sock, conn));
+  ASSERT_TRUE(conn.sendBlocked.hasValue());
+
+  // Once it goes, the rest follows in order.
+  conn.sendBlocked->retryBatch =
+      [](folly::AsyncUDPSocket&, const folly::SocketAddress&) -> ssize_t {
+    return 4;
+  };
+  conn.sendBlocked->datagrams.push_back(folly::IOBuf::copyBuffer("Last"));
+  std::vector<std::string> written;
+  EXPECT_CALL(sock, write(peerAddress, ::testing::_))
+      .WillOnce(::testing::Invoke(
+          [&](const folly::SocketAddress&,
+              const std::unique_ptr<folly::IOBuf>& buf) -> ssize_t {
+            written.push_back(buf->moveToFbString().toStdString());
+            return 4;
+          }))
+      .WillOnce(::testing::SetErrnoAndReturn(EAGAIN, -1));
+  EXPECT_FALSE(writeSendBlockedPackets(sock, conn));
+  ASSERT_TRUE(conn.sendBlocked.hasValue());
+  EXPECT_FALSE(conn.sendBlocked->retryBatch);
+  EXPECT_EQ(1, conn.sendBlocked->datagrams.size());
+
+  EXPECT_CALL(sock, write(peerAddress, ::testing::_))
+      .WillOnce(::testing::Invoke(
+          [&](const folly::SocketAddress&,
+              const std::unique_ptr<folly::IOBuf>& buf) -> ssize_t {
+            written.push_back(buf->moveToFbString().toStdString());
+            return 4;
+          }));
+  EXPECT_TRUE(writeSendBlockedPackets(sock, conn));
+  EXPECT_FALSE(conn.sendBlocked.hasValue());
+  EXPECT_EQ(written, std::vector<std::string>({"Next", "Last"}));
+}
 } // namespace testing
 } // namespace quic
@@ -116,6 +116,12 @@ class MockQuicSocket : public QuicSocket {
   using ReadResult =
       folly::Expected<std::pair<folly::IOBuf*, bool>, LocalErrorCode>;
   MOCK_METHOD2(readNaked, ReadResult(StreamId, size_t));
+  MOCK_METHOD3(
+      readInto,
+      folly::Expected<std::pair<size_t, bool>, LocalErrorCode>(
+          StreamId,
+          const struct iovec*,
+          size_t));
   MOCK_METHOD1(
       createBidirectionalStream,
       folly::Expected<StreamId, LocalErrorCode>(bool));
@@ -134,6 +140,12 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD2(
       notifyPendingWriteOnStream,
       folly::Expected<folly::Unit, LocalErrorCode>(StreamId, WriteCallback*));
+  MOCK_METHOD2(
+      setStreamWriteLowWatermark,
+      folly::Expected<folly::Unit, LocalErrorCode>(StreamId, uint64_t));
+  MOCK_METHOD1(
+      setConnectionWriteLowWatermark,
+      folly::Expected<folly::Unit, LocalErrorCode>(uint64_t));
   folly::Expected<Buf, LocalErrorCode> writeChain(
       StreamId id,
       Buf data,
@@ -152,6 +164,36 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD5(
       writeChain,
       WriteResult(StreamId, SharedBuf, bool, bool, DeliveryCallback*));
+  MOCK_METHOD4(
+      writeBuffers,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          std::vector<ExternalBuffer>,
+          bool,
+          DeliveryCallback*));
+  MOCK_METHOD1(
+      setFrameTemplates,
+      void(std::shared_ptr<const QuicFrameTemplates>));
+  folly::Expected<Buf, LocalErrorCode> writeFrameTemplate(
+      StreamId id,
+      QuicFrameTemplates::Handle handle,
+      bool eof,
+      bool cork,
+      DeliveryCallback* cb) override {
+    auto res = writeFrameTemplateShared(id, handle, eof, cork, cb);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    return Buf(res.value());
+  }
+  MOCK_METHOD5(
+      writeFrameTemplateShared,
+      WriteResult(
+          StreamId,
+          QuicFrameTemplates::Handle,
+          bool,
+          bool,
+          DeliveryCallback*));
   MOCK_METHOD3(
       registerDeliveryCallback,
       folly::Expected<folly::Unit, LocalErrorCode>(
@@ -168,12 +210,51 @@ class MockQuicSocket : public QuicSocket {
   MOCK_METHOD2(
       maybeResetStreamFromReadError,
       folly::Expected<folly::Unit, LocalErrorCode>(StreamId, QuicErrorCode));
+  MOCK_METHOD1(setBatchReadCallback, void(BatchReadCallback*));
   MOCK_METHOD2(sendPing, void(PingCallback*, std::chrono::milliseconds));
+  MOCK_METHOD1(setDatagramCallback, void(DatagramCallback*));
+  MOCK_CONST_METHOD0(getDatagramSizeLimit, uint16_t());
+  folly::Expected<folly::Unit, LocalErrorCode> writeDatagram(
+      Buf data) override {
+    SharedBuf sharedData(data.release());
+    return writeDatagram(sharedData);
+  }
+  MOCK_METHOD1(
+      writeDatagram,
+      folly::Expected<folly::Unit, LocalErrorCode>(SharedBuf));
+  folly::Expected<std::vector<Buf>, LocalErrorCode> readDatagrams(
+      size_t atMost) override {
+    auto res = readDatagramsNaked(atMost);
+    if (res.hasError()) {
+      return folly::makeUnexpected(res.error());
+    }
+    std::vector<Buf> datagrams;
+    for (auto datagram : res.value()) {
+      datagrams.emplace_back(datagram);
+    }
+    return datagrams;
+  }
+  using ReadDatagramsResult =
+      folly::Expected<std::vector<folly::IOBuf*>, LocalErrorCode>;
+  MOCK_METHOD1(readDatagramsNaked, ReadDatagramsResult(size_t));
   MOCK_CONST_METHOD0(getState, const QuicConnectionStateBase*());
   MOCK_METHOD0(isDetachable, bool());
   MOCK_METHOD1(attachEventBase, void(folly::EventBase*));
   MOCK_METHOD0(detachEventBase, void());
   MOCK_METHOD1(setControlStream, folly::Optional<LocalErrorCode>(StreamId));
+  MOCK_METHOD1(setWriteCork, void(bool));
+  MOCK_METHOD3(
+      setStreamPriority,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          PriorityLevel,
+          bool));
+  MOCK_METHOD1(
+      setMaxPacingRate,
+      folly::Expected<folly::Unit, LocalErrorCode>(uint64_t));
+  MOCK_METHOD2(
+      setStreamMaxSendRate,
+      folly::Expected<folly::Unit, LocalErrorCode>(StreamId, uint64_t));
 
   MOCK_METHOD2(
       setPeekCallback,
@@ -229,6 +310,12 @@ class MockQuicSocket : public QuicSocket {
           StreamId,
           uint64_t offset));
 
+  MOCK_METHOD2(
+      setStreamDeliveryDeadline,
+      folly::Expected<folly::Unit, LocalErrorCode>(
+          StreamId,
+          std::chrono::microseconds));
+
   ConnectionCallback* cb_;
 
   folly::Function<bool(const folly::Optional<std::string>&, const Buf&)>
@@ -12,6 +12,7 @@
 #include <folly/portability/GMock.h>
 
 #include <quic/state/QuicTransportStatsCallback.h>
+#include <quic/state/StateData.h>
 
 namespace quic {
 
@@ -41,6 +42,19 @@ class MockQuicStats : public QuicTransportStatsCallback {
   MOCK_METHOD0(onPTO, void());
   MOCK_METHOD1(onRead, void(size_t));
   MOCK_METHOD1(onWrite, void(size_t));
+  MOCK_METHOD2(onRecvBufferPoolStats, void(size_t, size_t));
+  MOCK_METHOD2(onBufferMemoryUsage, void(size_t, size_t));
+  MOCK_METHOD1(onWorkerHandoffBatch, void(size_t));
+  MOCK_METHOD0(onWorkerHandoffQueueFull, void());
+  MOCK_METHOD0(onRetrySent, void());
+  MOCK_METHOD1(onSpuriousLoss, void(size_t));
+  MOCK_METHOD0(onCongestionUndo, void());
+  MOCK_CONST_METHOD0(latencySamplingEnabled, bool());
+  MOCK_METHOD2(onLatencySample, void(LatencyType, std::chrono::microseconds));
+  MOCK_METHOD2(onCpuCost, void(CpuCostType, uint64_t));
+  MOCK_METHOD1(
+      onCongestionControlSample,
+      void(const CongestionControlSample&));
 };
 
 class MockQuicStatsFactory : public QuicTransportStatsCallbackFactory {
@@ -63,6 +63,17 @@ class MockReadCallback : public QuicSocket::ReadCallback {
           std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>));
 };
 
+class MockBatchReadCallback : public QuicSocket::BatchReadCallback {
+ public:
+  ~MockBatchReadCallback() override = default;
+  GMOCK_METHOD1_(
+      ,
+      noexcept,
+      ,
+      readAvailable,
+      void(folly::Range<QuicSocket::StreamReadResult*>));
+};
+
 class MockPeekCallback : public QuicSocket::PeekCallback {
  public:
   ~MockPeekCallback() override = default;
@@ -103,6 +114,12 @@ class MockConnectionCallback : public QuicSocket::ConnectionCallback {
   GMOCK_METHOD1_(, noexcept, , onFlowControlUpdate, void(StreamId));
   GMOCK_METHOD1_(, noexcept, , onNewBidirectionalStream, void(StreamId));
   GMOCK_METHOD1_(, noexcept, , onNewUnidirectionalStream, void(StreamId));
+  GMOCK_METHOD1_(
+      ,
+      noexcept,
+      ,
+      onNewStreams,
+      void(folly::Range<const StreamId*>));
   GMOCK_METHOD2_(
       ,
       noexcept,
@@ -129,6 +146,12 @@ class MockDeliveryCallback : public QuicSocket::DeliveryCallback {
   MOCK_METHOD2(onCanceled, void(StreamId, uint64_t));
 };
 
+class MockDatagramCallback : public QuicSocket::DatagramCallback {
+ public:
+  ~MockDatagramCallback() override = default;
+  GMOCK_METHOD0_(, noexcept, , onDatagramsAvailable, void());
+};
+
 class MockDataExpiredCallback : public QuicSocket::DataExpiredCallback {
  public:
   ~MockDataExpiredCallback() override = default;
@@ -188,6 +211,8 @@ class MockQuicTransport : public QuicServerTransport {
       setOriginalPeerAddress,
       void(const folly::SocketAddress&));
 
+  GMOCK_METHOD1_(, , , setOriginalConnectionId, void(const ConnectionId&));
+
   GMOCK_METHOD0_(, , , accept, void());
 
   GMOCK_METHOD1_(, , , setTransportSettings, void(TransportSettings));
@@ -207,6 +232,34 @@ class MockQuicTransport : public QuicServerTransport {
       onNetworkData,
       void(const folly::SocketAddress&, const folly::IOBuf*));
 
+  void onNetworkDataBatch(
+      const folly::SocketAddress& peer,
+      std::vector<NetworkData>&& batch) noexcept override {
+    onNetworkDataBatch(peer, batch.size());
+    for (auto& networkData : batch) {
+      onNetworkData(peer, networkData.data.get());
+    }
+  }
+
+  GMOCK_METHOD2_(
+      ,
+      noexcept,
+      ,
+      onNetworkDataBatch,
+      void(const folly::SocketAddress&, size_t));
+
+  WriteResult writeChain(
+      StreamId id,
+      Buf data,
+      bool eof,
+      bool /* cork */,
+      DeliveryCallback* /* cb */) override {
+    writeChain(id, data.get(), eof);
+    return nullptr;
+  }
+
+  GMOCK_METHOD3_(, , , writeChain, void(StreamId, const folly::IOBuf*, bool));
+
   GMOCK_METHOD1_(
       ,
       noexcept,
@@ -267,6 +320,10 @@ class MockLoopDetectorCallback : public LoopDetectorCallback {
   MOCK_METHOD4(
       onSuspiciousLoops,
       void(uint64_t, WriteDataReason, NoWriteReason, const std::string&));
+  MOCK_METHOD3(
+      onWriteBudgetExhausted,
+      void(std::chrono::microseconds, uint64_t, size_t));
+  MOCK_METHOD1(onWriteLoop, void(const WriteLoopMetrics&));
 };
 
 inline std::ostream& operator<<(std::ostream& os, const MockQuicTransport&) {
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicAsyncStream.h>
+
+#include <folly/io/async/EventBase.h>
+#include <gtest/gtest.h>
+#include <quic/api/test/MockQuicSocket.h>
+#include <quic/api/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+constexpr StreamId kStreamId = 4;
+
+class QuicAsyncStreamTest : public Test {
+ public:
+  void SetUp() override {
+    socket_ = std::make_unique<NiceMock<MockQuicSocket>>(&evb_, connCb_);
+    EXPECT_CALL(*socket_, setReadCallback(kStreamId, _))
+        .WillOnce(DoAll(
+            SaveArg<1>(&readCb_),
+            Return(folly::Expected<folly::Unit, LocalErrorCode>(folly::unit))));
+    EXPECT_CALL(*socket_, pauseRead(kStreamId));
+    stream_ = std::make_unique<QuicAsyncStream>(*socket_, kStreamId);
+    Mock::VerifyAndClearExpectations(socket_.get());
+  }
+
+  void TearDown() override {
+    stream_.reset();
+  }
+
+ protected:
+  folly::EventBase evb_;
+  NiceMock<MockConnectionCallback> connCb_;
+  std::unique_ptr<NiceMock<MockQuicSocket>> socket_;
+  std::unique_ptr<QuicAsyncStream> stream_;
+  QuicSocket::ReadCallback* readCb_{nullptr};
+};
+
+std::pair<folly::IOBuf*, bool> readResult(const std::string& str, bool eof) {
+  return std::pair<folly::IOBuf*, bool>(
+      folly::IOBuf::copyBuffer(str).release(), eof);
+}
+
+TEST_F(QuicAsyncStreamTest, ReadCompletesOnceDataIsAvailable) {
+  InSequence enforceOrder;
+  EXPECT_CALL(*socket_, readNaked(kStreamId, 100))
+      .WillOnce(Return(std::pair<folly::IOBuf*, bool>(nullptr, false)));
+  EXPECT_CALL(*socket_, resumeRead(kStreamId));
+  std::string received;
+  bool eof = false;
+  stream_->read(100, [&](QuicAsyncStream::ReadResult result) {
+    ASSERT_TRUE(result.hasValue());
+    received = result->first->moveToFbString().toStdString();
+    eof = result->second;
+  });
+  EXPECT_TRUE(stream_->readPending());
+
+  EXPECT_CALL(*socket_, readNaked(kStreamId, 100))
+      .WillOnce(Return(readResult("hello", true)));
+  EXPECT_CALL(*socket_, pauseRead(kStreamId));
+  readCb_->readAvailable(kStreamId);
+  EXPECT_FALSE(stream_->readPending());
+  EXPECT_EQ(received, "hello");
+  EXPECT_TRUE(eof);
+}
+
+TEST_F(QuicAsyncStreamTest, ContinuationStartsTheNextRead) {
+  EXPECT_CALL(*socket_, readNaked(kStreamId, _))
+      .WillOnce(Return(readResult("a", false)))
+      .WillOnce(Return(readResult("b", true)));
+  std::string received;
+  folly::Function<void(QuicAsyncStream::ReadResult)> onRead;
+  onRead = [&](QuicAsyncStream::ReadResult result) {
+    ASSERT_TRUE(result.hasValue());
+    received += result->first->moveToFbString().toStdString();
+    if (!result->second) {
+      stream_->read(10, [&](QuicAsyncStream::ReadResult next) {
+        onRead(std::move(next));
+      });
+    }
+  };
+  stream_->read(10, [&](QuicAsyncStream::ReadResult result) {
+    onRead(std::move(result));
+  });
+  EXPECT_EQ(received, "ab");
+  EXPECT_FALSE(stream_->readPending());
+}
+
+TEST_F(QuicAsyncStreamTest, ReadErrorCompletesPendingRead) {
+  EXPECT_CALL(*socket_, readNaked(kStreamId, _))
+      .WillOnce(Return(std::pair<folly::IOBuf*, bool>(nullptr, false)));
+  folly::Optional<QuicErrorCode> error;
+  stream_->read(10, [&](QuicAsyncStream::ReadResult result) {
+    ASSERT_TRUE(result.hasError());
+    error = result.error();
+  });
+  readCb_->readError(
+      kStreamId,
+      std::make_pair(
+          QuicErrorCode(LocalErrorCode::CONNECTION_RESET), folly::none));
+  ASSERT_TRUE(error.hasValue());
+  EXPECT_EQ(*error->asLocalErrorCode(), LocalErrorCode::CONNECTION_RESET);
+  EXPECT_FALSE(stream_->readPending());
+}
+
+TEST_F(QuicAsyncStreamTest, SecondPendingOperationFails) {
+  QuicSocket::WriteCallback* writeCb = nullptr;
+  EXPECT_CALL(*socket_, notifyPendingWriteOnStream(kStreamId, _))
+      .WillOnce(DoAll(
+          SaveArg<1>(&writeCb),
+          Return(folly::Expected<folly::Unit, LocalErrorCode>(folly::unit))));
+  folly::Optional<uint64_t> maxToSend;
+  stream_->writeReady([&](QuicAsyncStream::WriteReadyResult result) {
+    ASSERT_TRUE(result.hasValue());
+    maxToSend = *result;
+  });
+  bool failed = false;
+  stream_->writeReady([&](QuicAsyncStream::WriteReadyResult result) {
+    ASSERT_TRUE(result.hasError());
+    EXPECT_EQ(
+        *result.error().asLocalErrorCode(),
+        LocalErrorCode::CALLBACK_ALREADY_INSTALLED);
+    failed = true;
+  });
+  EXPECT_TRUE(failed);
+  EXPECT_TRUE(stream_->writeReadyPending());
+
+  ASSERT_NE(writeCb, nullptr);
+  writeCb->onStreamWriteReady(kStreamId, 1000);
+  EXPECT_EQ(maxToSend, 1000u);
+  EXPECT_FALSE(stream_->writeReadyPending());
+}
+
+TEST_F(QuicAsyncStreamTest, DeliveryAckAndCancel) {
+  QuicSocket::DeliveryCallback* deliveryCb = nullptr;
+  EXPECT_CALL(*socket_, registerDeliveryCallback(kStreamId, 10, _))
+      .WillOnce(DoAll(
+          SaveArg<2>(&deliveryCb),
+          Return(folly::Expected<folly::Unit, LocalErrorCode>(folly::unit))));
+  folly::Optional<std::chrono::microseconds> rtt;
+  stream_->delivery(10, [&](QuicAsyncStream::DeliveryResult result) {
+    ASSERT_TRUE(result.hasValue());
+    rtt = *result;
+  });
+  ASSERT_NE(deliveryCb, nullptr);
+  deliveryCb->onDeliveryAck(kStreamId, 10, std::chrono::microseconds(50));
+  EXPECT_EQ(rtt, std::chrono::microseconds(50));
+
+  EXPECT_CALL(*socket_, registerDeliveryCallback(kStreamId, 20, _))
+      .WillOnce(
+          Return(folly::Expected<folly::Unit, LocalErrorCode>(folly::unit)));
+  bool canceled = false;
+  stream_->delivery(20, [&](QuicAsyncStream::DeliveryResult result) {
+    ASSERT_TRUE(result.hasError());
+    canceled = true;
+  });
+  deliveryCb->onCanceled(kStreamId, 20);
+  EXPECT_TRUE(canceled);
+  EXPECT_FALSE(stream_->deliveryPending());
+}
+
+TEST_F(QuicAsyncStreamTest, DestructionUnregistersCallbacks) {
+  EXPECT_CALL(*socket_, registerDeliveryCallback(kStreamId, 10, _))
+      .WillOnce(
+          Return(folly::Expected<folly::Unit, LocalErrorCode>(folly::unit)));
+  bool called = false;
+  stream_->delivery(10, [&](QuicAsyncStream::DeliveryResult) {
+    called = true;
+  });
+  EXPECT_CALL(*socket_, setReadCallback(kStreamId, nullptr));
+  EXPECT_CALL(*socket_, cancelDeliveryCallbacksForStream(kStreamId));
+  stream_.reset();
+  EXPECT_FALSE(called);
+}
+} // namespace test
+} // namespace quic
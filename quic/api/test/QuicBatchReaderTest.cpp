@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicBatchReader.h>
+
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace testing {
+
+constexpr const auto kPacketSize = 1500;
+
+class QuicBatchReaderTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    serverSock_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    serverSock_->bind(folly::SocketAddress("127.0.0.1", 0));
+    clientSock_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    clientSock_->bind(folly::SocketAddress("127.0.0.1", 0));
+  }
+
+  void sendPackets(size_t num, size_t len) {
+    for (size_t i = 0; i < num; ++i) {
+      auto buf = folly::IOBuf::copyBuffer(std::string(len, 'a' + i));
+      CHECK_EQ(clientSock_->write(serverSock_->address(), buf), len);
+    }
+  }
+
+ protected:
+  folly::EventBase evb_;
+  std::unique_ptr<folly::AsyncUDPSocket> serverSock_;
+  std::unique_ptr<folly::AsyncUDPSocket> clientSock_;
+};
+
+TEST_F(QuicBatchReaderTest, ReadBatch) {
+  RecvmmsgBatchReader reader(4, kPacketSize);
+  sendPackets(3, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 3);
+  auto& packets = reader.packets();
+  ASSERT_EQ(packets.size(), 3);
+  for (size_t i = 0; i < packets.size(); ++i) {
+    EXPECT_FALSE(packets[i].truncated);
+    EXPECT_EQ(packets[i].peer, clientSock_->address());
+    EXPECT_EQ(
+        packets[i].data->moveToFbString().toStdString(),
+        std::string(100, 'a' + i));
+  }
+}
+
+TEST_F(QuicBatchReaderTest, ReadBatchLimitedByMaxPackets) {
+  RecvmmsgBatchReader reader(2, kPacketSize);
+  sendPackets(3, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 2);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 0);
+  EXPECT_TRUE(reader.packets().empty());
+}
+
+TEST_F(QuicBatchReaderTest, NothingToRead) {
+  RecvmmsgBatchReader reader(4, kPacketSize);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 0);
+}
+
+TEST_F(QuicBatchReaderTest, TruncatedPacket) {
+  RecvmmsgBatchReader reader(4, 50);
+  sendPackets(1, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_TRUE(reader.packets()[0].truncated);
+}
+
+TEST_F(QuicBatchReaderTest, SlabReusedWhenReleased) {
+  RecvmmsgBatchReader reader(2, kPacketSize);
+  sendPackets(1, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 1);
+  auto firstData = reader.packets()[0].data->data();
+  reader.packets().clear();
+  sendPackets(1, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_EQ(reader.packets()[0].data->data(), firstData);
+
+  // Hold on to the packet, the next batch has to use new memory.
+  auto held = std::move(reader.packets()[0].data);
+  sendPackets(1, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_NE(reader.packets()[0].data->data(), held->data());
+}
+TEST_F(QuicBatchReaderTest, GROSplitsSegments) {
+  if (!RecvmmsgBatchReader::enableGRO(serverSock_->getNetworkSocket()) ||
+      clientSock_->getGSO() < 0) {
+    return;
+  }
+  RecvmmsgBatchReader reader(4, kPacketSize, true /* groEnabled */);
+  constexpr size_t kSegmentSize = 100;
+  auto buf = folly::IOBuf::copyBuffer(std::string(kSegmentSize, 'a'));
+  buf->prependChain(folly::IOBuf::copyBuffer(std::string(kSegmentSize, 'b')));
+  buf->prependChain(folly::IOBuf::copyBuffer(std::string(50, 'c')));
+  CHECK_GT(clientSock_->writeGSO(serverSock_->address(), buf, kSegmentSize), 0);
+
+  // Whether or not the kernel coalesced the datagrams, we should see the
+  // individual segments.
+  size_t total = 0;
+  std::vector<std::string> segments;
+  while (total < 3) {
+    auto numRead = reader.readBatch(serverSock_->getNetworkSocket());
+    ASSERT_GT(numRead, 0);
+    total += numRead;
+    for (auto& packet : reader.packets()) {
+      EXPECT_FALSE(packet.truncated);
+      segments.push_back(packet.data->moveToFbString().toStdString());
+    }
+  }
+  ASSERT_EQ(segments.size(), 3);
+  EXPECT_EQ(segments[0], std::string(kSegmentSize, 'a'));
+  EXPECT_EQ(segments[1], std::string(kSegmentSize, 'b'));
+  EXPECT_EQ(segments[2], std::string(50, 'c'));
+}
+
+TEST_F(QuicBatchReaderTest, ECNCodepoint) {
+  // The sender marks its packets once ECN is enabled on its socket.
+  if (!RecvmmsgBatchReader::enableECN(
+          serverSock_->getNetworkSocket(), AF_INET) ||
+      !RecvmmsgBatchReader::enableECN(
+          clientSock_->getNetworkSocket(), AF_INET)) {
+    return;
+  }
+  RecvmmsgBatchReader reader(
+      4, kPacketSize, false /* groEnabled */, true /* ecnEnabled */);
+  sendPackets(2, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 2);
+  for (auto& packet : reader.packets()) {
+    EXPECT_EQ(packet.ecn, ECNCodepoint::ECT0);
+  }
+
+  // Without the control message space the codepoint is not reported.
+  RecvmmsgBatchReader plainReader(4, kPacketSize);
+  sendPackets(1, 100);
+  EXPECT_EQ(plainReader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_EQ(plainReader.packets()[0].ecn, ECNCodepoint::NotECT);
+}
+
+TEST_F(QuicBatchReaderTest, ReceiveTimestamps) {
+  if (!RecvmmsgBatchReader::enableTimestamps(
+          serverSock_->getNetworkSocket())) {
+    return;
+  }
+  RecvmmsgBatchReader reader(
+      4,
+      kPacketSize,
+      false /* groEnabled */,
+      false /* ecnEnabled */,
+      true /* timestampsEnabled */);
+  auto beforeSend = Clock::now();
+  sendPackets(2, 100);
+  EXPECT_EQ(reader.readBatch(serverSock_->getNetworkSocket()), 2);
+  auto afterRead = Clock::now();
+  for (auto& packet : reader.packets()) {
+    ASSERT_TRUE(packet.receiveTime.hasValue());
+    // Allow for the two clocks not being read at the same instant.
+    EXPECT_GE(*packet.receiveTime, beforeSend - std::chrono::milliseconds(1));
+    EXPECT_LE(*packet.receiveTime, afterRead);
+  }
+
+  RecvmmsgBatchReader plainReader(4, kPacketSize);
+  sendPackets(1, 100);
+  EXPECT_EQ(plainReader.readBatch(serverSock_->getNetworkSocket()), 1);
+  EXPECT_FALSE(plainReader.packets()[0].receiveTime.hasValue());
+}
+} // namespace testing
+} // namespace quic
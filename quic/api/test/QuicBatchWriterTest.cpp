@@ -7,7 +7,9 @@
  */
 
 #include <quic/api/QuicBatchWriter.h>
+#include <quic/api/QuicPacketIO.h>
 
+#include <folly/ScopeGuard.h>
 #include <gtest/gtest.h>
 
 namespace quic {
@@ -192,5 +194,235 @@ TEST(QuicBatchWriter, TestBatchingSendmmsg) {
   }
 }
 
+TEST(QuicBatchWriter, TestBatchingGSOZeroCopyFallback) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  // Without a registered tracker we should get a regular GSO writer.
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY, kBatchNum);
+  CHECK(batchWriter);
+  EXPECT_EQ(
+      dynamic_cast<GSOZeroCopyPacketBatchWriter*>(batchWriter.get()),
+      nullptr);
+}
+
+TEST(QuicBatchWriter, TestBatchingGSOZeroCopy) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer(&evb);
+  peer.setReuseAddr(false);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto tracker = ZeroCopyTracker::registerSocket(sock.getNetworkSocket());
+  if (!tracker || sock.getGSO() < 0) {
+    return;
+  }
+  SCOPE_EXIT {
+    ZeroCopyTracker::unregisterSocket(sock.getNetworkSocket());
+  };
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY, kBatchNum);
+  ASSERT_NE(
+      dynamic_cast<GSOZeroCopyPacketBatchWriter*>(batchWriter.get()),
+      nullptr);
+  std::string strTest(kStrLen, 'A');
+  for (auto j = 0; j < kBatchNum; j++) {
+    batchWriter->append(folly::IOBuf::copyBuffer(strTest), kStrLen);
+  }
+  EXPECT_EQ(batchWriter->write(sock, peer.address()), kStrLen * kBatchNum);
+  EXPECT_EQ(tracker->numPinnedBuffers(), 1);
+  tracker->onCompletion(0, 0);
+  EXPECT_EQ(tracker->numPinnedBuffers(), 0);
+}
+
+TEST(QuicBatchWriter, TestZeroCopyTrackerOutOfOrderCompletion) {
+  ZeroCopyTracker tracker;
+  for (int i = 0; i < 4; ++i) {
+    tracker.onSent(folly::IOBuf::copyBuffer("test"));
+  }
+  EXPECT_EQ(tracker.numPinnedBuffers(), 4);
+  tracker.onCompletion(2, 3);
+  EXPECT_EQ(tracker.numPinnedBuffers(), 2);
+  tracker.onCompletion(0, 1);
+  EXPECT_EQ(tracker.numPinnedBuffers(), 0);
+  tracker.onSent(folly::IOBuf::copyBuffer("test"));
+  tracker.onCompletion(4, 4);
+  EXPECT_EQ(tracker.numPinnedBuffers(), 0);
+}
+
+TEST(QuicBatchWriter, TestBatchingSendmmsgGSOGroupsByDestination) {
+  quic::SendmmsgGSOPacketBatchWriter batchWriter(kBatchNum * 2);
+  folly::SocketAddress addr1("127.0.0.1", 1000);
+  folly::SocketAddress addr2("127.0.0.1", 2000);
+  std::string strTest(kStrLen, 'A');
+
+  // run multiple loops
+  for (size_t i = 0; i < kNumLoops; i++) {
+    CHECK(batchWriter.empty());
+    CHECK_EQ(batchWriter.size(), 0);
+    // interleave equal sized packets for two destinations
+    for (size_t j = 0; j < kBatchNum - 1; j++) {
+      EXPECT_FALSE(batchWriter.append(
+          folly::IOBuf::copyBuffer(strTest), kStrLen, addr1));
+      EXPECT_FALSE(batchWriter.append(
+          folly::IOBuf::copyBuffer(strTest), kStrLen, addr2));
+    }
+    EXPECT_EQ(batchWriter.numMessages(), 2);
+    // a smaller packet ends the GSO message of its destination
+    EXPECT_FALSE(batchWriter.append(
+        folly::IOBuf::copyBuffer(strTest.substr(0, kStrLenLT)),
+        kStrLenLT,
+        addr1));
+    EXPECT_EQ(batchWriter.numMessages(), 2);
+    // a bigger packet cannot be a segment of the existing message
+    std::string bigStr(kStrLenGT, 'B');
+    CHECK(batchWriter.append(
+        folly::IOBuf::copyBuffer(bigStr), kStrLenGT, addr2));
+    EXPECT_EQ(batchWriter.numMessages(), 3);
+    EXPECT_EQ(
+        batchWriter.size(),
+        (kBatchNum - 1) * 2 * kStrLen + kStrLenLT + kStrLenGT);
+    batchWriter.reset();
+    EXPECT_EQ(batchWriter.numMessages(), 0);
+  }
+}
+
+TEST(QuicBatchWriter, TestBatchingSendmmsgGSOWrite) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  // only if GSO is available
+  if (sock.getGSO() < 0) {
+    return;
+  }
+
+  folly::AsyncUDPSocket peer1(&evb);
+  peer1.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer2(&evb);
+  peer2.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto batchWriter = quic::BatchWriterFactory::makeBatchWriter(
+      sock, quic::QuicBatchingMode::BATCHING_MODE_SENDMMSG_GSO, kBatchNum * 2);
+  auto sendmmsgGSOWriter =
+      dynamic_cast<quic::SendmmsgGSOPacketBatchWriter*>(batchWriter.get());
+  ASSERT_NE(sendmmsgGSOWriter, nullptr);
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum; i++) {
+    sendmmsgGSOWriter->append(
+        folly::IOBuf::copyBuffer(strTest), kStrLen, peer1.address());
+    sendmmsgGSOWriter->append(
+        folly::IOBuf::copyBuffer(strTest), kStrLen, peer2.address());
+  }
+  EXPECT_EQ(sendmmsgGSOWriter->numMessages(), 2);
+  EXPECT_EQ(
+      batchWriter->write(sock, folly::SocketAddress()),
+      kBatchNum * 2 * kStrLen);
+}
+TEST(QuicBatchWriter, TestBatchingTxTimeGroupsByDepartureTime) {
+  auto now = Clock::now();
+  std::vector<TimePoint> departureTimes = {
+      now, now, now, now + 1ms, now + 1ms, now + 2ms};
+  size_t next = 0;
+  quic::TxTimePacketBatchWriter batchWriter(
+      departureTimes.size(), true /* gsoEnabled */, [&]() {
+        return departureTimes[next++];
+      });
+  std::string strTest(kStrLen, 'A');
+
+  EXPECT_FALSE(batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  EXPECT_FALSE(batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  // a smaller packet ends the GSO message
+  EXPECT_FALSE(batchWriter.append(
+      folly::IOBuf::copyBuffer(strTest.substr(0, kStrLenLT)), kStrLenLT));
+  EXPECT_EQ(batchWriter.numMessages(), 1);
+  // the next burst leaves later
+  EXPECT_FALSE(batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  EXPECT_EQ(batchWriter.numMessages(), 2);
+  // a bigger packet cannot be a segment of the existing message
+  std::string bigStr(kStrLenGT, 'B');
+  EXPECT_FALSE(
+      batchWriter.append(folly::IOBuf::copyBuffer(bigStr), kStrLenGT));
+  EXPECT_EQ(batchWriter.numMessages(), 3);
+  EXPECT_TRUE(batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  EXPECT_EQ(batchWriter.numMessages(), 4);
+  EXPECT_EQ(batchWriter.size(), 4 * kStrLen + kStrLenLT + kStrLenGT);
+
+  batchWriter.reset();
+  EXPECT_TRUE(batchWriter.empty());
+  EXPECT_EQ(batchWriter.numMessages(), 0);
+}
+
+TEST(QuicBatchWriter, TestBatchingTxTimeWithoutGSO) {
+  auto now = Clock::now();
+  quic::TxTimePacketBatchWriter batchWriter(
+      kBatchNum, false /* gsoEnabled */, [now]() { return now; });
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum - 1; i++) {
+    EXPECT_FALSE(
+        batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  }
+  EXPECT_TRUE(batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  EXPECT_EQ(batchWriter.numMessages(), kBatchNum);
+}
+
+TEST(QuicBatchWriter, TestBatchingTxTimeWrite) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+  // only if the kernel supports SO_TXTIME
+  if (!quic::TxTimePacketBatchWriter::enableTxTime(sock.getNetworkSocket())) {
+    return;
+  }
+
+  folly::AsyncUDPSocket peer(&evb);
+  peer.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  auto now = Clock::now();
+  size_t numPackets = 0;
+  quic::TxTimePacketBatchWriter batchWriter(
+      kBatchNum * 2, sock.getGSO() >= 0, [&]() {
+        return now + std::chrono::microseconds(10 * (numPackets++ / 2));
+      });
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum * 2; i++) {
+    batchWriter.append(folly::IOBuf::copyBuffer(strTest), kStrLen);
+  }
+  EXPECT_EQ(
+      batchWriter.write(sock, peer.address()), kBatchNum * 2 * kStrLen);
+}
+
+TEST(QuicBatchWriter, TestSocketPacketIOSendDatagrams) {
+  folly::EventBase evb;
+  folly::AsyncUDPSocket sock(&evb);
+  sock.setReuseAddr(false);
+  sock.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  folly::AsyncUDPSocket peer1(&evb);
+  peer1.bind(folly::SocketAddress("127.0.0.1", 0));
+  folly::AsyncUDPSocket peer2(&evb);
+  peer2.bind(folly::SocketAddress("127.0.0.1", 0));
+
+  std::string strTest(kStrLen, 'A');
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs;
+  std::vector<quic::OutgoingDatagram> datagrams(3);
+  bufs.reserve(datagrams.size());
+  for (size_t i = 0; i < datagrams.size(); i++) {
+    bufs.push_back(folly::IOBuf::copyBuffer(strTest));
+    datagrams[i].address = i % 2 ? &peer2.address() : &peer1.address();
+    datagrams[i].buf = &bufs.back();
+  }
+  quic::SocketPacketIO packetIO(sock);
+  EXPECT_EQ(packetIO.sendDatagrams(datagrams.data(), 1), 1);
+  EXPECT_EQ(
+      packetIO.sendDatagrams(datagrams.data(), datagrams.size()),
+      static_cast<int>(datagrams.size()));
+}
 } // namespace testing
 } // namespace quic
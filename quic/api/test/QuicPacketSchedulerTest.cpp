@@ -334,6 +334,47 @@ TEST_F(QuicPacketSchedulerTest, CloningSchedulerTest) {
   EXPECT_EQ(packetNum, *result.first);
 }
 
+TEST_F(QuicPacketSchedulerTest, CloningSchedulerUsesCandidates) {
+  QuicClientConnectionState conn;
+  FrameScheduler noopScheduler("frame");
+  CloningScheduler cloningScheduler(noopScheduler, conn, "CopyCat", 0);
+  std::vector<PacketNum> packets;
+  for (int i = 0; i < 3; ++i) {
+    packets.push_back(addOutstandingPacket(conn));
+    conn.outstandingPackets.back().packet.frames.push_back(
+        MaxDataFrame(conn.flowControlState.advertisedMaxOffset));
+  }
+  // Only the last two are candidates, and one that is gone.
+  conn.cloneCandidates = {packets[1], packets[2], packets[2] + 100};
+  auto schedule = [&]() {
+    ShortHeader header(
+        ProtectionType::KeyPhaseOne,
+        conn.clientConnectionId.value_or(getTestConnectionId()),
+        getNextPacketNum(conn, PacketNumberSpace::AppData));
+    RegularQuicPacketBuilder builder(
+        conn.udpSendPacketLen,
+        std::move(header),
+        conn.ackStates.appDataAckState.largestAckedByPeer);
+    auto result = cloningScheduler.scheduleFramesForPacket(
+        std::move(builder), kDefaultUDPSendPacketLen);
+    EXPECT_TRUE(result.first.hasValue() && result.second.hasValue());
+    return result.first.value_or(0);
+  };
+  EXPECT_EQ(packets[2], schedule());
+  EXPECT_EQ(
+      std::deque<PacketNum>({packets[1], packets[2]}), conn.cloneCandidates);
+
+  // Once the newest is acked, the next candidate.
+  conn.outstandingPackets.erase(std::prev(conn.outstandingPackets.end()));
+  EXPECT_EQ(packets[1], schedule());
+  EXPECT_EQ(std::deque<PacketNum>({packets[1]}), conn.cloneCandidates);
+
+  // And the packets older than the candidates after them.
+  conn.outstandingPackets.erase(std::prev(conn.outstandingPackets.end()));
+  EXPECT_EQ(packets[0], schedule());
+  EXPECT_TRUE(conn.cloneCandidates.empty());
+}
+
 TEST_F(QuicPacketSchedulerTest, WriteOnlyOutstandingPacketsTest) {
   QuicClientConnectionState conn;
   FrameScheduler noopScheduler("frame");
@@ -816,5 +857,187 @@ TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerRemoveOne) {
   EXPECT_EQ(*builder.frames_[0].asWriteStreamFrame(), f1);
 }
 
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerPriority) {
+  QuicClientConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = 100000;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote = 100000;
+  StreamFrameScheduler scheduler(conn);
+  MockQuicPacketBuilder builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream3 = conn.streamManager->createNextBidirectionalStream().value();
+  conn.streamManager->setStreamPriority(*stream2, Priority(0, false));
+  conn.streamManager->setStreamPriority(*stream3, Priority(0, false));
+  writeDataToQuicStream(*stream1, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream2, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream3, folly::IOBuf::copyBuffer("some data"), false);
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(4096));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 3);
+  WriteStreamFrame f1(stream2->id, 0, 9, false);
+  WriteStreamFrame f2(stream3->id, 0, 9, false);
+  WriteStreamFrame f3(stream1->id, 0, 9, false);
+  ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[0].asWriteStreamFrame(), f1);
+  ASSERT_TRUE(builder.frames_[1].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[1].asWriteStreamFrame(), f2);
+  ASSERT_TRUE(builder.frames_[2].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[2].asWriteStreamFrame(), f3);
+
+  // A full packet does not move the round robin of a less urgent group.
+  builder.frames_.clear();
+  conn.schedulingState.nextScheduledStream = stream3->id;
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(0));
+  scheduler.writeStreams(builder);
+  EXPECT_TRUE(builder.frames_.empty());
+  EXPECT_EQ(conn.schedulingState.nextScheduledStream, stream3->id);
+}
+
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerDeadline) {
+  QuicClientConnectionState conn;
+  conn.partialReliabilityEnabled = true;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = 100000;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote = 100000;
+  StreamFrameScheduler scheduler(conn);
+  MockQuicPacketBuilder builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream3 = conn.streamManager->createNextBidirectionalStream().value();
+  stream2->deliveryDeadline = 100ms;
+  stream3->deliveryDeadline = 50ms;
+  writeDataToQuicStream(*stream1, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream2, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream3, folly::IOBuf::copyBuffer("some data"), false);
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(4096));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeStreams(builder);
+  // Earliest deadline first, then the streams without a deadline.
+  ASSERT_EQ(builder.frames_.size(), 3);
+  WriteStreamFrame f1(stream3->id, 0, 9, false);
+  WriteStreamFrame f2(stream2->id, 0, 9, false);
+  WriteStreamFrame f3(stream1->id, 0, 9, false);
+  ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[0].asWriteStreamFrame(), f1);
+  ASSERT_TRUE(builder.frames_[1].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[1].asWriteStreamFrame(), f2);
+  ASSERT_TRUE(builder.frames_[2].asWriteStreamFrame());
+  EXPECT_EQ(*builder.frames_[2].asWriteStreamFrame(), f3);
+}
+
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerFillPacket) {
+  QuicClientConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = 100000;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote = 100000;
+  StreamFrameScheduler scheduler(conn);
+  MockQuicPacketBuilder builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  // The offset of stream1 takes 4 bytes, so its header doesn't fit in the
+  // 5 bytes left, while the 2 bytes one of stream2 does.
+  stream1->currentWriteOffset = 1 << 20;
+  stream1->flowControlState.peerAdvertisedMaxOffset = (1 << 20) + 100000;
+  writeDataToQuicStream(*stream1, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream2, folly::IOBuf::copyBuffer("some data"), false);
+  builder.remaining_ = 5;
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Invoke([&]() {
+    return builder.remaining_;
+  }));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    // The frame takes the rest of the packet.
+    builder.remaining_ = 0;
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeStreams(builder);
+  EXPECT_TRUE(builder.frames_.empty());
+
+  conn.transportSettings.fillPacketsWithStreams = true;
+  scheduler.writeStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 1);
+  ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
+  EXPECT_EQ(
+      *builder.frames_[0].asWriteStreamFrame(),
+      WriteStreamFrame(stream2->id, 0, 3, false));
+  // The stream that didn't fit still goes first in the next packet.
+  EXPECT_EQ(conn.schedulingState.nextScheduledStream, stream1->id);
+}
+
+TEST_F(QuicPacketSchedulerTest, StreamFrameSchedulerSendRateLimit) {
+  QuicClientConnectionState conn;
+  conn.streamManager->setMaxLocalBidirectionalStreams(10);
+  conn.flowControlState.peerAdvertisedMaxOffset = 100000;
+  conn.flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote = 100000;
+  StreamFrameScheduler scheduler(conn);
+  MockQuicPacketBuilder builder;
+  auto stream1 = conn.streamManager->createNextBidirectionalStream().value();
+  auto stream2 = conn.streamManager->createNextBidirectionalStream().value();
+  // A bucket of 4 bytes that doesn't refill until the test moves it back.
+  stream1->sendRateLimit.emplace(1000, 4, Clock::now() + 1h);
+  writeDataToQuicStream(*stream1, folly::IOBuf::copyBuffer("some data"), false);
+  writeDataToQuicStream(*stream2, folly::IOBuf::copyBuffer("some data"), false);
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(4096));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.frames_.push_back(f);
+  }));
+  scheduler.writeStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 2);
+  ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
+  EXPECT_EQ(
+      *builder.frames_[0].asWriteStreamFrame(),
+      WriteStreamFrame(stream1->id, 0, 4, false));
+  ASSERT_TRUE(builder.frames_[1].asWriteStreamFrame());
+  EXPECT_EQ(
+      *builder.frames_[1].asWriteStreamFrame(),
+      WriteStreamFrame(stream2->id, 0, 9, false));
+  EXPECT_EQ(0, stream1->sendRateLimit->tokens);
+
+  // Out of tokens, the stream is skipped.
+  builder.frames_.clear();
+  scheduler.writeStreams(builder);
+  EXPECT_TRUE(builder.frames_.empty());
+
+  // The bucket refills up to its depth.
+  stream1->sendRateLimit->lastRefillTime = Clock::now() - 1s;
+  scheduler.writeStreams(builder);
+  ASSERT_EQ(builder.frames_.size(), 1);
+  ASSERT_TRUE(builder.frames_[0].asWriteStreamFrame());
+  EXPECT_EQ(
+      *builder.frames_[0].asWriteStreamFrame(),
+      WriteStreamFrame(stream1->id, 4, 4, false));
+}
+
+TEST_F(QuicPacketSchedulerTest, DatagramFrameSchedulerInOrder) {
+  QuicClientConnectionState conn;
+  conn.datagramState.writeBuffer.push_back(buildRandomInputData(100));
+  conn.datagramState.writeBuffer.push_back(buildRandomInputData(200));
+  conn.datagramState.writeBuffer.push_back(buildRandomInputData(50));
+  DatagramFrameScheduler scheduler(conn);
+  EXPECT_TRUE(scheduler.hasPendingDatagrams());
+  MockQuicPacketBuilder builder;
+  // Room for the first datagram, not the second one. The third one would fit
+  // but isn't written ahead of the second.
+  builder.remaining_ = 250;
+  EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Invoke([&]() {
+    return builder.remaining_;
+  }));
+  EXPECT_CALL(builder, appendFrame(_)).WillRepeatedly(Invoke([&](auto f) {
+    builder.remaining_ -= f.asWriteDatagramFrame()->len + 3;
+    builder.frames_.push_back(f);
+  }));
+  EXPECT_TRUE(scheduler.writeDatagramFrames(builder));
+  ASSERT_EQ(1, builder.frames_.size());
+  EXPECT_EQ(
+      WriteDatagramFrame(100), *builder.frames_[0].asWriteDatagramFrame());
+  // The queue is only popped when the packet is sent.
+  EXPECT_EQ(3, conn.datagramState.writeBuffer.size());
+}
+
 } // namespace test
 } // namespace quic
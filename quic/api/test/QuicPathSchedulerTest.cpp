@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicPathScheduler.h>
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class QuicPathSchedulerTest : public Test {
+ public:
+  void SetUp() override {
+    conn_.udpSendPacketLen = 1000;
+    conn_.lossState.srtt = 50ms;
+    auto congestionController = std::make_unique<MockCongestionController>();
+    EXPECT_CALL(*congestionController, getWritableBytes())
+        .WillRepeatedly(Return(10 * 1000));
+    conn_.congestionController = std::move(congestionController);
+  }
+
+  SecondaryPath& addPath(
+      std::chrono::microseconds srtt,
+      uint64_t writableBytes,
+      uint64_t weight = 1) {
+    SecondaryPath path;
+    path.id = conn_.nextPathId++;
+    path.peerAddress = folly::SocketAddress("1.2.3.4", 1234 + path.id);
+    path.srtt = srtt;
+    path.weight = weight;
+    auto congestionController = std::make_unique<MockCongestionController>();
+    EXPECT_CALL(*congestionController, getWritableBytes())
+        .WillRepeatedly(Return(writableBytes));
+    path.congestionController = std::move(congestionController);
+    conn_.secondaryPaths.push_back(std::move(path));
+    return conn_.secondaryPaths.back();
+  }
+
+ protected:
+  QuicServerConnectionState conn_;
+};
+
+TEST_F(QuicPathSchedulerTest, PrimaryPathOnly) {
+  auto writes = schedulePathWrites(conn_, 8);
+  ASSERT_EQ(1, writes.size());
+  EXPECT_EQ(kPrimaryPathId, writes[0].pathId);
+  EXPECT_EQ(8, writes[0].packetLimit);
+}
+
+TEST_F(QuicPathSchedulerTest, MinRtt) {
+  auto& fastPath = addPath(20ms, 2500);
+  addPath(80ms, 0);
+  auto writes = schedulePathWrites(conn_, 8);
+  ASSERT_EQ(2, writes.size());
+  EXPECT_EQ(fastPath.id, writes[0].pathId);
+  EXPECT_EQ(3, writes[0].packetLimit);
+  EXPECT_EQ(kPrimaryPathId, writes[1].pathId);
+  EXPECT_EQ(5, writes[1].packetLimit);
+}
+
+TEST_F(QuicPathSchedulerTest, MinRttKeepsPacketForPrimaryPath) {
+  auto& fastPath = addPath(20ms, 100 * 1000);
+  auto writes = schedulePathWrites(conn_, 8);
+  ASSERT_EQ(2, writes.size());
+  EXPECT_EQ(fastPath.id, writes[0].pathId);
+  EXPECT_EQ(7, writes[0].packetLimit);
+  EXPECT_EQ(kPrimaryPathId, writes[1].pathId);
+  EXPECT_EQ(1, writes[1].packetLimit);
+}
+
+TEST_F(QuicPathSchedulerTest, Weighted) {
+  conn_.transportSettings.pathScheduler = PathSchedulerType::Weighted;
+  auto& heavyPath = addPath(80ms, 100 * 1000, 3);
+  auto& smallPath = addPath(80ms, 1000, 4);
+  auto writes = schedulePathWrites(conn_, 16);
+  ASSERT_EQ(3, writes.size());
+  // The small path is capped by its cwnd, the rest goes to the primary path.
+  EXPECT_EQ(kPrimaryPathId, writes[0].pathId);
+  EXPECT_EQ(9, writes[0].packetLimit);
+  EXPECT_EQ(heavyPath.id, writes[1].pathId);
+  EXPECT_EQ(6, writes[1].packetLimit);
+  EXPECT_EQ(smallPath.id, writes[2].pathId);
+  EXPECT_EQ(1, writes[2].packetLimit);
+}
+
+TEST_F(QuicPathSchedulerTest, ScopedPathWrite) {
+  auto& path = addPath(20ms, 1000);
+  auto primaryAddress = conn_.peerAddress;
+  auto pathAddress = path.peerAddress;
+  auto primaryCongestionController = conn_.congestionController.get();
+  auto pathCongestionController = path.congestionController.get();
+  conn_.pacer = std::make_unique<MockPacer>();
+  auto pacer = conn_.pacer.get();
+  {
+    ScopedPathWrite scopedPathWrite(conn_, path);
+    EXPECT_EQ(path.id, conn_.writePathId);
+    EXPECT_EQ(pathAddress, conn_.peerAddress);
+    EXPECT_EQ(pathCongestionController, conn_.congestionController.get());
+    EXPECT_EQ(nullptr, conn_.pacer);
+  }
+  EXPECT_EQ(kPrimaryPathId, conn_.writePathId);
+  EXPECT_EQ(primaryAddress, conn_.peerAddress);
+  EXPECT_EQ(pathAddress, path.peerAddress);
+  EXPECT_EQ(primaryCongestionController, conn_.congestionController.get());
+  EXPECT_EQ(pathCongestionController, path.congestionController.get());
+  EXPECT_EQ(pacer, conn_.pacer.get());
+}
+} // namespace test
+} // namespace quic
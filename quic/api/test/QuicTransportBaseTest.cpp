@@ -605,6 +605,95 @@ TEST_F(QuicTransportImplTest, ReadCallbackNoCallbackSet) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, BatchReadCallback) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  auto stream2 = transport->createBidirectionalStream().value();
+  auto stream3 = transport->createBidirectionalStream().value();
+  MockReadCallback readCb;
+  MockBatchReadCallback batchReadCb;
+  transport->setReadCallback(stream3, &readCb);
+  transport->setBatchReadCallback(&batchReadCb);
+
+  transport->addDataToStream(
+      stream1, StreamBuffer(folly::IOBuf::copyBuffer("data1"), 0));
+  transport->addDataToStream(
+      stream2, StreamBuffer(folly::IOBuf::copyBuffer("data2"), 0, true));
+  transport->addDataToStream(
+      stream3, StreamBuffer(folly::IOBuf::copyBuffer("data3"), 0));
+
+  // The stream with its own callback keeps using it.
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  EXPECT_CALL(batchReadCb, readAvailable(_))
+      .WillOnce(Invoke([&](folly::Range<QuicSocket::StreamReadResult*> rs) {
+        ASSERT_EQ(2, rs.size());
+        std::map<StreamId, QuicSocket::StreamReadResult*> results;
+        for (auto& result : rs) {
+          results.emplace(result.id, &result);
+        }
+        ASSERT_EQ(1, results.count(stream1));
+        ASSERT_EQ(1, results.count(stream2));
+        EXPECT_EQ("data1", results[stream1]->data->moveToFbString());
+        EXPECT_FALSE(results[stream1]->eof);
+        EXPECT_EQ("data2", results[stream2]->data->moveToFbString());
+        EXPECT_TRUE(results[stream2]->eof);
+        EXPECT_FALSE(results[stream1]->error.hasValue());
+      }));
+  transport->driveReadCallbacks();
+
+  // Nothing new to read.
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  EXPECT_CALL(batchReadCb, readAvailable(_)).Times(0);
+  transport->driveReadCallbacks();
+
+  transport->addStreamReadError(stream1, LocalErrorCode::NO_ERROR);
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  EXPECT_CALL(batchReadCb, readAvailable(_))
+      .WillOnce(Invoke([&](folly::Range<QuicSocket::StreamReadResult*> rs) {
+        ASSERT_EQ(1, rs.size());
+        EXPECT_EQ(stream1, rs[0].id);
+        EXPECT_EQ(QuicErrorCode(LocalErrorCode::NO_ERROR), *rs[0].error);
+      }));
+  transport->driveReadCallbacks();
+
+  // Without the batch callback the data waits for read().
+  transport->setBatchReadCallback(nullptr);
+  auto stream4 = transport->createBidirectionalStream().value();
+  transport->addDataToStream(
+      stream4, StreamBuffer(folly::IOBuf::copyBuffer("data4"), 0));
+  EXPECT_CALL(readCb, readAvailable(stream3));
+  transport->driveReadCallbacks();
+  EXPECT_EQ("data4", transport->read(stream4, 0)->first->moveToFbString());
+  transport.reset();
+}
+
+TEST_F(QuicTransportImplTest, ReadInto) {
+  auto stream1 = transport->createBidirectionalStream().value();
+  MockReadCallback readCb;
+  transport->setReadCallback(stream1, &readCb);
+  transport->addDataToStream(
+      stream1,
+      StreamBuffer(folly::IOBuf::copyBuffer("actual stream data"), 0, true));
+
+  std::array<char, 10> buf;
+  iovec vec = {buf.data(), buf.size()};
+  auto result = transport->readInto(stream1, &vec, 1);
+  ASSERT_FALSE(result.hasError());
+  EXPECT_EQ(10, result->first);
+  EXPECT_FALSE(result->second);
+  EXPECT_EQ("actual str", std::string(buf.data(), 10));
+
+  result = transport->readInto(stream1, &vec, 1);
+  ASSERT_FALSE(result.hasError());
+  EXPECT_EQ(8, result->first);
+  EXPECT_TRUE(result->second);
+  EXPECT_EQ("eam data", std::string(buf.data(), 8));
+
+  EXPECT_EQ(
+      LocalErrorCode::STREAM_NOT_EXISTS,
+      transport->readInto(0x10, &vec, 1).error());
+  transport.reset();
+}
+
 TEST_F(QuicTransportImplTest, ReadCallbackInvalidStream) {
   MockReadCallback readCb1;
   StreamId invalidStream = 10;
@@ -856,6 +945,30 @@ TEST_F(QuicTransportImplTest, onNewBidirectionalStreamStreamOutOfOrder) {
   transport.reset();
 }
 
+TEST_F(QuicTransportImplTest, onNewStreamsBatched) {
+  auto& conn = transport->getConnectionState();
+  conn.transportSettings.batchNewPeerStreamCallbacks = true;
+  auto readData = folly::IOBuf::copyBuffer("actual stream data");
+  EXPECT_CALL(connCallback, onNewBidirectionalStream(_)).Times(0);
+  EXPECT_CALL(connCallback, onNewUnidirectionalStream(_)).Times(0);
+  std::vector<StreamId> expected = {0x00, 0x04, 0x08, 0x0c};
+  EXPECT_CALL(connCallback, onNewStreams(_))
+      .WillOnce(Invoke([&](folly::Range<const StreamId*> ids) {
+        EXPECT_EQ(expected, std::vector<StreamId>(ids.begin(), ids.end()));
+      }));
+  transport->addDataToStream(0x0c, StreamBuffer(readData->clone(), 0, true));
+  // The state of the lower streams was created along with the last.
+  EXPECT_EQ(4, conn.streamManager->streamCount());
+
+  expected = {0x02};
+  EXPECT_CALL(connCallback, onNewStreams(_))
+      .WillOnce(Invoke([&](folly::Range<const StreamId*> ids) {
+        EXPECT_EQ(expected, std::vector<StreamId>(ids.begin(), ids.end()));
+      }));
+  transport->addDataToStream(0x02, StreamBuffer(readData->clone(), 0, true));
+  transport.reset();
+}
+
 TEST_F(QuicTransportImplTest, onNewBidirectionalStreamSetReadCallback) {
   InSequence dummy;
   auto readData = folly::IOBuf::copyBuffer("actual stream data");
@@ -1286,6 +1399,89 @@ TEST_P(QuicTransportImplTestClose, TestNotifyPendingWriteOnCloseWithError) {
   evb->loopOnce();
 }
 
+TEST_F(QuicTransportImplTest, StreamWriteLowWatermark) {
+  auto stream = transport->createBidirectionalStream().value();
+  auto streamState = transport->getStream(stream);
+  streamState->writeBuffer.append(IOBuf::copyBuffer("0123456789"));
+  streamState->flowControlState.peerAdvertisedMaxOffset = 60;
+  EXPECT_TRUE(transport->setStreamWriteLowWatermark(stream, 100).hasValue());
+
+  MockWriteCallback wcb;
+  EXPECT_CALL(wcb, onStreamWriteReady(stream, _)).Times(0);
+  transport->notifyPendingWriteOnStream(stream, &wcb);
+  evb->loopOnce();
+  Mock::VerifyAndClearExpectations(&wcb);
+
+  // More flow control gets the stream over the watermark.
+  streamState->flowControlState.peerAdvertisedMaxOffset = 200;
+  transport->transportConn->streamManager->queueFlowControlUpdated(stream);
+  EXPECT_CALL(wcb, onStreamWriteReady(stream, 190));
+  transport->addDataToStream(
+      stream, StreamBuffer(IOBuf::copyBuffer("hello"), 0, false));
+  evb->loopOnce();
+}
+
+TEST_F(QuicTransportImplTest, StreamWriteLowWatermarkNothingBuffered) {
+  auto stream = transport->createBidirectionalStream().value();
+  auto streamState = transport->getStream(stream);
+  streamState->flowControlState.peerAdvertisedMaxOffset = 50;
+  EXPECT_TRUE(transport->setStreamWriteLowWatermark(stream, 100).hasValue());
+
+  // The stream can't get more room by sending, so it doesn't wait.
+  MockWriteCallback wcb;
+  EXPECT_CALL(wcb, onStreamWriteReady(stream, 50));
+  transport->notifyPendingWriteOnStream(stream, &wcb);
+  evb->loopOnce();
+}
+
+TEST_F(QuicTransportImplTest, ConnectionWriteLowWatermark) {
+  auto stream = transport->createBidirectionalStream().value();
+  auto& conn = *transport->transportConn;
+  conn.flowControlState.sumCurStreamBufferLen = 10;
+  conn.flowControlState.peerAdvertisedMaxOffset =
+      conn.flowControlState.sumCurWriteOffset + 60;
+  EXPECT_TRUE(transport->setConnectionWriteLowWatermark(100).hasValue());
+
+  MockWriteCallback wcb;
+  EXPECT_CALL(wcb, onConnectionWriteReady(_)).Times(0);
+  transport->notifyPendingWriteOnConnection(&wcb);
+  evb->loopOnce();
+  Mock::VerifyAndClearExpectations(&wcb);
+
+  conn.flowControlState.peerAdvertisedMaxOffset += 140;
+  EXPECT_CALL(wcb, onConnectionWriteReady(190));
+  transport->addDataToStream(
+      stream, StreamBuffer(IOBuf::copyBuffer("hello"), 0, false));
+  evb->loopOnce();
+
+  transport->close(folly::none);
+  EXPECT_EQ(
+      transport->setConnectionWriteLowWatermark(0).error(),
+      LocalErrorCode::CONNECTION_CLOSED);
+}
+
+TEST_F(QuicTransportImplTest, CloseCancelsCallbacksOfManyStreams) {
+  constexpr size_t kNumStreams = 100;
+  MockWriteCallback wcb;
+  MockReadCallback rcb;
+  std::vector<StreamId> streams;
+  for (size_t i = 0; i < kNumStreams; ++i) {
+    auto stream = transport->createBidirectionalStream().value();
+    transport->notifyPendingWriteOnStream(stream, &wcb);
+    transport->setReadCallback(stream, &rcb);
+    streams.push_back(stream);
+  }
+  for (auto stream : streams) {
+    EXPECT_CALL(
+        wcb, onStreamWriteError(stream, IsError(LocalErrorCode::NO_ERROR)));
+    EXPECT_CALL(rcb, readError(stream, IsError(LocalErrorCode::NO_ERROR)));
+  }
+  transport->close(folly::none);
+  auto& streamManager = *transport->getConnectionState().streamManager;
+  EXPECT_EQ(streamManager.streamCount(), 0);
+  EXPECT_EQ(streamManager.streamStatePool().numFree(), 0);
+}
+
 TEST_F(QuicTransportImplTest, TestGracefulCloseWithActiveStream) {
   EXPECT_CALL(connCallback, onConnectionEnd()).Times(0);
   EXPECT_CALL(connCallback, onConnectionError(_)).Times(0);
@@ -1478,6 +1674,68 @@ TEST_F(QuicTransportImplTest, AsyncStreamFlowControlWrite) {
   EXPECT_TRUE(streamState->latestMaxStreamDataPacket.hasValue());
 }
 
+class QuicTransportImplCorkTest : public QuicTransportImplTest {
+ public:
+  void SetUp() override {
+    QuicTransportImplTest::SetUp();
+    stream = transport->createBidirectionalStream().value();
+    EXPECT_CALL(*socketPtr, write(_, _))
+        .WillRepeatedly(Invoke([&](const auto&, const auto& buf) {
+          ++socketWrites;
+          return buf->computeChainDataLength();
+        }));
+  }
+
+  // Writes from a loop callback, like the apps do from the transport
+  // callbacks.
+  void writeInLoop(size_t size, bool cork) {
+    evb->runInLoop([this, size, cork] {
+      auto buf = IOBuf::create(size);
+      buf->append(size);
+      transport->writeChain(stream, std::move(buf), false, cork);
+    });
+  }
+
+  StreamId stream;
+  size_t socketWrites{0};
+};
+
+TEST_F(QuicTransportImplCorkTest, CorkedWriteWaitsForNextLoop) {
+  writeInLoop(10, true);
+  evb->loopOnce();
+  EXPECT_EQ(socketWrites, 0);
+  evb->loopOnce();
+  EXPECT_GT(socketWrites, 0);
+}
+
+TEST_F(QuicTransportImplCorkTest, CorkedFullPacketIsNotDelayed) {
+  writeInLoop(transport->transportConn->udpSendPacketLen, true);
+  evb->loopOnce();
+  EXPECT_GT(socketWrites, 0);
+}
+
+TEST_F(QuicTransportImplCorkTest, UncorkedWriteSendsCorkedData) {
+  writeInLoop(10, true);
+  writeInLoop(10, false);
+  evb->loopOnce();
+  EXPECT_GT(socketWrites, 0);
+}
+
+TEST_F(QuicTransportImplCorkTest, ConnectionCork) {
+  transport->setWriteCork(true);
+  writeInLoop(10, false);
+  evb->loopOnce();
+  EXPECT_EQ(socketWrites, 0);
+}
+
+TEST_F(QuicTransportImplCorkTest, ConnectionUncorkSendsCorkedData) {
+  transport->setWriteCork(true);
+  writeInLoop(10, false);
+  evb->runInLoop([&] { transport->setWriteCork(false); });
+  evb->loopOnce();
+  EXPECT_GT(socketWrites, 0);
+}
+
 TEST_F(QuicTransportImplTest, ExceptionInWriteLooperDoesNotCrash) {
   auto stream = transport->createBidirectionalStream().value();
   transport->setReadCallback(stream, nullptr);
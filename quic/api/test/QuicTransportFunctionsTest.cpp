@@ -951,6 +951,35 @@ TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionConnWindowUpdate) {
   EXPECT_EQ(packetNum, *conn->latestMaxDataPacket);
 }
 
+TEST_F(QuicTransportFunctionsTest, TestUpdateConnectionDatagram) {
+  auto conn = createConn();
+  conn->qLogger = std::make_shared<quic::FileQLogger>(VantagePoint::CLIENT);
+  conn->datagramState.writeBuffer.push_back(buildRandomInputData(100));
+  conn->datagramState.writeBuffer.push_back(buildRandomInputData(50));
+  auto packet = buildEmptyPacket(*conn, PacketNumberSpace::AppData);
+  packet.packet.frames.push_back(WriteDatagramFrame(100));
+  updateConnection(
+      *conn, folly::none, packet.packet, TimePoint(), getEncodedSize(packet));
+
+  ASSERT_EQ(1, conn->datagramState.writeBuffer.size());
+  EXPECT_EQ(50, conn->datagramState.writeBuffer.front()->length());
+  auto outstanding =
+      getFirstOutstandingPacket(*conn, PacketNumberSpace::AppData);
+  ASSERT_TRUE(outstanding);
+  EXPECT_FALSE(outstanding->pureAck);
+
+  std::shared_ptr<quic::FileQLogger> qLogger =
+      std::dynamic_pointer_cast<quic::FileQLogger>(conn->qLogger);
+  std::vector<int> indices =
+      getQLogEventIndices(QLogEventType::PacketSent, qLogger);
+  EXPECT_EQ(indices.size(), 1);
+  auto tmp = std::move(qLogger->logs[indices[0]]);
+  auto event = dynamic_cast<QLogPacketEvent*>(tmp.get());
+  EXPECT_EQ(event->frames.size(), 1);
+  auto frame = static_cast<DatagramFrameLog*>(event->frames[0].get());
+  EXPECT_EQ(frame->len, 100);
+}
+
 TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketWithCC) {
   auto conn = createConn();
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1222,6 +1251,37 @@ TEST_F(QuicTransportFunctionsTest, WriteQuicDataToSocketRetxBufferSorted) {
       stream->retransmissionBuffer.front().offset);
 }
 
+TEST_F(QuicTransportFunctionsTest, CachedWriteLoopTime) {
+  EventBase evb;
+  folly::test::MockAsyncUDPSocket socket(&evb);
+  auto conn = createConn();
+  conn->transportSettings.cachedWriteLoopTime = true;
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(
+      *stream, buildRandomInputData(conn->udpSendPacketLen * 3), false);
+  EXPECT_CALL(socket, write(_, _))
+      .WillRepeatedly(Invoke([&](const SocketAddress&,
+                                 const std::unique_ptr<folly::IOBuf>& iobuf) {
+        return iobuf->computeChainDataLength();
+      }));
+  auto before = Clock::now();
+  writeQuicDataToSocket(
+      socket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      *aead,
+      *headerCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  ASSERT_GT(conn->outstandingPackets.size(), 1);
+  auto sentTime = conn->outstandingPackets.front().time;
+  EXPECT_GE(sentTime, before);
+  for (const auto& packet : conn->outstandingPackets) {
+    EXPECT_EQ(packet.time, sentTime);
+  }
+}
+
 TEST_F(QuicTransportFunctionsTest, NothingWritten) {
   auto conn = createConn();
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1256,7 +1316,7 @@ TEST_F(QuicTransportFunctionsTest, NothingWritten) {
 }
 
 const QuicWriteFrame& getFirstFrameInOutstandingPackets(
-    const std::deque<OutstandingPacket>& outstandingPackets,
+    const OutstandingPacketQueue& outstandingPackets,
     QuicWriteFrame::Type frameType) {
   for (const auto& packet : outstandingPackets) {
     for (const auto& frame : packet.packet.frames) {
@@ -1700,6 +1760,45 @@ TEST_F(QuicTransportFunctionsTest, ShouldWriteDataNoConnFlowControl) {
   EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(*conn));
 }
 
+TEST_F(QuicTransportFunctionsTest, GetWriteLimit) {
+  auto conn = createConn();
+  conn->oneRttWriteCipher = test::createNoOpAead();
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Return(1500));
+  conn->congestionController = std::move(mockCongestionController);
+  EXPECT_EQ(WriteLimit::Idle, getWriteLimit(*conn));
+
+  auto stream1 = conn->streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream1, IOBuf::copyBuffer("0123456789"), false);
+  EXPECT_EQ(WriteLimit::Busy, getWriteLimit(*conn));
+
+  auto peerMaxOffset = conn->flowControlState.peerAdvertisedMaxOffset;
+  conn->flowControlState.peerAdvertisedMaxOffset = 0;
+  EXPECT_EQ(WriteLimit::FlowControlLimited, getWriteLimit(*conn));
+  conn->flowControlState.peerAdvertisedMaxOffset = peerMaxOffset;
+
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Return(0));
+  EXPECT_EQ(WriteLimit::CwndLimited, getWriteLimit(*conn));
+
+  EXPECT_CALL(*rawCongestionController, getWritableBytes())
+      .WillRepeatedly(Return(1500));
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  writeQuicDataToSocket(
+      *socket,
+      *conn,
+      *conn->clientConnectionId,
+      *conn->serverConnectionId,
+      *aead,
+      *headerCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+  EXPECT_EQ(WriteLimit::AppLimited, getWriteLimit(*conn));
+}
+
 TEST_F(QuicTransportFunctionsTest, HasAckDataToWriteCipherAndAckStateMatch) {
   auto conn = createConn();
   EXPECT_FALSE(hasAckDataToWrite(*conn));
@@ -1798,6 +1897,22 @@ TEST_F(QuicTransportFunctionsTest, UpdateConnectionCloneCounter) {
   EXPECT_EQ(1, conn->outstandingClonedPacketsCount);
 }
 
+TEST_F(QuicTransportFunctionsTest, WriteBatchSize) {
+  auto conn = createConn();
+  conn->udpSendPacketLen = 1000;
+  conn->transportSettings.maxBatchSize = 16;
+  EXPECT_EQ(16, getWriteBatchSize(*conn, 5, 100000));
+
+  conn->transportSettings.adaptiveBatchSize = true;
+  // Pacer burst
+  EXPECT_EQ(5, getWriteBatchSize(*conn, 5, 100000));
+  // Cwnd headroom, a partial packet still gets written
+  EXPECT_EQ(3, getWriteBatchSize(*conn, 20, 2500));
+  // Kernel GSO limit
+  EXPECT_EQ(kMaxGSOSegments, getWriteBatchSize(*conn, 1000, 1000000));
+  EXPECT_EQ(1, getWriteBatchSize(*conn, 20, 0));
+}
+
 TEST_F(QuicTransportFunctionsTest, ClearBlockedFromPendingEvents) {
   auto conn = createConn();
   auto packet = buildEmptyPacket(*conn, PacketNumberSpace::Handshake);
@@ -1904,6 +2019,127 @@ TEST_F(QuicTransportFunctionsTest, ClonedRst) {
       getLastOutstandingPacket(*conn, PacketNumberSpace::AppData)->pureAck);
 }
 
+TEST_F(QuicTransportFunctionsTest, CoalescedHandshakeFlight) {
+  auto conn = createConn();
+  conn->transportSettings.coalescePackets = true;
+  conn->handshakeWriteCipher = createNoOpAead();
+  conn->handshakeWriteHeaderCipher = createNoOpHeaderCipher();
+  writeDataToQuicStream(
+      conn->cryptoState->initialStream, buildRandomInputData(100));
+  writeDataToQuicStream(
+      conn->cryptoState->handshakeStream, buildRandomInputData(100));
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  size_t datagramLen = 0;
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        datagramLen = iobuf->computeChainDataLength();
+        return iobuf->computeChainDataLength();
+      }));
+  {
+    ScopedCoalescedWrite coalescedWrite(*rawSocket, *conn, true);
+    EXPECT_EQ(
+        1,
+        writeCryptoAndAckDataToSocket(
+            *rawSocket,
+            *conn,
+            *conn->serverConnectionId,
+            *conn->clientConnectionId,
+            LongHeader::Types::Initial,
+            *conn->initialWriteCipher,
+            *conn->initialHeaderCipher,
+            getVersion(*conn),
+            conn->transportSettings.writeConnectionDataPacketsLimit));
+    EXPECT_EQ(
+        1,
+        writeCryptoAndAckDataToSocket(
+            *rawSocket,
+            *conn,
+            *conn->serverConnectionId,
+            *conn->clientConnectionId,
+            LongHeader::Types::Handshake,
+            *conn->handshakeWriteCipher,
+            *conn->handshakeWriteHeaderCipher,
+            getVersion(*conn),
+            conn->transportSettings.writeConnectionDataPacketsLimit));
+    EXPECT_EQ(2, conn->coalescedDatagram.numPackets);
+  }
+  ASSERT_EQ(2, conn->outstandingPackets.size());
+  EXPECT_EQ(
+      conn->outstandingPackets[0].encodedSize +
+          conn->outstandingPackets[1].encodedSize,
+      datagramLen);
+  EXPECT_FALSE(conn->coalescedDatagram.enabled);
+  EXPECT_FALSE(conn->coalescedDatagram.packets);
+}
+
+TEST_F(QuicTransportFunctionsTest, CoalescedClientInitialIsPadded) {
+  auto conn = createConn();
+  conn->nodeType = QuicNodeType::Client;
+  conn->transportSettings.coalescePackets = true;
+  writeDataToQuicStream(
+      conn->cryptoState->initialStream, buildRandomInputData(100));
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  size_t datagramLen = 0;
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        datagramLen = iobuf->computeChainDataLength();
+        return iobuf->computeChainDataLength();
+      }));
+  {
+    ScopedCoalescedWrite coalescedWrite(*rawSocket, *conn, true);
+    writeCryptoAndAckDataToSocket(
+        *rawSocket,
+        *conn,
+        *conn->clientConnectionId,
+        *conn->serverConnectionId,
+        LongHeader::Types::Initial,
+        *conn->initialWriteCipher,
+        *conn->initialHeaderCipher,
+        getVersion(*conn),
+        conn->transportSettings.writeConnectionDataPacketsLimit);
+    EXPECT_TRUE(conn->coalescedDatagram.needsPadding);
+  }
+  // The Initial itself isn't padded, a padding only Initial is added to its
+  // datagram.
+  ASSERT_EQ(1, conn->outstandingPackets.size());
+  EXPECT_LT(
+      conn->outstandingPackets[0].encodedSize, kMinInitialPacketSize);
+  EXPECT_GE(datagramLen, kMinInitialPacketSize);
+  EXPECT_EQ(2, conn->ackStates.initialAckState.nextPacketNum);
+}
+
+TEST_F(QuicTransportFunctionsTest, NoCoalescingWithoutSetting) {
+  auto conn = createConn();
+  writeDataToQuicStream(
+      conn->cryptoState->initialStream, buildRandomInputData(100));
+  EventBase evb;
+  auto socket = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb);
+  auto rawSocket = socket.get();
+  ScopedCoalescedWrite coalescedWrite(*rawSocket, *conn, true);
+  EXPECT_FALSE(conn->coalescedDatagram.enabled);
+  EXPECT_CALL(*rawSocket, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& iobuf) {
+        return iobuf->computeChainDataLength();
+      }));
+  writeCryptoAndAckDataToSocket(
+      *rawSocket,
+      *conn,
+      *conn->serverConnectionId,
+      *conn->clientConnectionId,
+      LongHeader::Types::Initial,
+      *conn->initialWriteCipher,
+      *conn->initialHeaderCipher,
+      getVersion(*conn),
+      conn->transportSettings.writeConnectionDataPacketsLimit);
+}
+
 TEST_F(QuicTransportFunctionsTest, TotalBytesSentUpdate) {
   auto conn = createConn();
   conn->lossState.totalBytesSent = 1234;
@@ -91,9 +91,7 @@ class TestQuicTransport
         *aead,
         *headerCipher,
         getVersion(),
-        (isConnectionPaced(*conn_)
-             ? conn_->pacer->updateAndGetWriteBatchSize(Clock::now())
-             : conn_->transportSettings.writeConnectionDataPacketsLimit));
+        getWritePacketLimit(*conn_));
   }
 
   void closeTransport() override {
@@ -481,6 +479,69 @@ TEST_F(QuicTransportTest, WriteSmall) {
   EXPECT_EQ(WriteDataReason::NO_WRITE, shouldWriteData(conn));
 }
 
+TEST_F(QuicTransportTest, WriteBuffers) {
+  auto stream = transport_->createBidirectionalStream().value();
+  auto expected = buildRandomInputData(40);
+  expected->coalesce();
+  std::vector<uint8_t> data(
+      expected->data(), expected->data() + expected->length());
+  size_t released = 0;
+  auto releaseFn = [](void*, void* userData) {
+    ++*static_cast<size_t*>(userData);
+  };
+  std::vector<QuicSocket::ExternalBuffer> buffers{
+      {data.data(), 30, releaseFn, &released},
+      {data.data() + 30, 10, releaseFn, &released}};
+
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  EXPECT_TRUE(
+      transport_->writeBuffers(stream, std::move(buffers), false).hasValue());
+  loopForWrites();
+  auto& conn = transport_->getConnectionState();
+  verifyCorrectness(conn, 0, stream, *expected);
+  // The retransmission buffer references the application's memory.
+  auto streamState = conn.streamManager->findStream(stream);
+  ASSERT_EQ(1, streamState->retransmissionBuffer.size());
+  EXPECT_EQ(
+      data.data(), streamState->retransmissionBuffer[0].data.front()->data());
+  EXPECT_EQ(0, released);
+
+  transport_->close(folly::none);
+  EXPECT_EQ(2, released);
+}
+
+TEST_F(QuicTransportTest, WriteFrameTemplate) {
+  auto& conn = transport_->getConnectionState();
+  conn.transportSettings.writeCoalescingThreshold = 100;
+  auto frameTemplates = std::make_shared<QuicFrameTemplates>();
+  auto handle = frameTemplates->add(IOBuf::copyBuffer("static headers"));
+  auto frame = frameTemplates->get(handle);
+  auto stream1 = transport_->createBidirectionalStream().value();
+  auto stream2 = transport_->createBidirectionalStream().value();
+  EXPECT_EQ(
+      LocalErrorCode::INVALID_OPERATION,
+      transport_->writeFrameTemplate(stream1, handle, false, false).error());
+
+  transport_->setFrameTemplates(frameTemplates);
+  EXPECT_EQ(
+      LocalErrorCode::INVALID_OPERATION,
+      transport_->writeFrameTemplate(stream1, handle + 1, false, false)
+          .error());
+  for (auto stream : {stream1, stream2}) {
+    transport_->writeChain(stream, IOBuf::copyBuffer("a"), false, false);
+    EXPECT_TRUE(
+        transport_->writeFrameTemplate(stream, handle, false, false)
+            .hasValue());
+    // The frame isn't copied into the buffer of the previous write, all the
+    // streams reference the buffer of the template.
+    auto& writeBuffer = conn.streamManager->findStream(stream)->writeBuffer;
+    EXPECT_EQ(2, writeBuffer.front()->countChainElements());
+    EXPECT_EQ(frame->data(), writeBuffer.front()->prev()->data());
+    EXPECT_EQ(
+        "astatic headers", writeBuffer.front()->clone()->moveToFbString());
+  }
+}
+
 TEST_F(QuicTransportTest, WriteLarge) {
   // Testing writing a large buffer that would span multiple packets
   constexpr int NumFullPackets = 3;
@@ -1256,6 +1317,26 @@ TEST_F(QuicTransportTest, DoNotResendPathResponseOnLoss) {
   EXPECT_EQ(conn.pendingEvents.frames.size(), 0);
 }
 
+TEST_F(QuicTransportTest, CoalescePendingControlFrames) {
+  auto& conn = transport_->getConnectionState();
+  conn.pendingEvents.frames.clear();
+  sendSimpleFrame(conn, MaxStreamsFrame(10, true));
+  sendSimpleFrame(conn, MaxStreamsFrame(5, false));
+  sendSimpleFrame(conn, MaxStreamsFrame(20, true));
+  // A lost frame with an older limit doesn't lower the pending one.
+  sendSimpleFrame(conn, MaxStreamsFrame(15, true));
+  sendSimpleFrame(conn, PingFrame());
+  sendSimpleFrame(conn, PingFrame());
+  ASSERT_EQ(3, conn.pendingEvents.frames.size());
+  EXPECT_EQ(
+      MaxStreamsFrame(20, true),
+      *conn.pendingEvents.frames[0].asMaxStreamsFrame());
+  EXPECT_EQ(
+      MaxStreamsFrame(5, false),
+      *conn.pendingEvents.frames[1].asMaxStreamsFrame());
+  EXPECT_TRUE(conn.pendingEvents.frames[2].asPingFrame());
+}
+
 TEST_F(QuicTransportTest, SendNewConnectionIdFrame) {
   EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
   auto& conn = transport_->getConnectionState();
@@ -1372,6 +1453,37 @@ TEST_F(QuicTransportTest, BusyWriteLoopDetection) {
   transport_->close(folly::none);
 }
 
+TEST_F(QuicTransportTest, WriteLoopStats) {
+  auto& conn = transport_->getConnectionState();
+  conn.transportSettings.writeLoopStats = true;
+  auto mockLoopDetectorCallback = std::make_unique<MockLoopDetectorCallback>();
+  auto rawLoopDetectorCallback = mockLoopDetectorCallback.get();
+  conn.loopDetectorCallback = std::move(mockLoopDetectorCallback);
+
+  auto stream = transport_->createBidirectionalStream().value();
+  transport_->writeChain(stream, buildRandomInputData(100), true, false);
+  EXPECT_CALL(*socket_, write(_, _)).WillOnce(Invoke(bufLength));
+  WriteLoopMetrics metrics;
+  EXPECT_CALL(*rawLoopDetectorCallback, onWriteLoop(_))
+      .WillOnce(SaveArg<0>(&metrics));
+  loopForWrites();
+
+  EXPECT_EQ(1, metrics.packetsWritten);
+  EXPECT_EQ(1, metrics.socketWrites);
+  EXPECT_EQ(1, metrics.socketWritePackets);
+  EXPECT_GT(metrics.bytesWritten, 100);
+  // Everything was written and is in flight.
+  EXPECT_EQ(WriteLimit::AppLimited, metrics.stopReason);
+  EXPECT_FALSE(conn.currentWriteLoop.hasValue());
+
+  auto stats = transport_->getTransportInfo().writeLoopStats;
+  EXPECT_EQ(1, stats.numLoops);
+  EXPECT_EQ(1, stats.packetsWritten);
+  EXPECT_EQ(metrics.bytesWritten, stats.bytesWritten);
+  EXPECT_EQ(1, stats.stops[static_cast<size_t>(WriteLimit::AppLimited)]);
+  transport_->close(folly::none);
+}
+
 TEST_F(QuicTransportTest, ResendNewConnectionIdOnLoss) {
   auto& conn = transport_->getConnectionState();
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/api/QuicWriteCoalescer.h>
+
+#include <folly/ScopeGuard.h>
+#include <gtest/gtest.h>
+
+namespace quic {
+namespace testing {
+
+constexpr const auto kStrLen = 10;
+constexpr const auto kBatchNum = 3;
+
+class QuicWriteCoalescerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    sock_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    sock_->bind(folly::SocketAddress("127.0.0.1", 0));
+    peer_ = std::make_unique<folly::AsyncUDPSocket>(&evb_);
+    peer_->bind(folly::SocketAddress("127.0.0.1", 0));
+  }
+
+ protected:
+  folly::EventBase evb_;
+  std::unique_ptr<folly::AsyncUDPSocket> sock_;
+  std::unique_ptr<folly::AsyncUDPSocket> peer_;
+};
+
+TEST_F(QuicWriteCoalescerTest, FactoryUsesRegisteredCoalescer) {
+  auto batchWriter = BatchWriterFactory::makeBatchWriter(
+      *sock_, QuicBatchingMode::BATCHING_MODE_NONE, kBatchNum);
+  EXPECT_EQ(
+      dynamic_cast<CoalescedPacketBatchWriter*>(batchWriter.get()), nullptr);
+
+  auto coalescer =
+      QuicWriteCoalescer::registerSocket(&evb_, *sock_, kBatchNum * 2);
+  SCOPE_EXIT {
+    QuicWriteCoalescer::unregisterSocket(sock_->getNetworkSocket());
+  };
+  EXPECT_EQ(
+      QuicWriteCoalescer::getForSocket(sock_->getNetworkSocket()), coalescer);
+  batchWriter = BatchWriterFactory::makeBatchWriter(
+      *sock_, QuicBatchingMode::BATCHING_MODE_NONE, kBatchNum);
+  EXPECT_NE(
+      dynamic_cast<CoalescedPacketBatchWriter*>(batchWriter.get()), nullptr);
+}
+
+TEST_F(QuicWriteCoalescerTest, FlushAtEndOfLoop) {
+  auto coalescer =
+      QuicWriteCoalescer::registerSocket(&evb_, *sock_, kBatchNum * 2);
+  SCOPE_EXIT {
+    QuicWriteCoalescer::unregisterSocket(sock_->getNetworkSocket());
+  };
+  auto batchWriter = BatchWriterFactory::makeBatchWriter(
+      *sock_, QuicBatchingMode::BATCHING_MODE_NONE, kBatchNum);
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum - 1; i++) {
+    EXPECT_FALSE(
+        batchWriter->append(folly::IOBuf::copyBuffer(strTest), kStrLen));
+  }
+  EXPECT_EQ(
+      batchWriter->write(*sock_, peer_->address()), (kBatchNum - 1) * kStrLen);
+  batchWriter->reset();
+  EXPECT_EQ(coalescer->pendingBytes(), (kBatchNum - 1) * kStrLen);
+  EXPECT_TRUE(coalescer->isLoopCallbackScheduled());
+
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(coalescer->pendingBytes(), 0);
+}
+
+TEST_F(QuicWriteCoalescerTest, FlushWhenFull) {
+  auto coalescer = QuicWriteCoalescer::registerSocket(&evb_, *sock_, kBatchNum);
+  SCOPE_EXIT {
+    QuicWriteCoalescer::unregisterSocket(sock_->getNetworkSocket());
+  };
+  std::string strTest(kStrLen, 'A');
+  for (size_t i = 0; i < kBatchNum - 1; i++) {
+    coalescer->enqueue(
+        peer_->address(), folly::IOBuf::copyBuffer(strTest), kStrLen);
+  }
+  EXPECT_EQ(coalescer->pendingBytes(), (kBatchNum - 1) * kStrLen);
+  coalescer->enqueue(
+      peer_->address(), folly::IOBuf::copyBuffer(strTest), kStrLen);
+  EXPECT_EQ(coalescer->pendingBytes(), 0);
+}
+} // namespace testing
+} // namespace quic
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/loss/QuicLossFunctions.h>
+#include <quic/server/state/ServerStateMachine.h>
+#include <quic/state/AckHandlers.h>
+
+using namespace quic;
+using namespace quic::test;
+
+namespace {
+
+std::unique_ptr<QuicServerConnectionState> makeConn() {
+  auto conn = std::make_unique<QuicServerConnectionState>();
+  // Only the ack and loss processing is measured, the congestion controller
+  // would need the sends to keep its inflight count right.
+  conn->congestionController = nullptr;
+  return conn;
+}
+
+void addOutstandingPackets(QuicServerConnectionState& conn, size_t n) {
+  conn.outstandingPackets.clear();
+  auto sentTime = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < n; ++packetNum) {
+    auto packet = createNewPacket(packetNum, PacketNumberSpace::AppData);
+    packet.frames.push_back(
+        WriteStreamFrame(0, packetNum * 1000, 1000, false));
+    conn.outstandingPackets.push_back(OutstandingPacket(
+        std::move(packet),
+        sentTime,
+        1000,
+        false,
+        false,
+        (packetNum + 1) * 1000));
+  }
+  conn.ackStates.appDataAckState.nextPacketNum = n;
+}
+
+// Acks all the n packets in one range, or every other packet when sparse, in
+// which case the others are detected as lost.
+void processAckFrameBench(uint32_t iters, size_t n, bool sparse) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  ReadAckFrame ackFrame;
+  BENCHMARK_SUSPEND {
+    conn = makeConn();
+    ackFrame.largestAcked = n - 1;
+    if (sparse) {
+      for (PacketNum packetNum = n; packetNum >= 2; packetNum -= 2) {
+        ackFrame.ackBlocks.emplace_back(packetNum - 1, packetNum - 1);
+      }
+    } else {
+      ackFrame.ackBlocks.emplace_back(0, n - 1);
+    }
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    BENCHMARK_SUSPEND {
+      addOutstandingPackets(*conn, n);
+    }
+    processAckFrame(
+        *conn,
+        PacketNumberSpace::AppData,
+        ackFrame,
+        [](const auto&, const auto&, const auto&) {},
+        [](auto&, auto&, bool, PacketNum) {},
+        Clock::now());
+    folly::doNotOptimizeAway(conn->outstandingPackets.size());
+  }
+}
+
+void processAckFrameContiguous(uint32_t iters, size_t n) {
+  processAckFrameBench(iters, n, false);
+}
+
+void processAckFrameSparse(uint32_t iters, size_t n) {
+  processAckFrameBench(iters, n, true);
+}
+
+// All the n packets are lost.
+void detectLossPacketsBench(uint32_t iters, size_t n) {
+  std::unique_ptr<QuicServerConnectionState> conn;
+  BENCHMARK_SUSPEND {
+    conn = makeConn();
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    BENCHMARK_SUSPEND {
+      addOutstandingPackets(*conn, n);
+    }
+    auto lossEvent = detectLossPackets(
+        *conn,
+        n + conn->lossState.reorderingThreshold + 1,
+        [](auto&, auto&, bool, PacketNum) {},
+        Clock::now() + 1s,
+        PacketNumberSpace::AppData);
+    folly::doNotOptimizeAway(lossEvent);
+  }
+}
+
+} // namespace
+
+BENCHMARK_PARAM(processAckFrameContiguous, 10)
+BENCHMARK_PARAM(processAckFrameContiguous, 100)
+BENCHMARK_PARAM(processAckFrameContiguous, 1000)
+BENCHMARK_PARAM(processAckFrameContiguous, 10000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(processAckFrameSparse, 10)
+BENCHMARK_PARAM(processAckFrameSparse, 100)
+BENCHMARK_PARAM(processAckFrameSparse, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(detectLossPacketsBench, 10)
+BENCHMARK_PARAM(detectLossPacketsBench, 100)
+BENCHMARK_PARAM(detectLossPacketsBench, 1000)
+BENCHMARK_PARAM(detectLossPacketsBench, 10000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
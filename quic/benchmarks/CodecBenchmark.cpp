@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/codec/Decode.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/codec/QuicWriteCodec.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace quic;
+using namespace quic::test;
+
+namespace {
+
+ShortHeader makeHeader() {
+  return ShortHeader(ProtectionType::KeyPhaseZero, getTestConnectionId(), 1);
+}
+
+RegularQuicPacketBuilder makeBuilder() {
+  return RegularQuicPacketBuilder(kDefaultUDPSendPacketLen, makeHeader(), 0);
+}
+
+// A packet with an ack frame of numAckBlocks blocks, followed by stream frames
+// of 100 bytes until the packet is full.
+RegularQuicPacketBuilder::Packet buildPacket(
+    size_t numAckBlocks,
+    bool withStreams) {
+  auto builder = makeBuilder();
+  IntervalSet<PacketNum> acks;
+  for (size_t i = 0; i < numAckBlocks; ++i) {
+    acks.insert(i * 4, i * 4 + 1);
+  }
+  if (numAckBlocks) {
+    AckFrameMetaData ackData(acks, 0us, kDefaultAckDelayExponent);
+    CHECK(writeAckFrame(ackData, builder));
+  }
+  auto data = buildRandomInputData(100);
+  for (StreamId id = 0; withStreams; id += 4) {
+    auto dataLen = writeStreamFrameHeader(builder, id, 0, 100, 100, false);
+    if (!dataLen || *dataLen == 0) {
+      break;
+    }
+    writeStreamFrameData(builder, data->clone(), *dataLen);
+  }
+  return std::move(builder).buildPacket();
+}
+
+void decodeRegularPacketBench(uint32_t iters, size_t numAckBlocks) {
+  std::unique_ptr<folly::IOBuf> body;
+  BENCHMARK_SUSPEND {
+    body = buildPacket(numAckBlocks, true).body;
+  }
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::io::Cursor cursor(body.get());
+    auto packet = decodeRegularPacket(makeHeader(), params, cursor);
+    folly::doNotOptimizeAway(packet.frames.size());
+  }
+}
+
+void decodeAckFrameBench(uint32_t iters, size_t numAckBlocks) {
+  std::unique_ptr<folly::IOBuf> body;
+  BENCHMARK_SUSPEND {
+    body = buildPacket(numAckBlocks, false).body;
+  }
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  PacketHeader header(makeHeader());
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::io::Cursor cursor(body.get());
+    // Skip the frame type.
+    cursor.skip(1);
+    auto ackFrame = decodeAckFrame(cursor, header, params);
+    folly::doNotOptimizeAway(ackFrame.ackBlocks.size());
+  }
+}
+
+} // namespace
+
+BENCHMARK_PARAM(decodeRegularPacketBench, 1)
+BENCHMARK_PARAM(decodeRegularPacketBench, 32)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(decodeAckFrameBench, 1)
+BENCHMARK_PARAM(decodeAckFrameBench, 32)
+BENCHMARK_PARAM(decodeAckFrameBench, 128)
+BENCHMARK_DRAW_LINE();
+BENCHMARK(writeStreamFrameHeaderBench, iters) {
+  folly::Optional<RegularQuicPacketBuilder> builder;
+  BENCHMARK_SUSPEND {
+    builder.emplace(makeBuilder());
+  }
+  StreamId id = 0;
+  for (uint32_t i = 0; i < iters; ++i) {
+    auto dataLen = writeStreamFrameHeader(*builder, id, 1000, 100, 100, false);
+    if (!dataLen) {
+      BENCHMARK_SUSPEND {
+        builder.emplace(makeBuilder());
+      }
+    }
+    id += 4;
+    folly::doNotOptimizeAway(dataLen);
+  }
+}
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/common/IntervalSet.h>
+
+using namespace quic;
+
+namespace {
+
+// In order, every point extends the last interval, like the packet numbers
+// received without loss.
+void insertInOrder(uint32_t iters, size_t n) {
+  for (uint32_t i = 0; i < iters; ++i) {
+    IntervalSet<uint64_t> set;
+    for (uint64_t point = 0; point < n; ++point) {
+      set.insert(point);
+    }
+    folly::doNotOptimizeAway(set.size());
+  }
+}
+
+// Every other point first, which leaves n / 2 intervals, then the gaps, which
+// merge them back into one.
+void insertWithGapsThenMerge(uint32_t iters, size_t n) {
+  for (uint32_t i = 0; i < iters; ++i) {
+    IntervalSet<uint64_t> set;
+    for (uint64_t point = 0; point < n; point += 2) {
+      set.insert(point);
+    }
+    for (uint64_t point = 1; point < n; point += 2) {
+      set.insert(point);
+    }
+    folly::doNotOptimizeAway(set.size());
+  }
+}
+
+// Reordered by reverse order, every point lands in front of all the others.
+void insertReversed(uint32_t iters, size_t n) {
+  for (uint32_t i = 0; i < iters; ++i) {
+    IntervalSet<uint64_t> set;
+    for (uint64_t point = n; point > 0; --point) {
+      set.insert(point * 2);
+    }
+    folly::doNotOptimizeAway(set.size());
+  }
+}
+
+} // namespace
+
+BENCHMARK_PARAM(insertInOrder, 100)
+BENCHMARK_PARAM(insertInOrder, 10000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(insertWithGapsThenMerge, 16)
+BENCHMARK_PARAM(insertWithGapsThenMerge, 100)
+BENCHMARK_PARAM(insertWithGapsThenMerge, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(insertReversed, 16)
+BENCHMARK_PARAM(insertReversed, 1000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
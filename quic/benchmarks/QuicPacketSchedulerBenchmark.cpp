@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+
+#include <quic/api/QuicPacketScheduler.h>
+#include <quic/client/state/ClientStateMachine.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/state/QuicStreamFunctions.h>
+
+using namespace quic;
+using namespace quic::test;
+
+namespace {
+
+// Builds one packet per iteration out of numStreams streams with data. The
+// scheduler doesn't consume the stream data, so every packet sees the same
+// streams.
+void scheduleFramesForPacketBench(uint32_t iters, size_t numStreams) {
+  std::unique_ptr<QuicClientConnectionState> conn;
+  folly::Optional<FrameScheduler> scheduler;
+  BENCHMARK_SUSPEND {
+    conn = std::make_unique<QuicClientConnectionState>();
+    conn->streamManager->setMaxLocalBidirectionalStreams(numStreams);
+    conn->flowControlState.peerAdvertisedMaxOffset =
+        std::numeric_limits<uint32_t>::max();
+    conn->flowControlState.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        std::numeric_limits<uint32_t>::max();
+    for (size_t i = 0; i < numStreams; ++i) {
+      auto stream =
+          conn->streamManager->createNextBidirectionalStream().value();
+      writeDataToQuicStream(*stream, buildRandomInputData(10000), false);
+    }
+    scheduler.emplace(
+        FrameScheduler::Builder(
+            *conn,
+            EncryptionLevel::AppData,
+            PacketNumberSpace::AppData,
+            "BenchmarkScheduler")
+            .streamFrames()
+            .build());
+  }
+  auto connId = getTestConnectionId();
+  for (uint32_t i = 0; i < iters; ++i) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero,
+        connId,
+        getNextPacketNum(*conn, PacketNumberSpace::AppData));
+    RegularQuicPacketBuilder builder(
+        conn->udpSendPacketLen,
+        std::move(header),
+        conn->ackStates.appDataAckState.largestAckedByPeer);
+    auto result = scheduler->scheduleFramesForPacket(
+        std::move(builder), conn->udpSendPacketLen);
+    folly::doNotOptimizeAway(result.second);
+  }
+}
+
+} // namespace
+
+BENCHMARK_PARAM(scheduleFramesForPacketBench, 1)
+BENCHMARK_PARAM(scheduleFramesForPacketBench, 10)
+BENCHMARK_PARAM(scheduleFramesForPacketBench, 100)
+BENCHMARK_PARAM(scheduleFramesForPacketBench, 1000)
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  folly::runBenchmarks();
+  return 0;
+}
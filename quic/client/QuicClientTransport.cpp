@@ -8,17 +8,21 @@
 
 #include <quic/client/QuicClientTransport.h>
 
+#include <folly/ScopeGuard.h>
 #include <folly/portability/Sockets.h>
 
+#include <quic/api/QuicBatchWriter.h>
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/client/handshake/ClientTransportParametersExtension.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/handshake/CertificateCompression.h>
 #include <quic/handshake/FizzCryptoFactory.h>
 #include <quic/happyeyeballs/QuicHappyEyeballsFunctions.h>
 #include <quic/logging/QLoggerConstants.h>
 #include <quic/loss/QuicLossFunctions.h>
 #include <quic/state/AckHandlers.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/SimpleFrameFunctions.h>
 
@@ -73,6 +77,11 @@ QuicClientTransport::~QuicClientTransport() {
   // The caller probably doesn't need the conn callback after destroying the
   // transport.
   connCallback_ = nullptr;
+  // The read handler has to go away before the socket is closed.
+  batchReadHandler_.reset();
+  if (zeroCopyTracker_ && socket_) {
+    ZeroCopyTracker::unregisterSocket(socket_->getNetworkSocket());
+  }
   // Close without draining.
   closeImpl(
       std::make_pair(
@@ -90,6 +99,15 @@ QuicClientTransport::~QuicClientTransport() {
 void QuicClientTransport::processUDPData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) {
+  if (networkData.parsedPacket) {
+    processParsedPacket(
+        peer,
+        networkData.receiveTimePoint,
+        networkData.ecn,
+        std::move(*networkData.parsedPacket),
+        networkData.parsedPacketSize);
+    return;
+  }
   folly::IOBufQueue udpData{folly::IOBufQueue::cacheChainLength()};
   udpData.append(std::move(networkData.data));
 
@@ -112,7 +130,8 @@ void QuicClientTransport::processUDPData(
   for (uint16_t processedPackets = 0;
        !udpData.empty() && processedPackets < kMaxNumCoalescedPackets;
        processedPackets++) {
-    processPacketData(peer, networkData.receiveTimePoint, udpData);
+    processPacketData(
+        peer, networkData.receiveTimePoint, networkData.ecn, udpData);
   }
   VLOG_IF(4, !udpData.empty())
       << "Leaving " << udpData.chainLength()
@@ -123,13 +142,31 @@ void QuicClientTransport::processUDPData(
 void QuicClientTransport::processPacketData(
     const folly::SocketAddress& peer,
     TimePoint receiveTimePoint,
+    ECNCodepoint ecn,
     folly::IOBufQueue& packetQueue) {
   auto packetSize = packetQueue.chainLength();
   if (packetSize == 0) {
     return;
   }
-  auto parsedPacket = conn_->readCodec->parsePacket(
-      packetQueue, conn_->ackStates, conn_->clientConnectionId->size());
+  auto parsedPacket = [&] {
+    QuicLatencySampler sampler(
+        conn_->infoCallback,
+        QuicTransportStatsCallback::LatencyType::PACKET_DECODE);
+    QuicCpuCostSampler cpuCostSampler(
+        *conn_, QuicTransportStatsCallback::CpuCostType::PACKET_DECODE);
+    return conn_->readCodec->parsePacket(
+        packetQueue, conn_->ackStates, conn_->clientConnectionId->size());
+  }();
+  processParsedPacket(
+      peer, receiveTimePoint, ecn, std::move(parsedPacket), packetSize);
+}
+
+void QuicClientTransport::processParsedPacket(
+    const folly::SocketAddress& peer,
+    TimePoint receiveTimePoint,
+    ECNCodepoint ecn,
+    CodecResult parsedPacket,
+    size_t packetSize) {
   StatelessReset* statelessReset = parsedPacket.statelessReset();
   if (statelessReset) {
     auto& token = clientConn_->statelessResetToken;
@@ -152,6 +189,10 @@ void QuicClientTransport::processPacketData(
     return;
   }
   if (happyEyeballsEnabled_) {
+    if (happyEyeballsCache_ && !happyEyeballsCacheUpdated_) {
+      happyEyeballsCacheUpdated_ = true;
+      happyEyeballsUpdateCache(*conn_, peer, *happyEyeballsCache_);
+    }
     happyEyeballsOnDataReceived(
         *conn_, happyEyeballsConnAttemptDelayTimeout_, socket_, peer);
   }
@@ -218,6 +259,11 @@ void QuicClientTransport::processPacketData(
       protectionLevel == ProtectionType::KeyPhaseOne;
 
   auto& regularPacket = *regularOptional;
+  SCOPE_EXIT {
+    if (conn_->readCodec) {
+      conn_->readCodec->recycleFrames(std::move(regularPacket.frames));
+    }
+  };
   if (conn_->qLogger) {
     conn_->qLogger->addPacket(regularPacket, packetSize);
   }
@@ -235,6 +281,12 @@ void QuicClientTransport::processPacketData(
     }
   }
   QUIC_TRACE(packet_recvd, *conn_, toString(pnSpace), packetNum, packetSize);
+  QUIC_SDT(
+      packet_received,
+      *conn_,
+      static_cast<uint8_t>(pnSpace),
+      packetNum,
+      packetSize);
 
   // We got a packet that was not the version negotiation packet, that means
   // that the version is now bound to the new packet.
@@ -268,8 +320,23 @@ void QuicClientTransport::processPacketData(
         "Invalid connection id", TransportErrorCode::PROTOCOL_VIOLATION);
   }
   auto& ackState = getAckState(*conn_, pnSpace);
-  auto outOfOrder =
-      updateLargestReceivedPacketNum(ackState, packetNum, receiveTimePoint);
+  if (conn_->transportSettings.dropDuplicatePackets &&
+      !ackState.receivedPackets.insert(packetNum)) {
+    VLOG(4) << "Dropping duplicate packet=" << packetNum << " " << *this;
+    if (conn_->qLogger) {
+      conn_->qLogger->addPacketDrop(
+          packetSize,
+          QuicTransportStatsCallback::toString(
+              QuicTransportStatsCallback::PacketDropReason::DUPLICATE_PACKET));
+    }
+    QUIC_STATS(
+        conn_->infoCallback,
+        onPacketDropped,
+        QuicTransportStatsCallback::PacketDropReason::DUPLICATE_PACKET);
+    return;
+  }
+  auto outOfOrder = updateLargestReceivedPacketNum(
+      ackState, packetNum, receiveTimePoint, ecn);
 
   bool pktHasRetransmittableData = false;
   bool pktHasCryptoData = false;
@@ -502,6 +569,13 @@ void QuicClientTransport::processPacketData(
       case QuicFrame::Type::PaddingFrame_E: {
         break;
       }
+      case QuicFrame::Type::ReadDatagramFrame_E: {
+        VLOG(10) << "Client received datagram " << *this;
+        pktHasRetransmittableData = true;
+        onDatagramReceived(
+            *conn_, std::move(*quicFrame.asReadDatagramFrame()));
+        break;
+      }
       case QuicFrame::Type::QuicSimpleFrame_E: {
         QuicSimpleFrame& simpleFrame = *quicFrame.asQuicSimpleFrame();
         pktHasRetransmittableData = true;
@@ -509,6 +583,12 @@ void QuicClientTransport::processPacketData(
             *conn_, simpleFrame, packetNum, false);
         break;
       }
+      case QuicFrame::Type::ReadNewTokenFrame_E: {
+        VLOG(10) << "Client received new token " << *this;
+        pktHasRetransmittableData = true;
+        onNewToken(*quicFrame.asReadNewTokenFrame());
+        break;
+      }
       default:
         break;
     }
@@ -559,6 +639,10 @@ void QuicClientTransport::processPacketData(
       conn_->readCodec->setOneRttHeaderCipher(
           std::move(oneRttReadHeaderCipher));
     }
+    auto oneRttKeyUpdater = handshakeLayer->getOneRttKeyUpdater();
+    if (oneRttKeyUpdater && conn_->transportSettings.keyUpdateEnabled) {
+      conn_->oneRttKeyUpdate.updater = std::move(oneRttKeyUpdater);
+    }
     bool zeroRttRejected = handshakeLayer->getZeroRttRejected().value_or(false);
     if (zeroRttRejected) {
       if (conn_->qLogger) {
@@ -734,10 +818,11 @@ void QuicClientTransport::writeData() {
     return;
   }
 
-  uint64_t packetLimit =
-      (isConnectionPaced(*conn_)
-           ? conn_->pacer->updateAndGetWriteBatchSize(Clock::now())
-           : conn_->transportSettings.writeConnectionDataPacketsLimit);
+  uint64_t packetLimit = getWritePacketLimit(*conn_);
+  // Until the handshake is done the packets of the different encryption
+  // levels share datagrams.
+  ScopedCoalescedWrite coalescedWrite(
+      *socket_, *conn_, phase != ClientHandshake::Phase::Established);
   CryptoStreamScheduler initialScheduler(
       *conn_, *getCryptoStream(*conn_->cryptoState, EncryptionLevel::Initial));
   CryptoStreamScheduler handshakeScheduler(
@@ -758,7 +843,8 @@ void QuicClientTransport::writeData() {
         *conn_->initialHeaderCipher,
         version,
         packetLimit,
-        clientConn_->retryToken);
+        clientConn_->retryToken.empty() ? clientConn_->newToken
+                                        : clientConn_->retryToken);
   }
   if (!packetLimit) {
     return;
@@ -799,6 +885,15 @@ void QuicClientTransport::writeData() {
   }
   if (conn_->oneRttWriteCipher) {
     CHECK(clientConn_->oneRttWriteHeaderCipher);
+    packetLimit -= writePmtuProbe(
+        *socket_,
+        *conn_,
+        *destConnId,
+        *conn_->oneRttWriteCipher,
+        *conn_->oneRttWriteHeaderCipher);
+    if (!packetLimit) {
+      return;
+    }
     writeQuicDataExceptCryptoStreamToSocket(
         *socket_,
         *conn_,
@@ -859,9 +954,13 @@ void QuicClientTransport::startCryptoHandshake() {
   folly::Optional<fizz::client::CachedPsk> cachedPsk;
   if (quicCachedPsk) {
     cachedPsk = std::move(quicCachedPsk->cachedPsk);
+    clientConn_->newToken = std::move(quicCachedPsk->newToken);
   }
 
-  FizzCryptoFactory cryptoFactory;
+  if (!cryptoFactory_) {
+    cryptoFactory_ = std::make_shared<FizzCryptoFactory>();
+  }
+  auto& cryptoFactory = *cryptoFactory_;
   auto version = conn_->originalVersion.value();
   conn_->initialWriteCipher = cryptoFactory.getClientInitialCipher(
       *clientConn_->initialDestinationConnectionId, version);
@@ -873,8 +972,11 @@ void QuicClientTransport::startCryptoHandshake() {
   conn_->initialHeaderCipher = cryptoFactory.makeClientInitialHeaderCipher(
       *clientConn_->initialDestinationConnectionId, version);
 
-  // Add partial reliability parameter to customTransportParameters_.
+  // Add partial reliability, min ack delay and max datagram frame size
+  // parameters to customTransportParameters_.
   setPartialReliabilityTransportParameter();
+  setAckFrequencyTransportParameter();
+  setDatagramTransportParameter();
 
   auto paramsExtension = std::make_shared<ClientTransportParametersExtension>(
       folly::none,
@@ -885,9 +987,16 @@ void QuicClientTransport::startCryptoHandshake() {
       conn_->transportSettings.idleTimeout,
       conn_->transportSettings.ackDelayExponent,
       conn_->transportSettings.maxRecvPacketSize,
-      customTransportParameters_);
+      customTransportParameters_,
+      conn_->transportSettings.adaptiveAcks
+          ? folly::make_optional(conn_->transportSettings.maxAckDelay)
+          : folly::none);
   conn_->transportParametersEncoded = true;
   auto handshakeLayer = clientConn_->clientHandshakeLayer;
+  handshakeLayer->setCryptoFactory(cryptoFactory_);
+  if (conn_->transportSettings.certificateCompression) {
+    handshakeLayer->setCertDecompressionManager(getCertDecompressionManager());
+  }
   handshakeLayer->connect(
       ctx_,
       verifier_,
@@ -992,9 +1101,29 @@ void QuicClientTransport::onNewCachedPsk(
     }
   }
 
+  quicCachedPsk.newToken = clientConn_->newToken;
+
   pskCache_->putPsk(*hostname_, std::move(quicCachedPsk));
 }
 
+void QuicClientTransport::onNewToken(const ReadNewTokenFrame& frame) {
+  if (!frame.token) {
+    return;
+  }
+  folly::io::Cursor cursor(frame.token.get());
+  clientConn_->newToken =
+      cursor.readFixedString(frame.token->computeChainDataLength());
+  // The ticket may have come first, in which case it is cached already.
+  if (!pskCache_ || !hostname_) {
+    return;
+  }
+  auto quicCachedPsk = pskCache_->getPsk(*hostname_);
+  if (quicCachedPsk) {
+    quicCachedPsk->newToken = clientConn_->newToken;
+    pskCache_->putPsk(*hostname_, std::move(*quicCachedPsk));
+  }
+}
+
 bool QuicClientTransport::hasWriteCipher() const {
   return clientConn_->oneRttWriteCipher || clientConn_->zeroRttWriteCipher;
 }
@@ -1010,6 +1139,9 @@ bool QuicClientTransport::isTLSResumed() const {
 void QuicClientTransport::errMessage(
     FOLLY_MAYBE_UNUSED const cmsghdr& cmsg) noexcept {
 #ifdef FOLLY_HAVE_MSG_ERRQUEUE
+  if (zeroCopyTracker_ && zeroCopyTracker_->maybeHandleErrMessage(cmsg)) {
+    return;
+  }
   if ((cmsg.cmsg_level == SOL_IP && cmsg.cmsg_type == IP_RECVERR) ||
       (cmsg.cmsg_level == SOL_IPV6 && cmsg.cmsg_type == IPV6_RECVERR)) {
     const struct sock_extended_err* serr =
@@ -1034,7 +1166,22 @@ void QuicClientTransport::errMessage(
 void QuicClientTransport::getReadBuffer(void** buf, size_t* len) noexcept {
   DCHECK(conn_) << "trying to receive packets without a connection";
   auto readBufferSize = conn_->transportSettings.maxRecvPacketSize;
-  readBuffer_ = folly::IOBuf::create(readBufferSize);
+  auto pool = conn_->transportSettings.recvBufferPoolSize > 0
+      ? BufferPool::getForEventBase(
+            evb_,
+            readBufferSize,
+            conn_->transportSettings.recvBufferPoolSize)
+      : nullptr;
+  if (pool) {
+    readBuffer_ = pool->getBuffer();
+    QUIC_STATS(
+        conn_->infoCallback,
+        onRecvBufferPoolStats,
+        pool->pooledBuffers(),
+        pool->highWaterMark());
+  } else {
+    readBuffer_ = folly::IOBuf::create(readBufferSize);
+  }
   *buf = readBuffer_->writableData();
   *len = readBufferSize;
 }
@@ -1065,6 +1212,75 @@ void QuicClientTransport::onDataAvailable(
   onNetworkData(server, std::move(networkData));
 }
 
+void QuicClientTransport::onBatchRead(
+    std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+    TimePoint receiveTime) noexcept {
+  FOLLY_MAYBE_UNUSED auto self = sharedGuard();
+  for (auto& packet : packets) {
+    auto len = packet.data->length();
+    VLOG(10) << "Got data from socket peer=" << packet.peer << " len=" << len;
+    if (packet.truncated) {
+      // This is an error, drop the packet.
+      if (conn_->qLogger) {
+        conn_->qLogger->addPacketDrop(len, kUdpTruncated);
+      }
+      QUIC_TRACE(packet_drop, *conn_, "udp_truncated");
+      continue;
+    }
+    QUIC_TRACE(udp_recvd, *conn_, (uint64_t)len);
+    if (conn_->qLogger) {
+      conn_->qLogger->addDatagramReceived(len);
+    }
+    onNetworkData(
+        packet.peer,
+        NetworkData(std::move(packet.data), receiveTime, packet.ecn));
+  }
+}
+
+void QuicClientTransport::onReadError(
+    const folly::AsyncSocketException& ex) noexcept {
+  VLOG(4) << "Read error " << ex.what() << " " << *this;
+  // The socket stops reading on an error. A connected socket gets one for
+  // each ICMP error sent back for an earlier datagram, which an unconnected
+  // one doesn't see, so keep reading like it would. A dead path is found by
+  // the timeouts.
+  if (ex.getErrno() == ECONNREFUSED && socket_ && !socket_->isReading() &&
+      closeState_ == CloseState::OPEN) {
+    socket_->resumeRead(this);
+  }
+}
+
+void QuicClientTransport::onBatchReadError(int err) noexcept {
+  VLOG(4) << "Batch read error errno=" << err << " " << *this;
+}
+
+void QuicClientTransport::maybeStartBatchReads() {
+  bool groEnabled = conn_->transportSettings.groEnabled &&
+      RecvmmsgBatchReader::enableGRO(socket_->getNetworkSocket());
+  bool ecnEnabled = conn_->transportSettings.ecnEnabled &&
+      RecvmmsgBatchReader::enableECN(
+          socket_->getNetworkSocket(), socket_->address().getFamily());
+  if (!groEnabled && !ecnEnabled &&
+      conn_->transportSettings.maxRecvBatchSize <= 1) {
+    VLOG(4) << "GRO and ECN not supported " << *this;
+    return;
+  }
+  // The handler does not drain the socket's error queue, so error messages
+  // have to be turned off along with the socket's own reads.
+  socket_->pauseRead();
+  socket_->setErrMessageCallback(nullptr);
+  batchReadHandler_ = std::make_unique<BatchReadHandler>(
+      evb_,
+      socket_->getNetworkSocket(),
+      std::make_unique<RecvmmsgBatchReader>(
+          conn_->transportSettings.maxRecvBatchSize,
+          conn_->transportSettings.maxRecvPacketSize,
+          groEnabled,
+          ecnEnabled),
+      this);
+  batchReadHandler_->start();
+}
+
 void QuicClientTransport::
     happyEyeballsConnAttemptDelayTimeoutExpired() noexcept {
   QUIC_TRACE(happy_eyeballs, *conn_, "delay timer expired");
@@ -1075,16 +1291,30 @@ void QuicClientTransport::
 }
 
 void QuicClientTransport::start(ConnectionCallback* cb) {
+  // A shared socket only has the one family.
+  happyEyeballsEnabled_ = happyEyeballsEnabled_ && !sharedSocket_;
   if (happyEyeballsEnabled_) {
-    // TODO Supply v4 delay amount from somewhere when we want to tune this
+    auto cachedFamily = happyEyeballsCachedFamily_;
+    auto connAttemptDelay = cachedFamily == AF_UNSPEC
+        ? kHappyEyeballsV4Delay
+        : kHappyEyeballsConnAttemptDelayWithCache;
+    if (happyEyeballsCache_) {
+      auto decision = happyEyeballsCache_->decide();
+      if (decision.skipFamily != AF_UNSPEC) {
+        happyEyeballsSkipFamily(*conn_, decision.skipFamily);
+      }
+      if (decision.preferredFamily != AF_UNSPEC) {
+        cachedFamily = decision.preferredFamily;
+        connAttemptDelay =
+            decision.connAttemptDelay.value_or(kHappyEyeballsV4Delay);
+      }
+    }
     startHappyEyeballs(
         *conn_,
         evb_,
-        happyEyeballsCachedFamily_,
+        cachedFamily,
         happyEyeballsConnAttemptDelayTimeout_,
-        happyEyeballsCachedFamily_ == AF_UNSPEC
-            ? kHappyEyeballsV4Delay
-            : kHappyEyeballsConnAttemptDelayWithCache,
+        connAttemptDelay,
         this,
         this);
   }
@@ -1107,6 +1337,32 @@ void QuicClientTransport::start(ConnectionCallback* cb) {
   try {
     happyEyeballsSetUpSocket(
         *socket_, conn_->peerAddress, conn_->transportSettings, this, this);
+    // Happy eyeballs may switch to the second socket, which keeps reading
+    // through the regular read callback, so batched reads, GRO and ECN are
+    // only used without it.
+    if ((conn_->transportSettings.groEnabled ||
+         conn_->transportSettings.ecnEnabled ||
+         conn_->transportSettings.maxRecvBatchSize > 1) &&
+        !happyEyeballsEnabled_ && !sharedSocket_) {
+      maybeStartBatchReads();
+    }
+    // The departure times are only set up on the first socket, and not on a
+    // shared one.
+    if (conn_->transportSettings.txTimePacing &&
+        (happyEyeballsEnabled_ || sharedSocket_ ||
+         !TxTimePacketBatchWriter::enableTxTime(
+             socket_->getNetworkSocket()))) {
+      conn_->transportSettings.txTimePacing = false;
+    }
+    // Zero copy completions come in through errMessage(), so they need the
+    // socket's error message callback.
+    if (conn_->transportSettings.batchingMode ==
+            QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY &&
+        conn_->transportSettings.enableSocketErrMsgCallback &&
+        !batchReadHandler_ && !sharedSocket_) {
+      zeroCopyTracker_ =
+          ZeroCopyTracker::registerSocket(socket_->getNetworkSocket());
+    }
     startCryptoHandshake();
   } catch (const QuicTransportException& ex) {
     runOnEvbAsync([ex](auto self) {
@@ -1159,6 +1415,11 @@ void QuicClientTransport::setHappyEyeballsCachedFamily(
   happyEyeballsCachedFamily_ = cachedFamily;
 }
 
+void QuicClientTransport::setHappyEyeballsCache(
+    std::shared_ptr<HappyEyeballsCache> cache) {
+  happyEyeballsCache_ = std::move(cache);
+}
+
 void QuicClientTransport::addNewSocket(
     std::unique_ptr<folly::AsyncUDPSocket> socket) {
   happyEyeballsAddSocket(*conn_, std::move(socket));
@@ -1182,6 +1443,11 @@ void QuicClientTransport::setPskCache(std::shared_ptr<QuicPskCache> pskCache) {
   pskCache_ = std::move(pskCache);
 }
 
+void QuicClientTransport::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  cryptoFactory_ = std::move(cryptoFactory);
+}
+
 void QuicClientTransport::setSelfOwning() {
   selfOwning_ = shared_from_this();
 }
@@ -1227,8 +1493,43 @@ void QuicClientTransport::setPartialReliabilityTransportParameter() {
   }
 }
 
+void QuicClientTransport::setAckFrequencyTransportParameter() {
+  if (!conn_->transportSettings.ackFrequencyEnabled) {
+    return;
+  }
+  auto minAckDelayCustomParam =
+      std::make_unique<CustomIntegralTransportParameter>(
+          kMinAckDelayParameterId,
+          conn_->transportSettings.minAckDelay.count());
+
+  if (!setCustomTransportParameter(std::move(minAckDelayCustomParam))) {
+    LOG(ERROR) << "failed to set min ack delay transport setting";
+  }
+}
+
+void QuicClientTransport::setDatagramTransportParameter() {
+  if (conn_->transportSettings.maxDatagramFrameSize == 0) {
+    return;
+  }
+  auto maxDatagramFrameSizeCustomParam =
+      std::make_unique<CustomIntegralTransportParameter>(
+          kMaxDatagramFrameSizeParameterId,
+          conn_->transportSettings.maxDatagramFrameSize);
+
+  if (!setCustomTransportParameter(
+          std::move(maxDatagramFrameSizeCustomParam))) {
+    LOG(ERROR) << "failed to set max datagram frame size transport setting";
+  }
+}
+
 void QuicClientTransport::closeTransport() {
   happyEyeballsConnAttemptDelayTimeout_.cancelTimeout();
+  if (zeroCopyTracker_ && socket_) {
+    ZeroCopyTracker::unregisterSocket(socket_->getNetworkSocket());
+  }
+  if (batchReadHandler_) {
+    batchReadHandler_->pause();
+  }
 }
 
 void QuicClientTransport::unbindConnection() {
@@ -12,17 +12,23 @@
 #include <folly/SocketAddress.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <folly/net/NetOps.h>
+#include <quic/api/QuicBatchReader.h>
 #include <quic/api/QuicTransportBase.h>
 #include <quic/client/handshake/QuicPskCache.h>
 #include <quic/client/state/ClientStateMachine.h>
+#include <quic/common/BufferPool.h>
+#include <quic/happyeyeballs/HappyEyeballsCache.h>
 
 namespace quic {
 
+class QuicSharedClientSocket;
+
 class QuicClientTransport
     : public QuicTransportBase,
       public folly::AsyncUDPSocket::ReadCallback,
       public folly::AsyncUDPSocket::ErrMessageCallback,
       public std::enable_shared_from_this<QuicClientTransport>,
+      public BatchReadHandler::Callback,
       private ClientHandshake::HandshakeCallback {
  public:
   QuicClientTransport(
@@ -80,12 +86,27 @@ class QuicClientTransport
   void setHappyEyeballsEnabled(bool happyEyeballsEnabled);
   virtual void setHappyEyeballsCachedFamily(sa_family_t cachedFamily);
 
+  /**
+   * Set the cache, usually shared by all the clients of the process, that
+   * picks the family to start happy eyeballs with, the delay before racing the
+   * other one and whether to race it at all, and that learns from the outcome
+   * of this connection. Takes precedence over the cached family when it has a
+   * preference. Must be set before start().
+   */
+  void setHappyEyeballsCache(std::shared_ptr<HappyEyeballsCache> cache);
+
   /**
    * Set the cache that remembers psk and server transport parameters from
    * last connection. This is useful for session resumption and 0-rtt.
    */
   void setPskCache(std::shared_ptr<QuicPskCache> pskCache);
 
+  /**
+   * Set the factory that makes the ciphers of the connection, in place of the
+   * userspace OpenSSL ones of FizzCryptoFactory. Must be set before start().
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
   /**
    * Starts the connection.
    */
@@ -107,7 +128,13 @@ class QuicClientTransport
 
   // folly::AsyncUDPSocket::ReadCallback
   void onReadClosed() noexcept override {}
-  void onReadError(const folly::AsyncSocketException&) noexcept override {}
+  void onReadError(const folly::AsyncSocketException& ex) noexcept override;
+
+  // BatchReadHandler::Callback, used when GRO is enabled
+  void onBatchRead(
+      std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+      TimePoint receiveTime) noexcept override;
+  void onBatchReadError(int err) noexcept override;
 
   // folly::AsyncUDPSocket::ErrMessageCallback
   void errMessage(const cmsghdr& cmsg) noexcept override;
@@ -163,10 +190,24 @@ class QuicClientTransport
   void processPacketData(
       const folly::SocketAddress& peer,
       TimePoint receiveTimePoint,
+      ECNCodepoint ecn,
       folly::IOBufQueue& packetQueue);
 
+  void processParsedPacket(
+      const folly::SocketAddress& peer,
+      TimePoint receiveTimePoint,
+      ECNCodepoint ecn,
+      CodecResult parsedPacket,
+      size_t packetSize);
+
   void startCryptoHandshake();
 
+  /**
+   * Enables UDP_GRO and ECN on the socket as configured, and moves its reads
+   * over to a BatchReadHandler if the kernel supports either.
+   */
+  void maybeStartBatchReads();
+
   void happyEyeballsConnAttemptDelayTimeoutExpired() noexcept;
 
   void handleAckFrame(
@@ -179,6 +220,10 @@ class QuicClientTransport
       fizz::client::NewCachedPsk& newCachedPsk) noexcept override;
 
   Buf readBuffer_;
+  // Owns all the reads from socket_ when GRO or ECN is enabled.
+  std::unique_ptr<BatchReadHandler> batchReadHandler_;
+  // Tracks MSG_ZEROCOPY sends on socket_.
+  std::shared_ptr<ZeroCopyTracker> zeroCopyTracker_;
   folly::Optional<std::string> hostname_;
   std::shared_ptr<const fizz::client::FizzClientContext> ctx_;
   std::shared_ptr<const fizz::CertificateVerifier> verifier_;
@@ -199,7 +244,11 @@ class QuicClientTransport
       uint64_t peerAdvertisedInitialMaxStreamUni);
   folly::Optional<QuicCachedPsk> getPsk();
   void removePsk();
+  // Keeps the token for the next connections, with the cached psk.
+  void onNewToken(const ReadNewTokenFrame& frame);
   void setPartialReliabilityTransportParameter();
+  void setAckFrequencyTransportParameter();
+  void setDatagramTransportParameter();
 
  private:
   bool replaySafeNotified_{false};
@@ -208,8 +257,15 @@ class QuicClientTransport
   std::shared_ptr<QuicClientTransport> selfOwning_;
   bool happyEyeballsEnabled_{false};
   sa_family_t happyEyeballsCachedFamily_{AF_UNSPEC};
+  std::shared_ptr<HappyEyeballsCache> happyEyeballsCache_;
+  bool happyEyeballsCacheUpdated_{false};
   std::shared_ptr<QuicPskCache> pskCache_;
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
   QuicClientConnectionState* clientConn_;
   std::vector<TransportParameter> customTransportParameters_;
+  // Set when the socket is shared with other clients, which then does the
+  // reads and owns the socket options, see QuicSharedClientSocket.
+  friend class QuicSharedClientSocket;
+  bool sharedSocket_{false};
 };
 } // namespace quic
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicConnectionPool.h>
+
+#include <folly/hash/Hash.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+class QuicConnectionPool::PooledConnection
+    : public QuicSocket::ConnectionCallback {
+ public:
+  PooledConnection(QuicConnectionPool& pool, Key key)
+      : pool_(pool), key_(std::move(key)) {}
+
+  ~PooledConnection() override = default;
+
+  void setSocket(std::shared_ptr<QuicSocket> socket) {
+    socket_ = std::move(socket);
+  }
+
+  const std::shared_ptr<QuicSocket>& getSocket() const {
+    return socket_;
+  }
+
+  bool isReady() const {
+    return ready_;
+  }
+
+  bool isClosed() const {
+    return closed_ || !socket_;
+  }
+
+  void close() {
+    closed_ = true;
+    if (socket_) {
+      socket_->closeNow(folly::none);
+    }
+  }
+
+  void onNewBidirectionalStream(StreamId id) noexcept override {
+    socket_->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+    socket_->resetStream(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onNewUnidirectionalStream(StreamId id) noexcept override {
+    socket_->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onStopSending(StreamId id, ApplicationErrorCode error) noexcept
+      override {
+    socket_->resetStream(id, error);
+  }
+
+  void onConnectionEnd() noexcept override {
+    markClosed();
+  }
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> code) noexcept override {
+    VLOG(4) << "Pooled connection to " << key_.peerAddress
+            << " failed: " << code.second;
+    markClosed();
+  }
+
+  void onTransportReady() noexcept override {
+    ready_ = true;
+    pool_.onConnectionReady(key_);
+  }
+
+ private:
+  void markClosed() {
+    closed_ = true;
+    pool_.onConnectionClosed();
+  }
+
+  QuicConnectionPool& pool_;
+  Key key_;
+  std::shared_ptr<QuicSocket> socket_;
+  bool ready_{false};
+  bool closed_{false};
+};
+
+size_t QuicConnectionPool::KeyHash::operator()(const Key& key) const {
+  return folly::hash::hash_combine(
+      key.peerAddress.hash(), std::hash<std::string>()(key.hostname));
+}
+
+QuicConnectionPool::QuicConnectionPool(
+    folly::EventBase* evb,
+    ConnectionFactory connectionFactory,
+    Options options)
+    : evb_(evb),
+      connectionFactory_(std::move(connectionFactory)),
+      options_(std::move(options)) {
+  CHECK(evb_);
+  CHECK_GT(options_.maxConnectionsPerPeer, 0);
+}
+
+QuicConnectionPool::~QuicConnectionPool() {
+  closeAll();
+}
+
+void QuicConnectionPool::setConnectionReadyCallback(
+    ConnectionReadyCallback callback) {
+  connectionReadyCallback_ = std::move(callback);
+}
+
+folly::Expected<QuicConnectionPool::Stream, LocalErrorCode>
+QuicConnectionPool::createBidirectionalStream(const Key& key) {
+  DCHECK(evb_->isInEventBaseThread());
+  reapClosedConnections();
+  auto& connections = connections_[key];
+  folly::Optional<Stream> stream;
+  for (auto& connection : connections) {
+    const auto& socket = connection->getSocket();
+    if (!connection->isReady() || !socket->good() ||
+        socket->getNumOpenableBidirectionalStreams() == 0) {
+      continue;
+    }
+    auto id = socket->createBidirectionalStream();
+    if (id.hasValue()) {
+      stream = Stream{socket, *id};
+      break;
+    }
+  }
+  maybePrewarm(key, connections);
+  if (!stream) {
+    return folly::makeUnexpected(LocalErrorCode::STREAM_LIMIT_EXCEEDED);
+  }
+  return std::move(*stream);
+}
+
+void QuicConnectionPool::prewarm(const Key& key, size_t numConnections) {
+  DCHECK(evb_->isInEventBaseThread());
+  reapClosedConnections();
+  auto& connections = connections_[key];
+  numConnections = std::min(numConnections, options_.maxConnectionsPerPeer);
+  for (auto i = connections.size(); i < numConnections; ++i) {
+    startConnection(key, connections);
+  }
+}
+
+size_t QuicConnectionPool::getNumConnections(const Key& key) {
+  reapClosedConnections();
+  auto it = connections_.find(key);
+  return it != connections_.end() ? it->second.size() : 0;
+}
+
+size_t QuicConnectionPool::getNumReadyConnections(const Key& key) {
+  reapClosedConnections();
+  auto it = connections_.find(key);
+  if (it == connections_.end()) {
+    return 0;
+  }
+  return std::count_if(
+      it->second.begin(), it->second.end(), [](const auto& connection) {
+        return connection->isReady();
+      });
+}
+
+void QuicConnectionPool::closeAll() {
+  closing_ = true;
+  for (auto& entry : connections_) {
+    for (auto& connection : entry.second) {
+      connection->close();
+    }
+  }
+  connections_.clear();
+  hasClosedConnections_ = false;
+  closing_ = false;
+}
+
+void QuicConnectionPool::startConnection(
+    const Key& key,
+    Connections& connections) {
+  auto connection = std::make_unique<PooledConnection>(*this, key);
+  connection->setSocket(connectionFactory_(key, connection.get()));
+  if (!connection->getSocket()) {
+    VLOG(4) << "Failed to make a pooled connection to " << key.peerAddress;
+    return;
+  }
+  connections.push_back(std::move(connection));
+}
+
+void QuicConnectionPool::maybePrewarm(
+    const Key& key,
+    Connections& connections) {
+  if (connections.size() >= options_.maxConnectionsPerPeer) {
+    return;
+  }
+  uint64_t openableStreams = 0;
+  for (const auto& connection : connections) {
+    if (connection->isClosed()) {
+      continue;
+    }
+    if (!connection->isReady()) {
+      // One is already on its way.
+      return;
+    }
+    openableStreams +=
+        connection->getSocket()->getNumOpenableBidirectionalStreams();
+  }
+  if (openableStreams == 0 ||
+      openableStreams < options_.prewarmStreamThreshold) {
+    startConnection(key, connections);
+  }
+}
+
+void QuicConnectionPool::onConnectionReady(const Key& key) {
+  if (connectionReadyCallback_) {
+    connectionReadyCallback_(key);
+  }
+}
+
+void QuicConnectionPool::onConnectionClosed() {
+  if (!closing_) {
+    hasClosedConnections_ = true;
+  }
+}
+
+void QuicConnectionPool::reapClosedConnections() {
+  if (!hasClosedConnections_) {
+    return;
+  }
+  hasClosedConnections_ = false;
+  for (auto it = connections_.begin(); it != connections_.end();) {
+    auto& connections = it->second;
+    connections.erase(
+        std::remove_if(
+            connections.begin(),
+            connections.end(),
+            [](const auto& connection) { return connection->isClosed(); }),
+        connections.end());
+    if (connections.empty()) {
+      it = connections_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+} // namespace quic
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Expected.h>
+#include <folly/Function.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/async/EventBase.h>
+
+#include <quic/QuicConstants.h>
+#include <quic/api/QuicSocket.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Keeps warm client connections per peer and SNI and multiplexes streams over
+ * them. A stream is opened on the first ready connection that the peer still
+ * lets open a bidirectional stream, and a new connection is started once the
+ * connections to the peer run low on streams, so that the handshake stays off
+ * the path of the streams that come later.
+ *
+ * The pool lives on a single event base and all its methods, like the ones of
+ * the connections, must be called from it. Streams opened by the peer are
+ * refused.
+ */
+class QuicConnectionPool {
+ public:
+  struct Key {
+    folly::SocketAddress peerAddress;
+    std::string hostname;
+
+    bool operator==(const Key& other) const {
+      return peerAddress == other.peerAddress && hostname == other.hostname;
+    }
+  };
+
+  /**
+   * Makes a connection to the peer of the key and starts it with the given
+   * callback. This is usually a QuicClientTransport with the peer address and
+   * the hostname of the key, and the settings and PSK cache of the caller.
+   */
+  using ConnectionFactory = folly::Function<std::shared_ptr<QuicSocket>(
+      const Key&,
+      QuicSocket::ConnectionCallback*)>;
+
+  // Called when a connection to the key is ready to open streams.
+  using ConnectionReadyCallback = folly::Function<void(const Key&)>;
+
+  struct Options {
+    size_t maxConnectionsPerPeer{kDefaultMaxPooledConnectionsPerPeer};
+    // A new connection is started when the ready connections to a peer can
+    // open fewer streams than this, and none is already being established.
+    uint64_t prewarmStreamThreshold{kDefaultPoolPrewarmStreamThreshold};
+  };
+
+  struct Stream {
+    std::shared_ptr<QuicSocket> socket;
+    StreamId id;
+  };
+
+  QuicConnectionPool(
+      folly::EventBase* evb,
+      ConnectionFactory connectionFactory,
+      Options options = Options());
+
+  /**
+   * Closes all the connections.
+   */
+  ~QuicConnectionPool();
+
+  void setConnectionReadyCallback(ConnectionReadyCallback callback);
+
+  /**
+   * Opens a bidirectional stream to the key on one of the pooled connections.
+   * Returns STREAM_LIMIT_EXCEEDED if none of them can open one right now, in
+   * which case a connection is on its way unless the key already has
+   * maxConnectionsPerPeer connections, and the connection ready callback is
+   * called once it can be retried.
+   */
+  folly::Expected<Stream, LocalErrorCode> createBidirectionalStream(
+      const Key& key);
+
+  /**
+   * Starts connections to the key until it has numConnections of them, ready
+   * or not, up to maxConnectionsPerPeer.
+   */
+  void prewarm(const Key& key, size_t numConnections);
+
+  /**
+   * Returns the number of open connections to the key, and how many of them
+   * are ready.
+   */
+  size_t getNumConnections(const Key& key);
+  size_t getNumReadyConnections(const Key& key);
+
+  /**
+   * Closes the connections to every key. The streams that were handed out are
+   * closed with them.
+   */
+  void closeAll();
+
+ private:
+  class PooledConnection;
+  using Connections = std::vector<std::unique_ptr<PooledConnection>>;
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  void startConnection(const Key& key, Connections& connections);
+  void maybePrewarm(const Key& key, Connections& connections);
+  void onConnectionReady(const Key& key);
+  void onConnectionClosed();
+  // Drops the connections that have closed since the last call. They can't be
+  // destroyed from within their own callbacks.
+  void reapClosedConnections();
+
+  folly::EventBase* evb_;
+  ConnectionFactory connectionFactory_;
+  ConnectionReadyCallback connectionReadyCallback_;
+  Options options_;
+  std::unordered_map<Key, Connections, KeyHash> connections_;
+  bool hasClosedConnections_{false};
+  bool closing_{false};
+};
+} // namespace quic
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicSharedClientSocket.h>
+
+#include <folly/io/Cursor.h>
+#include <quic/codec/Decode.h>
+
+namespace quic {
+
+namespace {
+folly::Optional<ConnectionId> parseDestinationConnectionId(
+    const folly::IOBuf& data,
+    size_t connectionIdSize) {
+  folly::io::Cursor cursor(&data);
+  if (!cursor.canAdvance(sizeof(uint8_t))) {
+    return folly::none;
+  }
+  uint8_t initialByte = cursor.readBE<uint8_t>();
+  if (getHeaderForm(initialByte) == HeaderForm::Short) {
+    auto shortHeader =
+        parseShortHeaderInvariants(initialByte, cursor, connectionIdSize);
+    if (!shortHeader) {
+      return folly::none;
+    }
+    return std::move(shortHeader->destinationConnId);
+  }
+  // Also covers version negotiation, which carries the client's connection
+  // id in the long header.
+  auto longHeader = parseLongHeaderInvariant(initialByte, cursor);
+  if (!longHeader) {
+    return folly::none;
+  }
+  return std::move(longHeader->invariant.dstConnId);
+}
+} // namespace
+
+QuicSharedClientSocket::QuicSharedClientSocket(
+    folly::EventBase* evb,
+    std::unique_ptr<folly::AsyncUDPSocket> socket,
+    Options options)
+    : evb_(evb), socket_(std::move(socket)), options_(options) {
+  CHECK(socket_->isBound());
+  if (options_.maxCoalescedWriteBatchSize > 0) {
+    writeCoalescer_ = QuicWriteCoalescer::registerSocket(
+        evb_, *socket_, options_.maxCoalescedWriteBatchSize);
+  }
+  if (options_.maxRecvBatchSize > 1) {
+    batchReadHandler_ = std::make_unique<BatchReadHandler>(
+        evb_,
+        socket_->getNetworkSocket(),
+        std::make_unique<RecvmmsgBatchReader>(
+            options_.maxRecvBatchSize, options_.maxRecvPacketSize),
+        this);
+    batchReadHandler_->start();
+  } else {
+    socket_->resumeRead(this);
+  }
+}
+
+QuicSharedClientSocket::~QuicSharedClientSocket() {
+  // The clients keep the shared socket alive, so they are all gone.
+  DCHECK(connections_.empty());
+  batchReadHandler_.reset();
+  if (writeCoalescer_) {
+    // Write out the close packets of the clients.
+    writeCoalescer_->flush();
+    QuicWriteCoalescer::unregisterSocket(socket_->getNetworkSocket());
+    writeCoalescer_.reset();
+  }
+  socket_->pauseRead();
+  socket_->close();
+}
+
+void QuicSharedClientSocket::getReadBuffer(void** buf, size_t* len) noexcept {
+  readBuffer_ = folly::IOBuf::create(options_.maxRecvPacketSize);
+  *buf = readBuffer_->writableData();
+  *len = options_.maxRecvPacketSize;
+}
+
+void QuicSharedClientSocket::onDataAvailable(
+    const folly::SocketAddress& peer,
+    size_t len,
+    bool truncated) noexcept {
+  auto receiveTime = Clock::now();
+  Buf data = std::move(readBuffer_);
+  if (truncated) {
+    VLOG(4) << "Dropping truncated packet from " << peer;
+    return;
+  }
+  data->append(len);
+  dispatch(peer, NetworkData(std::move(data), receiveTime));
+}
+
+void QuicSharedClientSocket::onReadError(
+    const folly::AsyncSocketException& ex) noexcept {
+  VLOG(4) << "Read error on shared client socket " << ex.what();
+  // The socket stops reading on an error, one client's peer going away
+  // shouldn't stop the others.
+  socket_->resumeRead(this);
+}
+
+void QuicSharedClientSocket::onBatchRead(
+    std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+    TimePoint receiveTime) noexcept {
+  for (auto& packet : packets) {
+    if (packet.truncated) {
+      VLOG(4) << "Dropping truncated packet from " << packet.peer;
+      continue;
+    }
+    dispatch(
+        packet.peer,
+        NetworkData(std::move(packet.data), receiveTime, packet.ecn));
+  }
+}
+
+void QuicSharedClientSocket::onBatchReadError(int err) noexcept {
+  VLOG(4) << "Batch read error on shared client socket errno=" << err;
+}
+
+void QuicSharedClientSocket::dispatch(
+    const folly::SocketAddress& peer,
+    NetworkData&& networkData) {
+  auto connectionId = parseDestinationConnectionId(
+      *networkData.data, options_.connectionIdSize);
+  auto it =
+      connectionId ? connections_.find(*connectionId) : connections_.end();
+  if (it == connections_.end()) {
+    VLOG(4) << "Dropping unroutable packet from " << peer;
+    ++numUnroutablePackets_;
+    return;
+  }
+  // The client can go away while handling the packet, taking its socket and
+  // possibly the last reference to this one with it.
+  auto self = shared_from_this();
+  it->second->onNetworkData(peer, std::move(networkData));
+}
+
+QuicSharedClientSocket::ConnectionSocket::ConnectionSocket(
+    std::shared_ptr<QuicSharedClientSocket> shared)
+    : folly::AsyncUDPSocket(shared->evb_), shared_(std::move(shared)) {}
+
+QuicSharedClientSocket::ConnectionSocket::~ConnectionSocket() {
+  unregister();
+}
+
+void QuicSharedClientSocket::ConnectionSocket::setTransport(
+    QuicClientTransport* transport) {
+  DCHECK(!transport_);
+  transport_ = transport;
+  const auto& connectionId = transport_->getState()->clientConnectionId;
+  CHECK(
+      connectionId &&
+      connectionId->size() == shared_->options_.connectionIdSize);
+  // The connection ids are random, a collision can only be a bug.
+  CHECK(shared_->connections_.emplace(*connectionId, this).second);
+  connectionId_ = *connectionId;
+}
+
+void QuicSharedClientSocket::ConnectionSocket::onNetworkData(
+    const folly::SocketAddress& peer,
+    NetworkData&& networkData) {
+  if (!reading_) {
+    return;
+  }
+  transport_->onNetworkData(peer, std::move(networkData));
+}
+
+void QuicSharedClientSocket::ConnectionSocket::unregister() {
+  reading_ = false;
+  if (connectionId_) {
+    shared_->connections_.erase(*connectionId_);
+    connectionId_.clear();
+  }
+}
+
+const folly::SocketAddress&
+QuicSharedClientSocket::ConnectionSocket::address() const {
+  return shared_->socket_->address();
+}
+
+void QuicSharedClientSocket::ConnectionSocket::bind(
+    const folly::SocketAddress& /* address */) {}
+
+ssize_t QuicSharedClientSocket::ConnectionSocket::write(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  return shared_->socket_->write(address, buf);
+}
+
+ssize_t QuicSharedClientSocket::ConnectionSocket::writeGSO(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>& buf,
+    int gso) {
+  return shared_->socket_->writeGSO(address, buf, gso);
+}
+
+int QuicSharedClientSocket::ConnectionSocket::writem(
+    const folly::SocketAddress& address,
+    const std::unique_ptr<folly::IOBuf>* bufs,
+    size_t count) {
+  return shared_->socket_->writem(address, bufs, count);
+}
+
+void QuicSharedClientSocket::ConnectionSocket::resumeRead(
+    ReadCallback* /* cob */) {
+  // The packets go straight to the transport.
+  reading_ = true;
+}
+
+void QuicSharedClientSocket::ConnectionSocket::pauseRead() {
+  reading_ = false;
+}
+
+void QuicSharedClientSocket::ConnectionSocket::close() {
+  unregister();
+}
+
+folly::NetworkSocket
+QuicSharedClientSocket::ConnectionSocket::getNetworkSocket() const {
+  return shared_->socket_->getNetworkSocket();
+}
+
+bool QuicSharedClientSocket::ConnectionSocket::isBound() const {
+  return true;
+}
+
+int QuicSharedClientSocket::ConnectionSocket::connect(
+    const folly::SocketAddress& /* address */) {
+  // The shared socket talks to all the peers, the writes carry the address
+  // anyway.
+  return 0;
+}
+
+void QuicSharedClientSocket::ConnectionSocket::setErrMessageCallback(
+    ErrMessageCallback* /* errMessageCallback */) {}
+
+void QuicSharedClientSocket::ConnectionSocket::setReuseAddr(
+    bool /* reuseAddr */) {}
+
+void QuicSharedClientSocket::ConnectionSocket::dontFragment(bool /* df */) {}
+
+void QuicSharedClientSocket::ConnectionSocket::setDFAndTurnOffPMTU() {}
+} // namespace quic
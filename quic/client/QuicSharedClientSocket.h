@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/container/F14Map.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+#include <quic/api/QuicBatchReader.h>
+#include <quic/api/QuicWriteCoalescer.h>
+#include <quic/client/QuicClientTransport.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * One UDP socket shared by many client transports on the same EventBase, so
+ * that a process with many outbound connections doesn't need a file
+ * descriptor and an ephemeral port for each of them. The received packets
+ * are dispatched to the transports by their destination connection id, like
+ * the server worker does, and the writes of all the transports can be
+ * flushed together at the end of the loop, see QuicWriteCoalescer.
+ *
+ * The transports get their connection ids from newClient(), which all have
+ * the same length so that short header packets can be routed. Happy eyeballs
+ * isn't supported, since the socket only has one family, and neither are
+ * stateless resets, which don't carry a connection id that can be routed.
+ * Everything has to be used from the thread of the EventBase.
+ */
+class QuicSharedClientSocket
+    : public std::enable_shared_from_this<QuicSharedClientSocket>,
+      private folly::AsyncUDPSocket::ReadCallback,
+      private BatchReadHandler::Callback {
+ public:
+  struct Options {
+    // The length of the connection ids of the clients.
+    size_t connectionIdSize{kDefaultConnectionIdSize};
+    // The max UDP packet size we are willing to receive.
+    uint64_t maxRecvPacketSize{kDefaultUDPReadBufferSize};
+    // Maximum number of datagrams read per read event, using recvmmsg where
+    // available.
+    uint32_t maxRecvBatchSize{kDefaultQuicMaxRecvBatchSize};
+    // When not 0, the packets written by all the clients during one loop
+    // iteration are flushed together, up to this many per sendmmsg.
+    size_t maxCoalescedWriteBatchSize{0};
+  };
+
+  /**
+   * The socket has to be bound. The reads start right away.
+   */
+  QuicSharedClientSocket(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> socket,
+      Options options);
+
+  QuicSharedClientSocket(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> socket)
+      : QuicSharedClientSocket(evb, std::move(socket), Options()) {}
+
+  ~QuicSharedClientSocket() override;
+
+  /**
+   * Returns a self-owning client, like QuicClientTransport::newClient(), that
+   * sends and receives through this socket. The shared socket is kept alive
+   * by its clients.
+   */
+  template <class TransportType = QuicClientTransport>
+  std::shared_ptr<TransportType> newClient() {
+    auto socket = std::make_unique<ConnectionSocket>(shared_from_this());
+    auto socketPtr = socket.get();
+    auto client = QuicClientTransport::newClient<TransportType>(
+        evb_, std::move(socket), options_.connectionIdSize);
+    client->sharedSocket_ = true;
+    socketPtr->setTransport(client.get());
+    return client;
+  }
+
+  const folly::SocketAddress& address() const {
+    return socket_->address();
+  }
+
+  /**
+   * The number of clients that can receive packets.
+   */
+  size_t numConnections() const {
+    return connections_.size();
+  }
+
+  /**
+   * The number of packets that were dropped because they weren't for any of
+   * the clients.
+   */
+  uint64_t numUnroutablePackets() const {
+    return numUnroutablePackets_;
+  }
+
+ private:
+  /**
+   * The socket of one client. It writes to the shared socket and gets the
+   * packets for the client from it. Everything that configures the socket is
+   * up to the owner of the shared socket and is ignored.
+   */
+  class ConnectionSocket : public folly::AsyncUDPSocket {
+   public:
+    explicit ConnectionSocket(std::shared_ptr<QuicSharedClientSocket> shared);
+
+    ~ConnectionSocket() override;
+
+    void setTransport(QuicClientTransport* transport);
+
+    void onNetworkData(
+        const folly::SocketAddress& peer,
+        NetworkData&& networkData);
+
+    const folly::SocketAddress& address() const override;
+
+    void bind(const folly::SocketAddress& address) override;
+
+    ssize_t write(
+        const folly::SocketAddress& address,
+        const std::unique_ptr<folly::IOBuf>& buf) override;
+
+    ssize_t writeGSO(
+        const folly::SocketAddress& address,
+        const std::unique_ptr<folly::IOBuf>& buf,
+        int gso) override;
+
+    int writem(
+        const folly::SocketAddress& address,
+        const std::unique_ptr<folly::IOBuf>* bufs,
+        size_t count) override;
+
+    void resumeRead(ReadCallback* cob) override;
+
+    void pauseRead() override;
+
+    void close() override;
+
+    folly::NetworkSocket getNetworkSocket() const override;
+
+    bool isBound() const override;
+
+    int connect(const folly::SocketAddress& address) override;
+
+    void setErrMessageCallback(ErrMessageCallback* errMessageCallback) override;
+
+    void setReuseAddr(bool reuseAddr) override;
+
+    void dontFragment(bool df) override;
+
+    void setDFAndTurnOffPMTU() override;
+
+   private:
+    void unregister();
+
+    std::shared_ptr<QuicSharedClientSocket> shared_;
+    QuicClientTransport* transport_{nullptr};
+    folly::Optional<ConnectionId> connectionId_;
+    bool reading_{false};
+  };
+
+  // folly::AsyncUDPSocket::ReadCallback
+  void getReadBuffer(void** buf, size_t* len) noexcept override;
+  void onDataAvailable(
+      const folly::SocketAddress& peer,
+      size_t len,
+      bool truncated) noexcept override;
+  void onReadError(const folly::AsyncSocketException& ex) noexcept override;
+  void onReadClosed() noexcept override {}
+
+  // BatchReadHandler::Callback
+  void onBatchRead(
+      std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+      TimePoint receiveTime) noexcept override;
+  void onBatchReadError(int err) noexcept override;
+
+  void dispatch(const folly::SocketAddress& peer, NetworkData&& networkData);
+
+  folly::EventBase* evb_;
+  std::unique_ptr<folly::AsyncUDPSocket> socket_;
+  Options options_;
+  Buf readBuffer_;
+  std::unique_ptr<BatchReadHandler> batchReadHandler_;
+  std::shared_ptr<QuicWriteCoalescer> writeCoalescer_;
+  folly::F14FastMap<ConnectionId, ConnectionSocket*, ConnectionIdHash>
+      connections_;
+  uint64_t numUnroutablePackets_{0};
+};
+} // namespace quic
@@ -18,6 +18,16 @@ namespace quic {
 ClientHandshake::ClientHandshake(QuicCryptoState& cryptoState)
     : cryptoState_(cryptoState) {}
 
+void ClientHandshake::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  cryptoFactory_ = std::move(cryptoFactory);
+}
+
+void ClientHandshake::setCertDecompressionManager(
+    std::shared_ptr<fizz::CertDecompressionManager> decompressionManager) {
+  certDecompressionManager_ = std::move(decompressionManager);
+}
+
 void ClientHandshake::connect(
     std::shared_ptr<const fizz::client::FizzClientContext> context,
     std::shared_ptr<const fizz::CertificateVerifier> verifier,
@@ -28,11 +38,15 @@ void ClientHandshake::connect(
   transportParams_ = transportParams;
   callback_ = callback;
   auto ctx = std::make_shared<fizz::client::FizzClientContext>(*context);
-  auto cryptoFactory = std::make_shared<FizzCryptoFactory>();
-  ctx->setFactory(cryptoFactory);
-  cryptoFactory_ = std::move(cryptoFactory);
-  ctx->setSupportedCiphers({fizz::CipherSuite::TLS_AES_128_GCM_SHA256});
+  if (!cryptoFactory_) {
+    cryptoFactory_ = std::make_shared<FizzCryptoFactory>();
+  }
+  ctx->setFactory(cryptoFactory_);
+  ctx->setSupportedCiphers(getQuicCipherSuites(hasHardwareAes()));
   ctx->setCompatibilityMode(false);
+  if (certDecompressionManager_ && !ctx->getCertDecompressionManager()) {
+    ctx->setCertDecompressionManager(certDecompressionManager_);
+  }
   // Since Draft-17, EOED should not be sent
   ctx->setOmitEarlyRecordLayer(true);
   processActions(machine_.processConnect(
@@ -170,6 +184,23 @@ ClientHandshake::getZeroRttWriteHeaderCipher() {
   return std::move(zeroRttWriteHeaderCipher_);
 }
 
+std::unique_ptr<OneRttKeyUpdater> ClientHandshake::getOneRttKeyUpdater() {
+  if (error_) {
+    error_.throw_exception();
+  }
+  if (oneRttReadSecret_.empty() || oneRttWriteSecret_.empty()) {
+    return nullptr;
+  }
+  auto updater = std::make_unique<OneRttKeyUpdater>(
+      *state_.cipher(),
+      std::move(oneRttReadSecret_),
+      std::move(oneRttWriteSecret_),
+      cryptoFactory_);
+  oneRttReadSecret_.clear();
+  oneRttWriteSecret_.clear();
+  return updater;
+}
+
 /**
  * Notify the crypto layer that we received one rtt protected data.
  * This allows us to know that the peer has implicitly acked the 1-rtt keys.
@@ -210,7 +241,8 @@ const folly::Optional<std::string>& ClientHandshake::getApplicationProtocol()
 
 void ClientHandshake::computeCiphers(CipherKind kind, folly::ByteRange secret) {
   auto aead = buildAead(kind, secret);
-  auto packetNumberCipher = cryptoFactory_->makePacketNumberCipher(secret);
+  auto packetNumberCipher =
+      cryptoFactory_->makePacketNumberCipher(getCipherSuite(kind), secret);
   switch (kind) {
     case CipherKind::HandshakeWrite:
       handshakeWriteCipher_ = std::move(aead);
@@ -223,10 +255,12 @@ void ClientHandshake::computeCiphers(CipherKind kind, folly::ByteRange secret) {
     case CipherKind::OneRttWrite:
       oneRttWriteCipher_ = std::move(aead);
       oneRttWriteHeaderCipher_ = std::move(packetNumberCipher);
+      oneRttWriteSecret_.assign(secret.begin(), secret.end());
       break;
     case CipherKind::OneRttRead:
       oneRttReadCipher_ = std::move(aead);
       oneRttReadHeaderCipher_ = std::move(packetNumberCipher);
+      oneRttReadSecret_.assign(secret.begin(), secret.end());
       break;
     case CipherKind::ZeroRttWrite:
       zeroRttWriteCipher_ = std::move(aead);
@@ -247,12 +281,16 @@ void ClientHandshake::processSocketData(folly::IOBufQueue& queue) {
   processActions(machine_.processSocketData(state_, queue));
 }
 
+fizz::CipherSuite ClientHandshake::getCipherSuite(CipherKind kind) const {
+  return kind == CipherKind::ZeroRttWrite ? state_.earlyDataParams()->cipher
+                                          : *state_.cipher();
+}
+
 std::unique_ptr<Aead> ClientHandshake::buildAead(
     CipherKind kind,
     folly::ByteRange secret) {
   bool isEarlyTraffic = kind == CipherKind::ZeroRttWrite;
-  fizz::CipherSuite cipher =
-      isEarlyTraffic ? state_.earlyDataParams()->cipher : *state_.cipher();
+  fizz::CipherSuite cipher = getCipherSuite(kind);
   std::unique_ptr<fizz::KeyScheduler> keySchedulerPtr = isEarlyTraffic
       ? state_.context()->getFactory()->makeKeyScheduler(cipher)
       : nullptr;
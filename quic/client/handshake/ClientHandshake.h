@@ -22,8 +22,9 @@
 #include <quic/QuicException.h>
 #include <quic/client/handshake/ClientTransportParametersExtension.h>
 #include <quic/client/handshake/QuicPskCache.h>
-#include <quic/handshake/CryptoFactory.h>
+#include <quic/handshake/FizzCryptoFactory.h>
 #include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/OneRttKeyUpdater.h>
 #include <quic/state/StateData.h>
 
 namespace quic {
@@ -41,6 +42,21 @@ class ClientHandshake : public Handshake {
 
   explicit ClientHandshake(QuicCryptoState& cryptoState);
 
+  /**
+   * Makes the packet protection of the connection with the given factory
+   * instead of a FizzCryptoFactory of its own. Must be called before
+   * connect().
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
+  /**
+   * Offers the compression of the server's Certificate message with the
+   * algorithms of the manager, unless the context already has a manager of
+   * its own. Must be called before connect().
+   */
+  void setCertDecompressionManager(
+      std::shared_ptr<fizz::CertDecompressionManager> decompressionManager);
+
   /**
    * Initiate the handshake with the supplied parameters.
    */
@@ -122,6 +138,13 @@ class ClientHandshake : public Handshake {
    */
   std::unique_ptr<PacketNumberCipher> getZeroRttWriteHeaderCipher();
 
+  /**
+   * An edge triggered API to get the updater of the 1-rtt keys, available
+   * once both 1-rtt secrets are derived. Once you receive the updater
+   * subsequent calls will return null.
+   */
+  std::unique_ptr<OneRttKeyUpdater> getOneRttKeyUpdater();
+
   /**
    * Notify the crypto layer that we received one rtt protected data.
    * This allows us to know that the peer has implicitly acked the 1-rtt keys.
@@ -179,6 +202,10 @@ class ClientHandshake : public Handshake {
   std::unique_ptr<PacketNumberCipher> handshakeWriteHeaderCipher_;
   std::unique_ptr<PacketNumberCipher> zeroRttWriteHeaderCipher_;
 
+  // Kept until the key updater is made from them.
+  std::vector<uint8_t> oneRttReadSecret_;
+  std::vector<uint8_t> oneRttWriteSecret_;
+
   void computeCiphers(CipherKind kind, folly::ByteRange secret);
 
   folly::Optional<bool> zeroRttRejected_;
@@ -188,6 +215,9 @@ class ClientHandshake : public Handshake {
  private:
   EncryptionLevel getReadRecordLayerEncryptionLevel();
   void processSocketData(folly::IOBufQueue& queue);
+  // The cipher suite of the early data for ZeroRttWrite, the negotiated one
+  // otherwise.
+  fizz::CipherSuite getCipherSuite(CipherKind kind) const;
   std::unique_ptr<Aead> buildAead(CipherKind kind, folly::ByteRange secret);
 
   void writeDataToStream(EncryptionLevel encryptionLevel, Buf data);
@@ -209,7 +239,8 @@ class ClientHandshake : public Handshake {
 
   folly::exception_wrapper error_;
 
-  std::shared_ptr<CryptoFactory> cryptoFactory_;
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
+  std::shared_ptr<fizz::CertDecompressionManager> certDecompressionManager_;
   std::shared_ptr<ClientTransportParametersExtension> transportParams_;
   bool earlyDataAttempted_{false};
 };
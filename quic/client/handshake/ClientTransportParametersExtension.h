@@ -25,7 +25,8 @@ class ClientTransportParametersExtension : public fizz::ClientExtensions {
       uint64_t ackDelayExponent,
       uint64_t maxRecvPacketSize,
       std::vector<TransportParameter> customTransportParameters =
-          std::vector<TransportParameter>())
+          std::vector<TransportParameter>(),
+      folly::Optional<std::chrono::milliseconds> maxAckDelay = folly::none)
       : initialVersion_(initialVersion),
         initialMaxData_(initialMaxData),
         initialMaxStreamDataBidiLocal_(initialMaxStreamDataBidiLocal),
@@ -34,7 +35,8 @@ class ClientTransportParametersExtension : public fizz::ClientExtensions {
         idleTimeout_(idleTimeout),
         ackDelayExponent_(ackDelayExponent),
         maxRecvPacketSize_(maxRecvPacketSize),
-        customTransportParameters_(customTransportParameters) {}
+        customTransportParameters_(customTransportParameters),
+        maxAckDelay_(maxAckDelay) {}
 
   ~ClientTransportParametersExtension() override = default;
 
@@ -66,6 +68,10 @@ class ClientTransportParametersExtension : public fizz::ClientExtensions {
         TransportParameterId::ack_delay_exponent, ackDelayExponent_));
     params.parameters.push_back(encodeIntegerParameter(
         TransportParameterId::max_packet_size, maxRecvPacketSize_));
+    if (maxAckDelay_) {
+      params.parameters.push_back(encodeIntegerParameter(
+          TransportParameterId::max_ack_delay, maxAckDelay_->count()));
+    }
 
     for (const auto& customParameter : customTransportParameters_) {
       params.parameters.push_back(customParameter);
@@ -101,5 +107,6 @@ class ClientTransportParametersExtension : public fizz::ClientExtensions {
   uint64_t maxRecvPacketSize_;
   folly::Optional<ServerTransportParameters> serverTransportParameters_;
   std::vector<TransportParameter> customTransportParameters_;
+  folly::Optional<std::chrono::milliseconds> maxAckDelay_;
 };
 } // namespace quic
@@ -34,6 +34,9 @@ struct QuicCachedPsk {
   fizz::client::CachedPsk cachedPsk;
   CachedServerTransportParameters transportParams;
   std::string appParams;
+  // The token of the last NEW_TOKEN frame of the server, sent in the Initials
+  // of the next connection. Empty if the server sent none.
+  std::string newToken;
 };
 
 class QuicPskCache {
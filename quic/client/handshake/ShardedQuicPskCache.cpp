@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/handshake/ShardedQuicPskCache.h>
+
+#include <fizz/client/PskSerializationUtils.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/io/Cursor.h>
+#include <folly/system/MemoryMapping.h>
+
+#include <glog/logging.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace quic {
+
+namespace {
+
+template <typename Length>
+void writeString(folly::StringPiece str, folly::io::Appender& appender) {
+  CHECK_LE(str.size(), std::numeric_limits<Length>::max());
+  appender.writeBE<Length>(str.size());
+  appender.push(folly::ByteRange(str));
+}
+
+template <typename Length>
+std::string readString(folly::io::Cursor& cursor) {
+  return cursor.readFixedString(cursor.readBE<Length>());
+}
+
+void writeEntry(
+    const std::string& identity,
+    const QuicCachedPsk& psk,
+    folly::io::Appender& appender) {
+  writeString<uint16_t>(identity, appender);
+  writeString<uint32_t>(fizz::client::serializePsk(psk.cachedPsk), appender);
+  const auto& params = psk.transportParams;
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(params.negotiatedVersion));
+  appender.writeBE<uint64_t>(params.idleTimeout);
+  appender.writeBE<uint64_t>(params.maxRecvPacketSize);
+  appender.writeBE<uint64_t>(params.initialMaxData);
+  appender.writeBE<uint64_t>(params.initialMaxStreamDataBidiLocal);
+  appender.writeBE<uint64_t>(params.initialMaxStreamDataBidiRemote);
+  appender.writeBE<uint64_t>(params.initialMaxStreamDataUni);
+  appender.writeBE<uint64_t>(params.initialMaxStreamsBidi);
+  appender.writeBE<uint64_t>(params.initialMaxStreamsUni);
+  writeString<uint32_t>(psk.appParams, appender);
+  writeString<uint32_t>(psk.newToken, appender);
+}
+
+QuicCachedPsk readEntry(
+    folly::io::Cursor& cursor,
+    const fizz::Factory& factory) {
+  QuicCachedPsk psk;
+  psk.cachedPsk =
+      fizz::client::deserializePsk(readString<uint32_t>(cursor), factory);
+  auto& params = psk.transportParams;
+  params.negotiatedVersion =
+      static_cast<QuicVersion>(cursor.readBE<uint32_t>());
+  params.idleTimeout = cursor.readBE<uint64_t>();
+  params.maxRecvPacketSize = cursor.readBE<uint64_t>();
+  params.initialMaxData = cursor.readBE<uint64_t>();
+  params.initialMaxStreamDataBidiLocal = cursor.readBE<uint64_t>();
+  params.initialMaxStreamDataBidiRemote = cursor.readBE<uint64_t>();
+  params.initialMaxStreamDataUni = cursor.readBE<uint64_t>();
+  params.initialMaxStreamsBidi = cursor.readBE<uint64_t>();
+  params.initialMaxStreamsUni = cursor.readBE<uint64_t>();
+  psk.appParams = readString<uint32_t>(cursor);
+  psk.newToken = readString<uint32_t>(cursor);
+  return psk;
+}
+} // namespace
+
+ShardedQuicPskCache::ShardedQuicPskCache(size_t capacity, size_t numShards) {
+  CHECK_GT(numShards, 0);
+  auto shardCapacity = std::max<size_t>(1, capacity / numShards);
+  shards_.reserve(numShards);
+  for (size_t i = 0; i < numShards; ++i) {
+    shards_.push_back(std::make_unique<Shard>(shardCapacity));
+  }
+}
+
+ShardedQuicPskCache::Shard& ShardedQuicPskCache::getShard(
+    const std::string& identity) const {
+  return *shards_[std::hash<std::string>()(identity) % shards_.size()];
+}
+
+folly::Optional<QuicCachedPsk> ShardedQuicPskCache::getPsk(
+    const std::string& identity) {
+  auto& shard = getShard(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto result = shard.cache.find(identity);
+  if (result != shard.cache.end()) {
+    return result->second;
+  }
+  return folly::none;
+}
+
+void ShardedQuicPskCache::putPsk(
+    const std::string& identity,
+    QuicCachedPsk psk) {
+  auto& shard = getShard(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.cache.set(identity, std::move(psk));
+}
+
+void ShardedQuicPskCache::removePsk(const std::string& identity) {
+  auto& shard = getShard(identity);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.cache.erase(identity);
+}
+
+size_t ShardedQuicPskCache::size() const {
+  size_t size = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    size += shard->cache.size();
+  }
+  return size;
+}
+
+bool ShardedQuicPskCache::save(const std::string& path) const {
+  auto buf = folly::IOBuf::create(4096);
+  folly::io::Appender appender(buf.get(), 4096);
+  appender.writeBE<uint8_t>(kPskCacheFileVersion);
+  // Each shard is only locked while it is encoded, so the count is only known
+  // at the end.
+  uint32_t count = 0;
+  auto entries = folly::IOBuf::create(4096);
+  folly::io::Appender entryAppender(entries.get(), 4096);
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    for (const auto& entry : shard->cache) {
+      writeEntry(entry.first, entry.second, entryAppender);
+      ++count;
+    }
+  }
+  appender.writeBE<uint32_t>(count);
+  buf->prependChain(std::move(entries));
+  auto ret =
+      folly::writeFileAtomicNoThrow(path, folly::ByteRange(buf->coalesce()));
+  if (ret != 0) {
+    VLOG(4) << "Failed to save the psk cache to " << path << ": "
+            << folly::errnoStr(ret);
+    return false;
+  }
+  return true;
+}
+
+bool ShardedQuicPskCache::load(
+    const std::string& path,
+    const fizz::Factory& factory) {
+  std::vector<std::pair<std::string, QuicCachedPsk>> entries;
+  try {
+    folly::MemoryMapping mapping(path.c_str());
+    auto data = folly::IOBuf::wrapBuffer(mapping.range());
+    folly::io::Cursor cursor(data.get());
+    if (cursor.readBE<uint8_t>() != kPskCacheFileVersion) {
+      return false;
+    }
+    auto count = cursor.readBE<uint32_t>();
+    for (uint32_t i = 0; i < count; ++i) {
+      auto identity = readString<uint16_t>(cursor);
+      entries.emplace_back(std::move(identity), readEntry(cursor, factory));
+    }
+    if (!cursor.isAtEnd()) {
+      return false;
+    }
+  } catch (const std::exception& ex) {
+    VLOG(4) << "Failed to load the psk cache from " << path << ": "
+            << ex.what();
+    return false;
+  }
+  for (auto& entry : entries) {
+    putPsk(entry.first, std::move(entry.second));
+  }
+  return true;
+}
+} // namespace quic
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/client/handshake/QuicPskCache.h>
+
+#include <fizz/protocol/Factory.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+/**
+ * PSK cache that can be shared by the clients of many threads. The identities
+ * are spread over shards that each have their own lock and hold at most
+ * capacity / numShards PSKs, evicting the least recently used one when full.
+ *
+ * The cache can be saved to a file and loaded back, so that the PSKs survive a
+ * restart of the process.
+ */
+class ShardedQuicPskCache : public QuicPskCache {
+ public:
+  explicit ShardedQuicPskCache(
+      size_t capacity,
+      size_t numShards = kDefaultPskCacheShards);
+
+  ~ShardedQuicPskCache() override = default;
+
+  folly::Optional<QuicCachedPsk> getPsk(const std::string& identity) override;
+  void putPsk(const std::string& identity, QuicCachedPsk psk) override;
+  void removePsk(const std::string& identity) override;
+
+  size_t size() const;
+
+  /**
+   * Writes all the PSKs to the file, atomically replacing it. Returns false if
+   * the file could not be written.
+   */
+  bool save(const std::string& path) const;
+
+  /**
+   * Adds the PSKs of a file written by save(), using the factory to rebuild
+   * the fizz PSKs. Returns false, and adds nothing, if the file could not be
+   * read or is malformed.
+   */
+  bool load(const std::string& path, const fizz::Factory& factory);
+
+ private:
+  struct Shard {
+    explicit Shard(size_t capacity) : cache(capacity) {}
+
+    mutable std::mutex mutex;
+    folly::EvictingCacheMap<std::string, QuicCachedPsk> cache;
+  };
+
+  Shard& getShard(const std::string& identity) const;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+} // namespace quic
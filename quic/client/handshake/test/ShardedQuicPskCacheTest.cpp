@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/handshake/ShardedQuicPskCache.h>
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/portability/GTest.h>
+
+#include <thread>
+
+namespace quic {
+namespace test {
+
+namespace {
+QuicCachedPsk makePsk(const std::string& secret) {
+  QuicCachedPsk quicCachedPsk;
+  auto& psk = quicCachedPsk.cachedPsk;
+  psk.psk = std::string("psk");
+  psk.secret = secret;
+  psk.type = fizz::PskType::Resumption;
+  psk.version = fizz::ProtocolVersion::tls_1_3;
+  psk.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+  psk.group = fizz::NamedGroup::x25519;
+  psk.alpn = std::string("h3");
+  psk.ticketAgeAdd = 1;
+  psk.ticketIssueTime =
+      std::chrono::system_clock::time_point(std::chrono::minutes(1));
+  psk.ticketExpirationTime =
+      std::chrono::system_clock::time_point(std::chrono::minutes(100));
+  psk.ticketHandshakeTime =
+      std::chrono::system_clock::time_point(std::chrono::minutes(1));
+  psk.maxEarlyDataSize = 2;
+  quicCachedPsk.transportParams.negotiatedVersion = QuicVersion::MVFST;
+  quicCachedPsk.transportParams.idleTimeout = 1;
+  quicCachedPsk.transportParams.maxRecvPacketSize = 2;
+  quicCachedPsk.transportParams.initialMaxData = 3;
+  quicCachedPsk.transportParams.initialMaxStreamDataBidiLocal = 4;
+  quicCachedPsk.transportParams.initialMaxStreamDataBidiRemote = 5;
+  quicCachedPsk.transportParams.initialMaxStreamDataUni = 6;
+  quicCachedPsk.transportParams.initialMaxStreamsBidi = 7;
+  quicCachedPsk.transportParams.initialMaxStreamsUni = 8;
+  quicCachedPsk.appParams = "app params";
+  quicCachedPsk.newToken = "new token";
+  return quicCachedPsk;
+}
+} // namespace
+
+TEST(ShardedQuicPskCacheTest, PutGetRemove) {
+  ShardedQuicPskCache cache(100);
+  EXPECT_FALSE(cache.getPsk("a").hasValue());
+  cache.putPsk("a", makePsk("secret a"));
+  cache.putPsk("b", makePsk("secret b"));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.getPsk("a")->cachedPsk.secret, "secret a");
+  EXPECT_EQ(cache.getPsk("b")->cachedPsk.secret, "secret b");
+
+  cache.putPsk("a", makePsk("new secret a"));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.getPsk("a")->cachedPsk.secret, "new secret a");
+
+  cache.removePsk("a");
+  EXPECT_FALSE(cache.getPsk("a").hasValue());
+  EXPECT_TRUE(cache.getPsk("b").hasValue());
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST(ShardedQuicPskCacheTest, EvictLeastRecentlyUsed) {
+  ShardedQuicPskCache cache(2, 1);
+  cache.putPsk("a", makePsk("secret a"));
+  cache.putPsk("b", makePsk("secret b"));
+  // Makes b the least recently used.
+  EXPECT_TRUE(cache.getPsk("a").hasValue());
+  cache.putPsk("c", makePsk("secret c"));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_TRUE(cache.getPsk("a").hasValue());
+  EXPECT_FALSE(cache.getPsk("b").hasValue());
+  EXPECT_TRUE(cache.getPsk("c").hasValue());
+}
+
+TEST(ShardedQuicPskCacheTest, ConcurrentAccess) {
+  ShardedQuicPskCache cache(1000);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t] {
+      for (int i = 0; i < 100; ++i) {
+        auto identity = folly::to<std::string>(t, ":", i);
+        cache.putPsk(identity, makePsk(identity));
+        auto psk = cache.getPsk(identity);
+        ASSERT_TRUE(psk.hasValue());
+        EXPECT_EQ(psk->cachedPsk.secret, identity);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(cache.size(), 400);
+}
+
+TEST(ShardedQuicPskCacheTest, SaveAndLoad) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "psks").string();
+  ShardedQuicPskCache cache(100);
+  cache.putPsk("a", makePsk("secret a"));
+  cache.putPsk("b", makePsk("secret b"));
+  ASSERT_TRUE(cache.save(path));
+
+  fizz::Factory factory;
+  ShardedQuicPskCache loaded(100);
+  ASSERT_TRUE(loaded.load(path, factory));
+  EXPECT_EQ(loaded.size(), 2);
+  for (const auto& identity : {"a", "b"}) {
+    auto expected = cache.getPsk(identity);
+    auto actual = loaded.getPsk(identity);
+    ASSERT_TRUE(actual.hasValue());
+    EXPECT_EQ(actual->cachedPsk.psk, expected->cachedPsk.psk);
+    EXPECT_EQ(actual->cachedPsk.secret, expected->cachedPsk.secret);
+    EXPECT_EQ(actual->cachedPsk.cipher, expected->cachedPsk.cipher);
+    EXPECT_EQ(actual->cachedPsk.alpn, expected->cachedPsk.alpn);
+    EXPECT_EQ(
+        actual->cachedPsk.ticketExpirationTime,
+        expected->cachedPsk.ticketExpirationTime);
+    EXPECT_EQ(
+        actual->transportParams.negotiatedVersion,
+        expected->transportParams.negotiatedVersion);
+    EXPECT_EQ(
+        actual->transportParams.initialMaxData,
+        expected->transportParams.initialMaxData);
+    EXPECT_EQ(
+        actual->transportParams.initialMaxStreamsUni,
+        expected->transportParams.initialMaxStreamsUni);
+    EXPECT_EQ(actual->appParams, expected->appParams);
+    EXPECT_EQ(actual->newToken, expected->newToken);
+  }
+}
+
+TEST(ShardedQuicPskCacheTest, LoadMalformed) {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "psks").string();
+  fizz::Factory factory;
+  ShardedQuicPskCache cache(100);
+  EXPECT_FALSE(cache.load(path, factory));
+
+  ShardedQuicPskCache saved(100);
+  saved.putPsk("a", makePsk("secret a"));
+  ASSERT_TRUE(saved.save(path));
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(path.c_str(), contents));
+  contents.resize(contents.size() - 1);
+  ASSERT_TRUE(folly::writeFile(contents, path.c_str()));
+  EXPECT_FALSE(cache.load(path, factory));
+  EXPECT_EQ(cache.size(), 0);
+}
+} // namespace test
+} // namespace quic
@@ -85,6 +85,14 @@ void processServerInitialParams(
   auto partialReliability = getIntegerParameter(
       static_cast<TransportParameterId>(kPartialReliabilityParameterId),
       serverParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      serverParams.parameters);
+  auto maxAckDelay = getIntegerParameter(
+      TransportParameterId::max_ack_delay, serverParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      serverParams.parameters);
   auto activeConnectionIdLimit = getIntegerParameter(
       TransportParameterId::active_connection_id_limit,
       serverParams.parameters);
@@ -130,9 +138,10 @@ void processServerInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen = *packetSize;
+  } else {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   conn.peerActiveConnectionIdLimit =
@@ -145,6 +154,32 @@ void processServerInitialParams(
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
 
+  // max_ack_delay is in milliseconds, min_ack_delay in microseconds.
+  if (maxAckDelay && *maxAckDelay >= kMaxMaxAckDelay) {
+    throw QuicTransportException(
+        "max_ack_delay too large",
+        TransportErrorCode::TRANSPORT_PARAMETER_ERROR);
+  }
+  auto peerMaxAckDelay = maxAckDelay
+      ? std::chrono::microseconds(std::chrono::milliseconds(*maxAckDelay))
+      : kMaxAckTimeout;
+  if (minAckDelay && *minAckDelay > uint64_t(peerMaxAckDelay.count())) {
+    throw QuicTransportException(
+        "min_ack_delay larger than max ack delay",
+        TransportErrorCode::TRANSPORT_PARAMETER_ERROR);
+  }
+  if (maxAckDelay) {
+    conn.ackFrequencyState.peerMaxAckDelay = peerMaxAckDelay;
+  }
+  if (minAckDelay && conn.transportSettings.ackFrequencyEnabled) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+
+  if (maxDatagramFrameSize && conn.transportSettings.maxDatagramFrameSize) {
+    conn.datagramState.maxWriteFrameSize = *maxDatagramFrameSize;
+  }
+
   conn.statelessResetToken = std::move(statelessResetToken);
   // Update the existing streams, because we allow streams to be created before
   // the connection is established.
@@ -27,6 +27,11 @@ struct QuicClientConnectionState : public QuicConnectionStateBase {
   // The retry token sent by the server.
   std::string retryToken;
 
+  // The token of a NEW_TOKEN frame, either of a previous connection, from
+  // the psk cache, or the latest one the server sent on this connection.
+  // The Initials carry it when there is no retry token.
+  std::string newToken;
+
   // Initial destination connection id.
   folly::Optional<ConnectionId> initialDestinationConnectionId;
 
@@ -6,6 +6,7 @@
  *
  */
 #include <quic/client/QuicClientTransport.h>
+#include <quic/client/QuicSharedClientSocket.h>
 #include <quic/server/QuicServer.h>
 
 #include <quic/api/test/Mocks.h>
@@ -199,17 +200,21 @@ class QuicClientTransportIntegrationTest : public TestWithParam<TestingParams> {
     auto sock = std::make_unique<folly::AsyncUDPSocket>(&eventbase_);
     client = std::make_shared<TestingQuicClientTransport>(
         &eventbase_, std::move(sock), GetParam().dstConnIdSize);
-    client->setSupportedVersions({getVersion()});
-    client->setCongestionControllerFactory(
-        std::make_shared<DefaultCongestionControllerFactory>());
-    client->setHostname(hostname);
-    client->setFizzClientContext(clientCtx);
-    client->setCertificateVerifier(createTestCertificateVerifier());
-    client->addNewPeerAddress(serverAddr);
-    client->setPskCache(pskCache_);
+    setUpClient(*client);
     return client;
   }
 
+  void setUpClient(QuicClientTransport& transport) {
+    transport.setSupportedVersions({getVersion()});
+    transport.setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    transport.setHostname(hostname);
+    transport.setFizzClientContext(clientCtx);
+    transport.setCertificateVerifier(createTestCertificateVerifier());
+    transport.addNewPeerAddress(serverAddr);
+    transport.setPskCache(pskCache_);
+  }
+
   std::shared_ptr<QuicServer> createServer(ProcessId processId) {
     auto server = QuicServer::createQuicServer();
     server->setQuicServerTransportFactory(
@@ -508,6 +513,70 @@ TEST_P(QuicClientTransportIntegrationTest, NetworkTestConnected) {
   sendRequestAndResponseAndWait(*expected, data->clone(), streamId, &readCb);
 }
 
+TEST_P(QuicClientTransportIntegrationTest, NetworkTestUnconnected) {
+  expectTransportCallbacks();
+  auto qLogger = std::make_shared<FileQLogger>(VantagePoint::CLIENT);
+  client->getNonConstConn().qLogger = qLogger;
+  TransportSettings settings;
+  settings.connectUDP = false;
+  client->setTransportSettings(settings);
+  client->start(&clientConnCallback);
+
+  EXPECT_CALL(clientConnCallback, onTransportReady()).WillOnce(Invoke([&] {
+    CHECK(client->getConn().oneRttWriteCipher);
+    eventbase_.terminateLoopSoon();
+  }));
+  eventbase_.loopForever();
+
+  auto streamId = client->createBidirectionalStream().value();
+  auto data = IOBuf::copyBuffer("hello");
+  auto expected = std::shared_ptr<IOBuf>(IOBuf::copyBuffer("echo "));
+  expected->prependChain(data->clone());
+  sendRequestAndResponseAndWait(*expected, data->clone(), streamId, &readCb);
+}
+
+TEST_P(QuicClientTransportIntegrationTest, NetworkTestSharedSocket) {
+  auto sock = std::make_unique<folly::AsyncUDPSocket>(&eventbase_);
+  sock->bind(folly::SocketAddress("::1", 0));
+  auto sharedSocket =
+      std::make_shared<QuicSharedClientSocket>(&eventbase_, std::move(sock));
+  client = sharedSocket->newClient<TestingQuicClientTransport>();
+  auto other = sharedSocket->newClient<TestingQuicClientTransport>();
+  EXPECT_EQ(2, sharedSocket->numConnections());
+  setUpClient(*client);
+  setUpClient(*other);
+
+  MockConnectionCallback otherConnCallback;
+  expectTransportCallbacks();
+  EXPECT_CALL(otherConnCallback, onReplaySafe());
+  size_t numReady = 0;
+  auto onReady = [&] {
+    if (++numReady == 2) {
+      eventbase_.terminateLoopSoon();
+    }
+  };
+  EXPECT_CALL(clientConnCallback, onTransportReady())
+      .WillOnce(Invoke(onReady));
+  EXPECT_CALL(otherConnCallback, onTransportReady()).WillOnce(Invoke(onReady));
+  client->start(&clientConnCallback);
+  other->start(&otherConnCallback);
+  eventbase_.loopForever();
+  EXPECT_EQ(sharedSocket->address(), client->getLocalAddress());
+  EXPECT_EQ(sharedSocket->address(), other->getLocalAddress());
+
+  auto streamId = client->createBidirectionalStream().value();
+  auto data = IOBuf::copyBuffer("hello");
+  auto expected = std::shared_ptr<IOBuf>(IOBuf::copyBuffer("echo "));
+  expected->prependChain(data->clone());
+  sendRequestAndResponseAndWait(*expected, data->clone(), streamId, &readCb);
+  EXPECT_EQ(0, sharedSocket->numUnroutablePackets());
+
+  other->closeNow(folly::none);
+  EXPECT_EQ(1, sharedSocket->numConnections());
+  client->closeNow(folly::none);
+  EXPECT_EQ(0, sharedSocket->numConnections());
+}
+
 TEST_P(QuicClientTransportIntegrationTest, SetTransportSettingsAfterStart) {
   expectTransportCallbacks();
   auto qLogger = std::make_shared<FileQLogger>(VantagePoint::CLIENT);
@@ -2467,6 +2536,41 @@ TEST_F(
   fatalWriteErrorOnBothAfterSecondStarts(serverAddrV4, serverAddrV6);
 }
 
+TEST_F(QuicClientTransportHappyEyeballsTest, CacheLearnsFromSecondWin) {
+  auto cache = std::make_shared<HappyEyeballsCache>();
+  client->setHappyEyeballsCache(cache);
+  secondWin(serverAddrV6, serverAddrV4);
+  auto decision = cache->decide();
+  EXPECT_EQ(decision.preferredFamily, AF_INET);
+  EXPECT_TRUE(decision.connAttemptDelay.hasValue());
+  EXPECT_EQ(decision.skipFamily, AF_UNSPEC);
+}
+
+TEST_F(QuicClientTransportHappyEyeballsTest, CacheSkipsBrokenFamily) {
+  auto cache = std::make_shared<HappyEyeballsCache>();
+  for (uint32_t i = 0; i < kHappyEyeballsBrokenFamilyLosses; ++i) {
+    cache->onFamilyLost(AF_INET6);
+  }
+  cache->onFamilySucceeded(AF_INET, 20ms);
+  client->setHappyEyeballsCache(cache);
+  auto& conn = client->getConn();
+
+  EXPECT_CALL(*secondSock, close());
+  EXPECT_CALL(*secondSock, write(_, _)).Times(0);
+  EXPECT_CALL(*sock, write(serverAddrV4, _))
+      .WillRepeatedly(Invoke([&](const SocketAddress&,
+                                 const std::unique_ptr<folly::IOBuf>& buf) {
+        socketWrites.push_back(buf->clone());
+        return buf->computeChainDataLength();
+      }));
+  client->start(&clientConnCallback);
+  EXPECT_EQ(conn.peerAddress, serverAddrV4);
+  EXPECT_FALSE(conn.happyEyeballsState.v6PeerAddress.isInitialized());
+  EXPECT_FALSE(conn.happyEyeballsState.secondSocket);
+  EXPECT_FALSE(client->happyEyeballsConnAttemptDelayTimeout().isScheduled());
+  EXPECT_TRUE(conn.happyEyeballsState.finished);
+}
+
 class QuicClientTransportAfterStartTestBase : public QuicClientTransportTest {
  public:
   void SetUp() override {
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/client/QuicConnectionPool.h>
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+
+#include <quic/api/test/MockQuicSocket.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class QuicConnectionPoolTest : public Test {
+ public:
+  void SetUp() override {
+    key.peerAddress = folly::SocketAddress("127.0.0.1", 443);
+    key.hostname = "www.facebook.com";
+    makePool(QuicConnectionPool::Options());
+  }
+
+  void makePool(QuicConnectionPool::Options options) {
+    pool = std::make_unique<QuicConnectionPool>(
+        &evb,
+        [this](
+            const QuicConnectionPool::Key& connKey,
+            QuicSocket::ConnectionCallback* cb) {
+          EXPECT_EQ(connKey, key);
+          auto socket = std::make_shared<NiceMock<MockQuicSocket>>(&evb, *cb);
+          ON_CALL(*socket, good()).WillByDefault(Return(true));
+          ON_CALL(*socket, getNumOpenableBidirectionalStreams())
+              .WillByDefault(Return(openableStreams));
+          ON_CALL(*socket, createBidirectionalStream(_))
+              .WillByDefault(Invoke([this](bool) { return nextStreamId++; }));
+          sockets.push_back(socket);
+          return socket;
+        },
+        options);
+    pool->setConnectionReadyCallback(
+        [this](const QuicConnectionPool::Key&) { numReady++; });
+  }
+
+  void makeReady(size_t index) {
+    sockets[index]->cb_->onTransportReady();
+  }
+
+  folly::EventBase evb;
+  QuicConnectionPool::Key key;
+  std::unique_ptr<QuicConnectionPool> pool;
+  std::vector<std::shared_ptr<NiceMock<MockQuicSocket>>> sockets;
+  uint64_t openableStreams{100};
+  StreamId nextStreamId{0};
+  size_t numReady{0};
+};
+
+TEST_F(QuicConnectionPoolTest, MultiplexStreams) {
+  auto stream = pool->createBidirectionalStream(key);
+  ASSERT_TRUE(stream.hasError());
+  EXPECT_EQ(stream.error(), LocalErrorCode::STREAM_LIMIT_EXCEEDED);
+  ASSERT_EQ(sockets.size(), 1);
+  EXPECT_EQ(pool->getNumConnections(key), 1);
+  EXPECT_EQ(pool->getNumReadyConnections(key), 0);
+
+  // Still waiting on the same connection.
+  EXPECT_TRUE(pool->createBidirectionalStream(key).hasError());
+  EXPECT_EQ(sockets.size(), 1);
+
+  makeReady(0);
+  EXPECT_EQ(numReady, 1);
+  EXPECT_EQ(pool->getNumReadyConnections(key), 1);
+  for (StreamId id = 0; id < 3; ++id) {
+    stream = pool->createBidirectionalStream(key);
+    ASSERT_TRUE(stream.hasValue());
+    EXPECT_EQ(stream->socket, sockets[0]);
+    EXPECT_EQ(stream->id, id);
+  }
+  EXPECT_EQ(sockets.size(), 1);
+}
+
+TEST_F(QuicConnectionPoolTest, PrewarmWhenLowOnStreams) {
+  openableStreams = kDefaultPoolPrewarmStreamThreshold - 1;
+  pool->prewarm(key, 1);
+  ASSERT_EQ(sockets.size(), 1);
+  makeReady(0);
+
+  auto stream = pool->createBidirectionalStream(key);
+  ASSERT_TRUE(stream.hasValue());
+  EXPECT_EQ(stream->socket, sockets[0]);
+  // The first connection can still open streams, but few enough that the
+  // next one is started ahead of demand.
+  ASSERT_EQ(sockets.size(), 2);
+  EXPECT_EQ(pool->getNumConnections(key), 2);
+
+  ON_CALL(*sockets[0], getNumOpenableBidirectionalStreams())
+      .WillByDefault(Return(0));
+  EXPECT_TRUE(pool->createBidirectionalStream(key).hasError());
+  makeReady(1);
+  stream = pool->createBidirectionalStream(key);
+  ASSERT_TRUE(stream.hasValue());
+  EXPECT_EQ(stream->socket, sockets[1]);
+}
+
+TEST_F(QuicConnectionPoolTest, MaxConnectionsPerPeer) {
+  QuicConnectionPool::Options options;
+  options.maxConnectionsPerPeer = 2;
+  makePool(options);
+  pool->prewarm(key, 5);
+  EXPECT_EQ(sockets.size(), 2);
+  makeReady(0);
+  makeReady(1);
+  for (auto& socket : sockets) {
+    ON_CALL(*socket, getNumOpenableBidirectionalStreams())
+        .WillByDefault(Return(0));
+  }
+  auto stream = pool->createBidirectionalStream(key);
+  ASSERT_TRUE(stream.hasError());
+  EXPECT_EQ(stream.error(), LocalErrorCode::STREAM_LIMIT_EXCEEDED);
+  EXPECT_EQ(sockets.size(), 2);
+}
+
+TEST_F(QuicConnectionPoolTest, ReplaceClosedConnection) {
+  pool->prewarm(key, 1);
+  makeReady(0);
+  sockets[0]->cb_->onConnectionError(std::make_pair(
+      QuicErrorCode(LocalErrorCode::IDLE_TIMEOUT), std::string("idle")));
+  EXPECT_EQ(pool->getNumConnections(key), 0);
+
+  EXPECT_TRUE(pool->createBidirectionalStream(key).hasError());
+  ASSERT_EQ(sockets.size(), 2);
+  makeReady(1);
+  auto stream = pool->createBidirectionalStream(key);
+  ASSERT_TRUE(stream.hasValue());
+  EXPECT_EQ(stream->socket, sockets[1]);
+}
+
+TEST_F(QuicConnectionPoolTest, RefusePeerStreams) {
+  pool->prewarm(key, 1);
+  makeReady(0);
+  EXPECT_CALL(*sockets[0], stopSending(1, _));
+  EXPECT_CALL(*sockets[0], resetStream(1, _));
+  sockets[0]->cb_->onNewBidirectionalStream(1);
+  EXPECT_CALL(*sockets[0], stopSending(3, _));
+  sockets[0]->cb_->onNewUnidirectionalStream(3);
+}
+
+TEST_F(QuicConnectionPoolTest, CloseOnDestruction) {
+  pool->prewarm(key, 2);
+  ASSERT_EQ(sockets.size(), 2);
+  for (auto& socket : sockets) {
+    EXPECT_CALL(*socket, closeNow(_));
+  }
+  pool.reset();
+}
+} // namespace test
+} // namespace quic
@@ -48,6 +48,37 @@ quic::PacketNum nextAckedPacketLen(
   return packetNum - ackBlockLen;
 }
 
+// Goes through the ack blocks that are entirely in the current buffer of the
+// cursor, decoding them straight from the buffer, and skips them all at once.
+// Returns how many blocks were decoded. currentPacketNum is updated to the
+// start of the last one.
+uint64_t decodeContiguousAckBlocks(
+    folly::io::Cursor& cursor,
+    uint64_t maxBlocks,
+    quic::PacketNum& currentPacketNum) {
+  auto bytes = cursor.peekBytes();
+  size_t consumed = 0;
+  uint64_t numBlocks = 0;
+  while (numBlocks < maxBlocks) {
+    auto gap = quic::decodeQuicInteger(bytes.subpiece(consumed));
+    if (!gap) {
+      break;
+    }
+    auto blockLen =
+        quic::decodeQuicInteger(bytes.subpiece(consumed + gap->second));
+    if (!blockLen) {
+      break;
+    }
+    consumed += gap->second + blockLen->second;
+    quic::PacketNum nextEndPacket =
+        nextAckedPacketGap(currentPacketNum, gap->first);
+    currentPacketNum = nextAckedPacketLen(nextEndPacket, blockLen->first);
+    ++numBlocks;
+  }
+  cursor.skip(consumed);
+  return numBlocks;
+}
+
 // The octet following the version contains the lengths of the two connection ID
 // fields that follow it
 constexpr size_t kConnIdLengthOctet = 1;
@@ -64,11 +95,55 @@ PingFrame decodePingFrame(folly::io::Cursor&) {
   return PingFrame();
 }
 
+AckBlocksView::Iterator& AckBlocksView::Iterator::operator++() {
+  DCHECK_GT(remaining_, 0);
+  if (--remaining_ == 0) {
+    return *this;
+  }
+  // decodeAckFrameView() already went through the blocks, they are valid.
+  auto gap = decodeQuicInteger(cursor_);
+  auto blockLen = decodeQuicInteger(cursor_);
+  DCHECK(gap && blockLen);
+  PacketNum nextEndPacket = nextAckedPacketGap(block_.startPacket, gap->first);
+  block_ = AckBlock(
+      nextAckedPacketLen(nextEndPacket, blockLen->first), nextEndPacket);
+  return *this;
+}
+
+ReadAckFrame ReadAckFrameView::toReadAckFrame() const {
+  ReadAckFrame frame;
+  frame.largestAcked = largestAcked;
+  frame.ackDelay = ackDelay;
+  frame.ackBlocks.reserve(ackBlocks.size());
+  for (const auto& block : ackBlocks) {
+    frame.ackBlocks.push_back(block);
+  }
+  frame.ecnCounts = ecnCounts;
+  return frame;
+}
+
+Buf ReadStreamFrameView::cloneData() const {
+  Buf buf;
+  auto cursor = data;
+  cursor.clone(buf, dataLength);
+  return buf;
+}
+
+ReadStreamFrame ReadStreamFrameView::toReadStreamFrame() const {
+  return ReadStreamFrame(streamId, offset, cloneData(), fin);
+}
+
 ReadAckFrame decodeAckFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
-  ReadAckFrame frame;
+  return decodeAckFrameView(cursor, header, params).toReadAckFrame();
+}
+
+ReadAckFrameView decodeAckFrameView(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
   auto largestAckedInt = decodeQuicInteger(cursor);
   if (UNLIKELY(!largestAckedInt)) {
     throw QuicTransportException(
@@ -129,11 +204,23 @@ ReadAckFrame decodeAckFrame(
   }
   PacketNum currentPacketNum =
       nextAckedPacketLen(largestAcked, firstAckBlockLen->first);
-  frame.largestAcked = largestAcked;
-  frame.ackDelay = std::chrono::microseconds(adjustedAckDelay);
-  frame.ackBlocks.emplace_back(currentPacketNum, largestAcked);
-  for (uint64_t numBlocks = 0; numBlocks < additionalAckBlocks->first;
-       ++numBlocks) {
+  ReadAckFrameView frame(
+      largestAcked,
+      std::chrono::microseconds(adjustedAckDelay),
+      AckBlocksView(
+          cursor,
+          AckBlock(currentPacketNum, largestAcked),
+          additionalAckBlocks->first));
+  // Only validate the blocks here, the view decodes them again when it is
+  // iterated.
+  uint64_t numBlocks = 0;
+  while (numBlocks < additionalAckBlocks->first) {
+    numBlocks += decodeContiguousAckBlocks(
+        cursor, additionalAckBlocks->first - numBlocks, currentPacketNum);
+    if (numBlocks == additionalAckBlocks->first) {
+      break;
+    }
+    // The next block spans two buffers, or is truncated.
     auto currentGap = decodeQuicInteger(cursor);
     if (UNLIKELY(!currentGap)) {
       throw QuicTransportException(
@@ -151,20 +238,12 @@ ReadAckFrame decodeAckFrame(
     PacketNum nextEndPacket =
         nextAckedPacketGap(currentPacketNum, currentGap->first);
     currentPacketNum = nextAckedPacketLen(nextEndPacket, blockLen->first);
-    // We don't need to add the entry when the block length is zero since we
-    // already would have processed it in the previous iteration.
-    frame.ackBlocks.emplace_back(currentPacketNum, nextEndPacket);
+    ++numBlocks;
   }
   return frame;
 }
 
-ReadAckFrame decodeAckFrameWithECN(
-    folly::io::Cursor& cursor,
-    const PacketHeader& header,
-    const CodecParameters& params) {
-  // TODO this is incomplete
-  auto readAckFrame = decodeAckFrame(cursor, header, params);
-  // TODO we simply ignore ECN blocks in ACK-ECN frames for now.
+static ECNCounts decodeECNCounts(folly::io::Cursor& cursor) {
   auto ect_0 = decodeQuicInteger(cursor);
   if (UNLIKELY(!ect_0)) {
     throw QuicTransportException(
@@ -186,6 +265,19 @@ ReadAckFrame decodeAckFrameWithECN(
         quic::TransportErrorCode::FRAME_ENCODING_ERROR,
         quic::FrameType::ACK_ECN);
   }
+  ECNCounts ecnCounts;
+  ecnCounts.ect0 = ect_0->first;
+  ecnCounts.ect1 = ect_1->first;
+  ecnCounts.ce = ect_ce->first;
+  return ecnCounts;
+}
+
+ReadAckFrame decodeAckFrameWithECN(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  auto readAckFrame = decodeAckFrame(cursor, header, params);
+  readAckFrame.ecnCounts = decodeECNCounts(cursor);
   return readAckFrame;
 }
 
@@ -305,6 +397,12 @@ ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor) {
 ReadStreamFrame decodeStreamFrame(
     folly::io::Cursor& cursor,
     StreamTypeField frameTypeField) {
+  return decodeStreamFrameView(cursor, frameTypeField).toReadStreamFrame();
+}
+
+ReadStreamFrameView decodeStreamFrameView(
+    folly::io::Cursor& cursor,
+    StreamTypeField frameTypeField) {
   auto streamId = decodeQuicInteger(cursor);
   if (!streamId) {
     throw QuicTransportException(
@@ -334,7 +432,7 @@ ReadStreamFrame decodeStreamFrame(
           quic::FrameType::STREAM);
     }
   }
-  Buf data;
+  size_t length;
   if (dataLength.hasValue()) {
     if (cursor.totalLength() < dataLength->first) {
       throw QuicTransportException(
@@ -342,15 +440,16 @@ ReadStreamFrame decodeStreamFrame(
           quic::TransportErrorCode::FRAME_ENCODING_ERROR,
           quic::FrameType::STREAM);
     }
-    // If dataLength > data's actual length then the cursor will throw.
-    cursor.clone(data, dataLength->first);
+    length = dataLength->first;
   } else {
     // Missing Data Length field doesn't mean no data. It means the rest of the
     // frame are all data.
-    cursor.clone(data, cursor.totalLength());
+    length = cursor.totalLength();
   }
-  return ReadStreamFrame(
-      folly::to<StreamId>(streamId->first), offset, std::move(data), fin);
+  ReadStreamFrameView frame(
+      folly::to<StreamId>(streamId->first), offset, fin, cursor, length);
+  cursor.skip(length);
+  return frame;
 }
 
 MaxDataFrame decodeMaxDataFrame(folly::io::Cursor& cursor) {
@@ -664,10 +763,69 @@ ExpiredStreamDataFrame decodeExpiredStreamDataFrame(folly::io::Cursor& cursor) {
       folly::to<StreamId>(streamId->first), minimumStreamOffset->first);
 }
 
-QuicFrame parseFrame(
+AckFrequencyFrame decodeAckFrequencyFrame(folly::io::Cursor& cursor) {
+  auto sequenceNumber = decodeQuicInteger(cursor);
+  if (UNLIKELY(!sequenceNumber)) {
+    throw QuicTransportException(
+        "Invalid sequence number",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto packetTolerance = decodeQuicInteger(cursor);
+  if (UNLIKELY(!packetTolerance || packetTolerance->first == 0)) {
+    throw QuicTransportException(
+        "Invalid packet tolerance",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto updateMaxAckDelay = decodeQuicInteger(cursor);
+  if (UNLIKELY(!updateMaxAckDelay)) {
+    throw QuicTransportException(
+        "Invalid update max ack delay",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  if (UNLIKELY(!cursor.canAdvance(sizeof(uint8_t)))) {
+    throw QuicTransportException(
+        "Invalid ignore order",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  auto ignoreOrder = cursor.readBE<uint8_t>();
+  if (UNLIKELY(ignoreOrder > 1)) {
+    throw QuicTransportException(
+        "Invalid ignore order",
+        quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+        quic::FrameType::ACK_FREQUENCY);
+  }
+  return AckFrequencyFrame(
+      sequenceNumber->first,
+      packetTolerance->first,
+      std::chrono::microseconds(updateMaxAckDelay->first),
+      ignoreOrder == 1);
+}
+
+ReadDatagramFrame decodeDatagramFrame(
     folly::io::Cursor& cursor,
-    const PacketHeader& header,
-    const CodecParameters& params) {
+    bool hasLength) {
+  auto frameType = hasLength ? FrameType::DATAGRAM_LEN : FrameType::DATAGRAM;
+  size_t length = cursor.totalLength();
+  if (hasLength) {
+    auto lengthInt = decodeQuicInteger(cursor);
+    if (UNLIKELY(!lengthInt || cursor.totalLength() < lengthInt->first)) {
+      throw QuicTransportException(
+          "Invalid length",
+          quic::TransportErrorCode::FRAME_ENCODING_ERROR,
+          frameType);
+    }
+    length = lengthInt->first;
+  }
+  Buf data;
+  cursor.clone(data, length);
+  return ReadDatagramFrame(std::move(data));
+}
+
+static uint64_t decodeFrameType(folly::io::Cursor& cursor) {
   if (!cursor.canAdvance(sizeof(FrameType))) {
     throw QuicTransportException(
         "Quic frame parsing: cursor cannot advance",
@@ -679,7 +837,23 @@ QuicFrame parseFrame(
     throw QuicTransportException(
         "Invalid frame-type field", TransportErrorCode::FRAME_ENCODING_ERROR);
   }
-  FrameType frameType = static_cast<FrameType>(initialByte->first);
+  return initialByte->first;
+}
+
+static QuicTransportException invalidFrameException(uint64_t frameTypeInt) {
+  return QuicTransportException(
+      folly::to<std::string>(
+          "Frame format invalid, type=", toHex<uint8_t>(frameTypeInt)),
+      TransportErrorCode::FRAME_ENCODING_ERROR,
+      static_cast<FrameType>(frameTypeInt));
+}
+
+static QuicFrame parseFrameOfType(
+    uint64_t frameTypeInt,
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params) {
+  FrameType frameType = static_cast<FrameType>(frameTypeInt);
   try {
     switch (frameType) {
       case FrameType::PADDING:
@@ -707,7 +881,7 @@ QuicFrame parseFrame(
       case FrameType::STREAM_OFF_LEN:
       case FrameType::STREAM_OFF_LEN_FIN:
         return QuicFrame(
-            decodeStreamFrame(cursor, StreamTypeField(initialByte->first)));
+            decodeStreamFrame(cursor, StreamTypeField(frameTypeInt)));
       case FrameType::MAX_DATA:
         return QuicFrame(decodeMaxDataFrame(cursor));
       case FrameType::MAX_STREAM_DATA:
@@ -736,45 +910,110 @@ QuicFrame parseFrame(
         return QuicFrame(decodeConnectionCloseFrame(cursor, params));
       case FrameType::APPLICATION_CLOSE:
         return QuicFrame(decodeApplicationCloseFrame(cursor, params));
+      case FrameType::DATAGRAM:
+      case FrameType::DATAGRAM_LEN:
+        return QuicFrame(decodeDatagramFrame(
+            cursor, frameType == FrameType::DATAGRAM_LEN));
+      case FrameType::ACK_FREQUENCY:
+        return QuicFrame(decodeAckFrequencyFrame(cursor));
       case FrameType::MIN_STREAM_DATA:
         return QuicFrame(decodeMinStreamDataFrame(cursor));
       case FrameType::EXPIRED_STREAM_DATA:
         return QuicFrame(decodeExpiredStreamDataFrame(cursor));
     }
   } catch (const std::exception&) {
-    throw QuicTransportException(
-        folly::to<std::string>(
-            "Frame format invalid, type=", toHex<uint8_t>(initialByte->first)),
-        TransportErrorCode::FRAME_ENCODING_ERROR,
-        frameType);
+    throw invalidFrameException(frameTypeInt);
   }
   throw QuicTransportException(
       folly::to<std::string>(
-          "Unknown frame, type=", toHex<uint8_t>(initialByte->first)),
+          "Unknown frame, type=", toHex<uint8_t>(frameTypeInt)),
       TransportErrorCode::FRAME_ENCODING_ERROR,
       frameType);
 }
 
-// Parse packet
-
-static std::vector<QuicFrame> framesDecodeHelper(
+QuicFrame parseFrame(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
     const CodecParameters& params) {
-  std::vector<QuicFrame> frames;
+  auto frameTypeInt = decodeFrameType(cursor);
+  return parseFrameOfType(frameTypeInt, cursor, header, params);
+}
+
+void decodeFrames(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params,
+    QuicFrameVisitor& visitor) {
   while (cursor.totalLength()) {
-    auto frame = parseFrame(cursor, header, params);
-    frames.push_back(std::move(frame));
+    auto frameTypeInt = decodeFrameType(cursor);
+    // The visitor is called outside of the try blocks, so that its own
+    // errors are not turned into frame encoding errors.
+    switch (static_cast<FrameType>(frameTypeInt)) {
+      case FrameType::ACK:
+      case FrameType::ACK_ECN: {
+        folly::Optional<ReadAckFrameView> frame;
+        try {
+          frame.emplace(decodeAckFrameView(cursor, header, params));
+          if (static_cast<FrameType>(frameTypeInt) == FrameType::ACK_ECN) {
+            frame->ecnCounts = decodeECNCounts(cursor);
+          }
+        } catch (const std::exception&) {
+          throw invalidFrameException(frameTypeInt);
+        }
+        visitor.onAckFrame(*frame);
+        break;
+      }
+      case FrameType::STREAM:
+      case FrameType::STREAM_FIN:
+      case FrameType::STREAM_LEN:
+      case FrameType::STREAM_LEN_FIN:
+      case FrameType::STREAM_OFF:
+      case FrameType::STREAM_OFF_FIN:
+      case FrameType::STREAM_OFF_LEN:
+      case FrameType::STREAM_OFF_LEN_FIN: {
+        folly::Optional<ReadStreamFrameView> frame;
+        try {
+          frame.emplace(
+              decodeStreamFrameView(cursor, StreamTypeField(frameTypeInt)));
+        } catch (const std::exception&) {
+          throw invalidFrameException(frameTypeInt);
+        }
+        visitor.onStreamFrame(*frame);
+        break;
+      }
+      default:
+        visitor.onFrame(
+            parseFrameOfType(frameTypeInt, cursor, header, params));
+    }
   }
-  return frames;
 }
 
+// Parse packet
+
+namespace {
+class FrameCollector : public QuicFrameVisitor {
+ public:
+  explicit FrameCollector(std::vector<QuicFrame>& frames) : frames_(frames) {}
+
+  void onFrame(QuicFrame&& frame) override {
+    frames_.push_back(std::move(frame));
+  }
+
+ private:
+  std::vector<QuicFrame>& frames_;
+};
+} // namespace
+
 RegularQuicPacket decodeRegularPacket(
     PacketHeader&& header,
     const CodecParameters& params,
-    folly::io::Cursor& cursor) {
+    folly::io::Cursor& cursor,
+    std::vector<QuicFrame> frames) {
   RegularQuicPacket packet(std::move(header));
-  packet.frames = framesDecodeHelper(cursor, header, params);
+  packet.frames = std::move(frames);
+  packet.frames.clear();
+  FrameCollector collector(packet.frames);
+  decodeFrames(cursor, packet.header, params, collector);
   return packet;
 }
 
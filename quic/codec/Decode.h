@@ -12,6 +12,8 @@
 #include <quic/codec/PacketNumber.h>
 #include <quic/codec/Types.h>
 
+#include <iterator>
+
 namespace quic {
 
 /**
@@ -53,11 +55,14 @@ folly::Optional<VersionNegotiationPacket> decodeVersionNegotiation(
  * The packet in the cursor must be at least 1 QUIC packet.
  * Throws with a QuicException if the data in the cursor is not a complete QUIC
  * packet or the packet could not be decoded correctly.
+ * The frames are added to frames, which is cleared first, so that the
+ * memory of the frames of an earlier packet can be reused.
  */
 RegularQuicPacket decodeRegularPacket(
     PacketHeader&& header,
     const CodecParameters& params,
-    folly::io::Cursor& cursor);
+    folly::io::Cursor& cursor,
+    std::vector<QuicFrame> frames = std::vector<QuicFrame>());
 
 /**
  * Parses a single frame from the cursor. Throws a QuicException if the frame
@@ -68,6 +73,160 @@ QuicFrame parseFrame(
     const PacketHeader& header,
     const CodecParameters& params);
 
+/**
+ * The ack blocks of an ACK frame in descending order. They are decoded from
+ * the packet buffer while iterating instead of being copied into a vector, so
+ * the view is only valid as long as the packet buffer is. The encoding is
+ * validated when the frame is decoded, iterating doesn't throw.
+ */
+class AckBlocksView {
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = AckBlock;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const AckBlock*;
+    using reference = const AckBlock&;
+
+    reference operator*() const {
+      return block_;
+    }
+
+    pointer operator->() const {
+      return &block_;
+    }
+
+    Iterator& operator++();
+
+    bool operator==(const Iterator& other) const {
+      return remaining_ == other.remaining_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class AckBlocksView;
+
+    Iterator(folly::io::Cursor cursor, AckBlock block, uint64_t remaining)
+        : cursor_(cursor), block_(block), remaining_(remaining) {}
+
+    // Points to the gap of the next block
+    folly::io::Cursor cursor_;
+    AckBlock block_;
+    // Number of blocks left, including the current one
+    uint64_t remaining_;
+  };
+
+  AckBlocksView(
+      folly::io::Cursor additionalBlocks,
+      AckBlock firstBlock,
+      uint64_t numAdditionalBlocks)
+      : additionalBlocks_(additionalBlocks),
+        firstBlock_(firstBlock),
+        numAdditionalBlocks_(numAdditionalBlocks) {}
+
+  Iterator begin() const {
+    return Iterator(additionalBlocks_, firstBlock_, numAdditionalBlocks_ + 1);
+  }
+
+  Iterator end() const {
+    return Iterator(additionalBlocks_, firstBlock_, 0);
+  }
+
+  size_t size() const {
+    return numAdditionalBlocks_ + 1;
+  }
+
+ private:
+  folly::io::Cursor additionalBlocks_;
+  AckBlock firstBlock_;
+  uint64_t numAdditionalBlocks_;
+};
+
+/**
+ * An ACK frame that borrows its blocks from the packet buffer.
+ */
+struct ReadAckFrameView {
+  PacketNum largestAcked;
+  std::chrono::microseconds ackDelay;
+  AckBlocksView ackBlocks;
+  // Only set for ACK_ECN frames.
+  folly::Optional<ECNCounts> ecnCounts;
+
+  ReadAckFrameView(
+      PacketNum largestAckedIn,
+      std::chrono::microseconds ackDelayIn,
+      AckBlocksView ackBlocksIn)
+      : largestAcked(largestAckedIn),
+        ackDelay(ackDelayIn),
+        ackBlocks(ackBlocksIn) {}
+
+  ReadAckFrame toReadAckFrame() const;
+};
+
+/**
+ * A STREAM frame whose data is still in the packet buffer.
+ */
+struct ReadStreamFrameView {
+  StreamId streamId;
+  uint64_t offset;
+  bool fin;
+  // Points to the data, only valid as long as the packet buffer is.
+  folly::io::Cursor data;
+  size_t dataLength;
+
+  ReadStreamFrameView(
+      StreamId streamIdIn,
+      uint64_t offsetIn,
+      bool finIn,
+      folly::io::Cursor dataIn,
+      size_t dataLengthIn)
+      : streamId(streamIdIn),
+        offset(offsetIn),
+        fin(finIn),
+        data(dataIn),
+        dataLength(dataLengthIn) {}
+
+  // Shares the data with the packet buffer, without copying it.
+  Buf cloneData() const;
+
+  ReadStreamFrame toReadStreamFrame() const;
+};
+
+/**
+ * Called by decodeFrames() for every frame of a packet. ACK and STREAM frames
+ * come as views on the packet buffer, the handlers that don't override them
+ * get the decoded frame in onFrame() instead.
+ */
+class QuicFrameVisitor {
+ public:
+  virtual ~QuicFrameVisitor() = default;
+
+  virtual void onFrame(QuicFrame&& frame) = 0;
+
+  virtual void onAckFrame(const ReadAckFrameView& frame) {
+    onFrame(QuicFrame(frame.toReadAckFrame()));
+  }
+
+  virtual void onStreamFrame(const ReadStreamFrameView& frame) {
+    onFrame(QuicFrame(frame.toReadStreamFrame()));
+  }
+};
+
+/**
+ * Decodes all the frames from the cursor in a single pass and hands them to
+ * the visitor in order. Throws a QuicException if a frame could not be
+ * parsed, exceptions of the visitor are passed through as is.
+ */
+void decodeFrames(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params,
+    QuicFrameVisitor& visitor);
+
 /**
  * The following functions decode frames. They throw an QuicException when error
  * occurs.
@@ -94,6 +253,15 @@ ExpiredStreamDataFrame decodeExpiredStreamDataFrame(folly::io::Cursor& cursor);
 
 MinStreamDataFrame decodeMinStreamDataFrame(folly::io::Cursor& cursor);
 
+AckFrequencyFrame decodeAckFrequencyFrame(folly::io::Cursor& cursor);
+
+/**
+ * Without a length the datagram takes the rest of the packet.
+ */
+ReadDatagramFrame decodeDatagramFrame(
+    folly::io::Cursor& cursor,
+    bool hasLength);
+
 MaxStreamsFrame decodeBiDiMaxStreamsFrame(folly::io::Cursor& cursor);
 
 MaxStreamsFrame decodeUniMaxStreamsFrame(folly::io::Cursor& cursor);
@@ -126,6 +294,11 @@ ReadAckFrame decodeAckFrame(
     const PacketHeader& header,
     const CodecParameters& params);
 
+ReadAckFrameView decodeAckFrameView(
+    folly::io::Cursor& cursor,
+    const PacketHeader& header,
+    const CodecParameters& params);
+
 ReadAckFrame decodeAckFrameWithECN(
     folly::io::Cursor& cursor,
     const PacketHeader& header,
@@ -135,6 +308,10 @@ ReadStreamFrame decodeStreamFrame(
     folly::io::Cursor& cursor,
     StreamTypeField frameTypeField);
 
+ReadStreamFrameView decodeStreamFrameView(
+    folly::io::Cursor& cursor,
+    StreamTypeField frameTypeField);
+
 ReadCryptoFrame decodeCryptoFrame(folly::io::Cursor& cursor);
 
 ReadNewTokenFrame decodeNewTokenFrame(folly::io::Cursor& cursor);
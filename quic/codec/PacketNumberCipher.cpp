@@ -36,7 +36,15 @@ void PacketNumberCipher::cipherHeader(
     folly::MutableByteRange packetNumberBytes,
     uint8_t initialByteMask,
     uint8_t /* packetNumLengthMask */) const {
-  HeaderProtectionMask headerMask = mask(sample);
+  applyCipherMask(
+      mask(sample), initialByte, packetNumberBytes, initialByteMask);
+}
+
+void PacketNumberCipher::applyCipherMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes,
+    uint8_t initialByteMask) const {
   // Mask size should be > packet number length + 1.
   DCHECK_GE(headerMask.size(), kMaxPacketNumEncodingSize + 1);
   size_t packetNumLength = parsePacketNumberLength(*initialByte.data());
@@ -46,6 +54,14 @@ void PacketNumberCipher::cipherHeader(
   }
 }
 
+void PacketNumberCipher::batchMask(
+    folly::Range<const Sample*> samples,
+    HeaderProtectionMask* masks) const {
+  for (size_t i = 0; i < samples.size(); ++i) {
+    masks[i] = mask(folly::range(samples[i]));
+  }
+}
+
 void PacketNumberCipher::decryptLongHeader(
     folly::ByteRange sample,
     folly::MutableByteRange initialByte,
@@ -94,4 +110,20 @@ void PacketNumberCipher::encryptShortHeader(
       ShortHeader::kPacketNumLenMask);
 }
 
+void PacketNumberCipher::encryptLongHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyCipherMask(
+      headerMask, initialByte, packetNumberBytes, LongHeader::kTypeBitsMask);
+}
+
+void PacketNumberCipher::encryptShortHeaderWithMask(
+    const HeaderProtectionMask& headerMask,
+    folly::MutableByteRange initialByte,
+    folly::MutableByteRange packetNumberBytes) const {
+  applyCipherMask(
+      headerMask, initialByte, packetNumberBytes, ShortHeader::kTypeBitsMask);
+}
+
 } // namespace quic
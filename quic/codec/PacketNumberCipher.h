@@ -24,6 +24,15 @@ class PacketNumberCipher {
 
   virtual HeaderProtectionMask mask(folly::ByteRange sample) const = 0;
 
+  /**
+   * Computes the masks of several samples in one go, which lets
+   * implementations pipeline the block cipher. masks should have room for
+   * samples.size() masks.
+   */
+  virtual void batchMask(
+      folly::Range<const Sample*> samples,
+      HeaderProtectionMask* masks) const;
+
   /**
    * Decrypts a long header from a sample.
    * sample should be 16 bytes long.
@@ -66,6 +75,20 @@ class PacketNumberCipher {
       folly::MutableByteRange initialByte,
       folly::MutableByteRange packetNumberBytes) const;
 
+  /**
+   * Same as encryptLongHeader and encryptShortHeader, using a mask computed
+   * beforehand from the sample, e.g. with batchMask.
+   */
+  void encryptLongHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
+  void encryptShortHeaderWithMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes) const;
+
   /**
    * Returns the length of key needed for the pn cipher.
    */
@@ -85,6 +108,13 @@ class PacketNumberCipher {
       folly::MutableByteRange packetNumberBytes,
       uint8_t initialByteMask,
       uint8_t packetNumLengthMask) const;
+
+ private:
+  void applyCipherMask(
+      const HeaderProtectionMask& headerMask,
+      folly::MutableByteRange initialByte,
+      folly::MutableByteRange packetNumberBytes,
+      uint8_t initialByteMask) const;
 };
 
 } // namespace quic
@@ -16,6 +16,7 @@
 #include <folly/io/IOBuf.h>
 
 #include <array>
+#include <cstring>
 
 namespace quic {
 constexpr uint8_t kStatelessResetTokenLength = 16;
@@ -63,8 +64,18 @@ struct ConnectionId {
 };
 
 struct ConnectionIdHash {
+  // Already well mixed, so F14 maps use it as is.
+  using folly_is_avalanching = std::true_type;
+
   size_t operator()(const ConnectionId& connId) const {
-    return folly::hash::fnv32_buf(connId.data(), connId.size());
+    // Connection ids are at most 20 bytes, so hash them as three words rather
+    // than byte by byte.
+    static_assert(kMaxConnectionIdSize <= 3 * sizeof(uint64_t), "");
+    uint64_t words[3] = {0, 0, 0};
+    memcpy(words, connId.data(), connId.size());
+    return folly::hash::hash_128_to_64(
+        folly::hash::hash_128_to_64(words[0], words[1]),
+        words[2] ^ connId.size());
   }
 };
 
@@ -8,6 +8,7 @@
 
 #include <quic/codec/QuicInteger.h>
 #include <folly/Conv.h>
+#include <folly/lang/Bits.h>
 
 namespace quic {
 
@@ -53,9 +54,93 @@ folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
   return folly::makeUnexpected(TransportErrorCode::INTERNAL_ERROR);
 }
 
+folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
+    uint64_t value,
+    uint8_t* out) {
+  if (value <= kOneByteLimit) {
+    *out = static_cast<uint8_t>(value);
+    return sizeof(uint8_t);
+  } else if (value <= kTwoByteLimit) {
+    uint16_t modified = static_cast<uint16_t>(value) | 0x4000;
+    folly::storeUnaligned(out, folly::Endian::big(modified));
+    return sizeof(modified);
+  } else if (value <= kFourByteLimit) {
+    uint32_t modified = static_cast<uint32_t>(value) | 0x80000000;
+    folly::storeUnaligned(out, folly::Endian::big(modified));
+    return sizeof(modified);
+  } else if (value <= kEightByteLimit) {
+    uint64_t modified = value | 0xC000000000000000;
+    folly::storeUnaligned(out, folly::Endian::big(modified));
+    return sizeof(modified);
+  }
+  return folly::makeUnexpected(TransportErrorCode::INTERNAL_ERROR);
+}
+
+void encodeQuicIntegerWithSize(uint64_t value, size_t size, uint8_t* out) {
+  switch (size) {
+    case 1:
+      *out = static_cast<uint8_t>(value);
+      break;
+    case 2:
+      folly::storeUnaligned(
+          out, folly::Endian::big(static_cast<uint16_t>(value | 0x4000)));
+      break;
+    case 4:
+      folly::storeUnaligned(
+          out, folly::Endian::big(static_cast<uint32_t>(value | 0x80000000)));
+      break;
+    default:
+      DCHECK_EQ(size, 8);
+      folly::storeUnaligned(
+          out, folly::Endian::big(value | 0xC000000000000000));
+      break;
+  }
+}
+
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data) {
+  if (data.empty()) {
+    return folly::none;
+  }
+  const size_t length = decodeQuicIntegerLength(data[0]);
+  if (data.size() < length) {
+    return folly::none;
+  }
+  switch (length) {
+    case 1:
+      return std::make_pair((uint64_t)(data[0] & kOneByteLimit), length);
+    case 2:
+      return std::make_pair(
+          (uint64_t)(
+              folly::Endian::big(folly::loadUnaligned<uint16_t>(data.data())) &
+              kTwoByteLimit),
+          length);
+    case 4:
+      return std::make_pair(
+          (uint64_t)(
+              folly::Endian::big(folly::loadUnaligned<uint32_t>(data.data())) &
+              kFourByteLimit),
+          length);
+    default:
+      return std::make_pair(
+          folly::Endian::big(folly::loadUnaligned<uint64_t>(data.data())) &
+              kEightByteLimit,
+          length);
+  }
+}
+
 folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost) {
+  // Fast path for an integer that is entirely in the current buffer.
+  auto bytes = cursor.peekBytes();
+  if (!bytes.empty() && decodeQuicIntegerLength(bytes[0]) <= atMost) {
+    auto result = decodeQuicInteger(bytes);
+    if (result) {
+      cursor.skip(result->second);
+      return result;
+    }
+  }
   size_t numBytes = 0;
   size_t advanceLen = 0;
   uint64_t result = 0;
@@ -29,6 +29,20 @@ folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
     uint64_t value,
     folly::io::QueueAppender& appender);
 
+/**
+ * Same as above, writing the integer to out, which needs room for 8 bytes.
+ */
+folly::Expected<size_t, TransportErrorCode> encodeQuicInteger(
+    uint64_t value,
+    uint8_t* out);
+
+/**
+ * Writes value to out in size bytes, which has to be what getQuicIntegerSize
+ * returns for it. There are no checks, for the encoders that sized and
+ * checked a whole frame already.
+ */
+void encodeQuicIntegerWithSize(uint64_t value, size_t size, uint8_t* out);
+
 /**
  * Reads an integer out of the cursor and returns a pair with the integer and
  * the numbers of bytes read, or folly::none if there are not enough bytes to
@@ -38,6 +52,14 @@ folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
     folly::io::Cursor& cursor,
     uint64_t atMost = std::numeric_limits<uint64_t>::max());
 
+/**
+ * Same as above for an integer at the start of contiguous memory, with a
+ * single unaligned load instead of a pull per byte. Returns folly::none if
+ * data is too short.
+ */
+folly::Optional<std::pair<uint64_t, size_t>> decodeQuicInteger(
+    folly::ByteRange data);
+
 /**
  * Returns the length of a quic integer given the first byte
  */
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/QuicLbCodec.h>
+
+#include <glog/logging.h>
+#include <openssl/evp.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr uint8_t kConfigIdShift = 6;
+constexpr uint8_t kLengthMask = 0x3f;
+constexpr size_t kAesBlockSize = 16;
+} // namespace
+
+namespace quic {
+
+QuicLbCodec::QuicLbCodec(const QuicLbConfig& config) : config_(config) {
+  if (config_.configId >= kQuicLbUnroutableConfigId) {
+    throw std::invalid_argument("QUIC-LB config id must be below 3");
+  }
+  if (config_.serverIdLength < 1 || config_.serverIdLength > 2) {
+    throw std::invalid_argument("QUIC-LB server id must be 1 or 2 bytes");
+  }
+  if (config_.mode != QuicLbConfig::Mode::StreamCipher) {
+    return;
+  }
+  encryptCtx_.reset(EVP_CIPHER_CTX_new());
+  if (!encryptCtx_ ||
+      EVP_EncryptInit_ex(
+          encryptCtx_.get(),
+          EVP_aes_128_ecb(),
+          nullptr,
+          config_.key.data(),
+          nullptr) != 1) {
+    throw std::runtime_error("Unable to init the QUIC-LB cipher");
+  }
+}
+
+size_t QuicLbCodec::routedOffset() const {
+  if (config_.mode == QuicLbConfig::Mode::Plaintext) {
+    return 1;
+  }
+  // The nonce is everything before the encrypted bytes.
+  return kQuicLbConnectionIdLength - config_.serverIdLength -
+      kQuicLbServerUseLength;
+}
+
+void QuicLbCodec::applyKeystream(uint8_t* connId) const {
+  std::array<uint8_t, kAesBlockSize> block{};
+  auto offset = routedOffset();
+  memcpy(block.data(), connId + 1, offset - 1);
+  std::array<uint8_t, kAesBlockSize> keystream;
+  int outLen = 0;
+  if (EVP_EncryptUpdate(
+          encryptCtx_.get(),
+          keystream.data(),
+          &outLen,
+          block.data(),
+          block.size()) != 1 ||
+      outLen != static_cast<int>(keystream.size())) {
+    throw std::runtime_error("QUIC-LB encryption error");
+  }
+  for (size_t i = offset; i < kQuicLbConnectionIdLength; ++i) {
+    connId[i] ^= keystream[i - offset];
+  }
+}
+
+folly::Optional<uint16_t> QuicLbCodec::getServerId(
+    folly::ByteRange connId) const {
+  auto info = decode(connId);
+  if (!info) {
+    return folly::none;
+  }
+  return info->serverId;
+}
+
+folly::Optional<QuicLbCodec::RoutingInfo> QuicLbCodec::decode(
+    folly::ByteRange connId) const {
+  if (connId.size() != kQuicLbConnectionIdLength ||
+      (connId[0] >> kConfigIdShift) != config_.configId) {
+    return folly::none;
+  }
+  std::array<uint8_t, kQuicLbConnectionIdLength> id;
+  memcpy(id.data(), connId.data(), id.size());
+  if (config_.mode == QuicLbConfig::Mode::StreamCipher) {
+    applyKeystream(id.data());
+  }
+  auto pos = routedOffset();
+  RoutingInfo info;
+  for (size_t i = 0; i < config_.serverIdLength; ++i) {
+    info.serverId = (info.serverId << 8) | id[pos++];
+  }
+  memcpy(info.serverUse.data(), id.data() + pos, info.serverUse.size());
+  return info;
+}
+
+void QuicLbCodec::encode(
+    const RoutingInfo& info,
+    folly::MutableByteRange connId) const {
+  CHECK_EQ(connId.size(), kQuicLbConnectionIdLength);
+  connId[0] = (config_.configId << kConfigIdShift) |
+      (config_.lengthSelfEncoded ? kQuicLbConnectionIdLength - 1
+                                 : connId[0] & kLengthMask);
+  auto pos = routedOffset();
+  for (size_t i = config_.serverIdLength; i > 0; --i) {
+    connId[pos++] = info.serverId >> (8 * (i - 1));
+  }
+  memcpy(connId.data() + pos, info.serverUse.data(), info.serverUse.size());
+  if (config_.mode == QuicLbConfig::Mode::StreamCipher) {
+    applyKeystream(connId.data());
+  }
+}
+} // namespace quic
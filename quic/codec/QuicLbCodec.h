@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/ssl/OpenSSLPtrTypes.h>
+
+#include <array>
+#include <cstdint>
+
+namespace quic {
+
+// The length of the connection ids, the one the servers read short headers
+// with.
+constexpr size_t kQuicLbConnectionIdLength = 8;
+// The bytes after the server id that only the server reads.
+constexpr size_t kQuicLbServerUseLength = 2;
+// The config rotation codepoint that no config uses, for unroutable ids.
+constexpr uint8_t kQuicLbUnroutableConfigId = 3;
+
+/**
+ * What a load balancer and the servers behind it agree on to route the
+ * packets by their connection id, as in the QUIC-LB draft.
+ */
+struct QuicLbConfig {
+  enum class Mode : uint8_t {
+    // The server id is in the clear after the first octet.
+    Plaintext,
+    // A nonce follows the first octet, and the server id and the server use
+    // bytes are XORed with AES-ECB(key, nonce padded with zeros).
+    StreamCipher,
+  };
+
+  Mode mode{Mode::Plaintext};
+  // Sent in the 2 high bits of the first octet, to rotate the configs.
+  uint8_t configId{0};
+  // 1 or 2 bytes of server id.
+  uint8_t serverIdLength{2};
+  // Whether the 6 low bits of the first octet are the length of the
+  // connection id minus one, rather than random.
+  bool lengthSelfEncoded{true};
+  // Only used by Mode::StreamCipher.
+  std::array<uint8_t, 16> key{};
+};
+
+/**
+ * Reads and writes the routing information of the connection ids of a
+ * QuicLbConfig. It only depends on folly and OpenSSL, so that load balancers
+ * can find the server of a packet without the rest of the transport.
+ *
+ * The connection ids are kQuicLbConnectionIdLength long:
+ *
+ *   Plaintext:     |CR|LEN| SERVER ID | SERVER USE | RANDOM |
+ *   Stream cipher: |CR|LEN| NONCE | ENCRYPTED SERVER ID and SERVER USE |
+ *
+ * The nonce takes the 3 or 4 bytes left by the server id and the server use
+ * bytes, shorter than the draft asks for since the ids are only 8 bytes long.
+ */
+class QuicLbCodec {
+ public:
+  struct RoutingInfo {
+    uint16_t serverId{0};
+    std::array<uint8_t, kQuicLbServerUseLength> serverUse{};
+  };
+
+  /**
+   * Throws std::invalid_argument if the config is not valid.
+   */
+  explicit QuicLbCodec(const QuicLbConfig& config);
+
+  /**
+   * The server of a connection id, none if the id isn't one of this config.
+   */
+  folly::Optional<uint16_t> getServerId(folly::ByteRange connId) const;
+
+  /**
+   * The server id and the server use bytes of a connection id, none if the
+   * id isn't one of this config.
+   */
+  folly::Optional<RoutingInfo> decode(folly::ByteRange connId) const;
+
+  /**
+   * Writes the routing information into connId, which holds
+   * kQuicLbConnectionIdLength random bytes.
+   */
+  void encode(const RoutingInfo& info, folly::MutableByteRange connId) const;
+
+  const QuicLbConfig& getConfig() const {
+    return config_;
+  }
+
+ private:
+  size_t routedOffset() const;
+
+  // XORs the server id and the server use bytes with the keystream of the
+  // nonce, which encrypts and decrypts them.
+  void applyKeystream(uint8_t* connId) const;
+
+  QuicLbConfig config_;
+  // Only set with Mode::StreamCipher.
+  folly::ssl::EvpCipherCtxUniquePtr encryptCtx_;
+};
+} // namespace quic
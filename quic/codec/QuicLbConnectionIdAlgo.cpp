@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/QuicLbConnectionIdAlgo.h>
+
+#include <folly/Random.h>
+#include <quic/QuicConstants.h>
+#include <quic/QuicException.h>
+
+namespace {
+constexpr uint8_t kProcessIdBitMask = 0x80;
+} // namespace
+
+namespace quic {
+
+static_assert(
+    kQuicLbConnectionIdLength == kDefaultConnectionIdSize,
+    "the servers read short headers with the default connection id size");
+
+QuicLbConnectionIdAlgo::QuicLbConnectionIdAlgo(const QuicLbConfig& config)
+    : codec_(config) {}
+
+bool QuicLbConnectionIdAlgo::canParse(const ConnectionId& id) const {
+  return codec_.decode(folly::range(id.data(), id.data() + id.size()))
+      .hasValue();
+}
+
+ServerConnectionIdParams QuicLbConnectionIdAlgo::parseConnectionId(
+    const ConnectionId& id) {
+  auto info = codec_.decode(folly::range(id.data(), id.data() + id.size()));
+  if (!info) {
+    throw QuicInternalException(
+        "ConnectionId is not one of the QUIC-LB config",
+        LocalErrorCode::INTERNAL_ERROR);
+  }
+  return ServerConnectionIdParams(
+      codec_.getConfig().configId,
+      info->serverId,
+      (info->serverUse[1] & kProcessIdBitMask) ? 1 : 0,
+      info->serverUse[0]);
+}
+
+ConnectionId QuicLbConnectionIdAlgo::encodeConnectionId(
+    const ServerConnectionIdParams& params) {
+  if (codec_.getConfig().serverIdLength < sizeof(params.hostId) &&
+      params.hostId >> (8 * codec_.getConfig().serverIdLength)) {
+    throw QuicInternalException(
+        "Host id does not fit in the QUIC-LB server id",
+        LocalErrorCode::INTERNAL_ERROR);
+  }
+  std::vector<uint8_t> connIdData(kQuicLbConnectionIdLength);
+  folly::Random::secureRandom(connIdData.data(), connIdData.size());
+  QuicLbCodec::RoutingInfo info;
+  info.serverId = params.hostId;
+  info.serverUse[0] = params.workerId;
+  info.serverUse[1] = (params.processId ? kProcessIdBitMask : 0) |
+      (connIdData.back() & ~kProcessIdBitMask);
+  codec_.encode(info, folly::range(connIdData));
+  return ConnectionId(std::move(connIdData));
+}
+
+} // namespace quic
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/codec/QuicLbCodec.h>
+
+namespace quic {
+
+/**
+ * Connection ids in the formats of the QUIC-LB draft, see QuicLbCodec, so
+ * that load balancers route the packets of a connection to its host from
+ * the connection id alone, even after the client migrates.
+ *
+ * The server id is the host id, which has to fit in the serverIdLength of
+ * the config. The server use bytes hold the worker id, then the process id
+ * in the high bit of the second byte, the rest of which is random:
+ *
+ *   SERVER USE: | WORKER_ID | PROCESS_ID | RANDOM (7 bits) |
+ *
+ * With Mode::StreamCipher they are encrypted along with the server id.
+ */
+class QuicLbConnectionIdAlgo : public ConnectionIdAlgo {
+ public:
+  explicit QuicLbConnectionIdAlgo(const QuicLbConfig& config);
+
+  ~QuicLbConnectionIdAlgo() override = default;
+
+  bool canParse(const ConnectionId& id) const override;
+
+  ServerConnectionIdParams parseConnectionId(const ConnectionId& id) override;
+
+  ConnectionId encodeConnectionId(
+      const ServerConnectionIdParams& params) override;
+
+ private:
+  QuicLbCodec codec_;
+};
+
+class QuicLbConnectionIdAlgoFactory : public ConnectionIdAlgoFactory {
+ public:
+  explicit QuicLbConnectionIdAlgoFactory(QuicLbConfig config)
+      : config_(std::move(config)) {}
+
+  ~QuicLbConnectionIdAlgoFactory() override = default;
+
+  std::unique_ptr<ConnectionIdAlgo> make() override {
+    return std::make_unique<QuicLbConnectionIdAlgo>(config_);
+  }
+
+ private:
+  QuicLbConfig config_;
+};
+
+} // namespace quic
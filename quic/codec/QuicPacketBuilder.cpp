@@ -9,6 +9,8 @@
 #include <quic/codec/QuicPacketBuilder.h>
 
 #include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
 #include <quic/codec/PacketNumber.h>
 
 namespace {
@@ -184,6 +186,12 @@ void RegularQuicPacketBuilder::appendBytes(
 
 void RegularQuicPacketBuilder::insert(std::unique_ptr<folly::IOBuf> buf) {
   remainingBytes_ -= buf->computeChainDataLength();
+  if (contiguousBody_) {
+    for (const auto& range : *buf) {
+      bodyAppender_.push(range.data(), range.size());
+    }
+    return;
+  }
   bodyAppender_.insert(std::move(buf));
 }
 
@@ -213,7 +221,12 @@ RegularQuicPacketBuilder::Packet RegularQuicPacketBuilder::buildPacket() && {
         packetNumberEncoding_->result,
         packetNumberEncoding_->length);
   }
-  return Packet(std::move(packet_), header_.move(), outputQueue_.move());
+  auto body = outputQueue_.move();
+  if (contiguousBody_ && body && body->computeChainDataLength() == 0) {
+    // Nothing was written to the buffer we were given.
+    body = nullptr;
+  }
+  return Packet(std::move(packet_), header_.move(), std::move(body));
 }
 
 void RegularQuicPacketBuilder::writeHeaderBytes(
@@ -280,10 +293,31 @@ void RegularQuicPacketBuilder::setCipherOverhead(uint8_t overhead) noexcept {
   cipherOverhead_ = overhead;
 }
 
+void RegularQuicPacketBuilder::setContiguousBodyBuffer(
+    std::unique_ptr<folly::IOBuf> buf) {
+  CHECK(outputQueue_.empty());
+  CHECK(!buf->isChained());
+  contiguousBody_ = true;
+  outputQueue_.append(std::move(buf));
+}
+
 QuicVersion RegularQuicPacketBuilder::getVersion() const {
   return version_;
 }
 
+Buf prependHeaderInPlace(Buf header, Buf body) {
+  auto headerLen = header->computeChainDataLength();
+  if (body->isChained() || body->isSharedOne() ||
+      body->headroom() < headerLen) {
+    header->prependChain(std::move(body));
+    return header;
+  }
+  body->prepend(headerLen);
+  folly::io::Cursor cursor(header.get());
+  cursor.pull(body->writableData(), headerLen);
+  return body;
+}
+
 StatelessResetPacketBuilder::StatelessResetPacketBuilder(
     uint16_t maxPacketSize,
     const StatelessResetToken& resetToken) {
@@ -355,6 +389,43 @@ void VersionNegotiationPacketBuilder::writeVersionNegotiationPacket(
   }
 }
 
+VersionNegotiationPacketTemplate::VersionNegotiationPacketTemplate(
+    const std::vector<QuicVersion>& versions) {
+  encodedVersions_.reserve(versions.size() * sizeof(QuicVersionType));
+  for (auto version : versions) {
+    QuicVersionType encoded =
+        folly::Endian::big(static_cast<QuicVersionType>(version));
+    auto bytes = reinterpret_cast<const uint8_t*>(&encoded);
+    encodedVersions_.insert(
+        encodedVersions_.end(), bytes, bytes + sizeof(encoded));
+  }
+}
+
+Buf VersionNegotiationPacketTemplate::buildPacket(
+    const ConnectionId& sourceConnectionId,
+    const ConnectionId& destinationConnectionId) const {
+  size_t headerLen = sizeof(uint8_t) + sizeof(QuicVersionType) +
+      sizeof(uint8_t) + destinationConnectionId.size() + sizeof(uint8_t) +
+      sourceConnectionId.size();
+  // As many versions as fit, like the builder.
+  size_t versionsLen = std::min(
+      encodedVersions_.size(),
+      (kDefaultUDPSendPacketLen - headerLen) / sizeof(QuicVersionType) *
+          sizeof(QuicVersionType));
+  auto buf = folly::IOBuf::create(headerLen + versionsLen);
+  folly::io::Appender appender(buf.get(), 0);
+  // Same packet type as VersionNegotiationPacketBuilder.
+  appender.writeBE<uint8_t>(kHeaderFormMask);
+  appender.writeBE(
+      static_cast<QuicVersionType>(QuicVersion::VERSION_NEGOTIATION));
+  appender.writeBE<uint8_t>(destinationConnectionId.size());
+  appender.push(destinationConnectionId.data(), destinationConnectionId.size());
+  appender.writeBE<uint8_t>(sourceConnectionId.size());
+  appender.push(sourceConnectionId.data(), sourceConnectionId.size());
+  appender.push(encodedVersions_.data(), versionsLen);
+  return buf;
+}
+
 uint8_t VersionNegotiationPacketBuilder::generateRandomPacketType() const {
   // TODO: change this back to generating random packet type after we rollout
   // draft-13. For now the 0 packet type will make sure that the version
@@ -70,7 +70,12 @@ class PacketBuilderInterface {
   }
 };
 
-class RegularQuicPacketBuilder : public PacketBuilderInterface {
+/**
+ * The builder of the regular packets. It is final so that the write codec and
+ * scheduler overloads that take a RegularPacketBuilderWrapper call it without
+ * virtual dispatch.
+ */
+class RegularQuicPacketBuilder final : public PacketBuilderInterface {
  public:
   ~RegularQuicPacketBuilder() override = default;
 
@@ -122,6 +127,16 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
 
   void setCipherOverhead(uint8_t overhead) noexcept;
 
+  /**
+   * Makes the builder write the whole packet body, including the inserted
+   * stream data which is copied rather than chained, into buf. buf should be
+   * empty, unshared and large enough for the packet and the cipher overhead,
+   * with enough headroom for the header, so that the encrypted packet can end
+   * up as a single contiguous buffer (see prependHeaderInPlace). Needs to be
+   * called before anything is written to the body.
+   */
+  void setContiguousBodyBuffer(std::unique_ptr<folly::IOBuf> buf);
+
   QuicVersion getVersion() const override;
 
  private:
@@ -144,8 +159,17 @@ class RegularQuicPacketBuilder : public PacketBuilderInterface {
   uint32_t cipherOverhead_{0};
   folly::Optional<PacketNumEncodingResult> packetNumberEncoding_;
   QuicVersion version_;
+  bool contiguousBody_{false};
 };
 
+/**
+ * Prepends the header to the body by copying it into the body's headroom.
+ * Returns the whole packet as one buffer if the body is a single unshared
+ * buffer with enough headroom, otherwise returns the header chained with the
+ * body.
+ */
+Buf prependHeaderInPlace(Buf header, Buf body);
+
 class VersionNegotiationPacketBuilder {
  public:
   explicit VersionNegotiationPacketBuilder(
@@ -175,6 +199,26 @@ class VersionNegotiationPacketBuilder {
   folly::io::QueueAppender appender_;
 };
 
+/**
+ * The versions of a version negotiation packet encoded once, for a server
+ * that answers many packets with the same versions. Building a packet only
+ * writes the header with the connection ids in front of a copy of the
+ * encoded versions, in a single buffer. The bytes are the same as the ones
+ * VersionNegotiationPacketBuilder writes.
+ */
+class VersionNegotiationPacketTemplate {
+ public:
+  explicit VersionNegotiationPacketTemplate(
+      const std::vector<QuicVersion>& versions);
+
+  Buf buildPacket(
+      const ConnectionId& sourceConnectionId,
+      const ConnectionId& destinationConnectionId) const;
+
+ private:
+  std::vector<uint8_t> encodedVersions_;
+};
+
 class StatelessResetPacketBuilder {
  public:
   StatelessResetPacketBuilder(
@@ -262,4 +306,85 @@ class PacketBuilderWrapper : public PacketBuilderInterface {
   PacketBuilderInterface& builder;
   uint32_t diff;
 };
+
+/**
+ * A PacketBuilderWrapper around a RegularQuicPacketBuilder. Both are final, so
+ * the code that takes a RegularPacketBuilderWrapper rather than a
+ * PacketBuilderInterface calls the builder directly for every field it writes.
+ * This is what the FrameScheduler uses for the packets it builds.
+ */
+class RegularPacketBuilderWrapper final : public PacketBuilderInterface {
+ public:
+  ~RegularPacketBuilderWrapper() override = default;
+
+  // Without a limit, the wrapper can write to the whole packet.
+  explicit RegularPacketBuilderWrapper(RegularQuicPacketBuilder& builderIn)
+      : builder(builderIn), diff(0) {}
+
+  RegularPacketBuilderWrapper(
+      RegularQuicPacketBuilder& builderIn,
+      uint32_t writableBytes)
+      : builder(builderIn),
+        diff(
+            writableBytes > builder.remainingSpaceInPkt()
+                ? 0
+                : builder.remainingSpaceInPkt() - writableBytes) {}
+
+  uint32_t remainingSpaceInPkt() const override {
+    return builder.remainingSpaceInPkt() > diff
+        ? builder.remainingSpaceInPkt() - diff
+        : 0;
+  }
+
+  void write(const QuicInteger& quicInteger) override {
+    builder.write(quicInteger);
+  }
+
+  void writeBE(uint8_t value) override {
+    builder.writeBE(value);
+  }
+
+  void writeBE(uint16_t value) override {
+    builder.writeBE(value);
+  }
+
+  void writeBE(uint64_t value) override {
+    builder.writeBE(value);
+  }
+
+  void appendBytes(PacketNum value, uint8_t byteNumber) override {
+    builder.appendBytes(value, byteNumber);
+  }
+
+  void appendBytes(
+      folly::io::QueueAppender& appender,
+      PacketNum value,
+      uint8_t byteNumber) override {
+    builder.appendBytes(appender, value, byteNumber);
+  }
+
+  void insert(std::unique_ptr<folly::IOBuf> buf) override {
+    builder.insert(std::move(buf));
+  }
+
+  void appendFrame(QuicWriteFrame frame) override {
+    builder.appendFrame(std::move(frame));
+  }
+
+  void push(const uint8_t* data, size_t len) override {
+    builder.push(data, len);
+  }
+
+  const PacketHeader& getPacketHeader() const override {
+    return builder.getPacketHeader();
+  }
+
+  QuicVersion getVersion() const override {
+    return builder.getVersion();
+  }
+
+ private:
+  RegularQuicPacketBuilder& builder;
+  uint32_t diff;
+};
 } // namespace quic
@@ -9,6 +9,7 @@
 #include <quic/codec/QuicPacketRebuilder.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/flowcontrol/QuicFlowController.h>
+#include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/SimpleFrameFunctions.h>
 
@@ -25,7 +26,7 @@ uint64_t PacketRebuilder::getHeaderBytes() const {
 
 PacketEvent PacketRebuilder::cloneOutstandingPacket(OutstandingPacket& packet) {
   // Either the packet has never been cloned before, or it's associatedEvent is
-  // still in the outstandingPacketEvents set.
+  // still outstanding in the outstandingPacketEvents table.
   DCHECK(
       !packet.associatedEvent ||
       conn_.outstandingPacketEvents.count(*packet.associatedEvent));
@@ -34,6 +35,7 @@ PacketEvent PacketRebuilder::cloneOutstandingPacket(OutstandingPacket& packet) {
     DCHECK(!conn_.outstandingPacketEvents.count(packetNum));
     packet.associatedEvent = packetNum;
     conn_.outstandingPacketEvents.insert(packetNum);
+    conn_.outstandingPacketEvents.addPacket(packetNum, packetNum);
     ++conn_.outstandingClonedPacketsCount;
   }
   return *packet.associatedEvent;
@@ -61,8 +63,20 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
             (packetHeader.getHeaderForm() == HeaderForm::Long)
             ? kDefaultAckDelayExponent
             : conn_.transportSettings.ackDelayExponent;
-        AckFrameMetaData meta(
-            ackFrame.ackBlocks, ackFrame.ackDelay, ackDelayExponent);
+        IntervalSet<PacketNum> ackBlocks;
+        for (auto it = ackFrame.ackBlocks.cbegin();
+             it != ackFrame.ackBlocks.cend();
+             ++it) {
+          ackBlocks.insert(*it);
+        }
+        AckFrameMetaData meta(ackBlocks, ackFrame.ackDelay, ackDelayExponent);
+        if (ackFrame.ecn) {
+          // The counts only grow, the current ones are as valid as the ones
+          // of the cloned packet.
+          meta.ecnCounts =
+              getAckState(conn_, packetHeader.getPacketNumberSpace())
+                  .ecnCountsReceived;
+        }
         auto ackWriteResult = writeAckFrame(meta, builder_);
         writeSuccess = ackWriteResult.hasValue();
         break;
@@ -103,10 +117,11 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
         // initialStream and handshakeStream can only be in handshake packet,
         // so they are not clonable
         CHECK(!packet.isHandshake);
-        // key update not supported
         DCHECK(
             packet.packet.header.getProtectionType() ==
-            ProtectionType::KeyPhaseZero);
+                ProtectionType::KeyPhaseZero ||
+            packet.packet.header.getProtectionType() ==
+                ProtectionType::KeyPhaseOne);
         auto& stream = conn_.cryptoState->oneRttStream;
         auto buf = cloneCryptoRetransmissionBuffer(cryptoFrame, stream);
 
@@ -149,6 +164,11 @@ folly::Optional<PacketEvent> PacketRebuilder::rebuildFromPacket(
         writeSuccess = true;
         break;
       }
+      case QuicWriteFrame::Type::WriteDatagramFrame_E: {
+        // Datagrams are not retransmitted, and their data is gone anyway.
+        writeSuccess = true;
+        break;
+      }
       case QuicWriteFrame::Type::PaddingFrame_E: {
         const PaddingFrame& paddingFrame = *frame.asPaddingFrame();
         writeSuccess = writeFrame(paddingFrame, builder_) != 0;
@@ -200,9 +220,7 @@ Buf PacketRebuilder::cloneCryptoRetransmissionBuffer(
    * lost packet.
    */
   DCHECK(frame.len) << "WriteCryptoFrame cloning: frame is empty. " << conn_;
-  auto iter = std::lower_bound(
-      stream.retransmissionBuffer.begin(),
-      stream.retransmissionBuffer.end(),
+  auto iter = stream.retransmissionBuffer.lowerBound(
       frame.offset,
       [](const auto& buffer, const auto& targetOffset) {
         return buffer.offset < targetOffset;
@@ -236,9 +254,7 @@ Buf PacketRebuilder::cloneRetransmissionBuffer(
    */
   DCHECK(stream);
   DCHECK(retransmittable(*stream));
-  auto iter = std::lower_bound(
-      stream->retransmissionBuffer.begin(),
-      stream->retransmissionBuffer.end(),
+  auto iter = stream->retransmissionBuffer.lowerBound(
       frame.offset,
       [](const auto& buffer, const auto& targetOffset) {
         return buffer.offset < targetOffset;
@@ -48,10 +48,19 @@ QuicReadCodec::tryParsingVersionNegotiation(folly::IOBufQueue& queue) {
 
 CodecResult QuicReadCodec::parseLongHeaderPacket(
     folly::IOBufQueue& queue,
-    const AckStates& ackStates) {
+    const AckStates& ackStates,
+    folly::Optional<ParsedLongHeaderInvariant> parsedInvariant) {
   folly::io::Cursor cursor(queue.front());
   auto initialByte = cursor.readBE<uint8_t>();
-  auto longHeaderInvariant = parseLongHeaderInvariant(initialByte, cursor);
+  auto longHeaderInvariant =
+      [&]() -> folly::Expected<ParsedLongHeaderInvariant, TransportErrorCode> {
+    if (parsedInvariant) {
+      DCHECK_EQ(parsedInvariant->initialByte, initialByte);
+      cursor.skip(parsedInvariant->invariantLength);
+      return std::move(*parsedInvariant);
+    }
+    return parseLongHeaderInvariant(initialByte, cursor);
+  }();
   if (!longHeaderInvariant) {
     VLOG(4) << "Dropping packet, failed to parse invariant " << connIdToHex();
     // We've failed to parse the long header, so we have no idea where this
@@ -229,13 +238,15 @@ CodecResult QuicReadCodec::parseLongHeaderPacket(
   }
 
   folly::io::Cursor packetCursor(decrypted.get());
-  return decodeRegularPacket(std::move(longHeader), params_, packetCursor);
+  return decodeRegularPacket(
+      std::move(longHeader), params_, packetCursor, takeSpareFrames());
 }
 
 CodecResult QuicReadCodec::parsePacket(
     folly::IOBufQueue& queue,
     const AckStates& ackStates,
-    size_t dstConnIdSize) {
+    size_t dstConnIdSize,
+    folly::Optional<ParsedLongHeaderInvariant> longHeaderInvariant) {
   if (queue.empty()) {
     return CodecResult(Nothing());
   }
@@ -247,10 +258,99 @@ CodecResult QuicReadCodec::parsePacket(
   uint8_t initialByte = cursor.readBE<uint8_t>();
   auto headerForm = getHeaderForm(initialByte);
   if (headerForm == HeaderForm::Long) {
-    return parseLongHeaderPacket(queue, ackStates);
+    return parseLongHeaderPacket(
+        queue, ackStates, std::move(longHeaderInvariant));
   }
   // Short header:
-  // TODO: support key phase one.
+  ShortHeaderPacket packet;
+  auto result =
+      prepareShortHeaderPacket(queue, ackStates, dstConnIdSize, packet);
+  if (result) {
+    return std::move(*result);
+  }
+  folly::IOBuf headerData = packet.headerData();
+  auto packetNum = packet.header->getPacketSequenceNum();
+  auto decryptAttempt = packet.data->isSharedOne()
+      ? packet.cipher->tryDecrypt(
+            std::move(packet.data), &headerData, packetNum)
+      : packet.cipher->tryDecryptInPlace(
+            std::move(packet.data), &headerData, packetNum);
+  return finishShortHeaderPacket(packet, std::move(decryptAttempt));
+}
+
+std::vector<folly::Optional<CodecResult>>
+QuicReadCodec::parseShortHeaderPackets(
+    std::vector<Buf>& datagrams,
+    const AckStates& ackStates,
+    size_t dstConnIdSize) {
+  std::vector<folly::Optional<CodecResult>> results(datagrams.size());
+  // Both are reserved for the whole batch so that the requests can point to
+  // the packets and their header.
+  std::vector<ShortHeaderPacket> packets;
+  packets.reserve(datagrams.size());
+  std::vector<folly::IOBuf> headers;
+  headers.reserve(datagrams.size());
+  std::vector<Aead::DecryptRequest> requests;
+  std::vector<size_t> requestIndices;
+  auto flush = [&] {
+    if (requests.empty()) {
+      return;
+    }
+    packets.back().cipher->tryDecryptBatch(folly::range(requests));
+    for (size_t i = 0; i < requests.size(); ++i) {
+      auto index = requestIndices[i];
+      results[index] = finishShortHeaderPacket(
+          packets[i], std::move(requests[i].plaintext));
+    }
+    packets.clear();
+    headers.clear();
+    requests.clear();
+    requestIndices.clear();
+  };
+  for (size_t index = 0; index < datagrams.size(); ++index) {
+    auto& datagram = datagrams[index];
+    if (!datagram || datagram->empty() ||
+        getHeaderForm(datagram->data()[0]) != HeaderForm::Short) {
+      continue;
+    }
+    DCHECK(!datagram->isChained());
+    folly::IOBufQueue queue{folly::IOBufQueue::cacheChainLength()};
+    queue.append(std::move(datagram));
+    ShortHeaderPacket packet;
+    auto result =
+        prepareShortHeaderPacket(queue, ackStates, dstConnIdSize, packet);
+    if (result) {
+      results[index] = std::move(*result);
+      continue;
+    }
+    // The first packet of the next key phase decides which ciphers the
+    // packets after it use, so it's decrypted on its own.
+    if (!requests.empty() &&
+        (packet.nextKeyPhase || packet.cipher != packets.back().cipher)) {
+      flush();
+    }
+    auto packetNum = packet.header->getPacketSequenceNum();
+    packets.push_back(std::move(packet));
+    headers.push_back(packets.back().headerData());
+    Aead::DecryptRequest request;
+    request.ciphertext = std::move(packets.back().data);
+    request.associatedData = &headers.back();
+    request.seqNum = packetNum;
+    requests.push_back(std::move(request));
+    requestIndices.push_back(index);
+    if (packets.back().nextKeyPhase) {
+      flush();
+    }
+  }
+  flush();
+  return results;
+}
+
+folly::Optional<CodecResult> QuicReadCodec::prepareShortHeaderPacket(
+    folly::IOBufQueue& queue,
+    const AckStates& ackStates,
+    size_t dstConnIdSize,
+    ShortHeaderPacket& packet) {
   if (!oneRttReadCipher_ || !oneRttHeaderCipher_) {
     VLOG(4) << nodeToString(nodeType_) << " cannot read key phase zero packet";
     VLOG(20) << "cannot read data="
@@ -277,6 +377,8 @@ CodecResult QuicReadCodec::parsePacket(
   }
   // Take it out of the queue so we can do some writing.
   auto data = queue.move();
+  folly::io::Cursor cursor(data.get());
+  cursor.skip(sizeof(uint8_t));
   folly::MutableByteRange initialByteRange(data->writableData(), 1);
   folly::MutableByteRange packetNumberByteRange(
       data->writableData() + packetNumberOffset, kMaxPacketNumEncodingSize);
@@ -294,61 +396,110 @@ CodecResult QuicReadCodec::parsePacket(
     return CodecResult(Nothing());
   }
   shortHeader->setPacketNumber(packetNum.first);
-  if (shortHeader->getProtectionType() == ProtectionType::KeyPhaseOne) {
-    VLOG(4) << nodeToString(nodeType_) << " cannot read key phase one packet "
-            << connIdToHex();
-    return CodecResult(Nothing());
+  packet.cipher = oneRttReadCipher_.get();
+  packet.nextKeyPhase = false;
+  if (shortHeader->getProtectionType() != oneRttReadPhase_) {
+    if (previousOneRttReadCipher_ && oneRttReadPhaseStart_ &&
+        packetNum.first < *oneRttReadPhaseStart_) {
+      // Sent before the last key update and reordered after it.
+      packet.cipher = previousOneRttReadCipher_.get();
+    } else if (nextOneRttReadCipher_) {
+      packet.cipher = nextOneRttReadCipher_.get();
+      packet.nextKeyPhase = true;
+    } else {
+      VLOG(4) << nodeToString(nodeType_) << " cannot read "
+              << toString(shortHeader->getProtectionType()) << " packet "
+              << connIdToHex();
+      return CodecResult(Nothing());
+    }
   }
 
   // We know that the iobuf is not chained. This means that we can safely have a
   // non-owning reference to the header without cloning the buffer. If we don't
   // clone the buffer, the buffer will not show up as shared and we can decrypt
   // in-place.
-  size_t aadLen = packetNumberOffset + packetNum.second;
-  folly::IOBuf headerData =
-      folly::IOBuf::wrapBufferAsValue(data->data(), aadLen);
-  data->trimStart(aadLen);
+  packet.aadLength = packetNumberOffset + packetNum.second;
+  data->trimStart(packet.aadLength);
 
-  Buf decrypted;
   // TODO: small optimization we can do here: only read the token if
   // decryption fails
-  folly::Optional<StatelessResetToken> token;
   auto encryptedDataLength = data->length();
   if (statelessResetToken_ &&
       encryptedDataLength > sizeof(StatelessResetToken)) {
-    token = StatelessResetToken();
+    packet.token = StatelessResetToken();
     memcpy(
-        token->data(),
+        packet.token->data(),
         data->data() + (encryptedDataLength - sizeof(StatelessResetToken)),
-        token->size());
+        packet.token->size());
   }
-  auto decryptAttempt = oneRttReadCipher_->tryDecrypt(
-      std::move(data), &headerData, packetNum.first);
+  packet.header = std::move(*shortHeader);
+  packet.data = std::move(data);
+  return folly::none;
+}
+
+CodecResult QuicReadCodec::finishShortHeaderPacket(
+    ShortHeaderPacket& packet,
+    folly::Optional<Buf> decryptAttempt) {
   if (!decryptAttempt) {
     // Can't return the data now, already consumed it to try decrypting it.
-    if (token) {
-      return StatelessReset(*token);
+    if (packet.token) {
+      return StatelessReset(*packet.token);
     }
-    auto protectionType = shortHeader->getProtectionType();
-    VLOG(10) << "Unable to decrypt packet=" << packetNum.first
-             << " protectionType=" << (int)protectionType << " "
+    VLOG(10) << "Unable to decrypt packet="
+             << packet.header->getPacketSequenceNum() << " protectionType="
+             << (int)packet.header->getProtectionType() << " "
              << connIdToHex();
     return CodecResult(Nothing());
   }
-  decrypted = std::move(*decryptAttempt);
+  if (packet.nextKeyPhase) {
+    // Only a packet that decrypts moves the codec to the next key phase, so
+    // that a flipped bit in garbage doesn't.
+    previousOneRttReadCipher_ = std::move(oneRttReadCipher_);
+    oneRttReadCipher_ = std::move(nextOneRttReadCipher_);
+    oneRttReadPhase_ = packet.header->getProtectionType();
+    oneRttReadPhaseStart_ = packet.header->getPacketSequenceNum();
+  }
+  Buf decrypted = std::move(*decryptAttempt);
   if (!decrypted) {
     // TODO better way of handling this (tests break without this)
     decrypted = folly::IOBuf::create(0);
   }
 
   folly::io::Cursor packetCursor(decrypted.get());
-  return decodeRegularPacket(std::move(*shortHeader), params_, packetCursor);
+  return decodeRegularPacket(
+      std::move(*packet.header), params_, packetCursor, takeSpareFrames());
+}
+
+void QuicReadCodec::recycleFrames(std::vector<QuicFrame> frames) {
+  if (frames.capacity() == 0 || frames.capacity() > kMaxRecycledFrames ||
+      spareFrames_.size() >= kMaxSpareFrameVectors) {
+    return;
+  }
+  frames.clear();
+  spareFrames_.push_back(std::move(frames));
+}
+
+std::vector<QuicFrame> QuicReadCodec::takeSpareFrames() {
+  if (spareFrames_.empty()) {
+    return std::vector<QuicFrame>();
+  }
+  auto frames = std::move(spareFrames_.back());
+  spareFrames_.pop_back();
+  return frames;
 }
 
 const Aead* QuicReadCodec::getOneRttReadCipher() const {
   return oneRttReadCipher_.get();
 }
 
+const Aead* QuicReadCodec::getNextOneRttReadCipher() const {
+  return nextOneRttReadCipher_.get();
+}
+
+ProtectionType QuicReadCodec::getOneRttReadPhase() const {
+  return oneRttReadPhase_;
+}
+
 const Aead* QuicReadCodec::getZeroRttReadCipher() const {
   return zeroRttReadCipher_.get();
 }
@@ -376,6 +527,11 @@ void QuicReadCodec::setOneRttReadCipher(
   oneRttReadCipher_ = std::move(oneRttReadCipher);
 }
 
+void QuicReadCodec::setNextOneRttReadCipher(
+    std::unique_ptr<Aead> nextOneRttReadCipher) {
+  nextOneRttReadCipher_ = std::move(nextOneRttReadCipher);
+}
+
 void QuicReadCodec::setZeroRttReadCipher(
     std::unique_ptr<Aead> zeroRttReadCipher) {
   if (nodeType_ == QuicNodeType::Client) {
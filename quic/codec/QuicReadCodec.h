@@ -92,10 +92,29 @@ class QuicReadCodec {
    * cipher unavailable structure. The caller can then retry when the cipher is
    * available. A client should call tryParsingVersionNegotiation
    * before the version is negotiated to detect VN.
+   *
+   * longHeaderInvariant is the invariant of the first packet in the queue if
+   * it's a long header packet and the caller already parsed it, like the
+   * server worker does to route the datagram. It isn't parsed again.
    */
   virtual CodecResult parsePacket(
       folly::IOBufQueue& queue,
       const AckStates& ackStates,
+      size_t dstConnIdSize = kDefaultConnectionIdSize,
+      folly::Optional<ParsedLongHeaderInvariant> longHeaderInvariant =
+          folly::none);
+
+  /**
+   * Parses the datagrams of a batch that start with a short header, the way
+   * parsePacket() would one after the other, and moves them out of
+   * datagrams. The payloads that the same cipher protects are decrypted
+   * together through Aead::tryDecryptBatch(). Returns the result of each
+   * datagram at its index, none for the datagrams that were left untouched
+   * because they don't start with a short header.
+   */
+  std::vector<folly::Optional<CodecResult>> parseShortHeaderPackets(
+      std::vector<Buf>& datagrams,
+      const AckStates& ackStates,
       size_t dstConnIdSize = kDefaultConnectionIdSize);
 
   /**
@@ -107,6 +126,13 @@ class QuicReadCodec {
   folly::Optional<VersionNegotiationPacket> tryParsingVersionNegotiation(
       folly::IOBufQueue& queue);
 
+  /**
+   * Gives back the frames of a parsed packet once they are processed. The
+   * memory of the vector is reused for the frames of a later packet, instead
+   * of allocating a new one for every packet that is read.
+   */
+  void recycleFrames(std::vector<QuicFrame> frames);
+
   const Aead* getOneRttReadCipher() const;
   const Aead* getZeroRttReadCipher() const;
   const Aead* getHandshakeReadCipher() const;
@@ -118,12 +144,29 @@ class QuicReadCodec {
   const PacketNumberCipher* getHandshakeHeaderCipher() const;
   const PacketNumberCipher* getZeroRttHeaderCipher() const;
 
+  const Aead* getNextOneRttReadCipher() const;
+
+  /**
+   * Key phase of the 1-rtt packets that the current 1-rtt read cipher reads.
+   */
+  ProtectionType getOneRttReadPhase() const;
+
   const folly::Optional<StatelessResetToken>& getStatelessResetToken() const;
 
   CodecParameters getCodecParameters() const;
 
   void setInitialReadCipher(std::unique_ptr<Aead> initialReadCipher);
   void setOneRttReadCipher(std::unique_ptr<Aead> oneRttReadCipher);
+
+  /**
+   * Sets the 1-rtt read cipher of the key phase after the current one. The
+   * 1-rtt packets of the other key phase are tried with it, and the first one
+   * it decrypts switches the codec to that phase: the cipher becomes the
+   * current one, and the former current one stays around for the packets
+   * reordered across the key update. Once switched, the codec needs the next
+   * cipher again before the peer can update its keys once more.
+   */
+  void setNextOneRttReadCipher(std::unique_ptr<Aead> nextOneRttReadCipher);
   void setZeroRttReadCipher(std::unique_ptr<Aead> zeroRttReadCipher);
   void setHandshakeReadCipher(std::unique_ptr<Aead> handshakeReadCipher);
 
@@ -150,12 +193,45 @@ class QuicReadCodec {
   folly::Optional<TimePoint> getHandshakeDoneTime();
 
  private:
+  // A short header packet whose header protection is removed, waiting for
+  // its payload to be decrypted.
+  struct ShortHeaderPacket {
+    folly::Optional<ShortHeader> header;
+    // The encrypted payload, the header is right before it in the buffer.
+    Buf data;
+    size_t aadLength{0};
+    const Aead* cipher{nullptr};
+    bool nextKeyPhase{false};
+    folly::Optional<StatelessResetToken> token;
+
+    folly::IOBuf headerData() const {
+      return folly::IOBuf::wrapBufferAsValue(
+          data->data() - aadLength, aadLength);
+    }
+  };
+
   CodecResult parseLongHeaderPacket(
       folly::IOBufQueue& queue,
-      const AckStates& ackStates);
+      const AckStates& ackStates,
+      folly::Optional<ParsedLongHeaderInvariant> parsedInvariant);
+
+  // Removes the header protection of the packet at the front of queue and
+  // picks the cipher of its payload. Returns the result right away when the
+  // packet can't be decrypted.
+  folly::Optional<CodecResult> prepareShortHeaderPacket(
+      folly::IOBufQueue& queue,
+      const AckStates& ackStates,
+      size_t dstConnIdSize,
+      ShortHeaderPacket& packet);
+
+  CodecResult finishShortHeaderPacket(
+      ShortHeaderPacket& packet,
+      folly::Optional<Buf> decryptAttempt);
 
   std::string connIdToHex();
 
+  std::vector<QuicFrame> takeSpareFrames();
+
   QuicNodeType nodeType_;
 
   CodecParameters params_;
@@ -166,6 +242,13 @@ class QuicReadCodec {
   std::unique_ptr<Aead> initialReadCipher_;
 
   std::unique_ptr<Aead> oneRttReadCipher_;
+  // Ciphers of the 1-rtt key phases around the current one, when the
+  // connection updates its keys.
+  std::unique_ptr<Aead> nextOneRttReadCipher_;
+  std::unique_ptr<Aead> previousOneRttReadCipher_;
+  ProtectionType oneRttReadPhase_{ProtectionType::KeyPhaseZero};
+  // First packet read in the current key phase, none before any key update.
+  folly::Optional<PacketNum> oneRttReadPhaseStart_;
   std::unique_ptr<Aead> zeroRttReadCipher_;
   std::unique_ptr<Aead> handshakeReadCipher_;
 
@@ -176,6 +259,8 @@ class QuicReadCodec {
 
   folly::Optional<StatelessResetToken> statelessResetToken_;
   folly::Optional<TimePoint> handshakeDoneTime_;
+  // Emptied frame vectors of processed packets, see recycleFrames().
+  std::vector<std::vector<QuicFrame>> spareFrames_;
 };
 
 } // namespace quic
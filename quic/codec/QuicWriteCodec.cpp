@@ -9,6 +9,7 @@
 #include <quic/codec/QuicWriteCodec.h>
 
 #include <algorithm>
+#include <array>
 
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
@@ -29,8 +30,50 @@ bool packetSpaceCheck(uint64_t limit, size_t require) {
 
 namespace quic {
 
-folly::Optional<uint64_t> writeStreamFrameHeader(
-    PacketBuilderInterface& builder,
+namespace {
+
+/**
+ * Encodes the fields of a frame that was already sized and checked against
+ * the space left in the packet into contiguous memory, so that the frame
+ * goes to the builder with a single push instead of a call per field.
+ */
+class FrameFieldsEncoder {
+ public:
+  // A frame type and three integers.
+  static constexpr size_t kMaxSize = 1 + 3 * sizeof(uint64_t);
+
+  void writeByte(uint8_t value) {
+    DCHECK_LT(len_, kMaxSize);
+    buf_[len_++] = value;
+  }
+
+  void write(uint64_t value, size_t size) {
+    DCHECK_LE(len_ + size, kMaxSize);
+    encodeQuicIntegerWithSize(value, size, buf_.data() + len_);
+    len_ += size;
+  }
+
+  template <typename BuilderType>
+  size_t flush(BuilderType& builder) const {
+    builder.push(buf_.data(), len_);
+    return len_;
+  }
+
+ private:
+  std::array<uint8_t, kMaxSize> buf_;
+  size_t len_{0};
+};
+
+constexpr size_t FrameFieldsEncoder::kMaxSize;
+
+/**
+ * The write functions that are on the path of every packet are templated on
+ * the builder, so that they don't go through PacketBuilderInterface when the
+ * builder type is final.
+ */
+template <typename BuilderType>
+folly::Optional<uint64_t> writeStreamFrameHeaderImpl(
+    BuilderType& builder,
     StreamId id,
     uint64_t offset,
     uint64_t writeBufferLen,
@@ -45,14 +88,16 @@ folly::Optional<uint64_t> writeStreamFrameHeader(
         LocalErrorCode::INTERNAL_ERROR);
   }
   StreamTypeField::Builder streamTypeBuilder;
-  QuicInteger idInt(id);
-  QuicInteger offsetInt(offset);
+  // The sizes are checked once here, the fields are encoded without checks.
+  size_t idSize = QuicInteger(id).getSize();
+  size_t offsetSize = 0;
   // First account for the things that are non-optional: frame type and stream
   // id.
-  uint64_t headerSize = sizeof(FrameType::STREAM) + idInt.getSize();
+  uint64_t headerSize = sizeof(FrameType::STREAM) + idSize;
   if (offset != 0) {
     streamTypeBuilder.setOffset();
-    headerSize += offsetInt.getSize();
+    offsetSize = QuicInteger(offset).getSize();
+    headerSize += offsetSize;
   }
   if (builder.remainingSpaceInPkt() < headerSize) {
     VLOG(4) << "No space in packet for stream header. stream=" << id
@@ -121,124 +166,113 @@ folly::Optional<uint64_t> writeStreamFrameHeader(
     streamTypeBuilder.setFin();
   }
   auto streamType = streamTypeBuilder.build();
-  builder.writeBE(streamType.fieldValue());
-  builder.write(idInt);
+  FrameFieldsEncoder encoder;
+  encoder.writeByte(streamType.fieldValue());
+  encoder.write(id, idSize);
   if (offset != 0) {
-    builder.write(offsetInt);
+    encoder.write(offset, offsetSize);
   }
   if (dataLenLen > 0) {
-    builder.write(QuicInteger(dataLen));
+    // The smallest size that fits was picked above.
+    encoder.write(dataLen, dataLenLen);
   }
+  encoder.flush(builder);
   builder.appendFrame(
       WriteStreamFrame(id, offset, dataLen, streamType.hasFin()));
   DCHECK(dataLen <= builder.remainingSpaceInPkt());
   return folly::make_optional(dataLen);
 }
 
-void writeStreamFrameData(
-    PacketBuilderInterface& builder,
-    const folly::IOBufQueue& writeBuffer,
+template <typename BuilderType>
+void writeStreamFrameDataImpl(
+    BuilderType& builder,
+    const folly::IOBuf* writeBuffer,
     uint64_t dataLen) {
   if (dataLen > 0) {
     Buf streamData;
-    folly::io::Cursor cursor(writeBuffer.front());
+    folly::io::Cursor cursor(writeBuffer);
     cursor.clone(streamData, dataLen);
     builder.insert(std::move(streamData));
   }
 }
 
-void writeStreamFrameData(
-    PacketBuilderInterface& builder,
-    Buf writeBuffer,
-    uint64_t dataLen) {
-  if (dataLen > 0) {
-    Buf streamData;
-    folly::io::Cursor cursor(writeBuffer.get());
-    cursor.clone(streamData, dataLen);
-    builder.insert(std::move(streamData));
-  }
+/**
+ * Appends the gap and length fields of block to encoded. prevStart is the
+ * start of the block above it.
+ */
+void encodeAckBlock(
+    PacketNum prevStart,
+    const Interval<PacketNum>& block,
+    std::vector<uint8_t>& encoded,
+    std::vector<uint8_t>& blockSizes) {
+  // These must be true because of the properties of the interval set.
+  CHECK_GE(prevStart, block.end + 2);
+  QuicInteger gapInt(prevStart - block.end - 2);
+  QuicInteger blockLenInt(block.end - block.start);
+  size_t offset = encoded.size();
+  size_t size = gapInt.getSize() + blockLenInt.getSize();
+  encoded.resize(offset + size);
+  offset += *encodeQuicInteger(gapInt.getValue(), encoded.data() + offset);
+  encodeQuicInteger(blockLenInt.getValue(), encoded.data() + offset);
+  blockSizes.push_back(size);
 }
 
-folly::Optional<WriteCryptoFrame>
-writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder) {
-  uint64_t spaceLeftInPkt = builder.remainingSpaceInPkt();
-  QuicInteger intFrameType(static_cast<uint8_t>(FrameType::CRYPTO_FRAME));
-  QuicInteger offsetInteger(offsetIn);
-
-  size_t lengthBytes = 2;
-  size_t cryptoFrameHeaderSize =
-      intFrameType.getSize() + offsetInteger.getSize() + lengthBytes;
-
-  if (spaceLeftInPkt <= cryptoFrameHeaderSize) {
-    VLOG(3) << "No space left in packet to write cryptoFrame header of size: "
-            << cryptoFrameHeaderSize << ", space left=" << spaceLeftInPkt;
-    return folly::none;
+/**
+ * Brings encoding up to date with ackBlocks, and makes it cover at least
+ * numBlocks blocks under the largest one when there are as many. Only the
+ * blocks added above the previous largest block are encoded, unless the
+ * encoding was invalidated.
+ */
+void updateAckBlocksEncoding(
+    const IntervalSet<PacketNum>& ackBlocks,
+    AckBlocksEncoding& encoding,
+    size_t numBlocks) {
+  auto largest = ackBlocks.crbegin();
+  // The previous largest block can only have been extended, and can only
+  // have blocks above it that were not there before.
+  size_t newBlocks = 0;
+  bool found = false;
+  if (encoding.largestBlock) {
+    for (auto it = largest; it != ackBlocks.crend() &&
+         it->start >= encoding.largestBlock->start;
+         ++it) {
+      if (it->start == encoding.largestBlock->start) {
+        found = it->end >= encoding.largestBlock->end;
+        break;
+      }
+      ++newBlocks;
+    }
   }
-  size_t spaceRemaining = spaceLeftInPkt - cryptoFrameHeaderSize;
-  size_t dataLength = data->computeChainDataLength();
-  size_t writeableData = std::min(dataLength, spaceRemaining);
-  QuicInteger lengthVarInt(writeableData);
-
-  if (lengthVarInt.getSize() > lengthBytes) {
-    throw QuicInternalException(
-        std::string("Length bytes representation"),
-        LocalErrorCode::CODEC_ERROR);
+  if (!found || ackBlocks.size() != encoding.numBlocks + newBlocks) {
+    encoding.invalidate();
+    newBlocks = 0;
   }
-  data->coalesce();
-  data->trimEnd(dataLength - writeableData);
-
-  builder.write(intFrameType);
-  builder.write(offsetInteger);
-  builder.write(lengthVarInt);
-  builder.insert(std::move(data));
-  builder.appendFrame(WriteCryptoFrame(offsetIn, lengthVarInt.getValue()));
-  return WriteCryptoFrame(offsetIn, lengthVarInt.getValue());
-}
-
-size_t fillFrameWithAckBlocks(
-    const IntervalSet<PacketNum>& ackBlocks,
-    WriteAckFrame& ackFrame,
-    uint64_t bytesLimit);
-
-size_t fillFrameWithAckBlocks(
-    const IntervalSet<PacketNum>& ackBlocks,
-    WriteAckFrame& ackFrame,
-    uint64_t bytesLimit) {
-  PacketNum currentSeqNum = ackBlocks.crbegin()->start;
-
-  // starts off with 0 which is what we assumed the initial ack block to be for
-  // the largest acked.
-  size_t numAdditionalAckBlocks = 0;
-  QuicInteger previousNumAckBlockInt(numAdditionalAckBlocks);
-
-  for (auto blockItr = ackBlocks.crbegin() + 1; blockItr != ackBlocks.crend();
-       ++blockItr) {
-    const auto& currBlock = *blockItr;
-    // These must be true because of the properties of the interval set.
-    CHECK_GE(currentSeqNum, currBlock.end + 2);
-    PacketNum gap = currentSeqNum - currBlock.end - 2;
-    PacketNum currBlockLen = currBlock.end - currBlock.start;
-
-    QuicInteger gapInt(gap);
-    QuicInteger currentBlockLenInt(currBlockLen);
-    QuicInteger numAckBlocksInt(numAdditionalAckBlocks + 1);
-    size_t additionalSize = gapInt.getSize() + currentBlockLenInt.getSize() +
-        (numAckBlocksInt.getSize() - previousNumAckBlockInt.getSize());
-    if (bytesLimit < additionalSize) {
-      break;
+  if (newBlocks > 0) {
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> blockSizes;
+    for (auto it = largest; it != largest + newBlocks; ++it) {
+      encodeAckBlock(it->start, *std::next(it), encoded, blockSizes);
     }
-    numAdditionalAckBlocks++;
-    bytesLimit -= additionalSize;
-    previousNumAckBlockInt = numAckBlocksInt;
-    currentSeqNum = currBlock.start;
-    ackFrame.ackBlocks.insert(currBlock.start, currBlock.end);
+    encoding.encoded.insert(
+        encoding.encoded.begin(), encoded.begin(), encoded.end());
+    encoding.blockSizes.insert(
+        encoding.blockSizes.begin(), blockSizes.begin(), blockSizes.end());
+  }
+  encoding.largestBlock = *largest;
+  encoding.numBlocks = ackBlocks.size();
+  numBlocks = std::min(numBlocks, ackBlocks.size() - 1);
+  for (auto it = largest + encoding.blockSizes.size();
+       encoding.blockSizes.size() < numBlocks;
+       ++it) {
+    encodeAckBlock(
+        it->start, *std::next(it), encoding.encoded, encoding.blockSizes);
   }
-  return numAdditionalAckBlocks;
 }
 
-folly::Optional<AckFrameWriteResult> writeAckFrame(
+template <typename BuilderType>
+folly::Optional<AckFrameWriteResult> writeAckFrameImpl(
     const quic::AckFrameMetaData& ackFrameMetaData,
-    PacketBuilderInterface& builder) {
+    BuilderType& builder) {
   if (ackFrameMetaData.ackBlocks.empty()) {
     return folly::none;
   }
@@ -267,17 +301,57 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
 
   // Required fields are Type, LargestAcked, AckDelay, AckBlockCount,
   // firstAckBlockLength
-  QuicInteger encodedintFrameType(static_cast<uint8_t>(FrameType::ACK));
+  const auto& ecnCounts = ackFrameMetaData.ecnCounts;
+  QuicInteger encodedintFrameType(static_cast<uint8_t>(
+      ecnCounts ? FrameType::ACK_ECN : FrameType::ACK));
   auto headerSize = encodedintFrameType.getSize() +
       largestAckedPacketInt.getSize() + ackDelayInt.getSize() +
       minAdditionalAckBlockCount.getSize() + firstAckBlockLengthInt.getSize();
+  // The ECN counts go after the ack blocks, but their space is reserved up
+  // front so that the ack blocks don't take it.
+  QuicInteger ect0Int(ecnCounts ? ecnCounts->ect0 : 0);
+  QuicInteger ect1Int(ecnCounts ? ecnCounts->ect1 : 0);
+  QuicInteger ceInt(ecnCounts ? ecnCounts->ce : 0);
+  if (ecnCounts) {
+    headerSize += ect0Int.getSize() + ect1Int.getSize() + ceInt.getSize();
+  }
   if (spaceLeft < headerSize) {
     return folly::none;
   }
   spaceLeft -= headerSize;
 
-  auto numAdditionalAckBlocks =
-      fillFrameWithAckBlocks(ackFrameMetaData.ackBlocks, ackFrame, spaceLeft);
+  // Only the blocks that the cap allows and that can fit are encoded, every
+  // block takes at least 2 bytes.
+  const auto& ackBlocks = ackFrameMetaData.ackBlocks;
+  size_t maxAdditionalAckBlocks = std::min<uint64_t>(
+      std::max<uint64_t>(ackFrameMetaData.maxAckBlocks, 1) - 1,
+      ackBlocks.size() - 1);
+  AckBlocksEncoding localEncoding;
+  auto& encoding =
+      ackFrameMetaData.encoding ? *ackFrameMetaData.encoding : localEncoding;
+  updateAckBlocksEncoding(
+      ackBlocks,
+      encoding,
+      std::min<uint64_t>(maxAdditionalAckBlocks, spaceLeft / 2));
+
+  size_t numAdditionalAckBlocks = 0;
+  size_t encodedLength = 0;
+  QuicInteger previousNumAckBlockInt(numAdditionalAckBlocks);
+  size_t numEncodedBlocks =
+      std::min(maxAdditionalAckBlocks, encoding.blockSizes.size());
+  while (numAdditionalAckBlocks < numEncodedBlocks) {
+    QuicInteger numAckBlocksInt(numAdditionalAckBlocks + 1);
+    size_t blockSize = encoding.blockSizes[numAdditionalAckBlocks];
+    size_t additionalSize = blockSize +
+        (numAckBlocksInt.getSize() - previousNumAckBlockInt.getSize());
+    if (spaceLeft < additionalSize) {
+      break;
+    }
+    numAdditionalAckBlocks++;
+    spaceLeft -= additionalSize;
+    encodedLength += blockSize;
+    previousNumAckBlockInt = numAckBlocksInt;
+  }
 
   QuicInteger numAdditionalAckBlocksInt(numAdditionalAckBlocks);
   builder.write(encodedintFrameType);
@@ -285,31 +359,163 @@ folly::Optional<AckFrameWriteResult> writeAckFrame(
   builder.write(ackDelayInt);
   builder.write(numAdditionalAckBlocksInt);
   builder.write(firstAckBlockLengthInt);
-
-  PacketNum currentSeqNum = ackFrameMetaData.ackBlocks.back().start;
-  for (auto it = ackFrame.ackBlocks.crbegin(); it != ackFrame.ackBlocks.crend();
-       ++it) {
-    CHECK_GE(currentSeqNum, it->end + 2);
-    PacketNum gap = currentSeqNum - it->end - 2;
-    PacketNum currBlockLen = it->end - it->start;
-    QuicInteger gapInt(gap);
-    QuicInteger currentBlockLenInt(currBlockLen);
-    builder.write(gapInt);
-    builder.write(currentBlockLenInt);
-    currentSeqNum = it->start;
-  }
-  // also the largest ack block since we already accounted for the space to
-  // write to it.
-  ackFrame.ackBlocks.insert(
-      ackFrameMetaData.ackBlocks.back().start,
-      ackFrameMetaData.ackBlocks.back().end);
+  if (encodedLength > 0) {
+    builder.push(encoding.encoded.data(), encodedLength);
+  }
+  if (ecnCounts) {
+    builder.write(ect0Int);
+    builder.write(ect1Int);
+    builder.write(ceInt);
+  }
+  // The written blocks, the largest one included, smallest first so that
+  // they are appended.
+  auto blockItr = ackBlocks.crbegin() + numAdditionalAckBlocks + 1;
+  while (blockItr != ackBlocks.crbegin()) {
+    --blockItr;
+    ackFrame.ackBlocks.insert(blockItr->start, blockItr->end);
+  }
+  // Keep the encoding bounded by the cap rather than by the ack history.
+  if (encoding.blockSizes.size() > maxAdditionalAckBlocks) {
+    size_t keptLength = 0;
+    for (size_t i = 0; i < maxAdditionalAckBlocks; ++i) {
+      keptLength += encoding.blockSizes[i];
+    }
+    encoding.blockSizes.resize(maxAdditionalAckBlocks);
+    encoding.encoded.resize(keptLength);
+  }
   ackFrame.ackDelay = ackFrameMetaData.ackDelay;
+  ackFrame.ecn = ecnCounts.hasValue();
   builder.appendFrame(std::move(ackFrame));
   return AckFrameWriteResult(
       beginningSpace - builder.remainingSpaceInPkt(),
       1 + numAdditionalAckBlocks);
 }
 
+} // namespace
+
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    PacketBuilderInterface& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin) {
+  return writeStreamFrameHeaderImpl(
+      builder, id, offset, writeBufferLen, flowControlLen, fin);
+}
+
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    RegularPacketBuilderWrapper& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin) {
+  return writeStreamFrameHeaderImpl(
+      builder, id, offset, writeBufferLen, flowControlLen, fin);
+}
+
+void writeStreamFrameData(
+    PacketBuilderInterface& builder,
+    const folly::IOBufQueue& writeBuffer,
+    uint64_t dataLen) {
+  writeStreamFrameDataImpl(builder, writeBuffer.front(), dataLen);
+}
+
+void writeStreamFrameData(
+    RegularPacketBuilderWrapper& builder,
+    const folly::IOBufQueue& writeBuffer,
+    uint64_t dataLen) {
+  writeStreamFrameDataImpl(builder, writeBuffer.front(), dataLen);
+}
+
+void writeStreamFrameData(
+    PacketBuilderInterface& builder,
+    Buf writeBuffer,
+    uint64_t dataLen) {
+  writeStreamFrameDataImpl(builder, writeBuffer.get(), dataLen);
+}
+
+void writeStreamFrameData(
+    RegularPacketBuilderWrapper& builder,
+    Buf writeBuffer,
+    uint64_t dataLen) {
+  writeStreamFrameDataImpl(builder, writeBuffer.get(), dataLen);
+}
+
+size_t writeDatagramFrame(
+    const folly::IOBuf& data,
+    PacketBuilderInterface& builder) {
+  auto dataLen = data.computeChainDataLength();
+  QuicInteger frameType(static_cast<uint8_t>(FrameType::DATAGRAM_LEN));
+  QuicInteger length(dataLen);
+  auto datagramFrameSize = frameType.getSize() + length.getSize() + dataLen;
+  if (!packetSpaceCheck(builder.remainingSpaceInPkt(), datagramFrameSize)) {
+    return size_t(0);
+  }
+  builder.write(frameType);
+  builder.write(length);
+  if (dataLen > 0) {
+    builder.insert(data.clone());
+  }
+  builder.appendFrame(WriteDatagramFrame(dataLen));
+  return datagramFrameSize;
+}
+
+folly::Optional<AckFrameWriteResult> writeAckFrame(
+    const quic::AckFrameMetaData& ackFrameMetaData,
+    PacketBuilderInterface& builder) {
+  return writeAckFrameImpl(ackFrameMetaData, builder);
+}
+
+folly::Optional<AckFrameWriteResult> writeAckFrame(
+    const quic::AckFrameMetaData& ackFrameMetaData,
+    RegularPacketBuilderWrapper& builder) {
+  return writeAckFrameImpl(ackFrameMetaData, builder);
+}
+
+folly::Optional<WriteCryptoFrame>
+writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder) {
+  uint64_t spaceLeftInPkt = builder.remainingSpaceInPkt();
+  QuicInteger intFrameType(static_cast<uint8_t>(FrameType::CRYPTO_FRAME));
+  QuicInteger offsetInteger(offsetIn);
+
+  size_t lengthBytes = 2;
+  size_t cryptoFrameHeaderSize =
+      intFrameType.getSize() + offsetInteger.getSize() + lengthBytes;
+
+  if (spaceLeftInPkt <= cryptoFrameHeaderSize) {
+    VLOG(3) << "No space left in packet to write cryptoFrame header of size: "
+            << cryptoFrameHeaderSize << ", space left=" << spaceLeftInPkt;
+    return folly::none;
+  }
+  size_t spaceRemaining = spaceLeftInPkt - cryptoFrameHeaderSize;
+  size_t dataLength = data->computeChainDataLength();
+  size_t writeableData = std::min(dataLength, spaceRemaining);
+  QuicInteger lengthVarInt(writeableData);
+
+  if (lengthVarInt.getSize() > lengthBytes) {
+    throw QuicInternalException(
+        std::string("Length bytes representation"),
+        LocalErrorCode::CODEC_ERROR);
+  }
+  // The data can be a chain, like a flight whose certificate is shared with
+  // other connections, keep it one instead of copying it to trim it.
+  if (writeableData < dataLength) {
+    Buf trimmed;
+    folly::io::Cursor cursor(data.get());
+    cursor.clone(trimmed, writeableData);
+    data = std::move(trimmed);
+  }
+
+  builder.write(intFrameType);
+  builder.write(offsetInteger);
+  builder.write(lengthVarInt);
+  builder.insert(std::move(data));
+  builder.appendFrame(WriteCryptoFrame(offsetIn, lengthVarInt.getValue()));
+  return WriteCryptoFrame(offsetIn, lengthVarInt.getValue());
+}
+
 size_t writeSimpleFrame(
     QuicSimpleFrame&& frame,
     PacketBuilderInterface& builder) {
@@ -486,6 +692,46 @@ size_t writeSimpleFrame(
       // no space left in packet
       return size_t(0);
     }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& ackFrequencyFrame = *frame.asAckFrequencyFrame();
+      QuicInteger frameType(static_cast<uint8_t>(FrameType::ACK_FREQUENCY));
+      QuicInteger sequenceNumber(ackFrequencyFrame.sequenceNumber);
+      QuicInteger packetTolerance(ackFrequencyFrame.packetTolerance);
+      QuicInteger updateMaxAckDelay(
+          ackFrequencyFrame.updateMaxAckDelay.count());
+      auto ackFrequencyFrameSize = frameType.getSize() +
+          sequenceNumber.getSize() + packetTolerance.getSize() +
+          updateMaxAckDelay.getSize() + sizeof(uint8_t);
+      if (packetSpaceCheck(spaceLeft, ackFrequencyFrameSize)) {
+        builder.write(frameType);
+        builder.write(sequenceNumber);
+        builder.write(packetTolerance);
+        builder.write(updateMaxAckDelay);
+        builder.writeBE(static_cast<uint8_t>(ackFrequencyFrame.ignoreOrder));
+        builder.appendFrame(QuicSimpleFrame(ackFrequencyFrame));
+        return ackFrequencyFrameSize;
+      }
+      // no space left in packet
+      return size_t(0);
+    }
+    case QuicSimpleFrame::Type::NewTokenFrame_E: {
+      const NewTokenFrame& newTokenFrame = *frame.asNewTokenFrame();
+      QuicInteger frameType(static_cast<uint8_t>(FrameType::NEW_TOKEN));
+      QuicInteger tokenLength(newTokenFrame.token.size());
+      auto newTokenFrameSize = frameType.getSize() + tokenLength.getSize() +
+          newTokenFrame.token.size();
+      if (packetSpaceCheck(spaceLeft, newTokenFrameSize)) {
+        builder.write(frameType);
+        builder.write(tokenLength);
+        builder.push(
+            (const uint8_t*)newTokenFrame.token.data(),
+            newTokenFrame.token.size());
+        builder.appendFrame(QuicSimpleFrame(newTokenFrame));
+        return newTokenFrameSize;
+      }
+      // no space left in packet
+      return size_t(0);
+    }
   }
   folly::assume_unreachable();
 }
@@ -689,7 +935,7 @@ size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder) {
       return writeSimpleFrame(std::move(*frame.asQuicSimpleFrame()), builder);
     }
     default: {
-      // TODO add support for: RETIRE_CONNECTION_ID and NEW_TOKEN frames
+      // TODO add support for: RETIRE_CONNECTION_ID frames
       auto errorStr = folly::to<std::string>(
           "Unknown / unsupported frame type received at ", __func__);
       VLOG(2) << errorStr;
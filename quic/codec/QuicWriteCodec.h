@@ -11,6 +11,7 @@
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/Types.h>
 #include <quic/common/IntervalSet.h>
+#include <quic/state/AckStates.h>
 #include <chrono>
 
 namespace quic {
@@ -22,6 +23,14 @@ struct AckFrameMetaData {
   std::chrono::microseconds ackDelay;
   // The ack delay exponent to use.
   uint8_t ackDelayExponent;
+  // The ECN counts to send in an ACK_ECN frame, a plain ACK frame is written
+  // when they are not set.
+  folly::Optional<ECNCounts> ecnCounts;
+  // Max number of ack blocks to write, the largest one included.
+  uint64_t maxAckBlocks{std::numeric_limits<uint64_t>::max()};
+  // The encoding of ackBlocks from the previous ack frame written, which is
+  // reused and updated. The blocks are encoded from scratch when not set.
+  AckBlocksEncoding* encoding{nullptr};
 
   AckFrameMetaData(
       const IntervalSet<PacketNum>& acksIn,
@@ -59,6 +68,15 @@ size_t writeSimpleFrame(
  */
 size_t writeFrame(QuicWriteFrame&& frame, PacketBuilderInterface& builder);
 
+/**
+ * Write a DATAGRAM frame with its length into builder. The data is shared
+ * with the builder, not copied. Returns the bytes written, 0 if the whole
+ * frame doesn't fit.
+ */
+size_t writeDatagramFrame(
+    const folly::IOBuf& data,
+    PacketBuilderInterface& builder);
+
 /**
  * Write a complete stream frame header into builder
  * This writes the stream frame header into the parameter builder and returns
@@ -74,6 +92,17 @@ folly::Optional<uint64_t> writeStreamFrameHeader(
     uint64_t flowControlLen,
     bool fin);
 
+/**
+ * Same as above, without virtual calls into the builder.
+ */
+folly::Optional<uint64_t> writeStreamFrameHeader(
+    RegularPacketBuilderWrapper& builder,
+    StreamId id,
+    uint64_t offset,
+    uint64_t writeBufferLen,
+    uint64_t flowControlLen,
+    bool fin);
+
 /**
  * Write stream frama data into builder
  * This writes dataLen worth of bytes from the parameter writeBuffer into the
@@ -85,6 +114,11 @@ void writeStreamFrameData(
     const folly::IOBufQueue& writeBuffer,
     uint64_t dataLen);
 
+void writeStreamFrameData(
+    RegularPacketBuilderWrapper& builder,
+    const folly::IOBufQueue& writeBuffer,
+    uint64_t dataLen);
+
 /**
  * Write stream frama data into builder
  * This writes dataLen worth of bytes from the parameter writeBuffer into the
@@ -96,6 +130,11 @@ void writeStreamFrameData(
     Buf writeBuffer,
     uint64_t dataLen);
 
+void writeStreamFrameData(
+    RegularPacketBuilderWrapper& builder,
+    Buf writeBuffer,
+    uint64_t dataLen);
+
 /**
  * Write a CryptoFrame into builder. The builder may not be able to accept all
  * the bytes that are supplied to writeCryptoFrame.
@@ -122,6 +161,10 @@ writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder);
  * of the packet sequence numbers. Exception will be thrown if they are not
  * sorted.
  *
+ * At most ackFrameMetaData.maxAckBlocks blocks are written. When
+ * ackFrameMetaData.encoding is set, only the blocks that changed since it was
+ * last updated are encoded.
+ *
  * Return: A AckFrameWriteResult to indicate how many bytes and ack blocks are
  * written to the appender. Returns an empty optional if an ack block could not
  * be written.
@@ -129,4 +172,11 @@ writeCryptoFrame(uint64_t offsetIn, Buf data, PacketBuilderInterface& builder);
 folly::Optional<AckFrameWriteResult> writeAckFrame(
     const AckFrameMetaData& ackFrameMetaData,
     PacketBuilderInterface& builder);
+
+/**
+ * Same as above, without virtual calls into the builder.
+ */
+folly::Optional<AckFrameWriteResult> writeAckFrame(
+    const AckFrameMetaData& ackFrameMetaData,
+    RegularPacketBuilderWrapper& builder);
 } // namespace quic
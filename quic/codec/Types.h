@@ -66,6 +66,18 @@ struct AckBlock {
       : startPacket(start), endPacket(end) {}
 };
 
+// Number of packets received with each ECN codepoint, which ACK_ECN frames
+// carry after the ack blocks.
+struct ECNCounts {
+  uint64_t ect0{0};
+  uint64_t ect1{0};
+  uint64_t ce{0};
+
+  bool empty() const {
+    return ect0 == 0 && ect1 == 0 && ce == 0;
+  }
+};
+
 /**
  0                   1                   2                   3
  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -92,6 +104,8 @@ struct ReadAckFrame {
   // Should have at least 1 block.
   // These are ordered in descending order by start packet.
   std::vector<AckBlock> ackBlocks;
+  // Only set for ACK_ECN frames.
+  folly::Optional<ECNCounts> ecnCounts;
 
   bool operator==(const ReadAckFrame& /*rhs*/) const {
     // Can't compare ackBlocks, function is just here to appease compiler.
@@ -99,10 +113,23 @@ struct ReadAckFrame {
   }
 };
 
+/**
+ * The container of the ack blocks of a written ack frame. Most ack frames
+ * have a single block, and since every frame of an outstanding packet takes
+ * the size of the largest frame type, only that one block is inline.
+ */
+template <typename I, typename = std::allocator<I>>
+using WriteAckBlocksVector = folly::small_vector<I, 1>;
+
+using WriteAckBlocks = IntervalSet<PacketNum, 1, WriteAckBlocksVector>;
+
 struct WriteAckFrame {
-  IntervalSet<PacketNum> ackBlocks;
+  WriteAckBlocks ackBlocks;
   // Delay in sending ack from time that packet was received.
   std::chrono::microseconds ackDelay{0us};
+  // Whether it was written as an ACK_ECN frame. The counts aren't kept, a
+  // clone sends the current ones.
+  bool ecn{false};
 
   bool operator==(const WriteAckFrame& /*rhs*/) const {
     // Can't compare ackBlocks, function is just here to appease compiler.
@@ -196,6 +223,48 @@ struct WriteCryptoFrame {
   }
 };
 
+// DATAGRAM frames are not retransmitted, so the written frame only keeps
+// the length of the data. The data goes straight from the datagram queue of
+// the connection into the packet.
+struct ReadDatagramFrame {
+  Buf data;
+
+  explicit ReadDatagramFrame(Buf dataIn) : data(std::move(dataIn)) {}
+
+  // Stuff stored in a variant type needs to be copyable.
+  ReadDatagramFrame(const ReadDatagramFrame& other) {
+    if (other.data) {
+      data = other.data->clone();
+    }
+  }
+
+  ReadDatagramFrame(ReadDatagramFrame&& other) noexcept = default;
+
+  ReadDatagramFrame& operator=(const ReadDatagramFrame& other) {
+    if (other.data) {
+      data = other.data->clone();
+    }
+    return *this;
+  }
+
+  ReadDatagramFrame& operator=(ReadDatagramFrame&& other) = default;
+
+  bool operator==(const ReadDatagramFrame& other) const {
+    folly::IOBufEqualTo eq;
+    return eq(data, other.data);
+  }
+};
+
+struct WriteDatagramFrame {
+  uint64_t len;
+
+  explicit WriteDatagramFrame(uint64_t lenIn) : len(lenIn) {}
+
+  bool operator==(const WriteDatagramFrame& rhs) const {
+    return len == rhs.len;
+  }
+};
+
 struct ReadNewTokenFrame {
   Buf token;
 
@@ -223,6 +292,17 @@ struct ReadNewTokenFrame {
   }
 };
 
+// The NEW_TOKEN frame the server writes, it is read as a ReadNewTokenFrame.
+struct NewTokenFrame {
+  std::string token;
+
+  explicit NewTokenFrame(std::string tokenIn) : token(std::move(tokenIn)) {}
+
+  bool operator==(const NewTokenFrame& rhs) const {
+    return token == rhs.token;
+  }
+};
+
 /**
  The structure of the stream frame used for writes.
  0                   1                   2                   3
@@ -383,6 +463,35 @@ struct ExpiredStreamDataFrame {
   }
 };
 
+// The AckFrequencyFrame is used by a sender to ask the receiver for fewer
+// acks: one every packetTolerance ack-eliciting packets, or after
+// updateMaxAckDelay. With ignoreOrder set, out of order packets don't cause
+// an immediate ack either. Only the frame with the largest sequence number
+// is applied.
+struct AckFrequencyFrame {
+  uint64_t sequenceNumber;
+  uint64_t packetTolerance;
+  std::chrono::microseconds updateMaxAckDelay;
+  bool ignoreOrder;
+
+  AckFrequencyFrame(
+      uint64_t sequenceNumberIn,
+      uint64_t packetToleranceIn,
+      std::chrono::microseconds updateMaxAckDelayIn,
+      bool ignoreOrderIn)
+      : sequenceNumber(sequenceNumberIn),
+        packetTolerance(packetToleranceIn),
+        updateMaxAckDelay(updateMaxAckDelayIn),
+        ignoreOrder(ignoreOrderIn) {}
+
+  bool operator==(const AckFrequencyFrame& rhs) const {
+    return sequenceNumber == rhs.sequenceNumber &&
+        packetTolerance == rhs.packetTolerance &&
+        updateMaxAckDelay == rhs.updateMaxAckDelay &&
+        ignoreOrder == rhs.ignoreOrder;
+  }
+};
+
 struct MaxStreamsFrame {
   // A count of the cumulative number of streams
   uint64_t maxStreams;
@@ -568,6 +677,8 @@ struct StatelessReset {
   F(NewConnectionIdFrame, __VA_ARGS__)    \
   F(MaxStreamsFrame, __VA_ARGS__)         \
   F(RetireConnectionIdFrame, __VA_ARGS__) \
+  F(AckFrequencyFrame, __VA_ARGS__)       \
+  F(NewTokenFrame, __VA_ARGS__)           \
   F(PingFrame, __VA_ARGS__)
 
 DECLARE_VARIANT_TYPE(QuicSimpleFrame, QUIC_SIMPLE_FRAME)
@@ -586,6 +697,7 @@ DECLARE_VARIANT_TYPE(QuicSimpleFrame, QUIC_SIMPLE_FRAME)
   F(ReadStreamFrame, __VA_ARGS__)        \
   F(ReadCryptoFrame, __VA_ARGS__)        \
   F(ReadNewTokenFrame, __VA_ARGS__)      \
+  F(ReadDatagramFrame, __VA_ARGS__)      \
   F(QuicSimpleFrame, __VA_ARGS__)        \
   F(NoopFrame, __VA_ARGS__)
 
@@ -604,6 +716,7 @@ DECLARE_VARIANT_TYPE(QuicFrame, QUIC_FRAME)
   F(WriteAckFrame, __VA_ARGS__)          \
   F(WriteStreamFrame, __VA_ARGS__)       \
   F(WriteCryptoFrame, __VA_ARGS__)       \
+  F(WriteDatagramFrame, __VA_ARGS__)     \
   F(QuicSimpleFrame, __VA_ARGS__)        \
   F(NoopFrame, __VA_ARGS__)
 
@@ -697,5 +697,199 @@ TEST_F(DecodeTest, DecodeExpiredStreamDataFrame) {
   EXPECT_EQ(result.minimumStreamOffset, 100);
 }
 
+std::unique_ptr<folly::IOBuf> createAckFrequencyFrame(
+    uint64_t packetTolerance,
+    uint8_t ignoreOrder) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(1).encode(wcursor);
+  QuicInteger(packetTolerance).encode(wcursor);
+  QuicInteger(5000).encode(wcursor);
+  wcursor.writeBE<uint8_t>(ignoreOrder);
+  return bufQueue.move();
+}
+
+TEST_F(DecodeTest, DecodeAckFrequencyFrame) {
+  auto ackFrequencyFrame = createAckFrequencyFrame(20, 1);
+  folly::io::Cursor cursor(ackFrequencyFrame.get());
+  auto result = decodeAckFrequencyFrame(cursor);
+  EXPECT_EQ(result.sequenceNumber, 1);
+  EXPECT_EQ(result.packetTolerance, 20);
+  EXPECT_EQ(result.updateMaxAckDelay, std::chrono::microseconds(5000));
+  EXPECT_TRUE(result.ignoreOrder);
+  EXPECT_TRUE(cursor.isAtEnd());
+
+  auto noTolerance = createAckFrequencyFrame(0, 0);
+  folly::io::Cursor cursor0(noTolerance.get());
+  EXPECT_THROW(decodeAckFrequencyFrame(cursor0), QuicTransportException);
+
+  auto badIgnoreOrder = createAckFrequencyFrame(20, 2);
+  folly::io::Cursor cursor1(badIgnoreOrder.get());
+  EXPECT_THROW(decodeAckFrequencyFrame(cursor1), QuicTransportException);
+
+  ackFrequencyFrame->trimEnd(1);
+  folly::io::Cursor cursor2(ackFrequencyFrame.get());
+  EXPECT_THROW(decodeAckFrequencyFrame(cursor2), QuicTransportException);
+}
+
+TEST_F(DecodeTest, DecodeDatagramFrame) {
+  folly::IOBufQueue bufQueue;
+  folly::io::QueueAppender wcursor(&bufQueue, 10);
+  QuicInteger(5).encode(wcursor);
+  wcursor.push(folly::StringPiece("hello"));
+  wcursor.push(folly::StringPiece("rest"));
+  auto buf = bufQueue.move();
+
+  folly::io::Cursor cursor(buf.get());
+  auto withLength = decodeDatagramFrame(cursor, true);
+  EXPECT_EQ("hello", withLength.data->moveToFbString().toStdString());
+  // Without a length the frame runs to the end of the packet.
+  auto withoutLength = decodeDatagramFrame(cursor, false);
+  EXPECT_EQ("rest", withoutLength.data->moveToFbString().toStdString());
+  EXPECT_TRUE(cursor.isAtEnd());
+
+  folly::IOBufQueue badQueue;
+  folly::io::QueueAppender badCursor(&badQueue, 10);
+  QuicInteger(10).encode(badCursor);
+  badCursor.push(folly::StringPiece("hello"));
+  auto badBuf = badQueue.move();
+  folly::io::Cursor cursor1(badBuf.get());
+  EXPECT_THROW(decodeDatagramFrame(cursor1, true), QuicTransportException);
+}
+
+TEST_F(DecodeTest, AckFrameView) {
+  std::vector<NormalizedAckBlock> ackBlocks;
+  ackBlocks.emplace_back(QuicInteger(10), QuicInteger(10));
+  ackBlocks.emplace_back(QuicInteger(0), QuicInteger(0));
+  auto result = createAckFrame(
+      QuicInteger(1000),
+      QuicInteger(100),
+      QuicInteger(ackBlocks.size()),
+      QuicInteger(10),
+      ackBlocks);
+  folly::io::Cursor cursor(result.get());
+  auto frame = decodeAckFrameView(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  EXPECT_TRUE(cursor.isAtEnd());
+  EXPECT_EQ(1000, frame.largestAcked);
+  EXPECT_EQ(100 << kDefaultAckDelayExponent, frame.ackDelay.count());
+  ASSERT_EQ(3, frame.ackBlocks.size());
+  std::vector<std::pair<PacketNum, PacketNum>> blocks;
+  for (const auto& block : frame.ackBlocks) {
+    blocks.emplace_back(block.startPacket, block.endPacket);
+  }
+  std::vector<std::pair<PacketNum, PacketNum>> expected = {
+      {990, 1000}, {968, 978}, {966, 966}};
+  EXPECT_EQ(expected, blocks);
+
+  auto ackFrame = frame.toReadAckFrame();
+  ASSERT_EQ(3, ackFrame.ackBlocks.size());
+  EXPECT_EQ(968, ackFrame.ackBlocks[1].startPacket);
+  EXPECT_EQ(978, ackFrame.ackBlocks[1].endPacket);
+}
+
+TEST_F(DecodeTest, AckFrameBlocksAcrossBuffers) {
+  std::vector<NormalizedAckBlock> ackBlocks;
+  ackBlocks.emplace_back(QuicInteger(10), QuicInteger(10));
+  ackBlocks.emplace_back(QuicInteger(300), QuicInteger(20000));
+  ackBlocks.emplace_back(QuicInteger(0), QuicInteger(0));
+  auto result = createAckFrame(
+      QuicInteger(100000),
+      QuicInteger(100),
+      QuicInteger(ackBlocks.size()),
+      QuicInteger(10),
+      ackBlocks);
+  result->coalesce();
+  CodecParameters params(kDefaultAckDelayExponent, QuicVersion::MVFST);
+  folly::io::Cursor contiguousCursor(result.get());
+  auto expected = decodeAckFrame(contiguousCursor, makeHeader(), params);
+  ASSERT_EQ(4, expected.ackBlocks.size());
+
+  // Split the frame at every byte, so that some of the blocks are decoded
+  // from the buffer directly and the others through the cursor.
+  for (size_t split = 1; split < result->length(); split++) {
+    auto chain = folly::IOBuf::copyBuffer(result->data(), split);
+    chain->prependChain(folly::IOBuf::copyBuffer(
+        result->data() + split, result->length() - split));
+    folly::io::Cursor cursor(chain.get());
+    auto ackFrame = decodeAckFrame(cursor, makeHeader(), params);
+    EXPECT_TRUE(cursor.isAtEnd());
+    ASSERT_EQ(expected.ackBlocks.size(), ackFrame.ackBlocks.size());
+    for (size_t i = 0; i < expected.ackBlocks.size(); i++) {
+      EXPECT_EQ(
+          expected.ackBlocks[i].startPacket, ackFrame.ackBlocks[i].startPacket);
+      EXPECT_EQ(
+          expected.ackBlocks[i].endPacket, ackFrame.ackBlocks[i].endPacket);
+    }
+  }
+}
+
+TEST_F(DecodeTest, StreamFrameViewBorrowsData) {
+  auto streamType = StreamTypeField::Builder().setOffset().setLength().build();
+  auto streamFrame = createStreamFrame(
+      QuicInteger(4),
+      QuicInteger(100),
+      QuicInteger(5),
+      folly::IOBuf::copyBuffer("helloworld"));
+  folly::io::Cursor cursor(streamFrame.get());
+  auto frame = decodeStreamFrameView(cursor, streamType);
+  EXPECT_EQ(4, frame.streamId);
+  EXPECT_EQ(100, frame.offset);
+  EXPECT_FALSE(frame.fin);
+  EXPECT_EQ(5, frame.dataLength);
+  EXPECT_EQ(5, cursor.totalLength());
+  auto data = frame.cloneData();
+  EXPECT_EQ("hello", data->moveToFbString().toStdString());
+}
+
+class TestFrameVisitor : public QuicFrameVisitor {
+ public:
+  void onFrame(QuicFrame&& frame) override {
+    frameTypes.push_back(frame.type());
+  }
+
+  void onAckFrame(const ReadAckFrameView& frame) override {
+    ackBlocks += frame.ackBlocks.size();
+  }
+
+  std::vector<QuicFrame::Type> frameTypes;
+  size_t ackBlocks{0};
+};
+
+TEST_F(DecodeTest, DecodeFramesVisitor) {
+  folly::IOBufQueue queue;
+  folly::io::QueueAppender wcursor(&queue, 10);
+  QuicInteger(static_cast<uint8_t>(FrameType::PADDING)).encode(wcursor);
+  QuicInteger(static_cast<uint8_t>(FrameType::ACK)).encode(wcursor);
+  wcursor.insert(createAckFrame(
+      QuicInteger(1000),
+      QuicInteger(100),
+      QuicInteger(0),
+      QuicInteger(10)));
+  auto streamType = StreamTypeField::Builder().setLength().build();
+  QuicInteger(streamType.fieldValue()).encode(wcursor);
+  wcursor.insert(createStreamFrame(
+      QuicInteger(4),
+      folly::none,
+      QuicInteger(1),
+      folly::IOBuf::copyBuffer("a")));
+  auto packet = queue.move();
+
+  TestFrameVisitor visitor;
+  folly::io::Cursor cursor(packet.get());
+  decodeFrames(
+      cursor,
+      makeHeader(),
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST),
+      visitor);
+  EXPECT_EQ(1, visitor.ackBlocks);
+  // The stream frame isn't overridden, it comes decoded.
+  std::vector<QuicFrame::Type> expected = {
+      QuicFrame::Type::PaddingFrame_E, QuicFrame::Type::ReadStreamFrame_E};
+  EXPECT_EQ(expected, visitor.frameTypes);
+}
+
 } // namespace test
 } // namespace quic
@@ -65,6 +65,26 @@ TEST(ConnectionIdTest, ConnIdSize) {
   EXPECT_THROW(ConnectionId{testconnid}, std::runtime_error);
 }
 
+TEST(ConnectionIdTest, Hash) {
+  ConnectionIdHash hash;
+  ConnectionId connid1(std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03});
+  ConnectionId connid2(std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03});
+  EXPECT_EQ(hash(connid1), hash(connid2));
+
+  // Trailing zeros still change the hash.
+  ConnectionId connid3(std::vector<uint8_t>{0x00, 0x01, 0x02, 0x03, 0x00});
+  EXPECT_NE(hash(connid1), hash(connid3));
+
+  // Every byte is part of the hash, up to the longest connection id.
+  std::vector<uint8_t> longest(kMaxConnectionIdSize, 0xaa);
+  auto longestHash = hash(ConnectionId(longest));
+  for (size_t i = 0; i < longest.size(); ++i) {
+    auto bytes = longest;
+    bytes[i] = 0xab;
+    EXPECT_NE(longestHash, hash(ConnectionId(bytes)));
+  }
+}
+
 struct ConnectionIdLengthParams {
   uint8_t dcidLen;
   uint8_t scidLen;
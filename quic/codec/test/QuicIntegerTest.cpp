@@ -15,6 +15,8 @@
 #include <quic/QuicException.h>
 #include <quic/codec/QuicInteger.h>
 
+#include <array>
+
 using namespace testing;
 using namespace folly;
 
@@ -72,6 +74,41 @@ TEST_P(QuicIntegerDecodeTest, DecodeAtMost) {
   }
 }
 
+TEST_P(QuicIntegerDecodeTest, DecodeByteRange) {
+  std::string encodedBytes = folly::unhexlify(GetParam().hexEncoded);
+
+  for (int atMost = 0; atMost <= GetParam().encodedLength; atMost++) {
+    auto data = folly::StringPiece(encodedBytes).subpiece(0, atMost);
+    auto decodedValue = decodeQuicInteger(folly::ByteRange(data));
+    if (GetParam().error || atMost != GetParam().encodedLength) {
+      EXPECT_FALSE(decodedValue.hasValue());
+    } else {
+      EXPECT_EQ(decodedValue->first, GetParam().decoded);
+      EXPECT_EQ(decodedValue->second, GetParam().encodedLength);
+    }
+  }
+}
+
+TEST_P(QuicIntegerDecodeTest, DecodeAcrossBuffers) {
+  std::string encodedBytes = folly::unhexlify(GetParam().hexEncoded);
+  if (GetParam().error || encodedBytes.size() < 2) {
+    return;
+  }
+  // Split the integer at every position, the decode can't use the single
+  // load of the contiguous case.
+  for (size_t split = 1; split < encodedBytes.size(); split++) {
+    auto wrappedEncoded = IOBuf::copyBuffer(encodedBytes.data(), split);
+    wrappedEncoded->prependChain(IOBuf::copyBuffer(
+        encodedBytes.data() + split, encodedBytes.size() - split));
+    folly::io::Cursor cursor(wrappedEncoded.get());
+    auto decodedValue = decodeQuicInteger(cursor);
+    ASSERT_TRUE(decodedValue.hasValue());
+    EXPECT_EQ(decodedValue->first, GetParam().decoded);
+    EXPECT_EQ(decodedValue->second, GetParam().encodedLength);
+    EXPECT_TRUE(cursor.isAtEnd());
+  }
+}
+
 TEST_P(QuicIntegerEncodeTest, Encode) {
   IOBufQueue queue;
   folly::io::QueueAppender appender(&queue, 10);
@@ -91,6 +128,18 @@ TEST_P(QuicIntegerEncodeTest, Encode) {
   EXPECT_EQ(*written, encodedValue.size() / 2);
 }
 
+TEST_P(QuicIntegerEncodeTest, EncodeWithSize) {
+  if (GetParam().error) {
+    return;
+  }
+  auto size = *getQuicIntegerSize(GetParam().decoded);
+  std::array<uint8_t, sizeof(uint64_t)> out;
+  encodeQuicIntegerWithSize(GetParam().decoded, size, out.data());
+  EXPECT_EQ(
+      folly::hexlify(folly::ByteRange(out.data(), size)),
+      GetParam().hexEncoded);
+}
+
 TEST_P(QuicIntegerEncodeTest, GetSize) {
   auto size = getQuicIntegerSize(GetParam().decoded);
   if (GetParam().error) {
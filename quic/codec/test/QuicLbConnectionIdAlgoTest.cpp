@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/codec/QuicLbConnectionIdAlgo.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/QuicException.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+folly::ByteRange toRange(const ConnectionId& connId) {
+  return folly::range(connId.data(), connId.data() + connId.size());
+}
+
+QuicLbConfig makeStreamCipherConfig() {
+  QuicLbConfig config;
+  config.mode = QuicLbConfig::Mode::StreamCipher;
+  config.configId = 1;
+  for (size_t i = 0; i < config.key.size(); ++i) {
+    config.key[i] = i;
+  }
+  return config;
+}
+} // namespace
+
+TEST(QuicLbConnectionIdAlgoTest, Plaintext) {
+  QuicLbConfig config;
+  config.configId = 2;
+  QuicLbConnectionIdAlgo algo(config);
+  ServerConnectionIdParams params(0x1234, 1, 42);
+  auto connId = algo.encodeConnectionId(params);
+  ASSERT_EQ(connId.size(), kQuicLbConnectionIdLength);
+  // The config id, then the self encoded length.
+  EXPECT_EQ(connId.data()[0], (2 << 6) | 7);
+  EXPECT_EQ(connId.data()[1], 0x12);
+  EXPECT_EQ(connId.data()[2], 0x34);
+  EXPECT_EQ(connId.data()[3], 42);
+
+  EXPECT_TRUE(algo.canParse(connId));
+  auto parsed = algo.parseConnectionId(connId);
+  EXPECT_EQ(parsed.hostId, 0x1234);
+  EXPECT_EQ(parsed.processId, 1);
+  EXPECT_EQ(parsed.workerId, 42);
+
+  // What a load balancer does with the same config.
+  QuicLbCodec codec(config);
+  EXPECT_EQ(codec.getServerId(toRange(connId)), 0x1234);
+}
+
+TEST(QuicLbConnectionIdAlgoTest, StreamCipher) {
+  auto config = makeStreamCipherConfig();
+  QuicLbConnectionIdAlgo algo(config);
+  QuicLbCodec codec(config);
+  for (uint8_t processId = 0; processId < 2; ++processId) {
+    ServerConnectionIdParams params(0xbeef, processId, 7);
+    auto connId = algo.encodeConnectionId(params);
+    ASSERT_EQ(connId.size(), kQuicLbConnectionIdLength);
+    EXPECT_EQ(connId.data()[0] >> 6, 1);
+    auto parsed = algo.parseConnectionId(connId);
+    EXPECT_EQ(parsed.hostId, 0xbeef);
+    EXPECT_EQ(parsed.processId, processId);
+    EXPECT_EQ(parsed.workerId, 7);
+    EXPECT_EQ(codec.getServerId(toRange(connId)), 0xbeef);
+  }
+
+  // Another key finds another server.
+  auto otherConfig = config;
+  otherConfig.key[0] ^= 1;
+  QuicLbCodec otherCodec(otherConfig);
+  auto connId = algo.encodeConnectionId(ServerConnectionIdParams(0xbeef, 0, 7));
+  EXPECT_NE(otherCodec.getServerId(toRange(connId)), 0xbeef);
+}
+
+TEST(QuicLbConnectionIdAlgoTest, OtherConfigId) {
+  auto config = makeStreamCipherConfig();
+  QuicLbConnectionIdAlgo algo(config);
+  auto connId = algo.encodeConnectionId(ServerConnectionIdParams(1, 0, 0));
+  config.configId = 0;
+  QuicLbConnectionIdAlgo otherAlgo(config);
+  EXPECT_FALSE(otherAlgo.canParse(connId));
+  EXPECT_THROW(otherAlgo.parseConnectionId(connId), QuicInternalException);
+  EXPECT_FALSE(QuicLbCodec(config).getServerId(toRange(connId)).hasValue());
+  // Only the connection ids of the right length are routed.
+  EXPECT_FALSE(
+      algo.canParse(ConnectionId(std::vector<uint8_t>(10, connId.data()[0]))));
+}
+
+TEST(QuicLbConnectionIdAlgoTest, HostIdTooLarge) {
+  QuicLbConfig config;
+  config.serverIdLength = 1;
+  QuicLbConnectionIdAlgo algo(config);
+  auto connId = algo.encodeConnectionId(ServerConnectionIdParams(0xff, 0, 3));
+  EXPECT_EQ(algo.parseConnectionId(connId).hostId, 0xff);
+  EXPECT_EQ(algo.parseConnectionId(connId).workerId, 3);
+  EXPECT_THROW(
+      algo.encodeConnectionId(ServerConnectionIdParams(0x100, 0, 3)),
+      QuicInternalException);
+}
+
+TEST(QuicLbConnectionIdAlgoTest, InvalidConfig) {
+  QuicLbConfig config;
+  config.configId = kQuicLbUnroutableConfigId;
+  EXPECT_THROW(QuicLbCodec{config}, std::invalid_argument);
+  config.configId = 0;
+  config.serverIdLength = 3;
+  EXPECT_THROW(QuicLbCodec{config}, std::invalid_argument);
+}
+
+} // namespace test
+} // namespace quic
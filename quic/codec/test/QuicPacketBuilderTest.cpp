@@ -11,6 +11,7 @@
 #include <folly/Random.h>
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/QuicReadCodec.h>
+#include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
 #include <quic/codec/test/Mocks.h>
 #include <quic/common/test/TestUtils.h>
@@ -110,6 +111,23 @@ TEST_F(QuicPacketBuilderTest, SimpleVersionNegotiationPacket) {
   EXPECT_EQ(decodedVersionNegotiationPacket->versions, versions);
 }
 
+TEST_F(QuicPacketBuilderTest, VersionNegotiationPacketTemplate) {
+  std::vector<QuicVersion> manyVersions;
+  for (size_t i = 0; i < 1000; i++) {
+    manyVersions.push_back(static_cast<QuicVersion>(i));
+  }
+  auto srcConnId = getTestConnectionId(0), destConnId = getTestConnectionId(1);
+  for (const auto& versions : {versionList({1, 2, 3}), manyVersions}) {
+    VersionNegotiationPacketTemplate versionTemplate(versions);
+    auto templatePacket = versionTemplate.buildPacket(srcConnId, destConnId);
+    auto builderPacket =
+        VersionNegotiationPacketBuilder(srcConnId, destConnId, versions)
+            .buildPacket()
+            .second;
+    EXPECT_TRUE(folly::IOBufEqualTo()(templatePacket, builderPacket));
+  }
+}
+
 TEST_F(QuicPacketBuilderTest, SimpleRetryPacket) {
   LongHeader headerIn(
       LongHeader::Types::Retry,
@@ -265,6 +283,59 @@ TEST_F(QuicPacketBuilderTest, ShortHeaderRegularPacket) {
   EXPECT_EQ(pktNum, decodedHeader.getPacketSequenceNum());
 }
 
+TEST_F(QuicPacketBuilderTest, ShortHeaderContiguousBody) {
+  auto connId = getTestConnectionId();
+  PacketNum pktNum = 222;
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen,
+      ShortHeader(ProtectionType::KeyPhaseZero, connId, pktNum),
+      0 /* largestAcked */);
+  constexpr size_t kHeadroom = 64;
+  auto arenaBuf = folly::IOBuf::create(kHeadroom + kDefaultUDPSendPacketLen);
+  auto arenaData = arenaBuf->data();
+  arenaBuf->advance(kHeadroom);
+  builder.setContiguousBodyBuffer(std::move(arenaBuf));
+
+  // Inserted buffers get copied rather than chained. Zeroes are padding.
+  writeFrame(PaddingFrame(), builder);
+  auto inserted = folly::IOBuf::create(10);
+  inserted->append(10);
+  memset(inserted->writableData(), 0, inserted->length());
+  auto insertedTail = inserted->clone();
+  inserted->prependChain(std::move(insertedTail));
+  builder.appendFrame(PaddingFrame());
+  builder.insert(std::move(inserted));
+  auto builtOut = std::move(builder).buildPacket();
+  ASSERT_NE(builtOut.body, nullptr);
+  EXPECT_FALSE(builtOut.body->isChained());
+  EXPECT_EQ(builtOut.body->computeChainDataLength(), 21);
+
+  auto headerLen = builtOut.header->computeChainDataLength();
+  auto packetBuf =
+      prependHeaderInPlace(std::move(builtOut.header), std::move(builtOut.body));
+  EXPECT_FALSE(packetBuf->isChained());
+  EXPECT_EQ(packetBuf->length(), headerLen + 21);
+  EXPECT_EQ(packetBuf->data(), arenaData + kHeadroom - headerLen);
+
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(std::move(packetBuf));
+  auto parsedPacket =
+      makeCodec(
+          connId, QuicNodeType::Client, nullptr, quic::test::createNoOpAead())
+          ->parsePacket(packetQueue, ackStates);
+  auto& decodedRegularPacket = *parsedPacket.regularPacket();
+  EXPECT_EQ(
+      pktNum, decodedRegularPacket.header.asShort()->getPacketSequenceNum());
+}
+
+TEST_F(QuicPacketBuilderTest, PrependHeaderWithoutHeadroom) {
+  auto header = folly::IOBuf::copyBuffer("header");
+  auto body = folly::IOBuf::copyBuffer("body");
+  auto packetBuf = prependHeaderInPlace(std::move(header), std::move(body));
+  EXPECT_TRUE(packetBuf->isChained());
+  EXPECT_EQ(packetBuf->computeChainDataLength(), 10);
+}
+
 TEST_F(QuicPacketBuilderTest, ShortHeaderWithNoFrames) {
   auto connId = getTestConnectionId();
   PacketNum pktNum = 222;
@@ -350,3 +421,33 @@ TEST_F(QuicPacketBuilderTest, PacketBuilderWrapper) {
   EXPECT_CALL(builder, remainingSpaceInPkt()).WillRepeatedly(Return(50));
   EXPECT_EQ(0, wrapper.remainingSpaceInPkt());
 }
+
+TEST_F(QuicPacketBuilderTest, RegularPacketBuilderWrapper) {
+  PacketNum pktNum = 222;
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen,
+      ShortHeader(ProtectionType::KeyPhaseZero, getTestConnectionId(), pktNum),
+      0 /* largestAcked */);
+  RegularPacketBuilderWrapper fullPacket(builder);
+  EXPECT_EQ(builder.remainingSpaceInPkt(), fullPacket.remainingSpaceInPkt());
+
+  RegularPacketBuilderWrapper wrapper(builder, 100);
+  EXPECT_EQ(100, wrapper.remainingSpaceInPkt());
+  auto data = folly::IOBuf::copyBuffer(std::string(1000, 'a'));
+  auto dataLen = writeStreamFrameHeader(wrapper, 4, 0, 1000, 1000, false);
+  ASSERT_TRUE(dataLen.hasValue());
+  // The frame type and the stream id take 2 bytes, and without a length
+  // field the data fills the rest of the writable bytes.
+  EXPECT_EQ(98, *dataLen);
+  writeStreamFrameData(wrapper, std::move(data), *dataLen);
+  EXPECT_EQ(0, wrapper.remainingSpaceInPkt());
+  EXPECT_GT(fullPacket.remainingSpaceInPkt(), 0);
+
+  auto builtOut = std::move(builder).buildPacket();
+  ASSERT_EQ(1, builtOut.packet.frames.size());
+  auto streamFrame = builtOut.packet.frames.front().asWriteStreamFrame();
+  ASSERT_NE(nullptr, streamFrame);
+  EXPECT_EQ(4, streamFrame->streamId);
+  EXPECT_EQ(98, streamFrame->len);
+  EXPECT_FALSE(streamFrame->fin);
+}
@@ -177,6 +177,32 @@ TEST_F(QuicReadCodecTest, StreamWithShortHeader) {
   EXPECT_TRUE(parseSuccess(std::move(packet)));
 }
 
+TEST_F(QuicReadCodecTest, RecycledFrames) {
+  auto connId = getTestConnectionId();
+  StreamId streamId = 2;
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto codec = makeEncryptedCodec(connId, createNoOpAead());
+  AckStates ackStates;
+
+  auto packetQueue = bufToQueue(packetToBuf(createStreamPacket(
+      connId, connId, 1, streamId, *data, 0 /* cipherOverhead */, 0)));
+  auto result = codec->parsePacket(packetQueue, ackStates);
+  ASSERT_NE(nullptr, result.regularPacket());
+  auto& frames = result.regularPacket()->frames;
+  ASSERT_EQ(1, frames.size());
+  auto framesData = frames.data();
+  codec->recycleFrames(std::move(frames));
+
+  packetQueue = bufToQueue(packetToBuf(createStreamPacket(
+      connId, connId, 2, streamId, *data, 0 /* cipherOverhead */, 0)));
+  auto nextResult = codec->parsePacket(packetQueue, ackStates);
+  ASSERT_NE(nullptr, nextResult.regularPacket());
+  auto& nextFrames = nextResult.regularPacket()->frames;
+  ASSERT_EQ(1, nextFrames.size());
+  EXPECT_EQ(framesData, nextFrames.data());
+  EXPECT_NE(nullptr, nextFrames[0].asReadStreamFrame());
+}
+
 TEST_F(QuicReadCodecTest, StreamWithShortHeaderOnlyHeader) {
   auto connId = getTestConnectionId();
   PacketNum packetNum = 12321;
@@ -289,6 +315,40 @@ TEST_F(QuicReadCodecTest, ZeroRttPacketWithZeroRttCipher) {
   EXPECT_TRUE(parseSuccess(std::move(packet)));
 }
 
+TEST_F(QuicReadCodecTest, ZeroRttPacketWithParsedInvariant) {
+  auto connId = getTestConnectionId();
+  PacketNum packetNum = 12321;
+  StreamId streamId = 2;
+
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto streamPacket = createStreamPacket(
+      connId,
+      connId,
+      packetNum,
+      streamId,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      std::make_pair(LongHeader::Types::ZeroRtt, QuicVersion::MVFST));
+
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  folly::io::Cursor cursor(packetQueue.front());
+  auto initialByte = cursor.readBE<uint8_t>();
+  auto invariant = parseLongHeaderInvariant(initialByte, cursor);
+  ASSERT_TRUE(invariant.hasValue());
+  auto packet = makeEncryptedCodec(connId, nullptr, createNoOpAead())
+                    ->parsePacket(
+                        packetQueue,
+                        ackStates,
+                        kDefaultConnectionIdSize,
+                        std::move(*invariant));
+  auto regularPacket = packet.regularPacket();
+  ASSERT_NE(regularPacket, nullptr);
+  EXPECT_EQ(regularPacket->header.getPacketSequenceNum(), packetNum);
+  EXPECT_TRUE(packetQueue.empty());
+}
+
 TEST_F(QuicReadCodecTest, KeyPhaseOnePacket) {
   auto connId = getTestConnectionId();
   PacketNum packetNum = 12321;
@@ -313,6 +373,192 @@ TEST_F(QuicReadCodecTest, KeyPhaseOnePacket) {
   EXPECT_FALSE(parseSuccess(std::move(packet)));
 }
 
+TEST_F(QuicReadCodecTest, KeyPhaseOnePacketWithNextCipher) {
+  auto connId = getTestConnectionId();
+  StreamId streamId = 2;
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto currentAead = createNoOpAead();
+  auto rawCurrentAead = currentAead.get();
+  auto nextAead = createNoOpAead();
+  auto rawNextAead = nextAead.get();
+  auto codec = makeEncryptedCodec(connId, std::move(currentAead));
+  codec->setNextOneRttReadCipher(std::move(nextAead));
+
+  auto updatedPacket = createStreamPacket(
+      connId,
+      connId,
+      10,
+      streamId,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseOne);
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(packetToBuf(updatedPacket));
+  EXPECT_CALL(*rawCurrentAead, _tryDecrypt(_, _, _)).Times(0);
+  EXPECT_CALL(*rawNextAead, _tryDecrypt(_, _, 10)).Times(1);
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, codec->getOneRttReadPhase());
+  EXPECT_EQ(rawNextAead, codec->getOneRttReadCipher());
+  EXPECT_EQ(nullptr, codec->getNextOneRttReadCipher());
+
+  // A packet of the first phase reordered after the key update.
+  auto reorderedPacket = createStreamPacket(
+      connId, connId, 9, streamId, *data, 0 /* cipherOverhead */, 0);
+  packetQueue = bufToQueue(packetToBuf(reorderedPacket));
+  EXPECT_CALL(*rawCurrentAead, _tryDecrypt(_, _, 9)).Times(1);
+  EXPECT_TRUE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, codec->getOneRttReadPhase());
+
+  // Another key update before the next cipher is installed.
+  auto secondUpdatePacket = createStreamPacket(
+      connId, connId, 11, streamId, *data, 0 /* cipherOverhead */, 0);
+  packetQueue = bufToQueue(packetToBuf(secondUpdatePacket));
+  EXPECT_FALSE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, codec->getOneRttReadPhase());
+}
+
+TEST_F(QuicReadCodecTest, KeyPhaseOnePacketFailsToDecrypt) {
+  auto connId = getTestConnectionId();
+  auto nextAead = std::make_unique<MockAead>();
+  auto rawNextAead = nextAead.get();
+  auto codec = makeEncryptedCodec(connId, createNoOpAead());
+  codec->setNextOneRttReadCipher(std::move(nextAead));
+  EXPECT_CALL(*rawNextAead, _tryDecrypt(_, _, _))
+      .WillOnce(Invoke([](auto&, const auto&, auto) { return folly::none; }));
+
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto streamPacket = createStreamPacket(
+      connId,
+      connId,
+      10,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseOne);
+  AckStates ackStates;
+  auto packetQueue = bufToQueue(packetToBuf(streamPacket));
+  EXPECT_FALSE(parseSuccess(codec->parsePacket(packetQueue, ackStates)));
+  EXPECT_EQ(ProtectionType::KeyPhaseZero, codec->getOneRttReadPhase());
+  EXPECT_EQ(rawNextAead, codec->getNextOneRttReadCipher());
+}
+
+class BatchRecordingAead : public Aead {
+ public:
+  explicit BatchRecordingAead(std::unique_ptr<Aead> aead)
+      : aead_(std::move(aead)) {}
+
+  std::unique_ptr<folly::IOBuf> encrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_->encrypt(std::move(plaintext), associatedData, seqNum);
+  }
+
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecrypt(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    return aead_->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+  }
+
+  void tryDecryptBatch(
+      folly::Range<DecryptRequest*> requests) const override {
+    batchSizes.push_back(requests.size());
+    Aead::tryDecryptBatch(requests);
+  }
+
+  size_t getCipherOverhead() const override {
+    return aead_->getCipherOverhead();
+  }
+
+  mutable std::vector<size_t> batchSizes;
+
+ private:
+  std::unique_ptr<Aead> aead_;
+};
+
+Buf makeShortHeaderDatagram(
+    PacketNum packetNum,
+    ProtectionType keyPhase = ProtectionType::KeyPhaseZero) {
+  auto connId = getTestConnectionId();
+  auto data = folly::IOBuf::copyBuffer("hello");
+  return packetToBuf(createStreamPacket(
+      connId,
+      connId,
+      packetNum,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      keyPhase));
+}
+
+TEST_F(QuicReadCodecTest, ParseShortHeaderPackets) {
+  auto connId = getTestConnectionId();
+  auto aead = std::make_unique<BatchRecordingAead>(createNoOpAead());
+  auto rawAead = aead.get();
+  auto codec = makeEncryptedCodec(connId, std::move(aead));
+
+  std::vector<Buf> datagrams;
+  datagrams.push_back(makeShortHeaderDatagram(1));
+  // Left for parsePacket().
+  auto longHeader = folly::IOBuf::copyBuffer("long header");
+  longHeader->writableData()[0] = 0xc0;
+  datagrams.push_back(longHeader->clone());
+  datagrams.push_back(makeShortHeaderDatagram(2));
+  datagrams.push_back(makeShortHeaderDatagram(3));
+  AckStates ackStates;
+  auto results = codec->parseShortHeaderPackets(datagrams, ackStates);
+  ASSERT_EQ(4, results.size());
+  for (size_t i : {0, 2, 3}) {
+    ASSERT_TRUE(results[i].hasValue());
+    ASSERT_NE(nullptr, results[i]->regularPacket());
+    EXPECT_EQ(nullptr, datagrams[i]);
+  }
+  EXPECT_EQ(
+      2, results[2]->regularPacket()->header.getPacketSequenceNum());
+  EXPECT_FALSE(results[1].hasValue());
+  EXPECT_TRUE(folly::IOBufEqualTo()(*datagrams[1], *longHeader));
+  EXPECT_EQ(std::vector<size_t>{3}, rawAead->batchSizes);
+}
+
+TEST_F(QuicReadCodecTest, ParseShortHeaderPacketsAcrossKeyUpdate) {
+  auto connId = getTestConnectionId();
+  auto currentAead = std::make_unique<BatchRecordingAead>(createNoOpAead());
+  auto rawCurrentAead = currentAead.get();
+  auto nextAead = std::make_unique<BatchRecordingAead>(createNoOpAead());
+  auto rawNextAead = nextAead.get();
+  auto codec = makeEncryptedCodec(connId, std::move(currentAead));
+  codec->setNextOneRttReadCipher(std::move(nextAead));
+
+  std::vector<Buf> datagrams;
+  datagrams.push_back(makeShortHeaderDatagram(1));
+  datagrams.push_back(makeShortHeaderDatagram(3, ProtectionType::KeyPhaseOne));
+  datagrams.push_back(makeShortHeaderDatagram(4, ProtectionType::KeyPhaseOne));
+  // Reordered from before the key update.
+  datagrams.push_back(makeShortHeaderDatagram(2));
+  AckStates ackStates;
+  auto results = codec->parseShortHeaderPackets(datagrams, ackStates);
+  ASSERT_EQ(4, results.size());
+  for (auto& result : results) {
+    ASSERT_TRUE(result.hasValue());
+    EXPECT_NE(nullptr, result->regularPacket());
+  }
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, codec->getOneRttReadPhase());
+  EXPECT_EQ(rawNextAead, codec->getOneRttReadCipher());
+  // The first packet of the new phase is decrypted on its own.
+  EXPECT_EQ((std::vector<size_t>{1, 1}), rawCurrentAead->batchSizes);
+  EXPECT_EQ((std::vector<size_t>{1, 1}), rawNextAead->batchSizes);
+}
+
 TEST_F(QuicReadCodecTest, FailToDecryptLeadsToReset) {
   auto connId = getTestConnectionId();
   auto aead = std::make_unique<MockAead>();
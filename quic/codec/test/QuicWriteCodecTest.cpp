@@ -663,6 +663,41 @@ TEST_F(QuicWriteCodecTest, WriteSimpleAckFrame) {
   EXPECT_EQ(decodedAckFrame.ackBlocks[1].endPacket, 400);
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckFrameWithECN) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto ackDelay = 111us;
+  IntervalSet<PacketNum> ackBlocks = {{501, 1000}, {101, 400}};
+  AckFrameMetaData meta(ackBlocks, ackDelay, kDefaultAckDelayExponent);
+  meta.ecnCounts = ECNCounts();
+  meta.ecnCounts->ect0 = 1000;
+  meta.ecnCounts->ce = 10;
+
+  // The 11 bytes of the plain ack, plus 2 bytes of ECT(0) count, 1 byte of
+  // ECT(1) count and 1 byte of CE count.
+  auto result = *writeAckFrame(meta, pktBuilder);
+  EXPECT_EQ(15, result.bytesWritten);
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  WriteAckFrame& ackFrame = *regularPacket.frames.back().asWriteAckFrame();
+  EXPECT_TRUE(ackFrame.ecn);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor typeCursor(wireBuf.get());
+  EXPECT_EQ(
+      static_cast<uint8_t>(FrameType::ACK_ECN),
+      typeCursor.readBE<uint8_t>());
+  folly::io::Cursor cursor(wireBuf.get());
+  QuicFrame decodedFrame = parseQuicFrame(cursor);
+  auto& decodedAckFrame = *decodedFrame.asReadAckFrame();
+  EXPECT_EQ(decodedAckFrame.largestAcked, 1000);
+  EXPECT_EQ(decodedAckFrame.ackBlocks.size(), 2);
+  ASSERT_TRUE(decodedAckFrame.ecnCounts.hasValue());
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect0, 1000);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ect1, 0);
+  EXPECT_EQ(decodedAckFrame.ecnCounts->ce, 10);
+}
+
 TEST_F(QuicWriteCodecTest, WriteAckFrameWillSaveAckDelay) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -849,6 +884,85 @@ TEST_F(QuicWriteCodecTest, WriteSomeAckBlocks) {
   EXPECT_EQ(decodedAckFrame.ackBlocks.size(), 14);
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckFrameMaxAckBlocks) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  IntervalSet<PacketNum> ackBlocks = {
+      {1000, 1000}, {900, 950}, {800, 850}, {700, 750}, {600, 650}};
+  AckFrameMetaData ackMetadata(ackBlocks, 555us, kDefaultAckDelayExponent);
+  ackMetadata.maxAckBlocks = 3;
+  auto ackFrameWriteResult = *writeAckFrame(ackMetadata, pktBuilder);
+  EXPECT_EQ(3, ackFrameWriteResult.ackBlocksWritten);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  WriteAckFrame& ackFrame = *builtOut.first.frames.back().asWriteAckFrame();
+  ASSERT_EQ(3, ackFrame.ackBlocks.size());
+  EXPECT_EQ(800, ackFrame.ackBlocks.front().start);
+  EXPECT_EQ(1000, ackFrame.ackBlocks.back().end);
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  QuicFrame decodedFrame = parseQuicFrame(cursor);
+  auto& decodedAckFrame = *decodedFrame.asReadAckFrame();
+  ASSERT_EQ(3, decodedAckFrame.ackBlocks.size());
+  EXPECT_EQ(800, decodedAckFrame.ackBlocks.back().startPacket);
+  EXPECT_EQ(850, decodedAckFrame.ackBlocks.back().endPacket);
+}
+
+TEST_F(QuicWriteCodecTest, WriteAckFrameReusesEncoding) {
+  auto writeAcks = [](const IntervalSet<PacketNum>& ackBlocks,
+                      AckBlocksEncoding* encoding,
+                      uint32_t space) {
+    MockQuicPacketBuilder pktBuilder;
+    pktBuilder.remaining_ = space;
+    setupCommonExpects(pktBuilder);
+    AckFrameMetaData ackMetadata(ackBlocks, 555us, kDefaultAckDelayExponent);
+    ackMetadata.encoding = encoding;
+    writeAckFrame(ackMetadata, pktBuilder);
+    auto builtOut = std::move(pktBuilder).buildPacket();
+    EXPECT_EQ(1, builtOut.first.frames.size());
+    return builtOut.second->moveToFbString().toStdString();
+  };
+  IntervalSet<PacketNum> ackBlocks;
+  for (PacketNum packetNum = 10; packetNum < 200; packetNum += 3) {
+    ackBlocks.insert(packetNum);
+  }
+  AckBlocksEncoding encoding;
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, kDefaultUDPSendPacketLen),
+      writeAcks(ackBlocks, &encoding, kDefaultUDPSendPacketLen));
+  EXPECT_EQ(ackBlocks.size() - 1, encoding.blockSizes.size());
+
+  // The largest block is extended, then more blocks are added above it.
+  ackBlocks.insert(200);
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, kDefaultUDPSendPacketLen),
+      writeAcks(ackBlocks, &encoding, kDefaultUDPSendPacketLen));
+  ackBlocks.insert(205);
+  ackBlocks.insert(210, 220);
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, kDefaultUDPSendPacketLen),
+      writeAcks(ackBlocks, &encoding, kDefaultUDPSendPacketLen));
+  EXPECT_EQ(ackBlocks.size() - 1, encoding.blockSizes.size());
+
+  // Less space than the encoding covers.
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, 30), writeAcks(ackBlocks, &encoding, 30));
+
+  // A block that merges two others is detected without an invalidate().
+  ackBlocks.insert(101, 102);
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, kDefaultUDPSendPacketLen),
+      writeAcks(ackBlocks, &encoding, kDefaultUDPSendPacketLen));
+
+  // A block that only grows needs the encoding to be invalidated.
+  ackBlocks.insert(50);
+  encoding.invalidate();
+  EXPECT_EQ(
+      writeAcks(ackBlocks, nullptr, kDefaultUDPSendPacketLen),
+      writeAcks(ackBlocks, &encoding, kDefaultUDPSendPacketLen));
+}
+
 TEST_F(QuicWriteCodecTest, NoSpaceForAckBlockSection) {
   MockQuicPacketBuilder pktBuilder;
   pktBuilder.remaining_ = 6;
@@ -1415,6 +1529,104 @@ TEST_F(QuicWriteCodecTest, WriteExpiredStreamDataFrame) {
   EXPECT_TRUE(cursor.isAtEnd());
 }
 
+TEST_F(QuicWriteCodecTest, WriteAckFrequencyFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  AckFrequencyFrame ackFrequencyFrame(1, 10, 25000us, true);
+  auto bytesWritten =
+      writeFrame(QuicSimpleFrame(ackFrequencyFrame), pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 2 bytes of frame type, 1 of sequence number and packet tolerance, 4 of
+  // delay and 1 of ignore order.
+  EXPECT_EQ(bytesWritten, 9);
+  EXPECT_EQ(
+      ackFrequencyFrame,
+      *regularPacket.frames[0].asQuicSimpleFrame()->asAckFrequencyFrame());
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  QuicFrame decodedFrame = parseQuicFrame(cursor);
+  QuicSimpleFrame& simpleFrame = *decodedFrame.asQuicSimpleFrame();
+  EXPECT_EQ(ackFrequencyFrame, *simpleFrame.asAckFrequencyFrame());
+
+  // At last, verify there is nothing left in the wire format bytes:
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForAckFrequencyFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 8;
+  setupCommonExpects(pktBuilder);
+  AckFrequencyFrame ackFrequencyFrame(1, 10, 25000us, true);
+  EXPECT_EQ(0, writeFrame(QuicSimpleFrame(ackFrequencyFrame), pktBuilder));
+}
+
+TEST_F(QuicWriteCodecTest, WriteNewTokenFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  NewTokenFrame newTokenFrame(std::string(24, 'a'));
+  auto bytesWritten = writeFrame(QuicSimpleFrame(newTokenFrame), pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 1 byte of frame type, 1 of token length and the token.
+  EXPECT_EQ(bytesWritten, 26);
+  EXPECT_EQ(
+      newTokenFrame,
+      *regularPacket.frames[0].asQuicSimpleFrame()->asNewTokenFrame());
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  QuicFrame decodedFrame = parseQuicFrame(cursor);
+  auto& readNewTokenFrame = *decodedFrame.asReadNewTokenFrame();
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      *folly::IOBuf::copyBuffer(newTokenFrame.token),
+      *readNewTokenFrame.token));
+
+  // At last, verify there is nothing left in the wire format bytes:
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForNewTokenFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 25;
+  setupCommonExpects(pktBuilder);
+  NewTokenFrame newTokenFrame(std::string(24, 'a'));
+  EXPECT_EQ(0, writeFrame(QuicSimpleFrame(newTokenFrame), pktBuilder));
+}
+
+TEST_F(QuicWriteCodecTest, WriteDatagramFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  setupCommonExpects(pktBuilder);
+  auto data = buildRandomInputData(100);
+  auto bytesWritten = writeDatagramFrame(*data, pktBuilder);
+
+  auto builtOut = std::move(pktBuilder).buildPacket();
+  auto regularPacket = builtOut.first;
+  // 1 byte of frame type and 2 of length.
+  EXPECT_EQ(bytesWritten, 103);
+  EXPECT_EQ(
+      WriteDatagramFrame(100), *regularPacket.frames[0].asWriteDatagramFrame());
+
+  auto wireBuf = std::move(builtOut.second);
+  folly::io::Cursor cursor(wireBuf.get());
+  QuicFrame decodedFrame = parseQuicFrame(cursor);
+  auto& datagramFrame = *decodedFrame.asReadDatagramFrame();
+  EXPECT_TRUE(folly::IOBufEqualTo()(data, datagramFrame.data));
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(QuicWriteCodecTest, NoSpaceForDatagramFrame) {
+  MockQuicPacketBuilder pktBuilder;
+  pktBuilder.remaining_ = 102;
+  setupCommonExpects(pktBuilder);
+  auto data = buildRandomInputData(100);
+  EXPECT_EQ(0, writeDatagramFrame(*data, pktBuilder));
+  EXPECT_EQ(102, pktBuilder.remaining_);
+}
+
 TEST_F(QuicWriteCodecTest, WriteMinStreamDataFrame) {
   MockQuicPacketBuilder pktBuilder;
   setupCommonExpects(pktBuilder);
@@ -261,6 +261,12 @@ TEST_F(TypesTest, LongHeaderPacketNumberSpace) {
       PacketNumberSpace::AppData, zeroRttLongHeader.getPacketNumberSpace());
 }
 
+TEST_F(TypesTest, WriteAckFrameSize) {
+  // The ack frame shouldn't be what sizes the frames of the outstanding
+  // packets.
+  EXPECT_LE(sizeof(WriteAckFrame), sizeof(QuicSimpleFrame));
+}
+
 class PacketHeaderTest : public Test {};
 
 TEST_F(PacketHeaderTest, LongHeader) {
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/BufferPool.h>
+
+#include <folly/io/async/EventBaseLocal.h>
+#include <folly/portability/SysMman.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+namespace {
+// The buffers of the region start on a cache line.
+constexpr size_t kRegionAlignment = 64;
+
+folly::EventBaseLocal<std::unique_ptr<BufferPool>>& eventBasePools() {
+  static auto* pools = new folly::EventBaseLocal<std::unique_ptr<BufferPool>>();
+  return *pools;
+}
+} // namespace
+
+BufferPool::BufferPool(size_t bufferSize, size_t maxPooledBuffers)
+    : BufferPool(bufferSize, maxPooledBuffers, 0) {}
+
+BufferPool::BufferPool(
+    size_t bufferSize,
+    size_t maxPooledBuffers,
+    size_t regionSize)
+    : bufferSize_(bufferSize),
+      regionSlotSize_(
+          (bufferSize + kRegionAlignment - 1) / kRegionAlignment *
+          kRegionAlignment),
+      state_(new State()) {
+  state_->ownerThread = std::this_thread::get_id();
+  state_->maxPooledBuffers = maxPooledBuffers;
+  if (regionSize > 0 && bufferSize > 0) {
+    mapRegion(regionSize);
+  }
+  state_->freeList.reserve(maxPooledBuffers + regionBuffers());
+}
+
+BufferPool::State::~State() {
+  if (region) {
+    ::munmap(region, regionSize);
+  }
+}
+
+void BufferPool::mapRegion(size_t regionSize) {
+  regionSize = (regionSize + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  void* region = MAP_FAILED;
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  // Only succeeds with huge pages reserved, see vm.nr_hugepages.
+  region = ::mmap(
+      nullptr,
+      regionSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+      -1,
+      0);
+  state_->hugePages = region != MAP_FAILED;
+#endif
+  if (region == MAP_FAILED) {
+    region = ::mmap(
+        nullptr,
+        regionSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (region == MAP_FAILED) {
+      LOG(ERROR) << "Unable to map a buffer pool region of " << regionSize
+                 << " bytes, the buffers come from the heap";
+      return;
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Transparent huge pages, if they are enabled for madvise.
+    state_->hugePages = ::madvise(region, regionSize, MADV_HUGEPAGE) == 0;
+#endif
+  }
+  state_->region = static_cast<uint8_t*>(region);
+  state_->regionSize = regionSize;
+}
+
+BufferPool::~BufferPool() {
+  DCHECK(state_->ownerThread == std::this_thread::get_id());
+  state_->poolAlive = false;
+  for (auto buf : state_->freeList) {
+    if (!state_->inRegion(buf)) {
+      ::free(buf);
+    }
+  }
+  state_->freeList.clear();
+  releaseState(state_);
+}
+
+void BufferPool::releaseState(State* state) {
+  if (state->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete state;
+  }
+}
+
+void BufferPool::freeBuffer(void* buf, void* userData) {
+  auto state = static_cast<State*>(userData);
+  bool inRegion = state->inRegion(buf);
+  if (std::this_thread::get_id() == state->ownerThread && state->poolAlive &&
+      (inRegion || state->freeList.size() < state->maxPooledBuffers)) {
+    state->freeList.push_back(buf);
+  } else if (!inRegion) {
+    ::free(buf);
+  }
+  releaseState(state);
+}
+
+std::unique_ptr<folly::IOBuf> BufferPool::getBuffer() {
+  DCHECK(state_->ownerThread == std::this_thread::get_id());
+  void* buf;
+  if (!state_->freeList.empty()) {
+    buf = state_->freeList.back();
+    state_->freeList.pop_back();
+  } else if (state_->regionUsed + regionSlotSize_ <= state_->regionSize) {
+    buf = state_->region + state_->regionUsed;
+    state_->regionUsed += regionSlotSize_;
+  } else {
+    buf = ::malloc(bufferSize_);
+    if (!buf) {
+      throw std::bad_alloc();
+    }
+  }
+  auto refs = state_->refs.fetch_add(1, std::memory_order_relaxed) + 1;
+  // refs counts the pool itself.
+  highWaterMark_ = std::max(highWaterMark_, refs - 1);
+  auto ioBuf = folly::IOBuf::takeOwnership(
+      buf, bufferSize_, 0, &BufferPool::freeBuffer, state_);
+  return ioBuf;
+}
+
+size_t BufferPool::pooledBuffers() const {
+  return state_->freeList.size();
+}
+
+size_t BufferPool::regionBuffers() const {
+  return regionSlotSize_ > 0 ? state_->regionSize / regionSlotSize_ : 0;
+}
+
+size_t BufferPool::outstandingBuffers() const {
+  return state_->refs.load(std::memory_order_relaxed) - 1;
+}
+
+BufferPool* BufferPool::getForEventBase(
+    folly::EventBase* evb,
+    size_t bufferSize,
+    size_t maxPooledBuffers) {
+  DCHECK(evb->isInEventBaseThread());
+  auto& pool = eventBasePools().getOrCreate(*evb);
+  if (!pool) {
+    pool = std::make_unique<BufferPool>(bufferSize, maxPooledBuffers);
+  }
+  return pool->bufferSize() == bufferSize ? pool.get() : nullptr;
+}
+} // namespace quic
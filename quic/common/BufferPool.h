@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A pool of fixed size buffers used for receiving packets. Buffers are handed
+ * out as IOBufs whose free function gives the memory back to the pool, so
+ * that steady state receive does not hit the allocator.
+ *
+ * The pool is meant to be used from a single thread (typically an EventBase
+ * thread). Buffers can be released from any thread and can outlive the pool;
+ * buffers released from another thread, or once the pool is full or
+ * destroyed, are simply freed.
+ *
+ * The buffers can also come from a region of memory of a fixed size mapped
+ * for the pool, backed by huge pages when the system has them, so that a
+ * large working set of buffers costs few TLB entries. The region is handed
+ * out first and its buffers always go back to the pool, whatever its
+ * maxPooledBuffers; once it is used up the buffers come from the heap. A
+ * region buffer released on another thread isn't reused, the region is
+ * unmapped once the pool and all its buffers are gone.
+ */
+class BufferPool {
+ public:
+  /**
+   * bufferSize: The size of every buffer handed out.
+   * maxPooledBuffers: The maximum number of released buffers the pool keeps
+   * around for reuse.
+   */
+  BufferPool(size_t bufferSize, size_t maxPooledBuffers);
+
+  /**
+   * regionSize: The bytes of the region the buffers are carved out of first,
+   * rounded up to kHugePageSize. 0 allocates every buffer from the heap, as
+   * does a region that can't be mapped.
+   */
+  BufferPool(size_t bufferSize, size_t maxPooledBuffers, size_t regionSize);
+
+  ~BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /**
+   * Returns an empty IOBuf with bufferSize() bytes of tailroom.
+   */
+  std::unique_ptr<folly::IOBuf> getBuffer();
+
+  size_t bufferSize() const {
+    return bufferSize_;
+  }
+
+  /**
+   * Number of released buffers currently cached by the pool.
+   */
+  size_t pooledBuffers() const;
+
+  /**
+   * Number of buffers handed out and not yet released.
+   */
+  size_t outstandingBuffers() const;
+
+  /**
+   * The largest number of buffers that have been outstanding at once.
+   */
+  size_t highWaterMark() const {
+    return highWaterMark_;
+  }
+
+  /**
+   * Number of buffers the region holds, 0 without a region.
+   */
+  size_t regionBuffers() const;
+
+  /**
+   * Whether the region is backed by huge pages, either reserved ones or
+   * transparent ones the kernel was asked for. The kernel may still back a
+   * transparent one with normal pages.
+   */
+  bool regionUsesHugePages() const {
+    return state_->hugePages;
+  }
+
+  /**
+   * Returns the pool of buffers of the given size associated with the
+   * EventBase, creating it if needed. Must be called on the EventBase thread.
+   * Returns nullptr if the EventBase already has a pool of a different size.
+   */
+  static BufferPool* getForEventBase(
+      folly::EventBase* evb,
+      size_t bufferSize,
+      size_t maxPooledBuffers);
+
+ private:
+  // State shared between the pool and its outstanding buffers, so that
+  // buffers can be released after the pool is gone.
+  struct State {
+    ~State();
+
+    bool inRegion(const void* buf) const {
+      return buf >= region && buf < region + regionSize;
+    }
+
+    // One reference for the pool itself plus one per outstanding buffer.
+    std::atomic<size_t> refs{1};
+    // Only accessed on the owner thread.
+    bool poolAlive{true};
+    std::thread::id ownerThread;
+    std::vector<void*> freeList;
+    size_t maxPooledBuffers;
+    // Unmapped with the state, so that the buffers can outlive the pool.
+    uint8_t* region{nullptr};
+    size_t regionSize{0};
+    // The bytes of the region handed out at least once, from its start.
+    size_t regionUsed{0};
+    bool hugePages{false};
+  };
+
+  void mapRegion(size_t regionSize);
+
+  static void freeBuffer(void* buf, void* userData);
+  static void releaseState(State* state);
+
+  size_t bufferSize_;
+  // The size of the buffers in the region, aligned for every one of them.
+  size_t regionSlotSize_;
+  size_t highWaterMark_{0};
+  State* state_;
+};
+} // namespace quic
@@ -23,12 +23,54 @@ void FunctionLooper::setPacingTimer(
   pacingTimer_ = std::move(pacingTimer);
 }
 
+void FunctionLooper::setPacingScheduler(
+    PacingScheduler::SharedPtr pacingScheduler) noexcept {
+  pacingScheduler_ = std::move(pacingScheduler);
+}
+
+void FunctionLooper::setWriteScheduler(
+    WriteScheduler::SharedPtr writeScheduler) noexcept {
+  writeScheduler_ = std::move(writeScheduler);
+}
+
 void FunctionLooper::setPacingFunction(
     folly::Function<std::chrono::microseconds()>&& pacingFunc) {
   pacingFunc_ = std::move(pacingFunc);
 }
 
+void FunctionLooper::setLagCallback(
+    folly::Function<void(std::chrono::microseconds)>&& lagCallback) {
+  lagCallback_ = std::move(lagCallback);
+}
+
+void FunctionLooper::setWriteBudgetExhaustedCallback(
+    folly::Function<void(std::chrono::microseconds, uint64_t, size_t)>&&
+        callback) {
+  writeBudgetExhaustedCallback_ = std::move(callback);
+}
+
+void FunctionLooper::setExpectedRunTime(
+    std::chrono::microseconds delay) noexcept {
+  if (lagCallback_) {
+    expectedRunTime_ = std::chrono::steady_clock::now() + delay;
+  }
+}
+
+void FunctionLooper::reportLag() noexcept {
+  if (!lagCallback_ || !expectedRunTime_) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  auto lag = now > *expectedRunTime_
+      ? std::chrono::duration_cast<std::chrono::microseconds>(
+            now - *expectedRunTime_)
+      : 0us;
+  expectedRunTime_ = folly::none;
+  lagCallback_(lag);
+}
+
 void FunctionLooper::commonLoopBody(bool fromTimer) noexcept {
+  reportLag();
   inLoopBody_ = true;
   SCOPE_EXIT {
     inLoopBody_ = false;
@@ -43,15 +85,29 @@ void FunctionLooper::commonLoopBody(bool fromTimer) noexcept {
     return;
   }
   if (!schedulePacingTimeout(fromTimer)) {
-    evb_->runInLoop(this);
+    setExpectedRunTime(0us);
+    scheduleLoop(false);
+  }
+}
+
+void FunctionLooper::scheduleLoop(bool thisIteration) noexcept {
+  if (writeScheduler_) {
+    writeScheduler_->schedule(this, thisIteration);
+  } else {
+    evb_->runInLoop(this, thisIteration);
   }
 }
 
 bool FunctionLooper::schedulePacingTimeout(bool /* fromTimer */) noexcept {
-  if (pacingFunc_ && pacingTimer_ && !isScheduled()) {
+  if (pacingFunc_ && (pacingTimer_ || pacingScheduler_) && !isScheduled()) {
     auto nextPacingTime = (*pacingFunc_)();
     if (nextPacingTime != 0us) {
-      pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      setExpectedRunTime(nextPacingTime);
+      if (pacingScheduler_) {
+        pacingScheduler_->scheduleTimeout(this, nextPacingTime);
+      } else {
+        pacingTimer_->scheduleTimeout(this, nextPacingTime);
+      }
       return true;
     }
   }
@@ -63,28 +119,41 @@ void FunctionLooper::runLoopCallback() noexcept {
   commonLoopBody(false);
 }
 
+void FunctionLooper::writeBudgetExhausted(
+    std::chrono::microseconds timeSpent,
+    uint64_t packetsWritten,
+    size_t numDeferred) noexcept {
+  if (writeBudgetExhaustedCallback_) {
+    writeBudgetExhaustedCallback_(timeSpent, packetsWritten, numDeferred);
+  }
+}
+
 void FunctionLooper::run(bool thisIteration) noexcept {
   VLOG(10) << __func__ << ": " << type_;
   running_ = true;
   // Caller can call run() in func_. But if we are in pacing mode, we should
   // prevent such loop.
-  if (pacingTimer_ && inLoopBody_) {
+  if ((pacingTimer_ || pacingScheduler_) && inLoopBody_) {
     VLOG(4) << __func__ << ": " << type_
             << " in loop body and using pacing - not rescheduling";
     return;
   }
-  if (isLoopCallbackScheduled() || isScheduled()) {
+  if (isLoopCallbackScheduled() || isWriteScheduled() || isScheduled()) {
     VLOG(10) << __func__ << ": " << type_ << " already scheduled";
     return;
   }
-  evb_->runInLoop(this, thisIteration);
+  setExpectedRunTime(0us);
+  scheduleLoop(thisIteration);
 }
 
 void FunctionLooper::stop() noexcept {
   VLOG(10) << __func__ << ": " << type_;
   running_ = false;
+  expectedRunTime_ = folly::none;
   cancelLoopCallback();
   cancelTimeout();
+  cancelPacingTimeout();
+  cancelWrite();
 }
 
 bool FunctionLooper::isRunning() const {
@@ -103,9 +172,15 @@ void FunctionLooper::detachEventBase() {
   DCHECK(evb_ && evb_->isInEventBaseThread());
   stop();
   cancelTimeout();
+  // The scheduler runs on the evb being detached from.
+  writeScheduler_ = nullptr;
   evb_ = nullptr;
 }
 
+bool FunctionLooper::isScheduled() const {
+  return TimerHighRes::Callback::isScheduled() || isPacingTimeoutScheduled();
+}
+
 void FunctionLooper::timeoutExpired() noexcept {
   folly::DelayedDestruction::DestructorGuard dg(this);
   commonLoopBody(true);
@@ -115,8 +190,21 @@ void FunctionLooper::callbackCanceled() noexcept {
   return;
 }
 
+void FunctionLooper::pacingTimeoutExpired() noexcept {
+  folly::DelayedDestruction::DestructorGuard dg(this);
+  commonLoopBody(true);
+}
+
+void FunctionLooper::writeReady() noexcept {
+  folly::DelayedDestruction::DestructorGuard dg(this);
+  commonLoopBody(false);
+}
+
 folly::Optional<std::chrono::microseconds>
 FunctionLooper::getTimerTickInterval() noexcept {
+  if (pacingScheduler_) {
+    return pacingScheduler_->getTickInterval();
+  }
   if (pacingTimer_) {
     return pacingTimer_->getTickInterval();
   }
@@ -11,7 +11,9 @@
 
 #include <folly/Function.h>
 #include <folly/io/async/EventBase.h>
+#include <quic/common/PacingScheduler.h>
 #include <quic/common/Timers.h>
+#include <quic/common/WriteScheduler.h>
 
 namespace quic {
 enum class LooperType : uint8_t {
@@ -29,7 +31,9 @@ std::ostream& operator<<(std::ostream& /* out */, const LooperType& /*rhs*/);
  */
 class FunctionLooper : public folly::EventBase::LoopCallback,
                        public folly::DelayedDestruction,
-                       public TimerHighRes::Callback {
+                       public TimerHighRes::Callback,
+                       public PacingScheduler::Callback,
+                       public WriteScheduler::Callback {
  public:
   using Ptr =
       std::unique_ptr<FunctionLooper, folly::DelayedDestruction::Destructor>;
@@ -41,6 +45,18 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
 
   void setPacingTimer(TimerHighRes::SharedPtr pacingTimer) noexcept;
 
+  /**
+   * Paces with the scheduler shared by the worker's loopers instead of a
+   * timeout of its own on a pacing timer.
+   */
+  void setPacingScheduler(PacingScheduler::SharedPtr pacingScheduler) noexcept;
+
+  /**
+   * Runs in the worker's write scheduler instead of as a loop callback of its
+   * own. The scheduler is dropped when the looper is detached from its evb.
+   */
+  void setWriteScheduler(WriteScheduler::SharedPtr writeScheduler) noexcept;
+
   void runLoopCallback() noexcept override;
 
   /**
@@ -75,21 +91,66 @@ class FunctionLooper : public folly::EventBase::LoopCallback,
    */
   void detachEventBase();
 
+  /**
+   * Whether a paced run is scheduled, on the pacing timer or the pacing
+   * scheduler.
+   */
+  bool isScheduled() const;
+
   void timeoutExpired() noexcept override;
 
   void callbackCanceled() noexcept override;
 
+  void pacingTimeoutExpired() noexcept override;
+
+  void writeReady() noexcept override;
+
+  void writeBudgetExhausted(
+      std::chrono::microseconds timeSpent,
+      uint64_t packetsWritten,
+      size_t numDeferred) noexcept override;
+
   folly::Optional<std::chrono::microseconds> getTimerTickInterval() noexcept;
 
+  /**
+   * Reports how late the loop body runs compared to when it was meant to run:
+   * the loop iteration it was scheduled in, or the end of the pacing timeout.
+   * The latter includes up to a tick of the pacing timer. The clock is only
+   * read once a callback is set.
+   */
+  void setLagCallback(
+      folly::Function<void(std::chrono::microseconds)>&& lagCallback);
+
+  /**
+   * Called when the run of the looper used up the budget of its write
+   * scheduler, see WriteScheduler::Callback::writeBudgetExhausted().
+   */
+  void setWriteBudgetExhaustedCallback(
+      folly::Function<void(std::chrono::microseconds, uint64_t, size_t)>&&
+          callback);
+
  private:
-  ~FunctionLooper() override = default;
+  ~FunctionLooper() override {
+    // Before pacingScheduler_ and writeScheduler_ go away.
+    cancelPacingTimeout();
+    cancelWrite();
+  }
   void commonLoopBody(bool fromTimer) noexcept;
+  void scheduleLoop(bool thisIteration) noexcept;
   bool schedulePacingTimeout(bool fromTimer) noexcept;
+  void setExpectedRunTime(std::chrono::microseconds delay) noexcept;
+  void reportLag() noexcept;
 
   folly::EventBase* evb_;
   folly::Function<void(bool)> func_;
   folly::Optional<folly::Function<std::chrono::microseconds()>> pacingFunc_;
   TimerHighRes::SharedPtr pacingTimer_;
+  PacingScheduler::SharedPtr pacingScheduler_;
+  WriteScheduler::SharedPtr writeScheduler_;
+  folly::Function<void(std::chrono::microseconds)> lagCallback_;
+  folly::Function<void(std::chrono::microseconds, uint64_t, size_t)>
+      writeBudgetExhaustedCallback_;
+  folly::Optional<std::chrono::steady_clock::time_point> expectedRunTime_;
   bool running_{false};
   bool inLoopBody_{false};
   const LooperType type_;
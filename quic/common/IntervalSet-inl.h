@@ -103,6 +103,20 @@ template <
     T Unit,
     template <typename I, typename = std::allocator<I>> class Container>
 void IntervalSet<T, Unit, Container>::insert(const T& point) {
+  // In order packet numbers extend the last interval, or are already in it,
+  // without the search and merge.
+  if (!container_type::empty()) {
+    auto& last = container_type::back();
+    if (point >= last.start && point <= last.end) {
+      return;
+    }
+    if (point == last.end + interval_type::unitValue() &&
+        point <= std::numeric_limits<T>::max() - interval_type::unitValue()) {
+      last.end = point;
+      insertVersion_++;
+      return;
+    }
+  }
   insert(Interval<T, Unit>(point, point));
 }
 
@@ -135,4 +149,12 @@ template <
 uint64_t IntervalSet<T, Unit, Container>::insertVersion() const {
   return insertVersion_;
 }
+
+template <
+    typename T,
+    T Unit,
+    template <typename I, typename = std::allocator<I>> class Container>
+void IntervalSet<T, Unit, Container>::pop_front() {
+  container_type::erase(container_type::begin());
+}
 } // namespace quic
@@ -15,11 +15,16 @@
 #include <stdexcept>
 
 #include <folly/Likely.h>
+#include <folly/small_vector.h>
 
 namespace quic {
 
 constexpr uint64_t kDefaultIntervalSetVersion = 0;
 
+// Number of intervals an IntervalSet holds without allocating. Most ack
+// states and ack frames have fewer intervals than this.
+constexpr size_t kIntervalSetInlineCapacity = 4;
+
 template <typename T, T Unit = (T)1>
 struct Interval {
   T start;
@@ -40,6 +45,15 @@ struct Interval {
   }
 };
 
+/**
+ * The default container of IntervalSet: a vector that keeps the first
+ * kIntervalSetInlineCapacity intervals inline and only moves them to the heap
+ * past that. The allocator parameter is only there to match the signature of
+ * the standard containers, which can still be used instead.
+ */
+template <typename I, typename = std::allocator<I>>
+using SmallIntervalVector = folly::small_vector<I, kIntervalSetInlineCapacity>;
+
 /*
  * IntervalSet conceptually represents a set of sorted disjoint intervals.
  * Any operations on top of an interval set should keep the intervals it holds
@@ -53,7 +67,7 @@ template <
     typename T,
     T Unit = (T)1,
     template <typename I, typename = std::allocator<I>> class Container =
-        std::deque>
+        SmallIntervalVector>
 class IntervalSet : private Container<Interval<T, Unit>> {
  public:
   using interval_type = Interval<T, Unit>;
@@ -91,9 +105,11 @@ class IntervalSet : private Container<Interval<T, Unit>> {
   using container_type::empty;
   using container_type::front;
   using container_type::pop_back;
-  using container_type::pop_front;
   using container_type::size;
 
+  // Not every container has a pop_front().
+  void pop_front();
+
  private:
   /**
    * Helper function to find the intersecting range in this interval set
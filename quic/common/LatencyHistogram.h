@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include <folly/lang/Bits.h>
+
+namespace quic {
+
+/*
+ * A fixed size log-linear histogram of latencies in microseconds, in the
+ * spirit of HdrHistogram. Values below kSubBuckets get a bucket each, and every
+ * power of two above is split into kSubBuckets buckets, so the relative error
+ * of a recorded value stays below 1 / kSubBuckets. Adding a value is a couple
+ * of bit operations and an increment, with no allocation.
+ *
+ * It is not synchronized: like QuicTransportStatsCallback, keep one per thread
+ * and merge() them when aggregating.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 4;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  // Values are clamped to 2^kMaxValueBits - 1 microseconds, about 19 hours.
+  static constexpr size_t kMaxValueBits = 36;
+  static constexpr size_t kNumBuckets =
+      kSubBuckets + (kMaxValueBits - kSubBucketBits) * kSubBuckets;
+
+  void addValue(std::chrono::microseconds value) {
+    uint64_t us = value.count() > 0 ? value.count() : 0;
+    us = std::min<uint64_t>(us, (uint64_t(1) << kMaxValueBits) - 1);
+    ++buckets_[bucketIndex(us)];
+    ++count_;
+    max_ = std::max(max_, us);
+  }
+
+  uint64_t count() const {
+    return count_;
+  }
+
+  std::chrono::microseconds max() const {
+    return std::chrono::microseconds(max_);
+  }
+
+  /**
+   * Returns an upper bound of the given percentile, in [0, 100], of the values
+   * added so far. Zero if the histogram is empty.
+   */
+  std::chrono::microseconds getPercentile(double percentile) const {
+    if (count_ == 0) {
+      return std::chrono::microseconds(0);
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      seen += buckets_[i];
+      if (seen >= target) {
+        return std::chrono::microseconds(
+            std::min(bucketUpperBound(i), max_));
+      }
+    }
+    return std::chrono::microseconds(max_);
+  }
+
+  /**
+   * Adds count values to the bucket at index, for rebuilding a histogram from
+   * bucket counts kept elsewhere. The maximum is then only known up to the
+   * bucket upper bound.
+   */
+  void addBucketCount(size_t index, uint64_t count) {
+    if (count == 0) {
+      return;
+    }
+    buckets_[index] += count;
+    count_ += count;
+    max_ = std::max(max_, bucketUpperBound(index));
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  void clear() {
+    buckets_.fill(0);
+    count_ = 0;
+    max_ = 0;
+  }
+
+  static size_t bucketIndex(uint64_t us) {
+    if (us < kSubBuckets) {
+      return us;
+    }
+    // us is in [2^msb, 2^(msb + 1)), split into kSubBuckets buckets.
+    size_t msb = folly::findLastSet(us) - 1;
+    size_t shift = msb - kSubBucketBits;
+    size_t subBucket = (us >> shift) & (kSubBuckets - 1);
+    return kSubBuckets + shift * kSubBuckets + subBucket;
+  }
+
+  // Largest value that lands in the bucket.
+  static uint64_t bucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    size_t shift = (index - kSubBuckets) / kSubBuckets;
+    size_t subBucket = (index - kSubBuckets) % kSubBuckets;
+    uint64_t lower = (kSubBuckets + subBucket) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+  }
+
+ private:
+  std::array<uint64_t, kNumBuckets> buckets_{};
+  uint64_t count_{0};
+  uint64_t max_{0};
+};
+} // namespace quic
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/PacingScheduler.h>
+
+namespace quic {
+
+void PacingScheduler::Callback::cancelPacingTimeout() {
+  if (hook_.is_linked()) {
+    hook_.unlink();
+    if (scheduler_) {
+      scheduler_->onCanceled();
+    }
+  }
+  scheduler_ = nullptr;
+}
+
+PacingScheduler::PacingScheduler(
+    TimerHighRes::SharedPtr timer,
+    size_t numSlots)
+    : timer_(std::move(timer)),
+      tickInterval_(std::max(timer_->getTickInterval(), 1us)),
+      start_(Clock::now()),
+      slots_(std::max<size_t>(numSlots, 1)) {}
+
+PacingScheduler::~PacingScheduler() {
+  for (auto& slot : slots_) {
+    while (!slot.empty()) {
+      auto& callback = slot.front();
+      slot.pop_front();
+      callback.scheduler_ = nullptr;
+    }
+  }
+}
+
+uint64_t PacingScheduler::tickAt(TimePoint time) const {
+  if (time <= start_) {
+    return 0;
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(time - start_)
+             .count() /
+      tickInterval_.count();
+}
+
+void PacingScheduler::scheduleTimeout(
+    Callback* callback,
+    std::chrono::microseconds delay) {
+  callback->cancelPacingTimeout();
+  auto now = Clock::now();
+  if (numScheduled_ == 0) {
+    // Nothing to run in the ticks that went by while idle.
+    lastRunTick_ = std::max(lastRunTick_, tickAt(now));
+  }
+  // Round up, a paced write must not run early.
+  auto dueTick = std::max(
+      tickAt(now + delay + tickInterval_ - 1us), lastRunTick_ + 1);
+  callback->scheduler_ = this;
+  callback->dueTick_ = dueTick;
+  slots_[dueTick % slots_.size()].push_back(*callback);
+  ++numScheduled_;
+  if (!inTimeoutExpired_ && (!wakeupTick_ || dueTick < *wakeupTick_)) {
+    armTimer(dueTick);
+  }
+}
+
+void PacingScheduler::onCanceled() {
+  DCHECK_GT(numScheduled_, 0);
+  --numScheduled_;
+  if (numScheduled_ == 0 && wakeupTick_) {
+    wakeupTick_.clear();
+    cancelTimeout();
+  }
+}
+
+void PacingScheduler::armTimer(uint64_t tick) {
+  wakeupTick_ = tick;
+  auto wakeupTime = start_ + tick * tickInterval_;
+  auto now = Clock::now();
+  timer_->scheduleTimeout(
+      this,
+      wakeupTime > now ? std::chrono::duration_cast<std::chrono::microseconds>(
+                             wakeupTime - now)
+                       : 0us);
+}
+
+void PacingScheduler::timeoutExpired() noexcept {
+  ++numWakeups_;
+  // The timer can fire a little before the tick it was armed for.
+  auto nowTick = std::max(tickAt(Clock::now()), wakeupTick_.value_or(0));
+  wakeupTick_.clear();
+  inTimeoutExpired_ = true;
+
+  CallbackList due;
+  if (nowTick > lastRunTick_) {
+    auto numTicks = std::min<uint64_t>(nowTick - lastRunTick_, slots_.size());
+    for (uint64_t i = 1; i <= numTicks; ++i) {
+      auto& slot = slots_[(lastRunTick_ + i) % slots_.size()];
+      // The callbacks due in a later lap stay in the slot.
+      for (auto it = slot.begin(); it != slot.end();) {
+        auto& callback = *it;
+        ++it;
+        if (callback.dueTick_ <= nowTick) {
+          callback.hook_.unlink();
+          due.push_back(callback);
+        }
+      }
+    }
+    lastRunTick_ = nowTick;
+  }
+
+  // Run everything that is due back to back. A callback can cancel or
+  // reschedule the others, which takes them off the list.
+  while (!due.empty()) {
+    auto& callback = due.front();
+    due.pop_front();
+    callback.scheduler_ = nullptr;
+    --numScheduled_;
+    callback.pacingTimeoutExpired();
+  }
+  inTimeoutExpired_ = false;
+  scheduleWakeup();
+}
+
+void PacingScheduler::scheduleWakeup() {
+  if (numScheduled_ == 0) {
+    return;
+  }
+  // The first slot with a callback due in this lap holds the earliest one.
+  for (uint64_t i = 1; i <= slots_.size(); ++i) {
+    auto tick = lastRunTick_ + i;
+    for (const auto& callback : slots_[tick % slots_.size()]) {
+      if (callback.dueTick_ == tick) {
+        armTimer(tick);
+        return;
+      }
+    }
+  }
+  // Everything is more than a lap away.
+  folly::Optional<uint64_t> earliest;
+  for (const auto& slot : slots_) {
+    for (const auto& callback : slot) {
+      if (!earliest || callback.dueTick_ < *earliest) {
+        earliest = callback.dueTick_;
+      }
+    }
+  }
+  DCHECK(earliest);
+  armTimer(*earliest);
+}
+} // namespace quic
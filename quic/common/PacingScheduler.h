@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/IntrusiveList.h>
+#include <folly/Optional.h>
+#include <quic/QuicConstants.h>
+#include <quic/common/Timers.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Schedules the paced writes of all the transports of a worker with a single
+ * timeout on the pacing timer, instead of one per transport.
+ *
+ * The callbacks are kept in a calendar queue with one slot per tick of the
+ * pacing timer. On each wakeup all the callbacks that are due are run back
+ * to back, so their writes land in the same loop iteration, where a
+ * QuicWriteCoalescer can flush them together. A callback due more than
+ * numSlots ticks away stays in its slot for as many laps as it takes.
+ *
+ * Not thread-safe, only use it from the thread of the timer's EventBase.
+ */
+class PacingScheduler : private TimerHighRes::Callback {
+ public:
+  using SharedPtr = std::shared_ptr<PacingScheduler>;
+
+  class Callback {
+   public:
+    virtual ~Callback() {
+      cancelPacingTimeout();
+    }
+
+    virtual void pacingTimeoutExpired() noexcept = 0;
+
+    bool isPacingTimeoutScheduled() const {
+      return hook_.is_linked();
+    }
+
+    void cancelPacingTimeout();
+
+   private:
+    friend class PacingScheduler;
+
+    folly::IntrusiveListHook hook_;
+    PacingScheduler* scheduler_{nullptr};
+    // The tick the callback is due at, counted from the scheduler's start.
+    uint64_t dueTick_{0};
+  };
+
+  explicit PacingScheduler(
+      TimerHighRes::SharedPtr timer,
+      size_t numSlots = kDefaultPacingSchedulerSlots);
+
+  ~PacingScheduler() override;
+
+  /**
+   * Runs the callback once delay has passed, rounded up to a tick. A callback
+   * that is already scheduled is moved.
+   */
+  void scheduleTimeout(Callback* callback, std::chrono::microseconds delay);
+
+  std::chrono::microseconds getTickInterval() const {
+    return tickInterval_;
+  }
+
+  size_t numScheduled() const {
+    return numScheduled_;
+  }
+
+  /**
+   * The number of times the scheduler woke up to run callbacks.
+   */
+  uint64_t numWakeups() const {
+    return numWakeups_;
+  }
+
+ private:
+  using CallbackList = folly::IntrusiveList<Callback, &Callback::hook_>;
+
+  void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
+
+  void onCanceled();
+  uint64_t tickAt(TimePoint time) const;
+  void scheduleWakeup();
+  void armTimer(uint64_t tick);
+
+  TimerHighRes::SharedPtr timer_;
+  const std::chrono::microseconds tickInterval_;
+  const TimePoint start_;
+  std::vector<CallbackList> slots_;
+  size_t numScheduled_{0};
+  // All the ticks up to this one have been run.
+  uint64_t lastRunTick_{0};
+  // The tick the timer is armed for, if it is.
+  folly::Optional<uint64_t> wakeupTick_;
+  bool inTimeoutExpired_{false};
+  uint64_t numWakeups_{0};
+};
+} // namespace quic
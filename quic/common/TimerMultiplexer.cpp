@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/TimerMultiplexer.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+TimerMultiplexer::~TimerMultiplexer() {
+  if (destroyed_) {
+    *destroyed_ = true;
+  }
+}
+
+std::vector<TimerMultiplexer::Entry>::iterator TimerMultiplexer::find(
+    const folly::HHWheelTimer::Callback* callback) {
+  return std::find_if(
+      entries_.begin(), entries_.end(), [callback](const Entry& entry) {
+        return entry.callback == callback;
+      });
+}
+
+std::vector<TimerMultiplexer::Entry>::const_iterator TimerMultiplexer::find(
+    const folly::HHWheelTimer::Callback* callback) const {
+  return const_cast<TimerMultiplexer*>(this)->find(callback);
+}
+
+void TimerMultiplexer::scheduleTimeout(
+    folly::HHWheelTimer& wheel,
+    folly::HHWheelTimer::Callback* callback,
+    std::chrono::milliseconds timeout) {
+  if (wheel_ != &wheel) {
+    // Moving to another wheel, after the EventBase was detached.
+    DCHECK(entries_.empty());
+    cancelAll();
+    wheel_ = &wheel;
+  }
+  auto deadline = Clock::now() + timeout;
+  auto it = find(callback);
+  if (it != entries_.end()) {
+    it->deadline = deadline;
+    it->generation = nextGeneration_++;
+  } else {
+    entries_.push_back(Entry{callback, deadline, nextGeneration_++});
+  }
+  // A later deadline is picked up when the registration fires.
+  if (!inTimeoutExpired_ && (!wheelDeadline_ || deadline < *wheelDeadline_)) {
+    registerWheel(deadline);
+  }
+}
+
+bool TimerMultiplexer::isScheduled(
+    const folly::HHWheelTimer::Callback* callback) const {
+  return find(callback) != entries_.end();
+}
+
+void TimerMultiplexer::cancelTimeout(folly::HHWheelTimer::Callback* callback) {
+  auto it = find(callback);
+  if (it == entries_.end()) {
+    return;
+  }
+  entries_.erase(it);
+  if (entries_.empty() && !inTimeoutExpired_ && wheelDeadline_) {
+    wheelDeadline_.clear();
+    folly::HHWheelTimer::Callback::cancelTimeout();
+  }
+}
+
+void TimerMultiplexer::cancelAll() {
+  wheel_ = nullptr;
+  entries_.clear();
+  wheelDeadline_.clear();
+  folly::HHWheelTimer::Callback::cancelTimeout();
+}
+
+std::chrono::milliseconds TimerMultiplexer::getTimeRemaining(
+    const folly::HHWheelTimer::Callback* callback) const {
+  auto it = find(callback);
+  if (it == entries_.end()) {
+    return 0ms;
+  }
+  auto now = Clock::now();
+  if (it->deadline <= now) {
+    return 0ms;
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      it->deadline - now);
+}
+
+void TimerMultiplexer::registerWheel(TimePoint deadline) {
+  DCHECK(wheel_);
+  wheelDeadline_ = deadline;
+  ++numWheelSchedules_;
+  auto now = Clock::now();
+  std::chrono::milliseconds timeout = 0ms;
+  if (deadline > now) {
+    // Round up, the wheel would otherwise wake up a millisecond early.
+    timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - now + 999us);
+  }
+  wheel_->scheduleTimeout(this, timeout);
+}
+
+void TimerMultiplexer::timeoutExpired() noexcept {
+  // The wheel can fire a little before the deadline it was registered for.
+  auto now = std::max(Clock::now(), wheelDeadline_.value_or(TimePoint()));
+  wheelDeadline_.clear();
+
+  std::vector<Entry> expired;
+  for (const auto& entry : entries_) {
+    if (entry.deadline <= now) {
+      expired.push_back(entry);
+    }
+  }
+  std::sort(
+      expired.begin(), expired.end(), [](const Entry& a, const Entry& b) {
+        return a.deadline < b.deadline;
+      });
+
+  bool destroyed = false;
+  destroyed_ = &destroyed;
+  inTimeoutExpired_ = true;
+  // A callback can cancel or reschedule the others, only run the ones that
+  // are still scheduled as they were.
+  for (const auto& entry : expired) {
+    auto it = find(entry.callback);
+    if (it == entries_.end() || it->generation != entry.generation) {
+      continue;
+    }
+    entries_.erase(it);
+    entry.callback->timeoutExpired();
+    if (destroyed) {
+      return;
+    }
+  }
+  destroyed_ = nullptr;
+  inTimeoutExpired_ = false;
+
+  auto earliest = std::min_element(
+      entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+        return a.deadline < b.deadline;
+      });
+  if (earliest != entries_.end()) {
+    registerWheel(earliest->deadline);
+  }
+}
+
+void TimerMultiplexer::callbackCanceled() noexcept {
+  // The wheel is going away, so are all the timeouts on it.
+  wheel_ = nullptr;
+  wheelDeadline_.clear();
+  auto canceled = std::move(entries_);
+  entries_.clear();
+  bool destroyed = false;
+  destroyed_ = &destroyed;
+  for (const auto& entry : canceled) {
+    entry.callback->callbackCanceled();
+    if (destroyed) {
+      return;
+    }
+  }
+  destroyed_ = nullptr;
+}
+} // namespace quic
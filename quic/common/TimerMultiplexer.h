@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/io/async/HHWheelTimer.h>
+#include <quic/QuicConstants.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Runs the timeouts of a connection off a single registration on an
+ * HHWheelTimer. The multiplexer keeps the deadline of every timeout and the
+ * wheel only holds the one it is woken up for, which is moved lazily: a
+ * timeout that is pushed back, like the idle timeout on every packet, or
+ * cancelled doesn't touch the wheel at all, only a deadline earlier than the
+ * registration moves it. When the wheel fires before the earliest deadline
+ * the registration is moved there.
+ *
+ * The timeouts are plain HHWheelTimer callbacks that are never scheduled on
+ * the wheel themselves, so their own isScheduled() is false, ask the
+ * multiplexer instead. They have to be cancelled before they are destroyed.
+ * Not thread-safe, only use it from the thread of the wheel's EventBase.
+ */
+class TimerMultiplexer : private folly::HHWheelTimer::Callback {
+ public:
+  TimerMultiplexer() = default;
+
+  ~TimerMultiplexer() override;
+
+  /**
+   * Runs the callback once timeout has passed. A callback that is already
+   * scheduled is moved. All the callbacks have to use the same wheel, until
+   * cancelAll().
+   */
+  void scheduleTimeout(
+      folly::HHWheelTimer& wheel,
+      folly::HHWheelTimer::Callback* callback,
+      std::chrono::milliseconds timeout);
+
+  bool isScheduled(const folly::HHWheelTimer::Callback* callback) const;
+
+  /**
+   * Does nothing if the callback isn't scheduled. Doesn't call
+   * callbackCanceled(), like HHWheelTimer::Callback::cancelTimeout().
+   */
+  void cancelTimeout(folly::HHWheelTimer::Callback* callback);
+
+  /**
+   * Cancels all the callbacks, and the wheel registration.
+   */
+  void cancelAll();
+
+  /**
+   * 0 if the callback isn't scheduled or is overdue.
+   */
+  std::chrono::milliseconds getTimeRemaining(
+      const folly::HHWheelTimer::Callback* callback) const;
+
+  size_t numScheduled() const {
+    return entries_.size();
+  }
+
+  /**
+   * The number of times the registration on the wheel was made or moved.
+   */
+  uint64_t numWheelSchedules() const {
+    return numWheelSchedules_;
+  }
+
+ private:
+  struct Entry {
+    folly::HHWheelTimer::Callback* callback;
+    TimePoint deadline;
+    // Tells a callback apart from the same callback scheduled again while the
+    // expired ones are being run.
+    uint64_t generation;
+  };
+
+  void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override;
+
+  std::vector<Entry>::iterator find(
+      const folly::HHWheelTimer::Callback* callback);
+  std::vector<Entry>::const_iterator find(
+      const folly::HHWheelTimer::Callback* callback) const;
+  void registerWheel(TimePoint deadline);
+
+  folly::HHWheelTimer* wheel_{nullptr};
+  // A connection only has a handful of timeouts, a linear scan beats a heap.
+  std::vector<Entry> entries_;
+  // The deadline of the wheel registration, if there is one.
+  folly::Optional<TimePoint> wheelDeadline_;
+  uint64_t nextGeneration_{0};
+  bool inTimeoutExpired_{false};
+  // Set while the expired callbacks run, they can destroy the multiplexer.
+  bool* destroyed_{nullptr};
+  uint64_t numWheelSchedules_{0};
+};
+} // namespace quic
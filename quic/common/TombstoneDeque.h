@@ -0,0 +1,531 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+/*
+ * A deque where erasing an element only marks its slot as a tombstone, so that
+ * erasing from the middle is O(1) instead of moving the elements around.
+ * Tombstones at the front are dropped right away, the others are dropped when
+ * the container grows or when they outnumber the live elements, which keeps
+ * iteration linear in the number of live elements. Tombstones keep their
+ * value, so a container sorted by some key stays sorted including the
+ * tombstones, and can be binary searched through the raw slot interface.
+ *
+ * The iterators only visit live elements and are bidirectional. They are
+ * invalidated by whatever invalidates std::deque iterators, except erase(),
+ * which only invalidates iterators to the erased elements.
+ *
+ * The storage is only allocated when the first element is added, and freed
+ * by clear(), since std::deque allocates even when it's empty and most
+ * streams leave some of their queues empty for their whole life.
+ */
+template <typename T>
+class TombstoneDeque {
+ public:
+  struct EmplaceTag {};
+
+  struct Slot {
+    template <typename... Args>
+    explicit Slot(EmplaceTag, Args&&... args)
+        : value(std::forward<Args>(args)...) {}
+
+    T value;
+    bool tombstone{false};
+  };
+
+  using storage_type = std::deque<Slot>;
+  using raw_iterator = typename storage_type::iterator;
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+
+  template <bool Const>
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T*, T*>;
+    using reference = std::conditional_t<Const, const T&, T&>;
+    using storage_pointer =
+        std::conditional_t<Const, const storage_type*, storage_type*>;
+    using underlying_iterator = std::conditional_t<
+        Const,
+        typename storage_type::const_iterator,
+        typename storage_type::iterator>;
+
+    Iterator() = default;
+
+    Iterator(storage_pointer storage, underlying_iterator raw)
+        : storage_(storage), raw_(raw) {}
+
+    // Allow conversion from iterator to const_iterator.
+    template <bool C = Const, typename = std::enable_if_t<C>>
+    /* implicit */ Iterator(const Iterator<false>& other)
+        : storage_(other.storage_), raw_(other.raw_) {}
+
+    reference operator*() const {
+      return raw_->value;
+    }
+
+    pointer operator->() const {
+      return &raw_->value;
+    }
+
+    Iterator& operator++() {
+      do {
+        ++raw_;
+      } while (raw_ != storage_->end() && raw_->tombstone);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    Iterator& operator--() {
+      do {
+        --raw_;
+      } while (raw_ != storage_->begin() && raw_->tombstone);
+      return *this;
+    }
+
+    Iterator operator--(int) {
+      auto tmp = *this;
+      --*this;
+      return tmp;
+    }
+
+    // Linear in n, provided for convenience.
+    Iterator operator+(difference_type n) const {
+      auto tmp = *this;
+      for (; n > 0; --n) {
+        ++tmp;
+      }
+      for (; n < 0; ++n) {
+        --tmp;
+      }
+      return tmp;
+    }
+
+    Iterator operator-(difference_type n) const {
+      return *this + (-n);
+    }
+
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ == rhs.raw_;
+    }
+
+    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ != rhs.raw_;
+    }
+
+    // The slots are ordered, so iterators can still be compared even though
+    // they are not random access.
+    friend bool operator<(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ < rhs.raw_;
+    }
+
+    friend bool operator>(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ > rhs.raw_;
+    }
+
+    friend bool operator<=(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ <= rhs.raw_;
+    }
+
+    friend bool operator>=(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.raw_ >= rhs.raw_;
+    }
+
+    underlying_iterator raw() const {
+      return raw_;
+    }
+
+   private:
+    friend class Iterator<true>;
+    storage_pointer storage_{nullptr};
+    underlying_iterator raw_;
+  };
+
+  TombstoneDeque() = default;
+
+  TombstoneDeque(const TombstoneDeque& other)
+      : storage_(
+            other.storage_ ? std::make_unique<storage_type>(*other.storage_)
+                           : nullptr),
+        tombstones_(other.tombstones_) {}
+
+  TombstoneDeque(TombstoneDeque&& other) noexcept
+      : storage_(std::move(other.storage_)), tombstones_(other.tombstones_) {
+    other.tombstones_ = 0;
+  }
+
+  TombstoneDeque& operator=(const TombstoneDeque& other) {
+    if (this != &other) {
+      *this = TombstoneDeque(other);
+    }
+    return *this;
+  }
+
+  TombstoneDeque& operator=(TombstoneDeque&& other) noexcept {
+    storage_ = std::move(other.storage_);
+    tombstones_ = other.tombstones_;
+    other.tombstones_ = 0;
+    return *this;
+  }
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  size_t size() const {
+    return storage().size() - tombstones_;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  iterator begin() {
+    return iterator(&storage(), firstLive(storage().begin()));
+  }
+
+  const_iterator begin() const {
+    return const_iterator(&storage(), firstLive(storage().begin()));
+  }
+
+  iterator end() {
+    return iterator(&storage(), storage().end());
+  }
+
+  const_iterator end() const {
+    return const_iterator(&storage(), storage().end());
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  T& front() {
+    DCHECK(!empty());
+    return *begin();
+  }
+
+  const T& front() const {
+    DCHECK(!empty());
+    return *begin();
+  }
+
+  T& back() {
+    DCHECK(!empty());
+    return *rbegin();
+  }
+
+  const T& back() const {
+    DCHECK(!empty());
+    return *rbegin();
+  }
+
+  // Linear in the number of tombstones before the element.
+  T& operator[](size_t index) {
+    if (!tombstones_) {
+      return storage_[index].value;
+    }
+    return *(begin() + index);
+  }
+
+  const T& operator[](size_t index) const {
+    if (!tombstones_) {
+      return storage_[index].value;
+    }
+    return *(begin() + index);
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    dropTrailingTombstones();
+    maybeCompact();
+    mutableStorage().emplace_back(EmplaceTag(), std::forward<Args>(args)...);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  /**
+   * Constructs a value before pos. The tombstones right before pos are dropped
+   * so that the value lands right after the previous live element.
+   */
+  template <typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args) {
+    auto index = pos.raw() - storage().cbegin();
+    auto raw = mutableStorage().begin() + index;
+    auto firstTombstone = raw;
+    while (firstTombstone != storage().begin() &&
+           std::prev(firstTombstone)->tombstone) {
+      --firstTombstone;
+    }
+    if (firstTombstone != raw) {
+      tombstones_ -= std::distance(firstTombstone, raw);
+      raw = storage().erase(firstTombstone, raw);
+    }
+    raw = storage().emplace(raw, EmplaceTag(), std::forward<Args>(args)...);
+    return iterator(&storage(), raw);
+  }
+
+  iterator insert(const_iterator pos, T&& value) {
+    return emplace(pos, std::move(value));
+  }
+
+  /**
+   * Erases the element and returns the iterator to the next live element.
+   */
+  iterator erase(const_iterator pos) {
+    auto raw = storage().begin() + (pos.raw() - storage().cbegin());
+    tombstone(raw);
+    auto next = iterator(&storage(), raw);
+    ++next;
+    bool atEnd = next == end();
+    dropLeadingTombstones();
+    return atEnd ? end() : next;
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    auto raw = storage().begin() + (first.raw() - storage().cbegin());
+    auto rawLast = storage().begin() + (last.raw() - storage().cbegin());
+    for (; raw != rawLast; ++raw) {
+      if (!raw->tombstone) {
+        tombstone(raw);
+      }
+    }
+    bool atEnd = rawLast == storage().end();
+    dropLeadingTombstones();
+    return atEnd ? end() : iterator(&storage(), rawLast);
+  }
+
+  void pop_front() {
+    DCHECK(!empty());
+    erase(begin());
+  }
+
+  void pop_back() {
+    DCHECK(!empty());
+    tombstone(std::prev(end()).raw());
+    dropTrailingTombstones();
+  }
+
+  /**
+   * Also frees the storage.
+   */
+  void clear() {
+    storage_.reset();
+    tombstones_ = 0;
+  }
+
+  /**
+   * Binary searches a container sorted by key. Tombstones keep their value, so
+   * this is logarithmic in the number of slots. comp(element, key) has to
+   * return whether element is ordered before key, like for std::lower_bound.
+   */
+  template <typename Key, typename Compare>
+  iterator lowerBound(const Key& key, Compare comp) {
+    auto raw = std::lower_bound(
+        storage().begin(),
+        storage().end(),
+        key,
+        [&](const Slot& slot, const Key& val) {
+          return comp(slot.value, val);
+        });
+    return iterator(&storage(), firstLive(raw));
+  }
+
+  template <typename Key, typename Compare>
+  const_iterator lowerBound(const Key& key, Compare comp) const {
+    auto raw = std::lower_bound(
+        storage().begin(),
+        storage().end(),
+        key,
+        [&](const Slot& slot, const Key& val) {
+          return comp(slot.value, val);
+        });
+    return const_iterator(&storage(), firstLive(raw));
+  }
+
+  /**
+   * comp(key, element) has to return whether key is ordered before element,
+   * like for std::upper_bound.
+   */
+  template <typename Key, typename Compare>
+  iterator upperBound(const Key& key, Compare comp) {
+    auto raw = std::upper_bound(
+        storage().begin(),
+        storage().end(),
+        key,
+        [&](const Key& val, const Slot& slot) {
+          return comp(val, slot.value);
+        });
+    return iterator(&storage(), firstLive(raw));
+  }
+
+  /**
+   * Raw access to all the slots, including the tombstones. Raw iterators are
+   * random access, and are invalidated like std::deque iterators.
+   */
+  raw_iterator rawBegin() {
+    return storage().begin();
+  }
+
+  raw_iterator rawEnd() {
+    return storage().end();
+  }
+
+  /**
+   * Marks a live slot as a tombstone without touching the storage, so all
+   * iterators other than the ones to this slot stay valid.
+   */
+  void tombstone(raw_iterator it) {
+    DCHECK(!it->tombstone);
+    it->tombstone = true;
+    ++tombstones_;
+  }
+
+  /**
+   * Drops all the tombstones, invalidating all the iterators.
+   */
+  void compact() {
+    if (!tombstones_) {
+      return;
+    }
+    storage().erase(
+        std::remove_if(
+            storage().begin(),
+            storage().end(),
+            [](const Slot& slot) { return slot.tombstone; }),
+        storage().end());
+    tombstones_ = 0;
+  }
+
+  /**
+   * Drops all the tombstones once they outnumber the live elements, which
+   * keeps the cost of compaction amortized. Invalidates all the iterators.
+   */
+  void maybeCompact() {
+    dropLeadingTombstones();
+    dropTrailingTombstones();
+    if (tombstones_ > size()) {
+      compact();
+    }
+  }
+
+  size_t numTombstones() const {
+    return tombstones_;
+  }
+
+  /**
+   * Drops all the tombstones and gives the unused memory of the storage back,
+   * freeing it when the container is empty. Invalidates all the iterators.
+   */
+  void shrinkToFit() {
+    if (empty()) {
+      clear();
+      return;
+    }
+    compact();
+    storage().shrink_to_fit();
+  }
+
+ private:
+  template <typename RawIterator>
+  RawIterator firstLive(RawIterator it) const {
+    while (it != storage().end() && it->tombstone) {
+      ++it;
+    }
+    return it;
+  }
+
+  // An empty container shares this storage until something is added, so an
+  // unused one doesn't allocate. It is never modified.
+  static storage_type& emptyStorage() {
+    static storage_type empty;
+    return empty;
+  }
+
+  storage_type& storage() {
+    return storage_ ? *storage_ : emptyStorage();
+  }
+
+  const storage_type& storage() const {
+    return storage_ ? *storage_ : emptyStorage();
+  }
+
+  storage_type& mutableStorage() {
+    if (!storage_) {
+      storage_ = std::make_unique<storage_type>();
+    }
+    return *storage_;
+  }
+
+  void dropLeadingTombstones() {
+    while (!storage().empty() && storage().front().tombstone) {
+      storage().pop_front();
+      --tombstones_;
+    }
+  }
+
+  void dropTrailingTombstones() {
+    while (!storage().empty() && storage().back().tombstone) {
+      storage().pop_back();
+      --tombstones_;
+    }
+  }
+
+  std::unique_ptr<storage_type> storage_;
+  size_t tombstones_{0};
+};
+} // namespace quic
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/WriteScheduler.h>
+
+namespace quic {
+
+void WriteScheduler::Callback::cancelWrite() {
+  if (hook_.is_linked()) {
+    hook_.unlink();
+    if (scheduler_) {
+      scheduler_->onCanceled();
+    }
+  }
+  scheduler_ = nullptr;
+}
+
+void WriteScheduler::Callback::onPacketsWritten(uint64_t packets) {
+  deficit_ -= std::min(deficit_, packets);
+  if (runningIn_) {
+    runningIn_->packetsThisRun_ += packets;
+  }
+}
+
+WriteScheduler::WriteScheduler(
+    folly::EventBase* evb,
+    std::chrono::microseconds timeBudget,
+    uint64_t packetBudget,
+    uint64_t packetQuantum)
+    : evb_(evb),
+      timeBudget_(timeBudget),
+      packetBudget_(packetBudget),
+      packetQuantum_(std::max<uint64_t>(packetQuantum, 1)) {}
+
+WriteScheduler::~WriteScheduler() {
+  for (auto list : {&running_, &ready_}) {
+    while (!list->empty()) {
+      auto& callback = list->front();
+      list->pop_front();
+      callback.scheduler_ = nullptr;
+    }
+  }
+}
+
+void WriteScheduler::schedule(Callback* callback, bool thisIteration) {
+  if (callback->isWriteScheduled()) {
+    return;
+  }
+  callback->scheduler_ = this;
+  ready_.push_back(*callback);
+  ++numScheduled_;
+  if (inLoopCallback_) {
+    // Rescheduled once the current run is over.
+    return;
+  }
+  if (thisIteration && isLoopCallbackScheduled()) {
+    cancelLoopCallback();
+  }
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this, thisIteration);
+  }
+}
+
+void WriteScheduler::onCanceled() {
+  DCHECK_GT(numScheduled_, 0);
+  --numScheduled_;
+  if (numScheduled_ == 0 && !inLoopCallback_) {
+    cancelLoopCallback();
+  }
+}
+
+bool WriteScheduler::runCallback(Callback& callback) noexcept {
+  if (packetBudget_ > 0) {
+    callback.deficit_ += packetQuantum_;
+    callback.allowance_ =
+        std::min(callback.deficit_, packetBudget_ - packetsThisRun_);
+  }
+  callback.runningIn_ = this;
+  current_ = &callback;
+  callback.writeReady();
+  if (!current_) {
+    // Destroyed by its own run.
+    return false;
+  }
+  current_ = nullptr;
+  callback.runningIn_ = nullptr;
+  callback.allowance_.clear();
+  if (!callback.isWriteScheduled()) {
+    callback.deficit_ = 0;
+  }
+  return true;
+}
+
+void WriteScheduler::runLoopCallback() noexcept {
+  ++numRuns_;
+  inLoopCallback_ = true;
+  running_.swap(ready_);
+  auto start = Clock::now();
+  packetsThisRun_ = 0;
+  // A callback can cancel the others, which takes them off the list.
+  while (!running_.empty()) {
+    // Always run one callback, so that every iteration makes progress.
+    auto& callback = running_.front();
+    running_.pop_front();
+    callback.scheduler_ = nullptr;
+    --numScheduled_;
+    bool alive = runCallback(callback);
+    auto timeSpent = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start);
+    bool exhausted = timeSpent >= timeBudget_ ||
+        (packetBudget_ > 0 && packetsThisRun_ >= packetBudget_);
+    if (exhausted && !running_.empty()) {
+      ++numOverBudgetRuns_;
+      if (alive) {
+        callback.writeBudgetExhausted(
+            timeSpent, packetsThisRun_, running_.size());
+      }
+      break;
+    }
+  }
+  // What didn't run goes ahead of what was queued in the meantime.
+  running_.splice(running_.end(), ready_);
+  running_.swap(ready_);
+  inLoopCallback_ = false;
+  if (numScheduled_ > 0) {
+    evb_->runInLoop(this);
+  }
+}
+} // namespace quic
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/IntrusiveList.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+
+#include <memory>
+
+namespace quic {
+
+/**
+ * Runs the write loops of all the transports of a worker from a single
+ * EventBase loop callback, instead of one loop callback per transport.
+ *
+ * The transports ready to write wait in a FIFO queue. Each loop iteration
+ * runs the ones that were queued before it started, in order, until
+ * timeBudget has been spent or packetBudget packets have been written. The
+ * rest keep their place and go first in the next iteration, so that a worker
+ * with many busy connections still gets back to its reads and acks. A
+ * transport queued while the scheduler runs, by its own write loop or another
+ * one, waits for the next iteration.
+ *
+ * With a packet budget, the packets are shared with deficit round robin: each
+ * run of a callback adds packetQuantum to its deficit, and it can write as
+ * many packets as its deficit. What it doesn't use carries over while it
+ * stays queued, and is dropped when it goes idle.
+ *
+ * Not thread-safe, only use it from the thread of its EventBase.
+ */
+class WriteScheduler : private folly::EventBase::LoopCallback {
+ public:
+  using SharedPtr = std::shared_ptr<WriteScheduler>;
+
+  class Callback {
+   public:
+    virtual ~Callback() {
+      cancelWrite();
+      if (runningIn_) {
+        runningIn_->current_ = nullptr;
+      }
+    }
+
+    virtual void writeReady() noexcept = 0;
+
+    bool isWriteScheduled() const {
+      return hook_.is_linked();
+    }
+
+    void cancelWrite();
+
+    /**
+     * Called on the callback whose run used up the budget of an iteration,
+     * with what was spent in the iteration and the number of callbacks left
+     * for the next one.
+     */
+    virtual void writeBudgetExhausted(
+        std::chrono::microseconds /* timeSpent */,
+        uint64_t /* packetsWritten */,
+        size_t /* numDeferred */) noexcept {}
+
+    /**
+     * While writeReady() runs, the most packets the callback can write, none
+     * without a packet budget.
+     */
+    folly::Optional<uint64_t> writePacketAllowance() const {
+      return allowance_;
+    }
+
+    /**
+     * Reports the packets written by the current run of writeReady().
+     */
+    void onPacketsWritten(uint64_t packets);
+
+   private:
+    friend class WriteScheduler;
+
+    folly::IntrusiveListHook hook_;
+    WriteScheduler* scheduler_{nullptr};
+    // The scheduler running the callback.
+    WriteScheduler* runningIn_{nullptr};
+    uint64_t deficit_{0};
+    folly::Optional<uint64_t> allowance_;
+  };
+
+  /**
+   * A packetBudget of 0 doesn't limit the packets.
+   */
+  explicit WriteScheduler(
+      folly::EventBase* evb,
+      std::chrono::microseconds timeBudget = kDefaultWriteSchedulerTimeBudget,
+      uint64_t packetBudget = 0,
+      uint64_t packetQuantum = kDefaultWriteConnectionDataPacketLimit);
+
+  ~WriteScheduler() override;
+
+  /**
+   * Queues the callback, to run in the current loop iteration if
+   * thisIteration is set and the scheduler isn't already running in it. A
+   * callback that is already queued keeps its place.
+   */
+  void schedule(Callback* callback, bool thisIteration = false);
+
+  size_t numScheduled() const {
+    return numScheduled_;
+  }
+
+  /**
+   * The number of loop iterations the scheduler ran callbacks in, and how
+   * many of them ran out of budget before running all the ready callbacks.
+   */
+  uint64_t numRuns() const {
+    return numRuns_;
+  }
+
+  uint64_t numOverBudgetRuns() const {
+    return numOverBudgetRuns_;
+  }
+
+ private:
+  using CallbackList = folly::IntrusiveList<Callback, &Callback::hook_>;
+
+  void runLoopCallback() noexcept override;
+  void onCanceled();
+  // Returns false if the callback was destroyed by its run.
+  bool runCallback(Callback& callback) noexcept;
+
+  folly::EventBase* evb_;
+  const std::chrono::microseconds timeBudget_;
+  const uint64_t packetBudget_;
+  const uint64_t packetQuantum_;
+  // The callback being run, cleared if it is destroyed while running.
+  Callback* current_{nullptr};
+  uint64_t packetsThisRun_{0};
+  CallbackList ready_;
+  // The callbacks of the iteration being run.
+  CallbackList running_;
+  size_t numScheduled_{0};
+  bool inLoopCallback_{false};
+  uint64_t numRuns_{0};
+  uint64_t numOverBudgetRuns_{0};
+};
+} // namespace quic
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/BufferPool.h>
+#include <quic/QuicConstants.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+
+namespace quic {
+namespace test {
+
+TEST(BufferPoolTest, BuffersAreRecycled) {
+  BufferPool pool(1500, 4);
+  auto buf = pool.getBuffer();
+  EXPECT_EQ(buf->length(), 0);
+  EXPECT_EQ(buf->tailroom(), 1500);
+  EXPECT_EQ(pool.outstandingBuffers(), 1);
+  auto data = buf->data();
+  buf.reset();
+  EXPECT_EQ(pool.outstandingBuffers(), 0);
+  EXPECT_EQ(pool.pooledBuffers(), 1);
+
+  auto buf2 = pool.getBuffer();
+  EXPECT_EQ(buf2->data(), data);
+  EXPECT_EQ(pool.pooledBuffers(), 0);
+}
+
+TEST(BufferPoolTest, HighWaterMark) {
+  BufferPool pool(100, 4);
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs;
+  for (int i = 0; i < 6; ++i) {
+    bufs.push_back(pool.getBuffer());
+  }
+  EXPECT_EQ(pool.highWaterMark(), 6);
+  bufs.clear();
+  // Only up to maxPooledBuffers are kept.
+  EXPECT_EQ(pool.pooledBuffers(), 4);
+  EXPECT_EQ(pool.outstandingBuffers(), 0);
+  EXPECT_EQ(pool.highWaterMark(), 6);
+}
+
+TEST(BufferPoolTest, ReleaseOnOtherThread) {
+  BufferPool pool(100, 4);
+  auto buf = pool.getBuffer();
+  std::thread t([buf = std::move(buf)]() mutable { buf.reset(); });
+  t.join();
+  EXPECT_EQ(pool.outstandingBuffers(), 0);
+  EXPECT_EQ(pool.pooledBuffers(), 0);
+}
+
+TEST(BufferPoolTest, BufferOutlivesPool) {
+  std::unique_ptr<folly::IOBuf> buf;
+  {
+    BufferPool pool(100, 4);
+    buf = pool.getBuffer();
+    buf->append(10);
+  }
+  EXPECT_EQ(buf->length(), 10);
+  buf.reset();
+}
+
+TEST(BufferPoolTest, BuffersComeFromRegionFirst) {
+  BufferPool pool(1000, 0, 1);
+  // Rounded up to a huge page of 1024 byte slots.
+  ASSERT_EQ(pool.regionBuffers(), kHugePageSize / 1024);
+  std::vector<std::unique_ptr<folly::IOBuf>> bufs;
+  for (size_t i = 0; i < pool.regionBuffers() + 1; ++i) {
+    bufs.push_back(pool.getBuffer());
+    EXPECT_EQ(bufs.back()->tailroom(), 1000);
+  }
+  EXPECT_EQ(bufs[1]->data(), bufs[0]->data() + 1024);
+  bufs.clear();
+  // The region buffers go back to the pool even though it keeps no others.
+  EXPECT_EQ(pool.pooledBuffers(), pool.regionBuffers());
+}
+
+TEST(BufferPoolTest, RegionBufferOutlivesPool) {
+  std::unique_ptr<folly::IOBuf> buf;
+  {
+    BufferPool pool(100, 4, kHugePageSize);
+    ASSERT_GT(pool.regionBuffers(), 0);
+    buf = pool.getBuffer();
+    buf->append(10);
+  }
+  memset(buf->writableData(), 0, buf->length());
+  EXPECT_EQ(buf->length(), 10);
+  buf.reset();
+}
+
+TEST(BufferPoolTest, EventBasePool) {
+  folly::EventBase evb;
+  auto pool = BufferPool::getForEventBase(&evb, 100, 4);
+  ASSERT_NE(pool, nullptr);
+  EXPECT_EQ(BufferPool::getForEventBase(&evb, 100, 4), pool);
+  EXPECT_EQ(BufferPool::getForEventBase(&evb, 200, 4), nullptr);
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/test/EmulatedLink.h>
+
+#include <folly/io/Cursor.h>
+
+#include <glog/logging.h>
+
+#include <vector>
+
+namespace quic {
+namespace test {
+
+constexpr std::chrono::microseconds EmulatedLink::kTimerTick;
+
+/**
+ * Hands what is written to the link, and what the link delivers to the read
+ * callback. Everything that configures a real socket is ignored.
+ */
+class EmulatedLink::EmulatedSocket : public folly::AsyncUDPSocket {
+ public:
+  EmulatedSocket(std::shared_ptr<EmulatedLink> link, size_t endpoint)
+      : folly::AsyncUDPSocket(link->evb_),
+        link_(std::move(link)),
+        endpoint_(endpoint) {
+    CHECK(!link_->endpoints_[endpoint_].socket);
+    link_->endpoints_[endpoint_].socket = this;
+  }
+
+  ~EmulatedSocket() override {
+    link_->endpoints_[endpoint_].socket = nullptr;
+  }
+
+  bool deliver(const folly::SocketAddress& from, const folly::IOBuf& data) {
+    if (!readCallback_) {
+      return false;
+    }
+    void* buf = nullptr;
+    size_t len = 0;
+    readCallback_->getReadBuffer(&buf, &len);
+    if (!buf || !len) {
+      return false;
+    }
+    auto size = data.computeChainDataLength();
+    auto copied = std::min(size, len);
+    folly::io::Cursor(&data).pull(buf, copied);
+    readCallback_->onDataAvailable(from, copied, copied < size);
+    return true;
+  }
+
+  const folly::SocketAddress& address() const override {
+    return link_->endpoints_[endpoint_].address;
+  }
+
+  void bind(const folly::SocketAddress& /* address */) override {}
+
+  ssize_t write(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf) override {
+    auto size = buf->computeChainDataLength();
+    link_->send(endpoint_, address, buf->clone());
+    return size;
+  }
+
+  ssize_t writeGSO(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>& buf,
+      int gso) override {
+    if (gso <= 0) {
+      return write(address, buf);
+    }
+    // The segments are separate packets on the link, like the kernel splits
+    // them.
+    auto size = buf->computeChainDataLength();
+    folly::io::Cursor cursor(buf.get());
+    while (!cursor.isAtEnd()) {
+      std::unique_ptr<folly::IOBuf> segment;
+      cursor.clone(segment, std::min<size_t>(gso, cursor.totalLength()));
+      link_->send(endpoint_, address, std::move(segment));
+    }
+    return size;
+  }
+
+  int writem(
+      const folly::SocketAddress& address,
+      const std::unique_ptr<folly::IOBuf>* bufs,
+      size_t count) override {
+    for (size_t i = 0; i < count; ++i) {
+      write(address, bufs[i]);
+    }
+    return static_cast<int>(count);
+  }
+
+  void resumeRead(ReadCallback* cob) override {
+    readCallback_ = cob;
+  }
+
+  void pauseRead() override {
+    readCallback_ = nullptr;
+  }
+
+  void close() override {
+    readCallback_ = nullptr;
+  }
+
+  folly::NetworkSocket getNetworkSocket() const override {
+    return folly::NetworkSocket();
+  }
+
+  bool isBound() const override {
+    return true;
+  }
+
+  int connect(const folly::SocketAddress& /* address */) override {
+    return 0;
+  }
+
+  void setErrMessageCallback(
+      ErrMessageCallback* /* errMessageCallback */) override {}
+
+  void setReuseAddr(bool /* reuseAddr */) override {}
+
+  void dontFragment(bool /* df */) override {}
+
+  void setDFAndTurnOffPMTU() override {}
+
+ private:
+  std::shared_ptr<EmulatedLink> link_;
+  size_t endpoint_;
+  ReadCallback* readCallback_{nullptr};
+};
+
+EmulatedLink::EmulatedLink(
+    folly::EventBase* evb,
+    const folly::SocketAddress& addressA,
+    const folly::SocketAddress& addressB,
+    Options options)
+    : evb_(evb), timer_(TimerHighRes::newTimer(evb, kTimerTick)) {
+  CHECK_NE(addressA, addressB);
+  endpoints_[0].address = addressA;
+  endpoints_[1].address = addressB;
+  setOptions(addressA, options);
+  setOptions(addressB, options);
+}
+
+EmulatedLink::~EmulatedLink() {
+  cancelTimeout();
+}
+
+std::unique_ptr<folly::AsyncUDPSocket> EmulatedLink::makeSocket(
+    const folly::SocketAddress& address) {
+  return std::make_unique<EmulatedSocket>(
+      shared_from_this(), endpointIndex(address));
+}
+
+void EmulatedLink::setOptions(
+    const folly::SocketAddress& from,
+    Options options) {
+  auto& direction = endpoints_[endpointIndex(from)].out;
+  direction.random.seed(options.seed);
+  direction.options = options;
+}
+
+const EmulatedLink::Stats& EmulatedLink::getStats(
+    const folly::SocketAddress& from) const {
+  return endpoints_[endpointIndex(from)].out.stats;
+}
+
+size_t EmulatedLink::endpointIndex(const folly::SocketAddress& address) const {
+  for (size_t i = 0; i < endpoints_.size(); ++i) {
+    if (endpoints_[i].address == address) {
+      return i;
+    }
+  }
+  LOG(FATAL) << address.describe() << " is not an end of the link";
+  folly::assume_unreachable();
+}
+
+void EmulatedLink::send(
+    size_t from,
+    const folly::SocketAddress& to,
+    std::unique_ptr<folly::IOBuf> data) {
+  size_t peer = 1 - from;
+  if (to != endpoints_[peer].address) {
+    // Nothing at that address.
+    return;
+  }
+  auto& direction = endpoints_[from].out;
+  const auto& options = direction.options;
+  ++direction.stats.packetsSent;
+  std::uniform_real_distribution<double> chance(0, 1);
+  if (options.lossRate > 0 && chance(direction.random) < options.lossRate) {
+    ++direction.stats.packetsLost;
+    return;
+  }
+  auto now = Clock::now();
+  auto departure = now;
+  if (options.bandwidth) {
+    auto size = data->computeChainDataLength();
+    auto start = std::max(now, direction.busyUntil);
+    uint64_t waiting =
+        std::chrono::duration_cast<std::chrono::microseconds>(start - now)
+            .count();
+    auto queued = waiting * options.bandwidth / 1000000;
+    if (options.queueSize && queued + size > options.queueSize) {
+      ++direction.stats.packetsDropped;
+      return;
+    }
+    direction.busyUntil =
+        start + std::chrono::microseconds(size * 1000000 / options.bandwidth);
+    departure = direction.busyUntil;
+  }
+  auto arrival = departure + options.delay;
+  if (options.jitter.count() > 0) {
+    std::uniform_int_distribution<int64_t> jitter(0, options.jitter.count());
+    arrival += std::chrono::microseconds(jitter(direction.random));
+  }
+  if (options.reorderRate > 0 &&
+      chance(direction.random) < options.reorderRate) {
+    ++direction.stats.packetsReordered;
+    arrival += options.reorderDelay;
+  }
+  packets_.emplace(arrival, Packet{peer, std::move(data)});
+  scheduleDelivery();
+}
+
+void EmulatedLink::scheduleDelivery() {
+  if (packets_.empty()) {
+    cancelTimeout();
+    nextDelivery_.clear();
+    return;
+  }
+  auto next = packets_.begin()->first;
+  if (nextDelivery_ && *nextDelivery_ <= next && isScheduled()) {
+    return;
+  }
+  cancelTimeout();
+  nextDelivery_ = next;
+  auto timeout = std::max(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          next - Clock::now()),
+      std::chrono::microseconds(0));
+  timer_->scheduleTimeout(this, timeout);
+}
+
+void EmulatedLink::timeoutExpired() noexcept {
+  nextDelivery_.clear();
+  // What the ends send while the packets are delivered arrives later.
+  auto end = packets_.upper_bound(Clock::now());
+  std::vector<Packet> due;
+  for (auto it = packets_.begin(); it != end; ++it) {
+    due.push_back(std::move(it->second));
+  }
+  packets_.erase(packets_.begin(), end);
+  // Keep the link alive if an end closes while reading.
+  auto self = shared_from_this();
+  for (auto& packet : due) {
+    auto& endpoint = endpoints_[packet.to];
+    auto& stats = endpoints_[1 - packet.to].out.stats;
+    auto size = packet.data->computeChainDataLength();
+    if (endpoint.socket &&
+        endpoint.socket->deliver(
+            endpoints_[1 - packet.to].address, *packet.data)) {
+      ++stats.packetsDelivered;
+      stats.bytesDelivered += size;
+    }
+  }
+  scheduleDelivery();
+}
+} // namespace test
+} // namespace quic
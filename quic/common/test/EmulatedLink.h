@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+#include <quic/common/Timers.h>
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+
+namespace quic {
+namespace test {
+
+/**
+ * An emulated network path between two addresses, for end to end tests of
+ * the transports that need loss, delay or reordering without netem. The
+ * sockets it makes look like UDP sockets to the transports, what is written
+ * to one of them is read from the other after going through the link in that
+ * direction:
+ *
+ * - with a bandwidth, the packets are serialized at that rate, and those
+ *   that don't fit in the queue in front of the link are dropped,
+ * - they are lost with lossRate,
+ * - they arrive after the delay plus a jitter drawn in [0, jitter],
+ * - a reorderRate of them is held back by reorderDelay more.
+ *
+ * The random decisions come from a generator seeded by the options, so the
+ * same sequence of packets sees the same losses in every run. The packets
+ * are delivered from a timer of the EventBase, which both ends have to use,
+ * and the link has to be owned by a shared_ptr.
+ * The sockets don't have a file descriptor, so the transports must not be
+ * configured for batched reads, GRO, ECN, tx time pacing or zero copy.
+ */
+class EmulatedLink : public std::enable_shared_from_this<EmulatedLink>,
+                     private TimerHighRes::Callback {
+ public:
+  struct Options {
+    // Bytes per second, 0 for no limit.
+    uint64_t bandwidth{0};
+    std::chrono::microseconds delay{0};
+    std::chrono::microseconds jitter{0};
+    // Between 0 and 1.
+    double lossRate{0};
+    double reorderRate{0};
+    std::chrono::microseconds reorderDelay{0};
+    // Bytes waiting to be serialized when there is a bandwidth, 0 for no
+    // limit.
+    uint64_t queueSize{0};
+    uint32_t seed{1};
+  };
+
+  struct Stats {
+    uint64_t packetsSent{0};
+    uint64_t packetsLost{0};
+    // Dropped because the queue was full.
+    uint64_t packetsDropped{0};
+    uint64_t packetsReordered{0};
+    uint64_t packetsDelivered{0};
+    uint64_t bytesDelivered{0};
+  };
+
+  static constexpr std::chrono::microseconds kTimerTick{100};
+
+  /**
+   * The link starts with the same options in both directions.
+   */
+  EmulatedLink(
+      folly::EventBase* evb,
+      const folly::SocketAddress& addressA,
+      const folly::SocketAddress& addressB,
+      Options options);
+
+  ~EmulatedLink() override;
+
+  /**
+   * The socket bound to one of the two addresses of the link. There can be
+   * one at a time for each address, the socket keeps the link alive.
+   */
+  std::unique_ptr<folly::AsyncUDPSocket> makeSocket(
+      const folly::SocketAddress& address);
+
+  /**
+   * Changes the options of the packets sent from the address. The packets
+   * already on the link keep their arrival time.
+   */
+  void setOptions(const folly::SocketAddress& from, Options options);
+
+  const Stats& getStats(const folly::SocketAddress& from) const;
+
+ private:
+  class EmulatedSocket;
+
+  struct Direction {
+    Options options;
+    std::mt19937 random;
+    // When the packets waiting for the bandwidth are all on the link.
+    TimePoint busyUntil;
+    Stats stats;
+  };
+
+  struct Endpoint {
+    folly::SocketAddress address;
+    EmulatedSocket* socket{nullptr};
+    // The packets sent from this endpoint.
+    Direction out;
+  };
+
+  struct Packet {
+    size_t to;
+    std::unique_ptr<folly::IOBuf> data;
+  };
+
+  size_t endpointIndex(const folly::SocketAddress& address) const;
+
+  void send(
+      size_t from,
+      const folly::SocketAddress& to,
+      std::unique_ptr<folly::IOBuf> data);
+
+  void scheduleDelivery();
+
+  void timeoutExpired() noexcept override;
+
+  void callbackCanceled() noexcept override {}
+
+  folly::EventBase* evb_;
+  TimerHighRes::SharedPtr timer_;
+  std::array<Endpoint, 2> endpoints_;
+  // By arrival time, in the order they were sent for the same time.
+  std::multimap<TimePoint, Packet> packets_;
+  folly::Optional<TimePoint> nextDelivery_;
+};
+} // namespace test
+} // namespace quic
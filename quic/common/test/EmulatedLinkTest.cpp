@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/test/EmulatedLink.h>
+
+#include <folly/io/Cursor.h>
+#include <gtest/gtest.h>
+
+#include <quic/client/QuicClientTransport.h>
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/server/QuicServerTransport.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+// Records the payloads of the datagrams read from a socket, which start with
+// their index.
+class Reader : public folly::AsyncUDPSocket::ReadCallback {
+ public:
+  void getReadBuffer(void** buf, size_t* len) noexcept override {
+    *buf = buf_.data();
+    *len = buf_.size();
+  }
+
+  void onDataAvailable(
+      const folly::SocketAddress& /* client */,
+      size_t len,
+      bool truncated) noexcept override {
+    CHECK(!truncated);
+    sizes.push_back(len);
+    indexes.push_back(
+        folly::io::Cursor(folly::IOBuf::wrapBuffer(buf_.data(), len).get())
+            .readBE<uint32_t>());
+    times.push_back(Clock::now());
+  }
+
+  void onReadError(const folly::AsyncSocketException&) noexcept override {}
+
+  void onReadClosed() noexcept override {}
+
+  std::vector<size_t> sizes;
+  std::vector<uint32_t> indexes;
+  std::vector<TimePoint> times;
+
+ private:
+  std::array<uint8_t, kDefaultUDPReadBufferSize> buf_;
+};
+
+std::unique_ptr<folly::IOBuf> makeDatagram(uint32_t index, size_t size) {
+  auto buf = folly::IOBuf::create(size);
+  memset(buf->writableData(), 0, size);
+  buf->append(size);
+  folly::io::RWPrivateCursor(buf.get()).writeBE<uint32_t>(index);
+  return buf;
+}
+} // namespace
+
+class EmulatedLinkTest : public Test {
+ public:
+  void makeLink(EmulatedLink::Options options) {
+    link_ = std::make_shared<EmulatedLink>(
+        &evb_, addressA_, addressB_, options);
+    socketA_ = link_->makeSocket(addressA_);
+    socketB_ = link_->makeSocket(addressB_);
+    socketB_->resumeRead(&reader_);
+  }
+
+  void send(size_t numDatagrams, size_t size = 100) {
+    for (size_t i = 0; i < numDatagrams; ++i) {
+      socketA_->write(addressB_, makeDatagram(i, size));
+    }
+  }
+
+  void loopFor(std::chrono::milliseconds duration) {
+    evb_.runAfterDelay([&] { evb_.terminateLoopSoon(); }, duration.count());
+    evb_.loopForever();
+  }
+
+ protected:
+  folly::EventBase evb_;
+  folly::SocketAddress addressA_{"10.0.0.1", 1000};
+  folly::SocketAddress addressB_{"10.0.0.2", 2000};
+  std::shared_ptr<EmulatedLink> link_;
+  std::unique_ptr<folly::AsyncUDPSocket> socketA_;
+  std::unique_ptr<folly::AsyncUDPSocket> socketB_;
+  Reader reader_;
+};
+
+TEST_F(EmulatedLinkTest, Delay) {
+  EmulatedLink::Options options;
+  options.delay = std::chrono::milliseconds(20);
+  makeLink(options);
+  EXPECT_EQ(addressA_, socketA_->address());
+  auto sent = Clock::now();
+  send(1);
+  loopFor(std::chrono::milliseconds(5));
+  EXPECT_TRUE(reader_.indexes.empty());
+  loopFor(std::chrono::milliseconds(50));
+  ASSERT_EQ(1, reader_.indexes.size());
+  EXPECT_GE(reader_.times[0] - sent, options.delay);
+  EXPECT_EQ(1, link_->getStats(addressA_).packetsDelivered);
+  EXPECT_EQ(100, link_->getStats(addressA_).bytesDelivered);
+  EXPECT_EQ(0, link_->getStats(addressB_).packetsSent);
+}
+
+TEST_F(EmulatedLinkTest, LossIsDeterministic) {
+  EmulatedLink::Options options;
+  options.lossRate = 0.2;
+  options.seed = 42;
+  makeLink(options);
+  send(1000);
+  loopFor(std::chrono::milliseconds(20));
+  const auto& stats = link_->getStats(addressA_);
+  EXPECT_EQ(1000, stats.packetsSent);
+  EXPECT_EQ(1000, stats.packetsLost + stats.packetsDelivered);
+  EXPECT_GT(stats.packetsLost, 100);
+  EXPECT_LT(stats.packetsLost, 300);
+  auto firstRun = reader_.indexes;
+
+  socketA_.reset();
+  socketB_.reset();
+  reader_.indexes.clear();
+  makeLink(options);
+  send(1000);
+  loopFor(std::chrono::milliseconds(20));
+  EXPECT_EQ(firstRun, reader_.indexes);
+}
+
+TEST_F(EmulatedLinkTest, BandwidthAndQueue) {
+  EmulatedLink::Options options;
+  // 1000 bytes per ms.
+  options.bandwidth = 1000000;
+  options.queueSize = 10000;
+  makeLink(options);
+  auto sent = Clock::now();
+  send(100, 1000);
+  const auto& stats = link_->getStats(addressA_);
+  // The queue holds ten of them, counting the one being serialized.
+  EXPECT_EQ(90, stats.packetsDropped);
+  loopFor(std::chrono::milliseconds(50));
+  ASSERT_EQ(10, reader_.indexes.size());
+  for (uint32_t i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, reader_.indexes[i]);
+  }
+  EXPECT_GE(reader_.times.back() - sent, std::chrono::milliseconds(10));
+}
+
+TEST_F(EmulatedLinkTest, Reordering) {
+  EmulatedLink::Options options;
+  options.delay = std::chrono::milliseconds(1);
+  options.reorderRate = 0.5;
+  options.reorderDelay = std::chrono::milliseconds(5);
+  makeLink(options);
+  send(100);
+  loopFor(std::chrono::milliseconds(30));
+  ASSERT_EQ(100, reader_.indexes.size());
+  EXPECT_GT(link_->getStats(addressA_).packetsReordered, 0);
+  EXPECT_FALSE(std::is_sorted(reader_.indexes.begin(), reader_.indexes.end()));
+  auto indexes = reader_.indexes;
+  std::sort(indexes.begin(), indexes.end());
+  for (uint32_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, indexes[i]);
+  }
+}
+
+TEST_F(EmulatedLinkTest, GSOSegments) {
+  makeLink(EmulatedLink::Options());
+  auto buf = makeDatagram(0, 1200);
+  buf->prependChain(makeDatagram(1, 1200));
+  buf->prependChain(makeDatagram(2, 600));
+  EXPECT_EQ(3000, socketA_->writeGSO(addressB_, buf, 1200));
+  loopFor(std::chrono::milliseconds(5));
+  EXPECT_EQ(std::vector<size_t>({1200, 1200, 600}), reader_.sizes);
+  EXPECT_EQ(std::vector<uint32_t>({0, 1, 2}), reader_.indexes);
+}
+
+TEST_F(EmulatedLinkTest, NotReading) {
+  makeLink(EmulatedLink::Options());
+  socketB_->pauseRead();
+  send(1);
+  loopFor(std::chrono::milliseconds(5));
+  EXPECT_TRUE(reader_.indexes.empty());
+  EXPECT_EQ(0, link_->getStats(addressA_).packetsDelivered);
+}
+
+struct TransferParams {
+  CongestionControlType congestionControlType;
+  bool pacing;
+};
+
+/**
+ * A client uploads to a server transport over a lossy link with limited
+ * bandwidth, the upload has to recover from the losses.
+ */
+class EmulatedTransferTest : public TestWithParam<TransferParams>,
+                             public QuicSocket::ConnectionCallback,
+                             public QuicSocket::ReadCallback,
+                             public folly::AsyncUDPSocket::ReadCallback {
+ public:
+  void SetUp() override {
+    EmulatedLink::Options options;
+    options.bandwidth = 10 * 1000 * 1000;
+    options.delay = std::chrono::milliseconds(10);
+    options.jitter = std::chrono::milliseconds(1);
+    options.lossRate = 0.01;
+    options.queueSize = 100 * 1000;
+    link_ = std::make_shared<EmulatedLink>(
+        &evb_, clientAddr_, serverAddr_, options);
+
+    client_ = std::make_shared<QuicClientTransport>(
+        &evb_, link_->makeSocket(clientAddr_));
+    client_->setHostname("Fizz");
+    client_->setCertificateVerifier(createTestCertificateVerifier());
+    client_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    client_->addNewPeerAddress(serverAddr_);
+    TransportSettings clientSettings;
+    clientSettings.defaultCongestionController =
+        GetParam().congestionControlType;
+    clientSettings.pacingEnabled = GetParam().pacing;
+    client_->setTransportSettings(clientSettings);
+    if (GetParam().pacing) {
+      client_->setPacingTimer(TimerHighRes::newTimer(
+          &evb_, clientSettings.pacingTimerTickInterval));
+    }
+
+    auto serverSock = link_->makeSocket(serverAddr_);
+    serverSock->resumeRead(this);
+    server_ = QuicServerTransport::make(
+        &evb_, std::move(serverSock), *this, createServerCtx());
+    server_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    server_->setSupportedVersions(
+        {QuicVersion::MVFST, QuicVersion::QUIC_DRAFT});
+    server_->setOriginalPeerAddress(clientAddr_);
+    TransportSettings serverSettings;
+    serverSettings.statelessResetTokenSecret = getRandSecret();
+    server_->setTransportSettings(serverSettings);
+    server_->setConnectionIdAlgo(&connIdAlgo_);
+    server_->setServerConnectionIdParams(ServerConnectionIdParams(0, 0, 0));
+    server_->setClientConnectionId(*client_->getState()->clientConnectionId);
+    server_->accept();
+  }
+
+  void TearDown() override {
+    client_->closeNow(folly::none);
+    server_->closeNow(folly::none);
+  }
+
+  // folly::AsyncUDPSocket::ReadCallback of the server's socket
+  void getReadBuffer(void** buf, size_t* len) noexcept override {
+    readBuffer_ = folly::IOBuf::create(kDefaultUDPReadBufferSize);
+    *buf = readBuffer_->writableData();
+    *len = kDefaultUDPReadBufferSize;
+  }
+
+  void onDataAvailable(
+      const folly::SocketAddress& client,
+      size_t len,
+      bool /* truncated */) noexcept override {
+    readBuffer_->append(len);
+    server_->onNetworkData(
+        client, NetworkData(std::move(readBuffer_), Clock::now()));
+  }
+
+  void onReadError(const folly::AsyncSocketException&) noexcept override {}
+
+  void onReadClosed() noexcept override {}
+
+  // QuicSocket::ConnectionCallback of both transports
+  void onTransportReady() noexcept override {
+    auto stream = client_->createBidirectionalStream();
+    ASSERT_FALSE(stream.hasError());
+    auto data = folly::IOBuf::create(kUploadSize);
+    data->append(kUploadSize);
+    ASSERT_FALSE(
+        client_->writeChain(*stream, std::move(data), true, false).hasError());
+  }
+
+  void onNewBidirectionalStream(StreamId id) noexcept override {
+    server_->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(StreamId) noexcept override {}
+
+  void onStopSending(StreamId, ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {}
+
+  void onConnectionError(
+      std::pair<QuicErrorCode, std::string> error) noexcept override {
+    ADD_FAILURE() << toString(error.first) << " " << error.second;
+    evb_.terminateLoopSoon();
+  }
+
+  // QuicSocket::ReadCallback of the server's stream
+  void readAvailable(StreamId id) noexcept override {
+    auto res = server_->read(id, 0);
+    ASSERT_FALSE(res.hasError());
+    if (res->first) {
+      received_ += res->first->computeChainDataLength();
+    }
+    if (res->second) {
+      done_ = true;
+      evb_.terminateLoopSoon();
+    }
+  }
+
+  void readError(
+      StreamId,
+      std::pair<QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    ADD_FAILURE() << toString(error);
+  }
+
+ protected:
+  static constexpr size_t kUploadSize = 1000 * 1000;
+
+  folly::EventBase evb_;
+  folly::SocketAddress clientAddr_{"10.0.0.1", 1000};
+  folly::SocketAddress serverAddr_{"10.0.0.2", 443};
+  DefaultConnectionIdAlgo connIdAlgo_;
+  std::shared_ptr<EmulatedLink> link_;
+  std::shared_ptr<QuicClientTransport> client_;
+  QuicServerTransport::Ptr server_;
+  std::unique_ptr<folly::IOBuf> readBuffer_;
+  size_t received_{0};
+  bool done_{false};
+};
+
+constexpr size_t EmulatedTransferTest::kUploadSize;
+
+TEST_P(EmulatedTransferTest, UploadRecoversFromLosses) {
+  client_->start(this);
+  evb_.runAfterDelay([&] { evb_.terminateLoopSoon(); }, 20000);
+  evb_.loopForever();
+  EXPECT_TRUE(done_);
+  EXPECT_EQ(kUploadSize, received_);
+  const auto& stats = link_->getStats(clientAddr_);
+  EXPECT_GT(stats.packetsLost, 0);
+  EXPECT_GT(client_->getTransportInfo().totalBytesRetransmitted, 0);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    EmulatedTransferTests,
+    EmulatedTransferTest,
+    Values(
+        TransferParams{CongestionControlType::NewReno, false},
+        TransferParams{CongestionControlType::Cubic, false},
+        TransferParams{CongestionControlType::Copa, true},
+        TransferParams{CongestionControlType::BBR, true}));
+} // namespace test
+} // namespace quic
@@ -9,6 +9,8 @@
 #include <quic/common/FunctionLooper.h>
 #include <gtest/gtest.h>
 
+#include <thread>
+
 using namespace std;
 using namespace folly;
 using namespace testing;
@@ -46,6 +48,26 @@ TEST(FunctionLooperTest, LooperStarted) {
   EXPECT_TRUE(called);
 }
 
+TEST(FunctionLooperTest, LooperReportsLag) {
+  EventBase evb;
+  auto func = [&](bool) {};
+  FunctionLooper::Ptr looper(
+      new FunctionLooper(&evb, std::move(func), LooperType::WriteLooper));
+  std::vector<std::chrono::microseconds> lags;
+  looper->setLagCallback(
+      [&](std::chrono::microseconds lag) { lags.push_back(lag); });
+  looper->run();
+  std::this_thread::sleep_for(2ms);
+  evb.loopOnce();
+  ASSERT_EQ(1, lags.size());
+  EXPECT_GE(lags[0], 2ms);
+  evb.loopOnce();
+  EXPECT_EQ(2, lags.size());
+  looper->stop();
+  evb.loopOnce();
+  EXPECT_EQ(2, lags.size());
+}
+
 TEST(FunctionLooperTest, LooperStopped) {
   EventBase evb;
   bool called = false;
@@ -156,6 +178,29 @@ TEST(FunctionLooperTest, DetachStopsLooper) {
   EXPECT_FALSE(looper->isRunning());
 }
 
+TEST(FunctionLooperTest, WriteScheduler) {
+  EventBase evb;
+  auto writeScheduler = std::make_shared<WriteScheduler>(&evb);
+  int numCalls = 0;
+  auto func = [&](bool) { ++numCalls; };
+  FunctionLooper::Ptr looper(
+      new FunctionLooper(&evb, std::move(func), LooperType::WriteLooper));
+  looper->setWriteScheduler(writeScheduler);
+  looper->run();
+  EXPECT_TRUE(looper->isWriteScheduled());
+  EXPECT_FALSE(looper->isLoopCallbackScheduled());
+  evb.loopOnce();
+  EXPECT_EQ(1, numCalls);
+  // Keeps running from the scheduler until stopped.
+  EXPECT_TRUE(looper->isWriteScheduled());
+  evb.loopOnce();
+  EXPECT_EQ(2, numCalls);
+  looper->stop();
+  EXPECT_EQ(0, writeScheduler->numScheduled());
+  evb.loopOnce();
+  EXPECT_EQ(2, numCalls);
+}
+
 TEST(FunctionLooperTest, PacingOnce) {
   EventBase evb;
   TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 1ms));
@@ -231,6 +276,59 @@ TEST(FunctionLooperTest, KeepPacing) {
   looper->stop();
 }
 
+TEST(FunctionLooperTest, PacingScheduler) {
+  EventBase evb;
+  TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 1ms));
+  auto pacingScheduler = std::make_shared<PacingScheduler>(pacingTimer);
+  std::vector<int> runs;
+  size_t maxRuns = 6;
+  FunctionLooper::Ptr* looperPtrs[2] = {nullptr, nullptr};
+  auto makeLooper = [&](int id) {
+    auto func = [&, id](bool fromTimer) {
+      runs.push_back(fromTimer ? id : -id);
+      if (runs.size() >= maxRuns) {
+        (*looperPtrs[id - 1])->stop();
+      }
+    };
+    FunctionLooper::Ptr looper(
+        new FunctionLooper(&evb, std::move(func), LooperType::WriteLooper));
+    looper->setPacingScheduler(pacingScheduler);
+    looper->setPacingFunction([]() -> auto { return 1ms; });
+    return looper;
+  };
+  auto looper1 = makeLooper(1);
+  auto looper2 = makeLooper(2);
+  looperPtrs[0] = &looper1;
+  looperPtrs[1] = &looper2;
+  EXPECT_EQ(1ms, *looper1->getTimerTickInterval());
+
+  looper1->run();
+  looper2->run();
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({-1, -2}), runs);
+  EXPECT_TRUE(looper1->isScheduled());
+  EXPECT_TRUE(looper2->isScheduled());
+  EXPECT_EQ(2, pacingScheduler->numScheduled());
+  // Paced runs don't loop.
+  looper1->run();
+  EXPECT_FALSE(looper1->isLoopCallbackScheduled());
+
+  // Both run on each wakeup, until the second one stops at the 6th run and
+  // the first one on its next run.
+  evb.loop();
+  EXPECT_EQ(std::vector<int>({-1, -2, 1, 2, 1, 2, 1}), runs);
+  EXPECT_EQ(0, pacingScheduler->numScheduled());
+
+  // Stopping cancels the paced run.
+  maxRuns = 100;
+  looper1->run();
+  evb.loopOnce();
+  EXPECT_TRUE(looper1->isScheduled());
+  looper1->stop();
+  EXPECT_FALSE(looper1->isScheduled());
+  EXPECT_EQ(0, pacingScheduler->numScheduled());
+}
+
 TEST(FunctionLooperTest, TimerTickSize) {
   EventBase evb;
   TimerHighRes::SharedPtr pacingTimer(TimerHighRes::newTimer(&evb, 123ms));
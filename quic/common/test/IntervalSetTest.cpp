@@ -52,6 +52,27 @@ TEST(IntervalSet, insertAtBack) {
   EXPECT_TRUE(set.empty());
 }
 
+TEST(IntervalSet, insertPointsInOrder) {
+  IntervalSet<int> set;
+  set.insert(1, 2);
+  set.insert(5);
+  auto version1 = set.insertVersion();
+  set.insert(6);
+  auto version2 = set.insertVersion();
+  set.insert(6);
+  auto version3 = set.insertVersion();
+  ASSERT_EQ(set.size(), 2);
+  EXPECT_EQ(set.front(), Interval<int>(1, 2));
+  EXPECT_EQ(set.back(), Interval<int>(5, 6));
+  EXPECT_GT(version2, version1);
+  EXPECT_EQ(version3, version2);
+  // A point that fills the gap merges the intervals.
+  set.insert(3);
+  set.insert(4);
+  ASSERT_EQ(set.size(), 1);
+  EXPECT_EQ(set.front(), Interval<int>(1, 6));
+}
+
 TEST(IntervalSet, insertInTheMiddle) {
   IntervalSet<int> set;
   set.insert(1, 2);
@@ -302,3 +323,20 @@ TEST(IntervalSet, withdrawWithOverflow) {
   auto interval = set.front();
   EXPECT_EQ(interval, Interval<int>(3, 5));
 }
+
+TEST(IntervalSet, pastInlineCapacity) {
+  IntervalSet<int> set;
+  for (int i = 0; i < 3 * (int)kIntervalSetInlineCapacity; i++) {
+    set.insert(i * 10, i * 10 + 1);
+  }
+  EXPECT_EQ(3 * kIntervalSetInlineCapacity, set.size());
+  set.insert(2, 9);
+  EXPECT_EQ(3 * kIntervalSetInlineCapacity - 1, set.size());
+  EXPECT_EQ(Interval<int>(0, 11), set.front());
+  set.withdraw({5, 25});
+  EXPECT_EQ(Interval<int>(0, 4), set.front());
+  set.pop_front();
+  EXPECT_EQ(Interval<int>(30, 31), set.front());
+  int last = 3 * kIntervalSetInlineCapacity - 1;
+  EXPECT_EQ(Interval<int>(last * 10, last * 10 + 1), set.back());
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/LatencyHistogram.h>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace quic;
+
+namespace quic {
+namespace test {
+
+TEST(LatencyHistogramTest, Empty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0us, histogram.getPercentile(50));
+  EXPECT_EQ(0us, histogram.max());
+}
+
+TEST(LatencyHistogramTest, BucketsCoverAllValues) {
+  for (uint64_t us = 0; us < 100000; ++us) {
+    auto index = LatencyHistogram::bucketIndex(us);
+    EXPECT_GE(LatencyHistogram::bucketUpperBound(index), us);
+    if (index > 0) {
+      EXPECT_LT(LatencyHistogram::bucketUpperBound(index - 1), us);
+    }
+  }
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 100; ++i) {
+    histogram.addValue(std::chrono::microseconds(i));
+  }
+  EXPECT_EQ(100, histogram.count());
+  EXPECT_EQ(100us, histogram.max());
+  EXPECT_EQ(1us, histogram.getPercentile(0));
+  // 50 lands in the [50, 51] bucket.
+  EXPECT_EQ(51us, histogram.getPercentile(50));
+  EXPECT_EQ(99us, histogram.getPercentile(99));
+  EXPECT_EQ(100us, histogram.getPercentile(100));
+}
+
+TEST(LatencyHistogramTest, RelativeError) {
+  LatencyHistogram histogram;
+  histogram.addValue(123456us);
+  histogram.addValue(1us);
+  auto p100 = histogram.getPercentile(100);
+  EXPECT_EQ(123456us, p100);
+  auto index = LatencyHistogram::bucketIndex(123456);
+  auto upper = LatencyHistogram::bucketUpperBound(index);
+  EXPECT_LE(upper - 123456, 123456 / 16);
+}
+
+TEST(LatencyHistogramTest, ClampsAndMerges) {
+  LatencyHistogram histogram;
+  histogram.addValue(-5us);
+  histogram.addValue(std::chrono::hours(1000));
+  EXPECT_EQ(2, histogram.count());
+  EXPECT_EQ(0us, histogram.getPercentile(50));
+
+  LatencyHistogram other;
+  other.addValue(10us);
+  histogram.merge(other);
+  EXPECT_EQ(3, histogram.count());
+  EXPECT_EQ(10us, histogram.getPercentile(50));
+
+  histogram.clear();
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0us, histogram.getPercentile(100));
+}
+
+} // namespace test
+} // namespace quic
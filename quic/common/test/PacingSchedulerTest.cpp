@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/PacingScheduler.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+class TestCallback : public PacingScheduler::Callback {
+ public:
+  explicit TestCallback(folly::Function<void()> func = nullptr)
+      : func_(std::move(func)) {}
+
+  void pacingTimeoutExpired() noexcept override {
+    ++numRuns;
+    if (func_) {
+      func_();
+    }
+  }
+
+  size_t numRuns{0};
+
+ private:
+  folly::Function<void()> func_;
+};
+} // namespace
+
+class PacingSchedulerTest : public Test {
+ protected:
+  folly::EventBase evb;
+  TimerHighRes::SharedPtr timer{TimerHighRes::newTimer(&evb, 1ms)};
+};
+
+TEST_F(PacingSchedulerTest, RunsDueCallbacksTogether) {
+  auto scheduler = std::make_shared<PacingScheduler>(timer, 16);
+  std::vector<int> order;
+  TestCallback first([&] { order.push_back(1); });
+  TestCallback second([&] { order.push_back(2); });
+  TestCallback later([&] { order.push_back(3); });
+  scheduler->scheduleTimeout(&later, 20ms);
+  scheduler->scheduleTimeout(&first, 2ms);
+  scheduler->scheduleTimeout(&second, 2ms);
+  EXPECT_EQ(3, scheduler->numScheduled());
+  EXPECT_TRUE(first.isPacingTimeoutScheduled());
+
+  evb.loop();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+  EXPECT_EQ(0, scheduler->numScheduled());
+  EXPECT_FALSE(first.isPacingTimeoutScheduled());
+  // One wakeup for the first two and one for the last, which is more than a
+  // lap of the calendar away.
+  EXPECT_EQ(2, scheduler->numWakeups());
+}
+
+TEST_F(PacingSchedulerTest, Cancel) {
+  auto scheduler = std::make_shared<PacingScheduler>(timer);
+  TestCallback canceled;
+  TestCallback run;
+  scheduler->scheduleTimeout(&canceled, 2ms);
+  scheduler->scheduleTimeout(&run, 2ms);
+  canceled.cancelPacingTimeout();
+  EXPECT_EQ(1, scheduler->numScheduled());
+  {
+    TestCallback destroyed;
+    scheduler->scheduleTimeout(&destroyed, 1ms);
+  }
+  EXPECT_EQ(1, scheduler->numScheduled());
+  evb.loop();
+  EXPECT_EQ(0, canceled.numRuns);
+  EXPECT_EQ(1, run.numRuns);
+}
+
+TEST_F(PacingSchedulerTest, CancelOthersWhileRunning) {
+  auto scheduler = std::make_shared<PacingScheduler>(timer);
+  TestCallback second;
+  TestCallback first([&] { second.cancelPacingTimeout(); });
+  scheduler->scheduleTimeout(&first, 1ms);
+  scheduler->scheduleTimeout(&second, 1ms);
+  evb.loop();
+  EXPECT_EQ(1, first.numRuns);
+  EXPECT_EQ(0, second.numRuns);
+  EXPECT_EQ(0, scheduler->numScheduled());
+}
+
+TEST_F(PacingSchedulerTest, RescheduleFromCallback) {
+  auto scheduler = std::make_shared<PacingScheduler>(timer);
+  TestCallback* callbackPtr = nullptr;
+  TestCallback callback([&] {
+    if (callbackPtr->numRuns < 3) {
+      scheduler->scheduleTimeout(callbackPtr, 1ms);
+    }
+  });
+  callbackPtr = &callback;
+  scheduler->scheduleTimeout(&callback, 1ms);
+  // Moving a scheduled callback doesn't run it twice.
+  scheduler->scheduleTimeout(&callback, 2ms);
+  EXPECT_EQ(1, scheduler->numScheduled());
+  evb.loop();
+  EXPECT_EQ(3, callback.numRuns);
+  EXPECT_EQ(3, scheduler->numWakeups());
+}
+
+TEST_F(PacingSchedulerTest, DestroyedWithScheduledCallbacks) {
+  TestCallback callback;
+  {
+    auto scheduler = std::make_shared<PacingScheduler>(timer);
+    scheduler->scheduleTimeout(&callback, 1ms);
+  }
+  EXPECT_FALSE(callback.isPacingTimeoutScheduled());
+  callback.cancelPacingTimeout();
+  evb.loop();
+  EXPECT_EQ(0, callback.numRuns);
+}
+} // namespace test
+} // namespace quic
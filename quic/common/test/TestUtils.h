@@ -114,10 +114,7 @@ Buf packetToBufCleartext(
 
 template <typename T, typename S>
 bool isState(const S& s) {
-  return folly::variant_match(
-      s.state,
-      [](const T&) { return true; },
-      [](const auto&) { return false; });
+  return matchesStates<decltype(s.state), T>(s.state);
 }
 
 std::shared_ptr<fizz::server::FizzServerContext> createServerCtx();
@@ -190,7 +187,7 @@ OutstandingPacket* findOutstandingPacket(
     QuicConnectionStateBase& conn,
     Match match) {
   auto helper =
-      [&](std::deque<OutstandingPacket>& packets) -> OutstandingPacket* {
+      [&](OutstandingPacketQueue& packets) -> OutstandingPacket* {
     for (auto& packet : packets) {
       if (match(packet)) {
         return &packet;
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/TimerMultiplexer.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+class TestTimeout : public folly::HHWheelTimer::Callback {
+ public:
+  explicit TestTimeout(folly::Function<void()> func = nullptr)
+      : func_(std::move(func)) {}
+
+  void timeoutExpired() noexcept override {
+    ++numRuns;
+    if (func_) {
+      func_();
+    }
+  }
+
+  void callbackCanceled() noexcept override {
+    ++numCanceled;
+  }
+
+  size_t numRuns{0};
+  size_t numCanceled{0};
+
+ private:
+  folly::Function<void()> func_;
+};
+} // namespace
+
+class TimerMultiplexerTest : public Test {
+ protected:
+  folly::EventBase evb;
+};
+
+TEST_F(TimerMultiplexerTest, RunsInDeadlineOrder) {
+  TimerMultiplexer timers;
+  std::vector<int> order;
+  TestTimeout first([&] { order.push_back(1); });
+  TestTimeout second([&] { order.push_back(2); });
+  TestTimeout third([&] { order.push_back(3); });
+  timers.scheduleTimeout(evb.timer(), &third, 30ms);
+  timers.scheduleTimeout(evb.timer(), &second, 20ms);
+  timers.scheduleTimeout(evb.timer(), &first, 10ms);
+  EXPECT_EQ(3, timers.numScheduled());
+  EXPECT_TRUE(timers.isScheduled(&first));
+  EXPECT_FALSE(first.isScheduled());
+  EXPECT_GT(timers.getTimeRemaining(&third), timers.getTimeRemaining(&first));
+
+  evb.loop();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+  EXPECT_EQ(0, timers.numScheduled());
+  EXPECT_FALSE(timers.isScheduled(&first));
+  EXPECT_EQ(0ms, timers.getTimeRemaining(&first));
+}
+
+TEST_F(TimerMultiplexerTest, LaterDeadlinesDontMoveTheRegistration) {
+  TimerMultiplexer timers;
+  TestTimeout idle;
+  TestTimeout ack;
+  timers.scheduleTimeout(evb.timer(), &idle, 20ms);
+  EXPECT_EQ(1, timers.numWheelSchedules());
+  // Pushing the idle timeout back, like a packet would.
+  for (int i = 0; i < 10; ++i) {
+    timers.scheduleTimeout(evb.timer(), &idle, 30ms);
+  }
+  timers.scheduleTimeout(evb.timer(), &ack, 40ms);
+  EXPECT_EQ(1, timers.numWheelSchedules());
+
+  // An earlier deadline does.
+  timers.scheduleTimeout(evb.timer(), &ack, 5ms);
+  EXPECT_EQ(2, timers.numWheelSchedules());
+
+  evb.loop();
+  EXPECT_EQ(1, idle.numRuns);
+  EXPECT_EQ(1, ack.numRuns);
+}
+
+TEST_F(TimerMultiplexerTest, Cancel) {
+  TimerMultiplexer timers;
+  TestTimeout canceled;
+  TestTimeout run;
+  timers.scheduleTimeout(evb.timer(), &canceled, 5ms);
+  timers.scheduleTimeout(evb.timer(), &run, 10ms);
+  timers.cancelTimeout(&canceled);
+  EXPECT_FALSE(timers.isScheduled(&canceled));
+  EXPECT_EQ(1, timers.numScheduled());
+  evb.loop();
+  EXPECT_EQ(0, canceled.numRuns);
+  EXPECT_EQ(0, canceled.numCanceled);
+  EXPECT_EQ(1, run.numRuns);
+
+  timers.scheduleTimeout(evb.timer(), &run, 5ms);
+  timers.cancelAll();
+  EXPECT_EQ(0, timers.numScheduled());
+  evb.loop();
+  EXPECT_EQ(1, run.numRuns);
+}
+
+TEST_F(TimerMultiplexerTest, ExpiredCallbackReschedules) {
+  TimerMultiplexer timers;
+  TestTimeout other;
+  TestTimeout self;
+  TestTimeout rescheduling([&] {
+    timers.cancelTimeout(&other);
+    timers.scheduleTimeout(evb.timer(), &self, 0ms);
+  });
+  // The same deadline would otherwise run other in the same wakeup.
+  timers.scheduleTimeout(evb.timer(), &rescheduling, 5ms);
+  timers.scheduleTimeout(evb.timer(), &other, 5ms);
+  evb.loop();
+  EXPECT_EQ(1, rescheduling.numRuns);
+  EXPECT_EQ(0, other.numRuns);
+  EXPECT_EQ(1, self.numRuns);
+}
+
+TEST_F(TimerMultiplexerTest, DestroyedInCallback) {
+  auto timers = std::make_unique<TimerMultiplexer>();
+  TestTimeout after;
+  TestTimeout destroying([&] {
+    timers->cancelTimeout(&after);
+    timers.reset();
+  });
+  timers->scheduleTimeout(evb.timer(), &destroying, 5ms);
+  timers->scheduleTimeout(evb.timer(), &after, 5ms);
+  evb.loop();
+  EXPECT_EQ(1, destroying.numRuns);
+  EXPECT_EQ(0, after.numRuns);
+}
+
+TEST_F(TimerMultiplexerTest, WheelDestroyed) {
+  TimerMultiplexer timers;
+  TestTimeout first;
+  TestTimeout second;
+  {
+    folly::EventBase otherEvb;
+    timers.scheduleTimeout(otherEvb.timer(), &first, 100ms);
+    timers.scheduleTimeout(otherEvb.timer(), &second, 200ms);
+  }
+  EXPECT_EQ(1, first.numCanceled);
+  EXPECT_EQ(1, second.numCanceled);
+  EXPECT_EQ(0, timers.numScheduled());
+
+  // The multiplexer can move to another wheel.
+  timers.scheduleTimeout(evb.timer(), &first, 5ms);
+  evb.loop();
+  EXPECT_EQ(1, first.numRuns);
+}
+} // namespace test
+} // namespace quic
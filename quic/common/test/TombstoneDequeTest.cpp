@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/TombstoneDeque.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace std;
+using namespace quic;
+
+namespace {
+vector<int> toVector(const TombstoneDeque<int>& deque) {
+  return vector<int>(deque.begin(), deque.end());
+}
+} // namespace
+
+TEST(TombstoneDeque, EraseMiddle) {
+  TombstoneDeque<int> deque;
+  for (int i = 0; i < 5; ++i) {
+    deque.push_back(i);
+  }
+  auto it = deque.erase(deque.begin() + 2);
+  EXPECT_EQ(3, *it);
+  EXPECT_EQ(4, deque.size());
+  EXPECT_EQ(1, deque.numTombstones());
+  EXPECT_EQ(vector<int>({0, 1, 3, 4}), toVector(deque));
+  EXPECT_EQ(3, deque[2]);
+  EXPECT_EQ(4, deque.back());
+  EXPECT_EQ(3, *(deque.rbegin() + 1));
+}
+
+TEST(TombstoneDeque, EraseFrontAndBack) {
+  TombstoneDeque<int> deque;
+  for (int i = 0; i < 4; ++i) {
+    deque.push_back(i);
+  }
+  deque.erase(deque.begin() + 1);
+  deque.erase(deque.begin());
+  // Tombstones at the front are dropped right away.
+  EXPECT_EQ(0, deque.numTombstones());
+  EXPECT_EQ(2, deque.front());
+  auto it = deque.erase(deque.begin() + 1);
+  EXPECT_TRUE(it == deque.end());
+  deque.pop_back();
+  EXPECT_TRUE(deque.empty());
+}
+
+TEST(TombstoneDeque, EraseRange) {
+  TombstoneDeque<int> deque;
+  for (int i = 0; i < 6; ++i) {
+    deque.push_back(i);
+  }
+  deque.erase(deque.begin() + 3);
+  auto it = deque.erase(deque.begin() + 1, deque.begin() + 4);
+  EXPECT_EQ(5, *it);
+  EXPECT_EQ(vector<int>({0, 5}), toVector(deque));
+}
+
+TEST(TombstoneDeque, InsertDropsPreviousTombstones) {
+  TombstoneDeque<int> deque;
+  for (int i : {0, 2, 4, 6}) {
+    deque.push_back(i);
+  }
+  deque.erase(deque.begin() + 1);
+  deque.erase(deque.begin() + 1);
+  auto it = deque.insert(deque.end() - 1, 5);
+  EXPECT_EQ(5, *it);
+  EXPECT_EQ(0, deque.numTombstones());
+  EXPECT_EQ(vector<int>({0, 5, 6}), toVector(deque));
+}
+
+TEST(TombstoneDeque, RawTombstoneAndCompact) {
+  TombstoneDeque<int> deque;
+  for (int i = 0; i < 5; ++i) {
+    deque.push_back(i);
+  }
+  auto raw = std::lower_bound(
+      deque.rawBegin(), deque.rawEnd(), 3, [](const auto& slot, int val) {
+        return slot.value < val;
+      });
+  deque.tombstone(raw);
+  deque.tombstone(raw - 2);
+  EXPECT_EQ(3, deque.size());
+  EXPECT_EQ(vector<int>({0, 2, 4}), toVector(deque));
+  deque.maybeCompact();
+  EXPECT_EQ(2, deque.numTombstones());
+  deque.tombstone(deque.rawBegin() + 2);
+  deque.maybeCompact();
+  EXPECT_EQ(0, deque.numTombstones());
+  EXPECT_EQ(vector<int>({0, 4}), toVector(deque));
+}
+
+TEST(TombstoneDeque, BoundsSkipTombstones) {
+  TombstoneDeque<int> deque;
+  for (int i : {0, 10, 20, 30, 40}) {
+    deque.push_back(i);
+  }
+  deque.erase(deque.begin() + 2);
+  auto less = [](int element, int key) { return element < key; };
+  auto greater = [](int key, int element) { return key < element; };
+  EXPECT_EQ(10, *deque.lowerBound(10, less));
+  EXPECT_EQ(30, *deque.lowerBound(15, less));
+  EXPECT_EQ(30, *deque.lowerBound(20, less));
+  EXPECT_EQ(30, *deque.upperBound(20, greater));
+  EXPECT_TRUE(deque.lowerBound(41, less) == deque.end());
+  const auto& constDeque = deque;
+  EXPECT_EQ(40, *constDeque.lowerBound(31, less));
+  auto it = deque.emplace(deque.upperBound(25, greater), 25);
+  EXPECT_EQ(25, *it);
+  EXPECT_EQ(vector<int>({0, 10, 25, 30, 40}), toVector(deque));
+  deque.pop_front();
+  EXPECT_EQ(10, deque.front());
+}
+
+TEST(TombstoneDeque, EmptyWithoutStorage) {
+  TombstoneDeque<int> deque;
+  EXPECT_TRUE(deque.empty());
+  EXPECT_TRUE(deque.begin() == deque.end());
+  EXPECT_TRUE(deque.rawBegin() == deque.rawEnd());
+  auto less = [](int element, int key) { return element < key; };
+  EXPECT_TRUE(deque.lowerBound(1, less) == deque.end());
+  deque.maybeCompact();
+
+  deque.emplace(deque.end(), 1);
+  deque.push_back(2);
+  EXPECT_EQ(vector<int>({1, 2}), toVector(deque));
+
+  TombstoneDeque<int> copy(deque);
+  deque.erase(deque.begin());
+  deque.clear();
+  EXPECT_TRUE(deque.empty());
+  EXPECT_EQ(0, deque.numTombstones());
+  EXPECT_EQ(vector<int>({1, 2}), toVector(copy));
+
+  deque.push_back(3);
+  EXPECT_EQ(vector<int>({3}), toVector(deque));
+  TombstoneDeque<int> moved(std::move(deque));
+  EXPECT_EQ(vector<int>({3}), toVector(moved));
+}
+
+TEST(TombstoneDeque, ShrinkToFit) {
+  TombstoneDeque<int> deque;
+  for (int i = 0; i < 5; ++i) {
+    deque.push_back(i);
+  }
+  deque.erase(deque.begin() + 2);
+  deque.shrinkToFit();
+  EXPECT_EQ(0, deque.numTombstones());
+  EXPECT_EQ(vector<int>({0, 1, 3, 4}), toVector(deque));
+
+  while (!deque.empty()) {
+    deque.pop_front();
+  }
+  deque.shrinkToFit();
+  EXPECT_TRUE(deque.rawBegin() == deque.rawEnd());
+  deque.push_back(5);
+  EXPECT_EQ(vector<int>({5}), toVector(deque));
+}
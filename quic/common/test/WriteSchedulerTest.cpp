@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/common/WriteScheduler.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+class TestCallback : public WriteScheduler::Callback {
+ public:
+  explicit TestCallback(folly::Function<void()> func = nullptr)
+      : func_(std::move(func)) {}
+
+  void writeReady() noexcept override {
+    ++numRuns;
+    if (func_) {
+      func_();
+    }
+  }
+
+  size_t numRuns{0};
+
+ private:
+  folly::Function<void()> func_;
+};
+
+// Writes up to packetsPerRun packets of its allowance in every run, and stays
+// queued while busy.
+class PacketCallback : public WriteScheduler::Callback {
+ public:
+  PacketCallback(WriteScheduler& writeScheduler, uint64_t packetsPerRun)
+      : writeScheduler_(writeScheduler), packetsPerRun_(packetsPerRun) {}
+
+  void writeReady() noexcept override {
+    auto allowance = writePacketAllowance();
+    EXPECT_TRUE(allowance.hasValue());
+    allowances.push_back(*allowance);
+    onPacketsWritten(std::min(packetsPerRun_, *allowance));
+    if (busy) {
+      writeScheduler_.schedule(this);
+    }
+  }
+
+  void writeBudgetExhausted(
+      std::chrono::microseconds,
+      uint64_t packetsWritten,
+      size_t numDeferred) noexcept override {
+    exhaustedPackets.push_back(packetsWritten);
+    exhaustedDeferred.push_back(numDeferred);
+  }
+
+  bool busy{true};
+  std::vector<uint64_t> allowances;
+  std::vector<uint64_t> exhaustedPackets;
+  std::vector<size_t> exhaustedDeferred;
+
+ private:
+  WriteScheduler& writeScheduler_;
+  uint64_t packetsPerRun_;
+};
+} // namespace
+
+TEST(WriteSchedulerTest, RunsReadyCallbacksInOrder) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s);
+  std::vector<int> order;
+  TestCallback first([&] { order.push_back(1); });
+  TestCallback second([&] { order.push_back(2); });
+  TestCallback third([&] { order.push_back(3); });
+  scheduler->schedule(&first);
+  scheduler->schedule(&second);
+  scheduler->schedule(&third);
+  scheduler->schedule(&first);
+  EXPECT_EQ(3, scheduler->numScheduled());
+  EXPECT_TRUE(first.isWriteScheduled());
+
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+  EXPECT_EQ(0, scheduler->numScheduled());
+  EXPECT_FALSE(first.isWriteScheduled());
+  EXPECT_EQ(1, scheduler->numRuns());
+
+  evb.loopOnce();
+  EXPECT_EQ(1, first.numRuns);
+  EXPECT_EQ(1, scheduler->numRuns());
+}
+
+TEST(WriteSchedulerTest, RescheduleRunsInNextIteration) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s);
+  TestCallback other;
+  TestCallback callback([&] {
+    scheduler->schedule(&callback);
+    scheduler->schedule(&other, true /* thisIteration */);
+  });
+  scheduler->schedule(&callback);
+
+  evb.loopOnce();
+  EXPECT_EQ(1, callback.numRuns);
+  EXPECT_EQ(0, other.numRuns);
+  evb.loopOnce();
+  EXPECT_EQ(2, callback.numRuns);
+  EXPECT_EQ(1, other.numRuns);
+  callback.cancelWrite();
+  other.cancelWrite();
+  EXPECT_EQ(0, scheduler->numScheduled());
+}
+
+TEST(WriteSchedulerTest, TimeBudget) {
+  folly::EventBase evb;
+  // Only one callback fits in each iteration.
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 0us);
+  std::vector<int> order;
+  TestCallback late([&] { order.push_back(3); });
+  TestCallback first([&] {
+    order.push_back(1);
+    scheduler->schedule(&late);
+  });
+  TestCallback second([&] { order.push_back(2); });
+  scheduler->schedule(&first);
+  scheduler->schedule(&second);
+
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1}), order);
+  EXPECT_EQ(1, scheduler->numOverBudgetRuns());
+  // The callback that didn't fit goes before the one queued since.
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2}), order);
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), order);
+  EXPECT_EQ(0, scheduler->numScheduled());
+}
+
+TEST(WriteSchedulerTest, PacketBudgetRoundRobin) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s, 4, 4);
+  PacketCallback first(*scheduler, 4);
+  PacketCallback second(*scheduler, 4);
+  PacketCallback third(*scheduler, 4);
+  scheduler->schedule(&first);
+  scheduler->schedule(&second);
+  scheduler->schedule(&third);
+
+  // Each iteration only has packets for one of them, who report it.
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4}), first.allowances);
+  EXPECT_TRUE(second.allowances.empty());
+  EXPECT_EQ(std::vector<uint64_t>({4}), first.exhaustedPackets);
+  EXPECT_EQ(std::vector<size_t>({2}), first.exhaustedDeferred);
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4}), second.allowances);
+  EXPECT_TRUE(third.allowances.empty());
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4}), third.allowances);
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4, 4}), first.allowances);
+  EXPECT_EQ(4, scheduler->numOverBudgetRuns());
+
+  first.cancelWrite();
+  second.cancelWrite();
+  third.cancelWrite();
+}
+
+TEST(WriteSchedulerTest, DeficitCarryover) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s, 6, 4);
+  PacketCallback light(*scheduler, 3);
+  PacketCallback heavy(*scheduler, 100);
+  scheduler->schedule(&light);
+  scheduler->schedule(&heavy);
+
+  // The heavy one only gets what is left of the budget.
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4}), light.allowances);
+  EXPECT_EQ(std::vector<uint64_t>({3}), heavy.allowances);
+  // Nothing was deferred.
+  EXPECT_TRUE(heavy.exhaustedPackets.empty());
+  heavy.busy = false;
+  heavy.cancelWrite();
+
+  // The unused deficit carries over while the light one stays queued.
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4, 5}), light.allowances);
+  light.busy = false;
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4, 5, 6}), light.allowances);
+
+  // And is dropped once it goes idle.
+  scheduler->schedule(&light);
+  evb.loopOnce();
+  EXPECT_EQ(std::vector<uint64_t>({4, 5, 6, 4}), light.allowances);
+  EXPECT_EQ(0, scheduler->numScheduled());
+  EXPECT_EQ(0, scheduler->numOverBudgetRuns());
+}
+
+TEST(WriteSchedulerTest, NoPacketBudget) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s);
+  folly::Optional<uint64_t> allowance = 0;
+  TestCallback callback([&] { allowance = callback.writePacketAllowance(); });
+  scheduler->schedule(&callback);
+  evb.loopOnce();
+  EXPECT_EQ(1, callback.numRuns);
+  EXPECT_FALSE(allowance.hasValue());
+}
+
+TEST(WriteSchedulerTest, Cancel) {
+  folly::EventBase evb;
+  auto scheduler = std::make_shared<WriteScheduler>(&evb, 1s);
+  TestCallback third;
+  TestCallback second;
+  TestCallback first([&] { third.cancelWrite(); });
+  scheduler->schedule(&first);
+  scheduler->schedule(&second);
+  scheduler->schedule(&third);
+  second.cancelWrite();
+  EXPECT_EQ(2, scheduler->numScheduled());
+
+  evb.loopOnce();
+  EXPECT_EQ(1, first.numRuns);
+  EXPECT_EQ(0, second.numRuns);
+  EXPECT_EQ(0, third.numRuns);
+  EXPECT_EQ(0, scheduler->numScheduled());
+
+  {
+    TestCallback destroyed;
+    scheduler->schedule(&destroyed);
+  }
+  EXPECT_EQ(0, scheduler->numScheduled());
+  evb.loopOnce();
+  EXPECT_EQ(1, scheduler->numRuns());
+}
+} // namespace test
+} // namespace quic
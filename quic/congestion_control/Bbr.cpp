@@ -41,7 +41,10 @@ BbrCongestionController::BbrCongestionController(
       pacingWindow_(
           conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
       // TODO: experiment with longer window len for ack aggregation filter
-      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {}
+      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {
+  cwndGain_ = config_.startupGain;
+  pacingGain_ = config_.startupGain;
+}
 
 void BbrCongestionController::setConnectionEmulation(uint8_t) noexcept {
   /* unsupported for BBR */
@@ -164,7 +167,11 @@ void BbrCongestionController::onPacketAckOrLoss(
   }
   if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
     CHECK(!ackEvent->ackedPackets.empty());
-    onPacketAcked(*ackEvent, prevInflightBytes, lossEvent.hasValue());
+    // CE marks end a bandwidth probe the same way losses do.
+    onPacketAcked(
+        *ackEvent,
+        prevInflightBytes,
+        lossEvent.hasValue() || ackEvent->ecnCEMarks > 0);
   }
 }
 
@@ -220,6 +227,11 @@ void BbrCongestionController::onPacketAcked(
   if (newRoundTrip && !lastAckedPacketAppLimited) {
     detectBottleneckBandwidth(lastAckedPacketAppLimited);
   }
+  if (state_ == BbrState::Startup && ack.ecnCEMarks > 0) {
+    // The bottleneck marks packets once its queue builds, so the pipe is
+    // already full.
+    btlbwFound_ = true;
+  }
 
   if (shouldExitStartup()) {
     transitToDrain();
@@ -386,8 +398,8 @@ void BbrCongestionController::handleAckInProbeRtt(
 
 void BbrCongestionController::transitToStartup() noexcept {
   state_ = BbrState::Startup;
-  pacingGain_ = kStartupGain;
-  cwndGain_ = kStartupGain;
+  pacingGain_ = config_.startupGain;
+  cwndGain_ = config_.startupGain;
 }
 
 void BbrCongestionController::transitToProbeRtt() noexcept {
@@ -403,8 +415,8 @@ void BbrCongestionController::transitToProbeRtt() noexcept {
 
 void BbrCongestionController::transitToDrain() noexcept {
   state_ = BbrState::Drain;
-  pacingGain_ = 1.0f / kStartupGain;
-  cwndGain_ = kStartupGain;
+  pacingGain_ = 1.0f / config_.startupGain;
+  cwndGain_ = config_.startupGain;
 }
 
 void BbrCongestionController::transitToProbeBw(TimePoint congestionEventTime) {
@@ -543,6 +555,18 @@ bool BbrCongestionController::isAppLimited() const noexcept {
   return bandwidthSampler_ ? bandwidthSampler_->isAppLimited() : false;
 }
 
+uint64_t BbrCongestionController::getBandwidthEstimate() const noexcept {
+  return bandwidth().normalize();
+}
+
+uint8_t BbrCongestionController::getStateCode() const noexcept {
+  return static_cast<uint8_t>(state_);
+}
+
+uint64_t BbrCongestionController::getBytesInFlight() const noexcept {
+  return inflightBytes_;
+}
+
 uint64_t BbrCongestionController::getCongestionWindow() const noexcept {
   if (state_ == BbrCongestionController::BbrState::ProbeRtt) {
     if (config_.largeProbeRttCwnd) {
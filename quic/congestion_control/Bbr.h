@@ -37,6 +37,8 @@ constexpr float kLargeProbeRttCwndGain = 0.75f;
 // Bandwidth WindowFilter length, in unit of RTT. This value is from Chromium
 // code. I don't know why.
 constexpr uint64_t kBandwidthWindowLength = kNumOfCycles + 2;
+// Number of candidate samples kept by the bandwidth filter of the sampler
+constexpr size_t kBandwidthFilterCapacity = 16;
 // RTT Sampler default expiration
 constexpr std::chrono::seconds kDefaultRttSamplerExpiration{10};
 // See calculateReductionFactors in QuicCubic.cpp
@@ -117,6 +119,9 @@ class BbrCongestionController : public CongestionController {
      * haven't reached the drain target.
      */
     bool drainToTarget{false};
+
+    // Cwnd and pacing gain during Startup. Drain paces at its inverse.
+    float startupGain{kStartupGain};
   };
 
   // TODO: i may move the configuration into a separate function
@@ -157,6 +162,12 @@ class BbrCongestionController : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  uint64_t getBandwidthEstimate() const noexcept override;
+
+  uint8_t getStateCode() const noexcept override;
+
+  uint64_t getBytesInFlight() const noexcept override;
+
   // TODO: some of these do not have to be in public API.
   bool inRecovery() const noexcept;
   BbrState state() const noexcept;
@@ -164,7 +175,7 @@ class BbrCongestionController : public CongestionController {
  private:
   /* prevInflightBytes: the inflightBytes_ value before the current
    *                    onPacketAckOrLoss invocation.
-   * hasLoss: whether current onPacketAckOrLoss has loss.
+   * hasLoss: whether current onPacketAckOrLoss has loss or ECN-CE marks.
    */
   void
   onPacketAcked(const AckEvent& ack, uint64_t prevInflightBytes, bool hasLoss);
@@ -203,7 +214,7 @@ class BbrCongestionController : public CongestionController {
    *
    * prevInflightBytes: the inflightBytes_ value before the current
    *                    onPacketAckOrLoss invocation.
-   * hasLoss: whether the current onpacketAckOrLoss has loss.
+   * hasLoss: whether the current onpacketAckOrLoss has loss or ECN-CE marks.
    */
   void handleAckInProbeBw(
       TimePoint ackTime,
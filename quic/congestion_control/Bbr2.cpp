@@ -0,0 +1,625 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+#include <folly/Random.h>
+#include <quic/QuicConstants.h>
+#include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/logging/QLoggerConstants.h>
+#include <quic/logging/QuicLogger.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+quic::Bandwidth kLowPacingRateForSendQuantum{1200 * 1000, 1s};
+quic::Bandwidth kHighPacingRateForSendQuantum{24, 1us};
+// Same as in Bbr.cpp
+uint64_t kQuantaFactor = 3;
+} // namespace
+
+namespace quic {
+
+Bbr2CongestionController::Bbr2CongestionController(
+    QuicConnectionStateBase& conn)
+    : conn_(conn),
+      cwnd_(conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      initialCwnd_(
+          conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      pacingWindow_(
+          conn.udpSendPacketLen * conn.transportSettings.initCwndInMss),
+      maxAckHeightFilter_(kBandwidthWindowLength, 0, 0) {}
+
+void Bbr2CongestionController::setConnectionEmulation(uint8_t) noexcept {
+  /* unsupported for BBR */
+}
+
+CongestionControlType Bbr2CongestionController::type() const noexcept {
+  return CongestionControlType::BBR2;
+}
+
+void Bbr2CongestionController::setRttSampler(
+    std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept {
+  minRttSampler_ = std::move(sampler);
+}
+
+void Bbr2CongestionController::setBandwidthSampler(
+    std::unique_ptr<BbrCongestionController::BandwidthSampler>
+        sampler) noexcept {
+  bandwidthSampler_ = std::move(sampler);
+}
+
+bool Bbr2CongestionController::updateRoundTripCounter(
+    TimePoint largestAckedSentTime) noexcept {
+  if (largestAckedSentTime > endOfRoundTrip_) {
+    roundTripCounter_++;
+    endOfRoundTrip_ = Clock::now();
+    return true;
+  }
+  return false;
+}
+
+void Bbr2CongestionController::onPacketSent(const OutstandingPacket& packet) {
+  if (!inflightBytes_ && isAppLimited()) {
+    exitingQuiescence_ = true;
+  }
+  addAndCheckOverflow(inflightBytes_, packet.encodedSize);
+  if (!ackAggregationStartTime_) {
+    ackAggregationStartTime_ = packet.time;
+  }
+}
+
+void Bbr2CongestionController::onRemoveBytesFromInflight(
+    uint64_t bytesToRemove) {
+  subtractAndCheckUnderflow(inflightBytes_, bytesToRemove);
+}
+
+void Bbr2CongestionController::onPacketAckOrLoss(
+    folly::Optional<AckEvent> ackEvent,
+    folly::Optional<LossEvent> lossEvent) {
+  auto prevInflightBytes = inflightBytes_;
+  if (ackEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, ackEvent->ackedBytes);
+  }
+  if (lossEvent) {
+    subtractAndCheckUnderflow(inflightBytes_, lossEvent->lostBytes);
+    roundLostBytes_ += lossEvent->lostBytes;
+    if (conn_.pacer) {
+      conn_.pacer->onPacketsLoss();
+    }
+    if (lossEvent->persistentCongestion) {
+      inflightLo_ = conn_.udpSendPacketLen * kMinCwndInMssForBbr;
+    }
+    // Probing stops as soon as it causes too many losses, without waiting
+    // for the end of the round.
+    if (isInflightTooHigh(prevInflightBytes)) {
+      handleInflightTooHigh(prevInflightBytes, lossEvent->lossTime);
+    }
+    if (conn_.qLogger) {
+      conn_.qLogger->addCongestionMetricUpdate(
+          inflightBytes_,
+          getCongestionWindow(),
+          kCongestionPacketLoss,
+          bbr2StateToString(state_));
+    }
+  }
+  if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
+    CHECK(!ackEvent->ackedPackets.empty());
+    onPacketAcked(*ackEvent, prevInflightBytes);
+  }
+}
+
+bool Bbr2CongestionController::isInflightTooHigh(
+    uint64_t prevInflightBytes) const noexcept {
+  return roundLostBytes_ > kBbr2LossThreshold * prevInflightBytes;
+}
+
+void Bbr2CongestionController::handleInflightTooHigh(
+    uint64_t prevInflightBytes,
+    TimePoint lossTime) noexcept {
+  if (state_ == State::Startup) {
+    // The bottleneck is full.
+    btlbwFound_ = true;
+    inflightHi_ = std::max(calculateTargetCwnd(1.0), roundAckedBytes_);
+  } else if (state_ == State::ProbeBwUp || state_ == State::ProbeBwRefill) {
+    inflightHi_ = std::max<uint64_t>(
+        prevInflightBytes, calculateTargetCwnd(1.0) * kBbr2Beta);
+    transitToProbeBwDown(lossTime);
+  }
+}
+
+void Bbr2CongestionController::onPacketAcked(
+    const AckEvent& ack,
+    uint64_t prevInflightBytes) {
+  if (ack.mrttSample && minRttSampler_) {
+    minRttSampler_->newRttSample(ack.mrttSample.value(), ack.ackTime);
+  }
+  if (!lastProbeRttTime_) {
+    lastProbeRttTime_ = ack.ackTime;
+  }
+
+  bool newRoundTrip = updateRoundTripCounter(ack.largestAckedPacketSentTime);
+  if (bandwidthSampler_) {
+    bool wasAppLimited = bandwidthSampler_->isAppLimited();
+    bandwidthSampler_->onPacketAcked(ack, roundTripCounter_);
+    if (wasAppLimited && !bandwidthSampler_->isAppLimited()) {
+      if (conn_.pacer) {
+        conn_.pacer->setAppLimited(false);
+      }
+    }
+  }
+  if (newRoundTrip) {
+    onRoundEnd(ack.ackTime, ack.largestAckedPacketAppLimited);
+  }
+  roundAckedBytes_ += ack.ackedBytes;
+  roundAckedPackets_ += ack.ackedPackets.size();
+  roundCEMarks_ += ack.ecnCEMarks;
+  if (ack.ecnCEMarks > 0 &&
+      roundCEMarks_ > kBbr2ECNThreshold * roundAckedPackets_) {
+    handleInflightTooHigh(prevInflightBytes, ack.ackTime);
+  }
+
+  auto excessiveBytes = updateAckAggregation(ack);
+
+  if (state_ == State::ProbeBwUp) {
+    raiseInflightHi(ack.ackedBytes);
+  }
+  if (state_ == State::Startup && btlbwFound_) {
+    transitToDrain();
+  }
+  if (state_ == State::Drain && inflightBytes_ <= calculateTargetCwnd(1.0)) {
+    transitToProbeBwDown(ack.ackTime);
+  }
+  updateProbeBw(ack.ackTime, prevInflightBytes);
+
+  if (shouldProbeRtt(ack.ackTime)) {
+    transitToProbeRtt();
+  }
+  exitingQuiescence_ = false;
+  if (state_ == State::ProbeRtt) {
+    handleAckInProbeRtt(newRoundTrip, ack.ackTime);
+  }
+
+  updateCwnd(ack.ackedBytes, excessiveBytes);
+  updatePacing();
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionPacketAck,
+        bbr2StateToString(state_));
+  }
+}
+
+void Bbr2CongestionController::onRoundEnd(
+    TimePoint ackTime,
+    bool appLimitedSample) {
+  if (state_ == State::Startup && !appLimitedSample) {
+    detectBottleneckBandwidth();
+  }
+  if ((roundLostBytes_ > 0 || roundCEMarks_ > 0) && !isProbingBandwidth()) {
+    adaptLowerBounds(ackTime);
+  }
+  if (state_ == State::ProbeBwUp) {
+    // Probe twice as hard every round.
+    probeUpPackets_ =
+        std::min(probeUpPackets_ * 2, conn_.transportSettings.maxCwndInMss);
+  }
+  roundAckedBytes_ = 0;
+  roundLostBytes_ = 0;
+  roundAckedPackets_ = 0;
+  roundCEMarks_ = 0;
+  roundStart_ = ackTime;
+}
+
+void Bbr2CongestionController::adaptLowerBounds(TimePoint ackTime) noexcept {
+  auto roundDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+      ackTime - roundStart_);
+  if (roundDuration > 0us) {
+    Bandwidth latest(roundAckedBytes_, roundDuration);
+    auto maxBandwidth =
+        bandwidthSampler_ ? bandwidthSampler_->getBandwidth() : Bandwidth();
+    auto bandwidthLo = bandwidthLo_.value_or(maxBandwidth) * kBbr2Beta;
+    bandwidthLo_ = std::max(latest, bandwidthLo);
+  }
+  uint64_t inflightLo =
+      inflightLo_.value_or(getCongestionWindow()) * kBbr2Beta;
+  inflightLo_ = std::max(roundAckedBytes_, inflightLo);
+}
+
+void Bbr2CongestionController::resetLowerBounds() noexcept {
+  inflightLo_ = folly::none;
+  bandwidthLo_ = folly::none;
+}
+
+void Bbr2CongestionController::raiseInflightHi(uint64_t ackedBytes) noexcept {
+  if (!inflightHi_ || inflightBytes_ + ackedBytes < *inflightHi_) {
+    // Not limited by inflightHi, no need to raise it.
+    return;
+  }
+  // Raise inflightHi by probeUpPackets_ packets over a round.
+  probeUpAckedBytes_ += ackedBytes;
+  uint64_t bytesPerIncrease = std::max<uint64_t>(
+      *inflightHi_ / probeUpPackets_, conn_.udpSendPacketLen);
+  while (probeUpAckedBytes_ >= bytesPerIncrease) {
+    probeUpAckedBytes_ -= bytesPerIncrease;
+    *inflightHi_ += conn_.udpSendPacketLen;
+  }
+  inflightHi_ = std::min(
+      *inflightHi_,
+      conn_.udpSendPacketLen * conn_.transportSettings.maxCwndInMss);
+}
+
+void Bbr2CongestionController::updateProbeBw(
+    TimePoint ackTime,
+    uint64_t prevInflightBytes) noexcept {
+  bool timeToProbe = ackTime - cycleStart_ >= probeWait_ ||
+      roundTripCounter_ - cycleStartRound_ >= kBbr2MaxProbeWaitRounds;
+  switch (state_) {
+    case State::ProbeBwDown: {
+      if (timeToProbe) {
+        transitToProbeBwRefill();
+        break;
+      }
+      auto drainTarget = calculateTargetCwnd(1.0);
+      if (inflightHi_) {
+        drainTarget = std::min<uint64_t>(
+            drainTarget, *inflightHi_ * kBbr2Headroom);
+      }
+      if (inflightBytes_ <= drainTarget) {
+        transitToProbeBwCruise();
+      }
+      break;
+    }
+    case State::ProbeBwCruise:
+      if (timeToProbe) {
+        transitToProbeBwRefill();
+      }
+      break;
+    case State::ProbeBwRefill:
+      // Refill the pipe for a round at the unbounded rate before probing, so
+      // that the losses of probing are not mistaken for the ones of refilling.
+      if (roundTripCounter_ > cycleStartRound_) {
+        transitToProbeBwUp(ackTime);
+      }
+      break;
+    case State::ProbeBwUp:
+      if (ackTime - cycleStart_ > minRtt() &&
+          prevInflightBytes >= calculateTargetCwnd(kBbr2ProbeBwUpPacingGain)) {
+        transitToProbeBwDown(ackTime);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+bool Bbr2CongestionController::shouldProbeRtt(TimePoint ackTime) const
+    noexcept {
+  if (state_ == State::ProbeRtt || !minRttSampler_ || exitingQuiescence_) {
+    return false;
+  }
+  return minRttSampler_->minRttExpired(ackTime) ||
+      (lastProbeRttTime_ &&
+       ackTime - *lastProbeRttTime_ > kBbr2ProbeRttInterval);
+}
+
+void Bbr2CongestionController::handleAckInProbeRtt(
+    bool newRoundTrip,
+    TimePoint ackTime) noexcept {
+  DCHECK(state_ == State::ProbeRtt);
+  // Wait for inflight to get down to the ProbeRtt cwnd, then stay there for
+  // max(1 round trip, kBbr2ProbeRttDuration).
+  if (!earliestTimeToExitProbeRtt_ &&
+      inflightBytes_ < getCongestionWindow() + conn_.udpSendPacketLen) {
+    earliestTimeToExitProbeRtt_ = ackTime + kBbr2ProbeRttDuration;
+    probeRttRound_ = folly::none;
+  } else if (earliestTimeToExitProbeRtt_ && newRoundTrip) {
+    if (!probeRttRound_) {
+      probeRttRound_ = roundTripCounter_;
+    } else if (
+        roundTripCounter_ > *probeRttRound_ &&
+        *earliestTimeToExitProbeRtt_ < ackTime) {
+      exitProbeRtt(ackTime);
+    }
+  }
+}
+
+void Bbr2CongestionController::exitProbeRtt(TimePoint ackTime) noexcept {
+  if (minRttSampler_) {
+    minRttSampler_->timestampMinRtt(ackTime);
+  }
+  lastProbeRttTime_ = ackTime;
+  resetLowerBounds();
+  if (btlbwFound_) {
+    transitToProbeBwDown(ackTime);
+  } else {
+    state_ = State::Startup;
+    pacingGain_ = kBbr2StartupPacingGain;
+    cwndGain_ = kBbr2StartupCwndGain;
+  }
+}
+
+void Bbr2CongestionController::transitToDrain() noexcept {
+  state_ = State::Drain;
+  pacingGain_ = kBbr2DrainPacingGain;
+  cwndGain_ = kBbr2StartupCwndGain;
+}
+
+void Bbr2CongestionController::transitToProbeBwDown(
+    TimePoint ackTime) noexcept {
+  state_ = State::ProbeBwDown;
+  pacingGain_ = kBbr2ProbeBwDownPacingGain;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+  cycleStart_ = ackTime;
+  cycleStartRound_ = roundTripCounter_;
+  // Randomized so that flows sharing a bottleneck don't probe in sync.
+  probeWait_ = kBbr2MinProbeWait +
+      std::chrono::milliseconds(
+                   folly::Random::rand32(kBbr2ProbeWaitJitter.count()));
+}
+
+void Bbr2CongestionController::transitToProbeBwCruise() noexcept {
+  state_ = State::ProbeBwCruise;
+  pacingGain_ = 1.0f;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+}
+
+void Bbr2CongestionController::transitToProbeBwRefill() noexcept {
+  state_ = State::ProbeBwRefill;
+  pacingGain_ = 1.0f;
+  cwndGain_ = kBbr2ProbeBwCwndGain;
+  cycleStartRound_ = roundTripCounter_;
+  probeUpPackets_ = 1;
+  probeUpAckedBytes_ = 0;
+  resetLowerBounds();
+}
+
+void Bbr2CongestionController::transitToProbeBwUp(TimePoint ackTime) noexcept {
+  state_ = State::ProbeBwUp;
+  pacingGain_ = kBbr2ProbeBwUpPacingGain;
+  cwndGain_ = kBbr2ProbeBwUpCwndGain;
+  cycleStart_ = ackTime;
+}
+
+void Bbr2CongestionController::transitToProbeRtt() noexcept {
+  state_ = State::ProbeRtt;
+  pacingGain_ = 1.0f;
+  earliestTimeToExitProbeRtt_ = folly::none;
+  probeRttRound_ = folly::none;
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+}
+
+bool Bbr2CongestionController::isProbingBandwidth() const noexcept {
+  return state_ == State::Startup || state_ == State::ProbeBwRefill ||
+      state_ == State::ProbeBwUp;
+}
+
+void Bbr2CongestionController::detectBottleneckBandwidth() {
+  if (btlbwFound_) {
+    return;
+  }
+  auto bandwidthTarget = previousStartupBandwidth_ * kExpectedStartupGrowth;
+  auto realBandwidth = bandwidth();
+  if (realBandwidth >= bandwidthTarget) {
+    previousStartupBandwidth_ = realBandwidth;
+    slowStartupRoundCounter_ = 0;
+    return;
+  }
+  if (++slowStartupRoundCounter_ >= kStartupSlowGrowRoundLimit) {
+    btlbwFound_ = true;
+  }
+}
+
+uint64_t Bbr2CongestionController::updateAckAggregation(const AckEvent& ack) {
+  DCHECK(ackAggregationStartTime_);
+  uint64_t expectedAckBytes = bandwidth() *
+      std::chrono::duration_cast<std::chrono::microseconds>(
+                                  ack.ackTime - *ackAggregationStartTime_);
+  if (aggregatedAckBytes_ <= expectedAckBytes) {
+    aggregatedAckBytes_ = ack.ackedBytes;
+    ackAggregationStartTime_ = ack.ackTime;
+    return 0;
+  }
+  aggregatedAckBytes_ += ack.ackedBytes;
+  maxAckHeightFilter_.Update(
+      aggregatedAckBytes_ - expectedAckBytes, roundTripCounter_);
+  return aggregatedAckBytes_ - expectedAckBytes;
+}
+
+void Bbr2CongestionController::updatePacing() noexcept {
+  if (!conn_.pacer) {
+    return;
+  }
+  if (conn_.lossState.totalBytesSent < initialCwnd_) {
+    return;
+  }
+  auto bandwidthEstimate = bandwidth();
+  if (!bandwidthEstimate) {
+    return;
+  }
+  auto mrtt = minRtt();
+  uint64_t targetPacingWindow = bandwidthEstimate * pacingGain_ * mrtt;
+  if (btlbwFound_) {
+    pacingWindow_ = targetPacingWindow;
+  } else {
+    pacingWindow_ = std::max(pacingWindow_, targetPacingWindow);
+  }
+  conn_.pacer->refreshPacingRate(pacingWindow_, mrtt);
+}
+
+uint64_t Bbr2CongestionController::calculateTargetCwnd(float gain) const
+    noexcept {
+  auto bandwidthEst = bandwidth();
+  auto minRttEst = minRtt();
+  if (!bandwidthEst || minRttEst == 0us) {
+    return gain * initialCwnd_;
+  }
+  uint64_t bdp = bandwidthEst * minRttEst;
+  return bdp * gain + kQuantaFactor * sendQuantum_;
+}
+
+void Bbr2CongestionController::updateCwnd(
+    uint64_t ackedBytes,
+    uint64_t excessiveBytes) noexcept {
+  if (state_ == State::ProbeRtt) {
+    return;
+  }
+  auto pacingRate = bandwidth() * pacingGain_;
+  if (pacingRate < kLowPacingRateForSendQuantum) {
+    sendQuantum_ = conn_.udpSendPacketLen;
+  } else if (pacingRate < kHighPacingRateForSendQuantum) {
+    sendQuantum_ = conn_.udpSendPacketLen * 2;
+  } else {
+    sendQuantum_ = std::min(pacingRate * 1000us, k64K);
+  }
+  auto targetCwnd = calculateTargetCwnd(cwndGain_);
+  if (btlbwFound_) {
+    targetCwnd += maxAckHeightFilter_.GetBest();
+    cwnd_ = std::min(targetCwnd, cwnd_ + ackedBytes);
+  } else if (
+      cwnd_ < targetCwnd + excessiveBytes ||
+      conn_.lossState.totalBytesAcked < initialCwnd_) {
+    cwnd_ += ackedBytes;
+  }
+  cwnd_ = boundedCwnd(
+      cwnd_,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      kMinCwndInMssForBbr);
+}
+
+uint64_t Bbr2CongestionController::boundCwnd(uint64_t cwnd) const noexcept {
+  if (inflightHi_) {
+    // Stay a bit below inflightHi when not probing.
+    cwnd = std::min<uint64_t>(
+        cwnd,
+        state_ == State::ProbeBwCruise ? *inflightHi_ * kBbr2Headroom
+                                       : *inflightHi_);
+  }
+  if (inflightLo_ && !isProbingBandwidth()) {
+    cwnd = std::min(cwnd, *inflightLo_);
+  }
+  return boundedCwnd(
+      cwnd,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      kMinCwndInMssForBbr);
+}
+
+uint64_t Bbr2CongestionController::getCongestionWindow() const noexcept {
+  if (state_ == State::ProbeRtt) {
+    return boundCwnd(
+        std::min(cwnd_, calculateTargetCwnd(kBbr2ProbeRttCwndGain)));
+  }
+  return boundCwnd(cwnd_);
+}
+
+uint64_t Bbr2CongestionController::getWritableBytes() const noexcept {
+  auto cwnd = getCongestionWindow();
+  return cwnd > inflightBytes_ ? cwnd - inflightBytes_ : 0;
+}
+
+void Bbr2CongestionController::setAppIdle(
+    bool idle,
+    TimePoint /* eventTime */) noexcept {
+  if (conn_.qLogger) {
+    conn_.qLogger->addAppIdleUpdate(kAppIdle, idle);
+  }
+}
+
+void Bbr2CongestionController::setAppLimited() {
+  if (inflightBytes_ > getCongestionWindow()) {
+    return;
+  }
+  if (bandwidthSampler_) {
+    bandwidthSampler_->onAppLimited();
+  }
+  if (conn_.pacer) {
+    conn_.pacer->setAppLimited(true);
+  }
+}
+
+bool Bbr2CongestionController::isAppLimited() const noexcept {
+  return bandwidthSampler_ ? bandwidthSampler_->isAppLimited() : false;
+}
+
+uint64_t Bbr2CongestionController::getBandwidthEstimate() const noexcept {
+  return bandwidth().normalize();
+}
+
+uint8_t Bbr2CongestionController::getStateCode() const noexcept {
+  return static_cast<uint8_t>(state_);
+}
+
+uint64_t Bbr2CongestionController::getBytesInFlight() const noexcept {
+  return inflightBytes_;
+}
+
+Bbr2CongestionController::State Bbr2CongestionController::state() const
+    noexcept {
+  return state_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightHi() const
+    noexcept {
+  return inflightHi_;
+}
+
+folly::Optional<uint64_t> Bbr2CongestionController::inflightLo() const
+    noexcept {
+  return inflightLo_;
+}
+
+std::chrono::microseconds Bbr2CongestionController::minRtt() const noexcept {
+  return minRttSampler_ ? minRttSampler_->minRtt() : 0us;
+}
+
+Bandwidth Bbr2CongestionController::bandwidth() const noexcept {
+  auto maxBandwidth =
+      bandwidthSampler_ ? bandwidthSampler_->getBandwidth() : Bandwidth();
+  if (bandwidthLo_ && *bandwidthLo_ < maxBandwidth) {
+    return *bandwidthLo_;
+  }
+  return maxBandwidth;
+}
+
+std::string bbr2StateToString(Bbr2CongestionController::State state) {
+  switch (state) {
+    case Bbr2CongestionController::State::Startup:
+      return "Startup";
+    case Bbr2CongestionController::State::Drain:
+      return "Drain";
+    case Bbr2CongestionController::State::ProbeBwDown:
+      return "ProbeBwDown";
+    case Bbr2CongestionController::State::ProbeBwCruise:
+      return "ProbeBwCruise";
+    case Bbr2CongestionController::State::ProbeBwRefill:
+      return "ProbeBwRefill";
+    case Bbr2CongestionController::State::ProbeBwUp:
+      return "ProbeBwUp";
+    case Bbr2CongestionController::State::ProbeRtt:
+      return "ProbeRtt";
+  }
+  return "BadBbr2State";
+}
+
+std::ostream& operator<<(
+    std::ostream& os,
+    const Bbr2CongestionController& bbr) {
+  os << "Bbr2: state=" << bbr2StateToString(bbr.state_)
+     << ", cwnd_=" << bbr.cwnd_
+     << ", inflightHi_=" << bbr.inflightHi_.value_or(0)
+     << ", inflightLo_=" << bbr.inflightLo_.value_or(0)
+     << ", pacingGain_=" << bbr.pacingGain_
+     << ", minRtt=" << bbr.minRtt().count()
+     << "us, bandwidth=" << bbr.bandwidth();
+  return os;
+}
+} // namespace quic
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/Bandwidth.h>
+#include <quic/congestion_control/Bbr.h>
+#include <quic/congestion_control/third_party/windowed_filter.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+// Pacing gain during Startup. Cwnd gain during Startup is kBbr2StartupCwndGain
+constexpr float kBbr2StartupPacingGain = 2.77f;
+constexpr float kBbr2StartupCwndGain = 2.0f;
+// Pacing gain during Drain, which drains the queue built up in Startup
+constexpr float kBbr2DrainPacingGain = 1.0f / kStartupGain;
+// Cwnd gain during ProbeBw
+constexpr float kBbr2ProbeBwCwndGain = 2.0f;
+// Pacing gains of the ProbeBw phases
+constexpr float kBbr2ProbeBwDownPacingGain = 0.9f;
+constexpr float kBbr2ProbeBwUpPacingGain = 1.25f;
+// Cwnd gain during ProbeBw Up, to leave room for the probing
+constexpr float kBbr2ProbeBwUpCwndGain = 2.25f;
+// The loss rate over a round above which inflight is considered too high
+constexpr float kBbr2LossThreshold = 0.02f;
+// The fraction of the packets acked in a round that can be CE marked before
+// inflight is considered too high
+constexpr float kBbr2ECNThreshold = 0.5f;
+// Multiplicative decrease of the bounds when the loss rate is too high
+constexpr float kBbr2Beta = 0.7f;
+// Fraction of inflightHi used outside of probing, to leave some headroom for
+// the other flows
+constexpr float kBbr2Headroom = 0.85f;
+// Cwnd during ProbeRtt, as a fraction of the BDP
+constexpr float kBbr2ProbeRttCwndGain = 0.5f;
+// How often to ProbeRtt, much less than the min rtt expiration of BBRv1
+constexpr std::chrono::seconds kBbr2ProbeRttInterval{5};
+// How long to stay at the ProbeRtt cwnd
+constexpr std::chrono::milliseconds kBbr2ProbeRttDuration{200};
+// ProbeBw waits between kBbr2MinProbeWait and kBbr2MinProbeWait +
+// kBbr2ProbeWaitJitter before probing for more bandwidth, or at most
+// kBbr2MaxProbeWaitRounds round trips.
+constexpr std::chrono::seconds kBbr2MinProbeWait{2};
+constexpr std::chrono::milliseconds kBbr2ProbeWaitJitter{1000};
+constexpr uint64_t kBbr2MaxProbeWaitRounds = 63;
+
+/**
+ * A BBRv2 congestion controller. On top of the bandwidth and min rtt model of
+ * BBRv1, it keeps bounds on inflight that react to losses and ECN-CE marks:
+ *
+ * - inflightHi is the highest inflight that didn't cause too many losses or
+ *   marks. The connection only goes above it when probing for bandwidth, and
+ *   stays a bit below it otherwise.
+ * - inflightLo and bandwidthLo are short term bounds that are lowered in
+ *   every round with losses or marks, and reset when probing for bandwidth.
+ *
+ * ProbeBw cycles through Down, Cruise, Refill and Up, and only probes up once
+ * every few seconds instead of every 8 round trips. ProbeRtt runs every 5
+ * seconds, at half of the BDP instead of 4 packets.
+ *
+ * The samplers are the same as BbrCongestionController's.
+ */
+class Bbr2CongestionController : public CongestionController {
+ public:
+  enum class State : uint8_t {
+    Startup,
+    Drain,
+    ProbeBwDown,
+    ProbeBwCruise,
+    ProbeBwRefill,
+    ProbeBwUp,
+    ProbeRtt,
+  };
+
+  explicit Bbr2CongestionController(QuicConnectionStateBase& conn);
+
+  void setRttSampler(
+      std::unique_ptr<BbrCongestionController::MinRttSampler> sampler) noexcept;
+  void setBandwidthSampler(
+      std::unique_ptr<BbrCongestionController::BandwidthSampler>
+          sampler) noexcept;
+
+  void onRemoveBytesFromInflight(uint64_t bytesToRemove) override;
+  void onPacketSent(const OutstandingPacket&) override;
+  void onPacketAckOrLoss(
+      folly::Optional<AckEvent> ackEvent,
+      folly::Optional<LossEvent> lossEvent) override;
+  uint64_t getWritableBytes() const noexcept override;
+
+  uint64_t getCongestionWindow() const noexcept override;
+  void setConnectionEmulation(uint8_t) noexcept override;
+  CongestionControlType type() const noexcept override;
+  void setAppIdle(bool idle, TimePoint eventTime) noexcept override;
+  void setAppLimited() override;
+
+  bool isAppLimited() const noexcept override;
+
+  uint64_t getBandwidthEstimate() const noexcept override;
+
+  uint8_t getStateCode() const noexcept override;
+
+  uint64_t getBytesInFlight() const noexcept override;
+
+  State state() const noexcept;
+
+  /**
+   * The inflight bounds, none when they are not set.
+   */
+  folly::Optional<uint64_t> inflightHi() const noexcept;
+  folly::Optional<uint64_t> inflightLo() const noexcept;
+
+ private:
+  void onPacketAcked(const AckEvent& ack, uint64_t prevInflightBytes);
+  void onRoundEnd(TimePoint ackTime, bool appLimitedSample);
+  void updatePacing() noexcept;
+  uint64_t updateAckAggregation(const AckEvent& ack);
+  void detectBottleneckBandwidth();
+  bool isInflightTooHigh(uint64_t prevInflightBytes) const noexcept;
+  void handleInflightTooHigh(
+      uint64_t prevInflightBytes,
+      TimePoint lossTime) noexcept;
+  void adaptLowerBounds(TimePoint ackTime) noexcept;
+  void resetLowerBounds() noexcept;
+  void updateProbeBw(TimePoint ackTime, uint64_t prevInflightBytes) noexcept;
+  void raiseInflightHi(uint64_t ackedBytes) noexcept;
+  bool shouldProbeRtt(TimePoint ackTime) const noexcept;
+  void handleAckInProbeRtt(bool newRoundTrip, TimePoint ackTime) noexcept;
+  bool isProbingBandwidth() const noexcept;
+
+  void transitToDrain() noexcept;
+  void transitToProbeBwDown(TimePoint ackTime) noexcept;
+  void transitToProbeBwCruise() noexcept;
+  void transitToProbeBwRefill() noexcept;
+  void transitToProbeBwUp(TimePoint ackTime) noexcept;
+  void transitToProbeRtt() noexcept;
+  void exitProbeRtt(TimePoint ackTime) noexcept;
+
+  bool updateRoundTripCounter(TimePoint largestAckedSentTime) noexcept;
+
+  uint64_t calculateTargetCwnd(float gain) const noexcept;
+  uint64_t boundCwnd(uint64_t cwnd) const noexcept;
+  void updateCwnd(uint64_t ackedBytes, uint64_t excessiveBytes) noexcept;
+  std::chrono::microseconds minRtt() const noexcept;
+  // The bandwidth estimate, bounded by bandwidthLo_.
+  Bandwidth bandwidth() const noexcept;
+
+  QuicConnectionStateBase& conn_;
+  State state_{State::Startup};
+
+  // Number of round trips the connection has witnessed
+  uint64_t roundTripCounter_{0};
+  // When a packet with send time later than endOfRoundTrip_ is acked, the
+  // current round trip is ended.
+  TimePoint endOfRoundTrip_;
+  TimePoint roundStart_;
+  // Bytes acked and lost in the current round
+  uint64_t roundAckedBytes_{0};
+  uint64_t roundLostBytes_{0};
+  // Packets acked and reported as CE marked in the current round
+  uint64_t roundAckedPackets_{0};
+  uint64_t roundCEMarks_{0};
+  // Cwnd in bytes, before the inflight bounds
+  uint64_t cwnd_;
+  uint64_t initialCwnd_;
+  uint64_t inflightBytes_{0};
+  // Number of bytes we expect to send over one RTT when paced write.
+  uint64_t pacingWindow_{0};
+
+  float cwndGain_{kBbr2StartupCwndGain};
+  float pacingGain_{kBbr2StartupPacingGain};
+
+  bool btlbwFound_{false};
+  uint64_t sendQuantum_{0};
+  Bandwidth previousStartupBandwidth_;
+  uint8_t slowStartupRoundCounter_{0};
+
+  folly::Optional<uint64_t> inflightHi_;
+  folly::Optional<uint64_t> inflightLo_;
+  folly::Optional<Bandwidth> bandwidthLo_;
+  // Doubles every round of ProbeBw Up, in packets
+  uint64_t probeUpPackets_{1};
+  uint64_t probeUpAckedBytes_{0};
+
+  // When the current ProbeBw phase started
+  TimePoint cycleStart_;
+  uint64_t cycleStartRound_{0};
+  // How long to cruise before probing again
+  std::chrono::microseconds probeWait_{0};
+
+  std::unique_ptr<BbrCongestionController::MinRttSampler> minRttSampler_;
+  std::unique_ptr<BbrCongestionController::BandwidthSampler>
+      bandwidthSampler_;
+
+  folly::Optional<TimePoint> lastProbeRttTime_;
+  folly::Optional<TimePoint> earliestTimeToExitProbeRtt_;
+  folly::Optional<uint64_t> probeRttRound_;
+
+  WindowedFilter<
+      uint64_t /* ack bytes count */,
+      MaxFilter<uint64_t>,
+      uint64_t /* roundtrip count */,
+      uint64_t /* roundtrip count */>
+      maxAckHeightFilter_;
+  folly::Optional<TimePoint> ackAggregationStartTime_;
+  uint64_t aggregatedAckBytes_{0};
+
+  bool exitingQuiescence_{false};
+
+  friend std::ostream& operator<<(
+      std::ostream& os,
+      const Bbr2CongestionController& bbr);
+};
+
+std::ostream& operator<<(std::ostream& os, const Bbr2CongestionController& bbr);
+
+std::string bbr2StateToString(Bbr2CongestionController::State state);
+} // namespace quic
@@ -10,7 +10,7 @@
 #pragma once
 
 #include <quic/congestion_control/Bbr.h>
-#include <quic/congestion_control/third_party/windowed_filter.h>
+#include <quic/congestion_control/MonotonicWindowedFilter.h>
 #include <quic/state/StateData.h>
 
 namespace quic {
@@ -38,7 +38,12 @@ class BbrBandwidthSampler : public BbrCongestionController::BandwidthSampler {
 
  private:
   QuicConnectionStateBase& conn_;
-  WindowedFilter<Bandwidth, MaxFilter<Bandwidth>, uint64_t, uint64_t>
+  MonotonicWindowedFilter<
+      Bandwidth,
+      MaxFilter<Bandwidth>,
+      uint64_t,
+      uint64_t,
+      kBandwidthFilterCapacity>
       windowedFilter_;
   bool appLimited_{false};
 
@@ -9,6 +9,7 @@
 #include <quic/congestion_control/CongestionControllerFactory.h>
 
 #include <quic/congestion_control/Bbr.h>
+#include <quic/congestion_control/Bbr2.h>
 #include <quic/congestion_control/BbrBandwidthSampler.h>
 #include <quic/congestion_control/BbrRttSampler.h>
 #include <quic/congestion_control/Copa.h>
@@ -22,19 +23,44 @@ std::unique_ptr<CongestionController>
 DefaultCongestionControllerFactory::makeCongestionController(
     QuicConnectionStateBase& conn,
     CongestionControlType type) {
+  const auto& profile = conn.transportSettings.ccProfile;
   std::unique_ptr<CongestionController> congestionController;
   switch (type) {
     case CongestionControlType::NewReno:
-      congestionController = std::make_unique<NewReno>(conn);
+      congestionController = std::make_unique<NewReno>(
+          conn, profile.proportionalRateReduction, profile.cwndValidation);
       break;
-    case CongestionControlType::Cubic:
-      congestionController = std::make_unique<Cubic>(conn);
+    case CongestionControlType::Cubic: {
+      Cubic::CubicBuilder builder;
+      builder.setTcpFriendly(profile.cubicTcpFriendly)
+          .setAckTrain(profile.cubicAckTrain)
+          .setReductionFactor(
+              profile.cubicReductionFactor.value_or(
+                  kDefaultCubicReductionFactor))
+          .setProportionalRateReduction(profile.proportionalRateReduction)
+          .setCwndValidation(profile.cwndValidation);
+      if (profile.cubicHystartPlusPlus) {
+        builder.setHystartPlusPlus();
+      }
+      congestionController = builder.build(conn);
       break;
-    case CongestionControlType::Copa:
-      congestionController = std::make_unique<Copa>(conn);
+    }
+    case CongestionControlType::Copa: {
+      Copa::CopaConfig config;
+      config.modeSwitching = profile.copaModeSwitching;
+      congestionController = std::make_unique<Copa>(conn, config);
       break;
+    }
     case CongestionControlType::BBR: {
       BbrCongestionController::BbrConfig config;
+      config.conservativeRecovery = profile.bbrConservativeRecovery;
+      config.largeProbeRttCwnd = profile.bbrLargeProbeRttCwnd;
+      config.enableAckAggregationInStartup =
+          profile.bbrEnableAckAggregationInStartup;
+      config.probeRttDisabledIfAppLimited =
+          profile.bbrProbeRttDisabledIfAppLimited;
+      config.drainToTarget = profile.bbrDrainToTarget;
+      config.startupGain = profile.bbrStartupGain.value_or(kStartupGain);
       auto bbr = std::make_unique<BbrCongestionController>(conn, config);
       bbr->setRttSampler(std::make_unique<BbrRttSampler>(
           std::chrono::seconds(kDefaultRttSamplerExpiration)));
@@ -42,6 +68,14 @@ DefaultCongestionControllerFactory::makeCongestionController(
       congestionController = std::move(bbr);
       break;
     }
+    case CongestionControlType::BBR2: {
+      auto bbr = std::make_unique<Bbr2CongestionController>(conn);
+      bbr->setRttSampler(std::make_unique<BbrRttSampler>(
+          std::chrono::seconds(kDefaultRttSamplerExpiration)));
+      bbr->setBandwidthSampler(std::make_unique<BbrBandwidthSampler>(conn));
+      congestionController = std::move(bbr);
+      break;
+    }
     case CongestionControlType::None:
       break;
   }
@@ -16,21 +16,25 @@ namespace quic {
 
 using namespace std::chrono;
 
-Copa::Copa(QuicConnectionStateBase& conn)
+Copa::Copa(QuicConnectionStateBase& conn, CopaConfig config)
     : conn_(conn),
+      config_(config),
       cwndBytes_(conn.transportSettings.initCwndInMss * conn.udpSendPacketLen),
       isSlowStart_(true),
       minRTTFilter_(kMinRTTWindowLength.count(), 0us, 0),
       standingRTTFilter_(
           100000, /*100ms*/
           0us,
-          0) {
+          0),
+      maxRTTFilter_(kMinRTTWindowLength.count(), 0us, 0) {
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
   if (conn_.transportSettings.latencyFactor.hasValue()) {
     latencyFactor_ = conn_.transportSettings.latencyFactor.value();
   }
+  defaultLatencyFactor_ = latencyFactor_;
+  inverseLatencyFactor_ = 1.0 / defaultLatencyFactor_;
 }
 
 void Copa::onRemoveBytesFromInflight(uint64_t bytes) {
@@ -107,6 +111,47 @@ void Copa::checkAndUpdateDirection(const TimePoint ackTime) {
   }
 }
 
+/**
+ * The standing queue of a Copa flow drains every few RTTs. If it hasn't been
+ * nearly empty, a queueing delay under a tenth of the RTT variation, for
+ * kCopaModeSwitchRtts srtts, a flow that fills the buffer shares the
+ * bottleneck and Copa competes with it: 1/latencyFactor grows by one every
+ * srtt, and is halved on loss.
+ */
+void Copa::updateMode(
+    TimePoint ackTime,
+    std::chrono::microseconds rttMin,
+    std::chrono::microseconds rttStanding) {
+  maxRTTFilter_.SetWindowLength(
+      conn_.lossState.srtt.count() * kCopaMaxRttWindowRtts);
+  maxRTTFilter_.Update(
+      conn_.lossState.lrtt,
+      duration_cast<microseconds>(ackTime.time_since_epoch()).count());
+  auto rttMax = maxRTTFilter_.GetBest();
+  if (!lastQueueNearlyEmptyTime_ ||
+      (rttStanding - rttMin) * 10 <= (rttMax - rttMin)) {
+    lastQueueNearlyEmptyTime_ = ackTime;
+  }
+  bool competitive = ackTime - *lastQueueNearlyEmptyTime_ >
+      conn_.lossState.srtt * kCopaModeSwitchRtts;
+  if (competitive != competitiveMode_) {
+    VLOG(10) << __func__ << " competitive mode=" << competitive
+             << " rttMin=" << rttMin.count()
+             << " rttStanding=" << rttStanding.count()
+             << " rttMax=" << rttMax.count() << " " << conn_;
+    competitiveMode_ = competitive;
+    inverseLatencyFactor_ = 1.0 / defaultLatencyFactor_;
+    lastInverseLatencyFactorIncrease_ = ackTime;
+  } else if (
+      competitiveMode_ &&
+      ackTime - lastInverseLatencyFactorIncrease_ >= conn_.lossState.srtt) {
+    inverseLatencyFactor_ += 1.0;
+    lastInverseLatencyFactorIncrease_ = ackTime;
+  }
+  latencyFactor_ =
+      competitiveMode_ ? 1.0 / inverseLatencyFactor_ : defaultLatencyFactor_;
+}
+
 void Copa::changeDirection(
     VelocityState::Direction newDirection,
     const TimePoint ackTime) {
@@ -141,16 +186,13 @@ void Copa::onPacketAckOrLoss(
 void Copa::onPacketAcked(const AckEvent& ack) {
   DCHECK(ack.largestAckedPacket.hasValue());
   subtractAndCheckUnderflow(bytesInFlight_, ack.ackedBytes);
-  minRTTFilter_.Update(
-      conn_.lossState.lrtt,
+  auto ackTimeMicroSec =
       std::chrono::duration_cast<microseconds>(ack.ackTime.time_since_epoch())
-          .count());
+          .count();
+  minRTTFilter_.Update(conn_.lossState.lrtt, ackTimeMicroSec);
   auto rttMin = minRTTFilter_.GetBest();
   standingRTTFilter_.SetWindowLength(conn_.lossState.srtt.count() / 2);
-  standingRTTFilter_.Update(
-      conn_.lossState.lrtt,
-      std::chrono::duration_cast<microseconds>(ack.ackTime.time_since_epoch())
-          .count());
+  standingRTTFilter_.Update(conn_.lossState.lrtt, ackTimeMicroSec);
   auto rttStandingMicroSec = standingRTTFilter_.GetBest().count();
 
   VLOG(10) << __func__ << "ack size=" << ack.ackedBytes
@@ -190,6 +232,10 @@ void Copa::onPacketAcked(const AckEvent& ack) {
            << " estimated queuing delay microsec =" << delayInMicroSec << " "
            << conn_;
 
+  if (config_.modeSwitching) {
+    updateMode(ack.ackTime, rttMin, microseconds(rttStandingMicroSec));
+  }
+
   bool increaseCwnd = false;
   if (delayInMicroSec == 0) {
     // taking care of inf targetRate case here, this happens in beginning where
@@ -277,6 +323,11 @@ void Copa::onPacketLoss(const LossEvent& loss) {
   }
   DCHECK(loss.largestLostPacketNum.hasValue());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
+  if (competitiveMode_) {
+    inverseLatencyFactor_ = std::max(
+        inverseLatencyFactor_ / 2, 1.0 / defaultLatencyFactor_);
+    latencyFactor_ = 1.0 / inverseLatencyFactor_;
+  }
   if (loss.persistentCongestion) {
     // TODO See if we should go to slowStart here
     VLOG(10) << __func__ << " writable=" << getWritableBytes()
@@ -309,6 +360,14 @@ bool Copa::inSlowStart() {
   return isSlowStart_;
 }
 
+bool Copa::inCompetitiveMode() const noexcept {
+  return competitiveMode_;
+}
+
+double Copa::getLatencyFactor() const noexcept {
+  return latencyFactor_;
+}
+
 CongestionControlType Copa::type() const noexcept {
   return CongestionControlType::Copa;
 }
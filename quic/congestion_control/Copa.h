@@ -10,7 +10,7 @@
 
 #include <folly/Optional.h>
 #include <quic/QuicException.h>
-#include <quic/congestion_control/third_party/windowed_filter.h>
+#include <quic/congestion_control/MonotonicWindowedFilter.h>
 #include <quic/state/StateData.h>
 
 #include <limits>
@@ -19,6 +19,13 @@ namespace quic {
 
 using namespace std::chrono_literals;
 constexpr std::chrono::microseconds kMinRTTWindowLength{10s};
+// Number of candidate samples kept by the min RTT filters
+constexpr size_t kCopaRttFilterCapacity = 8;
+// With mode switching, the max RTT is measured over this many srtts, and the
+// queue has to have been nearly empty within kCopaModeSwitchRtts srtts for
+// Copa to stay in its default mode.
+constexpr int64_t kCopaMaxRttWindowRtts = 4;
+constexpr int64_t kCopaModeSwitchRtts = 5;
 
 /**
  * Algorithm description https://fb.quip.com/kgubABy1yuYR
@@ -28,7 +35,20 @@ constexpr std::chrono::microseconds kMinRTTWindowLength{10s};
 
 class Copa : public CongestionController {
  public:
-  explicit Copa(QuicConnectionStateBase& conn);
+  struct CopaConfig {
+    /**
+     * Whether Copa switches to its competitive mode when the queue doesn't
+     * drain anymore, which means a buffer-filling flow shares the
+     * bottleneck. In competitive mode 1/latencyFactor grows by one every
+     * srtt and is halved on loss, never going below its default, so Copa
+     * gets its share of the queue instead of starving.
+     */
+    bool modeSwitching{false};
+  };
+
+  explicit Copa(
+      QuicConnectionStateBase& conn,
+      CopaConfig config = CopaConfig());
   void onRemoveBytesFromInflight(uint64_t) override;
   void onPacketSent(const OutstandingPacket& packet) override;
   void onPacketAckOrLoss(folly::Optional<AckEvent>, folly::Optional<LossEvent>)
@@ -40,7 +60,11 @@ class Copa : public CongestionController {
 
   bool inSlowStart();
 
-  uint64_t getBytesInFlight() const noexcept;
+  bool inCompetitiveMode() const noexcept;
+
+  double getLatencyFactor() const noexcept;
+
+  uint64_t getBytesInFlight() const noexcept override;
 
   void setConnectionEmulation(uint8_t) noexcept override;
   void setAppIdle(bool, TimePoint) noexcept override;
@@ -65,11 +89,16 @@ class Copa : public CongestionController {
     uint64_t lastRecordedCwndBytes;
     folly::Optional<TimePoint> lastCwndRecordTime{folly::none};
   };
+  void updateMode(
+      TimePoint ackTime,
+      std::chrono::microseconds rttMin,
+      std::chrono::microseconds rttStanding);
   void checkAndUpdateDirection(const TimePoint ackTime);
   void changeDirection(
       VelocityState::Direction newDirection,
       const TimePoint ackTime);
   QuicConnectionStateBase& conn_;
+  CopaConfig config_;
   uint64_t bytesInFlight_{0};
   uint64_t cwndBytes_;
 
@@ -77,20 +106,30 @@ class Copa : public CongestionController {
   // time at which cwnd was last doubled during slow start
   folly::Optional<TimePoint> lastCwndDoubleTime_{folly::none};
 
-  WindowedFilter<
+  MonotonicWindowedFilter<
       std::chrono::microseconds,
       MinFilter<std::chrono::microseconds>,
       uint64_t,
-      uint64_t>
+      uint64_t,
+      kCopaRttFilterCapacity>
       minRTTFilter_; // To get min RTT over 10 seconds
 
-  WindowedFilter<
+  MonotonicWindowedFilter<
       std::chrono::microseconds,
       MinFilter<std::chrono::microseconds>,
       uint64_t,
-      uint64_t>
+      uint64_t,
+      kCopaRttFilterCapacity>
       standingRTTFilter_; // To get min RTT over srtt/2
 
+  MonotonicWindowedFilter<
+      std::chrono::microseconds,
+      MaxFilter<std::chrono::microseconds>,
+      uint64_t,
+      uint64_t,
+      kCopaRttFilterCapacity>
+      maxRTTFilter_; // To get max RTT over kCopaMaxRttWindowRtts srtts
+
   VelocityState velocityState_;
   /**
    * latencyFactor_ determines how latency sensitive the algorithm is. Lower
@@ -98,5 +137,13 @@ class Copa : public CongestionController {
    * it will minimize delay at expense of throughput.
    */
   double latencyFactor_{0.50};
+  double defaultLatencyFactor_{0.50};
+
+  bool competitiveMode_{false};
+  // Last time the standing queue was nearly empty.
+  folly::Optional<TimePoint> lastQueueNearlyEmptyTime_;
+  // 1 / latencyFactor_ in competitive mode, and when it last grew.
+  double inverseLatencyFactor_{2.0};
+  TimePoint lastInverseLatencyFactorIncrease_;
 };
 } // namespace quic
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CwndValidator.h>
+
+#include <algorithm>
+
+namespace quic {
+
+namespace {
+// The round trips are at least this long, before there is an RTT sample.
+constexpr std::chrono::microseconds kMinPipeAckRound{1000};
+} // namespace
+
+void CwndValidator::onPacketAcked(
+    uint64_t ackedBytes,
+    TimePoint ackTime,
+    std::chrono::microseconds srtt) {
+  auto round = std::max(srtt, kMinPipeAckRound);
+  if (!roundStart_) {
+    roundStart_ = ackTime;
+  }
+  if (ackTime >= *roundStart_ + round) {
+    // The rounds without any ack, e.g. while idle, had nothing acked.
+    uint64_t elapsedRounds = (ackTime - *roundStart_) / round;
+    if (elapsedRounds > pastRoundsAcked_.size()) {
+      pastRoundsAcked_.fill(0);
+    } else {
+      for (uint64_t i = 0; i < elapsedRounds; ++i) {
+        pastRoundsAcked_[nextRound_] = i == 0 ? currentRoundAcked_ : 0;
+        nextRound_ = (nextRound_ + 1) % pastRoundsAcked_.size();
+      }
+    }
+    currentRoundAcked_ = 0;
+    *roundStart_ += elapsedRounds * round;
+  }
+  currentRoundAcked_ += ackedBytes;
+}
+
+uint64_t CwndValidator::getPipeAck() const noexcept {
+  return std::max(
+      currentRoundAcked_,
+      *std::max_element(pastRoundsAcked_.begin(), pastRoundsAcked_.end()));
+}
+
+bool CwndValidator::nonValidatedPeriodExpired(
+    uint64_t cwndBytes,
+    TimePoint now) noexcept {
+  if (!lastValidatedTime_ || isValidated(cwndBytes)) {
+    lastValidatedTime_ = now;
+    return false;
+  }
+  if (now - *lastValidatedTime_ < nonValidatedPeriod_) {
+    return false;
+  }
+  lastValidatedTime_ = now;
+  return true;
+}
+
+uint64_t CwndValidator::reduceCwnd(
+    uint64_t cwndBytes,
+    uint64_t restartWindowBytes) noexcept {
+  return std::min(cwndBytes, std::max(cwndBytes / 2, restartWindowBytes));
+}
+} // namespace quic
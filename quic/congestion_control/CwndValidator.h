@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+
+#include <array>
+#include <chrono>
+
+namespace quic {
+
+/**
+ * Congestion window validation (RFC 7661) for the loss based controllers.
+ *
+ * The cwnd only reflects what the path can take if the sender fills it. The
+ * validator measures pipeACK, the largest flight acked in a round trip over
+ * the last kPipeAckSampleRounds round trips, and the cwnd is validated while
+ * pipeACK is at least half of it. An unvalidated cwnd must not grow from
+ * the acks, and after kCwndNonValidatedPeriod of not being validated it is
+ * halved, so that a connection with request and response traffic doesn't
+ * keep a large window it never tested for minutes.
+ */
+class CwndValidator {
+ public:
+  explicit CwndValidator(
+      std::chrono::microseconds nonValidatedPeriod = kCwndNonValidatedPeriod)
+      : nonValidatedPeriod_(nonValidatedPeriod) {}
+
+  void onPacketAcked(
+      uint64_t ackedBytes,
+      TimePoint ackTime,
+      std::chrono::microseconds srtt);
+
+  uint64_t getPipeAck() const noexcept;
+
+  bool isValidated(uint64_t cwndBytes) const noexcept {
+    return 2 * getPipeAck() >= cwndBytes;
+  }
+
+  /**
+   * Called on every packet sent: whether the cwnd hasn't been validated for
+   * the whole non-validated period, in which case the controller reduces it
+   * with reduceCwnd() and a new period starts.
+   */
+  bool nonValidatedPeriodExpired(uint64_t cwndBytes, TimePoint now) noexcept;
+
+  /**
+   * The cwnd at the end of a non-validated period: max(cwnd / 2, restart
+   * window), never more than the current one.
+   */
+  static uint64_t reduceCwnd(
+      uint64_t cwndBytes,
+      uint64_t restartWindowBytes) noexcept;
+
+ private:
+  std::chrono::microseconds nonValidatedPeriod_;
+  folly::Optional<TimePoint> roundStart_;
+  // The bytes acked in the current round trip, and in the last ones.
+  uint64_t currentRoundAcked_{0};
+  std::array<uint64_t, kPipeAckSampleRounds> pastRoundsAcked_{};
+  size_t nextRound_{0};
+  folly::Optional<TimePoint> lastValidatedTime_;
+};
+} // namespace quic
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/congestion_control/third_party/windowed_filter.h>
+
+#include <array>
+#include <cstddef>
+
+namespace quic {
+
+/**
+ * A windowed min or max filter that keeps the candidates for the best sample
+ * in a monotonic deque: every sample is at least as good as the ones after it
+ * and older than them. A new sample drops the candidates it is at least as
+ * good as, and the candidates older than the window are dropped from the
+ * front. The best sample is then always the front, and the filter is exact as
+ * long as there are no more than Capacity candidates. When it is full, the
+ * second best candidate is dropped to make room, so that the best one is
+ * never lost before it expires.
+ *
+ * The deque is a ring buffer inline in the filter, updates don't allocate and
+ * only touch the few cache lines of the filter itself.
+ *
+ * The interface is the same as WindowedFilter's, Compare is MinFilter<T> or
+ * MaxFilter<T>.
+ */
+template <
+    class T,
+    class Compare,
+    typename TimeT,
+    typename TimeDeltaT,
+    size_t Capacity>
+class MonotonicWindowedFilter {
+  static_assert(
+      Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+      "Capacity must be a power of 2 of at least 2");
+
+ public:
+  // windowLength is the period after which a sample expires. zeroValue
+  // is what GetBest() returns before the first sample.
+  MonotonicWindowedFilter(
+      TimeDeltaT windowLength,
+      T zeroValue,
+      TimeT /* zeroTime */)
+      : windowLength_(windowLength), zeroValue_(zeroValue) {}
+
+  // Changes the window length. The samples that are now out of the window
+  // expire with the next Update().
+  void SetWindowLength(TimeDeltaT windowLength) {
+    windowLength_ = windowLength;
+  }
+
+  void Update(T newSample, TimeT newTime) {
+    while (size_ > 0 && Compare()(newSample, at(size_ - 1).sample)) {
+      --size_;
+    }
+    if (size_ == Capacity) {
+      for (size_t i = 1; i + 1 < size_; ++i) {
+        at(i) = at(i + 1);
+      }
+      --size_;
+    }
+    at(size_++) = Sample{newSample, newTime};
+    // The new sample is always in the window, so this never empties the deque.
+    while (newTime - at(0).time > windowLength_) {
+      head_ = (head_ + 1) & kMask;
+      --size_;
+    }
+  }
+
+  // Drops all the samples but the new one.
+  void Reset(T newSample, TimeT newTime) {
+    head_ = 0;
+    size_ = 0;
+    at(size_++) = Sample{newSample, newTime};
+  }
+
+  T GetBest() const {
+    return size_ > 0 ? at(0).sample : zeroValue_;
+  }
+
+ private:
+  static constexpr size_t kMask = Capacity - 1;
+
+  struct Sample {
+    T sample;
+    TimeT time;
+  };
+
+  Sample& at(size_t index) {
+    return samples_[(head_ + index) & kMask];
+  }
+
+  const Sample& at(size_t index) const {
+    return samples_[(head_ + index) & kMask];
+  }
+
+  TimeDeltaT windowLength_;
+  T zeroValue_;
+  size_t head_{0};
+  size_t size_{0};
+  std::array<Sample, Capacity> samples_;
+};
+} // namespace quic
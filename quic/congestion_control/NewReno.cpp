@@ -14,7 +14,10 @@ namespace quic {
 
 constexpr int kRenoLossReductionFactorShift = 1;
 
-NewReno::NewReno(QuicConnectionStateBase& conn)
+NewReno::NewReno(
+    QuicConnectionStateBase& conn,
+    bool proportionalRateReduction,
+    bool cwndValidation)
     : conn_(conn),
       ssthresh_(std::numeric_limits<uint32_t>::max()),
       cwndBytes_(conn.transportSettings.initCwndInMss * conn.udpSendPacketLen) {
@@ -23,6 +26,12 @@ NewReno::NewReno(QuicConnectionStateBase& conn)
       conn_.udpSendPacketLen,
       conn_.transportSettings.maxCwndInMss,
       conn_.transportSettings.minCwndInMss);
+  if (proportionalRateReduction) {
+    prr_.emplace();
+  }
+  if (cwndValidation) {
+    cwndValidator_.emplace();
+  }
 }
 
 void NewReno::onRemoveBytesFromInflight(uint64_t bytes) {
@@ -37,7 +46,23 @@ void NewReno::onRemoveBytesFromInflight(uint64_t bytes) {
 }
 
 void NewReno::onPacketSent(const OutstandingPacket& packet) {
+  if (cwndValidator_ &&
+      cwndValidator_->nonValidatedPeriodExpired(cwndBytes_, packet.time)) {
+    ssthresh_ = std::max(ssthresh_, cwndBytes_ / 4 * 3);
+    cwndBytes_ = boundedCwnd(
+        CwndValidator::reduceCwnd(
+            cwndBytes_,
+            conn_.transportSettings.initCwndInMss * conn_.udpSendPacketLen),
+        conn_.udpSendPacketLen,
+        conn_.transportSettings.maxCwndInMss,
+        conn_.transportSettings.minCwndInMss);
+    VLOG(10) << __func__ << " cwnd not validated, ssthresh=" << ssthresh_
+             << " cwnd=" << cwndBytes_ << " " << conn_;
+  }
   addAndCheckOverflow(bytesInFlight_, packet.encodedSize);
+  if (prr_) {
+    prr_->onPacketSent(packet.encodedSize);
+  }
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_
            << " packetNum=" << packet.packet.header.getPacketSequenceNum()
@@ -51,6 +76,14 @@ void NewReno::onPacketSent(const OutstandingPacket& packet) {
 void NewReno::onAckEvent(const AckEvent& ack) {
   DCHECK(ack.largestAckedPacket.hasValue() && !ack.ackedPackets.empty());
   subtractAndCheckUnderflow(bytesInFlight_, ack.ackedBytes);
+  if (prr_ && prr_->inRecovery()) {
+    if (ack.largestAckedPacketSentTime > *endOfRecovery_) {
+      prr_->onExitRecovery();
+    } else {
+      prr_->onPacketAcked(
+          ack.ackedBytes, bytesInFlight_, conn_.udpSendPacketLen);
+    }
+  }
   VLOG(10) << __func__ << " writable=" << getWritableBytes()
            << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
            << conn_;
@@ -58,6 +91,14 @@ void NewReno::onAckEvent(const AckEvent& ack) {
     conn_.qLogger->addCongestionMetricUpdate(
         bytesInFlight_, getCongestionWindow(), kCongestionPacketAck);
   }
+  if (cwndValidator_) {
+    cwndValidator_->onPacketAcked(
+        ack.ackedBytes, ack.ackTime, conn_.lossState.srtt);
+    if (!cwndValidator_->isValidated(cwndBytes_)) {
+      // The app doesn't use the window, the acks don't tell it can grow.
+      return;
+    }
+  }
   for (const auto& packet : ack.ackedPackets) {
     onPacketAcked(packet);
   }
@@ -94,17 +135,49 @@ void NewReno::onPacketAckOrLoss(
     // on the pacer when there is loss.
   }
   if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
+    if (ackEvent->ecnCEMarks > 0) {
+      onECNCongestion(*ackEvent);
+    }
     onAckEvent(*ackEvent);
   }
   // TODO: Pacing isn't supported with NewReno
 }
 
+void NewReno::onECNCongestion(const AckEvent& ack) {
+  // CE marks get the same reduction as a loss, once per recovery period. The
+  // acked packets were all sent before the new end of recovery, so they
+  // don't grow the window afterwards.
+  if (endOfRecovery_ && ack.largestAckedPacketSentTime <= *endOfRecovery_) {
+    return;
+  }
+  // A reaction to a CE mark is never undone.
+  undoState_ = folly::none;
+  endOfRecovery_ = Clock::now();
+  cwndBytes_ = boundedCwnd(
+      cwndBytes_ >> kRenoLossReductionFactorShift,
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  ssthresh_ = cwndBytes_;
+  if (prr_) {
+    prr_->onEnterRecovery(bytesInFlight_, ssthresh_);
+  }
+  VLOG(10) << __func__ << " ecnCEMarks=" << ack.ecnCEMarks
+           << " ssthresh=" << ssthresh_ << " cwnd=" << cwndBytes_
+           << " inflight=" << bytesInFlight_ << " " << conn_;
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCongestionECN);
+  }
+}
+
 void NewReno::onPacketLoss(const LossEvent& loss) {
   DCHECK(
       loss.largestLostPacketNum.hasValue() &&
       loss.largestLostSentTime.hasValue());
   subtractAndCheckUnderflow(bytesInFlight_, loss.lostBytes);
   if (!endOfRecovery_ || *endOfRecovery_ < *loss.largestLostSentTime) {
+    undoState_ = UndoState{cwndBytes_, ssthresh_, endOfRecovery_};
     endOfRecovery_ = Clock::now();
     cwndBytes_ = (cwndBytes_ >> kRenoLossReductionFactorShift);
     cwndBytes_ = boundedCwnd(
@@ -114,6 +187,9 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
         conn_.transportSettings.minCwndInMss);
     // This causes us to exit slow start.
     ssthresh_ = cwndBytes_;
+    if (prr_) {
+      prr_->onEnterRecovery(bytesInFlight_ + loss.lostBytes, ssthresh_);
+    }
     VLOG(10) << __func__ << " exit slow start, ssthresh=" << ssthresh_
              << " packetNum=" << *loss.largestLostPacketNum
              << " writable=" << getWritableBytes() << " cwnd=" << cwndBytes_
@@ -128,7 +204,11 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
     conn_.qLogger->addCongestionMetricUpdate(
         bytesInFlight_, getCongestionWindow(), kCongestionPacketLoss);
   }
+  if (undoState_) {
+    undoState_->lostPackets += loss.lostPackets;
+  }
   if (loss.persistentCongestion) {
+    undoState_ = folly::none;
     VLOG(10) << __func__ << " writable=" << getWritableBytes()
              << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
              << conn_;
@@ -137,10 +217,46 @@ void NewReno::onPacketLoss(const LossEvent& loss) {
           bytesInFlight_, getCongestionWindow(), kPersistentCongestion);
     }
     cwndBytes_ = conn_.transportSettings.minCwndInMss * conn_.udpSendPacketLen;
+    if (prr_) {
+      prr_->onExitRecovery();
+    }
   }
 }
 
+bool NewReno::onSpuriousLoss(const LossEvent& spuriousLoss) {
+  // Only the packets lost since the last reduction count.
+  if (!undoState_ || !spuriousLoss.smallestLostSentTime ||
+      *spuriousLoss.smallestLostSentTime <
+          undoState_->endOfRecovery.value_or(
+              *spuriousLoss.smallestLostSentTime)) {
+    return false;
+  }
+  undoState_->lostPackets -=
+      std::min(undoState_->lostPackets, (uint64_t)spuriousLoss.lostPackets);
+  if (undoState_->lostPackets > 0) {
+    return false;
+  }
+  cwndBytes_ = undoState_->cwndBytes;
+  ssthresh_ = undoState_->ssthresh;
+  endOfRecovery_ = undoState_->endOfRecovery;
+  undoState_ = folly::none;
+  if (prr_) {
+    prr_->onExitRecovery();
+  }
+  VLOG(10) << __func__ << " undo loss reduction ssthresh=" << ssthresh_
+           << " cwnd=" << cwndBytes_ << " inflight=" << bytesInFlight_ << " "
+           << conn_;
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        bytesInFlight_, getCongestionWindow(), kCongestionUndo);
+  }
+  return true;
+}
+
 uint64_t NewReno::getWritableBytes() const noexcept {
+  if (prr_ && prr_->inRecovery()) {
+    return prr_->getWritableBytes();
+  }
   if (bytesInFlight_ > cwndBytes_) {
     return 0;
   } else {
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <quic/QuicException.h>
+#include <quic/congestion_control/CwndValidator.h>
+#include <quic/congestion_control/ProportionalRateReduction.h>
 #include <quic/state/StateData.h>
 
 #include <limits>
@@ -17,11 +19,15 @@ namespace quic {
 
 class NewReno : public CongestionController {
  public:
-  explicit NewReno(QuicConnectionStateBase& conn);
+  explicit NewReno(
+      QuicConnectionStateBase& conn,
+      bool proportionalRateReduction = false,
+      bool cwndValidation = false);
   void onRemoveBytesFromInflight(uint64_t) override;
   void onPacketSent(const OutstandingPacket& packet) override;
   void onPacketAckOrLoss(folly::Optional<AckEvent>, folly::Optional<LossEvent>)
       override;
+  bool onSpuriousLoss(const LossEvent& spuriousLoss) override;
 
   uint64_t getWritableBytes() const noexcept override;
   uint64_t getCongestionWindow() const noexcept override;
@@ -33,12 +39,13 @@ class NewReno : public CongestionController {
 
   bool inSlowStart() const noexcept;
 
-  uint64_t getBytesInFlight() const noexcept;
+  uint64_t getBytesInFlight() const noexcept override;
 
   bool isAppLimited() const noexcept override;
 
  private:
   void onPacketLoss(const LossEvent&);
+  void onECNCongestion(const AckEvent&);
   void onAckEvent(const AckEvent&);
   void onPacketAcked(const CongestionController::AckEvent::AckPacket&);
 
@@ -48,5 +55,20 @@ class NewReno : public CongestionController {
   uint64_t ssthresh_;
   uint64_t cwndBytes_;
   folly::Optional<TimePoint> endOfRecovery_;
+
+  // The state before the last loss reduction, restored if all the packets
+  // lost since turn out to be spurious losses.
+  struct UndoState {
+    uint64_t cwndBytes;
+    uint64_t ssthresh;
+    folly::Optional<TimePoint> endOfRecovery;
+    // Packets lost since the reduction and not acked since
+    uint64_t lostPackets{0};
+  };
+  folly::Optional<UndoState> undoState_;
+  // Only set with proportional rate reduction.
+  folly::Optional<ProportionalRateReduction> prr_;
+  // Only set with congestion window validation.
+  folly::Optional<CwndValidator> cwndValidator_;
 };
 } // namespace quic
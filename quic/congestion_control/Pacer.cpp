@@ -21,6 +21,7 @@ DefaultPacer::DefaultPacer(
       batchSize_(conn.transportSettings.writeConnectionDataPacketsLimit),
       pacingRateCalculator_(calculatePacingRate),
       cachedBatchSize_(conn.transportSettings.writeConnectionDataPacketsLimit),
+      maxPacingRate_(conn.maxPacingRate),
       tokens_(conn.transportSettings.writeConnectionDataPacketsLimit) {}
 
 // TODO: we choose to keep refershing pacing rate even when we are app-limited,
@@ -29,6 +30,11 @@ DefaultPacer::DefaultPacer(
 void DefaultPacer::refreshPacingRate(
     uint64_t cwndBytes,
     std::chrono::microseconds rtt) {
+  if (refreshDeferred_) {
+    deferredRefresh_ = std::make_pair(cwndBytes, rtt);
+    return;
+  }
+  lastRefresh_ = std::make_pair(cwndBytes, rtt);
   if (rtt < conn_.transportSettings.pacingTimerTickInterval) {
     writeInterval_ = 0us;
     batchSize_ = conn_.transportSettings.writeConnectionDataPacketsLimit;
@@ -37,8 +43,13 @@ void DefaultPacer::refreshPacingRate(
         pacingRateCalculator_(conn_, cwndBytes, minCwndInMss_, rtt);
     writeInterval_ = pacingRate.interval;
     batchSize_ = pacingRate.burstSize;
-    tokens_ += batchSize_;
+    // The tokens of a capped connection only come with time, a burst for every
+    // refresh would add up to more than the cap.
+    if (!maxPacingRate_) {
+      tokens_ += batchSize_;
+    }
   }
+  applyMaxPacingRate();
   if (conn_.qLogger) {
     conn_.qLogger->addPacingMetricUpdate(batchSize_, writeInterval_);
   }
@@ -47,6 +58,68 @@ void DefaultPacer::refreshPacingRate(
   cachedBatchSize_ = batchSize_;
 }
 
+void DefaultPacer::applyMaxPacingRate() {
+  if (!maxPacingRate_) {
+    return;
+  }
+  uint64_t packetLen = conn_.udpSendPacketLen;
+  auto interval = std::max(
+      writeInterval_, conn_.transportSettings.pacingTimerTickInterval);
+  uint64_t maxBurst = static_cast<uint64_t>(
+      double(*maxPacingRate_) * interval.count() / std::micro::den /
+      packetLen);
+  if (writeInterval_ != 0us && batchSize_ <= maxBurst) {
+    return;
+  }
+  if (maxBurst == 0) {
+    // Less than a packet per tick, one packet at a longer interval.
+    batchSize_ = 1;
+    interval = std::chrono::microseconds(
+        packetLen * std::micro::den / *maxPacingRate_);
+  } else {
+    batchSize_ = maxBurst;
+  }
+  writeInterval_ = interval;
+}
+
+uint64_t DefaultPacer::getPacingRate() const {
+  if (writeInterval_ == 0us) {
+    return 0;
+  }
+  return batchSize_ * conn_.udpSendPacketLen * std::micro::den /
+      writeInterval_.count();
+}
+
+void DefaultPacer::setMaxPacingRate(uint64_t maxRateBytesPerSec) {
+  if (maxRateBytesPerSec == 0) {
+    maxPacingRate_.clear();
+  } else {
+    maxPacingRate_ = maxRateBytesPerSec;
+  }
+  if (lastRefresh_) {
+    auto refresh = *lastRefresh_;
+    refreshPacingRate(refresh.first, refresh.second);
+  } else {
+    // Not refreshed yet, back to the unpaced start before the cap.
+    writeInterval_ = 0us;
+    batchSize_ = conn_.transportSettings.writeConnectionDataPacketsLimit;
+    applyMaxPacingRate();
+    cachedBatchSize_ = batchSize_;
+  }
+  if (maxPacingRate_) {
+    tokens_ = std::min(tokens_, batchSize_);
+  }
+}
+
+void DefaultPacer::setRefreshDeferred(bool deferred) {
+  refreshDeferred_ = deferred;
+  if (!refreshDeferred_ && deferredRefresh_) {
+    auto refresh = *deferredRefresh_;
+    deferredRefresh_.clear();
+    refreshPacingRate(refresh.first, refresh.second);
+  }
+}
+
 void DefaultPacer::onPacedWriteScheduled(TimePoint currentTime) {
   scheduledWriteTime_ = currentTime;
 }
@@ -62,14 +135,14 @@ void DefaultPacer::onPacketsLoss() {
 }
 
 std::chrono::microseconds DefaultPacer::getTimeUntilNextWrite() const {
-  return (appLimited_ || tokens_) ? 0us : writeInterval_;
+  return (unpacedWhenAppLimited() || tokens_) ? 0us : writeInterval_;
 }
 
 uint64_t DefaultPacer::updateAndGetWriteBatchSize(TimePoint currentTime) {
   SCOPE_EXIT {
     scheduledWriteTime_.clear();
   };
-  if (appLimited_) {
+  if (unpacedWhenAppLimited()) {
     cachedBatchSize_ = conn_.transportSettings.writeConnectionDataPacketsLimit;
     return cachedBatchSize_;
   }
@@ -96,12 +169,35 @@ uint64_t DefaultPacer::getCachedWriteBatchSize() const {
   return cachedBatchSize_;
 }
 
+TimePoint DefaultPacer::getNextDepartureTime(TimePoint currentTime) {
+  if (unpacedWhenAppLimited() || writeInterval_ == 0us || !nextDepartureTime_ ||
+      *nextDepartureTime_ < currentTime) {
+    // Whatever was scheduled before has left already, start a burst now.
+    nextDepartureTime_ = currentTime;
+    packetsLeftInBurst_ = std::max<uint64_t>(batchSize_, 1);
+  } else if (packetsLeftInBurst_ == 0) {
+    *nextDepartureTime_ += writeInterval_;
+    packetsLeftInBurst_ = std::max<uint64_t>(batchSize_, 1);
+  }
+  --packetsLeftInBurst_;
+  return *nextDepartureTime_;
+}
+
 void DefaultPacer::setPacingRateCalculator(
     PacingRateCalculator pacingRateCalculator) {
   pacingRateCalculator_ = std::move(pacingRateCalculator);
 }
 
 void DefaultPacer::setAppLimited(bool limited) {
+  if (appLimited_ && !limited &&
+      conn_.transportSettings.pacingRestartAfterIdle) {
+    // The refreshes kept adding tokens while app limited, start from a single
+    // burst instead of sending them all at once.
+    tokens_ = std::min(tokens_, batchSize_);
+    scheduledWriteTime_.clear();
+    nextDepartureTime_.clear();
+    packetsLeftInBurst_ = 0;
+  }
   appLimited_ = limited;
 }
 
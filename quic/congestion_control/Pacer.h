@@ -31,6 +31,8 @@ class DefaultPacer : public Pacer {
   void refreshPacingRate(uint64_t cwndBytes, std::chrono::microseconds rtt)
       override;
 
+  void setRefreshDeferred(bool deferred) override;
+
   void onPacedWriteScheduled(TimePoint currentTime) override;
 
   std::chrono::microseconds getTimeUntilNextWrite() const override;
@@ -41,12 +43,26 @@ class DefaultPacer : public Pacer {
 
   uint64_t getCachedWriteBatchSize() const override;
 
+  TimePoint getNextDepartureTime(TimePoint currentTime) override;
+
   void setAppLimited(bool limited) override;
 
+  void setMaxPacingRate(uint64_t maxRateBytesPerSec) override;
+
+  uint64_t getPacingRate() const override;
+
   void onPacketSent() override;
   void onPacketsLoss() override;
 
  private:
+  // Lowers the rate of writeInterval_ and batchSize_ to maxPacingRate_.
+  void applyMaxPacingRate();
+
+  // Whether the connection writes without pacing while app limited.
+  bool unpacedWhenAppLimited() const {
+    return appLimited_ && !maxPacingRate_;
+  }
+
   const QuicConnectionStateBase& conn_;
   uint64_t minCwndInMss_;
   uint64_t batchSize_;
@@ -55,6 +71,19 @@ class DefaultPacer : public Pacer {
   PacingRateCalculator pacingRateCalculator_;
   uint64_t cachedBatchSize_;
   bool appLimited_{false};
+  folly::Optional<uint64_t> maxPacingRate_;
+  // The cwnd and RTT of the last refresh, to recompute the rate when the cap
+  // changes.
+  folly::Optional<std::pair<uint64_t, std::chrono::microseconds>>
+      lastRefresh_;
   uint64_t tokens_;
+  // Departure time of the current burst and how many more packets can leave
+  // with it, for kernel pacing.
+  folly::Optional<TimePoint> nextDepartureTime_;
+  uint64_t packetsLeftInBurst_{0};
+  bool refreshDeferred_{false};
+  // The last refresh asked for while deferred.
+  folly::Optional<std::pair<uint64_t, std::chrono::microseconds>>
+      deferredRefresh_;
 };
 } // namespace quic
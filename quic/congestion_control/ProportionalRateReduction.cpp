@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/ProportionalRateReduction.h>
+
+#include <algorithm>
+
+namespace quic {
+
+void ProportionalRateReduction::onEnterRecovery(
+    uint64_t recoverFs,
+    uint64_t ssthresh) noexcept {
+  inRecovery_ = true;
+  recoverFs_ = std::max<uint64_t>(recoverFs, 1);
+  ssthresh_ = ssthresh;
+  delivered_ = 0;
+  out_ = 0;
+  sendQuota_ = 0;
+}
+
+void ProportionalRateReduction::onExitRecovery() noexcept {
+  inRecovery_ = false;
+  sendQuota_ = 0;
+}
+
+void ProportionalRateReduction::onPacketSent(uint64_t bytes) noexcept {
+  if (!inRecovery_) {
+    return;
+  }
+  out_ += bytes;
+  sendQuota_ -= std::min(sendQuota_, bytes);
+}
+
+void ProportionalRateReduction::onPacketAcked(
+    uint64_t deliveredBytes,
+    uint64_t bytesInFlight,
+    uint64_t packetLength) noexcept {
+  if (!inRecovery_) {
+    return;
+  }
+  delivered_ += deliveredBytes;
+  if (bytesInFlight > ssthresh_) {
+    // Proportional part: ceil(delivered * ssthresh / RecoverFS) - out.
+    uint64_t allowed = (delivered_ * ssthresh_ + recoverFs_ - 1) / recoverFs_;
+    sendQuota_ = allowed > out_ ? allowed - out_ : 0;
+  } else {
+    // Slow start reduction bound.
+    uint64_t limit = std::max(
+                         delivered_ > out_ ? delivered_ - out_ : 0,
+                         deliveredBytes) +
+        packetLength;
+    sendQuota_ = std::min(ssthresh_ - bytesInFlight, limit);
+  }
+}
+} // namespace quic
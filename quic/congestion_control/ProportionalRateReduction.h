@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace quic {
+
+/**
+ * Proportional Rate Reduction (RFC 6937) for the loss based controllers.
+ *
+ * After a window reduction the bytes in flight are above the new window, and
+ * the sender would go silent until they drain below it. In a recovery
+ * period, PRR instead lets out data in proportion to the data delivered,
+ * ssthresh / RecoverFS of it, so that the bytes in flight reach ssthresh
+ * within a round trip while the acks keep clocking packets out. Once they
+ * are below ssthresh, the slow start reduction bound grows them back to it
+ * by at most one packet more than what each ack delivered.
+ *
+ * The controller keeps its window at ssthresh during the recovery, and uses
+ * getWritableBytes() instead of the room in that window.
+ */
+class ProportionalRateReduction {
+ public:
+  /**
+   * recoverFs is the number of bytes that were in flight when the loss or
+   * the CE mark was detected, lost ones included.
+   */
+  void onEnterRecovery(uint64_t recoverFs, uint64_t ssthresh) noexcept;
+
+  void onExitRecovery() noexcept;
+
+  bool inRecovery() const noexcept {
+    return inRecovery_;
+  }
+
+  void onPacketSent(uint64_t bytes) noexcept;
+
+  /**
+   * Computes what can be sent until the next ack, from the bytes this ack
+   * delivered and the bytes in flight left.
+   */
+  void onPacketAcked(
+      uint64_t deliveredBytes,
+      uint64_t bytesInFlight,
+      uint64_t packetLength) noexcept;
+
+  uint64_t getWritableBytes() const noexcept {
+    return sendQuota_;
+  }
+
+ private:
+  bool inRecovery_{false};
+  uint64_t recoverFs_{0};
+  uint64_t ssthresh_{0};
+  // prr_delivered and prr_out of the RFC.
+  uint64_t delivered_{0};
+  uint64_t out_{0};
+  // The sndcnt of the last ack, minus what was sent since.
+  uint64_t sendQuota_{0};
+};
+} // namespace quic
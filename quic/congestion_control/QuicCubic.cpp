@@ -18,10 +18,15 @@ Cubic::Cubic(
     uint64_t initSsthresh,
     bool tcpFriendly,
     bool ackTrain,
-    bool spreadAcrossRtt)
+    bool spreadAcrossRtt,
+    folly::Optional<HystartPlusPlusSettings> hystartPlusPlus,
+    double reductionFactor,
+    bool proportionalRateReduction,
+    bool cwndValidation)
     : conn_(conn),
       inflightBytes_(0),
       ssthresh_(initSsthresh),
+      baseReductionFactor_(reductionFactor),
       spreadAcrossRtt_(spreadAcrossRtt) {
   cwndBytes_ = std::min(
       conn.transportSettings.maxCwndInMss * conn.udpSendPacketLen,
@@ -29,14 +34,32 @@ Cubic::Cubic(
   steadyState_.tcpFriendly = tcpFriendly;
   steadyState_.estRenoCwnd = cwndBytes_;
   hystartState_.ackTrain = ackTrain;
+  hystartState_.plusPlus = hystartPlusPlus;
   calculateReductionFactors();
+  if (proportionalRateReduction) {
+    prr_.emplace();
+  }
+  if (cwndValidation) {
+    cwndValidator_.emplace();
+  }
 }
 
 CubicStates Cubic::state() const noexcept {
   return state_;
 }
 
+uint8_t Cubic::getStateCode() const noexcept {
+  return static_cast<uint8_t>(state_);
+}
+
+uint64_t Cubic::getBytesInFlight() const noexcept {
+  return inflightBytes_;
+}
+
 uint64_t Cubic::getWritableBytes() const noexcept {
+  if (prr_ && prr_->inRecovery()) {
+    return prr_->getWritableBytes();
+  }
   return cwndBytes_ > inflightBytes_ ? cwndBytes_ - inflightBytes_ : 0;
 }
 
@@ -61,10 +84,16 @@ void Cubic::onPersistentCongestion() {
   steadyState_.lastReductionTime = folly::none;
   steadyState_.lastMaxCwndBytes = folly::none;
   quiescenceStart_ = folly::none;
+  unvalidatedStart_ = folly::none;
   hystartState_.found = Cubic::HystartFound::No;
   hystartState_.inRttRound = false;
+  hystartState_.cssBaselineMinRtt = folly::none;
+  hystartState_.cssRounds = 0;
 
   state_ = CubicStates::Hystart;
+  if (prr_) {
+    prr_->onExitRecovery();
+  }
 
   QUIC_TRACE(
       cubic_persistent_congestion,
@@ -83,6 +112,10 @@ void Cubic::onPersistentCongestion() {
 }
 
 void Cubic::onPacketSent(const OutstandingPacket& packet) {
+  if (cwndValidator_ &&
+      cwndValidator_->nonValidatedPeriodExpired(cwndBytes_, packet.time)) {
+    onNonValidatedPeriodEnd(packet.time);
+  }
   if (std::numeric_limits<uint64_t>::max() - inflightBytes_ <
       packet.encodedSize) {
     throw QuicInternalException(
@@ -90,6 +123,38 @@ void Cubic::onPacketSent(const OutstandingPacket& packet) {
         LocalErrorCode::INFLIGHT_BYTES_OVERFLOW);
   }
   inflightBytes_ += packet.encodedSize;
+  if (prr_) {
+    prr_->onPacketSent(packet.encodedSize);
+  }
+}
+
+void Cubic::onNonValidatedPeriodEnd(TimePoint eventTime) noexcept {
+  // The recovery keeps cwnd at ssthresh until it ends.
+  if (state_ == CubicStates::FastRecovery) {
+    return;
+  }
+  ssthresh_ = std::max(ssthresh_, cwndBytes_ / 4 * 3);
+  // The curve starts again from the reduced cwnd, towards the old one.
+  steadyState_.lastMaxCwndBytes = cwndBytes_;
+  steadyState_.lastReductionTime = eventTime;
+  steadyState_.originPoint = folly::none;
+  unvalidatedStart_ = folly::none;
+  cwndBytes_ = boundedCwnd(
+      CwndValidator::reduceCwnd(
+          cwndBytes_,
+          conn_.transportSettings.initCwndInMss * conn_.udpSendPacketLen),
+      conn_.udpSendPacketLen,
+      conn_.transportSettings.maxCwndInMss,
+      conn_.transportSettings.minCwndInMss);
+  if (steadyState_.tcpFriendly) {
+    steadyState_.estRenoCwnd = cwndBytes_;
+  }
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
+  VLOG(10) << __func__ << " cwnd not validated, cwnd=" << cwndBytes_
+           << " ssthresh=" << ssthresh_ << " " << conn_;
 }
 
 void Cubic::onPacketLoss(const LossEvent& loss) {
@@ -103,16 +168,13 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
   // as it was already accounted for in a recovery period.
   if (*loss.largestLostSentTime >=
       recoveryState_.endOfRecovery.value_or(*loss.largestLostSentTime)) {
-    recoveryState_.endOfRecovery = Clock::now();
-    cubicReduction(loss.lossTime);
-    if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
-      state_ = CubicStates::FastRecovery;
-    }
-    ssthresh_ = cwndBytes_;
-    if (conn_.pacer) {
-      conn_.pacer->refreshPacingRate(
-          cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+    UndoState undoState{
+        cwndBytes_, ssthresh_, state_, steadyState_, recoveryState_};
+    enterRecovery(loss.lossTime);
+    if (prr_) {
+      prr_->onEnterRecovery(inflightBytes_ + loss.lostBytes, ssthresh_);
     }
+    undoState_ = std::move(undoState);
     QUIC_TRACE(
         cubic_loss,
         conn_,
@@ -139,11 +201,89 @@ void Cubic::onPacketLoss(const LossEvent& loss) {
     }
   }
 
+  if (undoState_) {
+    undoState_->lostPackets += loss.lostPackets;
+  }
   if (loss.persistentCongestion) {
+    undoState_ = folly::none;
     onPersistentCongestion();
   }
 }
 
+bool Cubic::onSpuriousLoss(const LossEvent& spuriousLoss) {
+  // Only the packets lost since the last recovery started count.
+  if (!undoState_ || !spuriousLoss.smallestLostSentTime ||
+      *spuriousLoss.smallestLostSentTime <
+          undoState_->recoveryState.endOfRecovery.value_or(
+              *spuriousLoss.smallestLostSentTime)) {
+    return false;
+  }
+  undoState_->lostPackets -=
+      std::min(undoState_->lostPackets, (uint64_t)spuriousLoss.lostPackets);
+  if (undoState_->lostPackets > 0) {
+    return false;
+  }
+  cwndBytes_ = undoState_->cwndBytes;
+  ssthresh_ = undoState_->ssthresh;
+  state_ = undoState_->state;
+  steadyState_ = undoState_->steadyState;
+  recoveryState_ = undoState_->recoveryState;
+  undoState_ = folly::none;
+  if (prr_) {
+    prr_->onExitRecovery();
+  }
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
+  VLOG(10) << __func__ << " undo loss reduction cwnd=" << cwndBytes_
+           << " ssthresh=" << ssthresh_ << " inflight=" << inflightBytes_ << " "
+           << conn_;
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionUndo,
+        cubicStateToString(state_).str());
+  }
+  return true;
+}
+
+void Cubic::onECNCongestion(const AckEvent& ack) {
+  // CE marks are reacted to like a loss of the largest acked packet: at most
+  // once per recovery period.
+  if (ack.largestAckedPacketSentTime <
+      recoveryState_.endOfRecovery.value_or(ack.largestAckedPacketSentTime)) {
+    return;
+  }
+  // A reaction to a CE mark is never undone.
+  undoState_ = folly::none;
+  enterRecovery(ack.ackTime);
+  if (prr_) {
+    prr_->onEnterRecovery(inflightBytes_, ssthresh_);
+  }
+  if (conn_.qLogger) {
+    conn_.qLogger->addCongestionMetricUpdate(
+        inflightBytes_,
+        getCongestionWindow(),
+        kCongestionECN,
+        cubicStateToString(state_).str());
+  }
+}
+
+void Cubic::enterRecovery(TimePoint eventTime) noexcept {
+  recoveryState_.endOfRecovery = Clock::now();
+  cubicReduction(eventTime);
+  if (state_ == CubicStates::Hystart || state_ == CubicStates::Steady) {
+    state_ = CubicStates::FastRecovery;
+  }
+  ssthresh_ = cwndBytes_;
+  if (conn_.pacer) {
+    conn_.pacer->refreshPacingRate(
+        cwndBytes_ * pacingGain(), conn_.lossState.srtt);
+  }
+}
+
 void Cubic::onRemoveBytesFromInflight(uint64_t bytes) {
   DCHECK_LE(bytes, inflightBytes_);
   inflightBytes_ -= bytes;
@@ -225,7 +365,7 @@ void Cubic::calculateReductionFactors() noexcept {
       (numEmulatedConnections_ - 1 + kDefaultLastMaxReductionFactor) /
       numEmulatedConnections_;
   steadyState_.reductionFactor =
-      (numEmulatedConnections_ - 1 + kDefaultCubicReductionFactor) /
+      (numEmulatedConnections_ - 1 + baseReductionFactor_) /
       numEmulatedConnections_;
   if (steadyState_.tcpFriendly) {
     // Every RTT, one "emulated" connection should increase by:
@@ -390,6 +530,9 @@ void Cubic::onPacketAckOrLoss(
   }
   if (ackEvent && ackEvent->largestAckedPacket.hasValue()) {
     CHECK(!ackEvent->ackedPackets.empty());
+    if (ackEvent->ecnCEMarks > 0) {
+      onECNCongestion(*ackEvent);
+    }
     onPacketAcked(*ackEvent);
   }
 }
@@ -398,6 +541,13 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
   auto currentCwnd = cwndBytes_;
   DCHECK_LE(ack.ackedBytes, inflightBytes_);
   inflightBytes_ -= ack.ackedBytes;
+  if (prr_) {
+    prr_->onPacketAcked(ack.ackedBytes, inflightBytes_, conn_.udpSendPacketLen);
+  }
+  if (cwndValidator_) {
+    cwndValidator_->onPacketAcked(
+        ack.ackedBytes, ack.ackTime, conn_.lossState.srtt);
+  }
   if (recoveryState_.endOfRecovery.hasValue() &&
       *recoveryState_.endOfRecovery >= ack.largestAckedPacketSentTime) {
     QUIC_TRACE(fst_trace, conn_, "cubic_skip_ack");
@@ -412,7 +562,10 @@ void Cubic::onPacketAcked(const AckEvent& ack) {
   }
   switch (state_) {
     case CubicStates::Hystart:
-      onPacketAckedInHystart(ack);
+      // The acks of a window the app doesn't use don't grow it.
+      if (!cwndValidator_ || cwndValidator_->isValidated(cwndBytes_)) {
+        onPacketAckedInHystart(ack);
+      }
       break;
     case CubicStates::Steady:
       onPacketAckedInSteady(ack);
@@ -478,7 +631,11 @@ std::unique_ptr<Cubic> Cubic::CubicBuilder::build(
       std::numeric_limits<uint64_t>::max(),
       tcpFriendly_,
       ackTrain_,
-      spreadAcrossRtt_);
+      spreadAcrossRtt_,
+      hystartPlusPlus_,
+      reductionFactor_,
+      proportionalRateReduction_,
+      cwndValidation_);
 }
 
 Cubic::CubicBuilder& Cubic::CubicBuilder::setAckTrain(bool ackTrain) noexcept {
@@ -498,6 +655,30 @@ Cubic::CubicBuilder& Cubic::CubicBuilder::setPacingSpreadAcrossRtt(
   return *this;
 }
 
+Cubic::CubicBuilder& Cubic::CubicBuilder::setHystartPlusPlus(
+    HystartPlusPlusSettings settings) noexcept {
+  hystartPlusPlus_ = settings;
+  return *this;
+}
+
+Cubic::CubicBuilder& Cubic::CubicBuilder::setReductionFactor(
+    double reductionFactor) noexcept {
+  reductionFactor_ = reductionFactor;
+  return *this;
+}
+
+Cubic::CubicBuilder& Cubic::CubicBuilder::setProportionalRateReduction(
+    bool proportionalRateReduction) noexcept {
+  proportionalRateReduction_ = proportionalRateReduction;
+  return *this;
+}
+
+Cubic::CubicBuilder& Cubic::CubicBuilder::setCwndValidation(
+    bool cwndValidation) noexcept {
+  cwndValidation_ = cwndValidation;
+  return *this;
+}
+
 float Cubic::pacingGain() const noexcept {
   double pacingGain = 1.0f;
   if (state_ == CubicStates::Hystart) {
@@ -522,10 +703,15 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
     throw QuicInternalException(
         "Cubic Hystart: cwnd overflow", LocalErrorCode::CWND_OVERFLOW);
   }
+  // Conservative slow start of HyStart++ only grows by a fraction of the acked
+  // bytes.
+  auto cwndIncrease = hystartState_.cssBaselineMinRtt
+      ? ack.ackedBytes / hystartState_.plusPlus->cssGrowthDivisor
+      : ack.ackedBytes;
   VLOG(15) << "Cubic Hystart increase cwnd=" << cwndBytes_ << ", by "
-           << ack.ackedBytes;
+           << cwndIncrease;
   cwndBytes_ = boundedCwnd(
-      cwndBytes_ + ack.ackedBytes,
+      cwndBytes_ + cwndIncrease,
       conn_.udpSendPacketLen,
       conn_.transportSettings.maxCwndInMss,
       conn_.transportSettings.minCwndInMss);
@@ -548,6 +734,8 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
        * sampled RTT as the lastSampledRtt:
        */
       hystartState_.currSampledRtt = folly::none;
+      hystartState_.cssBaselineMinRtt = folly::none;
+      hystartState_.cssRounds = 0;
       steadyState_.lastMaxCwndBytes = folly::none;
       steadyState_.lastReductionTime = folly::none;
       quiescenceStart_ = folly::none;
@@ -569,6 +757,12 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
   }
 
   DCHECK_LE(cwndBytes_, ssthresh_);
+  if (hystartState_.plusPlus) {
+    if (onPacketAckedInHystartPlusPlus(ack)) {
+      exitReason = Cubic::ExitReason::EXITPOINT;
+    }
+    return;
+  }
   if (hystartState_.found != Cubic::HystartFound::No) {
     return;
   }
@@ -636,6 +830,58 @@ void Cubic::onPacketAckedInHystart(const AckEvent& ack) {
   }
 }
 
+bool Cubic::onPacketAckedInHystartPlusPlus(const AckEvent& ack) noexcept {
+  const auto& settings = *hystartState_.plusPlus;
+  // Take the min of the first few latest RTT samples of the round, which
+  // filters out the jitter better than the smoothed RTT does.
+  if (hystartState_.ackCount < settings.rttSamples) {
+    hystartState_.currSampledRtt = std::min(
+        conn_.lossState.lrtt,
+        hystartState_.currSampledRtt.value_or(conn_.lossState.lrtt));
+    ++hystartState_.ackCount;
+  }
+  bool enoughSamples = hystartState_.ackCount >= settings.rttSamples;
+  bool roundEnd =
+      ack.largestAckedPacketSentTime > hystartState_.rttRoundEndTarget;
+
+  if (hystartState_.cssBaselineMinRtt) {
+    if (enoughSamples &&
+        *hystartState_.currSampledRtt < *hystartState_.cssBaselineMinRtt) {
+      VLOG(15) << "Cubic HyStart++: RTT dropped below the baseline, go back to"
+               << " slow start";
+      hystartState_.cssBaselineMinRtt = folly::none;
+      hystartState_.cssRounds = 0;
+      return false;
+    }
+    return roundEnd && ++hystartState_.cssRounds >= settings.cssRounds;
+  }
+
+  if (!enoughSamples || !hystartState_.lastSampledRtt.hasValue()) {
+    return false;
+  }
+  auto rttThresh = std::min(
+      settings.maxRttThresh,
+      std::max(
+          settings.minRttThresh,
+          *hystartState_.lastSampledRtt / settings.rttThreshDivisor));
+  // lastSampledRtt + rttThresh may overflow:
+  if (UNLIKELY(
+          *hystartState_.lastSampledRtt >
+          std::chrono::microseconds::max() - rttThresh)) {
+    return false;
+  }
+  if (*hystartState_.currSampledRtt >=
+      *hystartState_.lastSampledRtt + rttThresh) {
+    VLOG(15) << "Cubic HyStart++: enter conservative slow start, "
+             << "currSampledRtt=" << hystartState_.currSampledRtt->count()
+             << "us, lastSampledRtt=" << hystartState_.lastSampledRtt->count()
+             << "us";
+    hystartState_.cssBaselineMinRtt = hystartState_.currSampledRtt;
+    hystartState_.cssRounds = 0;
+  }
+  return false;
+}
+
 /**
  * Note: The Cubic paper, and linux/chromium implementation differ on the
  * definition of "time to origin", or the variable K in the paper. In the paper,
@@ -662,6 +908,21 @@ void Cubic::onPacketAckedInSteady(const AckEvent& ack) {
     }
     return;
   }
+  if (cwndValidator_) {
+    if (!cwndValidator_->isValidated(cwndBytes_)) {
+      if (!unvalidatedStart_) {
+        unvalidatedStart_ = ack.ackTime;
+      }
+      return;
+    }
+    if (unvalidatedStart_ && steadyState_.lastReductionTime &&
+        *unvalidatedStart_ <= ack.ackTime) {
+      *steadyState_.lastReductionTime +=
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              ack.ackTime - *unvalidatedStart_);
+    }
+    unvalidatedStart_ = folly::none;
+  }
   // TODO: There is a tradeoff between getting an accurate Cwnd by frequently
   // calculating it, and the CPU usage cost. This is worth experimenting. E.g.,
   // Chromium has an option to skips the cwnd calculation if it's configured to
@@ -739,6 +1000,9 @@ void Cubic::onPacketAckedInRecovery(const AckEvent& ack) {
   CHECK_EQ(cwndBytes_, ssthresh_);
   if (isRecovered(ack.largestAckedPacketSentTime)) {
     state_ = CubicStates::Steady;
+    if (prr_) {
+      prr_->onExitRecovery();
+    }
 
     // We do a Cubic cwnd pre-calculation here so that all Ack events from
     // this point on in the Steady state will only increase cwnd. We can check
@@ -10,6 +10,8 @@
 
 #include <quic/QuicException.h>
 #include <quic/congestion_control/CongestionControlFunctions.h>
+#include <quic/congestion_control/CwndValidator.h>
+#include <quic/congestion_control/ProportionalRateReduction.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/state/StateData.h>
 
@@ -53,13 +55,36 @@ class Cubic : public CongestionController {
    * spreadacrossRtt:   if the pacing bursts should be spread across RTT or all
    *                    close to the beginning of an RTT round
    */
+  /**
+   * Thresholds of HyStart++. Slow start is suspended when the min RTT of the
+   * first rttSamples acks of a round is larger than the previous round's by
+   * more than its 1/rttThreshDivisor, bounded by [minRttThresh, maxRttThresh].
+   * Conservative slow start then grows cwnd by 1/cssGrowthDivisor of the acked
+   * bytes, goes back to slow start if the RTT drops below what it was when the
+   * increase was found, and exits slow start after cssRounds rounds.
+   */
+  struct HystartPlusPlusSettings {
+    uint8_t rttSamples{kHystartPlusPlusRttSamples};
+    std::chrono::microseconds minRttThresh{kHystartPlusPlusMinRttThresh};
+    std::chrono::microseconds maxRttThresh{kHystartPlusPlusMaxRttThresh};
+    uint8_t rttThreshDivisor{kHystartPlusPlusRttThreshDivisor};
+    uint8_t cssGrowthDivisor{kHystartPlusPlusCssGrowthDivisor};
+    uint8_t cssRounds{kHystartPlusPlusCssRounds};
+  };
+
   // TODO: We haven't experimented with setting ackTrain and tcpFriendly
+  // When hystartPlusPlus is set, it replaces the AckTrain and DelayIncrease
+  // methods to exit slow start.
   explicit Cubic(
       QuicConnectionStateBase& conn,
       uint64_t initSsthresh = std::numeric_limits<uint64_t>::max(),
       bool tcpFriendly = true,
       bool ackTrain = false,
-      bool spreadAcrossRtt = false);
+      bool spreadAcrossRtt = false,
+      folly::Optional<HystartPlusPlusSettings> hystartPlusPlus = folly::none,
+      double reductionFactor = kDefaultCubicReductionFactor,
+      bool proportionalRateReduction = false,
+      bool cwndValidation = false);
 
   class CubicBuilder {
    public:
@@ -67,11 +92,21 @@ class Cubic : public CongestionController {
     CubicBuilder& setAckTrain(bool ackTrain) noexcept;
     CubicBuilder& setTcpFriendly(bool tcpFriendly) noexcept;
     CubicBuilder& setPacingSpreadAcrossRtt(bool spreadAcrossRtt) noexcept;
+    CubicBuilder& setHystartPlusPlus(
+        HystartPlusPlusSettings settings = HystartPlusPlusSettings()) noexcept;
+    CubicBuilder& setReductionFactor(double reductionFactor) noexcept;
+    CubicBuilder& setProportionalRateReduction(
+        bool proportionalRateReduction) noexcept;
+    CubicBuilder& setCwndValidation(bool cwndValidation) noexcept;
 
    private:
     bool tcpFriendly_{true};
     bool ackTrain_{false};
     bool spreadAcrossRtt_{false};
+    folly::Optional<HystartPlusPlusSettings> hystartPlusPlus_;
+    double reductionFactor_{kDefaultCubicReductionFactor};
+    bool proportionalRateReduction_{false};
+    bool cwndValidation_{false};
   };
 
   CubicStates state() const noexcept;
@@ -90,6 +125,7 @@ class Cubic : public CongestionController {
 
   void onPacketAckOrLoss(folly::Optional<AckEvent>, folly::Optional<LossEvent>)
       override;
+  bool onSpuriousLoss(const LossEvent& spuriousLoss) override;
   void onRemoveBytesFromInflight(uint64_t) override;
   void onPacketSent(const OutstandingPacket& packet) override;
 
@@ -101,6 +137,10 @@ class Cubic : public CongestionController {
 
   bool isAppLimited() const noexcept override;
 
+  uint8_t getStateCode() const noexcept override;
+
+  uint64_t getBytesInFlight() const noexcept override;
+
   CongestionControlType type() const noexcept override;
 
  protected:
@@ -110,12 +150,18 @@ class Cubic : public CongestionController {
   bool isAppIdle() const noexcept;
   void onPacketAcked(const AckEvent& ack);
   void onPacketAckedInHystart(const AckEvent& ack);
+  // Returns true when HyStart++ decides to exit slow start
+  bool onPacketAckedInHystartPlusPlus(const AckEvent& ack) noexcept;
   void onPacketAckedInSteady(const AckEvent& ack);
   void onPacketAckedInRecovery(const AckEvent& ack);
 
   void onPacketLoss(const LossEvent& loss);
   void onPacketLossInRecovery(const LossEvent& loss);
+  void onECNCongestion(const AckEvent& ack);
+  void enterRecovery(TimePoint eventTime) noexcept;
   void onPersistentCongestion();
+  // Halves a cwnd that hasn't been validated for a whole period.
+  void onNonValidatedPeriodEnd(TimePoint eventTime) noexcept;
 
   float pacingGain() const noexcept;
 
@@ -138,6 +184,8 @@ class Cubic : public CongestionController {
   uint64_t inflightBytes_;
   uint64_t ssthresh_;
   uint8_t numEmulatedConnections_{kDefaultEmulatedConnection};
+  // The cwnd reduction factor of a single emulated connection
+  double baseReductionFactor_;
 
   struct HystartState {
     // If AckTrain method will be used to exit SlowStart
@@ -162,6 +210,13 @@ class Cubic : public CongestionController {
     // When a packet with sent time >= rttRoundEndTarget is acked, end the
     // current RTT round
     TimePoint rttRoundEndTarget;
+    // Set when HyStart++ is used instead of AckTrain and DelayIncrease
+    folly::Optional<HystartPlusPlusSettings> plusPlus;
+    // The sampled RTT of the round that started conservative slow start. Set
+    // only while HyStart++ is in conservative slow start.
+    folly::Optional<std::chrono::microseconds> cssBaselineMinRtt;
+    // Number of RTT rounds ended in conservative slow start
+    uint8_t cssRounds{0};
   };
 
   struct SteadyState {
@@ -186,12 +241,33 @@ class Cubic : public CongestionController {
     folly::Optional<TimePoint> endOfRecovery;
   };
 
+  // The state before the last recovery entered on a loss, restored if all
+  // the packets lost since turn out to be spurious losses.
+  struct UndoState {
+    uint64_t cwndBytes;
+    uint64_t ssthresh;
+    CubicStates state;
+    SteadyState steadyState;
+    RecoveryState recoveryState;
+    // Packets lost since the recovery started and not acked since
+    uint64_t lostPackets{0};
+  };
+
   // if quiescenceStart_ has a value, then the connection is app limited
   folly::Optional<TimePoint> quiescenceStart_;
 
   HystartState hystartState_;
   SteadyState steadyState_;
   RecoveryState recoveryState_;
+  folly::Optional<UndoState> undoState_;
+  // Only set with proportional rate reduction, in which case it decides what
+  // can be sent in FastRecovery.
+  folly::Optional<ProportionalRateReduction> prr_;
+  // Only set with congestion window validation.
+  folly::Optional<CwndValidator> cwndValidator_;
+  // When the cwnd stopped being validated in Steady. The cubic curve is then
+  // paused, like during a quiescence.
+  folly::Optional<TimePoint> unvalidatedStart_;
 
   // When spreadAcrossRtt_ is set to true, the pacing writes will be distributed
   // evenly across an RTT. Otherwise, we will use the first N number of pacing
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/Bbr2.h>
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class Bbr2Test : public Test {
+ public:
+  void SetUp() override {
+    conn_ = std::make_unique<QuicConnectionStateBase>(QuicNodeType::Client);
+    conn_->udpSendPacketLen = 1000;
+    bbr_ = std::make_unique<Bbr2CongestionController>(*conn_);
+    auto rttSampler = std::make_unique<NiceMock<MockMinRttSampler>>();
+    auto bandwidthSampler =
+        std::make_unique<NiceMock<MockBandwidthSampler>>();
+    rawRttSampler_ = rttSampler.get();
+    rawBandwidthSampler_ = bandwidthSampler.get();
+    ON_CALL(*rawRttSampler_, minRtt()).WillByDefault(Return(50ms));
+    ON_CALL(*rawRttSampler_, minRttExpired(_)).WillByDefault(Return(false));
+    ON_CALL(*rawBandwidthSampler_, getBandwidth())
+        .WillByDefault(Return(Bandwidth()));
+    ON_CALL(*rawBandwidthSampler_, isAppLimited())
+        .WillByDefault(Return(false));
+    bbr_->setRttSampler(std::move(rttSampler));
+    bbr_->setBandwidthSampler(std::move(bandwidthSampler));
+  }
+
+  // Loses enough in Startup to fill the pipe, then acks enough to drain it
+  // and get to ProbeBw.
+  void getToProbeBw() {
+    bbr_->onPacketSent(makeTestingWritePacket(0, 20000, 20000));
+    CongestionController::LossEvent loss;
+    loss.lostBytes = 1000;
+    bbr_->onPacketAckOrLoss(folly::none, loss);
+    auto sentTime = Clock::now();
+    bbr_->onPacketAckOrLoss(
+        makeAck(1, 10000, sentTime + 10ms, sentTime), folly::none);
+  }
+
+  // Acks a packet sent after the end of the current round, so the ack starts
+  // a new round.
+  void ackNewRound(uint64_t ackedBytes, PacketNum seq) {
+    auto sentTime = Clock::now();
+    bbr_->onPacketAckOrLoss(
+        makeAck(seq, ackedBytes, sentTime + 10ms, sentTime), folly::none);
+  }
+
+  std::unique_ptr<QuicConnectionStateBase> conn_;
+  std::unique_ptr<Bbr2CongestionController> bbr_;
+  MockMinRttSampler* rawRttSampler_;
+  MockBandwidthSampler* rawBandwidthSampler_;
+};
+
+TEST_F(Bbr2Test, InitStates) {
+  EXPECT_EQ(CongestionControlType::BBR2, bbr_->type());
+  EXPECT_EQ(Bbr2CongestionController::State::Startup, bbr_->state());
+  EXPECT_EQ("Startup", bbr2StateToString(bbr_->state()));
+  EXPECT_EQ(
+      1000 * conn_->transportSettings.initCwndInMss,
+      bbr_->getCongestionWindow());
+  EXPECT_EQ(bbr_->getWritableBytes(), bbr_->getCongestionWindow());
+  EXPECT_FALSE(bbr_->inflightHi().hasValue());
+  EXPECT_FALSE(bbr_->inflightLo().hasValue());
+}
+
+TEST_F(Bbr2Test, StartupExitsOnLoss) {
+  bbr_->onPacketSent(makeTestingWritePacket(0, 20000, 20000));
+  // Less than 2% of inflight doesn't end Startup.
+  CongestionController::LossEvent smallLoss;
+  smallLoss.lostBytes = 100;
+  bbr_->onPacketAckOrLoss(folly::none, smallLoss);
+  EXPECT_FALSE(bbr_->inflightHi().hasValue());
+
+  CongestionController::LossEvent loss;
+  loss.lostBytes = 1000;
+  bbr_->onPacketAckOrLoss(folly::none, loss);
+  // Without a bandwidth sample the BDP is the initial cwnd.
+  auto initCwnd = 1000 * conn_->transportSettings.initCwndInMss;
+  ASSERT_TRUE(bbr_->inflightHi().hasValue());
+  EXPECT_EQ(initCwnd, *bbr_->inflightHi());
+
+  auto sentTime = Clock::now();
+  bbr_->onPacketAckOrLoss(
+      makeAck(1, 10000, sentTime + 10ms, sentTime), folly::none);
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+  EXPECT_LE(bbr_->getCongestionWindow(), *bbr_->inflightHi());
+}
+
+TEST_F(Bbr2Test, StartupExitsOnECN) {
+  bbr_->onPacketSent(makeTestingWritePacket(0, 20000, 20000));
+  auto sentTime = Clock::now();
+  auto ack = makeAck(0, 10000, sentTime + 10ms, sentTime);
+  ack.ecnCEMarks = 1;
+  bbr_->onPacketAckOrLoss(ack, folly::none);
+  ASSERT_TRUE(bbr_->inflightHi().hasValue());
+  EXPECT_EQ(
+      1000 * conn_->transportSettings.initCwndInMss, *bbr_->inflightHi());
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+}
+
+TEST_F(Bbr2Test, LowerBoundsOnLossWhenNotProbing) {
+  getToProbeBw();
+  ASSERT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+  EXPECT_FALSE(bbr_->inflightLo().hasValue());
+  auto cwnd = bbr_->getCongestionWindow();
+
+  CongestionController::LossEvent loss;
+  loss.lostBytes = 3000;
+  bbr_->onPacketAckOrLoss(folly::none, loss);
+  ackNewRound(1000, 2);
+  ASSERT_TRUE(bbr_->inflightLo().hasValue());
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeBwCruise, bbr_->state());
+
+  // A second round with losses keeps lowering it.
+  auto inflightLo = *bbr_->inflightLo();
+  loss.lostBytes = 500;
+  bbr_->onPacketAckOrLoss(folly::none, loss);
+  ackNewRound(1000, 3);
+  ASSERT_TRUE(bbr_->inflightLo().hasValue());
+  EXPECT_LT(*bbr_->inflightLo(), inflightLo);
+  EXPECT_LT(*bbr_->inflightLo(), cwnd);
+  EXPECT_EQ(*bbr_->inflightLo(), bbr_->getCongestionWindow());
+}
+
+TEST_F(Bbr2Test, ProbeRttInterval) {
+  getToProbeBw();
+  ASSERT_EQ(Bbr2CongestionController::State::ProbeBwDown, bbr_->state());
+  // The min rtt hasn't expired, but it's been more than the ProbeRtt
+  // interval since the last one.
+  auto sentTime = Clock::now();
+  EXPECT_CALL(*rawBandwidthSampler_, onAppLimited());
+  bbr_->onPacketAckOrLoss(
+      makeAck(2, 1000, sentTime + kBbr2ProbeRttInterval + 1s, sentTime),
+      folly::none);
+  EXPECT_EQ(Bbr2CongestionController::State::ProbeRtt, bbr_->state());
+  // Half of the BDP, which is the initial cwnd without a bandwidth sample.
+  EXPECT_EQ(
+      1000 * conn_->transportSettings.initCwndInMss / 2,
+      bbr_->getCongestionWindow());
+}
+} // namespace test
+} // namespace quic
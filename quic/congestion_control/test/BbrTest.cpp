@@ -207,6 +207,26 @@ TEST_F(BbrTest, LeaveStartup) {
   EXPECT_NE(BbrCongestionController::BbrState::Startup, bbr.state());
 }
 
+TEST_F(BbrTest, LeaveStartupOnECN) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.udpSendPacketLen = 1000;
+  BbrCongestionController::BbrConfig config;
+  BbrCongestionController bbr(conn, config);
+  auto mockBandwidthSampler = std::make_unique<MockBandwidthSampler>();
+  auto rawBandwidthSampler = mockBandwidthSampler.get();
+  bbr.setBandwidthSampler(std::move(mockBandwidthSampler));
+  EXPECT_CALL(*rawBandwidthSampler, getBandwidth())
+      .WillRepeatedly(
+          Return(Bandwidth(2000 * 1000, std::chrono::microseconds(1))));
+
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  bbr.onPacketSent(packet);
+  auto ack = makeAck(0, 1000, Clock::now(), packet.time);
+  ack.ecnCEMarks = 1;
+  bbr.onPacketAckOrLoss(ack, folly::none);
+  EXPECT_NE(BbrCongestionController::BbrState::Startup, bbr.state());
+}
+
 TEST_F(BbrTest, RemoveInflightBytes) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   conn.udpSendPacketLen = 1000;
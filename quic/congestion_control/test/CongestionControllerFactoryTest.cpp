@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CongestionControllerFactory.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/congestion_control/QuicCubic.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class CongestionControllerFactoryTest : public Test {};
+
+TEST_F(CongestionControllerFactoryTest, MakesRequestedType) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  DefaultCongestionControllerFactory factory;
+  for (auto type : {CongestionControlType::NewReno,
+                    CongestionControlType::Cubic,
+                    CongestionControlType::Copa,
+                    CongestionControlType::BBR,
+                    CongestionControlType::BBR2}) {
+    auto cc = factory.makeCongestionController(conn, type);
+    ASSERT_NE(nullptr, cc);
+    EXPECT_EQ(type, cc->type());
+  }
+  EXPECT_EQ(
+      nullptr,
+      factory.makeCongestionController(conn, CongestionControlType::None));
+}
+
+TEST_F(CongestionControllerFactoryTest, CubicProfile) {
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  DefaultCongestionControllerFactory factory;
+  conn.transportSettings.ccProfile.cubicReductionFactor = 0.6;
+  auto cubic =
+      factory.makeCongestionController(conn, CongestionControlType::Cubic);
+  auto initCwnd = cubic->getCongestionWindow();
+  auto packet = makeTestingWritePacket(0, 1000, 1000);
+  cubic->onPacketSent(packet);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet);
+  cubic->onPacketAckOrLoss(folly::none, std::move(loss));
+  // With the default 2 emulated connections, the reduction factor becomes
+  // (1 + 0.6) / 2
+  EXPECT_EQ(
+      static_cast<uint64_t>(initCwnd * 0.8), cubic->getCongestionWindow());
+}
+} // namespace test
+} // namespace quic
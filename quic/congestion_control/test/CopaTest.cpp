@@ -470,5 +470,66 @@ TEST_F(CopaTest, PacketLossInvokesPacer) {
   copa.onPacketAckOrLoss(folly::none, lossEvent);
 }
 
+TEST_F(CopaTest, CompetitiveMode) {
+  QuicServerConnectionState conn;
+  Copa::CopaConfig config;
+  config.modeSwitching = true;
+  Copa copa(conn, config);
+  auto packetSize = conn.udpSendPacketLen;
+  conn.lossState.srtt = 100ms;
+  PacketNum packetNum = 0;
+  auto now = Clock::now();
+  auto sendAndAck = [&](std::chrono::microseconds lrtt) {
+    conn.lossState.lrtt = lrtt;
+    copa.onPacketSent(createPacket(packetNum, packetSize, packetSize));
+    copa.onPacketAckOrLoss(
+        createAckEvent(packetNum++, packetSize, now), folly::none);
+    now += 10ms;
+  };
+
+  sendAndAck(100ms);
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+
+  // The standing queue never drains.
+  for (int i = 0; i < 100; ++i) {
+    sendAndAck(200ms);
+  }
+  EXPECT_TRUE(copa.inCompetitiveMode());
+  auto latencyFactor = copa.getLatencyFactor();
+  EXPECT_LT(latencyFactor, 0.5);
+
+  auto lostPacket = createPacket(packetNum++, packetSize, packetSize);
+  copa.onPacketSent(lostPacket);
+  CongestionController::LossEvent lossEvent;
+  lossEvent.addLostPacket(lostPacket);
+  copa.onPacketAckOrLoss(folly::none, lossEvent);
+  EXPECT_DOUBLE_EQ(std::min(0.5, latencyFactor * 2), copa.getLatencyFactor());
+
+  // Once the queue drains Copa is back to its default mode.
+  for (int i = 0; i < 10; ++i) {
+    sendAndAck(100ms);
+  }
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+}
+
+TEST_F(CopaTest, NoModeSwitchingByDefault) {
+  QuicServerConnectionState conn;
+  Copa copa(conn);
+  auto packetSize = conn.udpSendPacketLen;
+  conn.lossState.srtt = 100ms;
+  auto now = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < 100; ++packetNum) {
+    conn.lossState.lrtt = packetNum ? 200ms : 100ms;
+    copa.onPacketSent(createPacket(packetNum, packetSize, packetSize));
+    copa.onPacketAckOrLoss(
+        createAckEvent(packetNum, packetSize, now), folly::none);
+    now += 10ms;
+  }
+  EXPECT_FALSE(copa.inCompetitiveMode());
+  EXPECT_EQ(0.5, copa.getLatencyFactor());
+}
+
 } // namespace test
 } // namespace quic
@@ -316,5 +316,84 @@ TEST_F(CubicHystartTest, ReduceByCubicReductionFactor) {
   EXPECT_EQ(initCwnd * 0.9, cubic.getWritableBytes());
   EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
 }
+namespace {
+// Acks a RTT round of HyStart++: numAcks acks with the given RTT that don't
+// end the round, then one ack that does.
+void ackHystartPlusPlusRound(
+    QuicConnectionStateBase& conn,
+    Cubic& cubic,
+    PacketNum& packetNum,
+    std::chrono::microseconds rtt,
+    size_t numAcks = kHystartPlusPlusRttSamples) {
+  conn.lossState.lrtt = rtt;
+  auto sentTime = Clock::now() - 1s;
+  for (size_t i = 0; i < numAcks; i++) {
+    auto packet =
+        makeTestingWritePacket(packetNum, 1000, 1000, false, sentTime);
+    cubic.onPacketSent(packet);
+    cubic.onPacketAckOrLoss(
+        makeAck(packetNum++, 1000, Clock::now(), packet.time), folly::none);
+  }
+  auto lastPacket =
+      makeTestingWritePacket(packetNum, 1000, 1000, false, Clock::now() + 1s);
+  cubic.onPacketSent(lastPacket);
+  cubic.onPacketAckOrLoss(
+      makeAck(packetNum++, 1000, Clock::now(), lastPacket.time), folly::none);
+}
+} // namespace
+
+TEST_F(CubicHystartTest, HystartPlusPlusConservativeSlowStart) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto cubic = Cubic::CubicBuilder().setHystartPlusPlus().build(conn);
+  PacketNum packetNum = 0;
+  auto cwnd = cubic->getCongestionWindow();
+  // Two rounds of regular slow start to get a baseline RTT:
+  for (int round = 0; round < 2; round++) {
+    ackHystartPlusPlusRound(conn, *cubic, packetNum, 50ms);
+    cwnd += 1000 * (kHystartPlusPlusRttSamples + 1);
+    EXPECT_EQ(cwnd, cubic->getCongestionWindow());
+  }
+
+  // The RTT increases by more than 50ms / 8, the last ack of the round is in
+  // conservative slow start:
+  ackHystartPlusPlusRound(conn, *cubic, packetNum, 60ms);
+  cwnd += 1000 * kHystartPlusPlusRttSamples +
+      1000 / kHystartPlusPlusCssGrowthDivisor;
+  EXPECT_EQ(cwnd, cubic->getCongestionWindow());
+  EXPECT_EQ(CubicStates::Hystart, cubic->state());
+
+  for (int round = 1; round < kHystartPlusPlusCssRounds; round++) {
+    EXPECT_EQ(CubicStates::Hystart, cubic->state());
+    ackHystartPlusPlusRound(conn, *cubic, packetNum, 60ms);
+    cwnd += (1000 / kHystartPlusPlusCssGrowthDivisor) *
+        (kHystartPlusPlusRttSamples + 1);
+    EXPECT_EQ(cwnd, cubic->getCongestionWindow());
+  }
+  EXPECT_EQ(CubicStates::Steady, cubic->state());
+}
+
+TEST_F(CubicHystartTest, HystartPlusPlusSpuriousDelayIncrease) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto cubic = Cubic::CubicBuilder().setHystartPlusPlus().build(conn);
+  PacketNum packetNum = 0;
+  ackHystartPlusPlusRound(conn, *cubic, packetNum, 50ms);
+  ackHystartPlusPlusRound(conn, *cubic, packetNum, 60ms);
+  auto cwnd = cubic->getCongestionWindow();
+
+  // The RTT drops below the one that started conservative slow start, which
+  // goes back to slow start after the first samples of the round:
+  ackHystartPlusPlusRound(conn, *cubic, packetNum, 55ms);
+  cwnd += (1000 / kHystartPlusPlusCssGrowthDivisor) *
+          kHystartPlusPlusRttSamples +
+      1000;
+  EXPECT_EQ(cwnd, cubic->getCongestionWindow());
+  EXPECT_EQ(CubicStates::Hystart, cubic->state());
+
+  // An increase within the threshold keeps slow start going:
+  ackHystartPlusPlusRound(conn, *cubic, packetNum, 58ms);
+  cwnd += 1000 * (kHystartPlusPlusRttSamples + 1);
+  EXPECT_EQ(cwnd, cubic->getCongestionWindow());
+  EXPECT_EQ(CubicStates::Hystart, cubic->state());
+}
 } // namespace test
 } // namespace quic
@@ -47,6 +47,34 @@ TEST_F(CubicRecoveryTest, LossBurst) {
   EXPECT_GT(cwndAfterLoss, cubic.getCongestionWindow());
 }
 
+TEST_F(CubicRecoveryTest, UndoSpuriousLoss) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  Cubic cubic(conn);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet0 = makeTestingWritePacket(0, 1000, 1000);
+  auto packet1 = makeTestingWritePacket(1, 1000, 2000);
+  cubic.onPacketSent(packet0);
+  cubic.onPacketSent(packet1);
+  CongestionController::LossEvent loss;
+  loss.addLostPacket(packet0);
+  loss.addLostPacket(packet1);
+  cubic.onPacketAckOrLoss(folly::none, std::move(loss));
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  EXPECT_GT(initCwnd, cubic.getCongestionWindow());
+
+  // Undone only once all the lost packets turned out not to be.
+  CongestionController::LossEvent spuriousLoss0;
+  spuriousLoss0.addLostPacket(packet0);
+  EXPECT_FALSE(cubic.onSpuriousLoss(spuriousLoss0));
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  CongestionController::LossEvent spuriousLoss1;
+  spuriousLoss1.addLostPacket(packet1);
+  EXPECT_TRUE(cubic.onSpuriousLoss(spuriousLoss1));
+  EXPECT_EQ(CubicStates::Hystart, cubic.state());
+  EXPECT_EQ(initCwnd, cubic.getCongestionWindow());
+  EXPECT_FALSE(cubic.onSpuriousLoss(spuriousLoss1));
+}
+
 TEST_F(CubicRecoveryTest, LossBeforeRecovery) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   Cubic cubic(conn);
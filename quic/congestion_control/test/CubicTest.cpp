@@ -318,5 +318,28 @@ TEST_F(CubicTest, PacetLossInvokesPacer) {
   lossEvent.addLostPacket(packet);
   cubic.onPacketAckOrLoss(folly::none, lossEvent);
 }
+
+TEST_F(CubicTest, ECNCEMarksReduceCwnd) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  Cubic cubic(conn);
+  auto initCwnd = cubic.getCongestionWindow();
+  auto packet1 = makeTestingWritePacket(0, 1000, 1000);
+  auto packet2 = makeTestingWritePacket(1, 1000, 2000);
+  cubic.onPacketSent(packet1);
+  cubic.onPacketSent(packet2);
+
+  auto ack = makeAck(0, 1000, Clock::now(), packet1.time);
+  ack.ecnCEMarks = 1;
+  cubic.onPacketAckOrLoss(ack, folly::none);
+  EXPECT_EQ(CubicStates::FastRecovery, cubic.state());
+  auto reducedCwnd = cubic.getCongestionWindow();
+  EXPECT_LT(reducedCwnd, initCwnd);
+
+  // Marks on packets sent before the recovery started are ignored.
+  auto ack2 = makeAck(1, 1000, Clock::now(), packet2.time);
+  ack2.ecnCEMarks = 1;
+  cubic.onPacketAckOrLoss(ack2, folly::none);
+  EXPECT_EQ(reducedCwnd, cubic.getCongestionWindow());
+}
 } // namespace test
 } // namespace quic
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/CwndValidator.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(CwndValidatorTest, PipeAck) {
+  CwndValidator validator;
+  auto now = Clock::now();
+  auto srtt = std::chrono::milliseconds(100);
+  validator.onPacketAcked(1000, now, srtt);
+  validator.onPacketAcked(1000, now + 50ms, srtt);
+  EXPECT_EQ(2000, validator.getPipeAck());
+  EXPECT_TRUE(validator.isValidated(4000));
+  EXPECT_FALSE(validator.isValidated(4001));
+
+  // A smaller flight in the next round doesn't lower pipeACK.
+  validator.onPacketAcked(500, now + 100ms, srtt);
+  EXPECT_EQ(2000, validator.getPipeAck());
+  // Until the round of the larger one gets old.
+  validator.onPacketAcked(500, now + 450ms, srtt);
+  EXPECT_EQ(500, validator.getPipeAck());
+}
+
+TEST(CwndValidatorTest, Idle) {
+  CwndValidator validator;
+  auto now = Clock::now();
+  auto srtt = std::chrono::milliseconds(100);
+  validator.onPacketAcked(10000, now, srtt);
+  EXPECT_TRUE(validator.isValidated(20000));
+  // Nothing is acked while idle, the first ack after it is the whole flight.
+  validator.onPacketAcked(1000, now + 10s, srtt);
+  EXPECT_EQ(1000, validator.getPipeAck());
+  EXPECT_FALSE(validator.isValidated(20000));
+}
+
+TEST(CwndValidatorTest, NonValidatedPeriod) {
+  CwndValidator validator(std::chrono::seconds(1));
+  auto now = Clock::now();
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(10000, now));
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(10000, now + 500ms));
+  EXPECT_TRUE(validator.nonValidatedPeriodExpired(10000, now + 1s));
+  // A new period starts.
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(10000, now + 1500ms));
+
+  // Using the window restarts the period.
+  validator.onPacketAcked(5000, now + 1500ms, 100ms);
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(10000, now + 1900ms));
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(1000000, now + 2s));
+  EXPECT_FALSE(validator.nonValidatedPeriodExpired(1000000, now + 2500ms));
+  EXPECT_TRUE(validator.nonValidatedPeriodExpired(1000000, now + 3s));
+}
+
+TEST(CwndValidatorTest, ReduceCwnd) {
+  EXPECT_EQ(50000, CwndValidator::reduceCwnd(100000, 12000));
+  EXPECT_EQ(12000, CwndValidator::reduceCwnd(20000, 12000));
+  EXPECT_EQ(10000, CwndValidator::reduceCwnd(10000, 12000));
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/MonotonicWindowedFilter.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+using TestMinFilter = MonotonicWindowedFilter<
+    uint64_t,
+    MinFilter<uint64_t>,
+    uint64_t,
+    uint64_t,
+    4>;
+using TestMaxFilter = MonotonicWindowedFilter<
+    uint64_t,
+    MaxFilter<uint64_t>,
+    uint64_t,
+    uint64_t,
+    4>;
+
+class MonotonicWindowedFilterTest : public Test {};
+
+TEST_F(MonotonicWindowedFilterTest, Empty) {
+  TestMinFilter filter(10, 1000, 0);
+  EXPECT_EQ(1000, filter.GetBest());
+}
+
+TEST_F(MonotonicWindowedFilterTest, MinExpiration) {
+  TestMinFilter filter(10, 0, 0);
+  filter.Update(50, 0);
+  filter.Update(60, 5);
+  filter.Update(70, 8);
+  EXPECT_EQ(50, filter.GetBest());
+  // 50 expires, the next best sample in the window takes over.
+  filter.Update(80, 11);
+  EXPECT_EQ(60, filter.GetBest());
+  filter.Update(90, 16);
+  EXPECT_EQ(70, filter.GetBest());
+  filter.Update(40, 17);
+  EXPECT_EQ(40, filter.GetBest());
+  // Only the new sample is left once everything else expires.
+  filter.Update(100, 30);
+  EXPECT_EQ(100, filter.GetBest());
+}
+
+TEST_F(MonotonicWindowedFilterTest, MaxExpiration) {
+  TestMaxFilter filter(10, 0, 0);
+  filter.Update(70, 0);
+  filter.Update(60, 5);
+  filter.Update(65, 6);
+  EXPECT_EQ(70, filter.GetBest());
+  filter.Update(10, 11);
+  EXPECT_EQ(65, filter.GetBest());
+  filter.Update(80, 12);
+  EXPECT_EQ(80, filter.GetBest());
+}
+
+TEST_F(MonotonicWindowedFilterTest, FullKeepsBest) {
+  TestMaxFilter filter(100, 0, 0);
+  for (uint64_t i = 0; i < 10; ++i) {
+    filter.Update(100 - i, i);
+  }
+  EXPECT_EQ(100, filter.GetBest());
+  // The best sample expires at its time, not earlier because of the capacity.
+  filter.Update(1, 100);
+  EXPECT_EQ(100, filter.GetBest());
+  filter.Update(1, 101);
+  EXPECT_NE(100, filter.GetBest());
+  EXPECT_LT(1, filter.GetBest());
+}
+
+TEST_F(MonotonicWindowedFilterTest, SetWindowLength) {
+  TestMinFilter filter(10, 0, 0);
+  filter.Update(50, 0);
+  filter.Update(60, 5);
+  filter.SetWindowLength(4);
+  filter.Update(70, 6);
+  EXPECT_EQ(60, filter.GetBest());
+}
+
+TEST_F(MonotonicWindowedFilterTest, Reset) {
+  TestMinFilter filter(10, 0, 0);
+  filter.Update(50, 0);
+  filter.Reset(70, 1);
+  EXPECT_EQ(70, filter.GetBest());
+  filter.Update(60, 2);
+  EXPECT_EQ(60, filter.GetBest());
+}
+} // namespace test
+} // namespace quic
@@ -102,6 +102,23 @@ TEST_F(NewRenoTest, TestLoss) {
   EXPECT_EQ(reno.getBytesInFlight(), 0);
 }
 
+TEST_F(NewRenoTest, UndoSpuriousLoss) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn);
+  auto initCwnd = reno.getCongestionWindow();
+  reno.onPacketSent(createPacket(1, 10, Clock::now()));
+  reno.onPacketSent(createPacket(2, 10, Clock::now()));
+  auto loss = createLossEvent({std::make_pair(1, 10)});
+  reno.onPacketAckOrLoss(folly::none, loss);
+  EXPECT_GT(initCwnd, reno.getCongestionWindow());
+  EXPECT_FALSE(reno.inSlowStart());
+
+  EXPECT_TRUE(reno.onSpuriousLoss(loss));
+  EXPECT_EQ(initCwnd, reno.getCongestionWindow());
+  EXPECT_TRUE(reno.inSlowStart());
+  EXPECT_FALSE(reno.onSpuriousLoss(loss));
+}
+
 TEST_F(NewRenoTest, SendMoreThanWritable) {
   QuicServerConnectionState conn;
   NewReno reno(conn);
@@ -229,5 +246,85 @@ TEST_F(NewRenoTest, RemoveBytesWithoutLossOrAck) {
   reno.onRemoveBytesFromInflight(2);
   EXPECT_EQ(reno.getWritableBytes(), originalWritableBytes - ackedSize + 2);
 }
+
+TEST_F(NewRenoTest, ECNCEMarksReduceCwnd) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn);
+  auto sentTime = Clock::now();
+  reno.onPacketSent(createPacket(1, 1000, sentTime));
+  reno.onPacketSent(createPacket(2, 1000, sentTime));
+  auto cwnd = reno.getCongestionWindow();
+
+  auto ack = createAckEvent(1, 1000, sentTime);
+  ack.largestAckedPacketSentTime = sentTime;
+  ack.ecnCEMarks = 1;
+  reno.onPacketAckOrLoss(ack, folly::none);
+  EXPECT_FALSE(reno.inSlowStart());
+  EXPECT_EQ(cwnd / 2, reno.getCongestionWindow());
+
+  // A mark on a packet sent before the recovery started doesn't reduce the
+  // window again, nor does the ack grow it.
+  auto ack2 = createAckEvent(2, 1000, sentTime);
+  ack2.largestAckedPacketSentTime = sentTime;
+  ack2.ecnCEMarks = 1;
+  reno.onPacketAckOrLoss(ack2, folly::none);
+  EXPECT_EQ(cwnd / 2, reno.getCongestionWindow());
+  EXPECT_EQ(0, reno.getBytesInFlight());
+}
+
+TEST_F(NewRenoTest, CwndValidation) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn, false, true /* cwndValidation */);
+  auto cwnd = reno.getCongestionWindow();
+  // A flight much smaller than the window doesn't grow it.
+  auto packet = createPacket(1, 1000, Clock::now());
+  reno.onPacketSent(packet);
+  reno.onPacketAckOrLoss(createAckEvent(1, 1000, packet.time), folly::none);
+  EXPECT_EQ(cwnd, reno.getCongestionWindow());
+
+  // Filling it does.
+  for (PacketNum packetNum = 2; packetNum < 10; packetNum++) {
+    reno.onPacketSent(createPacket(packetNum, 1000, Clock::now()));
+  }
+  reno.onPacketAckOrLoss(createAckEvent(9, 8000, Clock::now()), folly::none);
+  EXPECT_EQ(cwnd + 8000, reno.getCongestionWindow());
+}
+
+TEST_F(NewRenoTest, ProportionalRateReduction) {
+  QuicServerConnectionState conn;
+  NewReno reno(conn, true /* proportionalRateReduction */);
+  auto sentTime = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 10; packetNum++) {
+    reno.onPacketSent(createPacket(packetNum, 1000, sentTime));
+  }
+  reno.onPacketAckOrLoss(
+      folly::none, createLossEvent({std::make_pair(1, 1000)}));
+  auto ssthresh = reno.getCongestionWindow();
+  ASSERT_GT(reno.getBytesInFlight(), ssthresh);
+  EXPECT_EQ(0, reno.getWritableBytes());
+
+  // The ack of a packet sent before the recovery lets out ssthresh / 10000 of
+  // what it delivered, although the bytes in flight are still above cwnd.
+  auto ack = createAckEvent(2, 1000, sentTime);
+  ack.largestAckedPacketSentTime = sentTime;
+  reno.onPacketAckOrLoss(ack, folly::none);
+  auto allowed = (1000 * ssthresh + 9999) / 10000;
+  EXPECT_EQ(allowed, reno.getWritableBytes());
+  EXPECT_EQ(ssthresh, reno.getCongestionWindow());
+
+  reno.onPacketSent(createPacket(11, allowed, Clock::now()));
+  EXPECT_EQ(0, reno.getWritableBytes());
+
+  // The ack of a packet sent after the recovery started ends it.
+  auto afterRecovery = Clock::now() + std::chrono::seconds(1);
+  auto recoveredAck = createAckEvent(11, allowed, afterRecovery);
+  recoveredAck.largestAckedPacketSentTime = afterRecovery;
+  reno.onPacketAckOrLoss(recoveredAck, folly::none);
+  EXPECT_EQ(
+      reno.getCongestionWindow() > reno.getBytesInFlight()
+          ? reno.getCongestionWindow() - reno.getBytesInFlight()
+          : 0,
+      reno.getWritableBytes());
+}
 } // namespace test
 } // namespace quic
@@ -57,6 +57,32 @@ TEST_F(PacerTest, RateCalculator) {
   EXPECT_EQ(1234us, pacer.getTimeUntilNextWrite());
 }
 
+TEST_F(PacerTest, DeferredRefresh) {
+  std::vector<uint64_t> cwnds;
+  pacer.setPacingRateCalculator([&](const QuicConnectionStateBase&,
+                                    uint64_t cwndBytes,
+                                    uint64_t,
+                                    std::chrono::microseconds) {
+    cwnds.push_back(cwndBytes);
+    return PacingRate::Builder().setInterval(1234us).setBurstSize(10).build();
+  });
+  pacer.setRefreshDeferred(true);
+  pacer.refreshPacingRate(100000, 200us);
+  pacer.refreshPacingRate(200000, 200us);
+  pacer.refreshPacingRate(300000, 200us);
+  EXPECT_TRUE(cwnds.empty());
+  pacer.setRefreshDeferred(false);
+  EXPECT_EQ(std::vector<uint64_t>({300000}), cwnds);
+  // The burst is only added to the tokens once.
+  EXPECT_EQ(
+      10 + conn.transportSettings.writeConnectionDataPacketsLimit,
+      pacer.updateAndGetWriteBatchSize(Clock::now()));
+  // Nothing was asked for this time.
+  pacer.setRefreshDeferred(true);
+  pacer.setRefreshDeferred(false);
+  EXPECT_EQ(1, cwnds.size());
+}
+
 TEST_F(PacerTest, CompensateTimerDrift) {
   pacer.setPacingRateCalculator([](const QuicConnectionStateBase&,
                                    uint64_t,
@@ -158,6 +184,65 @@ TEST_F(PacerTest, AppLimited) {
   EXPECT_EQ(12, pacer.updateAndGetWriteBatchSize(Clock::now()));
 }
 
+TEST_F(PacerTest, RestartAfterIdle) {
+  conn.transportSettings.pacingRestartAfterIdle = true;
+  consumeTokensHelper(
+      pacer, conn.transportSettings.writeConnectionDataPacketsLimit);
+  pacer.setPacingRateCalculator([](const QuicConnectionStateBase&,
+                                   uint64_t,
+                                   uint64_t,
+                                   std::chrono::microseconds) {
+    return PacingRate::Builder().setInterval(10ms).setBurstSize(10).build();
+  });
+  pacer.setAppLimited(true);
+  // The refreshes while app limited add up tokens.
+  for (int i = 0; i < 5; i++) {
+    pacer.refreshPacingRate(100, 100ms);
+  }
+  pacer.setAppLimited(false);
+  // Only one burst of them is left after the idle period.
+  EXPECT_EQ(10, pacer.updateAndGetWriteBatchSize(Clock::now()));
+  consumeTokensHelper(pacer, 10);
+  EXPECT_EQ(10ms, pacer.getTimeUntilNextWrite());
+}
+
+TEST_F(PacerTest, MaxPacingRate) {
+  conn.transportSettings.pacingTimerTickInterval = 1ms;
+  // 1000 packets per second.
+  pacer.setMaxPacingRate(1000 * conn.udpSendPacketLen);
+  // Not refreshed yet, a packet every tick.
+  EXPECT_EQ(1, pacer.getCachedWriteBatchSize());
+  consumeTokensHelper(pacer, 1);
+  EXPECT_EQ(1ms, pacer.getTimeUntilNextWrite());
+
+  pacer.setPacingRateCalculator([](const QuicConnectionStateBase&,
+                                   uint64_t,
+                                   uint64_t,
+                                   std::chrono::microseconds) {
+    return PacingRate::Builder().setInterval(10ms).setBurstSize(100).build();
+  });
+  pacer.refreshPacingRate(100, 100ms);
+  EXPECT_EQ(10, pacer.getCachedWriteBatchSize());
+  // The refresh doesn't add tokens, and app limited connections are paced
+  // too.
+  pacer.setAppLimited(true);
+  EXPECT_EQ(10ms, pacer.getTimeUntilNextWrite());
+  EXPECT_EQ(0, pacer.updateAndGetWriteBatchSize(Clock::now()));
+  auto currentTime = Clock::now();
+  pacer.onPacedWriteScheduled(currentTime);
+  EXPECT_EQ(10, pacer.updateAndGetWriteBatchSize(currentTime + 10ms));
+  consumeTokensHelper(pacer, 10);
+
+  // Less than a packet per tick.
+  pacer.setMaxPacingRate(10 * conn.udpSendPacketLen);
+  EXPECT_EQ(1, pacer.getCachedWriteBatchSize());
+  EXPECT_EQ(100ms, pacer.getTimeUntilNextWrite());
+
+  pacer.setMaxPacingRate(0);
+  EXPECT_EQ(100, pacer.getCachedWriteBatchSize());
+  EXPECT_EQ(0us, pacer.getTimeUntilNextWrite());
+}
+
 TEST_F(PacerTest, Tokens) {
   // Pacer has tokens right after init:
   EXPECT_EQ(0us, pacer.getTimeUntilNextWrite());
@@ -201,5 +286,40 @@ TEST_F(PacerTest, Tokens) {
   EXPECT_EQ(20, pacer.updateAndGetWriteBatchSize(curTime + 20ms));
 }
 
+TEST_F(PacerTest, DepartureTimes) {
+  pacer.setPacingRateCalculator([](const QuicConnectionStateBase&,
+                                   uint64_t,
+                                   uint64_t,
+                                   std::chrono::microseconds) {
+    return PacingRate::Builder().setInterval(1ms).setBurstSize(2).build();
+  });
+  auto currentTime = Clock::now();
+  // Without a pacing rate everything leaves right away.
+  EXPECT_EQ(currentTime, pacer.getNextDepartureTime(currentTime));
+  EXPECT_EQ(currentTime, pacer.getNextDepartureTime(currentTime));
+  EXPECT_EQ(currentTime, pacer.getNextDepartureTime(currentTime));
+
+  pacer.refreshPacingRate(20, 100us); // These two values do not matter here
+  EXPECT_EQ(currentTime, pacer.getNextDepartureTime(currentTime));
+  EXPECT_EQ(currentTime, pacer.getNextDepartureTime(currentTime));
+  EXPECT_EQ(currentTime + 1ms, pacer.getNextDepartureTime(currentTime));
+  EXPECT_EQ(currentTime + 1ms, pacer.getNextDepartureTime(currentTime));
+  // A later write keeps the schedule of the packets still queued up.
+  EXPECT_EQ(
+      currentTime + 2ms, pacer.getNextDepartureTime(currentTime + 500us));
+
+  // Once everything has left, the next burst starts at the current time.
+  EXPECT_EQ(
+      currentTime + 5ms, pacer.getNextDepartureTime(currentTime + 5ms));
+  EXPECT_EQ(
+      currentTime + 5ms, pacer.getNextDepartureTime(currentTime + 5ms));
+  EXPECT_EQ(
+      currentTime + 6ms, pacer.getNextDepartureTime(currentTime + 5ms));
+
+  pacer.setAppLimited(true);
+  EXPECT_EQ(
+      currentTime + 5ms, pacer.getNextDepartureTime(currentTime + 5ms));
+}
+
 } // namespace test
 } // namespace quic
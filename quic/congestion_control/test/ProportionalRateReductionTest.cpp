@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/congestion_control/ProportionalRateReduction.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+constexpr uint64_t kPacketLength = 1000;
+
+TEST(ProportionalRateReductionTest, Proportional) {
+  ProportionalRateReduction prr;
+  EXPECT_FALSE(prr.inRecovery());
+  prr.onEnterRecovery(10000, 5000);
+  EXPECT_TRUE(prr.inRecovery());
+  EXPECT_EQ(0, prr.getWritableBytes());
+
+  // Half of what is delivered goes out while the bytes in flight are above
+  // ssthresh.
+  prr.onPacketAcked(1001, 8000, kPacketLength);
+  EXPECT_EQ(501, prr.getWritableBytes());
+  prr.onPacketSent(501);
+  EXPECT_EQ(0, prr.getWritableBytes());
+  prr.onPacketAcked(999, 7000, kPacketLength);
+  EXPECT_EQ(499, prr.getWritableBytes());
+  prr.onPacketSent(1000);
+  EXPECT_EQ(0, prr.getWritableBytes());
+  // What was sent over the quota is taken off the next one.
+  prr.onPacketAcked(2000, 6000, kPacketLength);
+  EXPECT_EQ(2000 - 1501, prr.getWritableBytes());
+}
+
+TEST(ProportionalRateReductionTest, SlowStartReductionBound) {
+  ProportionalRateReduction prr;
+  prr.onEnterRecovery(10000, 5000);
+  // Below ssthresh, an ack lets out what it delivered and one more packet.
+  prr.onPacketAcked(1000, 3000, kPacketLength);
+  EXPECT_EQ(2000, prr.getWritableBytes());
+  // But never more than what takes the bytes in flight to ssthresh.
+  prr.onPacketAcked(1000, 4500, kPacketLength);
+  EXPECT_EQ(500, prr.getWritableBytes());
+}
+
+TEST(ProportionalRateReductionTest, ExitRecovery) {
+  ProportionalRateReduction prr;
+  prr.onEnterRecovery(10000, 5000);
+  prr.onPacketAcked(1000, 8000, kPacketLength);
+  EXPECT_GT(prr.getWritableBytes(), 0);
+  prr.onExitRecovery();
+  EXPECT_FALSE(prr.inRecovery());
+  EXPECT_EQ(0, prr.getWritableBytes());
+  // Nothing is tracked outside of a recovery.
+  prr.onPacketAcked(1000, 8000, kPacketLength);
+  prr.onPacketSent(1000);
+  prr.onEnterRecovery(10000, 5000);
+  prr.onPacketAcked(1000, 8000, kPacketLength);
+  EXPECT_EQ(500, prr.getWritableBytes());
+}
+} // namespace test
+} // namespace quic
@@ -44,6 +44,31 @@ folly::Optional<uint64_t> calculateNewWindowUpdate(
   return folly::none;
 }
 
+/**
+ * Doubles windowSize when the previous window update was sent less than
+ * flowControlRttFrequency * srtt before updateTime, which means the window
+ * rather than the reader limits the peer. Returns whether it grew.
+ */
+bool maybeAutoTuneWindow(
+    uint64_t& windowSize,
+    const std::chrono::microseconds& srtt,
+    const TransportSettings& transportSettings,
+    const folly::Optional<TimePoint>& lastSendTime,
+    const TimePoint& updateTime) {
+  if (!transportSettings.flowControlWindowAutoTuning || !lastSendTime ||
+      srtt == std::chrono::microseconds::zero() ||
+      updateTime - *lastSendTime >=
+          transportSettings.flowControlRttFrequency * srtt) {
+    return false;
+  }
+  auto maxWindowSize = transportSettings.totalBufferSpaceAvailable;
+  if (windowSize >= maxWindowSize) {
+    return false;
+  }
+  windowSize = windowSize > maxWindowSize / 2 ? maxWindowSize : windowSize * 2;
+  return true;
+}
+
 template <typename T>
 inline void incrementWithOverFlowCheck(T& num, T diff) {
   if (UNLIKELY(num > std::numeric_limits<T>::max() - diff)) {
@@ -53,9 +78,21 @@ inline void incrementWithOverFlowCheck(T& num, T diff) {
   num += diff;
 }
 
+// The window to advertise, smaller when the worker is close to its buffer
+// budget.
+inline uint64_t advertisedWindowSize(
+    const QuicConnectionStateBase& conn,
+    uint64_t windowSize) {
+  return conn.bufferMemoryBudget
+      ? conn.bufferMemoryBudget->adjustWindowSize(windowSize)
+      : windowSize;
+}
+
 inline uint64_t calculateMaximumData(const QuicStreamState& stream) {
   return std::max(
-      stream.currentReadOffset + stream.flowControlState.windowSize,
+      stream.currentReadOffset +
+          advertisedWindowSize(
+              stream.conn, stream.flowControlState.windowSize),
       stream.flowControlState.advertisedMaxOffset);
 }
 } // namespace
@@ -72,12 +109,20 @@ bool maybeSendConnWindowUpdate(
   auto newAdvertisedOffset = calculateNewWindowUpdate(
       flowControlState.sumCurReadOffset,
       flowControlState.advertisedMaxOffset,
-      flowControlState.windowSize,
+      advertisedWindowSize(conn, flowControlState.windowSize),
       conn.lossState.srtt,
       conn.transportSettings,
       flowControlState.timeOfLastFlowControlUpdate,
       updateTime);
   if (newAdvertisedOffset) {
+    if (maybeAutoTuneWindow(
+            flowControlState.windowSize,
+            conn.lossState.srtt,
+            conn.transportSettings,
+            flowControlState.timeOfLastFlowControlUpdate,
+            updateTime)) {
+      VLOG(10) << "Increased conn window to " << flowControlState.windowSize;
+    }
     conn.pendingEvents.connWindowUpdate = true;
     QUIC_STATS(conn.infoCallback, onConnFlowControlUpdate);
     if (conn.qLogger) {
@@ -103,12 +148,28 @@ bool maybeSendStreamWindowUpdate(
   auto newAdvertisedOffset = calculateNewWindowUpdate(
       stream.currentReadOffset,
       flowControlState.advertisedMaxOffset,
-      flowControlState.windowSize,
+      advertisedWindowSize(stream.conn, flowControlState.windowSize),
       stream.conn.lossState.srtt,
       stream.conn.transportSettings,
       flowControlState.timeOfLastFlowControlUpdate,
       updateTime);
   if (newAdvertisedOffset) {
+    auto& conn = stream.conn;
+    if (maybeAutoTuneWindow(
+            flowControlState.windowSize,
+            conn.lossState.srtt,
+            conn.transportSettings,
+            flowControlState.timeOfLastFlowControlUpdate,
+            updateTime)) {
+      // Don't let the connection window become the limit of the stream.
+      auto connWindowSize = std::min<uint64_t>(
+          flowControlState.windowSize * kConnectionToStreamWindowRatio,
+          conn.transportSettings.totalBufferSpaceAvailable);
+      conn.flowControlState.windowSize =
+          std::max(conn.flowControlState.windowSize, connWindowSize);
+      VLOG(10) << "Increased window of stream=" << stream.id << " to "
+               << flowControlState.windowSize;
+    }
     VLOG(10) << "Queued flow control update for stream=" << stream.id
              << " offset=" << *newAdvertisedOffset;
     stream.conn.streamManager->queueWindowUpdate(stream.id);
@@ -420,7 +481,8 @@ void updateFlowControlStateWithSettings(
 
 MaxDataFrame generateMaxDataFrame(const QuicConnectionStateBase& conn) {
   return MaxDataFrame(std::max(
-      conn.flowControlState.sumCurReadOffset + conn.flowControlState.windowSize,
+      conn.flowControlState.sumCurReadOffset +
+          advertisedWindowSize(conn, conn.flowControlState.windowSize),
       conn.flowControlState.advertisedMaxOffset));
 }
 
@@ -221,6 +221,99 @@ TEST_F(QuicFlowControlTest, MaybeSendStreamWindowUpdateTimeElapsed) {
   EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
 }
 
+TEST_F(QuicFlowControlTest, AutoTuneConnWindow) {
+  conn_.transportSettings.flowControlWindowAutoTuning = true;
+  conn_.transportSettings.totalBufferSpaceAvailable = 1500;
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 600;
+  conn_.flowControlState.sumCurReadOffset = 400;
+  conn_.lossState.srtt = 100us;
+  auto lastUpdateTime = Clock::now();
+  conn_.flowControlState.timeOfLastFlowControlUpdate = lastUpdateTime;
+
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(3);
+  maybeSendConnWindowUpdate(conn_, lastUpdateTime + 100us);
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(1000, conn_.flowControlState.windowSize);
+  EXPECT_EQ(1400, generateMaxDataFrame(conn_).maximumData);
+
+  // Capped by the buffer space.
+  conn_.pendingEvents.connWindowUpdate = false;
+  conn_.flowControlState.advertisedMaxOffset = 1400;
+  conn_.flowControlState.sumCurReadOffset = 1000;
+  maybeSendConnWindowUpdate(conn_, lastUpdateTime + 100us);
+  EXPECT_EQ(1500, conn_.flowControlState.windowSize);
+
+  // The update was sent more than 2 rtts ago.
+  conn_.pendingEvents.connWindowUpdate = false;
+  conn_.flowControlState.windowSize = 500;
+  maybeSendConnWindowUpdate(conn_, lastUpdateTime + 300us);
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, AutoTuneStreamWindow) {
+  conn_.transportSettings.flowControlWindowAutoTuning = true;
+  conn_.flowControlState.windowSize = 500;
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 400;
+  stream.flowControlState.windowSize = 500;
+  stream.flowControlState.advertisedMaxOffset = 600;
+  conn_.lossState.srtt = 100us;
+  stream.flowControlState.timeOfLastFlowControlUpdate = Clock::now();
+
+  EXPECT_CALL(*transportInfoCb_, onStreamFlowControlUpdate()).Times(1);
+  maybeSendStreamWindowUpdate(
+      stream, *stream.flowControlState.timeOfLastFlowControlUpdate + 100us);
+  EXPECT_TRUE(conn_.streamManager->pendingWindowUpdate(stream.id));
+  EXPECT_EQ(1000, stream.flowControlState.windowSize);
+  EXPECT_EQ(1500, conn_.flowControlState.windowSize);
+  EXPECT_EQ(1400, generateMaxStreamDataFrame(stream).maximumData);
+}
+
+TEST_F(QuicFlowControlTest, NoAutoTuneWhenDisabled) {
+  conn_.flowControlState.windowSize = 500;
+  conn_.flowControlState.advertisedMaxOffset = 600;
+  conn_.flowControlState.sumCurReadOffset = 400;
+  conn_.lossState.srtt = 100us;
+  conn_.flowControlState.timeOfLastFlowControlUpdate = Clock::now();
+
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(1);
+  maybeSendConnWindowUpdate(
+      conn_, *conn_.flowControlState.timeOfLastFlowControlUpdate + 100us);
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(500, conn_.flowControlState.windowSize);
+}
+
+TEST_F(QuicFlowControlTest, SmallerWindowsUnderBufferPressure) {
+  conn_.bufferMemoryBudget = std::make_shared<BufferMemoryBudget>(1000, 0.5);
+  conn_.flowControlState.windowSize = 400;
+  conn_.flowControlState.advertisedMaxOffset = 400;
+  conn_.flowControlState.sumCurReadOffset = 300;
+  StreamId id = 3;
+  QuicStreamState stream(id, conn_);
+  stream.currentReadOffset = 300;
+  stream.flowControlState.windowSize = 400;
+  stream.flowControlState.advertisedMaxOffset = 400;
+  EXPECT_EQ(700, generateMaxDataFrame(conn_).maximumData);
+  EXPECT_EQ(700, generateMaxStreamDataFrame(stream).maximumData);
+
+  conn_.bufferMemoryBudget->update(0, 600);
+  EXPECT_EQ(400, generateMaxDataFrame(conn_).maximumData);
+  EXPECT_EQ(400, generateMaxStreamDataFrame(stream).maximumData);
+
+  // The remaining window is still large enough for the smaller window.
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(0);
+  maybeSendConnWindowUpdate(conn_, Clock::now());
+  EXPECT_FALSE(conn_.pendingEvents.connWindowUpdate);
+
+  conn_.flowControlState.sumCurReadOffset = 390;
+  EXPECT_CALL(*transportInfoCb_, onConnFlowControlUpdate()).Times(1);
+  maybeSendConnWindowUpdate(conn_, Clock::now());
+  EXPECT_TRUE(conn_.pendingEvents.connWindowUpdate);
+  EXPECT_EQ(490, generateMaxDataFrame(conn_).maximumData);
+}
+
 TEST_F(QuicFlowControlTest, DontSendStreamWindowUpdateTwice) {
   StreamId id = 3;
   QuicStreamState stream(id, conn_);
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 
 namespace quic {
@@ -33,6 +34,18 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Encrypts plaintext in place. plaintext must be a single unshared buffer
+   * with at least getCipherOverhead() bytes of tailroom for the tag, and the
+   * returned ciphertext is the same buffer. Will throw on error.
+   */
+  virtual std::unique_ptr<folly::IOBuf> inplaceEncrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    return encrypt(std::move(plaintext), associatedData, seqNum);
+  }
+
   /**
    * Decrypt ciphertext. Will throw if the ciphertext does not decrypt
    * successfully.
@@ -57,6 +70,47 @@ class Aead {
       const folly::IOBuf* associatedData,
       uint64_t seqNum) const = 0;
 
+  /**
+   * Decrypts ciphertext in place. ciphertext must be a single unshared
+   * buffer, which the returned plaintext reuses. Will return none if the
+   * ciphertext does not decrypt successfully, in which case the contents of
+   * the buffer are undefined.
+   */
+  virtual folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const {
+    return tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+  }
+
+  struct DecryptRequest {
+    std::unique_ptr<folly::IOBuf> ciphertext;
+    const folly::IOBuf* associatedData{nullptr};
+    uint64_t seqNum{0};
+    // Set by tryDecryptBatch(), none if the ciphertext did not decrypt.
+    folly::Optional<std::unique_ptr<folly::IOBuf>> plaintext;
+  };
+
+  /**
+   * Decrypts the ciphertexts of several requests, in place for the unshared
+   * ones, and sets their plaintext like tryDecrypt() would. Implementations
+   * can interleave the requests to keep several blocks in flight through the
+   * cipher pipelines, the default decrypts them one after the other.
+   */
+  virtual void tryDecryptBatch(folly::Range<DecryptRequest*> requests) const {
+    for (auto& request : requests) {
+      request.plaintext = request.ciphertext->isSharedOne()
+          ? tryDecrypt(
+                std::move(request.ciphertext),
+                request.associatedData,
+                request.seqNum)
+          : tryDecryptInPlace(
+                std::move(request.ciphertext),
+                request.associatedData,
+                request.seqNum);
+    }
+  }
+
   /**
    * Returns the number of bytes the aead will add to the plaintext (size of
    * ciphertext - size of plaintext).
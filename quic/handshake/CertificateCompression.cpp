@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/CertificateCompression.h>
+
+#include <fizz/compression/ZlibCertificateCompressor.h>
+#include <fizz/compression/ZlibCertificateDecompressor.h>
+#include <quic/QuicConstants.h>
+
+namespace quic {
+
+std::vector<fizz::CertificateCompressionAlgorithm>
+getCertificateCompressionAlgorithms() {
+  return {fizz::CertificateCompressionAlgorithm::zlib};
+}
+
+std::vector<std::shared_ptr<fizz::CertificateCompressor>>
+makeCertificateCompressors() {
+  return {std::make_shared<fizz::ZlibCertificateCompressor>(
+      kDefaultCertificateCompressionLevel)};
+}
+
+std::shared_ptr<fizz::CertDecompressionManager>
+getCertDecompressionManager() {
+  static auto manager = [] {
+    auto decompressionManager =
+        std::make_shared<fizz::CertDecompressionManager>();
+    decompressionManager->setDecompressors(
+        {std::make_shared<fizz::ZlibCertificateDecompressor>()});
+    return decompressionManager;
+  }();
+  return manager;
+}
+} // namespace quic
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/compression/CertDecompressionManager.h>
+#include <fizz/compression/CertificateCompressor.h>
+#include <fizz/record/Types.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Compressing the Certificate message keeps the server's first flight
+ * within the amplification limit with larger certificate chains. With
+ * TransportSettings::certificateCompression the client offers these
+ * algorithms and the server negotiates them. The server sends the
+ * CompressedCertificate it gets from its certificate, so the certificates of
+ * the server's CertManager must have a compressor for them, see
+ * fizz::SelfCertImpl::setCompressors() and makeCertificateCompressors().
+ */
+std::vector<fizz::CertificateCompressionAlgorithm>
+getCertificateCompressionAlgorithms();
+
+/**
+ * The compressors of getCertificateCompressionAlgorithms(), to give to the
+ * certificates of a server.
+ */
+std::vector<std::shared_ptr<fizz::CertificateCompressor>>
+makeCertificateCompressors();
+
+/**
+ * Decompresses the algorithms of getCertificateCompressionAlgorithms(). The
+ * manager is shared by all the clients of the process, it isn't modified
+ * once made.
+ */
+std::shared_ptr<fizz::CertDecompressionManager>
+getCertDecompressionManager();
+} // namespace quic
@@ -38,6 +38,18 @@ class FizzAead final : public Aead {
       uint64_t seqNum) const override {
     return fizzAead->encrypt(std::move(plaintext), associatedData, seqNum);
   }
+  /**
+   * fizz encrypts and decrypts unshared buffers in place, and puts the tag in
+   * the tailroom when there is enough of it.
+   */
+  std::unique_ptr<folly::IOBuf> inplaceEncrypt(
+      std::unique_ptr<folly::IOBuf>&& plaintext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    DCHECK(!plaintext->isChained() && !plaintext->isSharedOne());
+    DCHECK_GE(plaintext->tailroom(), fizzAead->getCipherOverhead());
+    return fizzAead->encrypt(std::move(plaintext), associatedData, seqNum);
+  }
   std::unique_ptr<folly::IOBuf> decrypt(
       std::unique_ptr<folly::IOBuf>&& ciphertext,
       const folly::IOBuf* associatedData,
@@ -50,6 +62,13 @@ class FizzAead final : public Aead {
       uint64_t seqNum) const override {
     return fizzAead->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
   }
+  folly::Optional<std::unique_ptr<folly::IOBuf>> tryDecryptInPlace(
+      std::unique_ptr<folly::IOBuf>&& ciphertext,
+      const folly::IOBuf* associatedData,
+      uint64_t seqNum) const override {
+    DCHECK(!ciphertext->isChained() && !ciphertext->isSharedOne());
+    return fizzAead->tryDecrypt(std::move(ciphertext), associatedData, seqNum);
+  }
   size_t getCipherOverhead() const override {
     return fizzAead->getCipherOverhead();
   }
@@ -12,6 +12,14 @@
 #include <quic/handshake/FizzPacketNumberCipher.h>
 #include <quic/handshake/HandshakeLayer.h>
 
+#include <folly/CpuId.h>
+#include <folly/Portability.h>
+
+#if (defined(__aarch64__) || defined(__arm__)) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
 namespace {
 
 class QuicPlaintextReadRecordLayer : public fizz::PlaintextReadRecordLayer {
@@ -121,6 +129,15 @@ std::unique_ptr<Aead> FizzCryptoFactory::makeInitialAead(
     folly::StringPiece label,
     const ConnectionId& clientDestinationConnId,
     QuicVersion version) const {
+  auto aead = makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  aead->setKey(makeInitialTrafficKey(label, clientDestinationConnId, version));
+  return FizzAead::wrap(std::move(aead));
+}
+
+fizz::TrafficKey FizzCryptoFactory::makeInitialTrafficKey(
+    folly::StringPiece label,
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) const {
   auto trafficSecret =
       makeInitialTrafficSecret(label, clientDestinationConnId, version);
   auto deriver = makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
@@ -135,23 +152,32 @@ std::unique_ptr<Aead> FizzCryptoFactory::makeInitialAead(
       kQuicIVLabel,
       folly::IOBuf::create(0),
       aead->ivLength());
+  return {std::move(key), std::move(iv)};
+}
 
-  fizz::TrafficKey trafficKey = {std::move(key), std::move(iv)};
-  aead->setKey(std::move(trafficKey));
-  return FizzAead::wrap(std::move(aead));
+std::unique_ptr<PacketNumberCipher> FizzCryptoFactory::makePacketNumberCipher(
+    folly::ByteRange baseSecret) const {
+  return makePacketNumberCipher(
+      fizz::CipherSuite::TLS_AES_128_GCM_SHA256, baseSecret);
 }
 
 std::unique_ptr<PacketNumberCipher> FizzCryptoFactory::makePacketNumberCipher(
+    fizz::CipherSuite cipher,
     folly::ByteRange baseSecret) const {
-  auto pnCipher =
-      makePacketNumberCipher(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
-  auto deriver = makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
-  auto pnKey = deriver->expandLabel(
-      baseSecret, kQuicPNLabel, folly::IOBuf::create(0), pnCipher->keyLength());
+  auto pnCipher = makePacketNumberCipher(cipher);
+  auto pnKey = makePacketNumberKey(baseSecret, pnCipher->keyLength());
   pnCipher->setKey(pnKey->coalesce());
   return pnCipher;
 }
 
+Buf FizzCryptoFactory::makePacketNumberKey(
+    folly::ByteRange baseSecret,
+    size_t keyLength) const {
+  auto deriver = makeKeyDeriver(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  return deriver->expandLabel(
+      baseSecret, kQuicPNLabel, folly::IOBuf::create(0), keyLength);
+}
+
 std::unique_ptr<fizz::PlaintextReadRecordLayer>
 FizzCryptoFactory::makePlaintextReadRecordLayer() const {
   return std::make_unique<QuicPlaintextReadRecordLayer>();
@@ -181,9 +207,36 @@ std::unique_ptr<PacketNumberCipher> FizzCryptoFactory::makePacketNumberCipher(
       return std::make_unique<Aes128PacketNumberCipher>();
     case fizz::CipherSuite::TLS_AES_256_GCM_SHA384:
       return std::make_unique<Aes256PacketNumberCipher>();
+    case fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256:
+      return std::make_unique<ChaCha20PacketNumberCipher>();
     default:
       throw std::runtime_error("Packet number cipher not implemented");
   }
 }
 
+bool hasHardwareAes() {
+  static const bool hardwareAes = [] {
+#if FOLLY_X64
+    return folly::CpuId().aes();
+#elif defined(__aarch64__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__arm__) && defined(__linux__)
+    return (getauxval(AT_HWCAP2) & HWCAP2_AES) != 0;
+#else
+    // Keep preferring AES-GCM where we can't tell.
+    return true;
+#endif
+  }();
+  return hardwareAes;
+}
+
+std::vector<fizz::CipherSuite> getQuicCipherSuites(bool hardwareAes) {
+  if (hardwareAes) {
+    return {fizz::CipherSuite::TLS_AES_128_GCM_SHA256,
+            fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256};
+  }
+  return {fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+          fizz::CipherSuite::TLS_AES_128_GCM_SHA256};
+}
+
 } // namespace quic
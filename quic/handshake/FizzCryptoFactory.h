@@ -12,6 +12,8 @@
 
 #include <fizz/protocol/OpenSSLFactory.h>
 
+#include <vector>
+
 namespace quic {
 
 class FizzCryptoFactory : public CryptoFactory, public fizz::OpenSSLFactory {
@@ -28,9 +30,35 @@ class FizzCryptoFactory : public CryptoFactory, public fizz::OpenSSLFactory {
       const ConnectionId& clientDestinationConnId,
       QuicVersion version) const override;
 
+  /**
+   * The header protection of the Initial packets, which is always the one of
+   * TLS_AES_128_GCM_SHA256.
+   */
   std::unique_ptr<PacketNumberCipher> makePacketNumberCipher(
       folly::ByteRange baseSecret) const override;
 
+  /**
+   * The header protection of the negotiated cipher suite, keyed from the
+   * traffic secret.
+   */
+  std::unique_ptr<PacketNumberCipher> makePacketNumberCipher(
+      fizz::CipherSuite cipher,
+      folly::ByteRange baseSecret) const;
+
+  /**
+   * The key and iv of the Aead made by makeInitialAead().
+   */
+  fizz::TrafficKey makeInitialTrafficKey(
+      folly::StringPiece label,
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version) const;
+
+  /**
+   * The key of the PacketNumberCipher made by makePacketNumberCipher(), which
+   * is keyLength long.
+   */
+  Buf makePacketNumberKey(folly::ByteRange baseSecret, size_t keyLength) const;
+
   std::unique_ptr<fizz::PlaintextReadRecordLayer> makePlaintextReadRecordLayer()
       const override;
 
@@ -48,4 +76,16 @@ class FizzCryptoFactory : public CryptoFactory, public fizz::OpenSSLFactory {
       fizz::CipherSuite cipher) const;
 };
 
+/**
+ * Whether the CPU has AES instructions, checked once at runtime. Without
+ * them AES-GCM is several times slower than ChaCha20-Poly1305.
+ */
+bool hasHardwareAes();
+
+/**
+ * The cipher suites a client offers, in its order of preference:
+ * ChaCha20-Poly1305 comes first when the CPU has no AES instructions.
+ */
+std::vector<fizz::CipherSuite> getQuicCipherSuites(bool hardwareAes);
+
 } // namespace quic
@@ -8,6 +8,8 @@
 
 #include <quic/handshake/FizzPacketNumberCipher.h>
 
+#include <folly/Conv.h>
+
 namespace quic {
 
 static void setKeyImpl(
@@ -43,6 +45,32 @@ static HeaderProtectionMask maskImpl(
   return outMask;
 }
 
+// ECB encrypts every block independently, so a single update over all the
+// samples gives the same masks as one update per sample, and lets OpenSSL
+// pipeline the blocks (AES-NI on x86, the crypto extensions on ARM).
+static void batchMaskImpl(
+    const folly::ssl::EvpCipherCtxUniquePtr& context,
+    folly::Range<const Sample*> samples,
+    HeaderProtectionMask* masks) {
+  static_assert(
+      sizeof(Sample) == sizeof(HeaderProtectionMask),
+      "a mask is one encrypted sample");
+  if (samples.empty()) {
+    return;
+  }
+  int outLen = 0;
+  int inLen = folly::to<int>(samples.size() * sizeof(Sample));
+  if (EVP_EncryptUpdate(
+          context.get(),
+          reinterpret_cast<uint8_t*>(masks),
+          &outLen,
+          reinterpret_cast<const uint8_t*>(samples.data()),
+          inLen) != 1 ||
+      outLen != inLen) {
+    throw std::runtime_error("Encryption error");
+  }
+}
+
 void Aes128PacketNumberCipher::setKey(folly::ByteRange key) {
   return setKeyImpl(encryptCtx_, EVP_aes_128_ecb(), key);
 }
@@ -61,6 +89,18 @@ HeaderProtectionMask Aes256PacketNumberCipher::mask(
   return maskImpl(encryptCtx_, sample);
 }
 
+void Aes128PacketNumberCipher::batchMask(
+    folly::Range<const Sample*> samples,
+    HeaderProtectionMask* masks) const {
+  batchMaskImpl(encryptCtx_, samples, masks);
+}
+
+void Aes256PacketNumberCipher::batchMask(
+    folly::Range<const Sample*> samples,
+    HeaderProtectionMask* masks) const {
+  batchMaskImpl(encryptCtx_, samples, masks);
+}
+
 constexpr size_t kAES128KeyLength = 16;
 
 size_t Aes128PacketNumberCipher::keyLength() const {
@@ -73,4 +113,28 @@ size_t Aes256PacketNumberCipher::keyLength() const {
   return kAES256KeyLength;
 }
 
+void ChaCha20PacketNumberCipher::setKey(folly::ByteRange key) {
+  return setKeyImpl(encryptCtx_, EVP_chacha20(), key);
+}
+
+HeaderProtectionMask ChaCha20PacketNumberCipher::mask(
+    folly::ByteRange sample) const {
+  // The IV of OpenSSL's ChaCha20 is the little endian block counter followed
+  // by the nonce, which is the layout of the sample, so the mask is the
+  // encryption of zeros with the sample as the IV.
+  HeaderProtectionMask zeros{};
+  CHECK_EQ(sample.size(), zeros.size());
+  if (EVP_EncryptInit_ex(
+          encryptCtx_.get(), nullptr, nullptr, nullptr, sample.data()) != 1) {
+    throw std::runtime_error("Init error");
+  }
+  return maskImpl(encryptCtx_, folly::range(zeros));
+}
+
+constexpr size_t kChaCha20KeyLength = 32;
+
+size_t ChaCha20PacketNumberCipher::keyLength() const {
+  return kChaCha20KeyLength;
+}
+
 } // namespace quic
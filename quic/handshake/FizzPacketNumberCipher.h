@@ -22,6 +22,10 @@ class Aes128PacketNumberCipher : public PacketNumberCipher {
 
   HeaderProtectionMask mask(folly::ByteRange sample) const override;
 
+  void batchMask(
+      folly::Range<const Sample*> samples,
+      HeaderProtectionMask* masks) const override;
+
   size_t keyLength() const override;
 
  private:
@@ -36,6 +40,30 @@ class Aes256PacketNumberCipher : public PacketNumberCipher {
 
   HeaderProtectionMask mask(folly::ByteRange sample) const override;
 
+  void batchMask(
+      folly::Range<const Sample*> samples,
+      HeaderProtectionMask* masks) const override;
+
+  size_t keyLength() const override;
+
+ private:
+  folly::ssl::EvpCipherCtxUniquePtr encryptCtx_;
+};
+
+/**
+ * The header protection of ChaCha20-Poly1305: the mask is the keystream of
+ * ChaCha20 with the first 4 bytes of the sample as the block counter and the
+ * other 12 as the nonce. Unlike AES-ECB it needs no hardware support to be
+ * fast, and it is what the clients without AES instructions negotiate.
+ */
+class ChaCha20PacketNumberCipher : public PacketNumberCipher {
+ public:
+  ~ChaCha20PacketNumberCipher() override = default;
+
+  void setKey(folly::ByteRange key) override;
+
+  HeaderProtectionMask mask(folly::ByteRange sample) const override;
+
   size_t keyLength() const override;
 
  private:
@@ -19,6 +19,8 @@ namespace quic {
 constexpr folly::StringPiece kQuicKeyLabel = "quic key";
 constexpr folly::StringPiece kQuicIVLabel = "quic iv";
 constexpr folly::StringPiece kQuicPNLabel = "quic hp";
+// Derives the traffic secret of the next key phase from the current one.
+constexpr folly::StringPiece kQuicKeyUpdateLabel = "traffic upd";
 
 class Handshake : public folly::DelayedDestruction {
  public:
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/handshake/OneRttKeyUpdater.h>
+
+#include <fizz/protocol/Protocol.h>
+#include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/HandshakeLayer.h>
+
+namespace quic {
+
+OneRttKeyUpdater::OneRttKeyUpdater(
+    fizz::CipherSuite cipher,
+    std::vector<uint8_t> readSecret,
+    std::vector<uint8_t> writeSecret,
+    std::shared_ptr<const FizzCryptoFactory> factory)
+    : cipher_(cipher),
+      factory_(std::move(factory)),
+      keyScheduler_(factory_->makeKeyScheduler(cipher)),
+      readSecret_(std::move(readSecret)),
+      writeSecret_(std::move(writeSecret)) {}
+
+std::unique_ptr<Aead> OneRttKeyUpdater::makeNextReadCipher() {
+  return makeNextCipher(readSecret_);
+}
+
+std::unique_ptr<Aead> OneRttKeyUpdater::makeNextWriteCipher() {
+  return makeNextCipher(writeSecret_);
+}
+
+std::unique_ptr<Aead> OneRttKeyUpdater::makeNextCipher(
+    std::vector<uint8_t>& secret) {
+  auto deriver = factory_->makeKeyDeriver(cipher_);
+  auto nextSecret = deriver->expandLabel(
+      folly::range(secret),
+      kQuicKeyUpdateLabel,
+      folly::IOBuf::create(0),
+      secret.size());
+  nextSecret->coalesce();
+  secret.assign(nextSecret->data(), nextSecret->data() + nextSecret->length());
+  return FizzAead::wrap(fizz::Protocol::deriveRecordAeadWithLabel(
+      *factory_,
+      *keyScheduler_,
+      cipher_,
+      folly::range(secret),
+      kQuicKeyLabel,
+      kQuicIVLabel));
+}
+} // namespace quic
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/handshake/Aead.h>
+#include <quic/handshake/FizzCryptoFactory.h>
+
+#include <fizz/protocol/KeyScheduler.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Derives the 1-rtt ciphers of the next key phases of a connection from its
+ * 1-rtt traffic secrets. Every key update moves the secret of a direction to
+ * HKDF-Expand-Label(secret, "traffic upd", "", Hash.length) and derives the
+ * packet protection key and iv from it, while the header protection keys stay
+ * the ones of the first phase.
+ *
+ * The read and write directions advance independently, since the read cipher
+ * of the next phase is derived before the peer starts using it.
+ */
+class OneRttKeyUpdater {
+ public:
+  /**
+   * The ciphers are made by factory, the one of the handshake, so that they
+   * are offloaded the same way as the ciphers of the first phase.
+   */
+  OneRttKeyUpdater(
+      fizz::CipherSuite cipher,
+      std::vector<uint8_t> readSecret,
+      std::vector<uint8_t> writeSecret,
+      std::shared_ptr<const FizzCryptoFactory> factory =
+          std::make_shared<FizzCryptoFactory>());
+
+  /**
+   * The read cipher of the key phase after the last one derived.
+   */
+  std::unique_ptr<Aead> makeNextReadCipher();
+
+  /**
+   * The write cipher of the key phase after the last one derived.
+   */
+  std::unique_ptr<Aead> makeNextWriteCipher();
+
+ private:
+  std::unique_ptr<Aead> makeNextCipher(std::vector<uint8_t>& secret);
+
+  fizz::CipherSuite cipher_;
+  std::shared_ptr<const FizzCryptoFactory> factory_;
+  std::unique_ptr<fizz::KeyScheduler> keyScheduler_;
+  std::vector<uint8_t> readSecret_;
+  std::vector<uint8_t> writeSecret_;
+};
+} // namespace quic
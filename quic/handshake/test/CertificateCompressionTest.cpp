@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <folly/portability/GTest.h>
+
+#include <fizz/record/Types.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/handshake/CertificateCompression.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(CertificateCompressionTest, CompressAndDecompress) {
+  auto algorithms = getCertificateCompressionAlgorithms();
+  auto compressors = makeCertificateCompressors();
+  ASSERT_EQ(algorithms.size(), compressors.size());
+  auto manager = getCertDecompressionManager();
+  EXPECT_EQ(manager, getCertDecompressionManager());
+
+  auto cert = readCert();
+  auto certMsg = cert->getCertMessage();
+  auto encoded = fizz::encode(cert->getCertMessage());
+  for (size_t i = 0; i < algorithms.size(); i++) {
+    EXPECT_EQ(algorithms[i], compressors[i]->getAlgorithm());
+    auto compressed = compressors[i]->compress(certMsg);
+    EXPECT_EQ(algorithms[i], compressed.algorithm);
+    auto decompressor = manager->getDecompressor(algorithms[i]);
+    ASSERT_NE(decompressor, nullptr);
+    auto decompressed = decompressor->decompress(compressed);
+    EXPECT_TRUE(folly::IOBufEqualTo()(
+        encoded, fizz::encode(std::move(decompressed))));
+  }
+}
+} // namespace test
+} // namespace quic
@@ -119,6 +119,35 @@ TEST_F(FizzCryptoFactoryTest, TestDraft23ClearTextCipher) {
   EXPECT_EQ(trafficIvHex, expectedIv);
 }
 
+TEST_F(FizzCryptoFactoryTest, TestInPlaceEncryptDecrypt) {
+  FizzCryptoFactory cryptoFactory;
+  auto connid = getTestConnectionId();
+  auto writeCipher =
+      cryptoFactory.getClientInitialCipher(connid, QuicVersion::QUIC_DRAFT);
+  auto readCipher =
+      cryptoFactory.getClientInitialCipher(connid, QuicVersion::QUIC_DRAFT);
+  auto overhead = writeCipher->getCipherOverhead();
+
+  std::string plaintext = "plaintext";
+  auto header = folly::IOBuf::copyBuffer("header");
+  auto buf = folly::IOBuf::create(plaintext.size() + overhead);
+  memcpy(buf->writableData(), plaintext.data(), plaintext.size());
+  buf->append(plaintext.size());
+  auto data = buf->data();
+
+  auto ciphertext =
+      writeCipher->inplaceEncrypt(std::move(buf), header.get(), 1);
+  EXPECT_FALSE(ciphertext->isChained());
+  EXPECT_EQ(ciphertext->data(), data);
+  EXPECT_EQ(ciphertext->length(), plaintext.size() + overhead);
+
+  auto decrypted =
+      readCipher->tryDecryptInPlace(std::move(ciphertext), header.get(), 1);
+  ASSERT_TRUE(decrypted.hasValue());
+  EXPECT_EQ((*decrypted)->data(), data);
+  EXPECT_EQ((*decrypted)->moveToFbString().toStdString(), plaintext);
+}
+
 TEST_F(FizzCryptoFactoryTest, TestPacketEncryptionKey) {
   FizzCryptoTestFactory cryptoFactory;
   cryptoFactory.setMockPacketNumberCipher(createMockPacketNumberCipher());
@@ -147,5 +176,28 @@ TEST_F(FizzCryptoFactoryTest, TestPacketEncryptionKey) {
   EXPECT_EQ(secretHex2, expectedKey2);
 }
 
+TEST_F(FizzCryptoFactoryTest, TestCipherSuitePreference) {
+  EXPECT_THAT(
+      getQuicCipherSuites(true),
+      ElementsAre(
+          fizz::CipherSuite::TLS_AES_128_GCM_SHA256,
+          fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256));
+  EXPECT_THAT(
+      getQuicCipherSuites(false),
+      ElementsAre(
+          fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+          fizz::CipherSuite::TLS_AES_128_GCM_SHA256));
+
+  FizzCryptoFactory cryptoFactory;
+  auto secret = std::vector<uint8_t>(32, 0x01);
+  EXPECT_EQ(
+      cryptoFactory
+          .makePacketNumberCipher(
+              fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+              folly::range(secret))
+          ->keyLength(),
+      32);
+}
+
 } // namespace test
 } // namespace quic
@@ -89,6 +89,36 @@ TEST_P(LongPacketNumberCipherTest, TestEncryptDecrypt) {
       GetParam().decryptedPacketNumberBytes);
 }
 
+TEST_P(LongPacketNumberCipherTest, TestBatchMask) {
+  FizzCryptoFactory cryptoFactory;
+  auto cipher = cryptoFactory.makePacketNumberCipher(GetParam().cipher);
+  auto key = folly::unhexlify(GetParam().key);
+  cipher->setKey(folly::range(key));
+  auto sample = hexToBytes<Sample>(GetParam().sample);
+  std::vector<Sample> samples;
+  for (uint8_t i = 0; i < 9; ++i) {
+    samples.push_back(sample);
+    samples.back()[0] ^= i;
+  }
+  std::vector<HeaderProtectionMask> masks(samples.size());
+  cipher->batchMask(folly::range(samples), masks.data());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    EXPECT_EQ(masks[i], cipher->mask(folly::range(samples[i])));
+  }
+
+  CipherBytes cipherBytes(
+      GetParam().sample,
+      GetParam().decryptedInitialByte,
+      GetParam().decryptedPacketNumberBytes);
+  cipher->encryptLongHeaderWithMask(
+      masks[0],
+      folly::range(cipherBytes.initial),
+      folly::range(cipherBytes.packetNumber));
+  EXPECT_EQ(folly::hexlify(cipherBytes.initial), GetParam().initialByte);
+  EXPECT_EQ(
+      folly::hexlify(cipherBytes.packetNumber), GetParam().packetNumberBytes);
+}
+
 INSTANTIATE_TEST_CASE_P(
     LongPacketNumberCipherTests,
     LongPacketNumberCipherTest,
@@ -124,7 +154,18 @@ INSTANTIATE_TEST_CASE_P(
             folly::StringPiece{"2e2fad01"},
             folly::StringPiece{"c8"},
             folly::StringPiece{"772aa701"},
-            folly::StringPiece{"ce"}}));
+            folly::StringPiece{"ce"}},
+        // The key and the sample of the ChaCha20-Poly1305 short header
+        // example of the QUIC-TLS draft, whose mask is aefefe7d03.
+        HeaderParams{
+            fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256,
+            folly::StringPiece{
+                "25a282b9e82f06f21f488917a4fc8f1b73573685608597d0efcb076b0ab7a7a4"},
+            folly::StringPiece{"5e5cd55c41f69080575d7999c25a5bfb"},
+            folly::StringPiece{"fefe7d01"},
+            folly::StringPiece{"cd"},
+            folly::StringPiece{"00000002"},
+            folly::StringPiece{"c3"}}));
 
 } // namespace test
 } // namespace quic
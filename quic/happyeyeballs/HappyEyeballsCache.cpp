@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/happyeyeballs/HappyEyeballsCache.h>
+
+#include <algorithm>
+
+namespace quic {
+
+HappyEyeballsCache::Decision HappyEyeballsCache::decide(TimePoint now) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  Decision decision;
+  bool v6Broken = isBroken(v6Stats_, now);
+  bool v4Broken = isBroken(v4Stats_, now);
+  if (v6Broken && !v4Broken) {
+    decision.preferredFamily = AF_INET;
+    decision.skipFamily = AF_INET6;
+    return decision;
+  }
+  if (v4Broken && !v6Broken) {
+    decision.preferredFamily = AF_INET6;
+    decision.skipFamily = AF_INET;
+    return decision;
+  }
+  const FamilyStats* preferred = nullptr;
+  if (v6Stats_.srtt && v4Stats_.srtt) {
+    preferred = *v4Stats_.srtt < *v6Stats_.srtt ? &v4Stats_ : &v6Stats_;
+  } else if (v6Stats_.srtt) {
+    preferred = &v6Stats_;
+  } else if (v4Stats_.srtt) {
+    preferred = &v4Stats_;
+  }
+  if (!preferred) {
+    return decision;
+  }
+  decision.preferredFamily = preferred == &v4Stats_ ? AF_INET : AF_INET6;
+  // Give the preferred family about as long as it usually takes to hear back
+  // from the peer before racing the other one.
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      *preferred->srtt + 4 * preferred->rttvar);
+  decision.connAttemptDelay = std::max(
+      kHappyEyeballsMinConnAttemptDelay,
+      std::min(delay, kHappyEyeballsMaxConnAttemptDelay));
+  return decision;
+}
+
+void HappyEyeballsCache::onFamilySucceeded(
+    sa_family_t family,
+    std::chrono::microseconds rtt) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto stats = getStats(family);
+  if (!stats) {
+    return;
+  }
+  stats->consecutiveLosses = 0;
+  if (!stats->srtt) {
+    stats->srtt = rtt;
+    stats->rttvar = rtt / 2;
+    return;
+  }
+  // Same smoothing as the rtt estimator of a connection.
+  auto delta = rtt > *stats->srtt ? rtt - *stats->srtt : *stats->srtt - rtt;
+  stats->rttvar = (3 * stats->rttvar + delta) / 4;
+  stats->srtt = (7 * *stats->srtt + rtt) / 8;
+}
+
+void HappyEyeballsCache::onFamilyLost(sa_family_t family, TimePoint now) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto stats = getStats(family);
+  if (!stats) {
+    return;
+  }
+  stats->consecutiveLosses++;
+  stats->lastLossTime = now;
+}
+
+HappyEyeballsCache::FamilyStats* HappyEyeballsCache::getStats(
+    sa_family_t family) {
+  switch (family) {
+    case AF_INET6:
+      return &v6Stats_;
+    case AF_INET:
+      return &v4Stats_;
+    default:
+      return nullptr;
+  }
+}
+
+bool HappyEyeballsCache::isBroken(const FamilyStats& stats, TimePoint now)
+    const {
+  // Give a broken family another chance once it hasn't lost for a while, in
+  // case the network was fixed.
+  return stats.consecutiveLosses >= kHappyEyeballsBrokenFamilyLosses &&
+      now - stats.lastLossTime < kHappyEyeballsBrokenFamilyExpiry;
+}
+} // namespace quic
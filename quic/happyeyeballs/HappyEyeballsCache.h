@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+#include <folly/net/NetOps.h>
+
+#include <chrono>
+#include <mutex>
+
+namespace quic {
+
+/**
+ * Remembers, for each address family, how long recent connections took to hear
+ * back from the peer and whether the family keeps losing the happy eyeballs
+ * race, so that the next connections can pick the family to start with, how
+ * long to wait before racing the other one, and whether to race it at all.
+ * Meant to be shared by all the clients of a process, from any thread.
+ */
+class HappyEyeballsCache {
+ public:
+  struct Decision {
+    // The family to try first, AF_UNSPEC if there is no preference.
+    sa_family_t preferredFamily{AF_UNSPEC};
+    // How long to wait before trying the other family, none if there is not
+    // enough history for the preferred family.
+    folly::Optional<std::chrono::milliseconds> connAttemptDelay;
+    // The family not to try at all because it keeps losing, AF_UNSPEC if both
+    // should be raced.
+    sa_family_t skipFamily{AF_UNSPEC};
+  };
+
+  Decision decide(TimePoint now = Clock::now()) const;
+
+  /**
+   * The family won the race, or was the only one tried, and the first packet
+   * from the peer came rtt after the family's first packet was sent.
+   */
+  void onFamilySucceeded(sa_family_t family, std::chrono::microseconds rtt);
+
+  /**
+   * The family was tried first but another one won the race.
+   */
+  void onFamilyLost(sa_family_t family, TimePoint now = Clock::now());
+
+ private:
+  struct FamilyStats {
+    folly::Optional<std::chrono::microseconds> srtt;
+    std::chrono::microseconds rttvar{0};
+    uint32_t consecutiveLosses{0};
+    TimePoint lastLossTime;
+  };
+
+  FamilyStats* getStats(sa_family_t family);
+  bool isBroken(const FamilyStats& stats, TimePoint now) const;
+
+  mutable std::mutex mutex_;
+  FamilyStats v6Stats_;
+  FamilyStats v4Stats_;
+};
+} // namespace quic
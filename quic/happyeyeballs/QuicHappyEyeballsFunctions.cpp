@@ -12,6 +12,7 @@
 #include <quic/state/StateData.h>
 
 #include <folly/SocketAddress.h>
+#include <folly/String.h>
 #include <folly/io/async/AsyncUDPSocket.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/HHWheelTimer.h>
@@ -57,6 +58,27 @@ void happyEyeballsAddSocket(
   connection.happyEyeballsState.secondSocket = std::move(socket);
 }
 
+void happyEyeballsSkipFamily(
+    QuicConnectionStateBase& connection,
+    sa_family_t family) {
+  auto& state = connection.happyEyeballsState;
+  if (!state.v6PeerAddress.isInitialized() ||
+      !state.v4PeerAddress.isInitialized()) {
+    return;
+  }
+  QUIC_TRACE(
+      happy_eyeballs, connection, "skip", family == AF_INET ? "v4" : "v6");
+  if (family == AF_INET) {
+    state.v4PeerAddress = folly::SocketAddress();
+  } else {
+    state.v6PeerAddress = folly::SocketAddress();
+  }
+  if (state.secondSocket) {
+    state.secondSocket->close();
+    state.secondSocket.reset();
+  }
+}
+
 void startHappyEyeballs(
     QuicConnectionStateBase& connection,
     folly::EventBase* evb,
@@ -65,6 +87,7 @@ void startHappyEyeballs(
     std::chrono::milliseconds connAttempDelay,
     folly::AsyncUDPSocket::ErrMessageCallback* errMsgCallback,
     folly::AsyncUDPSocket::ReadCallback* readCallback) {
+  connection.happyEyeballsState.firstSocketStartTime = Clock::now();
   if (connection.happyEyeballsState.v6PeerAddress.isInitialized() &&
       connection.happyEyeballsState.v4PeerAddress.isInitialized()) {
     // A second socket has to be added before happy eyeballs starts
@@ -133,8 +156,10 @@ void happyEyeballsSetUpSocket(
   } else {
     socket.dontFragment(true);
   }
-  if (transportSettings.connectUDP) {
-    socket.connect(peerAddress);
+  if (transportSettings.connectUDP && socket.connect(peerAddress) != 0) {
+    // The writes carry the peer address anyway.
+    VLOG(4) << "Failed to connect the socket to " << peerAddress << ": "
+            << folly::errnoStr(errno) << ", using it unconnected";
   }
   if (transportSettings.enableSocketErrMsgCallback) {
     socket.setErrMessageCallback(errMsgCallback);
@@ -147,6 +172,26 @@ void happyEyeballsStartSecondSocket(
   CHECK(!happyEyeballsState.finished);
 
   happyEyeballsState.shouldWriteToSecondSocket = true;
+  happyEyeballsState.secondSocketStartTime = Clock::now();
+}
+
+void happyEyeballsUpdateCache(
+    const QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress,
+    HappyEyeballsCache& cache,
+    TimePoint now) {
+  const auto& state = connection.happyEyeballsState;
+  auto family = peerAddress.getFamily();
+  bool secondWon = !state.finished && state.shouldWriteToSecondSocket &&
+      connection.peerAddress.getFamily() != family;
+  auto startTime =
+      secondWon ? state.secondSocketStartTime : state.firstSocketStartTime;
+  cache.onFamilySucceeded(
+      family,
+      std::chrono::duration_cast<std::chrono::microseconds>(now - startTime));
+  if (secondWon) {
+    cache.onFamilyLost(connection.peerAddress.getFamily(), now);
+  }
 }
 
 void happyEyeballsOnDataReceived(
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <quic/happyeyeballs/HappyEyeballsCache.h>
 #include <quic/state/StateData.h>
 
 #include <folly/io/async/AsyncUDPSocket.h>
@@ -32,6 +33,15 @@ void happyEyeballsAddSocket(
     QuicConnectionStateBase& connection,
     std::unique_ptr<folly::AsyncUDPSocket> socket);
 
+/**
+ * Drops the peer address of the family, and the second socket, when there is
+ * an address of the other family to connect to. Must be called before
+ * startHappyEyeballs().
+ */
+void happyEyeballsSkipFamily(
+    QuicConnectionStateBase& connection,
+    sa_family_t family);
+
 void startHappyEyeballs(
     QuicConnectionStateBase& connection,
     folly::EventBase* evb,
@@ -53,6 +63,18 @@ void happyEyeballsSetUpSocket(
 void happyEyeballsStartSecondSocket(
     QuicConnectionStateBase::HappyEyeballsState& happyEyeballsState);
 
+/**
+ * Tells the cache which family the first packet from the peer came on and how
+ * long after the family started, and whether the family tried first lost the
+ * race. Must be called on the first packet, before
+ * happyEyeballsOnDataReceived().
+ */
+void happyEyeballsUpdateCache(
+    const QuicConnectionStateBase& connection,
+    const folly::SocketAddress& peerAddress,
+    HappyEyeballsCache& cache,
+    TimePoint now = Clock::now());
+
 void happyEyeballsOnDataReceived(
     QuicConnectionStateBase& connection,
     folly::HHWheelTimer::Callback& connAttemptDelayTimeout,
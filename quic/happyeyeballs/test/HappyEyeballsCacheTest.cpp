@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/happyeyeballs/HappyEyeballsCache.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+TEST(HappyEyeballsCacheTest, NoHistory) {
+  HappyEyeballsCache cache;
+  auto decision = cache.decide();
+  EXPECT_EQ(decision.preferredFamily, AF_UNSPEC);
+  EXPECT_FALSE(decision.connAttemptDelay.hasValue());
+  EXPECT_EQ(decision.skipFamily, AF_UNSPEC);
+}
+
+TEST(HappyEyeballsCacheTest, PreferFasterFamily) {
+  HappyEyeballsCache cache;
+  cache.onFamilySucceeded(AF_INET6, 40ms);
+  auto decision = cache.decide();
+  EXPECT_EQ(decision.preferredFamily, AF_INET6);
+  // srtt + 4 * rttvar, with the first rttvar at half the rtt.
+  EXPECT_EQ(*decision.connAttemptDelay, 120ms);
+  EXPECT_EQ(decision.skipFamily, AF_UNSPEC);
+
+  cache.onFamilySucceeded(AF_INET, 20ms);
+  decision = cache.decide();
+  EXPECT_EQ(decision.preferredFamily, AF_INET);
+  EXPECT_EQ(*decision.connAttemptDelay, 60ms);
+}
+
+TEST(HappyEyeballsCacheTest, ClampDelay) {
+  HappyEyeballsCache cache;
+  cache.onFamilySucceeded(AF_INET6, 1ms);
+  EXPECT_EQ(
+      *cache.decide().connAttemptDelay, kHappyEyeballsMinConnAttemptDelay);
+
+  HappyEyeballsCache slowCache;
+  slowCache.onFamilySucceeded(AF_INET6, 5s);
+  EXPECT_EQ(
+      *slowCache.decide().connAttemptDelay, kHappyEyeballsMaxConnAttemptDelay);
+}
+
+TEST(HappyEyeballsCacheTest, SkipBrokenFamily) {
+  HappyEyeballsCache cache;
+  auto now = Clock::now();
+  for (uint32_t i = 0; i < kHappyEyeballsBrokenFamilyLosses; ++i) {
+    EXPECT_EQ(cache.decide(now).skipFamily, AF_UNSPEC);
+    cache.onFamilyLost(AF_INET6, now);
+    cache.onFamilySucceeded(AF_INET, 30ms);
+  }
+  auto decision = cache.decide(now);
+  EXPECT_EQ(decision.preferredFamily, AF_INET);
+  EXPECT_EQ(decision.skipFamily, AF_INET6);
+
+  // Raced again once the losses are old enough.
+  decision = cache.decide(now + kHappyEyeballsBrokenFamilyExpiry);
+  EXPECT_EQ(decision.preferredFamily, AF_INET);
+  EXPECT_EQ(decision.skipFamily, AF_UNSPEC);
+
+  // And trusted again once it wins.
+  cache.onFamilySucceeded(AF_INET6, 10ms);
+  decision = cache.decide(now);
+  EXPECT_EQ(decision.preferredFamily, AF_INET6);
+  EXPECT_EQ(decision.skipFamily, AF_UNSPEC);
+}
+
+TEST(HappyEyeballsCacheTest, BothFamiliesBroken) {
+  HappyEyeballsCache cache;
+  auto now = Clock::now();
+  for (uint32_t i = 0; i < kHappyEyeballsBrokenFamilyLosses; ++i) {
+    cache.onFamilyLost(AF_INET6, now);
+    cache.onFamilyLost(AF_INET, now);
+  }
+  // Nothing to fall back to, so both are raced.
+  EXPECT_EQ(cache.decide(now).skipFamily, AF_UNSPEC);
+}
+} // namespace test
+} // namespace quic
@@ -63,6 +63,19 @@ void addQuicSimpleFrameToEvent(
               frame.sequenceNumber));
       break;
     }
+    case quic::QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const quic::AckFrequencyFrame& frame = *simpleFrame.asAckFrequencyFrame();
+      event->frames.push_back(std::make_unique<quic::AckFrequencyFrameLog>(
+          frame.sequenceNumber,
+          frame.packetTolerance,
+          frame.updateMaxAckDelay,
+          frame.ignoreOrder));
+      break;
+    }
+    case quic::QuicSimpleFrame::Type::NewTokenFrame_E: {
+      event->frames.push_back(std::make_unique<quic::ReadNewTokenFrameLog>());
+      break;
+    }
   }
 }
 } // namespace
@@ -167,6 +180,12 @@ std::unique_ptr<QLogPacketEvent> BaseQLogger::createPacketEvent(
         event->frames.push_back(std::make_unique<ReadNewTokenFrameLog>());
         break;
       }
+      case QuicFrame::Type::ReadDatagramFrame_E: {
+        const auto& frame = *quicFrame.asReadDatagramFrame();
+        event->frames.push_back(std::make_unique<DatagramFrameLog>(
+            frame.data ? frame.data->computeChainDataLength() : 0));
+        break;
+      }
       case QuicFrame::Type::QuicSimpleFrame_E: {
         const auto& simpleFrame = *quicFrame.asQuicSimpleFrame();
         addQuicSimpleFrameToEvent(event.get(), simpleFrame);
@@ -275,6 +294,11 @@ std::unique_ptr<QLogPacketEvent> BaseQLogger::createPacketEvent(
             std::make_unique<CryptoFrameLog>(frame.offset, frame.len));
         break;
       }
+      case QuicWriteFrame::Type::WriteDatagramFrame_E: {
+        const WriteDatagramFrame& frame = *quicFrame.asWriteDatagramFrame();
+        event->frames.push_back(std::make_unique<DatagramFrameLog>(frame.len));
+        break;
+      }
       case QuicWriteFrame::Type::QuicSimpleFrame_E: {
         const QuicSimpleFrame& simpleFrame = *quicFrame.asQuicSimpleFrame();
         addQuicSimpleFrameToEvent(event.get(), simpleFrame);
@@ -307,4 +331,247 @@ std::unique_ptr<QLogVersionNegotiationEvent> BaseQLogger::createPacketEvent(
   return event;
 }
 
+void BaseQLogger::setEventTypes(const std::vector<QLogEventType>& eventTypes) {
+  if (eventTypes.empty()) {
+    eventTypeMask_ = ~uint32_t(0);
+    return;
+  }
+  eventTypeMask_ = 0;
+  for (auto eventType : eventTypes) {
+    eventTypeMask_ |= eventTypeBit(eventType);
+  }
+}
+
+void BaseQLogger::logEvent(std::unique_ptr<QLogEvent> event) {
+  if (isLogged(event->eventType)) {
+    handleEvent(std::move(event));
+  }
+}
+
+void BaseQLogger::addPacket(
+    const RegularQuicPacket& regularPacket,
+    uint64_t packetSize) {
+  logEvent(createPacketEvent(regularPacket, packetSize));
+}
+
+void BaseQLogger::addPacket(
+    const RegularQuicWritePacket& writePacket,
+    uint64_t packetSize) {
+  logEvent(createPacketEvent(writePacket, packetSize));
+}
+
+void BaseQLogger::addPacket(
+    const VersionNegotiationPacket& versionPacket,
+    uint64_t packetSize,
+    bool isPacketRecvd) {
+  logEvent(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
+}
+
+void BaseQLogger::addConnectionClose(
+    std::string error,
+    std::string reason,
+    bool drainConnection,
+    bool sendCloseImmediately) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+  logEvent(std::make_unique<quic::QLogConnectionCloseEvent>(
+      std::move(error),
+      std::move(reason),
+      drainConnection,
+      sendCloseImmediately,
+      refTime));
+}
+
+void BaseQLogger::addTransportSummary(
+    uint64_t totalBytesSent,
+    uint64_t totalBytesRecvd,
+    uint64_t sumCurWriteOffset,
+    uint64_t sumMaxObservedOffset,
+    uint64_t sumCurStreamBufferLen,
+    uint64_t totalBytesRetransmitted,
+    uint64_t totalStreamBytesCloned,
+    uint64_t totalBytesCloned,
+    uint64_t totalCryptoDataWritten,
+    uint64_t totalCryptoDataRecvd) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogTransportSummaryEvent>(
+      totalBytesSent,
+      totalBytesRecvd,
+      sumCurWriteOffset,
+      sumMaxObservedOffset,
+      sumCurStreamBufferLen,
+      totalBytesRetransmitted,
+      totalStreamBytesCloned,
+      totalBytesCloned,
+      totalCryptoDataWritten,
+      totalCryptoDataRecvd,
+      refTime));
+}
+
+void BaseQLogger::addCongestionMetricUpdate(
+    uint64_t bytesInFlight,
+    uint64_t currentCwnd,
+    std::string congestionEvent,
+    std::string state,
+    std::string recoveryState) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
+      bytesInFlight,
+      currentCwnd,
+      std::move(congestionEvent),
+      std::move(state),
+      std::move(recoveryState),
+      refTime));
+}
+
+void BaseQLogger::addBandwidthEstUpdate(
+    uint64_t bytes,
+    std::chrono::microseconds interval) {
+  logEvent(std::make_unique<quic::QLogBandwidthEstUpdateEvent>(
+      bytes,
+      interval,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - refTimePoint)));
+}
+
+void BaseQLogger::addAppLimitedUpdate() {
+  logEvent(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
+      true,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - refTimePoint)));
+}
+
+void BaseQLogger::addAppUnlimitedUpdate() {
+  logEvent(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
+      false,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - refTimePoint)));
+}
+void BaseQLogger::addPacingMetricUpdate(
+    uint64_t pacingBurstSizeIn,
+    std::chrono::microseconds pacingIntervalIn) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
+      pacingBurstSizeIn, pacingIntervalIn, refTime));
+}
+
+void BaseQLogger::addPacingObservation(
+    std::string actual,
+    std::string expect,
+    std::string conclusion) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+  logEvent(std::make_unique<quic::QLogPacingObservationEvent>(
+      std::move(actual), std::move(expect), std::move(conclusion), refTime));
+}
+
+void BaseQLogger::addAppIdleUpdate(std::string idleEvent, bool idle) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogAppIdleUpdateEvent>(
+      std::move(idleEvent), idle, refTime));
+}
+
+void BaseQLogger::addPacketDrop(size_t packetSize, std::string dropReason) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogPacketDropEvent>(
+      packetSize, std::move(dropReason), refTime));
+}
+
+void BaseQLogger::addDatagramReceived(uint64_t dataLen) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(
+      std::make_unique<quic::QLogDatagramReceivedEvent>(dataLen, refTime));
+}
+
+void BaseQLogger::addLossAlarm(
+    PacketNum largestSent,
+    uint64_t alarmCount,
+    uint64_t outstandingPackets,
+    std::string type) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogLossAlarmEvent>(
+      largestSent, alarmCount, outstandingPackets, std::move(type), refTime));
+}
+
+void BaseQLogger::addPacketsLost(
+    PacketNum largestLostPacketNum,
+    uint64_t lostBytes,
+    uint64_t lostPackets) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogPacketsLostEvent>(
+      largestLostPacketNum, lostBytes, lostPackets, refTime));
+}
+
+void BaseQLogger::addTransportStateUpdate(std::string update) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogTransportStateUpdateEvent>(
+      std::move(update), refTime));
+}
+
+void BaseQLogger::addPacketBuffered(
+    PacketNum packetNum,
+    ProtectionType protectionType,
+    uint64_t packetSize) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogPacketBufferedEvent>(
+      packetNum, protectionType, packetSize, refTime));
+}
+
+void BaseQLogger::addPacketAck(
+    PacketNumberSpace packetNumSpace,
+    PacketNum packetNum) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogPacketAckEvent>(
+      packetNumSpace, packetNum, refTime));
+}
+
+void BaseQLogger::addMetricUpdate(
+    std::chrono::microseconds latestRtt,
+    std::chrono::microseconds mrtt,
+    std::chrono::microseconds srtt,
+    std::chrono::microseconds ackDelay) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogMetricUpdateEvent>(
+      latestRtt, mrtt, srtt, ackDelay, refTime));
+}
+
+void BaseQLogger::addStreamStateUpdate(
+    quic::StreamId id,
+    std::string update,
+    folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation) {
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+
+  logEvent(std::make_unique<quic::QLogStreamStateUpdateEvent>(
+      id,
+      std::move(update),
+      std::move(timeSinceStreamCreation),
+      vantagePoint,
+      refTime));
+}
+
 } // namespace quic
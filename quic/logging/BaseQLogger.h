@@ -21,7 +21,96 @@ class BaseQLogger : public QLogger {
 
   ~BaseQLogger() override = default;
 
+  /**
+   * Only log events of these types, or all of them if eventTypes is empty.
+   */
+  void setEventTypes(const std::vector<QLogEventType>& eventTypes);
+
+  void addPacket(const RegularQuicPacket& regularPacket, uint64_t packetSize)
+      override;
+  void addPacket(
+      const VersionNegotiationPacket& versionPacket,
+      uint64_t packetSize,
+      bool isPacketRecvd) override;
+  void addPacket(const RegularQuicWritePacket& writePacket, uint64_t packetSize)
+      override;
+  void addConnectionClose(
+      std::string error,
+      std::string reason,
+      bool drainConnection,
+      bool sendCloseImmediately) override;
+  void addTransportSummary(
+      uint64_t totalBytesSent,
+      uint64_t totalBytesRecvd,
+      uint64_t sumCurWriteOffset,
+      uint64_t sumMaxObservedOffset,
+      uint64_t sumCurStreamBufferLen,
+      uint64_t totalBytesRetransmitted,
+      uint64_t totalStreamBytesCloned,
+      uint64_t totalBytesCloned,
+      uint64_t totalCryptoDataWritten,
+      uint64_t totalCryptoDataRecvd) override;
+  void addCongestionMetricUpdate(
+      uint64_t bytesInFlight,
+      uint64_t currentCwnd,
+      std::string congestionEvent,
+      std::string state = "",
+      std::string recoveryState = "") override;
+  void addPacingMetricUpdate(
+      uint64_t pacingBurstSizeIn,
+      std::chrono::microseconds pacingIntervalIn) override;
+  void addPacingObservation(
+      std::string actual,
+      std::string expected,
+      std::string conclusion) override;
+  void addBandwidthEstUpdate(uint64_t bytes, std::chrono::microseconds interval)
+      override;
+  void addAppLimitedUpdate() override;
+  void addAppUnlimitedUpdate() override;
+  void addAppIdleUpdate(std::string idleEvent, bool idle) override;
+  void addPacketDrop(size_t packetSize, std::string dropReasonIn) override;
+  void addDatagramReceived(uint64_t dataLen) override;
+  void addLossAlarm(
+      PacketNum largestSent,
+      uint64_t alarmCount,
+      uint64_t outstandingPackets,
+      std::string type) override;
+  void addPacketsLost(
+      PacketNum largestLostPacketNum,
+      uint64_t lostBytes,
+      uint64_t lostPackets) override;
+  void addTransportStateUpdate(std::string update) override;
+  void addPacketBuffered(
+      PacketNum packetNum,
+      ProtectionType protectionType,
+      uint64_t packetSize) override;
+  void addPacketAck(PacketNumberSpace packetNumSpace, PacketNum packetNum)
+      override;
+  void addMetricUpdate(
+      std::chrono::microseconds latestRtt,
+      std::chrono::microseconds mrtt,
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds ackDelay) override;
+  void addStreamStateUpdate(
+      StreamId id,
+      std::string update,
+      folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation)
+      override;
+
  protected:
+  /**
+   * Called with every event whose type is logged, in order. Subclasses decide
+   * whether to keep, serialize or drop it.
+   */
+  virtual void handleEvent(std::unique_ptr<QLogEvent> event) = 0;
+
+  // Passes the event to handleEvent() if its type is logged.
+  void logEvent(std::unique_ptr<QLogEvent> event);
+
+  bool isLogged(QLogEventType eventType) const {
+    return eventTypeMask_ & eventTypeBit(eventType);
+  }
+
   std::unique_ptr<QLogPacketEvent> createPacketEvent(
       const RegularQuicPacket& regularPacket,
       uint64_t packetSize);
@@ -34,5 +123,12 @@ class BaseQLogger : public QLogger {
       const VersionNegotiationPacket& versionPacket,
       uint64_t packetSize,
       bool isPacketRecvd);
+
+ private:
+  static uint32_t eventTypeBit(QLogEventType eventType) {
+    return uint32_t(1) << static_cast<uint32_t>(eventType);
+  }
+
+  uint32_t eventTypeMask_{~uint32_t(0)};
 };
 } // namespace quic
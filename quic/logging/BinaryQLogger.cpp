@@ -0,0 +1,1226 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/BinaryQLogger.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+
+namespace quic {
+
+namespace {
+constexpr folly::StringPiece kBinaryQLogMagic = "MVFSTQLB";
+constexpr uint8_t kBinaryQLogFormatVersion = 1;
+
+// The values are the encoding, only ever append to these.
+enum class Record : uint8_t {
+  PacketReceived,
+  PacketSent,
+  VersionNegotiationReceived,
+  VersionNegotiationSent,
+  ConnectionClose,
+  TransportSummary,
+  CongestionMetricUpdate,
+  PacingMetricUpdate,
+  PacingObservation,
+  BandwidthEstUpdate,
+  AppLimitedUpdate,
+  AppUnlimitedUpdate,
+  AppIdleUpdate,
+  PacketDrop,
+  DatagramReceived,
+  LossAlarm,
+  PacketsLost,
+  TransportStateUpdate,
+  PacketBuffered,
+  PacketAck,
+  MetricUpdate,
+  StreamStateUpdate,
+};
+
+enum class FrameRecord : uint8_t {
+  // Ends the frames of a packet.
+  End,
+  Padding,
+  RstStream,
+  ConnectionClose,
+  ApplicationClose,
+  MaxData,
+  MaxStreamData,
+  MaxStreams,
+  StreamsBlocked,
+  Ping,
+  DataBlocked,
+  StreamDataBlocked,
+  Ack,
+  Stream,
+  Crypto,
+  StopSending,
+  MinStreamData,
+  ExpiredStreamData,
+  PathChallenge,
+  PathResponse,
+  NewConnectionId,
+  RetireConnectionId,
+  AckFrequency,
+  Datagram,
+  NewToken,
+};
+
+constexpr uint8_t toByte(Record record) {
+  return static_cast<uint8_t>(record);
+}
+
+constexpr uint8_t toByte(FrameRecord record) {
+  return static_cast<uint8_t>(record);
+}
+
+// 0 for a short header, the long header type plus one otherwise.
+uint8_t packetTypeByte(const PacketHeader& header) {
+  const LongHeader* longHeader = header.asLong();
+  return longHeader ? static_cast<uint8_t>(longHeader->getHeaderType()) + 1
+                    : 0;
+}
+
+class BinaryQLogReader {
+ public:
+  explicit BinaryQLogReader(folly::ByteRange data) : data_(data) {}
+
+  bool empty() const {
+    return data_.empty();
+  }
+
+  uint8_t readByte() {
+    need(1);
+    uint8_t value = data_[0];
+    data_.advance(1);
+    return value;
+  }
+
+  bool readBool() {
+    return readByte() != 0;
+  }
+
+  uint64_t readVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = readByte();
+      value |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw std::invalid_argument("Malformed varint in binary qlog");
+  }
+
+  std::chrono::microseconds readMicros() {
+    return std::chrono::microseconds(static_cast<int64_t>(readVarint()));
+  }
+
+  folly::ByteRange readBytes(uint64_t len) {
+    need(len);
+    auto bytes = data_.subpiece(0, len);
+    data_.advance(len);
+    return bytes;
+  }
+
+  std::string readRawString() {
+    auto bytes = readBytes(readVarint());
+    return std::string(bytes.begin(), bytes.end());
+  }
+
+  std::string readInternedString() {
+    uint64_t value = readVarint();
+    uint64_t index = value >> 1;
+    if (value & 1) {
+      if (index != strings_.size()) {
+        throw std::invalid_argument("Out of order string in binary qlog");
+      }
+      strings_.push_back(readRawString());
+    }
+    if (index >= strings_.size()) {
+      throw std::invalid_argument("Unknown string in binary qlog");
+    }
+    return strings_[index];
+  }
+
+  folly::Optional<ConnectionId> readConnectionId() {
+    uint64_t len = readVarint();
+    if (len == 0) {
+      return folly::none;
+    }
+    if (len - 1 > kMaxConnectionIdSize) {
+      throw std::invalid_argument("Connection id too long in binary qlog");
+    }
+    auto bytes = readBytes(len - 1);
+    return ConnectionId::createWithoutChecks(
+        std::vector<uint8_t>(bytes.begin(), bytes.end()));
+  }
+
+ private:
+  void need(uint64_t len) const {
+    if (data_.size() < len) {
+      throw std::invalid_argument("Truncated binary qlog");
+    }
+  }
+
+  folly::ByteRange data_;
+  std::vector<std::string> strings_;
+};
+
+std::unique_ptr<QLogFrame> readFrame(
+    BinaryQLogReader& reader,
+    FrameRecord record) {
+  switch (record) {
+    case FrameRecord::Padding:
+      return std::make_unique<PaddingFrameLog>(reader.readVarint());
+    case FrameRecord::RstStream: {
+      auto streamId = reader.readVarint();
+      auto errorCode = static_cast<ApplicationErrorCode>(reader.readVarint());
+      auto offset = reader.readVarint();
+      return std::make_unique<RstStreamFrameLog>(streamId, errorCode, offset);
+    }
+    case FrameRecord::ConnectionClose: {
+      auto errorCode = static_cast<TransportErrorCode>(reader.readVarint());
+      auto reasonPhrase = reader.readRawString();
+      auto closingFrameType = static_cast<FrameType>(reader.readVarint());
+      return std::make_unique<ConnectionCloseFrameLog>(
+          errorCode, std::move(reasonPhrase), closingFrameType);
+    }
+    case FrameRecord::ApplicationClose: {
+      auto errorCode = static_cast<ApplicationErrorCode>(reader.readVarint());
+      return std::make_unique<ApplicationCloseFrameLog>(
+          errorCode, reader.readRawString());
+    }
+    case FrameRecord::MaxData:
+      return std::make_unique<MaxDataFrameLog>(reader.readVarint());
+    case FrameRecord::MaxStreamData: {
+      auto streamId = reader.readVarint();
+      return std::make_unique<MaxStreamDataFrameLog>(
+          streamId, reader.readVarint());
+    }
+    case FrameRecord::MaxStreams: {
+      auto maxStreams = reader.readVarint();
+      return std::make_unique<MaxStreamsFrameLog>(
+          maxStreams, reader.readBool());
+    }
+    case FrameRecord::StreamsBlocked: {
+      auto streamLimit = reader.readVarint();
+      return std::make_unique<StreamsBlockedFrameLog>(
+          streamLimit, reader.readBool());
+    }
+    case FrameRecord::Ping:
+      return std::make_unique<PingFrameLog>();
+    case FrameRecord::DataBlocked:
+      return std::make_unique<DataBlockedFrameLog>(reader.readVarint());
+    case FrameRecord::StreamDataBlocked: {
+      auto streamId = reader.readVarint();
+      return std::make_unique<StreamDataBlockedFrameLog>(
+          streamId, reader.readVarint());
+    }
+    case FrameRecord::Ack: {
+      std::vector<AckBlock> ackBlocks;
+      auto numBlocks = reader.readVarint();
+      for (uint64_t i = 0; i < numBlocks; ++i) {
+        auto start = reader.readVarint();
+        auto end = reader.readVarint();
+        ackBlocks.emplace_back(start, end);
+      }
+      return std::make_unique<ReadAckFrameLog>(
+          ackBlocks, reader.readMicros());
+    }
+    case FrameRecord::Stream: {
+      auto streamId = reader.readVarint();
+      auto offset = reader.readVarint();
+      auto len = reader.readVarint();
+      return std::make_unique<StreamFrameLog>(
+          streamId, offset, len, reader.readBool());
+    }
+    case FrameRecord::Crypto: {
+      auto offset = reader.readVarint();
+      return std::make_unique<CryptoFrameLog>(offset, reader.readVarint());
+    }
+    case FrameRecord::StopSending: {
+      auto streamId = reader.readVarint();
+      return std::make_unique<StopSendingFrameLog>(
+          streamId, static_cast<ApplicationErrorCode>(reader.readVarint()));
+    }
+    case FrameRecord::MinStreamData: {
+      auto streamId = reader.readVarint();
+      auto maximumData = reader.readVarint();
+      return std::make_unique<MinStreamDataFrameLog>(
+          streamId, maximumData, reader.readVarint());
+    }
+    case FrameRecord::ExpiredStreamData: {
+      auto streamId = reader.readVarint();
+      return std::make_unique<ExpiredStreamDataFrameLog>(
+          streamId, reader.readVarint());
+    }
+    case FrameRecord::PathChallenge:
+      return std::make_unique<PathChallengeFrameLog>(reader.readVarint());
+    case FrameRecord::PathResponse:
+      return std::make_unique<PathResponseFrameLog>(reader.readVarint());
+    case FrameRecord::NewConnectionId: {
+      auto sequence = static_cast<uint16_t>(reader.readVarint());
+      StatelessResetToken token;
+      auto tokenBytes = reader.readBytes(token.size());
+      std::copy(tokenBytes.begin(), tokenBytes.end(), token.begin());
+      return std::make_unique<NewConnectionIdFrameLog>(sequence, token);
+    }
+    case FrameRecord::RetireConnectionId:
+      return std::make_unique<RetireConnectionIdFrameLog>(reader.readVarint());
+    case FrameRecord::AckFrequency: {
+      auto sequenceNumber = reader.readVarint();
+      auto packetTolerance = reader.readVarint();
+      auto updateMaxAckDelay = reader.readMicros();
+      return std::make_unique<AckFrequencyFrameLog>(
+          sequenceNumber,
+          packetTolerance,
+          updateMaxAckDelay,
+          reader.readBool());
+    }
+    case FrameRecord::Datagram:
+      return std::make_unique<DatagramFrameLog>(reader.readVarint());
+    case FrameRecord::NewToken:
+      return std::make_unique<ReadNewTokenFrameLog>();
+    case FrameRecord::End:
+      break;
+  }
+  throw std::invalid_argument(folly::to<std::string>(
+      "Unknown frame record in binary qlog: ", toByte(record)));
+}
+
+std::unique_ptr<QLogPacketEvent> readPacketEvent(
+    BinaryQLogReader& reader,
+    QLogEventType eventType) {
+  auto event = std::make_unique<QLogPacketEvent>();
+  event->eventType = eventType;
+  uint8_t packetType = reader.readByte();
+  if (packetType == 0) {
+    event->packetType = kShortHeaderPacketType.toString();
+  } else if (packetType - 1 <= static_cast<uint8_t>(LongHeader::Types::Retry)) {
+    event->packetType =
+        toString(static_cast<LongHeader::Types>(packetType - 1));
+  } else {
+    throw std::invalid_argument("Unknown packet type in binary qlog");
+  }
+  event->packetNum = reader.readVarint();
+  event->packetSize = reader.readVarint();
+  for (auto record = static_cast<FrameRecord>(reader.readByte());
+       record != FrameRecord::End;
+       record = static_cast<FrameRecord>(reader.readByte())) {
+    event->frames.push_back(readFrame(reader, record));
+  }
+  return event;
+}
+
+std::unique_ptr<QLogEvent> readEvent(
+    BinaryQLogReader& reader,
+    Record record,
+    VantagePoint vantagePoint,
+    std::chrono::microseconds refTime) {
+  switch (record) {
+    case Record::PacketReceived:
+      return readPacketEvent(reader, QLogEventType::PacketReceived);
+    case Record::PacketSent:
+      return readPacketEvent(reader, QLogEventType::PacketSent);
+    case Record::VersionNegotiationReceived:
+    case Record::VersionNegotiationSent: {
+      auto event = std::make_unique<QLogVersionNegotiationEvent>();
+      event->eventType = record == Record::VersionNegotiationReceived
+          ? QLogEventType::PacketReceived
+          : QLogEventType::PacketSent;
+      event->packetType = kVersionNegotiationPacketType;
+      event->packetSize = reader.readVarint();
+      std::vector<QuicVersion> versions;
+      auto numVersions = reader.readVarint();
+      for (uint64_t i = 0; i < numVersions; ++i) {
+        versions.push_back(static_cast<QuicVersion>(reader.readVarint()));
+      }
+      event->versionLog = std::make_unique<VersionNegotiationLog>(versions);
+      return std::move(event);
+    }
+    case Record::ConnectionClose: {
+      auto error = reader.readRawString();
+      auto reason = reader.readRawString();
+      auto drainConnection = reader.readBool();
+      auto sendCloseImmediately = reader.readBool();
+      return std::make_unique<QLogConnectionCloseEvent>(
+          std::move(error),
+          std::move(reason),
+          drainConnection,
+          sendCloseImmediately,
+          refTime);
+    }
+    case Record::TransportSummary: {
+      uint64_t values[10];
+      for (auto& value : values) {
+        value = reader.readVarint();
+      }
+      return std::make_unique<QLogTransportSummaryEvent>(
+          values[0],
+          values[1],
+          values[2],
+          values[3],
+          values[4],
+          values[5],
+          values[6],
+          values[7],
+          values[8],
+          values[9],
+          refTime);
+    }
+    case Record::CongestionMetricUpdate: {
+      auto bytesInFlight = reader.readVarint();
+      auto currentCwnd = reader.readVarint();
+      auto congestionEvent = reader.readInternedString();
+      auto state = reader.readInternedString();
+      auto recoveryState = reader.readInternedString();
+      return std::make_unique<QLogCongestionMetricUpdateEvent>(
+          bytesInFlight,
+          currentCwnd,
+          std::move(congestionEvent),
+          std::move(state),
+          std::move(recoveryState),
+          refTime);
+    }
+    case Record::PacingMetricUpdate: {
+      auto pacingBurstSize = reader.readVarint();
+      return std::make_unique<QLogPacingMetricUpdateEvent>(
+          pacingBurstSize, reader.readMicros(), refTime);
+    }
+    case Record::PacingObservation: {
+      auto actual = reader.readRawString();
+      auto expected = reader.readRawString();
+      auto conclusion = reader.readRawString();
+      return std::make_unique<QLogPacingObservationEvent>(
+          std::move(actual),
+          std::move(expected),
+          std::move(conclusion),
+          refTime);
+    }
+    case Record::BandwidthEstUpdate: {
+      auto bytes = reader.readVarint();
+      return std::make_unique<QLogBandwidthEstUpdateEvent>(
+          bytes, reader.readMicros(), refTime);
+    }
+    case Record::AppLimitedUpdate:
+      return std::make_unique<QLogAppLimitedUpdateEvent>(true, refTime);
+    case Record::AppUnlimitedUpdate:
+      return std::make_unique<QLogAppLimitedUpdateEvent>(false, refTime);
+    case Record::AppIdleUpdate: {
+      auto idleEvent = reader.readInternedString();
+      return std::make_unique<QLogAppIdleUpdateEvent>(
+          std::move(idleEvent), reader.readBool(), refTime);
+    }
+    case Record::PacketDrop: {
+      auto packetSize = reader.readVarint();
+      return std::make_unique<QLogPacketDropEvent>(
+          packetSize, reader.readInternedString(), refTime);
+    }
+    case Record::DatagramReceived:
+      return std::make_unique<QLogDatagramReceivedEvent>(
+          reader.readVarint(), refTime);
+    case Record::LossAlarm: {
+      auto largestSent = reader.readVarint();
+      auto alarmCount = reader.readVarint();
+      auto outstandingPackets = reader.readVarint();
+      return std::make_unique<QLogLossAlarmEvent>(
+          largestSent,
+          alarmCount,
+          outstandingPackets,
+          reader.readInternedString(),
+          refTime);
+    }
+    case Record::PacketsLost: {
+      auto largestLostPacketNum = reader.readVarint();
+      auto lostBytes = reader.readVarint();
+      auto lostPackets = reader.readVarint();
+      return std::make_unique<QLogPacketsLostEvent>(
+          largestLostPacketNum, lostBytes, lostPackets, refTime);
+    }
+    case Record::TransportStateUpdate:
+      return std::make_unique<QLogTransportStateUpdateEvent>(
+          reader.readInternedString(), refTime);
+    case Record::PacketBuffered: {
+      auto packetNum = reader.readVarint();
+      auto protectionType = static_cast<ProtectionType>(reader.readByte());
+      return std::make_unique<QLogPacketBufferedEvent>(
+          packetNum, protectionType, reader.readVarint(), refTime);
+    }
+    case Record::PacketAck: {
+      auto packetNumSpace = static_cast<PacketNumberSpace>(reader.readByte());
+      return std::make_unique<QLogPacketAckEvent>(
+          packetNumSpace, reader.readVarint(), refTime);
+    }
+    case Record::MetricUpdate: {
+      auto latestRtt = reader.readMicros();
+      auto mrtt = reader.readMicros();
+      auto srtt = reader.readMicros();
+      return std::make_unique<QLogMetricUpdateEvent>(
+          latestRtt, mrtt, srtt, reader.readMicros(), refTime);
+    }
+    case Record::StreamStateUpdate: {
+      auto id = reader.readVarint();
+      auto update = reader.readInternedString();
+      folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation;
+      if (reader.readBool()) {
+        timeSinceStreamCreation = std::chrono::milliseconds(
+            static_cast<int64_t>(reader.readVarint()));
+      }
+      return std::make_unique<QLogStreamStateUpdateEvent>(
+          id,
+          std::move(update),
+          std::move(timeSinceStreamCreation),
+          vantagePoint,
+          refTime);
+    }
+  }
+  throw std::invalid_argument(folly::to<std::string>(
+      "Unknown record in binary qlog: ", toByte(record)));
+}
+} // namespace
+
+BinaryQLogger::BinaryQLogger(
+    VantagePoint vantagePointIn,
+    std::string protocolTypeIn,
+    size_t initialBytes,
+    size_t maxBytes)
+    : BaseQLogger(vantagePointIn, std::move(protocolTypeIn)),
+      maxBytes_(maxBytes) {
+  buf_.reserve(std::min(initialBytes, maxBytes));
+}
+
+bool BinaryQLogger::beginEvent(QLogEventType eventType, uint8_t record) {
+  if (!isLogged(eventType)) {
+    return false;
+  }
+  if (full_) {
+    ++numDroppedEvents_;
+    return false;
+  }
+  eventStart_ = buf_.size();
+  eventStartRefTime_ = lastRefTime_;
+  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - refTimePoint);
+  // The times are written as the delta from the previous event.
+  refTime = std::max(refTime, lastRefTime_);
+  writeByte(record);
+  writeVarint((refTime - lastRefTime_).count());
+  lastRefTime_ = refTime;
+  return true;
+}
+
+void BinaryQLogger::endEvent() {
+  if (buf_.size() > maxBytes_) {
+    // Nothing is written after the first event that doesn't fit, so the
+    // strings it interned don't need to be forgotten.
+    buf_.resize(eventStart_);
+    lastRefTime_ = eventStartRefTime_;
+    full_ = true;
+    ++numDroppedEvents_;
+    return;
+  }
+  ++numEvents_;
+}
+
+void BinaryQLogger::writeVarint(uint64_t value) {
+  while (value >= 0x80) {
+    buf_.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  buf_.push_back(static_cast<uint8_t>(value));
+}
+
+void BinaryQLogger::writeBytes(folly::ByteRange bytes) {
+  buf_.insert(buf_.end(), bytes.begin(), bytes.end());
+}
+
+void BinaryQLogger::writeRawString(folly::StringPiece str) {
+  writeVarint(str.size());
+  writeBytes(folly::ByteRange(str));
+}
+
+void BinaryQLogger::writeInternedString(const std::string& str) {
+  // The index shifted left by one, with the low bit set when the string is
+  // new and follows.
+  auto it = strings_.find(str);
+  if (it != strings_.end()) {
+    writeVarint(uint64_t(it->second) << 1);
+    return;
+  }
+  uint32_t index = strings_.size();
+  strings_.emplace(str, index);
+  writeVarint((uint64_t(index) << 1) | 1);
+  writeRawString(str);
+}
+
+void BinaryQLogger::writeSimpleFrame(const QuicSimpleFrame& simpleFrame) {
+  switch (simpleFrame.type()) {
+    case QuicSimpleFrame::Type::PingFrame_E: {
+      writeByte(toByte(FrameRecord::Ping));
+      break;
+    }
+    case QuicSimpleFrame::Type::StopSendingFrame_E: {
+      const StopSendingFrame& frame = *simpleFrame.asStopSendingFrame();
+      writeByte(toByte(FrameRecord::StopSending));
+      writeVarint(frame.streamId);
+      writeVarint(frame.errorCode);
+      break;
+    }
+    case QuicSimpleFrame::Type::MinStreamDataFrame_E: {
+      const MinStreamDataFrame& frame = *simpleFrame.asMinStreamDataFrame();
+      writeByte(toByte(FrameRecord::MinStreamData));
+      writeVarint(frame.streamId);
+      writeVarint(frame.maximumData);
+      writeVarint(frame.minimumStreamOffset);
+      break;
+    }
+    case QuicSimpleFrame::Type::ExpiredStreamDataFrame_E: {
+      const ExpiredStreamDataFrame& frame =
+          *simpleFrame.asExpiredStreamDataFrame();
+      writeByte(toByte(FrameRecord::ExpiredStreamData));
+      writeVarint(frame.streamId);
+      writeVarint(frame.minimumStreamOffset);
+      break;
+    }
+    case QuicSimpleFrame::Type::PathChallengeFrame_E: {
+      writeByte(toByte(FrameRecord::PathChallenge));
+      writeVarint(simpleFrame.asPathChallengeFrame()->pathData);
+      break;
+    }
+    case QuicSimpleFrame::Type::PathResponseFrame_E: {
+      writeByte(toByte(FrameRecord::PathResponse));
+      writeVarint(simpleFrame.asPathResponseFrame()->pathData);
+      break;
+    }
+    case QuicSimpleFrame::Type::NewConnectionIdFrame_E: {
+      const NewConnectionIdFrame& frame = *simpleFrame.asNewConnectionIdFrame();
+      writeByte(toByte(FrameRecord::NewConnectionId));
+      writeVarint(frame.sequenceNumber);
+      writeBytes(folly::ByteRange(frame.token.data(), frame.token.size()));
+      break;
+    }
+    case QuicSimpleFrame::Type::MaxStreamsFrame_E: {
+      const MaxStreamsFrame& frame = *simpleFrame.asMaxStreamsFrame();
+      writeByte(toByte(FrameRecord::MaxStreams));
+      writeVarint(frame.maxStreams);
+      writeByte(frame.isForBidirectional);
+      break;
+    }
+    case QuicSimpleFrame::Type::RetireConnectionIdFrame_E: {
+      writeByte(toByte(FrameRecord::RetireConnectionId));
+      writeVarint(simpleFrame.asRetireConnectionIdFrame()->sequenceNumber);
+      break;
+    }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& frame = *simpleFrame.asAckFrequencyFrame();
+      writeByte(toByte(FrameRecord::AckFrequency));
+      writeVarint(frame.sequenceNumber);
+      writeVarint(frame.packetTolerance);
+      writeVarint(frame.updateMaxAckDelay.count());
+      writeByte(frame.ignoreOrder);
+      break;
+    }
+    case QuicSimpleFrame::Type::NewTokenFrame_E: {
+      writeByte(toByte(FrameRecord::NewToken));
+      break;
+    }
+  }
+}
+
+void BinaryQLogger::addPacket(
+    const RegularQuicPacket& regularPacket,
+    uint64_t packetSize) {
+  if (!beginEvent(
+          QLogEventType::PacketReceived, toByte(Record::PacketReceived))) {
+    return;
+  }
+  auto packetType = packetTypeByte(regularPacket.header);
+  writeByte(packetType);
+  // A Retry packet does not include a packet number.
+  bool isRetry =
+      packetType == static_cast<uint8_t>(LongHeader::Types::Retry) + 1;
+  writeVarint(isRetry ? 0 : regularPacket.header.getPacketSequenceNum());
+  writeVarint(packetSize);
+
+  uint64_t numPaddingFrames = 0;
+  for (const auto& quicFrame : regularPacket.frames) {
+    switch (quicFrame.type()) {
+      case QuicFrame::Type::PaddingFrame_E: {
+        ++numPaddingFrames;
+        break;
+      }
+      case QuicFrame::Type::RstStreamFrame_E: {
+        const auto& frame = *quicFrame.asRstStreamFrame();
+        writeByte(toByte(FrameRecord::RstStream));
+        writeVarint(frame.streamId);
+        writeVarint(frame.errorCode);
+        writeVarint(frame.offset);
+        break;
+      }
+      case QuicFrame::Type::ConnectionCloseFrame_E: {
+        const auto& frame = *quicFrame.asConnectionCloseFrame();
+        writeByte(toByte(FrameRecord::ConnectionClose));
+        writeVarint(static_cast<uint64_t>(frame.errorCode));
+        writeRawString(frame.reasonPhrase);
+        writeVarint(static_cast<uint64_t>(frame.closingFrameType));
+        break;
+      }
+      case QuicFrame::Type::ApplicationCloseFrame_E: {
+        const auto& frame = *quicFrame.asApplicationCloseFrame();
+        writeByte(toByte(FrameRecord::ApplicationClose));
+        writeVarint(frame.errorCode);
+        writeRawString(frame.reasonPhrase);
+        break;
+      }
+      case QuicFrame::Type::MaxDataFrame_E: {
+        writeByte(toByte(FrameRecord::MaxData));
+        writeVarint(quicFrame.asMaxDataFrame()->maximumData);
+        break;
+      }
+      case QuicFrame::Type::MaxStreamDataFrame_E: {
+        const auto& frame = *quicFrame.asMaxStreamDataFrame();
+        writeByte(toByte(FrameRecord::MaxStreamData));
+        writeVarint(frame.streamId);
+        writeVarint(frame.maximumData);
+        break;
+      }
+      case QuicFrame::Type::DataBlockedFrame_E: {
+        writeByte(toByte(FrameRecord::DataBlocked));
+        writeVarint(quicFrame.asDataBlockedFrame()->dataLimit);
+        break;
+      }
+      case QuicFrame::Type::StreamDataBlockedFrame_E: {
+        const auto& frame = *quicFrame.asStreamDataBlockedFrame();
+        writeByte(toByte(FrameRecord::StreamDataBlocked));
+        writeVarint(frame.streamId);
+        writeVarint(frame.dataLimit);
+        break;
+      }
+      case QuicFrame::Type::StreamsBlockedFrame_E: {
+        const auto& frame = *quicFrame.asStreamsBlockedFrame();
+        writeByte(toByte(FrameRecord::StreamsBlocked));
+        writeVarint(frame.streamLimit);
+        writeByte(frame.isForBidirectional);
+        break;
+      }
+      case QuicFrame::Type::ReadAckFrame_E: {
+        const auto& frame = *quicFrame.asReadAckFrame();
+        writeByte(toByte(FrameRecord::Ack));
+        writeVarint(frame.ackBlocks.size());
+        for (const auto& block : frame.ackBlocks) {
+          writeVarint(block.startPacket);
+          writeVarint(block.endPacket);
+        }
+        writeVarint(frame.ackDelay.count());
+        break;
+      }
+      case QuicFrame::Type::ReadStreamFrame_E: {
+        const auto& frame = *quicFrame.asReadStreamFrame();
+        writeByte(toByte(FrameRecord::Stream));
+        writeVarint(frame.streamId);
+        writeVarint(frame.offset);
+        writeVarint(frame.data->length());
+        writeByte(frame.fin);
+        break;
+      }
+      case QuicFrame::Type::ReadCryptoFrame_E: {
+        const auto& frame = *quicFrame.asReadCryptoFrame();
+        writeByte(toByte(FrameRecord::Crypto));
+        writeVarint(frame.offset);
+        writeVarint(frame.data->length());
+        break;
+      }
+      case QuicFrame::Type::ReadNewTokenFrame_E: {
+        writeByte(toByte(FrameRecord::NewToken));
+        break;
+      }
+      case QuicFrame::Type::ReadDatagramFrame_E: {
+        const auto& frame = *quicFrame.asReadDatagramFrame();
+        writeByte(toByte(FrameRecord::Datagram));
+        writeVarint(frame.data ? frame.data->computeChainDataLength() : 0);
+        break;
+      }
+      case QuicFrame::Type::QuicSimpleFrame_E: {
+        writeSimpleFrame(*quicFrame.asQuicSimpleFrame());
+        break;
+      }
+      case QuicFrame::Type::NoopFrame_E: {
+        break;
+      }
+    }
+  }
+  if (numPaddingFrames > 0) {
+    writeByte(toByte(FrameRecord::Padding));
+    writeVarint(numPaddingFrames);
+  }
+  writeByte(toByte(FrameRecord::End));
+  endEvent();
+}
+
+void BinaryQLogger::addPacket(
+    const RegularQuicWritePacket& writePacket,
+    uint64_t packetSize) {
+  if (!beginEvent(QLogEventType::PacketSent, toByte(Record::PacketSent))) {
+    return;
+  }
+  writeByte(packetTypeByte(writePacket.header));
+  writeVarint(writePacket.header.getPacketSequenceNum());
+  writeVarint(packetSize);
+
+  uint64_t numPaddingFrames = 0;
+  for (const auto& quicFrame : writePacket.frames) {
+    switch (quicFrame.type()) {
+      case QuicWriteFrame::Type::PaddingFrame_E:
+        ++numPaddingFrames;
+        break;
+      case QuicWriteFrame::Type::RstStreamFrame_E: {
+        const RstStreamFrame& frame = *quicFrame.asRstStreamFrame();
+        writeByte(toByte(FrameRecord::RstStream));
+        writeVarint(frame.streamId);
+        writeVarint(frame.errorCode);
+        writeVarint(frame.offset);
+        break;
+      }
+      case QuicWriteFrame::Type::ConnectionCloseFrame_E: {
+        const ConnectionCloseFrame& frame = *quicFrame.asConnectionCloseFrame();
+        writeByte(toByte(FrameRecord::ConnectionClose));
+        writeVarint(static_cast<uint64_t>(frame.errorCode));
+        writeRawString(frame.reasonPhrase);
+        writeVarint(static_cast<uint64_t>(frame.closingFrameType));
+        break;
+      }
+      case QuicWriteFrame::Type::ApplicationCloseFrame_E: {
+        const ApplicationCloseFrame& frame =
+            *quicFrame.asApplicationCloseFrame();
+        writeByte(toByte(FrameRecord::ApplicationClose));
+        writeVarint(frame.errorCode);
+        writeRawString(frame.reasonPhrase);
+        break;
+      }
+      case QuicWriteFrame::Type::MaxDataFrame_E: {
+        writeByte(toByte(FrameRecord::MaxData));
+        writeVarint(quicFrame.asMaxDataFrame()->maximumData);
+        break;
+      }
+      case QuicWriteFrame::Type::MaxStreamDataFrame_E: {
+        const MaxStreamDataFrame& frame = *quicFrame.asMaxStreamDataFrame();
+        writeByte(toByte(FrameRecord::MaxStreamData));
+        writeVarint(frame.streamId);
+        writeVarint(frame.maximumData);
+        break;
+      }
+      case QuicWriteFrame::Type::StreamsBlockedFrame_E: {
+        const StreamsBlockedFrame& frame = *quicFrame.asStreamsBlockedFrame();
+        writeByte(toByte(FrameRecord::StreamsBlocked));
+        writeVarint(frame.streamLimit);
+        writeByte(frame.isForBidirectional);
+        break;
+      }
+      case QuicWriteFrame::Type::DataBlockedFrame_E: {
+        writeByte(toByte(FrameRecord::DataBlocked));
+        writeVarint(quicFrame.asDataBlockedFrame()->dataLimit);
+        break;
+      }
+      case QuicWriteFrame::Type::StreamDataBlockedFrame_E: {
+        const StreamDataBlockedFrame& frame =
+            *quicFrame.asStreamDataBlockedFrame();
+        writeByte(toByte(FrameRecord::StreamDataBlocked));
+        writeVarint(frame.streamId);
+        writeVarint(frame.dataLimit);
+        break;
+      }
+      case QuicWriteFrame::Type::WriteAckFrame_E: {
+        const WriteAckFrame& frame = *quicFrame.asWriteAckFrame();
+        writeByte(toByte(FrameRecord::Ack));
+        writeVarint(frame.ackBlocks.size());
+        for (auto it = frame.ackBlocks.cbegin(); it != frame.ackBlocks.cend();
+             ++it) {
+          writeVarint(it->start);
+          writeVarint(it->end);
+        }
+        writeVarint(frame.ackDelay.count());
+        break;
+      }
+      case QuicWriteFrame::Type::WriteStreamFrame_E: {
+        const WriteStreamFrame& frame = *quicFrame.asWriteStreamFrame();
+        writeByte(toByte(FrameRecord::Stream));
+        writeVarint(frame.streamId);
+        writeVarint(frame.offset);
+        writeVarint(frame.len);
+        writeByte(frame.fin);
+        break;
+      }
+      case QuicWriteFrame::Type::WriteCryptoFrame_E: {
+        const WriteCryptoFrame& frame = *quicFrame.asWriteCryptoFrame();
+        writeByte(toByte(FrameRecord::Crypto));
+        writeVarint(frame.offset);
+        writeVarint(frame.len);
+        break;
+      }
+      case QuicWriteFrame::Type::WriteDatagramFrame_E: {
+        writeByte(toByte(FrameRecord::Datagram));
+        writeVarint(quicFrame.asWriteDatagramFrame()->len);
+        break;
+      }
+      case QuicWriteFrame::Type::QuicSimpleFrame_E: {
+        writeSimpleFrame(*quicFrame.asQuicSimpleFrame());
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  if (numPaddingFrames > 0) {
+    writeByte(toByte(FrameRecord::Padding));
+    writeVarint(numPaddingFrames);
+  }
+  writeByte(toByte(FrameRecord::End));
+  endEvent();
+}
+
+void BinaryQLogger::addPacket(
+    const VersionNegotiationPacket& versionPacket,
+    uint64_t packetSize,
+    bool isPacketRecvd) {
+  if (!beginEvent(
+          isPacketRecvd ? QLogEventType::PacketReceived
+                        : QLogEventType::PacketSent,
+          toByte(
+              isPacketRecvd ? Record::VersionNegotiationReceived
+                            : Record::VersionNegotiationSent))) {
+    return;
+  }
+  writeVarint(packetSize);
+  writeVarint(versionPacket.versions.size());
+  for (auto version : versionPacket.versions) {
+    writeVarint(static_cast<uint64_t>(version));
+  }
+  endEvent();
+}
+
+void BinaryQLogger::addConnectionClose(
+    std::string error,
+    std::string reason,
+    bool drainConnection,
+    bool sendCloseImmediately) {
+  if (!beginEvent(
+          QLogEventType::ConnectionClose, toByte(Record::ConnectionClose))) {
+    return;
+  }
+  writeRawString(error);
+  writeRawString(reason);
+  writeByte(drainConnection);
+  writeByte(sendCloseImmediately);
+  endEvent();
+}
+
+void BinaryQLogger::addTransportSummary(
+    uint64_t totalBytesSent,
+    uint64_t totalBytesRecvd,
+    uint64_t sumCurWriteOffset,
+    uint64_t sumMaxObservedOffset,
+    uint64_t sumCurStreamBufferLen,
+    uint64_t totalBytesRetransmitted,
+    uint64_t totalStreamBytesCloned,
+    uint64_t totalBytesCloned,
+    uint64_t totalCryptoDataWritten,
+    uint64_t totalCryptoDataRecvd) {
+  if (!beginEvent(
+          QLogEventType::TransportSummary, toByte(Record::TransportSummary))) {
+    return;
+  }
+  writeVarint(totalBytesSent);
+  writeVarint(totalBytesRecvd);
+  writeVarint(sumCurWriteOffset);
+  writeVarint(sumMaxObservedOffset);
+  writeVarint(sumCurStreamBufferLen);
+  writeVarint(totalBytesRetransmitted);
+  writeVarint(totalStreamBytesCloned);
+  writeVarint(totalBytesCloned);
+  writeVarint(totalCryptoDataWritten);
+  writeVarint(totalCryptoDataRecvd);
+  endEvent();
+}
+
+void BinaryQLogger::addCongestionMetricUpdate(
+    uint64_t bytesInFlight,
+    uint64_t currentCwnd,
+    std::string congestionEvent,
+    std::string state,
+    std::string recoveryState) {
+  if (!beginEvent(
+          QLogEventType::CongestionMetricUpdate,
+          toByte(Record::CongestionMetricUpdate))) {
+    return;
+  }
+  writeVarint(bytesInFlight);
+  writeVarint(currentCwnd);
+  writeInternedString(congestionEvent);
+  writeInternedString(state);
+  writeInternedString(recoveryState);
+  endEvent();
+}
+
+void BinaryQLogger::addPacingMetricUpdate(
+    uint64_t pacingBurstSizeIn,
+    std::chrono::microseconds pacingIntervalIn) {
+  if (!beginEvent(
+          QLogEventType::PacingMetricUpdate,
+          toByte(Record::PacingMetricUpdate))) {
+    return;
+  }
+  writeVarint(pacingBurstSizeIn);
+  writeVarint(pacingIntervalIn.count());
+  endEvent();
+}
+
+void BinaryQLogger::addPacingObservation(
+    std::string actual,
+    std::string expected,
+    std::string conclusion) {
+  if (!beginEvent(
+          QLogEventType::PacingObservation,
+          toByte(Record::PacingObservation))) {
+    return;
+  }
+  writeRawString(actual);
+  writeRawString(expected);
+  writeRawString(conclusion);
+  endEvent();
+}
+
+void BinaryQLogger::addBandwidthEstUpdate(
+    uint64_t bytes,
+    std::chrono::microseconds interval) {
+  if (!beginEvent(
+          QLogEventType::BandwidthEstUpdate,
+          toByte(Record::BandwidthEstUpdate))) {
+    return;
+  }
+  writeVarint(bytes);
+  writeVarint(interval.count());
+  endEvent();
+}
+
+void BinaryQLogger::addAppLimitedUpdate() {
+  if (beginEvent(
+          QLogEventType::AppLimitedUpdate, toByte(Record::AppLimitedUpdate))) {
+    endEvent();
+  }
+}
+
+void BinaryQLogger::addAppUnlimitedUpdate() {
+  if (beginEvent(
+          QLogEventType::AppLimitedUpdate,
+          toByte(Record::AppUnlimitedUpdate))) {
+    endEvent();
+  }
+}
+
+void BinaryQLogger::addAppIdleUpdate(std::string idleEvent, bool idle) {
+  if (!beginEvent(
+          QLogEventType::AppIdleUpdate, toByte(Record::AppIdleUpdate))) {
+    return;
+  }
+  writeInternedString(idleEvent);
+  writeByte(idle);
+  endEvent();
+}
+
+void BinaryQLogger::addPacketDrop(size_t packetSize, std::string dropReason) {
+  if (!beginEvent(QLogEventType::PacketDrop, toByte(Record::PacketDrop))) {
+    return;
+  }
+  writeVarint(packetSize);
+  writeInternedString(dropReason);
+  endEvent();
+}
+
+void BinaryQLogger::addDatagramReceived(uint64_t dataLen) {
+  if (!beginEvent(
+          QLogEventType::DatagramReceived, toByte(Record::DatagramReceived))) {
+    return;
+  }
+  writeVarint(dataLen);
+  endEvent();
+}
+
+void BinaryQLogger::addLossAlarm(
+    PacketNum largestSent,
+    uint64_t alarmCount,
+    uint64_t outstandingPackets,
+    std::string type) {
+  if (!beginEvent(QLogEventType::LossAlarm, toByte(Record::LossAlarm))) {
+    return;
+  }
+  writeVarint(largestSent);
+  writeVarint(alarmCount);
+  writeVarint(outstandingPackets);
+  writeInternedString(type);
+  endEvent();
+}
+
+void BinaryQLogger::addPacketsLost(
+    PacketNum largestLostPacketNum,
+    uint64_t lostBytes,
+    uint64_t lostPackets) {
+  if (!beginEvent(QLogEventType::PacketsLost, toByte(Record::PacketsLost))) {
+    return;
+  }
+  writeVarint(largestLostPacketNum);
+  writeVarint(lostBytes);
+  writeVarint(lostPackets);
+  endEvent();
+}
+
+void BinaryQLogger::addTransportStateUpdate(std::string update) {
+  if (!beginEvent(
+          QLogEventType::TransportStateUpdate,
+          toByte(Record::TransportStateUpdate))) {
+    return;
+  }
+  writeInternedString(update);
+  endEvent();
+}
+
+void BinaryQLogger::addPacketBuffered(
+    PacketNum packetNum,
+    ProtectionType protectionType,
+    uint64_t packetSize) {
+  if (!beginEvent(
+          QLogEventType::PacketBuffered, toByte(Record::PacketBuffered))) {
+    return;
+  }
+  writeVarint(packetNum);
+  writeByte(static_cast<uint8_t>(protectionType));
+  writeVarint(packetSize);
+  endEvent();
+}
+
+void BinaryQLogger::addPacketAck(
+    PacketNumberSpace packetNumSpace,
+    PacketNum packetNum) {
+  if (!beginEvent(QLogEventType::PacketAck, toByte(Record::PacketAck))) {
+    return;
+  }
+  writeByte(static_cast<uint8_t>(packetNumSpace));
+  writeVarint(packetNum);
+  endEvent();
+}
+
+void BinaryQLogger::addMetricUpdate(
+    std::chrono::microseconds latestRtt,
+    std::chrono::microseconds mrtt,
+    std::chrono::microseconds srtt,
+    std::chrono::microseconds ackDelay) {
+  if (!beginEvent(QLogEventType::MetricUpdate, toByte(Record::MetricUpdate))) {
+    return;
+  }
+  writeVarint(latestRtt.count());
+  writeVarint(mrtt.count());
+  writeVarint(srtt.count());
+  writeVarint(ackDelay.count());
+  endEvent();
+}
+
+void BinaryQLogger::addStreamStateUpdate(
+    StreamId id,
+    std::string update,
+    folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation) {
+  if (!beginEvent(
+          QLogEventType::StreamStateUpdate,
+          toByte(Record::StreamStateUpdate))) {
+    return;
+  }
+  writeVarint(id);
+  writeInternedString(update);
+  writeByte(timeSinceStreamCreation.hasValue());
+  if (timeSinceStreamCreation) {
+    writeVarint(timeSinceStreamCreation->count());
+  }
+  endEvent();
+}
+
+std::string BinaryQLogger::serialize() const {
+  std::string out = kBinaryQLogMagic.str();
+  out.push_back(kBinaryQLogFormatVersion);
+  out.push_back(static_cast<char>(vantagePoint));
+  auto writeHeaderVarint = [&out](uint64_t value) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+  };
+  writeHeaderVarint(protocolType.size());
+  out.append(protocolType);
+  for (const auto& connId : {dcid, scid}) {
+    // The length plus one, 0 when there is no connection id.
+    writeHeaderVarint(connId ? connId->size() + 1 : 0);
+    if (connId) {
+      out.append(reinterpret_cast<const char*>(connId->data()), connId->size());
+    }
+  }
+  out.append(reinterpret_cast<const char*>(buf_.data()), buf_.size());
+  return out;
+}
+
+void BinaryQLogger::outputLogsToFile(const std::string& path) {
+  if (!dcid.hasValue()) {
+    LOG(ERROR) << "Error: No dcid found";
+    return;
+  }
+  std::string outputPath =
+      folly::to<std::string>(path, "/", dcid->hex(), ".qlogb");
+  std::ofstream fileObj(outputPath, std::ios::binary);
+  if (fileObj) {
+    fileObj << serialize();
+  } else {
+    LOG(ERROR) << "Error: Can't write to provided path: " << path;
+  }
+  fileObj.close();
+}
+
+std::unique_ptr<FileQLogger> parseBinaryQLog(folly::ByteRange data) {
+  BinaryQLogReader reader(data);
+  auto magic = reader.readBytes(kBinaryQLogMagic.size());
+  if (folly::StringPiece(magic) != kBinaryQLogMagic) {
+    throw std::invalid_argument("Not a binary qlog");
+  }
+  auto version = reader.readByte();
+  if (version != kBinaryQLogFormatVersion) {
+    throw std::invalid_argument(folly::to<std::string>(
+        "Unsupported binary qlog version: ", version));
+  }
+  auto vantagePointByte = reader.readByte();
+  if (vantagePointByte > static_cast<uint8_t>(VantagePoint::SERVER)) {
+    throw std::invalid_argument("Unknown vantage point in binary qlog");
+  }
+  auto vantagePoint = static_cast<VantagePoint>(vantagePointByte);
+  auto qLogger =
+      std::make_unique<FileQLogger>(vantagePoint, reader.readRawString());
+  qLogger->dcid = reader.readConnectionId();
+  qLogger->scid = reader.readConnectionId();
+
+  std::chrono::microseconds refTime{0};
+  while (!reader.empty()) {
+    auto record = static_cast<Record>(reader.readByte());
+    refTime += reader.readMicros();
+    auto event = readEvent(reader, record, vantagePoint, refTime);
+    event->refTime = refTime;
+    qLogger->logs.push_back(std::move(event));
+  }
+  return qLogger;
+}
+} // namespace quic
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/container/F14Map.h>
+#include <quic/logging/BaseQLogger.h>
+#include <quic/logging/FileQLogger.h>
+#include <quic/logging/QLoggerConstants.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A QLogger that encodes every event into a compact binary record as it is
+ * logged, instead of building a QLogEvent and its frames on the heap, so
+ * logging an event is mostly appending a few varints to a buffer reserved up
+ * front. Packet types, frame types and the other enums are written as
+ * numbers, and the strings that name an event, like the congestion events or
+ * the drop reasons, are written once and then referred to by their index.
+ *
+ * The buffer grows up to maxBytes, the events that don't fit are dropped.
+ * parseBinaryQLog() decodes the records back into the events of a
+ * FileQLogger, which is how the qlogconvert tool produces the usual JSON
+ * offline. Like a connection, the logger is used from a single thread.
+ */
+class BinaryQLogger : public BaseQLogger {
+ public:
+  explicit BinaryQLogger(
+      VantagePoint vantagePointIn,
+      std::string protocolTypeIn = kHTTP3ProtocolType,
+      size_t initialBytes = kDefaultBinaryQLogInitialBytes,
+      size_t maxBytes = kDefaultBinaryQLogMaxBytes);
+
+  ~BinaryQLogger() override = default;
+
+  void addPacket(const RegularQuicPacket& regularPacket, uint64_t packetSize)
+      override;
+  void addPacket(
+      const VersionNegotiationPacket& versionPacket,
+      uint64_t packetSize,
+      bool isPacketRecvd) override;
+  void addPacket(const RegularQuicWritePacket& writePacket, uint64_t packetSize)
+      override;
+  void addConnectionClose(
+      std::string error,
+      std::string reason,
+      bool drainConnection,
+      bool sendCloseImmediately) override;
+  void addTransportSummary(
+      uint64_t totalBytesSent,
+      uint64_t totalBytesRecvd,
+      uint64_t sumCurWriteOffset,
+      uint64_t sumMaxObservedOffset,
+      uint64_t sumCurStreamBufferLen,
+      uint64_t totalBytesRetransmitted,
+      uint64_t totalStreamBytesCloned,
+      uint64_t totalBytesCloned,
+      uint64_t totalCryptoDataWritten,
+      uint64_t totalCryptoDataRecvd) override;
+  void addCongestionMetricUpdate(
+      uint64_t bytesInFlight,
+      uint64_t currentCwnd,
+      std::string congestionEvent,
+      std::string state = "",
+      std::string recoveryState = "") override;
+  void addPacingMetricUpdate(
+      uint64_t pacingBurstSizeIn,
+      std::chrono::microseconds pacingIntervalIn) override;
+  void addPacingObservation(
+      std::string actual,
+      std::string expected,
+      std::string conclusion) override;
+  void addBandwidthEstUpdate(uint64_t bytes, std::chrono::microseconds interval)
+      override;
+  void addAppLimitedUpdate() override;
+  void addAppUnlimitedUpdate() override;
+  void addAppIdleUpdate(std::string idleEvent, bool idle) override;
+  void addPacketDrop(size_t packetSize, std::string dropReasonIn) override;
+  void addDatagramReceived(uint64_t dataLen) override;
+  void addLossAlarm(
+      PacketNum largestSent,
+      uint64_t alarmCount,
+      uint64_t outstandingPackets,
+      std::string type) override;
+  void addPacketsLost(
+      PacketNum largestLostPacketNum,
+      uint64_t lostBytes,
+      uint64_t lostPackets) override;
+  void addTransportStateUpdate(std::string update) override;
+  void addPacketBuffered(
+      PacketNum packetNum,
+      ProtectionType protectionType,
+      uint64_t packetSize) override;
+  void addPacketAck(PacketNumberSpace packetNumSpace, PacketNum packetNum)
+      override;
+  void addMetricUpdate(
+      std::chrono::microseconds latestRtt,
+      std::chrono::microseconds mrtt,
+      std::chrono::microseconds srtt,
+      std::chrono::microseconds ackDelay) override;
+  void addStreamStateUpdate(
+      StreamId id,
+      std::string update,
+      folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation)
+      override;
+
+  /**
+   * The header, with the connection ids, followed by the records.
+   */
+  std::string serialize() const;
+
+  /**
+   * Writes serialize() to <path>/<dcid>.qlogb.
+   */
+  void outputLogsToFile(const std::string& path);
+
+  uint64_t numEvents() const {
+    return numEvents_;
+  }
+
+  uint64_t numDroppedEvents() const {
+    return numDroppedEvents_;
+  }
+
+  // The bytes taken by the records.
+  size_t size() const {
+    return buf_.size();
+  }
+
+ protected:
+  // All the add methods are overridden, no QLogEvent is ever built.
+  void handleEvent(std::unique_ptr<QLogEvent>) override {}
+
+ private:
+  // Returns false if the event isn't logged.
+  bool beginEvent(QLogEventType eventType, uint8_t record);
+  void endEvent();
+
+  void writeByte(uint8_t value) {
+    buf_.push_back(value);
+  }
+
+  void writeVarint(uint64_t value);
+  void writeBytes(folly::ByteRange bytes);
+  void writeRawString(folly::StringPiece str);
+  void writeInternedString(const std::string& str);
+  void writeSimpleFrame(const QuicSimpleFrame& simpleFrame);
+
+  size_t maxBytes_;
+  std::vector<uint8_t> buf_;
+  folly::F14FastMap<std::string, uint32_t> strings_;
+  std::chrono::microseconds lastRefTime_{0};
+  // Where the event being written starts, it is rolled back if it doesn't
+  // fit.
+  size_t eventStart_{0};
+  std::chrono::microseconds eventStartRefTime_{0};
+  bool full_{false};
+  uint64_t numEvents_{0};
+  uint64_t numDroppedEvents_{0};
+};
+
+/**
+ * Decodes what BinaryQLogger::serialize() wrote. Throws std::invalid_argument
+ * if the data is malformed.
+ */
+std::unique_ptr<FileQLogger> parseBinaryQLog(folly::ByteRange data);
+} // namespace quic
@@ -13,215 +13,8 @@
 
 namespace quic {
 
-void FileQLogger::addPacket(
-    const RegularQuicPacket& regularPacket,
-    uint64_t packetSize) {
-  logs.push_back(createPacketEvent(regularPacket, packetSize));
-}
-
-void FileQLogger::addPacket(
-    const RegularQuicWritePacket& writePacket,
-    uint64_t packetSize) {
-  logs.push_back(createPacketEvent(writePacket, packetSize));
-}
-
-void FileQLogger::addPacket(
-    const VersionNegotiationPacket& versionPacket,
-    uint64_t packetSize,
-    bool isPacketRecvd) {
-  logs.push_back(createPacketEvent(versionPacket, packetSize, isPacketRecvd));
-}
-
-void FileQLogger::addConnectionClose(
-    std::string error,
-    std::string reason,
-    bool drainConnection,
-    bool sendCloseImmediately) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogConnectionCloseEvent>(
-      std::move(error),
-      std::move(reason),
-      drainConnection,
-      sendCloseImmediately,
-      refTime));
-}
-
-void FileQLogger::addTransportSummary(
-    uint64_t totalBytesSent,
-    uint64_t totalBytesRecvd,
-    uint64_t sumCurWriteOffset,
-    uint64_t sumMaxObservedOffset,
-    uint64_t sumCurStreamBufferLen,
-    uint64_t totalBytesRetransmitted,
-    uint64_t totalStreamBytesCloned,
-    uint64_t totalBytesCloned,
-    uint64_t totalCryptoDataWritten,
-    uint64_t totalCryptoDataRecvd) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogTransportSummaryEvent>(
-      totalBytesSent,
-      totalBytesRecvd,
-      sumCurWriteOffset,
-      sumMaxObservedOffset,
-      sumCurStreamBufferLen,
-      totalBytesRetransmitted,
-      totalStreamBytesCloned,
-      totalBytesCloned,
-      totalCryptoDataWritten,
-      totalCryptoDataRecvd,
-      refTime));
-}
-
-void FileQLogger::addCongestionMetricUpdate(
-    uint64_t bytesInFlight,
-    uint64_t currentCwnd,
-    std::string congestionEvent,
-    std::string state,
-    std::string recoveryState) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogCongestionMetricUpdateEvent>(
-      bytesInFlight,
-      currentCwnd,
-      std::move(congestionEvent),
-      std::move(state),
-      std::move(recoveryState),
-      refTime));
-}
-
-void FileQLogger::addBandwidthEstUpdate(
-    uint64_t bytes,
-    std::chrono::microseconds interval) {
-  logs.push_back(std::make_unique<quic::QLogBandwidthEstUpdateEvent>(
-      bytes,
-      interval,
-      std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::steady_clock::now() - refTimePoint)));
-}
-
-void FileQLogger::addAppLimitedUpdate() {
-  logs.push_back(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
-      true,
-      std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::steady_clock::now() - refTimePoint)));
-}
-
-void FileQLogger::addAppUnlimitedUpdate() {
-  logs.push_back(std::make_unique<quic::QLogAppLimitedUpdateEvent>(
-      false,
-      std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::steady_clock::now() - refTimePoint)));
-}
-void FileQLogger::addPacingMetricUpdate(
-    uint64_t pacingBurstSizeIn,
-    std::chrono::microseconds pacingIntervalIn) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogPacingMetricUpdateEvent>(
-      pacingBurstSizeIn, pacingIntervalIn, refTime));
-}
-
-void FileQLogger::addPacingObservation(
-    std::string actual,
-    std::string expect,
-    std::string conclusion) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-  logs.push_back(std::make_unique<quic::QLogPacingObservationEvent>(
-      std::move(actual), std::move(expect), std::move(conclusion), refTime));
-}
-
-void FileQLogger::addAppIdleUpdate(std::string idleEvent, bool idle) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogAppIdleUpdateEvent>(
-      std::move(idleEvent), idle, refTime));
-}
-
-void FileQLogger::addPacketDrop(size_t packetSize, std::string dropReason) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogPacketDropEvent>(
-      packetSize, std::move(dropReason), refTime));
-}
-
-void FileQLogger::addDatagramReceived(uint64_t dataLen) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(
-      std::make_unique<quic::QLogDatagramReceivedEvent>(dataLen, refTime));
-}
-
-void FileQLogger::addLossAlarm(
-    PacketNum largestSent,
-    uint64_t alarmCount,
-    uint64_t outstandingPackets,
-    std::string type) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogLossAlarmEvent>(
-      largestSent, alarmCount, outstandingPackets, std::move(type), refTime));
-}
-
-void FileQLogger::addPacketsLost(
-    PacketNum largestLostPacketNum,
-    uint64_t lostBytes,
-    uint64_t lostPackets) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogPacketsLostEvent>(
-      largestLostPacketNum, lostBytes, lostPackets, refTime));
-}
-
-void FileQLogger::addTransportStateUpdate(std::string update) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogTransportStateUpdateEvent>(
-      std::move(update), refTime));
-}
-
-void FileQLogger::addPacketBuffered(
-    PacketNum packetNum,
-    ProtectionType protectionType,
-    uint64_t packetSize) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogPacketBufferedEvent>(
-      packetNum, protectionType, packetSize, refTime));
-}
-
-void FileQLogger::addPacketAck(
-    PacketNumberSpace packetNumSpace,
-    PacketNum packetNum) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogPacketAckEvent>(
-      packetNumSpace, packetNum, refTime));
-}
-
-void FileQLogger::addMetricUpdate(
-    std::chrono::microseconds latestRtt,
-    std::chrono::microseconds mrtt,
-    std::chrono::microseconds srtt,
-    std::chrono::microseconds ackDelay) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogMetricUpdateEvent>(
-      latestRtt, mrtt, srtt, ackDelay, refTime));
+void FileQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  logs.push_back(std::move(event));
 }
 
 folly::dynamic FileQLogger::toDynamic() const {
@@ -277,21 +70,6 @@ folly::dynamic FileQLogger::toDynamic() const {
   return dynamicObj;
 }
 
-void FileQLogger::addStreamStateUpdate(
-    quic::StreamId id,
-    std::string update,
-    folly::Optional<std::chrono::milliseconds> timeSinceStreamCreation) {
-  auto refTime = std::chrono::duration_cast<std::chrono::microseconds>(
-      std::chrono::steady_clock::now() - refTimePoint);
-
-  logs.push_back(std::make_unique<quic::QLogStreamStateUpdateEvent>(
-      id,
-      std::move(update),
-      std::move(timeSinceStreamCreation),
-      vantagePoint,
-      refTime));
-}
-
 void FileQLogger::outputLogsToFile(const std::string& path, bool prettyJson) {
   if (!dcid.hasValue()) {
     LOG(ERROR) << "Error: No dcid found";
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/QLogSampler.h>
+
+#include <folly/hash/Hash.h>
+
+namespace quic {
+
+QLogSampler::QLogSampler(
+    QLogSamplingSettings settings,
+    QLoggerFactory factory)
+    : settings_(std::move(settings)), factory_(std::move(factory)) {
+  CHECK(factory_);
+  CHECK_LE(settings_.connectionPercent, 100);
+}
+
+std::shared_ptr<QLogger> QLogSampler::maybeCreateForNewConnection(
+    const ConnectionId& clientChosenConnId,
+    VantagePoint vantagePoint) const {
+  if (settings_.connectionPercent == 0) {
+    return nullptr;
+  }
+  // Not the ConnectionIdHash used for routing, so that the sampled
+  // connections are not correlated with the ones of a worker.
+  auto hash = folly::hash::fnv64_buf(
+      clientChosenConnId.data(), clientChosenConnId.size());
+  if (hash % 100 >= settings_.connectionPercent) {
+    return nullptr;
+  }
+  return create(vantagePoint);
+}
+
+std::shared_ptr<QLogger> QLogSampler::maybeCreateForLossyConnection(
+    uint32_t retransmissions,
+    uint32_t ptoCount,
+    VantagePoint vantagePoint) const {
+  bool retransmissionsCrossed = settings_.retransmissionThreshold > 0 &&
+      retransmissions >= settings_.retransmissionThreshold;
+  bool ptoCrossed =
+      settings_.ptoThreshold > 0 && ptoCount >= settings_.ptoThreshold;
+  if (!retransmissionsCrossed && !ptoCrossed) {
+    return nullptr;
+  }
+  return create(vantagePoint);
+}
+
+std::shared_ptr<QLogger> QLogSampler::create(VantagePoint vantagePoint) const {
+  auto qLogger = factory_(vantagePoint);
+  if (qLogger) {
+    qLogger->setEventTypes(settings_.eventTypes);
+  }
+  return qLogger;
+}
+} // namespace quic
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <functional>
+
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/logging/BaseQLogger.h>
+
+namespace quic {
+
+struct QLogSamplingSettings {
+  // Percentage of the connections, in [0, 100], that are logged from their
+  // start. They are picked by a hash of the connection id chosen by the
+  // client, so every worker and every host makes the same choice.
+  uint8_t connectionPercent{0};
+  // Connections that are not logged from their start start being logged once
+  // they have retransmitted this many packets, or had this many PTOs. Zero
+  // disables the trigger.
+  uint32_t retransmissionThreshold{0};
+  uint32_t ptoThreshold{0};
+  // The event types that are logged, all of them if empty.
+  std::vector<QLogEventType> eventTypes;
+};
+
+/**
+ * Decides which connections get a qlogger, and creates the qloggers with the
+ * factory. Shared by all the connections of a server, so it is immutable.
+ */
+class QLogSampler {
+ public:
+  using QLoggerFactory =
+      std::function<std::shared_ptr<BaseQLogger>(VantagePoint)>;
+
+  QLogSampler(QLogSamplingSettings settings, QLoggerFactory factory);
+
+  /**
+   * Returns a qlogger if the connection is logged from its start, nullptr
+   * otherwise.
+   */
+  std::shared_ptr<QLogger> maybeCreateForNewConnection(
+      const ConnectionId& clientChosenConnId,
+      VantagePoint vantagePoint) const;
+
+  /**
+   * Returns a qlogger if a connection that was not logged from its start
+   * crossed the retransmission or PTO thresholds, nullptr otherwise.
+   */
+  std::shared_ptr<QLogger> maybeCreateForLossyConnection(
+      uint32_t retransmissions,
+      uint32_t ptoCount,
+      VantagePoint vantagePoint) const;
+
+  bool hasLossTriggers() const {
+    return settings_.retransmissionThreshold > 0 || settings_.ptoThreshold > 0;
+  }
+
+  const QLogSamplingSettings& getSettings() const {
+    return settings_;
+  }
+
+ private:
+  std::shared_ptr<QLogger> create(VantagePoint vantagePoint) const;
+
+  const QLogSamplingSettings settings_;
+  const QLoggerFactory factory_;
+};
+} // namespace quic
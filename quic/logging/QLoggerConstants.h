@@ -33,6 +33,8 @@ constexpr auto kCopaInit = "copa init";
 constexpr auto kCongestionPacketSent = "congestion on packet sent";
 constexpr auto kCopaCheckAndUpdateDirection = "copa check and update direction";
 constexpr auto kCongestionPacketLoss = "congestion packet loss";
+constexpr auto kCongestionECN = "congestion ecn ce";
+constexpr auto kCongestionUndo = "congestion undo spurious loss";
 constexpr auto kAppLimited = "app limited";
 constexpr auto kAppUnlimited = "app unlimited";
 constexpr uint64_t kDefaultCwnd = 12320;
@@ -56,6 +58,12 @@ constexpr auto kTransportReady = "transport ready";
 constexpr auto kDerivedZeroRttReadCipher = "derived 0-rtt read cipher";
 constexpr auto kDerivedOneRttReadCipher = "derived 1-rtt read cipher";
 constexpr auto kDerivedOneRttWriteCipher = "derived 1-rtt write cipher";
+constexpr auto kLocalKeyUpdate = "local key update";
+constexpr auto kPeerKeyUpdate = "peer key update";
+constexpr auto kPmtuProbeAcked = "pmtu probe acked";
+constexpr auto kPmtuBlackHole = "pmtu black hole";
+constexpr auto kHibernated = "hibernated";
+constexpr auto kWokeUp = "woke up";
 constexpr auto kZeroRttRejected = "zerortt rejected";
 constexpr auto kZeroRttAccepted = "zerortt accepted";
 constexpr auto kZeroRttAttempted = "zerortt attempted";
@@ -71,6 +79,15 @@ constexpr auto kQLogVersionField = "qlog_version";
 constexpr auto kQLogTitleField = "title";
 constexpr auto kQLogDescriptionField = "description";
 constexpr auto kQLogTraceCountField = "trace_count";
+constexpr auto kQLogDroppedEventsField = "dropped_events";
+// Serialized events a StreamingQLogger buffers before handing them to its sink.
+constexpr size_t kDefaultQLogBatchBytes = 64 * 1024;
+// Batches an AsyncFileQLogSink holds before it drops new ones.
+constexpr size_t kDefaultQLogSinkQueueCapacity = 64;
+// Bytes a BinaryQLogger reserves up front, and the most it grows to before it
+// drops the events.
+constexpr size_t kDefaultBinaryQLogInitialBytes = 16 * 1024;
+constexpr size_t kDefaultBinaryQLogMaxBytes = 16 * 1024 * 1024;
 constexpr auto kEOM = "eom";
 constexpr auto kOnEOM = "on eom";
 constexpr auto kStreamBlocked = "stream blocked";
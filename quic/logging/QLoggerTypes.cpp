@@ -182,6 +182,16 @@ folly::dynamic RetireConnectionIdFrameLog::toDynamic() const {
   return d;
 }
 
+folly::dynamic AckFrequencyFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::ACK_FREQUENCY);
+  d["sequence_number"] = sequenceNumber;
+  d["packet_tolerance"] = packetTolerance;
+  d["update_max_ack_delay"] = updateMaxAckDelay.count();
+  d["ignore_order"] = ignoreOrder;
+  return d;
+}
+
 folly::dynamic ReadAckFrameLog::toDynamic() const {
   folly::dynamic d = folly::dynamic::object();
   folly::dynamic ackRangeDynamic = folly::dynamic::array();
@@ -209,6 +219,13 @@ folly::dynamic WriteAckFrameLog::toDynamic() const {
   return d;
 }
 
+folly::dynamic DatagramFrameLog::toDynamic() const {
+  folly::dynamic d = folly::dynamic::object();
+  d["frame_type"] = toString(FrameType::DATAGRAM);
+  d["length"] = len;
+  return d;
+}
+
 folly::dynamic ReadNewTokenFrameLog::toDynamic() const {
   folly::dynamic d = folly::dynamic::object();
   d["frame_type"] = toString(FrameType::NEW_TOKEN);
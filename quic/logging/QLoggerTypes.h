@@ -169,11 +169,11 @@ class ReadAckFrameLog : public QLogFrame {
 
 class WriteAckFrameLog : public QLogFrame {
  public:
-  IntervalSet<PacketNum> ackBlocks;
+  WriteAckBlocks ackBlocks;
   std::chrono::microseconds ackDelay;
 
   WriteAckFrameLog(
-      IntervalSet<PacketNum> ackBlocksIn,
+      WriteAckBlocks ackBlocksIn,
       std::chrono::microseconds ackDelayIn)
       : ackBlocks{ackBlocksIn}, ackDelay{ackDelayIn} {}
   ~WriteAckFrameLog() override = default;
@@ -288,6 +288,36 @@ class RetireConnectionIdFrameLog : public QLogFrame {
   folly::dynamic toDynamic() const override;
 };
 
+class AckFrequencyFrameLog : public QLogFrame {
+ public:
+  uint64_t sequenceNumber;
+  uint64_t packetTolerance;
+  std::chrono::microseconds updateMaxAckDelay;
+  bool ignoreOrder;
+
+  AckFrequencyFrameLog(
+      uint64_t sequenceNumberIn,
+      uint64_t packetToleranceIn,
+      std::chrono::microseconds updateMaxAckDelayIn,
+      bool ignoreOrderIn)
+      : sequenceNumber(sequenceNumberIn),
+        packetTolerance(packetToleranceIn),
+        updateMaxAckDelay(updateMaxAckDelayIn),
+        ignoreOrder(ignoreOrderIn) {}
+
+  ~AckFrequencyFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
+class DatagramFrameLog : public QLogFrame {
+ public:
+  uint64_t len;
+
+  explicit DatagramFrameLog(uint64_t lenIn) : len{lenIn} {}
+  ~DatagramFrameLog() override = default;
+  folly::dynamic toDynamic() const override;
+};
+
 class ReadNewTokenFrameLog : public QLogFrame {
  public:
   ReadNewTokenFrameLog() = default;
@@ -36,8 +36,10 @@ void quicTraceStream(std::string& value, T&& t, Args&&... args) {
   quicTraceStream(value, std::forward<Args>(args)...);
 }
 
+// Takes the name as a literal, so that there is no string to build when
+// nothing is traced.
 template <class T, class... Args>
-void quicTraceLogger(std::string name, const T& conn, Args&&... args) {
+void quicTraceLogger(const char* name, const T& conn, Args&&... args) {
   if (!conn.logger && !VLOG_IS_ON(20)) {
     return;
   }
@@ -106,6 +108,17 @@ void quicTraceLogger(std::string name, const T& conn, Args&&... args) {
   } while (false);
 #endif
 
+/**
+ * Static tracepoint with typed arguments, for the hot paths: unlike
+ * QUIC_TRACE nothing is formatted or logged, and a probe that isn't
+ * attached to, e.g. by bpftrace with usdt:<binary>:quic:<name>, costs a nop.
+ * The first argument of every probe is the address of the connection state,
+ * which tells the connections apart. The other arguments have to be
+ * integers, at most 7 of them.
+ */
+#define QUIC_SDT(name, conn, ...) \
+  FOLLY_SDT(quic, name, reinterpret_cast<uintptr_t>(&(conn)), __VA_ARGS__)
+
 #define QUIC_TRACE_SOCK(name, sock, ...)                \
   if (sock && sock->getState()) {                       \
     QUIC_TRACE(name, *(sock)->getState(), __VA_ARGS__); \
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/logging/StreamingQLogger.h>
+
+#include <folly/json.h>
+
+namespace quic {
+
+AsyncFileQLogSink::AsyncFileQLogSink(
+    const std::string& path,
+    size_t queueCapacity)
+    : file_(path, std::ios::out | std::ios::app), queue_(queueCapacity) {
+  if (!file_) {
+    LOG(ERROR) << "Error: Can't write to provided path: " << path;
+  }
+  writer_ = std::thread([this] { run(); });
+}
+
+AsyncFileQLogSink::~AsyncFileQLogSink() {
+  queue_.blockingWrite(std::string());
+  writer_.join();
+}
+
+bool AsyncFileQLogSink::write(std::string batch) {
+  if (batch.empty()) {
+    return true;
+  }
+  if (!queue_.write(std::move(batch))) {
+    droppedBatches_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void AsyncFileQLogSink::run() {
+  std::string batch;
+  while (true) {
+    queue_.blockingRead(batch);
+    if (batch.empty()) {
+      break;
+    }
+    if (file_) {
+      file_ << batch;
+    }
+  }
+  file_.flush();
+}
+
+StreamingQLogger::StreamingQLogger(
+    VantagePoint vantagePointIn,
+    std::shared_ptr<QLogSink> sink,
+    size_t batchBytes,
+    std::string protocolTypeIn)
+    : BaseQLogger(vantagePointIn, std::move(protocolTypeIn)),
+      sink_(std::move(sink)),
+      batchBytes_(batchBytes) {
+  CHECK(sink_);
+  batch_.reserve(batchBytes_);
+}
+
+StreamingQLogger::~StreamingQLogger() {
+  flush();
+}
+
+std::string StreamingQLogger::header() const {
+  folly::dynamic headerObj = folly::dynamic::object;
+  headerObj[kQLogVersionField] = kQLogVersion;
+  headerObj[kQLogTitleField] = kQLogTitle;
+  headerObj[kQLogDescriptionField] = kQLogTraceDescription;
+  headerObj["vantage_point"] =
+      folly::dynamic::object("type", vantagePointString(vantagePoint))(
+          "name", vantagePointString(vantagePoint));
+  headerObj["configuration"] =
+      folly::dynamic::object("time_offset", 0)("time_units", kQLogTimeUnits);
+  headerObj["common_fields"] = folly::dynamic::object("reference_time", "0")(
+      "dcid", dcid.hasValue() ? dcid.value().hex() : "")(
+      "scid", scid.hasValue() ? scid.value().hex() : "")(
+      "protocol_type", protocolType);
+  headerObj["event_fields"] = folly::dynamic::array(
+      "relative_time", "CATEGORY", "EVENT_TYPE", "TRIGGER", "DATA");
+  return folly::toJson(headerObj) + "\n";
+}
+
+void StreamingQLogger::handleEvent(std::unique_ptr<QLogEvent> event) {
+  ++numEvents_;
+  batch_ += folly::toJson(event->toDynamic());
+  batch_ += '\n';
+  ++batchEvents_;
+  if (batch_.size() >= batchBytes_) {
+    flush();
+  }
+}
+
+void StreamingQLogger::flush() {
+  if (batchEvents_ == 0) {
+    return;
+  }
+  std::string batch;
+  batch.reserve(batchBytes_);
+  if (!headerWritten_) {
+    // The connection ids are usually only known once the first events are
+    // logged, so the header goes with the first batch.
+    batch += header();
+  }
+  if (unreportedDroppedEvents_ > 0) {
+    batch += folly::toJson(folly::dynamic::object(
+        kQLogDroppedEventsField, unreportedDroppedEvents_));
+    batch += '\n';
+  }
+  batch += batch_;
+  if (sink_->write(std::move(batch))) {
+    headerWritten_ = true;
+    unreportedDroppedEvents_ = 0;
+  } else {
+    numDroppedEvents_ += batchEvents_;
+    unreportedDroppedEvents_ += batchEvents_;
+  }
+  batch_.clear();
+  batchEvents_ = 0;
+}
+} // namespace quic
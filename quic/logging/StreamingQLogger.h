@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include <folly/MPMCQueue.h>
+#include <quic/logging/BaseQLogger.h>
+#include <quic/logging/QLoggerConstants.h>
+
+namespace quic {
+
+/**
+ * Receives batches of serialized qlog events from StreamingQLoggers. write()
+ * is called from the thread of the connection, so it must not block.
+ */
+class QLogSink {
+ public:
+  virtual ~QLogSink() = default;
+
+  /**
+   * Returns false if the batch was dropped because the sink is backed up.
+   */
+  virtual bool write(std::string batch) = 0;
+};
+
+/**
+ * A sink that appends the batches to a file from a background thread. At most
+ * queueCapacity batches wait to be written, new batches are dropped past that.
+ * Can be shared by the loggers of many connections and threads.
+ */
+class AsyncFileQLogSink : public QLogSink {
+ public:
+  explicit AsyncFileQLogSink(
+      const std::string& path,
+      size_t queueCapacity = kDefaultQLogSinkQueueCapacity);
+
+  // Writes the batches still queued before returning.
+  ~AsyncFileQLogSink() override;
+
+  bool write(std::string batch) override;
+
+  uint64_t droppedBatches() const {
+    return droppedBatches_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void run();
+
+  std::ofstream file_;
+  // An empty batch tells the writer thread to stop.
+  folly::MPMCQueue<std::string> queue_;
+  std::atomic<uint64_t> droppedBatches_{0};
+  std::thread writer_;
+};
+
+/**
+ * A QLogger that serializes every event as it is logged, instead of keeping
+ * the events around like FileQLogger, so its memory stays bounded however
+ * long the connection lives. Events are written as one JSON array per line
+ * after a JSON header line, and handed to the sink in batches of about
+ * batchBytes. If the sink drops a batch, the next accepted batch starts with a
+ * {"dropped_events": n} line.
+ *
+ * Like a connection, the logger is used from a single thread and is not
+ * synchronized.
+ */
+class StreamingQLogger : public BaseQLogger {
+ public:
+  StreamingQLogger(
+      VantagePoint vantagePointIn,
+      std::shared_ptr<QLogSink> sink,
+      size_t batchBytes = kDefaultQLogBatchBytes,
+      std::string protocolTypeIn = kHTTP3ProtocolType);
+
+  // Flushes the events still buffered.
+  ~StreamingQLogger() override;
+
+  /**
+   * Hands the buffered events to the sink.
+   */
+  void flush();
+
+  uint64_t numEvents() const {
+    return numEvents_;
+  }
+
+  uint64_t numDroppedEvents() const {
+    return numDroppedEvents_;
+  }
+
+ protected:
+  void handleEvent(std::unique_ptr<QLogEvent> event) override;
+
+ private:
+  std::string header() const;
+
+  std::shared_ptr<QLogSink> sink_;
+  size_t batchBytes_;
+  std::string batch_;
+  size_t batchEvents_{0};
+  bool headerWritten_{false};
+  uint64_t numEvents_{0};
+  uint64_t numDroppedEvents_{0};
+  // Dropped since the last batch the sink accepted.
+  uint64_t unreportedDroppedEvents_{0};
+};
+} // namespace quic
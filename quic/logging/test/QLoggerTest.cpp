@@ -12,7 +12,10 @@
 #include <gtest/gtest.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/congestion_control/Bbr.h>
+#include <quic/logging/BinaryQLogger.h>
 #include <quic/logging/FileQLogger.h>
+#include <quic/logging/QLogSampler.h>
+#include <quic/logging/StreamingQLogger.h>
 
 using namespace testing;
 
@@ -1171,4 +1174,252 @@ TEST_F(QLoggerTest, PaddingFramesFollyDynamic) {
   EXPECT_EQ(expected, gotEvents);
 }
 
+class TestQLogSink : public QLogSink {
+ public:
+  bool write(std::string batch) override {
+    if (rejectWrites) {
+      return false;
+    }
+    batches.push_back(std::move(batch));
+    return true;
+  }
+
+  std::vector<folly::dynamic> lines() const {
+    std::vector<folly::dynamic> result;
+    for (const auto& batch : batches) {
+      std::vector<folly::StringPiece> batchLines;
+      folly::split('\n', batch, batchLines, true);
+      for (auto line : batchLines) {
+        result.push_back(folly::parseJson(line));
+      }
+    }
+    return result;
+  }
+
+  bool rejectWrites{false};
+  std::vector<std::string> batches;
+};
+
+TEST_F(QLoggerTest, StreamingQLoggerBatches) {
+  auto sink = std::make_shared<TestQLogSink>();
+  // Small enough that every event fills a batch.
+  StreamingQLogger q(VantagePoint::SERVER, sink, 1);
+  q.dcid = getTestConnectionId(0);
+  q.addTransportStateUpdate("update");
+  EXPECT_EQ(1, sink->batches.size());
+  q.addPacketDrop(5, "reason");
+  EXPECT_EQ(2, sink->batches.size());
+  EXPECT_EQ(2, q.numEvents());
+
+  auto lines = sink->lines();
+  ASSERT_EQ(3, lines.size());
+  EXPECT_EQ(kQLogVersion, lines[0][kQLogVersionField].asString());
+  EXPECT_EQ(
+      getTestConnectionId(0).hex(),
+      lines[0]["common_fields"]["dcid"].asString());
+  EXPECT_EQ("TRANSPORT_STATE_UPDATE", lines[1][2].asString());
+  EXPECT_EQ("PACKET_DROP", lines[2][2].asString());
+}
+
+TEST_F(QLoggerTest, StreamingQLoggerFlushesOnDestruction) {
+  auto sink = std::make_shared<TestQLogSink>();
+  {
+    StreamingQLogger q(VantagePoint::CLIENT, sink);
+    q.addTransportStateUpdate("update");
+    q.addTransportStateUpdate("update");
+    EXPECT_TRUE(sink->batches.empty());
+  }
+  ASSERT_EQ(1, sink->batches.size());
+  EXPECT_EQ(3, sink->lines().size());
+}
+
+TEST_F(QLoggerTest, StreamingQLoggerReportsDrops) {
+  auto sink = std::make_shared<TestQLogSink>();
+  StreamingQLogger q(VantagePoint::CLIENT, sink, 1);
+  sink->rejectWrites = true;
+  q.addTransportStateUpdate("update");
+  q.addTransportStateUpdate("update");
+  EXPECT_EQ(2, q.numDroppedEvents());
+
+  sink->rejectWrites = false;
+  q.addTransportStateUpdate("update");
+  auto lines = sink->lines();
+  // The header is only written once the sink accepts a batch.
+  ASSERT_EQ(3, lines.size());
+  EXPECT_EQ(kQLogVersion, lines[0][kQLogVersionField].asString());
+  EXPECT_EQ(2, lines[1][kQLogDroppedEventsField].asInt());
+  EXPECT_EQ("TRANSPORT_STATE_UPDATE", lines[2][2].asString());
+  EXPECT_EQ(2, q.numDroppedEvents());
+}
+
+TEST_F(QLoggerTest, FilterEventTypes) {
+  FileQLogger q(VantagePoint::CLIENT);
+  q.setEventTypes({QLogEventType::PacketDrop});
+  q.addTransportStateUpdate("update");
+  q.addPacketDrop(5, "reason");
+  ASSERT_EQ(1, q.logs.size());
+  EXPECT_EQ(QLogEventType::PacketDrop, q.logs[0]->eventType);
+
+  // No types means all of them.
+  q.setEventTypes({});
+  q.addTransportStateUpdate("update");
+  EXPECT_EQ(2, q.logs.size());
+}
+
+// Logs the same events to both loggers.
+void logTestEvents(QLogger& q) {
+  q.addPacket(createRegularQuicWritePacket(10, 0, 100, true), 120);
+  q.addPacket(createPacketWithPaddingFrames(), 100);
+  RegularQuicPacket readPacket(
+      ShortHeader(ProtectionType::KeyPhaseZero, getTestConnectionId(1), 7));
+  ReadAckFrame ackFrame;
+  ackFrame.ackBlocks.emplace_back(3, 5);
+  readPacket.frames.emplace_back(std::move(ackFrame));
+  readPacket.frames.emplace_back(MaxDataFrame(1000));
+  readPacket.frames.emplace_back(QuicSimpleFrame(PingFrame()));
+  q.addPacket(readPacket, 50);
+  q.addPacket(createVersionNegotiationPacket(), 10, true);
+  q.addCongestionMetricUpdate(10, 20, kCongestionPacketAck, "Steady");
+  q.addCongestionMetricUpdate(30, 40, kCongestionPacketAck, "Steady");
+  q.addAppLimitedUpdate();
+  q.addPacketDrop(5, kCipherUnavailable);
+  q.addMetricUpdate(10us, 5us, 8us, 1us);
+  q.addStreamStateUpdate(4, kOnEOM, std::chrono::milliseconds(20));
+  q.addStreamStateUpdate(8, kAbort, folly::none);
+  q.addConnectionClose("error", "reason", true, false);
+  q.addTransportSummary(1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+}
+
+TEST_F(QLoggerTest, BinaryQLoggerRoundTrip) {
+  FileQLogger fileQLogger(VantagePoint::SERVER);
+  BinaryQLogger binaryQLogger(VantagePoint::SERVER);
+  binaryQLogger.dcid = getTestConnectionId(2);
+  logTestEvents(fileQLogger);
+  logTestEvents(binaryQLogger);
+  EXPECT_EQ(fileQLogger.logs.size(), binaryQLogger.numEvents());
+
+  auto parsed = parseBinaryQLog(folly::StringPiece(binaryQLogger.serialize()));
+  EXPECT_EQ(VantagePoint::SERVER, parsed->vantagePoint);
+  EXPECT_EQ(getTestConnectionId(2), *parsed->dcid);
+  EXPECT_FALSE(parsed->scid.hasValue());
+  ASSERT_EQ(fileQLogger.logs.size(), parsed->logs.size());
+  for (size_t i = 0; i < parsed->logs.size(); ++i) {
+    auto expected = fileQLogger.logs[i]->toDynamic();
+    auto got = parsed->logs[i]->toDynamic();
+    // The loggers were called at different times.
+    expected[0] = got[0] = "0";
+    EXPECT_EQ(expected, got);
+  }
+}
+
+TEST_F(QLoggerTest, BinaryQLoggerInternsStrings) {
+  BinaryQLogger q(VantagePoint::CLIENT);
+  q.addTransportStateUpdate(std::string(100, 'a'));
+  auto firstSize = q.size();
+  q.addTransportStateUpdate(std::string(100, 'a'));
+  EXPECT_LT(q.size() - firstSize, 10);
+}
+
+TEST_F(QLoggerTest, BinaryQLoggerDropsPastMaxBytes) {
+  BinaryQLogger q(VantagePoint::CLIENT, kHTTP3ProtocolType, 16, 64);
+  for (int i = 0; i < 20; ++i) {
+    q.addPacketsLost(i, 1000, 1);
+  }
+  EXPECT_LE(q.size(), 64);
+  EXPECT_GT(q.numDroppedEvents(), 0);
+  EXPECT_EQ(20, q.numEvents() + q.numDroppedEvents());
+  auto parsed = parseBinaryQLog(folly::StringPiece(q.serialize()));
+  EXPECT_EQ(q.numEvents(), parsed->logs.size());
+}
+
+TEST_F(QLoggerTest, BinaryQLoggerFilterEventTypes) {
+  BinaryQLogger q(VantagePoint::CLIENT);
+  q.setEventTypes({QLogEventType::PacketDrop});
+  q.addTransportStateUpdate("update");
+  q.addPacketDrop(5, "reason");
+  EXPECT_EQ(1, q.numEvents());
+  auto parsed = parseBinaryQLog(folly::StringPiece(q.serialize()));
+  ASSERT_EQ(1, parsed->logs.size());
+  EXPECT_EQ(QLogEventType::PacketDrop, parsed->logs[0]->eventType);
+}
+
+TEST_F(QLoggerTest, BinaryQLogMalformed) {
+  BinaryQLogger q(VantagePoint::CLIENT);
+  q.addPacketDrop(5, "reason");
+  auto data = q.serialize();
+  EXPECT_THROW(
+      parseBinaryQLog(folly::StringPiece(data).subpiece(0, data.size() - 1)),
+      std::invalid_argument);
+  EXPECT_THROW(
+      parseBinaryQLog(folly::StringPiece("not a qlog")), std::invalid_argument);
+}
+
+QLogSampler::QLoggerFactory makeFileQLoggerFactory() {
+  return [](VantagePoint vantagePoint) {
+    return std::make_shared<FileQLogger>(vantagePoint);
+  };
+}
+
+TEST_F(QLoggerTest, QLogSamplerConnectionPercent) {
+  QLogSamplingSettings none;
+  QLogSampler noneSampler(none, makeFileQLoggerFactory());
+  QLogSamplingSettings all;
+  all.connectionPercent = 100;
+  QLogSampler allSampler(all, makeFileQLoggerFactory());
+  for (uint8_t i = 0; i < 20; ++i) {
+    EXPECT_EQ(
+        nullptr,
+        noneSampler.maybeCreateForNewConnection(
+            getTestConnectionId(i), VantagePoint::SERVER));
+    EXPECT_NE(
+        nullptr,
+        allSampler.maybeCreateForNewConnection(
+            getTestConnectionId(i), VantagePoint::SERVER));
+  }
+
+  QLogSamplingSettings half;
+  half.connectionPercent = 50;
+  QLogSampler halfSampler(half, makeFileQLoggerFactory());
+  auto connId = getTestConnectionId(3);
+  bool sampled =
+      halfSampler.maybeCreateForNewConnection(connId, VantagePoint::SERVER) !=
+      nullptr;
+  // The choice only depends on the connection id.
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(
+        sampled,
+        halfSampler.maybeCreateForNewConnection(
+            connId, VantagePoint::SERVER) != nullptr);
+  }
+}
+
+TEST_F(QLoggerTest, QLogSamplerLossTriggers) {
+  QLogSamplingSettings settings;
+  QLogSampler noTriggers(settings, makeFileQLoggerFactory());
+  EXPECT_FALSE(noTriggers.hasLossTriggers());
+  EXPECT_EQ(
+      nullptr,
+      noTriggers.maybeCreateForLossyConnection(100, 100, VantagePoint::SERVER));
+
+  settings.retransmissionThreshold = 10;
+  settings.ptoThreshold = 3;
+  settings.eventTypes = {QLogEventType::PacketsLost};
+  QLogSampler sampler(settings, makeFileQLoggerFactory());
+  EXPECT_TRUE(sampler.hasLossTriggers());
+  EXPECT_EQ(
+      nullptr,
+      sampler.maybeCreateForLossyConnection(9, 2, VantagePoint::SERVER));
+  EXPECT_NE(
+      nullptr,
+      sampler.maybeCreateForLossyConnection(10, 0, VantagePoint::SERVER));
+  auto qLogger =
+      sampler.maybeCreateForLossyConnection(0, 3, VantagePoint::SERVER);
+  ASSERT_NE(nullptr, qLogger);
+  qLogger->addTransportStateUpdate("update");
+  qLogger->addPacketsLost(1, 10, 1);
+  auto fileQLogger = std::dynamic_pointer_cast<FileQLogger>(qLogger);
+  ASSERT_EQ(1, fileQLogger->logs.size());
+  EXPECT_EQ(QLogEventType::PacketsLost, fileQLogger->logs[0]->eventType);
+}
+
 } // namespace quic::test
@@ -27,6 +27,94 @@ bool isPersistentCongestion(
       pto * kPersistentCongestionThreshold;
 }
 
+std::chrono::microseconds getRackReorderingWindow(
+    const QuicConnectionStateBase& conn) noexcept {
+  const auto& lossState = conn.lossState;
+  if (lossState.mrtt == kDefaultMinRtt) {
+    // No rtt sample yet.
+    return 0us;
+  }
+  auto window = lossState.mrtt / kRackReorderingWindowDivisor *
+      lossState.reorderingWindowMultiplier;
+  return lossState.srtt > 0us ? std::min(window, lossState.srtt) : window;
+}
+
+void recordLostPacket(
+    QuicConnectionStateBase& conn,
+    const OutstandingPacket& packet) {
+  auto& lostPackets = conn.lossState.recentLostPackets;
+  if (lostPackets.size() == kMaxRecentLostPackets) {
+    lostPackets.pop_front();
+  }
+  lostPackets.push_back(LossState::LostPacket{packet.packetNum,
+                                              packet.packetNumberSpace,
+                                              packet.time,
+                                              packet.encodedSize});
+}
+
+void onRackLossEvent(QuicConnectionStateBase& conn) noexcept {
+  auto& lossState = conn.lossState;
+  if (lossState.reorderingWindowMultiplier > 1 &&
+      ++lossState.lossEventsSinceReorderingWindowIncrease >=
+          kRackReorderingWindowPersistence) {
+    lossState.reorderingWindowMultiplier = 1;
+    lossState.lossEventsSinceReorderingWindowIncrease = 0;
+  }
+}
+
+folly::Optional<CongestionController::LossEvent> detectSpuriousLosses(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    TimePoint ackTime) {
+  auto& lossState = conn.lossState;
+  folly::Optional<CongestionController::LossEvent> spuriousLoss;
+  auto it = lossState.recentLostPackets.begin();
+  while (it != lossState.recentLostPackets.end()) {
+    auto packetNum = it->packetNum;
+    bool acked = it->packetNumberSpace == pnSpace &&
+        std::any_of(frame.ackBlocks.begin(),
+                    frame.ackBlocks.end(),
+                    [packetNum](const auto& block) {
+                      return block.startPacket <= packetNum &&
+                          packetNum <= block.endPacket;
+                    });
+    if (!acked) {
+      ++it;
+      continue;
+    }
+    if (!spuriousLoss) {
+      spuriousLoss.emplace(ackTime);
+    }
+    spuriousLoss->largestLostPacketNum =
+        std::max(packetNum, spuriousLoss->largestLostPacketNum.value_or(0));
+    spuriousLoss->lostBytes += it->encodedSize;
+    spuriousLoss->lostPackets++;
+    spuriousLoss->largestLostSentTime = std::max(
+        it->sentTime, spuriousLoss->largestLostSentTime.value_or(it->sentTime));
+    spuriousLoss->smallestLostSentTime = std::min(
+        it->sentTime,
+        spuriousLoss->smallestLostSentTime.value_or(it->sentTime));
+    VLOG(10) << __func__ << " spurious loss packetNum=" << packetNum << " "
+             << conn;
+    it = lossState.recentLostPackets.erase(it);
+  }
+  if (!spuriousLoss) {
+    return folly::none;
+  }
+  lossState.spuriousLossCount += spuriousLoss->lostPackets;
+  QUIC_STATS(conn.infoCallback, onSpuriousLoss, spuriousLoss->lostPackets);
+  lossState.reorderingSeen = true;
+  // Widen the reordering window at most once per round trip.
+  if (!lossState.lastReorderingWindowIncrease ||
+      ackTime - *lossState.lastReorderingWindowIncrease > lossState.srtt) {
+    ++lossState.reorderingWindowMultiplier;
+    lossState.lastReorderingWindowIncrease = ackTime;
+    lossState.lossEventsSinceReorderingWindowIncrease = 0;
+  }
+  return spuriousLoss;
+}
+
 void onPTOAlarm(QuicConnectionStateBase& conn) {
   VLOG(10) << __func__ << " " << conn;
   QUIC_TRACE(
@@ -95,9 +183,7 @@ void markPacketLoss(
         if (!stream) {
           break;
         }
-        auto bufferItr = std::lower_bound(
-            stream->retransmissionBuffer.begin(),
-            stream->retransmissionBuffer.end(),
+        auto bufferItr = stream->retransmissionBuffer.lowerBound(
             frame.offset,
             [](const auto& buffer, const auto& offset) {
               return buffer.offset < offset;
@@ -114,9 +200,7 @@ void markPacketLoss(
           break;
         }
         stream->lossBuffer.insert(
-            std::upper_bound(
-                stream->lossBuffer.begin(),
-                stream->lossBuffer.end(),
+            stream->lossBuffer.upperBound(
                 bufferItr->offset,
                 [](const auto& offset, const auto& buffer) {
                   return offset < buffer.offset;
@@ -135,9 +219,7 @@ void markPacketLoss(
         auto encryptionLevel = protectionTypeToEncryptionLevel(protectionType);
         auto cryptoStream = getCryptoStream(*conn.cryptoState, encryptionLevel);
 
-        auto bufferItr = std::lower_bound(
-            cryptoStream->retransmissionBuffer.begin(),
-            cryptoStream->retransmissionBuffer.end(),
+        auto bufferItr = cryptoStream->retransmissionBuffer.lowerBound(
             frame.offset,
             [](const auto& buffer, const auto& offset) {
               return buffer.offset < offset;
@@ -149,9 +231,7 @@ void markPacketLoss(
         }
         DCHECK_EQ(bufferItr->offset, frame.offset);
         cryptoStream->lossBuffer.insert(
-            std::upper_bound(
-                cryptoStream->lossBuffer.begin(),
-                cryptoStream->lossBuffer.end(),
+            cryptoStream->lossBuffer.upperBound(
                 bufferItr->offset,
                 [](const auto& offset, const auto& buffer) {
                   return offset < buffer.offset;
@@ -42,6 +42,37 @@ bool isPersistentCongestion(
     TimePoint lostPeriodStart,
     TimePoint lostPeriodEnd) noexcept;
 
+/**
+ * The RACK reordering window: the min rtt, scaled by the reordering window
+ * multiplier, and at most the srtt.
+ */
+std::chrono::microseconds getRackReorderingWindow(
+    const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * With rackLossDetection, remembers a lost packet so that an ack for it can
+ * be told apart as a spurious loss.
+ */
+void recordLostPacket(
+    QuicConnectionStateBase& conn,
+    const OutstandingPacket& packet);
+
+/**
+ * Counts a loss event for the decay of the RACK reordering window.
+ */
+void onRackLossEvent(QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Finds the recently lost packets of pnSpace that frame acks, and updates the
+ * reordering state and the counters. Returns the spurious losses as a loss
+ * event, none if there are none.
+ */
+folly::Optional<CongestionController::LossEvent> detectSpuriousLosses(
+    QuicConnectionStateBase& conn,
+    PacketNumberSpace pnSpace,
+    const ReadAckFrame& frame,
+    TimePoint ackTime);
+
 inline std::ostream& operator<<(
     std::ostream& os,
     const LossState::AlarmMethod& alarmMethod) {
@@ -105,8 +136,7 @@ calculateAlarmDuration(const QuicConnectionStateBase& conn) {
         std::chrono::duration_cast<std::chrono::milliseconds>(
             lastSentPacketTime + alarmDuration - now);
   } else {
-    auto lastSentPacketNum =
-        conn.outstandingPackets.back().packet.header.getPacketSequenceNum();
+    auto lastSentPacketNum = conn.outstandingPackets.back().packetNum;
     VLOG(10) << __func__ << " alarm already due method=" << *alarmMethod
              << " lastSentPacketNum=" << lastSentPacketNum
              << " lastSentPacketTime="
@@ -211,38 +241,110 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     TimePoint lossTime,
     PacketNumberSpace pnSpace) {
   getLossTime(conn, pnSpace).clear();
-  std::chrono::microseconds delayUntilLost =
-      std::max(conn.lossState.srtt, conn.lossState.lrtt) * 9 / 8;
+  bool rack = conn.transportSettings.rackLossDetection;
+  std::chrono::microseconds delayUntilLost = rack
+      ? conn.lossState.lrtt + getRackReorderingWindow(conn)
+      : std::max(conn.lossState.srtt, conn.lossState.lrtt) * 9 / 8;
+  // RACK only relies on the time threshold once the path reorders.
+  bool usePacketThreshold = !rack || !conn.lossState.reorderingSeen;
   VLOG(10) << __func__ << " outstanding=" << conn.outstandingPackets.size()
            << " largestAcked=" << largestAcked
            << " delayUntilLost=" << delayUntilLost.count() << "us"
            << " " << conn;
   CongestionController::LossEvent lossEvent(lossTime);
+  // The packets of every path are only compared with the later packets of
+  // the same path, since the other paths reorder them. The secondary paths
+  // only rely on the time threshold.
+  bool multipath =
+      !conn.secondaryPaths.empty() && pnSpace == PacketNumberSpace::AppData;
+  PacketNum primaryLargestAcked = multipath
+      ? conn.lossState.largestPrimaryPathAcked.value_or(0)
+      : largestAcked;
+  std::vector<std::pair<PathId, CongestionController::LossEvent>> pathLosses;
+  auto delayUntilLostOn = [&](const OutstandingPacket& pkt) {
+    auto path = multipath ? findSecondaryPath(conn, pkt.pathId) : nullptr;
+    return path ? std::max(path->srtt, path->lrtt) * 9 / 8 : delayUntilLost;
+  };
+  // Once a packet isn't lost, the later packets of its path aren't either,
+  // since both thresholds only grow with the packet number and the send time.
+  // With several paths the scan goes on until every path has such a packet.
+  // The packets of secondary paths that are gone count as primary ones.
+  std::vector<PathId> settledPaths;
+  // The first packet of the space the scan leaves outstanding, which is where
+  // the loss timer search below starts.
+  folly::Optional<OutstandingPacketQueue::iterator> firstKept;
   // Note that time based loss detection is also within the same PNSpace.
   auto iter = getFirstOutstandingPacket(conn, pnSpace);
   bool shouldSetTimer = false;
   while (iter != conn.outstandingPackets.end()) {
     auto& pkt = *iter;
-    auto currentPacketNum = pkt.packet.header.getPacketSequenceNum();
+    auto currentPacketNum = pkt.packetNum;
     if (currentPacketNum >= largestAcked) {
       break;
     }
-    auto currentPacketNumberSpace = pkt.packet.header.getPacketNumberSpace();
+    auto currentPacketNumberSpace = pkt.packetNumberSpace;
     if (currentPacketNumberSpace != pnSpace) {
       iter++;
       continue;
     }
-    bool lost = (lossTime - pkt.time) > delayUntilLost;
-    lost = lost ||
-        (largestAcked - currentPacketNum) > conn.lossState.reorderingThreshold;
+    auto path = multipath ? findSecondaryPath(conn, pkt.pathId) : nullptr;
+    auto settledPathId = path ? path->id : kPrimaryPathId;
+    if (multipath &&
+        std::find(settledPaths.begin(), settledPaths.end(), settledPathId) !=
+            settledPaths.end()) {
+      iter++;
+      continue;
+    }
+    bool lost;
+    if (path) {
+      lost = path->largestAckedPacket &&
+          *path->largestAckedPacket > currentPacketNum &&
+          (lossTime - pkt.time) > delayUntilLostOn(pkt);
+    } else {
+      lost = currentPacketNum < primaryLargestAcked &&
+          (lossTime - pkt.time) > delayUntilLost;
+      lost = lost ||
+          (usePacketThreshold && currentPacketNum < primaryLargestAcked &&
+           (primaryLargestAcked - currentPacketNum) >
+               conn.lossState.reorderingThreshold);
+    }
     if (!lost) {
-      // We can exit early here because if packet N doesn't meet the
-      // threshold, then packet N + 1 will not either.
       shouldSetTimer = true;
-      break;
+      if (!firstKept) {
+        firstKept = iter;
+      }
+      if (!multipath) {
+        // We can exit early here because if packet N doesn't meet the
+        // threshold, then packet N + 1 will not either.
+        break;
+      }
+      settledPaths.push_back(settledPathId);
+      if (settledPaths.size() > conn.secondaryPaths.size()) {
+        break;
+      }
+      // The packets of the other paths can still be lost.
+      iter++;
+      continue;
     }
     if (!pkt.pureAck) {
-      lossEvent.addLostPacket(pkt);
+      if (path) {
+        auto it = std::find_if(
+            pathLosses.begin(), pathLosses.end(), [&](const auto& entry) {
+              return entry.first == path->id;
+            });
+        if (it == pathLosses.end()) {
+          pathLosses.emplace_back(
+              path->id, CongestionController::LossEvent(lossTime));
+          it = std::prev(pathLosses.end());
+        }
+        it->second.addLostPacket(pkt);
+      } else if (pkt.pathId == kPrimaryPathId) {
+        lossEvent.addLostPacket(pkt);
+        if (rack) {
+          recordLostPacket(conn, pkt);
+        }
+        onPmtuPacketLost(conn, pkt.encodedSize);
+      }
     } else {
       DCHECK_GT(conn.outstandingPureAckPacketsCount, 0);
       --conn.outstandingPureAckPacketsCount;
@@ -252,13 +354,15 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
       --conn.outstandingClonedPacketsCount;
     }
     // Invoke LossVisitor if the packet doesn't have a associated PacketEvent;
-    // or if the PacketEvent is present in conn.outstandingPacketEvents.
+    // or if the PacketEvent is outstanding in conn.outstandingPacketEvents.
     bool processed = pkt.associatedEvent &&
         !conn.outstandingPacketEvents.count(*pkt.associatedEvent);
     lossVisitor(conn, pkt.packet, processed, currentPacketNum);
-    // Remove the PacketEvent from the outstandingPacketEvents set
+    // Mark the PacketEvent as processed in the outstandingPacketEvents table
     if (pkt.associatedEvent) {
       conn.outstandingPacketEvents.erase(*pkt.associatedEvent);
+      conn.outstandingPacketEvents.removePacket(
+          *pkt.associatedEvent, currentPacketNum);
     }
     if (pkt.isHandshake) {
       DCHECK(conn.outstandingHandshakePacketsCount);
@@ -270,7 +374,10 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
     iter = conn.outstandingPackets.erase(iter);
   }
 
-  auto earliest = getFirstOutstandingPacket(conn, pnSpace);
+  // Everything of this space before where the scan stopped is gone, other
+  // than the packets it kept.
+  auto earliest = getNextOutstandingPacket(
+      conn, pnSpace, firstKept ? *firstKept : iter);
   for (; earliest != conn.outstandingPackets.end();
        earliest = getNextOutstandingPacket(conn, pnSpace, earliest + 1)) {
     if (!earliest->pureAck &&
@@ -286,7 +393,14 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
              << conn.outstandingPackets.empty() << " delayUntilLost"
              << delayUntilLost.count() << "us"
              << " " << conn;
-    getLossTime(conn, pnSpace) = delayUntilLost + earliest->time;
+    getLossTime(conn, pnSpace) = delayUntilLostOn(*earliest) + earliest->time;
+  }
+  for (auto& pathLoss : pathLosses) {
+    auto path = findSecondaryPath(conn, pathLoss.first);
+    if (path && path->congestionController) {
+      path->congestionController->onPacketAckOrLoss(
+          folly::none, std::move(pathLoss.second));
+    }
   }
   if (lossEvent.largestLostPacketNum.hasValue()) {
     DCHECK(lossEvent.largestLostSentTime && lossEvent.smallestLostSentTime);
@@ -302,8 +416,18 @@ folly::Optional<CongestionController::LossEvent> detectLossPackets(
         *lossEvent.largestLostPacketNum,
         lossEvent.lostBytes,
         lossEvent.lostPackets);
+    QUIC_SDT(
+        packets_lost,
+        conn,
+        static_cast<uint8_t>(pnSpace),
+        *lossEvent.largestLostPacketNum,
+        lossEvent.lostBytes,
+        lossEvent.lostPackets);
 
     conn.lossState.rtxCount += lossEvent.lostPackets;
+    if (rack) {
+      onRackLossEvent(conn);
+    }
     if (conn.congestionController) {
       return lossEvent;
     }
@@ -342,8 +466,8 @@ void onHandshakeAlarm(
     // the word "handshake" in our code base is unfortunately overloaded.
     if (iter->isHandshake) {
       auto& packet = *iter;
-      auto currentPacketNum = packet.packet.header.getPacketSequenceNum();
-      auto currentPacketNumSpace = packet.packet.header.getPacketNumberSpace();
+      auto currentPacketNum = packet.packetNum;
+      auto currentPacketNumSpace = packet.packetNumberSpace;
       VLOG(10) << "HandshakeAlarm, removing packetNum=" << currentPacketNum
                << " packetNumSpace=" << currentPacketNumSpace << " " << conn;
       DCHECK(!packet.pureAck);
@@ -398,6 +522,11 @@ void onLossDetectionAlarm(
           *lossEvent->largestLostSentTime);
       conn.congestionController->onPacketAckOrLoss(
           folly::none, std::move(lossEvent));
+      QUIC_SDT(
+          congestion_window,
+          conn,
+          conn.congestionController->getCongestionWindow(),
+          conn.congestionController->getWritableBytes());
     }
   } else if (
       conn.lossState.currentAlarmMethod == LossState::AlarmMethod::Handshake) {
@@ -469,21 +598,22 @@ void markZeroRttPacketsLost(
   CongestionController::LossEvent lossEvent(ClockType::now());
   auto iter = getFirstOutstandingPacket(conn, PacketNumberSpace::AppData);
   while (iter != conn.outstandingPackets.end()) {
-    DCHECK_EQ(
-        iter->packet.header.getPacketNumberSpace(), PacketNumberSpace::AppData);
+    DCHECK_EQ(iter->packetNumberSpace, PacketNumberSpace::AppData);
     auto isZeroRttPacket =
         iter->packet.header.getProtectionType() == ProtectionType::ZeroRtt;
     if (isZeroRttPacket) {
       auto& pkt = *iter;
       DCHECK(!pkt.pureAck);
       DCHECK(!pkt.isHandshake);
-      auto currentPacketNum = pkt.packet.header.getPacketSequenceNum();
+      auto currentPacketNum = pkt.packetNum;
       bool processed = pkt.associatedEvent &&
           !conn.outstandingPacketEvents.count(*pkt.associatedEvent);
       lossVisitor(conn, pkt.packet, processed, currentPacketNum);
-      // Remove the PacketEvent from the outstandingPacketEvents set
+      // Mark the PacketEvent as processed in the outstandingPacketEvents table
       if (pkt.associatedEvent) {
         conn.outstandingPacketEvents.erase(*pkt.associatedEvent);
+        conn.outstandingPacketEvents.removePacket(
+            *pkt.associatedEvent, currentPacketNum);
         DCHECK_GT(conn.outstandingClonedPacketsCount, 0);
         --conn.outstandingClonedPacketsCount;
       }
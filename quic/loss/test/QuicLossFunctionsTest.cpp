@@ -1492,6 +1492,130 @@ TEST_F(QuicLossFunctionsTest, TimeThreshold) {
       PacketNumberSpace::AppData);
 }
 
+TEST_F(QuicLossFunctionsTest, SecondaryPathLossScanStopsOnceSettled) {
+  auto conn = createConn();
+  // Only the packet threshold applies to the primary path.
+  conn->lossState.srtt = 10s;
+  conn->lossState.reorderingThreshold = 3;
+  conn->lossState.largestPrimaryPathAcked = 9;
+  SecondaryPath path;
+  path.id = conn->nextPathId++;
+  path.srtt = 1s;
+  path.largestAckedPacket = 10;
+  conn->secondaryPaths.push_back(std::move(path));
+
+  // Odd packets on the primary path, even ones on the secondary path.
+  auto now = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 10; packetNum++) {
+    OutstandingPacket packet(
+        createNewPacket(packetNum, PacketNumberSpace::AppData),
+        packetNum == 2 ? now - 2s : now,
+        1,
+        false,
+        false,
+        packetNum);
+    packet.pathId = packetNum % 2 ? kPrimaryPathId : 1;
+    conn->outstandingPackets.push_back(std::move(packet));
+  }
+
+  std::vector<PacketNum> lostPackets;
+  auto lossVisitor =
+      [&](auto& /*conn*/, auto& /*packet*/, bool, PacketNum packetNum) {
+        lostPackets.push_back(packetNum);
+      };
+  detectLossPackets<decltype(lossVisitor)>(
+      *conn, 10, lossVisitor, now + 100ms, PacketNumberSpace::AppData);
+  EXPECT_EQ(std::vector<PacketNum>({1, 2, 3, 5}), lostPackets);
+  EXPECT_EQ(6, conn->outstandingPackets.size());
+  // The loss timer is armed for packet 4, the earliest one left.
+  ASSERT_TRUE(conn->lossState.appDataLossTime.hasValue());
+  EXPECT_EQ(now + 1125ms, *conn->lossState.appDataLossTime);
+}
+
+TEST_F(QuicLossFunctionsTest, RackSpuriousLoss) {
+  auto conn = createConn();
+  conn->transportSettings.rackLossDetection = true;
+  conn->lossState.srtt = 10ms;
+  conn->lossState.lrtt = 10ms;
+  conn->lossState.mrtt = 8ms;
+  EXPECT_EQ(2ms, getRackReorderingWindow(*conn));
+  auto noopLossVisitor = [](auto&, auto&, bool, PacketNum) {};
+  auto referenceTime = Clock::now();
+  std::vector<PacketNum> packets;
+  for (int i = 0; i < 6; ++i) {
+    packets.push_back(sendPacket(
+        *conn, referenceTime, false, folly::none, PacketType::OneRtt));
+  }
+  // The packet threshold applies until reordering is seen.
+  auto lossEvent = detectLossPackets(
+      *conn,
+      packets.back(),
+      noopLossVisitor,
+      referenceTime + 1ms,
+      PacketNumberSpace::AppData);
+  ASSERT_TRUE(lossEvent.hasValue());
+  EXPECT_EQ(2, lossEvent->lostPackets);
+  EXPECT_EQ(2, conn->lossState.recentLostPackets.size());
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = packets[1];
+  ackFrame.ackBlocks.emplace_back(packets[1], packets[1]);
+  // Acks for the other packet number spaces don't match.
+  EXPECT_FALSE(detectSpuriousLosses(
+                   *conn,
+                   PacketNumberSpace::Handshake,
+                   ackFrame,
+                   referenceTime + 2ms)
+                   .hasValue());
+  auto spuriousLoss = detectSpuriousLosses(
+      *conn, PacketNumberSpace::AppData, ackFrame, referenceTime + 2ms);
+  ASSERT_TRUE(spuriousLoss.hasValue());
+  EXPECT_EQ(1, spuriousLoss->lostPackets);
+  EXPECT_EQ(packets[1], *spuriousLoss->largestLostPacketNum);
+  EXPECT_EQ(1, conn->lossState.spuriousLossCount);
+  EXPECT_TRUE(conn->lossState.reorderingSeen);
+  EXPECT_EQ(2, conn->lossState.reorderingWindowMultiplier);
+  EXPECT_EQ(4ms, getRackReorderingWindow(*conn));
+  EXPECT_EQ(1, conn->lossState.recentLostPackets.size());
+
+  // The window only grows once per srtt.
+  ackFrame.ackBlocks.clear();
+  ackFrame.ackBlocks.emplace_back(packets[0], packets[0]);
+  EXPECT_TRUE(detectSpuriousLosses(
+                  *conn,
+                  PacketNumberSpace::AppData,
+                  ackFrame,
+                  referenceTime + 3ms)
+                  .hasValue());
+  EXPECT_EQ(2, conn->lossState.spuriousLossCount);
+  EXPECT_EQ(2, conn->lossState.reorderingWindowMultiplier);
+  EXPECT_TRUE(conn->lossState.recentLostPackets.empty());
+
+  // Now only the time threshold, lrtt plus the window, declares losses.
+  lossEvent = detectLossPackets(
+      *conn,
+      packets.back(),
+      noopLossVisitor,
+      referenceTime + 13ms,
+      PacketNumberSpace::AppData);
+  EXPECT_FALSE(lossEvent.hasValue());
+  lossEvent = detectLossPackets(
+      *conn,
+      packets.back(),
+      noopLossVisitor,
+      referenceTime + 15ms,
+      PacketNumberSpace::AppData);
+  ASSERT_TRUE(lossEvent.hasValue());
+  EXPECT_EQ(3, lossEvent->lostPackets);
+
+  // The window goes back to its initial size after enough loss events
+  // without spurious losses.
+  for (uint32_t i = 1; i < kRackReorderingWindowPersistence; ++i) {
+    onRackLossEvent(*conn);
+  }
+  EXPECT_EQ(1, conn->lossState.reorderingWindowMultiplier);
+}
+
 TEST_P(QuicLossFunctionsTest, CappedShiftNoCrash) {
   auto conn = createConn();
   conn->lossState.handshakeAlarmCount =
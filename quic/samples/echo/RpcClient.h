@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+
+#include <quic/api/QuicSocket.h>
+#include <quic/client/QuicClientTransport.h>
+#include <quic/common/Timers.h>
+#include <quic/common/test/TestUtils.h>
+#include <quic/samples/echo/RpcServer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace quic {
+namespace samples {
+
+/**
+ * Load generator for RpcServer. It opens numConnections connections, spread
+ * over numThreads threads, and keeps concurrency RPCs in flight on each of
+ * them for the duration of the run: every RPC is a new bidirectional stream
+ * carrying requestSize bytes with eof, and is done when the eof of the
+ * response is read. The latency of every RPC is recorded, and the throughput
+ * and the latency percentiles are logged at the end.
+ */
+class RpcClient {
+ public:
+  struct Options {
+    size_t numConnections{1};
+    size_t numThreads{1};
+    // The RPCs in flight on each connection.
+    size_t concurrency{1};
+    size_t requestSize{1024};
+    std::chrono::seconds duration{10};
+    TransportSettings transportSettings{
+        RpcServer::defaultTransportSettings()};
+  };
+
+  RpcClient(const std::string& host, uint16_t port, Options options)
+      : host_(host), port_(port), options_(std::move(options)) {}
+
+  void start() {
+    folly::SocketAddress addr(host_.c_str(), port_);
+    auto request = folly::IOBuf::create(options_.requestSize);
+    memset(request->writableData(), 'a', options_.requestSize);
+    request->append(options_.requestSize);
+    std::shared_ptr<const folly::IOBuf> sharedRequest = std::move(request);
+
+    std::vector<std::unique_ptr<folly::ScopedEventBaseThread>> threads;
+    auto numThreads = std::max<size_t>(options_.numThreads, 1);
+    for (size_t i = 0; i < numThreads; ++i) {
+      threads.push_back(
+          std::make_unique<folly::ScopedEventBaseThread>("RpcClientThread"));
+    }
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (size_t i = 0; i < options_.numConnections; ++i) {
+      auto evb = threads[i % numThreads]->getEventBase();
+      connections.push_back(
+          std::make_unique<Connection>(evb, options_, sharedRequest));
+      auto conn = connections.back().get();
+      evb->runInEventBaseThread([conn, addr] { conn->connect(addr); });
+    }
+    LOG(INFO) << "RpcClient running " << options_.numConnections
+              << " connections to " << addr.describe() << " for "
+              << options_.duration.count() << "s";
+
+    auto begin = Clock::now();
+    std::this_thread::sleep_for(options_.duration);
+    std::vector<uint64_t> latencies;
+    uint64_t numErrors = 0;
+    for (auto& conn : connections) {
+      conn->evb()->runInEventBaseThreadAndWait([&] {
+        conn->stop();
+        const auto& connLatencies = conn->latencies();
+        latencies.insert(
+            latencies.end(), connLatencies.begin(), connLatencies.end());
+        numErrors += conn->numErrors();
+      });
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - begin);
+    report(latencies, numErrors, elapsed);
+    for (auto& conn : connections) {
+      conn->evb()->runInEventBaseThreadAndWait([&] { conn.reset(); });
+    }
+  }
+
+ private:
+  class Connection : public quic::QuicSocket::ConnectionCallback,
+                     public quic::QuicSocket::ReadCallback {
+   public:
+    Connection(
+        folly::EventBase* evb,
+        const Options& options,
+        std::shared_ptr<const folly::IOBuf> request)
+        : evb_(evb), options_(options), request_(std::move(request)) {}
+
+    ~Connection() override {
+      if (client_) {
+        client_->close(folly::none);
+      }
+    }
+
+    folly::EventBase* evb() const {
+      return evb_;
+    }
+
+    void connect(const folly::SocketAddress& addr) {
+      auto sock = std::make_unique<folly::AsyncUDPSocket>(evb_);
+      client_ =
+          std::make_shared<quic::QuicClientTransport>(evb_, std::move(sock));
+      client_->setHostname("echo.com");
+      client_->setCertificateVerifier(test::createTestCertificateVerifier());
+      client_->addNewPeerAddress(addr);
+      client_->setTransportSettings(options_.transportSettings);
+      if (options_.transportSettings.pacingEnabled) {
+        client_->setPacingTimer(TimerHighRes::newTimer(
+            evb_, options_.transportSettings.pacingTimerTickInterval));
+      }
+      client_->start(this);
+    }
+
+    void stop() {
+      stopped_ = true;
+    }
+
+    const std::vector<uint64_t>& latencies() const {
+      return latencies_;
+    }
+
+    uint64_t numErrors() const {
+      return numErrors_;
+    }
+
+    void onTransportReady() noexcept override {
+      for (size_t i = 0; i < options_.concurrency; ++i) {
+        sendRequest();
+      }
+    }
+
+    void onNewBidirectionalStream(quic::StreamId id) noexcept override {
+      client_->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+    }
+
+    void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+      client_->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+    }
+
+    void onStopSending(
+        quic::StreamId id,
+        quic::ApplicationErrorCode /* error */) noexcept override {
+      client_->resetStream(id, GenericApplicationErrorCode::UNKNOWN);
+    }
+
+    void onConnectionEnd() noexcept override {}
+
+    void onConnectionError(
+        std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+      if (!stopped_) {
+        LOG(ERROR) << "RpcClient connection error=" << toString(error.first);
+      }
+    }
+
+    void readAvailable(quic::StreamId id) noexcept override {
+      auto res = client_->read(id, 0);
+      if (res.hasError()) {
+        ++numErrors_;
+        return;
+      }
+      if (!res->second) {
+        return;
+      }
+      auto it = requestTimes_.find(id);
+      if (it == requestTimes_.end()) {
+        return;
+      }
+      if (!stopped_) {
+        latencies_.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - it->second)
+                .count());
+      }
+      requestTimes_.erase(it);
+      sendRequest();
+    }
+
+    void readError(
+        quic::StreamId id,
+        std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+        /* error */) noexcept override {
+      if (requestTimes_.erase(id)) {
+        ++numErrors_;
+        sendRequest();
+      }
+    }
+
+   private:
+    void sendRequest() {
+      if (stopped_) {
+        return;
+      }
+      auto streamId = client_->createBidirectionalStream();
+      if (streamId.hasError()) {
+        // Out of streams, the connection runs with one less RPC in flight.
+        ++numErrors_;
+        return;
+      }
+      client_->setReadCallback(*streamId, this);
+      requestTimes_.emplace(*streamId, Clock::now());
+      auto res = client_->writeChain(*streamId, request_->clone(), true, false);
+      if (res.hasError()) {
+        ++numErrors_;
+        requestTimes_.erase(*streamId);
+      }
+    }
+
+    folly::EventBase* evb_;
+    const Options& options_;
+    std::shared_ptr<const folly::IOBuf> request_;
+    std::shared_ptr<quic::QuicClientTransport> client_;
+    std::unordered_map<quic::StreamId, TimePoint> requestTimes_;
+    std::vector<uint64_t> latencies_;
+    uint64_t numErrors_{0};
+    bool stopped_{false};
+  };
+
+  static void report(
+      std::vector<uint64_t>& latencies,
+      uint64_t numErrors,
+      std::chrono::microseconds elapsed) {
+    if (latencies.empty()) {
+      LOG(INFO) << "RpcClient completed no RPC, errors=" << numErrors;
+      return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+      auto index = static_cast<size_t>(p * (latencies.size() - 1));
+      return latencies[index];
+    };
+    LOG(INFO) << "RpcClient completed " << latencies.size() << " RPCs, "
+              << latencies.size() * 1000000 / elapsed.count() << " RPC/s"
+              << ", errors=" << numErrors;
+    LOG(INFO) << "RpcClient latency us: p50=" << percentile(0.5)
+              << " p90=" << percentile(0.9) << " p99=" << percentile(0.99)
+              << " p99.9=" << percentile(0.999)
+              << " max=" << latencies.back();
+  }
+
+  std::string host_;
+  uint16_t port_;
+  Options options_;
+};
+} // namespace samples
+} // namespace quic
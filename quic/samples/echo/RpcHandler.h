@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+
+#include <quic/api/QuicSocket.h>
+
+#include <memory>
+
+namespace quic {
+namespace samples {
+
+/**
+ * The server side of the RPC benchmark. Every bidirectional stream is one
+ * RPC: the request is read and dropped as it arrives, and once its eof is
+ * received the response is written with eof. The response is a clone of one
+ * buffer shared by all the connections, so answering doesn't copy or log
+ * anything.
+ *
+ * The handler owns itself, it is deleted in the loop after its connection
+ * ends.
+ */
+class RpcHandler : public quic::QuicSocket::ConnectionCallback,
+                   public quic::QuicSocket::ReadCallback {
+ public:
+  RpcHandler(
+      folly::EventBase* evb,
+      std::shared_ptr<const folly::IOBuf> response)
+      : evb_(evb), response_(std::move(response)) {}
+
+  void setQuicSocket(std::shared_ptr<quic::QuicSocket> sock) {
+    sock_ = std::move(sock);
+  }
+
+  void onNewBidirectionalStream(quic::StreamId id) noexcept override {
+    sock_->setReadCallback(id, this);
+  }
+
+  void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
+    // Requests are only sent on bidirectional streams.
+    sock_->stopSending(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onStopSending(
+      quic::StreamId id,
+      quic::ApplicationErrorCode /* error */) noexcept override {
+    sock_->resetStream(id, GenericApplicationErrorCode::UNKNOWN);
+  }
+
+  void onConnectionEnd() noexcept override {
+    destroy();
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    VLOG(4) << "RpcHandler connection error=" << toString(error.first);
+    destroy();
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    auto res = sock_->read(id, 0);
+    if (res.hasError()) {
+      LOG(ERROR) << "RpcHandler read error=" << toString(res.error());
+      return;
+    }
+    if (!res->second) {
+      return;
+    }
+    sock_->setReadCallback(id, nullptr);
+    auto writeRes =
+        sock_->writeChain(id, response_->clone(), true, false, nullptr);
+    if (writeRes.hasError()) {
+      LOG(ERROR) << "RpcHandler write error=" << toString(writeRes.error());
+    }
+  }
+
+  void readError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    VLOG(4) << "RpcHandler read error on stream=" << id
+            << " error=" << toString(error);
+  }
+
+ private:
+  void destroy() {
+    // The transport is still running the callback, so the handler and its
+    // reference to the transport are released in the loop.
+    evb_->runInLoop([this] { delete this; });
+  }
+
+  folly::EventBase* evb_;
+  std::shared_ptr<const folly::IOBuf> response_;
+  std::shared_ptr<quic::QuicSocket> sock_;
+};
+} // namespace samples
+} // namespace quic
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <quic/common/test/TestUtils.h>
+#include <quic/samples/echo/RpcHandler.h>
+#include <quic/server/QuicServer.h>
+#include <quic/server/QuicServerTransport.h>
+
+namespace quic {
+namespace samples {
+
+class RpcServerTransportFactory : public quic::QuicServerTransportFactory {
+ public:
+  explicit RpcServerTransportFactory(size_t responseSize)
+      : response_(makeResponse(responseSize)) {}
+
+  quic::QuicServerTransport::Ptr make(
+      folly::EventBase* evb,
+      std::unique_ptr<folly::AsyncUDPSocket> sock,
+      const folly::SocketAddress&,
+      std::shared_ptr<const fizz::server::FizzServerContext>
+          ctx) noexcept override {
+    CHECK_EQ(evb, sock->getEventBase());
+    auto handler = new RpcHandler(evb, response_);
+    auto transport =
+        quic::QuicServerTransport::make(evb, std::move(sock), *handler, ctx);
+    handler->setQuicSocket(transport);
+    return transport;
+  }
+
+ private:
+  static std::shared_ptr<const folly::IOBuf> makeResponse(size_t size) {
+    auto response = folly::IOBuf::create(size);
+    memset(response->writableData(), 'a', size);
+    response->append(size);
+    return std::move(response);
+  }
+
+  std::shared_ptr<const folly::IOBuf> response_;
+};
+
+/**
+ * The server of the RPC benchmark, see RpcClient. It runs a worker per
+ * thread, and its default settings are the configuration the library is
+ * benchmarked with: GSO, BBR with pacing, and the batched receive path.
+ */
+class RpcServer {
+ public:
+  struct Options {
+    // 0 runs a worker per hardware thread.
+    size_t numWorkers{0};
+    // The bytes written back for every request.
+    size_t responseSize{1024};
+    TransportSettings transportSettings{defaultTransportSettings()};
+  };
+
+  static TransportSettings defaultTransportSettings() {
+    TransportSettings settings;
+    settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+    settings.adaptiveBatchSize = true;
+    settings.defaultCongestionController = CongestionControlType::BBR;
+    settings.pacingEnabled = true;
+    settings.batchPacingRefresh = true;
+    settings.batchReceivedPackets = true;
+    settings.recvBufferPoolSize = kDefaultQuicMaxRecvBatchSize;
+    return settings;
+  }
+
+  RpcServer(const std::string& host, uint16_t port, Options options)
+      : host_(host),
+        port_(port),
+        options_(std::move(options)),
+        server_(QuicServer::createQuicServer()) {
+    server_->setQuicServerTransportFactory(
+        std::make_unique<RpcServerTransportFactory>(options_.responseSize));
+    server_->setFizzContext(quic::test::createServerCtx());
+    server_->setTransportSettings(options_.transportSettings);
+  }
+
+  void start() {
+    folly::SocketAddress addr(host_.c_str(), port_);
+    server_->start(addr, options_.numWorkers);
+    LOG(INFO) << "Rpc server started at: " << addr.describe();
+    eventbase_.loopForever();
+  }
+
+ private:
+  std::string host_;
+  uint16_t port_;
+  Options options_;
+  folly::EventBase eventbase_;
+  std::shared_ptr<quic::QuicServer> server_;
+};
+} // namespace samples
+} // namespace quic
@@ -14,11 +14,23 @@
 
 #include <quic/samples/echo/EchoClient.h>
 #include <quic/samples/echo/EchoServer.h>
+#include <quic/samples/echo/RpcClient.h>
+#include <quic/samples/echo/RpcServer.h>
 
 DEFINE_string(host, "::1", "Echo server hostname/IP");
 DEFINE_int32(port, 6666, "Echo server port");
-DEFINE_string(mode, "server", "Mode to run in: 'client' or 'server'");
+DEFINE_string(
+    mode,
+    "server",
+    "Mode to run in: 'client', 'server', 'rpc_client' or 'rpc_server'");
 DEFINE_bool(pr, false, "Enable partially realible mode");
+DEFINE_int32(workers, 0, "rpc_server: workers, 0 for one per hardware thread");
+DEFINE_int32(request_size, 1024, "rpc_client: bytes of every request");
+DEFINE_int32(response_size, 1024, "rpc_server: bytes of every response");
+DEFINE_int32(connections, 1, "rpc_client: number of connections");
+DEFINE_int32(threads, 1, "rpc_client: threads the connections are spread on");
+DEFINE_int32(concurrency, 1, "rpc_client: RPCs in flight per connection");
+DEFINE_int32(duration, 10, "rpc_client: seconds to run for");
 
 using namespace quic::samples;
 
@@ -42,6 +54,21 @@ int main(int argc, char* argv[]) {
     }
     EchoClient client(FLAGS_host, FLAGS_port, FLAGS_pr);
     client.start();
+  } else if (FLAGS_mode == "rpc_server") {
+    RpcServer::Options options;
+    options.numWorkers = FLAGS_workers;
+    options.responseSize = FLAGS_response_size;
+    RpcServer server(FLAGS_host, FLAGS_port, std::move(options));
+    server.start();
+  } else if (FLAGS_mode == "rpc_client") {
+    RpcClient::Options options;
+    options.numConnections = FLAGS_connections;
+    options.numThreads = FLAGS_threads;
+    options.concurrency = FLAGS_concurrency;
+    options.requestSize = FLAGS_request_size;
+    options.duration = std::chrono::seconds(FLAGS_duration);
+    RpcClient client(FLAGS_host, FLAGS_port, std::move(options));
+    client.start();
   } else {
     LOG(ERROR) << "Unknown mode specified: " << FLAGS_mode;
     return -1;
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/ConnectionIntrospection.h>
+
+#include <quic/api/QuicTransportBase.h>
+
+namespace quic {
+
+namespace {
+
+struct IntrospectionState {
+  folly::EventBase* evb;
+  std::vector<std::weak_ptr<QuicTransportBase>> transports;
+  ConnectionIntrospectionOptions options;
+  folly::Function<void(WorkerIntrospection)> callback;
+  WorkerIntrospection result;
+  size_t next{0};
+  // One out of every sampleStride transports is sampled.
+  size_t sampleStride{1};
+};
+
+void introspectBatch(std::shared_ptr<IntrospectionState> state) {
+  auto end = std::min(
+      state->transports.size(),
+      state->next + std::max<size_t>(state->options.batchSize, 1));
+  auto& result = state->result;
+  for (; state->next < end; ++state->next) {
+    auto transport = state->transports[state->next].lock();
+    if (!transport) {
+      continue;
+    }
+    auto summary = summarizeConnection(*transport);
+    ++result.numConnections;
+    result.bufferedBytes += summary.bufferedBytes;
+    result.numStreams += summary.numStreams;
+    result.srtt.addValue(summary.transportInfo.srtt);
+    if (summary.transportInfo.congestionControlType !=
+        CongestionControlType::None) {
+      result.congestionWindow.addValue(std::chrono::microseconds(
+          summary.transportInfo.congestionWindow));
+    }
+    if (state->next % state->sampleStride == 0 &&
+        result.sampledConnections.size() <
+            state->options.maxSampledConnections) {
+      result.sampledConnections.push_back(std::move(summary));
+    }
+  }
+  if (state->next < state->transports.size()) {
+    auto evb = state->evb;
+    evb->runInLoop(
+        [state = std::move(state)]() mutable {
+          introspectBatch(std::move(state));
+        });
+    return;
+  }
+  state->transports.clear();
+  auto callback = std::move(state->callback);
+  callback(std::move(result));
+}
+} // namespace
+
+ConnectionSummary summarizeConnection(const QuicTransportBase& transport) {
+  ConnectionSummary summary;
+  summary.peerAddress = transport.getPeerAddress();
+  summary.transportInfo = transport.getTransportInfo();
+  auto conn = transport.getState();
+  if (conn) {
+    summary.serverConnectionId = conn->serverConnectionId;
+    summary.bufferedBytes = conn->flowControlState.sumCurStreamBufferLen;
+    summary.numStreams = conn->streamManager->streamCount();
+  }
+  return summary;
+}
+
+void introspectConnections(
+    folly::EventBase* evb,
+    uint8_t workerId,
+    std::vector<std::weak_ptr<QuicTransportBase>> transports,
+    ConnectionIntrospectionOptions options,
+    folly::Function<void(WorkerIntrospection)> callback) {
+  DCHECK(evb->isInEventBaseThread());
+  auto state = std::make_shared<IntrospectionState>();
+  state->evb = evb;
+  state->transports = std::move(transports);
+  state->options = options;
+  state->callback = std::move(callback);
+  state->result.workerId = workerId;
+  if (options.maxSampledConnections > 0) {
+    state->sampleStride = std::max<size_t>(
+        1,
+        (state->transports.size() + options.maxSampledConnections - 1) /
+            options.maxSampledConnections);
+  }
+  introspectBatch(std::move(state));
+}
+} // namespace quic
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+#include <quic/api/QuicSocket.h>
+#include <quic/common/LatencyHistogram.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+class QuicTransportBase;
+
+struct ConnectionIntrospectionOptions {
+  // Connections summarized per loop of the EventBase of a worker, so that a
+  // worker with many connections keeps serving them in between.
+  size_t batchSize{kDefaultIntrospectionBatchSize};
+  // Summaries kept per worker, picked evenly among its connections. The
+  // aggregates always cover all the connections.
+  size_t maxSampledConnections{kDefaultIntrospectionMaxSampledConnections};
+};
+
+struct ConnectionSummary {
+  folly::SocketAddress peerAddress;
+  folly::Optional<ConnectionId> serverConnectionId;
+  QuicSocket::TransportInfo transportInfo;
+  // Stream data written by the app and not sent yet.
+  uint64_t bufferedBytes{0};
+  uint64_t numStreams{0};
+};
+
+struct WorkerIntrospection {
+  uint8_t workerId{0};
+  uint64_t numConnections{0};
+  uint64_t bufferedBytes{0};
+  uint64_t numStreams{0};
+  LatencyHistogram srtt;
+  // Of the connections with a congestion controller, the values are bytes
+  // rather than microseconds.
+  LatencyHistogram congestionWindow;
+  std::vector<ConnectionSummary> sampledConnections;
+};
+
+ConnectionSummary summarizeConnection(const QuicTransportBase& transport);
+
+/**
+ * Summarizes the transports that are still alive, options.batchSize of them
+ * per loop of evb, and then calls the callback with the result on the thread
+ * of evb. Must be called on the thread of evb.
+ */
+void introspectConnections(
+    folly::EventBase* evb,
+    uint8_t workerId,
+    std::vector<std::weak_ptr<QuicTransportBase>> transports,
+    ConnectionIntrospectionOptions options,
+    folly::Function<void(WorkerIntrospection)> callback);
+} // namespace quic
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/NewConnectionBalancer.h>
+
+#include <folly/Random.h>
+
+namespace quic {
+
+NewConnectionBalancer::NewConnectionBalancer(
+    size_t numWorkers,
+    uint64_t maxImbalance,
+    LoadFn load)
+    : maxImbalance_(maxImbalance),
+      load_(std::move(load)),
+      workers_(numWorkers) {
+  CHECK_GT(maxImbalance_, 0);
+}
+
+size_t NewConnectionBalancer::pickWorker(
+    size_t workerId,
+    const QuicServerTransport::SourceIdentity& source,
+    bool isInitial,
+    TimePoint now) {
+  auto& worker = workers_[workerId];
+  expireRedirects(worker, now);
+  auto redirect = worker.redirects.find(source);
+  if (redirect != worker.redirects.end()) {
+    return redirect->second.workerId;
+  }
+  if (!isInitial || workers_.size() < 2) {
+    return workerId;
+  }
+  size_t otherWorkerId = folly::Random::rand32(workers_.size() - 1);
+  if (otherWorkerId >= workerId) {
+    ++otherWorkerId;
+  }
+  if (load_(workerId) < load_(otherWorkerId) + maxImbalance_) {
+    return workerId;
+  }
+  if (worker.order.size() >= kMaxNewConnectionRedirects) {
+    worker.redirects.erase(worker.order.front());
+    worker.order.pop_front();
+  }
+  worker.redirects.emplace(
+      source, Redirect{otherWorkerId, now + kNewConnectionRedirectLifetime});
+  worker.order.push_back(source);
+  ++worker.numRedirected;
+  return otherWorkerId;
+}
+
+void NewConnectionBalancer::expireRedirects(
+    WorkerRedirects& worker,
+    TimePoint now) {
+  while (!worker.order.empty()) {
+    auto redirect = worker.redirects.find(worker.order.front());
+    if (redirect != worker.redirects.end()) {
+      if (redirect->second.expiry > now) {
+        return;
+      }
+      worker.redirects.erase(redirect);
+    }
+    worker.order.pop_front();
+  }
+}
+} // namespace quic
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/container/F14Map.h>
+#include <quic/QuicConstants.h>
+#include <quic/server/QuicServerTransport.h>
+
+#include <deque>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Evens out the new connections of the workers of a QuicServer, which the
+ * kernel spreads by hashing the addresses of the clients regardless of the
+ * load of the workers. The first packet of a client goes to the worker the
+ * kernel delivered it to, unless a worker picked at random has at least
+ * maxImbalance fewer connections, in which case it goes to that one, the
+ * power of two choices. The worker that gets the Initial creates the
+ * connection, so the connection ids of the server carry its id and the
+ * packets that use them are routed there directly.
+ *
+ * The packets the client sends with its own connection id before it hears
+ * back, the retransmitted Initials and the 0-rtt packets, follow the same
+ * decision for kNewConnectionRedirectLifetime. The decisions are kept per
+ * worker and only used from the thread of that worker.
+ */
+class NewConnectionBalancer {
+ public:
+  using LoadFn = folly::Function<uint64_t(size_t) const>;
+
+  /**
+   * load returns the number of connections of a worker, it is called from
+   * the threads of the other workers.
+   */
+  NewConnectionBalancer(size_t numWorkers, uint64_t maxImbalance, LoadFn load);
+
+  /**
+   * The worker a packet of the client identified by source should go to,
+   * when the worker it arrived at, workerId, has no connection for it. Only
+   * Initials move new connections. Called on the thread of workerId.
+   */
+  size_t pickWorker(
+      size_t workerId,
+      const QuicServerTransport::SourceIdentity& source,
+      bool isInitial,
+      TimePoint now);
+
+  /**
+   * Number of connections moved by the worker so far.
+   */
+  uint64_t numRedirected(size_t workerId) const {
+    return workers_[workerId].numRedirected;
+  }
+
+ private:
+  struct SourceIdentityHash {
+    size_t operator()(const QuicServerTransport::SourceIdentity& sid) const {
+      return folly::hash::hash_combine(
+          ConnectionIdHash()(sid.second), sid.first.hash());
+    }
+  };
+
+  struct Redirect {
+    size_t workerId;
+    TimePoint expiry;
+  };
+
+  struct WorkerRedirects {
+    folly::F14FastMap<
+        QuicServerTransport::SourceIdentity,
+        Redirect,
+        SourceIdentityHash>
+        redirects;
+    // In the order of their expiry.
+    std::deque<QuicServerTransport::SourceIdentity> order;
+    uint64_t numRedirected{0};
+  };
+
+  void expireRedirects(WorkerRedirects& worker, TimePoint now);
+
+  uint64_t maxImbalance_;
+  LoadFn load_;
+  std::vector<WorkerRedirects> workers_;
+};
+} // namespace quic
@@ -9,7 +9,10 @@
 #include <quic/server/QuicServer.h>
 
 #include <folly/Random.h>
+#include <folly/ScopeGuard.h>
+#include <folly/String.h>
 #include <folly/io/async/EventBaseManager.h>
+#include <folly/synchronization/Baton.h>
 #include <quic/codec/DefaultConnectionIdAlgo.h>
 #include <quic/codec/QuicHeaderCodec.h>
 #include <quic/server/QuicReusePortUDPSocketFactory.h>
@@ -17,6 +20,8 @@
 #include <quic/server/QuicServerTransport.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
 
+#include <atomic>
+
 namespace quic {
 
 namespace {
@@ -60,6 +65,34 @@ void QuicServer::setCongestionControllerFactory(
   ccFactory_ = std::move(ccFactory);
 }
 
+void QuicServer::setQLogSampler(
+    std::shared_ptr<const QLogSampler> qLogSampler) {
+  CHECK(!initialized_)
+      << " QLog sampler must be set before the server is initialized.";
+  qLogSampler_ = std::move(qLogSampler);
+}
+
+void QuicServer::setCryptoExecutor(
+    std::shared_ptr<folly::Executor> cryptoExecutor) {
+  CHECK(!initialized_)
+      << " Crypto executor must be set before the server is initialized.";
+  cryptoExecutor_ = std::move(cryptoExecutor);
+}
+
+void QuicServer::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  CHECK(!initialized_)
+      << " Crypto factory must be set before the server is initialized.";
+  cryptoFactory_ = std::move(cryptoFactory);
+}
+
+void QuicServer::setPathEstimateCache(
+    std::shared_ptr<PathEstimateCache> pathEstimateCache) {
+  CHECK(!initialized_)
+      << " Path estimate cache must be set before the server is initialized.";
+  pathEstimateCache_ = std::move(pathEstimateCache);
+}
+
 void QuicServer::setSupportedVersion(const std::vector<QuicVersion>& versions) {
   supportedVersions_ = versions;
 }
@@ -118,6 +151,13 @@ void QuicServer::initialize(
     transportSettings_.statelessResetTokenSecret = secret;
   }
 
+  // setting default retry token secret if not set
+  if (!transportSettings_.retryTokenSecret) {
+    std::array<uint8_t, kRetryTokenSecretLength> secret;
+    folly::Random::secureRandom(secret.data(), secret.size());
+    transportSettings_.retryTokenSecret = secret;
+  }
+
   // it the connid algo factory is not set, use default impl
   if (!connIdAlgoFactory_) {
     connIdAlgoFactory_ = std::make_unique<DefaultConnectionIdAlgoFactory>();
@@ -136,6 +176,12 @@ void QuicServer::initializeWorkers(
     const std::vector<folly::EventBase*>& evbs,
     bool useDefaultTransport) {
   CHECK(workers_.empty());
+  if (numHandshakeWorkers_ > 0) {
+    CHECK_GE(evbs.size(), 2 * numHandshakeWorkers_)
+        << " Every handshake worker needs a data worker.";
+    CHECK(transportSettings_.allowConnectionTakeover)
+        << " Handing connections over to the data workers needs their secrets.";
+  }
   for (auto& workerEvb : evbs) {
     auto worker = newWorkerWithoutSocket();
     if (useDefaultTransport) {
@@ -162,11 +208,34 @@ void QuicServer::initializeWorkers(
     }
     worker->setConnectionIdAlgo(connIdAlgoFactory_->make());
     worker->setCongestionControllerFactory(ccFactory_);
+    worker->setQLogSampler(qLogSampler_);
+    worker->setCryptoExecutor(cryptoExecutor_);
+    worker->setCryptoFactory(cryptoFactory_);
+    worker->setPathEstimateCache(pathEstimateCache_);
     worker->setWorkerId(workers_.size());
+    if (numHandshakeWorkers_ > 0) {
+      worker->setHandshakeWorkers(numHandshakeWorkers_, evbs.size());
+    }
     worker->setTransportSettingsOverrideFn(transportSettingsOverrideFn_);
     workers_.push_back(std::move(worker));
     evbToWorkers_.emplace(workerEvb, workers_.back().get());
   }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    auto handoffs = std::make_unique<WorkerHandoffs>();
+    for (size_t j = 0; j < workers_.size(); ++j) {
+      handoffs->fromWorkers.push_back(
+          std::make_unique<HandoffQueue>(kWorkerHandoffQueueSize));
+    }
+    workerHandoffs_.push_back(std::move(handoffs));
+  }
+  if (newConnectionMaxImbalance_ > 0 && numHandshakeWorkers_ == 0) {
+    newConnectionBalancer_ = std::make_unique<NewConnectionBalancer>(
+        workers_.size(),
+        newConnectionMaxImbalance_,
+        [this](size_t workerId) {
+          return workers_[workerId]->getNumConnections();
+        });
+  }
 }
 
 std::unique_ptr<QuicServerWorker> QuicServer::newWorkerWithoutSocket() {
@@ -184,52 +253,98 @@ void QuicServer::bindWorkersToSocket(
     const folly::SocketAddress& address,
     const std::vector<folly::EventBase*>& evbs) {
   auto numWorkers = evbs.size();
+  // The workers set up their sockets in parallel, except with reuseport
+  // steering, whose program finds the sockets of the group in the order they
+  // were bound.
+  bool inOrder = reusePortSteering_ && listeningFDs_.empty();
+  // Guarded by startMutex_.
+  auto pendingWorkers = std::make_shared<size_t>(numWorkers);
   for (size_t i = 0; i < numWorkers; ++i) {
     auto workerEvb = evbs[i];
-    workerEvb->runImmediatelyOrRunInEventBaseThreadAndWait(
-        [address,
-         self = this->shared_from_this(),
-         workerEvb,
-         numWorkers,
-         processId = processId_,
-         idx = i] {
-          std::lock_guard<std::mutex> guard(self->startMutex_);
-          if (self->shutdown_) {
-            return;
-          }
-          auto workerSocket = self->listenerSocketFactory_->make(workerEvb, -1);
-          auto it = self->evbToWorkers_.find(workerEvb);
-          CHECK(it != self->evbToWorkers_.end());
-          auto worker = it->second;
-          int takeoverOverFd = -1;
-          if (self->listeningFDs_.size() > idx) {
-            takeoverOverFd = self->listeningFDs_[idx];
-          }
-          // dup the takenover socket on only one worker and bind the rest
-          if (takeoverOverFd >= 0) {
-            VLOG(4) << "Setting dup()'ed fd for address=" << address
-                    << " on workerId=" << (int)worker->getWorkerId();
-            workerSocket->setFD(
-                folly::NetworkSocket::fromFd(::dup(takeoverOverFd)),
-                // set ownership to OWNS to allow ::close()'ing of of the fd
-                // when this server goes away
-                folly::AsyncUDPSocket::FDOwnership::OWNS);
-            worker->setSocket(std::move(workerSocket));
-          } else {
-            VLOG(4) << "No valid takenover fd found for address=" << address
-                    << ". binding on worker=" << worker
-                    << " workerId=" << (int)worker->getWorkerId()
-                    << " processId=" << (int)processId;
-            worker->setSocket(std::move(workerSocket));
-            worker->bind(address);
-          }
-          if (idx == (numWorkers - 1)) {
-            VLOG(4) << "Initialized all workers in the eventbase";
-            self->initialized_ = true;
-            self->startCv_.notify_all();
-          }
-        });
+    auto bindWorker = [address,
+                       self = this->shared_from_this(),
+                       workerEvb,
+                       pendingWorkers,
+                       numWorkers,
+                       inOrder,
+                       idx = i] {
+      SCOPE_EXIT {
+        std::lock_guard<std::mutex> guard(self->startMutex_);
+        if (--*pendingWorkers == 0) {
+          self->startCv_.notify_all();
+        }
+      };
+      auto worker = self->bindWorkerToSocket(address, workerEvb, idx);
+      // The program is attached to the whole group, so once every worker has
+      // bound, in the order of their ids.
+      if (worker && inOrder && idx == (numWorkers - 1) &&
+          !worker->attachReusePortSteering()) {
+        LOG(ERROR) << "Reuseport steering disabled for address=" << address;
+      }
+    };
+    if (inOrder) {
+      workerEvb->runImmediatelyOrRunInEventBaseThreadAndWait(
+          std::move(bindWorker));
+    } else if (workerEvb->isInEventBaseThread()) {
+      bindWorker();
+    } else {
+      workerEvb->runInEventBaseThread(std::move(bindWorker));
+    }
+  }
+  std::unique_lock<std::mutex> guard(startMutex_);
+  startCv_.wait(guard, [&] { return *pendingWorkers == 0; });
+  if (shutdown_) {
+    return;
+  }
+  VLOG(4) << "Initialized all workers in the eventbase";
+  initialized_ = true;
+  startCv_.notify_all();
+}
+
+QuicServerWorker* QuicServer::bindWorkerToSocket(
+    const folly::SocketAddress& address,
+    folly::EventBase* workerEvb,
+    size_t idx) {
+  QuicServerWorker* worker;
+  int takeoverOverFd = -1;
+  {
+    std::lock_guard<std::mutex> guard(startMutex_);
+    if (shutdown_) {
+      return nullptr;
+    }
+    auto it = evbToWorkers_.find(workerEvb);
+    CHECK(it != evbToWorkers_.end());
+    worker = it->second;
+    if (listeningFDs_.size() > idx) {
+      takeoverOverFd = listeningFDs_[idx];
+    }
+  }
+  // The shutdown of the worker runs on its thread, after this.
+  auto workerSocket = listenerSocketFactory_->make(workerEvb, -1);
+  // dup the takenover socket on only one worker and bind the rest
+  if (takeoverOverFd >= 0) {
+    VLOG(4) << "Setting dup()'ed fd for address=" << address
+            << " on workerId=" << (int)worker->getWorkerId();
+    workerSocket->setFD(
+        folly::NetworkSocket::fromFd(::dup(takeoverOverFd)),
+        // set ownership to OWNS to allow ::close()'ing of of the fd
+        // when this server goes away
+        folly::AsyncUDPSocket::FDOwnership::OWNS);
+    worker->setSocket(std::move(workerSocket));
+  } else {
+    VLOG(4) << "No valid takenover fd found for address=" << address
+            << ". binding on worker=" << worker
+            << " workerId=" << (int)worker->getWorkerId()
+            << " processId=" << (int)processId_;
+    worker->setSocket(std::move(workerSocket));
+    worker->bind(address);
+  }
+  // Before the worker starts and allocates its buffers.
+  if (idx < workerCpus_.size() && !worker->setCpuAffinity(workerCpus_[idx])) {
+    LOG(ERROR) << "Failed to pin workerId=" << (int)worker->getWorkerId()
+               << " to cpu=" << workerCpus_[idx];
   }
+  return worker;
 }
 
 void QuicServer::start() {
@@ -311,12 +426,37 @@ void QuicServer::routeDataToWorker(
     return;
   }
 
+  if (numHandshakeWorkers_ > 0) {
+    routeDataToHandshakeOrDataWorker(
+        client, std::move(routingData), std::move(networkData));
+    return;
+  }
+
   // For initial or zeroRtt packets, pick the worker that kernel / bpf routed to
   // Without this, when (bpf / kernel) hash and userspace hash get out of sync
   // (e.g. due to shuffling of sockets in the hash ring), it results in
   // very high amount of 'misses'
   if (routingData.isUsingClientConnId && workerPtr_) {
     CHECK(workerPtr_->getEventBase()->isInEventBaseThread());
+    if (newConnectionBalancer_ && routingData.sourceConnId) {
+      auto source = std::make_pair(client, *routingData.sourceConnId);
+      size_t workerId = workerPtr_->getWorkerId();
+      if (!workerPtr_->getSrcToTransportMap().count(source)) {
+        auto workerToRunOn = newConnectionBalancer_->pickWorker(
+            workerId,
+            source,
+            routingData.isInitial,
+            networkData.receiveTimePoint);
+        if (workerToRunOn != workerId) {
+          handOffToWorker(
+              workerToRunOn,
+              client,
+              std::move(routingData),
+              std::move(networkData));
+          return;
+        }
+      }
+    }
     workerPtr_->dispatchPacketData(
         client, std::move(routingData), std::move(networkData));
     return;
@@ -324,9 +464,88 @@ void QuicServer::routeDataToWorker(
 
   auto workerToRunOn =
       getWorkerToRouteTo(routingData, workers_.size(), connIdAlgo_.get());
+  handOffToWorker(
+      workerToRunOn, client, std::move(routingData), std::move(networkData));
+}
+
+void QuicServer::routeDataToHandshakeOrDataWorker(
+    const folly::SocketAddress& client,
+    RoutingData&& routingData,
+    NetworkData&& networkData) {
+  size_t workerToRunOn;
+  if (routingData.isUsingClientConnId) {
+    // The Initial and 0-RTT packets of a connection all carry the connection
+    // id the client picked.
+    workerToRunOn = ConnectionIdHash()(routingData.destinationConnId) %
+        numHandshakeWorkers_;
+  } else {
+    workerToRunOn =
+        getWorkerToRouteTo(routingData, workers_.size(), connIdAlgo_.get());
+    if (workerToRunOn < numHandshakeWorkers_) {
+      // Not an id this server gives out with handshake workers.
+      VLOG(4) << "Dropping packet with the connection id of a handshake "
+              << "worker, workerId=" << workerToRunOn;
+      return;
+    }
+    if (routingData.headerForm == HeaderForm::Long ||
+        routingData.missedOnDataWorker) {
+      workerToRunOn = QuicServerWorker::getHandshakeWorkerFor(
+          workerToRunOn, numHandshakeWorkers_);
+    }
+  }
+  if (workerPtr_ && workerPtr_->getWorkerId() == workerToRunOn) {
+    workerPtr_->dispatchPacketData(
+        client, std::move(routingData), std::move(networkData));
+    return;
+  }
+  handOffToWorker(
+      workerToRunOn, client, std::move(routingData), std::move(networkData));
+}
+
+void QuicServer::handOffConnection(
+    uint8_t workerId,
+    ServerConnectionSnapshot snapshot) {
+  if (shutdown_) {
+    return;
+  }
+  auto worker = workers_[workerId % workers_.size()].get();
+  worker->getEventBase()->runInEventBaseThread(
+      [server = this->shared_from_this(),
+       worker,
+       snapshot = std::move(snapshot)] {
+        if (server->shutdown_) {
+          return;
+        }
+        worker->adoptConnection(snapshot);
+      });
+}
+
+void QuicServer::handOffToWorker(
+    size_t workerToRunOn,
+    const folly::SocketAddress& client,
+    RoutingData&& routingData,
+    NetworkData&& networkData) {
   auto& worker = workers_[workerToRunOn];
   VLOG_IF(4, !worker->getEventBase()->isInEventBaseThread())
       << " Routing to worker in different EVB, to workerId=" << workerToRunOn;
+  if (workerPtr_) {
+    // Queue the packet for the worker, and only wake it up if it doesn't
+    // already have a drain scheduled, so a burst of packets costs a single
+    // closure.
+    auto& handoffs = *workerHandoffs_[workerToRunOn];
+    auto& queue = *handoffs.fromWorkers[workerPtr_->getWorkerId()];
+    if (queue.write(client, std::move(routingData), std::move(networkData))) {
+      if (!handoffs.drainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        worker->getEventBase()->runInEventBaseThread(
+            [server = this->shared_from_this(), workerToRunOn] {
+              server->drainWorkerHandoffs(workerToRunOn);
+            });
+      }
+      return;
+    }
+    QUIC_STATS(
+        workerPtr_->getTransportInfoCallback(), onWorkerHandoffQueueFull);
+  }
   worker->getEventBase()->runInEventBaseThread(
       [server = this->shared_from_this(),
        cl = client,
@@ -340,6 +559,44 @@ void QuicServer::routeDataToWorker(
       });
 }
 
+void QuicServer::drainWorkerHandoffs(size_t workerId) {
+  auto& handoffs = *workerHandoffs_[workerId];
+  // Cleared before draining, so that a packet queued from now on schedules
+  // another drain. Also makes the packets queued before visible.
+  handoffs.drainScheduled.exchange(false, std::memory_order_acq_rel);
+  if (shutdown_) {
+    return;
+  }
+  auto& worker = workers_[workerId];
+  uint64_t numPending = 0;
+  for (auto& queue : handoffs.fromWorkers) {
+    numPending += queue->sizeGuess();
+  }
+  worker->onPendingRoutedPackets(numPending);
+  size_t numPackets = 0;
+  worker->startPacketBatch();
+  for (auto& queue : handoffs.fromWorkers) {
+    // Only take what is queued now, later packets come with their own drain.
+    for (size_t toDrain = queue->sizeGuess(); toDrain > 0; --toDrain) {
+      auto packet = queue->frontPtr();
+      if (!packet) {
+        break;
+      }
+      worker->dispatchPacketData(
+          packet->client,
+          std::move(packet->routingData),
+          std::move(packet->networkData));
+      queue->popFront();
+      ++numPackets;
+    }
+  }
+  worker->finishPacketBatch();
+  if (numPackets > 0) {
+    QUIC_STATS(
+        worker->getTransportInfoCallback(), onWorkerHandoffBatch, numPackets);
+  }
+}
+
 void QuicServer::handleWorkerError(LocalErrorCode error) {
   shutdown(error);
 }
@@ -369,16 +626,26 @@ void QuicServer::shutdown(LocalErrorCode error) {
         !worker->getEventBase()->isInEventBaseThread());
   }
   shutdown_ = true;
-  for (auto& worker : workers_) {
-    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
-      worker->shutdownAllConnections(error);
-      workerPtr_.reset();
+  // The workers close their connections in parallel, over several loop
+  // iterations with TransportSettings::shutdownTimeBudget.
+  std::vector<folly::Baton<>> workersDone(workers_.size());
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    auto worker = workers_[i].get();
+    auto done = &workersDone[i];
+    worker->getEventBase()->runInEventBaseThreadAndWait([&, worker, done] {
+      worker->shutdownAllConnections(error, [this, done] {
+        workerPtr_.reset();
+        done->post();
+      });
     });
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workersDone[i].wait();
     // protecting the erase in map with the mutex since
     // the erase could potentally affect concurrent accesses from other threads
     std::lock_guard<std::mutex> guard(startMutex_);
-    evbToWorkers_.erase(worker->getEventBase());
-    evbToAcceptors_.erase(worker->getEventBase());
+    evbToWorkers_.erase(workers_[i]->getEventBase());
+    evbToAcceptors_.erase(workers_[i]->getEventBase());
   }
   startCv_.notify_all();
 }
@@ -429,6 +696,7 @@ void QuicServer::setHealthCheckToken(const std::string& healthCheckToken) {
 
 void QuicServer::setFizzContext(
     std::shared_ptr<const fizz::server::FizzServerContext> ctx) {
+  ctx = withTicketKeyManager(std::move(ctx));
   ctx_ = ctx;
   runOnAllWorkers([ctx](auto worker) mutable { worker->setFizzContext(ctx); });
 }
@@ -438,6 +706,7 @@ void QuicServer::setFizzContext(
     std::shared_ptr<const fizz::server::FizzServerContext> ctx) {
   CHECK(evb);
   CHECK(ctx);
+  ctx = withTicketKeyManager(std::move(ctx));
   evb->runImmediatelyOrRunInEventBaseThreadAndWait([&] {
     std::lock_guard<std::mutex> guard(startMutex_);
     if (shutdown_) {
@@ -449,6 +718,24 @@ void QuicServer::setFizzContext(
   });
 }
 
+void QuicServer::setTicketKeyManager(
+    std::shared_ptr<TicketKeyManager> manager) {
+  CHECK(!ctx_) << "Set the ticket key manager before the TLS context";
+  ticketKeyManager_ = std::move(manager);
+}
+
+std::shared_ptr<const fizz::server::FizzServerContext>
+QuicServer::withTicketKeyManager(
+    std::shared_ptr<const fizz::server::FizzServerContext> ctx) const {
+  if (!ticketKeyManager_ || !ctx ||
+      ctx->getTicketCipher() == ticketKeyManager_.get()) {
+    return ctx;
+  }
+  auto copy = std::make_shared<fizz::server::FizzServerContext>(*ctx);
+  copy->setTicketCipher(ticketKeyManager_);
+  return copy;
+}
+
 const TransportSettings& QuicServer::getTransportSettings() const noexcept {
   return transportSettings_;
 }
@@ -473,6 +760,30 @@ void QuicServer::enablePartialReliability(bool enabled) {
   });
 }
 
+void QuicServer::enableReusePortSteering(bool enabled) {
+  CHECK(!initialized_)
+      << " Reuseport steering must be set before the server is initialized.";
+  reusePortSteering_ = enabled;
+}
+
+void QuicServer::enableNewConnectionBalancing(uint64_t maxImbalance) {
+  CHECK(!initialized_) << " New connection balancing must be set before the "
+                       << "server is initialized.";
+  newConnectionMaxImbalance_ = maxImbalance;
+}
+
+void QuicServer::setNumHandshakeWorkers(size_t numHandshakeWorkers) {
+  CHECK(!initialized_) << " Handshake workers must be set before the server "
+                       << "is initialized.";
+  numHandshakeWorkers_ = numHandshakeWorkers;
+}
+
+void QuicServer::setWorkerCpus(std::vector<int> workerCpus) {
+  CHECK(!initialized_)
+      << " Worker cpus must be set before the server is initialized.";
+  workerCpus_ = std::move(workerCpus);
+}
+
 void QuicServer::setEventBaseObserver(
     std::shared_ptr<folly::EventBaseObserver> observer) {
   if (shutdown_ || workerEvbs_.empty()) {
@@ -485,10 +796,12 @@ void QuicServer::setEventBaseObserver(
   });
 };
 
-void QuicServer::startPacketForwarding(const folly::SocketAddress& destAddr) {
+void QuicServer::startPacketForwarding(
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion version) {
   if (initialized_) {
-    runOnAllWorkers([destAddr](auto worker) mutable {
-      worker->startPacketForwarding(destAddr);
+    runOnAllWorkers([destAddr, version](auto worker) mutable {
+      worker->startPacketForwarding(destAddr, version);
     });
   }
 }
@@ -515,6 +828,152 @@ void QuicServer::stopPacketForwarding(std::chrono::milliseconds delay) {
   }
 }
 
+folly::Optional<size_t> QuicServer::exportConnections(
+    folly::NetworkSocket sock) {
+  std::vector<ServerConnectionSnapshot> snapshots;
+  if (initialized_ && !shutdown_) {
+    for (auto& worker : workers_) {
+      CHECK(!worker->getEventBase()->isInEventBaseThread());
+      worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+        auto workerSnapshots = worker->exportConnections();
+        std::move(
+            workerSnapshots.begin(),
+            workerSnapshots.end(),
+            std::back_inserter(snapshots));
+      });
+    }
+  }
+  if (!writeServerConnectionSnapshots(sock, snapshots)) {
+    LOG(ERROR) << "Failed to write connection snapshots "
+               << folly::errnoStr(errno);
+    return folly::none;
+  }
+  return snapshots.size();
+}
+
+void QuicServer::introspectConnections(
+    ConnectionIntrospectionOptions options,
+    folly::Function<void(std::vector<WorkerIntrospection>)> callback) {
+  struct Results {
+    std::mutex mutex;
+    size_t pendingWorkers;
+    std::vector<WorkerIntrospection> workers;
+    folly::Function<void(std::vector<WorkerIntrospection>)> callback;
+  };
+  if (!initialized_ || shutdown_ || workers_.empty()) {
+    callback({});
+    return;
+  }
+  auto results = std::make_shared<Results>();
+  results->pendingWorkers = workers_.size();
+  results->callback = std::move(callback);
+  runOnAllWorkers([options, results](auto worker) {
+    worker->introspectConnections(
+        options, [results](WorkerIntrospection workerResult) {
+          std::unique_lock<std::mutex> guard(results->mutex);
+          results->workers.push_back(std::move(workerResult));
+          if (--results->pendingWorkers > 0) {
+            return;
+          }
+          auto workers = std::move(results->workers);
+          auto resultCallback = std::move(results->callback);
+          guard.unlock();
+          std::sort(
+              workers.begin(), workers.end(), [](const auto& a, const auto& b) {
+                return a.workerId < b.workerId;
+              });
+          resultCallback(std::move(workers));
+        });
+  });
+}
+
+void QuicServer::broadcast(
+    Buf data,
+    std::vector<BroadcastTarget> targets,
+    bool eof,
+    folly::Function<void(size_t)> callback) {
+  struct Results {
+    std::atomic<size_t> pendingWorkers{0};
+    std::atomic<size_t> written{0};
+    folly::Function<void(size_t)> callback;
+  };
+  if (!initialized_ || shutdown_ || workers_.empty() || targets.empty()) {
+    if (callback) {
+      callback(0);
+    }
+    return;
+  }
+  // Group them per worker, to hop to each worker once.
+  std::vector<std::vector<BroadcastTarget>> workerTargets(workers_.size());
+  for (auto& target : targets) {
+    auto workerId =
+        connIdAlgo_->parseConnectionId(target.serverConnectionId).workerId %
+        workers_.size();
+    workerTargets[workerId].push_back(std::move(target));
+  }
+  std::shared_ptr<const folly::IOBuf> sharedData(std::move(data));
+  auto results = std::make_shared<Results>();
+  results->callback = std::move(callback);
+  results->pendingWorkers = std::count_if(
+      workerTargets.begin(), workerTargets.end(), [](const auto& targets) {
+        return !targets.empty();
+      });
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (workerTargets[i].empty()) {
+      continue;
+    }
+    auto worker = workers_[i].get();
+    worker->getEventBase()->runInEventBaseThread(
+        [worker,
+         sharedData,
+         results,
+         eof,
+         targets = std::move(workerTargets[i])]() mutable {
+          results->written += worker->broadcast(*sharedData, targets, eof);
+          if (--results->pendingWorkers == 0 && results->callback) {
+            results->callback(results->written);
+          }
+        });
+  }
+}
+
+folly::Optional<size_t> QuicServer::adoptConnections(
+    folly::NetworkSocket sock) {
+  auto snapshots = readServerConnectionSnapshots(sock);
+  if (!snapshots) {
+    LOG(ERROR) << "Failed to read connection snapshots";
+    return folly::none;
+  }
+  if (!initialized_ || shutdown_) {
+    return 0;
+  }
+  // Group them per worker, to hop to each worker once.
+  std::vector<std::vector<ServerConnectionSnapshot>> workerSnapshots(
+      workers_.size());
+  for (auto& snapshot : *snapshots) {
+    if (!snapshot.serverConnectionId) {
+      continue;
+    }
+    auto workerId =
+        connIdAlgo_->parseConnectionId(*snapshot.serverConnectionId).workerId %
+        workers_.size();
+    workerSnapshots[workerId].push_back(std::move(snapshot));
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    if (workerSnapshots[i].empty()) {
+      continue;
+    }
+    auto& worker = workers_[i];
+    CHECK(!worker->getEventBase()->isInEventBaseThread());
+    worker->getEventBase()->runInEventBaseThreadAndWait([&] {
+      for (const auto& snapshot : workerSnapshots[i]) {
+        worker->adoptConnection(snapshot);
+      }
+    });
+  }
+  return snapshots->size();
+}
+
 void QuicServer::setTransportStatsCallbackFactory(
     std::unique_ptr<QuicTransportStatsCallbackFactory> statsFactory) {
   CHECK(statsFactory);
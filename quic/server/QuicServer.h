@@ -12,15 +12,20 @@
 #include <memory>
 #include <vector>
 
+#include <folly/ProducerConsumerQueue.h>
 #include <folly/ThreadLocal.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 
 #include <quic/QuicConstants.h>
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/logging/QLogSampler.h>
+#include <quic/server/NewConnectionBalancer.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicServerWorker.h>
 #include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/handshake/TicketKeyManager.h>
+#include <quic/server/state/ServerConnectionSnapshot.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
 namespace quic {
@@ -97,6 +102,42 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> ccFactory);
 
+  /**
+   * Set the sampler that decides which connections are qlogged.
+   * This must be set before the server is started.
+   */
+  void setQLogSampler(std::shared_ptr<const QLogSampler> qLogSampler);
+
+  /**
+   * Set the executor, usually a CPU thread pool, that the connections process
+   * the ClientHello on: generating the key share, deriving the handshake
+   * secrets and signing with the certificate key. This keeps handshake bursts
+   * from delaying the established connections of a worker. When not set the
+   * handshake runs inline on the worker's event base.
+   * This must be set before the server is started.
+   */
+  void setCryptoExecutor(std::shared_ptr<folly::Executor> cryptoExecutor);
+
+  /**
+   * Set the factory that makes the Aeads and header ciphers of the 0-rtt,
+   * handshake and 1-rtt packets of every connection, in place of the
+   * userspace OpenSSL ones of FizzCryptoFactory. Overriding makeAead() and
+   * makePacketNumberCipher() lets the packet protection run on inline crypto
+   * of the NIC or on an accelerator. The factory is shared by all the workers
+   * and called from their threads.
+   * This must be set before the server is started.
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
+  /**
+   * Set the cache that remembers the bandwidth and min rtt of the client
+   * subnets, shared by all the workers. New connections from a subnet in the
+   * cache start with a larger cwnd and a pacing rate derived from it.
+   * This must be set before the server is started.
+   */
+  void setPathEstimateCache(
+      std::shared_ptr<PathEstimateCache> pathEstimateCache);
+
   /**
    * Set list of supported QUICVersion for this server. These versions will be
    * used during the 'Version-Negotiation' phase with the client.
@@ -123,6 +164,14 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
       folly::EventBase* evb,
       std::shared_ptr<const fizz::server::FizzServerContext> ctx);
 
+  /**
+   * Encrypt and decrypt the session tickets of all the workers with the keys
+   * of the manager, whatever the ticket cipher of the TLS contexts they are
+   * given, so that a ticket resumes on any worker and through the rotations
+   * of the manager. Must be called before the TLS contexts are set.
+   */
+  void setTicketKeyManager(std::shared_ptr<TicketKeyManager> manager);
+
   /**
    * Set the server id of the quic server.
    * Note that this function must be called before initialize(..)
@@ -159,6 +208,55 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   void enablePartialReliability(bool enabled);
 
+  /**
+   * Steer the packets of established connections to the socket of the worker
+   * that owns them in the kernel, with an eBPF program attached to the
+   * SO_REUSEPORT group of the workers, instead of forwarding them between
+   * workers. Only valid with the DefaultConnectionIdAlgo and the default
+   * listener socket factory, and skipped when the sockets are taken over.
+   * This must be set before the server is started.
+   */
+  void enableReusePortSteering(bool enabled);
+
+  /**
+   * Pins the thread of the worker i to workerCpus[i], the workers past the
+   * end of the list are left alone. The socket of a pinned worker also sets
+   * SO_INCOMING_CPU to its cpu so that the kernel prefers it for the packets
+   * processed on that cpu: with the cpus listed in the order of the NIC RSS
+   * queues they service, each worker gets the packets of its own queue. The
+   * memory a worker allocates as it starts, like its receive buffer pool, is
+   * first touched on its pinned thread, so it comes from the local NUMA node.
+   * Linux only. This must be set before the server is started.
+   */
+  void setWorkerCpus(std::vector<int> workerCpus);
+
+  /**
+   * Moves the new connections that arrive at a worker with at least
+   * maxImbalance more connections than another worker, picked at random, to
+   * that worker, see NewConnectionBalancer. 0 leaves the connections where
+   * the kernel delivers them. This must be set before the server is started.
+   */
+  void enableNewConnectionBalancing(uint64_t maxImbalance);
+
+  /**
+   * Runs the handshakes on the first numHandshakeWorkers workers only, so
+   * that a surge of new connections doesn't slow down the established ones
+   * on the other, data, workers. The Initial and 0-RTT packets go to a
+   * handshake worker picked from the client's connection id, which gives the
+   * connection the ids of one of its data workers. The connection moves to
+   * that data worker with no packet in flight once the handshake is done,
+   * the same way as over a takeover, see QuicServerTransport::exportSnapshot,
+   * so that afterwards its packets are routed from the connection id alone.
+   * Until then the data worker routes them back to the handshake worker. A
+   * connection that never goes quiet stays on its handshake worker.
+   *
+   * Needs at least twice as many workers, and the secrets kept for the
+   * takeovers, see TransportSettings::allowConnectionTakeover. New connection
+   * balancing is off with handshake workers. 0 keeps the handshakes on every
+   * worker. This must be set before the server is started.
+   */
+  void setNumHandshakeWorkers(size_t numHandshakeWorkers);
+
   /**
    * Returns listening address of this server
    */
@@ -196,6 +294,12 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
       RoutingData&& routingData,
       NetworkData&& networkData);
 
+  /**
+   * Has the worker adopt the connection a handshake worker exported, see
+   * setNumHandshakeWorkers().
+   */
+  void handOffConnection(uint8_t workerId, ServerConnectionSnapshot snapshot);
+
   /**
    * Set an EventBaseObserver for server and all its workers. This only works
    * after server is already start()-ed, no-op otherwise.
@@ -230,9 +334,12 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   /*
    * Setup and initialize the listening socket of the old server from the given
    * address to forward misrouted packets belonging to that server during
-   * the takeover process
+   * the takeover process. The version should be the one the old server
+   * returns from getTakeoverProtocolVersion(), V1 batching the packets.
    */
-  void startPacketForwarding(const folly::SocketAddress& destAddr);
+  void startPacketForwarding(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion version = TakeoverProtocolVersion::V0);
 
   /*
    * Disable packet forwarding, even if the packet has no connection id
@@ -240,6 +347,53 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
    */
   void stopPacketForwarding(std::chrono::milliseconds delay);
 
+  /**
+   * Hands the established connections that are idle to the process taking
+   * over this server, over a connected stream socket such as one end of a unix
+   * socket pair, so that the new process adopts them instead of forwarding
+   * their packets back here. The exported connections are closed without
+   * telling the peers, the others stay with this server. Needs
+   * TransportSettings::allowConnectionTakeover. Blocks until the snapshots
+   * are written, and must not be called on a worker's thread. Returns the
+   * number of connections handed over, or none if the socket failed.
+   */
+  folly::Optional<size_t> exportConnections(folly::NetworkSocket sock);
+
+  /**
+   * Reads the connections handed over by exportConnections() in the old
+   * process and adopts each one on the worker its connection id routes to.
+   * Must be called after start(), with the same host id and number of workers
+   * as the old server, and not on a worker's thread. Blocks until the old
+   * server is done writing. Returns the number of connections read, or none
+   * if the socket failed.
+   */
+  folly::Optional<size_t> adoptConnections(folly::NetworkSocket sock);
+
+  /**
+   * Summarizes the connections of every worker, for monitoring. The workers
+   * go through their connections options.batchSize at a time per loop of
+   * their EventBase, so they keep serving them meanwhile. The callback gets
+   * the result of every worker, ordered by worker id, on the thread of the
+   * last worker to finish, or right away with none if the server isn't
+   * running. It isn't called if the server shuts down in the meantime.
+   */
+  void introspectConnections(
+      ConnectionIntrospectionOptions options,
+      folly::Function<void(std::vector<WorkerIntrospection>)> callback);
+
+  /**
+   * Writes the same data, and eof, to the target streams, on the workers of
+   * their connections, see QuicServerWorker::broadcast(). The workers share
+   * the one buffer, which is released once the last stream is done with it.
+   * The callback, if set, gets the number of streams written on the thread of
+   * the last worker to finish, or 0 right away if the server isn't running.
+   */
+  void broadcast(
+      Buf data,
+      std::vector<BroadcastTarget> targets,
+      bool eof,
+      folly::Function<void(size_t)> callback = nullptr);
+
   /**
    * Set takenover socket fds for the quic server from another process.
    * Quic server calls ::dup for each fd and will not bind to the address for
@@ -311,14 +465,66 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
 
   void runOnAllWorkers(std::function<void(QuicServerWorker*)> func);
 
+  // The context with the ticket cipher of ticketKeyManager_, if one is set.
+  std::shared_ptr<const fizz::server::FizzServerContext> withTicketKeyManager(
+      std::shared_ptr<const fizz::server::FizzServerContext> ctx) const;
+
   void bindWorkersToSocket(
       const folly::SocketAddress& address,
       const std::vector<folly::EventBase*>& evbs);
 
+  // Runs on the evb of the worker. Returns the worker, or null if the server
+  // is shut down.
+  QuicServerWorker* bindWorkerToSocket(
+      const folly::SocketAddress& address,
+      folly::EventBase* workerEvb,
+      size_t idx);
+
+  // Routes the packet with handshake workers, see setNumHandshakeWorkers().
+  void routeDataToHandshakeOrDataWorker(
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData);
+
+  // Queues the packet for the worker, called on the thread of another one.
+  void handOffToWorker(
+      size_t workerId,
+      const folly::SocketAddress& client,
+      RoutingData&& routingData,
+      NetworkData&& networkData);
+
+  // Runs on the evb of the worker, dispatches the packets handed off to it.
+  void drainWorkerHandoffs(size_t workerId);
+
+  struct HandoffPacket {
+    folly::SocketAddress client;
+    RoutingData routingData;
+    NetworkData networkData;
+
+    HandoffPacket(
+        const folly::SocketAddress& clientIn,
+        RoutingData&& routingDataIn,
+        NetworkData&& networkDataIn)
+        : client(clientIn),
+          routingData(std::move(routingDataIn)),
+          networkData(std::move(networkDataIn)) {}
+  };
+
+  using HandoffQueue = folly::ProducerConsumerQueue<HandoffPacket>;
+
+  // Packets handed off to a worker by the other workers.
+  struct WorkerHandoffs {
+    // Indexed by the id of the worker handing off, which is its only writer.
+    std::vector<std::unique_ptr<HandoffQueue>> fromWorkers;
+    // Whether a drain is already scheduled on the evb of the worker.
+    std::atomic<bool> drainScheduled{false};
+  };
+
   std::vector<QuicVersion> supportedVersions_{
       {QuicVersion::MVFST, QuicVersion::MVFST_OLD, QuicVersion::QUIC_DRAFT}};
   std::atomic<bool> shutdown_{true};
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
+  std::shared_ptr<TicketKeyManager> ticketKeyManager_;
   TransportSettings transportSettings_;
   std::mutex startMutex_;
   std::atomic<bool> initialized_{false};
@@ -333,6 +539,8 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   // their destruction
   folly::ThreadLocalPtr<QuicServerWorker> workerPtr_;
   std::unordered_map<folly::EventBase*, QuicServerWorker*> evbToWorkers_;
+  // Indexed by the id of the worker the packets are handed off to.
+  std::vector<std::unique_ptr<WorkerHandoffs>> workerHandoffs_;
   std::unique_ptr<QuicServerTransportFactory> transportFactory_;
   std::unordered_map<folly::EventBase*, QuicServerTransportFactory*>
       evbToAcceptors_;
@@ -342,6 +550,12 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   std::unique_ptr<QuicUDPSocketFactory> socketFactory_;
   // factory used to create specific instance of Congestion control algorithm
   std::shared_ptr<CongestionControllerFactory> ccFactory_;
+  // picks the connections that get a qlogger, none if not set
+  std::shared_ptr<const QLogSampler> qLogSampler_;
+  // runs the expensive part of the handshakes, the worker evbs if not set
+  std::shared_ptr<folly::Executor> cryptoExecutor_;
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
+  std::shared_ptr<PathEstimateCache> pathEstimateCache_;
 
   std::shared_ptr<folly::EventBaseObserver> evbObserver_;
   folly::Optional<std::string> healthCheckToken_;
@@ -350,6 +564,12 @@ class QuicServer : public QuicServerWorker::WorkerCallback,
   ProcessId processId_{ProcessId::ZERO};
   uint16_t hostId_{0};
   bool rejectNewConnections_{false};
+  bool reusePortSteering_{false};
+  std::vector<int> workerCpus_;
+  uint64_t newConnectionMaxImbalance_{0};
+  // Only set when newConnectionMaxImbalance_ is non zero.
+  std::unique_ptr<NewConnectionBalancer> newConnectionBalancer_;
+  size_t numHandshakeWorkers_{0};
   // factory to create per worker QuicTransportStatsCallback
   std::unique_ptr<QuicTransportStatsCallbackFactory> transportStatsFactory_;
   // factory to create per worker ConnectionIdAlgo
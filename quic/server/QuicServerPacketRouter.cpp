@@ -20,6 +20,62 @@ namespace quic {
  */
 constexpr uint16_t kMaxBufSizeForTakeoverEncapsulation = 64;
 
+namespace {
+size_t forwardedPacketHeaderSize(const folly::SocketAddress& peerAddress) {
+  return sizeof(uint16_t) + peerAddress.getActualSize() + sizeof(uint64_t);
+}
+
+void writeForwardedPacketHeader(
+    folly::io::Appender& appender,
+    const folly::SocketAddress& peerAddress,
+    const TimePoint& packetReceiveTime) {
+  sockaddr_storage addrStorage;
+  uint16_t socklen = peerAddress.getAddress(&addrStorage);
+  appender.writeBE<uint16_t>(socklen);
+  appender.push((uint8_t*)&addrStorage, socklen);
+  uint64_t tick = packetReceiveTime.time_since_epoch().count();
+  appender.writeBE<uint64_t>(tick);
+}
+
+/**
+ * Reads the client address and the time the packet was received, which
+ * precede every forwarded packet. Returns false if they are malformed.
+ */
+bool readForwardedPacketHeader(
+    folly::io::Cursor& cursor,
+    folly::SocketAddress& peerAddress,
+    TimePoint& packetReceiveTime) {
+  if (!cursor.canAdvance(sizeof(uint16_t))) {
+    VLOG(4) << "Malformed packet received. Dropping.";
+    return false;
+  }
+  uint16_t addrLen = cursor.readBE<uint16_t>();
+  if (addrLen > sizeof(sockaddr_storage) || !cursor.canAdvance(addrLen)) {
+    VLOG(4) << "Cannot extract peerAddress address of length=" << addrLen
+            << " from the forwarded packet. Dropping the packet.";
+    return false;
+  }
+  sockaddr_storage addrStorage;
+  cursor.pull(&addrStorage, addrLen);
+  try {
+    peerAddress.setFromSockaddr((struct sockaddr*)&addrStorage, addrLen);
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Invalid client address encoded: addrlen=" << addrLen
+               << " ex=" << ex.what();
+    return false;
+  }
+  // decode the packetReceiveTime
+  if (!cursor.canAdvance(sizeof(uint64_t))) {
+    VLOG(4) << "Malformed packet received without packetReceiveTime. Dropping.";
+    return false;
+  }
+  auto pktReceiveEpoch = cursor.readBE<uint64_t>();
+  Clock::duration tick(pktReceiveEpoch);
+  packetReceiveTime = TimePoint(tick);
+  return true;
+}
+} // namespace
+
 TakeoverHandlerCallback::TakeoverHandlerCallback(
     QuicServerWorker* worker,
     TakeoverPacketHandler& takeoverPktHandler,
@@ -57,12 +113,14 @@ int TakeoverHandlerCallback::getSocketFD() {
 }
 
 void TakeoverHandlerCallback::getReadBuffer(void** buf, size_t* len) noexcept {
-  readBuffer_ = folly::IOBuf::create(
+  // Large enough for a single forwarded packet, or for a batch of them.
+  size_t bufSize = std::max<size_t>(
       transportSettings_.maxRecvPacketSize +
-      kMaxBufSizeForTakeoverEncapsulation);
+          kMaxBufSizeForTakeoverEncapsulation,
+      kMaxTakeoverBatchSize);
+  readBuffer_ = folly::IOBuf::create(bufSize);
   *buf = readBuffer_->writableData();
-  *len = transportSettings_.maxRecvPacketSize +
-      kMaxBufSizeForTakeoverEncapsulation;
+  *len = bufSize;
 }
 
 void TakeoverHandlerCallback::onDataAvailable(
@@ -105,8 +163,10 @@ void TakeoverHandlerCallback::onReadClosed() noexcept {
 }
 
 void TakeoverPacketHandler::setDestination(
-    const folly::SocketAddress& destAddr) {
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion version) {
   pktForwardDestAddr_ = folly::SocketAddress(destAddr);
+  takeoverProtocol_ = version;
   packetForwardingEnabled_ = true;
 }
 
@@ -114,23 +174,62 @@ void TakeoverPacketHandler::forwardPacketToAnotherServer(
     const folly::SocketAddress& peerAddress,
     Buf data,
     const TimePoint& packetReceiveTime) {
+  if (takeoverProtocol_ == TakeoverProtocolVersion::V1) {
+    batchPacket(peerAddress, std::move(data), packetReceiveTime);
+    return;
+  }
   // create buffer for the peerAddress address and clientPacketReceiveTime
   // Serialize: version (4B), socket(2 + 16)B and time of ack (8B)
-  auto bufSize = sizeof(TakeoverProtocolVersion) + sizeof(uint16_t) +
-      peerAddress.getActualSize() + sizeof(uint64_t);
+  auto bufSize = sizeof(TakeoverProtocolVersion) +
+      forwardedPacketHeaderSize(peerAddress);
   Buf writeBuffer = folly::IOBuf::create(bufSize);
   folly::io::Appender appender(writeBuffer.get(), bufSize);
   appender.writeBE<uint32_t>(static_cast<uint32_t>(takeoverProtocol_));
-  sockaddr_storage addrStorage;
-  uint16_t socklen = peerAddress.getAddress(&addrStorage);
-  appender.writeBE<uint16_t>(socklen);
-  appender.push((uint8_t*)&addrStorage, socklen);
-  uint64_t tick = packetReceiveTime.time_since_epoch().count();
-  appender.writeBE<uint64_t>(tick);
+  writeForwardedPacketHeader(appender, peerAddress, packetReceiveTime);
   writeBuffer->prependChain(std::move(data));
   forwardPacket(std::move(writeBuffer));
 }
 
+void TakeoverPacketHandler::batchPacket(
+    const folly::SocketAddress& peerAddress,
+    Buf data,
+    const TimePoint& packetReceiveTime) {
+  // Serialize: socket(2 + 16)B, time of ack (8B), packet length (2B) and the
+  // packet, after the version (4B) that starts the datagram.
+  size_t packetLen = data->computeChainDataLength();
+  // The packet was read from a udp socket, so its length fits.
+  DCHECK_LE(packetLen, std::numeric_limits<uint16_t>::max());
+  auto needed =
+      forwardedPacketHeaderSize(peerAddress) + sizeof(uint16_t) + packetLen;
+  if (pendingBatch_ &&
+      pendingBatch_->length() + needed > kMaxTakeoverBatchSize) {
+    forwardPacket(std::move(pendingBatch_));
+  }
+  if (!pendingBatch_) {
+    pendingBatch_ = folly::IOBuf::create(std::max<size_t>(
+        kMaxTakeoverBatchSize, sizeof(TakeoverProtocolVersion) + needed));
+    folly::io::Appender appender(pendingBatch_.get(), 0);
+    appender.writeBE<uint32_t>(static_cast<uint32_t>(takeoverProtocol_));
+  }
+  // Copying the packet keeps the datagram in a single buffer, so that it is
+  // written without being coalesced again by the socket.
+  folly::io::Appender appender(pendingBatch_.get(), 0);
+  writeForwardedPacketHeader(appender, peerAddress, packetReceiveTime);
+  appender.writeBE<uint16_t>(static_cast<uint16_t>(packetLen));
+  for (auto range : *data) {
+    appender.push(range.data(), range.size());
+  }
+  if (!isLoopCallbackScheduled()) {
+    worker_->getEventBase()->runInLoop(this);
+  }
+}
+
+void TakeoverPacketHandler::runLoopCallback() noexcept {
+  if (pendingBatch_) {
+    forwardPacket(std::move(pendingBatch_));
+  }
+}
+
 TakeoverPacketHandler::TakeoverPacketHandler(QuicServerWorker* worker)
     : worker_(worker) {}
 
@@ -173,50 +272,20 @@ void TakeoverPacketHandler::processForwardedPacket(
   }
   uint32_t protocol =
       cursor.readBE<std::underlying_type<TakeoverProtocolVersion>::type>();
-  if (protocol != static_cast<uint32_t>(takeoverProtocol_)) {
-    VLOG(4) << "Unexpected takeover protocol version=" << protocol;
+  if (protocol == static_cast<uint32_t>(TakeoverProtocolVersion::V1)) {
+    processForwardedBatch(cursor);
     return;
   }
-  if (!cursor.canAdvance(sizeof(uint16_t))) {
-    VLOG(4) << "Malformed packet received. Dropping.";
+  if (protocol != static_cast<uint32_t>(TakeoverProtocolVersion::V0)) {
+    VLOG(4) << "Unexpected takeover protocol version=" << protocol;
     return;
   }
-  uint16_t addrLen = cursor.readBE<uint16_t>();
-  struct sockaddr* sockaddr = nullptr;
-  std::pair<const uint8_t*, size_t> addrData = cursor.peek();
-  if (addrData.second >= addrLen) {
-    // the address is contiguous in the queue
-    sockaddr = (struct sockaddr*)addrData.first;
-    cursor.skip(addrLen);
-  } else {
-    // the address is not contiguous, copy it to a local buffer
-    uint8_t* sockaddrBuf =
-        new uint8_t[std::min(addrLen, kMaxBufSizeForTakeoverEncapsulation)];
-    if (!cursor.canAdvance(addrLen)) {
-      VLOG(4) << "Cannot extract peerAddress address of length=" << addrLen
-              << " from the forwarded packet. Dropping the packet.";
-      return;
-    }
-    cursor.pull(sockaddrBuf, addrLen);
-    sockaddr = (struct sockaddr*)sockaddrBuf;
-  }
   folly::SocketAddress peerAddress;
-  try {
-    CHECK_NOTNULL(sockaddr);
-    peerAddress.setFromSockaddr(sockaddr, addrLen);
-  } catch (const std::exception& ex) {
-    LOG(ERROR) << "Invalid client address encoded: addrlen=" << addrLen
-               << " ex=" << ex.what();
-    return;
-  }
-  // decode the packetReceiveTime
-  if (!cursor.canAdvance(sizeof(uint64_t))) {
-    VLOG(4) << "Malformed packet received without packetReceiveTime. Dropping.";
+  TimePoint clientPacketReceiveTime;
+  if (!readForwardedPacketHeader(
+          cursor, peerAddress, clientPacketReceiveTime)) {
     return;
   }
-  auto pktReceiveEpoch = cursor.readBE<uint64_t>();
-  Clock::duration tick(pktReceiveEpoch);
-  TimePoint clientPacketReceiveTime(tick);
   data->trimStart(cursor - data.get());
   QUIC_STATS(worker_->getInfoCallback(), onForwardedPacketProcessed);
   worker_->handleNetworkData(
@@ -226,8 +295,42 @@ void TakeoverPacketHandler::processForwardedPacket(
       /* isForwardedData */ true);
 }
 
+void TakeoverPacketHandler::processForwardedBatch(folly::io::Cursor& cursor) {
+  // The packets share the buffer the datagram was read into.
+  while (!cursor.isAtEnd()) {
+    folly::SocketAddress peerAddress;
+    TimePoint clientPacketReceiveTime;
+    if (!readForwardedPacketHeader(
+            cursor, peerAddress, clientPacketReceiveTime)) {
+      return;
+    }
+    if (!cursor.canAdvance(sizeof(uint16_t))) {
+      VLOG(4) << "Malformed batch received without packet length. Dropping.";
+      return;
+    }
+    auto packetLen = cursor.readBE<uint16_t>();
+    if (!cursor.canAdvance(packetLen)) {
+      VLOG(4) << "Forwarded packet of length=" << packetLen
+              << " is truncated. Dropping the rest of the batch.";
+      return;
+    }
+    Buf packet;
+    cursor.clone(packet, packetLen);
+    QUIC_STATS(worker_->getInfoCallback(), onForwardedPacketProcessed);
+    worker_->handleNetworkData(
+        peerAddress,
+        std::move(packet),
+        clientPacketReceiveTime,
+        /* isForwardedData */ true);
+  }
+}
+
 void TakeoverPacketHandler::stop() {
   packetForwardingEnabled_ = false;
+  // Packets still waiting for the end of the loop are dropped, like the ones
+  // arriving after forwarding stops.
+  cancelLoopCallback();
+  pendingBatch_.reset();
   pktForwardingSocket_.reset();
 }
 } // namespace quic
@@ -9,7 +9,9 @@
 #pragma once
 #include <unordered_map>
 
+#include <folly/io/Cursor.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/EventBase.h>
 
 #include <quic/QuicConstants.h>
 #include <quic/codec/ConnectionIdAlgo.h>
@@ -30,7 +32,11 @@ enum class ProcessId : uint8_t { ZERO = 0x0, ONE = 0x1 };
  * Version of the 'takeover' protocol
  */
 enum class TakeoverProtocolVersion : uint32_t {
+  // One forwarded packet per datagram.
   V0 = 0x00000001,
+  // Several forwarded packets per datagram, each with its own length, see
+  // kMaxTakeoverBatchSize.
+  V1 = 0x00000002,
 };
 
 struct RoutingData {
@@ -46,6 +52,11 @@ struct RoutingData {
   // Source connection may not be present for short header packets.
   folly::Optional<ConnectionId> sourceConnId;
 
+  // Set on the short header packets a data worker had no connection for, and
+  // routes back to its handshake worker, see
+  // QuicServer::setNumHandshakeWorkers().
+  bool missedOnDataWorker{false};
+
   RoutingData(
       HeaderForm headerFormIn,
       bool isInitialIn,
@@ -66,14 +77,21 @@ struct RoutingData {
  * another quic server (on the same host) and process the packets forwarded by
  * another quic server.
  */
-class TakeoverPacketHandler {
+class TakeoverPacketHandler : public folly::EventBase::LoopCallback {
  public:
   explicit TakeoverPacketHandler(QuicServerWorker* worker);
-  virtual ~TakeoverPacketHandler();
+  virtual ~TakeoverPacketHandler() override;
 
   void setSocketFactory(QuicUDPSocketFactory* factory);
 
-  void setDestination(const folly::SocketAddress& destAddr);
+  /**
+   * Forwards the packets to destAddr with the given version of the protocol,
+   * which must be one the other server can process. With V1 the packets
+   * forwarded during a loop iteration are sent together at the end of it.
+   */
+  void setDestination(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion version = TakeoverProtocolVersion::V0);
 
   void forwardPacketToAnotherServer(
       const folly::SocketAddress& peerAddress,
@@ -84,15 +102,26 @@ class TakeoverPacketHandler {
 
   void stop();
 
+  /**
+   * The latest version of the protocol this server can process forwarded
+   * packets in. It processes all the earlier ones too.
+   */
   TakeoverProtocolVersion getTakeoverProtocolVersion() const noexcept {
-    return TakeoverProtocolVersion::V0;
+    return TakeoverProtocolVersion::V1;
   }
 
+  void runLoopCallback() noexcept override;
+
   TakeoverProtocolVersion takeoverProtocol_{TakeoverProtocolVersion::V0};
 
  private:
   std::unique_ptr<folly::AsyncUDPSocket> makeSocket(folly::EventBase* evb);
   void forwardPacket(Buf packet);
+  void batchPacket(
+      const folly::SocketAddress& peerAddress,
+      Buf data,
+      const TimePoint& packetReceiveTime);
+  void processForwardedBatch(folly::io::Cursor& cursor);
   // prevent copying
   TakeoverPacketHandler(const TakeoverPacketHandler&);
   TakeoverPacketHandler& operator=(const TakeoverPacketHandler&);
@@ -102,6 +131,9 @@ class TakeoverPacketHandler {
   std::unique_ptr<folly::AsyncUDPSocket> pktForwardingSocket_;
   bool packetForwardingEnabled_{false};
   QuicUDPSocketFactory* socketFactory_{nullptr};
+  // The V1 datagram being filled, sent at the end of the loop or once the
+  // next packet doesn't fit.
+  Buf pendingBatch_;
 };
 
 /**
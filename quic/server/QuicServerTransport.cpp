@@ -7,10 +7,14 @@
  */
 
 #include <quic/server/QuicServerTransport.h>
+#include <quic/api/QuicPathScheduler.h>
+#include <quic/handshake/CertificateCompression.h>
 
 #include <quic/server/handshake/AppToken.h>
 #include <quic/server/handshake/DefaultAppTokenValidator.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/PathEstimateCache.h>
+#include <quic/state/QuicPacingFunctions.h>
 #include <algorithm>
 
 namespace quic {
@@ -76,6 +80,15 @@ void QuicServerTransport::setTransportInfoCallback(
   if (conn_) {
     conn_->infoCallback = infoCallback;
   }
+  if (infoCallback && infoCallback->latencySamplingEnabled()) {
+    writeLooper_->setLagCallback([this](std::chrono::microseconds lag) {
+      QUIC_STATS(
+          conn_->infoCallback,
+          onLatencySample,
+          QuicTransportStatsCallback::LatencyType::EVENT_LOOP_LAG,
+          lag);
+    });
+  }
 }
 
 void QuicServerTransport::setConnectionIdAlgo(
@@ -95,9 +108,15 @@ void QuicServerTransport::setCongestionControllerFactory(
   }
 }
 
+void QuicServerTransport::setQLogSampler(
+    std::shared_ptr<const QLogSampler> qLogSampler) {
+  qLogSampler_ = std::move(qLogSampler);
+}
+
 void QuicServerTransport::onReadData(
     const folly::SocketAddress& peer,
     NetworkData&& networkData) {
+  wakeUp();
   ServerEvents::ReadData readData;
   readData.peer = peer;
   readData.networkData = std::move(networkData);
@@ -107,6 +126,7 @@ void QuicServerTransport::onReadData(
   if (closeState_ == CloseState::CLOSED) {
     return;
   }
+  maybeApplyTicketCongestionState();
   if (!notifiedRouting_ && routingCb_ && conn_->serverConnectionId) {
     notifiedRouting_ = true;
     if (routingCb_) {
@@ -115,24 +135,444 @@ void QuicServerTransport::onReadData(
     }
   }
   maybeWriteNewSessionTicket();
+  maybeRefreshSessionTicket();
+  maybeWriteNewToken();
   maybeNotifyConnectionIdBound();
   maybeIssueConnectionIds();
   maybeNotifyTransportReady();
+  maybeStartQLogging();
+  writeStandbyPathProbes();
+  scheduleHibernationTimeout();
+}
+
+void QuicServerTransport::setCryptoExecutor(
+    std::shared_ptr<folly::Executor> cryptoExecutor) {
+  cryptoExecutor_ = std::move(cryptoExecutor);
+}
+
+void QuicServerTransport::setInitialCipherCache(
+    std::shared_ptr<InitialCipherCache> initialCipherCache) {
+  serverConn_->initialCipherCache = std::move(initialCipherCache);
+}
+
+void QuicServerTransport::setCertificateMessageCache(
+    std::shared_ptr<CertificateMessageCache> certificateMessageCache) {
+  certificateMessageCache_ = std::move(certificateMessageCache);
+}
+
+void QuicServerTransport::setNewTokenGenerator(
+    std::shared_ptr<const RetryTokenGenerator> newTokenGenerator) {
+  serverConn_->newTokenGenerator = std::move(newTokenGenerator);
+}
+
+void QuicServerTransport::setTransportParametersCache(
+    std::shared_ptr<ServerTransportParametersCache> transportParametersCache) {
+  serverConn_->transportParametersCache = std::move(transportParametersCache);
+}
+
+void QuicServerTransport::setConnectionIdPool(
+    ConnectionIdPool::SharedPtr connectionIdPool) {
+  serverConn_->connectionIdPool = std::move(connectionIdPool);
+}
+
+void QuicServerTransport::setSharedStreamStatePool(
+    std::shared_ptr<StreamStatePool> pool) {
+  conn_->streamManager->setSharedStreamStatePool(std::move(pool));
+}
+
+void QuicServerTransport::seedPacingRate(std::chrono::microseconds rtt) {
+  if (conn_->pacer && conn_->congestionController) {
+    conn_->pacer->refreshPacingRate(
+        conn_->congestionController->getCongestionWindow(), rtt);
+  }
+}
+
+void QuicServerTransport::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  cryptoFactory_ = std::move(cryptoFactory);
 }
 
 void QuicServerTransport::accept() {
   setIdleTimer();
   updateFlowControlStateWithSettings(
       conn_->flowControlState, conn_->transportSettings);
+  if (cryptoFactory_) {
+    serverConn_->serverHandshakeLayer->setCryptoFactory(cryptoFactory_);
+  }
+  if (conn_->transportSettings.certificateCompression) {
+    serverConn_->serverHandshakeLayer->setCertificateCompressionAlgorithms(
+        getCertificateCompressionAlgorithms());
+  }
   serverConn_->serverHandshakeLayer->initialize(
       evb_,
       ctx_,
       this,
       std::make_unique<DefaultAppTokenValidator>(
           serverConn_, std::move(earlyDataAppParamsValidator_)));
+  serverConn_->serverHandshakeLayer->setRetainOneRttSecrets(
+      retainOneRttSecrets());
+  if (cryptoExecutor_) {
+    serverConn_->serverHandshakeLayer->setCryptoExecutor(cryptoExecutor_.get());
+  }
+  if (certificateMessageCache_) {
+    serverConn_->serverHandshakeLayer->setCertificateMessageCache(
+        certificateMessageCache_);
+  }
+}
+
+void QuicServerTransport::adopt(const ServerConnectionSnapshot& snapshot) {
+  CHECK(snapshot.clientConnectionId && snapshot.serverConnectionId);
+  setIdleTimer();
+  updateFlowControlStateWithSettings(
+      conn_->flowControlState, conn_->transportSettings);
+  adoptOneRttSecrets(snapshot.secrets, snapshot.alpn);
+
+  conn_->version = snapshot.version;
+  conn_->originalVersion = snapshot.version;
+  conn_->clientConnectionId = snapshot.clientConnectionId;
+  conn_->serverConnectionId = snapshot.serverConnectionId;
+  // ConnectionIdData can't be assigned, only copied.
+  conn_->selfConnectionIds.clear();
+  for (const auto& connIdData : snapshot.selfConnectionIds) {
+    conn_->selfConnectionIds.push_back(connIdData);
+  }
+  conn_->peerConnectionIds.clear();
+  for (const auto& connIdData : snapshot.peerConnectionIds) {
+    conn_->peerConnectionIds.push_back(connIdData);
+  }
+  conn_->nextSelfConnectionIdSequence = snapshot.nextSelfConnectionIdSequence;
+  conn_->peerAddress = snapshot.peerAddress;
+  conn_->originalPeerAddress = snapshot.originalPeerAddress;
+
+  conn_->peerAckDelayExponent = snapshot.peerAckDelayExponent;
+  conn_->peerIdleTimeout = snapshot.peerIdleTimeout;
+  conn_->udpSendPacketLen = snapshot.udpSendPacketLen;
+  conn_->peerActiveConnectionIdLimit = snapshot.peerActiveConnectionIdLimit;
+  conn_->partialReliabilityEnabled = snapshot.partialReliabilityEnabled;
+
+  conn_->ackStates.appDataAckState.nextPacketNum = snapshot.nextPacketNum;
+  conn_->ackStates.appDataAckState.largestReceivedPacketNum =
+      snapshot.largestReceivedPacketNum;
+  if (snapshot.nextPacketNum > 0) {
+    conn_->lossState.largestSent = snapshot.nextPacketNum - 1;
+  }
+
+  auto& flowControl = conn_->flowControlState;
+  flowControl.windowSize = snapshot.connWindowSize;
+  flowControl.advertisedMaxOffset = snapshot.connAdvertisedMaxOffset;
+  flowControl.peerAdvertisedMaxOffset = snapshot.connPeerAdvertisedMaxOffset;
+  flowControl.sumCurReadOffset = snapshot.sumCurReadOffset;
+  flowControl.sumMaxObservedOffset = snapshot.sumMaxObservedOffset;
+  flowControl.sumCurWriteOffset = snapshot.sumCurWriteOffset;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      snapshot.peerAdvertisedInitialMaxStreamOffsetBidiLocal;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+      snapshot.peerAdvertisedInitialMaxStreamOffsetBidiRemote;
+  flowControl.peerAdvertisedInitialMaxStreamOffsetUni =
+      snapshot.peerAdvertisedInitialMaxStreamOffsetUni;
+
+  conn_->lossState.srtt = snapshot.srtt;
+  conn_->lossState.lrtt = snapshot.lrtt;
+  conn_->lossState.rttvar = snapshot.rttvar;
+  conn_->lossState.mrtt = snapshot.mrtt;
+
+  conn_->streamManager->setStreamIdState(snapshot.streamIds);
+  for (const auto& streamSnapshot : snapshot.streams) {
+    auto stream = conn_->streamManager->getStream(streamSnapshot.id);
+    CHECK(stream) << "stream " << streamSnapshot.id << " is not open";
+    stream->currentWriteOffset = streamSnapshot.currentWriteOffset;
+    stream->currentReadOffset = streamSnapshot.currentReadOffset;
+    stream->currentReceiveOffset = streamSnapshot.currentReceiveOffset;
+    stream->minimumRetransmittableOffset =
+        streamSnapshot.minimumRetransmittableOffset;
+    stream->maxOffsetObserved = streamSnapshot.maxOffsetObserved;
+    stream->finalWriteOffset = streamSnapshot.finalWriteOffset;
+    stream->finalReadOffset = streamSnapshot.finalReadOffset;
+    switch (streamSnapshot.sendState) {
+      case 0:
+        stream->send.state = StreamSendStates::Open();
+        break;
+      case 1:
+        stream->send.state = StreamSendStates::ResetSent();
+        break;
+      case 2:
+        stream->send.state = StreamSendStates::Closed();
+        break;
+      default:
+        stream->send.state = StreamSendStates::Invalid();
+        break;
+    }
+    switch (streamSnapshot.recvState) {
+      case 0:
+        stream->recv.state = StreamReceiveStates::Open();
+        break;
+      case 1:
+        stream->recv.state = StreamReceiveStates::Closed();
+        break;
+      default:
+        stream->recv.state = StreamReceiveStates::Invalid();
+        break;
+    }
+    stream->flowControlState.windowSize = streamSnapshot.windowSize;
+    stream->flowControlState.advertisedMaxOffset =
+        streamSnapshot.advertisedMaxOffset;
+    stream->flowControlState.peerAdvertisedMaxOffset =
+        streamSnapshot.peerAdvertisedMaxOffset;
+    stream->priority = streamSnapshot.priority;
+    if (streamSnapshot.isControl) {
+      conn_->streamManager->setStreamAsControl(*stream);
+    }
+  }
+
+  makeOneRttCodecAndCiphers();
+  updatePacingOnKeyEstablished(*conn_);
+
+  // The old process already did all of this, the connection ids just need to
+  // be routed to this transport.
+  notifiedRouting_ = true;
+  notifiedConnIdBound_ = true;
+  newSessionTicketWritten_ = true;
+  connectionIdsIssued_ = true;
+  if (routingCb_) {
+    std::vector<ConnectionId> connIds;
+    connIds.reserve(conn_->selfConnectionIds.size());
+    for (const auto& connIdData : conn_->selfConnectionIds) {
+      connIds.push_back(connIdData.connId);
+    }
+    routingCb_->onConnectionIdsAvailable(
+        shared_from_this(), std::move(connIds));
+  }
+  maybeNotifyTransportReady();
+  scheduleHibernationTimeout();
+}
+
+bool QuicServerTransport::retainOneRttSecrets() const {
+  return conn_->transportSettings.allowConnectionTakeover ||
+      conn_->transportSettings.hibernationTimeout > 0ms;
+}
+
+void QuicServerTransport::adoptOneRttSecrets(
+    const ServerHandshake::OneRttSecrets& secrets,
+    folly::Optional<std::string> alpn) {
+  auto handshakeLayer = serverConn_->serverHandshakeLayer;
+  if (cryptoFactory_) {
+    handshakeLayer->setCryptoFactory(cryptoFactory_);
+  }
+  handshakeLayer->initialize(evb_, ctx_, this);
+  handshakeLayer->setRetainOneRttSecrets(retainOneRttSecrets());
+  handshakeLayer->adoptOneRttSecrets(secrets, std::move(alpn));
+}
+
+void QuicServerTransport::makeOneRttCodecAndCiphers() {
+  auto handshakeLayer = serverConn_->serverHandshakeLayer;
+  conn_->readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+  conn_->readCodec->setClientConnectionId(*conn_->clientConnectionId);
+  conn_->readCodec->setServerConnectionId(*conn_->serverConnectionId);
+  conn_->readCodec->setCodecParameters(CodecParameters(
+      conn_->peerAckDelayExponent,
+      conn_->version.value_or(*conn_->originalVersion)));
+  conn_->readCodec->setOneRttReadCipher(handshakeLayer->getOneRttReadCipher());
+  conn_->readCodec->setOneRttHeaderCipher(
+      handshakeLayer->getOneRttReadHeaderCipher());
+  conn_->readCodec->onHandshakeDone(Clock::now());
+  conn_->oneRttWriteCipher = handshakeLayer->getOneRttWriteCipher();
+  conn_->oneRttWriteHeaderCipher = handshakeLayer->getOneRttWriteHeaderCipher();
+}
+
+void QuicServerTransport::scheduleHibernationTimeout() {
+  if (closeState_ != CloseState::OPEN || hibernatedState_ ||
+      conn_->transportSettings.hibernationTimeout == 0ms) {
+    return;
+  }
+  scheduleTimeout(
+      &hibernationTimeout_, conn_->transportSettings.hibernationTimeout);
+}
+
+void QuicServerTransport::hibernate() {
+  if (closeState_ != CloseState::OPEN || hibernatedState_) {
+    return;
+  }
+  auto handshakeLayer = serverConn_->serverHandshakeLayer;
+  const auto& secrets = handshakeLayer->getOneRttSecrets();
+  // Only the TLS state can write tickets, so the connection waits until it
+  // wrote all of them.
+  bool ticketsWritten = ctx_->getSendNewSessionTicket() ||
+      (newSessionTicketWritten_ &&
+       (!conn_->transportSettings.congestionStateInTicket ||
+        sessionTicketRefreshed_));
+  if (!handshakeLayer->isHandshakeDone() || !secrets ||
+      secrets->clientSecret.empty() || secrets->serverSecret.empty() ||
+      !conn_->clientConnectionId || !conn_->serverConnectionId ||
+      !ticketsWritten || conn_->oneRttKeyUpdate.updater ||
+      !isQuiescent() || shouldWriteData(*conn_) != WriteDataReason::NO_WRITE ||
+      isLossTimeoutScheduled() || isTimeoutScheduled(&ackTimeout_) ||
+      isTimeoutScheduled(&pathValidationTimeout_)) {
+    scheduleHibernationTimeout();
+    return;
+  }
+  VLOG(4) << "Hibernating " << *this;
+  if (conn_->qLogger) {
+    conn_->qLogger->addTransportStateUpdate(kHibernated);
+  }
+  QUIC_TRACE(fst_trace, *conn_, "hibernated");
+  hibernatedState_.emplace();
+  hibernatedState_->secrets = *secrets;
+  hibernatedState_->alpn = handshakeLayer->getApplicationProtocol();
+  // The TLS state and the copy of the context go with the handshake layer.
+  // The connection keeps an uninitialized one until it wakes up. The write
+  // ciphers are kept, the transport writes as soon as there is data.
+  handshakeLayer->cancel();
+  serverConn_->serverHandshakeLayer = new ServerHandshake(*conn_->cryptoState);
+  conn_->handshakeLayer.reset(serverConn_->serverHandshakeLayer);
+  conn_->readCodec.reset();
+}
+
+void QuicServerTransport::wakeUp() {
+  if (!hibernatedState_) {
+    return;
+  }
+  VLOG(4) << "Waking up " << *this;
+  if (conn_->qLogger) {
+    conn_->qLogger->addTransportStateUpdate(kWokeUp);
+  }
+  QUIC_TRACE(fst_trace, *conn_, "woke up");
+  auto hibernatedState = std::move(*hibernatedState_);
+  hibernatedState_.clear();
+  adoptOneRttSecrets(hibernatedState.secrets, std::move(hibernatedState.alpn));
+  makeOneRttCodecAndCiphers();
+}
+
+folly::Optional<std::string> QuicServerTransport::getAppProtocol() const {
+  if (hibernatedState_) {
+    return hibernatedState_->alpn;
+  }
+  return QuicTransportBase::getAppProtocol();
+}
+
+folly::Optional<ServerConnectionSnapshot>
+QuicServerTransport::exportSnapshot() {
+  wakeUp();
+  const auto& secrets = serverConn_->serverHandshakeLayer->getOneRttSecrets();
+  if (closeState_ != CloseState::OPEN ||
+      !serverConn_->serverHandshakeLayer->isHandshakeDone() || !secrets ||
+      secrets->clientSecret.empty() || secrets->serverSecret.empty() ||
+      !conn_->clientConnectionId || !conn_->serverConnectionId ||
+      !isQuiescent()) {
+    return folly::none;
+  }
+  ServerConnectionSnapshot snapshot;
+  snapshot.version = conn_->version.value_or(*conn_->originalVersion);
+  snapshot.alpn = serverConn_->serverHandshakeLayer->getApplicationProtocol();
+  snapshot.secrets = *secrets;
+  snapshot.clientConnectionId = conn_->clientConnectionId;
+  snapshot.serverConnectionId = conn_->serverConnectionId;
+  for (const auto& connIdData : conn_->selfConnectionIds) {
+    snapshot.selfConnectionIds.push_back(connIdData);
+  }
+  for (const auto& connIdData : conn_->peerConnectionIds) {
+    snapshot.peerConnectionIds.push_back(connIdData);
+  }
+  snapshot.nextSelfConnectionIdSequence = conn_->nextSelfConnectionIdSequence;
+  snapshot.peerAddress = conn_->peerAddress;
+  snapshot.originalPeerAddress = conn_->originalPeerAddress;
+
+  snapshot.peerAckDelayExponent = conn_->peerAckDelayExponent;
+  snapshot.peerIdleTimeout = conn_->peerIdleTimeout;
+  snapshot.udpSendPacketLen = conn_->udpSendPacketLen;
+  snapshot.peerActiveConnectionIdLimit = conn_->peerActiveConnectionIdLimit;
+  snapshot.partialReliabilityEnabled = conn_->partialReliabilityEnabled;
+
+  snapshot.nextPacketNum = conn_->ackStates.appDataAckState.nextPacketNum;
+  snapshot.largestReceivedPacketNum =
+      conn_->ackStates.appDataAckState.largestReceivedPacketNum;
+
+  const auto& flowControl = conn_->flowControlState;
+  snapshot.connWindowSize = flowControl.windowSize;
+  snapshot.connAdvertisedMaxOffset = flowControl.advertisedMaxOffset;
+  snapshot.connPeerAdvertisedMaxOffset = flowControl.peerAdvertisedMaxOffset;
+  snapshot.sumCurReadOffset = flowControl.sumCurReadOffset;
+  snapshot.sumMaxObservedOffset = flowControl.sumMaxObservedOffset;
+  snapshot.sumCurWriteOffset = flowControl.sumCurWriteOffset;
+  snapshot.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiLocal;
+  snapshot.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetBidiRemote;
+  snapshot.peerAdvertisedInitialMaxStreamOffsetUni =
+      flowControl.peerAdvertisedInitialMaxStreamOffsetUni;
+
+  snapshot.srtt = conn_->lossState.srtt;
+  snapshot.lrtt = conn_->lossState.lrtt;
+  snapshot.rttvar = conn_->lossState.rttvar;
+  snapshot.mrtt = conn_->lossState.mrtt;
+
+  snapshot.streamIds = conn_->streamManager->getStreamIdState();
+  for (const auto& it : conn_->streamManager->streams()) {
+    const auto& stream = it.second;
+    ServerConnectionSnapshot::Stream streamSnapshot;
+    streamSnapshot.id = stream.id;
+    streamSnapshot.currentWriteOffset = stream.currentWriteOffset;
+    streamSnapshot.currentReadOffset = stream.currentReadOffset;
+    streamSnapshot.currentReceiveOffset = stream.currentReceiveOffset;
+    streamSnapshot.minimumRetransmittableOffset =
+        stream.minimumRetransmittableOffset;
+    streamSnapshot.maxOffsetObserved = stream.maxOffsetObserved;
+    streamSnapshot.finalWriteOffset = stream.finalWriteOffset;
+    streamSnapshot.finalReadOffset = stream.finalReadOffset;
+    streamSnapshot.sendState = stream.send.state.which();
+    streamSnapshot.recvState = stream.recv.state.which();
+    streamSnapshot.windowSize = stream.flowControlState.windowSize;
+    streamSnapshot.advertisedMaxOffset =
+        stream.flowControlState.advertisedMaxOffset;
+    streamSnapshot.peerAdvertisedMaxOffset =
+        stream.flowControlState.peerAdvertisedMaxOffset;
+    streamSnapshot.priority = stream.priority;
+    streamSnapshot.isControl = stream.isControl;
+    snapshot.streams.push_back(std::move(streamSnapshot));
+  }
+
+  // The peer carries on with the process taking over, so the connection is
+  // closed without telling it.
+  closeImpl(
+      std::make_pair(
+          QuicErrorCode(LocalErrorCode::CONNECTION_ABANDONED),
+          std::string("Connection taken over")),
+      false /* drainConnection */,
+      false /* sendCloseImmediately */);
+  return snapshot;
+}
+
+void QuicServerTransport::writeStandbyPathProbes() {
+  if (!conn_->oneRttWriteCipher || !conn_->clientConnectionId) {
+    return;
+  }
+  CHECK(conn_->oneRttWriteHeaderCipher);
+  for (auto& path : serverConn_->migrationState.standbyPaths) {
+    if (path.pendingFrames.empty()) {
+      continue;
+    }
+    bool hasChallenge = std::any_of(
+        path.pendingFrames.begin(),
+        path.pendingFrames.end(),
+        [](const QuicSimpleFrame& frame) {
+          return frame.asPathChallengeFrame() != nullptr;
+        });
+    if (writePathProbe(
+            *socket_,
+            *conn_,
+            path.congestionAndRtt.peerAddress,
+            path.connId.value_or(*conn_->clientConnectionId),
+            std::move(path.pendingFrames),
+            *conn_->oneRttWriteCipher,
+            *conn_->oneRttWriteHeaderCipher) &&
+        hasChallenge) {
+      path.challengeSentTime = Clock::now();
+    }
+    path.pendingFrames.clear();
+  }
 }
 
 void QuicServerTransport::writeData() {
+  wakeUp();
   if (!conn_->clientConnectionId && !conn_->serverConnectionId) {
     // It is possible for the server to invoke writeData() after receiving a
     // packet that could not per parsed successfully.
@@ -183,16 +623,20 @@ void QuicServerTransport::writeData() {
     return;
   }
 
-  if (UNLIKELY(!conn_->initialWriteCipher)) {
+  if (UNLIKELY(!conn_->initialWriteCipher && !conn_->oneRttWriteCipher)) {
     // This would be possible if we read a packet from the network which
-    // could not be parsed later.
+    // could not be parsed later. Adopted connections only have the 1-rtt
+    // ciphers.
     return;
   }
 
-  uint64_t packetLimit =
-      (isConnectionPaced(*conn_)
-           ? conn_->pacer->updateAndGetWriteBatchSize(Clock::now())
-           : conn_->transportSettings.writeConnectionDataPacketsLimit);
+  uint64_t packetLimit = getWritePacketLimit(*conn_);
+  // Until the handshake is done the packets of the different encryption
+  // levels share datagrams.
+  ScopedCoalescedWrite coalescedWrite(
+      *socket_,
+      *conn_,
+      !serverConn_->serverHandshakeLayer->isHandshakeDone());
   CryptoStreamScheduler initialScheduler(
       *conn_, *getCryptoStream(*conn_->cryptoState, EncryptionLevel::Initial));
   CryptoStreamScheduler handshakeScheduler(
@@ -238,23 +682,52 @@ void QuicServerTransport::writeData() {
   }
   if (conn_->oneRttWriteCipher) {
     CHECK(conn_->oneRttWriteHeaderCipher);
-    writeQuicDataToSocket(
+    packetLimit -= writePmtuProbe(
         *socket_,
         *conn_,
-        srcConnId /* src */,
-        destConnId /* dst */,
+        destConnId,
         *conn_->oneRttWriteCipher,
-        *conn_->oneRttWriteHeaderCipher,
-        version,
-        packetLimit);
+        *conn_->oneRttWriteHeaderCipher);
+    if (!packetLimit) {
+      return;
+    }
+    if (conn_->secondaryPaths.empty()) {
+      writeQuicDataToSocket(
+          *socket_,
+          *conn_,
+          srcConnId /* src */,
+          destConnId /* dst */,
+          *conn_->oneRttWriteCipher,
+          *conn_->oneRttWriteHeaderCipher,
+          version,
+          packetLimit);
+      return;
+    }
+    for (const auto& pathWrite : schedulePathWrites(*conn_, packetLimit)) {
+      auto path = findSecondaryPath(*conn_, pathWrite.pathId);
+      folly::Optional<ScopedPathWrite> scopedPathWrite;
+      if (path) {
+        scopedPathWrite.emplace(*conn_, *path);
+      }
+      writeQuicDataToSocket(
+          *socket_,
+          *conn_,
+          srcConnId /* src */,
+          path && path->connId ? *path->connId : destConnId /* dst */,
+          *conn_->oneRttWriteCipher,
+          *conn_->oneRttWriteHeaderCipher,
+          version,
+          pathWrite.packetLimit);
+    }
   }
 }
 
 void QuicServerTransport::closeTransport() {
+  cancelTimeout(&hibernationTimeout_);
   serverConn_->serverHandshakeLayer->cancel();
   // Clear out pending data.
-  serverConn_->pendingZeroRttData.reset();
-  serverConn_->pendingOneRttData.reset();
+  serverConn_->pendingZeroRttData.take();
+  serverConn_->pendingOneRttData.take();
   onServerClose(*serverConn_);
 }
 
@@ -270,6 +743,26 @@ void QuicServerTransport::unbindConnection() {
   }
 }
 
+bool QuicServerTransport::handOffDraining(
+    std::chrono::milliseconds drainPeriod) {
+  // Without the 1-rtt keys the peer may still send long header packets to
+  // the connection ids it chose, which only the transport can route.
+  if (!conn_->transportSettings.compactDrainingConnections || !routingCb_ ||
+      !conn_->oneRttWriteCipher || !conn_->readCodec->getOneRttReadCipher()) {
+    return false;
+  }
+  // When the peer closed first, it isn't answered any more.
+  Buf closePacket;
+  if (!conn_->peerConnectionError) {
+    closePacket = std::move(conn_->lastClosePacket);
+  }
+  return routingCb_->onConnectionDraining(
+      conn_->selfConnectionIds,
+      conn_->peerAddress,
+      std::move(closePacket),
+      drainPeriod);
+}
+
 bool QuicServerTransport::hasWriteCipher() const {
   return conn_->oneRttWriteCipher != nullptr;
 }
@@ -285,6 +778,15 @@ void QuicServerTransport::setClientConnectionId(
       clientConnectionId, kInitialSequenceNumber);
 }
 
+void QuicServerTransport::setOriginalConnectionId(
+    const ConnectionId& originalConnId) {
+  serverConn_->originalConnectionId = originalConnId;
+}
+
+void QuicServerTransport::setNewTokenValidated() {
+  serverConn_->newTokenValidated = true;
+}
+
 void QuicServerTransport::onCryptoEventAvailable() noexcept {
   try {
     VLOG(10) << "onCryptoEventAvailable " << *this;
@@ -298,7 +800,9 @@ void QuicServerTransport::onCryptoEventAvailable() noexcept {
     if (closeState_ == CloseState::CLOSED) {
       return;
     }
+    maybeApplyTicketCongestionState();
     maybeWriteNewSessionTicket();
+    maybeWriteNewToken();
     maybeNotifyConnectionIdBound();
     maybeIssueConnectionIds();
     writeSocketData();
@@ -322,26 +826,40 @@ void QuicServerTransport::onCryptoEventAvailable() noexcept {
 void QuicServerTransport::processPendingData(bool async) {
   // The case when both 0-rtt and 1-rtt pending data are ready to be processed
   // but neither had been shouldn't happen
-  std::unique_ptr<std::vector<ServerEvents::ReadData>> pendingData;
+  PendingPacketBuffer* pendingBuffer = nullptr;
   if (conn_->readCodec && conn_->readCodec->getOneRttReadCipher()) {
-    pendingData = std::move(serverConn_->pendingOneRttData);
+    pendingBuffer = &serverConn_->pendingOneRttData;
     // It's possible that 0-rtt packets are received after CFIN, we are not
     // dealing with that much level of reordering.
-    serverConn_->pendingZeroRttData.reset();
+    serverConn_->pendingZeroRttData.take();
   } else if (conn_->readCodec && conn_->readCodec->getZeroRttReadCipher()) {
-    pendingData = std::move(serverConn_->pendingZeroRttData);
+    pendingBuffer = &serverConn_->pendingZeroRttData;
   }
-  if (pendingData) {
-    // Move the pending data out so that we don't ever add new data to the
+  if (pendingBuffer && pendingBuffer->isOpen()) {
+    // Take the pending data out so that we don't ever add new data to the
     // pending data.
-    VLOG_IF(10, !pendingData->empty())
-        << "Processing pending data size=" << pendingData->size() << " "
+    auto pendingData = pendingBuffer->take();
+    VLOG_IF(10, !pendingData.empty())
+        << "Processing pending data size=" << pendingData.size() << " "
         << *this;
-    auto func = [pendingData = std::move(pendingData)](auto self) {
+    auto func = [pendingData = std::move(pendingData)](auto self) mutable {
       auto serverPtr = static_cast<QuicServerTransport*>(self.get());
-      for (auto& pendingPacket : *pendingData) {
-        serverPtr->onNetworkData(
-            pendingPacket.peer, std::move(pendingPacket.networkData));
+      // The packets from the same peer are read as one batch, so that the
+      // short header ones are parsed in one pass.
+      auto it = pendingData.begin();
+      while (it != pendingData.end()) {
+        const auto& peer = it->peer;
+        auto batchEnd = std::find_if(
+            it, pendingData.end(), [&](const ServerEvents::ReadData& data) {
+              return data.peer != peer;
+            });
+        std::vector<NetworkData> batch;
+        batch.reserve(std::distance(it, batchEnd));
+        for (auto batchIt = it; batchIt != batchEnd; ++batchIt) {
+          batch.push_back(std::move(batchIt->networkData));
+        }
+        serverPtr->onNetworkDataBatch(peer, std::move(batch));
+        it = batchEnd;
         if (serverPtr->closeState_ == CloseState::CLOSED) {
           // The pending data could potentially contain a connection close, or
           // the app could have triggered a connection close with an error. It
@@ -365,37 +883,111 @@ void QuicServerTransport::processPendingData(bool async) {
 void QuicServerTransport::maybeWriteNewSessionTicket() {
   if (!newSessionTicketWritten_ && !ctx_->getSendNewSessionTicket() &&
       serverConn_->serverHandshakeLayer->isHandshakeDone()) {
-    if (conn_->qLogger) {
-      conn_->qLogger->addTransportStateUpdate(kWriteNst);
-    }
-    QUIC_TRACE(fst_trace, *conn_, "write nst");
     newSessionTicketWritten_ = true;
-    AppToken appToken;
-    appToken.transportParams = createTicketTransportParameters(
-        conn_->transportSettings.idleTimeout.count(),
-        conn_->transportSettings.maxRecvPacketSize,
-        conn_->transportSettings.advertisedInitialConnectionWindowSize,
-        conn_->transportSettings.advertisedInitialBidiLocalStreamWindowSize,
-        conn_->transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
-        conn_->transportSettings.advertisedInitialUniStreamWindowSize,
-        std::numeric_limits<uint32_t>::max(),
-        std::numeric_limits<uint32_t>::max());
-    appToken.sourceAddresses = serverConn_->tokenSourceAddresses;
-    appToken.version = conn_->version;
-    // If a client connects to server for the first time and doesn't attempt
-    // early data, tokenSourceAddresses will not be set because
-    // validateAndUpdateSourceAddressToken is not called in this case.
-    // So checking if source address token is empty here and adding peerAddr
-    // if so.
-    // TODO accumulate recent source tokens
-    if (appToken.sourceAddresses.empty()) {
-      appToken.sourceAddresses.push_back(conn_->peerAddress.getIPAddress());
-    }
-    if (earlyDataAppParamsGetter_) {
-      appToken.appParams = earlyDataAppParamsGetter_();
-    }
-    serverConn_->serverHandshakeLayer->writeNewSessionTicket(appToken);
+    newSessionTicketTime_ = Clock::now();
+    writeNewSessionTicket();
+  }
+}
+
+void QuicServerTransport::maybeRefreshSessionTicket() {
+  // The first ticket only has the estimates of the handshake, write another
+  // one once they had time to converge.
+  if (conn_->transportSettings.congestionStateInTicket &&
+      newSessionTicketWritten_ && !sessionTicketRefreshed_ &&
+      !ctx_->getSendNewSessionTicket() &&
+      Clock::now() - newSessionTicketTime_ >= kCongestionStateTicketDelay) {
+    sessionTicketRefreshed_ = true;
+    writeNewSessionTicket();
+  }
+}
+
+void QuicServerTransport::writeNewSessionTicket() {
+  if (conn_->qLogger) {
+    conn_->qLogger->addTransportStateUpdate(kWriteNst);
+  }
+  QUIC_TRACE(fst_trace, *conn_, "write nst");
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn_->transportSettings.idleTimeout.count(),
+      conn_->transportSettings.maxRecvPacketSize,
+      conn_->transportSettings.advertisedInitialConnectionWindowSize,
+      conn_->transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn_->transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn_->transportSettings.advertisedInitialUniStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = serverConn_->tokenSourceAddresses;
+  appToken.version = conn_->version;
+  appToken.compact = conn_->transportSettings.compactAppTokens;
+  // If a client connects to server for the first time and doesn't attempt
+  // early data, tokenSourceAddresses will not be set because
+  // validateAndUpdateSourceAddressToken is not called in this case.
+  // So checking if source address token is empty here and adding peerAddr
+  // if so.
+  // TODO accumulate recent source tokens
+  if (appToken.sourceAddresses.empty()) {
+    appToken.sourceAddresses.push_back(conn_->peerAddress.getIPAddress());
+  }
+  if (earlyDataAppParamsGetter_) {
+    appToken.appParams = earlyDataAppParamsGetter_();
+  }
+  if (conn_->transportSettings.congestionStateInTicket &&
+      conn_->congestionController && conn_->lossState.srtt > 0us) {
+    TicketCongestionState congestionState;
+    congestionState.srtt = conn_->lossState.srtt;
+    congestionState.minRtt = conn_->lossState.mrtt;
+    congestionState.bandwidth =
+        conn_->congestionController->getCongestionWindow() *
+        std::chrono::microseconds(1s).count() / conn_->lossState.srtt.count();
+    congestionState.timestamp =
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+    appToken.congestionState = congestionState;
+  }
+  serverConn_->serverHandshakeLayer->writeNewSessionTicket(appToken);
+}
+
+void QuicServerTransport::maybeWriteNewToken() {
+  if (newTokenWritten_ || !serverConn_->newTokenGenerator ||
+      !serverConn_->serverHandshakeLayer->isHandshakeDone()) {
+    return;
+  }
+  newTokenWritten_ = true;
+  auto token =
+      serverConn_->newTokenGenerator->generateNewToken(conn_->peerAddress);
+  sendSimpleFrame(*conn_, NewTokenFrame(std::move(token)));
+}
+
+void QuicServerTransport::maybeApplyTicketCongestionState() {
+  if (!serverConn_->ticketCongestionState) {
+    return;
+  }
+  auto congestionState = *serverConn_->ticketCongestionState;
+  serverConn_->ticketCongestionState = folly::none;
+  if (!conn_->congestionController || !ccFactory_) {
+    return;
+  }
+  PathEstimateCache::Estimate estimate;
+  estimate.bandwidth = congestionState.bandwidth;
+  estimate.minRtt = congestionState.minRtt;
+  auto initCwndInMss = PathEstimateCache::initCwndInMss(
+      estimate, conn_->transportSettings, conn_->udpSendPacketLen);
+  VLOG(10) << "Resuming with initCwndInMss=" << initCwndInMss
+           << " from the ticket, srtt=" << congestionState.srtt.count()
+           << "us " << *this;
+  // The congestion controllers only read the initial cwnd when they are made.
+  // Carry over the bytes already in flight.
+  conn_->transportSettings.initCwndInMss = initCwndInMss;
+  auto congestionController = ccFactory_->makeCongestionController(
+      *conn_, conn_->congestionController->type());
+  if (!congestionController) {
+    return;
+  }
+  for (const auto& packet : conn_->outstandingPackets) {
+    congestionController->onPacketSent(packet);
   }
+  conn_->congestionController = std::move(congestionController);
+  seedPacingRate(congestionState.srtt);
 }
 
 void QuicServerTransport::maybeNotifyConnectionIdBound() {
@@ -416,15 +1008,15 @@ void QuicServerTransport::maybeIssueConnectionIds() {
 
     const uint64_t maximumIdsToIssue = std::min(
         conn_->peerActiveConnectionIdLimit, kMinNumAvailableConnIds - 1);
+    // The ids are routed to the transport all at once.
+    std::vector<ConnectionId> connIds;
+    connIds.reserve(maximumIdsToIssue);
     for (size_t i = 0; i < maximumIdsToIssue; i++) {
       auto newConnIdData = serverConn_->createAndAddNewSelfConnId();
       if (!newConnIdData.hasValue()) {
-        return;
+        break;
       }
-
-      CHECK(routingCb_);
-      routingCb_->onConnectionIdAvailable(
-          shared_from_this(), newConnIdData->connId);
+      connIds.push_back(newConnIdData->connId);
 
       NewConnectionIdFrame frame(
           newConnIdData->sequenceNumber,
@@ -433,6 +1025,11 @@ void QuicServerTransport::maybeIssueConnectionIds() {
           *newConnIdData->token);
       sendSimpleFrame(*conn_, std::move(frame));
     }
+    if (!connIds.empty()) {
+      CHECK(routingCb_);
+      routingCb_->onConnectionIdsAvailable(
+          shared_from_this(), std::move(connIds));
+    }
   }
 }
 
@@ -447,5 +1044,60 @@ void QuicServerTransport::maybeNotifyTransportReady() {
   }
 }
 
+bool QuicServerTransport::isQuiescent() const {
+  if (!conn_->outstandingPackets.empty() ||
+      !conn_->pendingEvents.frames.empty() ||
+      !conn_->pendingEvents.resets.empty() ||
+      conn_->pendingEvents.pathChallenge ||
+      conn_->outstandingPathValidation ||
+      serverConn_->pendingOneRttData.isOpen() ||
+      serverConn_->pendingZeroRttData.isOpen()) {
+    return false;
+  }
+  for (const auto* cryptoStream :
+       {&conn_->cryptoState->initialStream,
+        &conn_->cryptoState->handshakeStream,
+        &conn_->cryptoState->oneRttStream}) {
+    if (!cryptoStream->writeBuffer.empty() ||
+        !cryptoStream->retransmissionBuffer.empty() ||
+        !cryptoStream->lossBuffer.empty()) {
+      return false;
+    }
+  }
+  const auto& streamManager = *conn_->streamManager;
+  if (streamManager.hasWritable() || streamManager.hasLoss() ||
+      streamManager.hasBlocked() || streamManager.hasWindowUpdates() ||
+      streamManager.hasDeliverable()) {
+    return false;
+  }
+  for (const auto& it : streamManager.streams()) {
+    const auto& stream = it.second;
+    if (!stream.writeBuffer.empty() || !stream.retransmissionBuffer.empty() ||
+        !stream.lossBuffer.empty() || !stream.readBuffer.empty() ||
+        stream.streamReadError || stream.streamWriteError ||
+        matchesStates<StreamSendStateData, StreamSendStates::ResetSent>(
+            stream.send.state)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void QuicServerTransport::maybeStartQLogging() {
+  if (conn_->qLogger || !qLogSampler_ || !qLogSampler_->hasLossTriggers()) {
+    return;
+  }
+  auto qLogger = qLogSampler_->maybeCreateForLossyConnection(
+      conn_->lossState.rtxCount,
+      conn_->lossState.totalPTOCount,
+      VantagePoint::SERVER);
+  if (!qLogger) {
+    return;
+  }
+  qLogger->dcid = conn_->clientConnectionId;
+  qLogger->scid = conn_->serverConnectionId;
+  setQLogger(std::move(qLogger));
+}
+
 
 } // namespace quic
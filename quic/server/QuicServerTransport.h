@@ -12,7 +12,9 @@
 #include <quic/api/QuicTransportFunctions.h>
 #include <quic/codec/ConnectionIdAlgo.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/logging/QLogSampler.h>
 #include <quic/server/handshake/ServerTransportParametersExtension.h>
+#include <quic/server/state/ServerConnectionSnapshot.h>
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
@@ -35,6 +37,15 @@ class QuicServerTransport
         Ptr transport,
         ConnectionId id) noexcept = 0;
 
+    // Called when several connection ids are available at once
+    virtual void onConnectionIdsAvailable(
+        Ptr transport,
+        std::vector<ConnectionId> ids) noexcept {
+      for (auto& id : ids) {
+        onConnectionIdAvailable(transport, std::move(id));
+      }
+    }
+
     // Called when a connecton id is bound and ip address should not
     // be used any more for routing.
     virtual void onConnectionIdBound(Ptr transport) noexcept = 0;
@@ -44,6 +55,18 @@ class QuicServerTransport
         QuicServerTransport* transport,
         const SourceIdentity& address,
         const std::vector<ConnectionIdData>& connectionIdData) noexcept = 0;
+
+    // Called when the connection starts draining, before it is unbound.
+    // Returns true if the packets sent to the connection ids are answered
+    // with closePacket, if any, for drainPeriod, so that the transport can
+    // be freed right away.
+    virtual bool onConnectionDraining(
+        const std::vector<ConnectionIdData>& /* connectionIdData */,
+        const folly::SocketAddress& /* peerAddress */,
+        Buf /* closePacket */,
+        std::chrono::milliseconds /* drainPeriod */) noexcept {
+      return false;
+    }
   };
 
   static QuicServerTransport::Ptr make(
@@ -88,22 +111,136 @@ class QuicServerTransport
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> factory) override;
 
+  /**
+   * Set the sampler that may start qlogging the connection once it turns
+   * lossy, if it was not qlogged from its start.
+   */
+  void setQLogSampler(std::shared_ptr<const QLogSampler> qLogSampler);
+
+  /**
+   * Set the executor that the expensive part of the handshake runs on, see
+   * ServerHandshake::setCryptoExecutor(). Must be set before accept().
+   */
+  void setCryptoExecutor(std::shared_ptr<folly::Executor> cryptoExecutor);
+
+  /**
+   * Set the factory that makes the packet protection of the connection, see
+   * ServerHandshake::setCryptoFactory(). Must be set before accept().
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
+  /**
+   * Derive the Initial ciphers of the connection through the worker's cache.
+   * Must be set before the first packet is read.
+   */
+  void setInitialCipherCache(
+      std::shared_ptr<InitialCipherCache> initialCipherCache);
+
+  /**
+   * Share the Certificate message of the handshake with the other handshakes
+   * of the worker, see ServerHandshake::setCertificateMessageCache(). Must be
+   * set before accept().
+   */
+  void setCertificateMessageCache(
+      std::shared_ptr<CertificateMessageCache> certificateMessageCache);
+
+  /**
+   * Set the generator of the token of the NEW_TOKEN frame, sent once the
+   * handshake is done.
+   */
+  void setNewTokenGenerator(
+      std::shared_ptr<const RetryTokenGenerator> newTokenGenerator);
+
+  /**
+   * Reuse the transport parameters encoded by the other handshakes of the
+   * worker. Must be set before the first packet is read.
+   */
+  void setTransportParametersCache(
+      std::shared_ptr<ServerTransportParametersCache> transportParametersCache);
+
+  /**
+   * Take the connection ids of the connection from the worker's pool. The
+   * pool must encode them with the ServerConnectionIdParams of the connection
+   * and its stateless reset secret. Must be set before the first packet is
+   * read.
+   */
+  void setConnectionIdPool(ConnectionIdPool::SharedPtr connectionIdPool);
+
+  /**
+   * Open the streams of the connection in the memory of the closed streams
+   * of the other connections of the worker, see
+   * TransportSettings::workerStreamStatePoolSize. Must be set on the thread
+   * of the worker, before the first packet is read.
+   */
+  void setSharedStreamStatePool(std::shared_ptr<StreamStatePool> pool);
+
+  /**
+   * Paces the first flights of the connection as if the path had the given
+   * rtt, until the congestion controller refreshes the pacing rate from its
+   * own samples. Must be called after setTransportSettings(), does nothing
+   * when pacing is disabled.
+   */
+  void seedPacingRate(std::chrono::microseconds rtt);
+
   virtual void setClientConnectionId(const ConnectionId& clientConnectionId);
 
+  /**
+   * Sets the destination connection id of the client's first Initial, when
+   * the client address was validated by a Retry.
+   */
+  virtual void setOriginalConnectionId(const ConnectionId& originalConnId);
+
+  /**
+   * Marks the client address as validated by the token of a NEW_TOKEN frame
+   * the client got in a previous connection.
+   */
+  virtual void setNewTokenValidated();
+
   // From QuicTransportBase
   void onReadData(const folly::SocketAddress& peer, NetworkData&& networkData)
       override;
   void writeData() override;
   void closeTransport() override;
   void unbindConnection() override;
+  bool handOffDraining(std::chrono::milliseconds drainPeriod) override;
   bool hasWriteCipher() const override;
   std::shared_ptr<QuicTransportBase> sharedGuard() override;
 
+  // From QuicSocket
+  folly::Optional<std::string> getAppProtocol() const override;
+
   const fizz::server::FizzServerContext& getCtx() {
     return *ctx_;
   }
 
   virtual void accept();
+
+  /**
+   * Carries on with a connection exported by another process, instead of
+   * accept(). The transport must be set up as if it was about to accept, with
+   * the same connection id parameters as the exporting server.
+   */
+  virtual void adopt(const ServerConnectionSnapshot& snapshot);
+
+  /**
+   * Returns the state of the connection and closes it without telling the
+   * peer, so that the process taking over the server can adopt() it. Returns
+   * none and leaves the connection alone when it can't be exported: the
+   * handshake isn't done, the secrets weren't kept (see
+   * TransportSettings::allowConnectionTakeover), or data is in flight or
+   * buffered.
+   */
+  folly::Optional<ServerConnectionSnapshot> exportSnapshot();
+
+  /**
+   * Whether the connection dropped its TLS state and read codec after
+   * staying quiescent for TransportSettings::hibernationTimeout. They are
+   * rebuilt by the next packet or write.
+   */
+  bool isHibernated() const {
+    return hibernatedState_.hasValue();
+  }
+
   void setShedConnection() {
     shedConnection_ = true;
   }
@@ -120,7 +257,49 @@ class QuicServerTransport
   void maybeNotifyTransportReady();
   void maybeNotifyConnectionIdBound();
   void maybeWriteNewSessionTicket();
+  void maybeRefreshSessionTicket();
+  void writeNewSessionTicket();
+  void maybeWriteNewToken();
+  void maybeApplyTicketCongestionState();
   void maybeIssueConnectionIds();
+  void maybeStartQLogging();
+  // Answers the probes the client sent on its standby paths, see
+  // TransportSettings::enableStandbyPaths.
+  void writeStandbyPathProbes();
+  bool isQuiescent() const;
+  bool retainOneRttSecrets() const;
+  // Puts the handshake layer in the established phase with the given secrets.
+  void adoptOneRttSecrets(
+      const ServerHandshake::OneRttSecrets& secrets,
+      folly::Optional<std::string> alpn);
+  // Makes the read codec and takes the 1-rtt ciphers of the handshake layer.
+  void makeOneRttCodecAndCiphers();
+  void scheduleHibernationTimeout();
+  void hibernate();
+  void wakeUp();
+
+  class HibernationTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    ~HibernationTimeout() override = default;
+
+    explicit HibernationTimeout(QuicServerTransport* transport)
+        : transport_(transport) {}
+
+    void timeoutExpired() noexcept override {
+      transport_->hibernate();
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    QuicServerTransport* transport_;
+  };
+
+  // What a hibernated connection rebuilds its TLS state and read codec from.
+  struct HibernatedState {
+    ServerHandshake::OneRttSecrets secrets;
+    folly::Optional<std::string> alpn;
+  };
 
  private:
   RoutingCallback* routingCb_{nullptr};
@@ -128,8 +307,17 @@ class QuicServerTransport
   bool notifiedRouting_{false};
   bool notifiedConnIdBound_{false};
   bool newSessionTicketWritten_{false};
+  bool sessionTicketRefreshed_{false};
+  bool newTokenWritten_{false};
+  TimePoint newSessionTicketTime_;
   bool shedConnection_{false};
   bool connectionIdsIssued_{false};
+  std::shared_ptr<const QLogSampler> qLogSampler_;
+  std::shared_ptr<folly::Executor> cryptoExecutor_;
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
+  std::shared_ptr<CertificateMessageCache> certificateMessageCache_;
+  HibernationTimeout hibernationTimeout_{this};
+  folly::Optional<HibernatedState> hibernatedState_;
   QuicServerConnectionState* serverConn_;
 };
 } // namespace quic
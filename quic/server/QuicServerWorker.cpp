@@ -6,14 +6,24 @@
  *
  */
 
+#include <folly/Random.h>
+#include <folly/String.h>
 #include <folly/io/Cursor.h>
+#include <folly/net/NetOps.h>
 #include <folly/system/ThreadId.h>
 #include <quic/QuicConstants.h>
+#include <quic/api/QuicTransportFunctions.h>
 #include <quic/common/Timers.h>
+#include <quic/handshake/FizzCryptoFactory.h>
 
 #include <quic/server/QuicServerWorker.h>
+#include <quic/server/ReusePortSteering.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 namespace quic {
 
 QuicServerWorker::QuicServerWorker(
@@ -37,6 +47,45 @@ void QuicServerWorker::bind(const folly::SocketAddress& address) {
   socket_->setDFAndTurnOffPMTU();
 }
 
+bool QuicServerWorker::attachReusePortSteering() {
+  CHECK(socket_);
+  return attachReusePortSteeringProgram(socket_->getNetworkSocket());
+}
+
+bool QuicServerWorker::setCpuAffinity(int cpu) {
+  CHECK(socket_);
+  DCHECK(evb_->isInEventBaseThread());
+#if defined(__linux__)
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    LOG(ERROR) << "Invalid cpu=" << cpu;
+    return false;
+  }
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(cpu, &cpuSet);
+  // 0 is the calling thread.
+  if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+    LOG(ERROR) << "sched_setaffinity failed: " << folly::errnoStr(errno);
+    return false;
+  }
+#if defined(SO_INCOMING_CPU)
+  if (folly::netops::setsockopt(
+          socket_->getNetworkSocket(),
+          SOL_SOCKET,
+          SO_INCOMING_CPU,
+          &cpu,
+          sizeof(cpu)) != 0) {
+    LOG(ERROR) << "SO_INCOMING_CPU failed: " << folly::errnoStr(errno);
+    return false;
+  }
+#endif
+  return true;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
 void QuicServerWorker::setTransportSettingsOverrideFn(
     TransportSettingsOverrideFn fn) {
   transportSettingsOverrideFn_ = std::move(fn);
@@ -57,6 +106,7 @@ void QuicServerWorker::setConnectionIdAlgo(
     std::unique_ptr<ConnectionIdAlgo> connIdAlgo) noexcept {
   CHECK(connIdAlgo);
   connIdAlgo_ = std::move(connIdAlgo);
+  connectionIdPool_.reset();
 }
 
 void QuicServerWorker::setCongestionControllerFactory(
@@ -65,13 +115,126 @@ void QuicServerWorker::setCongestionControllerFactory(
   ccFactory_ = ccFactory;
 }
 
+void QuicServerWorker::setQLogSampler(
+    std::shared_ptr<const QLogSampler> qLogSampler) {
+  qLogSampler_ = std::move(qLogSampler);
+}
+
+void QuicServerWorker::setCryptoExecutor(
+    std::shared_ptr<folly::Executor> cryptoExecutor) {
+  cryptoExecutor_ = std::move(cryptoExecutor);
+}
+
+void QuicServerWorker::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  cryptoFactory_ = std::move(cryptoFactory);
+}
+
+void QuicServerWorker::setPathEstimateCache(
+    std::shared_ptr<PathEstimateCache> pathEstimateCache) {
+  pathEstimateCache_ = std::move(pathEstimateCache);
+}
+
 void QuicServerWorker::start() {
   CHECK(socket_);
+  if (transportSettings_.expectedConnectionsPerWorker > 0) {
+    connectionIdMap_.reserve(transportSettings_.expectedConnectionsPerWorker);
+  }
   if (!pacingTimer_) {
     pacingTimer_ = TimerHighRes::newTimer(
         evb_, transportSettings_.pacingTimerTickInterval);
   }
-  socket_->resumeRead(this);
+  if (transportSettings_.pacingSchedulerEnabled && !pacingScheduler_) {
+    pacingScheduler_ = std::make_shared<PacingScheduler>(pacingTimer_);
+  }
+  if (transportSettings_.writeSchedulerEnabled && !writeScheduler_) {
+    writeScheduler_ = std::make_shared<WriteScheduler>(
+        evb_,
+        transportSettings_.writeSchedulerTimeBudget,
+        transportSettings_.writeSchedulerPacketBudget,
+        transportSettings_.writeSchedulerPacketQuantum);
+  }
+  if (transportSettings_.recvBufferPoolSize > 0 && !recvBufferPool_) {
+    // The pool is only used from the worker's thread.
+    recvBufferPool_ = std::make_unique<BufferPool>(
+        transportSettings_.maxRecvPacketSize,
+        transportSettings_.recvBufferPoolSize,
+        transportSettings_.recvBufferPoolRegionSize);
+  }
+  if (transportSettings_.workerBufferMemoryBudget > 0 &&
+      !bufferMemoryBudget_) {
+    bufferMemoryBudget_ = std::make_shared<BufferMemoryBudget>(
+        transportSettings_.workerBufferMemoryBudget);
+  }
+  if (transportSettings_.txTimePacing &&
+      !TxTimePacketBatchWriter::enableTxTime(socket_->getNetworkSocket())) {
+    // The transports made from now on fall back to timer pacing.
+    LOG(ERROR) << "SO_TXTIME is not supported, using timer pacing";
+    transportSettings_.txTimePacing = false;
+  }
+  if (transportSettings_.loadShedding && !loadMonitor_) {
+    loadMonitor_ = std::make_unique<WorkerLoadMonitor>(
+        evb_, *transportSettings_.loadShedding);
+    loadMonitor_->start();
+  }
+  if (transportSettings_.initialCipherCacheSize > 0 && !initialCipherCache_) {
+    initialCipherCache_ = std::make_shared<InitialCipherCache>(
+        transportSettings_.initialCipherCacheSize);
+  }
+  if (transportSettings_.certificateMessageCacheSize > 0 &&
+      !certificateMessageCache_) {
+    certificateMessageCache_ = std::make_shared<CertificateMessageCache>(
+        transportSettings_.certificateMessageCacheSize);
+  }
+  if (transportSettings_.maxCoalescedWriteBatchSize > 0 && !writeCoalescer_) {
+    writeCoalescer_ = QuicWriteCoalescer::registerSocket(
+        evb_, *socket_, transportSettings_.maxCoalescedWriteBatchSize);
+  }
+  if (!batchReadHandler_) {
+    bool groEnabled = transportSettings_.groEnabled &&
+        RecvmmsgBatchReader::enableGRO(socket_->getNetworkSocket());
+    bool ecnEnabled = transportSettings_.ecnEnabled &&
+        RecvmmsgBatchReader::enableECN(
+            socket_->getNetworkSocket(), socket_->address().getFamily());
+    if (transportSettings_.ecnEnabled && !ecnEnabled) {
+      LOG(ERROR) << "ECN is not supported on the socket";
+    }
+    bool timestampsEnabled = transportSettings_.kernelReceiveTimestamps &&
+        RecvmmsgBatchReader::enableTimestamps(socket_->getNetworkSocket());
+    if (transportSettings_.kernelReceiveTimestamps && !timestampsEnabled) {
+      LOG(ERROR) << "Receive timestamps are not supported on the socket";
+    }
+    // The codepoints and the timestamps are only reported through control
+    // messages, which the socket's own reads don't surface.
+    if (groEnabled || ecnEnabled || timestampsEnabled) {
+      batchReadHandler_ = std::make_unique<BatchReadHandler>(
+          evb_,
+          socket_->getNetworkSocket(),
+          std::make_unique<RecvmmsgBatchReader>(
+              transportSettings_.maxRecvBatchSize,
+              transportSettings_.maxRecvPacketSize,
+              groEnabled,
+              ecnEnabled,
+              timestampsEnabled),
+          this);
+    }
+  }
+  if (batchReadHandler_) {
+    batchReadHandler_->start();
+  } else {
+    if (transportSettings_.batchingMode ==
+            QuicBatchingMode::BATCHING_MODE_GSO_ZEROCOPY &&
+        !zeroCopyTracker_) {
+      // Zero copy completions are delivered on the socket's error queue,
+      // which the socket drains while we are reading from it.
+      zeroCopyTracker_ =
+          ZeroCopyTracker::registerSocket(socket_->getNetworkSocket());
+      if (zeroCopyTracker_) {
+        socket_->setErrMessageCallback(this);
+      }
+    }
+    socket_->resumeRead(this);
+  }
   VLOG(10) << "Registered read on worker=" << this
            << " thread=" << folly::getCurrentThreadID()
            << " processId=" << (int)processId_;
@@ -79,6 +242,9 @@ void QuicServerWorker::start() {
 
 void QuicServerWorker::pauseRead() {
   CHECK(socket_);
+  if (batchReadHandler_) {
+    batchReadHandler_->pause();
+  }
   socket_->pauseRead();
 }
 
@@ -93,7 +259,16 @@ const folly::SocketAddress& QuicServerWorker::getAddress() const {
 }
 
 void QuicServerWorker::getReadBuffer(void** buf, size_t* len) noexcept {
-  readBuffer_ = folly::IOBuf::create(transportSettings_.maxRecvPacketSize);
+  if (recvBufferPool_) {
+    readBuffer_ = recvBufferPool_->getBuffer();
+    QUIC_STATS(
+        infoCallback_,
+        onRecvBufferPoolStats,
+        recvBufferPool_->pooledBuffers(),
+        recvBufferPool_->highWaterMark());
+  } else {
+    readBuffer_ = folly::IOBuf::create(transportSettings_.maxRecvPacketSize);
+  }
   *buf = readBuffer_->writableData();
   *len = transportSettings_.maxRecvPacketSize;
 }
@@ -105,17 +280,12 @@ bool QuicServerWorker::maybeSendVersionNegotiationPacketOrDrop(
     const folly::SocketAddress& client,
     bool isInitial,
     LongHeaderInvariant& invariant) {
-  folly::Optional<std::pair<VersionNegotiationPacket, Buf>>
-      versionNegotiationPacket;
+  const VersionNegotiationPacketTemplate* versionNegotiationTemplate =
+      nullptr;
   if (rejectNewConnections_ && isInitial) {
-    VersionNegotiationPacketBuilder builder(
-        invariant.dstConnId,
-        invariant.srcConnId,
-        std::vector<QuicVersion>{QuicVersion::MVFST_INVALID});
-    versionNegotiationPacket =
-        folly::make_optional(std::move(builder).buildPacket());
-  }
-  if (!versionNegotiationPacket) {
+    versionNegotiationTemplate = &rejectVersionNegotiationTemplate_;
+  }
+  if (!versionNegotiationTemplate) {
     bool negotiationNeeded = std::find(
                                  supportedVersions_.begin(),
                                  supportedVersions_.end(),
@@ -127,22 +297,144 @@ bool QuicServerWorker::maybeSendVersionNegotiationPacketOrDrop(
       return true;
     }
     if (negotiationNeeded) {
-      VersionNegotiationPacketBuilder builder(
-          invariant.dstConnId, invariant.srcConnId, supportedVersions_);
-      versionNegotiationPacket =
-          folly::make_optional(std::move(builder).buildPacket());
-    }
-  }
-  if (versionNegotiationPacket) {
-    VLOG(4) << "Version negotiation sent to client=" << client;
-    auto len = versionNegotiationPacket->second->computeChainDataLength();
-    QUIC_STATS(infoCallback_, onWrite, len);
-    QUIC_STATS(infoCallback_, onPacketProcessed);
-    QUIC_STATS(infoCallback_, onPacketSent);
-    socket_->write(client, versionNegotiationPacket->second);
+      versionNegotiationTemplate = &versionNegotiationTemplate_;
+    }
+  }
+  if (!versionNegotiationTemplate) {
+    return false;
+  }
+  if (versionNegotiationLimiter_ && !versionNegotiationLimiter_->consume(1)) {
+    VLOG(4) << "Version negotiation rate limited, client=" << client;
     return true;
   }
-  return false;
+  auto versionNegotiationPacket = versionNegotiationTemplate->buildPacket(
+      invariant.dstConnId, invariant.srcConnId);
+  VLOG(4) << "Version negotiation sent to client=" << client;
+  QUIC_STATS(infoCallback_, onWrite, versionNegotiationPacket->length());
+  QUIC_STATS(infoCallback_, onPacketProcessed);
+  QUIC_STATS(infoCallback_, onPacketSent);
+  socket_->write(client, versionNegotiationPacket);
+  return true;
+}
+
+bool QuicServerWorker::maybeSendRetryPacketOrDrop(
+    const folly::SocketAddress& client,
+    const RoutingData& routingData,
+    const NetworkData& networkData,
+    folly::Optional<ConnectionId>& originalConnId,
+    bool& newTokenValidated) {
+  if (!retryTokenGenerator_) {
+    return false;
+  }
+  // Only the header is parsed, before anything is allocated for the
+  // connection.
+  folly::io::Cursor cursor(networkData.data.get());
+  uint8_t initialByte = cursor.readBE<uint8_t>();
+  auto parsedHeader = parseLongHeader(initialByte, cursor);
+  if (!parsedHeader || !parsedHeader->parsedLongHeader) {
+    VLOG(3) << "Dropping unparseable initial packet from client=" << client;
+    QUIC_STATS(
+        infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+    return true;
+  }
+  const auto& header = parsedHeader->parsedLongHeader->header;
+  if (!header.getToken().empty()) {
+    if (transportSettings_.issueNewTokens &&
+        retryTokenGenerator_->validateNewToken(
+            header.getToken(), client, transportSettings_.newTokenLifetime)) {
+      newTokenValidated = true;
+      return false;
+    }
+    originalConnId = retryTokenGenerator_->validateToken(
+        header.getToken(), client, transportSettings_.retryTokenLifetime);
+    if (originalConnId) {
+      return false;
+    }
+    // The client may still be validated by a new Retry below.
+    VLOG(4) << "Invalid retry token from client=" << client;
+  }
+  bool retryUnderLoad = getLoadLevel() >= WorkerLoadMonitor::LoadLevel::RETRY;
+  if (!retryUnderLoad &&
+      (!transportSettings_.retryPendingHandshakesThreshold ||
+       sourceAddressMap_.size() <
+           *transportSettings_.retryPendingHandshakesThreshold)) {
+    return false;
+  }
+  std::vector<uint8_t> connIdData(kDefaultConnectionIdSize);
+  folly::Random::secureRandom(connIdData.data(), connIdData.size());
+  LongHeader retryHeader(
+      LongHeader::Types::Retry,
+      ConnectionId(connIdData),
+      *routingData.sourceConnId,
+      0 /* packetNum */,
+      header.getVersion(),
+      retryTokenGenerator_->generateToken(
+          routingData.destinationConnId, client),
+      routingData.destinationConnId);
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(retryHeader), 0 /* largestAcked */);
+  auto packet = std::move(builder).buildPacket();
+  auto retryData = std::move(packet.header);
+  if (packet.body) {
+    retryData->prependChain(std::move(packet.body));
+  }
+  VLOG(4) << "Retry sent to client=" << client;
+  QUIC_STATS(infoCallback_, onWrite, retryData->computeChainDataLength());
+  QUIC_STATS(infoCallback_, onPacketSent);
+  QUIC_STATS(infoCallback_, onRetrySent);
+  socket_->write(client, retryData);
+  return true;
+}
+
+void QuicServerWorker::sendConnectionRefused(
+    const folly::SocketAddress& client,
+    const RoutingData& routingData,
+    const NetworkData& networkData) {
+  QUIC_STATS(infoCallback_, onPacketDropped, PacketDropReason::LOAD_SHEDDING);
+  folly::io::Cursor cursor(networkData.data.get());
+  uint8_t initialByte = cursor.readBE<uint8_t>();
+  auto parsedHeader = parseLongHeader(initialByte, cursor);
+  if (!parsedHeader || !parsedHeader->parsedLongHeader) {
+    VLOG(3) << "Dropping unparseable initial packet from client=" << client;
+    return;
+  }
+  auto version = parsedHeader->parsedLongHeader->header.getVersion();
+  std::unique_ptr<Aead> aead;
+  std::unique_ptr<PacketNumberCipher> headerCipher;
+  if (initialCipherCache_) {
+    aead = initialCipherCache_->getServerInitialCipher(
+        routingData.destinationConnId, version);
+    headerCipher = initialCipherCache_->makeServerInitialHeaderCipher(
+        routingData.destinationConnId, version);
+  } else {
+    FizzCryptoFactory cryptoFactory;
+    aead = cryptoFactory.getServerInitialCipher(
+        routingData.destinationConnId, version);
+    headerCipher = cryptoFactory.makeServerInitialHeaderCipher(
+        routingData.destinationConnId, version);
+  }
+  LongHeader header(
+      LongHeader::Types::Initial,
+      routingData.destinationConnId,
+      *routingData.sourceConnId,
+      0 /* packetNum */,
+      version);
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+  builder.setCipherOverhead(aead->getCipherOverhead());
+  writeFrame(
+      ConnectionCloseFrame(
+          TransportErrorCode::SERVER_BUSY, std::string("server busy")),
+      builder);
+  auto packet = std::move(builder).buildPacket();
+  auto body = aead->encrypt(std::move(packet.body), packet.header.get(), 0);
+  encryptPacketHeader(HeaderForm::Long, *packet.header, *body, *headerCipher);
+  auto packetBuf = std::move(packet.header);
+  packetBuf->prependChain(std::move(body));
+  VLOG(4) << "Connection refused to client=" << client;
+  QUIC_STATS(infoCallback_, onWrite, packetBuf->computeChainDataLength());
+  QUIC_STATS(infoCallback_, onPacketSent);
+  socket_->write(client, packetBuf);
 }
 
 void QuicServerWorker::onDataAvailable(
@@ -166,14 +458,92 @@ void QuicServerWorker::onDataAvailable(
   data->append(len);
   QUIC_STATS(infoCallback_, onPacketReceived);
   QUIC_STATS(infoCallback_, onRead, len);
+  if (!batchReader_) {
+    handleNetworkData(client, std::move(data), packetReceiveTime);
+    return;
+  }
+  // Read the rest of the batch before handling the first packet since
+  // handling it can end up shutting down the worker and closing the socket.
+  auto numRead = batchReader_->readBatch(socket_->getNetworkSocket());
+  if (numRead < 0) {
+    VLOG(4) << "Batched read failed errno=" << errno << " worker=" << this;
+  }
   handleNetworkData(client, std::move(data), packetReceiveTime);
+  handleBatch(batchReader_->packets(), packetReceiveTime);
+}
+
+void QuicServerWorker::errMessage(const cmsghdr& cmsg) noexcept {
+  if (zeroCopyTracker_) {
+    zeroCopyTracker_->maybeHandleErrMessage(cmsg);
+  }
+}
+
+void QuicServerWorker::errMessageError(
+    const folly::AsyncSocketException& ex) noexcept {
+  VLOG(4) << "QuicServer error message error: " << ex.what();
+}
+
+void QuicServerWorker::onBatchRead(
+    std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+    TimePoint receiveTime) noexcept {
+  handleBatch(packets, receiveTime);
+}
+
+void QuicServerWorker::onBatchReadError(int err) noexcept {
+  VLOG(4) << "QuicServer batch read error errno=" << err;
+  if (batchReadHandler_) {
+    batchReadHandler_->pause();
+  }
+  if (!callback_) {
+    VLOG(0) << "Worker callback is null.  Ignoring worker error.";
+    return;
+  }
+  callback_->handleWorkerError(LocalErrorCode::INTERNAL_ERROR);
+}
+
+void QuicServerWorker::handleBatch(
+    std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+    const TimePoint& packetReceiveTime) noexcept {
+  for (auto& packet : packets) {
+    if (packet.truncated) {
+      // This is an error, drop the packet.
+      continue;
+    }
+    auto len = packet.data->length();
+    QUIC_STATS(infoCallback_, onPacketReceived);
+    QUIC_STATS(infoCallback_, onRead, len);
+    handleNetworkData(
+        packet.peer,
+        std::move(packet.data),
+        packet.receiveTime.value_or(packetReceiveTime),
+        false /* isForwardedData */,
+        packet.ecn);
+  }
+  packets.clear();
 }
 
 void QuicServerWorker::handleNetworkData(
     const folly::SocketAddress& client,
     Buf data,
     const TimePoint& packetReceiveTime,
-    bool isForwardedData) noexcept {
+    bool isForwardedData,
+    ECNCodepoint ecn) noexcept {
+  if (bufferMemoryBudget_) {
+    QUIC_STATS(
+        infoCallback_,
+        onBufferMemoryUsage,
+        bufferMemoryBudget_->bytesBuffered(),
+        bufferMemoryBudget_->highWaterMark());
+    if (transportSettings_.reclaimStreamBufferMemory &&
+        bufferMemoryBudget_->underPressure() &&
+        packetReceiveTime - lastBufferMemoryReclaim_ >=
+            kBufferMemoryReclaimInterval) {
+      lastBufferMemoryReclaim_ = packetReceiveTime;
+      for (auto transport : boundServerTransports_) {
+        transport->reclaimBufferMemory();
+      }
+    }
+  }
   try {
     if (shutdown_) {
       VLOG(4) << "Packet received after shutdown, dropping";
@@ -190,6 +560,11 @@ void QuicServerWorker::handleNetworkData(
           PacketDropReason::WORKER_NOT_INITIALIZED);
       return;
     }
+    // Health checks are answered before anything is parsed. The token can't
+    // be parsed as a QUIC header, see QuicServer::setHealthCheckToken().
+    if (maybeHandleHealthCheck(client, *data)) {
+      return;
+    }
     folly::io::Cursor cursor(data.get());
     if (!cursor.canAdvance(sizeof(uint8_t))) {
       VLOG(4) << "Dropping packet too small";
@@ -204,7 +579,10 @@ void QuicServerWorker::handleNetworkData(
       folly::Expected<ShortHeaderInvariant, TransportErrorCode>
           parsedShortHeader = parseShortHeaderInvariants(initialByte, cursor);
       if (!parsedShortHeader) {
-        return tryHandlingAsHealthCheck(client, *data);
+        VLOG(4) << "Dropping packet, cannot parse header client=" << client;
+        QUIC_STATS(
+            infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+        return;
       }
       RoutingData routingData(
           headerForm,
@@ -215,14 +593,17 @@ void QuicServerWorker::handleNetworkData(
       return forwardNetworkData(
           client,
           std::move(routingData),
-          NetworkData(std::move(data), packetReceiveTime),
+          NetworkData(std::move(data), packetReceiveTime, ecn),
           isForwardedData);
     }
 
     folly::Expected<ParsedLongHeaderInvariant, TransportErrorCode>
         parsedLongHeader = parseLongHeaderInvariant(initialByte, cursor);
     if (!parsedLongHeader) {
-      return tryHandlingAsHealthCheck(client, *data);
+      VLOG(4) << "Dropping packet, cannot parse header client=" << client;
+      QUIC_STATS(
+          infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
+      return;
     }
 
     // TODO: check version before looking at type
@@ -243,6 +624,9 @@ void QuicServerWorker::handleNetworkData(
           infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
       return;
     }
+    // The transport reads the header from where the invariant ends.
+    NetworkData networkData(std::move(data), packetReceiveTime, ecn);
+    networkData.longHeaderInvariant = *parsedLongHeader;
     RoutingData routingData(
         headerForm,
         isInitial,
@@ -252,7 +636,7 @@ void QuicServerWorker::handleNetworkData(
     return forwardNetworkData(
         client,
         std::move(routingData),
-        NetworkData(std::move(data), packetReceiveTime),
+        std::move(networkData),
         isForwardedData);
   } catch (const std::exception& ex) {
     // Drop the packet.
@@ -261,29 +645,33 @@ void QuicServerWorker::handleNetworkData(
   }
 }
 
-void QuicServerWorker::tryHandlingAsHealthCheck(
+bool QuicServerWorker::maybeHandleHealthCheck(
     const folly::SocketAddress& client,
     const folly::IOBuf& data) {
-  // If we cannot parse the long header then it is not a QUIC invariant
-  // packet, so just drop it after checking whether it could be a health
-  // check.
-  if (!healthCheckToken_) {
-    VLOG(4) << "Dropping packet, cannot parse header client=" << client;
-    QUIC_STATS(
-        infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
-    return;
+  // The length is compared first, most packets are QUIC packets of another
+  // length.
+  if (!healthCheckToken_ ||
+      data.computeChainDataLength() != (*healthCheckToken_)->length()) {
+    return false;
   }
-
   folly::IOBufEqualTo eq;
   // TODO: make this constant time, the token might be secret, but we're
   // current assuming it's not.
-  if (eq(*healthCheckToken_.value(), data)) {
-    // say that we are OK. The response is much smaller than the
-    // request, so we are not creating an amplification vector. Also
-    // ignore the error code.
-    VLOG(4) << "Health check request, response=OK";
-    socket_->write(client, folly::IOBuf::copyBuffer("OK"));
+  if (!eq(*healthCheckToken_.value(), data)) {
+    return false;
   }
+  // say that we are OK. The response is much smaller than the
+  // request, so we are not creating an amplification vector. Also
+  // ignore the error code.
+  VLOG(4) << "Health check request, response=OK";
+  if (writeCoalescer_) {
+    // Written with the other packets of the loop, in a single sendmmsg.
+    writeCoalescer_->enqueue(
+        client, healthCheckResponse_->clone(), healthCheckResponse_->length());
+  } else {
+    socket_->write(client, healthCheckResponse_);
+  }
+  return true;
 }
 
 void QuicServerWorker::forwardNetworkData(
@@ -316,6 +704,36 @@ void QuicServerWorker::forwardNetworkData(
       client, std::move(routingData), std::move(networkData));
 }
 
+void QuicServerWorker::startPacketBatch() {
+  batchingPackets_ = transportSettings_.batchReceivedPackets;
+}
+
+void QuicServerWorker::finishPacketBatch() {
+  flushPacketBatch();
+  batchingPackets_ = false;
+}
+
+void QuicServerWorker::flushPacketBatch() {
+  if (packetBatch_.empty()) {
+    return;
+  }
+  auto transport = std::move(packetBatchTransport_);
+  packetBatchTransport_ = nullptr;
+  auto batch = std::move(packetBatch_);
+  packetBatch_.clear();
+  if (shutdown_) {
+    // Handling the earlier packets shut the worker down.
+    return;
+  }
+  auto peer = packetBatchPeer_;
+  if (batch.size() == 1) {
+    transport->onNetworkData(peer, std::move(batch.front()));
+  } else {
+    transport->onNetworkDataBatch(peer, std::move(batch));
+  }
+  maybeHandOffConnection(transport);
+}
+
 void QuicServerWorker::setPacingTimer(
     TimerHighRes::SharedPtr pacingTimer) noexcept {
   pacingTimer_ = std::move(pacingTimer);
@@ -326,6 +744,13 @@ void QuicServerWorker::dispatchPacketData(
     RoutingData&& routingData,
     NetworkData&& networkData) noexcept {
   DCHECK(socket_);
+  auto loadLevel = getLoadLevel();
+  if (UNLIKELY(loadLevel == WorkerLoadMonitor::LoadLevel::DROP_HANDSHAKES) &&
+      routingData.headerForm == HeaderForm::Long) {
+    VLOG(4) << "Dropping long header packet under load from client=" << client;
+    QUIC_STATS(infoCallback_, onPacketDropped, PacketDropReason::LOAD_SHEDDING);
+    return;
+  }
   QuicServerTransport::Ptr transport;
   bool dropPacket = false;
   auto cit = connectionIdMap_.find(routingData.destinationConnId);
@@ -333,6 +758,17 @@ void QuicServerWorker::dispatchPacketData(
     transport = cit->second;
     VLOG(10) << "Found existing connection for CID="
              << routingData.destinationConnId.hex() << " " << *transport;
+  } else if (maybeHandleDrainingConnection(
+                 client, routingData.destinationConnId)) {
+    return;
+  } else if (
+      routingData.headerForm != HeaderForm::Long && numHandshakeWorkers_ &&
+      !isHandshakeWorker()) {
+    // The connection may not be handed over from its handshake worker yet.
+    routingData.missedOnDataWorker = true;
+    callback_->routeDataToWorker(
+        client, std::move(routingData), std::move(networkData));
+    return;
   } else if (routingData.headerForm != HeaderForm::Long) {
     // Drop the packet if the header form is not long
     VLOG(3) << "Dropping non-long header packet with no connid match CID="
@@ -377,39 +813,52 @@ void QuicServerWorker::dispatchPacketData(
               infoCallback_, onPacketDropped, PacketDropReason::INVALID_PACKET);
           return;
         }
-        // create 'accepting' transport
-        auto sock = makeSocket(getEventBase());
-        auto trans = transportFactory_->make(
-            getEventBase(), std::move(sock), client, ctx_);
-        trans->setPacingTimer(pacingTimer_);
-        trans->setRoutingCallback(this);
-        trans->setSupportedVersions(supportedVersions_);
-        trans->setOriginalPeerAddress(client);
-        trans->setCongestionControllerFactory(ccFactory_);
-        if (transportSettingsOverrideFn_) {
-          folly::Optional<TransportSettings> overridenTransportSettings =
-              transportSettingsOverrideFn_(
-                  transportSettings_, client.getIPAddress());
-          if (overridenTransportSettings) {
-            trans->setTransportSettings(*overridenTransportSettings);
-          } else {
-            trans->setTransportSettings(transportSettings_);
-          }
-        } else {
-          trans->setTransportSettings(transportSettings_);
+        if (loadLevel >= WorkerLoadMonitor::LoadLevel::REJECT) {
+          sendConnectionRefused(client, routingData, networkData);
+          return;
+        }
+        folly::Optional<ConnectionId> originalConnId;
+        bool newTokenValidated = false;
+        if (maybeSendRetryPacketOrDrop(
+                client,
+                routingData,
+                networkData,
+                originalConnId,
+                newTokenValidated)) {
+          return;
         }
-        trans->setConnectionIdAlgo(connIdAlgo_.get());
+        // Checked once the packet is known to need a transport, so that the
+        // Initials answered with a Retry don't count, and the ones with the
+        // token of a Retry come from the address they claim.
+        if (sourceRateLimiter_ &&
+            !sourceRateLimiter_->tryAcquire(client, Clock::now())) {
+          VLOG(4) << "New connection rate limited, client=" << client;
+          QUIC_STATS(
+              infoCallback_,
+              onPacketDropped,
+              PacketDropReason::SOURCE_RATE_LIMITED);
+          return;
+        }
+        // create 'accepting' transport
+        auto trans = makeTransport(client);
         trans->setClientConnectionId(*routingData.sourceConnId);
-        // parameters to create server chosen connection id
-        ServerConnectionIdParams serverConnIdParams(
-            hostId_, static_cast<uint8_t>(processId_), workerId_);
-        trans->setServerConnectionIdParams(std::move(serverConnIdParams));
-        if (infoCallback_) {
-          trans->setTransportInfoCallback(infoCallback_.get());
+        if (originalConnId) {
+          trans->setOriginalConnectionId(*originalConnId);
+        }
+        if (newTokenValidated) {
+          trans->setNewTokenValidated();
+        }
+        if (qLogSampler_) {
+          auto qLogger = qLogSampler_->maybeCreateForNewConnection(
+              *routingData.destinationConnId, VantagePoint::SERVER);
+          if (qLogger) {
+            trans->setQLogger(std::move(qLogger));
+          }
         }
         trans->accept();
         auto result = sourceAddressMap_.emplace(std::make_pair(
             std::make_pair(client, *routingData.sourceConnId), trans));
+        updateNumConnections();
         if (!result.second) {
           LOG(ERROR) << "Routing entry already exists for client=" << client
                      << ", client CID=" << routingData.sourceConnId->hex();
@@ -425,7 +874,30 @@ void QuicServerWorker::dispatchPacketData(
   }
   if (LIKELY(!dropPacket)) {
     DCHECK(transport->getEventBase()->isInEventBaseThread());
+    if (batchingPackets_ && routingData.headerForm == HeaderForm::Short) {
+      if (packetBatchTransport_ != transport || packetBatchPeer_ != client) {
+        flushPacketBatch();
+        packetBatchTransport_ = std::move(transport);
+        packetBatchPeer_ = client;
+      }
+      packetBatch_.push_back(std::move(networkData));
+      return;
+    }
+    // Keeps the packets of a connection in order.
+    flushPacketBatch();
     transport->onNetworkData(client, std::move(networkData));
+    maybeHandOffConnection(transport);
+    return;
+  }
+  if (routingData.missedOnDataWorker) {
+    // The connection is on its way to the data worker, or gone. Either way
+    // the data worker answers the next packets, without it the client would
+    // get a reset for a connection in the middle of its hand over.
+    VLOG(4) << "Dropping packet missed on the data worker too, CID="
+            << routingData.destinationConnId.hex()
+            << ", workerId=" << (uint32_t)workerId_;
+    QUIC_STATS(
+        infoCallback_, onPacketDropped, PacketDropReason::CONNECTION_NOT_FOUND);
     return;
   }
   ServerConnectionIdParams connIdParam =
@@ -480,6 +952,201 @@ void QuicServerWorker::dispatchPacketData(
   QUIC_STATS(infoCallback_, onPacketForwarded);
 }
 
+QuicServerTransport::Ptr QuicServerWorker::makeTransport(
+    const folly::SocketAddress& client) {
+  auto sock = makeSocket(getEventBase());
+  auto trans =
+      transportFactory_->make(getEventBase(), std::move(sock), client, ctx_);
+  trans->setPacingTimer(pacingTimer_);
+  trans->setPacingScheduler(pacingScheduler_);
+  trans->setWriteScheduler(writeScheduler_);
+  if (bufferMemoryBudget_) {
+    trans->setBufferMemoryBudget(bufferMemoryBudget_);
+  }
+  trans->setRoutingCallback(this);
+  trans->setSupportedVersions(supportedVersions_);
+  trans->setOriginalPeerAddress(client);
+  trans->setCongestionControllerFactory(ccFactory_);
+  folly::Optional<TransportSettings> overridenTransportSettings;
+  if (transportSettingsOverrideFn_) {
+    overridenTransportSettings =
+        transportSettingsOverrideFn_(transportSettings_, client.getIPAddress());
+  }
+  folly::Optional<PathEstimateCache::Estimate> pathEstimate;
+  if (pathEstimateCache_) {
+    pathEstimate = pathEstimateCache_->get(client.getIPAddress());
+  }
+  if (pathEstimate) {
+    if (!overridenTransportSettings) {
+      overridenTransportSettings = transportSettings_;
+    }
+    overridenTransportSettings->initCwndInMss =
+        PathEstimateCache::initCwndInMss(
+            *pathEstimate,
+            *overridenTransportSettings,
+            trans->getState()->udpSendPacketLen);
+  }
+  if (overridenTransportSettings) {
+    trans->setTransportSettings(*overridenTransportSettings);
+  } else {
+    trans->setTransportSettings(transportSettings_);
+  }
+  if (pathEstimate) {
+    trans->seedPacingRate(pathEstimate->minRtt);
+  }
+  trans->setConnectionIdAlgo(connIdAlgo_.get());
+  // parameters to create server chosen connection id
+  ServerConnectionIdParams serverConnIdParams(
+      hostId_,
+      static_cast<uint8_t>(processId_),
+      isHandshakeWorker() ? pickDataWorker() : workerId_);
+  // The connection ids of a handshake worker are for several data workers.
+  if (!isHandshakeWorker() && transportSettings_.connectionIdPoolSize > 0 &&
+      transportSettings_.statelessResetTokenSecret) {
+    // The pool only fits the connections that derive their tokens like the
+    // worker does.
+    const auto& settings = trans->getTransportSettings();
+    if (settings.statelessResetTokenSecret ==
+            transportSettings_.statelessResetTokenSecret &&
+        settings.statelessResetAesTokens ==
+            transportSettings_.statelessResetAesTokens) {
+      if (!connectionIdPool_) {
+        connectionIdPool_ = std::make_shared<ConnectionIdPool>(
+            getEventBase(),
+            connIdAlgo_.get(),
+            serverConnIdParams,
+            std::make_unique<StatelessResetGenerator>(
+                *transportSettings_.statelessResetTokenSecret,
+                getAddress().getFullyQualified(),
+                transportSettings_.statelessResetAesTokens
+                    ? StatelessResetGenerator::Algorithm::AES
+                    : StatelessResetGenerator::Algorithm::HKDF),
+            transportSettings_.connectionIdPoolSize);
+      }
+      trans->setConnectionIdPool(connectionIdPool_);
+    }
+  }
+  trans->setServerConnectionIdParams(std::move(serverConnIdParams));
+  if (infoCallback_) {
+    trans->setTransportInfoCallback(infoCallback_.get());
+  }
+  if (qLogSampler_) {
+    trans->setQLogSampler(qLogSampler_);
+  }
+  if (cryptoExecutor_) {
+    trans->setCryptoExecutor(cryptoExecutor_);
+  }
+  if (cryptoFactory_) {
+    trans->setCryptoFactory(cryptoFactory_);
+  }
+  if (initialCipherCache_) {
+    trans->setInitialCipherCache(initialCipherCache_);
+  }
+  if (certificateMessageCache_) {
+    trans->setCertificateMessageCache(certificateMessageCache_);
+  }
+  if (transportSettings_.issueNewTokens) {
+    trans->setNewTokenGenerator(retryTokenGenerator_);
+  }
+  trans->setTransportParametersCache(transportParametersCache_);
+  if (transportSettings_.workerStreamStatePoolSize > 0) {
+    if (!streamStatePool_) {
+      streamStatePool_ = std::make_shared<StreamStatePool>(
+          QuicStreamManager::streamStateBlockSize(),
+          transportSettings_.workerStreamStatePoolSize);
+    }
+    trans->setSharedStreamStatePool(streamStatePool_);
+  }
+  return trans;
+}
+
+std::vector<ServerConnectionSnapshot> QuicServerWorker::exportConnections() {
+  DCHECK(getEventBase()->isInEventBaseThread());
+  // Exporting a connection unbinds it, which changes the set.
+  std::vector<QuicServerTransport*> transports(
+      boundServerTransports_.begin(), boundServerTransports_.end());
+  std::vector<ServerConnectionSnapshot> snapshots;
+  for (auto transport : transports) {
+    // Keep the transport alive while it is closed.
+    auto guard = transport->sharedGuard();
+    auto snapshot = transport->exportSnapshot();
+    if (snapshot) {
+      snapshots.push_back(std::move(*snapshot));
+    }
+  }
+  VLOG(2) << "Exported " << snapshots.size() << " of " << transports.size()
+          << " connections, workerId=" << (uint32_t)workerId_;
+  return snapshots;
+}
+
+void QuicServerWorker::introspectConnections(
+    ConnectionIntrospectionOptions options,
+    folly::Function<void(WorkerIntrospection)> callback) {
+  DCHECK(getEventBase()->isInEventBaseThread());
+  // The connections can go away between two batches.
+  std::vector<std::weak_ptr<QuicTransportBase>> transports;
+  transports.reserve(boundServerTransports_.size());
+  for (auto transport : boundServerTransports_) {
+    transports.push_back(transport->sharedGuard());
+  }
+  quic::introspectConnections(
+      getEventBase(),
+      workerId_,
+      std::move(transports),
+      options,
+      std::move(callback));
+}
+
+size_t QuicServerWorker::broadcast(
+    const folly::IOBuf& data,
+    const std::vector<BroadcastTarget>& targets,
+    bool eof) {
+  DCHECK(getEventBase()->isInEventBaseThread());
+  size_t written = 0;
+  for (const auto& target : targets) {
+    auto it = connectionIdMap_.find(target.serverConnectionId);
+    if (it == connectionIdMap_.end()) {
+      continue;
+    }
+    auto result = it->second->writeChain(
+        target.streamId, data.clone(), eof, false /* cork */);
+    if (result.hasValue()) {
+      ++written;
+    }
+  }
+  return written;
+}
+
+void QuicServerWorker::maybeHandOffConnection(
+    const QuicServerTransport::Ptr& transport) {
+  // Only connections that are done with their handshake can be exported.
+  if (!isHandshakeWorker() || shutdown_ || !transport->replaySafe()) {
+    return;
+  }
+  auto snapshot = transport->exportSnapshot();
+  if (!snapshot) {
+    return;
+  }
+  auto dataWorkerId =
+      connIdAlgo_->parseConnectionId(*snapshot->serverConnectionId).workerId;
+  VLOG(4) << "Handing connection over from workerId=" << (uint32_t)workerId_
+          << " to workerId=" << (uint32_t)dataWorkerId;
+  callback_->handOffConnection(dataWorkerId, std::move(*snapshot));
+}
+
+void QuicServerWorker::adoptConnection(
+    const ServerConnectionSnapshot& snapshot) {
+  DCHECK(getEventBase()->isInEventBaseThread());
+  CHECK(transportFactory_);
+  if (!snapshot.clientConnectionId || !snapshot.serverConnectionId ||
+      connectionIdMap_.count(*snapshot.serverConnectionId)) {
+    LOG(ERROR) << "Can't adopt connection, workerId=" << (uint32_t)workerId_;
+    return;
+  }
+  auto trans = makeTransport(snapshot.originalPeerAddress);
+  trans->adopt(snapshot);
+}
+
 void QuicServerWorker::sendResetPacket(
     const HeaderForm& headerForm,
     const folly::SocketAddress& client,
@@ -489,19 +1156,36 @@ void QuicServerWorker::sendResetPacket(
     // Only send resets in response to short header packets.
     return;
   }
+  // Checked before deriving the token, so that a flood of packets with
+  // random connection ids costs no more than the resets it is allowed.
+  if (statelessResetLimiter_ && !statelessResetLimiter_->consume(1)) {
+    VLOG(4) << "Stateless reset rate limited, client=" << client;
+    return;
+  }
   uint16_t packetSize = networkData.data->computeChainDataLength();
   uint16_t maxResetPacketSize = std::min<uint16_t>(
       std::max<uint16_t>(kMinStatelessPacketSize, packetSize),
       kDefaultUDPSendPacketLen);
   CHECK(transportSettings_.statelessResetTokenSecret.hasValue());
-  StatelessResetGenerator generator(
-      *transportSettings_.statelessResetTokenSecret,
-      getAddress().getFullyQualified());
-  StatelessResetToken token = generator.generateToken(connId);
+  if (!statelessResetGenerator_) {
+    statelessResetGenerator_ = std::make_unique<StatelessResetGenerator>(
+        *transportSettings_.statelessResetTokenSecret,
+        getAddress().getFullyQualified(),
+        transportSettings_.statelessResetAesTokens
+            ? StatelessResetGenerator::Algorithm::AES
+            : StatelessResetGenerator::Algorithm::HKDF);
+  }
+  StatelessResetToken token = statelessResetGenerator_->generateToken(connId);
   StatelessResetPacketBuilder builder(maxResetPacketSize, token);
   auto resetData = std::move(builder).buildPacket();
-  socket_->write(client, std::move(resetData));
-  QUIC_STATS(infoCallback_, onWrite, resetData->computeChainDataLength());
+  auto resetDataLen = resetData->computeChainDataLength();
+  if (writeCoalescer_) {
+    // Written with the other packets of the loop, in a single sendmmsg.
+    writeCoalescer_->enqueue(client, std::move(resetData), resetDataLen);
+  } else {
+    socket_->write(client, resetData);
+  }
+  QUIC_STATS(infoCallback_, onWrite, resetDataLen);
   QUIC_STATS(infoCallback_, onPacketSent);
   QUIC_STATS(infoCallback_, onStatelessReset);
 }
@@ -522,9 +1206,10 @@ void QuicServerWorker::allowBeingTakenOver(
 }
 
 void QuicServerWorker::startPacketForwarding(
-    const folly::SocketAddress& destAddr) {
+    const folly::SocketAddress& destAddr,
+    TakeoverProtocolVersion version) {
   packetForwardingEnabled_ = true;
-  takeoverPktHandler_.setDestination(destAddr);
+  takeoverPktHandler_.setDestination(destAddr, version);
 }
 
 void QuicServerWorker::stopPacketForwarding() {
@@ -558,6 +1243,7 @@ TakeoverProtocolVersion QuicServerWorker::getTakeoverProtocolVersion() const
 
 void QuicServerWorker::setProcessId(enum ProcessId id) noexcept {
   processId_ = id;
+  connectionIdPool_.reset();
 }
 
 ProcessId QuicServerWorker::getProcessId() const noexcept {
@@ -566,14 +1252,43 @@ ProcessId QuicServerWorker::getProcessId() const noexcept {
 
 void QuicServerWorker::setWorkerId(uint8_t id) noexcept {
   workerId_ = id;
+  connectionIdPool_.reset();
 }
 
 uint8_t QuicServerWorker::getWorkerId() const noexcept {
   return workerId_;
 }
 
+void QuicServerWorker::setHandshakeWorkers(
+    size_t numHandshakeWorkers,
+    size_t numWorkers) noexcept {
+  CHECK_GE(numWorkers, 2 * numHandshakeWorkers);
+  numHandshakeWorkers_ = numHandshakeWorkers;
+  numWorkers_ = numWorkers;
+  connectionIdPool_.reset();
+}
+
+bool QuicServerWorker::isHandshakeWorker() const noexcept {
+  return workerId_ < numHandshakeWorkers_;
+}
+
+size_t QuicServerWorker::getHandshakeWorkerFor(
+    size_t dataWorkerId,
+    size_t numHandshakeWorkers) {
+  CHECK_GE(dataWorkerId, numHandshakeWorkers);
+  return (dataWorkerId - numHandshakeWorkers) % numHandshakeWorkers;
+}
+
+uint8_t QuicServerWorker::pickDataWorker() {
+  // The data workers of this one are N + workerId_ + k * N.
+  size_t numDataWorkers = (numWorkers_ - workerId_ - 1) / numHandshakeWorkers_;
+  size_t k = nextDataWorker_++ % numDataWorkers;
+  return numHandshakeWorkers_ + workerId_ + k * numHandshakeWorkers_;
+}
+
 void QuicServerWorker::setHostId(uint16_t hostId) noexcept {
   hostId_ = hostId;
+  connectionIdPool_.reset();
 }
 
 void QuicServerWorker::setNewConnectionSocketFactory(
@@ -590,6 +1305,8 @@ void QuicServerWorker::setTransportFactory(
 void QuicServerWorker::setSupportedVersions(
     const std::vector<QuicVersion>& supportedVersions) {
   supportedVersions_ = supportedVersions;
+  versionNegotiationTemplate_ =
+      VersionNegotiationPacketTemplate(supportedVersions_);
 }
 
 void QuicServerWorker::setFizzContext(
@@ -599,13 +1316,69 @@ void QuicServerWorker::setFizzContext(
 
 void QuicServerWorker::setTransportSettings(
     TransportSettings transportSettings) {
-  transportSettings_ = transportSettings;
+  transportSettings_ = std::move(transportSettings);
+  if (transportSettings_.maxRecvBatchSize > 1) {
+    // The first datagram of every batch is read by the socket through
+    // getReadBuffer().
+    batchReader_ = std::make_unique<RecvmmsgBatchReader>(
+        transportSettings_.maxRecvBatchSize - 1,
+        transportSettings_.maxRecvPacketSize);
+  } else {
+    batchReader_.reset();
+  }
+  if (transportSettings_.retryPendingHandshakesThreshold ||
+      transportSettings_.loadShedding || transportSettings_.issueNewTokens) {
+    CHECK(transportSettings_.retryTokenSecret.hasValue());
+    retryTokenGenerator_ = std::make_shared<const RetryTokenGenerator>(
+        *transportSettings_.retryTokenSecret);
+  } else {
+    retryTokenGenerator_.reset();
+  }
+  statelessResetGenerator_.reset();
+  connectionIdPool_.reset();
+  if (streamStatePool_) {
+    streamStatePool_->setCapacity(transportSettings_.workerStreamStatePoolSize);
+  }
+  if (transportSettings_.maxStatelessResetsPerSecond > 0) {
+    // Allows a burst of one second worth of resets.
+    statelessResetLimiter_.emplace(
+        transportSettings_.maxStatelessResetsPerSecond,
+        transportSettings_.maxStatelessResetsPerSecond);
+  } else {
+    statelessResetLimiter_.clear();
+  }
+  if (transportSettings_.maxVersionNegotiationsPerSecond > 0) {
+    versionNegotiationLimiter_.emplace(
+        transportSettings_.maxVersionNegotiationsPerSecond,
+        transportSettings_.maxVersionNegotiationsPerSecond);
+  } else {
+    versionNegotiationLimiter_.clear();
+  }
+  if (transportSettings_.maxNewConnectionsPerSourcePerSecond > 0) {
+    sourceRateLimiter_.emplace(
+        transportSettings_.maxNewConnectionsPerSourcePerSecond,
+        transportSettings_.sourceRateLimitIpv4PrefixLength,
+        transportSettings_.sourceRateLimitIpv6PrefixLength);
+  } else {
+    sourceRateLimiter_.clear();
+  }
 }
 
 void QuicServerWorker::rejectNewConnections(bool rejectNewConnections) {
   rejectNewConnections_ = rejectNewConnections;
 }
 
+void QuicServerWorker::onPendingRoutedPackets(uint64_t numPackets) noexcept {
+  if (loadMonitor_) {
+    loadMonitor_->onPendingPackets(numPackets);
+  }
+}
+
+WorkerLoadMonitor::LoadLevel QuicServerWorker::getLoadLevel() const noexcept {
+  return loadMonitor_ ? loadMonitor_->getLoadLevel()
+                      : WorkerLoadMonitor::LoadLevel::NORMAL;
+}
+
 void QuicServerWorker::enablePartialReliability(bool enabled) {
   transportSettings_.partialReliabilityEnabled = enabled;
 }
@@ -648,6 +1421,52 @@ void QuicServerWorker::onConnectionIdAvailable(
     LOG(ERROR) << "connectionIdMap_ already has CID=" << id;
   } else if (boundServerTransports_.insert(transportPtr).second) {
     QUIC_STATS(infoCallback_, onNewConnection);
+    updateNumConnections();
+  }
+}
+
+void QuicServerWorker::updateNumConnections() noexcept {
+  numConnections_.store(
+      sourceAddressMap_.size() + boundServerTransports_.size(),
+      std::memory_order_relaxed);
+}
+
+void QuicServerWorker::maybeShrinkSourceAddressMap() noexcept {
+  auto needed =
+      std::max(sourceAddressMap_.size(), kSourceAddressMapMinCapacity);
+  if (shutdown_ ||
+      sourceAddressMap_.bucket_count() <=
+          kSourceAddressMapShrinkFactor * needed) {
+    return;
+  }
+  // The tables don't shrink as entries are erased, so the entries are moved
+  // to a table of their size.
+  SrcToTransportMap shrunk;
+  shrunk.reserve(sourceAddressMap_.size());
+  for (auto& entry : sourceAddressMap_) {
+    shrunk.emplace(entry.first, std::move(entry.second));
+  }
+  sourceAddressMap_ = std::move(shrunk);
+}
+
+void QuicServerWorker::onConnectionIdsAvailable(
+    QuicServerTransport::Ptr transport,
+    std::vector<ConnectionId> ids) noexcept {
+  VLOG(4) << "Adding " << ids.size() << " CIDs into connectionIdMap_ "
+          << *transport;
+  connectionIdMap_.reserve(connectionIdMap_.size() + ids.size());
+  bool added = false;
+  for (auto& id : ids) {
+    auto result = connectionIdMap_.emplace(std::make_pair(id, transport));
+    if (!result.second) {
+      LOG(ERROR) << "connectionIdMap_ already has CID=" << id;
+    } else {
+      added = true;
+    }
+  }
+  if (added && boundServerTransports_.insert(transport.get()).second) {
+    QUIC_STATS(infoCallback_, onNewConnection);
+    updateNumConnections();
   }
 }
 
@@ -662,6 +1481,8 @@ void QuicServerWorker::onConnectionIdBound(
     LOG(ERROR) << "Transport not match, client=" << *transport;
   } else {
     sourceAddressMap_.erase(source);
+    updateNumConnections();
+    maybeShrinkSourceAddressMap();
     if (transport->shouldShedConnection()) {
       VLOG_EVERY_N(1, 100) << "Shedding connection";
       transport->closeNow(std::make_pair(
@@ -678,10 +1499,17 @@ void QuicServerWorker::onConnectionUnbound(
   VLOG(4) << "Removing from sourceAddressMap_ address=" << source.first;
   // Ensures we only process `onConnectionUnbound()` once.
   transport->setRoutingCallback(nullptr);
+  if (pathEstimateCache_ && transport->getState()) {
+    pathEstimateCache_->onConnectionDone(
+        source.first.getIPAddress(), *transport->getState());
+  }
   boundServerTransports_.erase(transport);
 
   // TODO: verify we are removing the right transport
-  sourceAddressMap_.erase(source);
+  if (sourceAddressMap_.erase(source)) {
+    maybeShrinkSourceAddressMap();
+  }
+  updateNumConnections();
 
   if (connectionIdData.size()) {
     QUIC_STATS(infoCallback_, onConnectionClose, folly::none);
@@ -694,14 +1522,102 @@ void QuicServerWorker::onConnectionUnbound(
   }
 }
 
-void QuicServerWorker::shutdownAllConnections(LocalErrorCode error) {
+bool QuicServerWorker::onConnectionDraining(
+    const std::vector<ConnectionIdData>& connectionIdData,
+    const folly::SocketAddress& peerAddress,
+    Buf closePacket,
+    std::chrono::milliseconds drainPeriod) noexcept {
+  if (shutdown_ || !evb_) {
+    return false;
+  }
+  std::vector<ConnectionId> connIds;
+  connIds.reserve(connectionIdData.size());
+  for (auto& connId : connectionIdData) {
+    connIds.push_back(connId.connId);
+  }
+  auto draining = std::make_shared<DrainingConnection>(
+      *this, connIds, peerAddress, std::move(closePacket));
+  for (auto& connId : connIds) {
+    VLOG(4) << "Adding into drainingConnectionIdMap_ for CID=" << connId
+            << ", workerId=" << (uint32_t)workerId_;
+    drainingConnectionIdMap_[connId] = draining;
+  }
+  evb_->timer().scheduleTimeout(draining.get(), drainPeriod);
+  return true;
+}
+
+bool QuicServerWorker::maybeHandleDrainingConnection(
+    const folly::SocketAddress& client,
+    const ConnectionId& connId) {
+  auto it = drainingConnectionIdMap_.find(connId);
+  if (it == drainingConnectionIdMap_.end()) {
+    return false;
+  }
+  VLOG(10) << "Packet from client=" << client
+           << " for draining connection CID=" << connId;
+  it->second->onPacket(*socket_);
+  return true;
+}
+
+void QuicServerWorker::removeDrainingConnection(
+    const std::vector<ConnectionId>& connIds) {
+  for (auto& connId : connIds) {
+    VLOG(4) << "Removing from drainingConnectionIdMap_ for CID=" << connId
+            << ", workerId=" << (uint32_t)workerId_;
+    drainingConnectionIdMap_.erase(connId);
+  }
+}
+
+QuicServerWorker::DrainingConnection::DrainingConnection(
+    QuicServerWorker& worker,
+    std::vector<ConnectionId> connIds,
+    folly::SocketAddress peerAddress,
+    Buf closePacket)
+    : worker_(worker),
+      connIds_(std::move(connIds)),
+      peerAddress_(std::move(peerAddress)),
+      closePacket_(std::move(closePacket)) {}
+
+void QuicServerWorker::DrainingConnection::onPacket(
+    folly::AsyncUDPSocket& sock) {
+  ++packetsReceived_;
+  if (!closePacket_ || (packetsReceived_ & (packetsReceived_ - 1)) != 0) {
+    return;
+  }
+  // best effort writing to the socket, ignore any errors.
+  sock.write(peerAddress_, closePacket_);
+}
+
+void QuicServerWorker::DrainingConnection::timeoutExpired() noexcept {
+  // Removing the connection ids from the map destroys this.
+  auto connIds = std::move(connIds_);
+  worker_.removeDrainingConnection(connIds);
+}
+
+void QuicServerWorker::shutdownAllConnections(
+    LocalErrorCode error,
+    folly::Function<void()> callback) {
   VLOG(4) << "QuicServer shutdown all connections."
           << " addressMap=" << sourceAddressMap_.size()
           << " connectionIdMap=" << connectionIdMap_.size();
   if (shutdown_) {
+    if (shutdownLoopCallback_.isLoopCallbackScheduled()) {
+      shutdownLoopCallback_.cancelLoopCallback();
+      for (auto& it : shutdownTransports_) {
+        closeTransportForShutdown(*it.first, it.second);
+      }
+      shutdownTransports_.clear();
+      finishShutdown();
+    }
+    if (callback) {
+      callback();
+    }
     return;
   }
   shutdown_ = true;
+  if (batchReadHandler_) {
+    batchReadHandler_->pause();
+  }
   if (socket_) {
     socket_->pauseRead();
   }
@@ -709,32 +1625,102 @@ void QuicServerWorker::shutdownAllConnections(LocalErrorCode error) {
     takeoverCB_->pause();
   }
   callback_ = nullptr;
+  shutdownError_ = error;
+  shutdownCallback_ = std::move(callback);
+
+  if (transportSettings_.shutdownTimeBudget.count() > 0 && evb_ &&
+      evb_->isRunning()) {
+    // None of the transports is routed to any more, they only wait for
+    // their turn to be closed.
+    shutdownTransports_.reserve(
+        sourceAddressMap_.size() + boundServerTransports_.size());
+    for (auto& it : sourceAddressMap_) {
+      it.second->setRoutingCallback(nullptr);
+      shutdownTransports_.emplace_back(it.second, false);
+    }
+    for (auto transport : boundServerTransports_) {
+      transport->setRoutingCallback(nullptr);
+      shutdownTransports_.emplace_back(transport->shared_from_this(), true);
+    }
+    sourceAddressMap_.clear();
+    connectionIdMap_.clear();
+    boundServerTransports_.clear();
+    continueShutdown();
+    return;
+  }
 
   // Shut down all transports without bound connection ids.
   for (auto& it : sourceAddressMap_) {
     auto transport = it.second;
     transport->setRoutingCallback(nullptr);
-    transport->setTransportInfoCallback(nullptr);
-    transport->closeNow(
-        std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    closeTransportForShutdown(*transport, false);
   }
 
   // Shut down all transports with bound connection ids.
   for (auto transport : boundServerTransports_) {
     transport->setRoutingCallback(nullptr);
-    transport->setTransportInfoCallback(nullptr);
-    transport->closeNow(
-        std::make_pair(QuicErrorCode(error), std::string("shutting down")));
+    closeTransportForShutdown(*transport, true);
+  }
+  finishShutdown();
+}
+
+void QuicServerWorker::closeTransportForShutdown(
+    QuicServerTransport& transport,
+    bool bound) {
+  transport.setTransportInfoCallback(nullptr);
+  transport.closeNow(std::make_pair(
+      QuicErrorCode(shutdownError_), std::string("shutting down")));
+  if (bound) {
     QUIC_STATS(infoCallback_, onConnectionClose, folly::none);
   }
+}
+
+void QuicServerWorker::continueShutdown() noexcept {
+  // Outside of the loop iteration that sent their close packets.
+  closedTransports_.clear();
+  if (shutdownTransports_.empty()) {
+    finishShutdown();
+    return;
+  }
+  auto deadline = Clock::now() + transportSettings_.shutdownTimeBudget;
+  do {
+    auto transport = std::move(shutdownTransports_.back());
+    shutdownTransports_.pop_back();
+    closeTransportForShutdown(*transport.first, transport.second);
+    closedTransports_.push_back(std::move(transport.first));
+  } while (!shutdownTransports_.empty() && Clock::now() < deadline);
+  evb_->runInLoop(&shutdownLoopCallback_);
+}
+
+void QuicServerWorker::finishShutdown() {
+  closedTransports_.clear();
   sourceAddressMap_.clear();
   connectionIdMap_.clear();
+  boundServerTransports_.clear();
+  drainingConnectionIdMap_.clear();
+  numConnections_.store(0, std::memory_order_relaxed);
   takeoverPktHandler_.stop();
   if (infoCallback_) {
     infoCallback_.reset();
   }
+  batchReadHandler_.reset();
+  if (socket_ && writeCoalescer_) {
+    // Write out the close packets of the transports.
+    writeCoalescer_->flush();
+    QuicWriteCoalescer::unregisterSocket(socket_->getNetworkSocket());
+    writeCoalescer_.reset();
+  }
+  if (socket_ && zeroCopyTracker_) {
+    socket_->setErrMessageCallback(nullptr);
+    ZeroCopyTracker::unregisterSocket(socket_->getNetworkSocket());
+  }
+  loadMonitor_.reset();
   socket_.reset();
   takeoverCB_.reset();
+  if (shutdownCallback_) {
+    auto callback = std::move(shutdownCallback_);
+    callback();
+  }
 }
 
 QuicServerWorker::~QuicServerWorker() {
@@ -7,22 +7,58 @@
  */
 
 #pragma once
-#include <unordered_map>
-
+#include <folly/Function.h>
+#include <folly/TokenBucket.h>
+#include <folly/container/F14Map.h>
 #include <folly/io/async/AsyncUDPSocket.h>
+#include <folly/io/async/HHWheelTimer.h>
 
+#include <quic/api/QuicBatchReader.h>
+#include <quic/api/QuicBatchWriter.h>
+#include <quic/api/QuicWriteCoalescer.h>
 #include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicPacketBuilder.h>
+#include <quic/common/BufferPool.h>
+#include <quic/common/PacingScheduler.h>
 #include <quic/common/Timers.h>
+#include <quic/common/WriteScheduler.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/logging/QLogSampler.h>
+#include <quic/server/ConnectionIntrospection.h>
 #include <quic/server/QuicServerPacketRouter.h>
 #include <quic/server/QuicServerTransportFactory.h>
 #include <quic/server/QuicUDPSocketFactory.h>
+#include <quic/server/SourceAddressRateLimiter.h>
+#include <quic/server/WorkerLoadMonitor.h>
+#include <quic/server/handshake/CertificateMessageCache.h>
+#include <quic/server/handshake/InitialCipherCache.h>
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/ConnectionIdPool.h>
+#include <quic/server/state/PathEstimateCache.h>
+#include <quic/state/BufferMemoryBudget.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 
 namespace quic {
 
+/**
+ * A stream that broadcast data is written to, see QuicServer::broadcast().
+ * The connection is identified by one of its server connection ids, which
+ * routes the target to the worker of the connection from any thread.
+ */
+struct BroadcastTarget {
+  ConnectionId serverConnectionId;
+  StreamId streamId;
+
+  BroadcastTarget(ConnectionId serverConnectionIdIn, StreamId streamIdIn)
+      : serverConnectionId(std::move(serverConnectionIdIn)),
+        streamId(streamIdIn) {}
+};
+
 class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
-                         public QuicServerTransport::RoutingCallback {
+                         public folly::AsyncUDPSocket::ErrMessageCallback,
+                         public QuicServerTransport::RoutingCallback,
+                         public BatchReadHandler::Callback {
  public:
   using TransportSettingsOverrideFn =
       std::function<folly::Optional<quic::TransportSettings>(
@@ -39,6 +75,12 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
         const folly::SocketAddress& client,
         RoutingData&& routingData,
         NetworkData&& networkData) = 0;
+
+    // Hands a connection that finished its handshake over to the data worker
+    // its connection ids route to, see QuicServer::setNumHandshakeWorkers().
+    virtual void handOffConnection(
+        uint8_t workerId,
+        ServerConnectionSnapshot snapshot) = 0;
   };
 
   explicit QuicServerWorker(std::shared_ptr<WorkerCallback> callback);
@@ -66,6 +108,19 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void bind(const folly::SocketAddress& address);
 
+  /**
+   * Attaches the reuseport steering program to the SO_REUSEPORT group of the
+   * bound socket, see attachReusePortSteeringProgram().
+   */
+  bool attachReusePortSteering();
+
+  /**
+   * Pins the calling thread, which must be the worker's, to the cpu, and sets
+   * SO_INCOMING_CPU to it on the socket. Returns false if either failed or
+   * isn't supported on the platform.
+   */
+  bool setCpuAffinity(int cpu);
+
   /**
    * start reading data from the socket
    */
@@ -97,15 +152,54 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   /**
    * Setup address that the taken over quic server is listening to forward
-   * misrouted packets belonging to the old server.
+   * misrouted packets belonging to the old server, with the given version of
+   * the takeover protocol.
    */
-  void startPacketForwarding(const folly::SocketAddress& destAddr);
+  void startPacketForwarding(
+      const folly::SocketAddress& destAddr,
+      TakeoverProtocolVersion version = TakeoverProtocolVersion::V0);
 
   /**
    * Stop forwarding of packets and clean up any allocated resources
    */
   void stopPacketForwarding();
 
+  /**
+   * Exports the connections that can be handed over to the process taking
+   * over this server, and closes them without telling the peers, see
+   * QuicServerTransport::exportSnapshot(). The other connections are left
+   * alone, their packets are forwarded to this server as usual.
+   */
+  std::vector<ServerConnectionSnapshot> exportConnections();
+
+  /**
+   * Summarizes the connections of the worker a batch at a time, see
+   * introspectConnections(). Must be called on the worker's thread.
+   */
+  void introspectConnections(
+      ConnectionIntrospectionOptions options,
+      folly::Function<void(WorkerIntrospection)> callback);
+
+  /**
+   * Writes the same data, and eof, to the target streams of the worker's
+   * connections. Each target only costs a clone of data and the write to its
+   * stream. The packets of all the connections are written at the end of the
+   * loop, together if the worker coalesces its writes, see
+   * TransportSettings::maxCoalescedWriteBatchSize. The targets whose
+   * connection is gone or whose write fails are skipped. Returns the number
+   * of streams written. Must be called on the worker's thread.
+   */
+  size_t broadcast(
+      const folly::IOBuf& data,
+      const std::vector<BroadcastTarget>& targets,
+      bool eof);
+
+  /**
+   * Creates a transport that carries on with a connection exported by the
+   * server this one took over. Must be called on the worker's thread.
+   */
+  void adoptConnection(const ServerConnectionSnapshot& snapshot);
+
   /*
    * Returns the File Descriptor of the listening socket that handles the
    * packets routed from another quic server.
@@ -138,6 +232,27 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   uint8_t getWorkerId() const noexcept;
 
+  /**
+   * Dedicates the workers below numHandshakeWorkers, out of numWorkers, to
+   * the handshakes, see QuicServer::setNumHandshakeWorkers(). A handshake
+   * worker gives its connections the ids of the data workers it hands them
+   * over to, and a data worker routes the short header packets it has no
+   * connection for back to their handshake worker.
+   */
+  void setHandshakeWorkers(
+      size_t numHandshakeWorkers,
+      size_t numWorkers) noexcept;
+
+  bool isHandshakeWorker() const noexcept;
+
+  /**
+   * The handshake worker that hands its connections over to the data worker,
+   * out of numHandshakeWorkers.
+   */
+  static size_t getHandshakeWorkerFor(
+      size_t dataWorkerId,
+      size_t numHandshakeWorkers);
+
   /**
    * Set the id for the host where this server is running.
    * It is used to make routing decision by setting this id in the ConnectionId
@@ -160,6 +275,25 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
    */
   void rejectNewConnections(bool rejectNewConnections);
 
+  /**
+   * Number of packets routed to this worker by the others that are waiting
+   * to be dispatched, see TransportSettings::loadShedding.
+   */
+  void onPendingRoutedPackets(uint64_t numPackets) noexcept;
+
+  /**
+   * The level of load shedding, always NORMAL without loadShedding.
+   */
+  WorkerLoadMonitor::LoadLevel getLoadLevel() const noexcept;
+
+  /**
+   * The connections of the worker, the handshakes included. Can be called
+   * from any thread.
+   */
+  uint64_t getNumConnections() const noexcept {
+    return numConnections_.load(std::memory_order_relaxed);
+  }
+
   /**
    * Enable/disable partial reliability on connection settings.
    */
@@ -199,6 +333,34 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   void setCongestionControllerFactory(
       std::shared_ptr<CongestionControllerFactory> factory);
 
+  /**
+   * Set the sampler that decides which of the connections of this worker are
+   * qlogged. This must be set before the server starts.
+   */
+  void setQLogSampler(std::shared_ptr<const QLogSampler> qLogSampler);
+
+  /**
+   * Set the executor that the connections of this worker process the
+   * ClientHello on, instead of the worker's event base. This must be set
+   * before the server starts.
+   */
+  void setCryptoExecutor(std::shared_ptr<folly::Executor> cryptoExecutor);
+
+  /**
+   * Set the factory that makes the packet protection of the connections of
+   * this worker, see QuicServer::setCryptoFactory().
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
+  /**
+   * Set the cache of the path estimates of the client subnets, which seeds
+   * the initial cwnd and pacing rate of the new connections and is updated
+   * when they go away. Can be shared by the workers. This must be set before
+   * the server starts.
+   */
+  void setPathEstimateCache(
+      std::shared_ptr<PathEstimateCache> pathEstimateCache);
+
   // Read callback
   void getReadBuffer(void** buf, size_t* len) noexcept override;
 
@@ -216,6 +378,13 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       QuicServerTransport::Ptr transport,
       ConnectionId id) noexcept override;
 
+  /**
+   * Adds all the ids of a transport to the connection id map at once.
+   */
+  void onConnectionIdsAvailable(
+      QuicServerTransport::Ptr transport,
+      std::vector<ConnectionId> ids) noexcept override;
+
   /**
    * Called when a connecton id is bound and ip address should not
    * be used any more for routing.
@@ -232,26 +401,57 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       const QuicServerTransport::SourceIdentity& source,
       const std::vector<ConnectionIdData>& connectionIdData) noexcept override;
 
+  /**
+   * Keeps a draining entry for the connection ids until drainPeriod is over,
+   * see TransportSettings::compactDrainingConnections.
+   */
+  bool onConnectionDraining(
+      const std::vector<ConnectionIdData>& connectionIdData,
+      const folly::SocketAddress& peerAddress,
+      Buf closePacket,
+      std::chrono::milliseconds drainPeriod) noexcept override;
+
   void onReadError(const folly::AsyncSocketException& ex) noexcept override;
 
   void onReadClosed() noexcept override;
 
+  // folly::AsyncUDPSocket::ErrMessageCallback, only installed to receive
+  // zero copy completions
+  void errMessage(const cmsghdr& cmsg) noexcept override;
+
+  void errMessageError(const folly::AsyncSocketException& ex) noexcept override;
+
+  // BatchReadHandler::Callback, used when GRO is enabled
+  void onBatchRead(
+      std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+      TimePoint receiveTime) noexcept override;
+
+  void onBatchReadError(int err) noexcept override;
+
   void dispatchPacketData(
       const folly::SocketAddress& client,
       RoutingData&& routingData,
       NetworkData&& networkData) noexcept;
 
-  using ConnIdToTransportMap = std::
-      unordered_map<ConnectionId, QuicServerTransport::Ptr, ConnectionIdHash>;
+  /**
+   * Until finishPacketBatch(), the short header packets that
+   * dispatchPacketData() routes to the same connection one after the other
+   * are held and handed to it together through onNetworkDataBatch(). Does
+   * nothing unless TransportSettings::batchReceivedPackets is set.
+   */
+  void startPacketBatch();
+  void finishPacketBatch();
+
+  using ConnIdToTransportMap = folly::
+      F14FastMap<ConnectionId, QuicServerTransport::Ptr, ConnectionIdHash>;
 
   struct SourceIdentityHash {
     size_t operator()(const QuicServerTransport::SourceIdentity& sid) const {
       return folly::hash::hash_combine(
-          folly::hash::fnv32_buf(sid.second.data(), sid.second.size()),
-          sid.first.hash());
+          ConnectionIdHash()(sid.second), sid.first.hash());
     }
   };
-  using SrcToTransportMap = std::unordered_map<
+  using SrcToTransportMap = folly::F14FastMap<
       QuicServerTransport::SourceIdentity,
       QuicServerTransport::Ptr,
       SourceIdentityHash>;
@@ -260,7 +460,16 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   const SrcToTransportMap& getSrcToTransportMap() const;
 
-  void shutdownAllConnections(LocalErrorCode error);
+  /**
+   * Closes all the connections and stops the worker. With
+   * TransportSettings::shutdownTimeBudget and a running EventBase, the
+   * connections are closed over several loop iterations, and the callback
+   * is invoked once they all are. Calling it again while the connections
+   * are being closed closes the rest right away.
+   */
+  void shutdownAllConnections(
+      LocalErrorCode error,
+      folly::Function<void()> callback = nullptr);
 
   // for unit test
   folly::AsyncUDPSocket::ReadCallback* getTakeoverHandlerCallback() {
@@ -272,12 +481,13 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       const folly::SocketAddress& client,
       Buf data,
       const TimePoint& receiveTime,
-      bool isForwardedData = false) noexcept;
+      bool isForwardedData = false,
+      ECNCodepoint ecn = ECNCodepoint::NotECT) noexcept;
 
   /**
-   * Try handling the data as a health check.
+   * Answers the data if it is a health check. Returns false if it isn't.
    */
-  void tryHandlingAsHealthCheck(
+  bool maybeHandleHealthCheck(
       const folly::SocketAddress& client,
       const folly::IOBuf& data);
 
@@ -318,17 +528,132 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
       folly::EventBase* evb,
       int fd) const;
 
+  /**
+   * Creates a transport for a connection from the client, set up with the
+   * worker's settings and callbacks.
+   */
+  QuicServerTransport::Ptr makeTransport(const folly::SocketAddress& client);
+
   void sendResetPacket(
       const HeaderForm& headerForm,
       const folly::SocketAddress& client,
       const NetworkData& networkData,
       const ConnectionId& connId);
 
+  void updateNumConnections() noexcept;
+
+  // Gives back the memory of sourceAddressMap_ left by a burst of handshakes.
+  void maybeShrinkSourceAddressMap() noexcept;
+
   bool maybeSendVersionNegotiationPacketOrDrop(
       const folly::SocketAddress& client,
       bool isInitial,
       LongHeaderInvariant& invariant);
 
+  /**
+   * Validates the client address of an Initial that would create a new
+   * connection, see TransportSettings::retryPendingHandshakesThreshold.
+   * Returns true if the packet was answered with a Retry or dropped. Otherwise
+   * the connection can be created, and originalConnId is set if the client
+   * came back with a valid token. newTokenValidated is set instead if the
+   * token is the one of a NEW_TOKEN frame, see
+   * TransportSettings::issueNewTokens.
+   */
+  bool maybeSendRetryPacketOrDrop(
+      const folly::SocketAddress& client,
+      const RoutingData& routingData,
+      const NetworkData& networkData,
+      folly::Optional<ConnectionId>& originalConnId,
+      bool& newTokenValidated);
+
+  /**
+   * Refuses the connection an Initial would create with a stateless
+   * CONNECTION_CLOSE carrying SERVER_BUSY, in an Initial packet protected
+   * with the keys derived from the client's destination connection id.
+   */
+  void sendConnectionRefused(
+      const folly::SocketAddress& client,
+      const RoutingData& routingData,
+      const NetworkData& networkData);
+
+  /**
+   * Dispatches a batch of packets read from the socket through
+   * handleNetworkData.
+   */
+  void handleBatch(
+      std::vector<RecvmmsgBatchReader::ReceivedPacket>& packets,
+      const TimePoint& packetReceiveTime) noexcept;
+
+  // Hands the packets held since startPacketBatch() to their connection.
+  void flushPacketBatch();
+
+  // The data worker of a new connection of this handshake worker, round
+  // robin among the ones it hands its connections over to.
+  uint8_t pickDataWorker();
+
+  // Hands the connection over to its data worker if this is a handshake
+  // worker and the connection can be exported.
+  void maybeHandOffConnection(const QuicServerTransport::Ptr& transport);
+
+  /**
+   * What is left of a connection handed over by onConnectionDraining(). The
+   * packets of the connection are answered with its close packet, at most
+   * the ones whose count is a power of two, until the drain period is over.
+   */
+  class DrainingConnection : public folly::HHWheelTimer::Callback {
+   public:
+    DrainingConnection(
+        QuicServerWorker& worker,
+        std::vector<ConnectionId> connIds,
+        folly::SocketAddress peerAddress,
+        Buf closePacket);
+
+    void onPacket(folly::AsyncUDPSocket& sock);
+
+    void timeoutExpired() noexcept override;
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    QuicServerWorker& worker_;
+    std::vector<ConnectionId> connIds_;
+    folly::SocketAddress peerAddress_;
+    Buf closePacket_;
+    uint64_t packetsReceived_{0};
+  };
+
+  /**
+   * Answers the packet if the connection id is the one of a draining
+   * connection. Returns false if it isn't.
+   */
+  bool maybeHandleDrainingConnection(
+      const folly::SocketAddress& client,
+      const ConnectionId& connId);
+
+  void removeDrainingConnection(const std::vector<ConnectionId>& connIds);
+
+  class ShutdownLoopCallback : public folly::EventBase::LoopCallback {
+   public:
+    explicit ShutdownLoopCallback(QuicServerWorker& worker) : worker_(worker) {}
+
+    void runLoopCallback() noexcept override {
+      worker_.continueShutdown();
+    }
+
+   private:
+    QuicServerWorker& worker_;
+  };
+
+  void closeTransportForShutdown(QuicServerTransport& transport, bool bound);
+
+  /**
+   * Destroys the transports closed by the previous iteration, and closes the
+   * next ones until shutdownTimeBudget is spent.
+   */
+  void continueShutdown() noexcept;
+
+  void finishShutdown();
+
   std::unique_ptr<folly::AsyncUDPSocket> socket_;
   std::shared_ptr<WorkerCallback> callback_;
   folly::EventBase* evb_{nullptr};
@@ -337,6 +662,10 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   QuicUDPSocketFactory* socketFactory_;
   QuicServerTransportFactory* transportFactory_;
   std::shared_ptr<CongestionControllerFactory> ccFactory_{nullptr};
+  std::shared_ptr<const QLogSampler> qLogSampler_{nullptr};
+  std::shared_ptr<folly::Executor> cryptoExecutor_{nullptr};
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
+  std::shared_ptr<PathEstimateCache> pathEstimateCache_{nullptr};
 
   // A server transport's membership is exclusive to only one of these maps.
   ConnIdToTransportMap connectionIdMap_;
@@ -344,15 +673,88 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
 
   // Contains every unique transport that is mapped in connectionIdMap_.
   std::unordered_set<QuicServerTransport*> boundServerTransports_;
+  // The connections that are draining without their transport.
+  folly::F14FastMap<
+      ConnectionId,
+      std::shared_ptr<DrainingConnection>,
+      ConnectionIdHash>
+      drainingConnectionIdMap_;
 
   Buf readBuffer_;
+  // Only set when recvBufferPoolSize is non zero.
+  std::unique_ptr<BufferPool> recvBufferPool_;
+  // Only set when workerBufferMemoryBudget is non zero.
+  BufferMemoryBudget::SharedPtr bufferMemoryBudget_;
+  // When the buffers of the connections were last reclaimed under pressure.
+  TimePoint lastBufferMemoryReclaim_;
+  // Only set when batched reads are enabled through maxRecvBatchSize.
+  std::unique_ptr<RecvmmsgBatchReader> batchReader_;
+  // Owns all the reads from socket_ when GRO is enabled.
+  std::unique_ptr<BatchReadHandler> batchReadHandler_;
+  // Tracks MSG_ZEROCOPY sends of the transports sharing socket_.
+  std::shared_ptr<ZeroCopyTracker> zeroCopyTracker_;
+  // Only set when maxCoalescedWriteBatchSize is non zero.
+  std::shared_ptr<QuicWriteCoalescer> writeCoalescer_;
   bool shutdown_{false};
+  // The transports left to close by a shutdown with a shutdownTimeBudget,
+  // with whether their connection ids are bound, and the ones closed in the
+  // current loop iteration.
+  std::vector<std::pair<QuicServerTransport::Ptr, bool>> shutdownTransports_;
+  std::vector<QuicServerTransport::Ptr> closedTransports_;
+  LocalErrorCode shutdownError_{LocalErrorCode::SHUTTING_DOWN};
+  folly::Function<void()> shutdownCallback_;
+  ShutdownLoopCallback shutdownLoopCallback_{*this};
+  // The packets held for a single connection between startPacketBatch() and
+  // finishPacketBatch().
+  bool batchingPackets_{false};
+  QuicServerTransport::Ptr packetBatchTransport_;
+  folly::SocketAddress packetBatchPeer_;
+  std::vector<NetworkData> packetBatch_;
   std::vector<QuicVersion> supportedVersions_;
+  // The version negotiation packets for supportedVersions_, and the one sent
+  // while new connections are rejected.
+  VersionNegotiationPacketTemplate versionNegotiationTemplate_{
+      supportedVersions_};
+  const VersionNegotiationPacketTemplate rejectVersionNegotiationTemplate_{
+      std::vector<QuicVersion>{QuicVersion::MVFST_INVALID}};
   std::shared_ptr<const fizz::server::FizzServerContext> ctx_;
   TransportSettings transportSettings_;
+  // Only set when retryPendingHandshakesThreshold, loadShedding or
+  // issueNewTokens is. The transports generate their NEW_TOKEN tokens with it.
+  std::shared_ptr<const RetryTokenGenerator> retryTokenGenerator_;
+  // Only set when loadShedding is.
+  std::unique_ptr<WorkerLoadMonitor> loadMonitor_;
+  // Only set when initialCipherCacheSize is non zero.
+  std::shared_ptr<InitialCipherCache> initialCipherCache_;
+  // Only set when certificateMessageCacheSize is non zero.
+  std::shared_ptr<CertificateMessageCache> certificateMessageCache_;
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache_{
+      std::make_shared<ServerTransportParametersCache>()};
+  // Made with the first stateless reset after the settings are set.
+  std::unique_ptr<StatelessResetGenerator> statelessResetGenerator_;
+  // Made with the first transport when connectionIdPoolSize is non zero, and
+  // dropped when the parameters of the connection ids change.
+  ConnectionIdPool::SharedPtr connectionIdPool_;
+  // Made with the first transport when workerStreamStatePoolSize is non
+  // zero.
+  std::shared_ptr<StreamStatePool> streamStatePool_;
+  // Only set when maxStatelessResetsPerSecond is non zero.
+  folly::Optional<folly::TokenBucket> statelessResetLimiter_;
+  // Only set when maxVersionNegotiationsPerSecond is non zero.
+  folly::Optional<folly::TokenBucket> versionNegotiationLimiter_;
+  // Only set when maxNewConnectionsPerSourcePerSecond is non zero.
+  folly::Optional<SourceAddressRateLimiter> sourceRateLimiter_;
   folly::Optional<Buf> healthCheckToken_;
+  // Made once, every health check is answered with it.
+  const Buf healthCheckResponse_{folly::IOBuf::copyBuffer("OK")};
   bool rejectNewConnections_{false};
   uint8_t workerId_{0};
+  // Non zero when the server has handshake workers.
+  size_t numHandshakeWorkers_{0};
+  size_t numWorkers_{0};
+  size_t nextDataWorker_{0};
+  // Published for the other workers, see getNumConnections().
+  std::atomic<uint64_t> numConnections_{0};
   std::unique_ptr<ConnectionIdAlgo> connIdAlgo_;
   uint16_t hostId_{0};
   // QuicServerWorker maintains ownership of the info stats callback
@@ -365,6 +767,9 @@ class QuicServerWorker : public folly::AsyncUDPSocket::ReadCallback,
   bool packetForwardingEnabled_{false};
   using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
   TimerHighRes::SharedPtr pacingTimer_;
+  PacingScheduler::SharedPtr pacingScheduler_;
+  // Only set when writeSchedulerEnabled is.
+  WriteScheduler::SharedPtr writeScheduler_;
 
   // Used to override certain transport parameters, given the client address
   TransportSettingsOverrideFn transportSettingsOverrideFn_;
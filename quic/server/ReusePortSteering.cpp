@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/ReusePortSteering.h>
+
+#include <folly/String.h>
+#include <folly/net/NetOps.h>
+#include <glog/logging.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#if defined(__linux__)
+#include <linux/bpf.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifndef SO_ATTACH_REUSEPORT_EBPF
+#define SO_ATTACH_REUSEPORT_EBPF 52
+#endif
+#endif
+
+namespace quic {
+
+#if defined(__linux__) && defined(__NR_bpf)
+namespace {
+// The program sees the datagram from its UDP payload on. The short header is
+// one byte of flags followed by the destination connection id, whose layout
+// is the one of DefaultConnectionIdAlgo:
+//   bits 0 - 1: version, kShortVersionId
+//   bits 18 - 25: worker id
+constexpr int32_t kConnIdOffset = 1;
+constexpr int32_t kLongHeaderBit = 0x80;
+
+bpf_insn makeInsn(
+    uint8_t code,
+    uint8_t dst,
+    uint8_t src,
+    int16_t off,
+    int32_t imm) {
+  bpf_insn insn;
+  memset(&insn, 0, sizeof(insn));
+  insn.code = code;
+  insn.dst_reg = dst;
+  insn.src_reg = src;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+// Loads the byte at offset of the packet into r0. Needs the context in r6.
+bpf_insn loadPacketByte(int32_t offset) {
+  return makeInsn(BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, offset);
+}
+
+std::vector<bpf_insn> makeSteeringProgram() {
+  // Older verifiers reject backward jumps, so every failed check jumps
+  // forward to the fallback at the end of the program, which returns an
+  // index past the group to let the kernel pick a socket by hash.
+  std::vector<bpf_insn> prog;
+  std::vector<size_t> fallbackJumps;
+  auto jumpToFallback = [&](uint8_t code, int32_t imm) {
+    fallbackJumps.push_back(prog.size());
+    prog.push_back(makeInsn(BPF_JMP | code | BPF_K, BPF_REG_0, 0, 0, imm));
+  };
+
+  // r6 = skb, as the packet loads expect.
+  prog.push_back(
+      makeInsn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0));
+  // A packet load past the end would abort the program and return 0, which
+  // would steer short packets to the first worker instead of hashing them.
+  prog.push_back(makeInsn(
+      BPF_LDX | BPF_MEM | BPF_W,
+      BPF_REG_0,
+      BPF_REG_6,
+      offsetof(struct __sk_buff, len),
+      0));
+  prog.push_back(makeInsn(
+      BPF_JMP | BPF_JGT | BPF_K,
+      BPF_REG_0,
+      0,
+      1,
+      kConnIdOffset + kMinConnectionIdSize - 1));
+  fallbackJumps.push_back(prog.size());
+  prog.push_back(makeInsn(BPF_JMP | BPF_JA, 0, 0, 0, 0));
+
+  prog.push_back(loadPacketByte(0));
+  jumpToFallback(BPF_JSET, kLongHeaderBit);
+
+  prog.push_back(loadPacketByte(kConnIdOffset));
+  prog.push_back(makeInsn(BPF_ALU64 | BPF_RSH | BPF_K, BPF_REG_0, 0, 0, 6));
+  jumpToFallback(BPF_JNE, kShortVersionId);
+
+  // Worker id bits 0 - 5 are the low 6 bits of byte 2 of the connection id.
+  prog.push_back(loadPacketByte(kConnIdOffset + 2));
+  prog.push_back(makeInsn(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_0, 0, 0, 0x3f));
+  prog.push_back(makeInsn(BPF_ALU64 | BPF_LSH | BPF_K, BPF_REG_0, 0, 0, 2));
+  // Packet loads clobber r0 - r5.
+  prog.push_back(
+      makeInsn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_7, BPF_REG_0, 0, 0));
+  // Worker id bits 6 - 7 are the high 2 bits of byte 3.
+  prog.push_back(loadPacketByte(kConnIdOffset + 3));
+  prog.push_back(makeInsn(BPF_ALU64 | BPF_RSH | BPF_K, BPF_REG_0, 0, 0, 6));
+  prog.push_back(
+      makeInsn(BPF_ALU64 | BPF_OR | BPF_X, BPF_REG_0, BPF_REG_7, 0, 0));
+  prog.push_back(makeInsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+  size_t fallback = prog.size();
+  prog.push_back(makeInsn(BPF_ALU | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, -1));
+  prog.push_back(makeInsn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+  for (auto jump : fallbackJumps) {
+    prog[jump].off = static_cast<int16_t>(fallback - jump - 1);
+  }
+  return prog;
+}
+
+int loadSteeringProgram() {
+  auto prog = makeSteeringProgram();
+  static const char kLicense[] = "GPL";
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+  attr.insns = reinterpret_cast<uint64_t>(prog.data());
+  attr.insn_cnt = prog.size();
+  attr.license = reinterpret_cast<uint64_t>(kLicense);
+  return syscall(__NR_bpf, BPF_PROG_LOAD, &attr, sizeof(attr));
+}
+} // namespace
+
+bool attachReusePortSteeringProgram(folly::NetworkSocket sock) {
+  int progFd = loadSteeringProgram();
+  if (progFd < 0) {
+    LOG(ERROR) << "Failed to load the reuseport steering program: "
+               << folly::errnoStr(errno);
+    return false;
+  }
+  int ret = folly::netops::setsockopt(
+      sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &progFd, sizeof(progFd));
+  int attachErrno = errno;
+  // The group holds its own reference to the program.
+  ::close(progFd);
+  if (ret != 0) {
+    LOG(ERROR) << "Failed to attach the reuseport steering program: "
+               << folly::errnoStr(attachErrno);
+    return false;
+  }
+  return true;
+}
+#else
+bool attachReusePortSteeringProgram(folly::NetworkSocket /* sock */) {
+  return false;
+}
+#endif
+} // namespace quic
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/net/NetworkSocket.h>
+
+namespace quic {
+
+/**
+ * Attaches a SO_ATTACH_REUSEPORT_EBPF program to the SO_REUSEPORT group of the
+ * given bound socket. The program decodes the worker id that
+ * DefaultConnectionIdAlgo puts in the server chosen connection id of short
+ * header packets, and delivers the packet to the socket at that index of the
+ * group, so that it lands on the worker that owns the connection. The sockets
+ * of the group must have been bound in the order of the worker ids.
+ *
+ * Long header packets, and short header ones whose connection id isn't in the
+ * DefaultConnectionIdAlgo format or names a worker past the size of the group,
+ * are left to the hash based selection of the kernel.
+ *
+ * Returns false, with the group untouched, if the program could not be loaded
+ * or attached, e.g. on kernels without eBPF support.
+ */
+bool attachReusePortSteeringProgram(folly::NetworkSocket sock);
+} // namespace quic
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/SourceAddressRateLimiter.h>
+
+#include <folly/Random.h>
+#include <folly/hash/SpookyHashV2.h>
+
+#include <algorithm>
+
+namespace quic {
+
+SourceAddressRateLimiter::SourceAddressRateLimiter(
+    uint32_t connectionsPerSecond,
+    uint8_t ipv4PrefixLength,
+    uint8_t ipv6PrefixLength,
+    size_t numBuckets)
+    : connectionsPerSecond_(connectionsPerSecond),
+      ipv4PrefixLength_(std::min<uint8_t>(ipv4PrefixLength, 32)),
+      ipv6PrefixLength_(std::min<uint8_t>(ipv6PrefixLength, 128)),
+      seed_(folly::Random::secureRand64()),
+      buckets_(std::max<size_t>(numBuckets, 1)) {}
+
+size_t SourceAddressRateLimiter::getBucketIndex(
+    const folly::SocketAddress& client) const {
+  auto ip = client.getIPAddress();
+  if (ip.isIPv4Mapped()) {
+    ip = ip.createIPv4();
+  }
+  auto prefix = ip.mask(ip.isV4() ? ipv4PrefixLength_ : ipv6PrefixLength_);
+  return folly::hash::SpookyHashV2::Hash64(
+             prefix.bytes(), prefix.byteCount(), seed_) %
+      buckets_.size();
+}
+
+bool SourceAddressRateLimiter::tryAcquire(
+    const folly::SocketAddress& client,
+    TimePoint now) {
+  auto& bucket = buckets_[getBucketIndex(client)];
+  // A bucket holds one second worth of connections, it starts full.
+  if (!bucket.lastRefillTime) {
+    bucket.tokens = connectionsPerSecond_;
+    bucket.lastRefillTime = now;
+  } else if (now > *bucket.lastRefillTime) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - *bucket.lastRefillTime);
+    bucket.tokens = std::min(
+        connectionsPerSecond_,
+        bucket.tokens +
+            connectionsPerSecond_ * elapsed.count() / std::micro::den);
+    bucket.lastRefillTime = now;
+  }
+  if (bucket.tokens < 1) {
+    return false;
+  }
+  bucket.tokens -= 1;
+  return true;
+}
+} // namespace quic
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Token buckets of the new connections of a QuicServerWorker, one for every
+ * prefix of the client addresses, so that a single source can't take the
+ * handshake CPU of the worker for itself. The prefixes are hashed with a
+ * random key into a fixed number of buckets: a prefix may share its bucket
+ * with a few others, but there is nothing to allocate per client and no
+ * client addresses that are known to collide. A worker has its own limiter,
+ * which needs no lock.
+ */
+class SourceAddressRateLimiter {
+ public:
+  SourceAddressRateLimiter(
+      uint32_t connectionsPerSecond,
+      uint8_t ipv4PrefixLength,
+      uint8_t ipv6PrefixLength,
+      size_t numBuckets = kSourceRateLimiterNumBuckets);
+
+  /**
+   * Whether a new connection from the client is allowed at the given time,
+   * in which case it takes a token of its bucket.
+   */
+  bool tryAcquire(const folly::SocketAddress& client, TimePoint now);
+
+ private:
+  struct Bucket {
+    double tokens{0};
+    folly::Optional<TimePoint> lastRefillTime;
+  };
+
+  size_t getBucketIndex(const folly::SocketAddress& client) const;
+
+  double connectionsPerSecond_;
+  uint8_t ipv4PrefixLength_;
+  uint8_t ipv6PrefixLength_;
+  uint64_t seed_;
+  std::vector<Bucket> buckets_;
+};
+} // namespace quic
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerLoadMonitor.h>
+
+#include <folly/lang/Assume.h>
+#include <glog/logging.h>
+
+namespace quic {
+
+namespace {
+bool crossed(
+    const LoadSheddingSettings::Threshold& threshold,
+    std::chrono::microseconds loopLag,
+    uint64_t pendingPackets) {
+  return loopLag >= threshold.loopLag ||
+      pendingPackets >= threshold.pendingPackets;
+}
+} // namespace
+
+WorkerLoadMonitor::WorkerLoadMonitor(
+    folly::EventBase* evb,
+    LoadSheddingSettings settings)
+    : folly::AsyncTimeout(evb), settings_(std::move(settings)) {}
+
+void WorkerLoadMonitor::start() {
+  if (!isScheduled()) {
+    scheduleSample();
+  }
+}
+
+void WorkerLoadMonitor::onPendingPackets(uint64_t numPackets) {
+  maxPendingPackets_ = std::max(maxPendingPackets_, numPackets);
+  setLevel(std::max(level_, getLevelFor(loopLag_, numPackets)));
+}
+
+void WorkerLoadMonitor::onLoopLag(std::chrono::microseconds lag) {
+  loopLag_ = lag;
+  setLevel(getLevelFor(loopLag_, maxPendingPackets_));
+  maxPendingPackets_ = 0;
+}
+
+void WorkerLoadMonitor::timeoutExpired() noexcept {
+  auto now = std::chrono::steady_clock::now();
+  onLoopLag(
+      now > sampleDueTime_
+          ? std::chrono::duration_cast<std::chrono::microseconds>(
+                now - sampleDueTime_)
+          : std::chrono::microseconds::zero());
+  scheduleSample();
+}
+
+const char* WorkerLoadMonitor::toString(LoadLevel level) {
+  switch (level) {
+    case LoadLevel::NORMAL:
+      return "NORMAL";
+    case LoadLevel::RETRY:
+      return "RETRY";
+    case LoadLevel::REJECT:
+      return "REJECT";
+    case LoadLevel::DROP_HANDSHAKES:
+      return "DROP_HANDSHAKES";
+  }
+  folly::assume_unreachable();
+}
+
+WorkerLoadMonitor::LoadLevel WorkerLoadMonitor::getLevelFor(
+    std::chrono::microseconds loopLag,
+    uint64_t pendingPackets) const {
+  if (crossed(settings_.dropHandshakes, loopLag, pendingPackets)) {
+    return LoadLevel::DROP_HANDSHAKES;
+  }
+  if (crossed(settings_.reject, loopLag, pendingPackets)) {
+    return LoadLevel::REJECT;
+  }
+  if (crossed(settings_.retry, loopLag, pendingPackets)) {
+    return LoadLevel::RETRY;
+  }
+  return LoadLevel::NORMAL;
+}
+
+void WorkerLoadMonitor::setLevel(LoadLevel level) {
+  if (level != level_) {
+    VLOG(2) << "Worker load level " << toString(level_) << " -> "
+            << toString(level) << " loopLag=" << loopLag_.count()
+            << "us pendingPackets=" << maxPendingPackets_;
+    level_ = level;
+  }
+}
+
+void WorkerLoadMonitor::scheduleSample() {
+  sampleDueTime_ = std::chrono::steady_clock::now() + settings_.sampleInterval;
+  scheduleTimeout(settings_.sampleInterval);
+}
+} // namespace quic
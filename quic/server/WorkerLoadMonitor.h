@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <quic/state/TransportSettings.h>
+
+namespace quic {
+
+/**
+ * Tracks the load of a QuicServerWorker and the level of load shedding it
+ * calls for, see LoadSheddingSettings.
+ *
+ * The lag of the event loop is how late a timeout that is due every
+ * sampleInterval fires, which is how long the loop was busy with other work
+ * past its due time. The number of pending packets is reported by whoever
+ * drains the handoff queues of the worker. The level goes up as soon as a
+ * report crosses a threshold, and is recomputed from the latest lag sample
+ * and the largest number of pending packets reported during the interval at
+ * every sample, so that it comes down once the load is gone.
+ */
+class WorkerLoadMonitor : public folly::AsyncTimeout {
+ public:
+  enum class LoadLevel : uint8_t {
+    NORMAL,
+    RETRY,
+    REJECT,
+    DROP_HANDSHAKES,
+  };
+
+  WorkerLoadMonitor(folly::EventBase* evb, LoadSheddingSettings settings);
+
+  ~WorkerLoadMonitor() override = default;
+
+  /**
+   * Starts sampling the lag of the event loop.
+   */
+  void start();
+
+  LoadLevel getLoadLevel() const {
+    return level_;
+  }
+
+  std::chrono::microseconds getLoopLag() const {
+    return loopLag_;
+  }
+
+  /**
+   * Number of packets waiting in the handoff queues of the worker.
+   */
+  void onPendingPackets(uint64_t numPackets);
+
+  /**
+   * A sample of the lag of the event loop. The timeout reports its own
+   * samples.
+   */
+  void onLoopLag(std::chrono::microseconds lag);
+
+  void timeoutExpired() noexcept override;
+
+  static const char* toString(LoadLevel level);
+
+ private:
+  LoadLevel getLevelFor(
+      std::chrono::microseconds loopLag,
+      uint64_t pendingPackets) const;
+
+  void setLevel(LoadLevel level);
+
+  void scheduleSample();
+
+  LoadSheddingSettings settings_;
+  LoadLevel level_{LoadLevel::NORMAL};
+  std::chrono::microseconds loopLag_{0};
+  // The largest number of pending packets reported since the last sample.
+  uint64_t maxPendingPackets_{0};
+  std::chrono::steady_clock::time_point sampleDueTime_;
+};
+} // namespace quic
@@ -25,6 +25,117 @@
 
 namespace quic {
 
+namespace {
+// The first byte of a token in the compact layout. A token in the original
+// layout starts with the type of the transport parameters extension, whose
+// first byte is never this.
+constexpr uint8_t kCompactAppTokenFormat = 0x01;
+constexpr uint8_t kCompactAppTokenHasCongestionState = 0x01;
+
+bool isCompactAppToken(const folly::IOBuf& buf) {
+  folly::io::Cursor cursor(&buf);
+  return cursor.canAdvance(sizeof(uint8_t)) &&
+      cursor.read<uint8_t>() == kCompactAppTokenFormat;
+}
+
+folly::Optional<TicketTransportValues> getTicketTransportValues(
+    const std::vector<TransportParameter>& params) {
+  if (params.size() != kExpectedNumOfParamsInTheTicket) {
+    return folly::none;
+  }
+  TicketTransportValues values;
+  std::pair<TransportParameterId, uint64_t*> fields[] = {
+      {TransportParameterId::idle_timeout, &values.idleTimeout},
+      {TransportParameterId::max_packet_size, &values.maxRecvPacketSize},
+      {TransportParameterId::initial_max_data, &values.initialMaxData},
+      {TransportParameterId::initial_max_stream_data_bidi_local,
+       &values.initialMaxStreamDataBidiLocal},
+      {TransportParameterId::initial_max_stream_data_bidi_remote,
+       &values.initialMaxStreamDataBidiRemote},
+      {TransportParameterId::initial_max_stream_data_uni,
+       &values.initialMaxStreamDataUni},
+      {TransportParameterId::initial_max_streams_bidi,
+       &values.initialMaxStreamsBidi},
+      {TransportParameterId::initial_max_streams_uni,
+       &values.initialMaxStreamsUni}};
+  for (auto& field : fields) {
+    auto value = getIntegerParameter(field.first, params);
+    if (!value) {
+      return folly::none;
+    }
+    *field.second = *value;
+  }
+  return values;
+}
+
+std::unique_ptr<folly::IOBuf> encodeCompactAppToken(
+    const AppToken& appToken,
+    const TicketTransportValues& values) {
+  auto buf = folly::IOBuf::create(128);
+  folly::io::Appender appender(buf.get(), 128);
+  appender.writeBE<uint8_t>(kCompactAppTokenFormat);
+  appender.writeBE<QuicVersionType>(
+      static_cast<QuicVersionType>(*appToken.version));
+  appender.writeBE<uint64_t>(values.idleTimeout);
+  appender.writeBE<uint64_t>(values.maxRecvPacketSize);
+  appender.writeBE<uint64_t>(values.initialMaxData);
+  appender.writeBE<uint64_t>(values.initialMaxStreamDataBidiLocal);
+  appender.writeBE<uint64_t>(values.initialMaxStreamDataBidiRemote);
+  appender.writeBE<uint64_t>(values.initialMaxStreamDataUni);
+  appender.writeBE<uint64_t>(values.initialMaxStreamsBidi);
+  appender.writeBE<uint64_t>(values.initialMaxStreamsUni);
+  appender.writeBE<uint8_t>(
+      appToken.congestionState ? kCompactAppTokenHasCongestionState : 0);
+  if (appToken.congestionState) {
+    const auto& congestionState = *appToken.congestionState;
+    appender.writeBE<uint64_t>(congestionState.srtt.count());
+    appender.writeBE<uint64_t>(congestionState.minRtt.count());
+    appender.writeBE<uint64_t>(congestionState.bandwidth);
+    appender.writeBE<uint64_t>(congestionState.timestamp.count());
+  }
+  fizz::detail::writeVector<uint8_t>(appToken.sourceAddresses, appender);
+  fizz::detail::writeBuf<uint16_t>(appToken.appParams, appender);
+  return buf;
+}
+
+folly::Optional<DecodedAppToken> decodeCompactAppToken(
+    const folly::IOBuf& buf) {
+  DecodedAppToken appToken;
+  folly::io::Cursor cursor(&buf);
+  try {
+    cursor.skip(sizeof(kCompactAppTokenFormat));
+    appToken.version =
+        static_cast<QuicVersion>(cursor.readBE<QuicVersionType>());
+    auto& values = appToken.transportParams;
+    values.idleTimeout = cursor.readBE<uint64_t>();
+    values.maxRecvPacketSize = cursor.readBE<uint64_t>();
+    values.initialMaxData = cursor.readBE<uint64_t>();
+    values.initialMaxStreamDataBidiLocal = cursor.readBE<uint64_t>();
+    values.initialMaxStreamDataBidiRemote = cursor.readBE<uint64_t>();
+    values.initialMaxStreamDataUni = cursor.readBE<uint64_t>();
+    values.initialMaxStreamsBidi = cursor.readBE<uint64_t>();
+    values.initialMaxStreamsUni = cursor.readBE<uint64_t>();
+    auto flags = cursor.readBE<uint8_t>();
+    if (flags & kCompactAppTokenHasCongestionState) {
+      TicketCongestionState congestionState;
+      congestionState.srtt =
+          std::chrono::microseconds(cursor.readBE<uint64_t>());
+      congestionState.minRtt =
+          std::chrono::microseconds(cursor.readBE<uint64_t>());
+      congestionState.bandwidth = cursor.readBE<uint64_t>();
+      congestionState.timestamp =
+          std::chrono::seconds(cursor.readBE<uint64_t>());
+      appToken.congestionState = congestionState;
+    }
+    fizz::detail::readVector<uint8_t>(appToken.sourceAddresses, cursor);
+    fizz::detail::readBuf<uint16_t>(appToken.appParams, cursor);
+  } catch (const std::exception& ex) {
+    return folly::none;
+  }
+  return appToken;
+}
+} // namespace
+
 TicketTransportParameters createTicketTransportParameters(
     uint64_t idleTimeout,
     uint64_t maxRecvPacketSize,
@@ -58,6 +169,13 @@ TicketTransportParameters createTicketTransportParameters(
 }
 
 std::unique_ptr<folly::IOBuf> encodeAppToken(const AppToken& appToken) {
+  if (appToken.compact && appToken.version) {
+    auto values =
+        getTicketTransportValues(appToken.transportParams.parameters);
+    if (values) {
+      return encodeCompactAppToken(appToken, *values);
+    }
+  }
   auto buf = folly::IOBuf::create(20);
   folly::io::Appender appender(buf.get(), 20);
   auto ext = encodeExtension(appToken.transportParams);
@@ -67,10 +185,20 @@ std::unique_ptr<folly::IOBuf> encodeAppToken(const AppToken& appToken) {
     fizz::detail::write(appToken.version.value(), appender);
   }
   fizz::detail::writeBuf<uint16_t>(appToken.appParams, appender);
+  if (appToken.version && appToken.congestionState) {
+    const auto& congestionState = *appToken.congestionState;
+    appender.writeBE<uint64_t>(congestionState.srtt.count());
+    appender.writeBE<uint64_t>(congestionState.minRtt.count());
+    appender.writeBE<uint64_t>(congestionState.bandwidth);
+    appender.writeBE<uint64_t>(congestionState.timestamp.count());
+  }
   return buf;
 }
 
 folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf) {
+  if (isCompactAppToken(buf)) {
+    return folly::none;
+  }
   AppToken appToken;
   folly::io::Cursor cursor(&buf);
   std::vector<fizz::Extension> extensions;
@@ -88,10 +216,41 @@ folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf) {
     fizz::detail::read(v, cursor);
     appToken.version = v;
     fizz::detail::readBuf<uint16_t>(appToken.appParams, cursor);
+    if (cursor.isAtEnd()) {
+      return appToken;
+    }
+    TicketCongestionState congestionState;
+    congestionState.srtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    congestionState.minRtt =
+        std::chrono::microseconds(cursor.readBE<uint64_t>());
+    congestionState.bandwidth = cursor.readBE<uint64_t>();
+    congestionState.timestamp = std::chrono::seconds(cursor.readBE<uint64_t>());
+    appToken.congestionState = congestionState;
   } catch (const std::exception& ex) {
     return folly::none;
   }
   return appToken;
 }
 
+folly::Optional<DecodedAppToken> decodeAppTokenValues(const folly::IOBuf& buf) {
+  if (isCompactAppToken(buf)) {
+    return decodeCompactAppToken(buf);
+  }
+  auto appToken = decodeAppToken(buf);
+  if (!appToken) {
+    return folly::none;
+  }
+  auto values = getTicketTransportValues(appToken->transportParams.parameters);
+  if (!values) {
+    return folly::none;
+  }
+  DecodedAppToken decoded;
+  decoded.transportParams = *values;
+  decoded.sourceAddresses = std::move(appToken->sourceAddresses);
+  decoded.version = appToken->version;
+  decoded.appParams = std::move(appToken->appParams);
+  decoded.congestionState = appToken->congestionState;
+  return decoded;
+}
+
 } // namespace quic
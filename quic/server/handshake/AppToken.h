@@ -30,11 +30,56 @@ class IOBuf;
 
 namespace quic {
 
+/**
+ * Congestion estimates of the connection that issued a ticket, for the
+ * connections resuming from it.
+ */
+struct TicketCongestionState {
+  std::chrono::microseconds srtt{0us};
+  std::chrono::microseconds minRtt{0us};
+  // Bytes per second
+  uint64_t bandwidth{0};
+  // When the estimates were taken, in seconds since the epoch of the system
+  // clock since the ticket outlives the process.
+  std::chrono::seconds timestamp{0};
+};
+
 struct AppToken {
   TicketTransportParameters transportParams;
   std::vector<folly::IPAddress> sourceAddresses;
   folly::Optional<QuicVersion> version;
   std::unique_ptr<folly::IOBuf> appParams;
+  // Only encoded when version is set.
+  folly::Optional<TicketCongestionState> congestionState;
+  // Whether to encode the token in the compact layout, see encodeAppToken().
+  bool compact{false};
+};
+
+/**
+ * The transport parameters written in a ticket, see
+ * createTicketTransportParameters().
+ */
+struct TicketTransportValues {
+  uint64_t idleTimeout{0};
+  uint64_t maxRecvPacketSize{0};
+  uint64_t initialMaxData{0};
+  uint64_t initialMaxStreamDataBidiLocal{0};
+  uint64_t initialMaxStreamDataBidiRemote{0};
+  uint64_t initialMaxStreamDataUni{0};
+  uint64_t initialMaxStreamsBidi{0};
+  uint64_t initialMaxStreamsUni{0};
+};
+
+/**
+ * An AppToken with its transport parameters decoded as integers, which is
+ * what validating a token needs.
+ */
+struct DecodedAppToken {
+  TicketTransportValues transportParams;
+  std::vector<folly::IPAddress> sourceAddresses;
+  folly::Optional<QuicVersion> version;
+  std::unique_ptr<folly::IOBuf> appParams;
+  folly::Optional<TicketCongestionState> congestionState;
 };
 
 TicketTransportParameters createTicketTransportParameters(
@@ -47,10 +92,27 @@ TicketTransportParameters createTicketTransportParameters(
     uint64_t initialMaxStreamsBidi,
     uint64_t initialMaxStreamsUni);
 
+/**
+ * Encodes the token as a transport parameters extension followed by the
+ * other fields, or, when appToken.compact is set and it has a version, in a
+ * compact layout: a format byte, the version and the parameters as fixed
+ * size integers, then the other fields. The compact layout can be decoded
+ * in one pass, without building the list of parameters.
+ */
 std::unique_ptr<folly::IOBuf> encodeAppToken(const AppToken& appToken);
 
+/**
+ * Decodes a token in the original layout. Returns none for a token in the
+ * compact layout.
+ */
 folly::Optional<AppToken> decodeAppToken(const folly::IOBuf& buf);
 
+/**
+ * Decodes a token in either layout. Returns none if the token is malformed
+ * or doesn't have exactly the parameters of a ticket.
+ */
+folly::Optional<DecodedAppToken> decodeAppTokenValues(const folly::IOBuf& buf);
+
 class FailingAppTokenValidator : public fizz::server::AppTokenValidator {
   bool validate(const fizz::server::ResumptionState&) const override {
     return false;
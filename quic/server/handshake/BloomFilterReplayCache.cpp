@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/BloomFilterReplayCache.h>
+
+#include <folly/Random.h>
+#include <folly/hash/SpookyHashV2.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace quic {
+
+namespace {
+constexpr size_t kBitsPerWord = 64;
+} // namespace
+
+BloomFilterReplayCache::BloomFilterReplayCache(
+    uint64_t expectedHandshakesPerSecond,
+    std::chrono::milliseconds window,
+    double falsePositiveRate)
+    : window_(window), seed_(folly::Random::secureRand64()) {
+  if (window_.count() <= 0) {
+    throw std::invalid_argument("Replay cache window must be positive");
+  }
+  if (falsePositiveRate <= 0 || falsePositiveRate >= 1) {
+    throw std::invalid_argument(
+        "Replay cache false positive rate must be in (0, 1)");
+  }
+  // The optimal bloom filter for n entries and a false positive rate p has
+  // -n * ln(p) / ln(2)^2 bits and uses ln(2) * bits / n hashes.
+  double entries = std::max(
+      1.0,
+      double(expectedHandshakesPerSecond) * window_.count() /
+          std::milli::den);
+  double ln2 = std::log(2.0);
+  double bits =
+      std::ceil(-entries * std::log(falsePositiveRate) / (ln2 * ln2));
+  size_t numWords = (size_t(bits) + kBitsPerWord - 1) / kBitsPerWord;
+  numBits_ = numWords * kBitsPerWord;
+  numHashes_ = std::max<size_t>(1, std::lround(ln2 * numBits_ / entries));
+  for (auto& filter : filters_) {
+    filter.resize(numWords, 0);
+  }
+}
+
+folly::Future<fizz::server::ReplayCacheResult> BloomFilterReplayCache::check(
+    folly::ByteRange identifier) {
+  return checkAndInsert(identifier, Clock::now());
+}
+
+fizz::server::ReplayCacheResult BloomFilterReplayCache::checkAndInsert(
+    folly::ByteRange identifier,
+    TimePoint now) {
+  // The bits of the identifier are h1 + i * h2 for i < numHashes_.
+  uint64_t h1 = seed_;
+  uint64_t h2 = seed_;
+  folly::hash::SpookyHashV2::Hash128(
+      identifier.data(), identifier.size(), &h1, &h2);
+  std::lock_guard<std::mutex> guard(mutex_);
+  rotate(now);
+  auto& current = filters_[currentWindow_ % 2];
+  const auto& previous = filters_[(currentWindow_ + 1) % 2];
+  bool inCurrent = true;
+  bool inPrevious = true;
+  for (size_t i = 0; i < numHashes_; ++i) {
+    uint64_t bit = (h1 + i * h2) % numBits_;
+    size_t word = bit / kBitsPerWord;
+    uint64_t mask = uint64_t(1) << (bit % kBitsPerWord);
+    inCurrent = inCurrent && (current[word] & mask);
+    inPrevious = inPrevious && (previous[word] & mask);
+    current[word] |= mask;
+  }
+  return (inCurrent || inPrevious)
+      ? fizz::server::ReplayCacheResult::MaybeReplay
+      : fizz::server::ReplayCacheResult::NotReplay;
+}
+
+void BloomFilterReplayCache::rotate(TimePoint now) {
+  uint64_t nowWindow =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          now.time_since_epoch()) /
+      window_;
+  if (nowWindow <= currentWindow_) {
+    return;
+  }
+  // The filter of the new window held the one before the previous window,
+  // both filters are stale after more than a window without a check.
+  for (uint64_t window = std::max(currentWindow_ + 1, nowWindow - 1);
+       window <= nowWindow;
+       ++window) {
+    auto& filter = filters_[window % 2];
+    std::fill(filter.begin(), filter.end(), 0);
+  }
+  currentWindow_ = nowWindow;
+}
+} // namespace quic
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <fizz/server/ReplayCache.h>
+#include <folly/Range.h>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A replay cache for the early data of the server, in fixed memory. The
+ * identifiers of the ClientHellos go in two bloom filters, each one for a
+ * window of time: the ClientHellos of the current window and of the previous
+ * one are remembered, older ones are forgotten when the filter of the window
+ * before is reset. Set the window to the width of the ClockSkewTolerance of
+ * the early data settings, the TLS stack rejects the early data of older
+ * ClientHellos since their ticket age is off by more than that.
+ *
+ * A ClientHello that may have been seen returns MaybeReplay, which only
+ * rejects its early data, so that a false positive costs a round trip and
+ * not the connection.
+ *
+ * The FizzServerContext is shared by the workers of a QuicServer, and so is
+ * the cache installed in its early data settings:
+ *
+ *   ctx->setEarlyDataSettings(
+ *       true,
+ *       clockSkew,
+ *       std::make_shared<BloomFilterReplayCache>(handshakesPerSecond, window));
+ *
+ * A check takes a lock and a few memory accesses, whatever the number of
+ * ClientHellos remembered.
+ */
+class BloomFilterReplayCache : public fizz::server::ReplayCache {
+ public:
+  /**
+   * Sized for the ClientHellos of a window at expectedHandshakesPerSecond,
+   * with the given rate of false positives.
+   */
+  BloomFilterReplayCache(
+      uint64_t expectedHandshakesPerSecond,
+      std::chrono::milliseconds window,
+      double falsePositiveRate = kDefaultReplayCacheFalsePositiveRate);
+
+  ~BloomFilterReplayCache() override = default;
+
+  folly::Future<fizz::server::ReplayCacheResult> check(
+      folly::ByteRange identifier) override;
+
+  /**
+   * Whether the identifier was seen at the given time, and remembers it.
+   */
+  fizz::server::ReplayCacheResult checkAndInsert(
+      folly::ByteRange identifier,
+      TimePoint now);
+
+  /**
+   * The bits of one of the filters.
+   */
+  size_t getNumBits() const {
+    return numBits_;
+  }
+
+  size_t getNumHashes() const {
+    return numHashes_;
+  }
+
+ private:
+  using Filter = std::vector<uint64_t>;
+
+  // Resets the filters of the windows that ended before the previous one.
+  void rotate(TimePoint now);
+
+  std::chrono::milliseconds window_;
+  size_t numBits_;
+  size_t numHashes_;
+  // Keys the hashes so that clients can't pick identifiers that collide.
+  uint64_t seed_;
+  // The filter of a window is filters_[window % 2].
+  std::array<Filter, 2> filters_;
+  TimePoint start_;
+  uint64_t currentWindow_{0};
+  std::mutex mutex_;
+};
+} // namespace quic
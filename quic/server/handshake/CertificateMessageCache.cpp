@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/CertificateMessageCache.h>
+
+#include <fizz/record/Types.h>
+
+#include <cstring>
+
+namespace quic {
+
+namespace {
+// The type and the 24 bit length of a handshake message.
+constexpr size_t kHandshakeMessageHeaderSize = 4;
+} // namespace
+
+CertificateMessageCache::CertificateMessageCache(size_t capacity)
+    : capacity_(capacity) {}
+
+Buf CertificateMessageCache::share(Buf flight) {
+  if (!flight) {
+    return flight;
+  }
+  folly::ByteRange data = flight->coalesce();
+  size_t offset = 0;
+  while (data.size() - offset >= kHandshakeMessageHeaderSize) {
+    auto type = static_cast<fizz::HandshakeType>(data[offset]);
+    size_t messageSize = kHandshakeMessageHeaderSize +
+        ((size_t(data[offset + 1]) << 16) | (size_t(data[offset + 2]) << 8) |
+         size_t(data[offset + 3]));
+    if (messageSize > data.size() - offset) {
+      return flight;
+    }
+    if (type != fizz::HandshakeType::certificate &&
+        type != fizz::HandshakeType::compressed_certificate) {
+      offset += messageSize;
+      continue;
+    }
+    auto message = getMessage(data.subpiece(offset, messageSize));
+    if (!message) {
+      return flight;
+    }
+    auto shared = folly::IOBuf::copyBuffer(data.data(), offset);
+    shared->prependChain(std::move(message));
+    size_t suffixOffset = offset + messageSize;
+    if (suffixOffset < data.size()) {
+      shared->prependChain(folly::IOBuf::copyBuffer(
+          data.data() + suffixOffset, data.size() - suffixOffset));
+    }
+    return shared;
+  }
+  return flight;
+}
+
+Buf CertificateMessageCache::getMessage(folly::ByteRange message) {
+  for (const auto& cached : messages_) {
+    if (cached->length() == message.size() &&
+        std::memcmp(cached->data(), message.data(), message.size()) == 0) {
+      ++hits_;
+      return cached->clone();
+    }
+  }
+  ++misses_;
+  if (messages_.size() >= capacity_) {
+    return nullptr;
+  }
+  messages_.push_back(folly::IOBuf::copyBuffer(message));
+  return messages_.back()->clone();
+}
+} // namespace quic
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+#include <quic/codec/Types.h>
+
+#include <folly/Range.h>
+
+#include <vector>
+
+namespace quic {
+
+/**
+ * Keeps one copy of the Certificate messages the server sends, compressed or
+ * not, so that the crypto streams of the handshakes hold a reference to it
+ * instead of their own copy of the certificate chain until the flight is
+ * acked. The TLS
+ * stack encodes a flight into one buffer: share() splits the Certificate
+ * message out of it and replaces it with a clone of the cached one, the
+ * messages around it, which are specific to the handshake, are copied out.
+ *
+ * Meant to be owned by a worker and only used from its thread.
+ */
+class CertificateMessageCache {
+ public:
+  explicit CertificateMessageCache(
+      size_t capacity = kDefaultCertificateMessageCacheSize);
+
+  /**
+   * Returns the flight with its Certificate message shared. The flight is
+   * returned as is if it has no Certificate message, or if the message isn't
+   * cached yet and the cache is full.
+   */
+  Buf share(Buf flight);
+
+  size_t size() const {
+    return messages_.size();
+  }
+
+  uint64_t hits() const {
+    return hits_;
+  }
+
+  uint64_t misses() const {
+    return misses_;
+  }
+
+ private:
+  // A clone of the cached message with these bytes, nullptr if there is none
+  // and there is no room for it.
+  Buf getMessage(folly::ByteRange message);
+
+  size_t capacity_;
+  std::vector<Buf> messages_;
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+};
+} // namespace quic
@@ -46,7 +46,13 @@ bool DefaultAppTokenValidator::validate(
     return false;
   }
 
-  auto appToken = decodeAppToken(*resumptionState.appToken);
+  // TODO T33454954 Simplify ticket transport params. see comments in D9324131
+  // Currenly only initialMaxData, initialMaxStreamData, ackDelayExponent, and
+  // maxRecvPacketSize are written into the ticket. In case new parameters
+  // are added for making early data decision (although not likely), the
+  // decoding fails if the number of parameters is not
+  // kExpectedNumOfParamsInTheTicket.
+  auto appToken = decodeAppTokenValues(*resumptionState.appToken);
   if (!appToken) {
     VLOG(10) << "Failed to decode app token";
     return false;
@@ -57,76 +63,39 @@ bool DefaultAppTokenValidator::validate(
     return false;
   }
 
-  auto& params = appToken->transportParams.parameters;
-
-  // TODO T33454954 Simplify ticket transport params. see comments in D9324131
-  // Currenly only initialMaxData, initialMaxStreamData, ackDelayExponent, and
-  // maxRecvPacketSize are written into the ticket. In case new parameters
-  // are added for making early data decision (although not likely), this
-  // validator fails the check if number of parameters is not
-  // kExpectedNumOfParamsInTheTicket.
-  if (params.size() != kExpectedNumOfParamsInTheTicket) {
-    VLOG(10) << "Unexpected number of parameters in the ticket";
-    return false;
-  }
-
-  auto ticketIdleTimeout =
-      getIntegerParameter(TransportParameterId::idle_timeout, params);
-  if (!ticketIdleTimeout ||
-      conn_->transportSettings.idleTimeout !=
-          std::chrono::milliseconds(*ticketIdleTimeout)) {
+  const auto& ticket = appToken->transportParams;
+  const auto& settings = conn_->transportSettings;
+  if (settings.idleTimeout != std::chrono::milliseconds(ticket.idleTimeout)) {
     VLOG(10) << "Changed idle timeout";
     return false;
   }
 
-  auto ticketPacketSize =
-      getIntegerParameter(TransportParameterId::max_packet_size, params);
-  if (!ticketPacketSize ||
-      conn_->transportSettings.maxRecvPacketSize < *ticketPacketSize) {
+  if (settings.maxRecvPacketSize < ticket.maxRecvPacketSize) {
     VLOG(10) << "Decreased max receive packet size";
     return false;
   }
 
   // if the current max data is less than the one advertised previously we
   // reject the early data
-  auto ticketMaxData =
-      getIntegerParameter(TransportParameterId::initial_max_data, params);
-  if (!ticketMaxData ||
-      conn_->transportSettings.advertisedInitialConnectionWindowSize <
-          *ticketMaxData) {
+  if (settings.advertisedInitialConnectionWindowSize <
+      ticket.initialMaxData) {
     VLOG(10) << "Decreased max data";
     return false;
   }
 
-  auto ticketMaxStreamDataBidiLocal = getIntegerParameter(
-      TransportParameterId::initial_max_stream_data_bidi_local, params);
-  auto ticketMaxStreamDataBidiRemote = getIntegerParameter(
-      TransportParameterId::initial_max_stream_data_bidi_remote, params);
-  auto ticketMaxStreamDataUni = getIntegerParameter(
-      TransportParameterId::initial_max_stream_data_uni, params);
-  if (!ticketMaxStreamDataBidiLocal ||
-      conn_->transportSettings.advertisedInitialBidiLocalStreamWindowSize <
-          *ticketMaxStreamDataBidiLocal ||
-      !ticketMaxStreamDataBidiRemote ||
-      conn_->transportSettings.advertisedInitialBidiRemoteStreamWindowSize <
-          *ticketMaxStreamDataBidiRemote ||
-      !ticketMaxStreamDataUni ||
-      conn_->transportSettings.advertisedInitialUniStreamWindowSize <
-          *ticketMaxStreamDataUni) {
+  if (settings.advertisedInitialBidiLocalStreamWindowSize <
+          ticket.initialMaxStreamDataBidiLocal ||
+      settings.advertisedInitialBidiRemoteStreamWindowSize <
+          ticket.initialMaxStreamDataBidiRemote ||
+      settings.advertisedInitialUniStreamWindowSize <
+          ticket.initialMaxStreamDataUni) {
     VLOG(10) << "Decreased max stream data";
     return false;
   }
 
-  auto ticketMaxStreamsBidi = getIntegerParameter(
-      TransportParameterId::initial_max_streams_bidi, params);
-  auto ticketMaxStreamsUni = getIntegerParameter(
-      TransportParameterId::initial_max_streams_uni, params);
-  if (!ticketMaxStreamsBidi ||
-      conn_->transportSettings.advertisedInitialMaxStreamsBidi <
-          *ticketMaxStreamsBidi ||
-      !ticketMaxStreamsUni ||
-      conn_->transportSettings.advertisedInitialMaxStreamsUni <
-          *ticketMaxStreamsUni) {
+  if (settings.advertisedInitialMaxStreamsBidi <
+          ticket.initialMaxStreamsBidi ||
+      settings.advertisedInitialMaxStreamsUni < ticket.initialMaxStreamsUni) {
     VLOG(10) << "Decreased max stream data";
     return false;
   }
@@ -153,14 +122,27 @@ bool DefaultAppTokenValidator::validate(
 
   updateTransportParamsFromTicket(
       *conn_,
-      *ticketIdleTimeout,
-      *ticketPacketSize,
-      *ticketMaxData,
-      *ticketMaxStreamDataBidiLocal,
-      *ticketMaxStreamDataBidiRemote,
-      *ticketMaxStreamDataUni,
-      *ticketMaxStreamsBidi,
-      *ticketMaxStreamsUni);
+      ticket.idleTimeout,
+      ticket.maxRecvPacketSize,
+      ticket.initialMaxData,
+      ticket.initialMaxStreamDataBidiLocal,
+      ticket.initialMaxStreamDataBidiRemote,
+      ticket.initialMaxStreamDataUni,
+      ticket.initialMaxStreamsBidi,
+      ticket.initialMaxStreamsUni);
+
+  if (conn_->transportSettings.congestionStateInTicket &&
+      appToken->congestionState) {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    auto age = now - appToken->congestionState->timestamp;
+    if (age >= std::chrono::seconds::zero() &&
+        age <= kTicketCongestionStateLifetime) {
+      conn_->ticketCongestionState = appToken->congestionState;
+    } else {
+      VLOG(10) << "Stale congestion state in the ticket";
+    }
+  }
 
   return true;
 }
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/InitialCipherCache.h>
+
+#include <quic/handshake/FizzBridge.h>
+#include <quic/handshake/HandshakeLayer.h>
+
+namespace quic {
+
+InitialCipherCache::InitialCipherCache(size_t capacity) : keys_(capacity) {}
+
+std::unique_ptr<Aead> InitialCipherCache::getClientInitialCipher(
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeAead(getKeys(clientDestinationConnId, version).client);
+}
+
+std::unique_ptr<Aead> InitialCipherCache::getServerInitialCipher(
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeAead(getKeys(clientDestinationConnId, version).server);
+}
+
+std::unique_ptr<PacketNumberCipher>
+InitialCipherCache::makeClientInitialHeaderCipher(
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeHeaderCipher(
+      getKeys(clientDestinationConnId, version).clientHeaderKey);
+}
+
+std::unique_ptr<PacketNumberCipher>
+InitialCipherCache::makeServerInitialHeaderCipher(
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  return makeHeaderCipher(
+      getKeys(clientDestinationConnId, version).serverHeaderKey);
+}
+
+const InitialCipherCache::InitialKeys& InitialCipherCache::getKeys(
+    const ConnectionId& clientDestinationConnId,
+    QuicVersion version) {
+  Key key{version, clientDestinationConnId};
+  auto it = keys_.find(key);
+  if (it != keys_.end()) {
+    ++hits_;
+    return it->second;
+  }
+  ++misses_;
+  auto headerKeyLength =
+      cryptoFactory_
+          .makePacketNumberCipher(fizz::CipherSuite::TLS_AES_128_GCM_SHA256)
+          ->keyLength();
+  InitialKeys keys;
+  keys.client = cryptoFactory_.makeInitialTrafficKey(
+      kClientInitialLabel, clientDestinationConnId, version);
+  keys.server = cryptoFactory_.makeInitialTrafficKey(
+      kServerInitialLabel, clientDestinationConnId, version);
+  keys.clientHeaderKey = cryptoFactory_.makePacketNumberKey(
+      cryptoFactory_
+          .makeInitialTrafficSecret(
+              kClientInitialLabel, clientDestinationConnId, version)
+          ->coalesce(),
+      headerKeyLength);
+  keys.serverHeaderKey = cryptoFactory_.makePacketNumberKey(
+      cryptoFactory_
+          .makeInitialTrafficSecret(
+              kServerInitialLabel, clientDestinationConnId, version)
+          ->coalesce(),
+      headerKeyLength);
+  keys_.set(key, std::move(keys));
+  return keys_.find(key)->second;
+}
+
+std::unique_ptr<Aead> InitialCipherCache::makeAead(
+    const fizz::TrafficKey& key) const {
+  auto aead =
+      cryptoFactory_.makeAead(fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  aead->setKey(key.clone());
+  return FizzAead::wrap(std::move(aead));
+}
+
+std::unique_ptr<PacketNumberCipher> InitialCipherCache::makeHeaderCipher(
+    const Buf& key) const {
+  auto headerCipher = cryptoFactory_.makePacketNumberCipher(
+      fizz::CipherSuite::TLS_AES_128_GCM_SHA256);
+  headerCipher->setKey(key->coalesce());
+  return headerCipher;
+}
+} // namespace quic
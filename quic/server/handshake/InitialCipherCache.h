@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/handshake/Aead.h>
+#include <quic/handshake/FizzCryptoFactory.h>
+
+#include <folly/container/EvictingCacheMap.h>
+
+namespace quic {
+
+/**
+ * Remembers the keys of the Initial ciphers derived from the destination
+ * connection id of the client's first Initial, so that deriving the ciphers
+ * again for the same connection id and version skips the HKDF rounds. The
+ * cache holds key material rather than ciphers, since every connection owns
+ * its ciphers: each call still returns a new Aead or PacketNumberCipher. The
+ * least recently used entries are evicted once the cache is full.
+ *
+ * Meant to be owned by a worker and only used from its thread.
+ */
+class InitialCipherCache {
+ public:
+  explicit InitialCipherCache(
+      size_t capacity = kDefaultInitialCipherCacheSize);
+
+  std::unique_ptr<Aead> getClientInitialCipher(
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<Aead> getServerInitialCipher(
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<PacketNumberCipher> makeClientInitialHeaderCipher(
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<PacketNumberCipher> makeServerInitialHeaderCipher(
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  size_t size() const {
+    return keys_.size();
+  }
+
+  uint64_t hits() const {
+    return hits_;
+  }
+
+  uint64_t misses() const {
+    return misses_;
+  }
+
+ private:
+  struct Key {
+    QuicVersion version;
+    ConnectionId connId;
+
+    bool operator==(const Key& other) const {
+      return version == other.version && connId == other.connId;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return ConnectionIdHash()(key.connId) ^
+          static_cast<size_t>(key.version);
+    }
+  };
+
+  struct InitialKeys {
+    fizz::TrafficKey client;
+    fizz::TrafficKey server;
+    Buf clientHeaderKey;
+    Buf serverHeaderKey;
+  };
+
+  const InitialKeys& getKeys(
+      const ConnectionId& clientDestinationConnId,
+      QuicVersion version);
+
+  std::unique_ptr<Aead> makeAead(const fizz::TrafficKey& key) const;
+
+  std::unique_ptr<PacketNumberCipher> makeHeaderCipher(const Buf& key) const;
+
+  FizzCryptoFactory cryptoFactory_;
+  folly::EvictingCacheMap<Key, InitialKeys, KeyHash> keys_;
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+};
+} // namespace quic
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+
+#include <folly/Range.h>
+#include <folly/lang/Bits.h>
+#include <folly/io/Cursor.h>
+#include <openssl/crypto.h>
+
+namespace {
+constexpr folly::StringPiece kSalt{"Retry token"};
+constexpr folly::StringPiece kNewTokenSalt{"New token"};
+// Issue time and the length of the connection id.
+constexpr size_t kRetryTokenFixedSize = sizeof(uint64_t) + sizeof(uint8_t);
+
+std::string encodeIssueTime(std::chrono::system_clock::time_point now) {
+  uint64_t issueTime =
+      std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch())
+          .count();
+  uint64_t issueTimeBE = folly::Endian::big(issueTime);
+  return std::string((const char*)&issueTimeBE, sizeof(issueTimeBE));
+}
+} // namespace
+
+namespace quic {
+
+RetryTokenGenerator::RetryTokenGenerator(RetryTokenSecret secret)
+    : hkdf_(fizz::HkdfImpl::create<fizz::Sha256>()) {
+  extractedSecret_ = hkdf_.extract(kSalt, folly::range(secret));
+  newTokenExtractedSecret_ =
+      hkdf_.extract(kNewTokenSalt, folly::range(secret));
+}
+
+
+std::string RetryTokenGenerator::generateToken(
+    const ConnectionId& originalConnId,
+    const folly::SocketAddress& clientAddr,
+    std::chrono::system_clock::time_point now) const {
+  auto token = encodeIssueTime(now);
+  token.push_back(static_cast<char>(originalConnId.size()));
+  token.append((const char*)originalConnId.data(), originalConnId.size());
+  auto tag =
+      computeTag(extractedSecret_, folly::StringPiece(token), clientAddr);
+  token.append((const char*)tag.data(), tag.size());
+  return token;
+}
+
+folly::Optional<ConnectionId> RetryTokenGenerator::validateToken(
+    const std::string& token,
+    const folly::SocketAddress& clientAddr,
+    std::chrono::seconds lifetime,
+    std::chrono::system_clock::time_point now) const {
+  if (token.size() < kRetryTokenFixedSize + kRetryTokenTagLength) {
+    return folly::none;
+  }
+  auto bodyLen = token.size() - kRetryTokenTagLength;
+  folly::ByteRange body((const uint8_t*)token.data(), bodyLen);
+  auto tag = computeTag(extractedSecret_, body, clientAddr);
+  if (CRYPTO_memcmp(tag.data(), token.data() + bodyLen, tag.size()) != 0) {
+    return folly::none;
+  }
+  // The token was generated by a server with the secret, so its fields are
+  // well formed from here on.
+  auto bodyBuf = folly::IOBuf::wrapBufferAsValue(body);
+  folly::io::Cursor cursor(&bodyBuf);
+  auto issueTime = std::chrono::system_clock::time_point(
+      std::chrono::seconds(cursor.readBE<uint64_t>()));
+  if (now < issueTime || now - issueTime > lifetime) {
+    return folly::none;
+  }
+  auto connIdLen = cursor.readBE<uint8_t>();
+  if (connIdLen != bodyLen - kRetryTokenFixedSize ||
+      connIdLen > kMaxConnectionIdSize) {
+    return folly::none;
+  }
+  return ConnectionId(cursor, connIdLen);
+}
+
+std::string RetryTokenGenerator::generateNewToken(
+    const folly::SocketAddress& clientAddr,
+    std::chrono::system_clock::time_point now) const {
+  auto token = encodeIssueTime(now);
+  auto tag = computeTag(
+      newTokenExtractedSecret_, folly::StringPiece(token), clientAddr);
+  token.append((const char*)tag.data(), tag.size());
+  return token;
+}
+
+bool RetryTokenGenerator::validateNewToken(
+    const std::string& token,
+    const folly::SocketAddress& clientAddr,
+    std::chrono::seconds lifetime,
+    std::chrono::system_clock::time_point now) const {
+  if (token.size() != sizeof(uint64_t) + kRetryTokenTagLength) {
+    return false;
+  }
+  folly::ByteRange body((const uint8_t*)token.data(), sizeof(uint64_t));
+  auto tag = computeTag(newTokenExtractedSecret_, body, clientAddr);
+  if (CRYPTO_memcmp(tag.data(), token.data() + body.size(), tag.size()) !=
+      0) {
+    return false;
+  }
+  auto bodyBuf = folly::IOBuf::wrapBufferAsValue(body);
+  folly::io::Cursor cursor(&bodyBuf);
+  auto issueTime = std::chrono::system_clock::time_point(
+      std::chrono::seconds(cursor.readBE<uint64_t>()));
+  return now >= issueTime && now - issueTime <= lifetime;
+}
+
+std::array<uint8_t, kRetryTokenTagLength> RetryTokenGenerator::computeTag(
+    const std::vector<uint8_t>& extractedSecret,
+    folly::ByteRange body,
+    const folly::SocketAddress& clientAddr) const {
+  std::array<uint8_t, kRetryTokenTagLength> tag;
+  auto clientIp = clientAddr.getIPAddress();
+  auto info = folly::IOBuf::wrapBufferAsValue(body);
+  info.prependChain(
+      folly::IOBuf::copyBuffer(clientIp.bytes(), clientIp.byteCount()));
+  auto out = hkdf_.expand(folly::range(extractedSecret), info, tag.size());
+  out->coalesce();
+  memcpy(tag.data(), out->data(), out->length());
+  return tag;
+}
+} // namespace quic
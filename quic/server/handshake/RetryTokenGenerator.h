@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <fizz/crypto/Hkdf.h>
+#include <fizz/crypto/Sha256.h>
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+
+#include <chrono>
+
+namespace quic {
+
+using RetryTokenSecret = std::array<uint8_t, kRetryTokenSecretLength>;
+
+/**
+ * Generates and validates the tokens the server puts in Retry packets, so that
+ * a client address can be validated without keeping any state.
+ *
+ * The token carries the time it was issued and the destination connection id
+ * of the client's first Initial, which the server has to echo in the
+ * original_connection_id transport parameter. Both are authenticated together
+ * with the client ip, so a token is only valid from the address it was sent
+ * to. Port changes, e.g. NAT rebinding, are allowed.
+ *
+ * PRK = HKDF-Extract(Salt, secret)
+ * appInfo = Concat(issueTime, odcidLength, odcid, clientIp)
+ * Token = Concat(issueTime, odcidLength, odcid,
+ *                HKDF-Expand(PRK, appInfo, tagLength))
+ *
+ * The tokens the server sends in NEW_TOKEN frames, for the client's next
+ * connections, only carry the issue time and are authenticated with a PRK
+ * extracted with another salt, so a token of one kind is never valid as the
+ * other.
+ */
+class RetryTokenGenerator {
+ public:
+  explicit RetryTokenGenerator(RetryTokenSecret secret);
+
+  std::string generateToken(
+      const ConnectionId& originalConnId,
+      const folly::SocketAddress& clientAddr,
+      std::chrono::system_clock::time_point now =
+          std::chrono::system_clock::now()) const;
+
+  /**
+   * Returns the destination connection id of the client's first Initial if
+   * the token was generated with the same secret for the client's ip and
+   * hasn't expired, and none otherwise.
+   */
+  folly::Optional<ConnectionId> validateToken(
+      const std::string& token,
+      const folly::SocketAddress& clientAddr,
+      std::chrono::seconds lifetime,
+      std::chrono::system_clock::time_point now =
+          std::chrono::system_clock::now()) const;
+
+  std::string generateNewToken(
+      const folly::SocketAddress& clientAddr,
+      std::chrono::system_clock::time_point now =
+          std::chrono::system_clock::now()) const;
+
+  /**
+   * Whether the token of a NEW_TOKEN frame was generated with the same secret
+   * for the client's ip and hasn't expired.
+   */
+  bool validateNewToken(
+      const std::string& token,
+      const folly::SocketAddress& clientAddr,
+      std::chrono::seconds lifetime,
+      std::chrono::system_clock::time_point now =
+          std::chrono::system_clock::now()) const;
+
+ private:
+  std::array<uint8_t, kRetryTokenTagLength> computeTag(
+      const std::vector<uint8_t>& extractedSecret,
+      folly::ByteRange body,
+      const folly::SocketAddress& clientAddr) const;
+
+  fizz::HkdfImpl hkdf_;
+  std::vector<uint8_t> extractedSecret_;
+  std::vector<uint8_t> newTokenExtractedSecret_;
+};
+} // namespace quic
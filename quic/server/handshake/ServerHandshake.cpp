@@ -9,6 +9,7 @@
 #include <quic/server/handshake/ServerHandshake.h>
 
 #include <fizz/protocol/Protocol.h>
+#include <folly/futures/Future.h>
 #include <quic/handshake/FizzBridge.h>
 #include <quic/handshake/FizzCryptoFactory.h>
 #include <quic/state/QuicStreamFunctions.h>
@@ -35,13 +36,21 @@ void ServerHandshake::initialize(
     std::unique_ptr<fizz::server::AppTokenValidator> validator) {
   executor_ = executor;
   auto ctx = std::make_shared<fizz::server::FizzServerContext>(*context);
-  auto cryptoFactory = std::make_shared<FizzCryptoFactory>();
-  ctx->setFactory(cryptoFactory);
-  cryptoFactory_ = std::move(cryptoFactory);
-  ctx->setSupportedCiphers({{fizz::CipherSuite::TLS_AES_128_GCM_SHA256}});
+  if (!cryptoFactory_) {
+    cryptoFactory_ = std::make_shared<FizzCryptoFactory>();
+  }
+  ctx->setFactory(cryptoFactory_);
+  // A single tier, so that the preference of the client wins: the clients
+  // without AES instructions offer ChaCha20-Poly1305 first.
+  ctx->setSupportedCiphers({{fizz::CipherSuite::TLS_AES_128_GCM_SHA256,
+                             fizz::CipherSuite::TLS_CHACHA20_POLY1305_SHA256}});
   ctx->setVersionFallbackEnabled(false);
   // Since Draft-17, client won't sent EOED
   ctx->setOmitEarlyRecordLayer(true);
+  if (!certificateCompressionAlgorithms_.empty() &&
+      ctx->getSupportedCompressionAlgorithms().empty()) {
+    ctx->setSupportedCompressionAlgorithms(certificateCompressionAlgorithms_);
+  }
   context_ = std::move(ctx);
   callback_ = callback;
 
@@ -52,6 +61,73 @@ void ServerHandshake::initialize(
   }
 }
 
+void ServerHandshake::setCryptoExecutor(folly::Executor* cryptoExecutor) {
+  CHECK(!transportParams_) << "Must be set before accept()";
+  cryptoExecutor_ = cryptoExecutor;
+}
+
+void ServerHandshake::setCryptoFactory(
+    std::shared_ptr<FizzCryptoFactory> cryptoFactory) {
+  CHECK(!context_) << "Must be set before initialize()";
+  cryptoFactory_ = std::move(cryptoFactory);
+}
+
+void ServerHandshake::setCertificateCompressionAlgorithms(
+    std::vector<fizz::CertificateCompressionAlgorithm> algorithms) {
+  CHECK(!context_) << "Must be set before initialize()";
+  certificateCompressionAlgorithms_ = std::move(algorithms);
+}
+
+void ServerHandshake::setCertificateMessageCache(
+    std::shared_ptr<CertificateMessageCache> certificateMessageCache) {
+  certificateMessageCache_ = std::move(certificateMessageCache);
+}
+
+void ServerHandshake::setRetainOneRttSecrets(bool retain) {
+  retainOneRttSecrets_ = retain;
+  if (!retain) {
+    oneRttSecrets_.clear();
+  }
+}
+
+const folly::Optional<ServerHandshake::OneRttSecrets>&
+ServerHandshake::getOneRttSecrets() const {
+  return oneRttSecrets_;
+}
+
+void ServerHandshake::adoptOneRttSecrets(
+    const OneRttSecrets& secrets,
+    folly::Optional<std::string> alpn) {
+  CHECK(context_) << "initialize() must be called first";
+  CHECK_EQ(static_cast<int>(phase_), static_cast<int>(Phase::Handshake));
+  const auto& factory = *context_->getFactory();
+  auto keyScheduler = factory.makeKeyScheduler(secrets.cipher);
+  auto makeAead = [&](folly::ByteRange secret) {
+    return FizzAead::wrap(fizz::Protocol::deriveRecordAeadWithLabel(
+        factory,
+        *keyScheduler,
+        secrets.cipher,
+        secret,
+        kQuicKeyLabel,
+        kQuicIVLabel));
+  };
+  auto clientSecret = folly::range(secrets.clientSecret);
+  auto serverSecret = folly::range(secrets.serverSecret);
+  oneRttReadCipher_ = makeAead(clientSecret);
+  oneRttReadHeaderCipher_ =
+      cryptoFactory_->makePacketNumberCipher(secrets.cipher, clientSecret);
+  oneRttWriteCipher_ = makeAead(serverSecret);
+  oneRttWriteHeaderCipher_ =
+      cryptoFactory_->makePacketNumberCipher(secrets.cipher, serverSecret);
+  state_.cipher() = secrets.cipher;
+  state_.alpn() = std::move(alpn);
+  if (retainOneRttSecrets_) {
+    oneRttSecrets_ = secrets;
+  }
+  handshakeDone_ = true;
+  phase_ = Phase::Established;
+}
+
 void ServerHandshake::doHandshake(
     std::unique_ptr<folly::IOBuf> data,
     EncryptionLevel encryptionLevel) {
@@ -62,7 +138,11 @@ void ServerHandshake::doHandshake(
   waitForData_ = false;
   switch (encryptionLevel) {
     case EncryptionLevel::Initial:
-      initialReadBuf_.append(std::move(data));
+      if (offloaded_) {
+        offloadedInitialReadBuf_.append(std::move(data));
+      } else {
+        initialReadBuf_.append(std::move(data));
+      }
       break;
     case EncryptionLevel::Handshake:
       handshakeReadBuf_.append(std::move(data));
@@ -143,6 +223,23 @@ ServerHandshake::getOneRttWriteHeaderCipher() {
   return std::move(oneRttWriteHeaderCipher_);
 }
 
+std::unique_ptr<OneRttKeyUpdater> ServerHandshake::getOneRttKeyUpdater() {
+  if (error_) {
+    throw QuicTransportException(error_->first, error_->second);
+  }
+  if (oneRttReadSecret_.empty() || oneRttWriteSecret_.empty()) {
+    return nullptr;
+  }
+  auto updater = std::make_unique<OneRttKeyUpdater>(
+      *state_.cipher(),
+      std::move(oneRttReadSecret_),
+      std::move(oneRttWriteSecret_),
+      cryptoFactory_);
+  oneRttReadSecret_.clear();
+  oneRttWriteSecret_.clear();
+  return updater;
+}
+
 std::unique_ptr<PacketNumberCipher>
 ServerHandshake::getHandshakeReadHeaderCipher() {
   if (error_) {
@@ -222,6 +319,10 @@ void ServerHandshake::onWriteData(fizz::WriteToSocket& write) {
     if (content.contentType != fizz::ContentType::handshake) {
       continue;
     }
+    if (certificateMessageCache_ &&
+        encryptionLevel == EncryptionLevel::Handshake) {
+      content.data = certificateMessageCache_->share(std::move(content.data));
+    }
     auto cryptoStream = getCryptoStream(cryptoState_, encryptionLevel);
     writeDataToQuicStream(*cryptoStream, std::move(content.data));
   }
@@ -289,6 +390,10 @@ void ServerHandshake::processPendingEvents() {
     if (!waitForData_) {
       switch (state_.readRecordLayer()->getEncryptionLevel()) {
         case fizz::EncryptionLevel::Plaintext:
+          if (cryptoExecutor_ && !initialReadBuf_.empty()) {
+            offloadInitialData();
+            return;
+          }
           actions = machine_.processSocketData(state_, initialReadBuf_);
           break;
         case fizz::EncryptionLevel::Handshake:
@@ -313,6 +418,43 @@ void ServerHandshake::processPendingEvents() {
   }
 }
 
+void ServerHandshake::offloadInitialData() {
+  DCHECK(actionGuard_);
+  offloaded_ = true;
+  // Only the read record layer and initialReadBuf_ are touched by the crypto
+  // executor: the state is only changed by the MutateState actions, which are
+  // applied once back on executor_. actionGuard_ keeps this alive until then.
+  folly::via(
+      cryptoExecutor_,
+      [this]() -> folly::Future<fizz::server::Actions> {
+        auto actions = machine_.processSocketData(state_, initialReadBuf_);
+        return folly::variant_match(
+            actions,
+            [](folly::Future<fizz::server::Actions>& futureActions) {
+              return std::move(futureActions);
+            },
+            [](fizz::server::Actions& immediateActions) {
+              return folly::makeFuture(std::move(immediateActions));
+            });
+      })
+      .via(executor_)
+      .then(&ServerHandshake::processOffloadedActions, this);
+}
+
+void ServerHandshake::processOffloadedActions(
+    fizz::server::ServerStateMachine::CompletedActions actions) {
+  folly::DelayedDestruction::DestructorGuard dg(this);
+  offloaded_ = false;
+  processActions(std::move(actions));
+  if (!offloaded_ && !offloadedInitialReadBuf_.empty()) {
+    // This data came in while the actions were being made, so they may have
+    // asked to wait for it.
+    waitForData_ = false;
+    initialReadBuf_.append(offloadedInitialReadBuf_.move());
+    processPendingEvents();
+  }
+}
+
 ServerHandshake::ActionMoveVisitor::ActionMoveVisitor(ServerHandshake& server)
     : server_(server) {}
 
@@ -399,7 +541,7 @@ void ServerHandshake::ActionMoveVisitor::operator()(
       kQuicKeyLabel,
       kQuicIVLabel);
   auto headerCipher = server_.cryptoFactory_->makePacketNumberCipher(
-      folly::range(secretAvailable.secret.secret));
+      *server_.state_.cipher(), folly::range(secretAvailable.secret.secret));
   folly::variant_match(
       secretAvailable.secret.type,
       [&](fizz::EarlySecrets earlySecrets) {
@@ -425,14 +567,28 @@ void ServerHandshake::ActionMoveVisitor::operator()(
         }
       },
       [&](fizz::AppTrafficSecrets appSecrets) {
+        if (server_.retainOneRttSecrets_ && !server_.oneRttSecrets_) {
+          server_.oneRttSecrets_ = OneRttSecrets();
+          server_.oneRttSecrets_->cipher = *server_.state_.cipher();
+        }
         switch (appSecrets) {
           case fizz::AppTrafficSecrets::ClientAppTraffic:
             server_.oneRttReadCipher_ = FizzAead::wrap(std::move(aead));
             server_.oneRttReadHeaderCipher_ = std::move(headerCipher);
+            server_.oneRttReadSecret_ = secretAvailable.secret.secret;
+            if (server_.oneRttSecrets_) {
+              server_.oneRttSecrets_->clientSecret =
+                  secretAvailable.secret.secret;
+            }
             break;
           case fizz::AppTrafficSecrets::ServerAppTraffic:
             server_.oneRttWriteCipher_ = FizzAead::wrap(std::move(aead));
             server_.oneRttWriteHeaderCipher_ = std::move(headerCipher);
+            server_.oneRttWriteSecret_ = secretAvailable.secret.secret;
+            if (server_.oneRttSecrets_) {
+              server_.oneRttSecrets_->serverSecret =
+                  secretAvailable.secret.secret;
+            }
             break;
         }
       },
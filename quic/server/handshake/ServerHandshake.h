@@ -18,9 +18,11 @@
 
 #include <quic/QuicConstants.h>
 #include <quic/QuicException.h>
-#include <quic/handshake/CryptoFactory.h>
+#include <quic/handshake/FizzCryptoFactory.h>
 #include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/OneRttKeyUpdater.h>
 #include <quic/server/handshake/AppToken.h>
+#include <quic/server/handshake/CertificateMessageCache.h>
 #include <quic/server/handshake/ServerTransportParametersExtension.h>
 #include <quic/state/StateData.h>
 
@@ -69,6 +71,13 @@ class ServerHandshake : public Handshake {
    */
   enum class Phase { Handshake, KeysDerived, Established };
 
+  // The 1-rtt traffic secrets of the connection and their cipher suite.
+  struct OneRttSecrets {
+    fizz::CipherSuite cipher{fizz::CipherSuite::TLS_AES_128_GCM_SHA256};
+    std::vector<uint8_t> clientSecret;
+    std::vector<uint8_t> serverSecret;
+  };
+
   explicit ServerHandshake(QuicCryptoState& cryptoState);
 
   /**
@@ -102,6 +111,63 @@ class ServerHandshake : public Handshake {
    */
   virtual void writeNewSessionTicket(const AppToken& appToken);
 
+  /**
+   * Runs the processing of the ClientHello, which generates the key share,
+   * derives the handshake secrets and signs the certificate verify, on the
+   * given executor instead of the one given to initialize(). The resulting
+   * actions are applied back on the initialize() executor, and crypto data
+   * that arrives meanwhile is queued until then. The executor must outlive the
+   * handshake. Must be called before accept().
+   */
+  void setCryptoExecutor(folly::Executor* cryptoExecutor);
+
+  /**
+   * Makes the packet protection of the connection with the given factory
+   * instead of a FizzCryptoFactory of its own, for instance to hand the
+   * Aeads to the inline crypto of the NIC. Must be called before
+   * initialize().
+   */
+  void setCryptoFactory(std::shared_ptr<FizzCryptoFactory> cryptoFactory);
+
+  /**
+   * Negotiates the compression of the Certificate message with these
+   * algorithms, unless the context already has algorithms of its own. The
+   * certificates of the context must be able to compress with them. Must be
+   * called before initialize().
+   */
+  void setCertificateCompressionAlgorithms(
+      std::vector<fizz::CertificateCompressionAlgorithm> algorithms);
+
+  /**
+   * Shares the Certificate message of the handshake flight with the other
+   * handshakes that use the cache, see CertificateMessageCache.
+   */
+  void setCertificateMessageCache(
+      std::shared_ptr<CertificateMessageCache> certificateMessageCache);
+
+  /**
+   * Keeps a copy of the 1-rtt traffic secrets when they are derived, so that
+   * the connection can be handed over to another process. Off by default, so
+   * that the secrets don't outlive the ciphers made from them.
+   */
+  void setRetainOneRttSecrets(bool retain);
+
+  /**
+   * Returns the 1-rtt secrets if they were retained and have been derived.
+   */
+  const folly::Optional<OneRttSecrets>& getOneRttSecrets() const;
+
+  /**
+   * Puts the handshake straight in the established phase with the 1-rtt keys
+   * derived from the given secrets, for a connection whose handshake was done
+   * by another process. The ciphers are then returned by the edge triggered
+   * getters as usual. Must be called after initialize() and instead of
+   * accept().
+   */
+  void adoptOneRttSecrets(
+      const OneRttSecrets& secrets,
+      folly::Optional<std::string> alpn);
+
   /**
    * An edge triggered API to get the handshakeWriteCipher. Once you receive the
    * write cipher subsequent calls will return null.
@@ -144,6 +210,13 @@ class ServerHandshake : public Handshake {
    */
   std::unique_ptr<PacketNumberCipher> getOneRttWriteHeaderCipher();
 
+  /**
+   * An edge triggered API to get the updater of the 1-rtt keys, available
+   * once both 1-rtt secrets are derived. Once you receive the updater
+   * subsequent calls will return null.
+   */
+  std::unique_ptr<OneRttKeyUpdater> getOneRttKeyUpdater();
+
   /**
    * An edge triggered API to get the handshake rtt read header cpher. Once you
    * receive the header cipher subsequent calls will return null.
@@ -245,10 +318,26 @@ class ServerHandshake : public Handshake {
    */
   void processPendingEvents();
 
+  /**
+   * Processes the initial crypto data on the crypto executor. actionGuard_
+   * must be held.
+   */
+  void offloadInitialData();
+
+  /**
+   * Back on the executor once the offloaded processing is done.
+   */
+  void processOffloadedActions(
+      fizz::server::ServerStateMachine::CompletedActions actions);
+
   fizz::server::State state_;
   fizz::server::ServerStateMachine machine_;
   folly::Optional<folly::DelayedDestruction::DestructorGuard> actionGuard_;
   folly::Executor* executor_;
+  folly::Executor* cryptoExecutor_{nullptr};
+  // Whether initialReadBuf_ is being read by the crypto executor, in which case
+  // new initial data goes to offloadedInitialReadBuf_.
+  bool offloaded_{false};
   std::shared_ptr<const fizz::server::FizzServerContext> context_;
   using PendingEvent = fizz::WriteNewSessionTicket;
   std::deque<PendingEvent> pendingEvents_;
@@ -261,6 +350,8 @@ class ServerHandshake : public Handshake {
   folly::IOBufQueue initialReadBuf_{folly::IOBufQueue::cacheChainLength()};
   folly::IOBufQueue handshakeReadBuf_{folly::IOBufQueue::cacheChainLength()};
   folly::IOBufQueue appDataReadBuf_{folly::IOBufQueue::cacheChainLength()};
+  folly::IOBufQueue offloadedInitialReadBuf_{
+      folly::IOBufQueue::cacheChainLength()};
 
   HandshakeCallback* callback_{nullptr};
   folly::Optional<std::pair<std::string, TransportErrorCode>> error_;
@@ -280,10 +371,18 @@ class ServerHandshake : public Handshake {
   bool inHandshakeStack_{false};
   bool handshakeDone_{false};
   bool handshakeEventAvailable_{false};
+  bool retainOneRttSecrets_{false};
+  folly::Optional<OneRttSecrets> oneRttSecrets_;
+  // Kept until the key updater is made from them.
+  std::vector<uint8_t> oneRttReadSecret_;
+  std::vector<uint8_t> oneRttWriteSecret_;
 
   Phase phase_{Phase::Handshake};
 
-  std::shared_ptr<CryptoFactory> cryptoFactory_;
+  std::shared_ptr<FizzCryptoFactory> cryptoFactory_;
   std::shared_ptr<ServerTransportParametersExtension> transportParams_;
+  std::shared_ptr<CertificateMessageCache> certificateMessageCache_;
+  std::vector<fizz::CertificateCompressionAlgorithm>
+      certificateCompressionAlgorithms_;
 }; // namespace quic
 } // namespace quic
@@ -12,8 +12,168 @@
 #include <quic/handshake/FizzTransportParameters.h>
 #include <quic/server/handshake/StatelessResetGenerator.h>
 
+#include <memory>
+#include <string>
+
 namespace quic {
 
+/**
+ * The transport parameters of the server that only depend on the transport
+ * settings, encoded once and shared by the handshakes of a worker, so that a
+ * handshake only encodes its stateless reset token and original connection
+ * id. They are encoded again when the settings of a handshake differ from
+ * the ones of the last encoding. Used from the thread of the worker.
+ */
+class ServerTransportParametersCache {
+ public:
+  struct Settings {
+    uint64_t initialMaxData;
+    uint64_t initialMaxStreamDataBidiLocal;
+    uint64_t initialMaxStreamDataBidiRemote;
+    uint64_t initialMaxStreamDataUni;
+    uint64_t initialMaxStreamsBidi;
+    uint64_t initialMaxStreamsUni;
+    std::chrono::milliseconds idleTimeout;
+    uint64_t ackDelayExponent;
+    uint64_t maxRecvPacketSize;
+    TransportPartialReliabilitySetting partialReliability;
+    folly::Optional<std::chrono::microseconds> minAckDelay;
+    uint16_t maxDatagramFrameSize;
+    folly::Optional<std::chrono::milliseconds> maxAckDelay;
+
+    bool operator==(const Settings& other) const {
+      return initialMaxData == other.initialMaxData &&
+          initialMaxStreamDataBidiLocal ==
+          other.initialMaxStreamDataBidiLocal &&
+          initialMaxStreamDataBidiRemote ==
+          other.initialMaxStreamDataBidiRemote &&
+          initialMaxStreamDataUni == other.initialMaxStreamDataUni &&
+          initialMaxStreamsBidi == other.initialMaxStreamsBidi &&
+          initialMaxStreamsUni == other.initialMaxStreamsUni &&
+          idleTimeout == other.idleTimeout &&
+          ackDelayExponent == other.ackDelayExponent &&
+          maxRecvPacketSize == other.maxRecvPacketSize &&
+          partialReliability == other.partialReliability &&
+          minAckDelay == other.minAckDelay &&
+          maxDatagramFrameSize == other.maxDatagramFrameSize &&
+          maxAckDelay == other.maxAckDelay;
+    }
+  };
+
+  /**
+   * The encoded parameters, in the order they are written: the ones before
+   * the stateless reset token and the ones after the original connection id.
+   */
+  struct EncodedParameters {
+    std::string beforeToken;
+    std::string afterConnId;
+  };
+
+  static EncodedParameters encode(const Settings& settings) {
+    EncodedParameters encoded;
+    auto append = [](std::string& out, const TransportParameter& param) {
+      auto buf = folly::IOBuf::create(fizz::detail::getSize(param));
+      folly::io::Appender appender(buf.get(), 0);
+      fizz::detail::write(param, appender);
+      out.append(reinterpret_cast<const char*>(buf->data()), buf->length());
+    };
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_stream_data_bidi_local,
+            settings.initialMaxStreamDataBidiLocal));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_stream_data_bidi_remote,
+            settings.initialMaxStreamDataBidiRemote));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_stream_data_uni,
+            settings.initialMaxStreamDataUni));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_data, settings.initialMaxData));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_streams_bidi,
+            settings.initialMaxStreamsBidi));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::initial_max_streams_uni,
+            settings.initialMaxStreamsUni));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::idle_timeout, settings.idleTimeout.count()));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::ack_delay_exponent,
+            settings.ackDelayExponent));
+    append(
+        encoded.beforeToken,
+        encodeIntegerParameter(
+            TransportParameterId::max_packet_size,
+            settings.maxRecvPacketSize));
+
+    uint64_t partialReliabilitySetting = 0;
+    if (settings.partialReliability) {
+      partialReliabilitySetting = 1;
+    }
+    append(
+        encoded.afterConnId,
+        encodeIntegerParameter(
+            static_cast<TransportParameterId>(kPartialReliabilityParameterId),
+            partialReliabilitySetting));
+    if (settings.minAckDelay) {
+      append(
+          encoded.afterConnId,
+          encodeIntegerParameter(
+              static_cast<TransportParameterId>(kMinAckDelayParameterId),
+              settings.minAckDelay->count()));
+    }
+    if (settings.maxDatagramFrameSize > 0) {
+      append(
+          encoded.afterConnId,
+          encodeIntegerParameter(
+              static_cast<TransportParameterId>(
+                  kMaxDatagramFrameSizeParameterId),
+              settings.maxDatagramFrameSize));
+    }
+    if (settings.maxAckDelay) {
+      append(
+          encoded.afterConnId,
+          encodeIntegerParameter(
+              TransportParameterId::max_ack_delay,
+              settings.maxAckDelay->count()));
+    }
+    return encoded;
+  }
+
+  const EncodedParameters& get(const Settings& settings) {
+    if (!settings_ || !(*settings_ == settings)) {
+      encoded_ = encode(settings);
+      settings_ = settings;
+      ++numEncodings_;
+    }
+    return encoded_;
+  }
+
+  uint64_t numEncodings() const {
+    return numEncodings_;
+  }
+
+ private:
+  folly::Optional<Settings> settings_;
+  EncodedParameters encoded_;
+  uint64_t numEncodings_{0};
+};
+
 class ServerTransportParametersExtension : public fizz::ServerExtensions {
  public:
   ServerTransportParametersExtension(
@@ -29,20 +189,30 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
       uint64_t ackDelayExponent,
       uint64_t maxRecvPacketSize,
       TransportPartialReliabilitySetting partialReliability,
-      const StatelessResetToken& token)
+      const StatelessResetToken& token,
+      folly::Optional<ConnectionId> originalConnId = folly::none,
+      folly::Optional<std::chrono::microseconds> minAckDelay = folly::none,
+      uint16_t maxDatagramFrameSize = 0,
+      std::shared_ptr<ServerTransportParametersCache> cache = nullptr,
+      folly::Optional<std::chrono::milliseconds> maxAckDelay = folly::none)
       : negotiatedVersion_(negotiatedVersion),
         supportedVersions_(supportedVersions),
-        initialMaxData_(initialMaxData),
-        initialMaxStreamDataBidiLocal_(initialMaxStreamDataBidiLocal),
-        initialMaxStreamDataBidiRemote_(initialMaxStreamDataBidiRemote),
-        initialMaxStreamDataUni_(initialMaxStreamDataUni),
-        initialMaxStreamsBidi_(initialMaxStreamsBidi),
-        initialMaxStreamsUni_(initialMaxStreamsUni),
-        idleTimeout_(idleTimeout),
-        ackDelayExponent_(ackDelayExponent),
-        maxRecvPacketSize_(maxRecvPacketSize),
-        partialReliability_(partialReliability),
-        token_(token) {}
+        settings_{initialMaxData,
+                  initialMaxStreamDataBidiLocal,
+                  initialMaxStreamDataBidiRemote,
+                  initialMaxStreamDataUni,
+                  initialMaxStreamsBidi,
+                  initialMaxStreamsUni,
+                  idleTimeout,
+                  ackDelayExponent,
+                  maxRecvPacketSize,
+                  partialReliability,
+                  minAckDelay,
+                  maxDatagramFrameSize,
+                  maxAckDelay},
+        token_(token),
+        originalConnId_(std::move(originalConnId)),
+        cache_(std::move(cache)) {}
 
   ~ServerTransportParametersExtension() override = default;
 
@@ -61,47 +231,53 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
       negotiatedVersion_ = folly::none;
     }
 
-    std::vector<fizz::Extension> exts;
-
-    ServerTransportParameters params;
-    params.negotiated_version = negotiatedVersion_;
-    params.supported_versions = supportedVersions_;
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_bidi_local,
-        initialMaxStreamDataBidiLocal_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_bidi_remote,
-        initialMaxStreamDataBidiRemote_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_stream_data_uni,
-        initialMaxStreamDataUni_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_data, initialMaxData_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_streams_bidi,
-        initialMaxStreamsBidi_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::initial_max_streams_uni, initialMaxStreamsUni_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::idle_timeout, idleTimeout_.count()));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::ack_delay_exponent, ackDelayExponent_));
-    params.parameters.push_back(encodeIntegerParameter(
-        TransportParameterId::max_packet_size, maxRecvPacketSize_));
+    ServerTransportParametersCache::EncodedParameters uncached;
+    const ServerTransportParametersCache::EncodedParameters* encoded;
+    if (cache_) {
+      encoded = &cache_->get(settings_);
+    } else {
+      uncached = ServerTransportParametersCache::encode(settings_);
+      encoded = &uncached;
+    }
     TransportParameter statelessReset;
     statelessReset.parameter = TransportParameterId::stateless_reset_token;
     statelessReset.value = folly::IOBuf::copyBuffer(token_);
-    params.parameters.push_back(std::move(statelessReset));
+    folly::Optional<TransportParameter> originalConnId;
+    if (originalConnId_) {
+      originalConnId.emplace();
+      originalConnId->parameter = TransportParameterId::original_connection_id;
+      originalConnId->value = folly::IOBuf::copyBuffer(
+          originalConnId_->data(), originalConnId_->size());
+    }
+    size_t parametersLen = encoded->beforeToken.size() +
+        fizz::detail::getSize(statelessReset) +
+        (originalConnId ? fizz::detail::getSize(*originalConnId) : 0) +
+        encoded->afterConnId.size();
 
-    uint64_t partialReliabilitySetting = 0;
-    if (partialReliability_) {
-      partialReliabilitySetting = 1;
+    // Same as encodeExtension() of ServerTransportParameters.
+    fizz::Extension ext;
+    ext.extension_type = fizz::ExtensionType::quic_transport_parameters;
+    ext.extension_data = folly::IOBuf::create(0);
+    folly::io::Appender appender(
+        ext.extension_data.get(), parametersLen + 40);
+    if (negotiatedVersion_) {
+      fizz::detail::write(negotiatedVersion_.value(), appender);
+      fizz::detail::writeVector<uint8_t>(supportedVersions_, appender);
     }
-    params.parameters.push_back(encodeIntegerParameter(
-        static_cast<TransportParameterId>(kPartialReliabilityParameterId),
-        partialReliabilitySetting));
+    fizz::detail::write(static_cast<uint16_t>(parametersLen), appender);
+    appender.push(
+        reinterpret_cast<const uint8_t*>(encoded->beforeToken.data()),
+        encoded->beforeToken.size());
+    fizz::detail::write(statelessReset, appender);
+    if (originalConnId) {
+      fizz::detail::write(*originalConnId, appender);
+    }
+    appender.push(
+        reinterpret_cast<const uint8_t*>(encoded->afterConnId.data()),
+        encoded->afterConnId.size());
 
-    exts.push_back(encodeExtension(params));
+    std::vector<fizz::Extension> exts;
+    exts.push_back(std::move(ext));
     return exts;
   }
 
@@ -112,17 +288,10 @@ class ServerTransportParametersExtension : public fizz::ServerExtensions {
  private:
   folly::Optional<QuicVersion> negotiatedVersion_;
   std::vector<QuicVersion> supportedVersions_;
-  uint64_t initialMaxData_;
-  uint64_t initialMaxStreamDataBidiLocal_;
-  uint64_t initialMaxStreamDataBidiRemote_;
-  uint64_t initialMaxStreamDataUni_;
-  uint64_t initialMaxStreamsBidi_;
-  uint64_t initialMaxStreamsUni_;
-  std::chrono::milliseconds idleTimeout_;
-  uint64_t ackDelayExponent_;
-  uint64_t maxRecvPacketSize_;
-  TransportPartialReliabilitySetting partialReliability_;
+  ServerTransportParametersCache::Settings settings_;
   folly::Optional<ClientTransportParameters> clientTransportParameters_;
   StatelessResetToken token_;
+  folly::Optional<ConnectionId> originalConnId_;
+  std::shared_ptr<ServerTransportParametersCache> cache_;
 };
 } // namespace quic
@@ -12,21 +12,36 @@
 
 namespace {
 constexpr folly::StringPiece kSalt{"Stateless reset"};
-}
+constexpr folly::StringPiece kAesKeyLabel{"aes"};
+constexpr size_t kAesBlockSize = 16;
+} // namespace
 
 namespace quic {
 
 StatelessResetGenerator::StatelessResetGenerator(
     StatelessResetSecret secret,
-    const std::string& addressStr)
+    const std::string& addressStr,
+    Algorithm algorithm)
     : secret_(std::move(secret)),
       addressStr_(std::move(addressStr)),
-      hkdf_(fizz::HkdfImpl::create<fizz::Sha256>()) {
+      hkdf_(fizz::HkdfImpl::create<fizz::Sha256>()),
+      algorithm_(algorithm) {
   extractedSecret_ = hkdf_.extract(kSalt, folly::range(secret));
+  if (algorithm_ == Algorithm::AES) {
+    auto info = folly::IOBuf::copyBuffer(kAesKeyLabel);
+    info->prependChain(
+        folly::IOBuf::wrapBuffer(addressStr_.data(), addressStr_.size()));
+    auto key =
+        hkdf_.expand(folly::range(extractedSecret_), *info, aes_.keyLength());
+    aes_.setKey(key->coalesce());
+  }
 }
 
 StatelessResetToken StatelessResetGenerator::generateToken(
     const ConnectionId& connId) const {
+  if (algorithm_ == Algorithm::AES) {
+    return generateAesToken(connId);
+  }
   StatelessResetToken token;
   auto info = toData(connId);
   info.prependChain(
@@ -37,4 +52,24 @@ StatelessResetToken StatelessResetGenerator::generateToken(
   return token;
 }
 
+StatelessResetToken StatelessResetGenerator::generateAesToken(
+    const ConnectionId& connId) const {
+  static_assert(
+      kMaxConnectionIdSize + 1 <= 2 * kAesBlockSize,
+      "a length prefixed ConnectionId fits in two blocks");
+  static_assert(
+      sizeof(StatelessResetToken) == kAesBlockSize, "a token is one block");
+  std::array<uint8_t, 2 * kAesBlockSize> blocks{};
+  blocks[0] = connId.size();
+  memcpy(blocks.data() + 1, connId.data(), connId.size());
+  auto mac = aes_.mask(folly::range(blocks.data(), kAesBlockSize));
+  for (size_t i = 0; i < kAesBlockSize; ++i) {
+    mac[i] ^= blocks[kAesBlockSize + i];
+  }
+  mac = aes_.mask(folly::range(mac));
+  StatelessResetToken token;
+  memcpy(token.data(), mac.data(), token.size());
+  return token;
+}
+
 } // namespace quic
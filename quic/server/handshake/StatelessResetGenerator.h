@@ -11,6 +11,7 @@
 #include <fizz/crypto/Hkdf.h>
 #include <fizz/crypto/Sha256.h>
 #include <quic/codec/Types.h>
+#include <quic/handshake/FizzPacketNumberCipher.h>
 
 namespace quic {
 
@@ -31,19 +32,39 @@ using StatelessResetSecret =
  * PRK = HKDF-Extract(Salt, secret)
  * appInfo = Concat(connId, addrString);
  * Token = HKDF-Expand(PRK, appInfo, tokenLength)
+ *
+ * With Algorithm::AES, the HKDF only runs once, to derive an AES-128 key for
+ * the address, and the tokens are the CBC-MAC of the length prefixed
+ * ConnectionId under that key: two AES blocks per token instead of the HMAC
+ * rounds of HKDF-Expand. The length prefix makes the CBC-MAC a PRF over the
+ * ConnectionIds of every length. Both algorithms give different tokens, so
+ * all the servers sharing a secret have to use the same one.
+ *
+ * AESKey = HKDF-Expand(PRK, Concat("aes", addrString), 16)
+ * Token = AES(AESKey, AES(AESKey, Concat(connIdLength, connId[0:15])) ^
+ *                     Pad(connId[15:]))
  */
 class StatelessResetGenerator {
  public:
+  enum class Algorithm : uint8_t { HKDF, AES };
+
   explicit StatelessResetGenerator(
       StatelessResetSecret secret,
-      const std::string& addressStr);
+      const std::string& addressStr,
+      Algorithm algorithm = Algorithm::HKDF);
 
   StatelessResetToken generateToken(const ConnectionId& connId) const;
 
  private:
+  StatelessResetToken generateAesToken(const ConnectionId& connId) const;
+
   StatelessResetSecret secret_;
   std::string addressStr_;
   fizz::HkdfImpl hkdf_;
   std::vector<uint8_t> extractedSecret_;
+  Algorithm algorithm_;
+  // Only set with Algorithm::AES. A single block ECB encryption is the AES
+  // permutation the CBC-MAC is made of.
+  Aes128PacketNumberCipher aes_;
 };
 } // namespace quic
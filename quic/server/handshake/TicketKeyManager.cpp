@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/TicketKeyManager.h>
+
+#include <stdexcept>
+#include <vector>
+
+namespace quic {
+
+TicketKeyManager::TicketKeyManager(
+    std::shared_ptr<fizz::Factory> factory,
+    std::shared_ptr<fizz::server::CertManager> certManager,
+    std::chrono::seconds ticketLifetime)
+    : factory_(std::move(factory)),
+      certManager_(std::move(certManager)),
+      ticketLifetime_(ticketLifetime) {
+  if (ticketLifetime_.count() <= 0) {
+    throw std::invalid_argument("Ticket lifetime must be positive");
+  }
+}
+
+folly::Future<folly::Optional<
+    std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+TicketKeyManager::encrypt(fizz::server::ResumptionState resState) const {
+  auto cipher = cipher_.load();
+  if (!cipher) {
+    return folly::none;
+  }
+  return cipher->encrypt(std::move(resState));
+}
+
+folly::Future<
+    std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+TicketKeyManager::decrypt(
+    std::unique_ptr<folly::IOBuf> encryptedTicket,
+    const fizz::server::State* state) const {
+  auto cipher = cipher_.load();
+  if (!cipher) {
+    return std::make_pair(fizz::PskType::Rejected, folly::none);
+  }
+  return cipher->decrypt(std::move(encryptedTicket), state);
+}
+
+void TicketKeyManager::rotate(std::string secret, TimePoint now) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  // Works on a copy so that a secret that is too short changes nothing.
+  auto secrets = secrets_;
+  if (!secrets.empty()) {
+    secrets.front().replacedAt = now;
+  }
+  secrets.push_front(Secret{std::move(secret), folly::none});
+  while (secrets.back().replacedAt &&
+         now - *secrets.back().replacedAt >= ticketLifetime_) {
+    secrets.pop_back();
+  }
+  std::vector<folly::ByteRange> ranges;
+  ranges.reserve(secrets.size());
+  for (const auto& s : secrets) {
+    ranges.push_back(folly::StringPiece(s.secret));
+  }
+  auto cipher = std::make_shared<Cipher>(factory_, certManager_);
+  cipher->setValidity(ticketLifetime_);
+  // The first secret encrypts, all of them decrypt.
+  if (!cipher->setTicketSecrets(std::move(ranges))) {
+    throw std::invalid_argument("Ticket secret is too short");
+  }
+  secrets_ = std::move(secrets);
+  cipher_.store(std::move(cipher));
+}
+
+size_t TicketKeyManager::getNumSecrets() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return secrets_.size();
+}
+} // namespace quic
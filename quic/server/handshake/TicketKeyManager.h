@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+
+#include <fizz/server/AeadTicketCipher.h>
+#include <folly/concurrency/AtomicSharedPtr.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace quic {
+
+/**
+ * A ticket cipher to share between the FizzServerContexts of all the workers
+ * of a QuicServer, and between the servers that resume each other's
+ * sessions, so that the keys are the same wherever a ticket comes back.
+ *
+ * rotate() makes a secret the one new tickets are encrypted with. The secret
+ * it replaces still decrypts for the lifetime of the tickets, so tickets
+ * issued right before a rotation keep resuming, and with them 0-RTT. Each
+ * rotation publishes a new cipher that encryption and decryption load
+ * atomically, without a lock: the handshakes of the workers never wait for
+ * a rotation, and a rotation never mutates a cipher that is in use.
+ *
+ * Before the first rotation no tickets are issued and all are rejected.
+ *
+ * Rotate at least once per ticket lifetime, the secrets that were replaced
+ * more than a lifetime ago are dropped on rotations.
+ */
+class TicketKeyManager : public fizz::server::TicketCipher {
+ public:
+  TicketKeyManager(
+      std::shared_ptr<fizz::Factory> factory,
+      std::shared_ptr<fizz::server::CertManager> certManager,
+      std::chrono::seconds ticketLifetime = kDefaultTicketLifetime);
+
+  ~TicketKeyManager() override = default;
+
+  folly::Future<folly::Optional<
+      std::pair<std::unique_ptr<folly::IOBuf>, std::chrono::seconds>>>
+  encrypt(fizz::server::ResumptionState resState) const override;
+
+  folly::Future<
+      std::pair<fizz::PskType, folly::Optional<fizz::server::ResumptionState>>>
+  decrypt(
+      std::unique_ptr<folly::IOBuf> encryptedTicket,
+      const fizz::server::State* state = nullptr) const override;
+
+  /**
+   * Encrypts the new tickets with secret, which has to be at least
+   * fizz::server::kMinTicketSecretLength bytes long. Safe to call from any
+   * thread.
+   */
+  void rotate(std::string secret, TimePoint now = Clock::now());
+
+  /**
+   * The secrets that decrypt, the current one included.
+   */
+  size_t getNumSecrets() const;
+
+ private:
+  struct Secret {
+    std::string secret;
+    // When the next secret replaced this one.
+    folly::Optional<TimePoint> replacedAt;
+  };
+
+  using Cipher = fizz::server::Aead128GCMTicketCipher;
+
+  std::shared_ptr<fizz::Factory> factory_;
+  std::shared_ptr<fizz::server::CertManager> certManager_;
+  std::chrono::seconds ticketLifetime_;
+  // The current secret first.
+  std::deque<Secret> secrets_;
+  mutable std::mutex mutex_;
+  folly::atomic_shared_ptr<const Cipher> cipher_;
+};
+} // namespace quic
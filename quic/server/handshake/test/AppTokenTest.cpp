@@ -250,5 +250,145 @@ TEST(AppTokenTest, TestEncodeAndDecodeIPv6AndIPv4AddressesWithAppToken) {
   expectAppTokenEqual(decodeAppToken(*buf), appToken);
 }
 
+TEST(AppTokenTest, TestEncodeAndDecodeCongestionState) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.4")};
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("QPACK Params");
+  TicketCongestionState congestionState;
+  congestionState.srtt = 30ms;
+  congestionState.minRtt = 20ms;
+  congestionState.bandwidth = 1000000;
+  congestionState.timestamp = std::chrono::seconds(1234567);
+  appToken.congestionState = congestionState;
+  Buf buf = encodeAppToken(appToken);
+
+  auto decodedAppToken = decodeAppToken(*buf);
+  expectAppTokenEqual(decodedAppToken, appToken);
+  ASSERT_TRUE(decodedAppToken->congestionState.hasValue());
+  EXPECT_EQ(30ms, decodedAppToken->congestionState->srtt);
+  EXPECT_EQ(20ms, decodedAppToken->congestionState->minRtt);
+  EXPECT_EQ(1000000, decodedAppToken->congestionState->bandwidth);
+  EXPECT_EQ(
+      std::chrono::seconds(1234567),
+      decodedAppToken->congestionState->timestamp);
+}
+
+TEST(AppTokenTest, TestEncodeAndDecodeCompact) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize + 1,
+      kDefaultStreamWindowSize + 2,
+      kDefaultStreamWindowSize + 3,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max() - 1);
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.4"),
+                              folly::IPAddress("::1")};
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("QPACK Params");
+  TicketCongestionState congestionState;
+  congestionState.srtt = 30ms;
+  congestionState.minRtt = 20ms;
+  congestionState.bandwidth = 1000000;
+  congestionState.timestamp = std::chrono::seconds(1234567);
+  appToken.congestionState = congestionState;
+  appToken.compact = true;
+  Buf buf = encodeAppToken(appToken);
+
+  EXPECT_FALSE(decodeAppToken(*buf).hasValue());
+  auto decoded = decodeAppTokenValues(*buf);
+  ASSERT_TRUE(decoded.hasValue());
+  EXPECT_EQ(kDefaultIdleTimeout.count(), decoded->transportParams.idleTimeout);
+  EXPECT_EQ(
+      kDefaultUDPReadBufferSize, decoded->transportParams.maxRecvPacketSize);
+  EXPECT_EQ(
+      kDefaultConnectionWindowSize, decoded->transportParams.initialMaxData);
+  EXPECT_EQ(
+      kDefaultStreamWindowSize + 1,
+      decoded->transportParams.initialMaxStreamDataBidiLocal);
+  EXPECT_EQ(
+      kDefaultStreamWindowSize + 2,
+      decoded->transportParams.initialMaxStreamDataBidiRemote);
+  EXPECT_EQ(
+      kDefaultStreamWindowSize + 3,
+      decoded->transportParams.initialMaxStreamDataUni);
+  EXPECT_EQ(
+      std::numeric_limits<uint32_t>::max(),
+      decoded->transportParams.initialMaxStreamsBidi);
+  EXPECT_EQ(
+      std::numeric_limits<uint32_t>::max() - 1,
+      decoded->transportParams.initialMaxStreamsUni);
+  EXPECT_EQ(appToken.sourceAddresses, decoded->sourceAddresses);
+  EXPECT_EQ(QuicVersion::MVFST, decoded->version);
+  ASSERT_NE(decoded->appParams, nullptr);
+  EXPECT_TRUE(folly::IOBufEqualTo()(*decoded->appParams, *appToken.appParams));
+  ASSERT_TRUE(decoded->congestionState.hasValue());
+  EXPECT_EQ(30ms, decoded->congestionState->srtt);
+  EXPECT_EQ(20ms, decoded->congestionState->minRtt);
+  EXPECT_EQ(1000000, decoded->congestionState->bandwidth);
+  EXPECT_EQ(
+      std::chrono::seconds(1234567), decoded->congestionState->timestamp);
+}
+
+TEST(AppTokenTest, TestDecodeValuesOriginalLayout) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.sourceAddresses = {folly::IPAddress("1.2.3.4")};
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("QPACK Params");
+  Buf buf = encodeAppToken(appToken);
+
+  auto decoded = decodeAppTokenValues(*buf);
+  ASSERT_TRUE(decoded.hasValue());
+  EXPECT_EQ(
+      kDefaultConnectionWindowSize, decoded->transportParams.initialMaxData);
+  EXPECT_EQ(
+      kDefaultStreamWindowSize,
+      decoded->transportParams.initialMaxStreamDataBidiLocal);
+  EXPECT_EQ(appToken.sourceAddresses, decoded->sourceAddresses);
+  EXPECT_EQ(QuicVersion::MVFST, decoded->version);
+  EXPECT_FALSE(decoded->congestionState.hasValue());
+}
+
+TEST(AppTokenTest, TestDecodeCompactTruncated) {
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      kDefaultIdleTimeout.count(),
+      kDefaultUDPReadBufferSize,
+      kDefaultConnectionWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      kDefaultStreamWindowSize,
+      std::numeric_limits<uint32_t>::max(),
+      std::numeric_limits<uint32_t>::max());
+  appToken.version = QuicVersion::MVFST;
+  appToken.appParams = folly::IOBuf::copyBuffer("QPACK Params");
+  appToken.compact = true;
+  Buf buf = encodeAppToken(appToken);
+  buf->coalesce();
+  auto truncated = folly::IOBuf::copyBuffer(buf->data(), buf->length() - 1);
+  EXPECT_FALSE(decodeAppTokenValues(*truncated).hasValue());
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/BloomFilterReplayCache.h>
+
+#include <folly/Conv.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+using fizz::server::ReplayCacheResult;
+
+namespace quic {
+namespace test {
+
+namespace {
+folly::ByteRange range(const std::string& identifier) {
+  return folly::StringPiece(identifier);
+}
+} // namespace
+
+TEST(BloomFilterReplayCacheTest, Replay) {
+  BloomFilterReplayCache cache(1000, std::chrono::seconds(10));
+  auto now = Clock::now();
+  EXPECT_EQ(
+      cache.checkAndInsert(range("hello"), now), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("world"), now), ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("hello"), now + std::chrono::seconds(1)),
+      ReplayCacheResult::MaybeReplay);
+}
+
+TEST(BloomFilterReplayCacheTest, RemembersThePreviousWindow) {
+  std::chrono::seconds window(10);
+  BloomFilterReplayCache cache(1000, window);
+  auto now = Clock::now();
+  cache.checkAndInsert(range("hello"), now);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("hello"), now + window),
+      ReplayCacheResult::MaybeReplay);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("world"), now + window),
+      ReplayCacheResult::NotReplay);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("world"), now + 2 * window),
+      ReplayCacheResult::MaybeReplay);
+}
+
+TEST(BloomFilterReplayCacheTest, ForgetsAfterTwoWindows) {
+  std::chrono::seconds window(10);
+  BloomFilterReplayCache cache(1000, window);
+  auto now = Clock::now();
+  cache.checkAndInsert(range("hello"), now);
+  EXPECT_EQ(
+      cache.checkAndInsert(range("hello"), now + 2 * window),
+      ReplayCacheResult::NotReplay);
+}
+
+TEST(BloomFilterReplayCacheTest, Sizing) {
+  // 10000 handshakes in the window at 1% of false positives take 9.6 bits
+  // and 7 hashes each.
+  BloomFilterReplayCache cache(1000, std::chrono::seconds(10), 0.01);
+  EXPECT_GE(cache.getNumBits(), 95851);
+  EXPECT_LT(cache.getNumBits(), 95851 + 64);
+  EXPECT_EQ(cache.getNumBits() % 64, 0);
+  EXPECT_EQ(cache.getNumHashes(), 7);
+}
+
+TEST(BloomFilterReplayCacheTest, FalsePositiveRate) {
+  BloomFilterReplayCache cache(1000, std::chrono::seconds(10), 0.01);
+  auto now = Clock::now();
+  for (int i = 0; i < 10000; ++i) {
+    cache.checkAndInsert(range(folly::to<std::string>("seen", i)), now);
+  }
+  int falsePositives = 0;
+  for (int i = 0; i < 1000; ++i) {
+    if (cache.checkAndInsert(range(folly::to<std::string>("new", i)), now) ==
+        ReplayCacheResult::MaybeReplay) {
+      falsePositives++;
+    }
+  }
+  // The inserts of the new identifiers fill the filter up a bit more.
+  EXPECT_LT(falsePositives, 50);
+}
+
+TEST(BloomFilterReplayCacheTest, InvalidSettings) {
+  EXPECT_THROW(
+      BloomFilterReplayCache(1000, std::chrono::seconds(0)),
+      std::invalid_argument);
+  EXPECT_THROW(
+      BloomFilterReplayCache(1000, std::chrono::seconds(10), 1.0),
+      std::invalid_argument);
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/CertificateMessageCache.h>
+
+#include <fizz/record/Types.h>
+#include <folly/io/Cursor.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+std::string handshakeMessage(fizz::HandshakeType type, std::string body) {
+  std::string message;
+  message.push_back(static_cast<char>(type));
+  message.push_back(static_cast<char>((body.size() >> 16) & 0xff));
+  message.push_back(static_cast<char>((body.size() >> 8) & 0xff));
+  message.push_back(static_cast<char>(body.size() & 0xff));
+  return message + body;
+}
+
+std::string certificate(std::string chain) {
+  return handshakeMessage(fizz::HandshakeType::certificate, std::move(chain));
+}
+
+std::string flight(std::string certificateMessage, std::string signature) {
+  return handshakeMessage(
+             fizz::HandshakeType::encrypted_extensions, "extensions") +
+      certificateMessage +
+      handshakeMessage(
+             fizz::HandshakeType::certificate_verify, std::move(signature)) +
+      handshakeMessage(fizz::HandshakeType::finished, "finished");
+}
+
+std::string toString(const Buf& buf) {
+  folly::io::Cursor cursor(buf.get());
+  return cursor.readFixedString(buf->computeChainDataLength());
+}
+} // namespace
+
+TEST(CertificateMessageCacheTest, SharesCertificate) {
+  CertificateMessageCache cache;
+  auto cert = certificate(std::string(2000, 'c'));
+  auto flight1 = flight(cert, "signature1");
+  auto flight2 = flight(cert, "signature2");
+
+  auto shared1 = cache.share(folly::IOBuf::copyBuffer(flight1));
+  auto shared2 = cache.share(folly::IOBuf::copyBuffer(flight2));
+  EXPECT_EQ(flight1, toString(shared1));
+  EXPECT_EQ(flight2, toString(shared2));
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+
+  // The messages before the certificate, the certificate and the ones after.
+  ASSERT_EQ(3, shared1->countChainElements());
+  ASSERT_EQ(3, shared2->countChainElements());
+  EXPECT_EQ(cert.size(), shared1->next()->length());
+  EXPECT_EQ(shared1->next()->data(), shared2->next()->data());
+}
+
+TEST(CertificateMessageCacheTest, SharesCompressedCertificate) {
+  CertificateMessageCache cache;
+  auto cert = handshakeMessage(
+      fizz::HandshakeType::compressed_certificate, std::string(500, 'z'));
+  auto flight1 = flight(cert, "signature1");
+  auto flight2 = flight(cert, "signature2");
+
+  auto shared1 = cache.share(folly::IOBuf::copyBuffer(flight1));
+  auto shared2 = cache.share(folly::IOBuf::copyBuffer(flight2));
+  EXPECT_EQ(flight1, toString(shared1));
+  EXPECT_EQ(flight2, toString(shared2));
+  EXPECT_EQ(1, cache.hits());
+  ASSERT_EQ(3, shared2->countChainElements());
+  EXPECT_EQ(shared1->next()->data(), shared2->next()->data());
+}
+
+TEST(CertificateMessageCacheTest, NoCertificate) {
+  CertificateMessageCache cache;
+  auto data = handshakeMessage(
+                  fizz::HandshakeType::encrypted_extensions, "extensions") +
+      handshakeMessage(fizz::HandshakeType::finished, "finished");
+  auto buf = folly::IOBuf::copyBuffer(data);
+  auto bufPtr = buf.get();
+  auto shared = cache.share(std::move(buf));
+  EXPECT_EQ(bufPtr, shared.get());
+  EXPECT_EQ(data, toString(shared));
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(0, cache.misses());
+}
+
+TEST(CertificateMessageCacheTest, Truncated) {
+  CertificateMessageCache cache;
+  auto data = flight(certificate("chain"), "signature");
+  data.resize(data.size() - 1);
+  auto buf = folly::IOBuf::copyBuffer(data);
+  auto bufPtr = buf.get();
+  auto shared = cache.share(std::move(buf));
+  EXPECT_EQ(bufPtr, shared.get());
+  EXPECT_EQ(data, toString(shared));
+}
+
+TEST(CertificateMessageCacheTest, Full) {
+  CertificateMessageCache cache(1);
+  auto flight1 = flight(certificate("chain1"), "signature");
+  auto flight2 = flight(certificate("chain2"), "signature");
+  cache.share(folly::IOBuf::copyBuffer(flight1));
+
+  auto buf = folly::IOBuf::copyBuffer(flight2);
+  auto bufPtr = buf.get();
+  auto shared = cache.share(std::move(buf));
+  EXPECT_EQ(bufPtr, shared.get());
+  EXPECT_EQ(flight2, toString(shared));
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(2, cache.misses());
+
+  shared = cache.share(folly::IOBuf::copyBuffer(flight1));
+  EXPECT_EQ(flight1, toString(shared));
+  EXPECT_EQ(1, cache.hits());
+}
+} // namespace test
+} // namespace quic
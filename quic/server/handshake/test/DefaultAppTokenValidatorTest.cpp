@@ -50,6 +50,32 @@ TEST(DefaultAppTokenValidatorTest, TestValidParams) {
   EXPECT_TRUE(validator.validate(resState));
 }
 
+TEST(DefaultAppTokenValidatorTest, TestValidCompactParams) {
+  QuicServerConnectionState conn;
+  conn.peerAddress = folly::SocketAddress("1.2.3.4", 443);
+  conn.version = QuicVersion::MVFST;
+
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn.transportSettings.idleTimeout.count(),
+      conn.transportSettings.maxRecvPacketSize,
+      conn.transportSettings.advertisedInitialConnectionWindowSize,
+      conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn.transportSettings.advertisedInitialUniStreamWindowSize,
+      conn.transportSettings.advertisedInitialMaxStreamsBidi,
+      conn.transportSettings.advertisedInitialMaxStreamsUni);
+  appToken.version = conn.version;
+  appToken.compact = true;
+  ResumptionState resState;
+  resState.appToken = encodeAppToken(appToken);
+
+  auto appParamsValidator = [](const folly::Optional<std::string>&,
+                               const Buf&) { return true; };
+  DefaultAppTokenValidator validator(&conn, std::move(appParamsValidator));
+  EXPECT_TRUE(validator.validate(resState));
+}
+
 TEST(
     DefaultAppTokenValidatorTest,
     TestValidUnequalParamsUpdateTransportSettings) {
@@ -344,6 +370,53 @@ TEST(DefaultAppTokenValidatorTest, TestInvalidAppParams) {
   EXPECT_FALSE(validator.validate(resState));
 }
 
+TEST(DefaultAppTokenValidatorTest, TestCongestionState) {
+  QuicServerConnectionState conn;
+  conn.peerAddress = folly::SocketAddress("1.2.3.4", 443);
+  conn.version = QuicVersion::MVFST;
+
+  AppToken appToken;
+  appToken.transportParams = createTicketTransportParameters(
+      conn.transportSettings.idleTimeout.count(),
+      conn.transportSettings.maxRecvPacketSize,
+      conn.transportSettings.advertisedInitialConnectionWindowSize,
+      conn.transportSettings.advertisedInitialBidiLocalStreamWindowSize,
+      conn.transportSettings.advertisedInitialBidiRemoteStreamWindowSize,
+      conn.transportSettings.advertisedInitialUniStreamWindowSize,
+      conn.transportSettings.advertisedInitialMaxStreamsBidi,
+      conn.transportSettings.advertisedInitialMaxStreamsUni);
+  appToken.version = conn.version;
+  TicketCongestionState congestionState;
+  congestionState.srtt = 30ms;
+  congestionState.minRtt = 20ms;
+  congestionState.bandwidth = 1000000;
+  congestionState.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  appToken.congestionState = congestionState;
+  ResumptionState resState;
+  resState.appToken = encodeAppToken(appToken);
+
+  auto appParamsValidator = [](const folly::Optional<std::string>&,
+                               const Buf&) { return true; };
+  DefaultAppTokenValidator validator(&conn, std::move(appParamsValidator));
+  // Ignored unless the settings ask for it:
+  EXPECT_TRUE(validator.validate(resState));
+  EXPECT_FALSE(conn.ticketCongestionState.hasValue());
+
+  conn.transportSettings.congestionStateInTicket = true;
+  EXPECT_TRUE(validator.validate(resState));
+  ASSERT_TRUE(conn.ticketCongestionState.hasValue());
+  EXPECT_EQ(30ms, conn.ticketCongestionState->srtt);
+  EXPECT_EQ(1000000, conn.ticketCongestionState->bandwidth);
+
+  // A stale one is ignored:
+  conn.ticketCongestionState = folly::none;
+  appToken.congestionState->timestamp -= kTicketCongestionStateLifetime + 1min;
+  resState.appToken = encodeAppToken(appToken);
+  EXPECT_TRUE(validator.validate(resState));
+  EXPECT_FALSE(conn.ticketCongestionState.hasValue());
+}
+
 class SourceAddressTokenTest : public Test {
  public:
   void SetUp() override {
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/InitialCipherCache.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class InitialCipherCacheTest : public Test {
+ protected:
+  void expectSameAead(Aead& expected, Aead& actual) {
+    auto plaintext = folly::IOBuf::copyBuffer("initial packet payload");
+    auto header = folly::IOBuf::copyBuffer("header");
+    auto ciphertext = actual.encrypt(plaintext->clone(), header.get(), 7);
+    EXPECT_TRUE(folly::IOBufEqualTo()(
+        expected.encrypt(plaintext->clone(), header.get(), 7), ciphertext));
+    auto decrypted = expected.decrypt(std::move(ciphertext), header.get(), 7);
+    EXPECT_TRUE(folly::IOBufEqualTo()(plaintext, decrypted));
+  }
+
+  void expectSameHeaderCipher(
+      const PacketNumberCipher& expected,
+      const PacketNumberCipher& actual) {
+    std::array<uint8_t, 16> sample;
+    sample.fill(0x5a);
+    EXPECT_EQ(
+        expected.mask(folly::range(sample)), actual.mask(folly::range(sample)));
+  }
+
+  FizzCryptoFactory cryptoFactory_;
+  ConnectionId connId_{{0x14, 0x35, 0x22, 0x11, 0x01, 0x02, 0x03, 0x04}};
+};
+
+TEST_F(InitialCipherCacheTest, SameAsCryptoFactory) {
+  InitialCipherCache cache;
+  for (auto version : {QuicVersion::MVFST, QuicVersion::QUIC_DRAFT}) {
+    expectSameAead(
+        *cryptoFactory_.getClientInitialCipher(connId_, version),
+        *cache.getClientInitialCipher(connId_, version));
+    expectSameAead(
+        *cryptoFactory_.getServerInitialCipher(connId_, version),
+        *cache.getServerInitialCipher(connId_, version));
+    expectSameHeaderCipher(
+        *cryptoFactory_.makeClientInitialHeaderCipher(connId_, version),
+        *cache.makeClientInitialHeaderCipher(connId_, version));
+    expectSameHeaderCipher(
+        *cryptoFactory_.makeServerInitialHeaderCipher(connId_, version),
+        *cache.makeServerInitialHeaderCipher(connId_, version));
+  }
+  // The versions use different salts, so they get an entry each, derived
+  // once.
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_EQ(6, cache.hits());
+}
+
+TEST_F(InitialCipherCacheTest, CiphersAreNotShared) {
+  InitialCipherCache cache;
+  auto aead = cache.getServerInitialCipher(connId_, QuicVersion::MVFST);
+  auto otherAead = cache.getServerInitialCipher(connId_, QuicVersion::MVFST);
+  EXPECT_NE(aead.get(), otherAead.get());
+  expectSameAead(*aead, *otherAead);
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_EQ(1, cache.hits());
+}
+
+TEST_F(InitialCipherCacheTest, Bounded) {
+  InitialCipherCache cache(2);
+  ConnectionId connId1({0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08});
+  ConnectionId connId2({0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18});
+  cache.getServerInitialCipher(connId_, QuicVersion::MVFST);
+  cache.getServerInitialCipher(connId1, QuicVersion::MVFST);
+  cache.getServerInitialCipher(connId_, QuicVersion::MVFST);
+  // Evicts connId1, the least recently used.
+  cache.getServerInitialCipher(connId2, QuicVersion::MVFST);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(3, cache.misses());
+  cache.getServerInitialCipher(connId_, QuicVersion::MVFST);
+  EXPECT_EQ(3, cache.misses());
+  cache.getServerInitialCipher(connId1, QuicVersion::MVFST);
+  EXPECT_EQ(4, cache.misses());
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/RetryTokenGenerator.h>
+#include <folly/Random.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class RetryTokenGeneratorTest : public Test {
+ public:
+  void SetUp() override {
+    folly::Random::secureRandom(secret_.data(), secret_.size());
+  }
+
+ protected:
+  RetryTokenSecret secret_;
+  ConnectionId connId_{{0x14, 0x35, 0x22, 0x11, 0x01, 0x02, 0x03, 0x04}};
+  folly::SocketAddress clientAddr_{"1.2.3.4", 8080};
+  std::chrono::seconds lifetime_{10};
+};
+
+TEST_F(RetryTokenGeneratorTest, Validate) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientAddr_);
+  auto originalConnId = generator.validateToken(token, clientAddr_, lifetime_);
+  ASSERT_TRUE(originalConnId.hasValue());
+  EXPECT_EQ(connId_, *originalConnId);
+
+  // Another generator with the same secret, e.g. on another worker, accepts
+  // the token, also from another port of the client.
+  RetryTokenGenerator otherGenerator(secret_);
+  EXPECT_EQ(
+      connId_,
+      otherGenerator.validateToken(
+          token, folly::SocketAddress("1.2.3.4", 9090), lifetime_));
+}
+
+TEST_F(RetryTokenGeneratorTest, DifferentAddress) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientAddr_);
+  EXPECT_FALSE(generator
+                   .validateToken(
+                       token, folly::SocketAddress("1.2.3.5", 8080), lifetime_)
+                   .hasValue());
+}
+
+TEST_F(RetryTokenGeneratorTest, DifferentSecret) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientAddr_);
+  RetryTokenSecret otherSecret;
+  folly::Random::secureRandom(otherSecret.data(), otherSecret.size());
+  RetryTokenGenerator otherGenerator(otherSecret);
+  EXPECT_FALSE(
+      otherGenerator.validateToken(token, clientAddr_, lifetime_).hasValue());
+}
+
+TEST_F(RetryTokenGeneratorTest, Expired) {
+  RetryTokenGenerator generator(secret_);
+  auto now = std::chrono::system_clock::now();
+  auto token = generator.generateToken(connId_, clientAddr_, now);
+  EXPECT_TRUE(generator.validateToken(token, clientAddr_, lifetime_, now)
+                  .hasValue());
+  EXPECT_FALSE(
+      generator.validateToken(token, clientAddr_, lifetime_, now + 11s)
+          .hasValue());
+  EXPECT_FALSE(generator.validateToken(token, clientAddr_, lifetime_, now - 1s)
+                   .hasValue());
+}
+
+TEST_F(RetryTokenGeneratorTest, Tampered) {
+  RetryTokenGenerator generator(secret_);
+  auto token = generator.generateToken(connId_, clientAddr_);
+  for (size_t i = 0; i < token.size(); ++i) {
+    auto tampered = token;
+    tampered[i] ^= 0x01;
+    EXPECT_FALSE(
+        generator.validateToken(tampered, clientAddr_, lifetime_).hasValue());
+  }
+  auto truncated = token.substr(0, token.size() - 1);
+  EXPECT_FALSE(
+      generator.validateToken(truncated, clientAddr_, lifetime_).hasValue());
+  EXPECT_FALSE(generator.validateToken("", clientAddr_, lifetime_).hasValue());
+}
+
+TEST_F(RetryTokenGeneratorTest, ValidateNewToken) {
+  RetryTokenGenerator generator(secret_);
+  auto now = std::chrono::system_clock::now();
+  auto token = generator.generateNewToken(clientAddr_, now);
+  EXPECT_TRUE(generator.validateNewToken(
+      token, folly::SocketAddress("1.2.3.4", 9090), lifetime_, now));
+  EXPECT_FALSE(generator.validateNewToken(
+      token, folly::SocketAddress("1.2.3.5", 8080), lifetime_, now));
+  EXPECT_FALSE(
+      generator.validateNewToken(token, clientAddr_, lifetime_, now + 11s));
+  for (size_t i = 0; i < token.size(); ++i) {
+    auto tampered = token;
+    tampered[i] ^= 0x01;
+    EXPECT_FALSE(
+        generator.validateNewToken(tampered, clientAddr_, lifetime_, now));
+  }
+}
+
+TEST_F(RetryTokenGeneratorTest, NewTokenIsNotRetryToken) {
+  RetryTokenGenerator generator(secret_);
+  auto newToken = generator.generateNewToken(clientAddr_);
+  EXPECT_FALSE(
+      generator.validateToken(newToken, clientAddr_, lifetime_).hasValue());
+  auto retryToken = generator.generateToken(connId_, clientAddr_);
+  EXPECT_FALSE(generator.validateNewToken(retryToken, clientAddr_, lifetime_));
+}
+} // namespace test
+} // namespace quic
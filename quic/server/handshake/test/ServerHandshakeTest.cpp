@@ -18,6 +18,7 @@
 #include <fizz/protocol/test/Mocks.h>
 #include <fizz/server/test/Mocks.h>
 
+#include <folly/executors/ManualExecutor.h>
 #include <folly/io/async/SSLContext.h>
 #include <folly/io/async/ScopedEventBaseThread.h>
 #include <folly/io/async/test/MockAsyncTransport.h>
@@ -393,6 +394,118 @@ TEST_F(ServerHandshakeTest, TestMalformedHandshakeMessage) {
   EXPECT_TRUE(ex);
 }
 
+class ServerHandshakeCryptoExecutorTest : public ServerHandshakeTest {
+ public:
+  ~ServerHandshakeCryptoExecutorTest() override = default;
+
+  void initialize() override {
+    ServerHandshakeTest::initialize();
+    handshake->setCryptoExecutor(&cryptoExecutor);
+  }
+
+  void runCryptoExecutor() {
+    while (cryptoExecutor.run() > 0) {
+      evb.loopIgnoreKeepAlive();
+    }
+  }
+
+  folly::ManualExecutor cryptoExecutor;
+};
+
+TEST_F(ServerHandshakeCryptoExecutorTest, TestHandshakeSuccess) {
+  // Split the ClientHello so that its second half comes in while the first
+  // one is on the crypto executor.
+  ASSERT_EQ(clientWrites.size(), 1);
+  ASSERT_EQ(clientWrites[0].contents.size(), 1);
+  auto clientHello = std::move(clientWrites[0].contents[0].data);
+  clientHello->coalesce();
+  auto half = clientHello->length() / 2;
+  clientWrites.clear();
+  for (auto range :
+       {folly::ByteRange(clientHello->data(), half),
+        folly::ByteRange(
+            clientHello->data() + half, clientHello->length() - half)}) {
+    fizz::WriteToSocket write;
+    fizz::TLSContent content;
+    content.contentType = fizz::ContentType::handshake;
+    content.data = folly::IOBuf::copyBuffer(range);
+    content.encryptionLevel = fizz::EncryptionLevel::Plaintext;
+    write.contents.push_back(std::move(content));
+    clientWrites.push_back(std::move(write));
+  }
+
+  clientServerRound();
+  EXPECT_EQ(handshakeWriteCipher, nullptr);
+  EXPECT_TRUE(cryptoState->initialStream.writeBuffer.empty());
+
+  runCryptoExecutor();
+  EXPECT_NE(handshakeWriteCipher, nullptr);
+  serverClientRound();
+  clientServerRound();
+  EXPECT_EQ(handshake->getPhase(), ServerHandshake::Phase::Established);
+  if (ex) {
+    std::rethrow_exception(ex);
+  }
+  expectOneRttCipher(true);
+  EXPECT_TRUE(handshakeSuccess);
+  EXPECT_EQ(cryptoExecutor.run(), 0);
+}
+
+TEST_F(ServerHandshakeCryptoExecutorTest, TestCancel) {
+  clientServerRound();
+
+  handshake->cancel();
+  // Let's destroy the crypto state to make sure it is not referenced.
+  cryptoState.reset();
+
+  runCryptoExecutor();
+  EXPECT_EQ(handshake->getDestructorGuardCount(), 0);
+  expectOneRttCipher(false);
+}
+
+class CountingCryptoFactory : public FizzCryptoFactory {
+ public:
+  std::unique_ptr<fizz::Aead> makeAead(
+      fizz::CipherSuite cipher) const override {
+    ++numAeads;
+    return FizzCryptoFactory::makeAead(cipher);
+  }
+
+  mutable size_t numAeads{0};
+};
+
+class ServerHandshakeCryptoFactoryTest : public ServerHandshakeTest {
+ public:
+  ~ServerHandshakeCryptoFactoryTest() override = default;
+
+  void initialize() override {
+    handshake->setCryptoFactory(cryptoFactory);
+    ServerHandshakeTest::initialize();
+  }
+
+  std::shared_ptr<CountingCryptoFactory> cryptoFactory{
+      std::make_shared<CountingCryptoFactory>()};
+};
+
+TEST_F(ServerHandshakeCryptoFactoryTest, TestHandshakeSuccess) {
+  clientServerRound();
+  serverClientRound();
+  clientServerRound();
+  EXPECT_EQ(handshake->getPhase(), ServerHandshake::Phase::Established);
+  if (ex) {
+    std::rethrow_exception(ex);
+  }
+  expectOneRttCipher(true);
+  // The handshake and 1-rtt ciphers of both directions.
+  EXPECT_GE(cryptoFactory->numAeads, 4);
+
+  auto numAeads = cryptoFactory->numAeads;
+  auto updater = handshake->getOneRttKeyUpdater();
+  ASSERT_NE(updater, nullptr);
+  updater->makeNextWriteCipher();
+  EXPECT_EQ(cryptoFactory->numAeads, numAeads + 1);
+}
+
 class AsyncRejectingTicketCipher : public fizz::server::TicketCipher {
  public:
   ~AsyncRejectingTicketCipher() override = default;
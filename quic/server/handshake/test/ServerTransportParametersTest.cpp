@@ -105,5 +105,98 @@ TEST(ServerTransportParametersTest, TestGetExtensionsMissingClientParams) {
       generateStatelessResetToken());
   EXPECT_THROW(ext.getExtensions(TestMessages::clientHello()), FizzException);
 }
+
+TEST(ServerTransportParametersTest, TestGetExtensionsCached) {
+  auto token = generateStatelessResetToken();
+  auto connId = getTestConnectionId();
+  auto makeExt =
+      [&](uint64_t initialMaxData,
+          std::shared_ptr<ServerTransportParametersCache> cache) {
+        return std::make_unique<ServerTransportParametersExtension>(
+            QuicVersion::MVFST_OLD,
+            std::vector<QuicVersion>{MVFST1, QuicVersion::MVFST_OLD},
+            initialMaxData,
+            kDefaultStreamWindowSize,
+            kDefaultStreamWindowSize,
+            kDefaultStreamWindowSize,
+            std::numeric_limits<uint32_t>::max(),
+            std::numeric_limits<uint32_t>::max(),
+            kDefaultIdleTimeout,
+            kDefaultAckDelayExponent,
+            kDefaultUDPSendPacketLen,
+            kDefaultPartialReliability,
+            token,
+            connId,
+            std::chrono::microseconds(1000),
+            1000,
+            std::move(cache));
+      };
+
+  // The parameters in the order they were always written.
+  ServerTransportParameters params;
+  params.negotiated_version = QuicVersion::MVFST_OLD;
+  params.supported_versions = {MVFST1, QuicVersion::MVFST_OLD};
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_bidi_local,
+      kDefaultStreamWindowSize));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_bidi_remote,
+      kDefaultStreamWindowSize));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_stream_data_uni,
+      kDefaultStreamWindowSize));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_data, kDefaultConnectionWindowSize));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_streams_bidi,
+      std::numeric_limits<uint32_t>::max()));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::initial_max_streams_uni,
+      std::numeric_limits<uint32_t>::max()));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::idle_timeout, kDefaultIdleTimeout.count()));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::ack_delay_exponent, kDefaultAckDelayExponent));
+  params.parameters.push_back(encodeIntegerParameter(
+      TransportParameterId::max_packet_size, kDefaultUDPSendPacketLen));
+  params.parameters.push_back(encodeStatelessResetToken(token));
+  params.parameters.emplace_back(
+      TransportParameterId::original_connection_id,
+      folly::IOBuf::copyBuffer(connId.data(), connId.size()));
+  params.parameters.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kPartialReliabilityParameterId), 0));
+  params.parameters.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId), 1000));
+  params.parameters.push_back(encodeIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      1000));
+  auto expected = encodeExtension(params);
+
+  auto cache = std::make_shared<ServerTransportParametersCache>();
+  auto chlo = getClientHello(QuicVersion::MVFST_OLD);
+  for (int i = 0; i < 2; i++) {
+    auto extensions =
+        makeExt(kDefaultConnectionWindowSize, cache)->getExtensions(chlo);
+    ASSERT_EQ(extensions.size(), 1);
+    EXPECT_TRUE(folly::IOBufEqualTo()(
+        extensions[0].extension_data, expected.extension_data));
+  }
+  EXPECT_EQ(cache->numEncodings(), 1);
+  auto uncached =
+      makeExt(kDefaultConnectionWindowSize, nullptr)->getExtensions(chlo);
+  EXPECT_TRUE(folly::IOBufEqualTo()(
+      uncached[0].extension_data, expected.extension_data));
+
+  // Different settings are encoded again.
+  auto other =
+      makeExt(kDefaultConnectionWindowSize * 2, cache)->getExtensions(chlo);
+  EXPECT_EQ(cache->numEncodings(), 2);
+  auto otherParams = getExtension<ServerTransportParameters>(other);
+  ASSERT_TRUE(otherParams.hasValue());
+  EXPECT_EQ(
+      *getIntegerParameter(
+          TransportParameterId::initial_max_data, otherParams->parameters),
+      kDefaultConnectionWindowSize * 2);
+}
 } // namespace test
 } // namespace quic
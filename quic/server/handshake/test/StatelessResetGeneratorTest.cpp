@@ -55,5 +55,36 @@ TEST_F(StatelessResetGeneratorTest, DifferentSecretSameAddress) {
       generator2.generateToken(ConnectionId({0x14, 0x35, 0x22, 0x11})));
 }
 
+TEST_F(StatelessResetGeneratorTest, AesTokens) {
+  StatelessResetSecret secret;
+  folly::Random::secureRandom(secret.data(), secret.size());
+  folly::SocketAddress address1("1.2.3.4", 8080), address2("2.3.4.5", 8888);
+  using Algorithm = StatelessResetGenerator::Algorithm;
+  StatelessResetGenerator generator1(
+      secret, address1.getFullyQualified(), Algorithm::AES),
+      generator2(secret, address1.getFullyQualified(), Algorithm::AES),
+      otherAddressGenerator(
+          secret, address2.getFullyQualified(), Algorithm::AES),
+      hkdfGenerator(secret, address1.getFullyQualified());
+  ConnectionId connId({0x14, 0x35, 0x22, 0x11});
+  EXPECT_EQ(generator1.generateToken(connId), generator2.generateToken(connId));
+  EXPECT_NE(
+      generator1.generateToken(connId),
+      otherAddressGenerator.generateToken(connId));
+  EXPECT_NE(
+      generator1.generateToken(connId), hkdfGenerator.generateToken(connId));
+  // The length prefix tells apart the ids that only differ by trailing zeros.
+  EXPECT_NE(
+      generator1.generateToken(connId),
+      generator1.generateToken(ConnectionId({0x14, 0x35, 0x22, 0x11, 0x00})));
+  // The longest ids span both blocks of the MAC.
+  std::vector<uint8_t> longId(kMaxConnectionIdSize, 0xab);
+  auto otherLongId = longId;
+  otherLongId.back() = 0xac;
+  EXPECT_NE(
+      generator1.generateToken(ConnectionId(longId)),
+      generator1.generateToken(ConnectionId(otherLongId)));
+}
+
 } // namespace test
 } // namespace quic
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/handshake/TicketKeyManager.h>
+
+#include <fizz/protocol/OpenSSLFactory.h>
+#include <fizz/server/CertManager.h>
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+fizz::server::ResumptionState makeResumptionState() {
+  fizz::server::ResumptionState resState;
+  resState.version = fizz::ProtocolVersion::tls_1_3;
+  resState.cipher = fizz::CipherSuite::TLS_AES_128_GCM_SHA256;
+  resState.resumptionSecret = folly::IOBuf::copyBuffer("resumption secret");
+  resState.ticketAgeAdd = 1;
+  resState.ticketIssueTime = std::chrono::system_clock::now();
+  return resState;
+}
+
+std::string makeSecret(char c) {
+  return std::string(fizz::server::kMinTicketSecretLength, c);
+}
+} // namespace
+
+class TicketKeyManagerTest : public Test {
+ public:
+  std::unique_ptr<folly::IOBuf> encrypt() {
+    auto result = manager_.encrypt(makeResumptionState()).get();
+    return result ? std::move(result->first) : nullptr;
+  }
+
+  fizz::PskType decrypt(const std::unique_ptr<folly::IOBuf>& ticket) {
+    return manager_.decrypt(ticket->clone()).get().first;
+  }
+
+ protected:
+  TicketKeyManager manager_{std::make_shared<fizz::OpenSSLFactory>(),
+                            std::make_shared<fizz::server::CertManager>(),
+                            std::chrono::seconds(60)};
+};
+
+TEST_F(TicketKeyManagerTest, NoSecret) {
+  EXPECT_EQ(encrypt(), nullptr);
+  EXPECT_EQ(
+      decrypt(folly::IOBuf::copyBuffer("ticket")), fizz::PskType::Rejected);
+}
+
+TEST_F(TicketKeyManagerTest, ShortSecret) {
+  EXPECT_THROW(manager_.rotate("short"), std::invalid_argument);
+  EXPECT_EQ(manager_.getNumSecrets(), 0);
+  EXPECT_EQ(encrypt(), nullptr);
+}
+
+TEST_F(TicketKeyManagerTest, ResumesThroughRotations) {
+  auto now = Clock::now();
+  manager_.rotate(makeSecret('a'), now);
+  auto ticket = encrypt();
+  ASSERT_NE(ticket, nullptr);
+  EXPECT_EQ(decrypt(ticket), fizz::PskType::Resumption);
+
+  now += std::chrono::seconds(30);
+  manager_.rotate(makeSecret('b'), now);
+  EXPECT_EQ(manager_.getNumSecrets(), 2);
+  EXPECT_EQ(decrypt(ticket), fizz::PskType::Resumption);
+  auto newTicket = encrypt();
+  ASSERT_NE(newTicket, nullptr);
+  EXPECT_EQ(decrypt(newTicket), fizz::PskType::Resumption);
+
+  // The first secret was replaced a lifetime ago.
+  now += std::chrono::seconds(60);
+  manager_.rotate(makeSecret('c'), now);
+  EXPECT_EQ(manager_.getNumSecrets(), 2);
+  EXPECT_EQ(decrypt(ticket), fizz::PskType::Rejected);
+  EXPECT_EQ(decrypt(newTicket), fizz::PskType::Resumption);
+}
+
+TEST_F(TicketKeyManagerTest, SharedBetweenManagers) {
+  // Servers that rotate to the same secrets resume each other's tickets.
+  TicketKeyManager other(
+      std::make_shared<fizz::OpenSSLFactory>(),
+      std::make_shared<fizz::server::CertManager>());
+  manager_.rotate(makeSecret('a'));
+  other.rotate(makeSecret('a'));
+  auto ticket = encrypt();
+  ASSERT_NE(ticket, nullptr);
+  EXPECT_EQ(
+      other.decrypt(ticket->clone()).get().first, fizz::PskType::Resumption);
+}
+} // namespace test
+} // namespace quic
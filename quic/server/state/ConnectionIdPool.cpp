@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionIdPool.h>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+ConnectionIdPool::ConnectionIdPool(
+    folly::EventBase* evb,
+    ConnectionIdAlgo* connIdAlgo,
+    ServerConnectionIdParams params,
+    std::unique_ptr<StatelessResetGenerator> resetGenerator,
+    size_t capacity)
+    : evb_(evb),
+      connIdAlgo_(connIdAlgo),
+      params_(std::move(params)),
+      resetGenerator_(std::move(resetGenerator)),
+      capacity_(capacity) {
+  CHECK(evb_);
+  CHECK(connIdAlgo_);
+  CHECK(resetGenerator_);
+  entries_.reserve(capacity_);
+  evb_->runInLoop(this);
+}
+
+ConnectionIdData ConnectionIdPool::take(uint64_t sequenceNumber) {
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+  if (entries_.empty()) {
+    ++numMisses_;
+    auto entry = encode();
+    ConnectionIdData connIdData(entry.connId, sequenceNumber);
+    connIdData.token = std::move(entry.token);
+    return connIdData;
+  }
+  ConnectionIdData connIdData(entries_.back().connId, sequenceNumber);
+  connIdData.token = std::move(entries_.back().token);
+  entries_.pop_back();
+  return connIdData;
+}
+
+void ConnectionIdPool::fill() {
+  while (entries_.size() < capacity_) {
+    entries_.push_back(encode());
+  }
+}
+
+void ConnectionIdPool::runLoopCallback() noexcept {
+  for (size_t i = 0;
+       i < kConnectionIdPoolRefillBatch && entries_.size() < capacity_;
+       i++) {
+    entries_.push_back(encode());
+  }
+  if (entries_.size() < capacity_) {
+    evb_->runInLoop(this);
+  }
+}
+
+ConnectionIdPool::Entry ConnectionIdPool::encode() {
+  auto connId = connIdAlgo_->encodeConnectionId(params_);
+  auto token = resetGenerator_->generateToken(connId);
+  return Entry(std::move(connId), std::move(token));
+}
+} // namespace quic
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+#include <quic/QuicConstants.h>
+#include <quic/codec/ConnectionIdAlgo.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+
+#include <memory>
+#include <vector>
+
+namespace quic {
+
+/**
+ * Connection ids of a server worker encoded ahead of time, together with
+ * their stateless reset tokens, so that the connections don't run the
+ * connection id algorithm and the token derivation while they handle a
+ * packet. The pool fills itself from an EventBase loop callback, at most
+ * kConnectionIdPoolRefillBatch ids per loop iteration, after it is made and
+ * whenever ids are taken. When it is empty take() encodes the id right away.
+ *
+ * All the ids are encoded with the same ServerConnectionIdParams, the pool has
+ * to be replaced when they change. Meant to be owned by a worker and only used
+ * from the thread of its EventBase.
+ */
+class ConnectionIdPool : private folly::EventBase::LoopCallback {
+ public:
+  using SharedPtr = std::shared_ptr<ConnectionIdPool>;
+
+  ConnectionIdPool(
+      folly::EventBase* evb,
+      ConnectionIdAlgo* connIdAlgo,
+      ServerConnectionIdParams params,
+      std::unique_ptr<StatelessResetGenerator> resetGenerator,
+      size_t capacity);
+
+  ~ConnectionIdPool() override = default;
+
+  /**
+   * A connection id and its token, with the given sequence number. Must be
+   * called from the thread of the EventBase, like the constructor.
+   */
+  ConnectionIdData take(uint64_t sequenceNumber);
+
+  /**
+   * Encodes ids until the pool is full, without waiting for the loop.
+   */
+  void fill();
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /**
+   * The ids taken while the pool was empty.
+   */
+  uint64_t numMisses() const {
+    return numMisses_;
+  }
+
+ private:
+  struct Entry {
+    Entry(ConnectionId connIdIn, StatelessResetToken tokenIn)
+        : connId(std::move(connIdIn)), token(std::move(tokenIn)) {}
+
+    ConnectionId connId;
+    StatelessResetToken token;
+  };
+
+  void runLoopCallback() noexcept override;
+  Entry encode();
+
+  folly::EventBase* evb_;
+  ConnectionIdAlgo* connIdAlgo_;
+  ServerConnectionIdParams params_;
+  std::unique_ptr<StatelessResetGenerator> resetGenerator_;
+  size_t capacity_;
+  std::vector<Entry> entries_;
+  uint64_t numMisses_{0};
+};
+} // namespace quic
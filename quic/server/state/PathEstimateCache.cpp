@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/PathEstimateCache.h>
+
+#include <algorithm>
+
+namespace quic {
+
+PathEstimateCache::PathEstimateCache(
+    size_t capacity,
+    std::chrono::microseconds lifetime)
+    : lifetime_(lifetime), estimates_(capacity) {}
+
+void PathEstimateCache::onConnectionDone(
+    const folly::IPAddress& client,
+    const QuicConnectionStateBase& conn,
+    TimePoint now) {
+  if (!conn.congestionController || conn.lossState.srtt == 0us ||
+      conn.lossState.mrtt == kDefaultMinRtt) {
+    return;
+  }
+  Estimate estimate;
+  // The delivery rate of the final cwnd, which is close to the bottleneck
+  // bandwidth for BBR and to what the path took for the loss based ones.
+  estimate.bandwidth = conn.congestionController->getCongestionWindow() *
+      std::chrono::microseconds(1s).count() / conn.lossState.srtt.count();
+  estimate.minRtt = conn.lossState.mrtt;
+  estimate.updateTime = now;
+  update(client, estimate);
+}
+
+void PathEstimateCache::update(
+    const folly::IPAddress& client,
+    const Estimate& estimate) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  estimates_.set(subnetOf(client), estimate);
+}
+
+folly::Optional<PathEstimateCache::Estimate> PathEstimateCache::get(
+    const folly::IPAddress& client,
+    TimePoint now) {
+  auto subnet = subnetOf(client);
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = estimates_.find(subnet);
+  if (it == estimates_.end()) {
+    return folly::none;
+  }
+  if (now - it->second.updateTime > lifetime_) {
+    estimates_.erase(subnet);
+    return folly::none;
+  }
+  return it->second;
+}
+
+uint64_t PathEstimateCache::initCwndInMss(
+    const Estimate& estimate,
+    const TransportSettings& settings,
+    uint64_t packetLen) {
+  // Bandwidth is in bytes per second, and minRtt could take the product out of
+  // the range of uint64_t if it is bogus, hence the double.
+  double bdp = static_cast<double>(estimate.bandwidth) *
+      estimate.minRtt.count() / std::chrono::microseconds(1s).count();
+  double cwndInMss = bdp * kPathEstimateCwndGain / packetLen;
+  uint64_t maxInitCwndInMss =
+      std::min(kPathEstimateMaxInitCwndInMss, settings.maxCwndInMss);
+  if (cwndInMss >= maxInitCwndInMss) {
+    return std::max(maxInitCwndInMss, settings.initCwndInMss);
+  }
+  return std::max(static_cast<uint64_t>(cwndInMss), settings.initCwndInMss);
+}
+
+folly::IPAddress PathEstimateCache::subnetOf(const folly::IPAddress& address) {
+  if (address.isIPv4Mapped()) {
+    return subnetOf(address.createIPv4());
+  }
+  return address.mask(
+      address.isV4() ? kPathEstimateV4PrefixLength
+                     : kPathEstimateV6PrefixLength);
+}
+} // namespace quic
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <quic/QuicConstants.h>
+#include <quic/state/StateData.h>
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <folly/container/EvictingCacheMap.h>
+
+#include <chrono>
+#include <mutex>
+
+namespace quic {
+
+/**
+ * Remembers the bandwidth and min rtt that the last connections from a client
+ * subnet (a /24 for IPv4, a /48 for IPv6) ended with, so that the next
+ * connections from the subnet can start with a cwnd and pacing rate closer to
+ * what the path can take. The entries expire after a while and the least
+ * recently used ones are evicted once the cache is full. Meant to be shared by
+ * all the workers of a server, from any thread.
+ */
+class PathEstimateCache {
+ public:
+  struct Estimate {
+    // Bytes per second
+    uint64_t bandwidth{0};
+    std::chrono::microseconds minRtt{0us};
+    TimePoint updateTime;
+  };
+
+  explicit PathEstimateCache(
+      size_t capacity = kDefaultPathEstimateCacheSize,
+      std::chrono::microseconds lifetime = kDefaultPathEstimateLifetime);
+
+  /**
+   * Records the estimates of a connection from the client that is going away.
+   * Connections without a rtt sample or a congestion controller are ignored.
+   */
+  void onConnectionDone(
+      const folly::IPAddress& client,
+      const QuicConnectionStateBase& conn,
+      TimePoint now = Clock::now());
+
+  void update(const folly::IPAddress& client, const Estimate& estimate);
+
+  folly::Optional<Estimate> get(
+      const folly::IPAddress& client,
+      TimePoint now = Clock::now());
+
+  /**
+   * The initial cwnd in MSS for a new connection from the client: a fraction
+   * of the cached bandwidth delay product, never below
+   * settings.initCwndInMss and never above kPathEstimateMaxInitCwndInMss or
+   * settings.maxCwndInMss.
+   */
+  static uint64_t initCwndInMss(
+      const Estimate& estimate,
+      const TransportSettings& settings,
+      uint64_t packetLen);
+
+  static folly::IPAddress subnetOf(const folly::IPAddress& address);
+
+ private:
+  std::mutex mutex_;
+  std::chrono::microseconds lifetime_;
+  folly::EvictingCacheMap<folly::IPAddress, Estimate> estimates_;
+};
+} // namespace quic
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ServerConnectionSnapshot.h>
+
+#include <folly/IPAddress.h>
+#include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
+#include <folly/net/NetOps.h>
+
+#include <glog/logging.h>
+
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+
+namespace quic {
+
+namespace {
+
+void writeBytes(folly::ByteRange bytes, folly::io::Appender& appender) {
+  CHECK_LE(bytes.size(), std::numeric_limits<uint16_t>::max());
+  appender.writeBE<uint16_t>(bytes.size());
+  appender.push(bytes.data(), bytes.size());
+}
+
+std::vector<uint8_t> readBytes(folly::io::Cursor& cursor) {
+  std::vector<uint8_t> bytes(cursor.readBE<uint16_t>());
+  cursor.pull(bytes.data(), bytes.size());
+  return bytes;
+}
+
+// Checks that count items of at least minSize bytes can still be read, before
+// allocating for them.
+void checkCount(
+    const folly::io::Cursor& cursor,
+    uint64_t count,
+    size_t minSize = 1) {
+  if (count > cursor.totalLength() / minSize) {
+    throw std::out_of_range("count larger than the snapshot");
+  }
+}
+
+void writeOptional(
+    const folly::Optional<uint64_t>& value,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint8_t>(value.hasValue());
+  if (value) {
+    appender.writeBE<uint64_t>(*value);
+  }
+}
+
+folly::Optional<uint64_t> readOptional(folly::io::Cursor& cursor) {
+  if (!cursor.readBE<uint8_t>()) {
+    return folly::none;
+  }
+  return cursor.readBE<uint64_t>();
+}
+
+void writeConnectionId(
+    const folly::Optional<ConnectionId>& connId,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint8_t>(connId.hasValue());
+  if (connId) {
+    appender.writeBE<uint8_t>(connId->size());
+    appender.push(connId->data(), connId->size());
+  }
+}
+
+folly::Optional<ConnectionId> readConnectionId(folly::io::Cursor& cursor) {
+  if (!cursor.readBE<uint8_t>()) {
+    return folly::none;
+  }
+  auto len = cursor.readBE<uint8_t>();
+  return ConnectionId(cursor, len);
+}
+
+void writeConnectionIds(
+    const std::vector<ConnectionIdData>& connIds,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint32_t>(connIds.size());
+  for (const auto& connIdData : connIds) {
+    writeConnectionId(connIdData.connId, appender);
+    appender.writeBE<uint64_t>(connIdData.sequenceNumber);
+    appender.writeBE<uint8_t>(connIdData.token.hasValue());
+    if (connIdData.token) {
+      appender.push(connIdData.token->data(), connIdData.token->size());
+    }
+  }
+}
+
+std::vector<ConnectionIdData> readConnectionIds(folly::io::Cursor& cursor) {
+  auto count = cursor.readBE<uint32_t>();
+  checkCount(cursor, count);
+  std::vector<ConnectionIdData> connIds;
+  connIds.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto connId = readConnectionId(cursor);
+    if (!connId) {
+      throw std::runtime_error("missing connection id");
+    }
+    auto sequenceNumber = cursor.readBE<uint64_t>();
+    connIds.emplace_back(*connId, sequenceNumber);
+    if (cursor.readBE<uint8_t>()) {
+      StatelessResetToken token;
+      cursor.pull(token.data(), token.size());
+      connIds.back().token = token;
+    }
+  }
+  return connIds;
+}
+
+void writeAddress(
+    const folly::SocketAddress& address,
+    folly::io::Appender& appender) {
+  if (!address.isInitialized()) {
+    writeBytes(folly::ByteRange(), appender);
+    return;
+  }
+  auto ip = address.getIPAddress();
+  writeBytes(folly::ByteRange(ip.bytes(), ip.byteCount()), appender);
+  appender.writeBE<uint16_t>(address.getPort());
+}
+
+folly::SocketAddress readAddress(folly::io::Cursor& cursor) {
+  auto bytes = readBytes(cursor);
+  if (bytes.empty()) {
+    return folly::SocketAddress();
+  }
+  auto ip = folly::IPAddress::fromBinary(folly::range(bytes));
+  return folly::SocketAddress(ip, cursor.readBE<uint16_t>());
+}
+
+void writeStreamIds(
+    const std::vector<StreamId>& ids,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint32_t>(ids.size());
+  for (auto id : ids) {
+    appender.writeBE<uint64_t>(id);
+  }
+}
+
+std::vector<StreamId> readStreamIds(folly::io::Cursor& cursor) {
+  auto count = cursor.readBE<uint32_t>();
+  checkCount(cursor, count, sizeof(uint64_t));
+  std::vector<StreamId> ids(count);
+  for (auto& id : ids) {
+    id = cursor.readBE<uint64_t>();
+  }
+  return ids;
+}
+
+void writeStream(
+    const ServerConnectionSnapshot::Stream& stream,
+    folly::io::Appender& appender) {
+  appender.writeBE<uint64_t>(stream.id);
+  appender.writeBE<uint64_t>(stream.currentWriteOffset);
+  appender.writeBE<uint64_t>(stream.currentReadOffset);
+  appender.writeBE<uint64_t>(stream.currentReceiveOffset);
+  appender.writeBE<uint64_t>(stream.minimumRetransmittableOffset);
+  appender.writeBE<uint64_t>(stream.maxOffsetObserved);
+  writeOptional(stream.finalWriteOffset, appender);
+  writeOptional(stream.finalReadOffset, appender);
+  appender.writeBE<uint8_t>(stream.sendState);
+  appender.writeBE<uint8_t>(stream.recvState);
+  appender.writeBE<uint64_t>(stream.windowSize);
+  appender.writeBE<uint64_t>(stream.advertisedMaxOffset);
+  appender.writeBE<uint64_t>(stream.peerAdvertisedMaxOffset);
+  appender.writeBE<uint8_t>(stream.priority.level);
+  appender.writeBE<uint8_t>(stream.priority.incremental);
+  appender.writeBE<uint8_t>(stream.isControl);
+}
+
+ServerConnectionSnapshot::Stream readStream(folly::io::Cursor& cursor) {
+  ServerConnectionSnapshot::Stream stream;
+  stream.id = cursor.readBE<uint64_t>();
+  stream.currentWriteOffset = cursor.readBE<uint64_t>();
+  stream.currentReadOffset = cursor.readBE<uint64_t>();
+  stream.currentReceiveOffset = cursor.readBE<uint64_t>();
+  stream.minimumRetransmittableOffset = cursor.readBE<uint64_t>();
+  stream.maxOffsetObserved = cursor.readBE<uint64_t>();
+  stream.finalWriteOffset = readOptional(cursor);
+  stream.finalReadOffset = readOptional(cursor);
+  stream.sendState = cursor.readBE<uint8_t>();
+  stream.recvState = cursor.readBE<uint8_t>();
+  stream.windowSize = cursor.readBE<uint64_t>();
+  stream.advertisedMaxOffset = cursor.readBE<uint64_t>();
+  stream.peerAdvertisedMaxOffset = cursor.readBE<uint64_t>();
+  auto level = cursor.readBE<uint8_t>();
+  bool incremental = cursor.readBE<uint8_t>();
+  stream.priority = Priority(level, incremental);
+  stream.isControl = cursor.readBE<uint8_t>();
+  return stream;
+}
+
+bool writeAll(folly::NetworkSocket sock, const uint8_t* data, size_t len) {
+  while (len > 0) {
+    auto ret = folly::netops::send(sock, data, len, MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+bool readAll(folly::NetworkSocket sock, uint8_t* data, size_t len) {
+  while (len > 0) {
+    auto ret = folly::netops::recv(sock, data, len, 0);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    data += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+bool writeLength(folly::NetworkSocket sock, uint32_t len) {
+  uint32_t bigEndianLen = folly::Endian::big(len);
+  return writeAll(
+      sock, reinterpret_cast<const uint8_t*>(&bigEndianLen), sizeof(len));
+}
+
+folly::Optional<uint32_t> readLength(folly::NetworkSocket sock) {
+  uint32_t bigEndianLen;
+  if (!readAll(
+          sock, reinterpret_cast<uint8_t*>(&bigEndianLen), sizeof(uint32_t))) {
+    return folly::none;
+  }
+  return folly::Endian::big(bigEndianLen);
+}
+} // namespace
+
+Buf encodeServerConnectionSnapshot(const ServerConnectionSnapshot& snapshot) {
+  auto buf = folly::IOBuf::create(512);
+  folly::io::Appender appender(buf.get(), 512);
+  appender.writeBE<uint8_t>(kServerConnectionSnapshotVersion);
+  appender.writeBE<uint32_t>(static_cast<uint32_t>(snapshot.version));
+  appender.writeBE<uint8_t>(snapshot.alpn.hasValue());
+  if (snapshot.alpn) {
+    writeBytes(folly::ByteRange(folly::StringPiece(*snapshot.alpn)), appender);
+  }
+  appender.writeBE<uint16_t>(static_cast<uint16_t>(snapshot.secrets.cipher));
+  writeBytes(folly::range(snapshot.secrets.clientSecret), appender);
+  writeBytes(folly::range(snapshot.secrets.serverSecret), appender);
+
+  writeConnectionId(snapshot.clientConnectionId, appender);
+  writeConnectionId(snapshot.serverConnectionId, appender);
+  writeConnectionIds(snapshot.selfConnectionIds, appender);
+  writeConnectionIds(snapshot.peerConnectionIds, appender);
+  appender.writeBE<uint64_t>(snapshot.nextSelfConnectionIdSequence);
+
+  writeAddress(snapshot.peerAddress, appender);
+  writeAddress(snapshot.originalPeerAddress, appender);
+
+  appender.writeBE<uint64_t>(snapshot.peerAckDelayExponent);
+  appender.writeBE<uint64_t>(snapshot.peerIdleTimeout.count());
+  appender.writeBE<uint64_t>(snapshot.udpSendPacketLen);
+  appender.writeBE<uint64_t>(snapshot.peerActiveConnectionIdLimit);
+  appender.writeBE<uint8_t>(snapshot.partialReliabilityEnabled);
+
+  appender.writeBE<uint64_t>(snapshot.nextPacketNum);
+  writeOptional(snapshot.largestReceivedPacketNum, appender);
+
+  appender.writeBE<uint64_t>(snapshot.connWindowSize);
+  appender.writeBE<uint64_t>(snapshot.connAdvertisedMaxOffset);
+  appender.writeBE<uint64_t>(snapshot.connPeerAdvertisedMaxOffset);
+  appender.writeBE<uint64_t>(snapshot.sumCurReadOffset);
+  appender.writeBE<uint64_t>(snapshot.sumMaxObservedOffset);
+  appender.writeBE<uint64_t>(snapshot.sumCurWriteOffset);
+  appender.writeBE<uint64_t>(
+      snapshot.peerAdvertisedInitialMaxStreamOffsetBidiLocal);
+  appender.writeBE<uint64_t>(
+      snapshot.peerAdvertisedInitialMaxStreamOffsetBidiRemote);
+  appender.writeBE<uint64_t>(snapshot.peerAdvertisedInitialMaxStreamOffsetUni);
+
+  appender.writeBE<uint64_t>(snapshot.srtt.count());
+  appender.writeBE<uint64_t>(snapshot.lrtt.count());
+  appender.writeBE<uint64_t>(snapshot.rttvar.count());
+  appender.writeBE<uint64_t>(snapshot.mrtt.count());
+
+  const auto& streamIds = snapshot.streamIds;
+  appender.writeBE<uint64_t>(streamIds.nextAcceptablePeerBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptablePeerUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(
+      streamIds.nextAcceptableLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.nextUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxLocalUnidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteBidirectionalStreamId);
+  appender.writeBE<uint64_t>(streamIds.maxRemoteUnidirectionalStreamId);
+  writeStreamIds(streamIds.openBidirectionalPeerStreams, appender);
+  writeStreamIds(streamIds.openUnidirectionalPeerStreams, appender);
+  writeStreamIds(streamIds.openLocalStreams, appender);
+
+  appender.writeBE<uint32_t>(snapshot.streams.size());
+  for (const auto& stream : snapshot.streams) {
+    writeStream(stream, appender);
+  }
+  return buf;
+}
+
+folly::Optional<ServerConnectionSnapshot> decodeServerConnectionSnapshot(
+    const folly::IOBuf& buf) {
+  ServerConnectionSnapshot snapshot;
+  folly::io::Cursor cursor(&buf);
+  try {
+    if (cursor.readBE<uint8_t>() != kServerConnectionSnapshotVersion) {
+      return folly::none;
+    }
+    snapshot.version = static_cast<QuicVersion>(cursor.readBE<uint32_t>());
+    if (cursor.readBE<uint8_t>()) {
+      auto alpn = readBytes(cursor);
+      snapshot.alpn = std::string(alpn.begin(), alpn.end());
+    }
+    snapshot.secrets.cipher =
+        static_cast<fizz::CipherSuite>(cursor.readBE<uint16_t>());
+    snapshot.secrets.clientSecret = readBytes(cursor);
+    snapshot.secrets.serverSecret = readBytes(cursor);
+
+    snapshot.clientConnectionId = readConnectionId(cursor);
+    snapshot.serverConnectionId = readConnectionId(cursor);
+    snapshot.selfConnectionIds = readConnectionIds(cursor);
+    snapshot.peerConnectionIds = readConnectionIds(cursor);
+    snapshot.nextSelfConnectionIdSequence = cursor.readBE<uint64_t>();
+
+    snapshot.peerAddress = readAddress(cursor);
+    snapshot.originalPeerAddress = readAddress(cursor);
+
+    snapshot.peerAckDelayExponent = cursor.readBE<uint64_t>();
+    snapshot.peerIdleTimeout =
+        std::chrono::milliseconds(cursor.readBE<uint64_t>());
+    snapshot.udpSendPacketLen = cursor.readBE<uint64_t>();
+    snapshot.peerActiveConnectionIdLimit = cursor.readBE<uint64_t>();
+    snapshot.partialReliabilityEnabled = cursor.readBE<uint8_t>();
+
+    snapshot.nextPacketNum = cursor.readBE<uint64_t>();
+    snapshot.largestReceivedPacketNum = readOptional(cursor);
+
+    snapshot.connWindowSize = cursor.readBE<uint64_t>();
+    snapshot.connAdvertisedMaxOffset = cursor.readBE<uint64_t>();
+    snapshot.connPeerAdvertisedMaxOffset = cursor.readBE<uint64_t>();
+    snapshot.sumCurReadOffset = cursor.readBE<uint64_t>();
+    snapshot.sumMaxObservedOffset = cursor.readBE<uint64_t>();
+    snapshot.sumCurWriteOffset = cursor.readBE<uint64_t>();
+    snapshot.peerAdvertisedInitialMaxStreamOffsetBidiLocal =
+        cursor.readBE<uint64_t>();
+    snapshot.peerAdvertisedInitialMaxStreamOffsetBidiRemote =
+        cursor.readBE<uint64_t>();
+    snapshot.peerAdvertisedInitialMaxStreamOffsetUni =
+        cursor.readBE<uint64_t>();
+
+    snapshot.srtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    snapshot.lrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    snapshot.rttvar = std::chrono::microseconds(cursor.readBE<uint64_t>());
+    snapshot.mrtt = std::chrono::microseconds(cursor.readBE<uint64_t>());
+
+    auto& streamIds = snapshot.streamIds;
+    streamIds.nextAcceptablePeerBidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptablePeerUnidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptableLocalBidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextAcceptableLocalUnidirectionalStreamId =
+        cursor.readBE<uint64_t>();
+    streamIds.nextBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.nextUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxLocalBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxLocalUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxRemoteBidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.maxRemoteUnidirectionalStreamId = cursor.readBE<uint64_t>();
+    streamIds.openBidirectionalPeerStreams = readStreamIds(cursor);
+    streamIds.openUnidirectionalPeerStreams = readStreamIds(cursor);
+    streamIds.openLocalStreams = readStreamIds(cursor);
+
+    auto numStreams = cursor.readBE<uint32_t>();
+    checkCount(cursor, numStreams);
+    snapshot.streams.reserve(numStreams);
+    for (uint32_t i = 0; i < numStreams; ++i) {
+      snapshot.streams.push_back(readStream(cursor));
+    }
+  } catch (const std::exception& ex) {
+    VLOG(4) << "Malformed connection snapshot: " << ex.what();
+    return folly::none;
+  }
+  if (!cursor.isAtEnd()) {
+    return folly::none;
+  }
+  return snapshot;
+}
+
+bool writeServerConnectionSnapshots(
+    folly::NetworkSocket sock,
+    const std::vector<ServerConnectionSnapshot>& snapshots) {
+  for (const auto& snapshot : snapshots) {
+    auto buf = encodeServerConnectionSnapshot(snapshot);
+    buf->coalesce();
+    if (buf->length() > kMaxServerConnectionSnapshotSize) {
+      LOG(ERROR) << "Skipping connection snapshot of " << buf->length()
+                 << " bytes";
+      continue;
+    }
+    if (!writeLength(sock, buf->length()) ||
+        !writeAll(sock, buf->data(), buf->length())) {
+      return false;
+    }
+  }
+  return writeLength(sock, 0);
+}
+
+folly::Optional<std::vector<ServerConnectionSnapshot>>
+readServerConnectionSnapshots(folly::NetworkSocket sock) {
+  std::vector<ServerConnectionSnapshot> snapshots;
+  while (true) {
+    auto len = readLength(sock);
+    if (!len || *len > kMaxServerConnectionSnapshotSize) {
+      return folly::none;
+    }
+    if (*len == 0) {
+      return snapshots;
+    }
+    auto buf = folly::IOBuf::create(*len);
+    if (!readAll(sock, buf->writableData(), *len)) {
+      return folly::none;
+    }
+    buf->append(*len);
+    auto snapshot = decodeServerConnectionSnapshot(*buf);
+    if (!snapshot) {
+      return folly::none;
+    }
+    snapshots.push_back(std::move(*snapshot));
+  }
+}
+} // namespace quic
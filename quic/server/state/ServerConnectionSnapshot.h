@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/SocketAddress.h>
+#include <folly/io/IOBuf.h>
+#include <folly/net/NetworkSocket.h>
+
+#include <quic/QuicConstants.h>
+#include <quic/codec/QuicConnectionId.h>
+#include <quic/server/handshake/ServerHandshake.h>
+#include <quic/state/QuicStreamManager.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace quic {
+
+/**
+ * The state of an established server connection that another process needs
+ * to carry on with the connection, taken when the connection is quiescent:
+ * nothing is in flight or buffered, so only offsets and limits are carried and
+ * no data. Loss recovery and congestion control start over in the new
+ * process, with the rtt estimates carried over.
+ */
+struct ServerConnectionSnapshot {
+  struct Stream {
+    StreamId id{0};
+    uint64_t currentWriteOffset{0};
+    uint64_t currentReadOffset{0};
+    uint64_t currentReceiveOffset{0};
+    uint64_t minimumRetransmittableOffset{0};
+    uint64_t maxOffsetObserved{0};
+    folly::Optional<uint64_t> finalWriteOffset;
+    folly::Optional<uint64_t> finalReadOffset;
+    // Index of the state in StreamSendStateData and StreamReceiveStateData.
+    uint8_t sendState{0};
+    uint8_t recvState{0};
+    uint64_t windowSize{0};
+    uint64_t advertisedMaxOffset{0};
+    uint64_t peerAdvertisedMaxOffset{0};
+    Priority priority{kDefaultPriority};
+    bool isControl{false};
+  };
+
+  QuicVersion version{QuicVersion::MVFST};
+  folly::Optional<std::string> alpn;
+  ServerHandshake::OneRttSecrets secrets;
+
+  folly::Optional<ConnectionId> clientConnectionId;
+  folly::Optional<ConnectionId> serverConnectionId;
+  std::vector<ConnectionIdData> selfConnectionIds;
+  std::vector<ConnectionIdData> peerConnectionIds;
+  uint64_t nextSelfConnectionIdSequence{0};
+
+  folly::SocketAddress peerAddress;
+  folly::SocketAddress originalPeerAddress;
+
+  // What was negotiated with the client transport parameters.
+  uint64_t peerAckDelayExponent{kDefaultAckDelayExponent};
+  std::chrono::milliseconds peerIdleTimeout{0};
+  uint64_t udpSendPacketLen{kDefaultUDPSendPacketLen};
+  uint64_t peerActiveConnectionIdLimit{0};
+  bool partialReliabilityEnabled{false};
+
+  PacketNum nextPacketNum{0};
+  folly::Optional<PacketNum> largestReceivedPacketNum;
+
+  uint64_t connWindowSize{0};
+  uint64_t connAdvertisedMaxOffset{0};
+  uint64_t connPeerAdvertisedMaxOffset{0};
+  uint64_t sumCurReadOffset{0};
+  uint64_t sumMaxObservedOffset{0};
+  uint64_t sumCurWriteOffset{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetBidiLocal{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetBidiRemote{0};
+  uint64_t peerAdvertisedInitialMaxStreamOffsetUni{0};
+
+  std::chrono::microseconds srtt{0};
+  std::chrono::microseconds lrtt{0};
+  std::chrono::microseconds rttvar{0};
+  std::chrono::microseconds mrtt{0};
+
+  QuicStreamManager::StreamIdState streamIds;
+  std::vector<Stream> streams;
+};
+
+Buf encodeServerConnectionSnapshot(const ServerConnectionSnapshot& snapshot);
+
+/**
+ * Returns none if the snapshot is malformed or was encoded with another
+ * version of the encoding.
+ */
+folly::Optional<ServerConnectionSnapshot> decodeServerConnectionSnapshot(
+    const folly::IOBuf& buf);
+
+/**
+ * Writes the snapshots to a connected stream socket, usually one end of a unix
+ * socket pair shared with the process taking over, each one prefixed with its
+ * length and the whole followed by a zero length. Blocks until everything is
+ * written. Returns false if the socket failed.
+ */
+bool writeServerConnectionSnapshots(
+    folly::NetworkSocket sock,
+    const std::vector<ServerConnectionSnapshot>& snapshots);
+
+/**
+ * Reads snapshots written by writeServerConnectionSnapshots() until the zero
+ * length that ends them. Blocks until then. Returns none if the socket failed
+ * or a snapshot is malformed.
+ */
+folly::Optional<std::vector<ServerConnectionSnapshot>>
+readServerConnectionSnapshots(folly::NetworkSocket sock);
+} // namespace quic
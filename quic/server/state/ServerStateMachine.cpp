@@ -8,11 +8,14 @@
 
 #include <quic/server/state/ServerStateMachine.h>
 
+#include <folly/ScopeGuard.h>
+
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/handshake/FizzCryptoFactory.h>
 #include <quic/handshake/TransportParameters.h>
 #include <quic/logging/QLoggerConstants.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/QuicPacingFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/QuicTransportStatsCallback.h>
@@ -80,6 +83,158 @@ void recoverOrResetCongestionAndRttState(
     resetCongestionAndRttState(conn);
   }
 }
+
+// Starts sending on the validated standby path too. The congestion
+// controller moves to the secondary path until the next migration.
+void addSecondaryPath(QuicServerConnectionState& conn, StandbyPath& path) {
+  SecondaryPath secondaryPath;
+  secondaryPath.id = conn.nextPathId++;
+  secondaryPath.peerAddress = path.congestionAndRtt.peerAddress;
+  secondaryPath.connId = path.connId;
+  secondaryPath.congestionController =
+      std::move(path.congestionAndRtt.congestionController);
+  secondaryPath.srtt = path.congestionAndRtt.srtt;
+  secondaryPath.lrtt = path.congestionAndRtt.lrtt;
+  secondaryPath.rttvar = path.congestionAndRtt.rttvar;
+  conn.secondaryPaths.push_back(std::move(secondaryPath));
+}
+
+// Sends on all the validated standby paths again after a migration.
+void maybeAddSecondaryPaths(QuicServerConnectionState& conn) {
+  if (!conn.transportSettings.multipathEnabled) {
+    return;
+  }
+  for (auto& path : conn.migrationState.standbyPaths) {
+    if (path.validated && path.congestionAndRtt.congestionController) {
+      addSecondaryPath(conn, path);
+    }
+  }
+}
+
+StandbyPath& addStandbyPath(QuicServerConnectionState& conn, StandbyPath path) {
+  auto& standbyPaths = conn.migrationState.standbyPaths;
+  if (standbyPaths.size() >= kMaxNumStandbyPaths) {
+    standbyPaths.erase(std::min_element(
+        standbyPaths.begin(),
+        standbyPaths.end(),
+        [](const StandbyPath& lhs, const StandbyPath& rhs) {
+          return lhs.congestionAndRtt.recordTime <
+              rhs.congestionAndRtt.recordTime;
+        }));
+  }
+  standbyPaths.push_back(std::move(path));
+  return standbyPaths.back();
+}
+
+// A spare connection id of the client that neither the current path nor
+// another standby path uses, so that the paths can't be linked on the wire.
+folly::Optional<ConnectionId> pickStandbyConnId(
+    const QuicServerConnectionState& conn) {
+  for (const auto& connIdData : conn.peerConnectionIds) {
+    if (conn.clientConnectionId &&
+        connIdData.connId == *conn.clientConnectionId) {
+      continue;
+    }
+    auto& standbyPaths = conn.migrationState.standbyPaths;
+    if (std::none_of(
+            standbyPaths.begin(),
+            standbyPaths.end(),
+            [&](const StandbyPath& path) {
+              return path.connId == connIdData.connId;
+            })) {
+      return connIdData.connId;
+    }
+  }
+  return folly::none;
+}
+
+// Turns the secondary paths back into standby paths. The packets still
+// outstanding on them are no longer accounted for, so their bytes are taken out
+// of the congestion controllers, which the standby paths keep.
+void reclaimSecondaryPaths(QuicServerConnectionState& conn) {
+  for (auto& secondaryPath : conn.secondaryPaths) {
+    auto standbyPath = findStandbyPath(conn, secondaryPath.peerAddress);
+    if (!standbyPath || !secondaryPath.congestionController) {
+      continue;
+    }
+    uint64_t inflightBytes = 0;
+    for (const auto& packet : conn.outstandingPackets) {
+      if (packet.pathId == secondaryPath.id && !packet.pureAck) {
+        inflightBytes += packet.encodedSize;
+      }
+    }
+    if (inflightBytes) {
+      secondaryPath.congestionController->onRemoveBytesFromInflight(
+          inflightBytes);
+    }
+    auto& state = standbyPath->congestionAndRtt;
+    state.congestionController = std::move(secondaryPath.congestionController);
+    state.srtt = secondaryPath.srtt;
+    state.lrtt = secondaryPath.lrtt;
+    state.rttvar = secondaryPath.rttvar;
+  }
+  conn.secondaryPaths.clear();
+}
+
+// Switches to the standby path of newPeerAddress if it is validated and its
+// state isn't stale. Returns false if the migration still has to validate
+// the new path.
+bool migrateToStandbyPath(
+    QuicServerConnectionState& conn,
+    const folly::SocketAddress& newPeerAddress) {
+  auto& standbyPaths = conn.migrationState.standbyPaths;
+  auto it = std::find_if(
+      standbyPaths.begin(),
+      standbyPaths.end(),
+      [&](const StandbyPath& path) {
+        return path.congestionAndRtt.peerAddress == newPeerAddress;
+      });
+  if (it == standbyPaths.end()) {
+    return false;
+  }
+  StandbyPath path = std::move(*it);
+  standbyPaths.erase(it);
+  // The answers to the challenges of the client go out on the new current
+  // path, our own challenge is moot either way.
+  for (auto& frame : path.pendingFrames) {
+    if (frame.asPathResponseFrame()) {
+      conn.pendingEvents.frames.push_back(std::move(frame));
+    }
+  }
+  if (!path.validated ||
+      Clock::now() - path.congestionAndRtt.recordTime >
+          kTimeToRetainLastCongestionAndRttState) {
+    return false;
+  }
+
+  auto& previousPeerAddresses = conn.migrationState.previousPeerAddresses;
+  previousPeerAddresses.erase(
+      std::remove(
+          previousPeerAddresses.begin(),
+          previousPeerAddresses.end(),
+          newPeerAddress),
+      previousPeerAddresses.end());
+  if (conn.outstandingPathValidation || conn.pendingEvents.pathChallenge) {
+    // The current path was never validated, forget about it.
+    conn.pendingEvents.pathChallenge = folly::none;
+    conn.pendingEvents.schedulePathValidationTimeout = false;
+    conn.outstandingPathValidation = folly::none;
+  } else {
+    previousPeerAddresses.push_back(conn.peerAddress);
+    StandbyPath previousPath;
+    previousPath.congestionAndRtt = moveCurrentCongestionAndRttState(conn);
+    previousPath.validated = true;
+    addStandbyPath(conn, std::move(previousPath));
+  }
+  conn.congestionController =
+      std::move(path.congestionAndRtt.congestionController);
+  conn.lossState.srtt = path.congestionAndRtt.srtt;
+  conn.lossState.lrtt = path.congestionAndRtt.lrtt;
+  conn.lossState.rttvar = path.congestionAndRtt.rttvar;
+  conn.writableBytesLimit = folly::none;
+  conn.peerAddress = newPeerAddress;
+  return true;
+}
 } // namespace
 
 void processClientInitialParams(
@@ -111,6 +266,14 @@ void processClientInitialParams(
   auto partialReliability = getIntegerParameter(
       static_cast<TransportParameterId>(kPartialReliabilityParameterId),
       clientParams.parameters);
+  auto minAckDelay = getIntegerParameter(
+      static_cast<TransportParameterId>(kMinAckDelayParameterId),
+      clientParams.parameters);
+  auto maxAckDelay = getIntegerParameter(
+      TransportParameterId::max_ack_delay, clientParams.parameters);
+  auto maxDatagramFrameSize = getIntegerParameter(
+      static_cast<TransportParameterId>(kMaxDatagramFrameSizeParameterId),
+      clientParams.parameters);
   auto activeConnectionIdLimit = getIntegerParameter(
       TransportParameterId::active_connection_id_limit,
       clientParams.parameters);
@@ -154,9 +317,10 @@ void processClientInitialParams(
   }
   conn.peerAckDelayExponent =
       ackDelayExponent.value_or(kDefaultAckDelayExponent);
-  // TODO: udpSendPacketLen should also be limited by PMTU
   if (conn.transportSettings.canIgnorePathMTU) {
     conn.udpSendPacketLen = *packetSize;
+  } else {
+    startPmtuDiscovery(conn, *packetSize);
   }
 
   conn.peerActiveConnectionIdLimit =
@@ -168,6 +332,32 @@ void processClientInitialParams(
   }
   VLOG(10) << "conn.partialReliabilityEnabled="
            << conn.partialReliabilityEnabled;
+
+  // max_ack_delay is in milliseconds, min_ack_delay in microseconds.
+  if (maxAckDelay && *maxAckDelay >= kMaxMaxAckDelay) {
+    throw QuicTransportException(
+        "max_ack_delay too large",
+        TransportErrorCode::TRANSPORT_PARAMETER_ERROR);
+  }
+  auto peerMaxAckDelay = maxAckDelay
+      ? std::chrono::microseconds(std::chrono::milliseconds(*maxAckDelay))
+      : kMaxAckTimeout;
+  if (minAckDelay && *minAckDelay > uint64_t(peerMaxAckDelay.count())) {
+    throw QuicTransportException(
+        "min_ack_delay larger than max ack delay",
+        TransportErrorCode::TRANSPORT_PARAMETER_ERROR);
+  }
+  if (maxAckDelay) {
+    conn.ackFrequencyState.peerMaxAckDelay = peerMaxAckDelay;
+  }
+  if (minAckDelay && conn.transportSettings.ackFrequencyEnabled) {
+    conn.ackFrequencyState.peerMinAckDelay =
+        std::chrono::microseconds(*minAckDelay);
+  }
+
+  if (maxDatagramFrameSize && conn.transportSettings.maxDatagramFrameSize) {
+    conn.datagramState.maxWriteFrameSize = *maxDatagramFrameSize;
+  }
 }
 
 void updateHandshakeState(QuicServerConnectionState& conn) {
@@ -233,6 +423,12 @@ void updateHandshakeState(QuicServerConnectionState& conn) {
     conn.writableBytesLimit = folly::none;
     conn.readCodec->setOneRttReadCipher(std::move(oneRttReadCipher));
   }
+  auto oneRttKeyUpdater = handshakeLayer->getOneRttKeyUpdater();
+  if (oneRttKeyUpdater && conn.transportSettings.keyUpdateEnabled &&
+      !conn.transportSettings.allowConnectionTakeover &&
+      conn.transportSettings.hibernationTimeout == 0ms) {
+    conn.oneRttKeyUpdate.updater = std::move(oneRttKeyUpdater);
+  }
   auto handshakeWriteCipher = handshakeLayer->getHandshakeWriteCipher();
   auto handshakeReadCipher = handshakeLayer->getHandshakeReadCipher();
   if (handshakeWriteCipher) {
@@ -287,8 +483,11 @@ bool validateAndUpdateSourceToken(
         break;
       case ZeroRttSourceTokenMatchingPolicy::LIMIT_IF_NO_EXACT_MATCH:
         acceptZeroRtt = true;
-        conn.writableBytesLimit =
-            conn.transportSettings.limitedCwndInMss * conn.udpSendPacketLen;
+        // The NEW_TOKEN token already validated the address.
+        if (!conn.newTokenValidated) {
+          conn.writableBytesLimit =
+              conn.transportSettings.limitedCwndInMss * conn.udpSendPacketLen;
+        }
         break;
     }
   }
@@ -354,6 +553,14 @@ void onConnectionMigration(
   }
   ++conn.migrationState.numMigrations;
 
+  // Secondary paths are relative to the current peer address.
+  reclaimSecondaryPaths(conn);
+  if (conn.transportSettings.enableStandbyPaths &&
+      migrateToStandbyPath(conn, newPeerAddress)) {
+    maybeAddSecondaryPaths(conn);
+    return;
+  }
+
   auto& previousPeerAddresses = conn.migrationState.previousPeerAddresses;
   auto it = std::find(
       previousPeerAddresses.begin(),
@@ -398,8 +605,99 @@ void onConnectionMigration(
       conn.migrationState.lastCongestionAndRtt = std::move(state);
     }
   }
+  if (!isNATRebinding) {
+    restartPmtuDiscovery(conn);
+  }
 
   conn.peerAddress = newPeerAddress;
+  maybeAddSecondaryPaths(conn);
+}
+
+StandbyPath* findStandbyPath(
+    QuicServerConnectionState& conn,
+    const folly::SocketAddress& peerAddress) {
+  for (auto& path : conn.migrationState.standbyPaths) {
+    if (path.congestionAndRtt.peerAddress == peerAddress) {
+      return &path;
+    }
+  }
+  return nullptr;
+}
+
+void onStandbyPathFrame(
+    QuicServerConnectionState& conn,
+    const folly::SocketAddress& peerAddress,
+    const QuicSimpleFrame& frame) {
+  auto path = findStandbyPath(conn, peerAddress);
+  switch (frame.type()) {
+    case QuicSimpleFrame::Type::PathChallengeFrame_E: {
+      if (!path) {
+        StandbyPath newPath;
+        newPath.congestionAndRtt.peerAddress = peerAddress;
+        newPath.connId = pickStandbyConnId(conn);
+        path = &addStandbyPath(conn, std::move(newPath));
+      }
+      path->congestionAndRtt.recordTime = Clock::now();
+      // Only the latest challenge is answered.
+      auto& frames = path->pendingFrames;
+      frames.erase(
+          std::remove_if(
+              frames.begin(),
+              frames.end(),
+              [](const QuicSimpleFrame& pendingFrame) {
+                return pendingFrame.asPathResponseFrame() != nullptr;
+              }),
+          frames.end());
+      frames.emplace_back(
+          PathResponseFrame(frame.asPathChallengeFrame()->pathData));
+      if (path->validated) {
+        break;
+      }
+      if (!path->outstandingChallenge) {
+        uint64_t pathData;
+        folly::Random::secureRandom(&pathData, sizeof(pathData));
+        path->outstandingChallenge = PathChallengeFrame(pathData);
+      }
+      // Probes aren't retransmitted, so the challenge goes out again with
+      // every answer until the path is validated.
+      QuicSimpleFrame challenge(*path->outstandingChallenge);
+      if (std::find(frames.begin(), frames.end(), challenge) == frames.end()) {
+        frames.push_back(std::move(challenge));
+      }
+      break;
+    }
+    case QuicSimpleFrame::Type::PathResponseFrame_E: {
+      if (!path || !path->outstandingChallenge ||
+          !path->challengeSentTime ||
+          frame.asPathResponseFrame()->pathData !=
+              path->outstandingChallenge->pathData) {
+        break;
+      }
+      auto now = Clock::now();
+      auto rttSample = std::chrono::duration_cast<std::chrono::microseconds>(
+          now - *path->challengeSentTime);
+      auto& state = path->congestionAndRtt;
+      state.recordTime = now;
+      state.srtt = rttSample;
+      state.lrtt = rttSample;
+      state.rttvar = rttSample / 2;
+      CHECK(conn.congestionControllerFactory)
+          << "CongestionControllerFactory is not set.";
+      state.congestionController =
+          conn.congestionControllerFactory->makeCongestionController(
+              conn, conn.transportSettings.defaultCongestionController);
+      path->validated = true;
+      path->outstandingChallenge = folly::none;
+      path->challengeSentTime = folly::none;
+      VLOG(4) << "Validated standby path " << peerAddress << " " << conn;
+      if (conn.transportSettings.multipathEnabled) {
+        addSecondaryPath(conn, *path);
+      }
+      break;
+    }
+    default:
+      break;
+  }
 }
 
 void onServerReadData(
@@ -439,8 +737,7 @@ void handleCipherUnavailable(
   }
 
   size_t combinedSize =
-      (conn.pendingZeroRttData ? conn.pendingZeroRttData->size() : 0) +
-      (conn.pendingOneRttData ? conn.pendingOneRttData->size() : 0);
+      conn.pendingZeroRttData.size() + conn.pendingOneRttData.size();
   if (combinedSize >= conn.transportSettings.maxPacketsToBuffer) {
     VLOG(10) << "drop because max buffered " << conn;
     if (conn.qLogger) {
@@ -453,7 +750,7 @@ void handleCipherUnavailable(
   auto& pendingData = originalData->protectionType == ProtectionType::ZeroRtt
       ? conn.pendingZeroRttData
       : conn.pendingOneRttData;
-  if (pendingData) {
+  if (pendingData.isOpen()) {
     QUIC_TRACE(
         packet_buffered,
         conn,
@@ -467,11 +764,14 @@ void handleCipherUnavailable(
     ServerEvents::ReadData pendingReadData;
     pendingReadData.peer = readData.peer;
     pendingReadData.networkData = NetworkData(
-        std::move(originalData->packet), readData.networkData.receiveTimePoint);
-    pendingData->emplace_back(std::move(pendingReadData));
+        std::move(originalData->packet),
+        readData.networkData.receiveTimePoint,
+        readData.networkData.ecn);
+    pendingData.add(
+        std::move(pendingReadData), conn.transportSettings.maxPacketsToBuffer);
     VLOG(10) << "Adding pending data to "
              << toString(originalData->protectionType)
-             << " buffer size=" << pendingData->size() << " " << conn;
+             << " buffer size=" << pendingData.size() << " " << conn;
   } else {
     VLOG(10) << "drop because " << toString(originalData->protectionType)
              << " buffer no longer available " << conn;
@@ -486,16 +786,24 @@ void onServerReadDataFromOpen(
     QuicServerConnectionState& conn,
     ServerEvents::ReadData& readData) {
   CHECK_EQ(conn.state, ServerState::Open);
+  auto& parsedAhead = readData.networkData.parsedPacket;
   // Don't bother parsing if the data is empty.
-  if (!readData.networkData.data ||
-      readData.networkData.data->computeChainDataLength() == 0) {
+  if (!parsedAhead &&
+      (!readData.networkData.data ||
+       readData.networkData.data->computeChainDataLength() == 0)) {
     return;
   }
+  // Taken by the first parse, it doesn't apply to the coalesced packets.
+  auto longHeaderInvariant =
+      std::move(readData.networkData.longHeaderInvariant);
+  readData.networkData.longHeaderInvariant.clear();
   if (!conn.readCodec) {
     // First packet from the peer
     folly::io::Cursor cursor(readData.networkData.data.get());
     auto initialByte = cursor.readBE<uint8_t>();
-    auto parsedLongHeader = parseLongHeaderInvariant(initialByte, cursor);
+    auto parsedLongHeader = longHeaderInvariant
+        ? folly::makeExpected<TransportErrorCode>(*longHeaderInvariant)
+        : parseLongHeaderInvariant(initialByte, cursor);
     if (!parsedLongHeader) {
       VLOG(4) << "Could not parse initial packet header";
       if (conn.qLogger) {
@@ -565,12 +873,25 @@ void onServerReadDataFromOpen(
             conn.transportSettings.ackDelayExponent,
             conn.transportSettings.maxRecvPacketSize,
             conn.transportSettings.partialReliabilityEnabled,
-            *newServerConnIdData->token));
+            *newServerConnIdData->token,
+            conn.originalConnectionId,
+            conn.transportSettings.ackFrequencyEnabled
+                ? folly::make_optional(conn.transportSettings.minAckDelay)
+                : folly::none,
+            conn.transportSettings.maxDatagramFrameSize,
+            conn.transportParametersCache,
+            conn.transportSettings.adaptiveAcks
+                ? folly::make_optional(conn.transportSettings.maxAckDelay)
+                : folly::none));
     conn.transportParametersEncoded = true;
     CryptoFactory& cryptoFactory = *conn.serverHandshakeLayer->cryptoFactory_;
+    InitialCipherCache* cipherCache = conn.initialCipherCache.get();
     conn.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
-    conn.readCodec->setInitialReadCipher(cryptoFactory.getClientInitialCipher(
-        initialDestinationConnectionId, version));
+    conn.readCodec->setInitialReadCipher(
+        cipherCache ? cipherCache->getClientInitialCipher(
+                          initialDestinationConnectionId, version)
+                    : cryptoFactory.getClientInitialCipher(
+                          initialDestinationConnectionId, version));
     conn.readCodec->setClientConnectionId(clientConnectionId);
     conn.readCodec->setServerConnectionId(*conn.serverConnectionId);
     if (conn.qLogger) {
@@ -579,24 +900,55 @@ void onServerReadDataFromOpen(
     }
     conn.readCodec->setCodecParameters(
         CodecParameters(conn.peerAckDelayExponent, version));
-    conn.initialWriteCipher = cryptoFactory.getServerInitialCipher(
-        initialDestinationConnectionId, version);
+    conn.initialWriteCipher = cipherCache
+        ? cipherCache->getServerInitialCipher(
+              initialDestinationConnectionId, version)
+        : cryptoFactory.getServerInitialCipher(
+              initialDestinationConnectionId, version);
 
     conn.readCodec->setInitialHeaderCipher(
-        cryptoFactory.makeClientInitialHeaderCipher(
-            initialDestinationConnectionId, version));
-    conn.initialHeaderCipher = cryptoFactory.makeServerInitialHeaderCipher(
-        initialDestinationConnectionId, version);
+        cipherCache ? cipherCache->makeClientInitialHeaderCipher(
+                          initialDestinationConnectionId, version)
+                    : cryptoFactory.makeClientInitialHeaderCipher(
+                          initialDestinationConnectionId, version));
+    conn.initialHeaderCipher = cipherCache
+        ? cipherCache->makeServerInitialHeaderCipher(
+              initialDestinationConnectionId, version)
+        : cryptoFactory.makeServerInitialHeaderCipher(
+              initialDestinationConnectionId, version);
     conn.peerAddress = conn.originalPeerAddress;
   }
   folly::IOBufQueue udpData{folly::IOBufQueue::cacheChainLength()};
-  udpData.append(std::move(readData.networkData.data));
+  if (readData.networkData.data) {
+    udpData.append(std::move(readData.networkData.data));
+  }
   for (uint16_t processedPackets = 0;
-       !udpData.empty() && processedPackets < kMaxNumCoalescedPackets;
+       (!udpData.empty() || parsedAhead) &&
+       processedPackets < kMaxNumCoalescedPackets;
        processedPackets++) {
     size_t dataSize = udpData.chainLength();
-    auto parsedPacket = conn.readCodec->parsePacket(udpData, conn.ackStates);
-    size_t packetSize = dataSize - udpData.chainLength();
+    bool wasParsedAhead = parsedAhead.hasValue();
+    auto parsedPacket = [&] {
+      if (parsedAhead) {
+        auto result = std::move(*parsedAhead);
+        parsedAhead.clear();
+        return result;
+      }
+      QuicLatencySampler sampler(
+          conn.infoCallback,
+          QuicTransportStatsCallback::LatencyType::PACKET_DECODE);
+      QuicCpuCostSampler cpuCostSampler(
+          conn, QuicTransportStatsCallback::CpuCostType::PACKET_DECODE);
+      auto invariant = std::move(longHeaderInvariant);
+      longHeaderInvariant.clear();
+      return conn.readCodec->parsePacket(
+          udpData,
+          conn.ackStates,
+          kDefaultConnectionIdSize,
+          std::move(invariant));
+    }();
+    size_t packetSize = wasParsedAhead ? readData.networkData.parsedPacketSize
+                                       : dataSize - udpData.chainLength();
 
     switch (parsedPacket.type()) {
       case CodecResult::Type::CIPHER_UNAVAILABLE: {
@@ -647,6 +999,11 @@ void onServerReadDataFromOpen(
 
     // TODO: enforce constraints on other protection levels.
     auto& regularPacket = *regularOptional;
+    SCOPE_EXIT {
+      if (conn.readCodec) {
+        conn.readCodec->recycleFrames(std::move(regularPacket.frames));
+      }
+    };
 
     bool isProtectedPacket = protectionLevel == ProtectionType::ZeroRtt ||
         protectionLevel == ProtectionType::KeyPhaseZero ||
@@ -683,6 +1040,12 @@ void onServerReadDataFromOpen(
       conn.qLogger->scid = conn.serverConnectionId;
     }
     QUIC_TRACE(packet_recvd, conn, packetNum, packetSize);
+    QUIC_SDT(
+        packet_received,
+        conn,
+        static_cast<uint8_t>(regularPacket.header.getPacketNumberSpace()),
+        packetNum,
+        packetSize);
     // We assume that the higher layer takes care of validating that the version
     // is supported.
     if (!conn.version) {
@@ -694,6 +1057,23 @@ void onServerReadDataFromOpen(
       conn.version = longHeader->getVersion();
     }
 
+    auto& ackState = getAckState(conn, packetNumberSpace);
+    if (conn.transportSettings.dropDuplicatePackets &&
+        !ackState.receivedPackets.insert(packetNum)) {
+      VLOG(4) << "Dropping duplicate packet=" << packetNum << " " << conn;
+      if (conn.qLogger) {
+        conn.qLogger->addPacketDrop(
+            packetSize,
+            QuicTransportStatsCallback::toString(
+                PacketDropReason::DUPLICATE_PACKET));
+      }
+      QUIC_STATS(
+          conn.infoCallback,
+          onPacketDropped,
+          PacketDropReason::DUPLICATE_PACKET);
+      continue;
+    }
+
     if (conn.peerAddress != readData.peer) {
       if (packetNumberSpace != PacketNumberSpace::AppData) {
         if (conn.qLogger) {
@@ -727,9 +1107,11 @@ void onServerReadDataFromOpen(
       }
     }
 
-    auto& ackState = getAckState(conn, packetNumberSpace);
     auto outOfOrder = updateLargestReceivedPacketNum(
-        ackState, packetNum, readData.networkData.receiveTimePoint);
+        ackState,
+        packetNum,
+        readData.networkData.receiveTimePoint,
+        readData.networkData.ecn);
     DCHECK(hasReceivedPackets(conn));
 
     bool pktHasRetransmittableData = false;
@@ -961,9 +1343,24 @@ void onServerReadDataFromOpen(
         case QuicFrame::Type::PaddingFrame_E: {
           break;
         }
+        case QuicFrame::Type::ReadDatagramFrame_E: {
+          VLOG(10) << "Server received datagram " << conn;
+          pktHasRetransmittableData = true;
+          isNonProbingPacket = true;
+          onDatagramReceived(
+              conn, std::move(*quicFrame.asReadDatagramFrame()));
+          break;
+        }
         case QuicFrame::Type::QuicSimpleFrame_E: {
           pktHasRetransmittableData = true;
           QuicSimpleFrame& simpleFrame = *quicFrame.asQuicSimpleFrame();
+          if (conn.transportSettings.enableStandbyPaths &&
+              readData.peer != conn.peerAddress &&
+              (simpleFrame.asPathChallengeFrame() ||
+               simpleFrame.asPathResponseFrame())) {
+            onStandbyPathFrame(conn, readData.peer, simpleFrame);
+            break;
+          }
           isNonProbingPacket |= updateSimpleFrameOnPacketReceived(
               conn, simpleFrame, packetNum, readData.peer != conn.peerAddress);
           break;
@@ -978,6 +1375,16 @@ void onServerReadDataFromOpen(
     // that if we haven't decided whether or not to validate the peer, we won't
     // increase the limit.
     updateWritableByteLimitOnRecvPacket(conn);
+    // Only a client that got our Initial has the Handshake keys. The limit
+    // set for a migration to an unvalidated path is lifted by its path
+    // response instead.
+    if (conn.transportSettings.validateAddressOnHandshakePacket &&
+        conn.writableBytesLimit &&
+        encryptionLevel == EncryptionLevel::Handshake &&
+        !conn.outstandingPathValidation && conn.peerAddress == readData.peer) {
+      VLOG(10) << "Validated client address with a handshake packet " << conn;
+      conn.writableBytesLimit = folly::none;
+    }
 
     if (conn.peerAddress != readData.peer) {
       // TODO use new conn id, make sure the other endpoint has new conn id
@@ -985,7 +1392,7 @@ void onServerReadDataFromOpen(
         if (packetNum == ackState.largestReceivedPacketNum) {
           onConnectionMigration(conn, readData.peer);
         }
-      } else {
+      } else if (!conn.transportSettings.enableStandbyPaths) {
         // Server will need to response with PathResponse to the new address
         // while not updating peerAddress to new address
         if (conn.qLogger) {
@@ -1044,9 +1451,14 @@ void onServerReadDataFromClosed(
     QuicServerConnectionState& conn,
     ServerEvents::ReadData& readData) {
   CHECK_EQ(conn.state, ServerState::Closed);
+  auto& parsedAhead = readData.networkData.parsedPacket;
   folly::IOBufQueue udpData{folly::IOBufQueue::cacheChainLength()};
-  udpData.append(std::move(readData.networkData.data));
-  auto packetSize = udpData.empty() ? 0 : udpData.chainLength();
+  if (readData.networkData.data) {
+    udpData.append(std::move(readData.networkData.data));
+  }
+  auto packetSize = parsedAhead
+      ? readData.networkData.parsedPacketSize
+      : (udpData.empty() ? 0 : udpData.chainLength());
   if (!conn.readCodec) {
     // drop data. We closed before we even got the first packet. This is
     // normally not possible but might as well.
@@ -1078,7 +1490,19 @@ void onServerReadDataFromClosed(
         PacketDropReason::SERVER_STATE_CLOSED);
     return;
   }
-  auto parsedPacket = conn.readCodec->parsePacket(udpData, conn.ackStates);
+  auto parsedPacket = [&] {
+    if (parsedAhead) {
+      auto result = std::move(*parsedAhead);
+      parsedAhead.clear();
+      return result;
+    }
+    QuicLatencySampler sampler(
+        conn.infoCallback,
+        QuicTransportStatsCallback::LatencyType::PACKET_DECODE);
+    QuicCpuCostSampler cpuCostSampler(
+        conn, QuicTransportStatsCallback::CpuCostType::PACKET_DECODE);
+    return conn.readCodec->parsePacket(udpData, conn.ackStates);
+  }();
   switch (parsedPacket.type()) {
     case CodecResult::Type::CIPHER_UNAVAILABLE: {
       VLOG(10) << "drop cipher unavailable " << conn;
@@ -1129,6 +1553,12 @@ void onServerReadDataFromClosed(
     conn.qLogger->addPacket(regularPacket, packetSize);
   }
   QUIC_TRACE(packet_recvd, conn, packetNum, packetSize);
+  QUIC_SDT(
+      packet_received,
+      conn,
+      static_cast<uint8_t>(pnSpace),
+      packetNum,
+      packetSize);
 
   bool isProtectedPacket = protectionLevel == ProtectionType::ZeroRtt ||
       protectionLevel == ProtectionType::KeyPhaseZero ||
@@ -1210,9 +1640,21 @@ QuicServerConnectionState::createAndAddNewSelfConnId() {
 
   CHECK(transportSettings.statelessResetTokenSecret);
 
-  StatelessResetGenerator generator(
-      transportSettings.statelessResetTokenSecret.value(),
-      serverAddr.getFullyQualified());
+  if (connectionIdPool) {
+    auto newConnIdData =
+        connectionIdPool->take(nextSelfConnectionIdSequence++);
+    selfConnectionIds.push_back(newConnIdData);
+    return newConnIdData;
+  }
+
+  if (!statelessResetGenerator) {
+    statelessResetGenerator = std::make_unique<StatelessResetGenerator>(
+        transportSettings.statelessResetTokenSecret.value(),
+        serverAddr.getFullyQualified(),
+        transportSettings.statelessResetAesTokens
+            ? StatelessResetGenerator::Algorithm::AES
+            : StatelessResetGenerator::Algorithm::HKDF);
+  }
 
   // TODO Possibly change this mechanism later
   // The default connectionId algo has 36 bits of randomness.
@@ -1220,7 +1662,8 @@ QuicServerConnectionState::createAndAddNewSelfConnId() {
       ConnectionIdData{connIdAlgo->encodeConnectionId(*serverConnIdParams),
                        nextSelfConnectionIdSequence++};
 
-  newConnIdData.token = generator.generateToken(newConnIdData.connId);
+  newConnIdData.token =
+      statelessResetGenerator->generateToken(newConnIdData.connId);
   selfConnectionIds.push_back(newConnIdData);
   return newConnIdData;
 }
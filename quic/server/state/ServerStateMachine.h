@@ -10,6 +10,7 @@
 
 #include <glog/logging.h>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <quic/QuicException.h>
@@ -19,7 +20,11 @@
 #include <quic/flowcontrol/QuicFlowController.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/server/handshake/InitialCipherCache.h>
+#include <quic/server/handshake/RetryTokenGenerator.h>
 #include <quic/server/handshake/ServerHandshake.h>
+#include <quic/server/handshake/StatelessResetGenerator.h>
+#include <quic/server/state/ConnectionIdPool.h>
 #include <quic/state/AckHandlers.h>
 #include <quic/state/QPRFunctions.h>
 #include <quic/state/QuicStateFunctions.h>
@@ -50,6 +55,47 @@ struct ServerEvents {
   struct Close {};
 };
 
+/**
+ * The packets of one encryption level that can't be read until its keys are
+ * available. Nothing is allocated until the first packet is buffered, which
+ * then reserves room for all the packets that may be buffered, so buffering
+ * never moves them around. The buffer is closed for good once its packets are
+ * taken, the packets that arrive after that are dropped.
+ */
+class PendingPacketBuffer {
+ public:
+  bool isOpen() const {
+    return open_;
+  }
+
+  bool empty() const {
+    return packets_.empty();
+  }
+
+  size_t size() const {
+    return packets_.size();
+  }
+
+  // capacity is the most packets the buffer is going to hold.
+  void add(ServerEvents::ReadData readData, size_t capacity) {
+    DCHECK(open_);
+    if (packets_.capacity() == 0) {
+      packets_.reserve(capacity);
+    }
+    packets_.push_back(std::move(readData));
+  }
+
+  // Closes the buffer and returns its packets.
+  std::vector<ServerEvents::ReadData> take() {
+    open_ = false;
+    return std::exchange(packets_, std::vector<ServerEvents::ReadData>());
+  }
+
+ private:
+  bool open_{true};
+  std::vector<ServerEvents::ReadData> packets_;
+};
+
 struct CongestionAndRttState {
   // The corresponding peer address
   folly::SocketAddress peerAddress;
@@ -68,6 +114,29 @@ struct CongestionAndRttState {
   std::chrono::microseconds rttvar;
 };
 
+// A peer address the client probed without migrating to it, or a validated
+// peer address it migrated away from. Only kept when
+// TransportSettings::enableStandbyPaths is set.
+struct StandbyPath {
+  // The congestion controller is made once the path is validated, and the
+  // rtt stats start from the rtt of the path challenge. recordTime is when
+  // the client last probed the path, or when it migrated away from it.
+  CongestionAndRttState congestionAndRtt;
+
+  // Peer connection id the probes to the path use, the current one if none.
+  folly::Optional<ConnectionId> connId;
+
+  // PATH_CHALLENGE sent on the path that hasn't been answered yet, and when
+  // it was last sent.
+  folly::Optional<PathChallengeFrame> outstandingChallenge;
+  folly::Optional<TimePoint> challengeSentTime;
+
+  bool validated{false};
+
+  // Frames for the next probe written to the path.
+  std::vector<QuicSimpleFrame> pendingFrames;
+};
+
 struct ConnectionMigrationState {
   uint32_t numMigrations{0};
 
@@ -76,6 +145,9 @@ struct ConnectionMigrationState {
 
   // Congestion state and rtt stats of last validated peer
   folly::Optional<CongestionAndRttState> lastCongestionAndRtt;
+
+  // At most kMaxNumStandbyPaths, none of them the current peer address
+  std::vector<StandbyPath> standbyPaths;
 };
 
 struct QuicServerConnectionState : public QuicConnectionStateBase {
@@ -85,9 +157,9 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
 
   // Data which we cannot read yet, because the handshake has not completed.
   // Zero rtt protected packets
-  std::unique_ptr<std::vector<ServerEvents::ReadData>> pendingZeroRttData;
+  PendingPacketBuffer pendingZeroRttData;
   // One rtt protected packets
-  std::unique_ptr<std::vector<ServerEvents::ReadData>> pendingOneRttData;
+  PendingPacketBuffer pendingOneRttData;
 
   // Current state of connection migration
   ConnectionMigrationState migrationState;
@@ -103,8 +175,28 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
   // Address with higher index is more recently used.
   std::vector<folly::IPAddress> tokenSourceAddresses;
 
+  // Whether the client sent the token of a NEW_TOKEN frame of a previous
+  // connection from its current ip, which validates its address.
+  bool newTokenValidated{false};
+
+  // Generates the token of the NEW_TOKEN frame sent once the handshake is
+  // done, if the worker issues them.
+  std::shared_ptr<const RetryTokenGenerator> newTokenGenerator;
+
   ServerHandshake* serverHandshakeLayer;
 
+  // Initial keys cache of the worker, if it has one. The Initial ciphers are
+  // derived from the crypto factory of the handshake otherwise.
+  std::shared_ptr<InitialCipherCache> initialCipherCache;
+
+  // The transport parameters encoded by the previous handshakes of the
+  // worker. They are all encoded by the handshake otherwise.
+  std::shared_ptr<ServerTransportParametersCache> transportParametersCache;
+
+  // Connection ids encoded ahead of time by the worker, if it has a pool.
+  // The ids are encoded here otherwise.
+  ConnectionIdPool::SharedPtr connectionIdPool;
+
   // Whether transport parameters from psk match current server parameters.
   // A false value indicates 0-rtt is rejected.
   folly::Optional<bool> transportParamsMatching;
@@ -114,9 +206,23 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
   // limited until CFIN depending on matching policy.
   folly::Optional<bool> sourceTokenMatching;
 
+  // Congestion state of the ticket the connection resumed from, set when 0-rtt
+  // was accepted and TransportSettings::congestionStateInTicket is set. The
+  // transport clears it once it applied it.
+  folly::Optional<TicketCongestionState> ticketCongestionState;
+
   // Server address of VIP. Currently used as input for stateless reset token.
   folly::SocketAddress serverAddr;
 
+  // Generates the stateless reset tokens of the new connection ids, made with
+  // the first one.
+  std::unique_ptr<StatelessResetGenerator> statelessResetGenerator;
+
+  // Destination connection id of the client's first Initial, set when the
+  // client was sent a Retry. Echoed in the original_connection_id transport
+  // parameter.
+  folly::Optional<ConnectionId> originalConnectionId;
+
   folly::Optional<ConnectionIdData> createAndAddNewSelfConnId() override;
 
   QuicServerConnectionState() : QuicConnectionStateBase(QuicNodeType::Server) {
@@ -135,9 +241,6 @@ struct QuicServerConnectionState : public QuicConnectionStateBase {
     // We shouldn't normally need to set this until we're starting the
     // transport, however writing unit tests is much easier if we set this here.
     updateFlowControlStateWithSettings(flowControlState, transportSettings);
-    pendingZeroRttData =
-        std::make_unique<std::vector<ServerEvents::ReadData>>();
-    pendingOneRttData = std::make_unique<std::vector<ServerEvents::ReadData>>();
     streamManager = std::make_unique<QuicStreamManager>(
         *this, this->nodeType, transportSettings);
   }
@@ -188,4 +291,19 @@ void updateTransportParamsFromTicket(
 void onConnectionMigration(
     QuicServerConnectionState& conn,
     const folly::SocketAddress& newPeerAddress);
+
+/**
+ * Handles a PATH_CHALLENGE or PATH_RESPONSE frame received from peerAddress,
+ * which isn't the current peer address, when standby paths are enabled. A
+ * challenge is answered on the path, together with a challenge of our own
+ * until the path is validated.
+ */
+void onStandbyPathFrame(
+    QuicServerConnectionState& conn,
+    const folly::SocketAddress& peerAddress,
+    const QuicSimpleFrame& frame);
+
+StandbyPath* findStandbyPath(
+    QuicServerConnectionState& conn,
+    const folly::SocketAddress& peerAddress);
 } // namespace quic
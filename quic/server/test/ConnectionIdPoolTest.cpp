@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ConnectionIdPool.h>
+
+#include <folly/container/F14Set.h>
+#include <folly/portability/GTest.h>
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class ConnectionIdPoolTest : public Test {
+ protected:
+  std::shared_ptr<ConnectionIdPool> makePool(size_t capacity) {
+    return std::make_shared<ConnectionIdPool>(
+        &evb_,
+        &connIdAlgo_,
+        params_,
+        std::make_unique<StatelessResetGenerator>(secret_, address_),
+        capacity);
+  }
+
+  void expectValid(const ConnectionIdData& connIdData) {
+    auto params = connIdAlgo_.parseConnectionId(connIdData.connId);
+    EXPECT_EQ(params_.hostId, params.hostId);
+    EXPECT_EQ(params_.processId, params.processId);
+    EXPECT_EQ(params_.workerId, params.workerId);
+    ASSERT_TRUE(connIdData.token.hasValue());
+    StatelessResetGenerator generator(secret_, address_);
+    EXPECT_EQ(generator.generateToken(connIdData.connId), *connIdData.token);
+  }
+
+  folly::EventBase evb_;
+  DefaultConnectionIdAlgo connIdAlgo_;
+  ServerConnectionIdParams params_{5, 1, 7};
+  StatelessResetSecret secret_{{0x01, 0x02, 0x03, 0x04}};
+  std::string address_{"1.2.3.4:443"};
+};
+
+TEST_F(ConnectionIdPoolTest, FillsInTheLoop) {
+  auto pool = makePool(kConnectionIdPoolRefillBatch * 2 + 1);
+  EXPECT_EQ(0, pool->size());
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(kConnectionIdPoolRefillBatch, pool->size());
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(kConnectionIdPoolRefillBatch * 2, pool->size());
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(pool->capacity(), pool->size());
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(pool->capacity(), pool->size());
+}
+
+TEST_F(ConnectionIdPoolTest, Take) {
+  auto pool = makePool(4);
+  pool->fill();
+  EXPECT_EQ(4, pool->size());
+  folly::F14FastSet<ConnectionId, ConnectionIdHash> connIds;
+  for (uint64_t sequenceNumber = 0; sequenceNumber < 4; sequenceNumber++) {
+    auto connIdData = pool->take(sequenceNumber);
+    EXPECT_EQ(sequenceNumber, connIdData.sequenceNumber);
+    expectValid(connIdData);
+    EXPECT_TRUE(connIds.insert(connIdData.connId).second);
+  }
+  EXPECT_EQ(0, pool->size());
+  EXPECT_EQ(0, pool->numMisses());
+
+  // Refilled in the background.
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+  EXPECT_EQ(4, pool->size());
+}
+
+TEST_F(ConnectionIdPoolTest, TakeWhenEmpty) {
+  auto pool = makePool(4);
+  auto connIdData = pool->take(1);
+  EXPECT_EQ(1, connIdData.sequenceNumber);
+  expectValid(connIdData);
+  EXPECT_EQ(1, pool->numMisses());
+  EXPECT_EQ(0, pool->size());
+}
+
+TEST_F(ConnectionIdPoolTest, DestroyedBeforeFilling) {
+  auto pool = makePool(4);
+  pool.reset();
+  evb_.loopOnce(EVLOOP_NONBLOCK);
+}
+} // namespace test
+} // namespace quic
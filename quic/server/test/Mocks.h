@@ -61,6 +61,8 @@ class MockWorkerCallback : public QuicServerWorker::WorkerCallback {
           std::unique_ptr<RoutingData>&,
           std::unique_ptr<NetworkData>&));
 
+  MOCK_METHOD2(handOffConnection, void(uint8_t, ServerConnectionSnapshot));
+
   void routeDataToWorker(
       const folly::SocketAddress& client,
       RoutingData&& routingDataIn,
@@ -109,5 +111,25 @@ class MockRoutingCallback : public QuicServerTransport::RoutingCallback {
           QuicServerTransport*,
           const QuicServerTransport::SourceIdentity&,
           const std::vector<ConnectionIdData>& connIdData));
+
+  bool onConnectionDraining(
+      const std::vector<ConnectionIdData>& connIdData,
+      const folly::SocketAddress& peerAddress,
+      Buf closePacket,
+      std::chrono::milliseconds drainPeriod) noexcept override {
+    return onConnectionDraining(
+        connIdData, peerAddress, closePacket.get(), drainPeriod);
+  }
+
+  GMOCK_METHOD4_(
+      ,
+      noexcept,
+      ,
+      onConnectionDraining,
+      bool(
+          const std::vector<ConnectionIdData>&,
+          const folly::SocketAddress&,
+          const folly::IOBuf*,
+          std::chrono::milliseconds));
 };
 } // namespace quic
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/NewConnectionBalancer.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/common/test/TestUtils.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+class NewConnectionBalancerTest : public Test {
+ public:
+  NewConnectionBalancerTest()
+      : balancer_(2, 10, [this](size_t workerId) { return loads_[workerId]; }),
+        source_(
+            folly::SocketAddress("1.2.3.4", 1234),
+            getTestConnectionId()) {}
+
+ protected:
+  std::array<uint64_t, 2> loads_{};
+  NewConnectionBalancer balancer_;
+  QuicServerTransport::SourceIdentity source_;
+};
+
+TEST_F(NewConnectionBalancerTest, StaysWhenBalanced) {
+  loads_ = {19, 10};
+  EXPECT_EQ(0, balancer_.pickWorker(0, source_, true, Clock::now()));
+  EXPECT_EQ(0, balancer_.numRedirected(0));
+}
+
+TEST_F(NewConnectionBalancerTest, MovesWhenImbalanced) {
+  auto now = Clock::now();
+  loads_ = {20, 10};
+  EXPECT_EQ(1, balancer_.pickWorker(0, source_, true, now));
+  EXPECT_EQ(1, balancer_.numRedirected(0));
+
+  // The following packets of the client follow, even once balanced.
+  loads_ = {10, 20};
+  EXPECT_EQ(1, balancer_.pickWorker(0, source_, false, now + 1ms));
+  EXPECT_EQ(1, balancer_.pickWorker(0, source_, true, now + 1ms));
+  EXPECT_EQ(1, balancer_.numRedirected(0));
+
+  // Until the decision expires.
+  auto later = now + kNewConnectionRedirectLifetime;
+  EXPECT_EQ(0, balancer_.pickWorker(0, source_, false, later));
+}
+
+TEST_F(NewConnectionBalancerTest, OnlyInitialsMove) {
+  loads_ = {20, 0};
+  EXPECT_EQ(0, balancer_.pickWorker(0, source_, false, Clock::now()));
+}
+
+TEST(NewConnectionBalancerSingleWorkerTest, Stays) {
+  NewConnectionBalancer balancer(1, 1, [](size_t) { return 100; });
+  auto source =
+      std::make_pair(folly::SocketAddress("1.2.3.4", 1234), ConnectionId({1}));
+  EXPECT_EQ(0, balancer.pickWorker(0, source, true, Clock::now()));
+}
+} // namespace test
+} // namespace quic
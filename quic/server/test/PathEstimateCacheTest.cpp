@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/PathEstimateCache.h>
+
+#include <folly/portability/GMock.h>
+#include <folly/portability/GTest.h>
+#include <quic/state/test/Mocks.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+namespace {
+PathEstimateCache::Estimate makeEstimate(
+    uint64_t bandwidth,
+    std::chrono::microseconds minRtt,
+    TimePoint updateTime = Clock::now()) {
+  PathEstimateCache::Estimate estimate;
+  estimate.bandwidth = bandwidth;
+  estimate.minRtt = minRtt;
+  estimate.updateTime = updateTime;
+  return estimate;
+}
+} // namespace
+
+TEST(PathEstimateCacheTest, SharedBySubnet) {
+  PathEstimateCache cache;
+  cache.update(folly::IPAddress("10.0.1.1"), makeEstimate(1000, 10ms));
+  auto estimate = cache.get(folly::IPAddress("10.0.1.200"));
+  ASSERT_TRUE(estimate.hasValue());
+  EXPECT_EQ(1000, estimate->bandwidth);
+  EXPECT_EQ(10ms, estimate->minRtt);
+  EXPECT_FALSE(cache.get(folly::IPAddress("10.0.2.1")).hasValue());
+  // An IPv4 mapped address is in its IPv4 subnet:
+  EXPECT_TRUE(cache.get(folly::IPAddress("::ffff:10.0.1.3")).hasValue());
+
+  cache.update(folly::IPAddress("2001:db8:1::1"), makeEstimate(2000, 20ms));
+  EXPECT_TRUE(cache.get(folly::IPAddress("2001:db8:1:ff::2")).hasValue());
+  EXPECT_FALSE(cache.get(folly::IPAddress("2001:db8:2::1")).hasValue());
+}
+
+TEST(PathEstimateCacheTest, Expiry) {
+  PathEstimateCache cache(10, 1min);
+  auto now = Clock::now();
+  cache.update(folly::IPAddress("10.0.1.1"), makeEstimate(1000, 10ms, now));
+  EXPECT_TRUE(cache.get(folly::IPAddress("10.0.1.1"), now + 30s).hasValue());
+  EXPECT_FALSE(cache.get(folly::IPAddress("10.0.1.1"), now + 2min).hasValue());
+  EXPECT_FALSE(cache.get(folly::IPAddress("10.0.1.1"), now).hasValue());
+}
+
+TEST(PathEstimateCacheTest, Bounded) {
+  PathEstimateCache cache(2);
+  cache.update(folly::IPAddress("10.0.1.1"), makeEstimate(1000, 10ms));
+  cache.update(folly::IPAddress("10.0.2.1"), makeEstimate(1000, 10ms));
+  // Touch the first subnet so that the second is the least recently used:
+  EXPECT_TRUE(cache.get(folly::IPAddress("10.0.1.1")).hasValue());
+  cache.update(folly::IPAddress("10.0.3.1"), makeEstimate(1000, 10ms));
+  EXPECT_TRUE(cache.get(folly::IPAddress("10.0.1.1")).hasValue());
+  EXPECT_FALSE(cache.get(folly::IPAddress("10.0.2.1")).hasValue());
+  EXPECT_TRUE(cache.get(folly::IPAddress("10.0.3.1")).hasValue());
+}
+
+TEST(PathEstimateCacheTest, InitCwnd) {
+  TransportSettings settings;
+  // 10MB/s over 10ms is a 100KB bdp, half of it is 50 packets of 1000 bytes.
+  EXPECT_EQ(
+      50,
+      PathEstimateCache::initCwndInMss(
+          makeEstimate(10 * 1000 * 1000, 10ms), settings, 1000));
+  // Never below the initial cwnd of the settings:
+  EXPECT_EQ(
+      settings.initCwndInMss,
+      PathEstimateCache::initCwndInMss(
+          makeEstimate(1000, 10ms), settings, 1000));
+  // Nor above the cap:
+  EXPECT_EQ(
+      kPathEstimateMaxInitCwndInMss,
+      PathEstimateCache::initCwndInMss(
+          makeEstimate(1000 * 1000 * 1000, 1s), settings, 1000));
+  settings.maxCwndInMss = 20;
+  EXPECT_EQ(
+      20,
+      PathEstimateCache::initCwndInMss(
+          makeEstimate(10 * 1000 * 1000, 10ms), settings, 1000));
+}
+
+TEST(PathEstimateCacheTest, OnConnectionDone) {
+  PathEstimateCache cache;
+  QuicConnectionStateBase conn(QuicNodeType::Server);
+  auto client = folly::IPAddress("10.0.1.1");
+  // No rtt sample yet:
+  cache.onConnectionDone(client, conn);
+  EXPECT_FALSE(cache.get(client).hasValue());
+
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  EXPECT_CALL(*mockCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(100000));
+  conn.congestionController = std::move(mockCongestionController);
+  conn.lossState.srtt = 20ms;
+  conn.lossState.mrtt = 10ms;
+  cache.onConnectionDone(client, conn);
+  auto estimate = cache.get(client);
+  ASSERT_TRUE(estimate.hasValue());
+  EXPECT_EQ(5 * 1000 * 1000, estimate->bandwidth);
+  EXPECT_EQ(10ms, estimate->minRtt);
+}
+} // namespace test
+} // namespace quic
@@ -294,6 +294,163 @@ TEST_F(QuicServerWorkerTest, NoConnFoundTestReset) {
       QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND);
 }
 
+TEST_F(QuicServerWorkerTest, DataWorkerRoutesMissesToHandshakeWorker) {
+  worker_->stopPacketForwarding();
+  worker_->setHandshakeWorkers(4, 64);
+  EXPECT_FALSE(worker_->isHandshakeWorker());
+  EXPECT_EQ(QuicServerWorker::getHandshakeWorkerFor(42, 4), 2);
+  auto connId = getTestConnectionId(hostId_);
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(kClientAddr, _, _))
+      .WillOnce(Invoke([&](auto&, auto& routingData, auto&) {
+        EXPECT_EQ(routingData->destinationConnId, connId);
+        EXPECT_TRUE(routingData->missedOnDataWorker);
+      }));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(HeaderForm::Short, false, false, connId, folly::none),
+      NetworkData(folly::IOBuf::copyBuffer("data"), Clock::now()));
+}
+
+TEST_F(QuicServerWorkerTest, HandshakeWorkerDropsMissesOfDataWorker) {
+  worker_->stopPacketForwarding();
+  worker_->setWorkerId(2);
+  worker_->setHandshakeWorkers(4, 64);
+  EXPECT_TRUE(worker_->isHandshakeWorker());
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  EXPECT_CALL(*workerCb_, routeDataToWorkerShort(_, _, _)).Times(0);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND));
+  RoutingData routingData(
+      HeaderForm::Short,
+      false,
+      false,
+      getTestConnectionId(hostId_),
+      folly::none);
+  routingData.missedOnDataWorker = true;
+  worker_->dispatchPacketData(
+      kClientAddr,
+      std::move(routingData),
+      NetworkData(folly::IOBuf::copyBuffer("data"), Clock::now()));
+}
+
+TEST_F(QuicServerWorkerTest, StatelessResetRateLimited) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.statelessResetAesTokens = true;
+  settings.maxStatelessResetsPerSecond = 1;
+  worker_->setTransportSettings(settings);
+  worker_->stopPacketForwarding();
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND))
+      .Times(3);
+  // Only the first packet is answered, the limit allows no burst beyond it.
+  EXPECT_CALL(*transportInfoCb_, onStatelessReset()).Times(1);
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _)).Times(1);
+  for (int i = 0; i < 3; ++i) {
+    auto connId = getTestConnectionId(hostId_);
+    worker_->dispatchPacketData(
+        kClientAddr,
+        RoutingData(HeaderForm::Short, false, false, connId, folly::none),
+        NetworkData(folly::IOBuf::copyBuffer("data"), Clock::now()));
+  }
+  eventbase_.loop();
+}
+
+TEST_F(QuicServerWorkerTest, DrainingConnection) {
+  worker_->stopPacketForwarding();
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  auto connId = getTestConnectionId(hostId_);
+  auto closePacket = folly::IOBuf::copyBuffer("close");
+  EXPECT_TRUE(worker_->onConnectionDraining(
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}},
+      kClientAddr,
+      closePacket->clone(),
+      std::chrono::milliseconds(10)));
+  auto dispatch = [&] {
+    worker_->dispatchPacketData(
+        folly::SocketAddress("1.2.3.4", 1234),
+        RoutingData(HeaderForm::Short, false, false, connId, folly::none),
+        NetworkData(folly::IOBuf::copyBuffer("data"), Clock::now()));
+  };
+  // The 1st, 2nd and 4th packets are answered, at the peer address of the
+  // connection.
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, BufMatches(*closePacket)))
+      .Times(3);
+  for (int i = 0; i < 5; ++i) {
+    dispatch();
+  }
+  eventbase_.loop();
+
+  // The connection is unknown once the drain period is over.
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::CONNECTION_NOT_FOUND));
+  EXPECT_CALL(*transportInfoCb_, onStatelessReset());
+  EXPECT_CALL(*socketPtr_, write(_, Not(BufMatches(*closePacket))));
+  dispatch();
+}
+
+TEST_F(QuicServerWorkerTest, HealthCheck) {
+  worker_->setHealthCheckToken("health");
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+      .WillOnce(Invoke([](auto&, const std::unique_ptr<folly::IOBuf>& buf) {
+        EXPECT_EQ(
+            std::string(
+                reinterpret_cast<const char*>(buf->data()), buf->length()),
+            "OK");
+        return 2;
+      }));
+  worker_->handleNetworkData(
+      kClientAddr, folly::IOBuf::copyBuffer("health"), Clock::now());
+  // Same length, not the token.
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(
+          QuicTransportStatsCallback::PacketDropReason::INVALID_PACKET));
+  worker_->handleNetworkData(
+      kClientAddr, folly::IOBuf::copyBuffer("heaLth"), Clock::now());
+  eventbase_.loop();
+}
+
+TEST_F(QuicServerWorkerTest, VersionNegotiationRateLimited) {
+  TransportSettings settings;
+  settings.maxVersionNegotiationsPerSecond = 1;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  // Only the first packet is answered, the limit allows no burst beyond it.
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+      .WillOnce(Invoke([](auto&, const std::unique_ptr<folly::IOBuf>& buf) {
+        auto packetQueue = bufToQueue(buf->clone());
+        auto versionPacket = QuicReadCodec(QuicNodeType::Client)
+                                 .tryParsingVersionNegotiation(packetQueue);
+        EXPECT_TRUE(versionPacket.hasValue());
+        return buf->computeChainDataLength();
+      }));
+  for (int i = 0; i < 3; ++i) {
+    auto connId = getTestConnectionId(hostId_);
+    LongHeader header(
+        LongHeader::Types::Initial,
+        connId,
+        connId,
+        1 /* packetNum */,
+        QuicVersion::MVFST_INVALID);
+    RegularQuicPacketBuilder builder(
+        kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+    auto packet = packetToBuf(std::move(builder).buildPacket());
+    worker_->handleNetworkData(kClientAddr, std::move(packet), Clock::now());
+  }
+  eventbase_.loop();
+}
+
 TEST_F(QuicServerWorkerTest, QuicServerWorkerUnbindBeforeCidAvailable) {
   MockConnectionCallback connCb;
   auto mockSock =
@@ -396,6 +553,141 @@ TEST_F(QuicServerWorkerTest, QuicServerMultipleConnIdsRouting) {
   transport_->QuicServerTransport::setRoutingCallback(nullptr);
 }
 
+TEST_F(QuicServerWorkerTest, IntrospectConnections) {
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  EXPECT_CALL(*transportInfoCb_, onNewConnection());
+  transport_->QuicServerTransport::setRoutingCallback(worker_.get());
+  worker_->onConnectionIdAvailable(transport_, connId);
+  EXPECT_CALL(*transport_, getPeerAddress())
+      .WillRepeatedly(ReturnRef(kClientAddr));
+
+  folly::Optional<WorkerIntrospection> result;
+  worker_->introspectConnections(
+      ConnectionIntrospectionOptions(),
+      [&](WorkerIntrospection workerResult) {
+        result = std::move(workerResult);
+      });
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(42, result->workerId);
+  EXPECT_EQ(1, result->numConnections);
+  EXPECT_EQ(1, result->srtt.count());
+  ASSERT_EQ(1, result->sampledConnections.size());
+  EXPECT_EQ(kClientAddr, result->sampledConnections[0].peerAddress);
+
+  EXPECT_CALL(*transportInfoCb_, onConnectionClose(_)).Times(1);
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  worker_->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
+TEST_F(QuicServerWorkerTest, Broadcast) {
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  EXPECT_CALL(*transportInfoCb_, onNewConnection());
+  transport_->QuicServerTransport::setRoutingCallback(worker_.get());
+  worker_->onConnectionIdAvailable(transport_, connId);
+
+  auto data = folly::IOBuf::copyBuffer("broadcast");
+  auto unknownConnId = connId;
+  unknownConnId.data()[7] ^= 0x1;
+  std::vector<BroadcastTarget> targets{
+      {connId, 0}, {connId, 4}, {unknownConnId, 0}};
+  // Every stream references the same buffer.
+  EXPECT_CALL(*transport_, writeChain(_, _, true))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](StreamId, const folly::IOBuf* buf, bool) {
+        EXPECT_EQ(data->data(), buf->data());
+      }));
+  EXPECT_EQ(2, worker_->broadcast(*data, targets, true));
+
+  EXPECT_CALL(*transportInfoCb_, onConnectionClose(_)).Times(1);
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  worker_->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
+TEST_F(QuicServerWorkerTest, IntrospectConnectionsInBatches) {
+  std::vector<std::weak_ptr<QuicTransportBase>> transports(3);
+  ConnectionIntrospectionOptions options;
+  options.batchSize = 2;
+  folly::Optional<WorkerIntrospection> result;
+  introspectConnections(
+      &eventbase_,
+      7,
+      std::move(transports),
+      options,
+      [&](WorkerIntrospection workerResult) {
+        result = std::move(workerResult);
+      });
+  // The closed connections are skipped, the last one in the next loop.
+  EXPECT_FALSE(result.hasValue());
+  eventbase_.loopOnce();
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(7, result->workerId);
+  EXPECT_EQ(0, result->numConnections);
+  EXPECT_TRUE(result->sampledConnections.empty());
+}
+
+TEST_F(QuicServerWorkerTest, BatchesShortHeaderPackets) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.batchReceivedPackets = true;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  EXPECT_CALL(*transportInfoCb_, onNewConnection());
+  transport_->QuicServerTransport::setRoutingCallback(worker_.get());
+  worker_->onConnectionIdAvailable(transport_, connId);
+  EXPECT_CALL(*transport_, getClientConnectionId())
+      .WillRepeatedly(Return(connId));
+  worker_->onConnectionIdBound(transport_);
+
+  auto data = folly::IOBuf::copyBuffer("data");
+  auto dispatch = [&] {
+    worker_->dispatchPacketData(
+        kClientAddr,
+        RoutingData(HeaderForm::Short, false, false, connId, folly::none),
+        NetworkData(data->clone(), Clock::now()));
+  };
+  worker_->startPacketBatch();
+  dispatch();
+  dispatch();
+  EXPECT_CALL(*transport_, onNetworkDataBatch(kClientAddr, 2)).Times(1);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)))
+      .Times(2);
+  worker_->finishPacketBatch();
+
+  // A lone packet goes through onNetworkData().
+  worker_->startPacketBatch();
+  dispatch();
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)))
+      .Times(1);
+  worker_->finishPacketBatch();
+
+  // Outside of a batch the packets are handed over right away.
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, BufMatches(*data)))
+      .Times(1);
+  dispatch();
+
+  EXPECT_CALL(*transportInfoCb_, onConnectionClose(_)).Times(1);
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr));
+  worker_->onConnectionUnbound(
+      transport_.get(),
+      std::make_pair(kClientAddr, connId),
+      std::vector<ConnectionIdData>{ConnectionIdData{connId, 0}});
+  transport_->QuicServerTransport::setRoutingCallback(nullptr);
+}
+
 TEST_F(QuicServerWorkerTest, QuicServerNewConnection) {
   EXPECT_CALL(*socketPtr_, address()).WillRepeatedly(ReturnRef(fakeAddress_));
   auto connId = getTestConnectionId(hostId_);
@@ -603,6 +895,35 @@ TEST_F(QuicServerWorkerTest, ShutdownQuicServer) {
   t.join();
 }
 
+TEST_F(QuicServerWorkerTest, ShutdownWithTimeBudget) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.shutdownTimeBudget = std::chrono::microseconds(1);
+  worker_->setTransportSettings(settings);
+  auto connId = getTestConnectionId(hostId_);
+  createQuicConnection(kClientAddr, connId);
+  EXPECT_CALL(*transportInfoCb_, onNewConnection());
+  worker_->onConnectionIdAvailable(transport_, connId);
+
+  EXPECT_CALL(*transportInfoCb_, onConnectionClose(_));
+  EXPECT_CALL(*transport_, setRoutingCallback(nullptr)).Times(2);
+  EXPECT_CALL(*transport_, setTransportInfoCallback(nullptr)).Times(2);
+  EXPECT_CALL(*transport_, closeNow(_)).Times(2);
+  bool done = false;
+  eventbase_.runInLoop([&] {
+    worker_->shutdownAllConnections(
+        LocalErrorCode::SHUTTING_DOWN, [&] { done = true; });
+    // Nothing is routed to the transports any more.
+    EXPECT_TRUE(worker_->getConnectionIdMap().empty());
+    EXPECT_TRUE(worker_->getSrcToTransportMap().empty());
+  });
+  eventbase_.loopOnce();
+  // The last closed transport is only destroyed in the next iteration.
+  EXPECT_FALSE(done);
+  eventbase_.loop();
+  EXPECT_TRUE(done);
+}
+
 TEST_F(QuicServerWorkerTest, PacketAfterShutdown) {
   std::thread t([&] { eventbase_.loopForever(); });
   worker_->shutdownAllConnections(LocalErrorCode::SHUTTING_DOWN);
@@ -718,6 +1039,209 @@ ConnectionId createConnIdForServer(ProcessId server) {
   return connIdAlgo->encodeConnectionId(params);
 }
 
+Buf createInitialWithToken(
+    ConnectionId srcConnId,
+    ConnectionId destConnId,
+    const std::string& token) {
+  LongHeader header(
+      LongHeader::Types::Initial,
+      srcConnId,
+      destConnId,
+      1 /* packetNum */,
+      QuicVersion::MVFST,
+      token);
+  RegularQuicPacketBuilder builder(
+      kDefaultUDPSendPacketLen, std::move(header), 0 /* largestAcked */);
+  writeFrame(PaddingFrame(), builder);
+  auto packet = packetToBuf(std::move(builder).buildPacket());
+  // The worker only looks at the header, pad to the minimum initial size.
+  packet->prependChain(createData(kMinInitialPacketSize));
+  return packet;
+}
+
+TEST_F(QuicServerWorkerTest, RetryOverPendingHandshakes) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.retryTokenSecret = getRandSecret();
+  settings.retryPendingHandshakesThreshold = 1;
+  worker_->setTransportSettings(settings);
+
+  // Below the threshold, the connection is created right away.
+  ConnectionId firstConnId = getTestConnectionId(hostId_);
+  expectConnectionCreation(kClientAddr, firstConnId);
+  EXPECT_CALL(*transport_, setOriginalConnectionId(_)).Times(0);
+  EXPECT_CALL(*transport_, onNetworkData(kClientAddr, _));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(HeaderForm::Long, true, true, firstConnId, firstConnId),
+      NetworkData(
+          createInitialWithToken(firstConnId, firstConnId, ""), Clock::now()));
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  ConnectionId clientConnId = getTestConnectionId(hostId_ + 1);
+  ConnectionId initialConnId({1, 2, 3, 4, 5, 6, 7, 8});
+  folly::SocketAddress clientAddr("1.2.3.5", 1234);
+  auto data = createInitialWithToken(clientConnId, initialConnId, "");
+  std::string token;
+  ConnectionId retryConnId;
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onRetrySent());
+  EXPECT_CALL(*socketPtr_, write(clientAddr, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        auto parsedHeader = parseHeader(*buf);
+        EXPECT_TRUE(parsedHeader.hasValue());
+        auto longHeader = parsedHeader->parsedHeader->asLong();
+        EXPECT_EQ(LongHeader::Types::Retry, longHeader->getHeaderType());
+        EXPECT_EQ(clientConnId, longHeader->getDestinationConnId());
+        EXPECT_EQ(initialConnId, *longHeader->getOriginalDstConnId());
+        token = longHeader->getToken();
+        retryConnId = longHeader->getSourceConnId();
+        return buf->computeChainDataLength();
+      }));
+  worker_->dispatchPacketData(
+      clientAddr,
+      RoutingData(HeaderForm::Long, true, true, initialConnId, clientConnId),
+      NetworkData(std::move(data), Clock::now()));
+  EXPECT_FALSE(token.empty());
+  EXPECT_EQ(1, worker_->getSrcToTransportMap().size());
+  Mock::VerifyAndClearExpectations(factory_.get());
+
+  // The client comes back with the token to the connection id of the Retry.
+  MockConnectionCallback connCb;
+  auto mockSock =
+      std::make_unique<folly::test::MockAsyncUDPSocket>(&eventbase_);
+  EXPECT_CALL(*mockSock, address()).WillRepeatedly(ReturnRef(fakeAddress_));
+  MockQuicTransport::Ptr transport = std::make_shared<MockQuicTransport>(
+      worker_->getEventBase(), std::move(mockSock), connCb, nullptr);
+  EXPECT_CALL(*transport, getEventBase())
+      .WillRepeatedly(Return(&eventbase_));
+  expectConnectionCreation(clientAddr, retryConnId, transport);
+  EXPECT_CALL(*transport, setOriginalConnectionId(initialConnId));
+  EXPECT_CALL(*transport, onNetworkData(clientAddr, _));
+  worker_->dispatchPacketData(
+      clientAddr,
+      RoutingData(HeaderForm::Long, true, true, retryConnId, clientConnId),
+      NetworkData(
+          createInitialWithToken(clientConnId, retryConnId, token),
+          Clock::now()));
+  EXPECT_EQ(2, worker_->getSrcToTransportMap().size());
+  // Otherwise the mock of _make will hold on to a shared_ptr to the transport
+  Mock::VerifyAndClearExpectations(factory_.get());
+}
+
+TEST_F(QuicServerWorkerTest, RetryInvalidToken) {
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.retryTokenSecret = getRandSecret();
+  settings.retryPendingHandshakesThreshold = 0;
+  worker_->setTransportSettings(settings);
+
+  // A token from a server with another secret gets a new Retry.
+  RetryTokenGenerator generator(getRandSecret());
+  ConnectionId clientConnId = getTestConnectionId(hostId_);
+  ConnectionId initialConnId({1, 2, 3, 4, 5, 6, 7, 8});
+  auto data = createInitialWithToken(
+      clientConnId,
+      initialConnId,
+      generator.generateToken(initialConnId, kClientAddr));
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+  EXPECT_CALL(*transportInfoCb_, onRetrySent());
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        return buf->computeChainDataLength();
+      }));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(HeaderForm::Long, true, true, initialConnId, clientConnId),
+      NetworkData(std::move(data), Clock::now()));
+  EXPECT_TRUE(worker_->getSrcToTransportMap().empty());
+}
+
+TEST_F(QuicServerWorkerTest, LoadShedding) {
+  using LoadLevel = WorkerLoadMonitor::LoadLevel;
+  TransportSettings settings;
+  settings.statelessResetTokenSecret = getRandSecret();
+  settings.retryTokenSecret = getRandSecret();
+  LoadSheddingSettings loadShedding;
+  loadShedding.retry.pendingPackets = 1;
+  loadShedding.reject.pendingPackets = 10;
+  loadShedding.dropHandshakes.pendingPackets = 100;
+  settings.loadShedding = loadShedding;
+  worker_->setTransportSettings(settings);
+  EXPECT_CALL(*socketPtr_, resumeRead(_));
+  worker_->start();
+  EXPECT_EQ(LoadLevel::NORMAL, worker_->getLoadLevel());
+
+  ConnectionId clientConnId = getTestConnectionId(hostId_);
+  ConnectionId initialConnId({1, 2, 3, 4, 5, 6, 7, 8});
+  RoutingData initialRoutingData(
+      HeaderForm::Long, true, true, initialConnId, clientConnId);
+  EXPECT_CALL(*factory_, _make(_, _, _, _)).Times(0);
+
+  worker_->onPendingRoutedPackets(1);
+  EXPECT_EQ(LoadLevel::RETRY, worker_->getLoadLevel());
+  EXPECT_CALL(*transportInfoCb_, onRetrySent());
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        auto parsedHeader = parseHeader(*buf);
+        EXPECT_TRUE(parsedHeader.hasValue());
+        EXPECT_EQ(
+            LongHeader::Types::Retry,
+            parsedHeader->parsedHeader->asLong()->getHeaderType());
+        return buf->computeChainDataLength();
+      }));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(initialRoutingData),
+      NetworkData(
+          createInitialWithToken(clientConnId, initialConnId, ""),
+          Clock::now()));
+  Mock::VerifyAndClearExpectations(socketPtr_);
+  Mock::VerifyAndClearExpectations(transportInfoCb_);
+
+  // New connections are refused with a close in an Initial.
+  worker_->onPendingRoutedPackets(10);
+  EXPECT_EQ(LoadLevel::REJECT, worker_->getLoadLevel());
+  EXPECT_CALL(*transportInfoCb_, onRetrySent()).Times(0);
+  EXPECT_CALL(
+      *transportInfoCb_, onPacketDropped(PacketDropReason::LOAD_SHEDDING));
+  EXPECT_CALL(*socketPtr_, write(kClientAddr, _))
+      .WillOnce(Invoke([&](const folly::SocketAddress&,
+                           const std::unique_ptr<folly::IOBuf>& buf) {
+        auto parsedHeader = parseHeader(*buf);
+        EXPECT_TRUE(parsedHeader.hasValue());
+        auto longHeader = parsedHeader->parsedHeader->asLong();
+        EXPECT_EQ(LongHeader::Types::Initial, longHeader->getHeaderType());
+        EXPECT_EQ(clientConnId, longHeader->getDestinationConnId());
+        return buf->computeChainDataLength();
+      }));
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(initialRoutingData),
+      NetworkData(
+          createInitialWithToken(clientConnId, initialConnId, ""),
+          Clock::now()));
+  Mock::VerifyAndClearExpectations(socketPtr_);
+  Mock::VerifyAndClearExpectations(transportInfoCb_);
+
+  // The long header packets of the handshakes are dropped.
+  worker_->onPendingRoutedPackets(100);
+  EXPECT_EQ(LoadLevel::DROP_HANDSHAKES, worker_->getLoadLevel());
+  EXPECT_CALL(
+      *transportInfoCb_, onPacketDropped(PacketDropReason::LOAD_SHEDDING));
+  EXPECT_CALL(*socketPtr_, write(_, _)).Times(0);
+  worker_->dispatchPacketData(
+      kClientAddr,
+      RoutingData(HeaderForm::Long, false, false, initialConnId, clientConnId),
+      NetworkData(createData(kMinInitialPacketSize), Clock::now()));
+  EXPECT_TRUE(worker_->getSrcToTransportMap().empty());
+  Mock::VerifyAndClearExpectations(factory_.get());
+}
+
 class QuicServerWorkerTakeoverTest : public Test {
  public:
   void SetUp() override {
@@ -1022,6 +1546,87 @@ TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverProcessForwardedPkt) {
   writeSock.release();
 }
 
+TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverForwardBatch) {
+  // packets belong to different server
+  ConnectionId connId = createConnIdForServer(ProcessId::ZERO),
+               clientConnId = getTestConnectionId(clientHostId_);
+  takeoverWorker_->setProcessId(ProcessId::ONE);
+  takeoverWorker_->startPacketForwarding(
+      folly::SocketAddress("0", 0), TakeoverProtocolVersion::V1);
+
+  auto writeSock = std::make_unique<folly::test::MockAsyncUDPSocket>(&evb_);
+  EXPECT_CALL(*takeoverSocketFactory_, _make(_, _))
+      .WillOnce(Return(writeSock.get()));
+  EXPECT_CALL(*writeSock, bind(_));
+  Buf batch;
+  EXPECT_CALL(*writeSock, write(_, _))
+      .WillOnce(Invoke([&](const SocketAddress& /* unused */,
+                           const std::unique_ptr<folly::IOBuf>& writtenData) {
+        batch = writtenData->clone();
+        return writtenData->computeChainDataLength();
+      }));
+  auto workerCb = [&](const folly::SocketAddress& client,
+                      std::unique_ptr<RoutingData>& routingData,
+                      std::unique_ptr<NetworkData>& networkData) {
+    takeoverWorker_->dispatchPacketData(
+        client, std::move(*routingData.get()), std::move(*networkData.get()));
+  };
+  EXPECT_CALL(*takeoverWorkerCb_, routeDataToWorkerLong(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(workerCb));
+  EXPECT_CALL(*transportInfoCb_, onPacketReceived()).Times(2);
+  EXPECT_CALL(*transportInfoCb_, onRead(_)).Times(2);
+  EXPECT_CALL(*transportInfoCb_, onPacketForwarded()).Times(2);
+
+  // Both packets go out in a single datagram at the end of the loop.
+  size_t len{0};
+  std::vector<Buf> packets;
+  for (auto type : {LongHeader::Types::Handshake, LongHeader::Types::ZeroRtt}) {
+    packets.push_back(writeTestDataOnWorkersBuf(
+        clientConnId, connId, len, takeoverWorker_.get(), type));
+    takeoverWorker_->onDataAvailable(clientAddr, len, false);
+  }
+  EXPECT_FALSE(batch);
+  evb_.loopOnce();
+  ASSERT_TRUE(batch);
+  batch->coalesce();
+  folly::io::Cursor cursor(batch.get());
+  EXPECT_EQ(
+      cursor.readBE<uint32_t>(),
+      static_cast<uint32_t>(TakeoverProtocolVersion::V1));
+
+  // The server taking the packets back unpacks them from the datagram.
+  takeoverWorker_->setProcessId(ProcessId::ZERO);
+  folly::AsyncUDPSocket::ReadCallback* takeoverCb =
+      takeoverWorker_->getTakeoverHandlerCallback();
+  uint8_t* workerBuf = nullptr;
+  size_t workerBufLen = 0;
+  takeoverCb->getReadBuffer((void**)&workerBuf, &workerBufLen);
+  ASSERT_GE(workerBufLen, batch->length());
+  memcpy(workerBuf, batch->data(), batch->length());
+
+  size_t received = 0;
+  auto cb = [&](const folly::SocketAddress& addr,
+                std::unique_ptr<RoutingData>& /* routingData */,
+                std::unique_ptr<NetworkData>& networkData) {
+    EXPECT_EQ(addr.getIPAddress(), clientAddr.getIPAddress());
+    EXPECT_EQ(addr.getPort(), clientAddr.getPort());
+    ASSERT_LT(received, packets.size());
+    EXPECT_TRUE(eq(*packets[received++], *(networkData->data)));
+  };
+  EXPECT_CALL(*takeoverWorkerCb_, routeDataToWorkerLong(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Invoke(cb));
+  EXPECT_CALL(*transportInfoCb_, onForwardedPacketReceived()).Times(1);
+  EXPECT_CALL(*transportInfoCb_, onForwardedPacketProcessed()).Times(2);
+  takeoverCb->onDataAvailable(clientAddr, batch->length(), false);
+  EXPECT_EQ(received, 2);
+  takeoverWorker_->stopPacketForwarding();
+  // release this resource since MockQuicUDPSocketFactory::_make() hands its
+  // ownership to it's caller (i.e. QuicServerWorker)
+  writeSock.release();
+}
+
 TEST_F(QuicServerWorkerTakeoverTest, QuicServerTakeoverCbReadClose) {
   folly::AsyncUDPSocket::ReadCallback* takeoverCb =
       takeoverWorker_->getTakeoverHandlerCallback();
@@ -1281,6 +1886,45 @@ TEST_F(QuicServerTest, DontRouteDataAfterShutdown) {
       [&] { transport.reset(); });
 }
 
+TEST_F(QuicServerTest, RouteDataToOtherWorkerInBatches) {
+  std::mutex m;
+  std::condition_variable cv;
+  size_t handedOff = 0;
+  auto transportStatsFactory = std::make_unique<MockQuicStatsFactory>();
+  EXPECT_CALL(*transportStatsFactory, make(_))
+      .WillRepeatedly(Invoke([&](folly::EventBase* /* unused */) {
+        auto stats = std::make_unique<NiceMock<MockQuicStats>>();
+        ON_CALL(*stats, onWorkerHandoffBatch(_))
+            .WillByDefault(Invoke([&](size_t numPackets) {
+              std::lock_guard<std::mutex> guard(m);
+              handedOff += numPackets;
+              cv.notify_one();
+            }));
+        return stats;
+      }));
+  server_->setTransportStatsCallbackFactory(std::move(transportStatsFactory));
+  server_->start(folly::SocketAddress("::1", 0), 2);
+  server_->waitUntilInitialized();
+
+  // A connection id owned by the second worker, routed from the first one.
+  auto connId = DefaultConnectionIdAlgo().encodeConnectionId(
+      ServerConnectionIdParams(serverHostId_, 0, 1));
+  server_->getWorkerEvbs()[0]->runInEventBaseThreadAndWait([&] {
+    for (int i = 0; i < 3; ++i) {
+      RoutingData routingData(
+          HeaderForm::Short, false, false, connId, folly::none);
+      NetworkData networkData(folly::IOBuf::copyBuffer("wat"), Clock::now());
+      server_->routeDataToWorker(
+          kClientAddr, std::move(routingData), std::move(networkData));
+    }
+  });
+  {
+    std::unique_lock<std::mutex> lg(m);
+    EXPECT_TRUE(cv.wait_for(lg, 1s, [&] { return handedOff == 3; }));
+  }
+  server_->shutdown();
+}
+
 class QuicServerTakeoverTest : public Test {
  public:
   void SetUp() override {
@@ -27,6 +27,8 @@
 
 #include <folly/io/async/test/MockAsyncUDPSocket.h>
 
+#include <thread>
+
 using namespace testing;
 using namespace folly;
 
@@ -823,6 +825,20 @@ TEST_F(QuicServerTransportTest, IdleTimerNotResetOnDuplicatePacket) {
   EXPECT_CALL(*transportInfoCb_, onQuicStreamClosed());
 }
 
+TEST_F(QuicServerTransportTest, DropDuplicatePacket) {
+  server->getNonConstConn().transportSettings.dropDuplicatePackets = true;
+  EXPECT_CALL(*transportInfoCb_, onNewQuicStream()).Times(1);
+  StreamId streamId = server->createBidirectionalStream().value();
+
+  auto expected = IOBuf::copyBuffer("hello");
+  auto packet = recvEncryptedStream(streamId, *expected);
+  EXPECT_CALL(
+      *transportInfoCb_,
+      onPacketDropped(PacketDropReason::DUPLICATE_PACKET));
+  deliverData(packet->clone(), false);
+  EXPECT_CALL(*transportInfoCb_, onQuicStreamClosed());
+}
+
 TEST_F(QuicServerTransportTest, IdleTimerNotResetWhenDataOutstanding) {
   // Clear the receivedNewPacketBeforeWrite flag, since we may reveice from
   // client during the SetUp of the test case.
@@ -914,6 +930,54 @@ TEST_F(QuicServerTransportTest, TestCloseConnectionWithNoError) {
       QuicFrame::Type::ApplicationCloseFrame_E));
 }
 
+TEST_F(QuicServerTransportTest, CompactDrainingConnection) {
+  server->getNonConstConn().transportSettings.compactDrainingConnections =
+      true;
+  Buf closePacket;
+  EXPECT_CALL(routingCallback, onConnectionDraining(_, clientAddr, _, _))
+      .WillOnce(Invoke([&](auto&, auto&, const folly::IOBuf* packet, auto) {
+        if (packet) {
+          closePacket = packet->clone();
+        }
+        return true;
+      }));
+  // The transport doesn't wait for the drain timeout to be unbound.
+  EXPECT_CALL(routingCallback, onConnectionUnbound(_, _, _)).Times(1);
+  server->close(std::make_pair(
+      QuicErrorCode(GenericApplicationErrorCode::UNKNOWN),
+      std::string("stopping")));
+  EXPECT_FALSE(server->drainTimeout().isScheduled());
+  EXPECT_TRUE(verifyFramePresent(
+      serverWrites,
+      *makeClientEncryptedCodec(),
+      QuicFrame::Type::ApplicationCloseFrame_E));
+  // The worker answers with the close packet that was sent.
+  ASSERT_NE(closePacket, nullptr);
+  EXPECT_TRUE(folly::IOBufEqualTo()(*closePacket, *serverWrites.back()));
+}
+
+TEST_F(QuicServerTransportTest, ExportSnapshotNeedsRetainedSecrets) {
+  // The 1-rtt secrets are only kept with allowConnectionTakeover, so the
+  // connection stays with this server.
+  EXPECT_FALSE(server->exportSnapshot().hasValue());
+  EXPECT_FALSE(server->isClosed());
+}
+
+TEST_F(QuicServerTransportTest, NoHibernationWithoutRetainedSecrets) {
+  auto transportSettings = server->getTransportSettings();
+  transportSettings.hibernationTimeout = 1ms;
+  server->setTransportSettings(transportSettings);
+  StreamId streamId = 4;
+  recvEncryptedStream(streamId, *IOBuf::copyBuffer("hello"));
+  loopForWrites();
+  std::this_thread::sleep_for(20ms);
+  evb.loopOnce(EVLOOP_NONBLOCK);
+  // The handshake doesn't have the secrets to rebuild the keys from.
+  EXPECT_FALSE(server->isHibernated());
+  recvEncryptedStream(streamId, *IOBuf::copyBuffer("world"), 5);
+  EXPECT_FALSE(server->isClosed());
+}
+
 TEST_F(QuicServerTransportTest, TestClientAddressChanges) {
   auto qLogger = std::make_shared<FileQLogger>(VantagePoint::SERVER);
   server->getNonConstConn().qLogger = qLogger;
@@ -1792,6 +1856,31 @@ TEST_F(QuicServerTransportTest, RecvPathChallenge) {
   EXPECT_EQ(pathResponse.pathData, pathChallenge.pathData);
 }
 
+TEST_F(QuicServerTransportTest, RecvAckFrequency) {
+  auto& conn = server->getNonConstConn();
+  conn.transportSettings.ackFrequencyEnabled = true;
+
+  auto deliverAckFrequency = [&](PacketNum packetNum,
+                                 const AckFrequencyFrame& frame) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero, *conn.serverConnectionId, packetNum);
+    RegularQuicPacketBuilder builder(
+        conn.udpSendPacketLen, std::move(header), 0 /* largestAcked */);
+    ASSERT_TRUE(builder.canBuildPacket());
+    writeSimpleFrame(QuicSimpleFrame(frame), builder);
+    deliverData(packetToBuf(std::move(builder).buildPacket()));
+  };
+
+  AckFrequencyFrame ackFrequency(2, 20, 10ms, true);
+  deliverAckFrequency(10, ackFrequency);
+  ASSERT_TRUE(conn.ackFrequencyState.received.hasValue());
+  EXPECT_EQ(ackFrequency, *conn.ackFrequencyState.received);
+
+  // A reordered older frame doesn't apply.
+  deliverAckFrequency(11, AckFrequencyFrame(1, 4, 5ms, false));
+  EXPECT_EQ(ackFrequency, *conn.ackFrequencyState.received);
+}
+
 TEST_F(QuicServerTransportTest, TestAckRstStream) {
   auto streamId = server->createUnidirectionalStream().value();
   auto stream = server->getNonConstConn().streamManager->getStream(streamId);
@@ -2104,6 +2193,102 @@ TEST_P(
           PacketDropReason::PEER_ADDRESS_CHANGE));
 }
 
+TEST_P(QuicServerTransportAllowMigrationTest, ValidateStandbyPath) {
+  server->getNonConstConn().transportSettings.enableStandbyPaths = true;
+  auto makeProbe = [&](QuicSimpleFrame frame) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero,
+        *server->getConn().serverConnectionId,
+        clientNextAppDataPacketNum++);
+    RegularQuicPacketBuilder builder(
+        server->getConn().udpSendPacketLen,
+        std::move(header),
+        0 /* largestAcked */);
+    writeSimpleFrame(std::move(frame), builder);
+    auto packet = std::move(builder).buildPacket();
+    return packetToBuf(packet);
+  };
+  auto peerAddress = server->getConn().peerAddress;
+  folly::SocketAddress newPeer("100.101.102.103", 23456);
+  serverWrites.clear();
+  deliverData(makeProbe(PathChallengeFrame(123)), true, &newPeer);
+  EXPECT_EQ(server->getConn().peerAddress, peerAddress);
+  EXPECT_EQ(server->getConn().migrationState.numMigrations, 0);
+  ASSERT_EQ(server->getConn().migrationState.standbyPaths.size(), 1);
+  auto& path = server->getConn().migrationState.standbyPaths[0];
+  EXPECT_EQ(path.congestionAndRtt.peerAddress, newPeer);
+  EXPECT_FALSE(path.validated);
+  ASSERT_TRUE(path.outstandingChallenge);
+  EXPECT_TRUE(path.challengeSentTime);
+  EXPECT_TRUE(path.pendingFrames.empty());
+  // The probe is written right away, before the writes of the current path.
+  ASSERT_FALSE(serverWrites.empty());
+  EXPECT_EQ(
+      serverWrites.front()->computeChainDataLength(),
+      server->getConn().udpSendPacketLen);
+  auto serverReadCodec = makeClientEncryptedCodec();
+  EXPECT_TRUE(verifyFramePresent(
+      serverWrites, *serverReadCodec, QuicFrame::Type::QuicSimpleFrame_E));
+
+  deliverData(
+      makeProbe(PathResponseFrame(path.outstandingChallenge->pathData)),
+      true,
+      &newPeer);
+  EXPECT_TRUE(path.validated);
+  EXPECT_FALSE(path.outstandingChallenge);
+  EXPECT_NE(path.congestionAndRtt.congestionController, nullptr);
+  EXPECT_EQ(server->getConn().peerAddress, peerAddress);
+}
+
+TEST_P(QuicServerTransportAllowMigrationTest, MigrateToStandbyPath) {
+  server->getNonConstConn().transportSettings.enableStandbyPaths = true;
+  auto peerAddress = server->getConn().peerAddress;
+  folly::SocketAddress newPeer("100.101.102.103", 23456);
+  StandbyPath standbyPath;
+  standbyPath.congestionAndRtt.peerAddress = newPeer;
+  standbyPath.congestionAndRtt.recordTime = Clock::now();
+  standbyPath.congestionAndRtt.congestionController =
+      server->getConn().congestionControllerFactory->makeCongestionController(
+          server->getNonConstConn(), CongestionControlType::NewReno);
+  standbyPath.congestionAndRtt.srtt = 30ms;
+  standbyPath.congestionAndRtt.lrtt = 30ms;
+  standbyPath.congestionAndRtt.rttvar = 15ms;
+  standbyPath.validated = true;
+  auto standbyCongestionController =
+      standbyPath.congestionAndRtt.congestionController.get();
+  server->getNonConstConn().migrationState.standbyPaths.push_back(
+      std::move(standbyPath));
+  auto congestionController = server->getConn().congestionController.get();
+
+  auto data = IOBuf::copyBuffer("bad data");
+  auto packetData = packetToBuf(createStreamPacket(
+      *clientConnectionId,
+      *server->getConn().serverConnectionId,
+      clientNextAppDataPacketNum++,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */));
+  deliverData(std::move(packetData), false, &newPeer);
+
+  EXPECT_EQ(server->getConn().peerAddress, newPeer);
+  EXPECT_EQ(server->getConn().migrationState.numMigrations, 1);
+  EXPECT_FALSE(server->getConn().pendingEvents.pathChallenge);
+  EXPECT_FALSE(server->getConn().writableBytesLimit);
+  EXPECT_EQ(
+      server->getConn().congestionController.get(),
+      standbyCongestionController);
+  EXPECT_EQ(server->getConn().lossState.srtt, 30ms);
+  // The path migrated away from is now on standby.
+  ASSERT_EQ(server->getConn().migrationState.standbyPaths.size(), 1);
+  auto& previousPath = server->getConn().migrationState.standbyPaths[0];
+  EXPECT_EQ(previousPath.congestionAndRtt.peerAddress, peerAddress);
+  EXPECT_TRUE(previousPath.validated);
+  EXPECT_EQ(
+      previousPath.congestionAndRtt.congestionController.get(),
+      congestionController);
+}
+
 TEST_P(
     QuicServerTransportAllowMigrationTest,
     ReceiveReorderedDataFromChangedPeerAddress) {
@@ -2970,6 +3155,42 @@ TEST_F(QuicServerTransportTest, RecvNewConnectionIdExceptionInvalidDuplicate) {
   EXPECT_THROW(deliverData(packetToBuf(packet)), std::runtime_error);
 }
 
+TEST_F(QuicServerTransportTest, WriteNewTokenOnce) {
+  RetryTokenSecret secret;
+  folly::Random::secureRandom(secret.data(), secret.size());
+  auto generator = std::make_shared<const RetryTokenGenerator>(secret);
+  server->setNewTokenGenerator(generator);
+  auto& conn = server->getNonConstConn();
+  auto countNewTokens = [&] {
+    return std::count_if(
+        conn.pendingEvents.frames.begin(),
+        conn.pendingEvents.frames.end(),
+        [](const QuicSimpleFrame& frame) {
+          return frame.asNewTokenFrame() != nullptr;
+        });
+  };
+  for (int i = 0; i < 2; ++i) {
+    ShortHeader header(
+        ProtectionType::KeyPhaseZero,
+        *conn.serverConnectionId,
+        clientNextAppDataPacketNum++);
+    RegularQuicPacketBuilder builder(
+        conn.udpSendPacketLen, std::move(header), 0 /* largestAcked */);
+    ASSERT_TRUE(builder.canBuildPacket());
+    writeSimpleFrame(PingFrame(), builder);
+    deliverData(packetToBuf(std::move(builder).buildPacket()), false);
+    EXPECT_EQ(countNewTokens(), 1);
+  }
+  for (const auto& frame : conn.pendingEvents.frames) {
+    if (frame.asNewTokenFrame()) {
+      EXPECT_TRUE(generator->validateNewToken(
+          frame.asNewTokenFrame()->token,
+          clientAddr,
+          kDefaultNewTokenLifetime));
+    }
+  }
+}
+
 class QuicUnencryptedServerTransportTest : public QuicServerTransportTest {
  public:
   void setupConnection() override {}
@@ -3101,11 +3322,11 @@ TEST_F(QuicUnencryptedServerTransportTest, TestPendingZeroRttData) {
     deliverData(std::move(packetData));
   }
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-  EXPECT_EQ(server->getConn().pendingZeroRttData->size(), expectedPendingLen);
+  EXPECT_EQ(server->getConn().pendingZeroRttData.size(), expectedPendingLen);
 
-  server->getNonConstConn().pendingZeroRttData->clear();
+  server->getNonConstConn().pendingZeroRttData.take();
   deliverData(IOBuf::create(0));
-  EXPECT_TRUE(server->getConn().pendingZeroRttData->empty());
+  EXPECT_TRUE(server->getConn().pendingZeroRttData.empty());
 }
 
 TEST_F(QuicUnencryptedServerTransportTest, TestPendingOneRttData) {
@@ -3127,11 +3348,11 @@ TEST_F(QuicUnencryptedServerTransportTest, TestPendingOneRttData) {
     deliverData(std::move(packetData));
   }
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-  EXPECT_EQ(server->getConn().pendingOneRttData->size(), expectedPendingLen);
+  EXPECT_EQ(server->getConn().pendingOneRttData.size(), expectedPendingLen);
 
-  server->getNonConstConn().pendingOneRttData->clear();
+  server->getNonConstConn().pendingOneRttData.take();
   deliverData(IOBuf::create(0));
-  EXPECT_TRUE(server->getConn().pendingOneRttData->empty());
+  EXPECT_TRUE(server->getConn().pendingOneRttData.empty());
 }
 
 TEST_F(
@@ -3185,7 +3406,7 @@ TEST_F(
   folly::SocketAddress newPeer("100.101.102.103", 23456);
   deliverData(std::move(packetData), true, &newPeer);
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-  EXPECT_EQ(server->getConn().pendingOneRttData->size(), 1);
+  EXPECT_EQ(server->getConn().pendingOneRttData.size(), 1);
 
   try {
     recvClientFinished();
@@ -3196,8 +3417,8 @@ TEST_F(
   EXPECT_EQ(
       server->getConn().localConnectionError->second, "Migration disabled");
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-  EXPECT_EQ(server->getConn().pendingZeroRttData, nullptr);
-  EXPECT_EQ(server->getConn().pendingOneRttData, nullptr);
+  EXPECT_FALSE(server->getConn().pendingZeroRttData.isOpen());
+  EXPECT_FALSE(server->getConn().pendingOneRttData.isOpen());
 }
 
 TEST_F(QuicUnencryptedServerTransportTest, TestWriteHandshakeAndZeroRtt) {
@@ -3253,6 +3474,39 @@ TEST_F(QuicUnencryptedServerTransportTest, TestEncryptedDataBeforeCFIN) {
   ASSERT_TRUE(stream->readBuffer.empty());
 }
 
+TEST_F(
+    QuicUnencryptedServerTransportTest,
+    TestClearInFlightBytesLimitationOnHandshakePacket) {
+  server->getNonConstConn()
+      .transportSettings.validateAddressOnHandshakePacket = true;
+  getFakeHandshakeLayer()->allowZeroRttKeys();
+  setupClientReadCodec();
+
+  recvClientHello();
+  ASSERT_TRUE(server->getNonConstConn().writableBytesLimit.hasValue());
+
+  // Handshake data that doesn't finish the handshake.
+  auto nextPacketNum = clientNextHandshakePacketNum++;
+  auto headerCipher = test::createNoOpHeaderCipher();
+  auto handshakeCipher = test::createNoOpAead();
+  auto packet = packetToBufCleartext(
+      createCryptoPacket(
+          *clientConnectionId,
+          *server->getConn().serverConnectionId,
+          nextPacketNum,
+          QuicVersion::MVFST,
+          ProtectionType::Handshake,
+          *IOBuf::copyBuffer("CERT"),
+          *handshakeCipher,
+          0 /* largestAcked */),
+      *handshakeCipher,
+      *headerCipher,
+      nextPacketNum);
+  deliverData(std::move(packet));
+  EXPECT_EQ(server->getConn().writableBytesLimit, folly::none);
+  EXPECT_EQ(server->getConn().readCodec->getOneRttReadCipher(), nullptr);
+}
+
 TEST_F(
     QuicUnencryptedServerTransportTest,
     TestClearInFlightBytesLimitationAfterCFIN) {
@@ -3496,14 +3750,14 @@ TEST_P(
   if (GetParam().acceptZeroRtt) {
     if (!GetParam().chloSync) {
       EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-      EXPECT_EQ(server->getConn().pendingZeroRttData->size(), 1);
+      EXPECT_EQ(server->getConn().pendingZeroRttData.size(), 1);
       loopForWrites();
     }
     EXPECT_EQ(server->getConn().streamManager->streamCount(), 1);
-    EXPECT_EQ(server->getConn().pendingZeroRttData, nullptr);
+    EXPECT_FALSE(server->getConn().pendingZeroRttData.isOpen());
   } else {
     EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-    EXPECT_EQ(server->getConn().pendingZeroRttData->size(), 1);
+    EXPECT_EQ(server->getConn().pendingZeroRttData.size(), 1);
   }
   EXPECT_EQ(
       server->getConn().qLogger->scid, server->getConn().serverConnectionId);
@@ -3531,12 +3785,12 @@ TEST_P(
       false));
   deliverData(std::move(packetData));
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-  EXPECT_EQ(server->getConn().pendingOneRttData->size(), 1);
+  EXPECT_EQ(server->getConn().pendingOneRttData.size(), 1);
 
   recvClientFinished();
   EXPECT_EQ(server->getConn().streamManager->streamCount(), 1);
-  EXPECT_EQ(server->getConn().pendingZeroRttData, nullptr);
-  EXPECT_EQ(server->getConn().pendingOneRttData, nullptr);
+  EXPECT_FALSE(server->getConn().pendingZeroRttData.isOpen());
+  EXPECT_FALSE(server->getConn().pendingOneRttData.isOpen());
   EXPECT_EQ(
       server->getConn().qLogger->scid, server->getConn().serverConnectionId);
   EXPECT_EQ(server->getConn().qLogger->dcid, clientConnectionId);
@@ -3566,14 +3820,14 @@ TEST_P(
   if (GetParam().acceptZeroRtt) {
     if (!GetParam().chloSync) {
       EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-      EXPECT_EQ(server->getConn().pendingZeroRttData->size(), 1);
+      EXPECT_EQ(server->getConn().pendingZeroRttData.size(), 1);
       loopForWrites();
     }
     EXPECT_EQ(server->getConn().streamManager->streamCount(), 1);
-    EXPECT_EQ(server->getConn().pendingZeroRttData, nullptr);
+    EXPECT_FALSE(server->getConn().pendingZeroRttData.isOpen());
   } else {
     EXPECT_EQ(server->getConn().streamManager->streamCount(), 0);
-    EXPECT_EQ(server->getConn().pendingZeroRttData->size(), 1);
+    EXPECT_EQ(server->getConn().pendingZeroRttData.size(), 1);
   }
   loopForWrites();
 
@@ -3591,14 +3845,14 @@ TEST_P(
   EXPECT_EQ(
       server->getConn().streamManager->streamCount(),
       GetParam().acceptZeroRtt ? 1 : 0);
-  EXPECT_EQ(server->getConn().pendingOneRttData->size(), 1);
+  EXPECT_EQ(server->getConn().pendingOneRttData.size(), 1);
 
   recvClientFinished();
   EXPECT_EQ(
       server->getConn().streamManager->streamCount(),
       GetParam().acceptZeroRtt ? 2 : 1);
-  EXPECT_EQ(server->getConn().pendingZeroRttData, nullptr);
-  EXPECT_EQ(server->getConn().pendingOneRttData, nullptr);
+  EXPECT_FALSE(server->getConn().pendingZeroRttData.isOpen());
+  EXPECT_FALSE(server->getConn().pendingOneRttData.isOpen());
   EXPECT_EQ(
       server->getConn().qLogger->scid, server->getConn().serverConnectionId);
   EXPECT_EQ(server->getConn().qLogger->dcid, clientConnectionId);
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/ReusePortSteering.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <folly/portability/GTest.h>
+#include <quic/codec/DefaultConnectionIdAlgo.h>
+
+namespace quic {
+namespace test {
+
+class ReusePortSteeringTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    for (size_t i = 0; i < kNumWorkers; ++i) {
+      int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+      ASSERT_GE(fd, 0);
+      int one = 1;
+      ASSERT_EQ(
+          0, ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)));
+      ASSERT_EQ(
+          0,
+          ::bind(
+              fd,
+              reinterpret_cast<const sockaddr*>(&addr_),
+              sizeof(addr_)));
+      if (i == 0) {
+        socklen_t len = sizeof(addr_);
+        ASSERT_EQ(
+            0,
+            ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr_), &len));
+      }
+      fds_.push_back(fd);
+    }
+    sender_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sender_, 0);
+  }
+
+  void TearDown() override {
+    for (auto fd : fds_) {
+      ::close(fd);
+    }
+    if (sender_ >= 0) {
+      ::close(sender_);
+    }
+  }
+
+  void send(const std::vector<uint8_t>& packet) {
+    ASSERT_EQ(
+        packet.size(),
+        ::sendto(
+            sender_,
+            packet.data(),
+            packet.size(),
+            0,
+            reinterpret_cast<const sockaddr*>(&addr_),
+            sizeof(addr_)));
+  }
+
+  // Index of the socket that received a packet, -1 if none did.
+  int receiver() {
+    uint8_t buf[64];
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      if (::recv(fds_[i], buf, sizeof(buf), MSG_DONTWAIT) >= 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  static std::vector<uint8_t> makeShortHeaderPacket(uint8_t workerId) {
+    DefaultConnectionIdAlgo algo;
+    auto connId =
+        algo.encodeConnectionId(ServerConnectionIdParams(5, 0, workerId));
+    // Fixed bit set, long header bit clear, then the connection id.
+    std::vector<uint8_t> packet{0x40};
+    packet.insert(
+        packet.end(), connId.data(), connId.data() + connId.size());
+    packet.resize(packet.size() + 20, 0);
+    return packet;
+  }
+
+  static constexpr size_t kNumWorkers = 4;
+  std::vector<int> fds_;
+  int sender_{-1};
+  sockaddr_in addr_{AF_INET, 0, {htonl(INADDR_LOOPBACK)}, {}};
+};
+
+constexpr size_t ReusePortSteeringTest::kNumWorkers;
+
+TEST_F(ReusePortSteeringTest, SteersShortHeaderPacketsByWorkerId) {
+  if (!attachReusePortSteeringProgram(
+          folly::NetworkSocket::fromFd(fds_[0]))) {
+    // No eBPF support, the kernel keeps steering by hash.
+    return;
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (uint8_t workerId = 0; workerId < kNumWorkers; ++workerId) {
+      send(makeShortHeaderPacket(workerId));
+      EXPECT_EQ(workerId, receiver());
+    }
+  }
+}
+
+TEST_F(ReusePortSteeringTest, FallsBackToHash) {
+  if (!attachReusePortSteeringProgram(
+          folly::NetworkSocket::fromFd(fds_[0]))) {
+    return;
+  }
+  // A worker past the group, a long header and a truncated packet all still
+  // reach one of the sockets.
+  send(makeShortHeaderPacket(kNumWorkers + 1));
+  EXPECT_NE(-1, receiver());
+  auto longHeader = makeShortHeaderPacket(2);
+  longHeader[0] = 0xc0;
+  send(longHeader);
+  EXPECT_NE(-1, receiver());
+  send({0x40, 0x40});
+  EXPECT_NE(-1, receiver());
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/state/ServerConnectionSnapshot.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <folly/portability/GTest.h>
+
+namespace quic {
+namespace test {
+
+namespace {
+ServerConnectionSnapshot makeSnapshot() {
+  ServerConnectionSnapshot snapshot;
+  snapshot.version = QuicVersion::MVFST;
+  snapshot.alpn = std::string("h3");
+  snapshot.secrets.clientSecret = std::vector<uint8_t>(32, 0x11);
+  snapshot.secrets.serverSecret = std::vector<uint8_t>(32, 0x22);
+  snapshot.clientConnectionId = ConnectionId({1, 2, 3, 4});
+  snapshot.serverConnectionId = ConnectionId({5, 6, 7, 8, 9, 10, 11, 12});
+  snapshot.selfConnectionIds.emplace_back(*snapshot.serverConnectionId, 0);
+  snapshot.selfConnectionIds.emplace_back(
+      ConnectionId({5, 6, 7, 8, 9, 10, 11, 13}), 1);
+  snapshot.selfConnectionIds.back().token = StatelessResetToken{{0xab}};
+  snapshot.peerConnectionIds.emplace_back(*snapshot.clientConnectionId, 0);
+  snapshot.nextSelfConnectionIdSequence = 2;
+  snapshot.peerAddress = folly::SocketAddress("::1", 4433);
+  snapshot.originalPeerAddress = folly::SocketAddress("127.0.0.1", 1234);
+  snapshot.peerIdleTimeout = std::chrono::milliseconds(30000);
+  snapshot.udpSendPacketLen = 1452;
+  snapshot.peerActiveConnectionIdLimit = 4;
+  snapshot.nextPacketNum = 100;
+  snapshot.largestReceivedPacketNum = 80;
+  snapshot.connWindowSize = 1000;
+  snapshot.connAdvertisedMaxOffset = 2000;
+  snapshot.connPeerAdvertisedMaxOffset = 3000;
+  snapshot.sumCurReadOffset = 10;
+  snapshot.sumMaxObservedOffset = 10;
+  snapshot.sumCurWriteOffset = 20;
+  snapshot.srtt = std::chrono::microseconds(20000);
+  snapshot.mrtt = std::chrono::microseconds(15000);
+  snapshot.streamIds.nextAcceptablePeerBidirectionalStreamId = 8;
+  snapshot.streamIds.maxRemoteBidirectionalStreamId = 400;
+  snapshot.streamIds.openBidirectionalPeerStreams = {0, 4};
+  snapshot.streamIds.openLocalStreams = {3};
+  ServerConnectionSnapshot::Stream stream;
+  stream.id = 4;
+  stream.currentWriteOffset = 20;
+  stream.currentReadOffset = 10;
+  stream.maxOffsetObserved = 10;
+  stream.finalReadOffset = 10;
+  stream.recvState = 1;
+  stream.windowSize = 100;
+  stream.priority = Priority(1, false);
+  stream.isControl = true;
+  snapshot.streams.push_back(stream);
+  return snapshot;
+}
+
+void expectSameSnapshot(
+    const ServerConnectionSnapshot& expected,
+    const ServerConnectionSnapshot& actual) {
+  EXPECT_EQ(expected.version, actual.version);
+  EXPECT_EQ(expected.alpn, actual.alpn);
+  EXPECT_EQ(expected.secrets.clientSecret, actual.secrets.clientSecret);
+  EXPECT_EQ(expected.secrets.serverSecret, actual.secrets.serverSecret);
+  EXPECT_EQ(expected.clientConnectionId, actual.clientConnectionId);
+  EXPECT_EQ(expected.serverConnectionId, actual.serverConnectionId);
+  ASSERT_EQ(expected.selfConnectionIds.size(), actual.selfConnectionIds.size());
+  for (size_t i = 0; i < expected.selfConnectionIds.size(); ++i) {
+    EXPECT_EQ(
+        expected.selfConnectionIds[i].connId,
+        actual.selfConnectionIds[i].connId);
+    EXPECT_EQ(
+        expected.selfConnectionIds[i].sequenceNumber,
+        actual.selfConnectionIds[i].sequenceNumber);
+    EXPECT_EQ(
+        expected.selfConnectionIds[i].token, actual.selfConnectionIds[i].token);
+  }
+  ASSERT_EQ(expected.peerConnectionIds.size(), actual.peerConnectionIds.size());
+  EXPECT_EQ(
+      expected.nextSelfConnectionIdSequence,
+      actual.nextSelfConnectionIdSequence);
+  EXPECT_EQ(expected.peerAddress, actual.peerAddress);
+  EXPECT_EQ(expected.originalPeerAddress, actual.originalPeerAddress);
+  EXPECT_EQ(expected.peerIdleTimeout, actual.peerIdleTimeout);
+  EXPECT_EQ(expected.udpSendPacketLen, actual.udpSendPacketLen);
+  EXPECT_EQ(
+      expected.peerActiveConnectionIdLimit, actual.peerActiveConnectionIdLimit);
+  EXPECT_EQ(expected.nextPacketNum, actual.nextPacketNum);
+  EXPECT_EQ(expected.largestReceivedPacketNum, actual.largestReceivedPacketNum);
+  EXPECT_EQ(expected.connWindowSize, actual.connWindowSize);
+  EXPECT_EQ(expected.connAdvertisedMaxOffset, actual.connAdvertisedMaxOffset);
+  EXPECT_EQ(
+      expected.connPeerAdvertisedMaxOffset, actual.connPeerAdvertisedMaxOffset);
+  EXPECT_EQ(expected.sumCurWriteOffset, actual.sumCurWriteOffset);
+  EXPECT_EQ(expected.srtt, actual.srtt);
+  EXPECT_EQ(expected.mrtt, actual.mrtt);
+  EXPECT_EQ(
+      expected.streamIds.nextAcceptablePeerBidirectionalStreamId,
+      actual.streamIds.nextAcceptablePeerBidirectionalStreamId);
+  EXPECT_EQ(
+      expected.streamIds.maxRemoteBidirectionalStreamId,
+      actual.streamIds.maxRemoteBidirectionalStreamId);
+  EXPECT_EQ(
+      expected.streamIds.openBidirectionalPeerStreams,
+      actual.streamIds.openBidirectionalPeerStreams);
+  EXPECT_EQ(
+      expected.streamIds.openLocalStreams, actual.streamIds.openLocalStreams);
+  ASSERT_EQ(expected.streams.size(), actual.streams.size());
+  for (size_t i = 0; i < expected.streams.size(); ++i) {
+    EXPECT_EQ(expected.streams[i].id, actual.streams[i].id);
+    EXPECT_EQ(
+        expected.streams[i].currentWriteOffset,
+        actual.streams[i].currentWriteOffset);
+    EXPECT_EQ(
+        expected.streams[i].currentReadOffset,
+        actual.streams[i].currentReadOffset);
+    EXPECT_EQ(
+        expected.streams[i].finalWriteOffset,
+        actual.streams[i].finalWriteOffset);
+    EXPECT_EQ(
+        expected.streams[i].finalReadOffset, actual.streams[i].finalReadOffset);
+    EXPECT_EQ(expected.streams[i].sendState, actual.streams[i].sendState);
+    EXPECT_EQ(expected.streams[i].recvState, actual.streams[i].recvState);
+    EXPECT_EQ(expected.streams[i].windowSize, actual.streams[i].windowSize);
+    EXPECT_EQ(expected.streams[i].priority, actual.streams[i].priority);
+    EXPECT_EQ(expected.streams[i].isControl, actual.streams[i].isControl);
+  }
+}
+} // namespace
+
+TEST(ServerConnectionSnapshotTest, EncodeDecode) {
+  auto snapshot = makeSnapshot();
+  auto buf = encodeServerConnectionSnapshot(snapshot);
+  auto decoded = decodeServerConnectionSnapshot(*buf);
+  ASSERT_TRUE(decoded.hasValue());
+  expectSameSnapshot(snapshot, *decoded);
+}
+
+TEST(ServerConnectionSnapshotTest, DecodeMalformed) {
+  auto buf = encodeServerConnectionSnapshot(makeSnapshot());
+  buf->coalesce();
+
+  auto truncated = folly::IOBuf::copyBuffer(buf->data(), buf->length() - 1);
+  EXPECT_FALSE(decodeServerConnectionSnapshot(*truncated).hasValue());
+
+  auto otherVersion = buf->clone();
+  otherVersion->unshare();
+  otherVersion->writableData()[0] = kServerConnectionSnapshotVersion + 1;
+  EXPECT_FALSE(decodeServerConnectionSnapshot(*otherVersion).hasValue());
+
+  auto trailing = buf->clone();
+  trailing->prependChain(folly::IOBuf::copyBuffer("x"));
+  EXPECT_FALSE(decodeServerConnectionSnapshot(*trailing).hasValue());
+}
+
+TEST(ServerConnectionSnapshotTest, WriteAndReadOverSocket) {
+  int fds[2];
+  ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  std::vector<ServerConnectionSnapshot> snapshots;
+  snapshots.push_back(makeSnapshot());
+  snapshots.push_back(makeSnapshot());
+  snapshots.back().nextPacketNum = 200;
+  ASSERT_TRUE(writeServerConnectionSnapshots(
+      folly::NetworkSocket::fromFd(fds[0]), snapshots));
+  auto read =
+      readServerConnectionSnapshots(folly::NetworkSocket::fromFd(fds[1]));
+  ASSERT_TRUE(read.hasValue());
+  ASSERT_EQ(2, read->size());
+  expectSameSnapshot(snapshots[0], (*read)[0]);
+  expectSameSnapshot(snapshots[1], (*read)[1]);
+
+  // A writer that goes away before the end of the snapshots is an error.
+  ::close(fds[0]);
+  EXPECT_FALSE(
+      readServerConnectionSnapshots(folly::NetworkSocket::fromFd(fds[1]))
+          .hasValue());
+  ::close(fds[1]);
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/SourceAddressRateLimiter.h>
+
+#include <folly/portability/GTest.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+folly::SocketAddress makeAddress(const std::string& ip) {
+  return folly::SocketAddress(ip, 4433);
+}
+
+TEST(SourceAddressRateLimiterTest, Burst) {
+  SourceAddressRateLimiter limiter(3, 32, 64);
+  auto client = makeAddress("1.2.3.4");
+  auto now = Clock::now();
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(limiter.tryAcquire(client, now));
+  }
+  EXPECT_FALSE(limiter.tryAcquire(client, now));
+
+  // The bucket refills at the rate, up to one second worth.
+  EXPECT_TRUE(limiter.tryAcquire(client, now + 400ms));
+  EXPECT_FALSE(limiter.tryAcquire(client, now + 400ms));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(limiter.tryAcquire(client, now + 10s));
+  }
+  EXPECT_FALSE(limiter.tryAcquire(client, now + 10s));
+}
+
+TEST(SourceAddressRateLimiterTest, Prefixes) {
+  SourceAddressRateLimiter limiter(1, 24, 64, 1 << 20);
+  auto now = Clock::now();
+  EXPECT_TRUE(limiter.tryAcquire(makeAddress("1.2.3.4"), now));
+  EXPECT_FALSE(limiter.tryAcquire(makeAddress("1.2.3.5"), now));
+  EXPECT_FALSE(limiter.tryAcquire(makeAddress("::ffff:1.2.3.6"), now));
+  EXPECT_TRUE(limiter.tryAcquire(makeAddress("1.2.4.4"), now));
+
+  EXPECT_TRUE(limiter.tryAcquire(makeAddress("2001:db8::1"), now));
+  EXPECT_FALSE(limiter.tryAcquire(makeAddress("2001:db8::2"), now));
+  EXPECT_TRUE(limiter.tryAcquire(makeAddress("2001:db8:0:1::1"), now));
+}
+
+TEST(SourceAddressRateLimiterTest, SharedBucket) {
+  // With a single bucket every client shares it.
+  SourceAddressRateLimiter limiter(1, 32, 64, 1);
+  auto now = Clock::now();
+  EXPECT_TRUE(limiter.tryAcquire(makeAddress("1.2.3.4"), now));
+  EXPECT_FALSE(limiter.tryAcquire(makeAddress("5.6.7.8"), now));
+}
+} // namespace test
+} // namespace quic
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/server/WorkerLoadMonitor.h>
+
+#include <folly/io/async/EventBase.h>
+#include <folly/portability/GTest.h>
+#include <thread>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+using LoadLevel = WorkerLoadMonitor::LoadLevel;
+
+LoadSheddingSettings makeSettings() {
+  LoadSheddingSettings settings;
+  settings.retry.loopLag = 10ms;
+  settings.retry.pendingPackets = 100;
+  settings.reject.loopLag = 50ms;
+  settings.dropHandshakes.loopLag = 200ms;
+  settings.dropHandshakes.pendingPackets = 1000;
+  return settings;
+}
+
+TEST(WorkerLoadMonitorTest, LoopLag) {
+  folly::EventBase evb;
+  WorkerLoadMonitor monitor(&evb, makeSettings());
+  EXPECT_EQ(LoadLevel::NORMAL, monitor.getLoadLevel());
+  monitor.onLoopLag(9ms);
+  EXPECT_EQ(LoadLevel::NORMAL, monitor.getLoadLevel());
+  monitor.onLoopLag(10ms);
+  EXPECT_EQ(LoadLevel::RETRY, monitor.getLoadLevel());
+  monitor.onLoopLag(60ms);
+  EXPECT_EQ(LoadLevel::REJECT, monitor.getLoadLevel());
+  EXPECT_EQ(60ms, monitor.getLoopLag());
+  monitor.onLoopLag(1s);
+  EXPECT_EQ(LoadLevel::DROP_HANDSHAKES, monitor.getLoadLevel());
+  // The level follows the lag back down.
+  monitor.onLoopLag(1ms);
+  EXPECT_EQ(LoadLevel::NORMAL, monitor.getLoadLevel());
+}
+
+TEST(WorkerLoadMonitorTest, PendingPackets) {
+  folly::EventBase evb;
+  WorkerLoadMonitor monitor(&evb, makeSettings());
+  monitor.onPendingPackets(99);
+  EXPECT_EQ(LoadLevel::NORMAL, monitor.getLoadLevel());
+  monitor.onPendingPackets(100);
+  EXPECT_EQ(LoadLevel::RETRY, monitor.getLoadLevel());
+  // Fewer packets don't lower the level before the next sample.
+  monitor.onPendingPackets(0);
+  EXPECT_EQ(LoadLevel::RETRY, monitor.getLoadLevel());
+  // The reject threshold has no pending packets.
+  monitor.onPendingPackets(999);
+  EXPECT_EQ(LoadLevel::RETRY, monitor.getLoadLevel());
+  monitor.onPendingPackets(1000);
+  EXPECT_EQ(LoadLevel::DROP_HANDSHAKES, monitor.getLoadLevel());
+
+  // The sample still sees the largest queue of the interval.
+  monitor.onLoopLag(0ms);
+  EXPECT_EQ(LoadLevel::DROP_HANDSHAKES, monitor.getLoadLevel());
+  monitor.onLoopLag(0ms);
+  EXPECT_EQ(LoadLevel::NORMAL, monitor.getLoadLevel());
+}
+
+TEST(WorkerLoadMonitorTest, SamplesLoopLag) {
+  folly::EventBase evb;
+  auto settings = makeSettings();
+  settings.sampleInterval = 1ms;
+  WorkerLoadMonitor monitor(&evb, settings);
+  monitor.start();
+  EXPECT_TRUE(monitor.isScheduled());
+  // Blocks the loop past the due time of the sample.
+  evb.runInLoop([] { std::this_thread::sleep_for(20ms); });
+  evb.loopOnce();
+  evb.loopOnce();
+  EXPECT_GE(monitor.getLoopLag(), 10ms);
+  EXPECT_EQ(LoadLevel::RETRY, monitor.getLoadLevel());
+  // It keeps sampling.
+  EXPECT_TRUE(monitor.isScheduled());
+}
+} // namespace test
+} // namespace quic
@@ -11,11 +11,139 @@
 #include <folly/Overload.h>
 #include <quic/logging/QuicLogger.h>
 #include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/QuicStateFunctions.h>
+#include <algorithm>
 #include <iterator>
 
 namespace quic {
 
+namespace {
+/**
+ * Once a copy of a cloned packet is acked, the other copies still outstanding
+ * carry frames that are already processed. They are retired right away rather
+ * than acked or declared lost later, so that they neither hold on to cwnd nor
+ * arm the loss timers. Returns the bytes they took up in flight on the primary
+ * path, the secondary paths are told about theirs directly.
+ */
+uint64_t retireProcessedClones(
+    QuicConnectionStateBase& conn,
+    const std::vector<PacketEvent>& ackedEvents) {
+  auto& outstandingPackets = conn.outstandingPackets;
+  uint64_t retiredBytes = 0;
+  for (auto event : ackedEvents) {
+    for (auto packetNum :
+         conn.outstandingPacketEvents.takeProcessedPackets(event)) {
+      auto rawIt = std::lower_bound(
+          outstandingPackets.rawBegin(),
+          outstandingPackets.rawEnd(),
+          packetNum,
+          [](const auto& slot, const auto& val) {
+            return slot.value.packetNum < val;
+          });
+      // Clones are application data, and the other packet number spaces can
+      // have packets with the same number.
+      for (; rawIt != outstandingPackets.rawEnd() &&
+           rawIt->value.packetNum == packetNum;
+           ++rawIt) {
+        auto& packet = rawIt->value;
+        if (rawIt->tombstone ||
+            packet.packetNumberSpace != PacketNumberSpace::AppData) {
+          continue;
+        }
+        DCHECK(packet.associatedEvent && *packet.associatedEvent == event);
+        VLOG(10) << __func__ << " retired packetNum=" << packetNum
+                 << " event=" << event << " " << conn;
+        DCHECK_GT(conn.outstandingClonedPacketsCount, 0);
+        --conn.outstandingClonedPacketsCount;
+        if (packet.pathId == kPrimaryPathId) {
+          retiredBytes += packet.encodedSize;
+        } else {
+          auto path = findSecondaryPath(conn, packet.pathId);
+          if (path && path->congestionController) {
+            path->congestionController->onRemoveBytesFromInflight(
+                packet.encodedSize);
+          }
+        }
+        outstandingPackets.tombstone(rawIt);
+        break;
+      }
+    }
+  }
+  return retiredBytes;
+}
+
+/**
+ * Takes a delivery rate sample off the largest newly acked packet: the bytes
+ * acked since the packet that was acked last when it was sent, over the
+ * longer of the time they took to be sent and to be acked. The sample goes
+ * with the ack to the congestion controller and is kept on the connection.
+ */
+void updateDeliveryRate(
+    QuicConnectionStateBase& conn,
+    CongestionController::AckEvent& ack) {
+  if (ack.ackedPackets.empty() ||
+      !ack.ackedPackets.front().lastAckedPacketInfo) {
+    return;
+  }
+  const auto& packet = ack.ackedPackets.front();
+  const auto& lastAcked = *packet.lastAckedPacketInfo;
+  auto interval = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::max(
+          packet.sentTime - lastAcked.sentTime,
+          ack.ackTime - lastAcked.ackTime));
+  if (interval.count() <= 0 ||
+      conn.lossState.totalBytesAcked < lastAcked.totalBytesAcked) {
+    return;
+  }
+  DeliveryRateSample sample;
+  sample.deliveredBytes =
+      conn.lossState.totalBytesAcked - lastAcked.totalBytesAcked;
+  sample.interval = interval;
+  sample.isAppLimited = packet.isAppLimited;
+  auto deliveryRate = sample.rate();
+  if (!sample.isAppLimited || deliveryRate > conn.lossState.deliveryRate) {
+    conn.lossState.deliveryRate = deliveryRate;
+  }
+  conn.lossState.latestDeliveryRateSample = sample;
+  ack.deliveryRateSample = sample;
+}
+
+void maybeSampleCongestionControl(
+    QuicConnectionStateBase& conn,
+    TimePoint now) {
+  auto interval = conn.transportSettings.congestionSampleInterval;
+  if (interval == 0ms || !conn.infoCallback ||
+      (conn.lastCongestionSampleTime &&
+       now - *conn.lastCongestionSampleTime < interval)) {
+    return;
+  }
+  conn.lastCongestionSampleTime = now;
+  const auto& cc = *conn.congestionController;
+  CongestionControlSample sample;
+  sample.time = now;
+  sample.serverConnectionId = conn.serverConnectionId;
+  sample.type = cc.type();
+  sample.state = cc.getStateCode();
+  sample.congestionWindow = cc.getCongestionWindow();
+  sample.inflightBytes = cc.getBytesInFlight();
+  sample.bandwidthEstimate = cc.getBandwidthEstimate();
+  sample.pacingRate = isConnectionPaced(conn) ? conn.pacer->getPacingRate() : 0;
+  sample.srtt = conn.lossState.srtt;
+  sample.mrtt = conn.lossState.mrtt;
+  conn.infoCallback->onCongestionControlSample(sample);
+}
+
+// Brings the frames of the packet into the cache ahead of its ack.
+inline void prefetchFrames(const OutstandingPacket& packet) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(packet.packet.frames.data());
+#else
+  (void)packet;
+#endif
+}
+} // namespace
+
 /**
  * Process ack frame and acked outstanding packets.
  *
@@ -39,160 +167,246 @@ void processAckFrame(
     const AckVisitor& ackVisitor,
     const LossVisitor& lossVisitor,
     const TimePoint& ackReceiveTime) {
+  QuicLatencySampler sampler(
+      conn.infoCallback,
+      QuicTransportStatsCallback::LatencyType::ACK_PROCESSING);
+  QuicCpuCostSampler cpuCostSampler(
+      conn, QuicTransportStatsCallback::CpuCostType::ACK_PROCESSING);
   DCHECK_GE(
       conn.outstandingPackets.size(), conn.outstandingPureAckPacketsCount);
   // TODO: send error if we get an ack for a packet we've not sent t18721184
   CongestionController::AckEvent ack;
   ack.ackTime = ackReceiveTime;
-  // Using kRxPacketsPendingBeforeAckThresh to reseve for ackedPackets container
-  // is a hueristic. Other quic implementations may have very different acking
-  // policy. It's also possibly that all acked packets are pure acks which leads
-  // to different number of packets being acked usually.
-  ack.ackedPackets.reserve(kRxPacketsPendingBeforeAckThresh);
-  auto currentPacketIt = getLastOutstandingPacket(conn, pnSpace);
-  uint64_t handshakePacketAcked = 0;
-  uint64_t pureAckPacketsAcked = 0;
-  uint64_t clonedPacketsAcked = 0;
-  folly::Optional<decltype(conn.lossState.lastAckedPacketSentTime)>
-      lastAckedPacketSentTime;
-  auto ackBlockIt = frame.ackBlocks.cbegin();
-  while (ackBlockIt != frame.ackBlocks.cend() &&
-         currentPacketIt != conn.outstandingPackets.rend()) {
-    // In reverse order, find the first outstanding packet that has a packet
-    // number LE the endPacket of the current ack range.
-    auto rPacketIt = std::lower_bound(
-        currentPacketIt,
-        conn.outstandingPackets.rend(),
-        ackBlockIt->endPacket,
-        [&](const auto& packetWithTime, const auto& val) {
-          return packetWithTime.packet.header.getPacketSequenceNum() > val;
+  auto& outstandingPackets = conn.outstandingPackets;
+  // The slots covered by each ack range are a contiguous span, found with two
+  // binary searches. Acked slots are only tombstoned until the end of the ack
+  // processing, so the slots stay sorted while the spans are walked. The
+  // ranges are in descending order and so are their spans, every search stops
+  // where the previous span starts.
+  using RawIterator = OutstandingPacketQueue::raw_iterator;
+  std::vector<std::pair<RawIterator, RawIterator>> ackedSpans;
+  ackedSpans.reserve(frame.ackBlocks.size());
+  size_t maxAckedPackets = 0;
+  auto searchEnd = outstandingPackets.rawEnd();
+  for (const auto& ackBlock : frame.ackBlocks) {
+    if (searchEnd == outstandingPackets.rawBegin()) {
+      break;
+    }
+    auto spanEnd = std::upper_bound(
+        outstandingPackets.rawBegin(),
+        searchEnd,
+        ackBlock.endPacket,
+        [](const auto& val, const auto& slot) {
+          return val < slot.value.packetNum;
         });
-    if (rPacketIt == conn.outstandingPackets.rend()) {
+    if (spanEnd == outstandingPackets.rawBegin()) {
       // This means that all the packets are greater than the end packet.
       // Since we iterate the ACK blocks in reverse order of end packets, our
       // work here is done.
       VLOG(10) << __func__ << " less than all outstanding packets outstanding="
-               << conn.outstandingPackets.size() << " range=["
-               << ackBlockIt->startPacket << ", " << ackBlockIt->endPacket
-               << "]"
+               << outstandingPackets.size() << " range=["
+               << ackBlock.startPacket << ", " << ackBlock.endPacket << "]"
                << " " << conn;
-      ackBlockIt++;
       break;
     }
-
-    // TODO: only process ACKs from packets which are sent from a greater than
-    // or equal to crypto protection level.
-    auto eraseEnd = rPacketIt;
-    while (rPacketIt != conn.outstandingPackets.rend()) {
-      auto currentPacketNum = rPacketIt->packet.header.getPacketSequenceNum();
-      auto currentPacketNumberSpace =
-          rPacketIt->packet.header.getPacketNumberSpace();
-      if (pnSpace != currentPacketNumberSpace) {
-        // When the next packet is not in the same packet number space, we need
-        // to skip it in current ack processing. If the iterator has moved, that
-        // means we have found packets in the current space that are acked by
-        // this ack block. So the code erases the current iterator range and
-        // move the iterator to be the next search point.
-        if (rPacketIt != eraseEnd) {
-          auto nextElem =
-              conn.outstandingPackets.erase(rPacketIt.base(), eraseEnd.base());
-          rPacketIt = std::reverse_iterator<decltype(nextElem)>(nextElem) + 1;
-          eraseEnd = rPacketIt;
-        } else {
-          rPacketIt++;
-          eraseEnd = rPacketIt;
-        }
-        continue;
-      }
-      if (currentPacketNum < ackBlockIt->startPacket) {
-        break;
-      }
-      VLOG(10) << __func__ << " acked packetNum=" << currentPacketNum
-               << " space=" << currentPacketNumberSpace
-               << " handshake=" << (int)rPacketIt->isHandshake
-               << " pureAck=" << (int)rPacketIt->pureAck << " " << conn;
-      if (rPacketIt->isHandshake) {
-        ++handshakePacketAcked;
+    auto spanBegin = std::lower_bound(
+        outstandingPackets.rawBegin(),
+        spanEnd,
+        ackBlock.startPacket,
+        [](const auto& slot, const auto& val) {
+          return slot.value.packetNum < val;
+        });
+    if (spanBegin != spanEnd) {
+      ackedSpans.emplace_back(spanBegin, spanEnd);
+      maxAckedPackets += std::distance(spanBegin, spanEnd);
+    }
+    searchEnd = spanBegin;
+  }
+  // The first pass only reads the packet numbers, spaces and tombstones of
+  // the slots, in order, and collects the packets the ack is for. The second
+  // one applies the ack to them, with the frames of the packets a few ahead
+  // prefetched, since for a large window they are likely out of the cache.
+  // Walked from the largest packet number down, so the first packet acked
+  // is the largest one.
+  std::vector<RawIterator> ackedSlots;
+  ackedSlots.reserve(maxAckedPackets);
+  for (const auto& span : ackedSpans) {
+    for (auto rawIt = span.second; rawIt != span.first;) {
+      --rawIt;
+      // Skip the packets acked earlier and the packets from the other packet
+      // number spaces, which have their own acks.
+      if (!rawIt->tombstone && pnSpace == rawIt->value.packetNumberSpace) {
+        ackedSlots.push_back(rawIt);
       }
-      if (!rPacketIt->pureAck) {
-        ack.ackedBytes += rPacketIt->encodedSize;
-      } else {
-        ++pureAckPacketsAcked;
+    }
+  }
+  ack.ackedPackets.reserve(ackedSlots.size());
+  uint64_t handshakePacketAcked = 0;
+  uint64_t pureAckPacketsAcked = 0;
+  uint64_t clonedPacketsAcked = 0;
+  uint64_t ackedEncodedBytes = 0;
+  // Events of the acked clones, whose other copies can be retired.
+  std::vector<PacketEvent> ackedEvents;
+  folly::Optional<decltype(conn.lossState.lastAckedPacketSentTime)>
+      lastAckedPacketSentTime;
+  // Acks of the packets sent on secondary paths, for their own congestion
+  // controllers. Reserved so that the pointers into it stay valid.
+  std::vector<std::pair<PathId, CongestionController::AckEvent>> pathAcks;
+  if (!conn.secondaryPaths.empty()) {
+    pathAcks.reserve(conn.secondaryPaths.size());
+  }
+  // TODO: only process ACKs from packets which are sent from a greater than
+  // or equal to crypto protection level.
+  for (size_t i = 0; i < ackedSlots.size(); ++i) {
+    if (i + kAckPrefetchDistance < ackedSlots.size()) {
+      prefetchFrames(ackedSlots[i + kAckPrefetchDistance]->value);
+    }
+    auto slotIt = ackedSlots[i];
+    auto& packet = slotIt->value;
+    auto currentPacketNum = packet.packetNum;
+    auto currentPacketNumberSpace = packet.packetNumberSpace;
+    VLOG(10) << __func__ << " acked packetNum=" << currentPacketNum
+             << " space=" << currentPacketNumberSpace
+             << " handshake=" << (int)packet.isHandshake
+             << " pureAck=" << (int)packet.pureAck << " " << conn;
+    // Packets of a secondary path that is gone are no longer accounted
+    // for by any congestion controller.
+    CongestionController::AckEvent* pathAck = &ack;
+    SecondaryPath* path = nullptr;
+    if (packet.pathId != kPrimaryPathId) {
+      pathAck = nullptr;
+      path = findSecondaryPath(conn, packet.pathId);
+      if (path) {
+        auto it = std::find_if(
+            pathAcks.begin(), pathAcks.end(), [&](const auto& entry) {
+              return entry.first == path->id;
+            });
+        if (it == pathAcks.end()) {
+          pathAcks.emplace_back(path->id, CongestionController::AckEvent());
+          it = std::prev(pathAcks.end());
+          it->second.ackTime = ackReceiveTime;
+        }
+        pathAck = &it->second;
+        path->largestAckedPacket =
+            std::max(path->largestAckedPacket.value_or(0), currentPacketNum);
       }
-      if (rPacketIt->associatedEvent) {
-        ++clonedPacketsAcked;
+    }
+    if (packet.isHandshake) {
+      ++handshakePacketAcked;
+    }
+    if (!packet.pureAck) {
+      if (pathAck) {
+        pathAck->ackedBytes += packet.encodedSize;
       }
-      // Update RTT if current packet is the largestAcked in the frame:
-      auto ackReceiveTimeOrNow =
-          ackReceiveTime > rPacketIt->time ? ackReceiveTime : Clock::now();
-      auto rttSample = std::chrono::duration_cast<std::chrono::microseconds>(
-          ackReceiveTimeOrNow - rPacketIt->time);
-      if (currentPacketNum == frame.largestAcked && !rPacketIt->pureAck) {
+    } else {
+      ++pureAckPacketsAcked;
+    }
+    if (packet.associatedEvent) {
+      ++clonedPacketsAcked;
+    }
+    // Update RTT if current packet is the largestAcked in the frame:
+    auto ackReceiveTimeOrNow =
+        ackReceiveTime > packet.time ? ackReceiveTime : Clock::now();
+    auto rttSample = std::chrono::duration_cast<std::chrono::microseconds>(
+        ackReceiveTimeOrNow - packet.time);
+    if (currentPacketNum == frame.largestAcked && !packet.pureAck) {
+      if (path) {
+        updatePathRtt(*path, rttSample, frame.ackDelay);
+      } else if (packet.pathId == kPrimaryPathId) {
         updateRtt(conn, rttSample, frame.ackDelay);
       }
-      if (conn.qLogger) {
-        conn.qLogger->addPacketAck(currentPacketNumberSpace, currentPacketNum);
+    }
+    if (conn.qLogger) {
+      conn.qLogger->addPacketAck(currentPacketNumberSpace, currentPacketNum);
+    }
+    QUIC_TRACE(
+        packet_acked,
+        conn,
+        toString(currentPacketNumberSpace),
+        currentPacketNum);
+    // Only invoke AckVisitor if the packet doesn't have an associated
+    // PacketEvent; or the PacketEvent is outstanding in
+    // conn.outstandingPacketEvents
+    if (!packet.associatedEvent ||
+        conn.outstandingPacketEvents.count(*packet.associatedEvent)) {
+      for (auto& packetFrame : packet.packet.frames) {
+        ackVisitor(packet, packetFrame, frame);
       }
-      QUIC_TRACE(
-          packet_acked,
-          conn,
-          toString(currentPacketNumberSpace),
-          currentPacketNum);
-      // Only invoke AckVisitor if the packet doesn't have an associated
-      // PacketEvent; or the PacketEvent is in conn.outstandingPacketEvents
-      if (!rPacketIt->associatedEvent ||
-          conn.outstandingPacketEvents.count(*rPacketIt->associatedEvent)) {
-        for (auto& packetFrame : rPacketIt->packet.frames) {
-          ackVisitor(*rPacketIt, packetFrame, frame);
-        }
-        // Remove this PacketEvent from the outstandingPacketEvents set
-        if (rPacketIt->associatedEvent) {
-          conn.outstandingPacketEvents.erase(*rPacketIt->associatedEvent);
-        }
+      // Mark this PacketEvent as processed
+      if (packet.associatedEvent) {
+        conn.outstandingPacketEvents.erase(*packet.associatedEvent);
       }
-      if (!ack.largestAckedPacket ||
-          *ack.largestAckedPacket < currentPacketNum) {
-        ack.largestAckedPacket = currentPacketNum;
-        ack.largestAckedPacketSentTime = rPacketIt->time;
-        ack.largestAckedPacketAppLimited = rPacketIt->isAppLimited;
+    }
+    if (packet.associatedEvent) {
+      conn.outstandingPacketEvents.removePacket(
+          *packet.associatedEvent, currentPacketNum);
+      ackedEvents.push_back(*packet.associatedEvent);
+    }
+    if (pathAck) {
+      if (!pathAck->largestAckedPacket ||
+          *pathAck->largestAckedPacket < currentPacketNum) {
+        pathAck->largestAckedPacket = currentPacketNum;
+        pathAck->largestAckedPacketSentTime = packet.time;
+        pathAck->largestAckedPacketAppLimited = packet.isAppLimited;
       }
-      if (ackReceiveTime > rPacketIt->time) {
-        ack.mrttSample =
-            std::min(ack.mrttSample.value_or(rttSample), rttSample);
+      if (ackReceiveTime > packet.time) {
+        pathAck->mrttSample =
+            std::min(pathAck->mrttSample.value_or(rttSample), rttSample);
       }
-      conn.lossState.totalBytesAcked += rPacketIt->encodedSize;
-      conn.lossState.totalBytesSentAtLastAck = conn.lossState.totalBytesSent;
-      conn.lossState.totalBytesAckedAtLastAck = conn.lossState.totalBytesAcked;
-      if (!lastAckedPacketSentTime) {
-        lastAckedPacketSentTime = rPacketIt->time;
+    }
+    if (packet.pathId == kPrimaryPathId) {
+      if (pnSpace == PacketNumberSpace::AppData) {
+        conn.lossState.largestPrimaryPathAcked = std::max(
+            conn.lossState.largestPrimaryPathAcked.value_or(0),
+            currentPacketNum);
       }
-      conn.lossState.lastAckedTime = ackReceiveTime;
-      ack.ackedPackets.push_back(
+    } else {
+      // Loss detection still has to see the largest packet acked.
+      auto& largestAcked = getAckState(conn, pnSpace).largestAckedByPeer;
+      largestAcked = std::max(largestAcked, currentPacketNum);
+      conn.lossState.ptoCount = 0;
+      conn.lossState.handshakeAlarmCount = 0;
+    }
+    ackedEncodedBytes += packet.encodedSize;
+    if (!lastAckedPacketSentTime) {
+      lastAckedPacketSentTime = packet.time;
+    }
+    if (pathAck) {
+      pathAck->ackedPackets.push_back(
           CongestionController::AckEvent::AckPacket::Builder()
-              .setSentTime(rPacketIt->time)
-              .setEncodedSize(rPacketIt->encodedSize)
-              .setLastAckedPacketInfo(std::move(rPacketIt->lastAckedPacketInfo))
-              .setTotalBytesSentThen(rPacketIt->totalBytesSent)
-              .setAppLimited(rPacketIt->isAppLimited)
+              .setSentTime(packet.time)
+              .setEncodedSize(packet.encodedSize)
+              .setLastAckedPacketInfo(std::move(packet.lastAckedPacketInfo))
+              .setTotalBytesSentThen(packet.totalBytesSent)
+              .setAppLimited(packet.isAppLimited)
               .build());
-      rPacketIt++;
-    }
-    // Done searching for acked outstanding packets in current ack block. Erase
-    // the current iterator range which is the last batch of continuous
-    // outstanding packets that are in this ack block. Move the iterator to be
-    // the next search point.
-    if (rPacketIt != eraseEnd) {
-      auto nextElem =
-          conn.outstandingPackets.erase(rPacketIt.base(), eraseEnd.base());
-      currentPacketIt = std::reverse_iterator<decltype(nextElem)>(nextElem);
-    } else {
-      currentPacketIt = rPacketIt;
     }
-    ackBlockIt++;
+    outstandingPackets.tombstone(slotIt);
   }
   if (lastAckedPacketSentTime) {
+    conn.lossState.totalBytesAcked += ackedEncodedBytes;
+    conn.lossState.totalBytesSentAtLastAck = conn.lossState.totalBytesSent;
+    conn.lossState.totalBytesAckedAtLastAck = conn.lossState.totalBytesAcked;
+    conn.lossState.lastAckedTime = ackReceiveTime;
     conn.lossState.lastAckedPacketSentTime = *lastAckedPacketSentTime;
   }
+  if (!ackedEvents.empty()) {
+    auto retiredBytes = retireProcessedClones(conn, ackedEvents);
+    if (retiredBytes && conn.congestionController) {
+      conn.congestionController->onRemoveBytesFromInflight(retiredBytes);
+    }
+  }
+  outstandingPackets.maybeCompact();
+  if (frame.ecnCounts) {
+    // Reordered acks can carry smaller counts than the ones already seen.
+    auto& ecnAcked = getAckState(conn, pnSpace).ecnCountsAckedByPeer;
+    if (frame.ecnCounts->ce > ecnAcked.ce) {
+      ack.ecnCEMarks = frame.ecnCounts->ce - ecnAcked.ce;
+    }
+    ecnAcked.ect0 = std::max(ecnAcked.ect0, frame.ecnCounts->ect0);
+    ecnAcked.ect1 = std::max(ecnAcked.ect1, frame.ecnCounts->ect1);
+    ecnAcked.ce = std::max(ecnAcked.ce, frame.ecnCounts->ce);
+  }
   DCHECK_GE(conn.outstandingHandshakePacketsCount, handshakePacketAcked);
   conn.outstandingHandshakePacketsCount -= handshakePacketAcked;
   DCHECK_GE(conn.outstandingPureAckPacketsCount, pureAckPacketsAcked);
@@ -204,6 +418,27 @@ void processAckFrame(
   DCHECK_GE(
       updatedOustandingPacketsCount, conn.outstandingHandshakePacketsCount);
   DCHECK_GE(updatedOustandingPacketsCount, conn.outstandingClonedPacketsCount);
+  if (conn.transportSettings.rackLossDetection &&
+      !conn.lossState.recentLostPackets.empty()) {
+    auto spuriousLoss =
+        detectSpuriousLosses(conn, pnSpace, frame, ackReceiveTime);
+    if (spuriousLoss && conn.congestionController &&
+        conn.congestionController->onSpuriousLoss(*spuriousLoss)) {
+      ++conn.lossState.congestionUndoCount;
+      QUIC_STATS(conn.infoCallback, onCongestionUndo);
+    }
+  }
+  QUIC_SDT(
+      ack_processed,
+      conn,
+      static_cast<uint8_t>(pnSpace),
+      frame.largestAcked,
+      ack.ackedBytes,
+      conn.outstandingPackets.size());
+  if (pnSpace == PacketNumberSpace::AppData) {
+    onPmtuAck(conn, frame, ack, ackReceiveTime);
+  }
+  updateDeliveryRate(conn, ack);
   auto lossEvent = handleAckForLoss(conn, lossVisitor, ack, pnSpace);
   if (conn.congestionController &&
       (ack.largestAckedPacket.hasValue() || lossEvent)) {
@@ -216,6 +451,23 @@ void processAckFrame(
     }
     conn.congestionController->onPacketAckOrLoss(
         std::move(ack), std::move(lossEvent));
+    QUIC_SDT(
+        congestion_window,
+        conn,
+        conn.congestionController->getCongestionWindow(),
+        conn.congestionController->getWritableBytes());
+    maybeSampleCongestionControl(conn, ackReceiveTime);
+  }
+  for (auto& pathAck : pathAcks) {
+    auto path = findSecondaryPath(conn, pathAck.first);
+    if (path && path->congestionController &&
+        pathAck.second.largestAckedPacket) {
+      path->congestionController->onPacketAckOrLoss(
+          std::move(pathAck.second), folly::none);
+    }
+  }
+  if (pnSpace == PacketNumberSpace::AppData) {
+    updateAckFrequency(conn);
   }
 }
 
@@ -233,6 +485,7 @@ void commonAckVisitorForAckFrame(
     ackState.acks.withdraw(*iter);
     iter++;
   }
+  ackState.acksEncoding.invalidate();
   if (!frame.ackBlocks.empty()) {
     auto largestAcked = frame.ackBlocks.back().end;
     if (largestAcked > kAckPurgingThresh) {
@@ -8,15 +8,113 @@
 
 #pragma once
 
+#include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
 #include <quic/common/IntervalSet.h>
 
+#include <array>
+
 namespace quic {
 
+/**
+ * The gap and length fields of the ack blocks under the largest one, as
+ * encoded for the last ack frame. New packets mostly extend the largest block
+ * or add blocks above it, which leaves the fields of the blocks under it as
+ * they are, so writeAckFrame only encodes the blocks above the cached largest
+ * block and copies the rest.
+ */
+struct AckBlocksEncoding {
+  // The largest ack block when the encoding was last updated, none when there
+  // is no encoding.
+  folly::Optional<Interval<PacketNum>> largestBlock;
+  // The number of ack blocks at that time.
+  size_t numBlocks{0};
+  // The encoded fields, largest block first.
+  std::vector<uint8_t> encoded;
+  // The size of the fields of each block in encoded.
+  std::vector<uint8_t> blockSizes;
+
+  // Has to be called when the ack blocks change other than by a larger
+  // packet number.
+  void invalidate() {
+    largestBlock = folly::none;
+    numBlocks = 0;
+    encoded.clear();
+    blockSizes.clear();
+  }
+};
+
+/**
+ * The packet numbers received among the last kReceivedPacketWindowSize ones
+ * up to the largest, to tell the duplicates apart in constant time. The acks
+ * can't, their blocks are withdrawn once the peer has seen them. The bit of a
+ * packet number is at its value modulo the window size, so moving the window
+ * up by one packet only clears one bit.
+ */
+class ReceivedPacketWindow {
+ public:
+  static_assert(
+      kReceivedPacketWindowSize % 64 == 0,
+      "The window is made of 64 bit words");
+
+  /**
+   * Records the packet number. Returns false if it was already received. The
+   * ones older than the window are reported as new, the window can't tell.
+   */
+  bool insert(PacketNum packetNum) {
+    if (!largest_ || packetNum > *largest_) {
+      if (!largest_ || packetNum - *largest_ >= kReceivedPacketWindowSize) {
+        bits_.fill(0);
+      } else {
+        for (PacketNum pn = *largest_ + 1; pn < packetNum; ++pn) {
+          clear(pn);
+        }
+      }
+      largest_ = packetNum;
+      set(packetNum);
+      return true;
+    }
+    if (*largest_ - packetNum >= kReceivedPacketWindowSize) {
+      return true;
+    }
+    if (test(packetNum)) {
+      return false;
+    }
+    set(packetNum);
+    return true;
+  }
+
+ private:
+  static size_t index(PacketNum packetNum) {
+    return (packetNum % kReceivedPacketWindowSize) / 64;
+  }
+
+  static uint64_t mask(PacketNum packetNum) {
+    return uint64_t(1) << (packetNum % 64);
+  }
+
+  bool test(PacketNum packetNum) const {
+    return bits_[index(packetNum)] & mask(packetNum);
+  }
+
+  void set(PacketNum packetNum) {
+    bits_[index(packetNum)] |= mask(packetNum);
+  }
+
+  void clear(PacketNum packetNum) {
+    bits_[index(packetNum)] &= ~mask(packetNum);
+  }
+
+  std::array<uint64_t, kReceivedPacketWindowSize / 64> bits_{};
+  folly::Optional<PacketNum> largest_;
+};
+
 // Ack and PacketNumber states. This is per-packet number space.
 struct AckState {
   using Acks = IntervalSet<PacketNum>;
   Acks acks;
+  // Cache of the encoding of acks, updated when an ack frame is written.
+  mutable AckBlocksEncoding acksEncoding;
   // Largest ack that has been written to a packet
   folly::Optional<PacketNum> largestAckScheduled;
   // Flag indicating that if we need to send ack immediately. This will be set
@@ -29,6 +127,11 @@ struct AckState {
   uint64_t numNonRxPacketsRecvd{0};
   // Count of oustanding packets received with retransmittable data.
   uint8_t numRxPacketsRecvd{0};
+  // Retransmittable packets received in order and without a CE mark since
+  // the last one that wasn't, with adaptiveAcks.
+  uint64_t numInOrderRxPacketsRecvd{0};
+  // Whether the last packet received was CE marked.
+  bool ecnCeReceived{false};
   // The receive time of the largest ack packet
   folly::Optional<TimePoint> largestRecvdPacketTime;
   // Latest packet number acked by peer
@@ -36,10 +139,17 @@ struct AckState {
   PacketNum largestAckedByPeer{0};
   // Largest received packet numbers on the connection.
   folly::Optional<PacketNum> largestReceivedPacketNum;
+  // With TransportSettings::dropDuplicatePackets.
+  ReceivedPacketWindow receivedPackets;
   // Largest received packet number at the time we sent our last close message.
   folly::Optional<PacketNum> largestReceivedAtLastCloseSent;
   // Next PacketNum we will send for packet in this packet number space
   PacketNum nextPacketNum{0};
+  // ECN codepoints of the packets received from the peer, echoed in our acks.
+  ECNCounts ecnCountsReceived;
+  // Largest ECN counts the peer has reported for our packets. The counts in
+  // acks only ever grow, so the new CE marks are the increase over these.
+  ECNCounts ecnCountsAckedByPeer;
 };
 
 struct AckStates {
@@ -51,4 +161,21 @@ struct AckStates {
   AckState appDataAckState;
 };
 
+// State of the ack frequency extension, in both directions.
+struct AckFrequencyState {
+  // The min_ack_delay the peer advertised. The peer can only be sent
+  // ACK_FREQUENCY frames when it is set.
+  folly::Optional<std::chrono::microseconds> peerMinAckDelay;
+  // The max_ack_delay the peer advertised, if any.
+  folly::Optional<std::chrono::microseconds> peerMaxAckDelay;
+  // The last ACK_FREQUENCY frame sent to the peer, which may still be
+  // pending.
+  folly::Optional<AckFrequencyFrame> requested;
+  uint64_t nextSequenceNumber{0};
+
+  // The ACK_FREQUENCY frame with the largest sequence number received from
+  // the peer. Without one, the default thresholds of the acks apply.
+  folly::Optional<AckFrequencyFrame> received;
+};
+
 } // namespace quic
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/BufferMemoryBudget.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace quic {
+
+BufferMemoryBudget::BufferMemoryBudget(
+    uint64_t budget,
+    double pressureThreshold)
+    : budget_(budget), pressureBytes_(budget * pressureThreshold) {
+  DCHECK_GT(pressureThreshold, 0);
+  DCHECK_LE(pressureThreshold, 1);
+}
+
+void BufferMemoryBudget::update(
+    uint64_t previousBytes,
+    uint64_t currentBytes) {
+  DCHECK_GE(bytesBuffered_, previousBytes);
+  bytesBuffered_ = bytesBuffered_ - previousBytes + currentBytes;
+  highWaterMark_ = std::max(highWaterMark_, bytesBuffered_);
+}
+
+uint64_t BufferMemoryBudget::available() const {
+  return underPressure() ? 0 : pressureBytes_ - bytesBuffered_;
+}
+
+bool BufferMemoryBudget::underPressure() const {
+  return bytesBuffered_ >= pressureBytes_;
+}
+
+uint64_t BufferMemoryBudget::adjustWindowSize(uint64_t windowSize) const {
+  if (!underPressure()) {
+    return windowSize;
+  }
+  // Keep the connections moving, more slowly, rather than stalling them.
+  return std::max<uint64_t>(windowSize / kBufferPressureWindowDivisor, 1);
+}
+} // namespace quic
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace quic {
+
+// Fraction of the budget above which the connections are asked to back off.
+constexpr double kDefaultBufferPressureThreshold = 0.8;
+// The receive windows advertised under pressure are divided by this.
+constexpr uint64_t kBufferPressureWindowDivisor = 4;
+
+/**
+ * Accounts for the stream data buffered by all the connections of a server
+ * worker, so that a few slow readers can't grow the worker without bound.
+ * Every connection reports how many bytes it buffers, and once the total is
+ * above the pressure threshold the connections advertise smaller receive
+ * windows and stop reporting buffer space to the application, which pauses
+ * the onConnectionWriteReady and onStreamWriteReady callbacks.
+ *
+ * The budget is meant to be used from the worker's thread only.
+ */
+class BufferMemoryBudget {
+ public:
+  using SharedPtr = std::shared_ptr<BufferMemoryBudget>;
+
+  explicit BufferMemoryBudget(
+      uint64_t budget,
+      double pressureThreshold = kDefaultBufferPressureThreshold);
+
+  /**
+   * Replaces the previousBytes a connection reported with currentBytes.
+   */
+  void update(uint64_t previousBytes, uint64_t currentBytes);
+
+  uint64_t budget() const {
+    return budget_;
+  }
+
+  uint64_t bytesBuffered() const {
+    return bytesBuffered_;
+  }
+
+  /**
+   * The largest number of bytes that have been buffered at once.
+   */
+  uint64_t highWaterMark() const {
+    return highWaterMark_;
+  }
+
+  /**
+   * Bytes that can still be buffered before reaching the pressure threshold.
+   */
+  uint64_t available() const;
+
+  bool underPressure() const;
+
+  /**
+   * The receive window to advertise instead of windowSize.
+   */
+  uint64_t adjustWindowSize(uint64_t windowSize) const;
+
+ private:
+  uint64_t budget_;
+  uint64_t pressureBytes_;
+  uint64_t bytesBuffered_{0};
+  uint64_t highWaterMark_{0};
+};
+} // namespace quic
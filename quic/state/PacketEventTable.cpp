@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/PacketEventTable.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace quic {
+
+bool PacketEventTable::insert(PacketEvent event) {
+  auto& slot = findOrCreate(event);
+  if (slot.outstanding) {
+    return false;
+  }
+  slot.outstanding = true;
+  ++numOutstanding_;
+  return true;
+}
+
+size_t PacketEventTable::count(PacketEvent event) const {
+  auto slot = find(event);
+  return slot && slot->outstanding ? 1 : 0;
+}
+
+size_t PacketEventTable::erase(PacketEvent event) {
+  auto slot = find(event);
+  if (!slot || !slot->outstanding) {
+    return 0;
+  }
+  slot->outstanding = false;
+  DCHECK_GT(numOutstanding_, 0);
+  --numOutstanding_;
+  maybeRelease(*slot);
+  return 1;
+}
+
+void PacketEventTable::clear() {
+  slots_.clear();
+  numOutstanding_ = 0;
+}
+
+void PacketEventTable::addPacket(PacketEvent event, PacketNum packetNum) {
+  auto& packets = findOrCreate(event).packets;
+  if (std::find(packets.begin(), packets.end(), packetNum) == packets.end()) {
+    packets.push_back(packetNum);
+  }
+}
+
+void PacketEventTable::removePacket(PacketEvent event, PacketNum packetNum) {
+  auto slot = find(event);
+  if (!slot) {
+    return;
+  }
+  auto it = std::find(slot->packets.begin(), slot->packets.end(), packetNum);
+  if (it != slot->packets.end()) {
+    slot->packets.erase(it);
+    maybeRelease(*slot);
+  }
+}
+
+PacketEventTable::Packets PacketEventTable::takeProcessedPackets(
+    PacketEvent event) {
+  Packets packets;
+  auto slot = find(event);
+  if (slot && !slot->outstanding) {
+    packets = std::move(slot->packets);
+    slot->packets.clear();
+    maybeRelease(*slot);
+  }
+  return packets;
+}
+
+size_t PacketEventTable::numPackets(PacketEvent event) const {
+  auto slot = find(event);
+  return slot ? slot->packets.size() : 0;
+}
+
+PacketEventTable::Slot* PacketEventTable::find(PacketEvent event) {
+  if (event < base_ || event - base_ >= slots_.size()) {
+    return nullptr;
+  }
+  auto& slot = slots_[event - base_];
+  return slot.used ? &slot : nullptr;
+}
+
+const PacketEventTable::Slot* PacketEventTable::find(PacketEvent event) const {
+  return const_cast<PacketEventTable*>(this)->find(event);
+}
+
+PacketEventTable::Slot& PacketEventTable::findOrCreate(PacketEvent event) {
+  if (slots_.empty()) {
+    base_ = event;
+    slots_.emplace_back();
+  } else if (event < base_) {
+    slots_.insert(slots_.begin(), base_ - event, Slot());
+    base_ = event;
+  } else if (event - base_ >= slots_.size()) {
+    slots_.resize(event - base_ + 1);
+  }
+  auto& slot = slots_[event - base_];
+  slot.used = true;
+  return slot;
+}
+
+void PacketEventTable::maybeRelease(Slot& slot) {
+  if (slot.outstanding || !slot.packets.empty()) {
+    return;
+  }
+  slot.used = false;
+  while (!slots_.empty() && !slots_.front().used) {
+    slots_.pop_front();
+    ++base_;
+  }
+  while (!slots_.empty() && !slots_.back().used) {
+    slots_.pop_back();
+  }
+}
+} // namespace quic
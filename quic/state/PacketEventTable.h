@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+
+#include <folly/small_vector.h>
+#include <quic/codec/Types.h>
+
+namespace quic {
+
+/**
+ * There are cases that we may clone an outstanding packet and resend it as is.
+ * When that happens, we assign a PacketEvent to both the original and cloned
+ * packet if no PacketEvent is already associated with the original packet. If
+ * the original packet already has a PacketEvent, we copy that value into the
+ * cloned packet.
+ * A connection maintains a table of PacketEvents. When a packet with a
+ * PacketEvent is acked or lost, we look it up in the table. If the PacketEvent
+ * is still outstanding, we process the ack or loss event (e.g. update RTT,
+ * notify CongestionController, and detect loss with this packet) as well as
+ * frames in the packet. Then we mark the PacketEvent as processed. If the
+ * PacketEvent is processed already, we consider all frames contained in the
+ * packet are already processed. We will still handle the ack or loss event and
+ * update the connection. But no frame will be processed.
+ */
+using PacketEvent = PacketNum;
+
+/**
+ * The PacketEvents of a connection, indexed by the event itself. An event is
+ * the packet number of the original packet, and only application data packets
+ * are cloned, so the events of a connection all come from the same packet
+ * number space and stay within the window of outstanding packets: the table
+ * is a ring of slots from the oldest to the newest event still referenced.
+ *
+ * Besides whether its frames still have to be processed, every slot keeps the
+ * packet numbers of the copies carrying the event that are still outstanding.
+ * Once any copy is acked, the others can be retired in bulk instead of being
+ * acked or declared lost one at a time later on.
+ *
+ * insert(), count(), erase(), size() and empty() work like they would on a set
+ * of the events whose frames haven't been processed yet.
+ */
+class PacketEventTable {
+ public:
+  using Packets = folly::small_vector<PacketNum, 2>;
+
+  /**
+   * Adds event as outstanding. Returns false if it already was.
+   */
+  bool insert(PacketEvent event);
+
+  /**
+   * 1 if the frames of event still have to be processed, 0 otherwise.
+   */
+  size_t count(PacketEvent event) const;
+
+  /**
+   * Marks event as processed, returns 1 if it was outstanding. The slot stays
+   * until the copies carrying the event are removed.
+   */
+  size_t erase(PacketEvent event);
+
+  size_t size() const {
+    return numOutstanding_;
+  }
+
+  bool empty() const {
+    return numOutstanding_ == 0;
+  }
+
+  void clear();
+
+  /**
+   * Records that the outstanding packet packetNum carries event.
+   */
+  void addPacket(PacketEvent event, PacketNum packetNum);
+
+  /**
+   * Records that packetNum left the outstanding packets.
+   */
+  void removePacket(PacketEvent event, PacketNum packetNum);
+
+  /**
+   * The outstanding packets carrying event, which the caller is about to
+   * remove. Nothing is returned for outstanding events.
+   */
+  Packets takeProcessedPackets(PacketEvent event);
+
+  /**
+   * Number of outstanding packets carrying event.
+   */
+  size_t numPackets(PacketEvent event) const;
+
+ private:
+  struct Slot {
+    bool used{false};
+    bool outstanding{false};
+    Packets packets;
+  };
+
+  Slot* find(PacketEvent event);
+  const Slot* find(PacketEvent event) const;
+  Slot& findOrCreate(PacketEvent event);
+  // Frees the slot if nothing references it anymore, then trims the free
+  // slots at both ends of the ring.
+  void maybeRelease(Slot& slot);
+
+  // The event of slots_.front()
+  PacketEvent base_{0};
+  std::deque<Slot> slots_;
+  size_t numOutstanding_{0};
+};
+} // namespace quic
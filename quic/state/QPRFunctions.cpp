@@ -11,27 +11,47 @@
 #include <quic/state/QuicStreamFunctions.h>
 #include <quic/state/QuicStreamUtilities.h>
 
+#include <iterator>
+
 namespace quic {
 namespace {
 
-// shrink the buffers until offset, either by popping up or trimming from start
-void shrinkBuffers(std::deque<StreamBuffer>& buffers, uint64_t offset) {
-  while (!buffers.empty()) {
-    auto curr = buffers.begin();
-    if (curr->offset >= offset) {
-      // the buffers are supposed to be sorted, so we are done here
-      break;
-    }
-    size_t currSize = curr->data.chainLength();
-    if (curr->offset + currSize <= offset) {
-      buffers.pop_front();
-    } else {
-      uint64_t amount = offset - curr->offset;
-      curr->data.trimStartAtMost(amount);
-      curr->offset += amount;
-      break;
-    }
+// Trims the start of the buffer that crosses offset.
+void trimBufferTo(StreamBuffer& buffer, uint64_t offset) {
+  if (buffer.offset < offset) {
+    uint64_t amount = offset - buffer.offset;
+    buffer.data.trimStartAtMost(amount);
+    buffer.offset += amount;
+  }
+}
+
+// Shrinks the buffers until offset, erasing the ones before it and trimming
+// the one it crosses. The buffers are found by a binary search, and erased at
+// once.
+void shrinkBuffers(StreamReadBuffer& buffers, uint64_t offset) {
+  // The buffers are keyed by their end, the first one left ends after offset.
+  auto first = buffers.lowerBound(offset + 1);
+  first = buffers.erase(buffers.begin(), first);
+  if (first != buffers.end()) {
+    trimBufferTo(*first, offset);
+  }
+}
+
+void shrinkBuffers(StreamBufferQueue& buffers, uint64_t offset) {
+  auto last = buffers.lowerBound(
+      offset, [](const auto& buffer, const auto& offsetIn) {
+        return buffer.offset < offsetIn;
+      });
+  if (last == buffers.begin()) {
+    return;
+  }
+  // Only the buffer right before the ones at offset can cross it.
+  auto crossing = std::prev(last);
+  if (crossing->offset + crossing->data.chainLength() > offset) {
+    trimBufferTo(*crossing, offset);
+    last = crossing;
   }
+  buffers.erase(buffers.begin(), last);
 }
 
 void shrinkRetransmittableBuffers(
@@ -200,6 +220,37 @@ folly::Optional<uint64_t> advanceMinimumRetransmittableOffset(
   return minimumStreamOffset;
 }
 
+folly::Optional<uint64_t> expireDataPastDeadline(
+    QuicStreamState* stream,
+    TimePoint now) {
+  folly::Optional<uint64_t> expiredOffset;
+  auto& deadlines = stream->writeDeadlines;
+  while (!deadlines.empty() && deadlines.front().second <= now) {
+    expiredOffset = deadlines.front().first;
+    deadlines.pop_front();
+  }
+  if (deadlines.empty()) {
+    stream->conn.streamManager->removeDeadline(stream->id);
+  }
+  if (!expiredOffset ||
+      *expiredOffset <= getStreamNextOffsetToDeliver(*stream)) {
+    // Everything past its deadline was delivered in time.
+    return folly::none;
+  }
+  VLOG(10) << __func__ << ": expiring stream=" << stream->id
+           << " until offset=" << *expiredOffset;
+  return advanceMinimumRetransmittableOffset(stream, *expiredOffset);
+}
+
+folly::Optional<TimePoint> getNextWriteDeadline(const QuicStreamState& stream) {
+  for (const auto& deadline : stream.writeDeadlines) {
+    if (deadline.first > stream.currentWriteOffset) {
+      return deadline.second;
+    }
+  }
+  return folly::none;
+}
+
 void onRecvExpiredStreamDataFrame(
     QuicStreamState* stream,
     const ExpiredStreamDataFrame& frame) {
@@ -35,6 +35,20 @@ folly::Optional<uint64_t> advanceMinimumRetransmittableOffset(
     QuicStreamState* stream,
     uint64_t minimumRetransmittableOffset);
 
+/**
+ * Expire the data of a stream whose delivery deadline has passed by now, so
+ * that it is skipped instead of being retransmitted. Returns the new minimum
+ * retransmittable offset if it moved.
+ */
+folly::Optional<uint64_t> expireDataPastDeadline(
+    QuicStreamState* stream,
+    TimePoint now);
+
+/**
+ * Returns the deadline of the next data of the stream to be written, if any.
+ */
+folly::Optional<TimePoint> getNextWriteDeadline(const QuicStreamState& stream);
+
 /**
  * processing upon receipt of ExpiredStreamDataFrame
  */
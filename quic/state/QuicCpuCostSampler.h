@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/chrono/Hardware.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * Adds the cycles spent in the enclosing scope to the CPU cost of the
+ * connection, and reports them to its stats callback, on one out of every
+ * TransportSettings::cpuCostSamplingRate scopes of the same type. The cycles
+ * are read from the time stamp counter where there is one.
+ */
+class QuicCpuCostSampler {
+ public:
+  QuicCpuCostSampler(
+      QuicConnectionStateBase& conn,
+      QuicTransportStatsCallback::CpuCostType type)
+      : conn_(conn),
+        type_(static_cast<size_t>(type)),
+        samplingRate_(conn.transportSettings.cpuCostSamplingRate) {
+    if (samplingRate_ && conn_.cpuCosts.calls[type_]++ % samplingRate_ == 0) {
+      start_ = folly::hardware_timestamp();
+    } else {
+      samplingRate_ = 0;
+    }
+  }
+
+  ~QuicCpuCostSampler() {
+    if (!samplingRate_) {
+      return;
+    }
+    auto end = folly::hardware_timestamp();
+    // The counters of the cores may not be in sync if the thread moved.
+    if (end < start_) {
+      return;
+    }
+    uint64_t cycles = (end - start_) * samplingRate_;
+    conn_.cpuCosts.cycles[type_] += cycles;
+    ++conn_.cpuCosts.samples[type_];
+    QUIC_STATS(
+        conn_.infoCallback,
+        onCpuCost,
+        static_cast<QuicTransportStatsCallback::CpuCostType>(type_),
+        cycles);
+  }
+
+  QuicCpuCostSampler(const QuicCpuCostSampler&) = delete;
+  QuicCpuCostSampler& operator=(const QuicCpuCostSampler&) = delete;
+
+ private:
+  QuicConnectionStateBase& conn_;
+  size_t type_;
+  // 0 when this scope isn't sampled.
+  uint64_t samplingRate_;
+  uint64_t start_{0};
+};
+} // namespace quic
@@ -12,14 +12,14 @@
 #include <quic/logging/QuicLogger.h>
 
 namespace {
-std::deque<quic::OutstandingPacket>::reverse_iterator
+quic::OutstandingPacketQueue::reverse_iterator
 getPreviousOutstandingPacket(
     quic::QuicConnectionStateBase& conn,
     quic::PacketNumberSpace packetNumberSpace,
-    std::deque<quic::OutstandingPacket>::reverse_iterator from) {
+    quic::OutstandingPacketQueue::reverse_iterator from) {
   return std::find_if(
       from, conn.outstandingPackets.rend(), [=](const auto& op) {
-        return packetNumberSpace == op.packet.header.getPacketNumberSpace();
+        return packetNumberSpace == op.packetNumberSpace;
       });
 }
 
@@ -82,6 +82,42 @@ void updateRtt(
       conn.lossState.srtt.count());
 }
 
+void updatePathRtt(
+    SecondaryPath& path,
+    std::chrono::microseconds rttSample,
+    std::chrono::microseconds ackDelay) {
+  std::chrono::microseconds minRtt = timeMin(path.mrtt, rttSample);
+  bool shouldUseAckDelay = (rttSample > ackDelay) &&
+      (rttSample > minRtt + ackDelay || path.mrtt == kDefaultMinRtt);
+  if (shouldUseAckDelay) {
+    rttSample -= ackDelay;
+  }
+  path.mrtt = minRtt;
+  path.lrtt = rttSample;
+  if (path.srtt == 0us) {
+    path.srtt = rttSample;
+    path.rttvar = rttSample / 2;
+  } else {
+    path.rttvar = path.rttvar * (kRttBeta - 1) / kRttBeta +
+        (path.srtt > rttSample ? path.srtt - rttSample
+                               : rttSample - path.srtt) /
+            kRttBeta;
+    path.srtt = path.srtt * (kRttAlpha - 1) / kRttAlpha + rttSample / kRttAlpha;
+  }
+}
+
+SecondaryPath* findSecondaryPath(QuicConnectionStateBase& conn, PathId id) {
+  if (id == kPrimaryPathId) {
+    return nullptr;
+  }
+  for (auto& path : conn.secondaryPaths) {
+    if (path.id == id) {
+      return &path;
+    }
+  }
+  return nullptr;
+}
+
 void updateAckSendStateOnRecvPacket(
     QuicConnectionStateBase& conn,
     AckState& ackState,
@@ -89,10 +125,34 @@ void updateAckSendStateOnRecvPacket(
     bool pktHasRetransmittableData,
     bool pktHasCryptoData) {
   DCHECK(!pktHasCryptoData || pktHasRetransmittableData);
-  uint8_t thresh =
+  uint64_t rxThresh = kRxPacketsPendingBeforeAckThresh;
+  const auto& ackFrequency = conn.ackFrequencyState.received;
+  bool ecnCe = ackState.ecnCeReceived;
+  ackState.ecnCeReceived = false;
+  if (conn.transportSettings.adaptiveAcks) {
+    // The ack timer still bounds the delay of the acks of a bulk receive.
+    rxThresh = std::min<uint64_t>(
+        kMaxRxPacketsPendingBeforeAckThresh,
+        rxThresh +
+            ackState.numInOrderRxPacketsRecvd / kRxPacketsPerAckThreshIncrease);
+    if (pktOutOfOrder || ecnCe) {
+      ackState.numInOrderRxPacketsRecvd = 0;
+    } else if (pktHasRetransmittableData) {
+      ++ackState.numInOrderRxPacketsRecvd;
+    }
+  }
+  if (ackFrequency) {
+    rxThresh = ackFrequency->packetTolerance;
+    pktOutOfOrder = pktOutOfOrder && !ackFrequency->ignoreOrder;
+  }
+  if (conn.transportSettings.adaptiveAcks && ecnCe) {
+    // The congestion signal reaches the peer without the ack delay.
+    pktOutOfOrder = true;
+  }
+  uint64_t thresh =
       ((pktHasRetransmittableData || ackState.numRxPacketsRecvd)
-           ? kRxPacketsPendingBeforeAckThresh
-           : kNonRxPacketsPendingBeforeAckThresh);
+           ? rxThresh
+           : std::max<uint64_t>(rxThresh, kNonRxPacketsPendingBeforeAckThresh));
   if (pktHasRetransmittableData) {
     if (pktHasCryptoData || pktOutOfOrder ||
         ++ackState.numRxPacketsRecvd + ackState.numNonRxPacketsRecvd >=
@@ -136,6 +196,80 @@ void updateAckSendStateOnRecvPacket(
   }
 }
 
+namespace {
+// Whether current is off by more than 25% from previous.
+template <typename T>
+bool changedEnough(T previous, T current) {
+  return current * 4 < previous * 3 || current * 4 > previous * 5;
+}
+} // namespace
+
+void updateAckFrequency(QuicConnectionStateBase& conn) {
+  auto& state = conn.ackFrequencyState;
+  if (!conn.transportSettings.ackFrequencyEnabled || !state.peerMinAckDelay ||
+      !conn.congestionController ||
+      conn.lossState.srtt == std::chrono::microseconds::zero()) {
+    return;
+  }
+  uint64_t packetTolerance = conn.congestionController->getCongestionWindow() /
+      conn.udpSendPacketLen / kAckFrequencyAcksPerCwnd;
+  packetTolerance = std::min(
+      std::max(packetTolerance, kMinAckFrequencyPacketTolerance),
+      kMaxAckFrequencyPacketTolerance);
+  auto maxAckDelay = timeMin(
+      timeMax(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              conn.lossState.srtt / kAckFrequencyAcksPerRtt),
+          *state.peerMinAckDelay),
+      state.peerMaxAckDelay.value_or(kMaxAckTimeout));
+  if (state.requested &&
+      !changedEnough(state.requested->packetTolerance, packetTolerance) &&
+      !changedEnough(
+          state.requested->updateMaxAckDelay.count(), maxAckDelay.count())) {
+    return;
+  }
+  AckFrequencyFrame frame(
+      state.nextSequenceNumber++,
+      packetTolerance,
+      maxAckDelay,
+      conn.transportSettings.ackFrequencyIgnoreOrder);
+  // A pending frame that has not been written yet is replaced.
+  auto& frames = conn.pendingEvents.frames;
+  auto pending = std::find_if(frames.begin(), frames.end(), [](const auto& f) {
+    return f.type() == QuicSimpleFrame::Type::AckFrequencyFrame_E;
+  });
+  if (pending != frames.end()) {
+    *pending = frame;
+  } else {
+    frames.emplace_back(frame);
+  }
+  VLOG(10) << conn << " ack frequency packetTolerance=" << packetTolerance
+           << " maxAckDelay=" << maxAckDelay.count() << "us";
+  state.requested = std::move(frame);
+}
+
+void onDatagramReceived(
+    QuicConnectionStateBase& conn,
+    ReadDatagramFrame&& frame) {
+  auto maxFrameSize = conn.transportSettings.maxDatagramFrameSize;
+  if (maxFrameSize == 0) {
+    throw QuicTransportException(
+        "Received unexpected datagram frame",
+        TransportErrorCode::PROTOCOL_VIOLATION);
+  }
+  auto len = frame.data ? frame.data->computeChainDataLength() : 0;
+  if (len > maxFrameSize) {
+    throw QuicTransportException(
+        "Datagram frame too large", TransportErrorCode::PROTOCOL_VIOLATION);
+  }
+  auto& readBuffer = conn.datagramState.readBuffer;
+  readBuffer.push_back(std::move(frame.data));
+  if (readBuffer.size() > conn.transportSettings.datagramReadBufferSize) {
+    readBuffer.pop_front();
+    conn.datagramState.numReadDropped++;
+  }
+}
+
 void updateAckStateOnAckTimeout(QuicConnectionStateBase& conn) {
   VLOG(10) << conn << " ack immediately due to ack timeout";
   conn.ackStates.appDataAckState.needsToSendAckImmediately = true;
@@ -164,7 +298,34 @@ void updateAckSendStateOnSentPacketWithAcks(
 
 bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept {
   return (
-      conn.transportSettings.pacingEnabled && conn.canBePaced && conn.pacer);
+      conn.transportSettings.pacingEnabled && conn.canBePaced && conn.pacer &&
+      !conn.transportSettings.txTimePacing);
+}
+
+bool isConnectionTxTimePaced(const QuicConnectionStateBase& conn) noexcept {
+  return (
+      conn.transportSettings.pacingEnabled && conn.canBePaced && conn.pacer &&
+      conn.transportSettings.txTimePacing);
+}
+
+uint64_t getWritePacketLimit(QuicConnectionStateBase& conn) {
+  uint64_t limit = conn.transportSettings.writeConnectionDataPacketsLimit;
+  if (isConnectionPaced(conn)) {
+    limit = conn.pacer->updateAndGetWriteBatchSize(Clock::now());
+  } else if (
+      isConnectionTxTimePaced(conn) && conn.congestionController &&
+      conn.udpSendPacketLen > 0) {
+    // The departure times space out the packets, so a whole window can be
+    // handed to the kernel at once.
+    limit = std::max<uint64_t>(
+        limit,
+        conn.congestionController->getCongestionWindow() /
+            conn.udpSendPacketLen);
+  }
+  if (conn.writePacketAllowance) {
+    limit = std::min(limit, *conn.writePacketAllowance);
+  }
+  return limit;
 }
 
 AckState& getAckState(
@@ -215,26 +376,75 @@ void increaseNextPacketNum(
   getAckState(conn, pnSpace).nextPacketNum++;
 }
 
-std::deque<OutstandingPacket>::iterator getFirstOutstandingPacket(
+void updateOneRttKeys(QuicConnectionStateBase& conn) {
+  auto& keyUpdate = conn.oneRttKeyUpdate;
+  if (!keyUpdate.updater || !conn.oneRttWriteCipher || !conn.readCodec ||
+      !conn.readCodec->getOneRttReadCipher()) {
+    return;
+  }
+  if (!conn.readCodec->getNextOneRttReadCipher()) {
+    conn.readCodec->setNextOneRttReadCipher(
+        keyUpdate.updater->makeNextReadCipher());
+  }
+  if (!keyUpdate.nextWriteCipher) {
+    keyUpdate.nextWriteCipher = keyUpdate.updater->makeNextWriteCipher();
+  }
+  auto readPhase = conn.readCodec->getOneRttReadPhase();
+  if (keyUpdate.localUpdatePending) {
+    // Until the peer answers, its packets of the previous phase don't mean
+    // that it updated its keys once more.
+    keyUpdate.localUpdatePending = readPhase != keyUpdate.writePhase;
+    return;
+  }
+  auto nextPacketNum = getNextPacketNum(conn, PacketNumberSpace::AppData);
+  bool peerUpdate = readPhase != keyUpdate.writePhase;
+  // An endpoint can only start a key update once a packet of the current
+  // phase is acked.
+  bool localUpdate = !peerUpdate &&
+      conn.transportSettings.keyUpdatePacketInterval > 0 &&
+      nextPacketNum - keyUpdate.writePhaseStartPacketNum >=
+          conn.transportSettings.keyUpdatePacketInterval &&
+      conn.lossState.lastAckedPacketSentTime &&
+      *conn.lossState.lastAckedPacketSentTime >= keyUpdate.writePhaseStartTime;
+  if (!peerUpdate && !localUpdate) {
+    return;
+  }
+  conn.oneRttWriteCipher = std::move(keyUpdate.nextWriteCipher);
+  keyUpdate.writePhase = keyUpdate.writePhase == ProtectionType::KeyPhaseZero
+      ? ProtectionType::KeyPhaseOne
+      : ProtectionType::KeyPhaseZero;
+  keyUpdate.writePhaseStartPacketNum = nextPacketNum;
+  keyUpdate.writePhaseStartTime = Clock::now();
+  keyUpdate.localUpdatePending = localUpdate;
+  ++keyUpdate.numKeyUpdates;
+  if (conn.qLogger) {
+    conn.qLogger->addTransportStateUpdate(
+        localUpdate ? kLocalKeyUpdate : kPeerKeyUpdate);
+  }
+  QUIC_TRACE(
+      fst_trace, conn, localUpdate ? "local key update" : "peer key update");
+}
+
+OutstandingPacketQueue::iterator getFirstOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace) {
   return getNextOutstandingPacket(
       conn, packetNumberSpace, conn.outstandingPackets.begin());
 }
 
-std::deque<OutstandingPacket>::reverse_iterator getLastOutstandingPacket(
+OutstandingPacketQueue::reverse_iterator getLastOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace) {
   return getPreviousOutstandingPacket(
       conn, packetNumberSpace, conn.outstandingPackets.rbegin());
 }
 
-std::deque<OutstandingPacket>::iterator getNextOutstandingPacket(
+OutstandingPacketQueue::iterator getNextOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace,
-    std::deque<OutstandingPacket>::iterator from) {
+    OutstandingPacketQueue::iterator from) {
   return std::find_if(from, conn.outstandingPackets.end(), [=](const auto& op) {
-    return packetNumberSpace == op.packet.header.getPacketNumberSpace();
+    return packetNumberSpace == op.packetNumberSpace;
   });
 }
 
@@ -308,4 +518,194 @@ std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestLossTimer(
       std::make_pair(
           conn.lossState.appDataLossTime, PacketNumberSpace::AppData));
 }
+
+void updateWriteLimit(
+    QuicConnectionStateBase& conn,
+    WriteLimit limit,
+    TimePoint now) noexcept {
+  auto& state = conn.writeLimitState;
+  if (limit == state.limit) {
+    return;
+  }
+  // The time before the first write isn't charged to anything.
+  if (state.limitStartTime != TimePoint() && now > state.limitStartTime) {
+    state.time[static_cast<size_t>(state.limit)] +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - state.limitStartTime);
+  }
+  state.limit = limit;
+  state.limitStartTime = now;
+}
+
+namespace {
+
+void finishPmtuSize(QuicConnectionStateBase& conn, TimePoint now) {
+  auto& pmtu = conn.pmtuDiscovery;
+  pmtu.probe.clear();
+  pmtu.probeSize = 0;
+  pmtu.lostProbes = 0;
+  if (pmtu.searchHigh < conn.udpSendPacketLen + kPmtuSearchGranularity) {
+    VLOG(4) << "Path MTU search done udpSendPacketLen="
+            << conn.udpSendPacketLen << " " << conn;
+    if (conn.udpSendPacketLen < pmtu.maxSize) {
+      pmtu.nextSearchTime = now + kPmtuRaiseTimer;
+    }
+  }
+}
+
+} // namespace
+
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxPacketSize) {
+  if (!conn.transportSettings.pmtuDiscoveryEnabled) {
+    return;
+  }
+  auto& pmtu = conn.pmtuDiscovery;
+  pmtu = QuicConnectionStateBase::PmtuDiscoveryState();
+  pmtu.baseSize = conn.udpSendPacketLen;
+  pmtu.maxSize =
+      std::min(conn.transportSettings.maxPmtuProbeSize, peerMaxPacketSize);
+  pmtu.searchHigh = pmtu.maxSize;
+  pmtu.enabled = pmtu.maxSize >= pmtu.baseSize + kPmtuSearchGranularity;
+}
+
+folly::Optional<uint64_t> getPmtuProbeSize(
+    QuicConnectionStateBase& conn,
+    TimePoint now) {
+  auto& pmtu = conn.pmtuDiscovery;
+  if (!pmtu.enabled || !conn.lossState.largestPrimaryPathAcked) {
+    return folly::none;
+  }
+  if (pmtu.probe) {
+    auto pto = conn.lossState.srtt + 4 * conn.lossState.rttvar +
+        conn.lossState.maxAckDelay;
+    if (now - pmtu.probe->sentTime < kPmtuProbeTimeoutPtos * pto) {
+      return folly::none;
+    }
+    onPmtuProbeLost(conn, now);
+  }
+  if (pmtu.nextSearchTime) {
+    if (now < *pmtu.nextSearchTime) {
+      return folly::none;
+    }
+    pmtu.nextSearchTime.clear();
+    pmtu.searchHigh = pmtu.maxSize;
+  }
+  if (pmtu.searchHigh < conn.udpSendPacketLen + kPmtuSearchGranularity) {
+    return folly::none;
+  }
+  if (!pmtu.probeSize) {
+    pmtu.probeSize = pmtu.searchHigh == pmtu.maxSize
+        ? pmtu.maxSize
+        : conn.udpSendPacketLen +
+            (pmtu.searchHigh - conn.udpSendPacketLen + 1) / 2;
+  }
+  return pmtu.probeSize;
+}
+
+void onPmtuProbeWritten(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t size,
+    TimePoint sentTime) {
+  conn.pmtuDiscovery.probe =
+      QuicConnectionStateBase::PmtuDiscoveryState::Probe{
+          packetNum, size, sentTime};
+}
+
+void onPmtuProbeLost(
+    QuicConnectionStateBase& conn,
+    TimePoint now,
+    bool sizeRefused) {
+  auto& pmtu = conn.pmtuDiscovery;
+  pmtu.probe.clear();
+  if (!sizeRefused && ++pmtu.lostProbes < kMaxPmtuProbes) {
+    return;
+  }
+  VLOG(4) << "Path MTU probe failed size=" << pmtu.probeSize << " " << conn;
+  pmtu.searchHigh = pmtu.probeSize - 1;
+  finishPmtuSize(conn, now);
+}
+
+void onPmtuAck(
+    QuicConnectionStateBase& conn,
+    const ReadAckFrame& frame,
+    const CongestionController::AckEvent& ack,
+    TimePoint now) {
+  auto& pmtu = conn.pmtuDiscovery;
+  if (!pmtu.enabled) {
+    return;
+  }
+  for (const auto& packet : ack.ackedPackets) {
+    if (packet.encodedSize > pmtu.baseSize) {
+      pmtu.largePacketsLost = 0;
+      break;
+    }
+  }
+  if (!pmtu.probe) {
+    return;
+  }
+  auto probePacketNum = pmtu.probe->packetNum;
+  bool acked = std::any_of(
+      frame.ackBlocks.begin(), frame.ackBlocks.end(), [&](const auto& block) {
+        return block.startPacket <= probePacketNum &&
+            probePacketNum <= block.endPacket;
+      });
+  if (acked) {
+    conn.udpSendPacketLen = pmtu.probe->size;
+    VLOG(4) << "Path MTU probe acked udpSendPacketLen="
+            << conn.udpSendPacketLen << " " << conn;
+    if (conn.qLogger) {
+      conn.qLogger->addTransportStateUpdate(kPmtuProbeAcked);
+    }
+    finishPmtuSize(conn, now);
+  } else if (
+      frame.largestAcked >
+      probePacketNum + conn.lossState.reorderingThreshold) {
+    onPmtuProbeLost(conn, now);
+  }
+}
+
+void onPmtuPacketLost(QuicConnectionStateBase& conn, uint64_t encodedSize) {
+  auto& pmtu = conn.pmtuDiscovery;
+  if (!pmtu.enabled || encodedSize <= pmtu.baseSize ||
+      ++pmtu.largePacketsLost < kPmtuBlackHoleThreshold) {
+    return;
+  }
+  VLOG(4) << "Path MTU black hole, back to udpSendPacketLen="
+          << pmtu.baseSize << " " << conn;
+  if (conn.qLogger) {
+    conn.qLogger->addTransportStateUpdate(kPmtuBlackHole);
+  }
+  restartPmtuDiscovery(conn);
+}
+
+void restartPmtuDiscovery(QuicConnectionStateBase& conn) {
+  auto& pmtu = conn.pmtuDiscovery;
+  if (!pmtu.enabled) {
+    return;
+  }
+  conn.udpSendPacketLen = pmtu.baseSize;
+  pmtu.searchHigh = pmtu.maxSize;
+  pmtu.probeSize = 0;
+  pmtu.lostProbes = 0;
+  pmtu.probe.clear();
+  pmtu.nextSearchTime.clear();
+  pmtu.largePacketsLost = 0;
+}
+
+std::chrono::microseconds getWriteLimitTime(
+    const QuicConnectionStateBase& conn,
+    WriteLimit limit,
+    TimePoint now) noexcept {
+  const auto& state = conn.writeLimitState;
+  auto time = state.time[static_cast<size_t>(limit)];
+  if (limit == state.limit && state.limitStartTime != TimePoint() &&
+      now > state.limitStartTime) {
+    time += std::chrono::duration_cast<std::chrono::microseconds>(
+        now - state.limitStartTime);
+  }
+  return time;
+}
 } // namespace quic
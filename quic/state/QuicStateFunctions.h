@@ -11,6 +11,7 @@
 #include <folly/Overload.h>
 #include <quic/codec/QuicPacketBuilder.h>
 #include <quic/codec/Types.h>
+#include <quic/logging/QuicLogger.h>
 #include <quic/state/StateData.h>
 #include <quic/state/stream/StreamStateMachine.h>
 
@@ -25,6 +26,21 @@ void updateAckSendStateOnRecvPacket(
 
 void updateAckStateOnAckTimeout(QuicConnectionStateBase& conn);
 
+/**
+ * Queues an ACK_FREQUENCY frame that asks the peer for fewer acks when the
+ * peer supports it and the cwnd or the rtt changed enough since the last
+ * one.
+ */
+void updateAckFrequency(QuicConnectionStateBase& conn);
+
+/**
+ * Queues a received DATAGRAM frame for the application. The oldest one is
+ * dropped when the application doesn't read them fast enough.
+ */
+void onDatagramReceived(
+    QuicConnectionStateBase& conn,
+    ReadDatagramFrame&& frame);
+
 void updateAckSendStateOnSentPacketWithAcks(
     QuicConnectionStateBase& conn,
     AckState& ackState,
@@ -35,25 +51,74 @@ void updateRtt(
     std::chrono::microseconds rttSample,
     std::chrono::microseconds ackDelay);
 
+/**
+ * Same as updateRtt() for the rtt stats of a secondary path.
+ */
+void updatePathRtt(
+    SecondaryPath& path,
+    std::chrono::microseconds rttSample,
+    std::chrono::microseconds ackDelay);
+
+/**
+ * The secondary path of id, nullptr for the primary path or a path that is
+ * gone.
+ */
+SecondaryPath* findSecondaryPath(QuicConnectionStateBase& conn, PathId id);
+
 template <typename Event>
 void invokeStreamSendStateMachine(
-    QuicConnectionStateBase&,
+    QuicConnectionStateBase& conn,
     QuicStreamState& stream,
     Event event) {
+  auto oldState = stream.send.state.which();
   invokeHandler<StreamSendStateMachine>(stream.send, std::move(event), stream);
+  if (stream.send.state.which() != oldState) {
+    QUIC_SDT(
+        stream_send_state,
+        conn,
+        stream.id,
+        oldState,
+        stream.send.state.which());
+  }
 }
 
 template <typename Event>
 void invokeStreamReceiveStateMachine(
-    QuicConnectionStateBase&,
+    QuicConnectionStateBase& conn,
     QuicStreamState& stream,
     Event event) {
+  auto oldState = stream.recv.state.which();
   invokeHandler<StreamReceiveStateMachine>(
       stream.recv, std::move(event), stream);
+  if (stream.recv.state.which() != oldState) {
+    QUIC_SDT(
+        stream_receive_state,
+        conn,
+        stream.id,
+        oldState,
+        stream.recv.state.which());
+  }
 }
 
+/**
+ * Whether the connection is paced with the pacing timer.
+ */
 bool isConnectionPaced(const QuicConnectionStateBase& conn) noexcept;
 
+/**
+ * Whether the connection is paced by the kernel, with an SO_TXTIME departure
+ * time on every packet.
+ */
+bool isConnectionTxTimePaced(const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * The number of packets the transport can write in one go: a burst when the
+ * pacing timer paces the connection, a congestion window when the kernel
+ * does, and writeConnectionDataPacketsLimit otherwise. It is capped by the
+ * allowance of the worker's write scheduler when there is one.
+ */
+uint64_t getWritePacketLimit(QuicConnectionStateBase& conn);
+
 AckState& getAckState(
     QuicConnectionStateBase& conn,
     PacketNumberSpace pnSpace) noexcept;
@@ -74,21 +139,42 @@ void increaseNextPacketNum(
     PacketNumberSpace pnSpace) noexcept;
 
 /**
- * Update largestReceivedPacketNum in ackState with packetNum. Return if the
- * current packetNum is received out of order.
+ * Update largestReceivedPacketNum in ackState with packetNum, and count the
+ * ECN codepoint the packet was received with. Return if the current packetNum
+ * is received out of order.
  */
 template <typename ClockType = quic::Clock>
 bool updateLargestReceivedPacketNum(
     AckState& ackState,
     PacketNum packetNum,
-    TimePoint receivedTime) {
+    TimePoint receivedTime,
+    ECNCodepoint ecn = ECNCodepoint::NotECT) {
   PacketNum expectedNextPacket = 0;
   if (ackState.largestReceivedPacketNum) {
     expectedNextPacket = *ackState.largestReceivedPacketNum + 1;
   }
+  if (ackState.largestReceivedPacketNum &&
+      packetNum < *ackState.largestReceivedPacketNum) {
+    // A reordered packet can change any ack block, not just the largest one.
+    ackState.acksEncoding.invalidate();
+  }
   ackState.largestReceivedPacketNum = std::max<PacketNum>(
       ackState.largestReceivedPacketNum.value_or(packetNum), packetNum);
   ackState.acks.insert(packetNum);
+  switch (ecn) {
+    case ECNCodepoint::ECT0:
+      ++ackState.ecnCountsReceived.ect0;
+      break;
+    case ECNCodepoint::ECT1:
+      ++ackState.ecnCountsReceived.ect1;
+      break;
+    case ECNCodepoint::CE:
+      ++ackState.ecnCountsReceived.ce;
+      ackState.ecnCeReceived = true;
+      break;
+    case ECNCodepoint::NotECT:
+      break;
+  }
   if (ackState.largestReceivedPacketNum == packetNum) {
     ackState.largestRecvdPacketTime = receivedTime;
   }
@@ -96,15 +182,15 @@ bool updateLargestReceivedPacketNum(
   return expectedNextPacket != packetNum;
 }
 
-std::deque<OutstandingPacket>::iterator getNextOutstandingPacket(
+OutstandingPacketQueue::iterator getNextOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace,
-    std::deque<OutstandingPacket>::iterator from);
-std::deque<OutstandingPacket>::iterator getFirstOutstandingPacket(
+    OutstandingPacketQueue::iterator from);
+OutstandingPacketQueue::iterator getFirstOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace);
 
-std::deque<OutstandingPacket>::reverse_iterator getLastOutstandingPacket(
+OutstandingPacketQueue::reverse_iterator getLastOutstandingPacket(
     QuicConnectionStateBase& conn,
     PacketNumberSpace packetNumberSpace);
 
@@ -125,4 +211,91 @@ folly::Optional<TimePoint>& getLossTime(
 
 std::pair<folly::Optional<TimePoint>, PacketNumberSpace> earliestLossTimer(
     const QuicConnectionStateBase& conn) noexcept;
+
+/**
+ * Moves the connection to a new WriteLimit, charging the time since the last
+ * change to the previous one.
+ */
+void updateWriteLimit(
+    QuicConnectionStateBase& conn,
+    WriteLimit limit,
+    TimePoint now) noexcept;
+
+/**
+ * The time spent in the limit, including the time in the current one so far.
+ */
+std::chrono::microseconds getWriteLimitTime(
+    const QuicConnectionStateBase& conn,
+    WriteLimit limit,
+    TimePoint now) noexcept;
+
+/**
+ * Starts the search for the path MTU with pmtuDiscoveryEnabled, from
+ * udpSendPacketLen up to the smaller of maxPmtuProbeSize and the
+ * max_packet_size of the peer. The first probe tries the largest size, which
+ * the path usually carries when it was configured for it, then the search
+ * halves the range between the sizes known to work and not to.
+ */
+void startPmtuDiscovery(
+    QuicConnectionStateBase& conn,
+    uint64_t peerMaxPacketSize);
+
+/**
+ * The size of the probe to write now, none while a probe is in flight or the
+ * search is over. Only probes once the peer acked a 1-rtt packet. Counts the
+ * probe in flight as lost once it is kPmtuProbeTimeoutPtos PTOs old.
+ */
+folly::Optional<uint64_t> getPmtuProbeSize(
+    QuicConnectionStateBase& conn,
+    TimePoint now);
+
+void onPmtuProbeWritten(
+    QuicConnectionStateBase& conn,
+    PacketNum packetNum,
+    uint64_t size,
+    TimePoint sentTime);
+
+/**
+ * A size is known not to work after kMaxPmtuProbes of its probes were lost,
+ * or right away if the socket refused to send it.
+ */
+void onPmtuProbeLost(
+    QuicConnectionStateBase& conn,
+    TimePoint now,
+    bool sizeRefused = false);
+
+/**
+ * Raises udpSendPacketLen to the size of the probe if the ack covers it, or
+ * counts the probe as lost if the ack covers packets sent well after it.
+ * An ack of packets larger than the size the search started from resets the
+ * black hole detection.
+ */
+void onPmtuAck(
+    QuicConnectionStateBase& conn,
+    const ReadAckFrame& frame,
+    const CongestionController::AckEvent& ack,
+    TimePoint now);
+
+/**
+ * Counts the lost packets larger than the size the search started from. After
+ * kPmtuBlackHoleThreshold of them in a row, the path is assumed to no longer
+ * carry them: udpSendPacketLen goes back to that size and the search starts
+ * over.
+ */
+void onPmtuPacketLost(QuicConnectionStateBase& conn, uint64_t encodedSize);
+
+/**
+ * Goes back to the size the search started from and searches again, for a
+ * new path.
+ */
+void restartPmtuDiscovery(QuicConnectionStateBase& conn);
+
+/**
+ * Derives the 1-rtt ciphers of the next key phase that are missing, then
+ * switches the writes to the next key phase if the peer moved to it or if
+ * keyUpdatePacketInterval packets were sent in the current one and the peer
+ * acked one of them. Meant to be called after reading, so that both the key
+ * derivations and the switch stay out of the packet read and write paths.
+ */
+void updateOneRttKeys(QuicConnectionStateBase& conn);
 } // namespace quic
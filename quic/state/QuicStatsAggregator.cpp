@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/state/QuicStatsAggregator.h>
+
+namespace quic {
+
+namespace {
+// The shard has a single writer, so a relaxed load and store is enough and
+// avoids the locked instruction of fetch_add.
+void increment(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+  counter.store(
+      counter.load(std::memory_order_relaxed) + delta,
+      std::memory_order_relaxed);
+}
+} // namespace
+
+class QuicStatsAggregator::WorkerStats : public QuicTransportStatsCallback {
+ public:
+  WorkerStats(std::shared_ptr<Shard> shard, bool sampleLatencies)
+      : shard_(std::move(shard)), sampleLatencies_(sampleLatencies) {}
+
+  ~WorkerStats() override = default;
+
+  void onPacketReceived() override {
+    bump(Counter::PACKET_RECEIVED);
+  }
+
+  void onDuplicatedPacketReceived() override {
+    bump(Counter::DUPLICATED_PACKET_RECEIVED);
+  }
+
+  void onOutOfOrderPacketReceived() override {
+    bump(Counter::OUT_OF_ORDER_PACKET_RECEIVED);
+  }
+
+  void onPacketProcessed() override {
+    bump(Counter::PACKET_PROCESSED);
+  }
+
+  void onPacketSent() override {
+    bump(Counter::PACKET_SENT);
+  }
+
+  void onPacketRetransmission() override {
+    bump(Counter::PACKET_RETRANSMISSION);
+  }
+
+  void onPacketDropped(PacketDropReason reason) override {
+    if (reason < PacketDropReason::MAX) {
+      increment(shard_->packetDrops[static_cast<size_t>(reason)]);
+    }
+  }
+
+  void onPacketForwarded() override {
+    bump(Counter::PACKET_FORWARDED);
+  }
+
+  void onForwardedPacketReceived() override {
+    bump(Counter::FORWARDED_PACKET_RECEIVED);
+  }
+
+  void onForwardedPacketProcessed() override {
+    bump(Counter::FORWARDED_PACKET_PROCESSED);
+  }
+
+  void onNewConnection() override {
+    bump(Counter::NEW_CONNECTION);
+  }
+
+  void onConnectionClose(
+      folly::Optional<ConnectionCloseReason> reason) override {
+    auto closeReason = reason.value_or(ConnectionCloseReason::NONE);
+    if (closeReason < ConnectionCloseReason::MAX) {
+      increment(shard_->connectionCloses[static_cast<size_t>(closeReason)]);
+    }
+  }
+
+  void onNewQuicStream() override {
+    bump(Counter::NEW_QUIC_STREAM);
+  }
+
+  void onQuicStreamClosed() override {
+    bump(Counter::QUIC_STREAM_CLOSED);
+  }
+
+  void onQuicStreamReset() override {
+    bump(Counter::QUIC_STREAM_RESET);
+  }
+
+  void onConnFlowControlUpdate() override {
+    bump(Counter::CONN_FLOW_CONTROL_UPDATE);
+  }
+
+  void onConnFlowControlBlocked() override {
+    bump(Counter::CONN_FLOW_CONTROL_BLOCKED);
+  }
+
+  void onStatelessReset() override {
+    bump(Counter::STATELESS_RESET);
+  }
+
+  void onStreamFlowControlUpdate() override {
+    bump(Counter::STREAM_FLOW_CONTROL_UPDATE);
+  }
+
+  void onStreamFlowControlBlocked() override {
+    bump(Counter::STREAM_FLOW_CONTROL_BLOCKED);
+  }
+
+  void onCwndBlocked() override {
+    bump(Counter::CWND_BLOCKED);
+  }
+
+  void onPTO() override {
+    bump(Counter::PTO);
+  }
+
+  void onRead(size_t bufSize) override {
+    bump(Counter::BYTES_READ, bufSize);
+  }
+
+  void onWrite(size_t bufSize) override {
+    bump(Counter::BYTES_WRITTEN, bufSize);
+  }
+
+  void onRecvBufferPoolStats(size_t pooledBuffers, size_t highWaterMark)
+      override {
+    shard_->pooledRecvBuffers.store(pooledBuffers, std::memory_order_relaxed);
+    shard_->recvBufferHighWaterMark.store(
+        highWaterMark, std::memory_order_relaxed);
+  }
+
+  void onBufferMemoryUsage(size_t bytesBuffered, size_t highWaterMark)
+      override {
+    shard_->bufferedBytes.store(bytesBuffered, std::memory_order_relaxed);
+    shard_->bufferedBytesHighWaterMark.store(
+        highWaterMark, std::memory_order_relaxed);
+  }
+
+  void onWorkerHandoffBatch(size_t numPackets) override {
+    bump(Counter::WORKER_HANDOFF_BATCHES);
+    bump(Counter::WORKER_HANDOFF_PACKETS, numPackets);
+  }
+
+  void onWorkerHandoffQueueFull() override {
+    bump(Counter::WORKER_HANDOFF_QUEUE_FULL);
+  }
+
+  void onRetrySent() override {
+    bump(Counter::RETRY_SENT);
+  }
+
+  void onSpuriousLoss(size_t numPackets) override {
+    bump(Counter::SPURIOUS_LOSS, numPackets);
+  }
+
+  void onCongestionUndo() override {
+    bump(Counter::CONGESTION_UNDO);
+  }
+
+  bool latencySamplingEnabled() const override {
+    return sampleLatencies_;
+  }
+
+  void onLatencySample(LatencyType type, std::chrono::microseconds latency)
+      override {
+    if (type >= LatencyType::MAX) {
+      return;
+    }
+    uint64_t us = latency.count() > 0 ? latency.count() : 0;
+    us = std::min<uint64_t>(
+        us, (uint64_t(1) << LatencyHistogram::kMaxValueBits) - 1);
+    auto& buckets = shard_->latencyBuckets[static_cast<size_t>(type)];
+    increment(buckets[LatencyHistogram::bucketIndex(us)]);
+  }
+
+  void onCpuCost(CpuCostType type, uint64_t cycles) override {
+    if (type >= CpuCostType::MAX) {
+      return;
+    }
+    increment(shard_->cpuCycles[static_cast<size_t>(type)], cycles);
+  }
+
+  void onWriteLoop(const WriteLoopMetrics& metrics) override {
+    bump(Counter::WRITE_LOOPS);
+    bump(Counter::WRITE_LOOP_PACKETS, metrics.packetsWritten);
+    bump(Counter::WRITE_LOOP_SOCKET_WRITES, metrics.socketWrites);
+    bump(Counter::WRITE_LOOP_SOCKET_WRITE_PACKETS, metrics.socketWritePackets);
+    bump(Counter::WRITE_LOOP_BYTES, metrics.bytesWritten);
+    if (metrics.timeSpent.count() > 0) {
+      bump(Counter::WRITE_LOOP_TIME, metrics.timeSpent.count());
+    }
+    if (metrics.stopReason < WriteLimit::MAX) {
+      increment(
+          shard_->writeLoopStops[static_cast<size_t>(metrics.stopReason)]);
+    }
+  }
+
+ private:
+  void bump(Counter counter, uint64_t delta = 1) {
+    increment(shard_->counters[static_cast<size_t>(counter)], delta);
+  }
+
+  std::shared_ptr<Shard> shard_;
+  const bool sampleLatencies_;
+};
+
+QuicStatsAggregator::QuicStatsAggregator(bool sampleLatencies)
+    : sampleLatencies_(sampleLatencies) {}
+
+std::unique_ptr<QuicTransportStatsCallback> QuicStatsAggregator::make(
+    folly::EventBase* /* evb */) {
+  auto shard = std::make_shared<Shard>();
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    shards_.push_back(shard);
+  }
+  return std::make_unique<WorkerStats>(std::move(shard), sampleLatencies_);
+}
+
+QuicStatsAggregator::Snapshot QuicStatsAggregator::snapshot() const {
+  std::vector<std::shared_ptr<Shard>> shards;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    shards = shards_;
+  }
+  Snapshot snapshot;
+  snapshot.numWorkers = shards.size();
+  for (const auto& shard : shards) {
+    for (size_t i = 0; i < snapshot.counters.size(); ++i) {
+      snapshot.counters[i] +=
+          shard->counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < snapshot.packetDrops.size(); ++i) {
+      snapshot.packetDrops[i] +=
+          shard->packetDrops[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < snapshot.connectionCloses.size(); ++i) {
+      snapshot.connectionCloses[i] +=
+          shard->connectionCloses[i].load(std::memory_order_relaxed);
+    }
+    snapshot.pooledRecvBuffers +=
+        shard->pooledRecvBuffers.load(std::memory_order_relaxed);
+    snapshot.recvBufferHighWaterMark = std::max(
+        snapshot.recvBufferHighWaterMark,
+        shard->recvBufferHighWaterMark.load(std::memory_order_relaxed));
+    snapshot.bufferedBytes +=
+        shard->bufferedBytes.load(std::memory_order_relaxed);
+    snapshot.bufferedBytesHighWaterMark = std::max(
+        snapshot.bufferedBytesHighWaterMark,
+        shard->bufferedBytesHighWaterMark.load(std::memory_order_relaxed));
+    for (size_t type = 0; type < snapshot.latencies.size(); ++type) {
+      const auto& buckets = shard->latencyBuckets[type];
+      for (size_t i = 0; i < buckets.size(); ++i) {
+        snapshot.latencies[type].addBucketCount(
+            i, buckets[i].load(std::memory_order_relaxed));
+      }
+    }
+    for (size_t i = 0; i < snapshot.cpuCycles.size(); ++i) {
+      snapshot.cpuCycles[i] +=
+          shard->cpuCycles[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < snapshot.writeLoopStops.size(); ++i) {
+      snapshot.writeLoopStops[i] +=
+          shard->writeLoopStops[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+} // namespace quic
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <folly/lang/Align.h>
+#include <quic/common/LatencyHistogram.h>
+#include <quic/state/QuicTransportStatsCallback.h>
+#include <quic/state/StateData.h>
+
+namespace quic {
+
+/**
+ * A QuicTransportStatsCallbackFactory that aggregates the stats of all the
+ * workers. Each worker gets its own shard of counters and latency histograms,
+ * padded so that it doesn't share a cache line with anything else. Only the
+ * worker writes to its shard, without atomic read-modify-writes, and
+ * snapshot() reads all the shards from any thread without stopping the
+ * workers. The snapshot is not a consistent cut across counters, but every
+ * counter in it is a value the counter really had.
+ */
+class QuicStatsAggregator : public QuicTransportStatsCallbackFactory {
+ public:
+  using PacketDropReason = QuicTransportStatsCallback::PacketDropReason;
+  using ConnectionCloseReason =
+      QuicTransportStatsCallback::ConnectionCloseReason;
+  using LatencyType = QuicTransportStatsCallback::LatencyType;
+  using CpuCostType = QuicTransportStatsCallback::CpuCostType;
+
+  enum class Counter : uint8_t {
+    PACKET_RECEIVED,
+    DUPLICATED_PACKET_RECEIVED,
+    OUT_OF_ORDER_PACKET_RECEIVED,
+    PACKET_PROCESSED,
+    PACKET_SENT,
+    PACKET_RETRANSMISSION,
+    PACKET_FORWARDED,
+    FORWARDED_PACKET_RECEIVED,
+    FORWARDED_PACKET_PROCESSED,
+    NEW_CONNECTION,
+    NEW_QUIC_STREAM,
+    QUIC_STREAM_CLOSED,
+    QUIC_STREAM_RESET,
+    CONN_FLOW_CONTROL_UPDATE,
+    CONN_FLOW_CONTROL_BLOCKED,
+    STATELESS_RESET,
+    STREAM_FLOW_CONTROL_UPDATE,
+    STREAM_FLOW_CONTROL_BLOCKED,
+    CWND_BLOCKED,
+    PTO,
+    BYTES_READ,
+    BYTES_WRITTEN,
+    WORKER_HANDOFF_BATCHES,
+    WORKER_HANDOFF_PACKETS,
+    WORKER_HANDOFF_QUEUE_FULL,
+    RETRY_SENT,
+    SPURIOUS_LOSS,
+    CONGESTION_UNDO,
+    // The sums of the WriteLoopMetrics, the time in microseconds.
+    WRITE_LOOPS,
+    WRITE_LOOP_PACKETS,
+    WRITE_LOOP_SOCKET_WRITES,
+    WRITE_LOOP_SOCKET_WRITE_PACKETS,
+    WRITE_LOOP_BYTES,
+    WRITE_LOOP_TIME,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
+  struct Snapshot {
+    size_t numWorkers{0};
+    std::array<uint64_t, static_cast<size_t>(Counter::MAX)> counters{};
+    std::array<uint64_t, static_cast<size_t>(PacketDropReason::MAX)>
+        packetDrops{};
+    // Closes without a reason are counted as ConnectionCloseReason::NONE.
+    std::array<uint64_t, static_cast<size_t>(ConnectionCloseReason::MAX)>
+        connectionCloses{};
+    // Sum over the workers of the last reported pool sizes, and the largest
+    // high water mark of any worker.
+    uint64_t pooledRecvBuffers{0};
+    uint64_t recvBufferHighWaterMark{0};
+    // Same for the stream data buffered under the worker buffer budgets.
+    uint64_t bufferedBytes{0};
+    uint64_t bufferedBytesHighWaterMark{0};
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyType::MAX)>
+        latencies;
+    // Estimated cycles reported by the connections that account CPU costs.
+    std::array<uint64_t, static_cast<size_t>(CpuCostType::MAX)> cpuCycles{};
+    // The write loops by the reason they stopped.
+    std::array<uint64_t, WriteLimitState::kNumLimits> writeLoopStops{};
+
+    uint64_t get(Counter counter) const {
+      return counters[static_cast<size_t>(counter)];
+    }
+
+    uint64_t get(PacketDropReason reason) const {
+      return packetDrops[static_cast<size_t>(reason)];
+    }
+
+    uint64_t get(ConnectionCloseReason reason) const {
+      return connectionCloses[static_cast<size_t>(reason)];
+    }
+
+    const LatencyHistogram& get(LatencyType type) const {
+      return latencies[static_cast<size_t>(type)];
+    }
+
+    uint64_t get(CpuCostType type) const {
+      return cpuCycles[static_cast<size_t>(type)];
+    }
+
+    uint64_t get(WriteLimit stopReason) const {
+      return writeLoopStops[static_cast<size_t>(stopReason)];
+    }
+  };
+
+  /**
+   * sampleLatencies turns on the optional latency samples of the callbacks it
+   * makes, see QuicTransportStatsCallback::latencySamplingEnabled().
+   */
+  explicit QuicStatsAggregator(bool sampleLatencies = false);
+
+  ~QuicStatsAggregator() override = default;
+
+  std::unique_ptr<QuicTransportStatsCallback> make(
+      folly::EventBase* evb) override;
+
+  /**
+   * Sums the stats of all the workers made so far, including the ones whose
+   * callback has been destroyed since. Can be called from any thread.
+   */
+  Snapshot snapshot() const;
+
+ private:
+  class WorkerStats;
+
+  // Written by a single worker, read by snapshot().
+  struct Shard {
+    char leadingPadding[folly::hardware_destructive_interference_size];
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::MAX)>
+        counters{};
+    std::array<
+        std::atomic<uint64_t>,
+        static_cast<size_t>(PacketDropReason::MAX)>
+        packetDrops{};
+    std::array<
+        std::atomic<uint64_t>,
+        static_cast<size_t>(ConnectionCloseReason::MAX)>
+        connectionCloses{};
+    std::atomic<uint64_t> pooledRecvBuffers{0};
+    std::atomic<uint64_t> recvBufferHighWaterMark{0};
+    std::atomic<uint64_t> bufferedBytes{0};
+    std::atomic<uint64_t> bufferedBytesHighWaterMark{0};
+    std::array<
+        std::array<std::atomic<uint64_t>, LatencyHistogram::kNumBuckets>,
+        static_cast<size_t>(LatencyType::MAX)>
+        latencyBuckets{};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(CpuCostType::MAX)>
+        cpuCycles{};
+    std::array<std::atomic<uint64_t>, WriteLimitState::kNumLimits>
+        writeLoopStops{};
+    char trailingPadding[folly::hardware_destructive_interference_size];
+  };
+
+  const bool sampleLatencies_;
+  // Only guards the list of shards, which changes when a worker is made. The
+  // workers never take it.
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Shard>> shards_;
+};
+} // namespace quic
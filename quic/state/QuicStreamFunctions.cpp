@@ -27,7 +27,11 @@ void prependToBuf(quic::Buf& buf, quic::Buf toAppend) {
 
 namespace quic {
 
-void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof) {
+void writeDataToQuicStream(
+    QuicStreamState& stream,
+    Buf data,
+    bool eof,
+    bool coalesce) {
   uint64_t len = 0;
   if (data) {
     len = data->computeChainDataLength();
@@ -37,12 +41,35 @@ void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof) {
     // write a blocked frame first time the stream becomes blocked
     maybeWriteBlockAfterAPIWrite(stream);
   }
-  stream.writeBuffer.append(std::move(data));
+  auto coalescingThreshold =
+      stream.conn.transportSettings.writeCoalescingThreshold;
+  if (coalesce && len > 0 && len <= coalescingThreshold) {
+    // The tailroom is only reused while the last buffer isn't shared, i.e.
+    // not cloned into a packet yet, otherwise a new buffer is allocated.
+    auto tail = stream.writeBuffer.preallocate(
+        len, std::max<uint64_t>(kWriteCoalescingBufferSize, len));
+    folly::io::Cursor(data.get()).pull(tail.first, len);
+    stream.writeBuffer.postallocate(len);
+  } else {
+    stream.writeBuffer.append(std::move(data));
+  }
   if (eof) {
     auto bufferSize =
         stream.writeBuffer.front() ? stream.writeBuffer.chainLength() : 0;
     stream.finalWriteOffset = stream.currentWriteOffset + bufferSize;
   }
+  if (len > 0 && stream.deliveryDeadline) {
+    stream.writeDeadlines.emplace_back(
+        stream.currentWriteOffset + stream.writeBuffer.chainLength(),
+        Clock::now() + *stream.deliveryDeadline);
+    stream.conn.streamManager->addDeadline(stream.id);
+  }
+  if (len > 0 && stream.conn.transportSettings.trackStreamByteEvents &&
+      stream.conn.infoCallback) {
+    auto endOffset =
+        stream.currentWriteOffset + stream.writeBuffer.chainLength();
+    stream.byteEvents.emplace_back(endOffset - len, endOffset, Clock::now());
+  }
   updateFlowControlOnWriteToStream(stream, len);
   stream.conn.streamManager->updateWritableStreams(stream);
 }
@@ -56,8 +83,6 @@ void appendDataToReadBufferCommon(
     StreamBuffer buffer,
     folly::Function<void(uint64_t, uint64_t)>&& connFlowControlVisitor) {
   auto& readBuffer = stream.readBuffer;
-  auto it = readBuffer.begin();
-
   auto bufferEndOffset = buffer.offset + buffer.data.chainLength();
 
   folly::Optional<uint64_t> bufferEofOffset;
@@ -107,102 +132,53 @@ void appendDataToReadBufferCommon(
     }
   }
 
-  // Nothing in the buffer, just append it.
-  if (it == readBuffer.end()) {
-    readBuffer.emplace_back(std::move(buffer));
+  // The buffers that overlap the new one or touch it are merged with it, so
+  // that the buffers in readBuffer stay non contiguous sections of the
+  // stream.
+  bufferEndOffset = buffer.offset + buffer.data.chainLength();
+  auto first = readBuffer.lowerBound(buffer.offset);
+  auto last = first;
+  while (last != readBuffer.end() && last->offset <= bufferEndOffset) {
+    ++last;
+  }
+  if (first == last) {
+    readBuffer.insert(std::move(buffer));
     return;
   }
-
-  // Start overlap will point to the first buffer that overlaps with the
-  // current buffer and End overlap will point to the last buffer that overlaps.
-  // They must always be set together.
-  folly::Optional<std::deque<StreamBuffer>::iterator> startOverlap;
-  folly::Optional<std::deque<StreamBuffer>::iterator> endOverlap;
-
-  StreamBuffer* current = &buffer;
-  bool currentAlreadyInserted = false;
-  bool done = false;
-  it = std::lower_bound(
-      it,
-      readBuffer.end(),
-      current->offset,
-      [](const StreamBuffer& listValue, uint64_t offset) {
-        // First element where the end offset is > start offset of the buffer.
-        return (listValue.offset + listValue.data.chainLength()) < offset;
-      });
-
-  // The invariant we're trying to maintain here is that individual
-  // elements of the readBuffer are assuredly non contiguous sections
-  // of the stream.
-  for (; it != readBuffer.end() && !done; ++it) {
-    auto currentEnd = current->offset + current->data.chainLength();
-    auto itEnd = it->offset + it->data.chainLength();
-    if (current->offset == it->offset && currentEnd == itEnd) {
-      // Exact overlap. Done.
-      done = true;
-    } else if (current->offset >= it->offset && currentEnd <= itEnd) {
-      // Subset overlap
-      done = true;
-    } else if (
-        current->offset <= it->offset && currentEnd >= it->offset &&
-        currentEnd <= itEnd) {
-      // Left overlap. Done.
-      it->data.trimStartAtMost(currentEnd - it->offset);
-      if (it->data.chainLength() > 0) {
-        current->data.append(it->data.move());
-      }
-      if (!startOverlap) {
-        startOverlap = it;
-      }
-      endOverlap = it + 1;
-      done = true;
-    } else if (current->offset < it->offset && currentEnd < it->offset) {
-      // Left, no overlap. Done.
-      if (!startOverlap) {
-        startOverlap = it;
-        endOverlap = it;
-      }
-      done = true;
-    } else if (current->offset <= it->offset && currentEnd > it->offset) {
-      // Complete overlap. Need to move on.
-      if (!startOverlap) {
-        startOverlap = it;
-      }
-      endOverlap = it + 1;
-    } else if (
-        current->offset >= it->offset && current->offset <= itEnd &&
-        currentEnd > itEnd) {
-      // Right overlap. Not done.
-      current->data.trimStartAtMost(itEnd - current->offset);
-      it->data.append(current->data.move());
-      current = &(*it);
-      currentAlreadyInserted = true;
-      DCHECK(!startOverlap);
-      startOverlap = it + 1;
-      endOverlap = it + 1;
-    }
+  if (first->offset <= buffer.offset &&
+      first->offset + first->data.chainLength() >= bufferEndOffset) {
+    // Subset overlap. Nothing new.
+    return;
   }
 
-  // Could have also been completely to the right of the last element.
-  if (startOverlap && !currentAlreadyInserted) {
-    DCHECK(endOverlap);
-    DCHECK(
-        *startOverlap != readBuffer.end() || *endOverlap == readBuffer.end());
-    auto insertIt = readBuffer.erase(*startOverlap, *endOverlap);
-    readBuffer.emplace(insertIt, std::move(*current));
-    return;
-  } else if (currentAlreadyInserted) {
-    DCHECK(startOverlap);
-    DCHECK(endOverlap);
-    DCHECK(
-        *startOverlap != readBuffer.end() || *endOverlap == readBuffer.end());
-    readBuffer.erase(*startOverlap, *endOverlap);
-    return;
+  StreamBuffer merged(
+      nullptr, std::min(first->offset, buffer.offset), false /* eof */);
+  auto mergedEndOffset = merged.offset;
+  auto appendToMerged = [&](StreamBuffer& piece) {
+    DCHECK_LE(piece.offset, mergedEndOffset);
+    auto pieceEndOffset = piece.offset + piece.data.chainLength();
+    if (pieceEndOffset <= mergedEndOffset) {
+      merged.eof |= piece.eof && pieceEndOffset == mergedEndOffset;
+      return;
+    }
+    piece.data.trimStartAtMost(mergedEndOffset - piece.offset);
+    merged.data.append(piece.data.move());
+    merged.eof = piece.eof;
+    mergedEndOffset = pieceEndOffset;
+  };
+  bool bufferMerged = false;
+  for (auto it = first; it != last; ++it) {
+    if (!bufferMerged && buffer.offset <= it->offset) {
+      appendToMerged(buffer);
+      bufferMerged = true;
+    }
+    appendToMerged(*it);
   }
-  auto last = readBuffer.end() - 1;
-  if (current->offset > last->offset + last->data.chainLength()) {
-    readBuffer.emplace_back(std::move(*current));
+  if (!bufferMerged) {
+    appendToMerged(buffer);
   }
+  readBuffer.erase(first, last);
+  readBuffer.insert(std::move(merged));
 }
 
 void appendDataToReadBuffer(QuicStreamState& stream, StreamBuffer buffer) {
@@ -270,9 +246,11 @@ Buf readDataFromCryptoStream(QuicCryptoStream& stream, uint64_t amount) {
   return readDataInOrderFromReadBuffer(stream, amount).first;
 }
 
-std::pair<Buf, bool> readDataFromQuicStream(
-    QuicStreamState& stream,
-    uint64_t amount) {
+namespace {
+/**
+ * Delivers the EOF if that's all that is left to read off the stream.
+ */
+bool readEofFromQuicStream(QuicStreamState& stream) {
   auto eof = stream.finalReadOffset &&
       stream.currentReadOffset >= *stream.finalReadOffset;
   if (eof) {
@@ -281,26 +259,89 @@ std::pair<Buf, bool> readDataFromQuicStream(
     }
     stream.conn.streamManager->updateReadableStreams(stream);
     stream.conn.streamManager->updatePeekableStreams(stream);
-    return std::make_pair(nullptr, true);
   }
+  return eof;
+}
 
-  uint64_t lastReadOffset = stream.currentReadOffset;
-
-  Buf data;
-  std::tie(data, eof) = readDataInOrderFromReadBuffer(stream, amount);
+/**
+ * Updates the stream after data was read off it from lastReadOffset, returns
+ * whether the EOF was read with it.
+ */
+bool onReadFromQuicStream(QuicStreamState& stream, uint64_t lastReadOffset) {
   // Update flow control before handling eof as eof is not subject to flow
   // control
   updateFlowControlOnRead(stream, lastReadOffset, Clock::now());
-  eof = stream.finalReadOffset &&
+  auto eof = stream.finalReadOffset &&
       stream.currentReadOffset == *stream.finalReadOffset;
   if (eof) {
     stream.currentReadOffset += 1;
   }
   stream.conn.streamManager->updateReadableStreams(stream);
   stream.conn.streamManager->updatePeekableStreams(stream);
+  return eof;
+}
+} // namespace
+
+std::pair<Buf, bool> readDataFromQuicStream(
+    QuicStreamState& stream,
+    uint64_t amount) {
+  if (readEofFromQuicStream(stream)) {
+    return std::make_pair(nullptr, true);
+  }
+
+  uint64_t lastReadOffset = stream.currentReadOffset;
+
+  Buf data;
+  std::tie(data, eof) = readDataInOrderFromReadBuffer(stream, amount);
+  eof = onReadFromQuicStream(stream, lastReadOffset);
   return std::make_pair(std::move(data), eof);
 }
 
+std::pair<uint64_t, bool> readDataFromQuicStream(
+    QuicStreamState& stream,
+    const struct iovec* vec,
+    size_t count) {
+  if (readEofFromQuicStream(stream)) {
+    return std::make_pair(0, true);
+  }
+
+  uint64_t lastReadOffset = stream.currentReadOffset;
+  size_t vecIndex = 0;
+  size_t vecOffset = 0;
+  while (vecIndex < count && !stream.readBuffer.empty()) {
+    auto curr = stream.readBuffer.begin();
+    if (curr->offset > stream.currentReadOffset) {
+      break;
+    }
+    CHECK_EQ(curr->offset, stream.currentReadOffset);
+    size_t currSize = curr->data.chainLength();
+    size_t copied = 0;
+    if (currSize > 0) {
+      folly::io::Cursor cursor(curr->data.front());
+      while (vecIndex < count && copied < currSize) {
+        const auto& iov = vec[vecIndex];
+        auto toCopy = std::min(iov.iov_len - vecOffset, currSize - copied);
+        cursor.pull(static_cast<uint8_t*>(iov.iov_base) + vecOffset, toCopy);
+        copied += toCopy;
+        vecOffset += toCopy;
+        if (vecOffset == iov.iov_len) {
+          vecIndex++;
+          vecOffset = 0;
+        }
+      }
+      curr->data.trimStart(copied);
+    }
+    curr->offset += copied;
+    stream.currentReadOffset += copied;
+    if (copied == currSize) {
+      stream.readBuffer.pop_front();
+    }
+  }
+  uint64_t bytesRead = stream.currentReadOffset - lastReadOffset;
+  auto eof = onReadFromQuicStream(stream, lastReadOffset);
+  return std::make_pair(bytesRead, eof);
+}
+
 void peekDataFromQuicStream(
     QuicStreamState& stream,
     const folly::Function<void(StreamId id, const folly::Range<PeekIterator>&)
@@ -309,7 +350,7 @@ void peekDataFromQuicStream(
     peekCallback(
         stream.id,
         folly::Range<PeekIterator>(
-            stream.readBuffer.cbegin(), stream.readBuffer.size()));
+            stream.readBuffer.cbegin(), stream.readBuffer.cend()));
   }
 }
 
@@ -394,6 +435,81 @@ uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream) {
   return minOffsetToDeliver;
 }
 
+void onStreamBytesSent(
+    QuicStreamState& stream,
+    uint64_t offset,
+    uint64_t len,
+    bool newData,
+    TimePoint sentTime) {
+  auto& events = stream.byteEvents;
+  if (events.empty() || len == 0) {
+    return;
+  }
+  auto endOffset = offset + len;
+  if (newData) {
+    // The rest of a write that was partly sent in an earlier packet.
+    if (stream.numSentByteEvents > 0 &&
+        events[stream.numSentByteEvents - 1].endOffset > offset) {
+      events[stream.numSentByteEvents - 1].lastSentTime = sentTime;
+    }
+    while (stream.numSentByteEvents < events.size() &&
+           events[stream.numSentByteEvents].startOffset < endOffset) {
+      auto& event = events[stream.numSentByteEvents++];
+      event.firstSentTime = sentTime;
+      event.lastSentTime = sentTime;
+    }
+    return;
+  }
+  auto sentEnd = events.begin() + stream.numSentByteEvents;
+  auto event = std::upper_bound(
+      events.begin(),
+      sentEnd,
+      offset,
+      [](uint64_t offsetIn, const StreamByteEvent& eventIn) {
+        return offsetIn < eventIn.endOffset;
+      });
+  for (; event != sentEnd && event->startOffset < endOffset; ++event) {
+    event->lastSentTime = sentTime;
+    event->resent = true;
+  }
+}
+
+void onStreamBytesDelivered(QuicStreamState& stream) {
+  auto& events = stream.byteEvents;
+  if (events.empty()) {
+    return;
+  }
+  auto deliveredOffset = getStreamNextOffsetToDeliver(stream);
+  auto now = Clock::now();
+  auto infoCallback = stream.conn.infoCallback;
+  while (stream.numSentByteEvents > 0 &&
+         events.front().endOffset <= deliveredOffset) {
+    const auto& event = events.front();
+    QUIC_STATS(
+        infoCallback,
+        onLatencySample,
+        QuicTransportStatsCallback::LatencyType::STREAM_APP_QUEUE,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            *event.firstSentTime - event.writeTime));
+    if (event.resent) {
+      QUIC_STATS(
+          infoCallback,
+          onLatencySample,
+          QuicTransportStatsCallback::LatencyType::STREAM_RETRANSMISSION,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              event.lastSentTime - *event.firstSentTime));
+    }
+    QUIC_STATS(
+        infoCallback,
+        onLatencySample,
+        QuicTransportStatsCallback::LatencyType::STREAM_NETWORK,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - event.lastSentTime));
+    events.pop_front();
+    --stream.numSentByteEvents;
+  }
+}
+
 void cancelHandshakeCryptoStreamRetransmissions(QuicCryptoState& cryptoState) {
   // Cancel any retransmissions we might want to do for the crypto stream.
   // This does not include data that is already deemed as lost, or data that
@@ -426,9 +542,7 @@ void processCryptoStreamAck(
     QuicCryptoStream& cryptoStream,
     uint64_t offset,
     uint64_t len) {
-  auto ackedBuffer = std::lower_bound(
-      cryptoStream.retransmissionBuffer.begin(),
-      cryptoStream.retransmissionBuffer.end(),
+  auto ackedBuffer = cryptoStream.retransmissionBuffer.lowerBound(
       offset,
       [](const auto& buffer, const auto& offset) {
         return buffer.offset < offset;
@@ -491,4 +605,55 @@ bool streamFrameMatchesRetransmitBuffer(
   }
   return match;
 }
+
+namespace {
+void compactStreamBuffers(StreamBufferQueue& buffers) {
+  for (auto& buffer : buffers) {
+    if (buffer.data.empty()) {
+      continue;
+    }
+    const auto* front = buffer.data.front();
+    auto len = front->computeChainDataLength();
+    if (front->computeChainCapacity() <= kStreamBufferCompactionFactor * len) {
+      continue;
+    }
+    auto copy = folly::IOBuf::create(len);
+    folly::io::Cursor cursor(front);
+    cursor.pull(copy->writableData(), len);
+    copy->append(len);
+    buffer.data.move();
+    buffer.data.append(std::move(copy));
+  }
+}
+} // namespace
+
+void reclaimStreamBufferMemory(QuicStreamLike& stream, bool compactBuffers) {
+  stream.retransmissionBuffer.shrinkToFit();
+  stream.lossBuffer.shrinkToFit();
+  if (stream.writeBuffer.empty()) {
+    stream.writeBuffer.move();
+  }
+  if (compactBuffers) {
+    compactStreamBuffers(stream.retransmissionBuffer);
+    compactStreamBuffers(stream.lossBuffer);
+  }
+}
+
+uint64_t refillStreamSendRateTokens(QuicStreamState& stream, TimePoint now) {
+  auto& limit = *stream.sendRateLimit;
+  if (now <= limit.lastRefillTime) {
+    return limit.tokens;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - limit.lastRefillTime);
+  double refill = double(limit.bytesPerSec) * elapsed.count() / std::micro::den;
+  if (refill < 1) {
+    // Keep the fraction of a byte for the next refill.
+    return limit.tokens;
+  }
+  limit.tokens = static_cast<uint64_t>(
+      std::min<double>(limit.burstBytes, limit.tokens + refill));
+  limit.lastRefillTime = now;
+  return limit.tokens;
+}
 } // namespace quic
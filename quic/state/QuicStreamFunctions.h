@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <folly/portability/IOVec.h>
 #include <quic/state/StateData.h>
 #include <algorithm>
 
@@ -15,11 +16,17 @@ namespace quic {
 
 /**
  * Adds data to the end of the write buffer of the QUIC stream. This
- * data will be written onto the socket.
+ * data will be written onto the socket. Small writes are copied into the
+ * buffer of the previous ones unless coalesce is false, see
+ * TransportSettings::writeCoalescingThreshold.
  *
  * @throws QuicTransportException on error.
  */
-void writeDataToQuicStream(QuicStreamState& stream, Buf data, bool eof);
+void writeDataToQuicStream(
+    QuicStreamState& stream,
+    Buf data,
+    bool eof,
+    bool coalesce = true);
 
 /**
  * Adds data to the end of the write buffer of the QUIC crypto stream. This
@@ -52,6 +59,16 @@ std::pair<Buf, bool> readDataFromQuicStream(
     QuicStreamState& state,
     uint64_t amount = 0);
 
+/**
+ * Same as above but copies the data into the buffers of vec, up to their
+ * total length. Returns the number of bytes copied and whether or not EOF was
+ * reached on the stream.
+ */
+std::pair<uint64_t, bool> readDataFromQuicStream(
+    QuicStreamState& state,
+    const struct iovec* vec,
+    size_t count);
+
 /**
  * Reads data from the QUIC crypto data if data exists.
  * amount == 0 reads all the pending data in the stream.
@@ -63,7 +80,7 @@ Buf readDataFromCryptoStream(QuicCryptoStream& stream, uint64_t amount = 0);
  * Invokes provided callback on the existing data.
  * Does not affect stream state (as opposed to read).
  */
-using PeekIterator = std::deque<StreamBuffer>::const_iterator;
+using PeekIterator = StreamReadBuffer::const_iterator;
 void peekDataFromQuicStream(
     QuicStreamState& state,
     const folly::Function<void(StreamId id, const folly::Range<PeekIterator>&)
@@ -97,6 +114,24 @@ uint64_t getLargestWriteOffsetSeen(const QuicStreamState& stream);
  */
 uint64_t getStreamNextOffsetToDeliver(const QuicStreamState& stream);
 
+/**
+ * Updates the send times of the byteEvents of the writes in
+ * [offset, offset + len), newData is whether the bytes are sent for the first
+ * time.
+ */
+void onStreamBytesSent(
+    QuicStreamState& stream,
+    uint64_t offset,
+    uint64_t len,
+    bool newData,
+    TimePoint sentTime);
+
+/**
+ * Reports the latencies of the byteEvents delivered up to
+ * getStreamNextOffsetToDeliver() and removes them.
+ */
+void onStreamBytesDelivered(QuicStreamState& stream);
+
 /**
  * Common functions for merging data into the read buffer for a Quic stream like
  * object. Callers should provide a connFlowControlVisitor which will be invoked
@@ -136,6 +171,21 @@ void processCryptoStreamAck(
     uint64_t offset,
     uint64_t len);
 
+/**
+ * Refills the send rate limit of the stream up to now and returns the bytes
+ * of new data it can send. The stream must have a sendRateLimit.
+ */
+uint64_t refillStreamSendRateTokens(QuicStreamState& stream, TimePoint now);
+
+/**
+ * Gives back the memory the buffers of the stream kept after they drained:
+ * the storage of the empty retransmission and loss queues, and the unused
+ * room of the others. With compactBuffers, the buffers holding on to shared
+ * memory much larger than their data, which the rest of a write acked since
+ * then left behind, are copied into buffers of their size.
+ */
+void reclaimStreamBufferMemory(QuicStreamLike& stream, bool compactBuffers);
+
 /**
  * Checks if stream frame matches buffer from the retransmit queue.
  *
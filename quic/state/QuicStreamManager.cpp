@@ -77,14 +77,18 @@ static LocalErrorCode openStreamIfNotClosed(
 
   // Since this is a deque just insert at the back and sort after. The swapping
   // has lower constant time operations than inserting into the proper sorted
-  // positions.
+  // positions. The new streams are the largest of their type, so the deque
+  // stays sorted unless it also holds streams of the other type.
   // TODO We can do better than this. We probably don't want a deque.
+  bool sorted = openStreams.empty() || openStreams.back() < streamId;
   StreamId start = nextAcceptableStreamId;
   while (start <= streamId) {
     openStreams.push_back(start);
     start += detail::kStreamIncrement;
   }
-  std::sort(openStreams.begin(), openStreams.end());
+  if (!sorted) {
+    std::sort(openStreams.begin(), openStreams.end());
+  }
 
   if (streamId >= nextAcceptableStreamId) {
     nextAcceptableStreamId = streamId + detail::kStreamIncrement;
@@ -93,11 +97,17 @@ static LocalErrorCode openStreamIfNotClosed(
 }
 
 QuicStreamState* QuicStreamManager::findStream(StreamId streamId) {
+  ++lookupCacheStats_.lookups;
+  if (lastStream_ && lastStream_->id == streamId) {
+    ++lookupCacheStats_.hits;
+    return lastStream_;
+  }
   auto lookup = streams_.find(streamId);
   if (lookup == streams_.end()) {
     return nullptr;
   } else {
-    return &lookup->second;
+    lastStream_ = &lookup->second;
+    return lastStream_;
   }
 }
 
@@ -169,9 +179,63 @@ void QuicStreamManager::setMaxRemoteUnidirectionalStreamsInternal(
   }
 }
 
+QuicStreamManager::StreamIdState QuicStreamManager::getStreamIdState() const {
+  StreamIdState state;
+  state.nextAcceptablePeerBidirectionalStreamId =
+      nextAcceptablePeerBidirectionalStreamId_;
+  state.nextAcceptablePeerUnidirectionalStreamId =
+      nextAcceptablePeerUnidirectionalStreamId_;
+  state.nextAcceptableLocalBidirectionalStreamId =
+      nextAcceptableLocalBidirectionalStreamId_;
+  state.nextAcceptableLocalUnidirectionalStreamId =
+      nextAcceptableLocalUnidirectionalStreamId_;
+  state.nextBidirectionalStreamId = nextBidirectionalStreamId_;
+  state.nextUnidirectionalStreamId = nextUnidirectionalStreamId_;
+  state.maxLocalBidirectionalStreamId = maxLocalBidirectionalStreamId_;
+  state.maxLocalUnidirectionalStreamId = maxLocalUnidirectionalStreamId_;
+  state.maxRemoteBidirectionalStreamId = maxRemoteBidirectionalStreamId_;
+  state.maxRemoteUnidirectionalStreamId = maxRemoteUnidirectionalStreamId_;
+  state.openBidirectionalPeerStreams.assign(
+      openBidirectionalPeerStreams_.begin(),
+      openBidirectionalPeerStreams_.end());
+  state.openUnidirectionalPeerStreams.assign(
+      openUnidirectionalPeerStreams_.begin(),
+      openUnidirectionalPeerStreams_.end());
+  state.openLocalStreams.assign(
+      openLocalStreams_.begin(), openLocalStreams_.end());
+  return state;
+}
+
+void QuicStreamManager::setStreamIdState(const StreamIdState& state) {
+  DCHECK(streams_.empty());
+  nextAcceptablePeerBidirectionalStreamId_ =
+      state.nextAcceptablePeerBidirectionalStreamId;
+  nextAcceptablePeerUnidirectionalStreamId_ =
+      state.nextAcceptablePeerUnidirectionalStreamId;
+  nextAcceptableLocalBidirectionalStreamId_ =
+      state.nextAcceptableLocalBidirectionalStreamId;
+  nextAcceptableLocalUnidirectionalStreamId_ =
+      state.nextAcceptableLocalUnidirectionalStreamId;
+  nextBidirectionalStreamId_ = state.nextBidirectionalStreamId;
+  nextUnidirectionalStreamId_ = state.nextUnidirectionalStreamId;
+  maxLocalBidirectionalStreamId_ = state.maxLocalBidirectionalStreamId;
+  maxLocalUnidirectionalStreamId_ = state.maxLocalUnidirectionalStreamId;
+  maxRemoteBidirectionalStreamId_ = state.maxRemoteBidirectionalStreamId;
+  maxRemoteUnidirectionalStreamId_ = state.maxRemoteUnidirectionalStreamId;
+  openBidirectionalPeerStreams_.assign(
+      state.openBidirectionalPeerStreams.begin(),
+      state.openBidirectionalPeerStreams.end());
+  openUnidirectionalPeerStreams_.assign(
+      state.openUnidirectionalPeerStreams.begin(),
+      state.openUnidirectionalPeerStreams.end());
+  openLocalStreams_.assign(
+      state.openLocalStreams.begin(), state.openLocalStreams.end());
+}
+
 void QuicStreamManager::refreshTransportSettings(
     const TransportSettings& settings) {
   transportSettings_ = &settings;
+  streamStatePool_->setCapacity(settings.streamStatePoolSize);
   setMaxRemoteBidirectionalStreamsInternal(
       transportSettings_->advertisedInitialMaxStreamsBidi, true);
   setMaxRemoteUnidirectionalStreamsInternal(
@@ -198,14 +262,24 @@ QuicStreamManager::getOrCreateOpenedLocalStream(StreamId streamId) {
 }
 
 QuicStreamState* QuicStreamManager::getStream(StreamId streamId) {
+  ++lookupCacheStats_.lookups;
+  if (lastStream_ && lastStream_->id == streamId) {
+    // The stream already has its state, so nothing else changed.
+    ++lookupCacheStats_.hits;
+    return lastStream_;
+  }
   if (isRemoteStream(nodeType_, streamId)) {
     auto stream = getOrCreatePeerStream(streamId);
     updateAppIdleState();
+    if (stream) {
+      lastStream_ = stream;
+    }
     return stream;
   }
   auto it = streams_.find(streamId);
   if (it != streams_.end()) {
-    return &it->second;
+    lastStream_ = &it->second;
+    return lastStream_;
   }
   auto stream = getOrCreateOpenedLocalStream(streamId);
   auto nextAcceptableStreamId = isUnidirectionalStream(streamId)
@@ -279,10 +353,10 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
     return &it.first->second;
   }
 
-  auto previousPeerStreams = folly::copy(openPeerStreams);
   auto& nextAcceptableStreamId = isUnidirectionalStream(streamId)
       ? nextAcceptablePeerUnidirectionalStreamId_
       : nextAcceptablePeerBidirectionalStreamId_;
+  auto firstNewStreamId = nextAcceptableStreamId;
   auto maxStreamId = isUnidirectionalStream(streamId)
       ? maxRemoteUnidirectionalStreamId_
       : maxRemoteBidirectionalStreamId_;
@@ -296,13 +370,27 @@ QuicStreamManager::getOrCreatePeerStream(StreamId streamId) {
         "Exceeded stream limit.", TransportErrorCode::STREAM_LIMIT_ERROR);
   }
 
-  // Copy over the new streams.
-  std::set_difference(
-      openPeerStreams.begin(),
-      openPeerStreams.end(),
-      std::make_move_iterator(previousPeerStreams.begin()),
-      std::make_move_iterator(previousPeerStreams.end()),
-      std::back_inserter(newPeerStreams_));
+  // The new streams are the ones up to streamId the peer hadn't opened yet.
+  for (auto id = firstNewStreamId; id <= streamId;
+       id += detail::kStreamIncrement) {
+    newPeerStreams_.push_back(id);
+  }
+  if (conn_.transportSettings.batchNewPeerStreamCallbacks &&
+      firstNewStreamId < streamId) {
+    // The application learns of all of them at once, and is likely to set
+    // their callbacks right away, so create their state at once too.
+    streams_.reserve(
+        streams_.size() +
+        (streamId - firstNewStreamId) / detail::kStreamIncrement + 1);
+    for (auto id = firstNewStreamId; id < streamId;
+         id += detail::kStreamIncrement) {
+      streams_.emplace(
+          std::piecewise_construct,
+          std::forward_as_tuple(id),
+          std::forward_as_tuple(id, conn_));
+      QUIC_STATS(conn_.infoCallback, onNewQuicStream);
+    }
+  }
 
   auto it = streams_.emplace(
       std::piecewise_construct,
@@ -363,7 +451,8 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
   DCHECK(inTerminalStates);
   readableStreams_.erase(streamId);
   peekableStreams_.erase(streamId);
-  writableStreams_.erase(streamId);
+  removeWritable(streamId);
+  deadlineStreams_.erase(streamId);
   blockedStreams_.erase(streamId);
   deliverableStreams_.erase(streamId);
   windowUpdates_.erase(streamId);
@@ -379,6 +468,9 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
     DCHECK_GT(numControlStreams_, 0);
     numControlStreams_--;
   }
+  if (lastStream_ == &it->second) {
+    lastStream_ = nullptr;
+  }
   streams_.erase(it);
   QUIC_STATS(conn_.infoCallback, onQuicStreamClosed);
   if (isRemoteStream(nodeType_, streamId)) {
@@ -392,18 +484,25 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
       // Check if we should send a stream limit update. We need to send an
       // update every time we've closed a number of streams >= the set windowing
       // fraction.
-      uint64_t initialStreamLimit = isUnidirectionalStream(streamId)
-          ? transportSettings_->advertisedInitialMaxStreamsUni
-          : transportSettings_->advertisedInitialMaxStreamsBidi;
-      uint64_t streamWindow =
-          initialStreamLimit / streamLimitWindowingFraction_;
+      uint64_t streamLimit = isUnidirectionalStream(streamId)
+          ? onPeerStreamClosed(
+                unidirectionalPeerStreamCloseRate_,
+                transportSettings_->advertisedInitialMaxStreamsUni,
+                openPeerStreams.size())
+          : onPeerStreamClosed(
+                bidirectionalPeerStreamCloseRate_,
+                transportSettings_->advertisedInitialMaxStreamsBidi,
+                openPeerStreams.size());
+      uint64_t streamWindow = streamLimit / streamLimitWindowingFraction_;
       uint64_t openableRemoteStreams = isUnidirectionalStream(streamId)
           ? openableRemoteUnidirectionalStreams()
           : openableRemoteBidirectionalStreams();
       // The "credit" here is how much available stream space we have based on
-      // what the initial stream limit was set to.
+      // what the stream limit is set to. An auto scaled limit can have shrunk
+      // below what the peer was already granted.
+      uint64_t usedStreams = openableRemoteStreams + openPeerStreams.size();
       uint64_t streamCredit =
-          initialStreamLimit - openableRemoteStreams - openPeerStreams.size();
+          streamLimit > usedStreams ? streamLimit - usedStreams : 0;
       if (streamCredit >= streamWindow) {
         if (isUnidirectionalStream(streamId)) {
           uint64_t maxStreams = (maxRemoteUnidirectionalStreamId_ -
@@ -430,6 +529,37 @@ void QuicStreamManager::removeClosedStream(StreamId streamId) {
   updateAppIdleState();
 }
 
+uint64_t QuicStreamManager::onPeerStreamClosed(
+    PeerStreamCloseRate& closeRate,
+    uint64_t initialStreamLimit,
+    uint64_t openPeerStreams) {
+  if (!transportSettings_->autoScaleStreamLimits) {
+    return initialStreamLimit;
+  }
+  auto now = Clock::now();
+  auto rtt = conn_.lossState.srtt == std::chrono::microseconds::zero()
+      ? kDefaultInitialRtt
+      : conn_.lossState.srtt;
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - closeRate.windowStart);
+  if (elapsed >= rtt) {
+    // Scale the count down if the window lasted longer than a RTT, so that
+    // the rate decays when the peer slows down.
+    closeRate.closedPerRtt =
+        closeRate.closedInWindow * rtt.count() / elapsed.count();
+    closeRate.windowStart = now;
+    closeRate.closedInWindow = 0;
+  }
+  closeRate.closedInWindow++;
+  // Within a window, follow a burst right away.
+  closeRate.closedPerRtt =
+      std::max(closeRate.closedPerRtt, closeRate.closedInWindow);
+  uint64_t scaledLimit = std::min(
+      transportSettings_->maxAutoScaledStreamLimit,
+      openPeerStreams + kStreamLimitAutoScaleRtts * closeRate.closedPerRtt);
+  return std::max(initialStreamLimit, scaledLimit);
+}
+
 void QuicStreamManager::updateLossStreams(QuicStreamState& stream) {
   auto it = std::find(lossStreams_.begin(), lossStreams_.end(), stream.id);
   if (!stream.lossBuffer.empty()) {
@@ -511,6 +641,48 @@ void QuicStreamManager::setStreamAsControl(QuicStreamState& stream) {
   updateAppIdleState();
 }
 
+void QuicStreamManager::setStreamPriority(
+    QuicStreamState& stream,
+    Priority priority) {
+  if (stream.priority == priority) {
+    return;
+  }
+  bool writable = writableContains(stream.id);
+  if (writable) {
+    removeWritable(stream.id);
+  }
+  stream.priority = priority;
+  if (writable) {
+    addWritable(stream.id);
+  }
+}
+
+void QuicStreamManager::addWritable(StreamId streamId) {
+  if (!writableStreams_.insert(streamId).second) {
+    return;
+  }
+  auto stream = streams_.find(streamId);
+  auto priority =
+      stream != streams_.end() ? stream->second.priority : kDefaultPriority;
+  writableStreamsByPriority_[priority].insert(streamId);
+}
+
+void QuicStreamManager::removeWritable(StreamId streamId) {
+  if (!writableStreams_.erase(streamId)) {
+    return;
+  }
+  for (auto it = writableStreamsByPriority_.begin();
+       it != writableStreamsByPriority_.end();
+       ++it) {
+    if (it->second.erase(streamId)) {
+      if (it->second.empty()) {
+        writableStreamsByPriority_.erase(it);
+      }
+      return;
+    }
+  }
+}
+
 bool QuicStreamManager::isAppIdle() const {
   return isAppIdle_;
 }
@@ -8,9 +8,12 @@
 
 #pragma once
 
+#include <folly/container/F14Map.h>
+#include <folly/container/F14Set.h>
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
 #include <quic/state/StreamData.h>
+#include <quic/state/StreamStatePool.h>
 #include <quic/state/TransportSettings.h>
 #include <deque>
 #include <map>
@@ -18,6 +21,7 @@
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace quic {
 namespace detail {
@@ -26,13 +30,45 @@ constexpr uint8_t kStreamIncrement = 0x04;
 }
 
 class QuicStreamManager {
+  using StreamMap = folly::F14NodeMap<
+      StreamId,
+      QuicStreamState,
+      folly::f14::DefaultHasher<StreamId>,
+      folly::f14::DefaultKeyEqual<StreamId>,
+      StreamStateAllocator<
+          std::pair<const StreamId, QuicStreamState>,
+          std::pair<const StreamId, QuicStreamState>>>;
+
  public:
+  // Which stream ids have been used and which can be used on the connection,
+  // for carrying the streams of a connection over to another process.
+  struct StreamIdState {
+    StreamId nextAcceptablePeerBidirectionalStreamId{0};
+    StreamId nextAcceptablePeerUnidirectionalStreamId{0};
+    StreamId nextAcceptableLocalBidirectionalStreamId{0};
+    StreamId nextAcceptableLocalUnidirectionalStreamId{0};
+    StreamId nextBidirectionalStreamId{0};
+    StreamId nextUnidirectionalStreamId{0};
+    StreamId maxLocalBidirectionalStreamId{0};
+    StreamId maxLocalUnidirectionalStreamId{0};
+    StreamId maxRemoteBidirectionalStreamId{0};
+    StreamId maxRemoteUnidirectionalStreamId{0};
+    // Ordered by id.
+    std::vector<StreamId> openBidirectionalPeerStreams;
+    std::vector<StreamId> openUnidirectionalPeerStreams;
+    std::vector<StreamId> openLocalStreams;
+  };
+
   explicit QuicStreamManager(
       QuicConnectionStateBase& conn,
       QuicNodeType nodeType,
       const TransportSettings& transportSettings)
       : conn_(conn),
         nodeType_(nodeType),
+        streamStatePool_(std::make_shared<StreamStatePool>(
+            sizeof(StreamMap::value_type),
+            transportSettings.streamStatePoolSize)),
+        streams_(StreamMap::allocator_type(streamStatePool_)),
         transportSettings_(&transportSettings) {
     if (nodeType == QuicNodeType::Server) {
       nextAcceptablePeerBidirectionalStreamId_ = 0x00;
@@ -84,6 +120,17 @@ class QuicStreamManager {
    */
   QuicStreamState* FOLLY_NONNULL getStream(StreamId streamId);
 
+  // How often getStream and findStream found the stream of the previous
+  // lookup, which runs of frames for the same stream do.
+  struct LookupCacheStats {
+    uint64_t lookups{0};
+    uint64_t hits{0};
+  };
+
+  const LookupCacheStats& getLookupCacheStats() const {
+    return lookupCacheStats_;
+  }
+
   /*
    * Remove all the state for a stream that is being closed.
    */
@@ -172,9 +219,14 @@ class QuicStreamManager {
    * Clear all the currently open streams.
    */
   void clearOpenStreams() {
+    // Only done on close, when no stream opens again: the memory of the
+    // streams goes back to the heap, or to the shared pool, instead of to the
+    // pool of the connection.
+    streamStatePool_->setCapacity(0);
     openLocalStreams_.clear();
     openBidirectionalPeerStreams_.clear();
     openUnidirectionalPeerStreams_.clear();
+    lastStream_ = nullptr;
     streams_.clear();
   }
 
@@ -186,6 +238,25 @@ class QuicStreamManager {
     return streams_;
   }
 
+  const StreamStatePool& streamStatePool() const {
+    return *streamStatePool_;
+  }
+
+  /**
+   * Opens the streams in the memory of the closed streams of other
+   * connections too, see StreamStatePool::setSharedPool().
+   */
+  void setSharedStreamStatePool(std::shared_ptr<StreamStatePool> pool) {
+    streamStatePool_->setSharedPool(std::move(pool));
+  }
+
+  /**
+   * The size of the blocks of the stream state pools.
+   */
+  static constexpr size_t streamStateBlockSize() {
+    return sizeof(StreamMap::value_type);
+  }
+
   /*
    * Call the given function on every currently open stream's state.
    */
@@ -207,15 +278,22 @@ class QuicStreamManager {
     return !lossStreams_.empty();
   }
 
-  // TODO figure out a better interface here.
   /*
-   * Returns a mutable reference to the container holding the writable stream
+   * Returns a const reference to the container holding the writable stream
    * IDs.
    */
-  auto& writableStreams() {
+  const auto& writableStreams() const {
     return writableStreams_;
   }
 
+  /*
+   * Returns the writable stream IDs grouped by stream priority, in the order
+   * they should be scheduled in.
+   */
+  const auto& writableStreamsByPriority() const {
+    return writableStreamsByPriority_;
+  }
+
   /*
    * Returns if there are any writable streams.
    */
@@ -233,22 +311,34 @@ class QuicStreamManager {
   /*
    * Add a writable stream id.
    */
-  void addWritable(StreamId streamId) {
-    writableStreams_.insert(streamId);
-  }
+  void addWritable(StreamId streamId);
 
   /*
    * Remove a writable stream id.
    */
-  void removeWritable(StreamId streamId) {
-    writableStreams_.erase(streamId);
-  }
+  void removeWritable(StreamId streamId);
 
   /*
    * Clear the writable streams.
    */
   void clearWritable() {
     writableStreams_.clear();
+    writableStreamsByPriority_.clear();
+  }
+
+  /*
+   * Returns the streams that have data with a delivery deadline.
+   */
+  const auto& deadlineStreams() const {
+    return deadlineStreams_;
+  }
+
+  void addDeadline(StreamId streamId) {
+    deadlineStreams_.insert(streamId);
+  }
+
+  void removeDeadline(StreamId streamId) {
+    deadlineStreams_.erase(streamId);
   }
 
   /*
@@ -307,6 +397,14 @@ class QuicStreamManager {
 
   void refreshTransportSettings(const TransportSettings& settings);
 
+  StreamIdState getStreamIdState() const;
+
+  /*
+   * Replaces the stream id state, on a manager without any open stream. The
+   * state of the open streams is then created lazily by getStream().
+   */
+  void setStreamIdState(const StreamIdState& state);
+
   /*
    * Sets the "window-by" fraction for sending stream limit updates. E.g.
    * setting the fraction to two when the initial stream limit was 100 will
@@ -588,7 +686,7 @@ class QuicStreamManager {
    * Returns the number of streams open and active (for which we have created
    * the stream state).
    */
-  size_t streamCount() {
+  size_t streamCount() const {
     return streams_.size();
   }
 
@@ -626,6 +724,11 @@ class QuicStreamManager {
    */
   void setStreamAsControl(QuicStreamState& stream);
 
+  /*
+   * Sets the priority the stream is scheduled with.
+   */
+  void setStreamPriority(QuicStreamState& stream, Priority priority);
+
   /*
    * Clear the tracking of streams which can trigger API callbacks.
    */
@@ -705,6 +808,27 @@ class QuicStreamManager {
   // send stream limit updates
   uint64_t streamLimitWindowingFraction_{2};
 
+  // How fast the peer closes the streams of one direction, over windows of
+  // one RTT. Only tracked with autoScaleStreamLimits.
+  struct PeerStreamCloseRate {
+    TimePoint windowStart;
+    uint64_t closedInWindow{0};
+    uint64_t closedPerRtt{0};
+  };
+
+  /*
+   * Records that the peer closed one of its streams and returns the number
+   * of streams it should be allowed to have at once, which is the initial
+   * limit unless the limits are auto scaled.
+   */
+  uint64_t onPeerStreamClosed(
+      PeerStreamCloseRate& closeRate,
+      uint64_t initialStreamLimit,
+      uint64_t openPeerStreams);
+
+  PeerStreamCloseRate bidirectionalPeerStreamCloseRate_;
+  PeerStreamCloseRate unidirectionalPeerStreamCloseRate_;
+
   // Contains the value of a stream window update that should be sent for
   // remote bidirectional streams.
   folly::Optional<uint64_t> remoteBidirectionalStreamLimitUpdate_;
@@ -726,10 +850,20 @@ class QuicStreamManager {
   // Streams that are opened locally on the connection. Ordered by id.
   std::deque<StreamId> openLocalStreams_;
 
-  // A map of streams that are active.
-  std::map<StreamId, QuicStreamState> streams_;
+  // The memory of closed streams, reused for the new ones.
+  std::shared_ptr<StreamStatePool> streamStatePool_;
+
+  // A map of streams that are active. Node based so that the stream states
+  // stay put while the map grows.
+  StreamMap streams_;
+
+  // The stream of the last lookup, until it is removed. The state of a stream
+  // doesn't move, so a lookup of the same stream is a comparison.
+  QuicStreamState* lastStream_{nullptr};
+  LookupCacheStats lookupCacheStats_;
 
-  std::deque<StreamId> newPeerStreams_;
+  // In the order the peer opened them, contiguous for onNewStreams.
+  std::vector<StreamId> newPeerStreams_;
 
   // List of streams that have pending reads
   std::set<StreamId> readableStreams_;
@@ -740,11 +874,17 @@ class QuicStreamManager {
   // List of streams that have writable data
   std::set<StreamId> writableStreams_;
 
+  // The streams of writableStreams_ grouped by priority, without empty groups.
+  std::map<Priority, std::set<StreamId>> writableStreamsByPriority_;
+
+  // Streams that have data with a delivery deadline
+  std::set<StreamId> deadlineStreams_;
+
   // List of streams that were blocked
-  std::unordered_map<StreamId, StreamDataBlockedFrame> blockedStreams_;
+  folly::F14FastMap<StreamId, StreamDataBlockedFrame> blockedStreams_;
 
   // List of streams where the peer was asked to stop sending
-  std::unordered_map<StreamId, ApplicationErrorCode> stopSendingStreams_;
+  folly::F14FastMap<StreamId, ApplicationErrorCode> stopSendingStreams_;
 
   // List of streams that have expired data
   std::set<StreamId> dataExpiredStreams_;
@@ -757,7 +897,7 @@ class QuicStreamManager {
 
   // Streams that had their stream window change and potentially need a window
   // update sent
-  std::unordered_set<StreamId> windowUpdates_;
+  folly::F14FastSet<StreamId> windowUpdates_;
 
   // Streams that had their flow control updated
   std::set<StreamId> flowControlUpdated_;
@@ -11,10 +11,14 @@
 #include <folly/Optional.h>
 #include <folly/functional/Invoke.h>
 #include <folly/io/async/EventBase.h>
+#include <chrono>
 #include <string>
 
 namespace quic {
 
+struct CongestionControlSample;
+struct WriteLoopMetrics;
+
 /* Interface for Transport level stats per VIP (server)
  * Quic Transport expects applications to instantiate this per thread (and
  * do necessary aggregation at the application level).
@@ -39,6 +43,9 @@ class QuicTransportStatsCallback {
     WORKER_NOT_INITIALIZED,
     SERVER_SHUTDOWN,
     INITIAL_CONNID_SMALL,
+    LOAD_SHEDDING,
+    DUPLICATE_PACKET,
+    SOURCE_RATE_LIMITED,
     // NOTE: MAX should always be at the end
     MAX
   };
@@ -51,6 +58,49 @@ class QuicTransportStatsCallback {
     MAX
   };
 
+  enum class LatencyType : uint8_t {
+    // Parsing and decrypting a received packet.
+    PACKET_DECODE,
+    // Processing a received ACK frame.
+    ACK_PROCESSING,
+    // One call to writeQuicDataToSocket.
+    WRITE_LOOP,
+    // How late the write loop runs compared to when it was scheduled.
+    EVENT_LOOP_LAG,
+    // The stream latencies, with TransportSettings::trackStreamByteEvents,
+    // one sample per write of the app once it is delivered. The time from
+    // the write to the first byte of it being sent,
+    STREAM_APP_QUEUE,
+    // from the last time a byte of it was sent to the write being delivered,
+    STREAM_NETWORK,
+    // and, for the writes that were partly sent again, from the first time a
+    // byte of it was sent to the last time.
+    STREAM_RETRANSMISSION,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
+  // The parts of the work done for a connection that its CPU cost is broken
+  // down into. They nest: NETWORK_DATA includes PACKET_DECODE, which is where
+  // the packets are decrypted, and ACK_PROCESSING, and WRITE_LOOP includes
+  // PACKET_ENCRYPT and SOCKET_WRITE.
+  enum class CpuCostType : uint8_t {
+    // Processing the data read from the socket, one call to onNetworkData.
+    NETWORK_DATA,
+    // Parsing and decrypting a received packet.
+    PACKET_DECODE,
+    // Processing a received ACK frame.
+    ACK_PROCESSING,
+    // One call to writeQuicDataToSocket.
+    WRITE_LOOP,
+    // Encrypting a packet, or protecting the headers of a batch of packets.
+    PACKET_ENCRYPT,
+    // Writing a batch of packets to the socket, mostly the syscall.
+    SOCKET_WRITE,
+    // NOTE: MAX should always be at the end
+    MAX
+  };
+
   virtual ~QuicTransportStatsCallback() = default;
 
   // packet level metrics
@@ -108,6 +158,64 @@ class QuicTransportStatsCallback {
 
   virtual void onWrite(size_t bufSize) = 0;
 
+  // receive buffer pool usage, reported when a buffer is taken from the pool.
+  // pooledBuffers is the number of buffers cached by the pool and
+  // highWaterMark the largest number of buffers outstanding at once.
+  virtual void onRecvBufferPoolStats(
+      size_t pooledBuffers,
+      size_t highWaterMark) = 0;
+
+  // server only, stream data buffered by all the connections of a worker
+  // that has a workerBufferMemoryBudget, reported for every packet received.
+  // highWaterMark is the most bytes buffered at once.
+  virtual void onBufferMemoryUsage(
+      size_t bytesBuffered,
+      size_t highWaterMark) = 0;
+
+  // server only, packets that arrived on another worker than the one owning
+  // their connection. Reported by the owning worker for every batch of packets
+  // it takes from the handoff queues, and by the receiving worker when its
+  // queue to the owning worker was full.
+  virtual void onWorkerHandoffBatch(size_t numPackets) = 0;
+
+  virtual void onWorkerHandoffQueueFull() = 0;
+
+  // server only, Retry packets sent to validate a client address before
+  // creating its connection.
+  virtual void onRetrySent() = 0;
+
+  // packets declared lost and then acked, and the congestion controller
+  // undoing its reaction to them, with rackLossDetection.
+  virtual void onSpuriousLoss(size_t numPackets) = 0;
+
+  virtual void onCongestionUndo() = 0;
+
+  // latency metrics, optional. The transport only reads the clock for them
+  // when latencySamplingEnabled() returns true, so implementations that don't
+  // need them pay nothing. The samples are meant to be recorded in a per thread
+  // histogram such as LatencyHistogram.
+  virtual bool latencySamplingEnabled() const {
+    return false;
+  }
+
+  virtual void onLatencySample(
+      LatencyType /* type */,
+      std::chrono::microseconds /* latency */) {}
+
+  // cpu cost metrics, optional. Reported with the estimated cycles of every
+  // sample when TransportSettings::cpuCostSamplingRate is set, that is the
+  // cycles of the sampled call times the sampling rate.
+  virtual void onCpuCost(CpuCostType /* type */, uint64_t /* cycles */) {}
+
+  // write loop metrics, optional. Reported for every write loop of the
+  // connections with TransportSettings::writeLoopStats.
+  virtual void onWriteLoop(const WriteLoopMetrics& /* metrics */) {}
+
+  // congestion control samples, optional. Reported for the connections with
+  // TransportSettings::congestionSampleInterval.
+  virtual void onCongestionControlSample(
+      const CongestionControlSample& /* sample */) {}
+
   static const char* toString(ConnectionCloseReason reason) {
     switch (reason) {
       case ConnectionCloseReason::NONE:
@@ -123,6 +231,50 @@ class QuicTransportStatsCallback {
     }
   }
 
+  static const char* toString(LatencyType type) {
+    switch (type) {
+      case LatencyType::PACKET_DECODE:
+        return "PACKET_DECODE";
+      case LatencyType::ACK_PROCESSING:
+        return "ACK_PROCESSING";
+      case LatencyType::WRITE_LOOP:
+        return "WRITE_LOOP";
+      case LatencyType::EVENT_LOOP_LAG:
+        return "EVENT_LOOP_LAG";
+      case LatencyType::STREAM_APP_QUEUE:
+        return "STREAM_APP_QUEUE";
+      case LatencyType::STREAM_NETWORK:
+        return "STREAM_NETWORK";
+      case LatencyType::STREAM_RETRANSMISSION:
+        return "STREAM_RETRANSMISSION";
+      case LatencyType::MAX:
+        return "MAX";
+      default:
+        throw std::runtime_error("Undefined LatencyType passed");
+    }
+  }
+
+  static const char* toString(CpuCostType type) {
+    switch (type) {
+      case CpuCostType::NETWORK_DATA:
+        return "NETWORK_DATA";
+      case CpuCostType::PACKET_DECODE:
+        return "PACKET_DECODE";
+      case CpuCostType::ACK_PROCESSING:
+        return "ACK_PROCESSING";
+      case CpuCostType::WRITE_LOOP:
+        return "WRITE_LOOP";
+      case CpuCostType::PACKET_ENCRYPT:
+        return "PACKET_ENCRYPT";
+      case CpuCostType::SOCKET_WRITE:
+        return "SOCKET_WRITE";
+      case CpuCostType::MAX:
+        return "MAX";
+      default:
+        throw std::runtime_error("Undefined CpuCostType passed");
+    }
+  }
+
   static const char* toString(PacketDropReason reason) {
     switch (reason) {
       case PacketDropReason::NONE:
@@ -151,6 +303,12 @@ class QuicTransportStatsCallback {
         return "SERVER_SHUTDOWN";
       case PacketDropReason::INITIAL_CONNID_SMALL:
         return "INITIAL_CONNID_SMALL";
+      case PacketDropReason::LOAD_SHEDDING:
+        return "LOAD_SHEDDING";
+      case PacketDropReason::DUPLICATE_PACKET:
+        return "DUPLICATE_PACKET";
+      case PacketDropReason::SOURCE_RATE_LIMITED:
+        return "SOURCE_RATE_LIMITED";
       case PacketDropReason::MAX:
         return "MAX";
       default:
@@ -175,6 +333,43 @@ class QuicTransportStatsCallbackFactory {
       folly::EventBase* evb) = 0;
 };
 
+/**
+ * Reports the time spent in the enclosing scope as a latency sample, if the
+ * callback is set and samples latencies.
+ */
+class QuicLatencySampler {
+ public:
+  QuicLatencySampler(
+      QuicTransportStatsCallback* infoCallback,
+      QuicTransportStatsCallback::LatencyType type)
+      : infoCallback_(
+            infoCallback && infoCallback->latencySamplingEnabled()
+                ? infoCallback
+                : nullptr),
+        type_(type) {
+    if (infoCallback_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~QuicLatencySampler() {
+    if (infoCallback_) {
+      infoCallback_->onLatencySample(
+          type_,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start_));
+    }
+  }
+
+  QuicLatencySampler(const QuicLatencySampler&) = delete;
+  QuicLatencySampler& operator=(const QuicLatencySampler&) = delete;
+
+ private:
+  QuicTransportStatsCallback* infoCallback_;
+  QuicTransportStatsCallback::LatencyType type_;
+  std::chrono::steady_clock::time_point start_;
+};
+
 #define QUIC_STATS(infoCallback, method, ...)                              \
   if (infoCallback) {                                                      \
     folly::invoke(                                                         \
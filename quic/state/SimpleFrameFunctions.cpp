@@ -8,11 +8,60 @@
 
 #include "SimpleFrameFunctions.h"
 
+#include <algorithm>
+
 #include <quic/state/QuicStateFunctions.h>
 #include <quic/state/QuicStreamFunctions.h>
 
 namespace quic {
+
+namespace {
+/**
+ * Merges the frame into a pending frame that it supersedes, so the pending
+ * queue doesn't grow with control frames only the latest of which matters.
+ * Returns whether the frame was merged.
+ */
+bool coalescePendingFrame(FrameList& frames, const QuicSimpleFrame& frame) {
+  switch (frame.type()) {
+    case QuicSimpleFrame::Type::MaxStreamsFrame_E: {
+      const MaxStreamsFrame& maxStreams = *frame.asMaxStreamsFrame();
+      for (auto& pending : frames) {
+        auto pendingMaxStreams = pending.asMaxStreamsFrame();
+        if (pendingMaxStreams &&
+            pendingMaxStreams->isForBidirectional ==
+                maxStreams.isForBidirectional) {
+          // The limit only grows, a lost frame can carry an older one.
+          pendingMaxStreams->maxStreams =
+              std::max(pendingMaxStreams->maxStreams, maxStreams.maxStreams);
+          return true;
+        }
+      }
+      return false;
+    }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      for (auto& pending : frames) {
+        if (pending.asAckFrequencyFrame()) {
+          pending = frame;
+          return true;
+        }
+      }
+      return false;
+    }
+    case QuicSimpleFrame::Type::PingFrame_E:
+      return std::any_of(
+          frames.begin(), frames.end(), [](const QuicSimpleFrame& pending) {
+            return pending.type() == QuicSimpleFrame::Type::PingFrame_E;
+          });
+    default:
+      return false;
+  }
+}
+} // namespace
+
 void sendSimpleFrame(QuicConnectionStateBase& conn, QuicSimpleFrame frame) {
+  if (coalescePendingFrame(conn.pendingEvents.frames, frame)) {
+    return;
+  }
   conn.pendingEvents.frames.emplace_back(std::move(frame));
 }
 
@@ -65,9 +114,18 @@ folly::Optional<QuicSimpleFrame> updateSimpleFrameOnPacketClone(
     case QuicSimpleFrame::Type::PathResponseFrame_E:
       // Do not clone PATH_RESPONSE to avoid buffering
       return folly::none;
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E:
+      // A newer ACK_FREQUENCY frame supersedes this one
+      if (!conn.ackFrequencyState.requested ||
+          !(*frame.asAckFrequencyFrame() ==
+            *conn.ackFrequencyState.requested)) {
+        return folly::none;
+      }
+      return QuicSimpleFrame(frame);
     case QuicSimpleFrame::Type::NewConnectionIdFrame_E:
     case QuicSimpleFrame::Type::MaxStreamsFrame_E:
     case QuicSimpleFrame::Type::RetireConnectionIdFrame_E:
+    case QuicSimpleFrame::Type::NewTokenFrame_E:
       // TODO junqiw
       return QuicSimpleFrame(frame);
   }
@@ -137,9 +195,22 @@ void updateSimpleFrameOnPacketLoss(
       // Do not retransmit PATH_RESPONSE to avoid buffering
       break;
     }
-    case QuicSimpleFrame::Type::NewConnectionIdFrame_E:
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& ackFrequency = *frame.asAckFrequencyFrame();
+      auto& frames = conn.pendingEvents.frames;
+      if (conn.ackFrequencyState.requested &&
+          ackFrequency == *conn.ackFrequencyState.requested &&
+          std::find(frames.begin(), frames.end(), frame) == frames.end()) {
+        frames.push_back(ackFrequency);
+      }
+      break;
+    }
     case QuicSimpleFrame::Type::MaxStreamsFrame_E:
+      sendSimpleFrame(conn, frame);
+      break;
+    case QuicSimpleFrame::Type::NewConnectionIdFrame_E:
     case QuicSimpleFrame::Type::RetireConnectionIdFrame_E:
+    case QuicSimpleFrame::Type::NewTokenFrame_E:
       conn.pendingEvents.frames.push_back(frame);
       break;
   }
@@ -255,6 +326,32 @@ bool updateSimpleFrameOnPacketReceived(
       // TODO junqiw
       return false;
     }
+    case QuicSimpleFrame::Type::NewTokenFrame_E: {
+      // Only written, the NEW_TOKEN frames are read as ReadNewTokenFrame.
+      return false;
+    }
+    case QuicSimpleFrame::Type::AckFrequencyFrame_E: {
+      const AckFrequencyFrame& ackFrequency = *frame.asAckFrequencyFrame();
+      if (!conn.transportSettings.ackFrequencyEnabled) {
+        throw QuicTransportException(
+            "Received ACK_FREQUENCY without advertising min_ack_delay",
+            TransportErrorCode::PROTOCOL_VIOLATION);
+      }
+      if (ackFrequency.updateMaxAckDelay <
+          conn.transportSettings.minAckDelay) {
+        throw QuicTransportException(
+            "ACK_FREQUENCY max ack delay below min_ack_delay",
+            TransportErrorCode::PROTOCOL_VIOLATION);
+      }
+      // Reordered frames with older sequence numbers are ignored.
+      auto& received = conn.ackFrequencyState.received;
+      if (!received || ackFrequency.sequenceNumber > received->sequenceNumber) {
+        received = ackFrequency;
+        received->packetTolerance = std::min(
+            received->packetTolerance, kMaxAckFrequencyPacketTolerance);
+      }
+      return true;
+    }
   }
   folly::assume_unreachable();
 }
@@ -18,15 +18,22 @@
 #include <quic/codec/QuicReadCodec.h>
 #include <quic/codec/QuicWriteCodec.h>
 #include <quic/codec/Types.h>
+#include <quic/common/BufferPool.h>
+#include <quic/common/TombstoneDeque.h>
 #include <quic/handshake/HandshakeLayer.h>
+#include <quic/handshake/OneRttKeyUpdater.h>
 #include <quic/logging/QLogger.h>
 #include <quic/state/AckStates.h>
+#include <quic/state/BufferMemoryBudget.h>
+#include <quic/state/PacketEventTable.h>
 #include <quic/state/QuicStreamManager.h>
 #include <quic/state/QuicTransportStatsCallback.h>
 #include <quic/state/StateMachine.h>
 #include <quic/state/StreamData.h>
 #include <quic/state/TransportSettings.h>
+#include <array>
 #include <chrono>
+#include <deque>
 #include <list>
 #include <map>
 #include <numeric>
@@ -39,44 +46,70 @@ namespace quic {
 struct NetworkData {
   Buf data;
   TimePoint receiveTimePoint;
+  // The ECN codepoint of the datagram, NotECT when the socket doesn't report
+  // it.
+  ECNCodepoint ecn{ECNCodepoint::NotECT};
+  // The packet of the datagram when it was parsed ahead along with the other
+  // packets of its batch, see QuicTransportBase::onNetworkDataBatch(). data
+  // is then null and parsedPacketSize is the size of the datagram.
+  folly::Optional<CodecResult> parsedPacket;
+  size_t parsedPacketSize{0};
+  // The invariant of the first packet of the datagram when it's a long header
+  // packet, if the server worker already parsed it to route the datagram.
+  folly::Optional<ParsedLongHeaderInvariant> longHeaderInvariant;
 
   NetworkData() = default;
-  NetworkData(Buf&& buf, const TimePoint& receiveTime)
-      : data(std::move(buf)), receiveTimePoint(receiveTime) {}
+  NetworkData(
+      Buf&& buf,
+      const TimePoint& receiveTime,
+      ECNCodepoint ecnIn = ECNCodepoint::NotECT)
+      : data(std::move(buf)), receiveTimePoint(receiveTime), ecn(ecnIn) {}
 };
 
+// The path a packet is sent on. The current peer address is the primary path,
+// the others are SecondaryPaths.
+using PathId = uint32_t;
+constexpr PathId kPrimaryPathId = 0;
+
 /**
- * There are cases that we may clone an outstanding packet and resend it as is.
- * When that happens, we assign a PacketEvent to both the original and cloned
- * packet if no PacketEvent is already associated with the original packet. If
- * the original packet already has a PacketEvent, we copy that value into the
- * cloned packet.
- * A connection maintains a set of PacketEvents. When a packet with a
- * PacketEvent is acked or lost, we search the set. If the PacketEvent is
- * present in the set, we process the ack or loss event (e.g. update RTT, notify
- * CongestionController, and detect loss with this packet) as well as frames in
- * the packet. Then we remove the PacketEvent from the set. If the PacketEvent
- * is absent in the set, we consider all frames contained in the packet are
- * already processed. We will still handle the ack or loss event and update the
- * connection. But no frame will be processed.
+ * The fields read while scanning the outstanding packets on every ack and
+ * loss detection come first, so that a scan only touches the first cache line
+ * of every packet. The sent packet itself, which is only needed once the
+ * packet is acked or lost, comes after them.
  */
-using PacketEvent = PacketNum;
-
 struct OutstandingPacket {
-  // Structure representing the frames that are outstanding including the header
-  // that was sent.
-  RegularQuicWritePacket packet;
-  // Time that the packet was sent.
-  TimePoint time;
-  // Size of the packet sent on the wire.
-  uint32_t encodedSize;
+  // Packet number and packet number space of the packet, copied out of the
+  // header.
+  PacketNum packetNum;
+  PacketNumberSpace packetNumberSpace;
+  // The congestion controller and rtt stats of this path account for the
+  // packet.
+  PathId pathId{kPrimaryPathId};
   // Whether this packet has any data from stream 0
   bool isHandshake;
   // Whether this packet is pure ack
   bool pureAck;
+  /**
+   * Whether the packet is sent when congestion controller is in app-limited
+   * state.
+   */
+  bool isAppLimited{false};
+  // Size of the packet sent on the wire.
+  uint32_t encodedSize;
+  // Time that the packet was sent.
+  TimePoint time;
   // Total sent bytes on this connection including this packet itself when this
   // packet is sent.
   uint64_t totalBytesSent;
+
+  // PacketEvent associated with this OutstandingPacket. This will be a
+  // folly::none if the packet isn't a clone and hasn't been cloned.
+  folly::Optional<PacketEvent> associatedEvent;
+
+  // Structure representing the frames that are outstanding including the header
+  // that was sent.
+  RegularQuicWritePacket packet;
+
   // Information regarding the last acked packet on this connection when this
   // packet is sent.
   struct LastAckedPacketInfo {
@@ -100,16 +133,6 @@ struct OutstandingPacket {
   };
   folly::Optional<LastAckedPacketInfo> lastAckedPacketInfo;
 
-  // PacketEvent associated with this OutstandingPacket. This will be a
-  // folly::none if the packet isn't a clone and hasn't been cloned.
-  folly::Optional<PacketEvent> associatedEvent;
-
-  /**
-   * Whether the packet is sent when congestion controller is in app-limited
-   * state.
-   */
-  bool isAppLimited{false};
-
   OutstandingPacket(
       RegularQuicWritePacket packetIn,
       TimePoint timeIn,
@@ -117,14 +140,20 @@ struct OutstandingPacket {
       bool isHandshakeIn,
       bool pureAckIn,
       uint64_t totalBytesSentIn)
-      : packet(std::move(packetIn)),
-        time(std::move(timeIn)),
-        encodedSize(encodedSizeIn),
+      : packetNum(packetIn.header.getPacketSequenceNum()),
+        packetNumberSpace(packetIn.header.getPacketNumberSpace()),
         isHandshake(isHandshakeIn),
         pureAck(pureAckIn),
-        totalBytesSent(totalBytesSentIn) {}
+        encodedSize(encodedSizeIn),
+        time(std::move(timeIn)),
+        totalBytesSent(totalBytesSentIn),
+        packet(std::move(packetIn)) {}
 };
 
+// Erasing an acked or lost packet only tombstones it, so that acking packets
+// in the middle of a large window does not move the rest of the window.
+using OutstandingPacketQueue = TombstoneDeque<OutstandingPacket>;
+
 struct Pacer {
   virtual ~Pacer() = default;
 
@@ -136,6 +165,13 @@ struct Pacer {
       uint64_t cwndBytes,
       std::chrono::microseconds rtt) = 0;
 
+  /**
+   * While the refreshes are deferred, refreshPacingRate only keeps the latest
+   * cwnd and RTT, and the rate is recomputed once from them when the
+   * refreshes resume.
+   */
+  virtual void setRefreshDeferred(bool deferred) = 0;
+
   /**
    * Notify the Pacer that a paced write is scheduled.
    *
@@ -164,6 +200,29 @@ struct Pacer {
    */
   virtual uint64_t getCachedWriteBatchSize() const = 0;
 
+  /**
+   * API for Transport to get the earliest departure time of the next packet
+   * when the kernel paces the connection. The packets are scheduled in bursts
+   * of the current batch size, one write interval apart, and never before
+   * currentTime. Every call schedules one more packet.
+   */
+  virtual TimePoint getNextDepartureTime(TimePoint currentTime) = 0;
+
+  /**
+   * Caps the pacing rate at maxRateBytesPerSec whatever the cwnd and the RTT,
+   * 0 removes the cap. A capped connection is paced even when it is app
+   * limited or its RTT is below the timer tick.
+   */
+  virtual void setMaxPacingRate(uint64_t maxRateBytesPerSec) = 0;
+
+  /**
+   * The rate the writes are paced at, in bytes per second. 0 when they
+   * aren't paced.
+   */
+  virtual uint64_t getPacingRate() const {
+    return 0;
+  }
+
   virtual void setAppLimited(bool limited) = 0;
   virtual void onPacketSent() = 0;
   virtual void onPacketsLoss() = 0;
@@ -187,6 +246,24 @@ struct PacingRate {
   PacingRate(std::chrono::microseconds interval, uint64_t burstSize);
 };
 
+/**
+ * A delivery rate sample, as in draft-cheng-iccrg-delivery-rate-estimation:
+ * the bytes acked while a packet was in flight, over the longer of the time
+ * they took to be sent and to be acked.
+ */
+struct DeliveryRateSample {
+  uint64_t deliveredBytes{0};
+  std::chrono::microseconds interval{0us};
+  // Whether the packet was sent while app-limited, in which case the sample
+  // only shows that the path can go at least this fast.
+  bool isAppLimited{false};
+
+  // In bytes per second.
+  uint64_t rate() const {
+    return deliveredBytes * 1000000 / interval.count();
+  }
+};
+
 struct CongestionController {
   // Helper struct to group multiple lost packets into one event
   struct LossEvent {
@@ -217,7 +294,7 @@ struct CongestionController {
             "LossEvent: lostBytes overflow",
             LocalErrorCode::LOST_BYTES_OVERFLOW);
       }
-      PacketNum packetNum = packet.packet.header.getPacketSequenceNum();
+      PacketNum packetNum = packet.packetNum;
       largestLostPacketNum =
           std::max(packetNum, largestLostPacketNum.value_or(packetNum));
       lostBytes += packet.encodedSize;
@@ -243,6 +320,11 @@ struct CongestionController {
     // The minimal RTT sample among packets acked by this AckEvent. This RTT
     // includes ack delay.
     folly::Optional<std::chrono::microseconds> mrttSample;
+    // Number of packets the peer newly reported as ECN-CE marked in this ack.
+    uint64_t ecnCEMarks{0};
+    // Taken off the largest newly acked packet, if it carries the state of
+    // the packet acked last when it was sent.
+    folly::Optional<DeliveryRateSample> deliveryRateSample;
 
     struct AckPacket {
       // Packet sent time when this acked pakcet was first sent.
@@ -309,6 +391,14 @@ struct CongestionController {
       folly::Optional<AckEvent>,
       folly::Optional<LossEvent>) = 0;
 
+  /**
+   * The packets of spuriousLoss were declared lost and then acked. Returns
+   * whether the controller undid its reaction to the loss.
+   */
+  virtual bool onSpuriousLoss(const LossEvent& /* spuriousLoss */) {
+    return false;
+  }
+
   /**
    * Return the number of bytes that the congestion controller
    * will allow you to write.
@@ -338,6 +428,31 @@ struct CongestionController {
   virtual void setAppLimited() = 0;
   virtual CongestionControlType type() const = 0;
 
+  /**
+   * The bandwidth of the path the controller estimates, in bytes per second.
+   * 0 for the controllers that don't model it.
+   */
+  virtual uint64_t getBandwidthEstimate() const {
+    return 0;
+  }
+
+  /**
+   * The state of the controller in its own enum, like CubicStates, as a
+   * number that only means something along with type(). 0 for the
+   * controllers that don't have states.
+   */
+  virtual uint8_t getStateCode() const {
+    return 0;
+  }
+
+  /**
+   * The bytes the controller counts in flight. 0 for the controllers that
+   * don't count them.
+   */
+  virtual uint64_t getBytesInFlight() const {
+    return 0;
+  }
+
   /**
    * Whether the congestion controller thinks it's currently in app-limited
    * state.
@@ -381,6 +496,14 @@ using FrameList = std::vector<QuicSimpleFrame>;
 
 struct LossState {
   enum class AlarmMethod { EarlyRetransmitOrReordering, Handshake, PTO };
+
+  struct LostPacket {
+    PacketNum packetNum;
+    PacketNumberSpace packetNumberSpace;
+    TimePoint sentTime;
+    uint32_t encodedSize;
+  };
+
   // Smooth rtt
   std::chrono::microseconds srtt{0us};
   // Latest rtt
@@ -441,12 +564,156 @@ struct LossState {
   folly::Optional<TimePoint> lastAckedTime;
   // The time when last retranmittable packet is sent
   TimePoint lastRetransmittablePacketSentTime;
+  // With rackLossDetection, the packets most recently declared lost, in the
+  // order they were.
+  std::deque<LostPacket> recentLostPackets;
+  // Whether a spurious loss showed the path reorders packets.
+  bool reorderingSeen{false};
+  // Largest application data packet of the primary path acked, which is the
+  // largest acked by the peer unless there are secondary paths.
+  folly::Optional<PacketNum> largestPrimaryPathAcked;
+  // RACK reordering window, in multiples of the min rtt divided by
+  // kRackReorderingWindowDivisor.
+  uint32_t reorderingWindowMultiplier{1};
+  folly::Optional<TimePoint> lastReorderingWindowIncrease;
+  uint32_t lossEventsSinceReorderingWindowIncrease{0};
+  // Total number of packets declared lost and then acked.
+  uint32_t spuriousLossCount{0};
+  // Total number of times the congestion controller undid a loss reaction.
+  uint32_t congestionUndoCount{0};
+  // Delivery rate in bytes per second, from the latest delivery rate sample.
+  // Samples of app-limited packets only ever raise it.
+  uint64_t deliveryRate{0};
+  folly::Optional<DeliveryRateSample> latestDeliveryRateSample;
+};
+
+// CPU cost accounting of a connection, see
+// TransportSettings::cpuCostSamplingRate.
+struct CpuCostState {
+  using CpuCostType = QuicTransportStatsCallback::CpuCostType;
+  static constexpr size_t kNumTypes = static_cast<size_t>(CpuCostType::MAX);
+
+  // Estimated cycles spent, the sampled cycles times the sampling rate.
+  std::array<uint64_t, kNumTypes> cycles{};
+  // Number of calls, sampled or not.
+  std::array<uint64_t, kNumTypes> calls{};
+  // Number of sampled calls.
+  std::array<uint64_t, kNumTypes> samples{};
+};
+
+// What held the writes of a connection back when it stopped writing.
+enum class WriteLimit : uint8_t {
+  // Nothing to send and nothing in flight.
+  Idle,
+  // Data to send that nothing visible held back, like the write packet limit
+  // of a loop or a full socket buffer.
+  Busy,
+  // Nothing more to send while data is in flight.
+  AppLimited,
+  CwndLimited,
+  // By the connection or the stream flow control of the peer.
+  FlowControlLimited,
+  PacingLimited,
+  MAX,
+};
+
+// The time a connection spent in each WriteLimit, like the tcpi_busy_time,
+// tcpi_rwnd_limited and tcpi_sndbuf_limited of TCP.
+struct WriteLimitState {
+  static constexpr size_t kNumLimits = static_cast<size_t>(WriteLimit::MAX);
+
+  WriteLimit limit{WriteLimit::Idle};
+  TimePoint limitStartTime;
+  // The time of the limits left so far, indexed by WriteLimit.
+  std::array<std::chrono::microseconds, kNumLimits> time{};
+};
+
+// What one write loop of a connection did, see
+// TransportSettings::writeLoopStats.
+struct WriteLoopMetrics {
+  uint64_t packetsWritten{0};
+  // The batches handed to the socket, a sendmsg or sendmmsg each, and the
+  // packets and bytes in them. With GSO the packets of a batch are its
+  // segments.
+  uint64_t socketWrites{0};
+  uint64_t socketWritePackets{0};
+  uint64_t bytesWritten{0};
+  // What held the writes back when the loop stopped. Busy is the write
+  // packet limit of the loop or a full socket buffer.
+  WriteLimit stopReason{WriteLimit::Idle};
+  std::chrono::microseconds timeSpent{0us};
+};
+
+// The congestion control of a connection at one point in time, see
+// TransportSettings::congestionSampleInterval. Fixed size, so that a
+// collector can copy it around without allocating.
+struct CongestionControlSample {
+  TimePoint time;
+  folly::Optional<ConnectionId> serverConnectionId;
+  CongestionControlType type{CongestionControlType::None};
+  // See CongestionController::getStateCode().
+  uint8_t state{0};
+  uint64_t congestionWindow{0};
+  uint64_t inflightBytes{0};
+  // In bytes per second, 0 when not known.
+  uint64_t bandwidthEstimate{0};
+  uint64_t pacingRate{0};
+  std::chrono::microseconds srtt{0us};
+  std::chrono::microseconds mrtt{0us};
+};
+
+// The sums over the write loops of a connection.
+struct WriteLoopStats {
+  uint64_t numLoops{0};
+  uint64_t packetsWritten{0};
+  uint64_t socketWrites{0};
+  uint64_t socketWritePackets{0};
+  uint64_t bytesWritten{0};
+  // The loops by the reason they stopped, indexed by WriteLimit.
+  std::array<uint64_t, WriteLimitState::kNumLimits> stops{};
+  std::chrono::microseconds timeSpent{0us};
+};
+
+// DATAGRAM frames of a connection, see TransportSettings::maxDatagramFrameSize.
+struct DatagramState {
+  // The largest frame the peer accepts, 0 if it doesn't support them.
+  uint64_t maxWriteFrameSize{0};
+  // Written by the app and waiting for room in a packet, and received and
+  // waiting for the app. Both are bounded, the oldest datagram is dropped to
+  // make room for a new one since a stale one is worth less.
+  std::deque<Buf> writeBuffer;
+  std::deque<Buf> readBuffer;
+  uint64_t numWriteDropped{0};
+  uint64_t numReadDropped{0};
 };
 
 class Logger;
 class CongestionControllerFactory;
 class LoopDetectorCallback;
 
+/**
+ * A validated path that packets are sent on at the same time as the current
+ * peer address, see TransportSettings::multipathEnabled. Its packets share the
+ * packet numbers of the connection but are gated by its own congestion
+ * controller, and its acks feed its own rtt stats. Losses are detected among
+ * the packets of the path only, since the other paths reorder them.
+ */
+struct SecondaryPath {
+  PathId id;
+  folly::SocketAddress peerAddress;
+  // Peer connection id the packets on the path use, the current one if none.
+  folly::Optional<ConnectionId> connId;
+  std::unique_ptr<CongestionController> congestionController;
+  std::chrono::microseconds srtt{0us};
+  std::chrono::microseconds lrtt{0us};
+  std::chrono::microseconds rttvar{0us};
+  std::chrono::microseconds mrtt{kDefaultMinRtt};
+  folly::Optional<PacketNum> largestAckedPacket;
+  // Share of the writes under PathSchedulerType::Weighted, the primary path
+  // has a weight of TransportSettings::primaryPathWeight.
+  uint64_t weight{1};
+};
+
 struct QuicConnectionStateBase {
   virtual ~QuicConnectionStateBase() = default;
 
@@ -480,13 +747,12 @@ struct QuicConnectionStateBase {
   // TODO: We really really should wrap outstandingPackets, all its associated
   // counters and the outstandingPacketEvents into one class.
   // Sent packets which have not been acked. These are sorted by PacketNum.
-  std::deque<OutstandingPacket> outstandingPackets;
+  OutstandingPacketQueue outstandingPackets;
 
   // All PacketEvents of this connection. If a OutstandingPacket doesn't have an
-  // associatedEvent or if it's not in this set, there is no need to process its
-  // frames upon ack or loss.
-  // TODO: Enforce only AppTraffic packets to be clonable
-  std::set<PacketEvent> outstandingPacketEvents;
+  // associatedEvent or if it's not outstanding in this table, there is no need
+  // to process its frames upon ack or loss.
+  PacketEventTable outstandingPacketEvents;
 
   // Number of pure ack packets outstanding.
   uint64_t outstandingPureAckPacketsCount{0};
@@ -497,6 +763,11 @@ struct QuicConnectionStateBase {
   // Number of packets are clones or cloned.
   uint64_t outstandingClonedPacketsCount{0};
 
+  // Packet numbers of the last kMaxCloneCandidates AppData packets the
+  // CloningScheduler could clone, oldest first. The ones no longer
+  // outstanding are dropped when the scheduler looks for a packet to clone.
+  std::deque<PacketNum> cloneCandidates;
+
   // The read codec to decrypt and decode packets.
   std::unique_ptr<QuicReadCodec> readCodec;
 
@@ -515,6 +786,25 @@ struct QuicConnectionStateBase {
   // Write cipher for 1-RTT data
   std::unique_ptr<Aead> oneRttWriteCipher;
 
+  // Key update state of the 1-rtt keys. The updater is only set with
+  // TransportSettings::keyUpdateEnabled.
+  struct OneRttKeyUpdateState {
+    std::unique_ptr<OneRttKeyUpdater> updater;
+    // Write cipher of the key phase after the current one, derived ahead of
+    // the key update.
+    std::unique_ptr<Aead> nextWriteCipher;
+    ProtectionType writePhase{ProtectionType::KeyPhaseZero};
+    // First packet number and time of the current write phase.
+    PacketNum writePhaseStartPacketNum{0};
+    TimePoint writePhaseStartTime;
+    // Whether this endpoint started the last key update, and the peer hasn't
+    // sent a packet of the new phase yet.
+    bool localUpdatePending{false};
+    uint64_t numKeyUpdates{0};
+  };
+
+  OneRttKeyUpdateState oneRttKeyUpdate;
+
   // Write cipher for packets with initial keys.
   std::unique_ptr<Aead> initialWriteCipher;
 
@@ -560,15 +850,42 @@ struct QuicConnectionStateBase {
   // Current peer address.
   folly::SocketAddress peerAddress;
 
+  // Paths sent on besides the current peer address. Cleared on migration,
+  // the packets still outstanding on them are then no longer accounted for.
+  std::vector<SecondaryPath> secondaryPaths;
+  PathId nextPathId{kPrimaryPathId + 1};
+
+  // Path the packets written right now are sent on, see ScopedPathWrite.
+  PathId writePathId{kPrimaryPathId};
+
   // Local error on the connection.
   folly::Optional<std::pair<QuicErrorCode, std::string>> localConnectionError;
 
   // Error sent on the connection by the peer.
   folly::Optional<std::pair<QuicErrorCode, std::string>> peerConnectionError;
 
+  // The last packet with a close frame that was sent, only kept with
+  // TransportSettings::compactDrainingConnections.
+  Buf lastClosePacket;
+
   // Before deadline, transport may treat ENETUNREACH as non-fatal error
   folly::Optional<TimePoint> continueOnNetworkUnreachableDeadline;
 
+  // With TransportSettings::sendBlockedBackpressure, what was built while the
+  // send buffer of the socket was full. It is written once the socket is
+  // writable, before anything else, the packets are outstanding already.
+  struct SendBlockedState {
+    // Writes the batch that found the buffer full again, returns what
+    // BatchWriter::write does.
+    using RetryBatchFunc = folly::Function<ssize_t(
+        folly::AsyncUDPSocket&,
+        const folly::SocketAddress&)>;
+    RetryBatchFunc retryBatch;
+    // The datagrams built after it, in order.
+    std::deque<Buf> datagrams;
+  };
+  folly::Optional<SendBlockedState> sendBlocked;
+
   // Supported versions in order of preference. Only meaningful to clients.
   // TODO: move to client only conn state.
   std::vector<QuicVersion> supportedVersions;
@@ -615,10 +932,27 @@ struct QuicConnectionStateBase {
 
   LossState lossState;
 
+  CpuCostState cpuCosts;
+
+  WriteLimitState writeLimitState;
+
+  // With TransportSettings::writeLoopStats, the loop being written and the
+  // sums of the previous ones.
+  folly::Optional<WriteLoopMetrics> currentWriteLoop;
+  WriteLoopStats writeLoopStats;
+
+  // When the congestion control was last sampled, with
+  // TransportSettings::congestionSampleInterval.
+  folly::Optional<TimePoint> lastCongestionSampleTime;
+
   // This contains the ack and packet number related states for all three
   // packet number space.
   AckStates ackStates;
 
+  AckFrequencyState ackFrequencyState;
+
+  DatagramState datagramState;
+
   struct ConnectionFlowControlState {
     // The size of the connection flow control window.
     uint64_t windowSize{0};
@@ -674,6 +1008,60 @@ struct QuicConnectionStateBase {
   // max_packet_size in Transport Parameters and PMTU
   uint64_t udpSendPacketLen{kDefaultUDPSendPacketLen};
 
+  // Search for the path MTU with TransportSettings::pmtuDiscoveryEnabled, see
+  // startPmtuDiscovery(). udpSendPacketLen is the largest size known to work.
+  struct PmtuDiscoveryState {
+    // A probe that is neither acked nor lost yet. Probes aren't outstanding
+    // packets, they aren't retransmitted nor counted in flight.
+    struct Probe {
+      PacketNum packetNum;
+      uint64_t size;
+      TimePoint sentTime;
+    };
+
+    bool enabled{false};
+    // The packet size the search started from. The connection falls back to
+    // it when the path no longer carries larger packets.
+    uint64_t baseSize{0};
+    // The largest size that can be probed.
+    uint64_t maxSize{0};
+    // The sizes above it are known not to work.
+    uint64_t searchHigh{0};
+    // The size being probed and how many of its probes were lost.
+    uint64_t probeSize{0};
+    uint8_t lostProbes{0};
+    folly::Optional<Probe> probe;
+    // Once the search is over, when it starts again.
+    folly::Optional<TimePoint> nextSearchTime;
+    // Packets larger than baseSize lost since one of them was acked.
+    uint64_t largePacketsLost{0};
+  };
+
+  PmtuDiscoveryState pmtuDiscovery;
+
+  // The datagram being filled while a ScopedCoalescedWrite is alive. Its
+  // packets are already protected, it is sent when a short header packet
+  // ends it, when the next packet doesn't fit or when the scope ends.
+  struct CoalescedDatagram {
+    bool enabled{false};
+    Buf packets;
+    uint64_t numPackets{0};
+    // The datagram carries a client Initial with crypto data and has to be
+    // padded to kMinInitialPacketSize. If the packets after the Initial don't
+    // get it there, a padding only Initial is added when it's sent, so
+    // paddingReserve bytes are kept for it.
+    bool needsPadding{false};
+    uint64_t paddingReserve{0};
+    folly::Optional<ConnectionId> initialSrcConnId;
+    folly::Optional<ConnectionId> initialDstConnId;
+    std::string initialToken;
+  };
+
+  CoalescedDatagram coalescedDatagram;
+
+  // Buffers the packets are built into when usePacketArena is set.
+  std::unique_ptr<BufferPool> packetArena;
+
   struct PacketSchedulingState {
     StreamId nextScheduledStream{0};
   };
@@ -693,6 +1081,10 @@ struct QuicConnectionStateBase {
   // Track stats for various server events
   QuicTransportStatsCallback* infoCallback{nullptr};
 
+  // Shared by the connections of a server worker when workerBufferMemoryBudget
+  // is set.
+  BufferMemoryBudget::SharedPtr bufferMemoryBudget;
+
   struct HappyEyeballsState {
     // Delay timer
     folly::HHWheelTimer::Callback* connAttemptDelayTimeout{nullptr};
@@ -716,6 +1108,11 @@ struct QuicConnectionStateBase {
     // Whether should write to the second UDP socket
     bool shouldWriteToSecondSocket{false};
 
+    // When the first and the second socket started writing, to tell how long
+    // the peer took to answer on each.
+    TimePoint firstSocketStartTime;
+    TimePoint secondSocketStartTime;
+
     // Whether HappyEyeballs has finished
     // The signal of finishing is first successful decryption of a packet
     bool finished{false};
@@ -727,6 +1124,10 @@ struct QuicConnectionStateBase {
   // For example, we may not want to pace a connection that's still handshaking.
   bool canBePaced{false};
 
+  // The pacing rate cap in bytes per second set by the app with
+  // setMaxPacingRate, the pacers of the connection start with it.
+  folly::Optional<uint64_t> maxPacingRate;
+
   // Whether or not both ends agree to use partial reliability
   bool partialReliabilityEnabled{false};
 
@@ -744,6 +1145,10 @@ struct QuicConnectionStateBase {
 
   std::shared_ptr<LoopDetectorCallback> loopDetectorCallback;
 
+  // While the write loop runs from a write scheduler with a packet budget,
+  // the most packets it can write.
+  folly::Optional<uint64_t> writePacketAllowance;
+
   // The parameter used to send the peer's active_connection_id_limit
   // does not include the connection id used in the initial handshake.
   uint64_t peerReceivedConnectionIdLimit{kDefaultConnectionIdLimit + 1};
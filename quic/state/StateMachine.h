@@ -14,6 +14,9 @@
 #include <boost/variant/static_visitor.hpp>
 #include <folly/Overload.h>
 #include <exception>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
 
 namespace quic {
 
@@ -74,6 +77,77 @@ struct Or<Condition, Conditions...>
     : std::conditional<Condition::value, std::true_type, Or<Conditions...>>::
           type {};
 
+template <class State, class... States>
+struct StateIndex;
+
+// sizeof...(States) when State isn't one of States.
+template <class State>
+struct StateIndex<State> : std::integral_constant<size_t, 0> {};
+
+template <class State, class... States>
+struct StateIndex<State, State, States...>
+    : std::integral_constant<size_t, 0> {};
+
+template <class State, class Other, class... States>
+struct StateIndex<State, Other, States...>
+    : std::integral_constant<size_t, 1 + StateIndex<State, States...>::value> {
+};
+
+/**
+ * The state of a machine whose states are empty types, kept as the index of
+ * the type in States in a single byte, instead of a boost::variant. It is
+ * assigned and compared with the state types like the variant and
+ * invokeHandler() dispatches on it with a table of the handlers built at
+ * compile time.
+ */
+template <class... States>
+class CompactState {
+  static_assert(
+      sizeof...(States) <= std::numeric_limits<uint8_t>::max(),
+      "Too many states");
+
+ public:
+  template <
+      class State,
+      typename = std::enable_if_t<
+          StateIndex<State, States...>::value < sizeof...(States)>>
+  /* implicit */ CompactState(State)
+      : index_(StateIndex<State, States...>::value) {}
+
+  /**
+   * Index of the state in States, like boost::variant::which().
+   */
+  uint8_t which() const {
+    return index_;
+  }
+
+  template <class State>
+  bool is() const {
+    static_assert(
+        StateIndex<State, States...>::value < sizeof...(States),
+        "Not a state of the machine");
+    return index_ == StateIndex<State, States...>::value;
+  }
+
+  template <class... Matches>
+  bool isAnyOf() const {
+    bool matched = false;
+    (void)std::initializer_list<int>{(matched |= is<Matches>(), 0)...};
+    return matched;
+  }
+
+  bool operator==(const CompactState& other) const {
+    return index_ == other.index_;
+  }
+
+  bool operator!=(const CompactState& other) const {
+    return index_ != other.index_;
+  }
+
+ private:
+  uint8_t index_;
+};
+
 template <typename T>
 struct Matcher {
   bool operator()(const T&) const {
@@ -81,12 +155,22 @@ struct Matcher {
   }
 };
 
-template <typename StateType, typename... States>
-bool matchesStates(const StateType& state) {
+template <typename... States, typename... AllStates>
+bool matchesStatesImpl(const CompactState<AllStates...>& state) {
+  return state.template isAnyOf<States...>();
+}
+
+template <typename... States, typename StateType>
+bool matchesStatesImpl(const StateType& state) {
   return folly::variant_match(
       state, Matcher<States>{}..., [](const auto&) { return false; });
 }
 
+template <typename StateType, typename... States>
+bool matchesStates(const StateType& state) {
+  return matchesStatesImpl<States...>(state);
+}
+
 template <class Machine, class State, class Event, class... AllowedStates>
 struct HandlerBase {
   template <class NewState>
@@ -156,13 +240,37 @@ struct state_visitor : public boost::static_visitor<> {
   typename Machine::UserData& userData_;
 };
 
+template <class Machine, class Event, class StateType>
+void dispatchHandler(
+    const StateType& state,
+    Event&& event,
+    typename Machine::StateData& data,
+    typename Machine::UserData& userData) {
+  auto visitor =
+      state_visitor<Machine, Event>(std::move(event), data, userData);
+  boost::apply_visitor(visitor, state);
+}
+
+template <class Machine, class Event, class... States>
+void dispatchHandler(
+    const CompactState<States...>& state,
+    Event&& event,
+    typename Machine::StateData& data,
+    typename Machine::UserData& userData) {
+  using HandlerFn = void (*)(
+      typename Machine::StateData&, Event&&, typename Machine::UserData&);
+  // The handler of the event for every state, in the order of States, with
+  // the InvalidEventHandler for the transitions that aren't declared.
+  static constexpr HandlerFn kHandlers[] = {
+      &Handler<Machine, States, Event>::handle...};
+  kHandlers[state.which()](data, std::move(event), userData);
+}
+
 template <class Machine, class Event>
 void invokeHandler(
     typename Machine::StateData& data,
     Event event,
     typename Machine::UserData& userData) {
-  auto visitor =
-      state_visitor<Machine, Event>(std::move(event), data, userData);
-  return boost::apply_visitor(visitor, data.state);
+  dispatchHandler<Machine>(data.state, std::move(event), data, userData);
 }
 }
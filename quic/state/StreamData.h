@@ -10,8 +10,11 @@
 
 #include <quic/QuicConstants.h>
 #include <quic/codec/Types.h>
+#include <quic/common/TombstoneDeque.h>
 #include <quic/state/StateMachine.h>
 
+#include <map>
+
 namespace quic {
 
 struct StreamBuffer {
@@ -30,12 +33,230 @@ struct StreamBuffer {
   StreamBuffer& operator=(StreamBuffer&& other) = default;
 };
 
+/*
+ * The data received on a stream and not read yet, as non overlapping buffers
+ * sorted by offset. The buffers are keyed by their end offset, which doesn't
+ * change when data is consumed from their start, so finding the buffers that
+ * overlap a range, inserting and erasing are logarithmic, and the front is
+ * found in constant time.
+ *
+ * Data can be trimmed from the start of a buffer in place. Anything that
+ * changes where a buffer ends has to erase it and insert it again.
+ */
+class StreamReadBuffer {
+ public:
+  using Map = std::map<uint64_t, StreamBuffer>;
+  using value_type = StreamBuffer;
+  using size_type = size_t;
+
+  template <bool Const>
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = StreamBuffer;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        std::conditional_t<Const, const StreamBuffer*, StreamBuffer*>;
+    using reference =
+        std::conditional_t<Const, const StreamBuffer&, StreamBuffer&>;
+    using map_pointer = std::conditional_t<Const, const Map*, Map*>;
+    using underlying_iterator =
+        std::conditional_t<Const, Map::const_iterator, Map::iterator>;
+
+    Iterator() = default;
+
+    Iterator(map_pointer map, underlying_iterator it) : map_(map), it_(it) {}
+
+    // Allow conversion from iterator to const_iterator.
+    template <bool C = Const, typename = std::enable_if_t<C>>
+    /* implicit */ Iterator(const Iterator<false>& other)
+        : map_(other.map_), it_(other.it_) {}
+
+    reference operator*() const {
+      return it_->second;
+    }
+
+    pointer operator->() const {
+      return &it_->second;
+    }
+
+    Iterator& operator++() {
+      ++it_;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      auto tmp = *this;
+      ++it_;
+      return tmp;
+    }
+
+    Iterator& operator--() {
+      --it_;
+      return *this;
+    }
+
+    Iterator operator--(int) {
+      auto tmp = *this;
+      --it_;
+      return tmp;
+    }
+
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.it_ == rhs.it_;
+    }
+
+    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.it_ != rhs.it_;
+    }
+
+    // Linear in n, provided for convenience, so that the buffers can be
+    // indexed and counted through a folly::Range.
+    Iterator operator+(difference_type n) const {
+      auto tmp = *this;
+      std::advance(tmp.it_, n);
+      return tmp;
+    }
+
+    reference operator[](difference_type n) const {
+      return *(*this + n);
+    }
+
+    friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) {
+      return std::distance(rhs.it_, lhs.it_);
+    }
+
+    // The buffers are keyed by end offset, so iterators can still be compared
+    // even though they are not random access.
+    friend bool operator<(const Iterator& lhs, const Iterator& rhs) {
+      if (rhs.it_ == rhs.map_->end()) {
+        return lhs.it_ != lhs.map_->end();
+      }
+      return lhs.it_ != lhs.map_->end() && lhs.it_->first < rhs.it_->first;
+    }
+
+    friend bool operator<=(const Iterator& lhs, const Iterator& rhs) {
+      return !(rhs < lhs);
+    }
+
+   private:
+    friend class Iterator<true>;
+    friend class StreamReadBuffer;
+    map_pointer map_{nullptr};
+    underlying_iterator it_;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  size_t size() const {
+    return buffers_.size();
+  }
+
+  bool empty() const {
+    return buffers_.empty();
+  }
+
+  iterator begin() {
+    return iterator(&buffers_, buffers_.begin());
+  }
+
+  const_iterator begin() const {
+    return const_iterator(&buffers_, buffers_.begin());
+  }
+
+  iterator end() {
+    return iterator(&buffers_, buffers_.end());
+  }
+
+  const_iterator end() const {
+    return const_iterator(&buffers_, buffers_.end());
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+
+  StreamBuffer& front() {
+    DCHECK(!empty());
+    return buffers_.begin()->second;
+  }
+
+  const StreamBuffer& front() const {
+    DCHECK(!empty());
+    return buffers_.begin()->second;
+  }
+
+  /**
+   * Inserts a non empty buffer that doesn't overlap any other.
+   */
+  iterator insert(StreamBuffer&& buffer) {
+    DCHECK_GT(buffer.data.chainLength(), 0);
+    auto bufferEnd = buffer.offset + buffer.data.chainLength();
+    auto result = buffers_.emplace(bufferEnd, std::move(buffer));
+    DCHECK(result.second);
+    return iterator(&buffers_, result.first);
+  }
+
+  /**
+   * Constructs a non empty buffer after all the others, in constant time.
+   */
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    StreamBuffer buffer(std::forward<Args>(args)...);
+    DCHECK_GT(buffer.data.chainLength(), 0);
+    DCHECK(empty() || buffers_.rbegin()->first <= buffer.offset);
+    auto bufferEnd = buffer.offset + buffer.data.chainLength();
+    buffers_.emplace_hint(buffers_.end(), bufferEnd, std::move(buffer));
+  }
+
+  /**
+   * The first buffer that ends at or after offset. If any buffer overlaps
+   * offset, or ends right before it, this is the one.
+   */
+  iterator lowerBound(uint64_t offset) {
+    return iterator(&buffers_, buffers_.lower_bound(offset));
+  }
+
+  const_iterator lowerBound(uint64_t offset) const {
+    return const_iterator(&buffers_, buffers_.lower_bound(offset));
+  }
+
+  iterator erase(const_iterator pos) {
+    return iterator(&buffers_, buffers_.erase(pos.it_));
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    return iterator(&buffers_, buffers_.erase(first.it_, last.it_));
+  }
+
+  void pop_front() {
+    DCHECK(!empty());
+    buffers_.erase(buffers_.begin());
+  }
+
+  void clear() {
+    buffers_.clear();
+  }
+
+ private:
+  Map buffers_;
+};
+
+// Acks and losses remove buffers from anywhere in the queue, so removals only
+// tombstone the buffer and lookups by offset are binary searches.
+using StreamBufferQueue = TombstoneDeque<StreamBuffer>;
+
 struct QuicStreamLike {
   virtual ~QuicStreamLike() = default;
 
   // List of bytes that have been read and buffered. We need to buffer
   // bytes in case we get bytes out of order.
-  std::deque<StreamBuffer> readBuffer;
+  StreamReadBuffer readBuffer;
 
   // List of bytes that have been written to the QUIC layer.
   folly::IOBufQueue writeBuffer{folly::IOBufQueue::cacheChainLength()};
@@ -45,11 +266,11 @@ struct QuicStreamLike {
   // We need to buffer these because these might be retransmitted
   // in the future.
   // These are sorted in order of start offset.
-  std::deque<StreamBuffer> retransmissionBuffer;
+  StreamBufferQueue retransmissionBuffer;
 
   // Stores a list of buffers which have been marked as loss by loss detector.
   // Each one represents one StreamFrame that was written.
-  std::deque<StreamBuffer> lossBuffer;
+  StreamBufferQueue lossBuffer;
 
   // Current offset of the start bytes in the write buffer.
   // This changes when we pop stuff off the writeBuffer.
@@ -106,34 +327,78 @@ struct StreamReceiveStates {
   struct Invalid {};
 };
 
-using StreamSendStateData = boost::variant<
+// A byte each, the stream state machines dispatch on them with a table.
+using StreamSendStateData = CompactState<
     StreamSendStates::Open,
     StreamSendStates::ResetSent,
     StreamSendStates::Closed,
     StreamSendStates::Invalid>;
 
-using StreamReceiveStateData = boost::variant<
+using StreamReceiveStateData = CompactState<
     StreamReceiveStates::Open,
     StreamReceiveStates::Closed,
     StreamReceiveStates::Invalid>;
 
 inline std::string streamStateToString(const StreamSendStateData& state) {
-  return folly::variant_match(
-      state,
-      [](const StreamSendStates::Open&) { return "Open"; },
-      [](const StreamSendStates::ResetSent&) { return "ResetSent"; },
-      [](const StreamSendStates::Closed&) { return "Closed"; },
-      [](const StreamSendStates::Invalid&) { return "Invalid"; });
+  if (state.is<StreamSendStates::Open>()) {
+    return "Open";
+  } else if (state.is<StreamSendStates::ResetSent>()) {
+    return "ResetSent";
+  } else if (state.is<StreamSendStates::Closed>()) {
+    return "Closed";
+  }
+  return "Invalid";
 }
 
 inline std::string streamStateToString(const StreamReceiveStateData& state) {
-  return folly::variant_match(
-      state,
-      [](const StreamReceiveStates::Open&) { return "Open"; },
-      [](const StreamReceiveStates::Closed&) { return "Closed"; },
-      [](const StreamReceiveStates::Invalid&) { return "Invalid"; });
+  if (state.is<StreamReceiveStates::Open>()) {
+    return "Open";
+  } else if (state.is<StreamReceiveStates::Closed>()) {
+    return "Closed";
+  }
+  return "Invalid";
 }
 
+// Token bucket of the send rate of a stream, set by the app with
+// setStreamMaxSendRate.
+struct StreamSendRateLimit {
+  uint64_t bytesPerSec;
+  // The depth of the bucket.
+  uint64_t burstBytes;
+  uint64_t tokens;
+  TimePoint lastRefillTime;
+
+  StreamSendRateLimit(
+      uint64_t bytesPerSecIn,
+      uint64_t burstBytesIn,
+      TimePoint now)
+      : bytesPerSec(bytesPerSecIn),
+        burstBytes(burstBytesIn),
+        tokens(burstBytesIn),
+        lastRefillTime(now) {}
+};
+
+// One write of the app to a stream, with
+// TransportSettings::trackStreamByteEvents.
+struct StreamByteEvent {
+  uint64_t startOffset;
+  uint64_t endOffset;
+  TimePoint writeTime;
+  // When a byte of the write was first sent, and the last time.
+  folly::Optional<TimePoint> firstSentTime;
+  TimePoint lastSentTime;
+  // Whether some of the bytes were sent more than once.
+  bool resent{false};
+
+  StreamByteEvent(
+      uint64_t startOffsetIn,
+      uint64_t endOffsetIn,
+      TimePoint writeTimeIn)
+      : startOffset(startOffsetIn),
+        endOffset(endOffsetIn),
+        writeTime(writeTimeIn) {}
+};
+
 struct QuicStreamState : public QuicStreamLike {
   virtual ~QuicStreamState() override = default;
 
@@ -145,6 +410,35 @@ struct QuicStreamState : public QuicStreamLike {
   // Stream id of the connection.
   StreamId id;
 
+  // The small fields are kept together, they are read on every packet and
+  // don't need padding this way.
+
+  // State machine data
+  struct Send {
+    StreamSendStateData state{StreamSendStates::Open()};
+  } send;
+  struct Recv {
+    StreamReceiveStateData state{StreamReceiveStates::Open()};
+  } recv;
+
+  // Tells whether this stream is a control stream.
+  // It is set by the app via setControlStream and the transport can use this
+  // knowledge for optimizations e.g. for setting the app limited state on
+  // congestion control with control streams still active.
+  bool isControl{false};
+
+  // Priority of the stream when scheduling writes, set by the app with
+  // setStreamPriority.
+  Priority priority{kDefaultPriority};
+
+  // The space the stream needs before its write callback is invoked, set by
+  // the app with setStreamWriteLowWatermark.
+  uint64_t writeLowWatermark{0};
+
+  // The scheduler doesn't write more new data of the stream than the bucket
+  // holds when it is set.
+  folly::Optional<StreamSendRateLimit> sendRateLimit;
+
   // Write side eof offset. This represents only the final FIN offset.
   folly::Optional<uint64_t> finalWriteOffset;
 
@@ -163,23 +457,23 @@ struct QuicStreamState : public QuicStreamLike {
   // Stream level write error occured.
   folly::Optional<QuicErrorCode> streamWriteError;
 
-  // State machine data
-  struct Send {
-    StreamSendStateData state{StreamSendStates::Open()};
-  } send;
-  struct Recv {
-    StreamReceiveStateData state{StreamReceiveStates::Open()};
-  } recv;
-
   // The packet number of the latest packet that contains a MaxStreamDataFrame
   // sent out by us.
   folly::Optional<PacketNum> latestMaxStreamDataPacket;
 
-  // Tells whether this stream is a control stream.
-  // It is set by the app via setControlStream and the transport can use this
-  // knowledge for optimizations e.g. for setting the app limited state on
-  // congestion control with control streams still active.
-  bool isControl{false};
+  // Delivery deadline of the data written to the stream, set by the app with
+  // setStreamDeliveryDeadline. Data that is not delivered within it is
+  // expired with partial reliability instead of being retransmitted.
+  folly::Optional<std::chrono::microseconds> deliveryDeadline;
+
+  // The end offset and the deadline of every write made while
+  // deliveryDeadline was set, in write order.
+  std::deque<std::pair<uint64_t, TimePoint>> writeDeadlines;
+
+  // The writes not delivered yet, in write order, with trackStreamByteEvents.
+  // The first numSentByteEvents of them were sent at least partly.
+  std::deque<StreamByteEvent> byteEvents;
+  size_t numSentByteEvents{0};
 
   // The last time we detected we were head of line blocked on the stream.
   folly::Optional<Clock::time_point> lastHolbTime;
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace quic {
+
+/**
+ * A freelist of the memory of closed streams, so opening a stream reuses the
+ * memory of a closed one instead of allocating a new node. It keeps up to
+ * capacity free blocks of blockSize bytes, the rest goes back to the heap,
+ * or to the shared pool if there is one.
+ */
+class StreamStatePool {
+ public:
+  explicit StreamStatePool(size_t blockSize, size_t capacity = 0)
+      : blockSize_(blockSize), capacity_(capacity) {}
+
+  ~StreamStatePool() {
+    setCapacity(0);
+  }
+
+  StreamStatePool(const StreamStatePool&) = delete;
+  StreamStatePool& operator=(const StreamStatePool&) = delete;
+
+  void* allocate() {
+    if (freeBlocks_.empty()) {
+      if (sharedPool_) {
+        return sharedPool_->allocate();
+      }
+      ++numAllocated_;
+      return ::operator new(blockSize_);
+    }
+    ++numReused_;
+    auto block = freeBlocks_.back();
+    freeBlocks_.pop_back();
+    return block;
+  }
+
+  void deallocate(void* block) {
+    if (freeBlocks_.size() < capacity_) {
+      freeBlocks_.push_back(block);
+    } else if (sharedPool_) {
+      sharedPool_->deallocate(block);
+    } else {
+      ::operator delete(block);
+    }
+  }
+
+  /**
+   * Takes the blocks from the shared pool once this one has none free, and
+   * gives it the ones past the capacity, so that the memory outlives the
+   * owner of this pool: the server worker shares one with the streams of all
+   * its connections. Both pools must have the same block size and be used on
+   * the same thread.
+   */
+  void setSharedPool(std::shared_ptr<StreamStatePool> sharedPool) {
+    CHECK(!sharedPool || sharedPool->blockSize_ == blockSize_);
+    sharedPool_ = std::move(sharedPool);
+  }
+
+  /**
+   * Frees the blocks past the new capacity.
+   */
+  void setCapacity(size_t capacity) {
+    capacity_ = capacity;
+    while (freeBlocks_.size() > capacity_) {
+      if (sharedPool_) {
+        sharedPool_->deallocate(freeBlocks_.back());
+      } else {
+        ::operator delete(freeBlocks_.back());
+      }
+      freeBlocks_.pop_back();
+    }
+  }
+
+  size_t numFree() const {
+    return freeBlocks_.size();
+  }
+
+  size_t numAllocated() const {
+    return numAllocated_;
+  }
+
+  size_t numReused() const {
+    return numReused_;
+  }
+
+ private:
+  size_t blockSize_;
+  size_t capacity_;
+  std::vector<void*> freeBlocks_;
+  std::shared_ptr<StreamStatePool> sharedPool_;
+  size_t numAllocated_{0};
+  size_t numReused_{0};
+};
+
+/**
+ * Allocator for a node based container of streams: the nodes of PooledType
+ * come from the StreamStatePool, everything else, like the container's own
+ * arrays, from std::allocator.
+ */
+template <class T, class PooledType>
+class StreamStateAllocator {
+ public:
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = StreamStateAllocator<U, PooledType>;
+  };
+
+  explicit StreamStateAllocator(std::shared_ptr<StreamStatePool> pool)
+      : pool_(std::move(pool)) {}
+
+  template <class U>
+  /* implicit */ StreamStateAllocator(
+      const StreamStateAllocator<U, PooledType>& other)
+      : pool_(other.pool()) {}
+
+  T* allocate(size_t n) {
+    return allocate(n, std::is_same<T, PooledType>());
+  }
+
+  void deallocate(T* p, size_t n) {
+    deallocate(p, n, std::is_same<T, PooledType>());
+  }
+
+  const std::shared_ptr<StreamStatePool>& pool() const {
+    return pool_;
+  }
+
+  template <class U>
+  bool operator==(const StreamStateAllocator<U, PooledType>& other) const {
+    return pool_ == other.pool();
+  }
+
+  template <class U>
+  bool operator!=(const StreamStateAllocator<U, PooledType>& other) const {
+    return pool_ != other.pool();
+  }
+
+ private:
+  T* allocate(size_t n, std::true_type) {
+    if (n == 1) {
+      return static_cast<T*>(pool_->allocate());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  T* allocate(size_t n, std::false_type) {
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n, std::true_type) {
+    if (n == 1) {
+      pool_->deallocate(p);
+      return;
+    }
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  void deallocate(T* p, size_t n, std::false_type) {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  std::shared_ptr<StreamStatePool> pool_;
+};
+} // namespace quic
@@ -10,9 +10,67 @@
 
 #include <quic/QuicConstants.h>
 #include <chrono>
+#include <limits>
 
 namespace quic {
 
+/**
+ * Tuning knobs of the congestion controllers made by
+ * DefaultCongestionControllerFactory. It is part of the TransportSettings so
+ * that the server's TransportSettingsOverrideFn can pick a different profile
+ * for each connection, e.g. based on the client address. Knobs that are not
+ * set keep the controller's default. Each controller only reads its own knobs.
+ */
+struct CongestionControlProfile {
+  // Cubic: the factor cwnd is multiplied by on loss.
+  folly::Optional<double> cubicReductionFactor;
+  // Cubic: see Cubic::CubicBuilder.
+  bool cubicTcpFriendly{true};
+  bool cubicAckTrain{false};
+  bool cubicHystartPlusPlus{false};
+  // NewReno and Cubic: send with Proportional Rate Reduction after a loss,
+  // see ProportionalRateReduction.
+  bool proportionalRateReduction{false};
+  // NewReno and Cubic: don't grow cwnd while it isn't used, see
+  // CwndValidator.
+  bool cwndValidation{false};
+  // BBR: the cwnd and pacing gain during Startup.
+  folly::Optional<float> bbrStartupGain;
+  // BBR: see BbrCongestionController::BbrConfig.
+  bool bbrConservativeRecovery{false};
+  bool bbrLargeProbeRttCwnd{false};
+  bool bbrEnableAckAggregationInStartup{false};
+  bool bbrProbeRttDisabledIfAppLimited{false};
+  bool bbrDrainToTarget{false};
+  // Copa: see Copa::CopaConfig.
+  bool copaModeSwitching{false};
+};
+
+/**
+ * Server only. Thresholds on the load of a worker, measured as the lag of its
+ * event loop and as the number of packets other workers routed to it that
+ * are waiting in its handoff queues. A level is entered as soon as either
+ * measure crosses its threshold, and left once neither does anymore for a
+ * sample interval. Each level includes the ones before it:
+ * - retry: Initials without a valid token are answered with a Retry.
+ * - reject: new connections are refused with a stateless close.
+ * - dropHandshakes: all the long header packets are dropped, which leaves
+ *   the established connections the whole worker.
+ * The thresholds that aren't set are never crossed.
+ */
+struct LoadSheddingSettings {
+  struct Threshold {
+    std::chrono::microseconds loopLag{std::chrono::microseconds::max()};
+    uint64_t pendingPackets{std::numeric_limits<uint64_t>::max()};
+  };
+
+  // How often the lag of the event loop is sampled.
+  std::chrono::milliseconds sampleInterval{kDefaultLoadSheddingSampleInterval};
+  Threshold retry;
+  Threshold reject;
+  Threshold dropHandshakes;
+};
+
 struct TransportSettings {
   // The initial connection window advertised to the peer.
   uint64_t advertisedInitialConnectionWindowSize{kDefaultConnectionWindowSize};
@@ -24,27 +82,139 @@ struct TransportSettings {
   uint64_t advertisedInitialMaxStreamsBidi{
       std::numeric_limits<uint32_t>::max()};
   uint64_t advertisedInitialMaxStreamsUni{std::numeric_limits<uint32_t>::max()};
+  // Whether the stream limits granted to the peer grow past the advertised
+  // initial limits with the rate at which the peer closes its streams, so
+  // that it always has about a RTT worth of streams to open. The limits
+  // don't grow past maxAutoScaledStreamLimit.
+  bool autoScaleStreamLimits{false};
+  uint64_t maxAutoScaledStreamLimit{kDefaultMaxAutoScaledStreamLimit};
   // Maximum number of packets to buffer while cipher is unavailable.
   uint32_t maxPacketsToBuffer{kDefaultMaxBufferedPackets};
+  // Drop the packets whose packet number was already received, among the
+  // last kReceivedPacketWindowSize ones, before processing their frames.
+  bool dropDuplicatePackets{false};
   // Idle timeout to advertise to the peer.
   std::chrono::milliseconds idleTimeout{kDefaultIdleTimeout};
   // Ack delay exponent to use.
   uint64_t ackDelayExponent{kDefaultAckDelayExponent};
+  // Max number of ack blocks to write in an ack frame. The most recent blocks
+  // are written first, so older gaps stop being reported past this number.
+  uint64_t maxAckBlocks{kDefaultMaxAckBlocks};
   // Default congestion controller type.
   CongestionControlType defaultCongestionController{
       CongestionControlType::Cubic};
   // Param to determine sensitivity of CongestionController to latency. Only
   // used by COPA.
   folly::Optional<double> latencyFactor;
+  // Whether the server puts the rtt and bandwidth estimates of the connection
+  // in its session tickets, and starts the connections that resume with 0-RTT
+  // from them: a cwnd derived from the previous bandwidth delay product, and
+  // a pacing rate derived from the previous rtt. The ticket is encrypted with
+  // the rest of the resumption state.
+  bool congestionStateInTicket{false};
+  // Server only. Whether the app tokens of the tickets are written in the
+  // compact layout, which is validated without decoding a list of transport
+  // parameters. Tokens in either layout are accepted regardless, so it can
+  // be turned on and off without losing the tickets already issued.
+  bool compactAppTokens{false};
+  // Parameters of the congestion controller made by the default factory.
+  // initCwndInMss and latencyFactor above apply on top of it.
+  CongestionControlProfile ccProfile;
   // The max UDP packet size we are willing to receive.
   uint64_t maxRecvPacketSize{kDefaultUDPReadBufferSize};
+  // Maximum number of datagrams the server worker, or the client, reads from
+  // its socket per read event, using recvmmsg where available. A value of 1
+  // keeps reading one datagram per callback.
+  uint32_t maxRecvBatchSize{kDefaultQuicMaxRecvBatchSize};
+  // Whether to enable UDP_GRO on the receive side. The kernel then delivers
+  // coalesced datagrams which are split into packets without copying.
+  // Ignored if the socket does not support it.
+  bool groEnabled{false};
+  // Whether the server worker hands the short header packets it routes to
+  // the same connection one after the other to it together, so that they
+  // share one round of ack and write processing and are decrypted through a
+  // single Aead::tryDecryptBatch().
+  bool batchReceivedPackets{false};
+  // Whether to mark the packets sent as ECN capable (ECT(0)), and to read and
+  // echo the ECN codepoints of the packets received. The congestion
+  // controllers react to the CE marks the peer echoes back. Ignored if the
+  // socket does not support it.
+  bool ecnEnabled{false};
+  // Server only. Whether the packets read carry the time the kernel received
+  // them, SO_TIMESTAMPNS, instead of the time the worker read them, so that
+  // the time spent waiting for a busy event loop isn't part of the RTT
+  // samples and ack delays. Ignored if the socket does not support it.
+  bool kernelReceiveTimestamps{false};
+  // Maximum number of released receive buffers kept around per EventBase for
+  // reuse. 0 disables pooling of receive buffers.
+  uint32_t recvBufferPoolSize{0};
+  // Bytes of the region of memory the receive buffer pool of the server
+  // worker carves its buffers out of before the heap, backed by 2MB huge
+  // pages when the system has them, see BufferPool. Only with
+  // recvBufferPoolSize. 0 takes every buffer from the heap.
+  uint64_t recvBufferPoolRegionSize{0};
+  // Number of connections a server worker is expected to hold at once. Its
+  // connection id map is sized for them up front, so that it doesn't rehash
+  // while the connections ramp up. 0 lets the map grow on demand.
+  uint32_t expectedConnectionsPerWorker{0};
+  // Number of client connection ids whose Initial keys a server worker caches,
+  // so that the Initials of the same client connection id don't derive them
+  // again. 0 disables the cache.
+  uint32_t initialCipherCacheSize{0};
+  // Number of distinct Certificate messages a server worker keeps one copy
+  // of, so that the crypto streams of its handshakes share the certificate
+  // chain instead of each holding a copy until the flight is acked. 0
+  // disables the cache.
+  uint32_t certificateMessageCacheSize{0};
+  // Whether the client offers, and the server negotiates, the compression of
+  // the Certificate message, so that larger certificate chains fit in the
+  // server's first flight. See getCertificateCompressionAlgorithms() for
+  // what the server's certificates then need.
+  bool certificateCompression{false};
+  // Number of connection ids, with their stateless reset tokens, that a
+  // server worker encodes ahead of time for its connections. 0 disables the
+  // pool and the ids are encoded when a connection needs them.
+  uint32_t connectionIdPoolSize{0};
+  // Keep the 1-rtt secrets of server connections around, so that they can be
+  // handed over to the process taking over the server instead of being
+  // forwarded to this one.
+  bool allowConnectionTakeover{false};
+  // Server connections that stay quiescent for this long drop their TLS
+  // state and their read codec, and rebuild them from the 1-rtt secrets when
+  // a packet arrives or something has to be written. The secrets are kept
+  // like with allowConnectionTakeover. 0 disables hibernation.
+  std::chrono::milliseconds hibernationTimeout{0ms};
+  // Run the timeouts of a connection off a single registration on the timer
+  // wheel, which is only moved when a deadline comes before it. Saves the
+  // wheel work of rescheduling the idle timeout on nearly every packet.
+  bool coalesceTimers{false};
+  // Update the 1-rtt keys when the peer does. Ignored by the servers that
+  // allow connection takeover or hibernation, since both rebuild the keys
+  // from the secrets of the first key phase.
+  bool keyUpdateEnabled{false};
+  // With keyUpdateEnabled, start a key update once this many 1-rtt packets
+  // were sent in the current key phase. 0 never starts one.
+  uint64_t keyUpdatePacketInterval{0};
   // Can we ignore the path mtu when sending a packet. This is useful for
   // testing.
   bool canIgnorePathMTU{false};
-  // Whether or not to use a connected UDP socket on the client. This should
-  // only be used in environments where you know your IP address does not
-  // change. See AsyncUDPSocket::connect for the caveats.
-  bool connectUDP{false};
+  // Once the handshake is done, search for the largest packets the path
+  // carries with PING probes padded to the size being tried (DPLPMTUD, RFC
+  // 8899), up to maxPmtuProbeSize and the max_packet_size of the peer, and
+  // raise udpSendPacketLen as they are acked. The socket must not fragment.
+  bool pmtuDiscoveryEnabled{false};
+  uint64_t maxPmtuProbeSize{kDefaultMaxPmtuProbeSize};
+  // Until the handshake is done, pack the packets of the different
+  // encryption levels written in one write loop into shared datagrams, see
+  // ScopedCoalescedWrite. The room the client Initial would be padded with is
+  // used by the packets that follow it instead.
+  bool coalescePackets{false};
+  // Whether or not to use a connected UDP socket on the client, which saves
+  // the route lookup on every send and has the kernel drop datagrams from
+  // other addresses. The client falls back to an unconnected socket if the
+  // connect fails. Turn it off where the local IP address can change, see
+  // AsyncUDPSocket::connect for the caveats.
+  bool connectUDP{true};
   // Maximum number of consecutive PTOs before the connection is torn down.
   uint16_t maxNumPTOs{kDefaultMaxNumPTO};
   // Whether to turn off PMTUD on the socket
@@ -58,6 +228,37 @@ struct TransportSettings {
   // Pacing timer tick interval
   std::chrono::microseconds pacingTimerTickInterval{
       kDefaultPacingTimerTickInterval};
+  // When pacing, tag every packet with an SO_TXTIME departure time and let the
+  // fq qdisc space out the bursts, instead of waking up on the pacing timer
+  // for each one. Falls back to timer pacing if the socket doesn't support
+  // SO_TXTIME.
+  bool txTimePacing{false};
+  // Whether the paced writes of all the transports of a server worker are
+  // scheduled together, so that the ones due in the same tick of the pacing
+  // timer run back to back on a single wakeup.
+  bool pacingSchedulerEnabled{false};
+  // When the connection stops being app limited, the pacer starts again from
+  // one burst instead of sending the tokens it gathered in the meantime.
+  bool pacingRestartAfterIdle{false};
+  // When a batch of datagrams is read at once, the pacing rate is recomputed
+  // once after the whole batch rather than after every ack in it.
+  bool batchPacingRefresh{false};
+  // The packets written by one write loop are all stamped with the time the
+  // loop started, instead of reading the clock for every packet. The sent
+  // times still feed the RTT samples, they can be late by the time it takes
+  // to build the packets of a loop.
+  bool cachedWriteLoopTime{false};
+  // Server only. Whether the write loops of all the transports of a worker
+  // run from a single write scheduler, which spends at most
+  // writeSchedulerTimeBudget on them per event loop iteration.
+  bool writeSchedulerEnabled{false};
+  std::chrono::microseconds writeSchedulerTimeBudget{
+      kDefaultWriteSchedulerTimeBudget};
+  // The most packets the write scheduler writes per event loop iteration, 0
+  // for no limit, shared among the transports with deficit round robin in
+  // quanta of writeSchedulerPacketQuantum.
+  uint64_t writeSchedulerPacketBudget{0};
+  uint64_t writeSchedulerPacketQuantum{kDefaultWriteConnectionDataPacketLimit};
   ZeroRttSourceTokenMatchingPolicy zeroRttSourceTokenMatchingPolicy{
       ZeroRttSourceTokenMatchingPolicy::LIMIT_IF_NO_EXACT_MATCH};
   bool attemptEarlyData{true};
@@ -71,11 +272,56 @@ struct TransportSettings {
   // Frequency of sending flow control updates. We can send one update every
   // flowControlWindowFrequency * window if the flow control changes.
   uint16_t flowControlWindowFrequency{2};
+  // Whether the stream and connection windows grow on their own. A window is
+  // doubled when the reader consumed enough of it to trigger an update less
+  // than flowControlRttFrequency * RTT after the previous update, up to
+  // totalBufferSpaceAvailable.
+  bool flowControlWindowAutoTuning{false};
+  // Whether to detect losses RACK style: the time threshold is the latest rtt
+  // plus a reordering window that grows with spurious losses, and the packet
+  // threshold is dropped once reordering has been seen. The congestion
+  // controller is told about spurious losses so it can undo its reaction.
+  bool rackLossDetection{false};
   // batching mode
   QuicBatchingMode batchingMode{QuicBatchingMode::BATCHING_MODE_NONE};
   // maximum number of packets we can batch. This does not apply to
   // BATCHING_MODE_NONE
   uint32_t maxBatchSize{kDefaultQuicMaxBatchSize};
+  // Size the batch of every write loop from the packets the loop can write,
+  // the pacer burst or writeConnectionDataPacketsLimit, bounded by the cwnd
+  // headroom and kMaxGSOSegments, instead of using maxBatchSize. A paced
+  // connection then sends a single GSO message per pacing tick.
+  bool adaptiveBatchSize{false};
+  // Measure the CPU cycles spent on every connection, broken down by
+  // QuicTransportStatsCallback::CpuCostType, on one out of every
+  // cpuCostSamplingRate calls of each type. 0 disables the accounting.
+  uint32_t cpuCostSamplingRate{0};
+  // Measure what every write loop writes, how it batches the packets for the
+  // socket and why it stops, see WriteLoopMetrics. The loops are summed up
+  // in the transport info, and reported to the LoopDetectorCallback and the
+  // QuicTransportStatsCallback.
+  bool writeLoopStats{false};
+  // Reports a CongestionControlSample of the connection to the stats
+  // callback at most once per interval, as the acks come, so that the
+  // congestion controllers can be followed in production without qlog. An
+  // idle connection isn't sampled. 0 disables the samples.
+  std::chrono::milliseconds congestionSampleInterval{0ms};
+  // Remember when every write of the app to a stream is first sent, last sent
+  // and delivered, and report the STREAM_* latencies of
+  // QuicTransportStatsCallback::LatencyType for it.
+  bool trackStreamByteEvents{false};
+  // Server only. Maximum number of packets, across all the connections of a
+  // worker, coalesced into a single write at the end of an EventBase loop.
+  // 0 disables coalescing, in which case every connection writes on its own.
+  uint32_t maxCoalescedWriteBatchSize{0};
+  // Server only. The most time a worker spends closing its connections per
+  // event loop iteration when it shuts down, 0 to close them all at once.
+  // The transports closed in an iteration are destroyed in the next one.
+  std::chrono::microseconds shutdownTimeBudget{0};
+  // Build every packet into a single buffer from a per connection arena,
+  // copying the stream data, so that the encrypted packet is contiguous
+  // rather than a chain of header, frames and stream data buffers.
+  bool usePacketArena{false};
   // Sets network unreachable to be a non fatal error. In some environments,
   // EHOSTUNREACH or ENETUNREACH could just be because the routing table is
   // being setup. This option makes those non fatal connection errors.
@@ -88,6 +334,11 @@ struct TransportSettings {
   // should be invisible to end users.
   // Choosing 150ms because loss timer fires at the 100ms for the first time.
   std::chrono::milliseconds continueOnNetworkUnreachableDuration{150};
+  // When the send buffer of the socket is full, keep the packets that could
+  // not be written and write them once the socket is writable, instead of
+  // leaving them to loss recovery. The write loop waits until then. ENOBUFS
+  // still drops them, the socket doesn't tell when the qdisc has room again.
+  bool sendBlockedBackpressure{false};
   // Initial congestion window in MSS
   uint64_t initCwndInMss{kInitCwndInMss};
   // Minimum congestion window in MSS
@@ -96,20 +347,135 @@ struct TransportSettings {
   uint64_t maxCwndInMss{kDefaultMaxCwndInMss};
   // Limited congestion window in MSS
   uint64_t limitedCwndInMss{kLimitedCwndInMss};
+  // Whether a server lifts the limit on the bytes it sends to an unvalidated
+  // client address as soon as it reads a Handshake packet from the client,
+  // which proves the client got the server's Initial, instead of waiting for
+  // the client's Finished.
+  bool validateAddressOnHandshakePacket{false};
+  // Whether a server answers the path probes a client sends from other
+  // addresses than the current peer address, validates those paths ahead of
+  // time and keeps a congestion controller and rtt stats for each of them.
+  // A migration to such a standby path then needs neither a path challenge
+  // nor the limited cwnd above.
+  bool enableStandbyPaths{false};
+  // Whether a server also sends on the validated standby paths, each gated
+  // by its own congestion controller, instead of only using them to migrate.
+  // Needs enableStandbyPaths, and a client that reads from all its paths.
+  bool multipathEnabled{false};
+  PathSchedulerType pathScheduler{PathSchedulerType::MinRtt};
+  // Weight of the current peer address under PathSchedulerType::Weighted
+  uint64_t primaryPathWeight{1};
   // Limits the amount of data that should be buffered in a QuicSocket.
   // If the amount of data in the buffer equals or exceeds this amount, then
   // the callback registered through notifyPendingWriteOnConnection() will
   // not be called
   uint64_t totalBufferSpaceAvailable{kDefaultBufferSpaceAvailable};
+  // Writes to a stream of at most this many bytes are copied into the
+  // tailroom of the last buffer of the stream's write buffer, so that many
+  // small writes don't make a long chain that is cloned into every packet.
+  // 0 disables the copies.
+  uint64_t writeCoalescingThreshold{0};
+  // When the frame of the next stream to schedule doesn't fit in what is
+  // left of a packet, try the other writable streams, in priority order, for
+  // one that does before closing the packet.
+  bool fillPacketsWithStreams{false};
+  // Number of closed streams whose memory is kept to open the new streams
+  // of the connection in, instead of allocating. 0 disables the reuse.
+  uint32_t streamStatePoolSize{0};
+  // Number of closed streams whose memory the server worker keeps for the
+  // streams of all its connections, once their own pools are full. Unlike
+  // the pool of a connection it outlives the connection, so that the short
+  // lived ones open their streams in the memory of the closed ones. 0
+  // disables it.
+  uint32_t workerStreamStatePoolSize{0};
   // Whether or not to advertise partial reliability capability
   bool partialReliabilityEnabled{false};
+  // Whether or not to advertise the ack frequency extension with
+  // minAckDelay. When both ends advertise it, the peer is asked with
+  // ACK_FREQUENCY frames for kAckFrequencyAcksPerCwnd acks per cwnd, and no
+  // more than kAckFrequencyAcksPerRtt per rtt.
+  bool ackFrequencyEnabled{false};
+  std::chrono::microseconds minAckDelay{kDefaultMinAckDelay};
+  // Whether the ACK_FREQUENCY frames sent ask the peer not to ack out of
+  // order packets immediately.
+  bool ackFrequencyIgnoreOrder{false};
+  // Adapts the acks sent to the path: the ack timer is the smaller of srtt / 4
+  // and maxAckDelay, which is advertised as max_ack_delay, CE marked packets
+  // are acked right away, and the packets received before an ack grow while
+  // packets keep arriving in order, up to kMaxRxPacketsPendingBeforeAckThresh.
+  bool adaptiveAcks{false};
+  std::chrono::milliseconds maxAckDelay{kDefaultMaxAckDelay};
+  // The largest DATAGRAM frame to accept, advertised to the peer. Datagrams
+  // can only be written to a peer that advertised it too. 0 disables them.
+  uint16_t maxDatagramFrameSize{0};
+  // Number of datagrams kept for the app to read, and waiting to be written.
+  size_t datagramReadBufferSize{kDefaultMaxDatagramsBuffered};
+  size_t datagramWriteBufferSize{kDefaultMaxDatagramsBuffered};
   // Whether the endpoint allows peer to migrate to new address
   bool disableMigration{true};
   // Whether or not the socket should gracefully drain on close
   bool shouldDrain{true};
+  // Whether the server frees the transport of a connection that closed with
+  // 1-rtt keys as soon as it starts draining, its worker answers the packets
+  // of the connection with the last close packet until the drain period is
+  // over.
+  bool compactDrainingConnections{false};
   // default stateless reset secret for stateless reset token
   folly::Optional<std::array<uint8_t, kStatelessResetTokenSecretLength>>
       statelessResetTokenSecret;
+  // Derive the stateless reset tokens with a CBC-MAC under an AES key derived
+  // once from the secret, rather than with a HKDF per token. Changes the
+  // tokens, so it has to be the same on all the servers sharing the secret.
+  bool statelessResetAesTokens{false};
+  // Server only. Largest number of stateless resets a worker sends per second,
+  // the resets above it are not sent. 0 doesn't limit them.
+  uint32_t maxStatelessResetsPerSecond{0};
+  // Server only. Same for the version negotiation packets, the packets that
+  // would be answered with one above it are dropped.
+  uint32_t maxVersionNegotiationsPerSecond{0};
+  // Server only. Largest number of new connections a worker accepts per
+  // second from a client address prefix, with a burst of one second worth.
+  // The Initials above it are dropped before a transport is made for them.
+  // 0 doesn't limit them.
+  uint32_t maxNewConnectionsPerSourcePerSecond{0};
+  // The length of the prefixes of the client addresses sharing a limit.
+  uint8_t sourceRateLimitIpv4PrefixLength{32};
+  uint8_t sourceRateLimitIpv6PrefixLength{64};
+  // Server only. Once a worker has this many handshakes pending, it answers
+  // Initials that carry no valid token with a stateless Retry instead of
+  // creating a connection. 0 always sends a Retry, none never does.
+  folly::Optional<uint64_t> retryPendingHandshakesThreshold;
+  // How long the token of a Retry stays valid.
+  std::chrono::seconds retryTokenLifetime{kDefaultRetryTokenLifetime};
+  // Secret the Retry tokens are generated with. Servers with the same secret
+  // accept each other's tokens.
+  folly::Optional<std::array<uint8_t, kRetryTokenSecretLength>>
+      retryTokenSecret;
+  // Server only. Send the client a NEW_TOKEN frame once the handshake is done.
+  // A client that comes back from the same ip with the token before it
+  // expires gets no Retry, and its 0-rtt data isn't limited while its address
+  // is validated. Needs a retryTokenSecret.
+  bool issueNewTokens{false};
+  // How long the token of a NEW_TOKEN frame stays valid.
+  std::chrono::seconds newTokenLifetime{kDefaultNewTokenLifetime};
+  // Server only. Lets the workers shed load on their own, none disables it.
+  // Needs a retryTokenSecret.
+  folly::Optional<LoadSheddingSettings> loadShedding;
+  // Server only. Bytes of stream data all the connections of a worker can
+  // buffer, counting the unsent data of the write buffers and the received
+  // data the application hasn't read. Close to it, the connections advertise
+  // smaller receive windows and report no buffer space to the application.
+  // 0 disables the budget.
+  uint64_t workerBufferMemoryBudget{0};
+  // Gives back the memory of the send buffers of a stream once an ack drains
+  // them, instead of keeping it until the stream closes. With a
+  // workerBufferMemoryBudget, the worker also compacts the buffers of its
+  // connections while under pressure.
+  bool reclaimStreamBufferMemory{false};
+  // Tells the ConnectionCallback of the streams the peer opened with one
+  // onNewStreams call per read instead of a call per stream. The state of the
+  // streams a frame opens at once is created at once as well.
+  bool batchNewPeerStreamCallbacks{false};
 };
 
 } // namespace quic
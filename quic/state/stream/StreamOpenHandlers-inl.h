@@ -85,10 +85,9 @@ inline void Handler<
         StreamEvents::AckStreamFrame&& ack,
         QuicStreamState& stream) {
   // Clean up the acked buffers from the retransmissionBuffer.
+  auto offsetToDeliverBefore = getStreamNextOffsetToDeliver(stream);
 
-  auto ackedBuffer = std::lower_bound(
-      stream.retransmissionBuffer.begin(),
-      stream.retransmissionBuffer.end(),
+  auto ackedBuffer = stream.retransmissionBuffer.lowerBound(
       ack.ackedFrame.offset,
       [](const auto& buffer, const auto& offset) {
         return buffer.offset < offset;
@@ -102,6 +101,11 @@ inline void Handler<
                << " len=" << ackedBuffer->data.chainLength()
                << " eof=" << ackedBuffer->eof << " " << stream.conn;
       stream.retransmissionBuffer.erase(ackedBuffer);
+      if (stream.conn.transportSettings.reclaimStreamBufferMemory &&
+          stream.retransmissionBuffer.empty() && stream.lossBuffer.empty() &&
+          stream.writeBuffer.empty()) {
+        reclaimStreamBufferMemory(stream, false);
+      }
     } else {
       VLOG(10) << "Open: received an ack for already discarded buffer; stream="
                << stream.id << " offset=" << ackedBuffer->offset
@@ -110,8 +114,13 @@ inline void Handler<
     }
   }
 
-  // This stream may be able to invoke some deliveryCallbacks:
-  stream.conn.streamManager->addDeliverable(stream.id);
+  // This stream may be able to invoke some deliveryCallbacks, but only if the
+  // ack moved the delivered offset. Acks filling a hole later in the stream
+  // don't make any callback deliverable.
+  if (getStreamNextOffsetToDeliver(stream) > offsetToDeliverBefore) {
+    stream.conn.streamManager->addDeliverable(stream.id);
+    onStreamBytesDelivered(stream);
+  }
 
   // Check for whether or not we have ACKed all bytes until our FIN.
   if (allBytesTillFinAcked(stream)) {
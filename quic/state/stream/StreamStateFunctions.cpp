@@ -18,6 +18,8 @@ void resetQuicStream(QuicStreamState& stream, ApplicationErrorCode error) {
   stream.writeBuffer.clear();
   stream.readBuffer.clear();
   stream.lossBuffer.clear();
+  stream.byteEvents.clear();
+  stream.numSentByteEvents = 0;
   stream.streamWriteError = error;
   stream.conn.streamManager->updateReadableStreams(stream);
   stream.conn.streamManager->updateWritableStreams(stream);
@@ -70,9 +72,9 @@ bool isAllDataReceived(const QuicStreamState& stream) {
     receivedDataTillFin = true;
   } else if (
       stream.finalReadOffset && stream.readBuffer.size() == 1 &&
-      stream.currentReadOffset == stream.readBuffer.at(0).offset &&
-      (stream.readBuffer.at(0).offset +
-           stream.readBuffer.at(0).data.chainLength() ==
+      stream.currentReadOffset == stream.readBuffer.front().offset &&
+      (stream.readBuffer.front().offset +
+           stream.readBuffer.front().data.chainLength() ==
        stream.finalReadOffset)) {
     receivedDataTillFin = true;
   }
@@ -234,6 +234,50 @@ TEST_F(QuicOpenStateTest, RetxBufferSortedAfterAck) {
       stream->retransmissionBuffer.front().offset);
 }
 
+TEST_F(QuicOpenStateTest, AckMarksDeliverableOnlyWhenDeliveredOffsetMoves) {
+  auto conn = createConn();
+  auto stream = conn->streamManager->createNextBidirectionalStream().value();
+  EventBase evb;
+  folly::test::MockAsyncUDPSocket socket(&evb);
+  folly::Optional<ConnectionId> serverChosenConnId = *conn->clientConnectionId;
+  serverChosenConnId.value().data()[0] ^= 0x01;
+
+  auto buf1 = IOBuf::copyBuffer("Alice");
+  auto buf2 = IOBuf::copyBuffer("Bob");
+  writeQuicPacket(
+      *conn,
+      *conn->clientConnectionId,
+      *serverChosenConnId,
+      socket,
+      *stream,
+      *buf1,
+      false);
+  writeQuicPacket(
+      *conn,
+      *conn->clientConnectionId,
+      *serverChosenConnId,
+      socket,
+      *stream,
+      *buf2,
+      false);
+  ASSERT_EQ(2, conn->outstandingPackets.size());
+  auto streamFrame1 =
+      *conn->outstandingPackets[0].packet.frames.front().asWriteStreamFrame();
+  auto streamFrame2 =
+      *conn->outstandingPackets[1].packet.frames.front().asWriteStreamFrame();
+
+  // Acking the second frame leaves a hole before it.
+  StreamEvents::AckStreamFrame ack2(streamFrame2);
+  invokeHandler<StreamSendStateMachine>(stream->send, ack2, *stream);
+  EXPECT_EQ(1, stream->retransmissionBuffer.size());
+  EXPECT_FALSE(conn->streamManager->deliverableContains(stream->id));
+
+  StreamEvents::AckStreamFrame ack1(streamFrame1);
+  invokeHandler<StreamSendStateMachine>(stream->send, ack1, *stream);
+  EXPECT_TRUE(stream->retransmissionBuffer.empty());
+  EXPECT_TRUE(conn->streamManager->deliverableContains(stream->id));
+}
+
 TEST_F(QuicOpenStateTest, AckStreamAfterSkip) {
   auto conn = createConn();
   conn->partialReliabilityEnabled = true;
@@ -9,10 +9,12 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <quic/api/test/MockQuicStats.h>
 #include <quic/common/test/TestUtils.h>
 
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStateFunctions.h>
 #include <quic/state/StateData.h>
 #include <quic/state/test/Mocks.h>
 
@@ -577,6 +579,98 @@ TEST_P(AckHandlersTest, PureAckBytesSkipsCongestionControl) {
   EXPECT_TRUE(conn.outstandingPackets.empty());
 }
 
+TEST_P(AckHandlersTest, ECNCEMarksInAckEvent) {
+  QuicServerConnectionState conn;
+  auto mockController = std::make_unique<MockCongestionController>();
+  auto rawController = mockController.get();
+  conn.congestionController = std::move(mockController);
+  for (PacketNum packetNum = 10; packetNum <= 12; packetNum++) {
+    conn.outstandingPackets.emplace_back(OutstandingPacket(
+        createNewPacket(packetNum, GetParam()),
+        Clock::now(),
+        100,
+        false,
+        false,
+        100 * (packetNum - 9)));
+  }
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 11;
+  ackFrame.ackBlocks.emplace_back(10, 11);
+  ackFrame.ecnCounts = ECNCounts();
+  ackFrame.ecnCounts->ect0 = 1;
+  ackFrame.ecnCounts->ce = 1;
+  std::vector<PacketNum> lostPackets;
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ackEvent, auto) {
+        EXPECT_EQ(1, ackEvent->ecnCEMarks);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [&](const auto&, const auto&, const auto&) {},
+      testLossHandler(lostPackets),
+      Clock::now());
+
+  // Only the increase of the CE count is reported.
+  ackFrame.largestAcked = 12;
+  ackFrame.ackBlocks.clear();
+  ackFrame.ackBlocks.emplace_back(10, 12);
+  ackFrame.ecnCounts->ect0 = 2;
+  ackFrame.ecnCounts->ce = 1;
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ackEvent, auto) {
+        EXPECT_EQ(0, ackEvent->ecnCEMarks);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [&](const auto&, const auto&, const auto&) {},
+      testLossHandler(lostPackets),
+      Clock::now());
+  auto& ecnAcked = getAckState(conn, GetParam()).ecnCountsAckedByPeer;
+  EXPECT_EQ(2, ecnAcked.ect0);
+  EXPECT_EQ(1, ecnAcked.ce);
+}
+
+TEST_P(AckHandlersTest, SpuriousLossUndo) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.rackLossDetection = true;
+  auto mockController = std::make_unique<MockCongestionController>();
+  auto rawController = mockController.get();
+  conn.congestionController = std::move(mockController);
+  // Packet 5 was declared lost, packet 6 is outstanding.
+  conn.lossState.recentLostPackets.push_back(
+      LossState::LostPacket{5, GetParam(), Clock::now(), 100});
+  conn.outstandingPackets.emplace_back(OutstandingPacket(
+      createNewPacket(6, GetParam()), Clock::now(), 100, false, false, 100));
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 6;
+  ackFrame.ackBlocks.emplace_back(5, 6);
+  EXPECT_CALL(*rawController, onSpuriousLoss(_))
+      .WillOnce(Invoke([](const auto& spuriousLoss) {
+        EXPECT_EQ(5, *spuriousLoss.largestLostPacketNum);
+        EXPECT_EQ(100, spuriousLoss.lostBytes);
+        return true;
+      }));
+  EXPECT_CALL(*rawController, onPacketAckOrLoss(_, _)).Times(1);
+  std::vector<PacketNum> lostPackets;
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [&](const auto&, const auto&, const auto&) {},
+      testLossHandler(lostPackets),
+      Clock::now());
+  EXPECT_EQ(1, conn.lossState.spuriousLossCount);
+  EXPECT_EQ(1, conn.lossState.congestionUndoCount);
+  EXPECT_TRUE(conn.lossState.reorderingSeen);
+  EXPECT_TRUE(conn.lossState.recentLostPackets.empty());
+}
+
 TEST_P(AckHandlersTest, NoSkipAckVisitor) {
   QuicServerConnectionState conn;
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -782,6 +876,57 @@ TEST_P(AckHandlersTest, ClonedPacketsCounter) {
   EXPECT_EQ(0, conn.outstandingClonedPacketsCount);
 }
 
+TEST_P(AckHandlersTest, RetireClonesOnAck) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  WriteStreamFrame frame(0, 0, 0, true);
+  // Packet 2 is a clone of packet 0, packet 1 is unrelated.
+  for (PacketNum packetNum = 0; packetNum < 3; packetNum++) {
+    auto regularPacket = createNewPacket(packetNum, PacketNumberSpace::AppData);
+    regularPacket.frames.push_back(frame);
+    conn.outstandingPackets.push_back(OutstandingPacket(
+        std::move(regularPacket),
+        Clock::now(),
+        100 + packetNum,
+        false,
+        false,
+        1));
+  }
+  conn.outstandingPackets[0].associatedEvent = 0;
+  conn.outstandingPackets[2].associatedEvent = 0;
+  conn.outstandingClonedPacketsCount = 2;
+  conn.outstandingPacketEvents.insert(0);
+  conn.outstandingPacketEvents.addPacket(0, 0);
+  conn.outstandingPacketEvents.addPacket(0, 2);
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 0;
+  ackFrame.ackBlocks.emplace_back(0, 0);
+  uint16_t ackVisitorCounter = 0;
+  EXPECT_CALL(*rawCongestionController, onRemoveBytesFromInflight(102))
+      .Times(1);
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ackEvent, auto lossEvent) {
+        EXPECT_EQ(100, ackEvent->ackedBytes);
+        EXPECT_FALSE(lossEvent.hasValue());
+      }));
+  processAckFrame(
+      conn,
+      PacketNumberSpace::AppData,
+      ackFrame,
+      [&](const auto&, const auto&, const auto&) { ackVisitorCounter++; },
+      [&](auto&, auto&, bool, PacketNum) { /* lossVisitor */ },
+      Clock::now());
+  EXPECT_EQ(1, ackVisitorCounter);
+  EXPECT_EQ(0, conn.outstandingClonedPacketsCount);
+  ASSERT_EQ(1, conn.outstandingPackets.size());
+  EXPECT_EQ(1, conn.outstandingPackets.front().packetNum);
+  EXPECT_TRUE(conn.outstandingPacketEvents.empty());
+  EXPECT_EQ(0, conn.outstandingPacketEvents.numPackets(0));
+}
+
 TEST_P(AckHandlersTest, UpdateMaxAckDelay) {
   QuicServerConnectionState conn;
   conn.congestionController = nullptr;
@@ -977,6 +1122,135 @@ TEST_F(AckHandlersTest, PureAckDoesNotUpdateRtt) {
   EXPECT_TRUE(conn.outstandingPackets.empty());
 }
 
+TEST_F(AckHandlersTest, CongestionControlSampledOncePerInterval) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.congestionSampleInterval = 100ms;
+  NiceMock<MockQuicStats> stats;
+  conn.infoCallback = &stats;
+  auto mockCongestionController =
+      std::make_unique<NiceMock<MockCongestionController>>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  ON_CALL(*rawCongestionController, getCongestionWindow())
+      .WillByDefault(Return(12345));
+  ON_CALL(*rawCongestionController, type())
+      .WillByDefault(Return(CongestionControlType::Cubic));
+  conn.lossState.srtt = 30ms;
+
+  auto now = Clock::now();
+  for (PacketNum packetNum = 0; packetNum < 3; packetNum++) {
+    conn.outstandingPackets.push_back(OutstandingPacket(
+        createNewPacket(packetNum, PacketNumberSpace::AppData),
+        now - 50ms,
+        100,
+        false,
+        false,
+        100 * (packetNum + 1)));
+  }
+  std::vector<CongestionControlSample> samples;
+  EXPECT_CALL(stats, onCongestionControlSample(_))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](const auto& sample) {
+        samples.push_back(sample);
+      }));
+  std::vector<PacketNum> lostPackets;
+  // The second ack comes before the end of the interval of the first one.
+  PacketNum packetNum = 0;
+  for (auto ackTime : {now, now + 10ms, now + 100ms}) {
+    ReadAckFrame ackFrame;
+    ackFrame.largestAcked = packetNum;
+    ackFrame.ackBlocks.emplace_back(packetNum, packetNum);
+    processAckFrame(
+        conn,
+        PacketNumberSpace::AppData,
+        ackFrame,
+        [&](const auto&, const auto&, const auto&) {},
+        testLossHandler(lostPackets),
+        ackTime);
+    packetNum++;
+  }
+  ASSERT_EQ(2, samples.size());
+  EXPECT_EQ(now, samples[0].time);
+  EXPECT_EQ(now + 100ms, samples[1].time);
+  EXPECT_EQ(CongestionControlType::Cubic, samples[0].type);
+  EXPECT_EQ(12345, samples[0].congestionWindow);
+  EXPECT_EQ(0, samples[0].pacingRate);
+}
+
+TEST_F(AckHandlersTest, AckSecondaryPathPackets) {
+  QuicServerConnectionState conn;
+  conn.lossState.reorderingThreshold = 85;
+  conn.lossState.srtt = 10s;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  SecondaryPath path;
+  path.id = conn.nextPathId++;
+  auto pathCongestionController = std::make_unique<MockCongestionController>();
+  auto rawPathCongestionController = pathCongestionController.get();
+  path.congestionController = std::move(pathCongestionController);
+  conn.secondaryPaths.push_back(std::move(path));
+
+  // Odd packets on the primary path, even ones on the secondary path.
+  auto now = Clock::now();
+  for (PacketNum packetNum = 1; packetNum <= 6; packetNum++) {
+    auto sentTime = packetNum == 2 ? now - 1s : now - 100ms;
+    OutstandingPacket packet(
+        createNewPacket(packetNum, PacketNumberSpace::AppData),
+        sentTime,
+        1,
+        false,
+        false,
+        packetNum);
+    packet.pathId = packetNum % 2 ? kPrimaryPathId : 1;
+    conn.outstandingPackets.push_back(std::move(packet));
+  }
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 6;
+  ackFrame.ackBlocks.emplace_back(4, 6);
+
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto loss) {
+        ASSERT_TRUE(ack);
+        EXPECT_EQ(5, *ack->largestAckedPacket);
+        EXPECT_EQ(1, ack->ackedBytes);
+        EXPECT_FALSE(loss);
+      }));
+  // Packet 2 is lost from the rtt of its own path, packets 1 and 3 aren't
+  // even though later packets were acked.
+  std::vector<folly::Optional<CongestionController::AckEvent>> pathAcks;
+  std::vector<folly::Optional<CongestionController::LossEvent>> pathLosses;
+  EXPECT_CALL(*rawPathCongestionController, onPacketAckOrLoss(_, _))
+      .Times(2)
+      .WillRepeatedly(Invoke([&](auto ack, auto loss) {
+        pathAcks.push_back(std::move(ack));
+        pathLosses.push_back(std::move(loss));
+      }));
+  std::vector<PacketNum> lostPackets;
+  processAckFrame(
+      conn,
+      PacketNumberSpace::AppData,
+      ackFrame,
+      [&](const auto&, const auto&, const auto&) {},
+      testLossHandler(lostPackets),
+      now);
+
+  EXPECT_EQ(std::vector<PacketNum>{2}, lostPackets);
+  ASSERT_EQ(2, pathLosses.size());
+  ASSERT_TRUE(pathLosses[0]);
+  EXPECT_EQ(2, *pathLosses[0]->largestLostPacketNum);
+  ASSERT_TRUE(pathAcks[1]);
+  EXPECT_EQ(6, *pathAcks[1]->largestAckedPacket);
+  EXPECT_EQ(2, pathAcks[1]->ackedBytes);
+  EXPECT_EQ(10s, conn.lossState.srtt);
+  EXPECT_NE(0us, conn.secondaryPaths[0].srtt);
+  EXPECT_EQ(6, *conn.secondaryPaths[0].largestAckedPacket);
+  EXPECT_EQ(5, *conn.lossState.largestPrimaryPathAcked);
+  EXPECT_EQ(
+      6, getAckState(conn, PacketNumberSpace::AppData).largestAckedByPeer);
+  EXPECT_EQ(2, conn.outstandingPackets.size());
+}
+
 TEST_P(AckHandlersTest, AckEventCreation) {
   QuicServerConnectionState conn;
   auto mockCongestionController = std::make_unique<MockCongestionController>();
@@ -1032,6 +1306,99 @@ TEST_P(AckHandlersTest, AckEventCreation) {
       ackTime);
 }
 
+TEST_P(AckHandlersTest, AckRangesBetweenOutstandingPackets) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+  // Get the loss detection out of the way
+  conn.lossState.reorderingThreshold = 30;
+  conn.lossState.srtt = 10s;
+
+  // Outstanding packets 10, 12, ..., 28.
+  for (PacketNum packetNum = 10; packetNum < 30; packetNum += 2) {
+    auto regularPacket = createNewPacket(packetNum, GetParam());
+    WriteStreamFrame frame(packetNum, 0, 0, true);
+    regularPacket.frames.emplace_back(std::move(frame));
+    conn.outstandingPackets.emplace_back(OutstandingPacket(
+        std::move(regularPacket), Clock::now(), 10, false, false, packetNum));
+  }
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 40;
+  // Above all of them, then one that ends in a gap, one entirely in a gap
+  // and one that starts below all of them.
+  ackFrame.ackBlocks.emplace_back(35, 40);
+  ackFrame.ackBlocks.emplace_back(22, 27);
+  ackFrame.ackBlocks.emplace_back(17, 17);
+  ackFrame.ackBlocks.emplace_back(0, 12);
+
+  std::vector<PacketNum> ackedPackets;
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto) {
+        ASSERT_TRUE(ack.hasValue());
+        EXPECT_EQ(26, *ack->largestAckedPacket);
+        EXPECT_EQ(50, ack->ackedBytes);
+        EXPECT_EQ(5, ack->ackedPackets.size());
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [&](const auto& packet, const auto&, const ReadAckFrame&) {
+        ackedPackets.push_back(packet.packetNum);
+      },
+      [](auto&, auto&, bool, PacketNum) {},
+      Clock::now());
+  EXPECT_EQ(std::vector<PacketNum>({26, 24, 22, 12, 10}), ackedPackets);
+  EXPECT_EQ(50, conn.lossState.totalBytesAcked);
+  EXPECT_EQ(50, conn.lossState.totalBytesAckedAtLastAck);
+  EXPECT_EQ(5, conn.outstandingPackets.size());
+}
+
+TEST_P(AckHandlersTest, DeliveryRateSample) {
+  QuicServerConnectionState conn;
+  auto mockCongestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = mockCongestionController.get();
+  conn.congestionController = std::move(mockCongestionController);
+
+  auto lastAckedSentTime = Clock::now() - 100ms;
+  OutstandingPacket sentPacket(
+      createNewPacket(5, GetParam()),
+      lastAckedSentTime + 5ms,
+      1000,
+      false,
+      false,
+      6000);
+  sentPacket.lastAckedPacketInfo.emplace(
+      lastAckedSentTime, lastAckedSentTime + 10ms, 5000, 3000);
+  conn.lossState.totalBytesAcked = 3000;
+  conn.outstandingPackets.push_back(std::move(sentPacket));
+
+  ReadAckFrame ackFrame;
+  ackFrame.largestAcked = 5;
+  ackFrame.ackBlocks.emplace_back(5, 5);
+  // The ack interval, 40ms, is longer than the send interval.
+  auto ackTime = lastAckedSentTime + 50ms;
+  EXPECT_CALL(*rawCongestionController, onPacketAckOrLoss(_, _))
+      .WillOnce(Invoke([&](auto ack, auto) {
+        ASSERT_TRUE(ack->deliveryRateSample.hasValue());
+        EXPECT_EQ(1000, ack->deliveryRateSample->deliveredBytes);
+        EXPECT_EQ(40ms, ack->deliveryRateSample->interval);
+        EXPECT_FALSE(ack->deliveryRateSample->isAppLimited);
+      }));
+  processAckFrame(
+      conn,
+      GetParam(),
+      ackFrame,
+      [](const auto&, const auto&, const auto&) {},
+      [](auto&, auto&, bool, PacketNum) {},
+      ackTime);
+  EXPECT_EQ(25000, conn.lossState.deliveryRate);
+  ASSERT_TRUE(conn.lossState.latestDeliveryRateSample.hasValue());
+  EXPECT_EQ(25000, conn.lossState.latestDeliveryRateSample->rate());
+}
+
 INSTANTIATE_TEST_CASE_P(
     AckHandlersTests,
     AckHandlersTest,
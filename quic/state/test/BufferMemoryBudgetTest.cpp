@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/state/BufferMemoryBudget.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(BufferMemoryBudgetTest, Accounting) {
+  BufferMemoryBudget budget(1000, 0.5);
+  EXPECT_EQ(1000, budget.budget());
+  EXPECT_EQ(500, budget.available());
+
+  budget.update(0, 300);
+  budget.update(0, 100);
+  EXPECT_EQ(400, budget.bytesBuffered());
+  EXPECT_EQ(100, budget.available());
+  EXPECT_FALSE(budget.underPressure());
+  EXPECT_EQ(400, budget.adjustWindowSize(400));
+
+  budget.update(100, 250);
+  EXPECT_EQ(550, budget.bytesBuffered());
+  EXPECT_EQ(0, budget.available());
+  EXPECT_TRUE(budget.underPressure());
+  EXPECT_EQ(100, budget.adjustWindowSize(400));
+
+  budget.update(300, 0);
+  EXPECT_EQ(250, budget.bytesBuffered());
+  EXPECT_EQ(550, budget.highWaterMark());
+  EXPECT_FALSE(budget.underPressure());
+}
+} // namespace test
+} // namespace quic
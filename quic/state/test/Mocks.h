@@ -24,7 +24,7 @@ class MockCongestionController : public CongestionController {
       void(folly::Optional<AckEvent>, folly::Optional<LossEvent>));
   MOCK_CONST_METHOD0(getWritableBytes, uint64_t());
   MOCK_CONST_METHOD0(getCongestionWindow, uint64_t());
-  MOCK_METHOD0(onSpuriousLoss, void());
+  MOCK_METHOD1(onSpuriousLoss, bool(const LossEvent&));
   GMOCK_METHOD1_(, , , setConnectionEmulation, void(uint8_t));
   MOCK_CONST_METHOD0(type, CongestionControlType());
   GMOCK_METHOD2_(, , , setAppIdle, void(bool, TimePoint));
@@ -35,10 +35,13 @@ class MockCongestionController : public CongestionController {
 class MockPacer : public Pacer {
  public:
   MOCK_METHOD2(refreshPacingRate, void(uint64_t, std::chrono::microseconds));
+  MOCK_METHOD1(setRefreshDeferred, void(bool));
   MOCK_METHOD1(onPacedWriteScheduled, void(TimePoint));
   MOCK_CONST_METHOD0(getTimeUntilNextWrite, std::chrono::microseconds());
   MOCK_METHOD1(updateAndGetWriteBatchSize, uint64_t(TimePoint));
   MOCK_CONST_METHOD0(getCachedWriteBatchSize, uint64_t());
+  MOCK_METHOD1(getNextDepartureTime, TimePoint(TimePoint));
+  MOCK_METHOD1(setMaxPacingRate, void(uint64_t));
   MOCK_METHOD1(setAppLimited, void(bool));
   MOCK_METHOD0(onPacketSent, void());
   MOCK_METHOD0(onPacketsLoss, void());
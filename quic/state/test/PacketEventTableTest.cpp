@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <quic/state/PacketEventTable.h>
+
+using namespace testing;
+
+namespace quic {
+namespace test {
+
+TEST(PacketEventTableTest, SetInterface) {
+  PacketEventTable table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_TRUE(table.insert(10));
+  EXPECT_FALSE(table.insert(10));
+  EXPECT_TRUE(table.insert(3));
+  EXPECT_TRUE(table.insert(20));
+  EXPECT_EQ(3, table.size());
+  EXPECT_EQ(1, table.count(3));
+  EXPECT_EQ(0, table.count(4));
+  EXPECT_EQ(0, table.count(21));
+
+  EXPECT_EQ(1, table.erase(10));
+  EXPECT_EQ(0, table.erase(10));
+  EXPECT_EQ(0, table.count(10));
+  EXPECT_EQ(2, table.size());
+  EXPECT_EQ(1, table.erase(3));
+  EXPECT_EQ(1, table.erase(20));
+  EXPECT_TRUE(table.empty());
+
+  // Events can be reused once released.
+  EXPECT_TRUE(table.insert(10));
+  table.clear();
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(0, table.count(10));
+}
+
+TEST(PacketEventTableTest, SlotOutlivesEventWhilePacketsOutstanding) {
+  PacketEventTable table;
+  table.insert(5);
+  table.addPacket(5, 5);
+  table.addPacket(5, 8);
+  table.addPacket(5, 8);
+  EXPECT_EQ(2, table.numPackets(5));
+
+  // Nothing to retire while the frames haven't been processed.
+  EXPECT_TRUE(table.takeProcessedPackets(5).empty());
+  EXPECT_EQ(2, table.numPackets(5));
+
+  table.erase(5);
+  EXPECT_EQ(0, table.count(5));
+  table.removePacket(5, 5);
+  EXPECT_EQ(1, table.numPackets(5));
+  // Reinserting the event of a slot that is still referenced keeps its
+  // packets.
+  table.insert(5);
+  EXPECT_EQ(1, table.numPackets(5));
+  table.erase(5);
+
+  auto packets = table.takeProcessedPackets(5);
+  ASSERT_EQ(1, packets.size());
+  EXPECT_EQ(8, packets.front());
+  EXPECT_EQ(0, table.numPackets(5));
+  EXPECT_TRUE(table.takeProcessedPackets(5).empty());
+}
+
+TEST(PacketEventTableTest, TolerateUnknownPackets) {
+  PacketEventTable table;
+  table.removePacket(1, 1);
+  EXPECT_TRUE(table.takeProcessedPackets(1).empty());
+  table.insert(1);
+  table.removePacket(1, 2);
+  EXPECT_EQ(1, table.count(1));
+  EXPECT_EQ(0, table.numPackets(1));
+}
+} // namespace test
+} // namespace quic
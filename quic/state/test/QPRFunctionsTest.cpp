@@ -11,6 +11,7 @@
 
 #include <quic/server/state/ServerStateMachine.h>
 #include <quic/state/QPRFunctions.h>
+#include <quic/state/QuicStreamFunctions.h>
 
 using namespace folly;
 using namespace testing;
@@ -194,6 +195,37 @@ TEST_F(QPRFunctionsTest, RecvMinStreamDataFrameShrinkBuffer) {
   EXPECT_EQ(stream->conn.flowControlState.sumCurStreamBufferLen, 0);
 }
 
+TEST_F(QPRFunctionsTest, ShrinkManyBuffers) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  stream->currentWriteOffset = 100;
+  for (uint64_t offset = 0; offset < 100; offset += 10) {
+    auto& buffers =
+        (offset / 10) % 2 ? stream->lossBuffer : stream->retransmissionBuffer;
+    buffers.emplace_back(
+        folly::IOBuf::copyBuffer(std::string(10, 'a' + offset / 10)), offset);
+    stream->readBuffer.emplace_back(
+        folly::IOBuf::copyBuffer(std::string(10, 'a' + offset / 10)), offset);
+  }
+  MinStreamDataFrame frame(
+      stream->id, stream->flowControlState.peerAdvertisedMaxOffset, 45);
+  onRecvMinStreamDataFrame(stream, frame, PacketNum(10));
+  // [40, 50) crossed the offset and was trimmed, [50, 60) is untouched.
+  ASSERT_EQ(3, stream->retransmissionBuffer.size());
+  EXPECT_EQ(45, stream->retransmissionBuffer.front().offset);
+  EXPECT_EQ(5, stream->retransmissionBuffer.front().data.chainLength());
+  EXPECT_EQ(60, (stream->retransmissionBuffer.begin() + 1)->offset);
+  ASSERT_EQ(3, stream->lossBuffer.size());
+  EXPECT_EQ(50, stream->lossBuffer.front().offset);
+  EXPECT_EQ(10, stream->lossBuffer.front().data.chainLength());
+
+  stream->currentReceiveOffset = 0;
+  EXPECT_EQ(55, *advanceCurrentReceiveOffset(stream, 55));
+  ASSERT_EQ(5, stream->readBuffer.size());
+  EXPECT_EQ(55, stream->readBuffer.front().offset);
+  auto data = stream->readBuffer.front().data.front()->cloneCoalesced();
+  EXPECT_EQ("fffff", data->moveToFbString().toStdString());
+}
+
 TEST_F(QPRFunctionsTest, RecvMinStreamDataFrameOnUnidirectionalStream) {
   auto stream = conn.streamManager->createNextUnidirectionalStream().value();
   stream->send.state = StreamSendStates::Closed{};
@@ -266,5 +298,39 @@ TEST_F(QPRFunctionsTest, AdvanceCurrentReceiveOffset) {
   EXPECT_EQ(*result, 120);
 }
 
+TEST_F(QPRFunctionsTest, ExpireDataPastDeadline) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  stream->deliveryDeadline = 10ms;
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("aaaaaaaaaa"), false);
+  auto firstDeadline = stream->writeDeadlines.front().second;
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("bbbbbbbbbb"), false);
+  ASSERT_EQ(stream->writeDeadlines.size(), 2);
+  EXPECT_EQ(stream->writeDeadlines.front().first, 10);
+  EXPECT_EQ(stream->writeDeadlines.back().first, 20);
+  EXPECT_TRUE(conn.streamManager->deadlineStreams().count(stream->id));
+  EXPECT_EQ(*getNextWriteDeadline(*stream), firstDeadline);
+
+  // Nothing is past its deadline yet.
+  EXPECT_FALSE(expireDataPastDeadline(stream, firstDeadline - 1ms));
+  EXPECT_EQ(stream->writeDeadlines.size(), 2);
+
+  // The first write is expired, the second one is kept.
+  auto result = expireDataPastDeadline(stream, firstDeadline);
+  ASSERT_TRUE(result.hasValue());
+  EXPECT_EQ(*result, 10);
+  EXPECT_EQ(stream->minimumRetransmittableOffset, 10);
+  EXPECT_EQ(stream->currentWriteOffset, 10);
+  EXPECT_EQ(stream->writeDeadlines.size(), 1);
+  EXPECT_TRUE(conn.streamManager->deadlineStreams().count(stream->id));
+
+  // Data delivered in time is not expired.
+  stream->currentWriteOffset = 20;
+  stream->writeBuffer.move();
+  EXPECT_FALSE(getNextWriteDeadline(*stream));
+  EXPECT_FALSE(expireDataPastDeadline(stream, firstDeadline + 1s));
+  EXPECT_TRUE(stream->writeDeadlines.empty());
+  EXPECT_FALSE(conn.streamManager->deadlineStreams().count(stream->id));
+}
+
 } // namespace test
 } // namespace quic
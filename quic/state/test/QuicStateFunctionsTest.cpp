@@ -78,6 +78,32 @@ TEST_P(UpdateLargestReceivedPacketNumTest, ReceiveOld) {
       currentLargestReceived);
 }
 
+TEST_P(UpdateLargestReceivedPacketNumTest, CountECNCodepoints) {
+  QuicServerConnectionState conn;
+  auto& ackState = getAckState(conn, GetParam());
+  updateLargestReceivedPacketNum(ackState, 1, Clock::now());
+  EXPECT_TRUE(ackState.ecnCountsReceived.empty());
+  updateLargestReceivedPacketNum(ackState, 2, Clock::now(), ECNCodepoint::ECT0);
+  updateLargestReceivedPacketNum(ackState, 3, Clock::now(), ECNCodepoint::ECT0);
+  updateLargestReceivedPacketNum(ackState, 4, Clock::now(), ECNCodepoint::ECT1);
+  updateLargestReceivedPacketNum(ackState, 5, Clock::now(), ECNCodepoint::CE);
+  EXPECT_EQ(2, ackState.ecnCountsReceived.ect0);
+  EXPECT_EQ(1, ackState.ecnCountsReceived.ect1);
+  EXPECT_EQ(1, ackState.ecnCountsReceived.ce);
+}
+
+TEST_P(UpdateLargestReceivedPacketNumTest, ReorderingInvalidatesEncoding) {
+  QuicServerConnectionState conn;
+  auto& ackState = getAckState(conn, GetParam());
+  updateLargestReceivedPacketNum(ackState, 1, Clock::now());
+  ackState.acksEncoding.largestBlock = ackState.acks.back();
+  ackState.acksEncoding.numBlocks = ackState.acks.size();
+  updateLargestReceivedPacketNum(ackState, 5, Clock::now());
+  EXPECT_TRUE(ackState.acksEncoding.largestBlock.hasValue());
+  updateLargestReceivedPacketNum(ackState, 3, Clock::now());
+  EXPECT_FALSE(ackState.acksEncoding.largestBlock.hasValue());
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateLargestReceivedPacketNumTests,
     UpdateLargestReceivedPacketNumTest,
@@ -163,6 +189,50 @@ TEST_P(UpdateAckStateTest, TestUpdateAckState) {
   EXPECT_FALSE(conn.pendingEvents.scheduleAckTimeout);
 }
 
+TEST_P(UpdateAckStateTest, AdaptiveAcks) {
+  QuicServerConnectionState conn;
+  conn.transportSettings.adaptiveAcks = true;
+  auto& ackState = getAckState(conn, GetParam());
+  PacketNum packetNum = 0;
+  auto receive = [&](ECNCodepoint ecn = ECNCodepoint::NotECT) {
+    bool outOfOrder = updateLargestReceivedPacketNum(
+        ackState, packetNum++, Clock::now(), ecn);
+    updateAckSendStateOnRecvPacket(conn, ackState, outOfOrder, true, false);
+  };
+  // Count the packets until each of the first acks.
+  auto packetsUntilAck = [&]() {
+    ackState.needsToSendAckImmediately = false;
+    uint64_t packets = 0;
+    while (!ackState.needsToSendAckImmediately) {
+      receive();
+      ++packets;
+    }
+    return packets;
+  };
+  uint64_t previous = packetsUntilAck();
+  EXPECT_EQ(kRxPacketsPendingBeforeAckThresh, previous);
+  for (int i = 0; i < 100; ++i) {
+    auto packets = packetsUntilAck();
+    EXPECT_GE(packets, previous);
+    previous = packets;
+  }
+  EXPECT_EQ(kMaxRxPacketsPendingBeforeAckThresh, previous);
+
+  // A CE mark is acked right away and starts over.
+  ackState.needsToSendAckImmediately = false;
+  receive(ECNCodepoint::CE);
+  EXPECT_TRUE(ackState.needsToSendAckImmediately);
+  EXPECT_EQ(0, ackState.numInOrderRxPacketsRecvd);
+  EXPECT_EQ(kRxPacketsPendingBeforeAckThresh, packetsUntilAck());
+
+  // So does reordering.
+  packetNum++;
+  ackState.needsToSendAckImmediately = false;
+  receive();
+  EXPECT_TRUE(ackState.needsToSendAckImmediately);
+  EXPECT_EQ(0, ackState.numInOrderRxPacketsRecvd);
+}
+
 TEST_F(UpdateAckStateTest, UpdateAckStateOnAckTimeout) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   auto& initialAckState = getAckState(conn, PacketNumberSpace::Initial);
@@ -298,6 +368,26 @@ TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsNonRxOutOfOrder) {
   EXPECT_FALSE(verifyToScheduleAckTimeout(conn));
 }
 
+TEST_P(UpdateAckStateTest, UpdateAckSendStateOnRecvPacketsAckFrequency) {
+  // The packet tolerance of the peer replaces the rx limit, and out of order
+  // packets are not acked immediately with ignore order
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.ackFrequencyState.received = AckFrequencyFrame(0, 20, 5ms, true);
+  auto& ackState = getAckState(conn, GetParam());
+  for (size_t i = 0; i < 19; i++) {
+    updateAckSendStateOnRecvPacket(conn, ackState, i % 2 == 0, true, false);
+    EXPECT_FALSE(verifyToAckImmediately(conn, ackState));
+    EXPECT_TRUE(verifyToScheduleAckTimeout(conn));
+  }
+  updateAckSendStateOnRecvPacket(conn, ackState, false, true, false);
+  EXPECT_TRUE(verifyToAckImmediately(conn, ackState));
+  EXPECT_FALSE(verifyToScheduleAckTimeout(conn));
+
+  conn.ackFrequencyState.received->ignoreOrder = false;
+  updateAckSendStateOnRecvPacket(conn, ackState, true, true, false);
+  EXPECT_TRUE(verifyToAckImmediately(conn, ackState));
+}
+
 INSTANTIATE_TEST_CASE_P(
     UpdateAckStateTests,
     UpdateAckStateTest,
@@ -477,6 +567,88 @@ TEST_F(QuicStateFunctionsTest, IsConnectionPaced) {
   EXPECT_FALSE(isConnectionPaced(state));
 }
 
+TEST_F(QuicStateFunctionsTest, WritePacketLimit) {
+  QuicConnectionStateBase state(QuicNodeType::Client);
+  state.canBePaced = true;
+  state.transportSettings.pacingEnabled = true;
+  auto pacer = std::make_unique<MockPacer>();
+  auto rawPacer = pacer.get();
+  state.pacer = std::move(pacer);
+  auto congestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = congestionController.get();
+  state.congestionController = std::move(congestionController);
+
+  EXPECT_TRUE(isConnectionPaced(state));
+  EXPECT_FALSE(isConnectionTxTimePaced(state));
+  EXPECT_CALL(*rawPacer, updateAndGetWriteBatchSize(_)).WillOnce(Return(3));
+  EXPECT_EQ(3, getWritePacketLimit(state));
+
+  // The kernel paces a whole congestion window.
+  state.transportSettings.txTimePacing = true;
+  EXPECT_FALSE(isConnectionPaced(state));
+  EXPECT_TRUE(isConnectionTxTimePaced(state));
+  EXPECT_CALL(*rawPacer, updateAndGetWriteBatchSize(_)).Times(0);
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(state.udpSendPacketLen * 100));
+  EXPECT_EQ(100, getWritePacketLimit(state));
+
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(state.udpSendPacketLen));
+  EXPECT_EQ(
+      state.transportSettings.writeConnectionDataPacketsLimit,
+      getWritePacketLimit(state));
+
+  state.transportSettings.pacingEnabled = false;
+  EXPECT_FALSE(isConnectionTxTimePaced(state));
+
+  // Capped by the allowance of the write scheduler.
+  state.writePacketAllowance = 2;
+  EXPECT_EQ(2, getWritePacketLimit(state));
+}
+
+TEST_F(QuicStateFunctionsTest, UpdateAckFrequency) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto congestionController = std::make_unique<MockCongestionController>();
+  auto rawCongestionController = congestionController.get();
+  conn.congestionController = std::move(congestionController);
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(conn.udpSendPacketLen * 100));
+  conn.lossState.srtt = 40ms;
+
+  // Not negotiated
+  conn.transportSettings.ackFrequencyEnabled = true;
+  updateAckFrequency(conn);
+  EXPECT_TRUE(conn.pendingEvents.frames.empty());
+
+  conn.ackFrequencyState.peerMinAckDelay = 1ms;
+  updateAckFrequency(conn);
+  ASSERT_EQ(1, conn.pendingEvents.frames.size());
+  EXPECT_EQ(
+      AckFrequencyFrame(0, 25, 10ms, false),
+      *conn.pendingEvents.frames.front().asAckFrequencyFrame());
+
+  // Small changes don't send a new frame.
+  conn.lossState.srtt = 45ms;
+  updateAckFrequency(conn);
+  ASSERT_EQ(1, conn.pendingEvents.frames.size());
+  EXPECT_EQ(0, conn.ackFrequencyState.requested->sequenceNumber);
+
+  // Larger ones replace the pending frame.
+  EXPECT_CALL(*rawCongestionController, getCongestionWindow())
+      .WillRepeatedly(Return(conn.udpSendPacketLen * 200));
+  updateAckFrequency(conn);
+  ASSERT_EQ(1, conn.pendingEvents.frames.size());
+  AckFrequencyFrame expected(1, 50, 11250us, false);
+  EXPECT_EQ(expected, *conn.pendingEvents.frames.front().asAckFrequencyFrame());
+  EXPECT_EQ(expected, *conn.ackFrequencyState.requested);
+
+  // The delay stays within the peer's min ack delay and kMaxAckTimeout.
+  conn.lossState.srtt = 1s;
+  updateAckFrequency(conn);
+  EXPECT_EQ(
+      kMaxAckTimeout, conn.ackFrequencyState.requested->updateMaxAckDelay);
+}
+
 TEST_F(QuicStateFunctionsTest, GetOutstandingPackets) {
   QuicConnectionStateBase conn(QuicNodeType::Client);
   conn.outstandingPackets.emplace_back(
@@ -584,6 +756,257 @@ TEST_F(QuicStateFunctionsTest, EarliestLossTimer) {
   EXPECT_EQ(currentTime, earliestLossTimer(conn).first.value());
 }
 
+class UpdateOneRttKeysTest : public Test {
+ public:
+  void SetUp() override {
+    conn_.readCodec = std::make_unique<QuicReadCodec>(QuicNodeType::Server);
+    conn_.readCodec->setOneRttReadCipher(createNoOpAead());
+    conn_.oneRttWriteCipher = createNoOpAead();
+    conn_.oneRttKeyUpdate.updater = std::make_unique<OneRttKeyUpdater>(
+        fizz::CipherSuite::TLS_AES_128_GCM_SHA256,
+        std::vector<uint8_t>(32, 'r'),
+        std::vector<uint8_t>(32, 'w'));
+  }
+
+ protected:
+  QuicServerConnectionState conn_;
+};
+
+TEST_F(UpdateOneRttKeysTest, DerivesNextKeys) {
+  auto writeCipher = conn_.oneRttWriteCipher.get();
+  updateOneRttKeys(conn_);
+  EXPECT_NE(nullptr, conn_.readCodec->getNextOneRttReadCipher());
+  EXPECT_NE(nullptr, conn_.oneRttKeyUpdate.nextWriteCipher);
+  EXPECT_EQ(writeCipher, conn_.oneRttWriteCipher.get());
+  EXPECT_EQ(ProtectionType::KeyPhaseZero, conn_.oneRttKeyUpdate.writePhase);
+  EXPECT_EQ(0, conn_.oneRttKeyUpdate.numKeyUpdates);
+
+  auto nextWriteCipher = conn_.oneRttKeyUpdate.nextWriteCipher.get();
+  updateOneRttKeys(conn_);
+  EXPECT_EQ(nextWriteCipher, conn_.oneRttKeyUpdate.nextWriteCipher.get());
+}
+
+TEST_F(UpdateOneRttKeysTest, NoUpdaterNoKeys) {
+  conn_.oneRttKeyUpdate.updater = nullptr;
+  updateOneRttKeys(conn_);
+  EXPECT_EQ(nullptr, conn_.readCodec->getNextOneRttReadCipher());
+  EXPECT_EQ(nullptr, conn_.oneRttKeyUpdate.nextWriteCipher);
+}
+
+TEST_F(UpdateOneRttKeysTest, LocalUpdate) {
+  conn_.transportSettings.keyUpdatePacketInterval = 10;
+  conn_.ackStates.appDataAckState.nextPacketNum = 10;
+  updateOneRttKeys(conn_);
+  // Nothing of the current phase has been acked yet.
+  EXPECT_EQ(ProtectionType::KeyPhaseZero, conn_.oneRttKeyUpdate.writePhase);
+
+  conn_.lossState.lastAckedPacketSentTime = Clock::now();
+  auto nextWriteCipher = conn_.oneRttKeyUpdate.nextWriteCipher.get();
+  updateOneRttKeys(conn_);
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, conn_.oneRttKeyUpdate.writePhase);
+  EXPECT_EQ(nextWriteCipher, conn_.oneRttWriteCipher.get());
+  EXPECT_TRUE(conn_.oneRttKeyUpdate.localUpdatePending);
+  EXPECT_EQ(10, conn_.oneRttKeyUpdate.writePhaseStartPacketNum);
+  EXPECT_EQ(1, conn_.oneRttKeyUpdate.numKeyUpdates);
+
+  // The peer is still in the previous phase, which isn't another update.
+  conn_.ackStates.appDataAckState.nextPacketNum = 30;
+  conn_.lossState.lastAckedPacketSentTime = Clock::now() + 1s;
+  updateOneRttKeys(conn_);
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, conn_.oneRttKeyUpdate.writePhase);
+  EXPECT_TRUE(conn_.oneRttKeyUpdate.localUpdatePending);
+  EXPECT_EQ(1, conn_.oneRttKeyUpdate.numKeyUpdates);
+  EXPECT_NE(nullptr, conn_.oneRttKeyUpdate.nextWriteCipher);
+}
+
+TEST_F(UpdateOneRttKeysTest, PeerUpdate) {
+  updateOneRttKeys(conn_);
+  // Swap in a cipher that reads the test packets.
+  conn_.readCodec->setNextOneRttReadCipher(createNoOpAead());
+  conn_.readCodec->setCodecParameters(
+      CodecParameters(kDefaultAckDelayExponent, QuicVersion::MVFST));
+  conn_.readCodec->setOneRttHeaderCipher(createNoOpHeaderCipher());
+  auto connId = getTestConnectionId();
+  auto data = folly::IOBuf::copyBuffer("hello");
+  auto packet = createStreamPacket(
+      connId,
+      connId,
+      1,
+      2,
+      *data,
+      0 /* cipherOverhead */,
+      0 /* largestAcked */,
+      folly::none,
+      true,
+      ProtectionType::KeyPhaseOne);
+  auto packetQueue = bufToQueue(packetToBuf(packet));
+  auto result = conn_.readCodec->parsePacket(packetQueue, conn_.ackStates);
+  ASSERT_NE(nullptr, result.regularPacket());
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, conn_.readCodec->getOneRttReadPhase());
+
+  auto nextWriteCipher = conn_.oneRttKeyUpdate.nextWriteCipher.get();
+  updateOneRttKeys(conn_);
+  EXPECT_EQ(ProtectionType::KeyPhaseOne, conn_.oneRttKeyUpdate.writePhase);
+  EXPECT_EQ(nextWriteCipher, conn_.oneRttWriteCipher.get());
+  EXPECT_FALSE(conn_.oneRttKeyUpdate.localUpdatePending);
+  EXPECT_EQ(1, conn_.oneRttKeyUpdate.numKeyUpdates);
+  EXPECT_NE(nullptr, conn_.readCodec->getNextOneRttReadCipher());
+  EXPECT_NE(nullptr, conn_.oneRttKeyUpdate.nextWriteCipher);
+}
+
+TEST_F(QuicStateFunctionsTest, WriteLimitTime) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  auto start = Clock::now();
+  // The time until the first limit isn't charged.
+  updateWriteLimit(conn, WriteLimit::CwndLimited, start);
+  EXPECT_EQ(0us, getWriteLimitTime(conn, WriteLimit::Idle, start));
+  EXPECT_EQ(
+      10us, getWriteLimitTime(conn, WriteLimit::CwndLimited, start + 10us));
+
+  // The same limit again doesn't restart it.
+  updateWriteLimit(conn, WriteLimit::CwndLimited, start + 10us);
+  updateWriteLimit(conn, WriteLimit::AppLimited, start + 20us);
+  EXPECT_EQ(
+      20us, getWriteLimitTime(conn, WriteLimit::CwndLimited, start + 50us));
+  EXPECT_EQ(
+      30us, getWriteLimitTime(conn, WriteLimit::AppLimited, start + 50us));
+
+  updateWriteLimit(conn, WriteLimit::CwndLimited, start + 50us);
+  EXPECT_EQ(
+      25us, getWriteLimitTime(conn, WriteLimit::CwndLimited, start + 55us));
+  EXPECT_EQ(
+      30us, getWriteLimitTime(conn, WriteLimit::AppLimited, start + 55us));
+}
+
+namespace {
+ReadAckFrame makePmtuAck(PacketNum start, PacketNum end) {
+  ReadAckFrame frame;
+  frame.largestAcked = end;
+  frame.ackBlocks.emplace_back(start, end);
+  return frame;
+}
+} // namespace
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoverySearch) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.udpSendPacketLen = kDefaultV4UDPSendPacketLen;
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  startPmtuDiscovery(conn, 4096);
+  auto now = Clock::now();
+  // Not before the peer acked a 1-rtt packet.
+  EXPECT_FALSE(getPmtuProbeSize(conn, now));
+  conn.lossState.largestPrimaryPathAcked = 0;
+
+  // The largest size goes first.
+  EXPECT_EQ(4096, getPmtuProbeSize(conn, now).value_or(0));
+  onPmtuProbeWritten(conn, 10, 4096, now);
+  EXPECT_FALSE(getPmtuProbeSize(conn, now));
+  CongestionController::AckEvent ack;
+  onPmtuAck(conn, makePmtuAck(9, 10), ack, now);
+  EXPECT_EQ(4096, conn.udpSendPacketLen);
+  // Nothing larger to search for.
+  EXPECT_FALSE(getPmtuProbeSize(conn, now + kPmtuRaiseTimer));
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoveryProbeLost) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.udpSendPacketLen = kDefaultV4UDPSendPacketLen;
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  conn.transportSettings.maxPmtuProbeSize = 4096;
+  startPmtuDiscovery(conn, kDefaultMaxUDPPayload * 2);
+  conn.lossState.largestPrimaryPathAcked = 0;
+  conn.lossState.srtt = 10ms;
+  conn.lossState.rttvar = 0us;
+  conn.lossState.maxAckDelay = 0us;
+  auto now = Clock::now();
+
+  // Lost on timeout.
+  for (uint8_t i = 0; i < kMaxPmtuProbes; ++i) {
+    EXPECT_EQ(4096, getPmtuProbeSize(conn, now).value_or(0));
+    onPmtuProbeWritten(conn, i, 4096, now);
+    now += 10ms;
+    EXPECT_FALSE(getPmtuProbeSize(conn, now));
+    now += 20ms;
+  }
+  auto size = kDefaultV4UDPSendPacketLen +
+      (4096 - 1 - kDefaultV4UDPSendPacketLen + 1) / 2;
+  EXPECT_EQ(size, getPmtuProbeSize(conn, now).value_or(0));
+  EXPECT_EQ(kDefaultV4UDPSendPacketLen, conn.udpSendPacketLen);
+
+  // Lost once later packets are acked.
+  PacketNum probePacketNum = 100;
+  onPmtuProbeWritten(conn, probePacketNum, size, now);
+  CongestionController::AckEvent ack;
+  auto largestAcked = probePacketNum + conn.lossState.reorderingThreshold;
+  onPmtuAck(conn, makePmtuAck(largestAcked, largestAcked), ack, now);
+  ASSERT_TRUE(conn.pmtuDiscovery.probe.hasValue());
+  onPmtuAck(conn, makePmtuAck(largestAcked + 1, largestAcked + 1), ack, now);
+  EXPECT_FALSE(conn.pmtuDiscovery.probe.hasValue());
+  EXPECT_EQ(1, conn.pmtuDiscovery.lostProbes);
+
+  // A size refused by the socket is given up on right away.
+  EXPECT_EQ(size, getPmtuProbeSize(conn, now).value_or(0));
+  onPmtuProbeLost(conn, now, true /* sizeRefused */);
+  EXPECT_EQ(size - 1, conn.pmtuDiscovery.searchHigh);
+  EXPECT_GT(size, getPmtuProbeSize(conn, now).value_or(size));
+}
+
+TEST_F(QuicStateFunctionsTest, PmtuDiscoveryBlackHole) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.udpSendPacketLen = kDefaultV4UDPSendPacketLen;
+  conn.transportSettings.pmtuDiscoveryEnabled = true;
+  startPmtuDiscovery(conn, 4096);
+  conn.lossState.largestPrimaryPathAcked = 0;
+  auto now = Clock::now();
+  ASSERT_EQ(4096, getPmtuProbeSize(conn, now).value_or(0));
+  onPmtuProbeWritten(conn, 10, 4096, now);
+  CongestionController::AckEvent ack;
+  onPmtuAck(conn, makePmtuAck(10, 10), ack, now);
+  ASSERT_EQ(4096, conn.udpSendPacketLen);
+
+  for (uint64_t i = 0; i < kPmtuBlackHoleThreshold - 1; ++i) {
+    onPmtuPacketLost(conn, 4096);
+  }
+  // An acked large packet means the path still carries them.
+  ack.ackedPackets.push_back(
+      CongestionController::AckEvent::AckPacket::Builder()
+          .setSentTime(now)
+          .setEncodedSize(4096)
+          .setTotalBytesSentThen(0)
+          .setAppLimited(false)
+          .build());
+  onPmtuAck(conn, makePmtuAck(11, 11), ack, now);
+  onPmtuPacketLost(conn, 4096);
+  // Small packets don't count.
+  onPmtuPacketLost(conn, kDefaultV4UDPSendPacketLen);
+  EXPECT_EQ(4096, conn.udpSendPacketLen);
+
+  for (uint64_t i = 0; i < kPmtuBlackHoleThreshold - 1; ++i) {
+    onPmtuPacketLost(conn, 4096);
+  }
+  EXPECT_EQ(kDefaultV4UDPSendPacketLen, conn.udpSendPacketLen);
+  // And the search starts over.
+  EXPECT_EQ(4096, getPmtuProbeSize(conn, now).value_or(0));
+}
+
+TEST(OneRttKeyUpdaterTest, PeersDeriveMatchingKeys) {
+  std::vector<uint8_t> clientSecret(32, 'c');
+  std::vector<uint8_t> serverSecret(32, 's');
+  OneRttKeyUpdater client(
+      fizz::CipherSuite::TLS_AES_128_GCM_SHA256, serverSecret, clientSecret);
+  OneRttKeyUpdater server(
+      fizz::CipherSuite::TLS_AES_128_GCM_SHA256, clientSecret, serverSecret);
+  for (int phase = 0; phase < 2; ++phase) {
+    auto clientWrite = client.makeNextWriteCipher();
+    auto serverRead = server.makeNextReadCipher();
+    auto plaintext = folly::IOBuf::copyBuffer("key update");
+    auto ciphertext = clientWrite->encrypt(plaintext->clone(), nullptr, 1);
+    auto decrypted = serverRead->tryDecrypt(std::move(ciphertext), nullptr, 1);
+    ASSERT_TRUE(decrypted.hasValue());
+    EXPECT_TRUE(folly::IOBufEqualTo()(*decrypted, plaintext));
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(
     QuicStateFunctionsTests,
     QuicStateFunctionsTest,
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <quic/state/QuicStatsAggregator.h>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace quic {
+namespace test {
+
+using Counter = QuicStatsAggregator::Counter;
+using LatencyType = QuicTransportStatsCallback::LatencyType;
+
+TEST(QuicStatsAggregatorTest, SumsWorkers) {
+  QuicStatsAggregator aggregator;
+  auto worker1 = aggregator.make(nullptr);
+  auto worker2 = aggregator.make(nullptr);
+  EXPECT_FALSE(worker1->latencySamplingEnabled());
+
+  worker1->onPacketReceived();
+  worker1->onPacketReceived();
+  worker2->onPacketReceived();
+  worker1->onWrite(100);
+  worker2->onWrite(50);
+  worker2->onPacketDropped(
+      QuicTransportStatsCallback::PacketDropReason::PARSE_ERROR);
+  worker1->onConnectionClose(folly::none);
+  worker2->onConnectionClose(
+      QuicTransportStatsCallback::ConnectionCloseReason::IDLE_TIMEOUT);
+  worker1->onRecvBufferPoolStats(3, 10);
+  worker2->onRecvBufferPoolStats(4, 7);
+  worker1->onBufferMemoryUsage(100, 300);
+  worker2->onBufferMemoryUsage(50, 200);
+
+  auto snapshot = aggregator.snapshot();
+  EXPECT_EQ(2, snapshot.numWorkers);
+  EXPECT_EQ(3, snapshot.get(Counter::PACKET_RECEIVED));
+  EXPECT_EQ(150, snapshot.get(Counter::BYTES_WRITTEN));
+  EXPECT_EQ(0, snapshot.get(Counter::PACKET_SENT));
+  EXPECT_EQ(
+      1,
+      snapshot.get(QuicTransportStatsCallback::PacketDropReason::PARSE_ERROR));
+  EXPECT_EQ(
+      1, snapshot.get(QuicTransportStatsCallback::ConnectionCloseReason::NONE));
+  EXPECT_EQ(
+      1,
+      snapshot.get(
+          QuicTransportStatsCallback::ConnectionCloseReason::IDLE_TIMEOUT));
+  EXPECT_EQ(7, snapshot.pooledRecvBuffers);
+  EXPECT_EQ(10, snapshot.recvBufferHighWaterMark);
+  EXPECT_EQ(150, snapshot.bufferedBytes);
+  EXPECT_EQ(300, snapshot.bufferedBytesHighWaterMark);
+
+  // Stats outlive the worker callbacks.
+  worker1.reset();
+  EXPECT_EQ(3, aggregator.snapshot().get(Counter::PACKET_RECEIVED));
+}
+
+TEST(QuicStatsAggregatorTest, Latencies) {
+  QuicStatsAggregator aggregator(true);
+  auto worker1 = aggregator.make(nullptr);
+  auto worker2 = aggregator.make(nullptr);
+  EXPECT_TRUE(worker1->latencySamplingEnabled());
+  worker1->onLatencySample(LatencyType::WRITE_LOOP, 10us);
+  worker2->onLatencySample(LatencyType::WRITE_LOOP, 1000us);
+  worker2->onLatencySample(LatencyType::ACK_PROCESSING, 5us);
+
+  auto snapshot = aggregator.snapshot();
+  const auto& writeLoop = snapshot.get(LatencyType::WRITE_LOOP);
+  EXPECT_EQ(2, writeLoop.count());
+  EXPECT_EQ(10us, writeLoop.getPercentile(50));
+  EXPECT_GE(writeLoop.getPercentile(100), 1000us);
+  EXPECT_LT(writeLoop.getPercentile(100), 1100us);
+  EXPECT_EQ(1, snapshot.get(LatencyType::ACK_PROCESSING).count());
+  EXPECT_EQ(0, snapshot.get(LatencyType::PACKET_DECODE).count());
+}
+
+TEST(QuicStatsAggregatorTest, CpuCosts) {
+  using CpuCostType = QuicTransportStatsCallback::CpuCostType;
+  QuicStatsAggregator aggregator;
+  auto worker1 = aggregator.make(nullptr);
+  auto worker2 = aggregator.make(nullptr);
+  worker1->onCpuCost(CpuCostType::NETWORK_DATA, 1000);
+  worker2->onCpuCost(CpuCostType::NETWORK_DATA, 500);
+  worker2->onCpuCost(CpuCostType::PACKET_ENCRYPT, 20);
+
+  auto snapshot = aggregator.snapshot();
+  EXPECT_EQ(1500, snapshot.get(CpuCostType::NETWORK_DATA));
+  EXPECT_EQ(20, snapshot.get(CpuCostType::PACKET_ENCRYPT));
+  EXPECT_EQ(0, snapshot.get(CpuCostType::WRITE_LOOP));
+}
+
+TEST(QuicStatsAggregatorTest, WriteLoops) {
+  QuicStatsAggregator aggregator;
+  auto worker1 = aggregator.make(nullptr);
+  auto worker2 = aggregator.make(nullptr);
+  WriteLoopMetrics metrics;
+  metrics.packetsWritten = 10;
+  metrics.socketWrites = 2;
+  metrics.socketWritePackets = 10;
+  metrics.bytesWritten = 12000;
+  metrics.stopReason = WriteLimit::CwndLimited;
+  metrics.timeSpent = 100us;
+  worker1->onWriteLoop(metrics);
+  metrics.stopReason = WriteLimit::PacingLimited;
+  worker2->onWriteLoop(metrics);
+
+  auto snapshot = aggregator.snapshot();
+  EXPECT_EQ(2, snapshot.get(Counter::WRITE_LOOPS));
+  EXPECT_EQ(20, snapshot.get(Counter::WRITE_LOOP_PACKETS));
+  EXPECT_EQ(4, snapshot.get(Counter::WRITE_LOOP_SOCKET_WRITES));
+  EXPECT_EQ(20, snapshot.get(Counter::WRITE_LOOP_SOCKET_WRITE_PACKETS));
+  EXPECT_EQ(24000, snapshot.get(Counter::WRITE_LOOP_BYTES));
+  EXPECT_EQ(200, snapshot.get(Counter::WRITE_LOOP_TIME));
+  EXPECT_EQ(1, snapshot.get(WriteLimit::CwndLimited));
+  EXPECT_EQ(1, snapshot.get(WriteLimit::PacingLimited));
+  EXPECT_EQ(0, snapshot.get(WriteLimit::Busy));
+}
+
+TEST(QuicStatsAggregatorTest, SnapshotWhileWorkersWrite) {
+  QuicStatsAggregator aggregator;
+  constexpr int kWorkers = 4;
+  constexpr int kPackets = 10000;
+  std::vector<std::unique_ptr<QuicTransportStatsCallback>> workers;
+  for (int i = 0; i < kWorkers; ++i) {
+    workers.push_back(aggregator.make(nullptr));
+  }
+  std::vector<std::thread> threads;
+  for (auto& worker : workers) {
+    threads.emplace_back([worker = worker.get()] {
+      for (int i = 0; i < kPackets; ++i) {
+        worker->onPacketSent();
+      }
+    });
+  }
+  uint64_t lastSeen = 0;
+  for (int i = 0; i < 100; ++i) {
+    auto seen = aggregator.snapshot().get(Counter::PACKET_SENT);
+    EXPECT_GE(seen, lastSeen);
+    lastSeen = seen;
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(
+      kWorkers * kPackets, aggregator.snapshot().get(Counter::PACKET_SENT));
+}
+
+} // namespace test
+} // namespace quic
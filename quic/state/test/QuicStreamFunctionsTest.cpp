@@ -11,6 +11,7 @@
 
 #include <quic/state/QuicStreamFunctions.h>
 
+#include <quic/api/test/MockQuicStats.h>
 #include <quic/client/state/ClientStateMachine.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/server/state/ServerStateMachine.h>
@@ -23,8 +24,6 @@ namespace test {
 
 constexpr uint8_t kStreamIncrement = 0x04;
 
-using PeekIterator = std::deque<StreamBuffer>::const_iterator;
-
 class QuicStreamFunctionsTest : public Test {
  public:
   void SetUp() override {
@@ -106,6 +105,30 @@ TEST_F(QuicStreamFunctionsTest, TestWriteStream) {
   EXPECT_TRUE(eq(stream->writeBuffer.move(), buf1));
 }
 
+TEST_F(QuicStreamFunctionsTest, TestWriteStreamCoalescing) {
+  conn.transportSettings.writeCoalescingThreshold = 20;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("I just met you"), false);
+  writeDataToQuicStream(
+      *stream, IOBuf::copyBuffer("and this is crazy"), false);
+  EXPECT_FALSE(stream->writeBuffer.front()->isChained());
+  EXPECT_EQ(31, stream->writeBuffer.chainLength());
+
+  // Once the tail is cloned into a packet it isn't written to anymore.
+  auto cloned = stream->writeBuffer.front()->clone();
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("here's my"), false);
+  EXPECT_EQ(2, stream->writeBuffer.front()->countChainElements());
+  EXPECT_EQ("I just met youand this is crazy", cloned->moveToFbString());
+
+  // Larger writes are appended as they are.
+  writeDataToQuicStream(
+      *stream, IOBuf::copyBuffer("number so call me maybe"), false);
+  EXPECT_EQ(3, stream->writeBuffer.front()->countChainElements());
+  EXPECT_EQ(
+      "I just met youand this is crazyhere's mynumber so call me maybe",
+      stream->writeBuffer.move()->moveToFbString());
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadDataWrittenInOrder) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto streamLastMaxOffset = stream->maxOffsetObserved;
@@ -399,6 +422,43 @@ TEST_F(QuicStreamFunctionsTest, TestReadDataOutOfOrder) {
   EXPECT_TRUE(readData4.second);
 }
 
+TEST_F(QuicStreamFunctionsTest, TestReadDataIntoIovec) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto buf1 = IOBuf::copyBuffer("I just met you ");
+  buf1->prependChain(IOBuf::copyBuffer("and this is crazy. "));
+  auto buf2 = IOBuf::copyBuffer("Here's my number");
+  appendDataToReadBuffer(*stream, StreamBuffer(buf1->clone(), 0));
+  appendDataToReadBuffer(
+      *stream,
+      StreamBuffer(buf2->clone(), buf1->computeChainDataLength() + 10, true));
+
+  std::array<char, 10> first;
+  std::array<char, 20> second;
+  std::array<iovec, 2> vec = {{{first.data(), first.size()},
+                               {second.data(), second.size()}}};
+  auto result = readDataFromQuicStream(*stream, vec.data(), vec.size());
+  EXPECT_EQ(30, result.first);
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ("I just met", std::string(first.data(), first.size()));
+  EXPECT_EQ(" you and this is cra", std::string(second.data(), second.size()));
+
+  // Stops at the hole.
+  result = readDataFromQuicStream(*stream, vec.data(), vec.size());
+  EXPECT_EQ(4, result.first);
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ("zy. ", std::string(first.data(), 4));
+  result = readDataFromQuicStream(*stream, vec.data(), vec.size());
+  EXPECT_EQ(0, result.first);
+
+  appendDataToReadBuffer(
+      *stream, StreamBuffer(IOBuf::copyBuffer("0123456789"), 34));
+  result = readDataFromQuicStream(*stream, vec.data(), vec.size());
+  EXPECT_EQ(26, result.first);
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ("0123456789", std::string(first.data(), first.size()));
+  EXPECT_EQ("Here's my number", std::string(second.data(), 16));
+}
+
 TEST_F(QuicStreamFunctionsTest, TestReadOverlappingData) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto buf1 = IOBuf::copyBuffer("I just met you ");
@@ -643,6 +703,39 @@ TEST_F(QuicStreamFunctionsTest, TestInsertVariations) {
   EXPECT_TRUE(stream->readBuffer.empty());
 }
 
+TEST_F(QuicStreamFunctionsTest, TestFillManyHoles) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  std::string data;
+  for (char c = 'a'; c <= 'z'; ++c) {
+    data += std::string(10, c);
+  }
+  // Every other 10 byte segment first, the rest in reverse order with a byte
+  // of overlap on both sides.
+  for (size_t offset = 0; offset < data.size(); offset += 20) {
+    appendDataToReadBuffer(
+        *stream,
+        StreamBuffer(IOBuf::copyBuffer(data.substr(offset, 10)), offset));
+  }
+  EXPECT_EQ(13, stream->readBuffer.size());
+  for (size_t i = 0; i < 13; ++i) {
+    size_t offset = data.size() - 10 - 20 * i;
+    bool eof = offset + 10 == data.size();
+    size_t len = eof ? 11 : 12;
+    appendDataToReadBuffer(
+        *stream,
+        StreamBuffer(
+            IOBuf::copyBuffer(data.substr(offset - 1, len)), offset - 1, eof));
+  }
+  ASSERT_EQ(1, stream->readBuffer.size());
+  EXPECT_EQ(0, stream->readBuffer.front().offset);
+  EXPECT_TRUE(stream->readBuffer.front().eof);
+
+  auto readData = readDataFromQuicStream(*stream, 1000);
+  EXPECT_EQ(data, readData.first->moveToFbString().toStdString());
+  EXPECT_TRUE(readData.second);
+  EXPECT_TRUE(stream->readBuffer.empty());
+}
+
 TEST_F(QuicStreamFunctionsTest, TestAppendAlreadyReadData) {
   auto stream = conn.streamManager->createNextBidirectionalStream().value();
   auto buf1 = IOBuf::copyBuffer("I just met you and this is crazy");
@@ -1534,7 +1627,7 @@ TEST_F(QuicStreamFunctionsTest, RemovedClosedState) {
 
 TEST_F(QuicServerStreamFunctionsTest, ServerGetClientQuicStream) {
   StreamId clientStream = 0x10;
-  std::deque<StreamId> newStreams = {0x0, 0x4, 0x8, 0xc, 0x10};
+  std::vector<StreamId> newStreams = {0x0, 0x4, 0x8, 0xc, 0x10};
   EXPECT_EQ(conn.streamManager->getStream(clientStream)->id, clientStream);
   EXPECT_EQ(conn.streamManager->streamCount(), 1);
   EXPECT_EQ(conn.streamManager->openBidirectionalPeerStreams().size(), 5);
@@ -2008,5 +2101,102 @@ TEST_F(
       id /* streamId */, 0 /* offset */, 5 /* length */, true /* eof */);
   EXPECT_TRUE(streamFrameMatchesRetransmitBuffer(stream, ackFrame, buf));
 }
+
+TEST_F(QuicStreamFunctionsTest, StreamByteEvents) {
+  using LatencyType = QuicTransportStatsCallback::LatencyType;
+  MockQuicStats stats;
+  conn.infoCallback = &stats;
+  conn.transportSettings.trackStreamByteEvents = true;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("hello"), false);
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("world"), false);
+  auto& events = stream->byteEvents;
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ(5, events[1].startOffset);
+  EXPECT_EQ(10, events[1].endOffset);
+  auto writeTime = events[0].writeTime;
+  events[1].writeTime = writeTime;
+
+  // The second write is sent across two packets.
+  onStreamBytesSent(*stream, 0, 7, true, writeTime + 10ms);
+  EXPECT_EQ(2, stream->numSentByteEvents);
+  onStreamBytesSent(*stream, 7, 3, true, writeTime + 20ms);
+  EXPECT_EQ(writeTime + 10ms, *events[1].firstSentTime);
+  EXPECT_EQ(writeTime + 20ms, events[1].lastSentTime);
+  EXPECT_FALSE(events[1].resent);
+
+  // The first packet is retransmitted.
+  onStreamBytesSent(*stream, 0, 7, false, writeTime + 50ms);
+  EXPECT_TRUE(events[0].resent);
+  EXPECT_TRUE(events[1].resent);
+  EXPECT_EQ(writeTime + 50ms, events[1].lastSentTime);
+
+  // Only the first write is delivered.
+  stream->currentWriteOffset = 10;
+  stream->retransmissionBuffer.emplace_back(
+      IOBuf::copyBuffer("world"), 5, false);
+  EXPECT_CALL(stats, onLatencySample(LatencyType::STREAM_APP_QUEUE, 10000us));
+  EXPECT_CALL(
+      stats, onLatencySample(LatencyType::STREAM_RETRANSMISSION, 40000us));
+  EXPECT_CALL(stats, onLatencySample(LatencyType::STREAM_NETWORK, _));
+  onStreamBytesDelivered(*stream);
+  EXPECT_EQ(1, events.size());
+  EXPECT_EQ(1, stream->numSentByteEvents);
+  Mock::VerifyAndClearExpectations(&stats);
+
+  stream->retransmissionBuffer.clear();
+  EXPECT_CALL(stats, onLatencySample(LatencyType::STREAM_APP_QUEUE, 10000us));
+  EXPECT_CALL(
+      stats, onLatencySample(LatencyType::STREAM_RETRANSMISSION, 40000us));
+  EXPECT_CALL(stats, onLatencySample(LatencyType::STREAM_NETWORK, _));
+  onStreamBytesDelivered(*stream);
+  EXPECT_TRUE(events.empty());
+  EXPECT_EQ(0, stream->numSentByteEvents);
+}
+
+TEST_F(QuicStreamFunctionsTest, StreamByteEventsDisabled) {
+  MockQuicStats stats;
+  conn.infoCallback = &stats;
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  writeDataToQuicStream(*stream, IOBuf::copyBuffer("hello"), false);
+  EXPECT_TRUE(stream->byteEvents.empty());
+}
+
+TEST_F(QuicStreamFunctionsTest, ReclaimStreamBufferMemory) {
+  auto stream = conn.streamManager->createNextBidirectionalStream().value();
+  auto data = IOBuf::create(1000);
+  data->append(1000);
+  memset(data->writableData(), 'a', 1000);
+  stream->writeBuffer.append(std::move(data));
+  stream->retransmissionBuffer.emplace_back(
+      stream->writeBuffer.split(10), 0, false);
+  stream->lossBuffer.emplace_back(stream->writeBuffer.split(10), 10, false);
+  stream->writeBuffer.move();
+
+  // Without compaction the buffers keep sharing the memory of the write.
+  reclaimStreamBufferMemory(*stream, false);
+  EXPECT_GE(
+      stream->retransmissionBuffer.front().data.front()->computeChainCapacity(),
+      1000);
+
+  reclaimStreamBufferMemory(*stream, true);
+  for (auto buffers : {&stream->retransmissionBuffer, &stream->lossBuffer}) {
+    ASSERT_EQ(1, buffers->size());
+    const auto* buf = buffers->front().data.front();
+    EXPECT_EQ(10, buf->computeChainDataLength());
+    EXPECT_LT(buf->computeChainCapacity(), 1000);
+    EXPECT_EQ(std::string(10, 'a'), buf->cloneCoalesced()->moveToFbString());
+  }
+  EXPECT_EQ(10, stream->lossBuffer.front().offset);
+
+  // Drained queues free their storage.
+  stream->retransmissionBuffer.pop_front();
+  stream->lossBuffer.pop_front();
+  reclaimStreamBufferMemory(*stream, false);
+  EXPECT_TRUE(
+      stream->retransmissionBuffer.rawBegin() ==
+      stream->retransmissionBuffer.rawEnd());
+  EXPECT_TRUE(stream->lossBuffer.empty());
+}
 } // namespace test
 } // namespace quic
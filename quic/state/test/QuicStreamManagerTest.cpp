@@ -248,5 +248,159 @@ TEST_F(QuicStreamManagerTest, StreamLimitManyWindowedUpdate) {
   EXPECT_FALSE(manager.remoteBidirectionalStreamLimitUpdate());
   EXPECT_FALSE(manager.remoteUnidirectionalStreamLimitUpdate());
 }
+
+TEST_F(QuicStreamManagerTest, StreamLimitAutoScaledUpdate) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.advertisedInitialMaxStreamsBidi = 100;
+  conn.transportSettings.autoScaleStreamLimits = true;
+  manager.refreshTransportSettings(conn.transportSettings);
+  manager.setStreamLimitWindowingFraction(4);
+  // All the streams are closed within one RTT.
+  conn.lossState.srtt = std::chrono::seconds(10);
+  for (int i = 0; i < 100; i++) {
+    manager.getStream(i * detail::kStreamIncrement);
+  }
+  for (int i = 0; i < 14; i++) {
+    auto stream = manager.getStream(i * detail::kStreamIncrement);
+    stream->send.state = StreamSendStates::Closed();
+    stream->recv.state = StreamReceiveStates::Closed();
+    manager.removeClosedStream(stream->id);
+  }
+  // After 14 closes the limit is the 86 open streams plus two RTTs worth of
+  // closes, so the credit of 28 streams exceeds a quarter of it, while the
+  // fixed window would wait for 25 closes.
+  auto update = manager.remoteBidirectionalStreamLimitUpdate();
+  ASSERT_TRUE(update);
+  EXPECT_EQ(update.value(), 128);
+  EXPECT_FALSE(manager.remoteBidirectionalStreamLimitUpdate());
+}
+
+TEST_F(QuicStreamManagerTest, StreamLimitAutoScaledCapped) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.advertisedInitialMaxStreamsBidi = 100;
+  conn.transportSettings.autoScaleStreamLimits = true;
+  conn.transportSettings.maxAutoScaledStreamLimit = 100;
+  manager.refreshTransportSettings(conn.transportSettings);
+  manager.setStreamLimitWindowingFraction(4);
+  conn.lossState.srtt = std::chrono::seconds(10);
+  for (int i = 0; i < 100; i++) {
+    manager.getStream(i * detail::kStreamIncrement);
+  }
+  for (int i = 0; i < 24; i++) {
+    auto stream = manager.getStream(i * detail::kStreamIncrement);
+    stream->send.state = StreamSendStates::Closed();
+    stream->recv.state = StreamReceiveStates::Closed();
+    manager.removeClosedStream(stream->id);
+  }
+  EXPECT_FALSE(manager.remoteBidirectionalStreamLimitUpdate());
+  auto stream = manager.getStream(24 * detail::kStreamIncrement);
+  stream->send.state = StreamSendStates::Closed();
+  stream->recv.state = StreamReceiveStates::Closed();
+  manager.removeClosedStream(stream->id);
+  auto update = manager.remoteBidirectionalStreamLimitUpdate();
+  ASSERT_TRUE(update);
+  EXPECT_EQ(update.value(), 125);
+}
+
+TEST_F(QuicStreamManagerTest, WritableStreamsByPriority) {
+  auto& manager = *conn.streamManager;
+  auto stream1 = manager.createNextBidirectionalStream().value();
+  auto stream2 = manager.createNextBidirectionalStream().value();
+  manager.addWritable(stream1->id);
+  manager.addWritable(stream2->id);
+  ASSERT_EQ(1, manager.writableStreamsByPriority().size());
+  EXPECT_EQ(
+      kDefaultPriority, manager.writableStreamsByPriority().begin()->first);
+
+  manager.setStreamPriority(*stream2, Priority(0, false));
+  ASSERT_EQ(2, manager.writableStreamsByPriority().size());
+  auto group = manager.writableStreamsByPriority().begin();
+  EXPECT_EQ(Priority(0, false), group->first);
+  EXPECT_EQ(std::set<StreamId>({stream2->id}), group->second);
+  EXPECT_EQ(std::set<StreamId>({stream1->id}), std::next(group)->second);
+
+  manager.removeWritable(stream2->id);
+  EXPECT_EQ(1, manager.writableStreamsByPriority().size());
+  EXPECT_EQ(Priority(0, false), stream2->priority);
+  manager.addWritable(stream2->id);
+  EXPECT_EQ(
+      Priority(0, false), manager.writableStreamsByPriority().begin()->first);
+  manager.clearWritable();
+  EXPECT_TRUE(manager.writableStreamsByPriority().empty());
+}
+
+TEST_F(QuicStreamManagerTest, ClosedStreamMemoryIsReused) {
+  auto& manager = *conn.streamManager;
+  conn.transportSettings.streamStatePoolSize = 1;
+  manager.refreshTransportSettings(conn.transportSettings);
+  auto stream = manager.createNextBidirectionalStream().value();
+  EXPECT_EQ(1, manager.streamStatePool().numAllocated());
+  stream->send.state = StreamSendStates::Closed();
+  stream->recv.state = StreamReceiveStates::Closed();
+  manager.removeClosedStream(stream->id);
+  EXPECT_EQ(1, manager.streamStatePool().numFree());
+
+  auto next = manager.createNextBidirectionalStream().value();
+  EXPECT_EQ(1, manager.streamStatePool().numAllocated());
+  EXPECT_EQ(1, manager.streamStatePool().numReused());
+  EXPECT_EQ(0, manager.streamStatePool().numFree());
+  EXPECT_TRUE(next->send.state.is<StreamSendStates::Open>());
+
+  // Without a pool the memory goes back to the heap.
+  conn.transportSettings.streamStatePoolSize = 0;
+  manager.refreshTransportSettings(conn.transportSettings);
+  next->send.state = StreamSendStates::Closed();
+  next->recv.state = StreamReceiveStates::Closed();
+  manager.removeClosedStream(next->id);
+  EXPECT_EQ(0, manager.streamStatePool().numFree());
+}
+
+TEST_F(QuicStreamManagerTest, ClosedStreamMemoryOutlivesConnection) {
+  auto sharedPool = std::make_shared<StreamStatePool>(
+      QuicStreamManager::streamStateBlockSize(), 1);
+  {
+    QuicServerConnectionState other;
+    other.streamManager->setMaxLocalBidirectionalStreams(
+        kDefaultMaxStreamsBidirectional);
+    other.streamManager->setSharedStreamStatePool(sharedPool);
+    other.streamManager->createNextBidirectionalStream().value();
+    EXPECT_EQ(1, sharedPool->numAllocated());
+    other.streamManager->clearOpenStreams();
+    EXPECT_EQ(1, sharedPool->numFree());
+  }
+  auto& manager = *conn.streamManager;
+  manager.setSharedStreamStatePool(sharedPool);
+  manager.createNextBidirectionalStream().value();
+  EXPECT_EQ(1, sharedPool->numReused());
+  EXPECT_EQ(0, sharedPool->numFree());
+}
+
+TEST_F(QuicStreamManagerTest, LookupOfLastStreamIsCached) {
+  auto& manager = *conn.streamManager;
+  auto stream1 = manager.createNextBidirectionalStream().value();
+  auto stream2 = manager.createNextBidirectionalStream().value();
+
+  EXPECT_EQ(stream1, manager.getStream(stream1->id));
+  EXPECT_EQ(stream1, manager.getStream(stream1->id));
+  EXPECT_EQ(stream1, manager.findStream(stream1->id));
+  EXPECT_EQ(3, manager.getLookupCacheStats().lookups);
+  EXPECT_EQ(2, manager.getLookupCacheStats().hits);
+
+  EXPECT_EQ(stream2, manager.findStream(stream2->id));
+  EXPECT_EQ(stream1, manager.getStream(stream1->id));
+  EXPECT_EQ(2, manager.getLookupCacheStats().hits);
+
+  // The removed stream is not returned from the cache.
+  auto id = stream1->id;
+  stream1->send.state = StreamSendStates::Closed();
+  stream1->recv.state = StreamReceiveStates::Closed();
+  manager.removeClosedStream(id);
+  EXPECT_EQ(nullptr, manager.findStream(id));
+  EXPECT_EQ(2, manager.getLookupCacheStats().hits);
+  EXPECT_EQ(stream2, manager.findStream(stream2->id));
+  EXPECT_EQ(stream2, manager.findStream(stream2->id));
+  EXPECT_EQ(3, manager.getLookupCacheStats().hits);
+}
+
 } // namespace test
 } // namespace quic
@@ -9,7 +9,9 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <quic/api/test/MockQuicStats.h>
 #include <quic/common/test/TestUtils.h>
+#include <quic/state/QuicCpuCostSampler.h>
 #include <quic/state/StateData.h>
 
 using namespace quic;
@@ -28,6 +30,22 @@ TEST_F(StateDataTest, EmptyLossEvent) {
   EXPECT_FALSE(loss.largestLostPacketNum);
 }
 
+TEST_F(StateDataTest, OutstandingPacketCopiesHeaderFields) {
+  RegularQuicWritePacket packet(LongHeader(
+      LongHeader::Types::Handshake,
+      getTestConnectionId(1),
+      getTestConnectionId(),
+      100,
+      kVersion));
+  OutstandingPacket outstandingPacket(
+      std::move(packet), Clock::now(), 1234, true, false, 1234);
+  EXPECT_EQ(100, outstandingPacket.packetNum);
+  EXPECT_EQ(PacketNumberSpace::Handshake, outstandingPacket.packetNumberSpace);
+  EXPECT_EQ(
+      outstandingPacket.packetNum,
+      outstandingPacket.packet.header.getPacketSequenceNum());
+}
+
 TEST_F(StateDataTest, SingleLostPacketEvent) {
   RegularQuicWritePacket packet(LongHeader(
       LongHeader::Types::Initial,
@@ -68,5 +86,76 @@ TEST_F(StateDataTest, MultipleLostPacketsEvent) {
   EXPECT_EQ(1234 + 1357, loss.lostBytes);
   EXPECT_EQ(110, *loss.largestLostPacketNum);
 }
+
+TEST_F(StateDataTest, CpuCostSamplingDisabled) {
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  MockQuicStats stats;
+  conn.infoCallback = &stats;
+  EXPECT_CALL(stats, onCpuCost(_, _)).Times(0);
+  {
+    QuicCpuCostSampler sampler(
+        conn, QuicTransportStatsCallback::CpuCostType::WRITE_LOOP);
+  }
+  auto index =
+      static_cast<size_t>(QuicTransportStatsCallback::CpuCostType::WRITE_LOOP);
+  EXPECT_EQ(0, conn.cpuCosts.calls[index]);
+  EXPECT_EQ(0, conn.cpuCosts.cycles[index]);
+}
+
+TEST_F(StateDataTest, CpuCostSampling) {
+  using CpuCostType = QuicTransportStatsCallback::CpuCostType;
+  QuicConnectionStateBase conn(QuicNodeType::Client);
+  conn.transportSettings.cpuCostSamplingRate = 4;
+  MockQuicStats stats;
+  conn.infoCallback = &stats;
+  std::vector<uint64_t> reported;
+  EXPECT_CALL(stats, onCpuCost(CpuCostType::ACK_PROCESSING, _))
+      .Times(3)
+      .WillRepeatedly(
+          Invoke([&](auto, uint64_t cycles) { reported.push_back(cycles); }));
+  for (int i = 0; i < 10; ++i) {
+    QuicCpuCostSampler sampler(conn, CpuCostType::ACK_PROCESSING);
+  }
+  auto index = static_cast<size_t>(CpuCostType::ACK_PROCESSING);
+  EXPECT_EQ(10, conn.cpuCosts.calls[index]);
+  EXPECT_EQ(3, conn.cpuCosts.samples[index]);
+  EXPECT_EQ(
+      std::accumulate(reported.begin(), reported.end(), uint64_t(0)),
+      conn.cpuCosts.cycles[index]);
+  for (auto cycles : reported) {
+    // Every sample stands for the calls that weren't sampled.
+    EXPECT_EQ(0, cycles % 4);
+  }
+  EXPECT_EQ(
+      0, conn.cpuCosts.calls[static_cast<size_t>(CpuCostType::WRITE_LOOP)]);
+}
+
+TEST_F(StateDataTest, ReceivedPacketWindow) {
+  ReceivedPacketWindow window;
+  EXPECT_TRUE(window.insert(10));
+  EXPECT_FALSE(window.insert(10));
+  // Out of order, then the gap is filled.
+  EXPECT_TRUE(window.insert(13));
+  EXPECT_TRUE(window.insert(11));
+  EXPECT_FALSE(window.insert(11));
+  EXPECT_TRUE(window.insert(12));
+  EXPECT_FALSE(window.insert(13));
+
+  // Moving the window forgets the bits of the packet numbers that share
+  // theirs with the new ones.
+  PacketNum next = 10 + kReceivedPacketWindowSize;
+  EXPECT_TRUE(window.insert(next));
+  EXPECT_TRUE(window.insert(next - 1));
+  EXPECT_FALSE(window.insert(11));
+  EXPECT_FALSE(window.insert(next));
+  // Below the window, it can't tell.
+  EXPECT_TRUE(window.insert(10));
+
+  // A jump past the whole window.
+  next += 5 * kReceivedPacketWindowSize;
+  EXPECT_TRUE(window.insert(next));
+  EXPECT_TRUE(window.insert(next - 3));
+  EXPECT_FALSE(window.insert(next - 3));
+}
 } // namespace test
 } // namespace quic
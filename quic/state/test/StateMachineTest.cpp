@@ -123,12 +123,28 @@ void Handler<Machine, State2, Event2>::handle(
   transit<State3>(s);
 }
 
+struct CompactConnectionState {
+  CompactState<State1, State2, State3> state{State1()};
+  bool visitedState1Event1{false};
+  bool visitedState1Event2{false};
+  bool visitedState2Event2{false};
+};
+
+struct TestCompactMachine {
+  using StateData = CompactConnectionState;
+  using UserData = CompactConnectionState;
+  static void InvalidEventHandler(CompactConnectionState& /*s*/) {
+    throw InvalidHandlerException("invalid state in compact machine");
+  }
+};
+
 namespace test {
 
 class StateMachineTest : public Test {
  public:
   ConnectionState state;
   ConnectionStateT<int> stateT;
+  CompactConnectionState stateCompact;
 };
 
 TEST_F(StateMachineTest, TestTransitions) {
@@ -181,5 +197,31 @@ TEST_F(StateMachineTest, TestTemplateInvalid) {
       invokeHandler<TestMachineT<int>>(stateT, Event1(), stateT),
       InvalidHandlerException);
 }
+
+TEST_F(StateMachineTest, TestCompactTransitions) {
+  EXPECT_EQ(1, sizeof(stateCompact.state));
+  invokeHandler<TestCompactMachine>(stateCompact, Event1(), stateCompact);
+  EXPECT_TRUE(stateCompact.visitedState1Event1);
+  EXPECT_FALSE(stateCompact.visitedState1Event2);
+  EXPECT_FALSE(stateCompact.visitedState2Event2);
+  EXPECT_TRUE(stateCompact.state.is<State2>());
+  EXPECT_EQ(1, stateCompact.state.which());
+
+  invokeHandler<TestCompactMachine>(stateCompact, Event2(), stateCompact);
+  EXPECT_TRUE(stateCompact.visitedState2Event2);
+  EXPECT_TRUE(stateCompact.state.is<State3>());
+  EXPECT_TRUE((matchesStates<decltype(stateCompact.state), State2, State3>(
+      stateCompact.state)));
+  EXPECT_FALSE((matchesStates<decltype(stateCompact.state), State1, State2>(
+      stateCompact.state)));
+}
+
+TEST_F(StateMachineTest, TestCompactInvalid) {
+  stateCompact.state = State2();
+  EXPECT_THROW(
+      invokeHandler<TestCompactMachine>(stateCompact, Event1(), stateCompact),
+      InvalidHandlerException);
+  EXPECT_TRUE(stateCompact.state.is<State2>());
+}
 } // namespace test
 } // namespace quic
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/ccsim/CCSimulator.h>
+
+#include <folly/Conv.h>
+#include <quic/congestion_control/Pacer.h>
+#include <quic/loss/QuicLossFunctions.h>
+#include <quic/state/AckHandlers.h>
+#include <quic/state/QuicStateFunctions.h>
+
+#include <thread>
+
+namespace quic {
+namespace ccsim {
+
+namespace {
+// Sleeping is only precise to a few tens of microseconds, the end of the wait
+// is spun.
+constexpr std::chrono::microseconds kSpinDuration{500us};
+
+TimePoint waitUntil(TimePoint deadline) {
+  auto now = Clock::now();
+  if (deadline - now > kSpinDuration) {
+    std::this_thread::sleep_for(deadline - now - kSpinDuration);
+  }
+  while ((now = Clock::now()) < deadline) {
+  }
+  return now;
+}
+
+PacketNumberSpace packetNumberSpace(const std::string& packetType) {
+  if (packetType == toString(LongHeader::Types::Initial)) {
+    return PacketNumberSpace::Initial;
+  }
+  if (packetType == toString(LongHeader::Types::Handshake)) {
+    return PacketNumberSpace::Handshake;
+  }
+  return PacketNumberSpace::AppData;
+}
+
+bool isRetransmittable(const folly::dynamic& frames) {
+  for (const auto& frame : frames) {
+    auto frameType = frame["frame_type"].asString();
+    if (frameType != toString(FrameType::ACK) &&
+        frameType != toString(FrameType::ACK_ECN) &&
+        frameType != toString(FrameType::PADDING)) {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+uint64_t SimulationStats::throughputBitsPerSecond() const {
+  if (duration == 0us) {
+    return 0;
+  }
+  return ackedBytes * 8 * 1000 * 1000 / duration.count();
+}
+
+std::chrono::microseconds SimulationStats::averageQueueingDelay() const {
+  return acks ? totalQueueingDelay / acks : 0us;
+}
+
+std::chrono::nanoseconds SimulationStats::averageTimePerAck() const {
+  return acks ? ackProcessingTime / acks : std::chrono::nanoseconds(0);
+}
+
+uint64_t SimulationStats::averageCwnd() const {
+  return acks ? totalCwnd / acks : 0;
+}
+
+std::ostream& operator<<(std::ostream& os, const SimulationStats& stats) {
+  os << "duration=" << stats.duration.count() << "us"
+     << " throughput=" << stats.throughputBitsPerSecond() << "bps"
+     << " sent=" << stats.sentPackets << " lost=" << stats.lostPackets
+     << " acks=" << stats.acks
+     << " avgCwnd=" << stats.averageCwnd()
+     << " avgQueueingDelay=" << stats.averageQueueingDelay().count() << "us"
+     << " maxQueueingDelay=" << stats.maxQueueingDelay.count() << "us"
+     << " timePerAck=" << stats.averageTimePerAck().count() << "ns"
+     << " timePerSend="
+     << (stats.sentPackets ? stats.sendProcessingTime.count() /
+                 stats.sentPackets
+                           : 0)
+     << "ns";
+  return os;
+}
+
+CCSimulator::CCSimulator(
+    CongestionControlType type,
+    TransportSettings transportSettings,
+    std::shared_ptr<CongestionControllerFactory> ccFactory)
+    : type_(type),
+      transportSettings_(std::move(transportSettings)),
+      ccFactory_(std::move(ccFactory)),
+      connId_(std::vector<uint8_t>{0x0c, 0xc5, 0x10, 0x00}) {
+  if (type_ == CongestionControlType::None) {
+    throw std::invalid_argument("A congestion controller is required");
+  }
+}
+
+void CCSimulator::reset() {
+  conn_ = std::make_unique<QuicConnectionStateBase>(QuicNodeType::Server);
+  auto& conn = *conn_;
+  conn.transportSettings = transportSettings_;
+  // Same as QuicTransportBase::setTransportSettings() and
+  // setCongestionControl().
+  if (type_ == CongestionControlType::BBR ||
+      type_ == CongestionControlType::BBR2) {
+    conn.transportSettings.pacingEnabled = true;
+  }
+  if (conn.transportSettings.pacingEnabled) {
+    conn.pacer = std::make_unique<DefaultPacer>(
+        conn,
+        (type_ == CongestionControlType::BBR ||
+         type_ == CongestionControlType::BBR2)
+            ? kMinCwndInMssForBbr
+            : conn.transportSettings.minCwndInMss);
+  }
+  conn.congestionController = ccFactory_->makeCongestionController(conn, type_);
+  CHECK(conn.congestionController);
+  stats_ = SimulationStats();
+  lossAlarm_.clear();
+  nextPacedWrite_.clear();
+  ackArrivals_ = decltype(ackArrivals_)();
+}
+
+OutstandingPacket& CCSimulator::sendPacket(
+    PacketNum packetNum,
+    TimePoint sendTime,
+    uint32_t size) {
+  // Same bookkeeping as updateConnection() for a retransmittable packet.
+  auto& conn = *conn_;
+  auto start = Clock::now();
+  RegularQuicWritePacket packet(
+      ShortHeader(ProtectionType::KeyPhaseZero, connId_, packetNum));
+  OutstandingPacket pkt(
+      std::move(packet),
+      sendTime,
+      size,
+      false /* isHandshake */,
+      false /* pureAck */,
+      conn.lossState.totalBytesSent + size);
+  pkt.isAppLimited = conn.congestionController->isAppLimited();
+  if (conn.lossState.lastAckedTime.hasValue() &&
+      conn.lossState.lastAckedPacketSentTime.hasValue()) {
+    pkt.lastAckedPacketInfo.emplace(
+        *conn.lossState.lastAckedPacketSentTime,
+        *conn.lossState.lastAckedTime,
+        conn.lossState.totalBytesSentAtLastAck,
+        conn.lossState.totalBytesAckedAtLastAck);
+  }
+  auto& ackState = getAckState(conn, PacketNumberSpace::AppData);
+  ackState.nextPacketNum = std::max(ackState.nextPacketNum, packetNum + 1);
+  conn.lossState.largestSent = std::max(conn.lossState.largestSent, packetNum);
+  conn.congestionController->onPacketSent(pkt);
+  if (conn.pacer) {
+    conn.pacer->onPacketSent();
+  }
+  conn.lossState.lastRetransmittablePacketSentTime = pkt.time;
+  conn.outstandingPackets.push_back(std::move(pkt));
+  conn.pendingEvents.setLossDetectionAlarm = true;
+  conn.lossState.totalBytesSent += size;
+  ++stats_.sentPackets;
+  stats_.sendProcessingTime += Clock::now() - start;
+  return conn.outstandingPackets.back();
+}
+
+void CCSimulator::processAck(
+    const ReadAckFrame& frame,
+    TimePoint ackTime,
+    folly::Optional<std::chrono::microseconds> queueingDelay) {
+  auto& conn = *conn_;
+  auto ackedBytesBefore = conn.lossState.totalBytesAcked;
+  auto start = Clock::now();
+  processAckFrame(
+      conn,
+      PacketNumberSpace::AppData,
+      frame,
+      [](const auto&, const auto&, const auto&) {},
+      lossVisitor_,
+      ackTime);
+  stats_.ackProcessingTime += Clock::now() - start;
+  auto ackedBytes = conn.lossState.totalBytesAcked - ackedBytesBefore;
+  if (ackedBytes == 0) {
+    return;
+  }
+  ++stats_.acks;
+  stats_.ackedBytes += ackedBytes;
+  stats_.totalCwnd += conn.congestionController->getCongestionWindow();
+  auto delay = queueingDelay.value_or(
+      conn.lossState.lrtt > conn.lossState.mrtt
+          ? conn.lossState.lrtt - conn.lossState.mrtt
+          : 0us);
+  stats_.totalQueueingDelay += delay;
+  stats_.maxQueueingDelay = std::max(stats_.maxQueueingDelay, delay);
+}
+
+void CCSimulator::maybeSetLossAlarm(TimePoint now) {
+  // Same as QuicTransportBase::updateLossDetectionAlarm().
+  auto& conn = *conn_;
+  if (conn.outstandingPackets.empty()) {
+    lossAlarm_.clear();
+    return;
+  }
+  if (!conn.pendingEvents.setLossDetectionAlarm && lossAlarm_) {
+    return;
+  }
+  auto alarm = calculateAlarmDuration(conn);
+  conn.lossState.currentAlarmMethod = alarm.second;
+  lossAlarm_ = now + alarm.first;
+  conn.pendingEvents.setLossDetectionAlarm = false;
+}
+
+void CCSimulator::maybeFireLossAlarm(TimePoint now) {
+  if (!lossAlarm_ || *lossAlarm_ > now) {
+    return;
+  }
+  lossAlarm_.clear();
+  auto start = Clock::now();
+  onLossDetectionAlarm(*conn_, lossVisitor_);
+  stats_.ackProcessingTime += Clock::now() - start;
+  conn_->pendingEvents.setLossDetectionAlarm = true;
+}
+
+void CCSimulator::onLinkPacketSent(const OutstandingPacket& packet) {
+  std::uniform_real_distribution<double> uniform(0, 1);
+  if (uniform(random_) < link_.lossRate) {
+    return;
+  }
+  auto sendTime = packet.time;
+  linkFreeTime_ = std::max(linkFreeTime_, sendTime);
+  auto queueingDelay =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          linkFreeTime_ - sendTime);
+  auto queuedBytes =
+      (uint64_t)queueingDelay.count() * link_.bandwidth / 1000 / 1000;
+  if (queuedBytes + packet.encodedSize > link_.bufferSize) {
+    return;
+  }
+  linkFreeTime_ += std::chrono::microseconds(
+      (uint64_t)packet.encodedSize * 1000 * 1000 / link_.bandwidth);
+  std::chrono::microseconds jitter{0us};
+  if (link_.jitter > 0us) {
+    std::uniform_int_distribution<uint64_t> jitterDist(0, link_.jitter.count());
+    jitter = std::chrono::microseconds(jitterDist(random_));
+  }
+  ackArrivals_.push(AckArrival{
+      linkFreeTime_ + link_.rtt + jitter, packet.packetNum, queueingDelay});
+}
+
+void CCSimulator::writeLinkPackets(TimePoint now) {
+  // Same as the write looper, without the app being ever limited.
+  auto& conn = *conn_;
+  while (conn.pendingEvents.numProbePackets > 0) {
+    --conn.pendingEvents.numProbePackets;
+    onLinkPacketSent(sendPacket(
+        getNextPacketNum(conn, PacketNumberSpace::AppData),
+        now,
+        conn.udpSendPacketLen));
+  }
+  uint64_t batchSize = std::numeric_limits<uint64_t>::max();
+  if (conn.pacer) {
+    if (nextPacedWrite_ && *nextPacedWrite_ > now) {
+      return;
+    }
+    nextPacedWrite_.clear();
+    batchSize = conn.pacer->updateAndGetWriteBatchSize(now);
+  }
+  uint64_t written = 0;
+  while (written < batchSize) {
+    auto writableBytes = conn.congestionController->getWritableBytes();
+    if (writableBytes < kBlockedSizeBytes) {
+      break;
+    }
+    onLinkPacketSent(sendPacket(
+        getNextPacketNum(conn, PacketNumberSpace::AppData),
+        now,
+        std::min<uint64_t>(writableBytes, conn.udpSendPacketLen)));
+    ++written;
+  }
+  if (conn.pacer && (written > 0 || batchSize == 0)) {
+    conn.pacer->onPacedWriteScheduled(now);
+    auto interval = conn.pacer->getTimeUntilNextWrite();
+    if (interval > 0us) {
+      nextPacedWrite_ = now + interval;
+    }
+  }
+}
+
+SimulationStats CCSimulator::runLink(
+    const LinkModel& link,
+    std::chrono::microseconds duration,
+    uint32_t seed) {
+  reset();
+  link_ = link;
+  random_.seed(seed);
+  auto now = Clock::now();
+  auto end = now + duration;
+  linkFreeTime_ = now;
+  while (now < end) {
+    while (!ackArrivals_.empty() && ackArrivals_.top().time <= now) {
+      auto arrival = ackArrivals_.top();
+      ackArrivals_.pop();
+      ReadAckFrame frame;
+      frame.largestAcked = arrival.packetNum;
+      frame.ackBlocks.emplace_back(arrival.packetNum, arrival.packetNum);
+      processAck(frame, now, arrival.queueingDelay);
+    }
+    maybeFireLossAlarm(now);
+    writeLinkPackets(now);
+    maybeSetLossAlarm(now);
+
+    auto next = end;
+    if (!ackArrivals_.empty()) {
+      next = std::min(next, ackArrivals_.top().time);
+    }
+    if (nextPacedWrite_) {
+      next = std::min(next, *nextPacedWrite_);
+    }
+    if (lossAlarm_) {
+      next = std::min(next, *lossAlarm_);
+    }
+    now = waitUntil(next);
+  }
+  stats_.duration = duration;
+  return stats_;
+}
+
+SimulationStats CCSimulator::replay(const folly::dynamic& qlog) {
+  reset();
+  const auto& events = qlog["traces"][0]["events"];
+  auto start = Clock::now();
+  std::chrono::microseconds firstEventTime{0us};
+  std::chrono::microseconds lastEventTime{0us};
+  bool firstEvent = true;
+  for (const auto& event : events) {
+    // relative_time, category, event_type, trigger, data
+    std::chrono::microseconds eventTime{
+        folly::to<uint64_t>(event[0].asString())};
+    const auto& eventType = event[2].asString();
+    const auto& data = event[4];
+    bool sent = eventType == "PACKET_SENT";
+    if ((!sent && eventType != "PACKET_RECEIVED") ||
+        packetNumberSpace(data["packet_type"].asString()) !=
+            PacketNumberSpace::AppData ||
+        !data.count("frames")) {
+      continue;
+    }
+    if (firstEvent) {
+      firstEventTime = eventTime;
+      firstEvent = false;
+    }
+    lastEventTime = eventTime;
+    auto now = waitUntil(start + (eventTime - firstEventTime));
+    maybeFireLossAlarm(now);
+    if (sent) {
+      if (isRetransmittable(data["frames"])) {
+        sendPacket(
+            data["header"]["packet_number"].asInt(),
+            now,
+            data["header"]["packet_size"].asInt());
+      }
+    } else {
+      for (const auto& frame : data["frames"]) {
+        if (frame["frame_type"].asString() != toString(FrameType::ACK) &&
+            frame["frame_type"].asString() != toString(FrameType::ACK_ECN)) {
+          continue;
+        }
+        ReadAckFrame ackFrame;
+        ackFrame.ackDelay =
+            std::chrono::microseconds(frame["ack_delay"].asInt());
+        for (const auto& range : frame["acked_ranges"]) {
+          ackFrame.ackBlocks.emplace_back(range[0].asInt(), range[1].asInt());
+        }
+        if (ackFrame.ackBlocks.empty()) {
+          continue;
+        }
+        ackFrame.largestAcked = ackFrame.ackBlocks.front().endPacket;
+        processAck(ackFrame, now, folly::none);
+      }
+    }
+    maybeSetLossAlarm(now);
+  }
+  stats_.duration = lastEventTime - firstEventTime;
+  return stats_;
+}
+} // namespace ccsim
+} // namespace quic
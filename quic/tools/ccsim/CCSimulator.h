@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/dynamic.h>
+#include <quic/congestion_control/CongestionControllerFactory.h>
+#include <quic/state/AckHandlers.h>
+#include <quic/state/StateData.h>
+
+#include <queue>
+#include <random>
+
+namespace quic {
+namespace ccsim {
+
+/**
+ * A bottleneck link: packets queue up in a drop-tail buffer in front of a
+ * fixed rate link, and the ack of every delivered packet comes back one rtt
+ * after it leaves the queue.
+ */
+struct LinkModel {
+  // Rate of the bottleneck, in bytes per second
+  uint64_t bandwidth{10 * 1000 * 1000 / 8};
+  // Round trip propagation delay, without queueing
+  std::chrono::microseconds rtt{50ms};
+  // Probability that a packet is dropped on top of the buffer overflows
+  double lossRate{0};
+  // Every ack is delayed by a uniformly random extra delay up to jitter
+  std::chrono::microseconds jitter{0us};
+  // Size of the bottleneck buffer in bytes
+  uint64_t bufferSize{64 * 1000};
+};
+
+struct SimulationStats {
+  std::chrono::microseconds duration{0us};
+  uint64_t sentPackets{0};
+  uint64_t lostPackets{0};
+  uint64_t ackedBytes{0};
+  uint64_t acks{0};
+  // Time spent processing the acks and the sends, congestion controller and
+  // pacer included
+  std::chrono::nanoseconds ackProcessingTime{0};
+  std::chrono::nanoseconds sendProcessingTime{0};
+  // Queueing delay of the acked packets. For a replay it is estimated as the
+  // latest rtt above the min rtt.
+  std::chrono::microseconds totalQueueingDelay{0us};
+  std::chrono::microseconds maxQueueingDelay{0us};
+  // Sum of the cwnd sampled on every ack
+  uint64_t totalCwnd{0};
+
+  uint64_t throughputBitsPerSecond() const;
+  std::chrono::microseconds averageQueueingDelay() const;
+  std::chrono::nanoseconds averageTimePerAck() const;
+  uint64_t averageCwnd() const;
+};
+
+std::ostream& operator<<(std::ostream& os, const SimulationStats& stats);
+
+/**
+ * Drives a congestion controller and a pacer through the same ack and loss
+ * processing as the transport, without sockets or a handshake. Either a
+ * sender that always has data runs over a LinkModel, or the packets sent and
+ * the acks received in a qlog written by FileQLogger are replayed as is.
+ *
+ * The controllers read Clock::now() for their recovery and round trip
+ * markers, so the simulation runs on the real clock and takes as long as the
+ * simulated duration: the events are waited for rather than skipped to.
+ */
+class CCSimulator {
+ public:
+  CCSimulator(
+      CongestionControlType type,
+      TransportSettings transportSettings,
+      std::shared_ptr<CongestionControllerFactory> ccFactory =
+          std::make_shared<DefaultCongestionControllerFactory>());
+
+  SimulationStats runLink(
+      const LinkModel& link,
+      std::chrono::microseconds duration,
+      uint32_t seed = 0);
+
+  /**
+   * Replays the application data packets of the first trace of qlog. The
+   * replay is open loop: the controller sees the sends and acks of the trace
+   * but doesn't change them. Losses are detected from the acks.
+   */
+  SimulationStats replay(const folly::dynamic& qlog);
+
+ private:
+  struct AckArrival {
+    TimePoint time;
+    PacketNum packetNum;
+    std::chrono::microseconds queueingDelay;
+
+    bool operator>(const AckArrival& other) const {
+      return time > other.time;
+    }
+  };
+
+  void reset();
+  OutstandingPacket&
+  sendPacket(PacketNum packetNum, TimePoint sendTime, uint32_t size);
+  void processAck(
+      const ReadAckFrame& frame,
+      TimePoint ackTime,
+      folly::Optional<std::chrono::microseconds> queueingDelay);
+  void maybeSetLossAlarm(TimePoint now);
+  void maybeFireLossAlarm(TimePoint now);
+  void writeLinkPackets(TimePoint now);
+  void onLinkPacketSent(const OutstandingPacket& packet);
+
+  std::unique_ptr<QuicConnectionStateBase> conn_;
+  CongestionControlType type_;
+  TransportSettings transportSettings_;
+  std::shared_ptr<CongestionControllerFactory> ccFactory_;
+  ConnectionId connId_;
+  SimulationStats stats_;
+  LossVisitor lossVisitor_{
+      [this](auto&, auto&, bool, PacketNum) { ++stats_.lostPackets; }};
+  folly::Optional<TimePoint> lossAlarm_;
+
+  // Link state of runLink()
+  LinkModel link_;
+  std::mt19937 random_;
+  TimePoint linkFreeTime_;
+  folly::Optional<TimePoint> nextPacedWrite_;
+  std::priority_queue<
+      AckArrival,
+      std::vector<AckArrival>,
+      std::greater<AckArrival>>
+      ackArrivals_;
+};
+} // namespace ccsim
+} // namespace quic
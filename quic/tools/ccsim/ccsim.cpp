@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <glog/logging.h>
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/json.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/tools/ccsim/CCSimulator.h>
+
+#include <iostream>
+
+DEFINE_string(congestion, "cubic", "newreno/cubic/copa/bbr/bbr2");
+DEFINE_bool(pacing, false, "Enable pacing");
+DEFINE_string(
+    qlog,
+    "",
+    "Path to a qlog file written by FileQLogger to replay. The synthetic link "
+    "below is simulated when it is empty.");
+DEFINE_int32(duration, 10, "Duration of the link simulation in seconds");
+DEFINE_uint64(bandwidth_kbps, 10000, "Bandwidth of the bottleneck link");
+DEFINE_uint64(rtt_ms, 50, "Round trip propagation delay of the link");
+DEFINE_double(loss, 0, "Random loss rate of the link, between 0 and 1");
+DEFINE_uint64(jitter_us, 0, "Maximum extra random delay of the acks");
+DEFINE_uint64(buffer_bytes, 64 * 1000, "Size of the bottleneck buffer");
+DEFINE_uint32(seed, 0, "Seed of the random losses and jitter");
+DEFINE_uint32(
+    max_cwnd_mss,
+    quic::kLargeMaxCwndInMss,
+    "Max cwnd in the unit of mss");
+
+quic::CongestionControlType flagsToCongestionControlType(
+    const std::string& congestionControlType) {
+  if (congestionControlType == "cubic") {
+    return quic::CongestionControlType::Cubic;
+  } else if (congestionControlType == "newreno") {
+    return quic::CongestionControlType::NewReno;
+  } else if (congestionControlType == "bbr") {
+    return quic::CongestionControlType::BBR;
+  } else if (congestionControlType == "bbr2") {
+    return quic::CongestionControlType::BBR2;
+  } else if (congestionControlType == "copa") {
+    return quic::CongestionControlType::Copa;
+  }
+  throw std::invalid_argument(folly::to<std::string>(
+      "Unknown congestion controller ", congestionControlType));
+}
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  quic::TransportSettings settings;
+  settings.pacingEnabled = FLAGS_pacing;
+  settings.maxCwndInMss = FLAGS_max_cwnd_mss;
+  quic::ccsim::CCSimulator simulator(
+      flagsToCongestionControlType(FLAGS_congestion), settings);
+
+  quic::ccsim::SimulationStats stats;
+  if (!FLAGS_qlog.empty()) {
+    std::string contents;
+    if (!folly::readFile(FLAGS_qlog.c_str(), contents)) {
+      LOG(ERROR) << "Could not read " << FLAGS_qlog;
+      return 1;
+    }
+    stats = simulator.replay(folly::parseJson(contents));
+  } else {
+    quic::ccsim::LinkModel link;
+    link.bandwidth = FLAGS_bandwidth_kbps * 1000 / 8;
+    link.rtt = std::chrono::milliseconds(FLAGS_rtt_ms);
+    link.lossRate = FLAGS_loss;
+    link.jitter = std::chrono::microseconds(FLAGS_jitter_us);
+    link.bufferSize = FLAGS_buffer_bytes;
+    stats = simulator.runLink(
+        link, std::chrono::seconds(FLAGS_duration), FLAGS_seed);
+  }
+  std::cout << FLAGS_congestion << " " << stats << std::endl;
+  return 0;
+}
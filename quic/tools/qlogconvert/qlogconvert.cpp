@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <glog/logging.h>
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <folly/json.h>
+#include <folly/portability/GFlags.h>
+
+#include <quic/logging/BinaryQLogger.h>
+
+#include <iostream>
+
+DEFINE_string(input, "", "Path to a qlog written by BinaryQLogger");
+DEFINE_string(
+    output,
+    "",
+    "Path of the JSON qlog to write, it is written to stdout when empty");
+DEFINE_bool(pretty, false, "Pretty print the JSON");
+
+int main(int argc, char* argv[]) {
+#if FOLLY_HAVE_LIBGFLAGS
+  // Enable glog logging to stderr by default.
+  gflags::SetCommandLineOptionWithMode(
+      "logtostderr", "1", gflags::SET_FLAGS_DEFAULT);
+#endif
+  gflags::ParseCommandLineFlags(&argc, &argv, false);
+  folly::Init init(&argc, &argv);
+
+  std::string contents;
+  if (!folly::readFile(FLAGS_input.c_str(), contents)) {
+    LOG(ERROR) << "Could not read " << FLAGS_input;
+    return 1;
+  }
+  std::unique_ptr<quic::FileQLogger> qLogger;
+  try {
+    qLogger = quic::parseBinaryQLog(folly::StringPiece(contents));
+  } catch (const std::invalid_argument& ex) {
+    LOG(ERROR) << "Could not parse " << FLAGS_input << ": " << ex.what();
+    return 1;
+  }
+  auto json = FLAGS_pretty ? folly::toPrettyJson(qLogger->toDynamic())
+                           : folly::toJson(qLogger->toDynamic());
+  if (FLAGS_output.empty()) {
+    std::cout << json << std::endl;
+  } else if (!folly::writeFile(json, FLAGS_output.c_str())) {
+    LOG(ERROR) << "Could not write " << FLAGS_output;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#include <quic/tools/tperf/CpuProfile.h>
+
+#include <glog/logging.h>
+#include <sys/resource.h>
+
+#include <folly/chrono/Hardware.h>
+
+namespace quic {
+namespace tperf {
+
+namespace {
+constexpr folly::StringPiece kScheduling = "SCHEDULING";
+} // namespace
+
+void CpuProfile::start(const QuicSocket& sock) {
+  startTime_ = Clock::now();
+  startTimestamp_ = folly::hardware_timestamp();
+  startCpuTime_ = threadCpuTime();
+  startCycles_ = sock.getTransportInfo().cpuCycles;
+}
+
+void CpuProfile::stop(const QuicSocket& sock) {
+  wallTime_ = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - startTime_);
+  auto timestamp = folly::hardware_timestamp();
+  timestamps_ = timestamp > startTimestamp_ ? timestamp - startTimestamp_ : 0;
+  cpuTime_ = threadCpuTime() - startCpuTime_;
+  auto cycles = sock.getTransportInfo().cpuCycles;
+  for (size_t i = 0; i < cycles.size(); ++i) {
+    cycles_[i] = cycles[i] - startCycles_[i];
+  }
+}
+
+std::chrono::microseconds CpuProfile::threadCpuTime() {
+  struct rusage usage;
+#ifdef RUSAGE_THREAD
+  getrusage(RUSAGE_THREAD, &usage);
+#else
+  getrusage(RUSAGE_SELF, &usage);
+#endif
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+      std::chrono::microseconds(
+             usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+uint64_t CpuProfile::cycles(
+    QuicTransportStatsCallback::CpuCostType type) const {
+  return cycles_[static_cast<size_t>(type)];
+}
+
+uint64_t CpuProfile::schedulingCycles() const {
+  using CpuCostType = QuicTransportStatsCallback::CpuCostType;
+  // The sampled scopes don't line up, so the nested ones can add up to more
+  // than the write loops.
+  auto writeLoop = cycles(CpuCostType::WRITE_LOOP);
+  auto nested =
+      cycles(CpuCostType::PACKET_ENCRYPT) + cycles(CpuCostType::SOCKET_WRITE);
+  return writeLoop > nested ? writeLoop - nested : 0;
+}
+
+std::chrono::microseconds CpuProfile::toTime(uint64_t cycles) const {
+  if (timestamps_ == 0 || wallTime_.count() == 0) {
+    return std::chrono::microseconds(0);
+  }
+  return std::chrono::microseconds(static_cast<uint64_t>(
+      static_cast<double>(cycles) * wallTime_.count() / timestamps_));
+}
+
+void CpuProfile::log(folly::StringPiece direction) const {
+  double wallSeconds = wallTime_.count() / 1000000.0;
+  double cpuSeconds = cpuTime_.count() / 1000000.0;
+  LOG(INFO) << direction << " CPU: " << cpuSeconds << " seconds in "
+            << wallSeconds << " seconds, "
+            << (wallSeconds > 0 ? 100 * cpuSeconds / wallSeconds : 0)
+            << "% utilization";
+  auto logPhase = [&](folly::StringPiece name, uint64_t phaseCycles) {
+    auto time = toTime(phaseCycles);
+    LOG(INFO) << direction << " " << name << ": " << phaseCycles
+              << " cycles, " << time.count() << "us, "
+              << (cpuTime_.count() > 0 ? 100.0 * time.count() / cpuTime_.count()
+                                       : 0)
+              << "% of CPU";
+  };
+  for (size_t i = 0; i < cycles_.size(); ++i) {
+    logPhase(
+        QuicTransportStatsCallback::toString(
+            static_cast<QuicTransportStatsCallback::CpuCostType>(i)),
+        cycles_[i]);
+  }
+  logPhase(kScheduling, schedulingCycles());
+}
+
+folly::dynamic CpuProfile::toDynamic() const {
+  folly::dynamic phases = folly::dynamic::object;
+  auto addPhase = [&](folly::StringPiece name, uint64_t phaseCycles) {
+    phases[name] = folly::dynamic::object("cycles", phaseCycles)(
+        "time_us", toTime(phaseCycles).count());
+  };
+  for (size_t i = 0; i < cycles_.size(); ++i) {
+    addPhase(
+        QuicTransportStatsCallback::toString(
+            static_cast<QuicTransportStatsCallback::CpuCostType>(i)),
+        cycles_[i]);
+  }
+  addPhase(kScheduling, schedulingCycles());
+  return folly::dynamic::object("wall_time_us", wallTime_.count())(
+      "cpu_time_us", cpuTime_.count())(
+      "cpu_utilization",
+      wallTime_.count() > 0
+          ? static_cast<double>(cpuTime_.count()) / wallTime_.count()
+          : 0.0)("phases", std::move(phases));
+}
+} // namespace tperf
+} // namespace quic
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ *
+ */
+
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+#include <quic/api/QuicSocket.h>
+
+#include <array>
+#include <chrono>
+
+namespace quic {
+namespace tperf {
+
+/**
+ * The CPU time of the calling thread and the cycles a connection spent in
+ * each QuicTransportStatsCallback::CpuCostType between start() and stop().
+ * The cycles are only counted with TransportSettings::cpuCostSamplingRate,
+ * and are turned into time with the rate the time stamp counter ran at over
+ * the same period.
+ *
+ * Besides the CpuCostTypes, the breakdown has SCHEDULING, the part of the
+ * write loops that wasn't spent encrypting or writing to the socket.
+ */
+class CpuProfile {
+ public:
+  void start(const QuicSocket& sock);
+  void stop(const QuicSocket& sock);
+
+  void log(folly::StringPiece direction) const;
+
+  folly::dynamic toDynamic() const;
+
+ private:
+  using Cycles = std::array<uint64_t, CpuCostState::kNumTypes>;
+
+  static std::chrono::microseconds threadCpuTime();
+
+  uint64_t cycles(QuicTransportStatsCallback::CpuCostType type) const;
+  uint64_t schedulingCycles() const;
+  std::chrono::microseconds toTime(uint64_t cycles) const;
+
+  TimePoint startTime_;
+  std::chrono::microseconds wallTime_{0};
+  uint64_t startTimestamp_{0};
+  uint64_t timestamps_{0};
+  std::chrono::microseconds startCpuTime_{0};
+  std::chrono::microseconds cpuTime_{0};
+  Cycles startCycles_{};
+  Cycles cycles_{};
+};
+} // namespace tperf
+} // namespace quic
@@ -8,17 +8,26 @@
 
 #include <glog/logging.h>
 
+#include <sys/resource.h>
+#include <thread>
+#include <unordered_map>
+
 #include <fizz/crypto/Utils.h>
+#include <folly/FileUtil.h>
 #include <folly/init/Init.h>
+#include <folly/io/Cursor.h>
 #include <folly/io/async/HHWheelTimer.h>
+#include <folly/json.h>
 #include <folly/portability/GFlags.h>
 
 #include <quic/client/QuicClientTransport.h>
+#include <quic/common/LatencyHistogram.h>
 #include <quic/common/test/TestUtils.h>
 #include <quic/congestion_control/CongestionControllerFactory.h>
 #include <quic/server/QuicServer.h>
 #include <quic/server/QuicServerTransport.h>
 #include <quic/server/QuicSharedUDPSocketFactory.h>
+#include <quic/tools/tperf/CpuProfile.h>
 #include <quic/tools/tperf/PacingObserver.h>
 #include <quic/tools/tperf/TperfQLogger.h>
 
@@ -32,7 +41,7 @@ DEFINE_uint64(
     "Amount of data written to stream each iteration");
 DEFINE_uint64(writes_per_loop, 5, "Amount of socket writes per event loop");
 DEFINE_uint64(window, 64 * 1024, "Flow control window size");
-DEFINE_string(congestion, "newreno", "newreno/cubic/bbr/none");
+DEFINE_string(congestion, "newreno", "newreno/cubic/bbr/bbr2/none");
 DEFINE_bool(pacing, false, "Enable pacing");
 DEFINE_bool(gso, false, "Enable GSO writes to the socket");
 DEFINE_uint32(
@@ -49,10 +58,66 @@ DEFINE_uint32(
     quic::kLargeMaxCwndInMss,
     "Max cwnd in the unit of mss");
 DEFINE_uint32(num_streams, 1, "Number of streams to send on simultaneously");
+DEFINE_string(
+    workload,
+    "bulk",
+    "'bulk': the server sends data on num_streams streams as fast as it can. "
+    "'rpc': the client runs request/response RPCs on bidirectional streams. "
+    "Both ends have to use the same workload");
+DEFINE_uint32(
+    num_connections,
+    1,
+    "Number of concurrent client connections, rpc workload only");
+DEFINE_uint32(
+    client_threads,
+    1,
+    "Number of client threads the connections are spread over, rpc workload "
+    "only");
+DEFINE_uint64(request_size, 64, "Size of the RPC requests, at least 8 bytes");
+DEFINE_uint64(response_size, 1024, "Size of the RPC responses");
+DEFINE_uint32(concurrent_rpcs, 1, "Number of outstanding RPCs per connection");
+DEFINE_uint64(
+    rpcs_per_connection,
+    0,
+    "Number of RPCs after which a connection is closed and a new one opened, "
+    "to measure handshakes. 0 keeps the connections for the whole test");
+DEFINE_uint32(
+    cpu_cost_sampling_rate,
+    16,
+    "One out of how many calls of each phase have their CPU cycles measured, "
+    "for the per-phase breakdown of the bulk workload. 0 disables it");
+DEFINE_string(
+    json_output,
+    "",
+    "Path of a JSON file the results of the bulk workload are written to, "
+    "the client's when the test ends and the server's when a connection "
+    "ends");
 
 namespace quic {
 namespace tperf {
 
+namespace {
+folly::dynamic flagsToDynamic() {
+  return folly::dynamic::object("duration_s", FLAGS_duration)(
+      "block_size", FLAGS_block_size)("writes_per_loop", FLAGS_writes_per_loop)(
+      "window", FLAGS_window)("congestion", FLAGS_congestion)(
+      "pacing", FLAGS_pacing)("gso", FLAGS_gso)(
+      "max_cwnd_mss", FLAGS_max_cwnd_mss)("num_streams", FLAGS_num_streams)(
+      "cpu_cost_sampling_rate", FLAGS_cpu_cost_sampling_rate);
+}
+
+void writeJsonResult(folly::dynamic result) {
+  if (FLAGS_json_output.empty()) {
+    return;
+  }
+  result["flags"] = flagsToDynamic();
+  if (!folly::writeFile(
+          folly::toPrettyJson(result), FLAGS_json_output.c_str())) {
+    LOG(ERROR) << "Could not write " << FLAGS_json_output;
+  }
+}
+} // namespace
+
 class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
                             public quic::QuicSocket::ReadCallback,
                             public quic::QuicSocket::WriteCallback {
@@ -60,15 +125,19 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   explicit ServerStreamHandler(
       folly::EventBase* evbIn,
       uint64_t blockSize,
-      uint32_t numStreams)
-      : evb_(evbIn), blockSize_(blockSize), numStreams_(numStreams) {}
+      uint32_t numStreams,
+      bool rpc)
+      : evb_(evbIn),
+        blockSize_(blockSize),
+        numStreams_(numStreams),
+        rpc_(rpc) {}
 
   void setQuicSocket(std::shared_ptr<quic::QuicSocket> socket) {
     sock_ = socket;
   }
 
   void onNewBidirectionalStream(quic::StreamId id) noexcept override {
-    LOG(INFO) << "Got bidirectional stream id=" << id;
+    VLOG_IF(1, !rpc_) << "Got bidirectional stream id=" << id;
     sock_->setReadCallback(id, this);
   }
 
@@ -84,17 +153,25 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   }
 
   void onConnectionEnd() noexcept override {
-    LOG(INFO) << "Socket closed";
+    LOG_IF(INFO, !rpc_) << "Socket closed";
+    report();
     sock_.reset();
   }
 
   void onConnectionError(
       std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
     LOG(ERROR) << "Socket error=" << toString(error.first);
+    report();
   }
 
   void onTransportReady() noexcept override {
+    if (rpc_) {
+      // The client opens a stream per RPC.
+      return;
+    }
     LOG(INFO) << "Starting sends to client.";
+    cpuProfile_.start(*sock_);
+    profiling_ = true;
     for (uint32_t i = 0; i < numStreams_; i++) {
       auto stream = sock_->createUnidirectionalStream();
       CHECK(stream.hasValue());
@@ -112,7 +189,37 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   }
 
   void readAvailable(quic::StreamId id) noexcept override {
-    LOG(INFO) << "read available for stream id=" << id;
+    if (!rpc_) {
+      LOG(INFO) << "read available for stream id=" << id;
+      return;
+    }
+    auto readData = sock_->read(id, 0);
+    if (readData.hasError()) {
+      LOG(ERROR) << "Failed read from stream=" << id
+                 << ", error=" << toString(readData.error());
+      return;
+    }
+    // The request starts with the size of the response, big endian.
+    auto& request = requests_[id];
+    if (readData->first) {
+      folly::io::Cursor cursor(readData->first.get());
+      while (request.headerBytes < sizeof(uint64_t) && !cursor.isAtEnd()) {
+        request.responseSize =
+            (request.responseSize << 8) | cursor.read<uint8_t>();
+        ++request.headerBytes;
+      }
+    }
+    if (!readData->second) {
+      return;
+    }
+    auto responseSize = request.responseSize;
+    requests_.erase(id);
+    auto buf = folly::IOBuf::create(responseSize);
+    buf->append(responseSize);
+    auto res = sock_->writeChain(id, std::move(buf), true, false, nullptr);
+    if (res.hasError()) {
+      LOG(ERROR) << "Got error on write: " << quic::toString(res.error());
+    }
   }
 
   void readError(
@@ -156,18 +263,40 @@ class ServerStreamHandler : public quic::QuicSocket::ConnectionCallback,
   }
 
  private:
+  void report() {
+    if (!profiling_ || !sock_) {
+      return;
+    }
+    profiling_ = false;
+    cpuProfile_.stop(*sock_);
+    auto bytesSent = sock_->getTransportInfo().bytesSent;
+    LOG(INFO) << "Sent " << bytesSent << " bytes";
+    cpuProfile_.log("Send");
+    writeJsonResult(folly::dynamic::object("direction", "send")(
+        "bytes", bytesSent)("cpu", cpuProfile_.toDynamic()));
+  }
+
+  struct RpcRequest {
+    size_t headerBytes{0};
+    uint64_t responseSize{0};
+  };
+
   std::shared_ptr<quic::QuicSocket> sock_;
   folly::EventBase* evb_;
   uint64_t blockSize_;
   uint32_t numStreams_;
+  bool rpc_;
+  std::unordered_map<quic::StreamId, RpcRequest> requests_;
+  CpuProfile cpuProfile_;
+  bool profiling_{false};
 };
 
 class TPerfServerTransportFactory : public quic::QuicServerTransportFactory {
  public:
   ~TPerfServerTransportFactory() override = default;
 
-  explicit TPerfServerTransportFactory(uint64_t blockSize, uint32_t numStreams)
-      : blockSize_(blockSize), numStreams_(numStreams) {}
+  TPerfServerTransportFactory(uint64_t blockSize, uint32_t numStreams, bool rpc)
+      : blockSize_(blockSize), numStreams_(numStreams), rpc_(rpc) {}
 
   quic::QuicServerTransport::Ptr make(
       folly::EventBase* evb,
@@ -176,8 +305,8 @@ class TPerfServerTransportFactory : public quic::QuicServerTransportFactory {
       std::shared_ptr<const fizz::server::FizzServerContext>
           ctx) noexcept override {
     CHECK_EQ(evb, sock->getEventBase());
-    auto serverHandler =
-        std::make_unique<ServerStreamHandler>(evb, blockSize_, numStreams_);
+    auto serverHandler = std::make_unique<ServerStreamHandler>(
+        evb, blockSize_, numStreams_, rpc_);
     auto transport = quic::QuicServerTransport::make(
         evb, std::move(sock), *serverHandler, ctx);
     if (!FLAGS_server_qlogger_path.empty()) {
@@ -196,6 +325,7 @@ class TPerfServerTransportFactory : public quic::QuicServerTransportFactory {
   std::vector<std::unique_ptr<ServerStreamHandler>> handlers_;
   uint64_t blockSize_;
   uint32_t numStreams_;
+  bool rpc_;
 };
 
 class TPerfServer {
@@ -209,16 +339,19 @@ class TPerfServer {
       bool gso,
       uint32_t maxCwndInMss,
       bool pacing,
-      uint32_t numStreams)
+      uint32_t numStreams,
+      bool rpc)
       : host_(host), port_(port), server_(QuicServer::createQuicServer()) {
     server_->setQuicServerTransportFactory(
-        std::make_unique<TPerfServerTransportFactory>(blockSize, numStreams));
+        std::make_unique<TPerfServerTransportFactory>(
+            blockSize, numStreams, rpc));
     auto serverCtx = quic::test::createServerCtx();
     serverCtx->setClock(std::make_shared<fizz::SystemClock>());
     server_->setFizzContext(serverCtx);
     quic::TransportSettings settings;
     settings.maxCwndInMss = maxCwndInMss;
     settings.writeConnectionDataPacketsLimit = writesPerLoop;
+    settings.cpuCostSamplingRate = FLAGS_cpu_cost_sampling_rate;
     settings.defaultCongestionController = congestionControlType;
     settings.pacingEnabled = pacing;
     if (pacing) {
@@ -269,16 +402,20 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
         congestionControlType_(congestionControlType) {}
 
   void timeoutExpired() noexcept override {
+    cpuProfile_.stop(*quicClient_);
     quicClient_->closeNow(folly::none);
     constexpr double bytesPerMegabit = 131072;
+    auto throughput = (receivedBytes_ / bytesPerMegabit) / duration_.count();
     LOG(INFO) << "Received " << receivedBytes_ << " bytes in "
               << duration_.count() << " seconds.";
-    LOG(INFO) << "Overall throughput: "
-              << (receivedBytes_ / bytesPerMegabit) / duration_.count()
-              << "Mb/s";
+    LOG(INFO) << "Overall throughput: " << throughput << "Mb/s";
     for (auto& p : bytesPerStream_) {
       LOG(INFO) << "Received " << p.second << " bytes on stream " << p.first;
     }
+    cpuProfile_.log("Receive");
+    writeJsonResult(folly::dynamic::object("direction", "receive")(
+        "bytes", receivedBytes_)("throughput_mbps", throughput)(
+        "cpu", cpuProfile_.toDynamic()));
   }
 
   virtual void callbackCanceled() noexcept override {}
@@ -313,6 +450,9 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
 
   void onNewUnidirectionalStream(quic::StreamId id) noexcept override {
     LOG(INFO) << "TPerfClient: new unidirectional stream=" << id;
+    if (!isScheduled()) {
+      cpuProfile_.start(*quicClient_);
+    }
     eventBase_.timer().scheduleTimeout(this, duration_);
     quicClient_->setReadCallback(id, this);
   }
@@ -373,7 +513,9 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
         std::numeric_limits<uint32_t>::max();
     settings.connectUDP = true;
     settings.defaultCongestionController = congestionControlType_;
-    if (congestionControlType_ == quic::CongestionControlType::BBR) {
+    settings.cpuCostSamplingRate = FLAGS_cpu_cost_sampling_rate;
+    if (congestionControlType_ == quic::CongestionControlType::BBR ||
+        congestionControlType_ == quic::CongestionControlType::BBR2) {
       settings.pacingEnabled = true;
       settings.pacingTimerTickInterval = 200us;
     }
@@ -397,12 +539,405 @@ class TPerfClient : public quic::QuicSocket::ConnectionCallback,
   folly::EventBase eventBase_;
   size_t receivedBytes_{0};
   std::map<quic::StreamId, size_t> bytesPerStream_;
+  CpuProfile cpuProfile_;
   std::chrono::seconds duration_;
   uint64_t window_;
   bool gso_;
   quic::CongestionControlType congestionControlType_;
 };
 
+struct RpcOptions {
+  uint64_t requestSize;
+  uint64_t responseSize;
+  uint32_t concurrentRpcs;
+  uint64_t rpcsPerConnection;
+  uint64_t window;
+  bool gso;
+  quic::CongestionControlType congestionControlType;
+};
+
+/**
+ * What the connections of a client thread measured. The threads merge theirs
+ * once they are done.
+ */
+struct RpcStats {
+  LatencyHistogram rpcLatency;
+  LatencyHistogram handshakeLatency;
+  uint64_t rpcs{0};
+  uint64_t handshakes{0};
+  uint64_t failedConnections{0};
+  uint64_t bytesSent{0};
+  uint64_t bytesReceived{0};
+
+  void merge(const RpcStats& other) {
+    rpcLatency.merge(other.rpcLatency);
+    handshakeLatency.merge(other.handshakeLatency);
+    rpcs += other.rpcs;
+    handshakes += other.handshakes;
+    failedConnections += other.failedConnections;
+    bytesSent += other.bytesSent;
+    bytesReceived += other.bytesReceived;
+  }
+};
+
+/**
+ * A client connection that keeps concurrentRpcs RPCs outstanding until the
+ * deadline, each on its own bidirectional stream. When rpcsPerConnection is
+ * set, the connection is replaced by a new one after that many RPCs.
+ */
+class RpcClientConnection : public quic::QuicSocket::ConnectionCallback,
+                            public quic::QuicSocket::ReadCallback,
+                            public folly::EventBase::LoopCallback {
+ public:
+  RpcClientConnection(
+      folly::EventBase* evb,
+      const folly::SocketAddress& addr,
+      const RpcOptions& options,
+      RpcStats& stats,
+      TimePoint deadline,
+      folly::Function<void()> onDone)
+      : evb_(evb),
+        addr_(addr),
+        options_(options),
+        stats_(stats),
+        deadline_(deadline),
+        onDone_(std::move(onDone)) {}
+
+  ~RpcClientConnection() override {
+    close();
+  }
+
+  void connect() {
+    auto sock = std::make_unique<folly::AsyncUDPSocket>(evb_);
+    quicClient_ =
+        std::make_shared<quic::QuicClientTransport>(evb_, std::move(sock));
+    quicClient_->setHostname("tperf");
+    quicClient_->setCertificateVerifier(test::createTestCertificateVerifier());
+    quicClient_->addNewPeerAddress(addr_);
+    quicClient_->setCongestionControllerFactory(
+        std::make_shared<DefaultCongestionControllerFactory>());
+    auto settings = quicClient_->getTransportSettings();
+    settings.advertisedInitialBidiLocalStreamWindowSize = options_.window;
+    settings.connectUDP = true;
+    settings.defaultCongestionController = options_.congestionControlType;
+    if (options_.gso) {
+      settings.batchingMode = QuicBatchingMode::BATCHING_MODE_GSO;
+      settings.maxBatchSize = 16;
+    }
+    quicClient_->setTransportSettings(settings);
+    connectTime_ = Clock::now();
+    rpcsOnConnection_ = 0;
+    quicClient_->start(this);
+  }
+
+  void stop() {
+    close();
+    done();
+  }
+
+  void onTransportReady() noexcept override {
+    ++stats_.handshakes;
+    stats_.handshakeLatency.addValue(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - connectTime_));
+    for (uint32_t i = 0; i < options_.concurrentRpcs; ++i) {
+      if (!sendRequest()) {
+        break;
+      }
+    }
+    if (rpcStartTimes_.empty()) {
+      finishConnection();
+    }
+  }
+
+  void readAvailable(quic::StreamId id) noexcept override {
+    auto readData = quicClient_->read(id, 0);
+    if (readData.hasError()) {
+      LOG(ERROR) << "RpcClientConnection failed read from stream=" << id
+                 << ", error=" << toString(readData.error());
+      return;
+    }
+    if (readData->first) {
+      stats_.bytesReceived += readData->first->computeChainDataLength();
+    }
+    if (!readData->second) {
+      return;
+    }
+    auto it = rpcStartTimes_.find(id);
+    if (it == rpcStartTimes_.end()) {
+      return;
+    }
+    ++stats_.rpcs;
+    stats_.rpcLatency.addValue(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - it->second));
+    rpcStartTimes_.erase(it);
+    sendRequest();
+    if (rpcStartTimes_.empty()) {
+      finishConnection();
+    }
+  }
+
+  void readError(
+      quic::StreamId id,
+      std::pair<quic::QuicErrorCode, folly::Optional<folly::StringPiece>>
+          error) noexcept override {
+    LOG(ERROR) << "RpcClientConnection failed read from stream=" << id
+               << ", error=" << toString(error);
+    rpcStartTimes_.erase(id);
+  }
+
+  void onNewBidirectionalStream(quic::StreamId) noexcept override {}
+
+  void onNewUnidirectionalStream(quic::StreamId) noexcept override {}
+
+  void onStopSending(
+      quic::StreamId,
+      quic::ApplicationErrorCode) noexcept override {}
+
+  void onConnectionEnd() noexcept override {
+    // Nothing to do if we closed the connection ourselves.
+    if (quicClient_) {
+      quicClient_.reset();
+      done();
+    }
+  }
+
+  void onConnectionError(
+      std::pair<quic::QuicErrorCode, std::string> error) noexcept override {
+    if (quicClient_) {
+      LOG(ERROR) << "RpcClientConnection error: " << toString(error.first);
+      ++stats_.failedConnections;
+      quicClient_.reset();
+      done();
+    }
+  }
+
+  void runLoopCallback() noexcept override {
+    if (!quicClient_ || !rpcStartTimes_.empty()) {
+      return;
+    }
+    close();
+    if (Clock::now() < deadline_) {
+      connect();
+    } else {
+      done();
+    }
+  }
+
+ private:
+  bool sendRequest() {
+    if (Clock::now() >= deadline_ ||
+        (options_.rpcsPerConnection &&
+         rpcsOnConnection_ >= options_.rpcsPerConnection)) {
+      return false;
+    }
+    auto stream = quicClient_->createBidirectionalStream();
+    if (stream.hasError()) {
+      LOG(ERROR) << "RpcClientConnection failed to create a stream, error="
+                 << toString(stream.error());
+      return false;
+    }
+    // The request starts with the size of the response, big endian.
+    auto requestSize =
+        std::max<uint64_t>(options_.requestSize, sizeof(uint64_t));
+    auto buf = folly::IOBuf::create(requestSize);
+    buf->append(requestSize);
+    memset(buf->writableData(), 0, requestSize);
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      buf->writableData()[i] =
+          (options_.responseSize >> (8 * (sizeof(uint64_t) - 1 - i))) & 0xff;
+    }
+    quicClient_->setReadCallback(*stream, this);
+    auto res = quicClient_->writeChain(*stream, std::move(buf), true, false);
+    if (res.hasError()) {
+      LOG(ERROR) << "RpcClientConnection write error="
+                 << toString(res.error());
+      return false;
+    }
+    stats_.bytesSent += requestSize;
+    rpcStartTimes_.emplace(*stream, Clock::now());
+    ++rpcsOnConnection_;
+    return true;
+  }
+
+  // Called once the connection has no RPC left. The transport is closed from
+  // the next loop rather than from within its own callback.
+  void finishConnection() {
+    if (!isLoopCallbackScheduled()) {
+      evb_->runInLoop(this);
+    }
+  }
+
+  // The connection callbacks see a null quicClient_ while we close it.
+  void close() {
+    if (quicClient_) {
+      auto client = std::move(quicClient_);
+      client->closeNow(folly::none);
+    }
+    rpcStartTimes_.clear();
+  }
+
+  void done() {
+    if (!isDone_) {
+      isDone_ = true;
+      onDone_();
+    }
+  }
+
+  folly::EventBase* evb_;
+  folly::SocketAddress addr_;
+  const RpcOptions& options_;
+  RpcStats& stats_;
+  TimePoint deadline_;
+  folly::Function<void()> onDone_;
+  std::shared_ptr<quic::QuicClientTransport> quicClient_;
+  TimePoint connectTime_;
+  uint64_t rpcsOnConnection_{0};
+  std::unordered_map<quic::StreamId, TimePoint> rpcStartTimes_;
+  bool isDone_{false};
+};
+
+/**
+ * Spreads numConnections RpcClientConnections over numThreads threads, each
+ * with its own EventBase, and logs the RPC latencies, the handshake rate and
+ * the CPU time per GB transferred once they are done.
+ */
+class RpcTPerfClient {
+ public:
+  RpcTPerfClient(
+      const std::string& host,
+      uint16_t port,
+      std::chrono::milliseconds transportTimerResolution,
+      int32_t duration,
+      uint32_t numConnections,
+      uint32_t numThreads,
+      RpcOptions options)
+      : addr_(host.c_str(), port),
+        transportTimerResolution_(transportTimerResolution),
+        duration_(duration),
+        numConnections_(numConnections),
+        numThreads_(std::max<uint32_t>(numThreads, 1)),
+        options_(options) {}
+
+  void start() {
+    LOG(INFO) << "RpcTPerfClient connecting " << numConnections_
+              << " connections from " << numThreads_ << " threads to "
+              << addr_.describe();
+    struct rusage startUsage;
+    getrusage(RUSAGE_SELF, &startUsage);
+    auto startTime = Clock::now();
+    auto deadline = startTime + duration_;
+    std::vector<RpcStats> threadStats(numThreads_);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < numThreads_; ++i) {
+      uint32_t threadConnections = numConnections_ / numThreads_ +
+          (i < numConnections_ % numThreads_ ? 1 : 0);
+      threads.emplace_back(
+          [this, i, threadConnections, deadline, &threadStats] {
+            runThread(threadConnections, deadline, threadStats[i]);
+          });
+    }
+    RpcStats stats;
+    for (uint32_t i = 0; i < numThreads_; ++i) {
+      threads[i].join();
+      stats.merge(threadStats[i]);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - startTime);
+    struct rusage endUsage;
+    getrusage(RUSAGE_SELF, &endUsage);
+    report(stats, elapsed, cpuTime(endUsage) - cpuTime(startUsage));
+  }
+
+ private:
+  void runThread(uint32_t numConnections, TimePoint deadline, RpcStats& stats) {
+    folly::EventBase evb(transportTimerResolution_);
+    uint32_t remaining = numConnections;
+    std::vector<std::unique_ptr<RpcClientConnection>> connections;
+    for (uint32_t i = 0; i < numConnections; ++i) {
+      connections.push_back(std::make_unique<RpcClientConnection>(
+          &evb, addr_, options_, stats, deadline, [&evb, &remaining] {
+            if (--remaining == 0) {
+              evb.terminateLoopSoon();
+            }
+          }));
+    }
+    for (auto& connection : connections) {
+      connection->connect();
+    }
+    // The RPCs still outstanding past the deadline get a grace period.
+    StopTimeout stopTimeout(connections);
+    evb.timer().scheduleTimeout(
+        &stopTimeout,
+        std::max(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - Clock::now() + kRpcGracePeriod),
+            std::chrono::milliseconds(0)));
+    if (numConnections) {
+      evb.loopForever();
+    }
+  }
+
+  static std::chrono::microseconds cpuTime(const struct rusage& usage) {
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+        std::chrono::microseconds(
+               usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+  }
+
+  void report(
+      const RpcStats& stats,
+      std::chrono::microseconds elapsed,
+      std::chrono::microseconds cpu) {
+    double seconds = std::max(elapsed.count(), int64_t(1)) / 1000000.0;
+    double gigabytes = (stats.bytesSent + stats.bytesReceived) / 1e9;
+    LOG(INFO) << "RPCs: " << stats.rpcs << " in " << seconds << " seconds, "
+              << stats.rpcs / seconds << " RPC/s";
+    LOG(INFO) << "RPC latency: p50="
+              << stats.rpcLatency.getPercentile(50).count()
+              << "us p99=" << stats.rpcLatency.getPercentile(99).count()
+              << "us p999=" << stats.rpcLatency.getPercentile(99.9).count()
+              << "us max=" << stats.rpcLatency.max().count() << "us";
+    LOG(INFO) << "Handshakes: " << stats.handshakes << ", "
+              << stats.handshakes / seconds << " handshakes/s, p50="
+              << stats.handshakeLatency.getPercentile(50).count()
+              << "us p99=" << stats.handshakeLatency.getPercentile(99).count()
+              << "us, failed connections=" << stats.failedConnections;
+    LOG(INFO) << "Sent " << stats.bytesSent << " bytes, received "
+              << stats.bytesReceived << " bytes";
+    LOG(INFO) << "Client CPU: " << cpu.count() / 1000000.0 << " seconds, "
+              << (gigabytes > 0 ? cpu.count() / 1000000.0 / gigabytes : 0)
+              << " seconds per GB";
+  }
+
+  class StopTimeout : public folly::HHWheelTimer::Callback {
+   public:
+    explicit StopTimeout(
+        std::vector<std::unique_ptr<RpcClientConnection>>& connections)
+        : connections_(connections) {}
+
+    void timeoutExpired() noexcept override {
+      for (auto& connection : connections_) {
+        connection->stop();
+      }
+    }
+
+    void callbackCanceled() noexcept override {}
+
+   private:
+    std::vector<std::unique_ptr<RpcClientConnection>>& connections_;
+  };
+
+  static constexpr std::chrono::seconds kRpcGracePeriod{2};
+
+  folly::SocketAddress addr_;
+  std::chrono::milliseconds transportTimerResolution_;
+  std::chrono::seconds duration_;
+  uint32_t numConnections_;
+  uint32_t numThreads_;
+  RpcOptions options_;
+};
+
 } // namespace tperf
 } // namespace quic
 
@@ -416,6 +951,8 @@ quic::CongestionControlType flagsToCongestionControlType(
     return quic::CongestionControlType::NewReno;
   } else if (congestionControlType == "bbr") {
     return quic::CongestionControlType::BBR;
+  } else if (congestionControlType == "bbr2") {
+    return quic::CongestionControlType::BBR2;
   } else if (congestionControlType == "copa") {
     return quic::CongestionControlType::Copa;
   } else if (congestionControlType == "none") {
@@ -445,8 +982,26 @@ int main(int argc, char* argv[]) {
         FLAGS_gso,
         FLAGS_max_cwnd_mss,
         FLAGS_pacing,
-        FLAGS_num_streams);
+        FLAGS_num_streams,
+        FLAGS_workload == "rpc");
     server.start();
+  } else if (FLAGS_mode == "client" && FLAGS_workload == "rpc") {
+    RpcOptions options{FLAGS_request_size,
+                       FLAGS_response_size,
+                       FLAGS_concurrent_rpcs,
+                       FLAGS_rpcs_per_connection,
+                       FLAGS_window,
+                       FLAGS_gso,
+                       flagsToCongestionControlType(FLAGS_congestion)};
+    RpcTPerfClient client(
+        FLAGS_host,
+        FLAGS_port,
+        std::chrono::milliseconds(FLAGS_client_transport_timer_resolution_ms),
+        FLAGS_duration,
+        FLAGS_num_connections,
+        FLAGS_client_threads,
+        options);
+    client.start();
   } else if (FLAGS_mode == "client") {
     TPerfClient client(
         FLAGS_host,